@@ -15,7 +15,7 @@ TMR_CC_FLAGS = ${TMR_FLAGS} ${TMR_INCLUDE} ${BLOSSOM_INCLUDE} ${TACS_OPT_CC_FLAG
 TMR_DEBUG_CC_FLAGS = ${TMR_DEBUG_FLAGS} ${TMR_INCLUDE} ${BLOSSOM_INCLUDE} ${TACS_DEBUG_CC_FLAGS} ${EGADS_DEBUG_CC_FLAGS}
 
 # Set the compiler flags
-TMR_EXTERN_LIBS = ${BLOSSOM_LIB} ${TACS_LD_FLAGS} ${PAROPT_LD_FLAGS} ${EGADS_LD_FLAGS} ${OPENCASCADE_LIB_PATH} ${OPENCASCADE_LIBS} ${NETGEN_LD_FLAGS}
+TMR_EXTERN_LIBS = ${BLOSSOM_LIB} ${TACS_LD_FLAGS} ${PAROPT_LD_FLAGS} ${EGADS_LD_FLAGS} ${OPENCASCADE_LIB_PATH} ${OPENCASCADE_LIBS} ${NETGEN_LD_FLAGS} -lpthread
 TMR_LD_FLAGS = ${TMR_LD_CMD} ${TMR_EXTERN_LIBS}
 
 # This is the one rule that is used to compile all the source
@@ -5,6 +5,12 @@
   This is a conversion tool that converts the output .bstl file (which
   is the results of a parallel I/O and is in bindary) to a regular
   .stl file.
+
+  Usage: bstltostl [-binary | -indexed] [-threads N] files
+
+  By default the output is an ASCII .stl file. With -binary, the
+  output is a binary .stl file, and with -indexed, the output is an
+  indexed binary .ibin file with merged vertices.
 */
 int main(int argc, char *argv[]) {
   MPI_Init(&argc, &argv);
@@ -17,13 +23,35 @@ int main(int argc, char *argv[]) {
     return (1);
   }
 
+  // Set the output format and the number of threads
+  TMRBinConvertType type = TMR_ASCII_STL;
+  const char *ext = ".stl";
+  int num_threads = 1;
+
   // Loop over all of the input files
   for (int k = 1; k < argc; k++) {
+    if (strcmp(argv[k], "-binary") == 0) {
+      type = TMR_BINARY_STL;
+      ext = ".stl";
+      continue;
+    } else if (strcmp(argv[k], "-indexed") == 0) {
+      type = TMR_INDEXED_BIN;
+      ext = ".ibin";
+      continue;
+    } else if (strcmp(argv[k], "-threads") == 0 && k + 1 < argc) {
+      num_threads = atoi(argv[k + 1]);
+      if (num_threads < 1) {
+        num_threads = 1;
+      }
+      k++;
+      continue;
+    }
+
     char *infile = new char[strlen(argv[k]) + 1];
     strcpy(infile, argv[k]);
 
     // Set the output file
-    char *outfile = new char[strlen(infile) + 5];
+    char *outfile = new char[strlen(infile) + strlen(ext) + 1];
     int len = strlen(infile);
     int i = len - 1;
     for (; i >= 0; i--) {
@@ -31,14 +59,14 @@ int main(int argc, char *argv[]) {
         break;
       }
     }
-    if (i == 0) {
-      i = len - 1;
+    if (i <= 0) {
+      i = len;
     }
     strcpy(outfile, infile);
-    strcpy(&outfile[i], ".stl");
+    strcpy(&outfile[i], ext);
 
     if (strcmp(infile, outfile) != 0) {
-      TMR_ConvertBinToSTL(infile, outfile);
+      TMR_ConvertBinFile(infile, outfile, type, num_threads);
     }
 
     delete[] infile;
@@ -0,0 +1,431 @@
+#include "TACSAssembler.h"
+#include "TACSElement3D.h"
+#include "TACSHexaBasis.h"
+#include "TACSLinearElasticity.h"
+#include "TACSMg.h"
+#include "TMROctForest.h"
+#include "TMR_RefinementTools.h"
+
+/*
+  Benchmark the main parallel operations on a forest of octrees
+
+  The forest is built on a structured nx x ny x nz array of blocks and
+  refined randomly with createRandomTrees(). The time for each of the
+  main operations is recorded separately and the minimum, maximum and
+  average time across all processors is written in JSON format.
+
+  Two scenarios are available:
+
+  strong:  a fixed array of nblocks^3 blocks
+  weak:    an array of (nblocks*size) x nblocks x nblocks blocks, so that
+           the number of blocks per processor is fixed
+
+  Usage:
+  mpirun -np 4 ./tmr_bench [weak|strong] nblocks=4 nrand=10 min_level=0
+                           max_level=6 order=2 nlevels=4 nthreads=1
+                           output=bench.json
+*/
+
+// The maximum number of recorded timings
+const int MAX_NUM_TIMINGS = 16;
+
+/*
+  Record the names and the times of the benchmarked operations
+*/
+class TMRBenchTimings {
+ public:
+  TMRBenchTimings() { num_timings = 0; }
+
+  // Add the time to the named operation
+  void add(const char *name, double t) {
+    for (int i = 0; i < num_timings; i++) {
+      if (strcmp(names[i], name) == 0) {
+        times[i] += t;
+        return;
+      }
+    }
+    if (num_timings < MAX_NUM_TIMINGS) {
+      names[num_timings] = name;
+      times[num_timings] = t;
+      num_timings++;
+    }
+  }
+
+  int num_timings;
+  const char *names[MAX_NUM_TIMINGS];
+  double times[MAX_NUM_TIMINGS];
+};
+
+/*
+  Create the connectivity for a structured array of blocks
+*/
+void createBlockConn(int nx, int ny, int nz, int **_conn, double **_Xpts) {
+  int *conn = new int[8 * nx * ny * nz];
+  double *Xpts = new double[3 * (nx + 1) * (ny + 1) * (nz + 1)];
+
+  for (int k = 0; k < nz + 1; k++) {
+    for (int j = 0; j < ny + 1; j++) {
+      for (int i = 0; i < nx + 1; i++) {
+        int node = i + (nx + 1) * (j + (ny + 1) * k);
+        Xpts[3 * node] = 1.0 * i;
+        Xpts[3 * node + 1] = 1.0 * j;
+        Xpts[3 * node + 2] = 1.0 * k;
+      }
+    }
+  }
+
+  for (int k = 0; k < nz; k++) {
+    for (int j = 0; j < ny; j++) {
+      for (int i = 0; i < nx; i++) {
+        int block = i + nx * (j + ny * k);
+        for (int kk = 0; kk < 2; kk++) {
+          for (int jj = 0; jj < 2; jj++) {
+            for (int ii = 0; ii < 2; ii++) {
+              conn[8 * block + ii + 2 * jj + 4 * kk] =
+                  (i + ii) + (nx + 1) * ((j + jj) + (ny + 1) * (k + kk));
+            }
+          }
+        }
+      }
+    }
+  }
+
+  *_conn = conn;
+  *_Xpts = Xpts;
+}
+
+/*
+  Create the TACSAssembler object for the forest
+*/
+TACSAssembler *createAssembler(TMROctForest *forest, TACSElement *elem,
+                               const int *block_conn, const double *Xpts) {
+  MPI_Comm comm = forest->getMPIComm();
+  int mpi_rank;
+  MPI_Comm_rank(comm, &mpi_rank);
+
+  // Find the number of nodes for this processor
+  const int *range;
+  forest->getOwnedNodeRange(&range);
+  int num_nodes = range[mpi_rank + 1] - range[mpi_rank];
+
+  // Get the mesh connectivity
+  const int *elem_conn;
+  int num_elements = 0;
+  forest->getNodeConn(&elem_conn, &num_elements);
+
+  // Get the dependent node information
+  const int *dep_ptr, *dep_conn;
+  const double *dep_weights;
+  int num_dep_nodes = forest->getDepNodeConn(&dep_ptr, &dep_conn, &dep_weights);
+
+  // Create the associated TACSAssembler object
+  int vars_per_node = 3;
+  TACSAssembler *assembler = new TACSAssembler(comm, vars_per_node, num_nodes,
+                                               num_elements, num_dep_nodes);
+
+  // Set the element connectivity into TACSAssembler
+  int order = forest->getMeshOrder();
+  int nnodes = order * order * order;
+  int *ptr = new int[num_elements + 1];
+  for (int i = 0; i < num_elements + 1; i++) {
+    ptr[i] = nnodes * i;
+  }
+  assembler->setElementConnectivity(ptr, elem_conn);
+  delete[] ptr;
+
+  // Set the dependent node information
+  assembler->setDependentNodes(dep_ptr, dep_conn, dep_weights);
+
+  // Set the elements
+  TACSElement **elems = new TACSElement *[num_elements];
+  for (int k = 0; k < num_elements; k++) {
+    elems[k] = elem;
+  }
+  assembler->setElements(elems);
+  delete[] elems;
+
+  assembler->initialize();
+
+  // Set the node locations using the trilinear map for each block
+  TMROctantArray *octants;
+  forest->getOctants(&octants);
+  int oct_size;
+  TMROctant *octs;
+  octants->getArray(&octs, &oct_size);
+
+  const double *knots;
+  forest->getInterpKnots(&knots);
+
+  TacsScalar *Xn;
+  TACSBVec *X = assembler->createNodeVec();
+  X->incref();
+  X->getArray(&Xn);
+
+  const int32_t hmax = 1 << TMR_MAX_LEVEL;
+  for (int i = 0; i < oct_size; i++) {
+    const int32_t h = 1 << (TMR_MAX_LEVEL - octs[i].level);
+    const int *c = &elem_conn[nnodes * i];
+    for (int j = 0; j < nnodes; j++) {
+      if (c[j] >= range[mpi_rank] && c[j] < range[mpi_rank + 1]) {
+        int index = c[j] - range[mpi_rank];
+        int ii = j % order;
+        int jj = (j % (order * order)) / order;
+        int kk = j / (order * order);
+        double u = (octs[i].x + h * knots[ii]) / hmax;
+        double v = (octs[i].y + h * knots[jj]) / hmax;
+        double w = (octs[i].z + h * knots[kk]) / hmax;
+
+        // The blocks are unit cubes, so the location is offset from
+        // the first node of the block
+        const int *bc = &block_conn[8 * octs[i].block];
+        Xn[3 * index] = Xpts[3 * bc[0]] + u;
+        Xn[3 * index + 1] = Xpts[3 * bc[0] + 1] + v;
+        Xn[3 * index + 2] = Xpts[3 * bc[0] + 2] + w;
+      }
+    }
+  }
+
+  assembler->setNodes(X);
+  X->decref();
+
+  return assembler;
+}
+
+/*
+  Write out the statistics for the timings across all processors
+*/
+void writeTimings(MPI_Comm comm, FILE *fp, const char *scenario, int nblocks,
+                  int order, int nlevels, long int num_elements,
+                  long int num_nodes, TMRBenchTimings *timings) {
+  int mpi_rank, mpi_size;
+  MPI_Comm_rank(comm, &mpi_rank);
+  MPI_Comm_size(comm, &mpi_size);
+
+  int n = timings->num_timings;
+  double tmin[MAX_NUM_TIMINGS], tmax[MAX_NUM_TIMINGS], tsum[MAX_NUM_TIMINGS];
+  MPI_Reduce(timings->times, tmin, n, MPI_DOUBLE, MPI_MIN, 0, comm);
+  MPI_Reduce(timings->times, tmax, n, MPI_DOUBLE, MPI_MAX, 0, comm);
+  MPI_Reduce(timings->times, tsum, n, MPI_DOUBLE, MPI_SUM, 0, comm);
+
+  if (mpi_rank == 0) {
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"scenario\": \"%s\",\n", scenario);
+    fprintf(fp, "  \"mpi_size\": %d,\n", mpi_size);
+    fprintf(fp, "  \"nblocks\": %d,\n", nblocks);
+    fprintf(fp, "  \"order\": %d,\n", order);
+    fprintf(fp, "  \"nlevels\": %d,\n", nlevels);
+    fprintf(fp, "  \"num_elements\": %ld,\n", num_elements);
+    fprintf(fp, "  \"num_nodes\": %ld,\n", num_nodes);
+    fprintf(fp, "  \"timings\": {\n");
+    for (int i = 0; i < n; i++) {
+      fprintf(fp,
+              "    \"%s\": {\"min\": %.6e, \"max\": %.6e, "
+              "\"avg\": %.6e}%s\n",
+              timings->names[i], tmin[i], tmax[i], tsum[i] / mpi_size,
+              (i < n - 1 ? "," : ""));
+    }
+    fprintf(fp, "  }\n");
+    fprintf(fp, "}\n");
+  }
+}
+
+int main(int argc, char *argv[]) {
+  MPI_Init(&argc, &argv);
+  TMRInitialize();
+
+  MPI_Comm comm = MPI_COMM_WORLD;
+  int mpi_rank, mpi_size;
+  MPI_Comm_rank(comm, &mpi_rank);
+  MPI_Comm_size(comm, &mpi_size);
+
+  // Set the default parameters
+  const char *scenario = "strong";
+  int nblocks = 4;
+  int nrand = 10;
+  int min_level = 0;
+  int max_level = 6;
+  int order = 2;
+  int nlevels = 4;
+  int nthreads = 1;
+  char output[256];
+  output[0] = '\0';
+
+  for (int k = 0; k < argc; k++) {
+    if (strcmp(argv[k], "weak") == 0) {
+      scenario = "weak";
+    } else if (strcmp(argv[k], "strong") == 0) {
+      scenario = "strong";
+    }
+    sscanf(argv[k], "nblocks=%d", &nblocks);
+    sscanf(argv[k], "nrand=%d", &nrand);
+    sscanf(argv[k], "min_level=%d", &min_level);
+    sscanf(argv[k], "max_level=%d", &max_level);
+    sscanf(argv[k], "order=%d", &order);
+    sscanf(argv[k], "nlevels=%d", &nlevels);
+    sscanf(argv[k], "nthreads=%d", &nthreads);
+    sscanf(argv[k], "output=%255s", output);
+  }
+  if (order < 2) {
+    order = 2;
+  } else if (order > 4) {
+    order = 4;
+  }
+  if (nlevels < 2) {
+    nlevels = 2;
+  }
+
+  // Set the size of the array of blocks
+  int nx = nblocks, ny = nblocks, nz = nblocks;
+  if (strcmp(scenario, "weak") == 0) {
+    nx = nblocks * mpi_size;
+  }
+
+  int *block_conn;
+  double *Xpts;
+  createBlockConn(nx, ny, nz, &block_conn, &Xpts);
+  int num_block_nodes = (nx + 1) * (ny + 1) * (nz + 1);
+
+  // Use the same random refinement on each run
+  srand(mpi_rank + 1);
+
+  TMRBenchTimings timings;
+  double t0;
+
+  // Create the finest forest
+  TMROctForest **forest = new TMROctForest *[nlevels];
+  forest[0] = new TMROctForest(comm, order, TMR_GAUSS_LOBATTO_POINTS);
+  forest[0]->incref();
+  forest[0]->setNumThreads(nthreads);
+  forest[0]->setConnectivity(num_block_nodes, block_conn, nx * ny * nz);
+
+  MPI_Barrier(comm);
+  t0 = MPI_Wtime();
+  forest[0]->createRandomTrees(nrand, min_level, max_level);
+  timings.add("create_trees", MPI_Wtime() - t0);
+
+  MPI_Barrier(comm);
+  t0 = MPI_Wtime();
+  forest[0]->balance(0);
+  timings.add("balance", MPI_Wtime() - t0);
+
+  MPI_Barrier(comm);
+  t0 = MPI_Wtime();
+  forest[0]->repartition();
+  timings.add("repartition", MPI_Wtime() - t0);
+
+  // Create the forest hierarchy, reducing the order first
+  MPI_Barrier(comm);
+  t0 = MPI_Wtime();
+  for (int level = 1; level < nlevels; level++) {
+    int level_order = forest[level - 1]->getMeshOrder();
+    if (level_order > 2) {
+      forest[level] = forest[level - 1]->duplicate();
+      forest[level]->setMeshOrder(level_order - 1, TMR_GAUSS_LOBATTO_POINTS);
+    } else {
+      forest[level] = forest[level - 1]->coarsenBalanced(0);
+    }
+    forest[level]->incref();
+    forest[level]->setNumThreads(nthreads);
+  }
+  timings.add("coarsen", MPI_Wtime() - t0);
+
+  for (int level = 0; level < nlevels; level++) {
+    MPI_Barrier(comm);
+    t0 = MPI_Wtime();
+    forest[level]->createNodes();
+    timings.add("create_nodes", MPI_Wtime() - t0);
+  }
+
+  // Count the global number of elements and nodes on the finest level
+  TMROctantArray *octants;
+  forest[0]->getOctants(&octants);
+  int size;
+  octants->getArray(NULL, &size);
+  long int num_elements = size, num_nodes = 0;
+  MPI_Allreduce(MPI_IN_PLACE, &num_elements, 1, MPI_LONG, MPI_SUM, comm);
+  const int *range;
+  forest[0]->getOwnedNodeRange(&range);
+  num_nodes = range[mpi_size];
+
+  // Create the elements for each order
+  TACSMaterialProperties *props = new TACSMaterialProperties(
+      2700.0, 921.096, 70e3, 0.3, 270.0, 24.0e-6, 230.0);
+  TACSSolidConstitutive *stiff = new TACSSolidConstitutive(props);
+  TACSElementModel *model =
+      new TACSLinearElasticity3D(stiff, TACS_LINEAR_STRAIN);
+  TACSElement *elems[3];
+  elems[0] = new TACSElement3D(model, new TACSLinearHexaBasis());
+  elems[1] = new TACSElement3D(model, new TACSQuadraticHexaBasis());
+  elems[2] = new TACSElement3D(model, new TACSCubicHexaBasis());
+  for (int k = 0; k < 3; k++) {
+    elems[k]->incref();
+  }
+
+  // Create the TACSAssembler objects
+  TACSAssembler **assembler = new TACSAssembler *[nlevels];
+  MPI_Barrier(comm);
+  t0 = MPI_Wtime();
+  for (int level = 0; level < nlevels; level++) {
+    int level_order = forest[level]->getMeshOrder();
+    assembler[level] = createAssembler(forest[level], elems[level_order - 2],
+                                       block_conn, Xpts);
+    assembler[level]->incref();
+  }
+  timings.add("create_assembler", MPI_Wtime() - t0);
+
+  // Time the interpolation between each pair of levels
+  for (int level = 0; level < nlevels - 1; level++) {
+    TACSBVecInterp *interp =
+        new TACSBVecInterp(assembler[level + 1], assembler[level]);
+    interp->incref();
+
+    MPI_Barrier(comm);
+    t0 = MPI_Wtime();
+    forest[level]->createInterpolation(forest[level + 1], interp);
+    interp->initialize();
+    timings.add("create_interpolation", MPI_Wtime() - t0);
+
+    interp->decref();
+  }
+
+  // Time the creation of the full multigrid object
+  TACSMg *mg;
+  MPI_Barrier(comm);
+  t0 = MPI_Wtime();
+  TMR_CreateTACSMg(nlevels, assembler, forest, &mg);
+  mg->incref();
+  timings.add("create_mg", MPI_Wtime() - t0);
+
+  // Write out the timings
+  FILE *fp = stdout;
+  if (mpi_rank == 0 && output[0] != '\0') {
+    fp = fopen(output, "w");
+    if (!fp) {
+      fprintf(stderr, "tmr_bench: Could not open file %s\n", output);
+      fp = stdout;
+    }
+  }
+  writeTimings(comm, fp, scenario, nblocks, order, nlevels, num_elements,
+               num_nodes, &timings);
+  if (fp != stdout) {
+    fclose(fp);
+  }
+
+  // Free everything
+  mg->decref();
+  for (int level = 0; level < nlevels; level++) {
+    assembler[level]->decref();
+    forest[level]->decref();
+  }
+  delete[] assembler;
+  delete[] forest;
+  for (int k = 0; k < 3; k++) {
+    elems[k]->decref();
+  }
+  delete[] block_conn;
+  delete[] Xpts;
+
+  TMRFinalize();
+  MPI_Finalize();
+  return 0;
+}
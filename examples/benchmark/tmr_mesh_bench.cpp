@@ -0,0 +1,467 @@
+#include <ctype.h>
+#include <math.h>
+
+#include "TMRFaceMesh.h"
+#include "TMRMesh.h"
+#include "TMR_QualityTools.h"
+
+#ifdef TMR_HAS_OPENCASCADE
+#include "TMROpenCascade.h"
+#endif  // TMR_HAS_OPENCASCADE
+
+#ifdef TMR_HAS_EGADS
+#include "TMREgads.h"
+#endif  // TMR_HAS_EGADS
+
+/*
+  Benchmark the surface and volume meshing on a fixed corpus of models
+
+  Each model in the corpus is meshed at several target sizes, set as
+  fractions of the diagonal of the bounding box of the model vertices,
+  so that the same sizes are used regardless of the model units. For
+  each mesh, the time for TMRMesh::mesh() is recorded along with the
+  time spent in each stage of the face meshing, the point location
+  counts from the triangulation and the element quality. The same
+  data is also recorded for each face. The results are written in
+  JSON format so that runs from different versions can be compared.
+
+  The corpus consists of the models in the examples directory:
+
+  crank:      examples/crank/crank.stp (swept volume)
+  2d-disk:    examples/poisson/2d-disk.stp
+  2d-square:  examples/poisson/2d-square.stp
+  crm:        examples/egads/crm/final_surface.igs
+
+  Other STEP, IGES or EGADS files can be added with file=. Models that
+  cannot be loaded with the available geometry interfaces are skipped.
+
+  Usage:
+  mpirun -np 1 ./tmr_mesh_bench examples=../ ndiv=10 nsizes=3
+                                 nthreads=1 units=M file=model.step
+                                 output=mesh_bench.json
+*/
+
+// The maximum number of models in the corpus
+const int MAX_NUM_MODELS = 16;
+
+// The number of values recorded for each face
+const int NUM_FACE_VALUES = 7;
+
+/*
+  A model in the benchmark corpus
+*/
+class TMRBenchModel {
+ public:
+  const char *name;
+  char filename[256];
+
+  // The source face for a swept volume (if any)
+  int source_volume, source_face, target_face;
+};
+
+/*
+  Check whether the file name ends with the given extension
+*/
+int hasExtension(const char *filename, const char *ext) {
+  size_t len = strlen(filename), elen = strlen(ext);
+  if (len < elen) {
+    return 0;
+  }
+  for (size_t i = 0; i < elen; i++) {
+    if (tolower(filename[len - elen + i]) != ext[i]) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/*
+  Load the model using the geometry interface based on the extension
+*/
+TMRModel *loadModel(const char *filename, const char *units) {
+  FILE *fp = fopen(filename, "r");
+  if (!fp) {
+    return NULL;
+  }
+  fclose(fp);
+
+#ifdef TMR_HAS_OPENCASCADE
+  if (hasExtension(filename, ".stp") || hasExtension(filename, ".step")) {
+    return TMR_LoadModelFromSTEPFile(filename, units);
+  } else if (hasExtension(filename, ".igs") ||
+             hasExtension(filename, ".iges")) {
+    return TMR_LoadModelFromIGESFile(filename, units);
+  }
+#endif  // TMR_HAS_OPENCASCADE
+#ifdef TMR_HAS_EGADS
+  if (hasExtension(filename, ".egads")) {
+    return TMR_EgadsInterface::TMR_LoadModelFromEGADSFile(filename, units);
+  }
+#endif  // TMR_HAS_EGADS
+  return NULL;
+}
+
+/*
+  Compute the diagonal of the bounding box of the model vertices
+*/
+double computeModelSize(TMRModel *geo) {
+  int num_vertices;
+  TMRVertex **vertices;
+  geo->getVertices(&num_vertices, &vertices);
+
+  TMRPoint xmin, xmax;
+  for (int i = 0; i < num_vertices; i++) {
+    TMRPoint p;
+    vertices[i]->evalPoint(&p);
+    if (i == 0) {
+      xmin = xmax = p;
+    } else {
+      xmin.x = (p.x < xmin.x ? p.x : xmin.x);
+      xmin.y = (p.y < xmin.y ? p.y : xmin.y);
+      xmin.z = (p.z < xmin.z ? p.z : xmin.z);
+      xmax.x = (p.x > xmax.x ? p.x : xmax.x);
+      xmax.y = (p.y > xmax.y ? p.y : xmax.y);
+      xmax.z = (p.z > xmax.z ? p.z : xmax.z);
+    }
+  }
+
+  if (num_vertices == 0) {
+    return 0.0;
+  }
+  return sqrt((xmax.x - xmin.x) * (xmax.x - xmin.x) +
+              (xmax.y - xmin.y) * (xmax.y - xmin.y) +
+              (xmax.z - xmin.z) * (xmax.z - xmin.z));
+}
+
+/*
+  Compute the minimum quality of the quadrilaterals in a face mesh
+*/
+void computeFaceQuality(TMRFaceMesh *mesh, double min_quality[]) {
+  for (int j = 0; j < TMR_NUM_QUALITY_METRICS; j++) {
+    min_quality[j] = 1.0;
+  }
+
+  int npts;
+  TMRPoint *X;
+  mesh->getMeshPoints(&npts, NULL, &X);
+  const int *quads;
+  int nquads = mesh->getQuadConnectivity(&quads);
+  for (int i = 0; i < nquads; i++) {
+    TMRPoint Xc[4];
+    for (int k = 0; k < 4; k++) {
+      Xc[k] = X[quads[4 * i + k]];
+    }
+    double quality[TMR_NUM_QUALITY_METRICS];
+    TMR_ComputeElementQuality(4, Xc, quality);
+    for (int j = 0; j < TMR_NUM_QUALITY_METRICS; j++) {
+      if (quality[j] < min_quality[j]) {
+        min_quality[j] = quality[j];
+      }
+    }
+  }
+}
+
+/*
+  Write out the quality histogram and minimum quality
+*/
+void writeQuality(FILE *fp, const char *name, int nelems, int nbins,
+                  const int hist[], const double min_quality[],
+                  const char *end) {
+  const char *names[] = {"scaled_jacobian", "aspect_ratio", "skew"};
+  fprintf(fp, "      \"%s\": {\"num_elements\": %d", name, nelems);
+  for (int j = 0; j < TMR_NUM_QUALITY_METRICS; j++) {
+    fprintf(fp, ",\n        \"%s\": {\"min\": %.6e, \"hist\": [", names[j],
+            (nelems > 0 ? min_quality[j] : 0.0));
+    for (int k = 0; k < nbins; k++) {
+      fprintf(fp, "%d%s", hist[nbins * j + k], (k < nbins - 1 ? ", " : ""));
+    }
+    fprintf(fp, "]}");
+  }
+  fprintf(fp, "}%s\n", end);
+}
+
+/*
+  Mesh the model with the target size and write out the results
+*/
+void benchModel(MPI_Comm comm, FILE *fp, TMRBenchModel *model, TMRModel *geo,
+                double hfrac, double htarget, int nthreads, int first) {
+  int mpi_rank, mpi_size;
+  MPI_Comm_rank(comm, &mpi_rank);
+  MPI_Comm_size(comm, &mpi_size);
+
+  TMRMesh *mesh = new TMRMesh(comm, geo);
+  mesh->incref();
+
+  TMRMeshOptions options;
+  options.frontal_quality_factor = 1.25;
+  options.num_smoothing_steps = 10;
+  options.num_threads = nthreads;
+
+  MPI_Barrier(comm);
+  double t0 = MPI_Wtime();
+  mesh->mesh(options, htarget);
+  t0 = MPI_Wtime() - t0;
+
+  double tmin, tmax, tsum;
+  MPI_Reduce(&t0, &tmin, 1, MPI_DOUBLE, MPI_MIN, 0, comm);
+  MPI_Reduce(&t0, &tmax, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+  MPI_Reduce(&t0, &tsum, 1, MPI_DOUBLE, MPI_SUM, 0, comm);
+
+  // Collect the statistics from the processor that meshed each face
+  int num_faces;
+  TMRFace **faces;
+  geo->getFaces(&num_faces, &faces);
+  double *values = new double[NUM_FACE_VALUES * num_faces];
+  for (int i = 0; i < num_faces; i++) {
+    TMRFaceMesh *face_mesh = NULL;
+    faces[i]->getMesh(&face_mesh);
+    TMRFaceMeshStats stats;
+    if (face_mesh) {
+      face_mesh->getMeshStats(&stats);
+    }
+    double *v = &values[NUM_FACE_VALUES * i];
+    v[0] = stats.boundary_time;
+    v[1] = stats.triangulate_time;
+    v[2] = stats.smooth_time;
+    v[3] = stats.recombine_time;
+    v[4] = stats.total_time;
+    v[5] = stats.num_locate_walks;
+    v[6] = stats.num_locate_searches;
+  }
+  MPI_Allreduce(MPI_IN_PLACE, values, NUM_FACE_VALUES * num_faces, MPI_DOUBLE,
+                MPI_MAX, comm);
+
+  // Compute the quality of the global mesh
+  const int nbins = 10;
+  int quad_hist[TMR_NUM_QUALITY_METRICS * nbins];
+  int hex_hist[TMR_NUM_QUALITY_METRICS * nbins];
+  double quad_min[TMR_NUM_QUALITY_METRICS], hex_min[TMR_NUM_QUALITY_METRICS];
+  int nquads = mesh->computeMeshQuality(TMRMesh::TMR_QUAD, nbins, quad_hist,
+                                        quad_min);
+  int nhex =
+      mesh->computeMeshQuality(TMRMesh::TMR_HEX, nbins, hex_hist, hex_min);
+
+  if (mpi_rank == 0) {
+    int num_nodes = mesh->getMeshPoints(NULL);
+    int ntris, ntet;
+    mesh->getTriConnectivity(&ntris, NULL);
+    mesh->getTetConnectivity(&ntet, NULL);
+
+    // Sum the face stages
+    double totals[NUM_FACE_VALUES];
+    memset(totals, 0, NUM_FACE_VALUES * sizeof(double));
+    for (int i = 0; i < num_faces; i++) {
+      for (int k = 0; k < NUM_FACE_VALUES; k++) {
+        totals[k] += values[NUM_FACE_VALUES * i + k];
+      }
+    }
+
+    fprintf(fp, "%s    {\n", (first ? "" : ",\n"));
+    fprintf(fp, "      \"model\": \"%s\",\n", model->name);
+    fprintf(fp, "      \"file\": \"%s\",\n", model->filename);
+    fprintf(fp, "      \"hfrac\": %.6e,\n", hfrac);
+    fprintf(fp, "      \"htarget\": %.6e,\n", htarget);
+    fprintf(fp, "      \"num_nodes\": %d,\n", num_nodes);
+    fprintf(fp, "      \"num_quads\": %d,\n", nquads);
+    fprintf(fp, "      \"num_tris\": %d,\n", ntris);
+    fprintf(fp, "      \"num_hex\": %d,\n", nhex);
+    fprintf(fp, "      \"num_tet\": %d,\n", ntet);
+    fprintf(fp,
+            "      \"mesh_time\": {\"min\": %.6e, \"max\": %.6e, "
+            "\"avg\": %.6e},\n",
+            tmin, tmax, tsum / mpi_size);
+    fprintf(fp,
+            "      \"face_stages\": {\"boundary\": %.6e, "
+            "\"triangulate\": %.6e, \"smooth\": %.6e, \"recombine\": %.6e, "
+            "\"total\": %.6e},\n",
+            totals[0], totals[1], totals[2], totals[3], totals[4]);
+    fprintf(fp,
+            "      \"point_location\": {\"walks\": %.0f, "
+            "\"searches\": %.0f},\n",
+            totals[5], totals[6]);
+    writeQuality(fp, "quad_quality", nquads, nbins, quad_hist, quad_min, ",");
+    writeQuality(fp, "hex_quality", nhex, nbins, hex_hist, hex_min, ",");
+
+    fprintf(fp, "      \"faces\": [\n");
+    for (int i = 0; i < num_faces; i++) {
+      TMRFaceMesh *face_mesh = NULL;
+      faces[i]->getMesh(&face_mesh);
+      int npts = 0, fquads = 0, ftris = 0;
+      const char *type = "none";
+      double min_quality[TMR_NUM_QUALITY_METRICS] = {0.0, 0.0, 0.0};
+      if (face_mesh) {
+        face_mesh->getMeshPoints(&npts, NULL, NULL);
+        fquads = face_mesh->getQuadConnectivity(NULL);
+        ftris = face_mesh->getTriConnectivity(NULL);
+        computeFaceQuality(face_mesh, min_quality);
+        TMRFaceMeshType mesh_type = face_mesh->getMeshType();
+        if (mesh_type == TMR_STRUCTURED) {
+          type = "structured";
+        } else if (mesh_type == TMR_UNSTRUCTURED) {
+          type = "unstructured";
+        } else if (mesh_type == TMR_TRIANGLE) {
+          type = "triangle";
+        }
+      }
+
+      const double *v = &values[NUM_FACE_VALUES * i];
+      fprintf(fp,
+              "        {\"face\": %d, \"type\": \"%s\", \"num_points\": %d, "
+              "\"num_quads\": %d, \"num_tris\": %d,\n",
+              i, type, npts, fquads, ftris);
+      fprintf(fp,
+              "         \"boundary\": %.6e, \"triangulate\": %.6e, "
+              "\"smooth\": %.6e, \"recombine\": %.6e, \"total\": %.6e,\n",
+              v[0], v[1], v[2], v[3], v[4]);
+      fprintf(fp,
+              "         \"walks\": %.0f, \"searches\": %.0f, "
+              "\"min_quality\": [%.6e, %.6e, %.6e]}%s\n",
+              v[5], v[6], min_quality[0], min_quality[1], min_quality[2],
+              (i < num_faces - 1 ? "," : ""));
+    }
+    fprintf(fp, "      ]\n");
+    fprintf(fp, "    }");
+  }
+
+  delete[] values;
+  mesh->decref();
+}
+
+int main(int argc, char *argv[]) {
+  MPI_Init(&argc, &argv);
+  TMRInitialize();
+
+  MPI_Comm comm = MPI_COMM_WORLD;
+  int mpi_rank, mpi_size;
+  MPI_Comm_rank(comm, &mpi_rank);
+  MPI_Comm_size(comm, &mpi_size);
+
+  // Set the default parameters
+  char examples[256];
+  snprintf(examples, sizeof(examples), "..");
+  char units[32];
+  snprintf(units, sizeof(units), "M");
+  int ndiv = 10;
+  int nsizes = 3;
+  int nthreads = 1;
+  char output[256];
+  output[0] = '\0';
+
+  // The user-defined models
+  int num_files = 0;
+  char files[MAX_NUM_MODELS][256];
+
+  for (int k = 0; k < argc; k++) {
+    sscanf(argv[k], "examples=%255s", examples);
+    sscanf(argv[k], "units=%31s", units);
+    sscanf(argv[k], "ndiv=%d", &ndiv);
+    sscanf(argv[k], "nsizes=%d", &nsizes);
+    sscanf(argv[k], "nthreads=%d", &nthreads);
+    sscanf(argv[k], "output=%255s", output);
+    if (num_files < MAX_NUM_MODELS &&
+        sscanf(argv[k], "file=%255s", files[num_files]) == 1) {
+      num_files++;
+    }
+  }
+  if (ndiv < 1) {
+    ndiv = 1;
+  }
+  if (nsizes < 1) {
+    nsizes = 1;
+  }
+
+  // Set up the corpus
+  const char *names[] = {"crank", "2d-disk", "2d-square", "crm"};
+  const char *paths[] = {"crank/crank.stp", "poisson/2d-disk.stp",
+                         "poisson/2d-square.stp",
+                         "egads/crm/final_surface.igs"};
+  int num_models = 0;
+  TMRBenchModel models[MAX_NUM_MODELS];
+  for (int i = 0; i < 4; i++, num_models++) {
+    models[num_models].name = names[i];
+    snprintf(models[num_models].filename, 256, "%s/%s", examples, paths[i]);
+    models[num_models].source_volume = -1;
+    models[num_models].source_face = -1;
+    models[num_models].target_face = -1;
+  }
+
+  // The crank is swept from face 6 to face 7
+  models[0].source_volume = 0;
+  models[0].source_face = 6;
+  models[0].target_face = 7;
+
+  for (int i = 0; i < num_files && num_models < MAX_NUM_MODELS;
+       i++, num_models++) {
+    models[num_models].name = files[i];
+    snprintf(models[num_models].filename, 256, "%s", files[i]);
+    models[num_models].source_volume = -1;
+    models[num_models].source_face = -1;
+    models[num_models].target_face = -1;
+  }
+
+  FILE *fp = stdout;
+  if (output[0] != '\0' && mpi_rank == 0) {
+    fp = fopen(output, "w");
+    if (!fp) {
+      fprintf(stderr, "tmr_mesh_bench: Could not open %s\n", output);
+      fp = stdout;
+    }
+  }
+
+  if (mpi_rank == 0) {
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"mpi_size\": %d,\n", mpi_size);
+    fprintf(fp, "  \"num_threads\": %d,\n", nthreads);
+    fprintf(fp, "  \"cases\": [\n");
+  }
+
+  int first = 1;
+  for (int i = 0; i < num_models; i++) {
+    TMRModel *geo = loadModel(models[i].filename, units);
+    if (!geo) {
+      if (mpi_rank == 0) {
+        fprintf(stderr, "tmr_mesh_bench: Skipping %s\n", models[i].filename);
+      }
+      continue;
+    }
+    geo->incref();
+
+    // Set the source face for the swept volume
+    int num_faces, num_volumes;
+    TMRFace **faces;
+    TMRVolume **volumes;
+    geo->getFaces(&num_faces, &faces);
+    geo->getVolumes(&num_volumes, &volumes);
+    if (models[i].source_volume >= 0 &&
+        models[i].source_volume < num_volumes &&
+        models[i].source_face < num_faces &&
+        models[i].target_face < num_faces) {
+      faces[models[i].target_face]->setSource(
+          volumes[models[i].source_volume], faces[models[i].source_face]);
+    }
+
+    // Mesh the model with successively smaller target sizes
+    double size = computeModelSize(geo);
+    int div = ndiv;
+    for (int k = 0; k < nsizes; k++, div *= 2) {
+      double hfrac = 1.0 / div;
+      benchModel(comm, fp, &models[i], geo, hfrac, hfrac * size, nthreads,
+                 first);
+      first = 0;
+    }
+
+    geo->decref();
+  }
+
+  if (mpi_rank == 0) {
+    fprintf(fp, "\n  ]\n");
+    fprintf(fp, "}\n");
+    if (fp != stdout) {
+      fclose(fp);
+    }
+  }
+
+  TMRFinalize();
+  MPI_Finalize();
+  return 0;
+}
@@ -31,11 +31,33 @@ static int TMR_is_initialized = 0;
 
 // The TMR data type for MPI useage
 MPI_Datatype TMROctant_MPI_type;
+MPI_Datatype TMROctantNode_MPI_type;
+MPI_Datatype TMROctantTag_MPI_type;
 MPI_Datatype TMRQuadrant_MPI_type;
 MPI_Datatype TMRPoint_MPI_type;
 MPI_Datatype TMRIndexWeight_MPI_type;
 MPI_Datatype TMR_STLTriangle_MPI_type;
 
+// The attribute key for the per-communicator count exchange sequence
+static int TMR_exchange_keyval = MPI_KEYVAL_INVALID;
+
+// The base tag used for the sparse count exchange
+static const int TMR_EXCHANGE_TAG = 7100;
+
+// The profile data for each phase and the nesting depth of each phase
+static TMRProfileData tmr_profile_data[TMR_PROFILE_NUM_PHASES];
+static int tmr_profile_depth[TMR_PROFILE_NUM_PHASES];
+static double tmr_profile_start[TMR_PROFILE_NUM_PHASES];
+
+/*
+  Free the sequence counter attached to a communicator
+*/
+static int TMRDeleteExchangeAttr(MPI_Comm comm, int keyval, void *attr,
+                                 void *extra) {
+  delete static_cast<int *>(attr);
+  return MPI_SUCCESS;
+}
+
 /*
   Initialize TMR data type
 */
@@ -63,6 +85,32 @@ void TMRInitialize() {
     MPI_Type_create_struct(2, counts, offset, types, &TMROctant_MPI_type);
     MPI_Type_commit(&TMROctant_MPI_type);
 
+    // Create the node data type for the TMROctant. This only contains
+    // the block, the x/y/z coordinates and the info, which identify a
+    // node, but it has the extent of a full octant so that the nodes
+    // can be sent directly from an octant array.
+    MPI_Datatype node_type;
+    counts[0] = 4;
+    counts[1] = 1;
+    offset[0] = offsetof(TMROctant, block);
+    offset[1] = offsetof(TMROctant, info);
+    MPI_Type_create_struct(2, counts, offset, types, &node_type);
+    MPI_Type_create_resized(node_type, 0, sizeof(TMROctant),
+                            &TMROctantNode_MPI_type);
+    MPI_Type_commit(&TMROctantNode_MPI_type);
+    MPI_Type_free(&node_type);
+
+    // Create the tag data type for the TMROctant. This is used to send
+    // only the tag of each octant from an octant array.
+    MPI_Datatype tag_type;
+    counts[0] = 1;
+    offset[0] = offsetof(TMROctant, tag);
+    MPI_Type_create_struct(1, counts, offset, types, &tag_type);
+    MPI_Type_create_resized(tag_type, 0, sizeof(TMROctant),
+                            &TMROctantTag_MPI_type);
+    MPI_Type_commit(&TMROctantTag_MPI_type);
+    MPI_Type_free(&tag_type);
+
     // Create the TMRPoint data type
     counts[0] = 3;
     offset[0] = 0;
@@ -86,6 +134,10 @@ void TMRInitialize() {
                            &TMR_STLTriangle_MPI_type);
     MPI_Type_commit(&TMR_STLTriangle_MPI_type);
 
+    // Create the key for the count exchange sequence counter
+    MPI_Comm_create_keyval(MPI_COMM_NULL_COPY_FN, TMRDeleteExchangeAttr,
+                           &TMR_exchange_keyval, NULL);
+
     // Set the TMR initialization flag
     TMR_is_initialized = 1;
   }
@@ -101,14 +153,375 @@ int TMRIsInitialized() { return TMR_is_initialized; }
 */
 void TMRFinalize() {
   MPI_Type_free(&TMROctant_MPI_type);
+  MPI_Type_free(&TMROctantNode_MPI_type);
+  MPI_Type_free(&TMROctantTag_MPI_type);
   MPI_Type_free(&TMRQuadrant_MPI_type);
   MPI_Type_free(&TMRPoint_MPI_type);
   MPI_Type_free(&TMRIndexWeight_MPI_type);
   MPI_Type_free(&TMR_STLTriangle_MPI_type);
+  if (TMR_exchange_keyval != MPI_KEYVAL_INVALID) {
+    MPI_Comm_free_keyval(&TMR_exchange_keyval);
+  }
+}
+
+/*
+  Exchange the message counts for a sparse all-to-all pattern
+
+  Each processor knows how many entries it will send to every other
+  processor, but not how many it will receive. Instead of an
+  MPI_Alltoall, this uses the non-blocking consensus algorithm: the
+  non-zero counts are sent with synchronous sends, any incoming count
+  is received as it arrives, and once all local sends have been
+  matched, a non-blocking barrier signals global completion. The cost
+  scales with the number of neighbors rather than the number of
+  processors.
+
+  The tag alternates between consecutive calls on the same
+  communicator so that a processor that has already moved on to the
+  next exchange cannot have its counts picked up by a processor that
+  is still finishing the previous one.
+
+  input:
+  comm:         the communicator
+  counts:       the number of entries sent to each processor
+
+  output:
+  recv_counts:  the number of entries received from each processor
+*/
+void TMRExchangeCounts(MPI_Comm comm, const int *counts, int *recv_counts) {
+  int mpi_rank, mpi_size;
+  MPI_Comm_rank(comm, &mpi_rank);
+  MPI_Comm_size(comm, &mpi_size);
+
+#if MPI_VERSION >= 3
+  if (TMR_exchange_keyval != MPI_KEYVAL_INVALID) {
+    // Retrieve the sequence counter attached to this communicator
+    int *seq = NULL, flag = 0;
+    MPI_Comm_get_attr(comm, TMR_exchange_keyval, &seq, &flag);
+    if (!flag) {
+      seq = new int(0);
+      MPI_Comm_set_attr(comm, TMR_exchange_keyval, seq);
+    }
+    int tag = TMR_EXCHANGE_TAG + (*seq % 2);
+    (*seq)++;
+
+    // Send the non-zero counts to their destinations
+    int nsends = 0;
+    for (int i = 0; i < mpi_size; i++) {
+      recv_counts[i] = 0;
+      if (i != mpi_rank && counts[i] > 0) {
+        nsends++;
+      }
+    }
+    recv_counts[mpi_rank] = counts[mpi_rank];
+
+    MPI_Request *send_request = new MPI_Request[nsends];
+    for (int i = 0, j = 0; i < mpi_size; i++) {
+      if (i != mpi_rank && counts[i] > 0) {
+        MPI_Issend(&counts[i], 1, MPI_INT, i, tag, comm, &send_request[j]);
+        j++;
+      }
+    }
+    TMR_PROFILE_MESSAGES(nsends, nsends, MPI_INT);
+
+    // Receive counts until the barrier indicates that every send,
+    // on every processor, has been matched
+    MPI_Request barrier;
+    int barrier_active = 0, done = 0;
+    while (!done) {
+      int arrived = 0;
+      MPI_Status status;
+      MPI_Iprobe(MPI_ANY_SOURCE, tag, comm, &arrived, &status);
+      if (arrived) {
+        int source = status.MPI_SOURCE;
+        MPI_Recv(&recv_counts[source], 1, MPI_INT, source, tag, comm,
+                 MPI_STATUS_IGNORE);
+      }
+
+      if (barrier_active) {
+        MPI_Test(&barrier, &done, MPI_STATUS_IGNORE);
+      } else {
+        int sent = 0;
+        MPI_Testall(nsends, send_request, &sent, MPI_STATUSES_IGNORE);
+        if (sent) {
+          MPI_Ibarrier(comm, &barrier);
+          barrier_active = 1;
+        }
+      }
+    }
+
+    delete[] send_request;
+    return;
+  }
+#endif  // MPI_VERSION >= 3
+
+  MPI_Alltoall(const_cast<int *>(counts), 1, MPI_INT, recv_counts, 1, MPI_INT,
+               comm);
+  TMR_PROFILE_MESSAGES(0, mpi_size, MPI_INT);
+}
+
+/*
+  Create the node communicator and the map from the ranks in the
+  communicator to the ranks on the node
+*/
+TMRNodeSharedBuffer::TMRNodeSharedBuffer(MPI_Comm comm) {
+  node_comm = MPI_COMM_NULL;
+  node_rank = 0;
+  node_size = 0;
+  node_ranks = NULL;
+  seg_size = 0;
+  win = MPI_WIN_NULL;
+  segments = NULL;
+
+#if MPI_VERSION >= 3
+  int mpi_size;
+  MPI_Comm_size(comm, &mpi_size);
+  MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL,
+                      &node_comm);
+  MPI_Comm_rank(node_comm, &node_rank);
+  MPI_Comm_size(node_comm, &node_size);
+
+  // Translate the ranks in the communicator to the node ranks
+  MPI_Group group, node_group;
+  MPI_Comm_group(comm, &group);
+  MPI_Comm_group(node_comm, &node_group);
+  int *ranks = new int[mpi_size];
+  node_ranks = new int[mpi_size];
+  for (int i = 0; i < mpi_size; i++) {
+    ranks[i] = i;
+  }
+  MPI_Group_translate_ranks(group, mpi_size, ranks, node_group, node_ranks);
+  for (int i = 0; i < mpi_size; i++) {
+    if (node_ranks[i] == MPI_UNDEFINED) {
+      node_ranks[i] = -1;
+    }
+  }
+  delete[] ranks;
+  MPI_Group_free(&group);
+  MPI_Group_free(&node_group);
+
+  segments = new char *[node_size];
+  memset(segments, 0, node_size * sizeof(char *));
+#endif  // MPI_VERSION >= 3
+}
+
+/*
+  Free the window and the node communicator
+*/
+TMRNodeSharedBuffer::~TMRNodeSharedBuffer() {
+#if MPI_VERSION >= 3
+  if (win != MPI_WIN_NULL) {
+    MPI_Win_unlock_all(win);
+    MPI_Win_free(&win);
+  }
+  if (node_comm != MPI_COMM_NULL) {
+    MPI_Comm_free(&node_comm);
+  }
+#endif  // MPI_VERSION >= 3
+  if (node_ranks) {
+    delete[] node_ranks;
+  }
+  if (segments) {
+    delete[] segments;
+  }
+}
+
+/*
+  Make each segment at least the given size
+
+  The required size is reduced over the node so that every processor
+  allocates segments of the same size. Since no processor can return
+  from the reduction until all processors on the node have entered
+  it, a processor may also safely overwrite its segment after this
+  call, once the other processors have finished reading the data
+  from the previous exchange.
+*/
+char *TMRNodeSharedBuffer::reserve(size_t size) {
+#if MPI_VERSION >= 3
+  if (node_comm != MPI_COMM_NULL) {
+    unsigned long need = size, max_need = 0;
+    MPI_Allreduce(&need, &max_need, 1, MPI_UNSIGNED_LONG, MPI_MAX,
+                  node_comm);
+
+    if (max_need > seg_size || win == MPI_WIN_NULL) {
+      if (win != MPI_WIN_NULL) {
+        MPI_Win_unlock_all(win);
+        MPI_Win_free(&win);
+      }
+
+      // Allocate extra space to avoid frequent re-allocation
+      seg_size = max_need + max_need / 2 + 64;
+
+      MPI_Info info;
+      MPI_Info_create(&info);
+      MPI_Info_set(info, (char *)"alloc_shared_noncontig", (char *)"true");
+      char *base = NULL;
+      MPI_Win_allocate_shared(seg_size, 1, info, node_comm, &base, &win);
+      MPI_Info_free(&info);
+
+      for (int i = 0; i < node_size; i++) {
+        MPI_Aint len;
+        int disp_unit;
+        MPI_Win_shared_query(win, i, &len, &disp_unit, &segments[i]);
+      }
+      MPI_Win_lock_all(MPI_MODE_NOCHECK, win);
+    }
+
+    return segments[node_rank];
+  }
+#endif  // MPI_VERSION >= 3
+  return NULL;
 }
 
-TMREntity::TMREntity() : entity_id(entity_id_count) {
-  entity_id_count++;
+/*
+  Synchronize the segments so that the data written by each processor
+  is visible to all the processors on the node
+*/
+void TMRNodeSharedBuffer::sync() {
+#if MPI_VERSION >= 3
+  if (win != MPI_WIN_NULL) {
+    MPI_Win_sync(win);
+    MPI_Barrier(node_comm);
+    MPI_Win_sync(win);
+  }
+#endif  // MPI_VERSION >= 3
+}
+
+/*
+  Begin recording the profile data for a phase
+
+  Phases may be nested. The time is recorded for the outermost call
+  to each phase, while the messages and peak sizes are added to all
+  of the phases that are active.
+*/
+void TMRBeginProfilePhase(TMRProfilePhase phase) {
+  if (tmr_profile_depth[phase] == 0) {
+    tmr_profile_start[phase] = MPI_Wtime();
+    tmr_profile_data[phase].num_calls++;
+  }
+  tmr_profile_depth[phase]++;
+}
+
+/*
+  End recording the profile data for a phase
+*/
+void TMREndProfilePhase(TMRProfilePhase phase) {
+  if (tmr_profile_depth[phase] > 0) {
+    tmr_profile_depth[phase]--;
+    if (tmr_profile_depth[phase] == 0) {
+      tmr_profile_data[phase].time += MPI_Wtime() - tmr_profile_start[phase];
+    }
+  }
+}
+
+/*
+  Add the messages sent from this processor to the active phases
+
+  input:
+  num_messages:  the number of point-to-point messages
+  count:         the total number of entries sent or gathered
+  datatype:      the MPI data type of the entries
+*/
+void TMRAddProfileMessages(int num_messages, long int count,
+                           MPI_Datatype datatype) {
+  int type_size;
+  MPI_Type_size(datatype, &type_size);
+  long int num_bytes = count * type_size;
+  for (int k = 0; k < TMR_PROFILE_NUM_PHASES; k++) {
+    if (tmr_profile_depth[k] > 0) {
+      tmr_profile_data[k].num_messages += num_messages;
+      tmr_profile_data[k].num_bytes += num_bytes;
+    }
+  }
+}
+
+/*
+  Record the size of a hash table or queue in the active phases
+*/
+void TMRAddProfilePeakSize(long int size) {
+  for (int k = 0; k < TMR_PROFILE_NUM_PHASES; k++) {
+    if (tmr_profile_depth[k] > 0 && size > tmr_profile_data[k].peak_size) {
+      tmr_profile_data[k].peak_size = size;
+    }
+  }
+}
+
+/*
+  Set the number of local octants (or quadrants) after a phase
+*/
+void TMRSetProfileOctantCount(TMRProfilePhase phase, long int count) {
+  tmr_profile_data[phase].num_octants = count;
+}
+
+/*
+  Check whether TMR was compiled with profiling
+*/
+int TMRIsProfilingEnabled() {
+#ifdef TMR_USE_PROFILING
+  return 1;
+#else
+  return 0;
+#endif  // TMR_USE_PROFILING
+}
+
+/*
+  Retrieve the profile data for the given phase on this processor
+
+  returns: 1 if profiling is enabled and 0 otherwise
+*/
+int TMRGetProfileData(TMRProfilePhase phase, TMRProfileData *data) {
+  *data = tmr_profile_data[phase];
+  return TMRIsProfilingEnabled();
+}
+
+/*
+  Reset the profile data for all phases
+*/
+void TMRResetProfileData() {
+  memset(tmr_profile_data, 0, sizeof(tmr_profile_data));
+}
+
+/*
+  Allocate the storage for a shape function table
+
+  input:
+  dim:     the parametric dimension of the points
+  npts:    the number of points
+  pts:     the parametric points (dim*npts)
+  nbasis:  the number of shape functions at each point
+*/
+TMRInterpTable::TMRInterpTable(int _dim, int _npts, const double _pts[],
+                               int _nbasis) {
+  dim = _dim;
+  npts = _npts;
+  nbasis = _nbasis;
+  pts = new double[dim * npts];
+  memcpy(pts, _pts, dim * npts * sizeof(double));
+  N = new double[nbasis * npts];
+  Nd = new double[dim * nbasis * npts];
+  next = NULL;
+}
+
+TMRInterpTable::~TMRInterpTable() {
+  delete[] pts;
+  delete[] N;
+  delete[] Nd;
+}
+
+/*
+  Check whether the table was created for exactly these points
+*/
+int TMRInterpTable::matches(int _dim, int _npts, const double _pts[]) {
+  return (dim == _dim && npts == _npts &&
+          memcmp(pts, _pts, dim * npts * sizeof(double)) == 0);
+}
+
+/*
+  Create the entity. The identification number is incremented
+  atomically so that entities may be created from multiple threads.
+*/
+TMREntity::TMREntity()
+    : entity_id(__sync_fetch_and_add(&entity_id_count, 1)) {
   name = NULL;
   ref_count = 0;
 }
@@ -140,16 +553,17 @@ void TMREntity::setName(const char *_name) {
 const char *TMREntity::getName() const { return name; }
 
 /*
-  Increment the reference count
+  Increment the reference count. The reference counts are updated
+  atomically since entities such as faces may be shared between
+  threads during meshing.
 */
-void TMREntity::incref() { ref_count++; }
+void TMREntity::incref() { __sync_fetch_and_add(&ref_count, 1); }
 
 /*
   Decrease the reference count
 */
 void TMREntity::decref() {
-  ref_count--;
-  if (ref_count == 0) {
+  if (__sync_sub_and_fetch(&ref_count, 1) == 0) {
     delete this;
   }
 }
@@ -36,6 +36,10 @@
 */
 static const int TMR_MAX_LEVEL = 30;
 
+// The version and header size of the forest checkpoint files
+static const int TMR_FOREST_FILE_VERSION = 1;
+static const int TMR_FOREST_FILE_HEADER_SIZE = 64;
+
 /*
   Set the type of interpolation to use (only makes a difference
   for order >= 4)
@@ -46,6 +50,19 @@ enum TMRInterpolationType {
   TMR_BERNSTEIN_POINTS
 };
 
+/*
+  Tensor-product interpolation kernels specialized for a fixed order
+  and interpolation type (see TMRInterpolation.h)
+*/
+typedef void (*TMRInterpKernel)(const double *knots, const double *w,
+                                const double pt[], double N[]);
+typedef void (*TMRInterpDerivKernel2D)(const double *knots, const double *w,
+                                       const double pt[], double N[],
+                                       double N1[], double N2[]);
+typedef void (*TMRInterpDerivKernel3D)(const double *knots, const double *w,
+                                       const double pt[], double N[],
+                                       double N1[], double N2[], double N3[]);
+
 /**
   Base class for all point-evaluation algorithms
 */
@@ -85,6 +102,8 @@ class TMR_STLTriangle {
   The MPI TMROctant data type
 */
 extern MPI_Datatype TMROctant_MPI_type;
+extern MPI_Datatype TMROctantNode_MPI_type;
+extern MPI_Datatype TMROctantTag_MPI_type;
 extern MPI_Datatype TMRQuadrant_MPI_type;
 extern MPI_Datatype TMRPoint_MPI_type;
 extern MPI_Datatype TMRIndexWeight_MPI_type;
@@ -95,6 +114,100 @@ void TMRInitialize();
 int TMRIsInitialized();
 void TMRFinalize();
 
+// Exchange the message counts for a sparse all-to-all pattern
+void TMRExchangeCounts(MPI_Comm comm, const int *counts, int *recv_counts);
+
+/*
+  Phases of the forest and mesh operations that are profiled
+*/
+enum TMRProfilePhase {
+  TMR_PROFILE_BALANCE,
+  TMR_PROFILE_REPARTITION,
+  TMR_PROFILE_CREATE_NODES,
+  TMR_PROFILE_CREATE_INTERPOLATION,
+  TMR_PROFILE_MESH,
+  TMR_PROFILE_NUM_PHASES
+};
+
+/*
+  The profile data recorded for each phase on this processor
+
+  The data is only recorded when TMR is compiled with
+  TMR_USE_PROFILING defined. Otherwise the TMR_PROFILE_* macros are
+  empty and there is no run-time cost.
+*/
+class TMRProfileData {
+ public:
+  int num_calls;          // Number of calls to the phase
+  double time;            // Total wall time in the phase
+  long int num_messages;  // Number of point-to-point messages sent
+  long int num_bytes;     // Number of bytes sent or gathered
+  long int peak_size;     // Peak size of the hash tables and queues
+  long int num_octants;   // Number of local octants after the last call
+};
+
+// Record and retrieve the profile data
+void TMRBeginProfilePhase(TMRProfilePhase phase);
+void TMREndProfilePhase(TMRProfilePhase phase);
+void TMRAddProfileMessages(int num_messages, long int count,
+                           MPI_Datatype datatype);
+void TMRAddProfilePeakSize(long int size);
+void TMRSetProfileOctantCount(TMRProfilePhase phase, long int count);
+int TMRIsProfilingEnabled();
+int TMRGetProfileData(TMRProfilePhase phase, TMRProfileData *data);
+void TMRResetProfileData();
+
+#ifdef TMR_USE_PROFILING
+#define TMR_PROFILE_BEGIN(phase) TMRBeginProfilePhase(phase)
+#define TMR_PROFILE_END(phase) TMREndProfilePhase(phase)
+#define TMR_PROFILE_MESSAGES(num, count, datatype) \
+  TMRAddProfileMessages(num, count, datatype)
+#define TMR_PROFILE_PEAK_SIZE(size) TMRAddProfilePeakSize(size)
+#define TMR_PROFILE_OCTANTS(phase, count) \
+  TMRSetProfileOctantCount(phase, count)
+#else
+#define TMR_PROFILE_BEGIN(phase)
+#define TMR_PROFILE_END(phase)
+#define TMR_PROFILE_MESSAGES(num, count, datatype)
+#define TMR_PROFILE_PEAK_SIZE(size)
+#define TMR_PROFILE_OCTANTS(phase, count)
+#endif  // TMR_USE_PROFILING
+
+/*
+  The memory (in bytes) used by the internal data structures of a
+  forest, mesh or filter on this processor
+
+  The hash tables are freed before balance() and createNodes() return,
+  so the hash field is only non-zero for the high-water mark.
+*/
+class TMRMemoryUsage {
+ public:
+  TMRMemoryUsage() { zero(); }
+  void zero() {
+    octants = nodes = conn = dep_nodes = points = hash = other = 0;
+  }
+  void add(const TMRMemoryUsage *usage) {
+    octants += usage->octants;
+    nodes += usage->nodes;
+    conn += usage->conn;
+    dep_nodes += usage->dep_nodes;
+    points += usage->points;
+    hash += usage->hash;
+    other += usage->other;
+  }
+  long int getTotal() const {
+    return octants + nodes + conn + dep_nodes + points + hash + other;
+  }
+
+  long int octants;    // Octants/quadrants, owners and neighbor lists
+  long int nodes;      // Node numbers, node ranges and node octants
+  long int conn;       // Element connectivity
+  long int dep_nodes;  // Dependent node pointers, indices and weights
+  long int points;     // Node locations
+  long int hash;       // Hash tables used by balance() and createNodes()
+  long int other;      // Interpolation cache, name index and vectors
+};
+
 /*
   The following class is used to help create the interpolation and
   restriction operators. It stores both the node index and
@@ -109,8 +222,18 @@ class TMRIndexWeight {
   double weight;
 
   // Sort and uniquify a list of indices and weights
-  static int uniqueSort(TMRIndexWeight *array, int size) {
-    qsort(array, size, sizeof(TMRIndexWeight), TMRIndexWeight::compare_weights);
+  static inline int uniqueSort(TMRIndexWeight *array, int size) {
+    if (size <= 1) {
+      return size;
+    }
+
+    // Short rows are sorted in place and the duplicates are merged
+    // afterwards. Longer rows are first reduced to their unique
+    // entries with an open-addressed accumulator.
+    if (size > MAX_INSERTION_SORT_SIZE) {
+      size = accumulate(array, size);
+    }
+    sortIndices(array, size);
 
     // Now that the weights are sorted, remove duplicates by adding up
     // the weights
@@ -135,14 +258,122 @@ class TMRIndexWeight {
   }
 
  private:
-  // Compare two TMRIndexWeight objects - compare them based on
-  // their index value only.
-  static int compare_weights(const void *a, const void *b) {
-    const TMRIndexWeight *A = static_cast<const TMRIndexWeight *>(a);
-    const TMRIndexWeight *B = static_cast<const TMRIndexWeight *>(b);
+  // Rows with at most this many entries are insertion sorted directly
+  static const int MAX_INSERTION_SORT_SIZE = 32;
+
+  // Size of the accumulator table that is kept on the stack
+  static const int ACCUMULATE_STACK_SIZE = 512;
+
+  // Sort the entries by index: insertion sort for short arrays,
+  // heap sort otherwise
+  static inline void sortIndices(TMRIndexWeight *array, int size) {
+    if (size <= MAX_INSERTION_SORT_SIZE) {
+      for (int i = 1; i < size; i++) {
+        TMRIndexWeight t = array[i];
+        int j = i;
+        for (; j > 0 && array[j - 1].index > t.index; j--) {
+          array[j] = array[j - 1];
+        }
+        array[j] = t;
+      }
+      return;
+    }
+
+    // Build the max-heap, then repeatedly move the root to the end
+    for (int start = size / 2 - 1; start >= 0; start--) {
+      siftDown(array, start, size);
+    }
+    for (int end = size - 1; end > 0; end--) {
+      TMRIndexWeight t = array[0];
+      array[0] = array[end];
+      array[end] = t;
+      siftDown(array, 0, end);
+    }
+  }
 
-    return A->index - B->index;
+  // Restore the heap property for the sub-tree rooted at root
+  static inline void siftDown(TMRIndexWeight *array, int root, int end) {
+    TMRIndexWeight t = array[root];
+    int child = 2 * root + 1;
+    while (child < end) {
+      if (child + 1 < end && array[child + 1].index > array[child].index) {
+        child++;
+      }
+      if (array[child].index <= t.index) {
+        break;
+      }
+      array[root] = array[child];
+      root = child;
+      child = 2 * root + 1;
+    }
+    array[root] = t;
   }
+
+  // Sum the weights with the same index into the first occurrence and
+  // compact the unique entries to the front of the array. The table
+  // stores the position of each unique index within the array.
+  static inline int accumulate(TMRIndexWeight *array, int size) {
+    int table_size = 64;
+    while (table_size < 2 * size) {
+      table_size *= 2;
+    }
+    int stack_table[ACCUMULATE_STACK_SIZE];
+    int *table = stack_table;
+    if (table_size > ACCUMULATE_STACK_SIZE) {
+      table = new int[table_size];
+    }
+    memset(table, 0xff, table_size * sizeof(int));
+
+    const uint32_t mask = table_size - 1;
+    int nunique = 0;
+    for (int i = 0; i < size; i++) {
+      // Multiplicative hash of the index with linear probing
+      uint32_t slot = (uint32_t)array[i].index * 2654435761u;
+      slot = (slot ^ (slot >> 16)) & mask;
+      while (table[slot] >= 0 &&
+             array[table[slot]].index != array[i].index) {
+        slot = (slot + 1) & mask;
+      }
+
+      if (table[slot] >= 0) {
+        array[table[slot]].weight += array[i].weight;
+      } else {
+        // The entry at nunique <= i has already been processed
+        table[slot] = nunique;
+        array[nunique] = array[i];
+        nunique++;
+      }
+    }
+
+    if (table != stack_table) {
+      delete[] table;
+    }
+
+    return nunique;
+  }
+};
+
+/*
+  A table of shape functions tabulated at a fixed set of points
+
+  The forests keep a short list of these tables so that repeated
+  evaluations at the same quadrature or node points reduce to a
+  lookup. The shape functions for point i start at N[nbasis*i], and
+  the derivative along direction d starts at Nd[nbasis*(npts*d + i)].
+*/
+class TMRInterpTable {
+ public:
+  TMRInterpTable(int _dim, int _npts, const double _pts[], int _nbasis);
+  ~TMRInterpTable();
+
+  // Check whether this table was created for the given points
+  int matches(int _dim, int _npts, const double _pts[]);
+
+  int dim, npts, nbasis;
+  double *pts;  // The parametric points
+  double *N;    // The shape functions at each point
+  double *Nd;   // The derivatives of the shape functions
+  TMRInterpTable *next;
 };
 
 /*
@@ -187,4 +418,47 @@ class TMREntity {
   static int entity_id_count;
 };
 
+/*
+  A buffer in the shared memory of a compute node
+
+  Each processor owns one segment of an MPI-3 shared-memory window
+  that is allocated over the processors on the same node, and can
+  read the segments owned by the other processors on the node
+  directly. This is used to pass data between processors on the same
+  node without messages.
+
+  The segments are re-allocated when reserve() requests more space
+  than is available. Both reserve() and sync() are collective on the
+  processors of the node. When MPI-3 is not available, no processor
+  is on the node and reserve() returns NULL.
+*/
+class TMRNodeSharedBuffer : public TMREntity {
+ public:
+  TMRNodeSharedBuffer(MPI_Comm comm);
+  ~TMRNodeSharedBuffer();
+
+  // Get the number of processors on the node and the rank on the
+  // node of a processor in the communicator (-1 if not on the node)
+  int getNodeSize() { return node_size; }
+  int getNodeRank(int rank) { return (node_ranks ? node_ranks[rank] : -1); }
+
+  // Make each segment at least the given size in bytes and return
+  // the segment owned by this processor
+  char *reserve(size_t size);
+
+  // Get the segment owned by the given processor on the node
+  const char *getSegment(int node_rank) { return segments[node_rank]; }
+
+  // Make the writes to the segments visible on all the processors
+  void sync();
+
+ private:
+  MPI_Comm node_comm;
+  int node_rank, node_size;
+  int *node_ranks;
+  size_t seg_size;
+  MPI_Win win;
+  char **segments;
+};
+
 #endif  // TMR_BASE_H
@@ -105,6 +105,26 @@ int bspline_interval(double u, const double *T, int n, int k) {
   }
 }
 
+/*
+  Find the knot interval using a guess for the interval
+
+  The interval hint, and the interval that follows it, are checked
+  before performing the binary search. This is used when evaluating
+  points in sorted order. The result is always the same as the result
+  from bspline_interval.
+*/
+static inline int bspline_interval(double u, const double *T, int n, int k,
+                                   int hint) {
+  if (hint >= k - 1 && hint < n && u >= T[k - 1] && u < T[n]) {
+    if (u >= T[hint] && u < T[hint + 1]) {
+      return hint;
+    } else if (hint + 1 < n && u >= T[hint + 1] && u < T[hint + 2]) {
+      return hint + 1;
+    }
+  }
+  return bspline_interval(u, T, n, k);
+}
+
 /*
   Evaluate the B-spline basis functions
 
@@ -399,45 +419,61 @@ void TMRBsplineCurve::getRange(double *tmin, double *tmax) {
   Given the parametric point, evaluate the x,y,z location
 */
 int TMRBsplineCurve::evalPoint(double t, TMRPoint *X) {
+  return TMRBsplineCurve::evalPoints(1, &t, X);
+}
+
+/*
+  Evaluate the x,y,z locations at an array of parametric points.
+
+  The knot span search starts from the span of the previous point
+  and the basis is only re-evaluated when the parameter changes, so
+  sorted parameters are cheaper to evaluate.
+*/
+int TMRBsplineCurve::evalPoints(int n, const double *t, TMRPoint *X) {
   double Nu[MAX_BSPLINE_ORDER];
   double work[2 * MAX_BSPLINE_ORDER];
 
-  // Compute the knot span
-  int intu = bspline_interval(t, Tu, nctl, ku);
-
-  // Compute the basis functions
-  bspline_basis(Nu, intu, t, Tu, ku, work);
+  int span = -1;
+  double tlast = 0.0;
+  for (int p = 0; p < n; p++) {
+    // Compute the knot span and the basis functions
+    if (span < 0 || t[p] != tlast) {
+      span = bspline_interval(t[p], Tu, nctl, ku, span);
+      bspline_basis(Nu, span, t[p], Tu, ku, work);
+      tlast = t[p];
+    }
 
-  // Set the interval to the initial control point
-  intu = intu - ku + 1;
+    // Set the interval to the initial control point
+    int intu = span - ku + 1;
 
-  // Zero the point location
-  X->zero();
+    // Zero the point location
+    X[p].zero();
 
-  // If this is a NURBS curve add the effect of the weights
-  if (wts) {
-    // Evaluate the b-spline
-    double w = 0.0;
-    for (int i = 0; i < ku; i++) {
-      X->x += wts[intu + i] * Nu[i] * pts[intu + i].x;
-      X->y += wts[intu + i] * Nu[i] * pts[intu + i].y;
-      X->z += wts[intu + i] * Nu[i] * pts[intu + i].z;
-      w += Nu[i] * wts[intu + i];
-    }
+    // If this is a NURBS curve add the effect of the weights
+    if (wts) {
+      // Evaluate the b-spline
+      double w = 0.0;
+      for (int i = 0; i < ku; i++) {
+        X[p].x += wts[intu + i] * Nu[i] * pts[intu + i].x;
+        X[p].y += wts[intu + i] * Nu[i] * pts[intu + i].y;
+        X[p].z += wts[intu + i] * Nu[i] * pts[intu + i].z;
+        w += Nu[i] * wts[intu + i];
+      }
 
-    // Divide through by the weights
-    if (w != 0.0) {
-      w = 1.0 / w;
-      X->x *= w;
-      X->y *= w;
-      X->z *= w;
-    }
-  } else {
-    // Evaluate the b-spline
-    for (int i = 0; i < ku; i++) {
-      X->x += Nu[i] * pts[intu + i].x;
-      X->y += Nu[i] * pts[intu + i].y;
-      X->z += Nu[i] * pts[intu + i].z;
+      // Divide through by the weights
+      if (w != 0.0) {
+        w = 1.0 / w;
+        X[p].x *= w;
+        X[p].y *= w;
+        X[p].z *= w;
+      }
+    } else {
+      // Evaluate the b-spline
+      for (int i = 0; i < ku; i++) {
+        X[p].x += Nu[i] * pts[intu + i].x;
+        X[p].y += Nu[i] * pts[intu + i].y;
+        X[p].z += Nu[i] * pts[intu + i].z;
+      }
     }
   }
 
@@ -1150,48 +1186,67 @@ void TMRBsplinePcurve::getRange(double *tmin, double *tmax) {
   Given the parametric point, evaluate the x,y,z location
 */
 int TMRBsplinePcurve::evalPoint(double t, double *_u, double *_v) {
+  double prm[2];
+  int fail = TMRBsplinePcurve::evalPoints(1, &t, prm);
+  *_u = prm[0];
+  *_v = prm[1];
+  return fail;
+}
+
+/*
+  Evaluate the parametric locations at an array of points
+
+  The knot span search starts from the span of the previous point
+  and the basis is only re-evaluated when the parameter changes.
+*/
+int TMRBsplinePcurve::evalPoints(int n, const double *t, double *prm) {
   double Nu[MAX_BSPLINE_ORDER];
   double work[2 * MAX_BSPLINE_ORDER];
 
-  // Compute the knot span
-  int intu = bspline_interval(t, Tu, nctl, ku);
+  int span = -1;
+  double tlast = 0.0;
+  for (int p = 0; p < n; p++) {
+    // Compute the knot span and the basis functions
+    if (span < 0 || t[p] != tlast) {
+      span = bspline_interval(t[p], Tu, nctl, ku, span);
+      bspline_basis(Nu, span, t[p], Tu, ku, work);
+      tlast = t[p];
+    }
 
-  // Compute the basis functions
-  bspline_basis(Nu, intu, t, Tu, ku, work);
+    // Set the interval to the initial control point
+    int intu = span - ku + 1;
 
-  // Set the interval to the initial control point
-  intu = intu - ku + 1;
+    // Zero the point location
+    double u = 0.0, v = 0.0;
 
-  // Zero the point location
-  double u = 0.0, v = 0.0;
+    // If this is a NURBS curve add the effect of the weights
+    if (wts) {
+      // Evaluate the b-spline
+      double w = 0.0;
+      for (int i = 0; i < ku; i++) {
+        u += wts[intu + i] * Nu[i] * pts[2 * (intu + i)];
+        v += wts[intu + i] * Nu[i] * pts[2 * (intu + i) + 1];
+        w += Nu[i] * wts[intu + i];
+      }
 
-  // If this is a NURBS curve add the effect of the weights
-  if (wts) {
-    // Evaluate the b-spline
-    double w = 0.0;
-    for (int i = 0; i < ku; i++) {
-      u += wts[intu + i] * Nu[i] * pts[2 * (intu + i)];
-      v += wts[intu + i] * Nu[i] * pts[2 * (intu + i) + 1];
-      w += Nu[i] * wts[intu + i];
+      // Divide through by the weights
+      if (w != 0.0) {
+        w = 1.0 / w;
+        u *= w;
+        v *= w;
+      }
+    } else {
+      // Evaluate the b-spline
+      for (int i = 0; i < ku; i++) {
+        u += Nu[i] * pts[2 * (intu + i)];
+        v += Nu[i] * pts[2 * (intu + i) + 1];
+      }
     }
 
-    // Divide through by the weights
-    if (w != 0.0) {
-      w = 1.0 / w;
-      u *= w;
-      v *= w;
-    }
-  } else {
-    // Evaluate the b-spline
-    for (int i = 0; i < ku; i++) {
-      u += Nu[i] * pts[2 * (intu + i)];
-      v += Nu[i] * pts[2 * (intu + i) + 1];
-    }
+    prm[2 * p] = u;
+    prm[2 * p + 1] = v;
   }
 
-  *_u = u;
-  *_v = v;
-
   // Success - we didn't fail
   return 0;
 }
@@ -1500,6 +1555,14 @@ TMRBsplineSurface::TMRBsplineSurface(int _nu, int _nv, int _ku, int _kv,
   // Allocate the points array
   pts = new TMRPoint[nu * nv];
   memcpy(pts, _pts, nu * nv * sizeof(TMRPoint));
+
+  // The inverse evaluation tree is created when first needed
+  inv_nupts = inv_nvpts = 0;
+  inv_pts = NULL;
+  num_inv_nodes = 0;
+  inv_nodes = NULL;
+  inv_bounds = NULL;
+  pthread_mutex_init(&inv_mutex, NULL);
 }
 
 /*
@@ -1548,6 +1611,14 @@ TMRBsplineSurface::TMRBsplineSurface(int _nu, int _nv, int _ku, int _kv,
   // Allocate the points array
   pts = new TMRPoint[nu * nv];
   memcpy(pts, _pts, nu * nv * sizeof(TMRPoint));
+
+  // The inverse evaluation tree is created when first needed
+  inv_nupts = inv_nvpts = 0;
+  inv_pts = NULL;
+  num_inv_nodes = 0;
+  inv_nodes = NULL;
+  inv_bounds = NULL;
+  pthread_mutex_init(&inv_mutex, NULL);
 }
 
 TMRBsplineSurface::TMRBsplineSurface(int _nu, int _nv, int _ku, int _kv,
@@ -1594,6 +1665,14 @@ TMRBsplineSurface::TMRBsplineSurface(int _nu, int _nv, int _ku, int _kv,
   // Allocate the points array
   pts = new TMRPoint[nu * nv];
   memcpy(pts, _pts, nu * nv * sizeof(TMRPoint));
+
+  // The inverse evaluation tree is created when first needed
+  inv_nupts = inv_nvpts = 0;
+  inv_pts = NULL;
+  num_inv_nodes = 0;
+  inv_nodes = NULL;
+  inv_bounds = NULL;
+  pthread_mutex_init(&inv_mutex, NULL);
 }
 
 /*
@@ -1606,6 +1685,12 @@ TMRBsplineSurface::~TMRBsplineSurface() {
     delete[] wts;
   }
   delete[] pts;
+  if (inv_nodes) {
+    delete[] inv_pts;
+    delete[] inv_nodes;
+    delete[] inv_bounds;
+  }
+  pthread_mutex_destroy(&inv_mutex);
 }
 
 /*
@@ -1628,54 +1713,81 @@ void TMRBsplineSurface::getRange(double *umin, double *vmin, double *umax,
   Given the parametric point, compute the x,y,z location
 */
 int TMRBsplineSurface::evalPoint(double u, double v, TMRPoint *X) {
+  double prm[2];
+  prm[0] = u;
+  prm[1] = v;
+  return TMRBsplineSurface::evalPoints(1, prm, X);
+}
+
+/*
+  Evaluate the x,y,z locations at an array of parametric points
+
+  The knot span searches start from the spans of the previous point,
+  and the basis functions in each direction are only re-evaluated when
+  that parameter changes. Points ordered along rows or columns of the
+  parameter space share their spans and one set of basis functions.
+*/
+int TMRBsplineSurface::evalPoints(int n, const double *prm, TMRPoint *X) {
   // The basis functions/work arrays
   double Nu[MAX_BSPLINE_ORDER], Nv[MAX_BSPLINE_ORDER];
   double work[2 * MAX_BSPLINE_ORDER];
 
-  // Compute the knot intervals
-  int intu = bspline_interval(u, Tu, nu, ku);
-  int intv = bspline_interval(v, Tv, nv, kv);
+  int spanu = -1, spanv = -1;
+  double ulast = 0.0, vlast = 0.0;
+  for (int p = 0; p < n; p++) {
+    double u = prm[2 * p];
+    double v = prm[2 * p + 1];
 
-  // Evaluate the basis functions
-  bspline_basis(Nu, intu, u, Tu, ku, work);
-  bspline_basis(Nv, intv, v, Tv, kv, work);
+    // Compute the knot intervals and evaluate the basis functions
+    if (spanu < 0 || u != ulast) {
+      spanu = bspline_interval(u, Tu, nu, ku, spanu);
+      bspline_basis(Nu, spanu, u, Tu, ku, work);
+      ulast = u;
+    }
+    if (spanv < 0 || v != vlast) {
+      spanv = bspline_interval(v, Tv, nv, kv, spanv);
+      bspline_basis(Nv, spanv, v, Tv, kv, work);
+      vlast = v;
+    }
 
-  // Set the interval to the initial control point
-  intu = intu - ku + 1;
-  intv = intv - kv + 1;
+    // Set the interval to the initial control point
+    int intu = spanu - ku + 1;
+    int intv = spanv - kv + 1;
 
-  // Zero the point location
-  X->zero();
+    // Zero the point location
+    TMRPoint *Xp = &X[p];
+    Xp->zero();
 
-  // If this is a NURBS surface add the effect of the weights
-  if (wts) {
-    // Evaluate the b-spline
-    double w = 0.0;
-    for (int j = 0; j < kv; j++) {
-      for (int i = 0; i < ku; i++) {
-        int index = intu + i + (intv + j) * nu;
-        X->x += wts[index] * Nu[i] * Nv[j] * pts[index].x;
-        X->y += wts[index] * Nu[i] * Nv[j] * pts[index].y;
-        X->z += wts[index] * Nu[i] * Nv[j] * pts[index].z;
-        w += wts[index] * Nu[i] * Nv[j];
+    // If this is a NURBS surface add the effect of the weights
+    if (wts) {
+      // Evaluate the b-spline
+      double w = 0.0;
+      for (int j = 0; j < kv; j++) {
+        for (int i = 0; i < ku; i++) {
+          int index = intu + i + (intv + j) * nu;
+          Xp->x += wts[index] * Nu[i] * Nv[j] * pts[index].x;
+          Xp->y += wts[index] * Nu[i] * Nv[j] * pts[index].y;
+          Xp->z += wts[index] * Nu[i] * Nv[j] * pts[index].z;
+          w += wts[index] * Nu[i] * Nv[j];
+        }
       }
-    }
 
-    // Divide through by the weights
-    if (w != 0.0) {
-      w = 1.0 / w;
-      X->x *= w;
-      X->y *= w;
-      X->z *= w;
-    }
-  } else {
-    // Evaluate the b-spline
-    for (int j = 0; j < kv; j++) {
-      for (int i = 0; i < ku; i++) {
-        int index = intu + i + (intv + j) * nu;
-        X->x += Nu[i] * Nv[j] * pts[index].x;
-        X->y += Nu[i] * Nv[j] * pts[index].y;
-        X->z += Nu[i] * Nv[j] * pts[index].z;
+      // Divide through by the weights
+      if (w != 0.0) {
+        w = 1.0 / w;
+        Xp->x *= w;
+        Xp->y *= w;
+        Xp->z *= w;
+      }
+    } else {
+      // Evaluate the b-spline
+      for (int j = 0; j < kv; j++) {
+        for (int i = 0; i < ku; i++) {
+          int index = intu + i + (intv + j) * nu;
+          Xp->x += Nu[i] * Nv[j] * pts[index].x;
+          Xp->y += Nu[i] * Nv[j] * pts[index].y;
+          Xp->z += Nu[i] * Nv[j] * pts[index].z;
+        }
       }
     }
   }
@@ -1684,10 +1796,277 @@ int TMRBsplineSurface::evalPoint(double u, double v, TMRPoint *X) {
   return 0;
 }
 
+/*
+  The maximum number of samples in a leaf of the inverse evaluation
+  tree
+*/
+static const int INV_EVAL_LEAF_SIZE = 16;
+
+/*
+  Compute the squared distance between a point and a bounding box
+*/
+static inline double bounds_distance(const TMRPoint *lo, const TMRPoint *hi,
+                                     const TMRPoint *p) {
+  double d = 0.0;
+  if (p->x < lo->x) {
+    d += (lo->x - p->x) * (lo->x - p->x);
+  } else if (p->x > hi->x) {
+    d += (p->x - hi->x) * (p->x - hi->x);
+  }
+  if (p->y < lo->y) {
+    d += (lo->y - p->y) * (lo->y - p->y);
+  } else if (p->y > hi->y) {
+    d += (p->y - hi->y) * (p->y - hi->y);
+  }
+  if (p->z < lo->z) {
+    d += (lo->z - p->z) * (lo->z - p->z);
+  } else if (p->z > hi->z) {
+    d += (p->z - hi->z) * (p->z - hi->z);
+  }
+  return d;
+}
+
+/*
+  Create the sample points used to find the starting point for the
+  inverse evaluation.
+
+  The surface is sampled on a uniform (2*nu + 1) x (2*nv + 1) grid in
+  parameter space. The grid is recursively split in half along its
+  longer index direction, and the bounds of the samples within each
+  range are stored so that the closest sample can be found without
+  checking every sample. The tree is created once, on the first call,
+  and may be created from multiple threads.
+*/
+void TMRBsplineSurface::initInvEvalTree() {
+  if (__atomic_load_n(&inv_nodes, __ATOMIC_ACQUIRE)) {
+    return;
+  }
+
+  pthread_mutex_lock(&inv_mutex);
+  if (!inv_nodes) {
+    double umin, vmin, umax, vmax;
+    getRange(&umin, &vmin, &umax, &vmax);
+
+    // Evaluate the surface at the sample points
+    inv_nupts = 2 * nu + 1;
+    inv_nvpts = 2 * nv + 1;
+    inv_pts = new TMRPoint[inv_nupts * inv_nvpts];
+    double *row = new double[2 * inv_nupts];
+    for (int jj = 0; jj < inv_nvpts; jj++) {
+      for (int ii = 0; ii < inv_nupts; ii++) {
+        row[2 * ii] = umin + (1.0 * ii / (inv_nupts - 1)) * (umax - umin);
+        row[2 * ii + 1] = vmin + (1.0 * jj / (inv_nvpts - 1)) * (vmax - vmin);
+      }
+      TMRBsplineSurface::evalPoints(inv_nupts, row,
+                                    &inv_pts[jj * inv_nupts]);
+    }
+    delete[] row;
+
+    // Each split creates two nodes and there is at least one sample
+    // in each leaf
+    int max_num_nodes = 2 * inv_nupts * inv_nvpts;
+    int *nodes = new int[5 * max_num_nodes];
+    inv_bounds = new TMRPoint[2 * max_num_nodes];
+
+    // Set the root and build the tree
+    nodes[0] = 0;
+    nodes[1] = inv_nupts;
+    nodes[2] = 0;
+    nodes[3] = inv_nvpts;
+    num_inv_nodes = 1;
+    buildInvEvalTree(nodes, 0);
+
+    // Make the tree visible to other threads only once it is complete
+    __atomic_store_n(&inv_nodes, nodes, __ATOMIC_RELEASE);
+  }
+  pthread_mutex_unlock(&inv_mutex);
+}
+
+/*
+  Compute the bounds of the samples in the given node and split the
+  node if it contains too many samples
+*/
+void TMRBsplineSurface::buildInvEvalTree(int *nodes, int node) {
+  int i0 = nodes[5 * node];
+  int i1 = nodes[5 * node + 1];
+  int j0 = nodes[5 * node + 2];
+  int j1 = nodes[5 * node + 3];
+
+  // Compute the bounds of the samples
+  TMRPoint lo = inv_pts[i0 + j0 * inv_nupts];
+  TMRPoint hi = lo;
+  for (int jj = j0; jj < j1; jj++) {
+    for (int ii = i0; ii < i1; ii++) {
+      const TMRPoint *X = &inv_pts[ii + jj * inv_nupts];
+      if (X->x < lo.x) {
+        lo.x = X->x;
+      }
+      if (X->x > hi.x) {
+        hi.x = X->x;
+      }
+      if (X->y < lo.y) {
+        lo.y = X->y;
+      }
+      if (X->y > hi.y) {
+        hi.y = X->y;
+      }
+      if (X->z < lo.z) {
+        lo.z = X->z;
+      }
+      if (X->z > hi.z) {
+        hi.z = X->z;
+      }
+    }
+  }
+  inv_bounds[2 * node] = lo;
+  inv_bounds[2 * node + 1] = hi;
+
+  if ((i1 - i0) * (j1 - j0) <= INV_EVAL_LEAF_SIZE) {
+    nodes[5 * node + 4] = -1;
+    return;
+  }
+
+  // Split the samples in half along the longer index direction
+  int left = num_inv_nodes;
+  num_inv_nodes += 2;
+  nodes[5 * node + 4] = left;
+
+  int *l = &nodes[5 * left];
+  int *r = &nodes[5 * (left + 1)];
+  if (i1 - i0 >= j1 - j0) {
+    int im = (i0 + i1) / 2;
+    l[0] = i0;
+    l[1] = im;
+    r[0] = im;
+    r[1] = i1;
+    l[2] = r[2] = j0;
+    l[3] = r[3] = j1;
+  } else {
+    int jm = (j0 + j1) / 2;
+    l[0] = r[0] = i0;
+    l[1] = r[1] = i1;
+    l[2] = j0;
+    l[3] = jm;
+    r[2] = jm;
+    r[3] = j1;
+  }
+
+  buildInvEvalTree(nodes, left);
+  buildInvEvalTree(nodes, left + 1);
+}
+
+/*
+  Find the sample closest to the point within the given node.
+
+  Ties are broken in favor of the lowest sample index so that the
+  result matches a search over all the samples in order.
+*/
+void TMRBsplineSurface::findClosestSample(int node, TMRPoint p, int *index,
+                                          double *dist) {
+  const int *n = &inv_nodes[5 * node];
+  if (n[4] < 0) {
+    for (int jj = n[2]; jj < n[3]; jj++) {
+      for (int ii = n[0]; ii < n[1]; ii++) {
+        int k = ii + jj * inv_nupts;
+        TMRPoint d;
+        d.x = p.x - inv_pts[k].x;
+        d.y = p.y - inv_pts[k].y;
+        d.z = p.z - inv_pts[k].z;
+        double t = d.dot(d);
+        if (t < *dist || (t == *dist && k < *index)) {
+          *dist = t;
+          *index = k;
+        }
+      }
+    }
+  } else {
+    // Search the closer child first
+    int left = n[4];
+    int right = left + 1;
+    double dl = bounds_distance(&inv_bounds[2 * left],
+                                &inv_bounds[2 * left + 1], &p);
+    double dr = bounds_distance(&inv_bounds[2 * right],
+                                &inv_bounds[2 * right + 1], &p);
+    if (dr < dl) {
+      int tmp = left;
+      left = right;
+      right = tmp;
+      double t = dl;
+      dl = dr;
+      dr = t;
+    }
+    if (dl <= *dist) {
+      findClosestSample(left, p, index, dist);
+    }
+    if (dr <= *dist) {
+      findClosestSample(right, p, index, dist);
+    }
+  }
+}
+
 /*
   Perform the inverse evaluation
+
+  The newton iteration starts from the closest point on a uniform grid
+  of samples over the surface.
 */
 int TMRBsplineSurface::invEvalPoint(TMRPoint point, double *uf, double *vf) {
+  initInvEvalTree();
+
+  // Find the closest sample point
+  int index = -1;
+  double dist = 1e40;
+  findClosestSample(0, point, &index, &dist);
+
+  double u = 0.0, v = 0.0;
+  if (index >= 0) {
+    double umin, vmin, umax, vmax;
+    getRange(&umin, &vmin, &umax, &vmax);
+    int ii = index % inv_nupts;
+    int jj = index / inv_nupts;
+    u = umin + (1.0 * ii / (inv_nupts - 1)) * (umax - umin);
+    v = vmin + (1.0 * jj / (inv_nvpts - 1)) * (vmax - vmin);
+  }
+
+  return invEvalNewton(point, u, v, uf, vf);
+}
+
+/*
+  Perform the inverse evaluation starting from the guess (u0, v0).
+
+  If the newton iteration from the guess fails, the inverse evaluation
+  is repeated from the closest sample point.
+*/
+int TMRBsplineSurface::invEvalPoint(TMRPoint point, double u0, double v0,
+                                    double *uf, double *vf) {
+  double umin, vmin, umax, vmax;
+  getRange(&umin, &vmin, &umax, &vmax);
+
+  // Truncate the guess to the bounds
+  if (u0 < umin) {
+    u0 = umin;
+  } else if (u0 > umax) {
+    u0 = umax;
+  }
+  if (v0 < vmin) {
+    v0 = vmin;
+  } else if (v0 > vmax) {
+    v0 = vmax;
+  }
+
+  if (invEvalNewton(point, u0, v0, uf, vf) == 0) {
+    return 0;
+  }
+
+  return invEvalPoint(point, uf, vf);
+}
+
+/*
+  Perform the newton iteration for the inverse evaluation starting
+  from the point (u, v)
+*/
+int TMRBsplineSurface::invEvalNewton(TMRPoint point, double u, double v,
+                                     double *uf, double *vf) {
   // Did this evaluation fail or not?
   int fail = 1;
 
@@ -1701,87 +2080,6 @@ int TMRBsplineSurface::invEvalPoint(TMRPoint point, double *uf, double *vf) {
   // Get the bounds
   double umin, vmin, umax, vmax;
   getRange(&umin, &vmin, &umax, &vmax);
-  double u = 0.0, v = 0.0;
-  double ubest = 0.0, vbest = 0.0;
-
-  // Set the number of trial points to use in the brute force method
-  // along each direction.
-  int nupts = 2 * nu + 1;
-  int nvpts = 2 * nv + 1;
-
-  // Using brute force, find the point that is closest to the input
-  // point by evaluating the surface at a series of locations.
-  double dist = 1e40;
-  for (int jj = 0; jj < nvpts; jj++) {
-    for (int ii = 0; ii < nupts; ii++) {
-      u = umin + (1.0 * ii / (nupts - 1)) * (umax - umin);
-      v = vmin + (1.0 * jj / (nvpts - 1)) * (vmax - vmin);
-      int intu = bspline_interval(u, Tu, nu, ku);
-      int intv = bspline_interval(v, Tv, nv, kv);
-
-      // Evaluate the basis functions
-      bspline_basis(Nu, intu, u, Tu, ku, work);
-      bspline_basis(Nv, intv, v, Tv, kv, work);
-
-      // Set the interval to the initial control point
-      intu = intu - ku + 1;
-      intv = intv - kv + 1;
-
-      // Evaluate the point
-      TMRPoint X;
-      X.zero();
-
-      // If this is a NURBS surface add the effect of the weights
-      if (wts) {
-        // Evaluate the b-spline
-        double w = 0.0;
-        for (int j = 0; j < kv; j++) {
-          for (int i = 0; i < ku; i++) {
-            int index = intu + i + (intv + j) * nu;
-            X.x += wts[index] * Nu[i] * Nv[j] * pts[index].x;
-            X.y += wts[index] * Nu[i] * Nv[j] * pts[index].y;
-            X.z += wts[index] * Nu[i] * Nv[j] * pts[index].z;
-            w += wts[index] * Nu[i] * Nv[j];
-          }
-        }
-
-        // Divide through by the weights
-        if (w != 0.0) {
-          w = 1.0 / w;
-          X.x *= w;
-          X.y *= w;
-          X.z *= w;
-        }
-      } else {
-        // Evaluate the b-spline
-        for (int j = 0; j < kv; j++) {
-          for (int i = 0; i < ku; i++) {
-            int index = intu + i + (intv + j) * nu;
-            X.x += Nu[i] * Nv[j] * pts[index].x;
-            X.y += Nu[i] * Nv[j] * pts[index].y;
-            X.z += Nu[i] * Nv[j] * pts[index].z;
-          }
-        }
-      }
-
-      // Find the distance vector
-      X.x = point.x - X.x;
-      X.y = point.y - X.y;
-      X.z = point.z - X.z;
-
-      // Check whether the distance is closer
-      double d = X.dot(X);
-      if (d < dist) {
-        dist = d;
-        ubest = u;
-        vbest = v;
-      }
-    }
-  }
-
-  // Set the new closest point
-  u = ubest;
-  v = vbest;
 
   // Perform a newton iteration until convergence
   for (int k = 0; k < max_newton_iters; k++) {
@@ -2369,13 +2667,15 @@ TMRBsplineCurve *TMRCurveInterpolation::createCurve(int ku) {
     memset(rhs, 0, 3 * nctl * sizeof(double));
 
     // Set the values into the A matrix
+    int span = -1;
     for (int p = 0; p < ninterp; p++) {
       // Evaluate the B-spline basis functions
       double Nu[MAX_BSPLINE_ORDER];
       double work[2 * MAX_BSPLINE_ORDER];
 
-      // Compute the b-spline interval
-      int intu = bspline_interval(ubar[p], Tu, nctl, ku);
+      // Compute the b-spline interval from the sorted parameters
+      int intu = bspline_interval(ubar[p], Tu, nctl, ku, span);
+      span = intu;
 
       // Compute the b-spline basis
       bspline_basis(Nu, intu, ubar[p], Tu, ku, work);
@@ -2485,13 +2785,15 @@ TMRBsplineCurve *TMRCurveInterpolation::createCurve(int ku) {
     memset(A, 0, lda * nctl * sizeof(double));
 
     // Set the values into the A matrix
+    int span = -1;
     for (int i = 0; i < nctl; i++) {
       // Evaluate the B-spline basis functions
       double Nu[MAX_BSPLINE_ORDER];
       double work[2 * MAX_BSPLINE_ORDER];
 
-      // Compute the b-spline interval
-      int intu = bspline_interval(ubar[i], Tu, nctl, ku);
+      // Compute the b-spline interval from the sorted parameters
+      int intu = bspline_interval(ubar[i], Tu, nctl, ku, span);
+      span = intu;
 
       // Compute the b-spline basis
       bspline_basis(Nu, intu, ubar[i], Tu, ku, work);
@@ -21,6 +21,8 @@
 #ifndef TMR_BSPLINE_H
 #define TMR_BSPLINE_H
 
+#include <pthread.h>
+
 #include "TMRGeometry.h"
 
 /*
@@ -45,6 +47,9 @@ class TMRBsplineCurve : public TMRCurve {
   // Given the parametric point, evaluate the x,y,z location
   int evalPoint(double t, TMRPoint *X);
 
+  // Evaluate an array of points, preferably in sorted order
+  int evalPoints(int n, const double *t, TMRPoint *X);
+
   // Given the x,y,z location, find the parametric coordinates
   int invEvalPoint(TMRPoint X, double *t);
 
@@ -116,9 +121,15 @@ class TMRBsplineSurface : public TMRSurface {
   // Given the parametric point, compute the x,y,z location
   int evalPoint(double u, double v, TMRPoint *X);
 
+  // Evaluate an array of points, preferably in sorted order
+  int evalPoints(int n, const double *prm, TMRPoint *X);
+
   // Perform the inverse evaluation
   int invEvalPoint(TMRPoint p, double *u, double *v);
 
+  // Perform the inverse evaluation starting from the guess (u0, v0)
+  int invEvalPoint(TMRPoint p, double u0, double v0, double *u, double *v);
+
   // Given the parametric point, evaluate the first derivative
   int evalDeriv(double u, double v, TMRPoint *X, TMRPoint *Xu, TMRPoint *Xv);
 
@@ -168,6 +179,25 @@ class TMRBsplineSurface : public TMRSurface {
   // The weighs (when it is a NURBS curve)
   double *wts;
 
+  // Perform the newton iteration for the inverse evaluation
+  int invEvalNewton(TMRPoint p, double u, double v, double *uf, double *vf);
+
+  // Create the sample points and bounding-box tree used to find the
+  // starting point for the inverse evaluation
+  void initInvEvalTree();
+  void buildInvEvalTree(int *nodes, int node);
+  void findClosestSample(int node, TMRPoint p, int *index, double *dist);
+
+  // The samples and tree are created on the first inverse evaluation.
+  // Each tree node stores a range of samples (i0, i1, j0, j1), the
+  // index of its first child and the bounds of its samples.
+  int inv_nupts, inv_nvpts;
+  TMRPoint *inv_pts;
+  int num_inv_nodes;
+  int *inv_nodes;
+  TMRPoint *inv_bounds;
+  pthread_mutex_t inv_mutex;
+
   // Maximum number of newton iterations for the B-spline inverse
   // point code
   static int max_newton_iters;
@@ -193,6 +223,9 @@ class TMRBsplinePcurve : public TMRPcurve {
   // Given the parametric point, evaluate the x,y,z location
   int evalPoint(double t, double *u, double *v);
 
+  // Evaluate an array of points, preferably in sorted order
+  int evalPoints(int n, const double *t, double *prm);
+
   // Given the parametric point, evaluate the derivative
   int evalDeriv(double t, double *u, double *v, double *ut, double *vt);
 
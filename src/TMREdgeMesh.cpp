@@ -22,16 +22,7 @@
 
 #include <math.h>
 #include <stdio.h>
-
-/*
-  An integral entry for the linked list
-*/
-class IntegralPt {
- public:
-  double t;
-  double dist;
-  IntegralPt *next;
-};
+#include <string.h>
 
 /*
   Evaluate the distance between two points
@@ -42,120 +33,161 @@ double pointDist(TMRPoint *a, TMRPoint *b) {
 }
 
 /*
-  Recursive integration on an edge with an adaptive error control to
-  ensure that the integral is computed with sufficient accuracy.
+  An interval on the stack used in the adaptive integration
+*/
+class IntegralInterval {
+ public:
+  double t1, t2;
+  double h1, h2;
+  TMRPoint p1, p2;
+  int depth;
+};
 
-  input:
-  t1, t2:  the limits of integration for this interval
-  tol:     the absolute error measure
-  ncalls:  the recursion depth
-  pt:      pointer into the linked list
+/*
+  Append a parametric point and its integral to the output arrays
 */
-void integrateEdge(TMREdge *edge, TMRElementFeatureSize *fs, double t1,
-                   double h1, TMRPoint p1, double t2, double tol, int ncalls,
-                   IntegralPt **_pt) {
-  // Dereference the pointer to the integral point
-  IntegralPt *pt = *_pt;
-
-  // Find the mid point of the interval
-  TMRPoint pmid;
-  double tmid = 0.5 * (t1 + t2);
-  edge->evalPoint(tmid, &pmid);
-  double hmid = fs->getFeatureSize(pmid);
-
-  // Evaluate the point at the end of the interval
-  TMRPoint p2;
-  edge->evalPoint(t2, &p2);
-  double h2 = fs->getFeatureSize(p2);
-
-  // Evaluate the approximate integral contributions
-  double int1 = 2.0 * pointDist(&p1, &pmid) / (h1 + hmid);
-  double int2 = 4.0 * pointDist(&pmid, &p2) / (h1 + 2.0 * hmid + h2);
-  double int3 = 2.0 * pointDist(&p1, &p2) / (hmid + h2);
-
-  // Compute the integration error
-  double error = fabs(int3 - int1 - int2);
-
-  if (((ncalls > 6) && (error < tol)) || (ncalls > 20)) {
-    // Add the mid point
-    pt->next = new IntegralPt;
-    pt->next->dist = pt->dist + int1;
-    pt->next->t = tmid;
-    pt->next->next = NULL;
-    pt = pt->next;
-
-    // Add the final point p2
-    pt->next = new IntegralPt;
-    pt->next->dist = pt->dist + int2;
-    pt->next->t = t2;
-    pt->next->next = NULL;
-    pt = pt->next;
-
-    // Set the pointer to the end of the linked list
-    *_pt = pt;
-  } else {
-    // Continue the recursive integration
-    integrateEdge(edge, fs, t1, h1, p1, tmid, tol, ncalls + 1, _pt);
-    integrateEdge(edge, fs, tmid, hmid, pmid, t2, tol, ncalls + 1, _pt);
+static void addIntegralPt(double t, double d, int *count, int *max_count,
+                          double **tvals, double **dist) {
+  if (*count >= *max_count) {
+    *max_count *= 2;
+    double *tmp = new double[*max_count];
+    memcpy(tmp, *tvals, *count * sizeof(double));
+    delete[] *tvals;
+    *tvals = tmp;
+
+    tmp = new double[*max_count];
+    memcpy(tmp, *dist, *count * sizeof(double));
+    delete[] *dist;
+    *dist = tmp;
   }
+  (*tvals)[*count] = t;
+  (*dist)[*count] = d;
+  (*count)++;
 }
 
 /*
-  Integrate along the edge adaptively, creating a list
+  Integrate along the edge adaptively, creating a list of parametric
+  points and the integral of the inverse of the feature size
+
+  Each interval is split into two halves with Simpson's rule until the
+  error is less than the absolute tolerance. The intervals are always
+  split down to a minimum depth, so the points on this uniform
+  partition and their midpoints are evaluated first in batches. The
+  remaining intervals are processed in order from an explicit stack,
+  so that the end points of each interval are re-used and only the
+  midpoint is evaluated.
+
+  input:
+  t1, t2:  the limits of integration
+  tol:     the absolute error measure
+
+  output:
+  tvals:   the parametric locations
+  dist:    the integral up to each parametric location
+  nvals:   the number of values
 */
 double integrateEdge(TMREdge *edge, TMRElementFeatureSize *fs, double t1,
                      double t2, double tol, double **_tvals, double **_dist,
                      int *_nvals) {
-  *_tvals = NULL;
-  *_dist = NULL;
-  *_nvals = 0;
-
-  // Allocate the entry in the linked list
-  IntegralPt *root = new IntegralPt;
-  root->next = NULL;
-  root->dist = 0.0;
-  root->t = t1;
-
-  // Evaluate the first point
-  TMRPoint p1;
-  edge->evalPoint(t1, &p1);
-  double h1 = fs->getFeatureSize(p1);
-
-  // Integrate over the edge
-  IntegralPt *pt = root;
-  integrateEdge(edge, fs, t1, h1, p1, t2, tol, 0, &pt);
-
-  // Count up and allocate the num
-  int count = 1;
-  IntegralPt *curr = root;
-  while (curr->next) {
-    curr = curr->next;
-    count++;
+  // The depths before/after which the error is not checked
+  const int min_depth = 7;
+  const int max_depth = 21;
+
+  // Compute the uniform partition at the minimum depth and the
+  // midpoints of its intervals by recursive bisection
+  const int nparts = 1 << (min_depth + 1);
+  double *t = new double[nparts + 1];
+  t[0] = t1;
+  t[nparts] = t2;
+  for (int step = nparts; step > 1; step /= 2) {
+    for (int i = 0; i < nparts; i += step) {
+      t[i + step / 2] = 0.5 * (t[i] + t[i + step]);
+    }
   }
 
-  // Allocate arrays to store the parametric location/distance data
-  double *tvals = new double[count];
-  double *dist = new double[count];
-
-  // Scan through the linked list, read out the values of the
-  // parameter and its integral and delete the entries as we go...
-  count = 0;
-  curr = root;
-  tvals[count] = curr->t;
-  dist[count] = curr->dist;
-  count++;
-
-  while (curr->next) {
-    IntegralPt *tmp = curr;
-    curr = curr->next;
-    tvals[count] = curr->t;
-    dist[count] = curr->dist;
-    count++;
-    delete tmp;
+  // Evaluate the points and the feature sizes
+  TMRPoint *p = new TMRPoint[nparts + 1];
+  double *h = new double[nparts + 1];
+  edge->evalPoints(nparts + 1, t, p);
+  fs->getFeatureSizes(nparts + 1, p, h);
+
+  // Allocate the output arrays
+  int count = 0;
+  int max_count = nparts + 1;
+  double *tvals = new double[max_count];
+  double *dist = new double[max_count];
+  addIntegralPt(t1, 0.0, &count, &max_count, &tvals, &dist);
+
+  // The stack of intervals
+  IntegralInterval stack[max_depth - min_depth + 2];
+
+  double len = 0.0;
+  for (int i = 0; i < nparts; i += 2) {
+    // Push the interval from the uniform partition
+    int nstack = 1;
+    stack[0].t1 = t[i];
+    stack[0].h1 = h[i];
+    stack[0].p1 = p[i];
+    stack[0].t2 = t[i + 2];
+    stack[0].h2 = h[i + 2];
+    stack[0].p2 = p[i + 2];
+    stack[0].depth = min_depth;
+
+    while (nstack > 0) {
+      IntegralInterval *in = &stack[nstack - 1];
+
+      // Find the mid point of the interval
+      TMRPoint pmid;
+      double hmid;
+      double tmid = 0.5 * (in->t1 + in->t2);
+      if (in->depth == min_depth) {
+        pmid = p[i + 1];
+        hmid = h[i + 1];
+      } else {
+        edge->evalPoint(tmid, &pmid);
+        hmid = fs->getFeatureSize(pmid);
+      }
+
+      // Evaluate the approximate integral contributions
+      double int1 = 2.0 * pointDist(&in->p1, &pmid) / (in->h1 + hmid);
+      double int2 = 4.0 * pointDist(&pmid, &in->p2) /
+                    (in->h1 + 2.0 * hmid + in->h2);
+      double int3 = 2.0 * pointDist(&in->p1, &in->p2) / (hmid + in->h2);
+
+      // Compute the integration error
+      double error = fabs(int3 - int1 - int2);
+
+      if (error < tol || in->depth >= max_depth) {
+        // Add the mid point and the final point
+        len += int1;
+        addIntegralPt(tmid, len, &count, &max_count, &tvals, &dist);
+        len += int2;
+        addIntegralPt(in->t2, len, &count, &max_count, &tvals, &dist);
+        nstack--;
+      } else {
+        // Replace the interval with its two halves, with the first
+        // half on the top of the stack
+        IntegralInterval *next = &stack[nstack];
+        next->t1 = in->t1;
+        next->h1 = in->h1;
+        next->p1 = in->p1;
+        next->t2 = tmid;
+        next->h2 = hmid;
+        next->p2 = pmid;
+        next->depth = in->depth + 1;
+
+        in->t1 = tmid;
+        in->h1 = hmid;
+        in->p1 = pmid;
+        in->depth++;
+        nstack++;
+      }
+    }
   }
 
-  double len = curr->dist;
-  delete curr;
+  delete[] t;
+  delete[] p;
+  delete[] h;
 
   // Set the pointers for the output
   *_nvals = count;
@@ -389,7 +421,20 @@ void TMREdgeMesh::mesh(TMRMeshOptions options, TMRElementFeatureSize *fs) {
   }
 
   if (mpi_rank == 0) {
-    if (copy && copy != edge) {
+    // Find the mesh in the cache. Copied edges, and edges with a
+    // feature size that cannot be fingerprinted, are not cached.
+    char cache_file[1024];
+    cache_file[0] = '\0';
+    uint64_t key = 0;
+    if (options.mesh_cache_dir[0] != '\0' && !(copy && copy != edge) &&
+        computeCacheKey(fs, &key) == 0) {
+      TMR_GetMeshCacheFileName(options.mesh_cache_dir, "edge", key,
+                               cache_file, sizeof(cache_file));
+    }
+
+    if (cache_file[0] != '\0' && readFromCache(cache_file, key) == 0) {
+      // The mesh was loaded from the cache
+    } else if (copy && copy != edge) {
       // Set the edge mesh
       TMREdgeMesh *mesh;
       copy->getMesh(&mesh);
@@ -500,8 +545,10 @@ void TMREdgeMesh::mesh(TMRMeshOptions options, TMRElementFeatureSize *fs) {
 
       // Allocate the points
       X = new TMRPoint[npts];
-      for (int i = 0; i < npts; i++) {
-        edge->evalPoint(pts[i], &X[i]);
+      edge->evalPoints(npts, pts, X);
+
+      if (cache_file[0] != '\0') {
+        writeToCache(cache_file, key);
       }
     }
   }
@@ -521,6 +568,89 @@ void TMREdgeMesh::mesh(TMRMeshOptions options, TMRElementFeatureSize *fs) {
   }
 }
 
+/*
+  Compute the key for the edge mesh in the cache
+
+  The key is computed from the number of points set by a source edge
+  (if any), the parameter range and sample points along the edge,
+  along with the feature size. Returns a non-zero fail flag if the
+  feature size cannot be fingerprinted and the mesh is not cached.
+*/
+int TMREdgeMesh::computeCacheKey(TMRElementFeatureSize *fs, uint64_t *key) {
+  const int nsamples = 33;
+
+  TMRMeshFingerprint fingerprint;
+  fingerprint.add(npts);
+  fingerprint.add(edge->isDegenerate());
+
+  TMRVertex *v1, *v2;
+  edge->getVertices(&v1, &v2);
+  fingerprint.add(v1 == v2 ? 1 : 0);
+
+  double tmin, tmax;
+  edge->getRange(&tmin, &tmax);
+  fingerprint.add(tmin);
+  fingerprint.add(tmax);
+
+  double t[nsamples];
+  TMRPoint Xs[nsamples];
+  for (int i = 0; i < nsamples; i++) {
+    t[i] = tmin + (tmax - tmin) * i / (nsamples - 1);
+  }
+  edge->evalPoints(nsamples, t, Xs);
+  fingerprint.addPoints(nsamples, Xs);
+
+  int fail = fingerprint.addFeatureSize(fs);
+  *key = fingerprint.hash;
+
+  return fail;
+}
+
+/*
+  Read the edge mesh from the cache. Returns 0 on success.
+*/
+int TMREdgeMesh::readFromCache(const char *filename, uint64_t key) {
+  FILE *fp = TMR_OpenMeshCacheFile(filename, key);
+  if (!fp) {
+    return 1;
+  }
+
+  int fail = 1;
+  int n = 0;
+  if (fread(&n, sizeof(int), 1, fp) == 1 && n >= 2) {
+    double *p = new double[n];
+    TMRPoint *Xp = new TMRPoint[n];
+    if (fread(p, sizeof(double), n, fp) == (size_t)n &&
+        fread(Xp, sizeof(TMRPoint), n, fp) == (size_t)n) {
+      npts = n;
+      pts = p;
+      X = Xp;
+      fail = 0;
+    } else {
+      delete[] p;
+      delete[] Xp;
+    }
+  }
+  fclose(fp);
+
+  return fail;
+}
+
+/*
+  Write the edge mesh to the cache
+*/
+void TMREdgeMesh::writeToCache(const char *filename, uint64_t key) {
+  char tmp_file[1100];
+  FILE *fp =
+      TMR_CreateMeshCacheFile(filename, key, tmp_file, sizeof(tmp_file));
+  if (fp) {
+    int fail = (fwrite(&npts, sizeof(int), 1, fp) != 1 ||
+                fwrite(pts, sizeof(double), npts, fp) != (size_t)npts ||
+                fwrite(X, sizeof(TMRPoint), npts, fp) != (size_t)npts);
+    TMR_CloseMeshCacheFile(fp, tmp_file, filename, fail);
+  }
+}
+
 /*
   Order the internal mesh points and return the number of owned points
   that were ordered.
@@ -636,6 +766,17 @@ int TMREdgeMesh::getNodeNums(const int **_vars) {
   return npts;
 }
 
+/*
+  Replace the node numbers with new numbers from the global ordering
+*/
+void TMREdgeMesh::renumberNodes(const int *new_nums) {
+  if (vars) {
+    for (int i = 0; i < npts; i++) {
+      vars[i] = new_nums[vars[i]];
+    }
+  }
+}
+
 /*
   Get the mesh points
 */
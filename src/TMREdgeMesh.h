@@ -46,6 +46,7 @@ class TMREdgeMesh : public TMREntity {
   // Order the mesh points uniquely
   int setNodeNums(int *num);
   int getNodeNums(const int **_vars);
+  void renumberNodes(const int *new_nums);
 
   // Retrieve the mesh points
   void getMeshPoints(int *_npts, const double **_pts, TMRPoint **X);
@@ -57,6 +58,11 @@ class TMREdgeMesh : public TMREntity {
   static int getEdgeCopyOrient(TMREdge *e);
 
  private:
+  // Compute the key and read/write the mesh in the mesh cache
+  int computeCacheKey(TMRElementFeatureSize *fs, uint64_t *key);
+  int readFromCache(const char *filename, uint64_t key);
+  void writeToCache(const char *filename, uint64_t key);
+
   MPI_Comm comm;
   TMREdge *edge;
 
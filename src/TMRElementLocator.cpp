@@ -0,0 +1,985 @@
+/*
+  This file is part of the package TMR for adaptive mesh refinement.
+
+  Copyright (C) 2015 Georgia Tech Research Corporation.
+  Additional copyright (C) 2015 Graeme Kennedy.
+  All rights reserved.
+
+  TMR is licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this software except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "TMRElementLocator.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+  Create the bounding box tree. The boxes are stored as the lower and
+  upper bounds (xlow, ylow, zlow, xhigh, yhigh, zhigh). Empty boxes,
+  with a lower bound that exceeds the upper bound, are not added to
+  the tree.
+*/
+TMRElementLocator::BoxTree::BoxTree(int _num_boxes, const double *_boxes) {
+  num_boxes = 0;
+  boxes = _boxes;
+  index = new int[_num_boxes > 0 ? _num_boxes : 1];
+  for (int i = 0; i < _num_boxes; i++) {
+    const double *b = &boxes[6 * i];
+    if (b[0] <= b[3] && b[1] <= b[4] && b[2] <= b[5]) {
+      index[num_boxes] = i;
+      num_boxes++;
+    }
+  }
+
+  // A binary tree with leaves of at least one box has fewer than
+  // twice as many nodes as boxes
+  int max_num_nodes = (num_boxes > 0 ? 2 * num_boxes : 1);
+  node_box = new double[6 * max_num_nodes];
+  node_left = new int[max_num_nodes];
+  node_right = new int[max_num_nodes];
+  node_start = new int[max_num_nodes];
+  node_count = new int[max_num_nodes];
+
+  num_nodes = 0;
+  if (num_boxes > 0) {
+    split(0, num_boxes);
+  }
+}
+
+/*
+  Free the tree
+*/
+TMRElementLocator::BoxTree::~BoxTree() {
+  delete[] index;
+  delete[] node_box;
+  delete[] node_left;
+  delete[] node_right;
+  delete[] node_start;
+  delete[] node_count;
+}
+
+/*
+  Create a node containing the boxes index[start:end] and split it
+  about the median of the box centers along its longest direction
+*/
+int TMRElementLocator::BoxTree::split(int start, int end) {
+  int node = num_nodes;
+  num_nodes++;
+
+  // Compute the bounds of the boxes and their centers
+  double *nb = &node_box[6 * node];
+  double clow[3], chigh[3];
+  for (int j = 0; j < 3; j++) {
+    const double *b = &boxes[6 * index[start]];
+    nb[j] = b[j];
+    nb[3 + j] = b[3 + j];
+    clow[j] = chigh[j] = b[j] + b[3 + j];
+  }
+  for (int i = start + 1; i < end; i++) {
+    const double *b = &boxes[6 * index[i]];
+    for (int j = 0; j < 3; j++) {
+      double c = b[j] + b[3 + j];
+      nb[j] = (b[j] < nb[j] ? b[j] : nb[j]);
+      nb[3 + j] = (b[3 + j] > nb[3 + j] ? b[3 + j] : nb[3 + j]);
+      clow[j] = (c < clow[j] ? c : clow[j]);
+      chigh[j] = (c > chigh[j] ? c : chigh[j]);
+    }
+  }
+
+  // Find the direction with the largest spread of the centers
+  int axis = 0;
+  for (int j = 1; j < 3; j++) {
+    if (chigh[j] - clow[j] > chigh[axis] - clow[axis]) {
+      axis = j;
+    }
+  }
+
+  node_left[node] = node_right[node] = -1;
+  node_start[node] = start;
+  node_count[node] = end - start;
+  if (end - start <= MAX_LEAF_SIZE || chigh[axis] <= clow[axis]) {
+    return node;
+  }
+
+  // Partially order the boxes so that the median lies at mid
+  int mid = (start + end) / 2;
+  int low = start, high = end - 1;
+  while (low < high) {
+    int p = index[(low + high) / 2];
+    double pivot = boxes[6 * p + axis] + boxes[6 * p + 3 + axis];
+    int i = low, j = high;
+    while (i <= j) {
+      while (boxes[6 * index[i] + axis] + boxes[6 * index[i] + 3 + axis] <
+             pivot) {
+        i++;
+      }
+      while (boxes[6 * index[j] + axis] + boxes[6 * index[j] + 3 + axis] >
+             pivot) {
+        j--;
+      }
+      if (i <= j) {
+        int t = index[i];
+        index[i] = index[j];
+        index[j] = t;
+        i++;
+        j--;
+      }
+    }
+    if (mid <= j) {
+      high = j;
+    } else if (mid >= i) {
+      low = i;
+    } else {
+      break;
+    }
+  }
+
+  int left = split(start, mid);
+  int right = split(mid, end);
+  node_left[node] = left;
+  node_right[node] = right;
+
+  return node;
+}
+
+/*
+  Find the boxes that contain the point. The number of boxes is
+  returned, but only the first max_size are written to the list.
+*/
+int TMRElementLocator::BoxTree::findBoxes(const double pt[], int max_size,
+                                          int *list) {
+  int count = 0;
+  if (num_nodes == 0) {
+    return count;
+  }
+
+  // The tree depth is bounded by the median split
+  int stack[128];
+  int nstack = 1;
+  stack[0] = 0;
+  while (nstack > 0) {
+    nstack--;
+    int node = stack[nstack];
+    const double *nb = &node_box[6 * node];
+    if (pt[0] < nb[0] || pt[0] > nb[3] || pt[1] < nb[1] || pt[1] > nb[4] ||
+        pt[2] < nb[2] || pt[2] > nb[5]) {
+      continue;
+    }
+
+    if (node_left[node] < 0) {
+      int end = node_start[node] + node_count[node];
+      for (int i = node_start[node]; i < end; i++) {
+        const double *b = &boxes[6 * index[i]];
+        if (pt[0] >= b[0] && pt[0] <= b[3] && pt[1] >= b[1] && pt[1] <= b[4] &&
+            pt[2] >= b[2] && pt[2] <= b[5]) {
+          if (count < max_size) {
+            list[count] = index[i];
+          }
+          count++;
+        }
+      }
+    } else {
+      stack[nstack] = node_right[node];
+      stack[nstack + 1] = node_left[node];
+      nstack += 2;
+    }
+  }
+
+  return count;
+}
+
+/*
+  Get the bounding boxes of the nodes from the deepest level of the
+  tree with no more than max_size nodes. Returns the number of boxes.
+*/
+int TMRElementLocator::BoxTree::getTopBoxes(int max_size, double *top) {
+  if (num_nodes == 0 || max_size < 1) {
+    return 0;
+  }
+
+  int *level = new int[2 * max_size];
+  int *next = new int[2 * max_size];
+  int nlevel = 1;
+  level[0] = 0;
+  while (1) {
+    int nnext = 0;
+    for (int i = 0; i < nlevel; i++) {
+      int node = level[i];
+      if (node_left[node] < 0) {
+        next[nnext] = node;
+        nnext++;
+      } else {
+        next[nnext] = node_left[node];
+        next[nnext + 1] = node_right[node];
+        nnext += 2;
+      }
+    }
+    if (nnext > max_size || nnext == nlevel) {
+      break;
+    }
+    int *t = level;
+    level = next;
+    next = t;
+    nlevel = nnext;
+  }
+
+  for (int i = 0; i < nlevel; i++) {
+    memcpy(&top[6 * i], &node_box[6 * level[i]], 6 * sizeof(double));
+  }
+  delete[] level;
+  delete[] next;
+
+  return nlevel;
+}
+
+/*
+  Create the locator for the elements of an octree forest
+*/
+TMRElementLocator::TMRElementLocator(TMROctForest *_oct_forest, double _tol) {
+  oct_forest = _oct_forest;
+  oct_forest->incref();
+  quad_forest = NULL;
+  tol = _tol;
+  initialize();
+}
+
+/*
+  Create the locator for the elements of a quadtree forest
+*/
+TMRElementLocator::TMRElementLocator(TMRQuadForest *_quad_forest,
+                                     double _tol) {
+  oct_forest = NULL;
+  quad_forest = _quad_forest;
+  quad_forest->incref();
+  tol = _tol;
+  initialize();
+}
+
+/*
+  Free the locator
+*/
+TMRElementLocator::~TMRElementLocator() {
+  if (oct_forest) {
+    oct_forest->decref();
+  }
+  if (quad_forest) {
+    quad_forest->decref();
+  }
+  delete[] Xelem;
+  delete[] elem_boxes;
+  delete[] elem_sizes;
+  delete elem_tree;
+  delete[] rank_boxes;
+  delete rank_tree;
+}
+
+/*
+  Copy the element node locations from the forest, then build the
+  element tree and the index of the processor boxes. This call is
+  collective on the forest communicator.
+*/
+void TMRElementLocator::initialize() {
+  const int *conn = NULL;
+  TMRPoint *X = NULL;
+  if (oct_forest) {
+    comm = oct_forest->getMPIComm();
+    dim = 3;
+    mesh_order = oct_forest->getMeshOrder();
+    elem_size = mesh_order * mesh_order * mesh_order;
+    oct_forest->getNodeConn(&conn, &num_elements);
+    oct_forest->getPoints(&X);
+  } else {
+    comm = quad_forest->getMPIComm();
+    dim = 2;
+    mesh_order = quad_forest->getMeshOrder();
+    elem_size = mesh_order * mesh_order;
+    quad_forest->getNodeConn(&conn, &num_elements);
+    quad_forest->getPoints(&X);
+  }
+
+  if (!conn || !X) {
+    fprintf(stderr,
+            "TMRElementLocator Error: The nodes must be created before "
+            "the elements can be located\n");
+    num_elements = 0;
+  }
+
+  // Copy the element node locations and compute the padded element
+  // bounding boxes
+  Xelem = new double[3 * elem_size * num_elements];
+  elem_boxes = new double[6 * num_elements];
+  elem_sizes = new double[num_elements];
+  for (int i = 0; i < num_elements; i++) {
+    const int *c = &conn[elem_size * i];
+    double *Xe = &Xelem[3 * elem_size * i];
+    double *b = &elem_boxes[6 * i];
+    for (int j = 0; j < elem_size; j++) {
+      int index = 0;
+      if (oct_forest) {
+        index = oct_forest->getLocalNodeNumber(c[j]);
+      } else {
+        index = quad_forest->getLocalNodeNumber(c[j]);
+      }
+      Xe[3 * j] = X[index].x;
+      Xe[3 * j + 1] = X[index].y;
+      Xe[3 * j + 2] = X[index].z;
+
+      for (int k = 0; k < 3; k++) {
+        if (j == 0 || Xe[3 * j + k] < b[k]) {
+          b[k] = Xe[3 * j + k];
+        }
+        if (j == 0 || Xe[3 * j + k] > b[3 + k]) {
+          b[3 + k] = Xe[3 * j + k];
+        }
+      }
+    }
+
+    double h = sqrt((b[3] - b[0]) * (b[3] - b[0]) +
+                    (b[4] - b[1]) * (b[4] - b[1]) +
+                    (b[5] - b[2]) * (b[5] - b[2]));
+    elem_sizes[i] = h;
+    for (int k = 0; k < 3; k++) {
+      b[k] -= tol * h;
+      b[3 + k] += tol * h;
+    }
+  }
+
+  elem_tree = new BoxTree(num_elements, elem_boxes);
+
+  // Gather the boxes from the top of the element tree on each
+  // processor. Unused boxes are marked as empty.
+  int mpi_size;
+  MPI_Comm_size(comm, &mpi_size);
+  double top[6 * MAX_RANK_BOXES];
+  int ntop = elem_tree->getTopBoxes(MAX_RANK_BOXES, top);
+  for (int i = ntop; i < MAX_RANK_BOXES; i++) {
+    for (int k = 0; k < 3; k++) {
+      top[6 * i + k] = 1.0;
+      top[6 * i + 3 + k] = -1.0;
+    }
+  }
+
+  rank_boxes = new double[6 * MAX_RANK_BOXES * mpi_size];
+  MPI_Allgather(top, 6 * MAX_RANK_BOXES, MPI_DOUBLE, rank_boxes,
+                6 * MAX_RANK_BOXES, MPI_DOUBLE, comm);
+  rank_tree = new BoxTree(MAX_RANK_BOXES * mpi_size, rank_boxes);
+}
+
+/*
+  Find the parametric point within the element closest to the given
+  point using Newton's method.
+
+  For an octree element, this solves X(prm) = pt and succeeds if the
+  parametric point lies within the element. For a quadtree element,
+  this finds the closest point within the element using a projected
+  Gauss-Newton method and succeeds if the distance is within the
+  tolerance. Returns 0 if the point lies within the element and 1
+  otherwise.
+*/
+int TMRElementLocator::invertElement(int elem, const TMRPoint *pt,
+                                     double *work, double prm[],
+                                     double *dist) {
+  const double *Xe = &Xelem[3 * elem_size * elem];
+  const double h = elem_sizes[elem];
+  const double eps = 1e-12 * h;
+  double *N = work;
+  double *N1 = &work[elem_size];
+  double *N2 = &work[2 * elem_size];
+  double *N3 = &work[3 * elem_size];
+
+  prm[0] = prm[1] = prm[2] = 0.0;
+  *dist = 0.0;
+
+  if (oct_forest) {
+    for (int iter = 0;; iter++) {
+      oct_forest->evalInterp(prm, N, N1, N2, N3);
+
+      // Evaluate the point and the Jacobian of the transformation
+      double r[3] = {-pt->x, -pt->y, -pt->z};
+      double J[9];
+      memset(J, 0, 9 * sizeof(double));
+      for (int i = 0; i < elem_size; i++) {
+        for (int k = 0; k < 3; k++) {
+          r[k] += N[i] * Xe[3 * i + k];
+          J[3 * k] += N1[i] * Xe[3 * i + k];
+          J[3 * k + 1] += N2[i] * Xe[3 * i + k];
+          J[3 * k + 2] += N3[i] * Xe[3 * i + k];
+        }
+      }
+      *dist = sqrt(r[0] * r[0] + r[1] * r[1] + r[2] * r[2]);
+      if (*dist <= eps || iter >= MAX_NEWTON_ITERS) {
+        break;
+      }
+
+      // Solve the 3x3 system using the adjugate of the Jacobian
+      double det = (J[0] * (J[4] * J[8] - J[5] * J[7]) -
+                    J[1] * (J[3] * J[8] - J[5] * J[6]) +
+                    J[2] * (J[3] * J[7] - J[4] * J[6]));
+      if (det == 0.0) {
+        return 1;
+      }
+      double d0 = ((J[4] * J[8] - J[5] * J[7]) * r[0] -
+                   (J[1] * J[8] - J[2] * J[7]) * r[1] +
+                   (J[1] * J[5] - J[2] * J[4]) * r[2]) /
+                  det;
+      double d1 = (-(J[3] * J[8] - J[5] * J[6]) * r[0] +
+                   (J[0] * J[8] - J[2] * J[6]) * r[1] -
+                   (J[0] * J[5] - J[2] * J[3]) * r[2]) /
+                  det;
+      double d2 = ((J[3] * J[7] - J[4] * J[6]) * r[0] -
+                   (J[0] * J[7] - J[1] * J[6]) * r[1] +
+                   (J[0] * J[4] - J[1] * J[3]) * r[2]) /
+                  det;
+      prm[0] -= d0;
+      prm[1] -= d1;
+      prm[2] -= d2;
+
+      // Stop once the iterates are well outside the element
+      if (fabs(prm[0]) > 4.0 || fabs(prm[1]) > 4.0 || fabs(prm[2]) > 4.0) {
+        return 1;
+      }
+    }
+
+    if (*dist <= tol * h && fabs(prm[0]) <= 1.0 + tol &&
+        fabs(prm[1]) <= 1.0 + tol && fabs(prm[2]) <= 1.0 + tol) {
+      return 0;
+    }
+  } else {
+    for (int iter = 0;; iter++) {
+      quad_forest->evalInterp(prm, N, N1, N2);
+
+      // Evaluate the point and its derivatives
+      TMRPoint r, Xu, Xv;
+      r.x = -pt->x;
+      r.y = -pt->y;
+      r.z = -pt->z;
+      Xu.zero();
+      Xv.zero();
+      for (int i = 0; i < elem_size; i++) {
+        r.x += N[i] * Xe[3 * i];
+        r.y += N[i] * Xe[3 * i + 1];
+        r.z += N[i] * Xe[3 * i + 2];
+        Xu.x += N1[i] * Xe[3 * i];
+        Xu.y += N1[i] * Xe[3 * i + 1];
+        Xu.z += N1[i] * Xe[3 * i + 2];
+        Xv.x += N2[i] * Xe[3 * i];
+        Xv.y += N2[i] * Xe[3 * i + 1];
+        Xv.z += N2[i] * Xe[3 * i + 2];
+      }
+      *dist = sqrt(r.dot(r));
+      if (*dist <= eps || iter >= MAX_NEWTON_ITERS) {
+        break;
+      }
+
+      // Solve the 2x2 Gauss-Newton system
+      double ru = Xu.dot(r), rv = Xv.dot(r);
+      double Juu = Xu.dot(Xu), Juv = Xu.dot(Xv), Jvv = Xv.dot(Xv);
+      double det = Juu * Jvv - Juv * Juv;
+      if (det == 0.0) {
+        return 1;
+      }
+      double u = prm[0] - (Jvv * ru - Juv * rv) / det;
+      double v = prm[1] - (Juu * rv - Juv * ru) / det;
+
+      // Project the point back onto the element
+      u = (u < -1.0 ? -1.0 : (u > 1.0 ? 1.0 : u));
+      v = (v < -1.0 ? -1.0 : (v > 1.0 ? 1.0 : v));
+      int converged = (fabs(u - prm[0]) <= 1e-12 && fabs(v - prm[1]) <= 1e-12);
+      prm[0] = u;
+      prm[1] = v;
+      if (converged) {
+        break;
+      }
+    }
+
+    if (*dist <= tol * h) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+/*
+  Locate the points within the elements on this processor. The
+  element index is -1 for points that are not found. For points that
+  lie within more than one element, the element with the smallest
+  distance is selected, or the lowest index for equal distances.
+*/
+void TMRElementLocator::locateLocalPoints(int npts, const TMRPoint *pts,
+                                          int *elems, double *prm,
+                                          double *dist) {
+  double *work = new double[4 * elem_size];
+  int max_size = 64;
+  int *list = new int[max_size];
+
+  for (int i = 0; i < npts; i++) {
+    double p[3] = {pts[i].x, pts[i].y, pts[i].z};
+    int n = elem_tree->findBoxes(p, max_size, list);
+    if (n > max_size) {
+      delete[] list;
+      max_size = 2 * n;
+      list = new int[max_size];
+      n = elem_tree->findBoxes(p, max_size, list);
+    }
+
+    elems[i] = -1;
+    prm[3 * i] = prm[3 * i + 1] = prm[3 * i + 2] = 0.0;
+    dist[i] = 0.0;
+    for (int j = 0; j < n; j++) {
+      double pe[3], d;
+      if (invertElement(list[j], &pts[i], work, pe, &d) == 0) {
+        if (elems[i] < 0 || d < dist[i] ||
+            (d == dist[i] && list[j] < elems[i])) {
+          elems[i] = list[j];
+          prm[3 * i] = pe[0];
+          prm[3 * i + 1] = pe[1];
+          prm[3 * i + 2] = pe[2];
+          dist[i] = d;
+        }
+      }
+    }
+  }
+
+  delete[] work;
+  delete[] list;
+}
+
+/*
+  Locate the points within the elements of the forest.
+
+  Each point is sent to the processors whose boxes contain it. These
+  processors locate the point within their elements and return the
+  results. The element with the smallest distance is selected, or the
+  lowest rank for equal distances. The points may differ between
+  processors.
+*/
+int TMRElementLocator::locatePoints(int npts, const TMRPoint *pts,
+                                    int *ranks, int *elems, double *prm) {
+  int mpi_size;
+  MPI_Comm_size(comm, &mpi_size);
+
+  // Count the number of points sent to each processor. Each point is
+  // sent at most once to each processor.
+  int *flags = new int[mpi_size];
+  int *send_counts = new int[mpi_size];
+  for (int k = 0; k < mpi_size; k++) {
+    flags[k] = -1;
+    send_counts[k] = 0;
+  }
+
+  int max_size = 4 * MAX_RANK_BOXES;
+  int *list = new int[max_size];
+  int *num_boxes = new int[npts];
+  for (int i = 0; i < npts; i++) {
+    double p[3] = {pts[i].x, pts[i].y, pts[i].z};
+    int n = rank_tree->findBoxes(p, max_size, list);
+    if (n > max_size) {
+      delete[] list;
+      max_size = 2 * n;
+      list = new int[max_size];
+      n = rank_tree->findBoxes(p, max_size, list);
+    }
+    num_boxes[i] = n;
+
+    for (int j = 0; j < n; j++) {
+      int k = list[j] / MAX_RANK_BOXES;
+      if (flags[k] != i) {
+        flags[k] = i;
+        send_counts[k]++;
+      }
+    }
+  }
+
+  int *send_ptr = new int[mpi_size + 1];
+  send_ptr[0] = 0;
+  for (int k = 0; k < mpi_size; k++) {
+    send_ptr[k + 1] = send_ptr[k] + send_counts[k];
+  }
+  int nsend = send_ptr[mpi_size];
+
+  // Order the points by destination
+  int *send_index = new int[nsend];
+  TMRPoint *send_pts = new TMRPoint[nsend];
+  for (int k = 0; k < mpi_size; k++) {
+    flags[k] = -1;
+    send_counts[k] = 0;
+  }
+  for (int i = 0; i < npts; i++) {
+    if (num_boxes[i] == 0) {
+      continue;
+    }
+    double p[3] = {pts[i].x, pts[i].y, pts[i].z};
+    int n = rank_tree->findBoxes(p, max_size, list);
+    for (int j = 0; j < n; j++) {
+      int k = list[j] / MAX_RANK_BOXES;
+      if (flags[k] != i) {
+        flags[k] = i;
+        int pos = send_ptr[k] + send_counts[k];
+        send_counts[k]++;
+        send_index[pos] = i;
+        send_pts[pos] = pts[i];
+      }
+    }
+  }
+  delete[] flags;
+  delete[] list;
+  delete[] num_boxes;
+
+  // Send the points to the processors
+  int *recv_counts = new int[mpi_size];
+  MPI_Alltoall(send_counts, 1, MPI_INT, recv_counts, 1, MPI_INT, comm);
+
+  int *recv_ptr = new int[mpi_size + 1];
+  recv_ptr[0] = 0;
+  for (int k = 0; k < mpi_size; k++) {
+    recv_ptr[k + 1] = recv_ptr[k] + recv_counts[k];
+  }
+  int nrecv = recv_ptr[mpi_size];
+
+  // Scale the counts and offsets by the number of components
+  int *send_counts_v = new int[mpi_size];
+  int *send_ptr_v = new int[mpi_size];
+  int *recv_counts_v = new int[mpi_size];
+  int *recv_ptr_v = new int[mpi_size];
+  for (int k = 0; k < mpi_size; k++) {
+    send_counts_v[k] = 3 * send_counts[k];
+    send_ptr_v[k] = 3 * send_ptr[k];
+    recv_counts_v[k] = 3 * recv_counts[k];
+    recv_ptr_v[k] = 3 * recv_ptr[k];
+  }
+
+  TMRPoint *recv_pts = new TMRPoint[nrecv];
+  MPI_Alltoallv(send_pts, send_counts_v, send_ptr_v, MPI_DOUBLE, recv_pts,
+                recv_counts_v, recv_ptr_v, MPI_DOUBLE, comm);
+  delete[] send_pts;
+
+  // Locate the points within the elements on this processor and pack
+  // the parametric point and the distance
+  int *recv_elems = new int[nrecv];
+  double *recv_prm = new double[3 * nrecv];
+  double *recv_dist = new double[nrecv];
+  locateLocalPoints(nrecv, recv_pts, recv_elems, recv_prm, recv_dist);
+  delete[] recv_pts;
+
+  double *recv_vals = new double[4 * nrecv];
+  for (int i = 0; i < nrecv; i++) {
+    recv_vals[4 * i] = recv_prm[3 * i];
+    recv_vals[4 * i + 1] = recv_prm[3 * i + 1];
+    recv_vals[4 * i + 2] = recv_prm[3 * i + 2];
+    recv_vals[4 * i + 3] = recv_dist[i];
+  }
+  delete[] recv_prm;
+  delete[] recv_dist;
+
+  // Return the results to the processors that sent the points
+  for (int k = 0; k < mpi_size; k++) {
+    send_counts_v[k] = 4 * send_counts[k];
+    send_ptr_v[k] = 4 * send_ptr[k];
+    recv_counts_v[k] = 4 * recv_counts[k];
+    recv_ptr_v[k] = 4 * recv_ptr[k];
+  }
+
+  int *send_elems = new int[nsend];
+  double *send_vals = new double[4 * nsend];
+  MPI_Alltoallv(recv_elems, recv_counts, recv_ptr, MPI_INT, send_elems,
+                send_counts, send_ptr, MPI_INT, comm);
+  MPI_Alltoallv(recv_vals, recv_counts_v, recv_ptr_v, MPI_DOUBLE, send_vals,
+                send_counts_v, send_ptr_v, MPI_DOUBLE, comm);
+  delete[] recv_elems;
+  delete[] recv_vals;
+  delete[] recv_counts;
+  delete[] recv_ptr;
+  delete[] send_counts_v;
+  delete[] send_ptr_v;
+  delete[] recv_counts_v;
+  delete[] recv_ptr_v;
+
+  // Select the closest result for each point, or the lowest rank
+  // for equal distances
+  double *dist = new double[npts];
+  for (int i = 0; i < npts; i++) {
+    ranks[i] = elems[i] = -1;
+    prm[3 * i] = prm[3 * i + 1] = prm[3 * i + 2] = 0.0;
+    dist[i] = 0.0;
+  }
+
+  int nfound = 0;
+  for (int k = 0; k < mpi_size; k++) {
+    for (int pos = send_ptr[k]; pos < send_ptr[k + 1]; pos++) {
+      int i = send_index[pos];
+      const double *v = &send_vals[4 * pos];
+      if (send_elems[pos] >= 0 && (ranks[i] < 0 || v[3] < dist[i])) {
+        if (ranks[i] < 0) {
+          nfound++;
+        }
+        ranks[i] = k;
+        elems[i] = send_elems[pos];
+        prm[3 * i] = v[0];
+        prm[3 * i + 1] = v[1];
+        prm[3 * i + 2] = v[2];
+        dist[i] = v[3];
+      }
+    }
+  }
+
+  delete[] dist;
+  delete[] send_index;
+  delete[] send_elems;
+  delete[] send_vals;
+  delete[] send_counts;
+  delete[] send_ptr;
+
+  return nfound;
+}
+
+/*
+  Create the interpolation from the nodes of the forest used by the
+  locator to the nodes of another octree forest.
+
+  The forests need not be related by refinement. Each node owned by
+  this processor in the given forest is located within the elements of
+  the locator forest, and the interpolation row for the node is the
+  shape functions evaluated at the parametric point. The input of the
+  interpolation is the node map of the locator forest and the output
+  is the node map of the given forest. The interpolation must be
+  initialized after this call. Rows for nodes that are not located are
+  left empty.
+
+  This call is collective and returns the number of nodes on all
+  processors that are not located.
+*/
+int TMRElementLocator::createInterpolation(TMROctForest *forest,
+                                           TACSBVecInterp *interp) {
+  int mpi_rank;
+  MPI_Comm_rank(comm, &mpi_rank);
+
+  const int *node_range;
+  TMRPoint *X;
+  forest->getOwnedNodeRange(&node_range);
+  forest->getPoints(&X);
+
+  int nnodes = 0;
+  if (node_range && X) {
+    nnodes = node_range[mpi_rank + 1] - node_range[mpi_rank];
+  }
+  int *nodes = new int[nnodes];
+  TMRPoint *pts = new TMRPoint[nnodes];
+  for (int i = 0; i < nnodes; i++) {
+    nodes[i] = node_range[mpi_rank] + i;
+    pts[i] = X[forest->getLocalNodeNumber(nodes[i])];
+  }
+
+  int fail = addInterpolation(nnodes, nodes, pts, interp);
+  delete[] nodes;
+  delete[] pts;
+
+  return fail;
+}
+
+/*
+  Create the interpolation from the nodes of the forest used by the
+  locator to the nodes of another quadtree forest
+*/
+int TMRElementLocator::createInterpolation(TMRQuadForest *forest,
+                                           TACSBVecInterp *interp) {
+  int mpi_rank;
+  MPI_Comm_rank(comm, &mpi_rank);
+
+  const int *node_range;
+  TMRPoint *X;
+  forest->getOwnedNodeRange(&node_range);
+  forest->getPoints(&X);
+
+  int nnodes = 0;
+  if (node_range && X) {
+    nnodes = node_range[mpi_rank + 1] - node_range[mpi_rank];
+  }
+  int *nodes = new int[nnodes];
+  TMRPoint *pts = new TMRPoint[nnodes];
+  for (int i = 0; i < nnodes; i++) {
+    nodes[i] = node_range[mpi_rank] + i;
+    pts[i] = X[forest->getLocalNodeNumber(nodes[i])];
+  }
+
+  int fail = addInterpolation(nnodes, nodes, pts, interp);
+  delete[] nodes;
+  delete[] pts;
+
+  return fail;
+}
+
+/*
+  Locate the points and send the node number, element and parametric
+  point to the processor that owns the element. The owner evaluates
+  the shape functions and adds the interpolation row, expanding the
+  dependent nodes in terms of the independent nodes.
+*/
+int TMRElementLocator::addInterpolation(int nnodes, const int *nodes,
+                                        const TMRPoint *pts,
+                                        TACSBVecInterp *interp) {
+  int mpi_size;
+  MPI_Comm_size(comm, &mpi_size);
+
+  int *ranks = new int[nnodes];
+  int *elems = new int[nnodes];
+  double *prm = new double[3 * nnodes];
+  int nfound = locatePoints(nnodes, pts, ranks, elems, prm);
+
+  // Order the located nodes by the owner of the element
+  int *send_counts = new int[mpi_size];
+  memset(send_counts, 0, mpi_size * sizeof(int));
+  for (int i = 0; i < nnodes; i++) {
+    if (ranks[i] >= 0) {
+      send_counts[ranks[i]]++;
+    }
+  }
+
+  int *send_ptr = new int[mpi_size + 1];
+  send_ptr[0] = 0;
+  for (int k = 0; k < mpi_size; k++) {
+    send_ptr[k + 1] = send_ptr[k] + send_counts[k];
+  }
+  int nsend = send_ptr[mpi_size];
+
+  int *send_ids = new int[2 * nsend];
+  double *send_prm = new double[3 * nsend];
+  memset(send_counts, 0, mpi_size * sizeof(int));
+  for (int i = 0; i < nnodes; i++) {
+    if (ranks[i] >= 0) {
+      int pos = send_ptr[ranks[i]] + send_counts[ranks[i]];
+      send_counts[ranks[i]]++;
+      send_ids[2 * pos] = nodes[i];
+      send_ids[2 * pos + 1] = elems[i];
+      send_prm[3 * pos] = prm[3 * i];
+      send_prm[3 * pos + 1] = prm[3 * i + 1];
+      send_prm[3 * pos + 2] = prm[3 * i + 2];
+    }
+  }
+  delete[] ranks;
+  delete[] elems;
+  delete[] prm;
+
+  int *recv_counts = new int[mpi_size];
+  MPI_Alltoall(send_counts, 1, MPI_INT, recv_counts, 1, MPI_INT, comm);
+
+  int *recv_ptr = new int[mpi_size + 1];
+  recv_ptr[0] = 0;
+  for (int k = 0; k < mpi_size; k++) {
+    recv_ptr[k + 1] = recv_ptr[k] + recv_counts[k];
+  }
+  int nrecv = recv_ptr[mpi_size];
+
+  // Send the node numbers and elements, then the parametric points
+  int *send_counts_v = new int[mpi_size];
+  int *send_ptr_v = new int[mpi_size];
+  int *recv_counts_v = new int[mpi_size];
+  int *recv_ptr_v = new int[mpi_size];
+  for (int k = 0; k < mpi_size; k++) {
+    send_counts_v[k] = 2 * send_counts[k];
+    send_ptr_v[k] = 2 * send_ptr[k];
+    recv_counts_v[k] = 2 * recv_counts[k];
+    recv_ptr_v[k] = 2 * recv_ptr[k];
+  }
+
+  int *recv_ids = new int[2 * nrecv];
+  MPI_Alltoallv(send_ids, send_counts_v, send_ptr_v, MPI_INT, recv_ids,
+                recv_counts_v, recv_ptr_v, MPI_INT, comm);
+
+  for (int k = 0; k < mpi_size; k++) {
+    send_counts_v[k] = 3 * send_counts[k];
+    send_ptr_v[k] = 3 * send_ptr[k];
+    recv_counts_v[k] = 3 * recv_counts[k];
+    recv_ptr_v[k] = 3 * recv_ptr[k];
+  }
+
+  double *recv_prm = new double[3 * nrecv];
+  MPI_Alltoallv(send_prm, send_counts_v, send_ptr_v, MPI_DOUBLE, recv_prm,
+                recv_counts_v, recv_ptr_v, MPI_DOUBLE, comm);
+  delete[] send_ids;
+  delete[] send_prm;
+  delete[] send_counts;
+  delete[] send_ptr;
+  delete[] recv_counts;
+  delete[] recv_ptr;
+  delete[] send_counts_v;
+  delete[] send_ptr_v;
+  delete[] recv_counts_v;
+  delete[] recv_ptr_v;
+
+  // Get the connectivity and the dependent nodes
+  const int *conn, *dep_ptr, *dep_conn;
+  const double *dep_weights;
+  if (oct_forest) {
+    oct_forest->getNodeConn(&conn);
+    oct_forest->getDepNodeConn(&dep_ptr, &dep_conn, &dep_weights);
+  } else {
+    quad_forest->getNodeConn(&conn);
+    quad_forest->getDepNodeConn(&dep_ptr, &dep_conn, &dep_weights);
+  }
+
+  // Allocate space for the weights. Each dependent node depends on
+  // at most mesh_order^2 independent nodes.
+  int max_weights = elem_size * mesh_order * mesh_order;
+  TMRIndexWeight *weights = new TMRIndexWeight[max_weights];
+  double *N = new double[elem_size];
+  double *wvals = new double[max_weights];
+  int *vars = new int[max_weights];
+
+  for (int i = 0; i < nrecv; i++) {
+    int elem = recv_ids[2 * i + 1];
+    if (oct_forest) {
+      oct_forest->evalInterp(&recv_prm[3 * i], N);
+    } else {
+      quad_forest->evalInterp(&recv_prm[3 * i], N);
+    }
+
+    const int *c = &conn[elem_size * elem];
+    int nweights = 0;
+    for (int j = 0; j < elem_size; j++) {
+      if (c[j] >= 0) {
+        weights[nweights].index = c[j];
+        weights[nweights].weight = N[j];
+        nweights++;
+      } else {
+        int node = -c[j] - 1;
+        for (int jp = dep_ptr[node]; jp < dep_ptr[node + 1]; jp++) {
+          weights[nweights].index = dep_conn[jp];
+          weights[nweights].weight = N[j] * dep_weights[jp];
+          nweights++;
+        }
+      }
+    }
+    nweights = TMRIndexWeight::uniqueSort(weights, nweights);
+
+    for (int k = 0; k < nweights; k++) {
+      vars[k] = weights[k].index;
+      wvals[k] = weights[k].weight;
+    }
+    interp->addInterp(recv_ids[2 * i], wvals, vars, nweights);
+  }
+
+  delete[] recv_ids;
+  delete[] recv_prm;
+  delete[] weights;
+  delete[] N;
+  delete[] wvals;
+  delete[] vars;
+
+  // Count the nodes that were not located on all processors
+  int nfail = nnodes - nfound;
+  MPI_Allreduce(MPI_IN_PLACE, &nfail, 1, MPI_INT, MPI_SUM, comm);
+
+  return nfail;
+}
@@ -0,0 +1,135 @@
+/*
+  This file is part of the package TMR for adaptive mesh refinement.
+
+  Copyright (C) 2015 Georgia Tech Research Corporation.
+  Additional copyright (C) 2015 Graeme Kennedy.
+  All rights reserved.
+
+  TMR is licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this software except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef TMR_ELEMENT_LOCATOR_H
+#define TMR_ELEMENT_LOCATOR_H
+
+#include "TMROctForest.h"
+#include "TMRQuadForest.h"
+
+/*
+  Locate the elements of a distributed forest that contain a set of
+  physical points.
+
+  Each processor builds a bounding box tree over the elements that it
+  owns, and the boxes of the upper levels of these trees are gathered
+  on all processors to form a coarse index of the processor bounding
+  boxes. A query sends each point to the processors whose boxes
+  contain it, locates the element and its parametric point using
+  Newton's method on those processors, and returns the results, so
+  that a batch of points requires a single round of communication.
+
+  For an octree forest, a point is contained in an element if the
+  parametric point lies within the element. For a quadtree forest, the
+  closest point on the element is found, and the point is contained in
+  the element if the distance is less than the tolerance times the
+  element size. The forest must have its nodes created and the
+  locator is not updated if the forest changes.
+
+  The locator also creates the interpolation between the nodes of its
+  forest and the nodes of a second forest, which need not be related
+  to the first by refinement.
+*/
+class TMRElementLocator : public TMREntity {
+ public:
+  TMRElementLocator(TMROctForest *_oct_forest, double _tol = 1e-6);
+  TMRElementLocator(TMRQuadForest *_quad_forest, double _tol = 1e-6);
+  ~TMRElementLocator();
+
+  // Locate the elements that contain the points. This is collective
+  // on the forest communicator. The results are the owner rank, the
+  // local element index on the owner and the parametric point in
+  // [-1, 1]^dim (three values per point). Points that are not found
+  // have rank and element index -1. Returns the number of points found.
+  int locatePoints(int npts, const TMRPoint *pts, int *ranks, int *elems,
+                   double *prm);
+
+  // Create the interpolation from the nodes of the forest used by the
+  // locator to the nodes of another forest. Returns the number of
+  // nodes that are not located.
+  int createInterpolation(TMROctForest *forest, TACSBVecInterp *interp);
+  int createInterpolation(TMRQuadForest *forest, TACSBVecInterp *interp);
+
+  // Locate the points only within the elements on this processor
+  void locateLocalPoints(int npts, const TMRPoint *pts, int *elems,
+                         double *prm, double *dist);
+
+ private:
+  // The maximum number of boxes per processor in the global index
+  static const int MAX_RANK_BOXES = 8;
+
+  // The maximum number of boxes within a leaf of the tree
+  static const int MAX_LEAF_SIZE = 8;
+
+  // The maximum number of Newton iterations
+  static const int MAX_NEWTON_ITERS = 20;
+
+  // A bounding box tree. Each node stores its bounding box and either
+  // its two children or the range of box indices within the leaf.
+  class BoxTree {
+   public:
+    BoxTree(int _num_boxes, const double *_boxes);
+    ~BoxTree();
+    int findBoxes(const double pt[], int max_size, int *list);
+    int getTopBoxes(int max_size, double *top);
+
+   private:
+    int split(int start, int end);
+
+    int num_boxes;
+    const double *boxes;
+    int *index;
+    int num_nodes;
+    double *node_box;
+    int *node_left, *node_right, *node_start, *node_count;
+  };
+
+  // Initialize the element data and the trees from the forest
+  void initialize();
+
+  // Add the interpolation rows for the given nodes and points
+  int addInterpolation(int nnodes, const int *nodes, const TMRPoint *pts,
+                       TACSBVecInterp *interp);
+
+  // Find the parametric point within a single element
+  int invertElement(int elem, const TMRPoint *pt, double *work, double prm[],
+                    double *dist);
+
+  // The forest
+  TMROctForest *oct_forest;
+  TMRQuadForest *quad_forest;
+  MPI_Comm comm;
+
+  // The dimension, the element order and the element node locations
+  int dim, mesh_order, elem_size;
+  int num_elements;
+  double *Xelem;
+  double *elem_boxes, *elem_sizes;
+  double tol;
+
+  // The element tree on this processor
+  BoxTree *elem_tree;
+
+  // The boxes from all processors and the processor tree
+  double *rank_boxes;
+  BoxTree *rank_tree;
+};
+
+#endif  // TMR_ELEMENT_LOCATOR_H
@@ -21,13 +21,18 @@
 #include "TMRFaceMesh.h"
 
 #include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 
+#include <set>
+#include <vector>
+
 #include "TMRMesh.h"
 #include "TMRMeshSmoothing.h"
 #include "TMRNativeTopology.h"
 #include "TMRPerfectMatchInterface.h"
 #include "TMRTriangularize.h"
+#include "TMR_VTKTools.h"
 #include "tmrlapack.h"
 
 /*
@@ -83,6 +88,27 @@ inline int get_structured_index(const int nx, const int ny, const int i,
   return 2 * nx + 2 * ny - 4 + (i - 1) + (j - 1) * (nx - 2);
 }
 
+/*
+  The x-coordinate and index of a mesh point, used to search for
+  coincident points
+*/
+class TMRFacePointKey {
+ public:
+  double x;
+  int index;
+};
+
+static int compare_face_point_keys(const void *avoid, const void *bvoid) {
+  const TMRFacePointKey *a = static_cast<const TMRFacePointKey *>(avoid);
+  const TMRFacePointKey *b = static_cast<const TMRFacePointKey *>(bvoid);
+  if (a->x < b->x) {
+    return -1;
+  } else if (a->x > b->x) {
+    return 1;
+  }
+  return a->index - b->index;
+}
+
 /*
   Create the surface mesh object
 
@@ -113,6 +139,7 @@ TMRFaceMesh::TMRFaceMesh(MPI_Comm _comm, TMRFace *_face, TMRPoint *_X,
   tris = NULL;
   source_to_target = NULL;
   copy_to_target = NULL;
+  sorted_pts = NULL;
 
   // This is not a prescribed mesh
   prescribed_mesh = 0;
@@ -150,6 +177,9 @@ TMRFaceMesh::~TMRFaceMesh() {
   if (copy_to_target) {
     delete[] copy_to_target;
   }
+  if (sorted_pts) {
+    delete[] sorted_pts;
+  }
 }
 
 /*
@@ -305,9 +335,7 @@ void TMRFaceMesh::setPrescribedMesh(const TMRPoint *_X, int _npts,
 
   // Set the point locations
   pts = new double[2 * num_points];
-  for (int i = 0; i < num_points; i++) {
-    face->invEvalPoint(X[i], &pts[2 * i], &pts[2 * i + 1]);
-  }
+  face->invEvalPoints(num_points, X, pts);
 }
 
 /*
@@ -411,6 +439,8 @@ void TMRFaceMesh::mesh(TMRMeshOptions options, TMRElementFeatureSize *fs) {
   mesh_type = _mesh_type;
 
   if (mpi_rank == 0) {
+    double t0 = MPI_Wtime();
+
     // Count up the number of points and segments from the curves that
     // bound the surface. Keep track of the number of points = the
     // number of segments.
@@ -560,8 +590,26 @@ void TMRFaceMesh::mesh(TMRMeshOptions options, TMRElementFeatureSize *fs) {
     // automatically.  The boundary points are guaranteed to be
     // ordered first.
     num_fixed_pts = total_num_pts - num_degen;
+    stats.boundary_time = MPI_Wtime() - t0;
+
+    // Find the mesh in the cache. Only the faces that are meshed
+    // independently of a source or copy face, and with a feature size
+    // that can be fingerprinted, are cached.
+    char cache_file[1024];
+    cache_file[0] = '\0';
+    uint64_t key = 0;
+    int from_cache = 0;
+    if (options.mesh_cache_dir[0] != '\0' && !source && !copy &&
+        computeCacheKey(options, fs, nloops, loop_pt_offset, params,
+                        num_degen, degen, &key) == 0) {
+      TMR_GetMeshCacheFileName(options.mesh_cache_dir, "face", key,
+                               cache_file, sizeof(cache_file));
+      from_cache = (readFromCache(cache_file, key) == 0);
+    }
 
-    if (source) {
+    if (from_cache) {
+      // The mesh was loaded from the cache
+    } else if (source) {
       mapSourceToTarget(options, params);
     } else if (copy) {
       mapCopyToTarget(options, params);
@@ -583,9 +631,7 @@ void TMRFaceMesh::mesh(TMRMeshOptions options, TMRElementFeatureSize *fs) {
 
       // Evaluate all of the points around the edge
       TMRPoint *Xparam = new TMRPoint[total_num_pts];
-      for (int i = 0; i < total_num_pts; i++) {
-        face->evalPoint(params[2 * i], params[2 * i + 1], &Xparam[i]);
-      }
+      face->evalPoints(total_num_pts, params, Xparam);
 
       // Go through the edge loops and find corners that will be problematic
       // for the quadrilateral mesh generator. Add extra segments
@@ -703,9 +749,11 @@ void TMRFaceMesh::mesh(TMRMeshOptions options, TMRElementFeatureSize *fs) {
                              &pts_to_quads);
 
       // Smooth the mesh using a local optimization of node locations
+      double ts = MPI_Wtime();
       TMR_QuadSmoothing(options.num_smoothing_steps, num_fixed_pts, num_points,
                         pts_to_quad_ptr, pts_to_quads, num_quads, quads, pts, X,
-                        face);
+                        face, options.smoothing_tolerance);
+      stats.smooth_time += MPI_Wtime() - ts;
 
       // Free the connectivity information
       delete[] pts_to_quad_ptr;
@@ -719,6 +767,10 @@ void TMRFaceMesh::mesh(TMRMeshOptions options, TMRElementFeatureSize *fs) {
       }
     }
 
+    if (cache_file[0] != '\0' && !from_cache) {
+      writeToCache(cache_file, key);
+    }
+
     if (num_degen > 0) {
       delete[] degen;
     }
@@ -727,43 +779,211 @@ void TMRFaceMesh::mesh(TMRMeshOptions options, TMRElementFeatureSize *fs) {
     delete[] loop_pt_offset;
     delete[] params;
     delete[] segments;
+
+    stats.total_time = MPI_Wtime() - t0;
   }
 
   if (mpi_size > 1) {
-    // Broadcast the number of points to all the processors
-    int temp[3];
-    temp[0] = num_points;
-    temp[1] = num_quads;
-    temp[2] = num_fixed_pts;
-    MPI_Bcast(temp, 3, MPI_INT, 0, comm);
-    num_points = temp[0];
-    num_quads = temp[1];
-    num_fixed_pts = temp[2];
+    broadcastMesh(comm, 0);
+  }
+}
+
+/*
+  Compute the key for the face mesh in the cache
 
-    if (mpi_rank != 0) {
-      pts = new double[2 * num_points];
-      X = new TMRPoint[num_points];
-      quads = new int[4 * num_quads];
+  The key is computed from the mesh type, the parameter locations of
+  the boundary points and a grid of sample points over the parameter
+  range of the face, along with the feature size and the meshing
+  options. Returns a non-zero fail flag if the feature size cannot be
+  fingerprinted and the mesh is not cached.
+*/
+int TMRFaceMesh::computeCacheKey(TMRMeshOptions options,
+                                 TMRElementFeatureSize *fs, int nloops,
+                                 const int *loop_pt_offset,
+                                 const double *params, int num_degen,
+                                 const int *degen, uint64_t *key) {
+  const int nsamples = 17;
+
+  TMRMeshFingerprint fingerprint;
+  fingerprint.add((int)mesh_type);
+  fingerprint.add(face->getOrientation());
+  fingerprint.add(nloops);
+  fingerprint.add(loop_pt_offset, (nloops + 1) * sizeof(int));
+  fingerprint.add(params, 2 * loop_pt_offset[nloops] * sizeof(double));
+  fingerprint.add(num_degen);
+  if (num_degen > 0) {
+    fingerprint.add(degen, 2 * num_degen * sizeof(int));
+  }
+  fingerprint.addOptions(options);
+
+  // Sample the surface over the parameter range
+  double umin, vmin, umax, vmax;
+  face->getRange(&umin, &vmin, &umax, &vmax);
+
+  double *prm = new double[2 * nsamples * nsamples];
+  TMRPoint *Xs = new TMRPoint[nsamples * nsamples];
+  for (int j = 0; j < nsamples; j++) {
+    for (int i = 0; i < nsamples; i++) {
+      int k = i + nsamples * j;
+      prm[2 * k] = umin + (umax - umin) * i / (nsamples - 1);
+      prm[2 * k + 1] = vmin + (vmax - vmin) * j / (nsamples - 1);
     }
+  }
+  face->evalPoints(nsamples * nsamples, prm, Xs);
+  fingerprint.addPoints(nsamples * nsamples, Xs);
+
+  delete[] prm;
+  delete[] Xs;
+
+  int fail = fingerprint.addFeatureSize(fs);
+  *key = fingerprint.hash;
+
+  return fail;
+}
 
-    // Broadcast the parametric locations and points
-    MPI_Bcast(pts, 2 * num_points, MPI_DOUBLE, 0, comm);
-    MPI_Bcast(X, num_points, TMRPoint_MPI_type, 0, comm);
-    MPI_Bcast(quads, 4 * num_quads, MPI_INT, 0, comm);
+/*
+  Read the face mesh from the cache. Returns 0 on success.
+*/
+int TMRFaceMesh::readFromCache(const char *filename, uint64_t key) {
+  FILE *fp = TMR_OpenMeshCacheFile(filename, key);
+  if (!fp) {
+    return 1;
+  }
 
-    // Broadcast the source to target information
-    if (source) {
-      if (mpi_rank != 0) {
-        source_to_target = new int[num_points];
+  int fail = 1;
+  int temp[5];
+  if (fread(temp, sizeof(int), 5, fp) == 5 && temp[0] == mesh_type &&
+      temp[2] >= temp[1] && temp[2] >= 0 && temp[3] >= 0 && temp[4] >= 0) {
+    int npts = temp[2], nquads = temp[3], ntris = temp[4];
+    double *p = new double[2 * npts];
+    TMRPoint *Xp = new TMRPoint[npts];
+    int *q = (nquads > 0 ? new int[4 * nquads] : NULL);
+    int *t = (ntris > 0 ? new int[3 * ntris] : NULL);
+    if (fread(p, sizeof(double), 2 * npts, fp) == (size_t)(2 * npts) &&
+        fread(Xp, sizeof(TMRPoint), npts, fp) == (size_t)npts &&
+        (!q || fread(q, sizeof(int), 4 * nquads, fp) == (size_t)(4 * nquads)) &&
+        (!t || fread(t, sizeof(int), 3 * ntris, fp) == (size_t)(3 * ntris))) {
+      num_fixed_pts = temp[1];
+      num_points = npts;
+      pts = p;
+      X = Xp;
+      num_quads = nquads;
+      quads = q;
+      num_tris = ntris;
+      tris = t;
+      fail = 0;
+    } else {
+      delete[] p;
+      delete[] Xp;
+      if (q) {
+        delete[] q;
       }
-      MPI_Bcast(source_to_target, num_points, MPI_INT, 0, comm);
-    } else if (copy) {
-      if (mpi_rank != 0) {
-        copy_to_target = new int[num_points];
+      if (t) {
+        delete[] t;
       }
-      MPI_Bcast(copy_to_target, num_points, MPI_INT, 0, comm);
     }
   }
+  fclose(fp);
+
+  return fail;
+}
+
+/*
+  Write the face mesh to the cache
+*/
+void TMRFaceMesh::writeToCache(const char *filename, uint64_t key) {
+  char tmp_file[1100];
+  FILE *fp =
+      TMR_CreateMeshCacheFile(filename, key, tmp_file, sizeof(tmp_file));
+  if (fp) {
+    int temp[5];
+    temp[0] = mesh_type;
+    temp[1] = num_fixed_pts;
+    temp[2] = num_points;
+    temp[3] = num_quads;
+    temp[4] = num_tris;
+    int fail = (fwrite(temp, sizeof(int), 5, fp) != 5 ||
+                fwrite(pts, sizeof(double), 2 * num_points, fp) !=
+                    (size_t)(2 * num_points) ||
+                fwrite(X, sizeof(TMRPoint), num_points, fp) !=
+                    (size_t)num_points);
+    if (!fail && num_quads > 0) {
+      fail = (fwrite(quads, sizeof(int), 4 * num_quads, fp) !=
+              (size_t)(4 * num_quads));
+    }
+    if (!fail && num_tris > 0) {
+      fail = (fwrite(tris, sizeof(int), 3 * num_tris, fp) !=
+              (size_t)(3 * num_tris));
+    }
+    TMR_CloseMeshCacheFile(fp, tmp_file, filename, fail);
+  }
+}
+
+/*
+  Broadcast the face mesh from the root processor to all processors
+  in the communicator.
+
+  This is used when the face has been meshed independently on the
+  root processor. The communicator stored in the object is replaced
+  by the input communicator.
+
+  input:
+  _comm:   the communicator to distribute the mesh over
+  root:    the rank of the processor that owns the mesh
+*/
+void TMRFaceMesh::broadcastMesh(MPI_Comm _comm, int root) {
+  comm = _comm;
+
+  int mpi_rank;
+  MPI_Comm_rank(comm, &mpi_rank);
+
+  // Broadcast the number of points to all the processors
+  int temp[7];
+  temp[0] = num_points;
+  temp[1] = num_quads;
+  temp[2] = num_tris;
+  temp[3] = num_fixed_pts;
+  temp[4] = mesh_type;
+  temp[5] = (source_to_target != NULL);
+  temp[6] = (copy_to_target != NULL);
+  MPI_Bcast(temp, 7, MPI_INT, root, comm);
+
+  if (mpi_rank != root) {
+    num_points = temp[0];
+    num_quads = temp[1];
+    num_tris = temp[2];
+    num_fixed_pts = temp[3];
+    mesh_type = (TMRFaceMeshType)temp[4];
+
+    pts = new double[2 * num_points];
+    X = new TMRPoint[num_points];
+    quads = new int[4 * num_quads];
+    if (num_tris > 0) {
+      tris = new int[3 * num_tris];
+    }
+    if (temp[5]) {
+      source_to_target = new int[num_points];
+    }
+    if (temp[6]) {
+      copy_to_target = new int[num_points];
+    }
+  }
+
+  // Broadcast the parametric locations and points
+  MPI_Bcast(pts, 2 * num_points, MPI_DOUBLE, root, comm);
+  MPI_Bcast(X, num_points, TMRPoint_MPI_type, root, comm);
+  MPI_Bcast(quads, 4 * num_quads, MPI_INT, root, comm);
+  if (num_tris > 0) {
+    MPI_Bcast(tris, 3 * num_tris, MPI_INT, root, comm);
+  }
+
+  // Broadcast the source to target information
+  if (temp[5]) {
+    MPI_Bcast(source_to_target, num_points, MPI_INT, root, comm);
+  }
+  if (temp[6]) {
+    MPI_Bcast(copy_to_target, num_points, MPI_INT, root, comm);
+  }
 }
 
 /*
@@ -1111,9 +1331,7 @@ void TMRFaceMesh::mapSourceToTarget(TMRMeshOptions options,
 
   // Evaluate the points
   X = new TMRPoint[num_points];
-  for (int i = 0; i < num_points; i++) {
-    face->evalPoint(pts[2 * i], pts[2 * i + 1], &X[i]);
-  }
+  face->evalPoints(num_points, pts, X);
 
   if (num_quads > 0) {
     // Smooth the copied mesh on the new surface
@@ -1123,9 +1341,11 @@ void TMRFaceMesh::mapSourceToTarget(TMRMeshOptions options,
                            &pts_to_quads);
 
     // Smooth the mesh using a local optimization of node locations
+    double t0 = MPI_Wtime();
     TMR_QuadSmoothing(options.num_smoothing_steps, num_fixed_pts, num_points,
                       pts_to_quad_ptr, pts_to_quads, num_quads, quads, pts, X,
-                      face);
+                      face, options.smoothing_tolerance);
+    stats.smooth_time += MPI_Wtime() - t0;
 
     // Free the connectivity information
     delete[] pts_to_quad_ptr;
@@ -1138,15 +1358,18 @@ void TMRFaceMesh::mapSourceToTarget(TMRMeshOptions options,
                               &tri_edges, &tri_neighbors, &dual_edges);
 
     // Smooth the resulting triangular mesh
+    double t0 = MPI_Wtime();
     if (options.tri_smoothing_type == TMRMeshOptions::TMR_LAPLACIAN) {
       TMR_LaplacianSmoothing(options.num_smoothing_steps, num_fixed_pts,
                              num_tri_edges, tri_edges, num_points, pts, X,
-                             face);
+                             face, options.smoothing_tolerance);
     } else {
       double alpha = 0.1;
       TMR_SpringSmoothing(options.num_smoothing_steps, alpha, num_fixed_pts,
-                          num_tri_edges, tri_edges, num_points, pts, X, face);
+                          num_tri_edges, tri_edges, num_points, pts, X, face,
+                          options.smoothing_tolerance);
     }
+    stats.smooth_time += MPI_Wtime() - t0;
 
     delete[] tri_edges;
     delete[] tri_neighbors;
@@ -1399,23 +1622,17 @@ int TMRFaceMesh::mapCopyToTarget(TMRMeshOptions options, const double *params) {
     }
 
     // Allocate and evaluate the new physical point locations
-    for (int i = 0; i < num_points; i++) {
-      face->evalPoint(pts[2 * i], pts[2 * i + 1], &X[i]);
-    }
+    face->evalPoints(num_points, pts, X);
 
     double atol = 1e-6;
+    int *match = new int[num_points];
+    copy_mesh->matchMeshPoints(num_points, X, atol, match);
     for (int i = 0; i < num_points; i++) {
-      TMRPoint a = X[i];
-      for (int j = 0; j < num_points; j++) {
-        TMRPoint b = copy_mesh->X[j];
-
-        if (((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y) +
-             (a.z - b.z) * (a.z - b.z)) < atol * atol) {
-          copy_to_target[j] = i;
-          break;
-        }
+      if (match[i] >= 0) {
+        copy_to_target[match[i]] = i;
       }
     }
+    delete[] match;
 
     /*
 
@@ -1462,19 +1679,21 @@ int TMRFaceMesh::mapCopyToTarget(TMRMeshOptions options, const double *params) {
     for (int i = num_fixed_pts; i < num_points; i++) {
       copy_to_target[i] = i;
       X[i] = copy_mesh->X[i];
-      double u, v;
-      int icode = face->invEvalPoint(X[i], &u, &v);
+    }
+
+    // Project all of the interior points onto the face in a single
+    // pass so that the surface can batch the inverse evaluations
+    int nint = num_points - num_fixed_pts;
+    if (nint > 0) {
+      int icode = face->invEvalPoints(nint, &X[num_fixed_pts],
+                                      &pts[2 * num_fixed_pts]);
       if (icode) {
         fprintf(stderr,
                 "TMRFaceMesh Error: Inverse point evaluation "
                 "failed with code %d\n",
                 icode);
       }
-
-      // Set the target index
-      pts[2 * i] = u;
-      pts[2 * i + 1] = v;
-      face->evalPoint(u, v, &X[i]);
+      face->evalPoints(nint, &pts[2 * num_fixed_pts], &X[num_fixed_pts]);
     }
 
     // Copy over the quadrilaterals
@@ -1497,6 +1716,63 @@ int TMRFaceMesh::mapCopyToTarget(TMRMeshOptions options, const double *params) {
   return 0;
 }
 
+/*
+  Find the mesh points that lie within a distance atol of each of the
+  given points.
+
+  The mesh points are sorted by their x-coordinate the first time this
+  is called, so that each search only checks the points within a
+  narrow slab. The sorted points are kept since the same copy source
+  mesh is often used by many target faces.
+
+  input:
+  npts:   the number of points to match
+  Xpts:   the point locations
+  atol:   the matching tolerance
+
+  output:
+  match:  the lowest index of a coincident mesh point (or -1)
+*/
+void TMRFaceMesh::matchMeshPoints(int npts, const TMRPoint *Xpts, double atol,
+                                  int *match) {
+  if (!sorted_pts) {
+    sorted_pts = new TMRFacePointKey[num_points];
+    for (int i = 0; i < num_points; i++) {
+      sorted_pts[i].x = X[i].x;
+      sorted_pts[i].index = i;
+    }
+    qsort(sorted_pts, num_points, sizeof(TMRFacePointKey),
+          compare_face_point_keys);
+  }
+
+  for (int i = 0; i < npts; i++) {
+    const TMRPoint a = Xpts[i];
+    match[i] = -1;
+
+    // Find the first point with x >= a.x - atol
+    int low = 0, high = num_points;
+    while (low < high) {
+      int mid = low + (high - low) / 2;
+      if (sorted_pts[mid].x < a.x - atol) {
+        low = mid + 1;
+      } else {
+        high = mid;
+      }
+    }
+
+    for (int k = low; k < num_points && sorted_pts[k].x <= a.x + atol; k++) {
+      int j = sorted_pts[k].index;
+      TMRPoint b = X[j];
+      if (((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y) +
+           (a.z - b.z) * (a.z - b.z)) < atol * atol) {
+        if (match[i] < 0 || j < match[i]) {
+          match[i] = j;
+        }
+      }
+    }
+  }
+}
+
 /*
   Create a structured mesh
 */
@@ -1611,9 +1887,7 @@ void TMRFaceMesh::createStructuredMesh(TMRMeshOptions options,
 
   // Allocate and evaluate the new physical point locations
   X = new TMRPoint[num_points];
-  for (int i = 0; i < num_points; i++) {
-    face->evalPoint(pts[2 * i], pts[2 * i + 1], &X[i]);
-  }
+  face->evalPoints(num_points, pts, X);
 
   if (num_quads > 0) {
     // Smooth the copied mesh on the new surface
@@ -1623,9 +1897,11 @@ void TMRFaceMesh::createStructuredMesh(TMRMeshOptions options,
                            &pts_to_quads);
 
     // Smooth the mesh using a local optimization of node locations
+    double t0 = MPI_Wtime();
     TMR_QuadSmoothing(options.num_smoothing_steps, num_fixed_pts, num_points,
                       pts_to_quad_ptr, pts_to_quads, num_quads, quads, pts, X,
-                      face);
+                      face, options.smoothing_tolerance);
+    stats.smooth_time += MPI_Wtime() - t0;
 
     // Free the connectivity information
     delete[] pts_to_quad_ptr;
@@ -1633,6 +1909,490 @@ void TMRFaceMesh::createStructuredMesh(TMRMeshOptions options,
   }
 }
 
+/*
+  The centroid and estimated cost of a triangle in the boundary
+  triangulation, used to partition the face into subdomains
+*/
+class TMRSubdomainKey {
+ public:
+  double c[2];  // Parametric centroid
+  double w;     // Estimated number of triangles in the final mesh
+  int tri;      // Triangle index
+};
+
+static int compare_subdomain_keys_x(const void *avoid, const void *bvoid) {
+  const TMRSubdomainKey *a = static_cast<const TMRSubdomainKey *>(avoid);
+  const TMRSubdomainKey *b = static_cast<const TMRSubdomainKey *>(bvoid);
+  if (a->c[0] < b->c[0]) {
+    return -1;
+  } else if (a->c[0] > b->c[0]) {
+    return 1;
+  }
+  return a->tri - b->tri;
+}
+
+static int compare_subdomain_keys_y(const void *avoid, const void *bvoid) {
+  const TMRSubdomainKey *a = static_cast<const TMRSubdomainKey *>(avoid);
+  const TMRSubdomainKey *b = static_cast<const TMRSubdomainKey *>(bvoid);
+  if (a->c[1] < b->c[1]) {
+    return -1;
+  } else if (a->c[1] > b->c[1]) {
+    return 1;
+  }
+  return a->tri - b->tri;
+}
+
+/*
+  Assign the triangles to nparts parts by recursive coordinate
+  bisection of their centroids, balancing the estimated cost
+*/
+static void TMR_BisectSubdomains(int n, TMRSubdomainKey *keys, int nparts,
+                                 int part_offset, int *part) {
+  if (nparts <= 1 || n <= 1) {
+    for (int i = 0; i < n; i++) {
+      part[keys[i].tri] = part_offset;
+    }
+    return;
+  }
+
+  // Split along the longest direction of the bounding box
+  double low[2] = {keys[0].c[0], keys[0].c[1]};
+  double high[2] = {keys[0].c[0], keys[0].c[1]};
+  double wtotal = 0.0;
+  for (int i = 0; i < n; i++) {
+    for (int d = 0; d < 2; d++) {
+      if (keys[i].c[d] < low[d]) {
+        low[d] = keys[i].c[d];
+      }
+      if (keys[i].c[d] > high[d]) {
+        high[d] = keys[i].c[d];
+      }
+    }
+    wtotal += keys[i].w;
+  }
+  if (high[0] - low[0] >= high[1] - low[1]) {
+    qsort(keys, n, sizeof(TMRSubdomainKey), compare_subdomain_keys_x);
+  } else {
+    qsort(keys, n, sizeof(TMRSubdomainKey), compare_subdomain_keys_y);
+  }
+
+  // Find the split that balances the cost between the two halves
+  int nleft = nparts / 2;
+  double wtarget = (wtotal * nleft) / nparts;
+  double wsum = 0.0;
+  int split = 0;
+  while (split < n - 1 && wsum + 0.5 * keys[split].w < wtarget) {
+    wsum += keys[split].w;
+    split++;
+  }
+  if (split == 0) {
+    split = 1;
+  }
+
+  TMR_BisectSubdomains(split, keys, nleft, part_offset, part);
+  TMR_BisectSubdomains(n - split, &keys[split], nparts - nleft,
+                       part_offset + nleft, part);
+}
+
+/*
+  The data for triangulating a single subdomain on a thread
+*/
+class TMRSubdomainData {
+ public:
+  TMRTriangularize *tri;
+  TMRMeshOptions *options;
+  TMRElementFeatureSize *fs;
+};
+
+static void *TMR_SubdomainFrontalThread(void *arg) {
+  TMRSubdomainData *data = static_cast<TMRSubdomainData *>(arg);
+  data->tri->frontal(*data->options, data->fs);
+  return NULL;
+}
+
+/*
+  Triangulate a large face by splitting its parameter domain into
+  subdomains that are meshed concurrently.
+
+  The boundary points are first triangulated without adding interior
+  points. The triangles of this boundary triangulation are divided
+  into parts by recursive coordinate bisection, balancing the
+  estimated number of triangles in the final mesh. Each edge between
+  two parts is discretized with points spaced by the local feature
+  size, and these points are shared by the subdomains on both sides.
+  Each subdomain is triangulated with the frontal algorithm on its own
+  thread, with hole points placed in the neighboring parts. The
+  subdomain meshes are then stitched together through the shared
+  points, so the triangles can be recombined and smoothed as a single
+  mesh. The interface points are not fixed and are free to move
+  during smoothing.
+
+  The geometry evaluation and feature size must be thread-safe. The
+  triangulator objects are created and destroyed on the calling
+  thread since the reference counts are not atomic.
+
+  Return 0 if the face was split and a non-zero value otherwise. The
+  output is the same as TMRTriangularize::getMesh().
+*/
+int TMRFaceMesh::createSubdomainTriangulation(
+    TMRMeshOptions options, TMRElementFeatureSize *fs,
+    const int total_num_pts, const int nholes, const double *params,
+    const int nsegs, const int *segments, int *npts, double **param_pts,
+    TMRPoint **Xpts, int *ntris, int **mesh_tris) {
+  // Triangulate the boundary without adding any interior points
+  TMRTriangularize *cdt = new TMRTriangularize(total_num_pts + nholes, params,
+                                               nholes, nsegs, segments, face);
+  cdt->incref();
+  int ncdt_pts, ncdt;
+  int *cdt_tris;
+  TMRPoint *Xcdt;
+  cdt->getMesh(&ncdt_pts, &ncdt, &cdt_tris, NULL, &Xcdt);
+  addPointLocationCounts(cdt);
+  cdt->decref();
+
+  // Estimate the number of triangles that each boundary triangle
+  // will contain in the final mesh
+  const double sqrt3 = 1.7320508075688772;
+  TMRSubdomainKey *keys = new TMRSubdomainKey[ncdt];
+  double wtotal = 0.0;
+  for (int i = 0; i < ncdt; i++) {
+    const int *t = &cdt_tris[3 * i];
+    TMRPoint d1, d2, c;
+    d1.x = Xcdt[t[1]].x - Xcdt[t[0]].x;
+    d1.y = Xcdt[t[1]].y - Xcdt[t[0]].y;
+    d1.z = Xcdt[t[1]].z - Xcdt[t[0]].z;
+    d2.x = Xcdt[t[2]].x - Xcdt[t[0]].x;
+    d2.y = Xcdt[t[2]].y - Xcdt[t[0]].y;
+    d2.z = Xcdt[t[2]].z - Xcdt[t[0]].z;
+    c.x = (Xcdt[t[0]].x + Xcdt[t[1]].x + Xcdt[t[2]].x) / 3.0;
+    c.y = (Xcdt[t[0]].y + Xcdt[t[1]].y + Xcdt[t[2]].y) / 3.0;
+    c.z = (Xcdt[t[0]].z + Xcdt[t[1]].z + Xcdt[t[2]].z) / 3.0;
+
+    TMRPoint n;
+    n.x = d1.y * d2.z - d1.z * d2.y;
+    n.y = d1.z * d2.x - d1.x * d2.z;
+    n.z = d1.x * d2.y - d1.y * d2.x;
+    double area = 0.5 * sqrt(n.dot(n));
+    double h = fs->getFeatureSize(c);
+
+    keys[i].c[0] =
+        (params[2 * t[0]] + params[2 * t[1]] + params[2 * t[2]]) / 3.0;
+    keys[i].c[1] =
+        (params[2 * t[0] + 1] + params[2 * t[1] + 1] + params[2 * t[2] + 1]) /
+        3.0;
+    keys[i].w = area / (0.25 * sqrt3 * h * h);
+    keys[i].tri = i;
+    wtotal += keys[i].w;
+  }
+
+  // Set the number of subdomains
+  int nparts = options.num_frontal_subdomains;
+  if (options.frontal_subdomain_min_triangles > 0) {
+    int max_parts = (int)(wtotal / options.frontal_subdomain_min_triangles);
+    if (nparts > max_parts) {
+      nparts = max_parts;
+    }
+  }
+  if (nparts > ncdt) {
+    nparts = ncdt;
+  }
+  if (nparts < 2) {
+    delete[] keys;
+    delete[] cdt_tris;
+    delete[] Xcdt;
+    return 1;
+  }
+
+  // Partition the boundary triangles
+  int *part = new int[ncdt];
+  TMR_BisectSubdomains(ncdt, keys, nparts, 0, part);
+  delete[] keys;
+
+  // Compute the edges of the boundary triangulation
+  int num_cdt_edges;
+  int *cdt_edges, *cdt_neighbors, *cdt_dual;
+  TMR_ComputePlanarTriEdges(ncdt_pts, ncdt, cdt_tris, &num_cdt_edges,
+                            &cdt_edges, &cdt_neighbors, &cdt_dual);
+  delete[] cdt_neighbors;
+
+  // Record the segments of the input
+  std::set<std::pair<int, int> > seg_set;
+  for (int i = 0; i < nsegs; i++) {
+    int u = segments[2 * i], v = segments[2 * i + 1];
+    if (u > v) {
+      int tmp = u;
+      u = v;
+      v = tmp;
+    }
+    seg_set.insert(std::pair<int, int>(u, v));
+  }
+
+  // Discretize the interface edges between parts that are not in the
+  // input segments. The new points are numbered after the input
+  // points, so that the interface points for edge i are numbered
+  // iface_ptr[i] to iface_ptr[i+1]-1.
+  int *iface_ptr = new int[num_cdt_edges + 1];
+  std::vector<double> iface_pts;
+  iface_ptr[0] = ncdt_pts;
+  for (int i = 0; i < num_cdt_edges; i++) {
+    iface_ptr[i + 1] = iface_ptr[i];
+    int t1 = cdt_dual[2 * i], t2 = cdt_dual[2 * i + 1];
+    if (t1 < 0 || t2 < 0 || part[t1] == part[t2]) {
+      continue;
+    }
+    int u = cdt_edges[2 * i], v = cdt_edges[2 * i + 1];
+    if (seg_set.count(std::pair<int, int>(u < v ? u : v, u < v ? v : u))) {
+      continue;
+    }
+
+    // Integrate ds/h along the straight line in parameter space. The
+    // line is resampled once the number of points is known.
+    const double *pu = &params[2 * u];
+    const double *pv = &params[2 * v];
+    int nsamples = 32;
+    std::vector<double> s;
+    for (int pass = 0; pass < 2; pass++) {
+      s.assign(nsamples + 1, 0.0);
+      TMRPoint Xprev = Xcdt[u];
+      double hprev = fs->getFeatureSize(Xprev);
+      for (int k = 1; k <= nsamples; k++) {
+        double f = 1.0 * k / nsamples;
+        TMRPoint Xk;
+        face->evalPoint((1.0 - f) * pu[0] + f * pv[0],
+                        (1.0 - f) * pu[1] + f * pv[1], &Xk);
+        double hk = fs->getFeatureSize(Xk);
+        TMRPoint d;
+        d.x = Xk.x - Xprev.x;
+        d.y = Xk.y - Xprev.y;
+        d.z = Xk.z - Xprev.z;
+        s[k] = s[k - 1] + 2.0 * sqrt(d.dot(d)) / (hk + hprev);
+        Xprev = Xk;
+        hprev = hk;
+      }
+      int n = (int)(s[nsamples] + 0.5);
+      if (pass > 0 || 4 * n <= nsamples) {
+        break;
+      }
+      nsamples = 4 * n;
+    }
+
+    // Place the points at equal increments of the integral
+    int n = (int)(s[nsamples] + 0.5);
+    for (int j = 1, k = 0; j < n; j++) {
+      double target = (s[nsamples] * j) / n;
+      while (k < nsamples - 1 && s[k + 1] < target) {
+        k++;
+      }
+      double f = (k + (target - s[k]) / (s[k + 1] - s[k])) / nsamples;
+      iface_pts.push_back((1.0 - f) * pu[0] + f * pv[0]);
+      iface_pts.push_back((1.0 - f) * pu[1] + f * pv[1]);
+      iface_ptr[i + 1]++;
+    }
+  }
+  int num_iface_pts = iface_ptr[num_cdt_edges] - ncdt_pts;
+
+  // Create the triangulation of each subdomain. The local points are
+  // the points of the subdomain, followed by the hole points.
+  TMRSubdomainData *data = new TMRSubdomainData[nparts];
+  int **local_to_global = new int *[nparts];
+  int *num_local = new int[nparts];
+  int *local = new int[ncdt_pts + num_iface_pts];
+  for (int i = 0; i < ncdt_pts + num_iface_pts; i++) {
+    local[i] = -1;
+  }
+
+  for (int p = 0; p < nparts; p++) {
+    std::vector<int> l2g;
+    std::vector<int> segs;
+    std::set<int> hole_tris;
+
+    // Add the vertices of the triangles in this part
+    for (int i = 0; i < ncdt; i++) {
+      if (part[i] == p) {
+        for (int j = 0; j < 3; j++) {
+          int u = cdt_tris[3 * i + j];
+          if (local[u] < 0) {
+            local[u] = l2g.size();
+            l2g.push_back(u);
+          }
+        }
+      }
+    }
+
+    // Add the segments bounding the part and the input segments
+    // within the part
+    for (int i = 0; i < num_cdt_edges; i++) {
+      int t1 = cdt_dual[2 * i], t2 = cdt_dual[2 * i + 1];
+      int in1 = (t1 >= 0 && part[t1] == p);
+      int in2 = (t2 >= 0 && part[t2] == p);
+      if (!in1 && !in2) {
+        continue;
+      }
+
+      int u = cdt_edges[2 * i], v = cdt_edges[2 * i + 1];
+      int is_seg = seg_set.count(
+          std::pair<int, int>(u < v ? u : v, u < v ? v : u));
+      if (in1 && in2) {
+        if (is_seg) {
+          segs.push_back(local[u]);
+          segs.push_back(local[v]);
+        }
+        continue;
+      }
+
+      // Record the neighboring triangle, which lies outside this part
+      int t = (in1 ? t2 : t1);
+      if (t >= 0) {
+        hole_tris.insert(t);
+      }
+
+      // Add the segment, or the chain of interface segments
+      int prev = local[u];
+      for (int k = iface_ptr[i]; k < iface_ptr[i + 1]; k++) {
+        if (local[k] < 0) {
+          local[k] = l2g.size();
+          l2g.push_back(k);
+        }
+        segs.push_back(prev);
+        segs.push_back(local[k]);
+        prev = local[k];
+      }
+      segs.push_back(prev);
+      segs.push_back(local[v]);
+    }
+
+    // Reset the local numbering for the next part
+    int nlocal = l2g.size();
+    for (int i = 0; i < nlocal; i++) {
+      local[l2g[i]] = -1;
+    }
+
+    // Set the local point locations followed by the hole points: the
+    // holes within the face and the centroids of the neighboring
+    // triangles in other parts
+    int nlocal_holes = hole_tris.size() + nholes;
+    double *local_pts = new double[2 * (nlocal + nlocal_holes)];
+    for (int i = 0; i < nlocal; i++) {
+      const double *pt = &params[2 * l2g[i]];
+      if (l2g[i] >= ncdt_pts) {
+        pt = &iface_pts[2 * (l2g[i] - ncdt_pts)];
+      }
+      local_pts[2 * i] = pt[0];
+      local_pts[2 * i + 1] = pt[1];
+    }
+    for (int i = 0; i < 2 * nholes; i++) {
+      local_pts[2 * nlocal + i] = params[2 * total_num_pts + i];
+    }
+    double *h = &local_pts[2 * (nlocal + nholes)];
+    for (std::set<int>::iterator it = hole_tris.begin(); it != hole_tris.end();
+         it++, h += 2) {
+      const int *tri = &cdt_tris[3 * (*it)];
+      h[0] =
+          (params[2 * tri[0]] + params[2 * tri[1]] + params[2 * tri[2]]) / 3.0;
+      h[1] = (params[2 * tri[0] + 1] + params[2 * tri[1] + 1] +
+              params[2 * tri[2] + 1]) /
+             3.0;
+    }
+
+    data[p].tri = new TMRTriangularize(nlocal + nlocal_holes, local_pts,
+                                       nlocal_holes, segs.size() / 2,
+                                       segs.data(), face);
+    data[p].tri->incref();
+    data[p].options = &options;
+    data[p].fs = fs;
+    delete[] local_pts;
+
+    num_local[p] = nlocal;
+    local_to_global[p] = new int[nlocal];
+    memcpy(local_to_global[p], l2g.data(), nlocal * sizeof(int));
+  }
+
+  delete[] local;
+  delete[] part;
+  delete[] cdt_tris;
+  delete[] cdt_edges;
+  delete[] cdt_dual;
+  delete[] iface_ptr;
+
+  // Triangulate the subdomains concurrently
+  pthread_t *threads = new pthread_t[nparts];
+  for (int p = 0; p < nparts; p++) {
+    pthread_create(&threads[p], NULL, TMR_SubdomainFrontalThread,
+                   (void *)&data[p]);
+  }
+  for (int p = 0; p < nparts; p++) {
+    pthread_join(threads[p], NULL);
+  }
+  delete[] threads;
+
+  // Retrieve the subdomain meshes
+  int *part_npts = new int[nparts];
+  int *part_ntris = new int[nparts];
+  int **part_tris = new int *[nparts];
+  double **part_pts = new double *[nparts];
+  TMRPoint **part_X = new TMRPoint *[nparts];
+  int total_pts = ncdt_pts + num_iface_pts;
+  int total_tris = 0;
+  for (int p = 0; p < nparts; p++) {
+    data[p].tri->getMesh(&part_npts[p], &part_ntris[p], &part_tris[p],
+                         &part_pts[p], &part_X[p]);
+    addPointLocationCounts(data[p].tri);
+    data[p].tri->decref();
+    total_pts += part_npts[p] - num_local[p];
+    total_tris += part_ntris[p];
+  }
+  delete[] data;
+
+  // Stitch the subdomain meshes together. The input points and the
+  // interface points keep their numbers and the interior points of
+  // each subdomain are appended in order.
+  *npts = total_pts;
+  *ntris = total_tris;
+  *param_pts = new double[2 * total_pts];
+  *Xpts = new TMRPoint[total_pts];
+  *mesh_tris = new int[3 * total_tris];
+
+  int pt_offset = ncdt_pts + num_iface_pts;
+  int *t = *mesh_tris;
+  for (int p = 0; p < nparts; p++) {
+    int *l2g = local_to_global[p];
+    for (int i = 0; i < part_npts[p]; i++) {
+      int g = (i < num_local[p] ? l2g[i] : pt_offset + i - num_local[p]);
+      (*param_pts)[2 * g] = part_pts[p][2 * i];
+      (*param_pts)[2 * g + 1] = part_pts[p][2 * i + 1];
+      (*Xpts)[g] = part_X[p][i];
+    }
+    for (int i = 0; i < 3 * part_ntris[p]; i++) {
+      int l = part_tris[p][i];
+      t[i] = (l < num_local[p] ? l2g[l] : pt_offset + l - num_local[p]);
+    }
+    t += 3 * part_ntris[p];
+    pt_offset += part_npts[p] - num_local[p];
+
+    delete[] part_tris[p];
+    delete[] part_pts[p];
+    delete[] part_X[p];
+    delete[] local_to_global[p];
+  }
+
+  if (options.triangularize_print_level > 0) {
+    printf("TMRFaceMesh: Face %d split into %d subdomains with %d "
+           "interface points\n",
+           face->getEntityId(), nparts, num_iface_pts);
+  }
+
+  delete[] part_npts;
+  delete[] part_ntris;
+  delete[] part_tris;
+  delete[] part_pts;
+  delete[] part_X;
+  delete[] local_to_global;
+  delete[] num_local;
+  delete[] Xcdt;
+
+  return 0;
+}
+
 /*
   Create the unstructured mesh using the Quad-Blossom algorithm
 */
@@ -1652,36 +2412,51 @@ void TMRFaceMesh::createUnstructuredMesh(
   *ntris = 0;
   *mesh_tris = NULL;
 
-  // Create the triangularization class
-  TMRTriangularize *tri = new TMRTriangularize(total_num_pts + nholes, params,
-                                               nholes, nsegs, segments, face);
-  tri->incref();
-
-  if (options.write_init_domain_triangle) {
-    char filename[256];
-    snprintf(filename, sizeof(filename), "init_domain_triangle%d.vtk",
-             face->getEntityId());
-    tri->writeToVTK(filename);
+  // Split large faces into subdomains that are triangulated
+  // concurrently. Faces with degenerate edges are not split.
+  double t0 = MPI_Wtime();
+  int split = 0;
+  if (options.num_frontal_subdomains > 1 && num_degen == 0) {
+    split = (createSubdomainTriangulation(options, fs, total_num_pts, nholes,
+                                          params, nsegs, segments, npts,
+                                          param_pts, Xpts, ntris,
+                                          mesh_tris) == 0);
   }
 
-  // Create the mesh using the frontal algorithm
-  tri->frontal(options, fs);
+  if (!split) {
+    // Create the triangularization class
+    TMRTriangularize *tri = new TMRTriangularize(
+        total_num_pts + nholes, params, nholes, nsegs, segments, face);
+    tri->incref();
 
-  // Free the degenerate triangles and reorder the mesh
-  if (num_degen > 0) {
-    tri->removeDegenerateEdges(num_degen, degen);
-  }
+    if (options.write_init_domain_triangle) {
+      char filename[256];
+      snprintf(filename, sizeof(filename), "init_domain_triangle%d.vtk",
+               face->getEntityId());
+      tri->writeToVTK(filename);
+    }
 
-  if (options.write_pre_smooth_triangle) {
-    char filename[256];
-    snprintf(filename, sizeof(filename), "pre_smooth_triangle%d.vtk",
-             face->getEntityId());
-    tri->writeToVTK(filename);
-  }
+    // Create the mesh using the frontal algorithm
+    tri->frontal(options, fs);
+
+    // Free the degenerate triangles and reorder the mesh
+    if (num_degen > 0) {
+      tri->removeDegenerateEdges(num_degen, degen);
+    }
+
+    if (options.write_pre_smooth_triangle) {
+      char filename[256];
+      snprintf(filename, sizeof(filename), "pre_smooth_triangle%d.vtk",
+               face->getEntityId());
+      tri->writeToVTK(filename);
+    }
 
-  // Extract the triangularization
-  tri->getMesh(npts, ntris, mesh_tris, param_pts, Xpts);
-  tri->decref();
+    // Extract the triangularization
+    tri->getMesh(npts, ntris, mesh_tris, param_pts, Xpts);
+    addPointLocationCounts(tri);
+    tri->decref();
+  }
+  stats.triangulate_time += MPI_Wtime() - t0;
 
   if (*ntris == 0) {
     fprintf(stderr, "TMRFaceMesh Warning: No triangles for mesh id %d\n",
@@ -1696,16 +2471,18 @@ void TMRFaceMesh::createUnstructuredMesh(
                               &node_to_tri_ptr, &node_to_tris);
 
     // Smooth the resulting triangular mesh
+    t0 = MPI_Wtime();
     if (options.tri_smoothing_type == TMRMeshOptions::TMR_LAPLACIAN) {
       TMR_LaplacianSmoothing(options.num_smoothing_steps, num_fixed_pts,
                              num_tri_edges, tri_edges, *npts, *param_pts, *Xpts,
-                             face);
+                             face, options.smoothing_tolerance);
     } else {
       double alpha = 0.1;
       TMR_SpringSmoothing(options.num_smoothing_steps, alpha, num_fixed_pts,
                           num_tri_edges, tri_edges, *npts, *param_pts, *Xpts,
-                          face);
+                          face, options.smoothing_tolerance);
     }
+    stats.smooth_time += MPI_Wtime() - t0;
 
     if (options.write_post_smooth_triangle) {
       char filename[256];
@@ -1716,6 +2493,7 @@ void TMRFaceMesh::createUnstructuredMesh(
 
     if (mesh_type == TMR_UNSTRUCTURED) {
       // Recombine the mesh into a quadrilateral mesh
+      t0 = MPI_Wtime();
       if (*ntris % 2 == 0) {
         recombine(*ntris, *mesh_tris, tri_neighbors, node_to_tri_ptr,
                   node_to_tris, num_tri_edges, dual_edges, nquads, mesh_quads,
@@ -1731,6 +2509,7 @@ void TMRFaceMesh::createUnstructuredMesh(
       for (int k = 0; k < 5; k++) {
         simplifyQuads(0);
       }
+      stats.recombine_time += MPI_Wtime() - t0;
 
       // Free the triangular mesh data
       delete[] tri_edges;
@@ -1775,6 +2554,22 @@ void TMRFaceMesh::createUnstructuredMesh(
   }
 }
 
+/*
+  Add the point location counts from a triangulation to the statistics
+*/
+void TMRFaceMesh::addPointLocationCounts(TMRTriangularize *tri) {
+  int num_walks, num_searches;
+  tri->getPointLocationCounts(&num_walks, &num_searches);
+  stats.num_locate_walks += num_walks;
+  stats.num_locate_searches += num_searches;
+}
+
+/*
+  Get the statistics recorded while meshing the face. These are only
+  set on the processor that meshed the face.
+*/
+void TMRFaceMesh::getMeshStats(TMRFaceMeshStats *_stats) { *_stats = stats; }
+
 /*
   Retrieve the mesh points and parametric locations
 */
@@ -2167,6 +2962,17 @@ int TMRFaceMesh::getNodeNums(const int **_vars) {
   return num_points;
 }
 
+/*
+  Replace the node numbers with new numbers from the global ordering
+*/
+void TMRFaceMesh::renumberNodes(const int *new_nums) {
+  if (vars) {
+    for (int i = 0; i < num_points; i++) {
+      vars[i] = new_nums[vars[i]];
+    }
+  }
+}
+
 /*
   Get the number of fixed points that are not ordered by this surface
   mesh
@@ -2362,6 +3168,449 @@ double TMRFaceMesh::computeTriQuality(const int *tri, const TMRPoint *p) {
   return eta;
 }
 
+/*
+  An edge in the dual graph along with its matching weight
+*/
+class TMRWeightedEdge {
+ public:
+  double weight;
+  int edge;
+};
+
+/*
+  Sort the weighted edges by increasing weight. Ties are broken by the
+  edge number so that the order is reproducible.
+*/
+static int compare_weighted_edges(const void *avoid, const void *bvoid) {
+  const TMRWeightedEdge *a = static_cast<const TMRWeightedEdge *>(avoid);
+  const TMRWeightedEdge *b = static_cast<const TMRWeightedEdge *>(bvoid);
+
+  if (a->weight < b->weight) {
+    return -1;
+  } else if (a->weight > b->weight) {
+    return 1;
+  }
+  return a->edge - b->edge;
+}
+
+/*
+  Find the closest common ancestor of the nodes a and b in the tree of
+  alternating paths. This is the base of the blossom formed by joining
+  the paths to a and b.
+*/
+static int find_blossom_base(int a, int b, const int *mate, const int *parent,
+                             const int *base, char *on_path, int *path) {
+  int npath = 0;
+  while (1) {
+    a = base[a];
+    on_path[a] = 1;
+    path[npath++] = a;
+    if (mate[a] < 0) {
+      break;
+    }
+    a = parent[mate[a]];
+  }
+
+  while (!on_path[base[b]]) {
+    b = parent[mate[base[b]]];
+  }
+  b = base[b];
+
+  for (int i = 0; i < npath; i++) {
+    on_path[path[i]] = 0;
+  }
+
+  return b;
+}
+
+/*
+  Mark the bases of the contracted blossoms along the path from v back
+  to the blossom base b, and point their parents across the blossom.
+  The marked bases are appended to the list of bases.
+*/
+static void mark_blossom_path(int v, int b, int child, const int *mate,
+                              int *parent, const int *base, char *blossom,
+                              int *nbases, int *bases) {
+  while (base[v] != b) {
+    for (int k = 0; k < 2; k++) {
+      int c = (k == 0 ? base[v] : base[mate[v]]);
+      if (!blossom[c]) {
+        blossom[c] = 1;
+        bases[(*nbases)++] = c;
+      }
+    }
+    parent[v] = child;
+    child = mate[v];
+    v = parent[mate[v]];
+  }
+}
+
+/*
+  Compute an approximate minimum-weight perfect matching
+
+  The edges are first matched greedily in order of increasing weight,
+  except that a node with only one remaining edge is matched along it
+  right away so that it is not left isolated. The nodes that are left
+  unmatched are then paired by searching for augmenting paths from
+  each unmatched node with Edmonds' blossom algorithm. The weights
+  are only used to restrict the searches to the cheaper edges in the
+  initial repair phases. The breadth-first search only visits the
+  nodes near the unmatched node in practice, so the repair is cheap
+  when the greedy matching leaves only a few unmatched nodes.
+
+  The matching is accepted if its weight is within the relative
+  tolerance of a lower bound on the optimal weight. The bound is half
+  the sum over all nodes of the smallest weight of an adjacent edge.
+
+  input:
+  nnodes:   the number of nodes in the graph
+  nedges:   the number of edges in the graph
+  edges:    the node numbers for each edge
+  weights:  the non-negative edge weights
+  tol:      the relative tolerance on the matching weight
+
+  output:
+  match:    the matched edge numbers
+
+  returns:  the number of matched edges or -1 if no perfect matching
+            within the tolerance was found
+*/
+static int greedy_perfect_match(int nnodes, int nedges, const int *edges,
+                                const double *weights, double tol,
+                                int *match) {
+  if (nnodes % 2 == 1 || nedges == 0) {
+    return -1;
+  }
+
+  // Compute the node to edge connectivity
+  int *ptr = new int[nnodes + 1];
+  memset(ptr, 0, (nnodes + 1) * sizeof(int));
+  for (int i = 0; i < nedges; i++) {
+    ptr[edges[2 * i] + 1]++;
+    ptr[edges[2 * i + 1] + 1]++;
+  }
+  for (int i = 0; i < nnodes; i++) {
+    ptr[i + 1] += ptr[i];
+  }
+  int *node_edges = new int[ptr[nnodes]];
+  for (int i = 0; i < nedges; i++) {
+    node_edges[ptr[edges[2 * i]]] = i;
+    ptr[edges[2 * i]]++;
+    node_edges[ptr[edges[2 * i + 1]]] = i;
+    ptr[edges[2 * i + 1]]++;
+  }
+  for (int i = nnodes; i > 0; i--) {
+    ptr[i] = ptr[i - 1];
+  }
+  ptr[0] = 0;
+
+  // Compute the lower bound on the weight of the matching
+  double lower_bound = 0.0;
+  for (int i = 0; i < nnodes; i++) {
+    double wmin = 0.0;
+    for (int jp = ptr[i]; jp < ptr[i + 1]; jp++) {
+      double w = weights[node_edges[jp]];
+      if (jp == ptr[i] || w < wmin) {
+        wmin = w;
+      }
+    }
+    lower_bound += 0.5 * wmin;
+  }
+
+  // Sort the edges by weight and match them greedily. The mate array
+  // stores the node matched to each node.
+  TMRWeightedEdge *sorted = new TMRWeightedEdge[nedges];
+  for (int i = 0; i < nedges; i++) {
+    sorted[i].weight = weights[i];
+    sorted[i].edge = i;
+  }
+  qsort(sorted, nedges, sizeof(TMRWeightedEdge), compare_weighted_edges);
+
+  // Set the weight thresholds for the repair phases as multiples of
+  // the median edge weight. The greedy matching only uses the edges
+  // below the second-to-last threshold, leaving the most expensive
+  // edges to the final repair phase.
+  const int num_phases = 4;
+  const double factors[num_phases - 1] = {2.0, 8.0, 32.0};
+  double wmedian = sorted[nedges / 2].weight;
+  double wmax[num_phases];
+  for (int k = 0; k < num_phases - 1; k++) {
+    wmax[k] = factors[k] * wmedian;
+  }
+  wmax[num_phases - 1] = sorted[nedges - 1].weight;
+  const double wgreedy = wmax[num_phases - 2];
+
+  // Count the number of edges to unmatched nodes for each node
+  int *mate = new int[nnodes];
+  int *degree = new int[nnodes];
+  int *forced = new int[nnodes];
+  int nforced = 0;
+  for (int i = 0; i < nnodes; i++) {
+    mate[i] = -1;
+    degree[i] = 0;
+    for (int jp = ptr[i]; jp < ptr[i + 1]; jp++) {
+      int e = node_edges[jp];
+      if (edges[2 * e] != edges[2 * e + 1] && weights[e] <= wgreedy) {
+        degree[i]++;
+      }
+    }
+    if (degree[i] == 1) {
+      forced[nforced++] = i;
+    }
+  }
+
+  // Match the nodes. A node with a single edge to an unmatched node
+  // is matched along that edge first, since otherwise it would be left
+  // isolated. Otherwise the lowest weight edge is matched.
+  int next = 0;
+  while (1) {
+    int u = -1, v = -1;
+    if (nforced > 0) {
+      u = forced[--nforced];
+      if (mate[u] >= 0 || degree[u] == 0) {
+        continue;
+      }
+      double wmin = 0.0;
+      for (int jp = ptr[u]; jp < ptr[u + 1]; jp++) {
+        int e = node_edges[jp];
+        int j = edges[2 * e] == u ? edges[2 * e + 1] : edges[2 * e];
+        if (j != u && mate[j] < 0 && weights[e] <= wgreedy &&
+            (v < 0 || weights[e] < wmin)) {
+          v = j;
+          wmin = weights[e];
+        }
+      }
+    } else {
+      while (next < nedges) {
+        int e = sorted[next].edge;
+        next++;
+        if (sorted[next - 1].weight > wgreedy) {
+          next = nedges;
+          break;
+        }
+        if (edges[2 * e] != edges[2 * e + 1] && mate[edges[2 * e]] < 0 &&
+            mate[edges[2 * e + 1]] < 0) {
+          u = edges[2 * e];
+          v = edges[2 * e + 1];
+          break;
+        }
+      }
+      if (u < 0) {
+        break;
+      }
+    }
+
+    mate[u] = v;
+    mate[v] = u;
+
+    // Update the degree of the unmatched neighbors
+    for (int k = 0; k < 2; k++) {
+      int x = (k == 0 ? u : v);
+      for (int jp = ptr[x]; jp < ptr[x + 1]; jp++) {
+        int e = node_edges[jp];
+        int j = edges[2 * e] == x ? edges[2 * e + 1] : edges[2 * e];
+        if (j != x && mate[j] < 0 && weights[e] <= wgreedy) {
+          degree[j]--;
+          if (degree[j] == 1) {
+            forced[nforced++] = j;
+          }
+        }
+      }
+    }
+  }
+  delete[] degree;
+  delete[] forced;
+
+  delete[] sorted;
+
+  // Allocate the data for the augmenting path search. Only the nodes
+  // that are reached by a search are reset afterwards.
+  int *parent = new int[nnodes];
+  int *base = new int[nnodes];
+  int *stamp = new int[nnodes];
+  char *used = new char[nnodes];
+  char *blossom = new char[nnodes];
+  char *on_path = new char[nnodes];
+  int *queue = new int[nnodes];
+  int *touched = new int[nnodes];
+  int *path = new int[nnodes];
+  int *member_next = new int[nnodes];
+  int *member_last = new int[nnodes];
+  for (int i = 0; i < nnodes; i++) {
+    parent[i] = -1;
+    base[i] = i;
+    stamp[i] = -1;
+    member_next[i] = -1;
+    member_last[i] = i;
+  }
+  memset(used, 0, nnodes * sizeof(char));
+  memset(blossom, 0, nnodes * sizeof(char));
+  memset(on_path, 0, nnodes * sizeof(char));
+
+  // The repair is performed in phases that only use the edges up to
+  // the weight threshold so that short paths along expensive edges
+  // are avoided. The searches in the initial phases are limited in
+  // size, since they may not find a path at all.
+  int fail = 0, search = 0;
+  for (int phase = 0; phase < num_phases; phase++) {
+    const int last = (phase == num_phases - 1);
+    const int max_touched = (last ? nnodes : 4096);
+
+    for (int root = 0; root < nnodes && !fail; root++) {
+      if (mate[root] >= 0) {
+        continue;
+      }
+
+      int head = 0, tail = 0, ntouched = 0;
+      search++;
+      used[root] = 1;
+      stamp[root] = search;
+      touched[ntouched++] = root;
+      queue[tail++] = root;
+
+      int end = -1;
+      while (head < tail && end < 0 && ntouched < max_touched) {
+        int v = queue[head++];
+        for (int jp = ptr[v]; jp < ptr[v + 1]; jp++) {
+          int e = node_edges[jp];
+          int to = edges[2 * e] == v ? edges[2 * e + 1] : edges[2 * e];
+          if (weights[e] > wmax[phase] || base[v] == base[to] ||
+              mate[v] == to) {
+            continue;
+          }
+
+          if (to == root || (mate[to] >= 0 && parent[mate[to]] >= 0)) {
+            // The edge closes an odd cycle: contract the blossom
+            int b =
+                find_blossom_base(v, to, mate, parent, base, on_path, path);
+            int nbases = 0;
+            mark_blossom_path(v, b, to, mate, parent, base, blossom, &nbases,
+                              path);
+            mark_blossom_path(to, b, v, mate, parent, base, blossom, &nbases,
+                              path);
+
+            // Relabel the members of the contracted blossoms and
+            // append them to the member list of the new base
+            for (int k = 0; k < nbases; k++) {
+              int c = path[k];
+              blossom[c] = 0;
+              if (c == b) {
+                continue;
+              }
+              for (int i = c; i >= 0; i = member_next[i]) {
+                base[i] = b;
+                if (!used[i]) {
+                  used[i] = 1;
+                  queue[tail++] = i;
+                }
+              }
+              member_next[member_last[b]] = c;
+              member_last[b] = member_last[c];
+            }
+          } else if (parent[to] < 0) {
+            parent[to] = v;
+            if (stamp[to] != search) {
+              stamp[to] = search;
+              touched[ntouched++] = to;
+            }
+
+            // The path ends at an unmatched node
+            if (mate[to] < 0) {
+              end = to;
+              break;
+            }
+
+            // Continue the search from the node matched to this node
+            int z = mate[to];
+            used[z] = 1;
+            if (stamp[z] != search) {
+              stamp[z] = search;
+              touched[ntouched++] = z;
+            }
+            queue[tail++] = z;
+          }
+        }
+      }
+
+      // Flip the matched and unmatched edges along the path
+      if (end >= 0) {
+        int v = end;
+        while (v >= 0) {
+          int pv = parent[v];
+          int ppv = mate[pv];
+          mate[v] = pv;
+          mate[pv] = v;
+          v = ppv;
+        }
+      } else if (last) {
+        fail = 1;
+      }
+
+      // Reset the search data for the nodes that were reached
+      for (int k = 0; k < ntouched; k++) {
+        int i = touched[k];
+        parent[i] = -1;
+        base[i] = i;
+        used[i] = 0;
+        member_next[i] = -1;
+        member_last[i] = i;
+      }
+    }
+  }
+
+  delete[] parent;
+  delete[] base;
+  delete[] stamp;
+  delete[] used;
+  delete[] blossom;
+  delete[] on_path;
+  delete[] queue;
+  delete[] touched;
+  delete[] path;
+  delete[] member_next;
+  delete[] member_last;
+
+  // Extract the matching. If there are multiple edges between the
+  // same pair of nodes, take the one with the smallest weight.
+  int nmatch = -1;
+  if (!fail) {
+    int *mate_edge = new int[nnodes];
+    for (int i = 0; i < nnodes; i++) {
+      mate_edge[i] = -1;
+    }
+    for (int i = 0; i < nedges; i++) {
+      int u = edges[2 * i];
+      int v = edges[2 * i + 1];
+      if (mate[u] == v && u != v) {
+        if (mate_edge[u] < 0 || weights[i] < weights[mate_edge[u]]) {
+          mate_edge[u] = mate_edge[v] = i;
+        }
+      }
+    }
+
+    double weight = 0.0;
+    nmatch = 0;
+    for (int i = 0; i < nedges; i++) {
+      if (mate_edge[edges[2 * i]] == i) {
+        match[nmatch] = i;
+        weight += weights[i];
+        nmatch++;
+      }
+    }
+    delete[] mate_edge;
+
+    if (weight > (1.0 + tol) * lower_bound) {
+      nmatch = -1;
+    }
+  }
+
+  delete[] ptr;
+  delete[] node_edges;
+  delete[] mate;
+
+  return nmatch;
+}
+
 /*
   Recombine the triangulation into a quadrilateral mesh
 */
@@ -2465,10 +3714,20 @@ void TMRFaceMesh::recombine(int ntris, const int triangles[],
                    X);
   }
 
-  // Perform the perfect matching
+  // Perform the perfect matching. Large faces may use the greedy
+  // matching when it is within the tolerance of the optimal matching.
   int *match = new int[ntris / 2];
-  int num_match =
-      TMR_PerfectMatchGraph(ntris, num_dual_edges, graph_edges, weights, match);
+  int num_match = -1;
+  if (options.greedy_recombine_min_triangles > 0 &&
+      ntris >= options.greedy_recombine_min_triangles) {
+    num_match =
+        greedy_perfect_match(ntris, num_dual_edges, graph_edges, weights,
+                             options.greedy_recombine_tolerance, match);
+  }
+  if (num_match < 0) {
+    num_match = TMR_PerfectMatchGraph(ntris, num_dual_edges, graph_edges,
+                                      weights, match);
+  }
   delete[] weights;
 
   // The quads formed from the original triangles
@@ -3010,6 +4269,48 @@ void TMRFaceMesh::writeToVTK(const char *filename) {
   }
 }
 
+/*
+  Write the quadrilateral or triangular mesh to a binary VTK XML file
+*/
+int TMRFaceMesh::writeToVTU(const char *filename, int use_float32) {
+  int fail = 0;
+  if (num_quads > 0 || num_tris > 0) {
+    // Write the quadrilaterals if they exist, otherwise the triangles
+    int ncells = (num_quads > 0 ? num_quads : num_tris);
+    int size = (num_quads > 0 ? 4 : 3);
+    const int *conn = (num_quads > 0 ? quads : tris);
+
+    int *ptr = new int[ncells + 1];
+    int *types = new int[ncells];
+    for (int k = 0; k <= ncells; k++) {
+      ptr[k] = size * k;
+    }
+    for (int k = 0; k < ncells; k++) {
+      types[k] = (num_quads > 0 ? TMR_VTK_QUAD : TMR_VTK_TRIANGLE);
+    }
+
+    if (num_quads > 0) {
+      const char *names[1] = {"quality"};
+      double *quality = new double[num_quads];
+      for (int i = 0; i < num_quads; i++) {
+        quality[i] = computeQuadQuality(&quads[4 * i], X);
+      }
+      fail = TMR_WriteVTUFile(MPI_COMM_SELF, filename, num_points, X, ncells,
+                              ptr, conn, types, 1, names, quality,
+                              use_float32);
+      delete[] quality;
+    } else {
+      fail = TMR_WriteVTUFile(MPI_COMM_SELF, filename, num_points, X, ncells,
+                              ptr, conn, types, 0, NULL, NULL, use_float32);
+    }
+
+    delete[] ptr;
+    delete[] types;
+  }
+
+  return fail;
+}
+
 /*
   Write out the segments to a VTK file
 */
@@ -26,6 +26,35 @@
 #include "TMREdgeMesh.h"
 #include "TMRMesh.h"
 
+class TMRFacePointKey;
+class TMRTriangularize;
+
+/*
+  The statistics recorded while meshing a face
+
+  The times are the wall-clock times in seconds spent in each stage on
+  the processor that meshed the face. The point location counts are
+  the calls to locate the triangle that encloses a point during the
+  triangulation that were resolved by walking the mesh from a nearby
+  triangle, and those that required a search from the closest point.
+*/
+class TMRFaceMeshStats {
+ public:
+  TMRFaceMeshStats() {
+    boundary_time = triangulate_time = 0.0;
+    smooth_time = recombine_time = total_time = 0.0;
+    num_locate_walks = num_locate_searches = 0;
+  }
+
+  double boundary_time;     // Set up the boundary points and segments
+  double triangulate_time;  // Triangulate the face
+  double smooth_time;       // Smooth the triangle or quadrilateral mesh
+  double recombine_time;    // Recombine and simplify the quadrilaterals
+  double total_time;        // Total time to mesh the face
+  int num_locate_walks;
+  int num_locate_searches;
+};
+
 /*
   The TMRFaceMesh class: This is used to generate quadrilateral and
   triangular face meshes
@@ -42,6 +71,9 @@ class TMRFaceMesh : public TMREntity {
   // Mesh the underlying geometric object
   void mesh(TMRMeshOptions options, TMRElementFeatureSize *fs);
 
+  // Distribute a mesh created on the root processor
+  void broadcastMesh(MPI_Comm _comm, int root);
+
   // Return the type of the underlying mesh
   TMRFaceMeshType getMeshType() { return mesh_type; }
 
@@ -51,6 +83,7 @@ class TMRFaceMesh : public TMREntity {
   // Order the mesh points uniquely
   int setNodeNums(int *num);
   int getNodeNums(const int **_vars);
+  void renumberNodes(const int *new_nums);
   int getNumFixedPoints();
 
   // Get points indexed via index on an edge or structured face
@@ -64,11 +97,15 @@ class TMRFaceMesh : public TMREntity {
 
   // Write the quadrilateral mesh to a VTK format
   void writeToVTK(const char *filename);
+  int writeToVTU(const char *filename, int use_float32 = 1);
 
   // Print the quadrilateral quality
   void addMeshQuality(int nbins, int count[]);
   void printMeshQuality();
 
+  // Get the statistics recorded while meshing the face
+  void getMeshStats(TMRFaceMeshStats *_stats);
+
  private:
   // Set the prescribed mesh
   void setPrescribedMesh(const TMRPoint *_X, int _npts, const int *_quads,
@@ -118,6 +155,10 @@ class TMRFaceMesh : public TMREntity {
   // Map the copy source face to the target face
   int mapCopyToTarget(TMRMeshOptions options, const double *params);
 
+  // Find the mesh points that coincide with the given points
+  void matchMeshPoints(int npts, const TMRPoint *Xpts, double atol,
+                       int *match);
+
   // Create a structured mesh
   void createStructuredMesh(TMRMeshOptions options, const double *params);
 
@@ -131,6 +172,24 @@ class TMRFaceMesh : public TMREntity {
                               TMRPoint **Xpts, int *nquads, int **mesh_quads,
                               int *ntris, int **mesh_tris);
 
+  // Triangulate the face by splitting it into subdomains
+  int createSubdomainTriangulation(
+      TMRMeshOptions options, TMRElementFeatureSize *fs,
+      const int total_num_pts, const int nholes, const double *params,
+      const int nsegs, const int *segments, int *npts, double **param_pts,
+      TMRPoint **Xpts, int *ntris, int **mesh_tris);
+
+  // Add the point location counts from the triangulation
+  void addPointLocationCounts(TMRTriangularize *tri);
+
+  // Compute the key and read/write the mesh in the mesh cache
+  int computeCacheKey(TMRMeshOptions options, TMRElementFeatureSize *fs,
+                      int nloops, const int *loop_pt_offset,
+                      const double *params, int num_degen, const int *degen,
+                      uint64_t *key);
+  int readFromCache(const char *filename, uint64_t key);
+  void writeToCache(const char *filename, uint64_t key);
+
   // The underlying surface
   MPI_Comm comm;
   TMRFace *face;
@@ -153,6 +212,11 @@ class TMRFaceMesh : public TMREntity {
   // are set in the TMRFace class
   int *copy_to_target;
 
+  // Mesh points sorted by their x-coordinate. This is created when
+  // the mesh is first used as a copy source and is shared by all of
+  // the faces that copy this mesh.
+  TMRFacePointKey *sorted_pts;
+
   // Record whether this mesh is prescribed
   int prescribed_mesh;
 
@@ -163,6 +227,9 @@ class TMRFaceMesh : public TMREntity {
   // Triangle mesh surface information
   int num_tris;
   int *tris;
+
+  // The statistics recorded while meshing the face
+  TMRFaceMeshStats stats;
 };
 
 #endif  // TMR_FACE_MESH_H
@@ -21,10 +21,14 @@
 #include "TMRFeatureSize.h"
 
 #include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <typeinfo>
+
+#include "TMRMesh.h"
 #include "tmrlapack.h"
 
 /*
@@ -43,6 +47,30 @@ TMRElementFeatureSize::~TMRElementFeatureSize() {}
 */
 double TMRElementFeatureSize::getFeatureSize(TMRPoint pt) { return hmin; }
 
+/*
+  Evaluate the feature size at a set of points
+*/
+void TMRElementFeatureSize::getFeatureSizes(int n, const TMRPoint *pts,
+                                            double *h) {
+  for (int i = 0; i < n; i++) {
+    h[i] = getFeatureSize(pts[i]);
+  }
+}
+
+/*
+  Add the constant feature size to the fingerprint. A derived class
+  that does not override this call may evaluate the feature size in
+  any way, so it cannot be fingerprinted.
+*/
+int TMRElementFeatureSize::addFingerprint(TMRMeshFingerprint *fingerprint) {
+  if (typeid(*this) != typeid(TMRElementFeatureSize)) {
+    return 1;
+  }
+  fingerprint->addString("TMRElementFeatureSize");
+  fingerprint->add(hmin);
+  return 0;
+}
+
 /*
   Create a feature size dependency that is linear but does not
   exceed hmin or hmax anywhere in the domain
@@ -74,6 +102,37 @@ double TMRLinearElementSize::getFeatureSize(TMRPoint pt) {
   return h;
 }
 
+/*
+  Evaluate the feature size at a set of points
+*/
+void TMRLinearElementSize::getFeatureSizes(int n, const TMRPoint *pts,
+                                           double *h) {
+  for (int i = 0; i < n; i++) {
+    double hval = c + ax * pts[i].x + ay * pts[i].y + az * pts[i].z;
+    if (hval < hmin) {
+      hval = hmin;
+    }
+    if (hval > hmax) {
+      hval = hmax;
+    }
+    h[i] = hval;
+  }
+}
+
+/*
+  Add the bounds and the coefficients to the fingerprint
+*/
+int TMRLinearElementSize::addFingerprint(TMRMeshFingerprint *fingerprint) {
+  fingerprint->addString("TMRLinearElementSize");
+  fingerprint->add(hmin);
+  fingerprint->add(hmax);
+  fingerprint->add(c);
+  fingerprint->add(ax);
+  fingerprint->add(ay);
+  fingerprint->add(az);
+  return 0;
+}
+
 /*
   Create the feature size within a box
 */
@@ -105,12 +164,21 @@ TMRBoxFeatureSize::TMRBoxFeatureSize(TMRPoint p1, TMRPoint p2, double _hmin,
   // Add a box to the data structure
   root = new BoxNode(&(list_current->boxes[num_boxes]), m1, d1);
   num_boxes++;
+
+  // The flattened tree is created when it is first needed
+  num_tree_nodes = 0;
+  tree_nodes = NULL;
+  tree_bounds = NULL;
+  tree_boxes = NULL;
+  pthread_mutex_init(&tree_mutex, NULL);
 }
 
 /*
   Free the data allocated by the feature-size object
 */
 TMRBoxFeatureSize::~TMRBoxFeatureSize() {
+  freeFlatTree();
+  pthread_mutex_destroy(&tree_mutex);
   delete root;
   while (list_root) {
     BoxList *tmp = list_root;
@@ -146,41 +214,205 @@ void TMRBoxFeatureSize::addBox(TMRPoint p1, TMRPoint p2, double hval) {
   // Add a box to the data structure
   root->addBox(&(list_current->boxes[num_boxes]));
   num_boxes++;
+
+  // The flattened tree is out of date
+  freeFlatTree();
 }
 
 /*
   Retrieve the feature size
 */
 double TMRBoxFeatureSize::getFeatureSize(TMRPoint pt) {
-  double h = hmax;
-  root->getSize(pt, &h);
-  if (h < hmin) {
-    h = hmin;
+  initFlatTree();
+  return getFlatSize(pt);
+}
+
+/*
+  Evaluate the feature size at a set of points
+*/
+void TMRBoxFeatureSize::getFeatureSizes(int n, const TMRPoint *pts,
+                                        double *h) {
+  initFlatTree();
+  for (int i = 0; i < n; i++) {
+    h[i] = getFlatSize(pts[i]);
   }
-  if (h > hmax) {
-    h = hmax;
+}
+
+/*
+  Add the bounds and all of the boxes, in the order they were added,
+  to the fingerprint
+*/
+int TMRBoxFeatureSize::addFingerprint(TMRMeshFingerprint *fingerprint) {
+  fingerprint->addString("TMRBoxFeatureSize");
+  fingerprint->add(hmin);
+  fingerprint->add(hmax);
+  for (BoxList *list = list_root; list; list = list->next) {
+    int nboxes = (list == list_current ? num_boxes : MAX_LIST_BOXES);
+    for (int i = 0; i < nboxes; i++) {
+      fingerprint->add(list->boxes[i].m);
+      fingerprint->add(list->boxes[i].d);
+      fingerprint->add(list->boxes[i].h);
+    }
   }
-  return h;
+  return 0;
 }
 
 /*
-  Check if the box contains the point
+  Create a flattened copy of the box tree.
+
+  The nodes are ordered breadth-first so that the children of each
+  node are stored contiguously, and the boxes within each leaf are
+  copied into a single array along with their bounds. The tree is
+  created once after the boxes are added, and may be created from
+  multiple threads.
 */
-int TMRBoxFeatureSize::BoxSize::contains(TMRPoint p) {
-  // Compute the lower/upper bounds
-  double xl = m.x - d.x;
-  double xu = m.x + d.x;
-  double yl = m.y - d.y;
-  double yu = m.y + d.y;
-  double zl = m.z - d.z;
-  double zu = m.z + d.z;
+void TMRBoxFeatureSize::initFlatTree() {
+  if (__atomic_load_n(&tree_nodes, __ATOMIC_ACQUIRE)) {
+    return;
+  }
 
-  // Return true if the box contains the point
-  if ((p.x >= xl && p.x <= xu) && (p.y >= yl && p.y <= yu) &&
-      (p.z >= zl && p.z <= zu)) {
-    return 1;
+  pthread_mutex_lock(&tree_mutex);
+  if (!tree_nodes) {
+    // Order the nodes breadth-first and count the boxes
+    int max_size = 64;
+    BoxNode **queue = new BoxNode *[max_size];
+    int size = 1;
+    queue[0] = root;
+
+    int num_tree_boxes = 0;
+    for (int k = 0; k < size; k++) {
+      BoxNode *node = queue[k];
+      if (node->c[0]) {
+        if (size + 8 > max_size) {
+          max_size = 2 * (size + 8);
+          BoxNode **temp = new BoxNode *[max_size];
+          memcpy(temp, queue, size * sizeof(BoxNode *));
+          delete[] queue;
+          queue = temp;
+        }
+        for (int i = 0; i < 8; i++) {
+          queue[size] = node->c[i];
+          size++;
+        }
+      }
+      num_tree_boxes += node->num_boxes;
+    }
+
+    int *nodes = new int[3 * size];
+    tree_bounds = new double[9 * size];
+    tree_boxes = new double[7 * num_tree_boxes];
+
+    int child = 1, offset = 0;
+    for (int k = 0; k < size; k++) {
+      BoxNode *node = queue[k];
+      if (node->c[0]) {
+        nodes[3 * k] = child;
+        child += 8;
+      } else {
+        nodes[3 * k] = -1;
+      }
+      nodes[3 * k + 1] = offset;
+      nodes[3 * k + 2] = node->num_boxes;
+
+      // Set the mid-point and the bounds for the node
+      double *b = &tree_bounds[9 * k];
+      b[0] = node->m.x;
+      b[1] = node->m.y;
+      b[2] = node->m.z;
+      b[3] = node->m.x - node->d.x;
+      b[4] = node->m.x + node->d.x;
+      b[5] = node->m.y - node->d.y;
+      b[6] = node->m.y + node->d.y;
+      b[7] = node->m.z - node->d.z;
+      b[8] = node->m.z + node->d.z;
+
+      // Copy the bounds and size for each box
+      for (int i = 0; i < node->num_boxes; i++, offset++) {
+        BoxSize *box = node->boxes[i];
+        double *t = &tree_boxes[7 * offset];
+        t[0] = box->m.x - box->d.x;
+        t[1] = box->m.x + box->d.x;
+        t[2] = box->m.y - box->d.y;
+        t[3] = box->m.y + box->d.y;
+        t[4] = box->m.z - box->d.z;
+        t[5] = box->m.z + box->d.z;
+        t[6] = box->h;
+      }
+    }
+    delete[] queue;
+
+    // Make the tree visible to other threads only once it is complete
+    num_tree_nodes = size;
+    __atomic_store_n(&tree_nodes, nodes, __ATOMIC_RELEASE);
+  }
+  pthread_mutex_unlock(&tree_mutex);
+}
+
+/*
+  Free the flattened tree
+*/
+void TMRBoxFeatureSize::freeFlatTree() {
+  if (tree_nodes) {
+    delete[] tree_nodes;
+    delete[] tree_bounds;
+    delete[] tree_boxes;
+    num_tree_nodes = 0;
+    tree_nodes = NULL;
+    tree_bounds = NULL;
+    tree_boxes = NULL;
   }
-  return 0;
+}
+
+/*
+  Find the feature size from the flattened tree.
+
+  This descends to the leaf containing the point, taking the lower
+  child when the point lies on a mid-plane, and finds the most
+  constraining box within the leaf. Points outside the root node only
+  use the boxes when the root node is a leaf.
+*/
+inline double TMRBoxFeatureSize::getFlatSize(const TMRPoint &p) {
+  double h = hmax;
+
+  int node = 0;
+  int child = tree_nodes[0];
+  while (child >= 0) {
+    const double *b = &tree_bounds[9 * node];
+    if (!((p.x >= b[3] && p.x <= b[4]) && (p.y >= b[5] && p.y <= b[6]) &&
+          (p.z >= b[7] && p.z <= b[8]))) {
+      break;
+    }
+    node = child;
+    if (p.x > b[0]) {
+      node += 1;
+    }
+    if (p.y > b[1]) {
+      node += 2;
+    }
+    if (p.z > b[2]) {
+      node += 4;
+    }
+    child = tree_nodes[3 * node];
+  }
+
+  // Find the most-constraining box size within the leaf
+  if (child < 0) {
+    const double *t = &tree_boxes[7 * tree_nodes[3 * node + 1]];
+    for (int i = 0; i < tree_nodes[3 * node + 2]; i++, t += 7) {
+      if ((p.x >= t[0] && p.x <= t[1]) && (p.y >= t[2] && p.y <= t[3]) &&
+          (p.z >= t[4] && p.z <= t[5]) && h > t[6]) {
+        h = t[6];
+      }
+    }
+  }
+
+  if (h < hmin) {
+    h = hmin;
+  }
+  if (h > hmax) {
+    h = hmax;
+  }
+  return h;
 }
 
 /*
@@ -313,58 +545,103 @@ void TMRBoxFeatureSize::BoxNode::addBox(BoxSize *ptr) {
 }
 
 /*
-  Get the element size based on the extent of the box
+  Create the point locator: This is used to find the points from the
+  initial point set that are closest to the provided point.
+
+  When more than one thread is used, the top levels of the tree are
+  split first and the remaining subtrees are created concurrently.
+  The tree does not depend on the number of threads.
 */
-void TMRBoxFeatureSize::BoxNode::getSize(TMRPoint p, double *hval) {
-  // Scan through the tree and find the most-constraining box size
-  for (int k = 0; k < 2; k++) {
-    double zl = m.z + (k - 1) * d.z;
-    double zu = m.z + k * d.z;
+TMRPointLocator::TMRPointLocator(int _npts, TMRPoint *_pts, int _num_threads) {
+  num_threads = (_num_threads > 1 ? _num_threads : 1);
+  npts = _npts;
+  pts = new TMRPoint[npts];
+  memcpy(pts, _pts, npts * sizeof(TMRPoint));
 
-    for (int j = 0; j < 2; j++) {
-      double yl = m.y + (j - 1) * d.y;
-      double yu = m.y + j * d.y;
+  // The point indicies
+  indices = new int[npts];
+  for (int i = 0; i < npts; i++) {
+    indices[i] = i;
+  }
 
-      for (int i = 0; i < 2; i++) {
-        double xl = m.x + (i - 1) * d.x;
-        double xu = m.x + i * d.x;
-
-        // Check if the point lies in the box and the box exists
-        if ((p.x >= xl && p.x <= xu) && (p.y >= yl && p.y <= yu) &&
-            (p.z >= zl && p.z <= zu)) {
-          if (c[i + 2 * j + 4 * k]) {
-            return c[i + 2 * j + 4 * k]->getSize(p, hval);
-          }
-        }
+  // Calculate approximately how many nodes there should be
+  tree = new NodeList(int(2.0 * npts / MAX_BIN_SIZE) + 1);
+
+  if (num_threads == 1 || npts <= 4 * num_threads * MAX_BIN_SIZE) {
+    // Recursively split the points
+    split(tree, 0, npts, -1);
+  } else {
+    // Split the top levels so that there are several subtrees for
+    // each thread
+    int depth = 0;
+    while ((1 << depth) < 4 * num_threads) {
+      depth++;
+    }
+    split(tree, 0, npts, depth);
+
+    // Find the nodes that were deferred
+    ThreadData data;
+    data.locator = this;
+    data.next = 0;
+    data.num_tasks = 0;
+    data.task_nodes = new int[tree->num_nodes];
+    for (int i = 0; i < tree->num_nodes; i++) {
+      if (tree->nodes[2 * i] == -2) {
+        data.task_nodes[data.num_tasks] = i;
+        data.num_tasks++;
       }
     }
-  }
 
-  for (int i = 0; i < num_boxes; i++) {
-    if (boxes[i]->contains(p) && *hval > boxes[i]->h) {
-      *hval = boxes[i]->h;
+    // Create the subtrees
+    data.subtrees = new NodeList *[data.num_tasks];
+    runThreads(buildThread, &data);
+
+    // Add each subtree to the tree. The root of the subtree replaces
+    // the deferred node and the remaining nodes are appended.
+    for (int task = 0; task < data.num_tasks; task++) {
+      NodeList *sub = data.subtrees[task];
+      int offset = tree->num_nodes - 1;
+      for (int i = 0; i < sub->num_nodes; i++) {
+        int node = (i == 0 ? data.task_nodes[task] : tree->addNode());
+        for (int k = 0; k < 2; k++) {
+          int child = sub->nodes[2 * i + k];
+          tree->nodes[2 * node + k] = (child > 0 ? child + offset : child);
+        }
+        tree->index_offset[node] = sub->index_offset[i];
+        tree->index_count[node] = sub->index_count[i];
+        tree->node_loc[node] = sub->node_loc[i];
+        tree->node_normal[node] = sub->node_normal[i];
+      }
+      delete sub;
     }
+
+    delete[] data.task_nodes;
+    delete[] data.subtrees;
   }
 }
 
+TMRPointLocator::~TMRPointLocator() {
+  delete[] pts;
+  delete[] indices;
+  delete tree;
+}
+
 /*
-  Create the point locator: This is used to find the points from the
-  initial point set that are closest to the provided point.
+  Get the points in the point cloud, in their original order
 */
-TMRPointLocator::TMRPointLocator(int _npts, TMRPoint *_pts) {
-  npts = _npts;
-  pts = new TMRPoint[npts];
-  memcpy(pts, _pts, npts * sizeof(TMRPoint));
+int TMRPointLocator::getPoints(const TMRPoint **_pts) {
+  if (_pts) {
+    *_pts = pts;
+  }
+  return npts;
+}
 
-  // Calculate approximately how many nodes there should be
-  max_num_nodes = int(2.0 * npts / MAX_BIN_SIZE) + 1;
+/*
+  Allocate space for the nodes within the tree
+*/
+TMRPointLocator::NodeList::NodeList(int _max_num_nodes) {
   num_nodes = 0;
-
-  // The point indicies
-  indices = new int[npts];
-  for (int i = 0; i < npts; i++) {
-    indices[i] = i;
-  }
+  max_num_nodes = (_max_num_nodes > 1 ? _max_num_nodes : 1);
 
   // Set up the data structure that represents the splitting planes
   nodes = new int[2 * max_num_nodes];
@@ -376,14 +653,9 @@ TMRPointLocator::TMRPointLocator(int _npts, TMRPoint *_pts) {
   node_normal = new TMRPoint[max_num_nodes];
   memset(node_loc, 0, max_num_nodes * sizeof(TMRPoint));
   memset(node_normal, 0, max_num_nodes * sizeof(TMRPoint));
-
-  // Recursively split the points
-  split(0, npts);
 }
 
-TMRPointLocator::~TMRPointLocator() {
-  delete[] pts;
-  delete[] indices;
+TMRPointLocator::NodeList::~NodeList() {
   delete[] nodes;
   delete[] index_offset;
   delete[] index_count;
@@ -392,17 +664,11 @@ TMRPointLocator::~TMRPointLocator() {
 }
 
 /*
-  Split the list of indices into approximately two. Those on one half
-  of a plane and those on the other.
+  Add a node and return its index, extending the arrays if needed
 */
-int TMRPointLocator::split(int start, int end) {
-  int root = num_nodes;
-
-  num_nodes++;
-
-  // Need to extend the arrays to make them fit
+int TMRPointLocator::NodeList::addNode() {
   if (num_nodes >= max_num_nodes) {
-    int max_num_nodes = 2 * (num_nodes + 1);
+    max_num_nodes = 2 * (num_nodes + 1);
 
     // Allocate and set a new nodes pointer
     int *temp_nodes = new int[2 * max_num_nodes];
@@ -435,15 +701,80 @@ int TMRPointLocator::split(int start, int end) {
     node_normal = temp_node_normal;
   }
 
+  int node = num_nodes;
+  num_nodes++;
+  return node;
+}
+
+/*
+  Run the function on the threads
+*/
+void TMRPointLocator::runThreads(void *(*func)(void *), ThreadData *data) {
+  pthread_t *threads = new pthread_t[num_threads];
+  for (int k = 0; k < num_threads; k++) {
+    pthread_create(&threads[k], NULL, func, (void *)data);
+  }
+  for (int k = 0; k < num_threads; k++) {
+    pthread_join(threads[k], NULL);
+  }
+  delete[] threads;
+}
+
+/*
+  Create the subtrees for the deferred nodes
+*/
+void *TMRPointLocator::buildThread(void *arg) {
+  ThreadData *data = static_cast<ThreadData *>(arg);
+  TMRPointLocator *locator = data->locator;
+  NodeList *tree = locator->tree;
+
+  while (1) {
+    int task = __atomic_fetch_add(&data->next, 1, __ATOMIC_RELAXED);
+    if (task >= data->num_tasks) {
+      break;
+    }
+
+    int node = data->task_nodes[task];
+    int start = tree->index_offset[node];
+    int end = start + tree->index_count[node];
+    NodeList *sub = new NodeList(int(2.0 * (end - start) / MAX_BIN_SIZE) + 1);
+    locator->split(sub, start, end, -1);
+    data->subtrees[task] = sub;
+  }
+
+  return NULL;
+}
+
+/*
+  Split the list of indices into approximately two. Those on one half
+  of a plane and those on the other.
+
+  When the depth reaches zero, the node is marked and its split is
+  deferred. A negative depth splits the points until the bins are
+  small enough.
+*/
+int TMRPointLocator::split(NodeList *list, int start, int end, int depth) {
+  int root = list->addNode();
+
   // If there are fewer than the max number of points in a bin, end
   // the recursion here and store the result of the last split
   if (end - start <= MAX_BIN_SIZE) {
-    nodes[2 * root] = -1;
-    nodes[2 * root + 1] = -1;
+    list->nodes[2 * root] = -1;
+    list->nodes[2 * root + 1] = -1;
 
     // Set the offset into the node
-    index_offset[root] = start;
-    index_count[root] = end - start;
+    list->index_offset[root] = start;
+    list->index_count[root] = end - start;
+
+    return root;
+  }
+
+  // Store the range of points for a node that is split later
+  if (depth == 0) {
+    list->nodes[2 * root] = -2;
+    list->nodes[2 * root + 1] = -2;
+    list->index_offset[root] = start;
+    list->index_count[root] = end - start;
 
     return root;
   }
@@ -452,23 +783,29 @@ int TMRPointLocator::split(int start, int end) {
   // index pointer to a negative value to indicate that this is not a
   // leaf. Sort the indices so that the points on one side of the
   // plane are below the mid point and the others are above.
-  index_offset[root] = -1;
-  index_count[root] = 0;
+  list->index_offset[root] = -1;
+  list->index_count[root] = 0;
 
   // Split the list
-  int mid = partitionPoints(&node_loc[root], &node_normal[root],
+  int mid = partitionPoints(&list->node_loc[root], &list->node_normal[root],
                             &indices[start], end - start);
 
+  // If the points could not be split, keep them all in this leaf
   if (mid == 0 || mid == end - start) {
+    list->nodes[2 * root] = -1;
+    list->nodes[2 * root + 1] = -1;
+    list->index_offset[root] = start;
+    list->index_count[root] = end - start;
+
     return root;
   }
 
   // Now, split the right and left hand sides of the list to continue
   // the recursion.
-  int left_node = split(start, start + mid);
-  int right_node = split(start + mid, end);
-  nodes[2 * root] = left_node;
-  nodes[2 * root + 1] = right_node;
+  int left_node = split(list, start, start + mid, depth - 1);
+  int right_node = split(list, start + mid, end, depth - 1);
+  list->nodes[2 * root] = left_node;
+  list->nodes[2 * root + 1] = right_node;
 
   return root;
 }
@@ -591,33 +928,210 @@ int TMRPointLocator::partitionPoints(TMRPoint *loc, TMRPoint *normal, int *indx,
 */
 void TMRPointLocator::locateClosest(const int K, const TMRPoint pt, int *nk,
                                     int *indx, double *dist) {
-  locateClosest(K, 0, pt, nk, indx, dist);
+  *nk = 0;
+  if (K <= 0) {
+    return;
+  }
+
+  int seq_array[64];
+  ClosestHeap heap;
+  heap.K = K;
+  heap.nk = 0;
+  heap.count = 0;
+  heap.indx = indx;
+  heap.dist = dist;
+  heap.seq = (K <= 64 ? seq_array : new int[K]);
+
+  locateClosest(0, pt, &heap);
+  heap.sort();
+  *nk = heap.nk;
+
+  if (heap.seq != seq_array) {
+    delete[] heap.seq;
+  }
 }
 
 /*
-  Locate the closest points to a given point
+  Spread the lower 21 bits of the input so that there are two zero
+  bits between each bit
+*/
+static inline uint64_t spread_bits(uint64_t u) {
+  u &= 0x1fffff;
+  u = (u | (u << 32)) & 0x1f00000000ffffULL;
+  u = (u | (u << 16)) & 0x1f0000ff0000ffULL;
+  u = (u | (u << 8)) & 0x100f00f00f00f00fULL;
+  u = (u | (u << 4)) & 0x10c30c30c30c30c3ULL;
+  u = (u | (u << 2)) & 0x1249249249249249ULL;
+  return u;
+}
+
+/*
+  Compare the Morton keys of two points, breaking ties by index
+*/
+static int compare_morton_keys(const void *a, const void *b) {
+  const uint64_t *ka = static_cast<const uint64_t *>(a);
+  const uint64_t *kb = static_cast<const uint64_t *>(b);
+  if (ka[0] != kb[0]) {
+    return (ka[0] < kb[0] ? -1 : 1);
+  }
+  return (ka[1] < kb[1] ? -1 : (ka[1] > kb[1] ? 1 : 0));
+}
+
+/*
+  Locate the closest points to each point in a list
+
+  The queries are performed in the order of the points along a Morton
+  curve so that nearby queries, which visit the same parts of the
+  tree, are performed together. The results do not depend on this
+  order or on the number of threads.
 
   input:
   K:      The number of closest points to find
+  n:      The number of points
+  pt:     The points
+
+  output:
+  nk:     The number of closest points found for each point
+  indx:   The indices of the K-closest values for each point
+  dist:   The sorted K-closest distances for each point
+*/
+void TMRPointLocator::locateClosest(const int K, const int n,
+                                    const TMRPoint *pt, int *nk, int *indx,
+                                    double *dist) {
+  if (n <= 0) {
+    return;
+  }
+  if (K <= 0) {
+    memset(nk, 0, n * sizeof(int));
+    return;
+  }
+
+  // Find the bounds of the points
+  TMRPoint lo = pt[0], hi = pt[0];
+  for (int i = 1; i < n; i++) {
+    if (pt[i].x < lo.x) {
+      lo.x = pt[i].x;
+    }
+    if (pt[i].x > hi.x) {
+      hi.x = pt[i].x;
+    }
+    if (pt[i].y < lo.y) {
+      lo.y = pt[i].y;
+    }
+    if (pt[i].y > hi.y) {
+      hi.y = pt[i].y;
+    }
+    if (pt[i].z < lo.z) {
+      lo.z = pt[i].z;
+    }
+    if (pt[i].z > hi.z) {
+      hi.z = pt[i].z;
+    }
+  }
+
+  // Order the points along the Morton curve within the bounds
+  const double scale = 2097151.0;
+  double sx = (hi.x > lo.x ? scale / (hi.x - lo.x) : 0.0);
+  double sy = (hi.y > lo.y ? scale / (hi.y - lo.y) : 0.0);
+  double sz = (hi.z > lo.z ? scale / (hi.z - lo.z) : 0.0);
+  uint64_t *keys = new uint64_t[2 * n];
+  for (int i = 0; i < n; i++) {
+    double x = sx * (pt[i].x - lo.x);
+    double y = sy * (pt[i].y - lo.y);
+    double z = sz * (pt[i].z - lo.z);
+    uint64_t ix = (x >= 0.0 && x <= scale ? (uint64_t)x : 0);
+    uint64_t iy = (y >= 0.0 && y <= scale ? (uint64_t)y : 0);
+    uint64_t iz = (z >= 0.0 && z <= scale ? (uint64_t)z : 0);
+    keys[2 * i] =
+        spread_bits(ix) | (spread_bits(iy) << 1) | (spread_bits(iz) << 2);
+    keys[2 * i + 1] = i;
+  }
+  qsort(keys, n, 2 * sizeof(uint64_t), compare_morton_keys);
+
+  int *order = new int[n];
+  for (int i = 0; i < n; i++) {
+    order[i] = keys[2 * i + 1];
+  }
+  delete[] keys;
+
+  ThreadData data;
+  data.locator = this;
+  data.next = 0;
+  data.num_tasks = n;
+  data.K = K;
+  data.pts = pt;
+  data.order = order;
+  data.nk = nk;
+  data.indx = indx;
+  data.dist = dist;
+
+  if (num_threads > 1 && n > QUERY_BLOCK_SIZE) {
+    runThreads(queryThread, &data);
+  } else {
+    queryThread(&data);
+  }
+
+  delete[] order;
+}
+
+/*
+  Perform the queries in blocks of points taken in order
+*/
+void *TMRPointLocator::queryThread(void *arg) {
+  ThreadData *data = static_cast<ThreadData *>(arg);
+  const int K = data->K;
+
+  ClosestHeap heap;
+  heap.K = K;
+  heap.seq = new int[K];
+
+  while (1) {
+    int start =
+        __atomic_fetch_add(&data->next, QUERY_BLOCK_SIZE, __ATOMIC_RELAXED);
+    if (start >= data->num_tasks) {
+      break;
+    }
+    int end = start + QUERY_BLOCK_SIZE;
+    if (end > data->num_tasks) {
+      end = data->num_tasks;
+    }
+
+    for (int i = start; i < end; i++) {
+      int q = data->order[i];
+      heap.nk = 0;
+      heap.count = 0;
+      heap.indx = &data->indx[K * q];
+      heap.dist = &data->dist[K * q];
+      data->locator->locateClosest(0, data->pts[q], &heap);
+      heap.sort();
+      data->nk[q] = heap.nk;
+    }
+  }
+
+  delete[] heap.seq;
+  return NULL;
+}
+
+/*
+  Locate the closest points to a given point
+
+  input:
   root:   The root node index to search
   pt:     The point
 
   input/output:
-  dist:   A sorted list of the K-closest distances
-  indx:   The indices of the K-closest values
-  nk:     The actual number of points in the list nk <= K
+  heap:   The heap of the K-closest points found so far
 */
-void TMRPointLocator::locateClosest(const int K, const int root,
-                                    const TMRPoint pt, int *nk, int *indx,
-                                    double *dist) {
-  int start = index_offset[root];
-  int left_node = nodes[2 * root];
-  int right_node = nodes[2 * root + 1];
+void TMRPointLocator::locateClosest(const int root, const TMRPoint pt,
+                                    ClosestHeap *heap) {
+  int start = tree->index_offset[root];
+  int left_node = tree->nodes[2 * root];
+  int right_node = tree->nodes[2 * root + 1];
 
   if (start != -1) {
     // This node is a leaf. Do an exhaustive search of the points
     // to find the ones that are closest to the given point
-    int end = start + index_count[root];
+    int end = start + tree->index_count[root];
 
     // Loop over the indices in the leaf
     for (int k = start; k < end; k++) {
@@ -629,94 +1143,138 @@ void TMRPointLocator::locateClosest(const int K, const int root,
                   (pts[n].z - pt.z) * (pts[n].z - pt.z));
 
       // Insert the point if needed
-      if ((*nk < K) || (t < dist[K - 1])) {
-        insertIndex(K, n, t, nk, indx, dist);
+      if ((heap->nk < heap->K) || (t < heap->dist[0])) {
+        heap->insert(n, t);
       }
     }
   } else {
     // This is not a leaf node. Figure out which side we should search
     // and then perform the recursive search on that side.
-    double x = node_loc[root].x;
-    double y = node_loc[root].y;
-    double z = node_loc[root].z;
+    double x = tree->node_loc[root].x;
+    double y = tree->node_loc[root].y;
+    double z = tree->node_loc[root].z;
 
     // Find the normal
-    double nx = node_normal[root].x;
-    double ny = node_normal[root].y;
-    double nz = node_normal[root].z;
+    double nx = tree->node_normal[root].x;
+    double ny = tree->node_normal[root].y;
+    double nz = tree->node_normal[root].z;
 
     // The normal distance
     double ndist = ((pt.x - x) * nx + (pt.y - y) * ny + (pt.z - z) * nz);
 
     if (ndist < 0.0) {  // The point lies to the 'left' of the plane
-      locateClosest(K, left_node, pt, nk, indx, dist);
+      locateClosest(left_node, pt, heap);
 
       // If the minimum distance to the plane is less than the minimum
       // distance then search the other branch too - there could be a
       // point on that branch that lies closer than *dist
-      if (*nk < K || ndist * ndist < dist[*nk - 1]) {
-        locateClosest(K, right_node, pt, nk, indx, dist);
+      if (heap->nk < heap->K || ndist * ndist < heap->dist[0]) {
+        locateClosest(right_node, pt, heap);
       }
     } else {  // The point lies to the 'right' of the plane
-      locateClosest(K, right_node, pt, nk, indx, dist);
+      locateClosest(right_node, pt, heap);
 
       // If the minimum distance to the plane is less than the minimum
       // distance then search the other branch too - there could be a
       // point on that branch that lies closer than *dist
-      if (*nk < K || ndist * ndist < dist[*nk - 1]) {
-        locateClosest(K, left_node, pt, nk, indx, dist);
+      if (heap->nk < heap->K || ndist * ndist < heap->dist[0]) {
+        locateClosest(left_node, pt, heap);
       }
     }
   }
 }
 
 /*
-  Insert a point into a sorted list based upon the distance from the
-  given point
+  Check whether the i-th entry in the heap is farther than the j-th
+  entry. Entries at the same distance are ordered by when they were
+  inserted.
+*/
+inline int TMRPointLocator::ClosestHeap::greater(int i, int j) {
+  return (dist[i] > dist[j] || (dist[i] == dist[j] && seq[i] > seq[j]));
+}
 
-  input:
-  K:      the maximum length of the array
-  dindx:  the index of the new point to insert
-  d:      the square of the distance to the new point
+/*
+  Move the i-th entry down the heap of the given size
+*/
+void TMRPointLocator::ClosestHeap::siftDown(int i, int size) {
+  while (1) {
+    int largest = i;
+    int left = 2 * i + 1;
+    int right = 2 * i + 2;
+    if (left < size && greater(left, largest)) {
+      largest = left;
+    }
+    if (right < size && greater(right, largest)) {
+      largest = right;
+    }
+    if (largest == i) {
+      break;
+    }
 
-  input/output:
-  nk:     the length of the sorted index/distance arrays nk <= K
-  indx:   the sorted list of index values
-  dist;   the distances
-*/
-void TMRPointLocator::insertIndex(const int K, int dindx, double d, int *nk,
-                                  int *indx, double *dist) {
-  if (*nk == 0) {
-    dist[*nk] = d;
-    indx[*nk] = dindx;
-    *nk += 1;
-    return;
-  } else if (*nk < K && dist[*nk - 1] <= d) {
-    dist[*nk] = d;
-    indx[*nk] = dindx;
-    *nk += 1;
-    return;
+    int tindx = indx[i];
+    int tseq = seq[i];
+    double t = dist[i];
+    indx[i] = indx[largest];
+    seq[i] = seq[largest];
+    dist[i] = dist[largest];
+    indx[largest] = tindx;
+    seq[largest] = tseq;
+    dist[largest] = t;
+    i = largest;
   }
+}
 
-  // Place it into the list
-  int i = 0;
-  while (i < *nk && (d >= dist[i])) {
-    i++;
-  }
+/*
+  Insert a point into the heap based upon the distance from the given
+  point. The farthest point is discarded when the heap is full.
 
-  for (; i < *nk; i++) {
-    int tindx = indx[i];
-    double t = dist[i];
+  input:
+  dindx:  the index of the new point to insert
+  d:      the square of the distance to the new point
+*/
+void TMRPointLocator::ClosestHeap::insert(int dindx, double d) {
+  if (nk < K) {
+    // Add the point to the end of the heap and move it up
+    int i = nk;
+    nk++;
+    while (i > 0) {
+      int parent = (i - 1) / 2;
+      if (d < dist[parent]) {
+        break;
+      }
+      indx[i] = indx[parent];
+      seq[i] = seq[parent];
+      dist[i] = dist[parent];
+      i = parent;
+    }
     indx[i] = dindx;
+    seq[i] = count;
     dist[i] = d;
-    dindx = tindx;
-    d = t;
+  } else if (d < dist[0]) {
+    // Replace the farthest point
+    indx[0] = dindx;
+    seq[0] = count;
+    dist[0] = d;
+    siftDown(0, nk);
   }
+  count++;
+}
 
-  if (*nk < K) {
-    indx[*nk] = dindx;
-    dist[*nk] = d;
-    *nk += 1;
+/*
+  Sort the points in the heap so that the distances are increasing
+*/
+void TMRPointLocator::ClosestHeap::sort() {
+  for (int size = nk - 1; size > 0; size--) {
+    int tindx = indx[0];
+    int tseq = seq[0];
+    double t = dist[0];
+    indx[0] = indx[size];
+    seq[0] = seq[size];
+    dist[0] = dist[size];
+    indx[size] = tindx;
+    seq[size] = tseq;
+    dist[size] = t;
+    siftDown(0, size);
   }
 }
 
@@ -726,13 +1284,14 @@ void TMRPointLocator::insertIndex(const int K, int dindx, double d, int *nk,
 */
 TMRPointFeatureSize::TMRPointFeatureSize(int _npts, TMRPoint *_pts,
                                          double *_hvals, double _hmin,
-                                         double _hmax, int _num_sample_pts)
+                                         double _hmax, int _num_sample_pts,
+                                         int _num_threads)
     : TMRElementFeatureSize(_hmin) {
   npts = _npts;
   hmin = _hmin;
   hmax = _hmax;
 
-  locator = new TMRPointLocator(npts, _pts);
+  locator = new TMRPointLocator(npts, _pts, _num_threads);
   locator->incref();
 
   // Set the number of sample points
@@ -755,12 +1314,66 @@ double TMRPointFeatureSize::getFeatureSize(TMRPoint pt) {
   // Get the closest points and use them to compute a set of weights
   int indx[MAX_CLOSEST_POINTS];
   double dist[MAX_CLOSEST_POINTS];
-  double weights[MAX_CLOSEST_POINTS];
 
   // Find the closest points
   int n = 0;
   locator->locateClosest(num_sample_pts, pt, &n, indx, dist);
 
+  return computeFeatureSize(n, indx, dist);
+}
+
+/*
+  Evaluate the feature size at a set of points. The closest points
+  are found for blocks of points at a time.
+*/
+void TMRPointFeatureSize::getFeatureSizes(int n, const TMRPoint *pts,
+                                          double *h) {
+  const int max_block_size = 4096;
+  int block_size = (n < max_block_size ? n : max_block_size);
+  int *nk = new int[block_size];
+  int *indx = new int[num_sample_pts * block_size];
+  double *dist = new double[num_sample_pts * block_size];
+
+  for (int start = 0; start < n; start += block_size) {
+    int size = (n - start < block_size ? n - start : block_size);
+    locator->locateClosest(num_sample_pts, size, &pts[start], nk, indx, dist);
+    for (int i = 0; i < size; i++) {
+      h[start + i] = computeFeatureSize(nk[i], &indx[num_sample_pts * i],
+                                        &dist[num_sample_pts * i]);
+    }
+  }
+
+  delete[] nk;
+  delete[] indx;
+  delete[] dist;
+}
+
+/*
+  Add the points, the feature sizes at the points and the sampling
+  parameters to the fingerprint
+*/
+int TMRPointFeatureSize::addFingerprint(TMRMeshFingerprint *fingerprint) {
+  const TMRPoint *pts;
+  locator->getPoints(&pts);
+
+  fingerprint->addString("TMRPointFeatureSize");
+  fingerprint->add(hmin);
+  fingerprint->add(hmax);
+  fingerprint->add(num_sample_pts);
+  fingerprint->add(npts);
+  fingerprint->add(pts, npts * sizeof(TMRPoint));
+  fingerprint->add(hvals, npts * sizeof(double));
+  return 0;
+}
+
+/*
+  Compute the feature size from the squared distances to the closest
+  points
+*/
+double TMRPointFeatureSize::computeFeatureSize(int n, const int *indx,
+                                               double *dist) {
+  double weights[MAX_CLOSEST_POINTS];
+
   // The maximum h-size squared
   double d = 10 * hmax;
   double dinv = 1.0 / d;
@@ -803,3 +1416,217 @@ double TMRPointFeatureSize::getFeatureSize(TMRPoint pt) {
 
   return h;
 }
+
+/*
+  Create the grid by sampling the feature size at the grid nodes
+
+  input:
+  p1, p2:      Opposite corners of the grid
+  nx, ny, nz:  The number of cells in each direction
+  fs:          The feature size to sample
+  hmin, hmax:  The min/max feature sizes
+*/
+TMRGridFeatureSize::TMRGridFeatureSize(TMRPoint p1, TMRPoint p2, int _nx,
+                                       int _ny, int _nz,
+                                       TMRElementFeatureSize *fs,
+                                       double _hmin, double _hmax)
+    : TMRElementFeatureSize(_hmin) {
+  init(p1, p2, _nx, _ny, _nz, _hmax);
+
+  // Evaluate the feature size at all of the nodes at once
+  int size = (nx + 1) * (ny + 1) * (nz + 1);
+  TMRPoint *X = new TMRPoint[size];
+  for (int k = 0, n = 0; k <= nz; k++) {
+    for (int j = 0; j <= ny; j++) {
+      for (int i = 0; i <= nx; i++, n++) {
+        X[n].x = xlow.x + (xhigh.x - xlow.x) * i / nx;
+        X[n].y = xlow.y + (xhigh.y - xlow.y) * j / ny;
+        X[n].z = xlow.z + (xhigh.z - xlow.z) * k / nz;
+      }
+    }
+  }
+
+  fs->getFeatureSizes(size, X, hvals);
+  delete[] X;
+
+  for (int n = 0; n < size; n++) {
+    if (hvals[n] < hmin) {
+      hvals[n] = hmin;
+    }
+    if (hvals[n] > hmax) {
+      hvals[n] = hmax;
+    }
+  }
+}
+
+/*
+  Create the grid from the values at the nodes, ordered with the
+  x index changing fastest
+*/
+TMRGridFeatureSize::TMRGridFeatureSize(TMRPoint p1, TMRPoint p2, int _nx,
+                                       int _ny, int _nz, const double *_hvals,
+                                       double _hmin, double _hmax)
+    : TMRElementFeatureSize(_hmin) {
+  init(p1, p2, _nx, _ny, _nz, _hmax);
+  memcpy(hvals, _hvals, (nx + 1) * (ny + 1) * (nz + 1) * sizeof(double));
+}
+
+TMRGridFeatureSize::~TMRGridFeatureSize() { delete[] hvals; }
+
+/*
+  Set the bounds and allocate the nodal values
+*/
+void TMRGridFeatureSize::init(TMRPoint p1, TMRPoint p2, int _nx, int _ny,
+                              int _nz, double _hmax) {
+  hmax = _hmax;
+  nx = (_nx > 1 ? _nx : 1);
+  ny = (_ny > 1 ? _ny : 1);
+  nz = (_nz > 1 ? _nz : 1);
+
+  xlow.x = (p1.x < p2.x ? p1.x : p2.x);
+  xlow.y = (p1.y < p2.y ? p1.y : p2.y);
+  xlow.z = (p1.z < p2.z ? p1.z : p2.z);
+  xhigh.x = (p1.x < p2.x ? p2.x : p1.x);
+  xhigh.y = (p1.y < p2.y ? p2.y : p1.y);
+  xhigh.z = (p1.z < p2.z ? p2.z : p1.z);
+
+  // A flat grid direction is evaluated at its lower bound
+  scale.x = (xhigh.x > xlow.x ? nx / (xhigh.x - xlow.x) : 0.0);
+  scale.y = (xhigh.y > xlow.y ? ny / (xhigh.y - xlow.y) : 0.0);
+  scale.z = (xhigh.z > xlow.z ? nz / (xhigh.z - xlow.z) : 0.0);
+
+  hvals = new double[(nx + 1) * (ny + 1) * (nz + 1)];
+}
+
+/*
+  Interpolate the feature size from the nodes of the enclosing cell
+*/
+double TMRGridFeatureSize::getFeatureSize(TMRPoint pt) {
+  // Find the grid coordinates, clamped to the bounds of the grid
+  double u = scale.x * (pt.x - xlow.x);
+  double v = scale.y * (pt.y - xlow.y);
+  double w = scale.z * (pt.z - xlow.z);
+  u = (u > 0.0 ? (u < nx ? u : nx) : 0.0);
+  v = (v > 0.0 ? (v < ny ? v : ny) : 0.0);
+  w = (w > 0.0 ? (w < nz ? w : nz) : 0.0);
+
+  // Find the cell and the parametric location within it
+  int i = (int)u, j = (int)v, k = (int)w;
+  i = (i < nx ? i : nx - 1);
+  j = (j < ny ? j : ny - 1);
+  k = (k < nz ? k : nz - 1);
+  u -= i;
+  v -= j;
+  w -= k;
+
+  const int sy = nx + 1;
+  const int sz = (nx + 1) * (ny + 1);
+  const double *h = &hvals[i + sy * j + sz * k];
+
+  // Interpolate along x, then y, then z
+  double h00 = h[0] + u * (h[1] - h[0]);
+  double h10 = h[sy] + u * (h[sy + 1] - h[sy]);
+  double h01 = h[sz] + u * (h[sz + 1] - h[sz]);
+  double h11 = h[sz + sy] + u * (h[sz + sy + 1] - h[sz + sy]);
+  double h0 = h00 + v * (h10 - h00);
+  double h1 = h01 + v * (h11 - h01);
+
+  return h0 + w * (h1 - h0);
+}
+
+/*
+  Evaluate the feature size at a set of points
+*/
+void TMRGridFeatureSize::getFeatureSizes(int n, const TMRPoint *pts,
+                                         double *h) {
+  for (int i = 0; i < n; i++) {
+    h[i] = getFeatureSize(pts[i]);
+  }
+}
+
+/*
+  Add the bounds of the grid and the nodal values to the fingerprint
+*/
+int TMRGridFeatureSize::addFingerprint(TMRMeshFingerprint *fingerprint) {
+  fingerprint->addString("TMRGridFeatureSize");
+  fingerprint->add(hmin);
+  fingerprint->add(hmax);
+  fingerprint->add(xlow);
+  fingerprint->add(xhigh);
+  fingerprint->add(nx);
+  fingerprint->add(ny);
+  fingerprint->add(nz);
+  fingerprint->add(hvals, (nx + 1) * (ny + 1) * (nz + 1) * sizeof(double));
+  return 0;
+}
+
+/*
+  Write the grid to a binary file in the native byte order. The file
+  contains the number of cells in each direction, the bounds of the
+  grid, the min/max feature sizes and the nodal values.
+
+  Returns a non-zero value on failure.
+*/
+int TMRGridFeatureSize::writeToFile(const char *filename) {
+  FILE *fp = fopen(filename, "wb");
+  if (!fp) {
+    return 1;
+  }
+
+  int size = (nx + 1) * (ny + 1) * (nz + 1);
+  int dims[3] = {nx, ny, nz};
+  double bounds[8] = {xlow.x,  xlow.y,  xlow.z, xhigh.x,
+                      xhigh.y, xhigh.z, hmin,   hmax};
+
+  int fail = 0;
+  if (fwrite(dims, sizeof(int), 3, fp) != 3 ||
+      fwrite(bounds, sizeof(double), 8, fp) != 8 ||
+      fwrite(hvals, sizeof(double), size, fp) != (size_t)size) {
+    fail = 1;
+  }
+  fclose(fp);
+
+  return fail;
+}
+
+/*
+  Create the grid from a file written by writeToFile. Returns NULL
+  if the file cannot be read.
+*/
+TMRGridFeatureSize *TMRGridFeatureSize::createFromFile(const char *filename) {
+  FILE *fp = fopen(filename, "rb");
+  if (!fp) {
+    return NULL;
+  }
+
+  int dims[3];
+  double bounds[8];
+  if (fread(dims, sizeof(int), 3, fp) != 3 ||
+      fread(bounds, sizeof(double), 8, fp) != 8 || dims[0] < 1 ||
+      dims[1] < 1 || dims[2] < 1) {
+    fclose(fp);
+    return NULL;
+  }
+
+  int size = (dims[0] + 1) * (dims[1] + 1) * (dims[2] + 1);
+  double *h = new double[size];
+  if (fread(h, sizeof(double), size, fp) != (size_t)size) {
+    fclose(fp);
+    delete[] h;
+    return NULL;
+  }
+  fclose(fp);
+
+  TMRPoint p1, p2;
+  p1.x = bounds[0];
+  p1.y = bounds[1];
+  p1.z = bounds[2];
+  p2.x = bounds[3];
+  p2.y = bounds[4];
+  p2.z = bounds[5];
+  TMRGridFeatureSize *grid = new TMRGridFeatureSize(
+      p1, p2, dims[0], dims[1], dims[2], h, bounds[6], bounds[7]);
+  delete[] h;
+
+  return grid;
+}
@@ -21,10 +21,20 @@
 #ifndef TMR_FEATURE_SIZE_H
 #define TMR_FEATURE_SIZE_H
 
+#include <pthread.h>
+
 #include "TMRBase.h"
 
+class TMRMeshFingerprint;
+
 /*
   The element feature size class
+
+  The addFingerprint() call adds the data that defines the feature
+  size to the key used for the mesh cache. It returns a non-zero
+  fail flag when the feature size cannot be represented exactly, in
+  which case the meshes are not cached. Classes derived outside of
+  this file must override it to take part in the mesh cache.
 */
 class TMRElementFeatureSize : public TMREntity {
  public:
@@ -32,6 +42,12 @@ class TMRElementFeatureSize : public TMREntity {
   virtual ~TMRElementFeatureSize();
   virtual double getFeatureSize(TMRPoint pt);
 
+  // Evaluate the feature size at a set of points
+  virtual void getFeatureSizes(int n, const TMRPoint *pts, double *h);
+
+  // Add the data that defines the feature size to the fingerprint
+  virtual int addFingerprint(TMRMeshFingerprint *fingerprint);
+
  protected:
   // The min local feature size
   double hmin;
@@ -46,6 +62,8 @@ class TMRLinearElementSize : public TMRElementFeatureSize {
                        double _ay, double _az);
   ~TMRLinearElementSize();
   double getFeatureSize(TMRPoint pt);
+  void getFeatureSizes(int n, const TMRPoint *pts, double *h);
+  int addFingerprint(TMRMeshFingerprint *fingerprint);
 
  private:
   double hmax;
@@ -61,17 +79,23 @@ class TMRBoxFeatureSize : public TMRElementFeatureSize {
   ~TMRBoxFeatureSize();
   void addBox(TMRPoint p1, TMRPoint p2, double h);
   double getFeatureSize(TMRPoint pt);
+  void getFeatureSizes(int n, const TMRPoint *pts, double *h);
+  int addFingerprint(TMRMeshFingerprint *fingerprint);
 
  private:
+  // Create the flattened copy of the box tree used for evaluation
+  void initFlatTree();
+  void freeFlatTree();
+
+  // Find the feature size from the flattened tree
+  inline double getFlatSize(const TMRPoint &p);
+
   // Maximum feature size
   double hmax;
 
   // Store the information about the points
   class BoxSize {
    public:
-    // Check whether the box contains a point
-    int contains(TMRPoint p);
-
     // Data for the box and its location
     TMRPoint m;  // Center of the box
     TMRPoint d;  // Half-edge length of each box
@@ -101,9 +125,6 @@ class TMRBoxFeatureSize : public TMRElementFeatureSize {
     // Add a box
     void addBox(BoxSize *ptr);
 
-    // Add a box to the data structure
-    void getSize(TMRPoint pt, double *h);
-
     // The mid-point of the node and the distance from the mid-point
     // to the box sides
     TMRPoint m, d;
@@ -115,6 +136,18 @@ class TMRBoxFeatureSize : public TMRElementFeatureSize {
     int num_boxes;
     BoxSize **boxes;
   } * root;
+
+  // The flattened tree is created on the first evaluation after a box
+  // is added. Each node stores the index of its first child (the
+  // eight children are contiguous) or -1, and the offset and number
+  // of its boxes. The node bounds store the mid-point and the lower
+  // and upper bounds in each direction, and each box stores its
+  // lower and upper bounds and its mesh size.
+  int num_tree_nodes;
+  int *tree_nodes;
+  double *tree_bounds;
+  double *tree_boxes;
+  pthread_mutex_t tree_mutex;
 };
 
 /*
@@ -125,7 +158,7 @@ class TMRBoxFeatureSize : public TMRElementFeatureSize {
 */
 class TMRPointLocator : public TMREntity {
  public:
-  TMRPointLocator(int npts, TMRPoint *pts);
+  TMRPointLocator(int npts, TMRPoint *pts, int _num_threads = 1);
   ~TMRPointLocator();
 
   // Find the K-closest points within the point cloud. Note
@@ -133,30 +166,85 @@ class TMRPointLocator : public TMREntity {
   void locateClosest(const int K, const TMRPoint pt, int *nk, int *indx,
                      double *dist);
 
+  // Find the K-closest points to each of n points. The results for
+  // the i-th point are stored in nk[i] and indx/dist[K*i]
+  void locateClosest(const int K, const int n, const TMRPoint *pt, int *nk,
+                     int *indx, double *dist);
+
+  // Get the points in the point cloud
+  int getPoints(const TMRPoint **_pts);
+
  private:
   static const int MAX_BIN_SIZE = 16;
+  static const int QUERY_BLOCK_SIZE = 64;
+
+  // The nodes within the tree or within a subtree. Each node stores
+  // its left and right children, or -1 for a leaf. Leaves store the
+  // range of their indices, while the other nodes store the plane
+  // that splits the points between the children.
+  class NodeList {
+   public:
+    NodeList(int _max_num_nodes);
+    ~NodeList();
+    int addNode();
+
+    int num_nodes, max_num_nodes;
+    int *nodes;
+    int *index_offset, *index_count;
+    TMRPoint *node_loc, *node_normal;
+  };
+
+  // A bounded max-heap of the closest points found so far. Points at
+  // the same distance are ordered by when they were found.
+  class ClosestHeap {
+   public:
+    void insert(int n, double d);
+    void sort();
+
+    int K, nk, count;
+    int *indx, *seq;
+    double *dist;
+
+   private:
+    inline int greater(int i, int j);
+    void siftDown(int i, int size);
+  };
+
+  // Data shared by the threads that build the subtrees or perform
+  // the queries
+  class ThreadData {
+   public:
+    TMRPointLocator *locator;
+    int next, num_tasks;
+    int *task_nodes;
+    NodeList **subtrees;
+    int K;
+    const TMRPoint *pts;
+    const int *order;
+    int *nk, *indx;
+    double *dist;
+  };
+  static void *buildThread(void *arg);
+  static void *queryThread(void *arg);
+  void runThreads(void *(*func)(void *), ThreadData *data);
 
   // Private functions
-  int split(int start, int end);
+  int split(NodeList *list, int start, int end, int depth);
   int partitionPoints(TMRPoint *loc, TMRPoint *normal, int *indx, int np);
 
   // Find the points that are closest to the provided point
-  void locateClosest(const int K, const int root, const TMRPoint pt, int *nk,
-                     int *indx, double *dist);
+  void locateClosest(const int root, const TMRPoint pt, ClosestHeap *heap);
 
-  // Insert the point into the list
-  void insertIndex(const int K, int dindx, double d, int *nk, int *indx,
-                   double *dist);
+  // The number of threads used to build the tree and for queries
+  int num_threads;
 
   // Point data
   int npts;
   TMRPoint *pts;
 
   // Private data for a sorted spatial data structure
-  int num_nodes, max_num_nodes;
-  int *indices, *nodes;
-  int *index_offset, *index_count;
-  TMRPoint *node_loc, *node_normal;
+  int *indices;
+  NodeList *tree;
 };
 
 /*
@@ -168,11 +256,17 @@ class TMRPointFeatureSize : public TMRElementFeatureSize {
   static const int MAX_CLOSEST_POINTS = 64;
 
   TMRPointFeatureSize(int npts, TMRPoint *pts, double *hvals, double _hmin,
-                      double _hmax, int _num_sample_pts = 16);
+                      double _hmax, int _num_sample_pts = 16,
+                      int _num_threads = 1);
   ~TMRPointFeatureSize();
   double getFeatureSize(TMRPoint pt);
+  void getFeatureSizes(int n, const TMRPoint *pts, double *h);
+  int addFingerprint(TMRMeshFingerprint *fingerprint);
 
  private:
+  // Compute the feature size from the closest points
+  double computeFeatureSize(int n, const int *indx, double *dist);
+
   // Find the closest point in the point cloud
   TMRPointLocator *locator;
 
@@ -187,4 +281,44 @@ class TMRPointFeatureSize : public TMRElementFeatureSize {
   int num_sample_pts;
 };
 
+/*
+  A feature size stored at the nodes of a uniform grid and evaluated
+  by trilinear interpolation.
+
+  The grid values are sampled once from another feature size, for
+  instance a TMRPointFeatureSize, so that repeated evaluations do not
+  repeat the closest point queries. The grid can be written to a
+  binary file and read back for later meshing runs. Points outside
+  the grid use the value at the closest point on the grid boundary.
+*/
+class TMRGridFeatureSize : public TMRElementFeatureSize {
+ public:
+  TMRGridFeatureSize(TMRPoint p1, TMRPoint p2, int _nx, int _ny, int _nz,
+                     TMRElementFeatureSize *fs, double _hmin, double _hmax);
+  TMRGridFeatureSize(TMRPoint p1, TMRPoint p2, int _nx, int _ny, int _nz,
+                     const double *_hvals, double _hmin, double _hmax);
+  ~TMRGridFeatureSize();
+  double getFeatureSize(TMRPoint pt);
+  void getFeatureSizes(int n, const TMRPoint *pts, double *h);
+  int addFingerprint(TMRMeshFingerprint *fingerprint);
+
+  // Write the grid to a binary file and read it back
+  int writeToFile(const char *filename);
+  static TMRGridFeatureSize *createFromFile(const char *filename);
+
+ private:
+  void init(TMRPoint p1, TMRPoint p2, int _nx, int _ny, int _nz,
+            double _hmax);
+
+  // Maximum feature size
+  double hmax;
+
+  // The bounds of the grid and the scaling to grid coordinates
+  TMRPoint xlow, xhigh, scale;
+
+  // The number of cells in each direction and the nodal values
+  int nx, ny, nz;
+  double *hvals;
+};
+
 #endif  // TMR_FEATURE_SIZE_H
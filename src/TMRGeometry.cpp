@@ -25,6 +25,19 @@
 
 #include "TMRMesh.h"
 
+/*
+  Evaluate the curve at an array of parametric locations
+*/
+int TMRCurve::evalPoints(int n, const double *t, TMRPoint *X) {
+  int fail = 0;
+  for (int i = 0; i < n; i++) {
+    if (evalPoint(t[i], &X[i])) {
+      fail = 1;
+    }
+  }
+  return fail;
+}
+
 /*
   Compute the inverse: This is not always required. By default it is
   not implemented. Derived classes can implement it if needed.
@@ -180,6 +193,40 @@ void TMRCurve::writeToVTK(const char *filename) {
 */
 double TMRSurface::deriv_step_size = 1e-6;
 
+/*
+  Perform the inverse evaluation from an initial guess
+*/
+int TMRSurface::invEvalPoint(TMRPoint p, double u0, double v0, double *u,
+                             double *v) {
+  return invEvalPoint(p, u, v);
+}
+
+/*
+  Evaluate the points at an array of parametric locations
+*/
+int TMRSurface::evalPoints(int n, const double *prm, TMRPoint *X) {
+  int fail = 0;
+  for (int i = 0; i < n; i++) {
+    if (evalPoint(prm[2 * i], prm[2 * i + 1], &X[i])) {
+      fail = 1;
+    }
+  }
+  return fail;
+}
+
+/*
+  Perform the inverse evaluation for an array of points
+*/
+int TMRSurface::invEvalPoints(int n, const TMRPoint *X, double *prm) {
+  int fail = 0;
+  for (int i = 0; i < n; i++) {
+    if (invEvalPoint(X[i], &prm[2 * i], &prm[2 * i + 1])) {
+      fail = 1;
+    }
+  }
+  return fail;
+}
+
 /*
   Evaluate the derivative using a finite-difference step size
 */
@@ -362,3 +409,16 @@ void TMRSurface::writeToVTK(const char *filename) {
     fclose(fp);
   }
 }
+
+/*
+  Evaluate the parametric curve at an array of parametric locations
+*/
+int TMRPcurve::evalPoints(int n, const double *t, double *prm) {
+  int fail = 0;
+  for (int i = 0; i < n; i++) {
+    if (evalPoint(t[i], &prm[2 * i], &prm[2 * i + 1])) {
+      fail = 1;
+    }
+  }
+  return fail;
+}
@@ -45,6 +45,10 @@ class TMRCurve : public TMREntity {
   // Given the parametric point, evaluate the x,y,z location
   virtual int evalPoint(double t, TMRPoint *X) = 0;
 
+  // Evaluate an array of n points. The default implementation loops
+  // over the points.
+  virtual int evalPoints(int n, const double *t, TMRPoint *X);
+
   // Given the point, find the parametric location
   virtual int invEvalPoint(TMRPoint X, double *t);
 
@@ -77,6 +81,16 @@ class TMRSurface : public TMREntity {
   // Perform the inverse evaluation
   virtual int invEvalPoint(TMRPoint p, double *u, double *v) = 0;
 
+  // Perform the inverse evaluation starting from the guess (u0, v0).
+  // By default, the guess is ignored.
+  virtual int invEvalPoint(TMRPoint p, double u0, double v0, double *u,
+                           double *v);
+
+  // Evaluate or invert an array of n points with interleaved (u, v)
+  // parameters. The default implementations loop over the points.
+  virtual int evalPoints(int n, const double *prm, TMRPoint *X);
+  virtual int invEvalPoints(int n, const TMRPoint *X, double *prm);
+
   // Given the parametric point, evaluate the first derivative
   virtual int evalDeriv(double u, double v, TMRPoint *X, TMRPoint *Xu,
                         TMRPoint *Xv);
@@ -106,6 +120,10 @@ class TMRPcurve : public TMREntity {
   // Given the parametric point, evaluate the x,y,z location
   virtual int evalPoint(double t, double *u, double *v) = 0;
 
+  // Evaluate an array of n points with interleaved (u, v) output. The
+  // default implementation loops over the points.
+  virtual int evalPoints(int n, const double *t, double *prm);
+
   // Given the parametric point, evaluate the derivative
   virtual int evalDeriv(double t, double *u, double *v, double *ut,
                         double *vt) = 0;
@@ -60,4 +60,12 @@ inline uint32_t TMRIntegerFiveTupleHash(uint32_t u, uint32_t v, uint32_t w,
   return TMR_FINAL_HASH(u, v, w);
 }
 
+/*
+  Create a hash value for a pointer
+*/
+inline uint32_t TMRPointerHash(const void *ptr) {
+  uint64_t p = (uint64_t)(uintptr_t)ptr;
+  return TMRIntegerPairHash((uint32_t)(p & 0xffffffff), (uint32_t)(p >> 32));
+}
+
 #endif  // TMR_HASH_FUNCTION_H
@@ -21,6 +21,8 @@
 #ifndef TMR_INTERPOLATION_FUNCTIONS_H
 #define TMR_INTERPOLATION_FUNCTIONS_H
 
+#include "TMRBase.h"
+
 /*
   The following file defines the inline interpolation functions used
   by TMR.
@@ -559,4 +561,266 @@ inline int eval_bernstein_interp_weights(const int mesh_order,
   return 1;
 }
 
+/*
+  Compute the barycentric weights for the Lagrange shape functions
+
+  The weights w[i] = 1/prod_{j != i}(knots[i] - knots[j]) are fixed for
+  a given set of knots, so computing them once removes the divisions
+  from the fixed-order evaluation routines below.
+
+  input:
+  order:  the order of the polynomial and number of knots
+  knots:  the interpolation knots in parameter space
+
+  output:
+  w:      the barycentric weights
+*/
+inline void lagrange_weights(const int order, const double *knots,
+                             double *w) {
+  for (int i = 0; i < order; i++) {
+    w[i] = 1.0;
+    for (int j = 0; j < order; j++) {
+      if (i != j) {
+        w[i] /= (knots[i] - knots[j]);
+      }
+    }
+  }
+}
+
+/*
+  Evaluate the Lagrange shape functions for a compile-time order
+
+  input:
+  u:      the parametric coordinate
+  knots:  the interpolation knots in parameter space
+  w:      the barycentric weights from lagrange_weights()
+
+  output:
+  N:      the values of the shape functions at u
+*/
+template <int order>
+inline void lagrange_shape_functions(const double u, const double *knots,
+                                     const double *w, double *N) {
+  double d[order];
+  for (int j = 0; j < order; j++) {
+    d[j] = u - knots[j];
+  }
+  for (int i = 0; i < order; i++) {
+    double p = w[i];
+    for (int j = 0; j < order; j++) {
+      if (i != j) {
+        p *= d[j];
+      }
+    }
+    N[i] = p;
+  }
+}
+
+/*
+  Evaluate the Lagrange shape functions and their derivatives for a
+  compile-time order
+
+  input:
+  u:      the parametric coordinate
+  knots:  the interpolation knots in parameter space
+  w:      the barycentric weights from lagrange_weights()
+
+  output:
+  N:      the values of the shape functions at u
+  Nd:     the derivative of the shape functions at u
+*/
+template <int order>
+inline void lagrange_shape_func_derivative(const double u,
+                                           const double *knots,
+                                           const double *w, double *N,
+                                           double *Nd) {
+  double d[order];
+  for (int j = 0; j < order; j++) {
+    d[j] = u - knots[j];
+  }
+  for (int i = 0; i < order; i++) {
+    // Accumulate the product and its derivative together
+    double p = 1.0, dp = 0.0;
+    for (int j = 0; j < order; j++) {
+      if (i != j) {
+        dp = dp * d[j] + p;
+        p *= d[j];
+      }
+    }
+    N[i] = w[i] * p;
+    Nd[i] = w[i] * dp;
+  }
+}
+
+/*
+  Evaluate the 1D shape functions for a compile-time order and basis
+*/
+template <int order, TMRInterpolationType interp_type>
+inline void eval_shape_functions(const double u, const double *knots,
+                                 const double *w, double *N) {
+  if (interp_type == TMR_BERNSTEIN_POINTS) {
+    bernstein_shape_functions(order, u, N);
+  } else {
+    lagrange_shape_functions<order>(u, knots, w, N);
+  }
+}
+
+template <int order, TMRInterpolationType interp_type>
+inline void eval_shape_func_derivative(const double u, const double *knots,
+                                       const double *w, double *N,
+                                       double *Nd) {
+  if (interp_type == TMR_BERNSTEIN_POINTS) {
+    bernstein_shape_func_derivative(order, u, N, Nd);
+  } else {
+    lagrange_shape_func_derivative<order>(u, knots, w, N, Nd);
+  }
+}
+
+/*
+  Tensor-product interpolation kernels for a compile-time order and
+  interpolation type. The forests select one instance of each kernel
+  when the mesh order is set so that the loops below are fully
+  unrolled for the common element orders.
+
+  input:
+  knots:  the interpolation knots in parameter space
+  w:      the barycentric weights from lagrange_weights()
+  pt:     the parametric point
+
+  output:
+  N:      the shape functions (and derivatives) at the point
+*/
+template <int order, TMRInterpolationType interp_type>
+void eval_tensor_interp_2d(const double *knots, const double *w,
+                           const double pt[], double N[]) {
+  double Nu[order], Nv[order];
+  eval_shape_functions<order, interp_type>(pt[0], knots, w, Nu);
+  eval_shape_functions<order, interp_type>(pt[1], knots, w, Nv);
+
+  for (int j = 0; j < order; j++) {
+    for (int i = 0; i < order; i++) {
+      N[i + order * j] = Nu[i] * Nv[j];
+    }
+  }
+}
+
+template <int order, TMRInterpolationType interp_type>
+void eval_tensor_interp_deriv_2d(const double *knots, const double *w,
+                                 const double pt[], double N[], double N1[],
+                                 double N2[]) {
+  double Nu[order], Nv[order], Nud[order], Nvd[order];
+  eval_shape_func_derivative<order, interp_type>(pt[0], knots, w, Nu, Nud);
+  eval_shape_func_derivative<order, interp_type>(pt[1], knots, w, Nv, Nvd);
+
+  for (int j = 0; j < order; j++) {
+    for (int i = 0; i < order; i++) {
+      N[i + order * j] = Nu[i] * Nv[j];
+      N1[i + order * j] = Nud[i] * Nv[j];
+      N2[i + order * j] = Nu[i] * Nvd[j];
+    }
+  }
+}
+
+template <int order, TMRInterpolationType interp_type>
+void eval_tensor_interp_3d(const double *knots, const double *w,
+                           const double pt[], double N[]) {
+  double Nu[order], Nv[order], Nw[order];
+  eval_shape_functions<order, interp_type>(pt[0], knots, w, Nu);
+  eval_shape_functions<order, interp_type>(pt[1], knots, w, Nv);
+  eval_shape_functions<order, interp_type>(pt[2], knots, w, Nw);
+
+  for (int k = 0; k < order; k++) {
+    for (int j = 0; j < order; j++) {
+      const double Nvw = Nv[j] * Nw[k];
+      for (int i = 0; i < order; i++) {
+        N[i + order * (j + order * k)] = Nu[i] * Nvw;
+      }
+    }
+  }
+}
+
+template <int order, TMRInterpolationType interp_type>
+void eval_tensor_interp_deriv_3d(const double *knots, const double *w,
+                                 const double pt[], double N[], double N1[],
+                                 double N2[], double N3[]) {
+  double Nu[order], Nv[order], Nw[order];
+  double Nud[order], Nvd[order], Nwd[order];
+  eval_shape_func_derivative<order, interp_type>(pt[0], knots, w, Nu, Nud);
+  eval_shape_func_derivative<order, interp_type>(pt[1], knots, w, Nv, Nvd);
+  eval_shape_func_derivative<order, interp_type>(pt[2], knots, w, Nw, Nwd);
+
+  for (int k = 0; k < order; k++) {
+    for (int j = 0; j < order; j++) {
+      const double Nvw = Nv[j] * Nw[k];
+      const double Nvdw = Nvd[j] * Nw[k];
+      const double Nvwd = Nv[j] * Nwd[k];
+      for (int i = 0; i < order; i++) {
+        const int n = i + order * (j + order * k);
+        N[n] = Nu[i] * Nvw;
+        N1[n] = Nud[i] * Nvw;
+        N2[n] = Nu[i] * Nvdw;
+        N3[n] = Nu[i] * Nvwd;
+      }
+    }
+  }
+}
+
+/*
+  Retrieve the kernels specialized for the given order and
+  interpolation type. The Lagrange kernels are shared between the
+  uniform and Gauss-Lobatto points since they differ only in the knots.
+  The kernels are set to NULL for orders without a specialization.
+*/
+template <TMRInterpolationType interp_type>
+inline void get_tensor_interp_kernels(const int order, TMRInterpKernel *k2d,
+                                      TMRInterpDerivKernel2D *dk2d,
+                                      TMRInterpKernel *k3d,
+                                      TMRInterpDerivKernel3D *dk3d) {
+  *k2d = NULL;
+  *dk2d = NULL;
+  *k3d = NULL;
+  *dk3d = NULL;
+  if (order == 2) {
+    *k2d = eval_tensor_interp_2d<2, interp_type>;
+    *dk2d = eval_tensor_interp_deriv_2d<2, interp_type>;
+    *k3d = eval_tensor_interp_3d<2, interp_type>;
+    *dk3d = eval_tensor_interp_deriv_3d<2, interp_type>;
+  } else if (order == 3) {
+    *k2d = eval_tensor_interp_2d<3, interp_type>;
+    *dk2d = eval_tensor_interp_deriv_2d<3, interp_type>;
+    *k3d = eval_tensor_interp_3d<3, interp_type>;
+    *dk3d = eval_tensor_interp_deriv_3d<3, interp_type>;
+  } else if (order == 4) {
+    *k2d = eval_tensor_interp_2d<4, interp_type>;
+    *dk2d = eval_tensor_interp_deriv_2d<4, interp_type>;
+    *k3d = eval_tensor_interp_3d<4, interp_type>;
+    *dk3d = eval_tensor_interp_deriv_3d<4, interp_type>;
+  } else if (order == 5) {
+    *k2d = eval_tensor_interp_2d<5, interp_type>;
+    *dk2d = eval_tensor_interp_deriv_2d<5, interp_type>;
+    *k3d = eval_tensor_interp_3d<5, interp_type>;
+    *dk3d = eval_tensor_interp_deriv_3d<5, interp_type>;
+  } else if (order == 6) {
+    *k2d = eval_tensor_interp_2d<6, interp_type>;
+    *dk2d = eval_tensor_interp_deriv_2d<6, interp_type>;
+    *k3d = eval_tensor_interp_3d<6, interp_type>;
+    *dk3d = eval_tensor_interp_deriv_3d<6, interp_type>;
+  }
+}
+
+inline void get_tensor_interp_kernels(const int order,
+                                      TMRInterpolationType interp_type,
+                                      TMRInterpKernel *k2d,
+                                      TMRInterpDerivKernel2D *dk2d,
+                                      TMRInterpKernel *k3d,
+                                      TMRInterpDerivKernel3D *dk3d) {
+  if (interp_type == TMR_BERNSTEIN_POINTS) {
+    get_tensor_interp_kernels<TMR_BERNSTEIN_POINTS>(order, k2d, dk2d, k3d,
+                                                    dk3d);
+  } else {
+    get_tensor_interp_kernels<TMR_UNIFORM_POINTS>(order, k2d, dk2d, k3d,
+                                                  dk3d);
+  }
+}
+
 #endif  // TMR_INTERPOLATION_FUNCTIONS_H
@@ -21,7 +21,12 @@
 #include "TMRMesh.h"
 
 #include <math.h>
+#include <pthread.h>
+#include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "TMRBspline.h"
 #include "TMREdgeMesh.h"
@@ -30,8 +35,13 @@
 #include "TMRNativeTopology.h"
 #include "TMRTriangularize.h"
 #include "TMRVolumeMesh.h"
+#include "TMR_QualityTools.h"
+#include "TMR_VTKTools.h"
 #include "tmrlapack.h"
 
+#include <queue>
+#include <vector>
+
 /*
   The triangle nodes and edges are ordered locally as follows. Note
   that the edges are ordered based on the node across the triangle.
@@ -107,104 +117,11 @@ const int hex_face_nodes[6][4] = {{0, 3, 7, 4}, {1, 2, 6, 5},   // x-faces
                                   {0, 4, 5, 1}, {3, 7, 6, 2},   // y-faces
                                   {0, 1, 2, 3}, {4, 5, 6, 7}};  // z-faces
 
-/*
-  Possible orientations for two connecting faces
-*/
-const int face_orientations[8][4] = {{0, 1, 2, 3}, {1, 2, 3, 0}, {2, 3, 0, 1},
-                                     {3, 0, 1, 2}, {3, 2, 1, 0}, {0, 3, 2, 1},
-                                     {1, 0, 3, 2}, {2, 1, 0, 3}};
-
 /*
   Hexahedral local node to local coordinate ordering transformation
 */
 const int hex_coordinate_order[] = {0, 1, 3, 2, 4, 5, 7, 6};
 
-/*
-  Compare coordinate pairs of points. This uses a Morton ordering
-  comparison to facilitate sorting/searching the list of edges.
-
-  This function can be used by the stdlib functions qsort and
-  bsearch to sort/search the edge pairs.
-*/
-static int compare_edges(const void *avoid, const void *bvoid) {
-  const int *a = static_cast<const int *>(avoid);
-  const int *b = static_cast<const int *>(bvoid);
-
-  // Extract the x/y locations for the a and b points
-  int ax = a[1], ay = a[2];
-  int bx = b[1], by = b[2];
-
-  int xxor = ax ^ bx;
-  int yxor = ay ^ by;
-  int sor = xxor | yxor;
-
-  // Note that here we do not distinguish between levels
-  // Check for the most-significant bit
-  int discrim = 0;
-  if (xxor > (sor ^ xxor)) {
-    discrim = ax - bx;
-  } else {
-    discrim = ay - by;
-  }
-
-  return discrim;
-}
-
-/*
-  Compare two edges to one another directly (not-indexed)
-*/
-static int compare_edges_simple(const void *avoid, const void *bvoid) {
-  const int *a = static_cast<const int *>(avoid);
-  const int *b = static_cast<const int *>(bvoid);
-
-  // Extract the x/y locations for the a and b points
-  int ax = a[0], ay = a[1];
-  int bx = b[0], by = b[1];
-
-  int xxor = ax ^ bx;
-  int yxor = ay ^ by;
-  int sor = xxor | yxor;
-
-  // Note that here we do not distinguish between levels
-  // Check for the most-significant bit
-  int discrim = 0;
-  if (xxor > (sor ^ xxor)) {
-    discrim = ax - bx;
-  } else {
-    discrim = ay - by;
-  }
-
-  return discrim;
-}
-
-/*
-  Compare faces. The faces themselves must be sorted such that
-  the indices are increasing.
-
-  This is used to determine the resulting face number given the
-  corresponding list of nodes.
-*/
-static int compare_faces(const void *avoid, const void *bvoid) {
-  const int *a = static_cast<const int *>(avoid);
-  const int *b = static_cast<const int *>(bvoid);
-
-  if (a[1] == b[1]) {
-    if (a[2] == b[2]) {
-      if (a[3] == b[3]) {
-        return a[4] - b[4];
-      } else {
-        return a[3] - b[3];
-      }
-    } else {
-      return a[2] - b[2];
-    }
-  } else {
-    return a[1] - b[1];
-  }
-
-  return 0;
-}
-
 /*
   Sort the nodes witin a face array
 */
@@ -245,6 +162,303 @@ static inline void sort_face_nodes(int *node) {
   }
 }
 
+/*
+  Find the first occurrence of each element edge
+
+  For each node in the range [start, end), loop over the elements that
+  contain the node and find the element edges whose lowest node number
+  is this node. The edges are matched by their other node and each
+  element edge is assigned the index (num_elem_edges*elem + local edge)
+  of its first occurrence. Each edge is only visited from its lowest
+  node, so different node ranges can be processed concurrently.
+*/
+static void TMR_FindFirstEdges(int start, int end, const int ptr[],
+                               const int node_to_elems[], int num_elem_nodes,
+                               int num_elem_edges, const int edge_nodes[][2],
+                               const int conn[], int edge_first[]) {
+  // Compute the local edges and the other local node for the edges
+  // that touch each local node
+  int *local_ptr = new int[num_elem_nodes + 1];
+  int *local_edges = new int[4 * num_elem_edges];
+  local_ptr[0] = 0;
+  for (int l = 0; l < num_elem_nodes; l++) {
+    local_ptr[l + 1] = local_ptr[l];
+    for (int j = 0; j < num_elem_edges; j++) {
+      for (int k = 0; k < 2; k++) {
+        if (edge_nodes[j][k] == l) {
+          local_edges[2 * local_ptr[l + 1]] = j;
+          local_edges[2 * local_ptr[l + 1] + 1] = edge_nodes[j][1 - k];
+          local_ptr[l + 1]++;
+        }
+      }
+    }
+  }
+
+  // The (other node, first index) pairs for the edges at this node
+  int max_size = 0;
+  int *edges = NULL;
+
+  for (int n = start; n < end; n++) {
+    int len = num_elem_edges * (ptr[n + 1] - ptr[n]);
+    if (len > max_size) {
+      max_size = 2 * len;
+      if (edges) {
+        delete[] edges;
+      }
+      edges = new int[2 * max_size];
+    }
+
+    int size = 0;
+    for (int kp = ptr[n]; kp < ptr[n + 1]; kp++) {
+      int elem = node_to_elems[kp];
+      const int *c = &conn[num_elem_nodes * elem];
+
+      for (int l = 0; l < num_elem_nodes; l++) {
+        if (c[l] != n) {
+          continue;
+        }
+        for (int jp = local_ptr[l]; jp < local_ptr[l + 1]; jp++) {
+          int m = c[local_edges[2 * jp + 1]];
+          if (m < n) {
+            continue;
+          }
+
+          // Search for the edge among the edges at this node
+          int index = num_elem_edges * elem + local_edges[2 * jp];
+          int k = 0;
+          while (k < size && edges[2 * k] != m) {
+            k++;
+          }
+          if (k < size) {
+            edge_first[index] = edges[2 * k + 1];
+          } else {
+            edges[2 * size] = m;
+            edges[2 * size + 1] = index;
+            edge_first[index] = index;
+            size++;
+          }
+        }
+      }
+    }
+  }
+
+  delete[] local_ptr;
+  delete[] local_edges;
+  if (edges) {
+    delete[] edges;
+  }
+}
+
+/*
+  Find the first occurrence of each hexahedral face
+
+  This is the same as TMR_FindFirstEdges except that the faces are
+  matched by the three remaining sorted node numbers.
+*/
+static void TMR_FindFirstHexFaces(int start, int end, const int ptr[],
+                                  const int node_to_hex[], const int hex[],
+                                  int face_first[]) {
+  // The (other nodes, first index) tuples for the faces at this node
+  int max_size = 0;
+  int *faces = NULL;
+
+  for (int n = start; n < end; n++) {
+    int len = 6 * (ptr[n + 1] - ptr[n]);
+    if (len > max_size) {
+      max_size = 2 * len;
+      if (faces) {
+        delete[] faces;
+      }
+      faces = new int[4 * max_size];
+    }
+
+    int size = 0;
+    for (int kp = ptr[n]; kp < ptr[n + 1]; kp++) {
+      int ihex = node_to_hex[kp];
+      const int *c = &hex[8 * ihex];
+
+      for (int j = 0; j < 6; j++) {
+        // Skip the faces that do not have n as their lowest node
+        int f[4];
+        int contains = 0, lowest = 1;
+        for (int k = 0; k < 4; k++) {
+          f[k] = c[hex_face_nodes[j][k]];
+          contains = contains || (f[k] == n);
+          lowest = lowest && (f[k] >= n);
+        }
+        if (!contains || !lowest) {
+          continue;
+        }
+        sort_face_nodes(f);
+
+        // Search for the face among the faces at this node
+        int index = 6 * ihex + j;
+        int k = 0;
+        while (k < size &&
+               (faces[4 * k] != f[1] || faces[4 * k + 1] != f[2] ||
+                faces[4 * k + 2] != f[3])) {
+          k++;
+        }
+        if (k < size) {
+          face_first[index] = faces[4 * k + 3];
+        } else {
+          faces[4 * size] = f[1];
+          faces[4 * size + 1] = f[2];
+          faces[4 * size + 2] = f[3];
+          faces[4 * size + 3] = index;
+          face_first[index] = index;
+          size++;
+        }
+      }
+    }
+  }
+
+  if (faces) {
+    delete[] faces;
+  }
+}
+
+/*
+  Convert the index of the first occurrence of each entity to a unique
+  entity number in place. The entities are numbered in the order of
+  their first occurrence. Entries that are negative are not numbered.
+*/
+static int TMR_NumberFirstEntities(int size, int nums[]) {
+  int count = 0;
+  for (int i = 0; i < size; i++) {
+    if (nums[i] == i) {
+      nums[i] = count;
+      count++;
+    } else if (nums[i] >= 0) {
+      nums[i] = nums[nums[i]];
+    }
+  }
+  return count;
+}
+
+/*
+  The data passed to each thread that finds the hexahedral edges and
+  faces within a range of nodes
+*/
+class TMRHexEntityData {
+ public:
+  int start, end;
+  const int *ptr, *node_to_hex;
+  const int *hex;
+  int *edge_first, *face_first;
+};
+
+static void *TMR_FindFirstHexEntitiesThread(void *arg) {
+  TMRHexEntityData *data = static_cast<TMRHexEntityData *>(arg);
+  TMR_FindFirstEdges(data->start, data->end, data->ptr, data->node_to_hex, 8,
+                     12, hex_edge_nodes, data->hex, data->edge_first);
+  TMR_FindFirstHexFaces(data->start, data->end, data->ptr, data->node_to_hex,
+                        data->hex, data->face_first);
+  return NULL;
+}
+
+/*
+  Create an index of the edges based on their lowest node number. For
+  each node, the index stores the (other node, edge number) pairs.
+*/
+static void TMR_ComputeEdgeIndex(int nnodes, int nedges, const int edges[],
+                                 int **_ptr, int **_index) {
+  int *ptr = new int[nnodes + 1];
+  memset(ptr, 0, (nnodes + 1) * sizeof(int));
+  for (int i = 0; i < nedges; i++) {
+    int n1 = edges[2 * i], n2 = edges[2 * i + 1];
+    ptr[(n1 < n2 ? n1 : n2) + 1]++;
+  }
+  for (int i = 0; i < nnodes; i++) {
+    ptr[i + 1] += ptr[i];
+  }
+
+  int *index = new int[2 * ptr[nnodes]];
+  for (int i = 0; i < nedges; i++) {
+    int n1 = edges[2 * i], n2 = edges[2 * i + 1];
+    int n = (n1 < n2 ? n1 : n2);
+    index[2 * ptr[n]] = (n1 < n2 ? n2 : n1);
+    index[2 * ptr[n] + 1] = i;
+    ptr[n]++;
+  }
+  for (int i = nnodes - 1; i >= 0; i--) {
+    ptr[i + 1] = ptr[i];
+  }
+  ptr[0] = 0;
+
+  *_ptr = ptr;
+  *_index = index;
+}
+
+/*
+  Find the edge with the given nodes in the edge index. The nodes must
+  be sorted so that n1 <= n2. Returns -1 if the edge does not exist.
+*/
+static int TMR_FindEdgeIndex(const int ptr[], const int index[], int n1,
+                             int n2) {
+  for (int k = ptr[n1]; k < ptr[n1 + 1]; k++) {
+    if (index[2 * k] == n2) {
+      return index[2 * k + 1];
+    }
+  }
+  return -1;
+}
+
+/*
+  Create an index of the quadrilateral faces based on their lowest node
+  number. For each node, the index stores the remaining three sorted
+  nodes and the face number.
+*/
+static void TMR_ComputeFaceIndex(int nnodes, int nfaces, const int faces[],
+                                 int **_ptr, int **_index) {
+  int *ptr = new int[nnodes + 1];
+  memset(ptr, 0, (nnodes + 1) * sizeof(int));
+  for (int i = 0; i < nfaces; i++) {
+    int f[4];
+    memcpy(f, &faces[4 * i], 4 * sizeof(int));
+    sort_face_nodes(f);
+    ptr[f[0] + 1]++;
+  }
+  for (int i = 0; i < nnodes; i++) {
+    ptr[i + 1] += ptr[i];
+  }
+
+  int *index = new int[4 * ptr[nnodes]];
+  for (int i = 0; i < nfaces; i++) {
+    int f[4];
+    memcpy(f, &faces[4 * i], 4 * sizeof(int));
+    sort_face_nodes(f);
+    int *entry = &index[4 * ptr[f[0]]];
+    entry[0] = f[1];
+    entry[1] = f[2];
+    entry[2] = f[3];
+    entry[3] = i;
+    ptr[f[0]]++;
+  }
+  for (int i = nnodes - 1; i >= 0; i--) {
+    ptr[i + 1] = ptr[i];
+  }
+  ptr[0] = 0;
+
+  *_ptr = ptr;
+  *_index = index;
+}
+
+/*
+  Find the face with the given sorted nodes in the face index. Returns
+  -1 if the face does not exist.
+*/
+static int TMR_FindFaceIndex(const int ptr[], const int index[],
+                             const int f[]) {
+  for (int k = ptr[f[0]]; k < ptr[f[0] + 1]; k++) {
+    const int *entry = &index[4 * k];
+    if (entry[0] == f[1] && entry[1] == f[2] && entry[2] == f[3]) {
+      return entry[3];
+    }
+  }
+  return -1;
+}
+
 /*
   Compute a node to triangle or node to quad data structure
 */
@@ -272,12 +486,11 @@ void TMR_ComputeNodeToElems(int nnodes, int nelems, int num_elem_nodes,
   int *node_to_elems = new int[ptr[nnodes]];
   const int *conn_ptr = conn;
   for (int i = 0; i < nelems; i++) {
-    for (int j = 0; j < num_elem_nodes; j++) {
+    for (int j = 0; j < num_elem_nodes; j++, conn_ptr++) {
       int node = conn_ptr[0];
       if (node >= 0) {
         node_to_elems[ptr[node]] = i;
         ptr[node]++;
-        conn_ptr++;
       }
     }
   }
@@ -422,49 +635,48 @@ void TMR_ComputePlanarTriEdges(int nnodes, int ntris, const int tris[],
 }
 
 /*
-  Compute the connectivity between the edges
+  Compute the unique edges within a quadrilateral mesh
+
+  The edges are numbered in the order that they first appear in the
+  quadrilateral connectivity and the lowest node number is stored
+  first for each edge.
 */
 void TMR_ComputeQuadEdges(int nnodes, int nquads, const int quads[],
                           int *_num_quad_edges, int **_quad_edges) {
-  // 4 edges for each quad, with 2 nodes per edge
-  int num_edges = 4 * nquads;
-  int *quad_edges = new int[8 * nquads];
-
-  for (int i = 0; i < nquads; i++) {
-    for (int j = 0; j < 4; j++) {
-      int e[2];
-      e[0] = quads[4 * i + quad_edge_nodes[j][0]];
-      e[1] = quads[4 * i + quad_edge_nodes[j][1]];
+  // Compute the connectivity from nodes to quads
+  int *ptr;
+  int *node_to_quads;
+  TMR_ComputeNodeToElems(nnodes, nquads, 4, quads, &ptr, &node_to_quads);
 
-      if (e[0] < e[1]) {
-        quad_edges[8 * i + 2 * j] = e[0];
-        quad_edges[8 * i + 2 * j + 1] = e[1];
-      } else {
-        quad_edges[8 * i + 2 * j] = e[1];
-        quad_edges[8 * i + 2 * j + 1] = e[0];
-      }
-    }
+  // Find the first occurrence of each quad edge and number them
+  int *quad_edge_nums = new int[4 * nquads];
+  for (int i = 0; i < 4 * nquads; i++) {
+    quad_edge_nums[i] = -1;
   }
+  TMR_FindFirstEdges(0, nnodes, ptr, node_to_quads, 4, 4, quad_edge_nodes,
+                     quads, quad_edge_nums);
+  int num_edges = TMR_NumberFirstEntities(4 * nquads, quad_edge_nums);
 
-  // Sort all of the edges
-  qsort(quad_edges, num_edges, 2 * sizeof(int), compare_edges_simple);
-
-  int index = 0;
-  for (int i = 0; i < num_edges; index++) {
-    if (i != index) {
-      quad_edges[2 * index] = quad_edges[2 * i];
-      quad_edges[2 * index + 1] = quad_edges[2 * i + 1];
-    }
+  delete[] ptr;
+  delete[] node_to_quads;
 
-    // Loop over the edges to find the next unique one
-    while (i < num_edges && compare_edges_simple(&quad_edges[2 * index],
-                                                 &quad_edges[2 * i]) == 0) {
-      i++;
+  // Create the unique list of edges
+  int *quad_edges = new int[2 * num_edges];
+  for (int i = 0; i < nquads; i++) {
+    for (int j = 0; j < 4; j++) {
+      int e = quad_edge_nums[4 * i + j];
+      if (e >= 0) {
+        int n1 = quads[4 * i + quad_edge_nodes[j][0]];
+        int n2 = quads[4 * i + quad_edge_nodes[j][1]];
+        quad_edges[2 * e] = (n1 < n2 ? n1 : n2);
+        quad_edges[2 * e + 1] = (n1 < n2 ? n2 : n1);
+      }
     }
   }
+  delete[] quad_edge_nums;
 
   *_quad_edges = quad_edges;
-  *_num_quad_edges = index;
+  *_num_quad_edges = num_edges;
 }
 
 /*
@@ -604,17 +816,30 @@ void TMR_ComputePlanarQuadEdges(int nnodes, int nquads, const int quads[],
 
 /*
   Compute the connectivity between edges within a hexahedral mesh
+
+  The edges and faces are numbered in the order that they first appear
+  in the hexahedral connectivity. The first occurrence of each edge and
+  face is found from the node to hexahedral connectivity by visiting
+  each entity from its lowest node number. The nodes are split into
+  contiguous ranges with roughly equal numbers of node to hex entries
+  that are processed by separate threads.
+
+  The node to hexahedral connectivity is computed along the way and is
+  returned in CSR format if _node_to_hex_ptr and _node_to_hex are
+  provided.
 */
 void TMR_ComputeHexEdgesAndFaces(int nnodes, int nhex, const int hex[],
                                  int *_num_hex_edges, int **_hex_edges,
                                  int **_hex_edge_nums, int *_num_hex_faces,
-                                 int **_hex_faces, int **_hex_face_nums) {
+                                 int **_hex_faces, int **_hex_face_nums,
+                                 int **_node_to_hex_ptr, int **_node_to_hex,
+                                 int num_threads) {
   // Compute the connectivity from nodes to hex
   int *ptr;
   int *node_to_hex;
   TMR_ComputeNodeToElems(nnodes, nhex, 8, hex, &ptr, &node_to_hex);
 
-  // Comput the neighbors for each hex
+  // Find the first occurrence of each edge and face
   int *hex_edge_nums = new int[12 * nhex];
   int *hex_face_nums = new int[6 * nhex];
   for (int i = 0; i < 12 * nhex; i++) {
@@ -624,103 +849,62 @@ void TMR_ComputeHexEdgesAndFaces(int nnodes, int nhex, const int hex[],
     hex_face_nums[i] = -1;
   }
 
-  int edge_num = 0, face_num = 0;
-  for (int i = 0; i < nhex; i++) {
-    // Search through each hexahedral element for the edge
-    for (int j = 0; j < 12; j++) {
-      if (hex_edge_nums[12 * i + j] < 0) {
-        hex_edge_nums[12 * i + j] = edge_num;
-
-        // Find the edge nodes for the new edge
-        int e[2];
-        e[0] = hex[8 * i + hex_edge_nodes[j][0]];
-        e[1] = hex[8 * i + hex_edge_nodes[j][1]];
-
-        // Find the node that shares the edge
-        int kp = ptr[e[0]];
-        int kpend = ptr[e[0] + 1];
-
-        for (; kp < kpend; kp++) {
-          // Find the potential hex neighbor
-          int ihex = node_to_hex[kp];
-          if (i == ihex) {
-            continue;
-          }
-
-          // Search over all the edges on this hex, and see if any of
-          // the edges match
-          for (int k = 0; k < 12; k++) {
-            int e2[2];
-            e2[0] = hex[8 * ihex + hex_edge_nodes[k][0]];
-            e2[1] = hex[8 * ihex + hex_edge_nodes[k][1]];
-
-            // Check if the adjacent edge matches in either direction
-            if ((e[0] == e2[0] && e[1] == e2[1]) ||
-                (e[0] == e2[1] && e[1] == e2[0])) {
-              hex_edge_nums[12 * ihex + k] = edge_num;
-            }
-          }
-        }
+  if (num_threads > nnodes) {
+    num_threads = nnodes;
+  }
+  if (num_threads < 1) {
+    num_threads = 1;
+  }
 
-        // Increment the edge number
-        edge_num++;
+  TMRHexEntityData *data = new TMRHexEntityData[num_threads];
+  for (int k = 0, n = 0; k < num_threads; k++) {
+    data[k].start = n;
+    if (k == num_threads - 1) {
+      n = nnodes;
+    } else {
+      long int target = ((long int)(k + 1) * ptr[nnodes]) / num_threads;
+      while (n < nnodes && ptr[n] < target) {
+        n++;
       }
     }
-
-    // Search through adjacent hexahedral elements for the faces
-    for (int j = 0; j < 6; j++) {
-      if (hex_face_nums[6 * i + j] < 0) {
-        hex_face_nums[6 * i + j] = face_num;
-
-        // Find the nodes associated with face j
-        int f[4];
-        f[0] = hex[8 * i + hex_face_nodes[j][0]];
-        f[1] = hex[8 * i + hex_face_nodes[j][1]];
-        f[2] = hex[8 * i + hex_face_nodes[j][2]];
-        f[3] = hex[8 * i + hex_face_nodes[j][3]];
-
-        // Find a node that shares the face
-        int kp = ptr[f[0]];
-        int kpend = ptr[f[0] + 1];
-
-        for (; kp < kpend; kp++) {
-          // Find the potential hex neighbor
-          int ihex = node_to_hex[kp];
-          if (i == ihex) {
-            continue;
-          }
-
-          // Search over all the faces on this hex, and see if any of
-          // the edges match
-          for (int k = 0; k < 6; k++) {
-            int f2[4];
-            f2[0] = hex[8 * ihex + hex_face_nodes[k][0]];
-            f2[1] = hex[8 * ihex + hex_face_nodes[k][1]];
-            f2[2] = hex[8 * ihex + hex_face_nodes[k][2]];
-            f2[3] = hex[8 * ihex + hex_face_nodes[k][3]];
-
-            // Check if the adjacent edge matches in either direction
-            for (int ort = 0; ort < 8; ort++) {
-              if (f[0] == f2[face_orientations[ort][0]] &&
-                  f[1] == f2[face_orientations[ort][1]] &&
-                  f[2] == f2[face_orientations[ort][2]] &&
-                  f[3] == f2[face_orientations[ort][3]]) {
-                hex_face_nums[6 * ihex + k] = face_num;
-                break;
-              }
-            }
-          }
-        }
-
-        // Increment the face number
-        face_num++;
-      }
+    data[k].end = n;
+    data[k].ptr = ptr;
+    data[k].node_to_hex = node_to_hex;
+    data[k].hex = hex;
+    data[k].edge_first = hex_edge_nums;
+    data[k].face_first = hex_face_nums;
+  }
+
+  if (num_threads > 1) {
+    pthread_t *threads = new pthread_t[num_threads];
+    for (int k = 0; k < num_threads; k++) {
+      pthread_create(&threads[k], NULL, TMR_FindFirstHexEntitiesThread,
+                     (void *)&data[k]);
     }
+    for (int k = 0; k < num_threads; k++) {
+      pthread_join(threads[k], NULL);
+    }
+    delete[] threads;
+  } else {
+    TMR_FindFirstHexEntitiesThread((void *)&data[0]);
   }
+  delete[] data;
 
-  // Free the node->hex data
-  delete[] ptr;
-  delete[] node_to_hex;
+  // Number the edges and faces in the order of their first occurrence
+  int edge_num = TMR_NumberFirstEntities(12 * nhex, hex_edge_nums);
+  int face_num = TMR_NumberFirstEntities(6 * nhex, hex_face_nums);
+
+  // Free the node->hex data or return it
+  if (_node_to_hex_ptr) {
+    *_node_to_hex_ptr = ptr;
+  } else {
+    delete[] ptr;
+  }
+  if (_node_to_hex) {
+    *_node_to_hex = node_to_hex;
+  } else {
+    delete[] node_to_hex;
+  }
 
   if (_num_hex_edges) {
     *_num_hex_edges = edge_num;
@@ -775,44 +959,301 @@ void TMR_ComputeHexEdgesAndFaces(int nnodes, int nhex, const int hex[],
 }
 
 /*
-  Mesh the given geometry and retrieve either a regular mesh
+  A node and its degree, used to order the neighbors of a node
 */
-TMRMesh::TMRMesh(MPI_Comm _comm, TMRModel *_geo) {
-  // Initialize the TMR-specific MPI data types
-  if (!TMRIsInitialized()) {
-    TMRInitialize();
-  }
-
-  // Copy the communicator
-  comm = _comm;
-  geo = _geo;
-  geo->incref();
+struct TMRNodeDegree {
+  int node;
+  int degree;
+};
 
-  // Set the mesh properties
-  num_nodes = 0;
-  num_quads = 0;
-  num_tris = 0;
-  num_hex = 0;
-  num_tet = 0;
-  quads = NULL;
-  tris = NULL;
-  hex = NULL;
-  tet = NULL;
-  X = NULL;
+/*
+  Compare two nodes by degree. Ties are broken by the node number.
+*/
+static int compare_node_degrees(const void *avoid, const void *bvoid) {
+  const TMRNodeDegree *a = static_cast<const TMRNodeDegree *>(avoid);
+  const TMRNodeDegree *b = static_cast<const TMRNodeDegree *>(bvoid);
+  if (a->degree != b->degree) {
+    return a->degree - b->degree;
+  }
+  return a->node - b->node;
 }
 
-TMRMesh::~TMRMesh() {
-  // Free the meshes created here...
-  int num_edges;
-  TMREdge **edges;
-  geo->getEdges(&num_edges, &edges);
-  for (int i = 0; i < num_edges; i++) {
-    TMREdgeMesh *mesh = NULL;
-    edges[i]->getMesh(&mesh);
-    if (mesh) {
-      delete mesh;
-    }
-    edges[i]->setMesh(NULL);
+/*
+  Compute a reverse Cuthill-McKee ordering of the nodes in a mesh
+
+  The nodes are ordered by a breadth-first search through the nodes
+  that share an element. Each search starts from the unordered node
+  with the lowest degree, and the neighbors of each node are added in
+  order of increasing degree. The final order is reversed. Nodes that
+  are not in any element are ordered as separate components.
+
+  input:
+  nnodes:     the number of nodes
+  nelems:     the number of elements
+  elem_ptr:   pointer into the element connectivity
+  elem_conn:  the element connectivity
+
+  output:
+  new_nums:   the new number for each of the nodes
+*/
+void TMR_ComputeRCMOrder(int nnodes, int nelems, const int elem_ptr[],
+                         const int elem_conn[], int new_nums[]) {
+  // Compute the elements that contain each node
+  int *node_ptr = new int[nnodes + 1];
+  memset(node_ptr, 0, (nnodes + 1) * sizeof(int));
+  for (int i = 0; i < elem_ptr[nelems]; i++) {
+    node_ptr[elem_conn[i] + 1]++;
+  }
+  for (int i = 0; i < nnodes; i++) {
+    node_ptr[i + 1] += node_ptr[i];
+  }
+  int *node_elems = new int[node_ptr[nnodes]];
+  for (int e = 0; e < nelems; e++) {
+    for (int j = elem_ptr[e]; j < elem_ptr[e + 1]; j++) {
+      int n = elem_conn[j];
+      node_elems[node_ptr[n]] = e;
+      node_ptr[n]++;
+    }
+  }
+  for (int i = nnodes; i > 0; i--) {
+    node_ptr[i] = node_ptr[i - 1];
+  }
+  node_ptr[0] = 0;
+
+  // Sort the nodes by degree to find the roots of each search. The
+  // number of adjacent elements is used as the degree.
+  TMRNodeDegree *roots = new TMRNodeDegree[nnodes];
+  for (int i = 0; i < nnodes; i++) {
+    roots[i].node = i;
+    roots[i].degree = node_ptr[i + 1] - node_ptr[i];
+  }
+  qsort(roots, nnodes, sizeof(TMRNodeDegree), compare_node_degrees);
+
+  // The Cuthill-McKee order of the nodes
+  int *order = new int[nnodes];
+  for (int i = 0; i < nnodes; i++) {
+    new_nums[i] = -1;
+  }
+
+  // Temporary storage for the neighbors of a node
+  int max_size = 0;
+  for (int i = 0; i < nnodes; i++) {
+    int size = 0;
+    for (int j = node_ptr[i]; j < node_ptr[i + 1]; j++) {
+      int e = node_elems[j];
+      size += elem_ptr[e + 1] - elem_ptr[e];
+    }
+    if (size > max_size) {
+      max_size = size;
+    }
+  }
+  TMRNodeDegree *next = new TMRNodeDegree[max_size];
+
+  int n = 0;
+  for (int r = 0; r < nnodes; r++) {
+    int root = roots[r].node;
+    if (new_nums[root] >= 0) {
+      continue;
+    }
+
+    // Start a new search from this root
+    int start = n;
+    new_nums[root] = n;
+    order[n] = root;
+    n++;
+
+    while (start < n) {
+      int node = order[start];
+      start++;
+
+      // Find the neighbors that have not yet been ordered
+      int nnext = 0;
+      for (int j = node_ptr[node]; j < node_ptr[node + 1]; j++) {
+        int e = node_elems[j];
+        for (int k = elem_ptr[e]; k < elem_ptr[e + 1]; k++) {
+          int adj = elem_conn[k];
+          if (new_nums[adj] < 0) {
+            new_nums[adj] = n;
+            next[nnext].node = adj;
+            next[nnext].degree = node_ptr[adj + 1] - node_ptr[adj];
+            nnext++;
+            n++;
+          }
+        }
+      }
+
+      // Add the neighbors in order of increasing degree
+      qsort(next, nnext, sizeof(TMRNodeDegree), compare_node_degrees);
+      for (int k = 0; k < nnext; k++) {
+        new_nums[next[k].node] = n - nnext + k;
+        order[n - nnext + k] = next[k].node;
+      }
+    }
+  }
+
+  // Reverse the order
+  for (int i = 0; i < nnodes; i++) {
+    new_nums[order[i]] = nnodes - 1 - i;
+  }
+
+  delete[] node_ptr;
+  delete[] node_elems;
+  delete[] roots;
+  delete[] order;
+  delete[] next;
+}
+
+/*
+  Add the options that modify the face meshes to the fingerprint
+*/
+void TMRMeshFingerprint::addOptions(const TMRMeshOptions &options) {
+  add(options.num_smoothing_steps);
+  add((int)options.tri_smoothing_type);
+  add(options.frontal_quality_factor);
+  add(options.num_frontal_subdomains);
+  add(options.frontal_subdomain_min_triangles);
+  add(options.smoothing_tolerance);
+  add(options.greedy_recombine_min_triangles);
+  add(options.greedy_recombine_tolerance);
+}
+
+/*
+  Add the sample points to the fingerprint
+*/
+void TMRMeshFingerprint::addPoints(int npts, const TMRPoint *X) {
+  for (int i = 0; i < npts; i++) {
+    add(X[i]);
+  }
+}
+
+/*
+  Add the feature size to the fingerprint. The feature size is not
+  sampled, since two feature sizes that agree at the sample points
+  may still produce different meshes.
+*/
+int TMRMeshFingerprint::addFeatureSize(TMRElementFeatureSize *fs) {
+  if (fs) {
+    add(1);
+    return fs->addFingerprint(this);
+  }
+  add(0);
+  return 0;
+}
+
+// The identifier at the start of each mesh cache file, followed by
+// the format version and the key
+static const char tmr_mesh_cache_magic[8] = {'T', 'M', 'R', 'M',
+                                             'E', 'S', 'H', 'C'};
+
+/*
+  Get the name of the file in the mesh cache for the given key
+*/
+void TMR_GetMeshCacheFileName(const char *cache_dir, const char *prefix,
+                              uint64_t key, char *filename, size_t len) {
+  snprintf(filename, len, "%s/%s.%016llx.tmrmesh", cache_dir, prefix,
+           (unsigned long long)key);
+}
+
+/*
+  Open the cache file for reading and check the header. Returns NULL
+  if the file does not exist, has a different format version or is
+  not for this key.
+*/
+FILE *TMR_OpenMeshCacheFile(const char *filename, uint64_t key) {
+  FILE *fp = fopen(filename, "rb");
+  if (fp) {
+    char magic[8];
+    int version;
+    uint64_t file_key;
+    if (fread(magic, 1, 8, fp) != 8 ||
+        memcmp(magic, tmr_mesh_cache_magic, 8) != 0 ||
+        fread(&version, sizeof(int), 1, fp) != 1 ||
+        version != TMR_MESH_CACHE_FORMAT_VERSION ||
+        fread(&file_key, sizeof(uint64_t), 1, fp) != 1 || file_key != key) {
+      fclose(fp);
+      fp = NULL;
+    }
+  }
+  return fp;
+}
+
+/*
+  Create a temporary file for a new entry in the cache and write the
+  header. The temporary file name is unique to the process and the
+  calling thread.
+*/
+FILE *TMR_CreateMeshCacheFile(const char *filename, uint64_t key,
+                              char *tmp_file, size_t len) {
+  snprintf(tmp_file, len, "%s.%d.%lx.tmp", filename, (int)getpid(),
+           (unsigned long)pthread_self());
+  FILE *fp = fopen(tmp_file, "wb");
+  if (fp) {
+    int version = TMR_MESH_CACHE_FORMAT_VERSION;
+    fwrite(tmr_mesh_cache_magic, 1, 8, fp);
+    fwrite(&version, sizeof(int), 1, fp);
+    fwrite(&key, sizeof(uint64_t), 1, fp);
+  } else {
+    fprintf(stderr, "TMRMesh Warning: Unable to write cache file %s\n",
+            filename);
+  }
+  return fp;
+}
+
+/*
+  Close the temporary file and move it into the cache, or remove it
+  if writing the file failed
+*/
+void TMR_CloseMeshCacheFile(FILE *fp, const char *tmp_file,
+                            const char *filename, int fail) {
+  if (fclose(fp) != 0) {
+    fail = 1;
+  }
+  if (fail || rename(tmp_file, filename) != 0) {
+    remove(tmp_file);
+  }
+}
+
+/*
+  Mesh the given geometry and retrieve either a regular mesh
+*/
+TMRMesh::TMRMesh(MPI_Comm _comm, TMRModel *_geo) {
+  // Initialize the TMR-specific MPI data types
+  if (!TMRIsInitialized()) {
+    TMRInitialize();
+  }
+
+  // Copy the communicator
+  comm = _comm;
+  geo = _geo;
+  geo->incref();
+
+  // Set the mesh properties
+  num_nodes = 0;
+  num_quads = 0;
+  num_tris = 0;
+  num_hex = 0;
+  num_tet = 0;
+  quads = NULL;
+  tris = NULL;
+  hex = NULL;
+  tet = NULL;
+  X = NULL;
+  node_ordering = TMR_NATURAL_ORDER;
+  num_threads = 1;
+}
+
+TMRMesh::~TMRMesh() {
+  // Free the meshes created here...
+  int num_edges;
+  TMREdge **edges;
+  geo->getEdges(&num_edges, &edges);
+  for (int i = 0; i < num_edges; i++) {
+    TMREdgeMesh *mesh = NULL;
+    edges[i]->getMesh(&mesh);
+    if (mesh) {
+      delete mesh;
+    }
+    edges[i]->setMesh(NULL);
   }
 
   int num_faces;
@@ -840,6 +1281,13 @@ TMRMesh::~TMRMesh() {
   }
 
   geo->decref();
+  freeMeshArrays();
+}
+
+/*
+  Free the global mesh arrays. They are created again on demand.
+*/
+void TMRMesh::freeMeshArrays() {
   if (quads) {
     delete[] quads;
   }
@@ -855,6 +1303,11 @@ TMRMesh::~TMRMesh() {
   if (X) {
     delete[] X;
   }
+  quads = NULL;
+  tris = NULL;
+  hex = NULL;
+  tet = NULL;
+  X = NULL;
 }
 
 /*
@@ -919,15 +1372,724 @@ void TMRMesh::resetMesh() {
   }
 }
 
+/*
+  Find the root of a group of entities that must be meshed together
+*/
+static int find_mesh_group(int *group, int i) {
+  while (group[i] != i) {
+    group[i] = group[group[i]];
+    i = group[i];
+  }
+  return i;
+}
+
+/*
+  Merge the groups containing entities i and j. The root of the
+  merged group is the entity with the lowest index.
+*/
+static void merge_mesh_groups(int *group, int i, int j) {
+  int ri = find_mesh_group(group, i);
+  int rj = find_mesh_group(group, j);
+  if (ri < rj) {
+    group[rj] = ri;
+  } else {
+    group[ri] = rj;
+  }
+}
+
+/*
+  Find the entities within each group, in order of increasing index.
+  Only the flagged entities are added to the groups.
+*/
+static void compute_mesh_groups(int n, int *group, const int *flags,
+                                int **_ptr, int **_list) {
+  int *ptr = new int[n + 1];
+  int *list = new int[n];
+  memset(ptr, 0, (n + 1) * sizeof(int));
+  for (int i = 0; i < n; i++) {
+    if (flags[i]) {
+      ptr[find_mesh_group(group, i) + 1]++;
+    }
+  }
+  for (int i = 0; i < n; i++) {
+    ptr[i + 1] += ptr[i];
+  }
+  for (int i = 0; i < n; i++) {
+    if (flags[i]) {
+      int g = find_mesh_group(group, i);
+      list[ptr[g]] = i;
+      ptr[g]++;
+    }
+  }
+  for (int i = n; i > 0; i--) {
+    ptr[i] = ptr[i - 1];
+  }
+  ptr[0] = 0;
+
+  *_ptr = ptr;
+  *_list = list;
+}
+
+/*
+  Estimate the cost of meshing a face as the square of the number of
+  points on its boundary. Edges without a mesh are not counted.
+*/
+static double estimate_face_mesh_cost(TMRFace *face) {
+  int npts = 0;
+  int nloops = face->getNumEdgeLoops();
+  for (int k = 0; k < nloops; k++) {
+    TMREdgeLoop *loop;
+    face->getEdgeLoop(k, &loop);
+    int nedges;
+    TMREdge **edges;
+    loop->getEdgeLoop(&nedges, &edges, NULL);
+    for (int j = 0; j < nedges; j++) {
+      TMREdgeMesh *mesh = NULL;
+      edges[j]->getMesh(&mesh);
+      if (mesh) {
+        int n;
+        mesh->getMeshPoints(&n, NULL, NULL);
+        npts += n;
+      }
+    }
+  }
+
+  return 1.0 + 1.0 * npts * npts;
+}
+
+/*
+  Sort the face groups by decreasing cost. Ties are broken by the
+  group index so that all processors produce the same ordering.
+*/
+struct TMRFaceCost {
+  int group;
+  double cost;
+};
+
+static int compare_face_costs(const void *avoid, const void *bvoid) {
+  const TMRFaceCost *a = static_cast<const TMRFaceCost *>(avoid);
+  const TMRFaceCost *b = static_cast<const TMRFaceCost *>(bvoid);
+  if (a->cost > b->cost) {
+    return -1;
+  } else if (a->cost < b->cost) {
+    return 1;
+  }
+  return a->group - b->group;
+}
+
+/*
+  The task graph used to mesh the edges, faces and volumes
+
+  Each task meshes a group of edges, a group of faces or a single
+  volume. A task is added to the ready queue as soon as all of the
+  tasks that it depends on are complete: a group of faces waits for
+  the edges on its boundary and a volume waits for its faces. The
+  ready tasks are executed by a pool of threads in order of decreasing
+  priority. The edges are executed first, since they are inexpensive
+  and release the faces, and the faces are ordered by their estimated
+  cost.
+
+  The edge and face meshes are created on MPI_COMM_SELF so that no
+  communication takes place within the threads.
+*/
+class TMRMeshTaskGraph {
+ public:
+  static const int EDGE_TASK = 0;
+  static const int FACE_TASK = 1;
+  static const int VOLUME_TASK = 2;
+
+  TMRMeshTaskGraph(TMRMeshOptions *_options, TMRElementFeatureSize *_fs,
+                   MPI_Comm _comm, TMREdge **_edges, TMRFace **_faces,
+                   TMRVolume **_volumes) {
+    options = _options;
+    fs = _fs;
+    comm = _comm;
+    edges = _edges;
+    faces = _faces;
+    volumes = _volumes;
+    task_ptr.push_back(0);
+    num_complete = 0;
+  }
+
+  // Add a task that meshes the given entities in order
+  int addTask(int type, int n, const int items[]) {
+    int task = task_type.size();
+    task_type.push_back(type);
+    for (int k = 0; k < n; k++) {
+      task_items.push_back(items[k]);
+    }
+    task_ptr.push_back(task_items.size());
+    dep_count.push_back(0);
+    dependents.push_back(std::vector<int>());
+    return task;
+  }
+
+  // The task cannot start until the prerequisite completes
+  void addDependency(int task, int prereq) {
+    dep_count[task]++;
+    dependents[prereq].push_back(task);
+  }
+
+  // Execute all tasks with the given number of threads
+  void run(int num_threads) {
+    int num_tasks = task_type.size();
+    for (int task = 0; task < num_tasks; task++) {
+      if (dep_count[task] == 0) {
+        ready.push(std::pair<double, int>(getPriority(task), -task));
+      }
+    }
+
+    if (num_threads > num_tasks) {
+      num_threads = num_tasks;
+    }
+    if (num_threads > 1) {
+      pthread_mutex_init(&mutex, NULL);
+      pthread_cond_init(&cond, NULL);
+
+      pthread_t *threads = new pthread_t[num_threads];
+      for (int k = 0; k < num_threads; k++) {
+        pthread_create(&threads[k], NULL, runThread, (void *)this);
+      }
+      for (int k = 0; k < num_threads; k++) {
+        pthread_join(threads[k], NULL);
+      }
+      delete[] threads;
+
+      pthread_mutex_destroy(&mutex);
+      pthread_cond_destroy(&cond);
+    } else {
+      while (!ready.empty()) {
+        int task = -ready.top().second;
+        ready.pop();
+        runTask(task);
+        releaseDependents(task);
+      }
+    }
+  }
+
+ private:
+  static void *runThread(void *arg) {
+    TMRMeshTaskGraph *graph = static_cast<TMRMeshTaskGraph *>(arg);
+    graph->runTasks();
+    return NULL;
+  }
+
+  // Retrieve the ready tasks until all tasks are complete
+  void runTasks() {
+    int num_tasks = task_type.size();
+
+    pthread_mutex_lock(&mutex);
+    while (1) {
+      while (ready.empty() && num_complete < num_tasks) {
+        pthread_cond_wait(&cond, &mutex);
+      }
+      if (ready.empty()) {
+        break;
+      }
+      int task = -ready.top().second;
+      ready.pop();
+      pthread_mutex_unlock(&mutex);
+
+      runTask(task);
+
+      pthread_mutex_lock(&mutex);
+      num_complete++;
+      releaseDependents(task);
+      pthread_cond_broadcast(&cond);
+    }
+    pthread_mutex_unlock(&mutex);
+  }
+
+  // Add the tasks that depend only on this task to the ready queue
+  void releaseDependents(int task) {
+    for (size_t k = 0; k < dependents[task].size(); k++) {
+      int next = dependents[task][k];
+      dep_count[next]--;
+      if (dep_count[next] == 0) {
+        ready.push(std::pair<double, int>(getPriority(next), -next));
+      }
+    }
+  }
+
+  // Get the priority of a task that is ready to execute
+  double getPriority(int task) {
+    if (task_type[task] == EDGE_TASK) {
+      return 1e30;
+    } else if (task_type[task] == FACE_TASK) {
+      double cost = 0.0;
+      for (int k = task_ptr[task]; k < task_ptr[task + 1]; k++) {
+        cost += estimate_face_mesh_cost(faces[task_items[k]]);
+      }
+      return cost;
+    }
+    return 1.0;
+  }
+
+  // Mesh the entities associated with the task
+  void runTask(int task) {
+    for (int k = task_ptr[task]; k < task_ptr[task + 1]; k++) {
+      int i = task_items[k];
+      if (task_type[task] == EDGE_TASK) {
+        TMREdgeMesh *mesh = NULL;
+        edges[i]->getMesh(&mesh);
+        if (!mesh) {
+          mesh = new TMREdgeMesh(MPI_COMM_SELF, edges[i]);
+          mesh->mesh(*options, fs);
+          edges[i]->setMesh(mesh);
+        }
+      } else if (task_type[task] == FACE_TASK) {
+        TMRFaceMesh *mesh = NULL;
+        faces[i]->getMesh(&mesh);
+        if (!mesh) {
+          mesh = new TMRFaceMesh(MPI_COMM_SELF, faces[i]);
+          mesh->mesh(*options, fs);
+          faces[i]->setMesh(mesh);
+        }
+      } else {
+        // Failed volume meshes are discarded here. The volume is
+        // meshed again by TMRMesh::mesh which reports the failure.
+        TMRVolumeMesh *mesh = new TMRVolumeMesh(comm, volumes[i]);
+        mesh->incref();
+        if (mesh->mesh(*options)) {
+          mesh->decref();
+        } else {
+          volumes[i]->setMesh(mesh);
+        }
+      }
+    }
+  }
+
+  // The meshing options and entities
+  TMRMeshOptions *options;
+  TMRElementFeatureSize *fs;
+  MPI_Comm comm;
+  TMREdge **edges;
+  TMRFace **faces;
+  TMRVolume **volumes;
+
+  // The entities meshed by each task
+  std::vector<int> task_type;
+  std::vector<int> task_ptr;
+  std::vector<int> task_items;
+
+  // The number of incomplete prerequisites and the dependent tasks
+  std::vector<int> dep_count;
+  std::vector<std::vector<int> > dependents;
+
+  // The tasks ready for execution, ordered by priority
+  std::priority_queue<std::pair<double, int> > ready;
+  int num_complete;
+
+  // Protect the queue and the dependency counts
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+};
+
+/*
+  Mesh the model in parallel.
+
+  The faces are split into groups that must be meshed on the same
+  processor: a target face is meshed from its source face and a copy
+  face from its copy source. The groups are assigned to processors
+  either in contiguous blocks (TMR_STATIC_DISTRIBUTION) or by a greedy
+  split of the estimated cost (TMR_COST_DISTRIBUTION). With
+  TMR_NO_DISTRIBUTION, all groups are owned by the root processor.
+  Each processor meshes its faces independently and the meshes are
+  then broadcast from their owners so that every processor has the
+  full surface mesh before the nodes are numbered.
+
+  The local work is executed as a task graph (see TMRMeshTaskGraph)
+  with the requested number of threads. When threads are used, each
+  processor meshes all of the edges within the graph so that a face
+  can start as soon as its boundary is complete. Since the cost split
+  requires the edge meshes, the edges are meshed beforehand with
+  TMR_COST_DISTRIBUTION on more than one processor. On a single
+  processor, the volumes are also meshed within the graph as soon as
+  their faces are complete.
+  With more than one processor, tetrahedral volumes are assigned to
+  processors in the same way as the face groups once the face meshes
+  are distributed, and are then broadcast from their owners.
+
+  The faces in different groups share only the edge meshes and the
+  feature size which are not modified during meshing, and the volumes
+  only read the face meshes. Note that the underlying geometry
+  evaluation must also be thread-safe.
+*/
+void TMRMesh::meshInParallel(TMRMeshOptions options,
+                             TMRElementFeatureSize *fs) {
+  int mpi_rank, mpi_size;
+  MPI_Comm_rank(comm, &mpi_rank);
+  MPI_Comm_size(comm, &mpi_size);
+
+  int num_edges;
+  TMREdge **edges;
+  geo->getEdges(&num_edges, &edges);
+
+  int num_faces;
+  TMRFace **faces;
+  geo->getFaces(&num_faces, &faces);
+
+  int num_volumes;
+  TMRVolume **volumes;
+  geo->getVolumes(&num_volumes, &volumes);
+
+  // Check whether the edges are meshed within the task graph
+  int edge_tasks = (options.num_threads > 1);
+  if (options.face_mesh_distribution == TMR_COST_DISTRIBUTION &&
+      mpi_size > 1) {
+    edge_tasks = 0;
+  }
+
+  // Flag the edges without an existing mesh and group them by their
+  // source and copy dependencies
+  int *edge_needs_mesh = new int[num_edges];
+  int *edge_group = new int[num_edges];
+  for (int i = 0; i < num_edges; i++) {
+    TMREdgeMesh *mesh = NULL;
+    edges[i]->getMesh(&mesh);
+    if (!mesh && !edge_tasks) {
+      mesh = new TMREdgeMesh(comm, edges[i]);
+      mesh->mesh(options, fs);
+      edges[i]->setMesh(mesh);
+    }
+    edge_needs_mesh[i] = (mesh == NULL);
+    edge_group[i] = i;
+  }
+  for (int i = 0; i < num_edges; i++) {
+    TMREdge *source, *copy;
+    edges[i]->getSource(&source);
+    edges[i]->getCopySource(&copy);
+    TMREdge *dep = (source ? source : copy);
+    if (dep && dep != edges[i]) {
+      int j = geo->getEdgeIndex(dep);
+      if (j >= 0) {
+        merge_mesh_groups(edge_group, i, j);
+      }
+    }
+  }
+
+  // Flag the faces without an existing mesh. This is the same on
+  // all processors.
+  int *needs_mesh = new int[num_faces];
+  int *group = new int[num_faces];
+  for (int i = 0; i < num_faces; i++) {
+    TMRFaceMesh *mesh = NULL;
+    faces[i]->getMesh(&mesh);
+    needs_mesh[i] = (mesh == NULL);
+    group[i] = i;
+  }
+
+  // Group the faces by their source and copy dependencies
+  for (int i = 0; i < num_faces; i++) {
+    TMRFace *source, *copy;
+    faces[i]->getSource(NULL, &source);
+    faces[i]->getCopySource(NULL, &copy);
+    TMRFace *dep = (source ? source : copy);
+    if (dep) {
+      int j = geo->getFaceIndex(dep);
+      if (j >= 0) {
+        merge_mesh_groups(group, i, j);
+      }
+    }
+  }
+
+  // Estimate the cost of each group from the boundary points
+  double *cost = new double[num_faces];
+  memset(cost, 0, num_faces * sizeof(double));
+  for (int i = 0; i < num_faces; i++) {
+    if (needs_mesh[i]) {
+      cost[find_mesh_group(group, i)] += estimate_face_mesh_cost(faces[i]);
+    }
+  }
+
+  // Collect the groups that contain at least one face to mesh
+  int num_groups = 0;
+  int *groups = new int[num_faces];
+  for (int i = 0; i < num_faces; i++) {
+    if (find_mesh_group(group, i) == i && cost[i] > 0.0) {
+      groups[num_groups] = i;
+      num_groups++;
+    }
+  }
+
+  // Assign an owner to each group
+  int *owner = new int[num_faces];
+  for (int i = 0; i < num_faces; i++) {
+    owner[i] = 0;
+  }
+  if (options.face_mesh_distribution == TMR_COST_DISTRIBUTION) {
+    // Sort the groups by decreasing cost and assign each group to
+    // the processor with the lowest load
+    TMRFaceCost *costs = new TMRFaceCost[num_groups];
+    for (int k = 0; k < num_groups; k++) {
+      costs[k].group = groups[k];
+      costs[k].cost = cost[groups[k]];
+    }
+    qsort(costs, num_groups, sizeof(TMRFaceCost), compare_face_costs);
+
+    double *load = new double[mpi_size];
+    memset(load, 0, mpi_size * sizeof(double));
+    for (int k = 0; k < num_groups; k++) {
+      int rank = 0;
+      for (int p = 1; p < mpi_size; p++) {
+        if (load[p] < load[rank]) {
+          rank = p;
+        }
+      }
+      owner[costs[k].group] = rank;
+      load[rank] += costs[k].cost;
+    }
+    delete[] load;
+    delete[] costs;
+  } else if (options.face_mesh_distribution == TMR_STATIC_DISTRIBUTION) {
+    // Assign the groups in contiguous blocks
+    for (int k = 0; k < num_groups; k++) {
+      owner[groups[k]] = (int)((1.0 * k * mpi_size) / num_groups);
+    }
+  }
+
+  // Find the edges and faces within each group
+  int *edge_group_ptr, *edge_group_list;
+  compute_mesh_groups(num_edges, edge_group, edge_needs_mesh, &edge_group_ptr,
+                      &edge_group_list);
+  int *group_ptr, *group_list;
+  compute_mesh_groups(num_faces, group, needs_mesh, &group_ptr, &group_list);
+
+  // Create the task graph
+  TMRMeshTaskGraph *graph =
+      new TMRMeshTaskGraph(&options, fs, comm, edges, faces, volumes);
+
+  // Add the edge groups
+  int *edge_task = new int[num_edges];
+  for (int i = 0; i < num_edges; i++) {
+    edge_task[i] = -1;
+    int n = edge_group_ptr[i + 1] - edge_group_ptr[i];
+    if (n > 0) {
+      edge_task[i] = graph->addTask(TMRMeshTaskGraph::EDGE_TASK, n,
+                                    &edge_group_list[edge_group_ptr[i]]);
+    }
+  }
+
+  // Add the face groups owned by this processor. Each face waits for
+  // the edges on its boundary.
+  int *face_task = new int[num_faces];
+  for (int k = 0; k < num_faces; k++) {
+    face_task[k] = -1;
+  }
+  for (int k = 0; k < num_groups; k++) {
+    int g = groups[k];
+    if (owner[g] != mpi_rank) {
+      continue;
+    }
+
+    int n = group_ptr[g + 1] - group_ptr[g];
+    int task = graph->addTask(TMRMeshTaskGraph::FACE_TASK, n,
+                              &group_list[group_ptr[g]]);
+    face_task[g] = task;
+
+    for (int j = group_ptr[g]; j < group_ptr[g + 1]; j++) {
+      TMRFace *face = faces[group_list[j]];
+      int nloops = face->getNumEdgeLoops();
+      for (int l = 0; l < nloops; l++) {
+        TMREdgeLoop *loop;
+        face->getEdgeLoop(l, &loop);
+        int nedges;
+        TMREdge **loop_edges;
+        loop->getEdgeLoop(&nedges, &loop_edges, NULL);
+        for (int m = 0; m < nedges; m++) {
+          int e = geo->getEdgeIndex(loop_edges[m]);
+          if (e >= 0) {
+            int prereq = edge_task[find_mesh_group(edge_group, e)];
+            if (prereq >= 0) {
+              graph->addDependency(task, prereq);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  // Add the volumes when all of the faces are meshed on this
+  // processor. Each volume waits for its faces.
+  if (mpi_size == 1) {
+    for (int i = 0; i < num_volumes; i++) {
+      TMRVolumeMesh *mesh = NULL;
+      volumes[i]->getMesh(&mesh);
+      if (mesh) {
+        continue;
+      }
+
+      int task = graph->addTask(TMRMeshTaskGraph::VOLUME_TASK, 1, &i);
+
+      int nvol_faces;
+      TMRFace **vol_faces;
+      volumes[i]->getFaces(&nvol_faces, &vol_faces);
+      for (int j = 0; j < nvol_faces; j++) {
+        int f = geo->getFaceIndex(vol_faces[j]);
+        if (f >= 0) {
+          int prereq = face_task[find_mesh_group(group, f)];
+          if (prereq >= 0) {
+            graph->addDependency(task, prereq);
+          }
+        }
+      }
+    }
+  }
+
+  // Mesh everything on this processor
+  graph->run(options.num_threads);
+  delete graph;
+
+  // Distribute the face meshes from their owners
+  for (int i = 0; i < num_faces; i++) {
+    if (needs_mesh[i]) {
+      int root = owner[find_mesh_group(group, i)];
+      TMRFaceMesh *mesh = NULL;
+      faces[i]->getMesh(&mesh);
+      if (mpi_rank != root) {
+        mesh = new TMRFaceMesh(comm, faces[i]);
+        faces[i]->setMesh(mesh);
+      }
+      mesh->broadcastMesh(comm, root);
+    }
+  }
+
+  // Distribute the tetrahedral volume meshes. The volumes only depend
+  // on the face meshes, so each volume is meshed on one processor and
+  // then broadcast from its owner.
+  if (mpi_size > 1 && options.mesh_type_default == TMR_TRIANGLE) {
+    // Estimate the cost of each volume from its boundary elements
+    int num_vol_groups = 0;
+    TMRFaceCost *vol_costs = new TMRFaceCost[num_volumes];
+    int *vol_owner = new int[num_volumes];
+    for (int i = 0; i < num_volumes; i++) {
+      vol_owner[i] = -1;
+      TMRVolumeMesh *mesh = NULL;
+      volumes[i]->getMesh(&mesh);
+      if (mesh) {
+        continue;
+      }
+
+      double vol_cost = 0.0;
+      int nvol_faces;
+      TMRFace **vol_faces;
+      volumes[i]->getFaces(&nvol_faces, &vol_faces);
+      for (int j = 0; j < nvol_faces; j++) {
+        TMRFaceMesh *face_mesh = NULL;
+        vol_faces[j]->getMesh(&face_mesh);
+        if (face_mesh) {
+          vol_cost += face_mesh->getTriConnectivity(NULL) +
+                      2 * face_mesh->getQuadConnectivity(NULL);
+        }
+      }
+
+      vol_owner[i] = 0;
+      vol_costs[num_vol_groups].group = i;
+      vol_costs[num_vol_groups].cost = vol_cost;
+      num_vol_groups++;
+    }
+
+    // Assign the owners in the same way as the face groups
+    if (options.face_mesh_distribution == TMR_COST_DISTRIBUTION) {
+      qsort(vol_costs, num_vol_groups, sizeof(TMRFaceCost),
+            compare_face_costs);
+
+      double *load = new double[mpi_size];
+      memset(load, 0, mpi_size * sizeof(double));
+      for (int k = 0; k < num_vol_groups; k++) {
+        int rank = 0;
+        for (int p = 1; p < mpi_size; p++) {
+          if (load[p] < load[rank]) {
+            rank = p;
+          }
+        }
+        vol_owner[vol_costs[k].group] = rank;
+        load[rank] += vol_costs[k].cost;
+      }
+      delete[] load;
+    } else if (options.face_mesh_distribution == TMR_STATIC_DISTRIBUTION) {
+      for (int k = 0; k < num_vol_groups; k++) {
+        vol_owner[vol_costs[k].group] =
+            (int)((1.0 * k * mpi_size) / num_vol_groups);
+      }
+    }
+
+    // Mesh the volumes owned by this processor
+    TMRVolumeMesh **vol_meshes = new TMRVolumeMesh *[num_volumes];
+    for (int i = 0; i < num_volumes; i++) {
+      vol_meshes[i] = NULL;
+      if (vol_owner[i] == mpi_rank) {
+        vol_meshes[i] = new TMRVolumeMesh(MPI_COMM_SELF, volumes[i]);
+        vol_meshes[i]->incref();
+        if (vol_meshes[i]->mesh(options)) {
+          vol_meshes[i]->decref();
+          vol_meshes[i] = NULL;
+        }
+      }
+    }
+
+    // Distribute the volume meshes from their owners. Failed volume
+    // meshes are meshed again by TMRMesh::mesh which reports the
+    // failure.
+    for (int i = 0; i < num_volumes; i++) {
+      int root = vol_owner[i];
+      if (root < 0) {
+        continue;
+      }
+
+      int success = (vol_meshes[i] != NULL);
+      MPI_Bcast(&success, 1, MPI_INT, root, comm);
+      if (success) {
+        if (mpi_rank != root) {
+          vol_meshes[i] = new TMRVolumeMesh(comm, volumes[i]);
+          vol_meshes[i]->incref();
+        }
+        vol_meshes[i]->broadcastMesh(comm, root);
+        volumes[i]->setMesh(vol_meshes[i]);
+      }
+    }
+
+    delete[] vol_costs;
+    delete[] vol_owner;
+    delete[] vol_meshes;
+  }
+
+  delete[] edge_needs_mesh;
+  delete[] edge_group;
+  delete[] edge_group_ptr;
+  delete[] edge_group_list;
+  delete[] edge_task;
+  delete[] needs_mesh;
+  delete[] group;
+  delete[] cost;
+  delete[] groups;
+  delete[] owner;
+  delete[] group_ptr;
+  delete[] group_list;
+  delete[] face_task;
+}
+
 /*
   Mesh the underlying geometry
 */
 void TMRMesh::mesh(TMRMeshOptions options, TMRElementFeatureSize *fs) {
+  TMR_PROFILE_BEGIN(TMR_PROFILE_MESH);
+
   // Reset the meshes within the mesh
   if (options.reset_mesh_objects) {
     resetMesh();
   }
 
+  // Mesh the edges, faces and volumes in parallel. Any remaining
+  // entities are meshed below.
+  int mpi_size;
+  MPI_Comm_size(comm, &mpi_size);
+  if ((options.face_mesh_distribution != TMR_NO_DISTRIBUTION &&
+       mpi_size > 1) ||
+      options.num_threads > 1) {
+    meshInParallel(options, fs);
+  }
+
   // Mesh the curves
   int num_edges;
   TMREdge **edges;
@@ -1074,6 +2236,162 @@ void TMRMesh::mesh(TMRMeshOptions options, TMRElementFeatureSize *fs) {
       printf("          %10d\n", total);
     }
   }
+
+  // Reorder the nodes to reduce the bandwidth of the mesh
+  num_threads = options.num_threads;
+  node_ordering = options.node_ordering;
+  if (node_ordering == TMR_RCM_ORDER) {
+    reorderNodes();
+  }
+
+  TMR_PROFILE_END(TMR_PROFILE_MESH);
+}
+
+/*
+  Reorder the nodes in the mesh using a reverse Cuthill-McKee ordering
+
+  The ordering is computed from the global connectivity of all the
+  elements. The new node numbers are then set in the vertices and the
+  edge, face and volume meshes so that every output of the mesh uses
+  the same ordering.
+*/
+void TMRMesh::reorderNodes() {
+  // Create the global connectivity with the current ordering
+  freeMeshArrays();
+  initMesh();
+
+  // Combine the connectivity from all of the elements
+  int nelems = num_quads + num_tris + num_hex + num_tet;
+  int *elem_ptr = new int[nelems + 1];
+  int *elem_conn =
+      new int[4 * num_quads + 3 * num_tris + 8 * num_hex + 4 * num_tet];
+  elem_ptr[0] = 0;
+  int e = 0;
+  for (int i = 0; i < num_quads; i++, e++) {
+    elem_ptr[e + 1] = elem_ptr[e] + 4;
+    memcpy(&elem_conn[elem_ptr[e]], &quads[4 * i], 4 * sizeof(int));
+  }
+  for (int i = 0; i < num_tris; i++, e++) {
+    elem_ptr[e + 1] = elem_ptr[e] + 3;
+    memcpy(&elem_conn[elem_ptr[e]], &tris[3 * i], 3 * sizeof(int));
+  }
+  for (int i = 0; i < num_hex; i++, e++) {
+    elem_ptr[e + 1] = elem_ptr[e] + 8;
+    memcpy(&elem_conn[elem_ptr[e]], &hex[8 * i], 8 * sizeof(int));
+  }
+  for (int i = 0; i < num_tet; i++, e++) {
+    elem_ptr[e + 1] = elem_ptr[e] + 4;
+    memcpy(&elem_conn[elem_ptr[e]], &tet[4 * i], 4 * sizeof(int));
+  }
+
+  int *new_nums = new int[num_nodes];
+  TMR_ComputeRCMOrder(num_nodes, nelems, elem_ptr, elem_conn, new_nums);
+  delete[] elem_ptr;
+  delete[] elem_conn;
+
+  // Set the new vertex numbers. The old numbers are all retrieved
+  // first since copied vertices share their numbers.
+  int num_vertices;
+  TMRVertex **vertices;
+  geo->getVertices(&num_vertices, &vertices);
+  int *vertex_nums = new int[num_vertices];
+  for (int i = 0; i < num_vertices; i++) {
+    vertex_nums[i] = -1;
+    vertices[i]->getNodeNum(&vertex_nums[i]);
+    vertices[i]->resetNodeNum();
+  }
+  for (int i = 0; i < num_vertices; i++) {
+    if (vertex_nums[i] >= 0) {
+      int num = new_nums[vertex_nums[i]];
+      vertices[i]->setNodeNum(&num);
+    }
+  }
+  delete[] vertex_nums;
+
+  // Set the new numbers for the edges, faces and volumes
+  int num_edges;
+  TMREdge **edges;
+  geo->getEdges(&num_edges, &edges);
+  for (int i = 0; i < num_edges; i++) {
+    TMREdgeMesh *mesh = NULL;
+    edges[i]->getMesh(&mesh);
+    if (mesh) {
+      mesh->renumberNodes(new_nums);
+    }
+  }
+
+  int num_faces;
+  TMRFace **faces;
+  geo->getFaces(&num_faces, &faces);
+  for (int i = 0; i < num_faces; i++) {
+    TMRFaceMesh *mesh = NULL;
+    faces[i]->getMesh(&mesh);
+    if (mesh) {
+      mesh->renumberNodes(new_nums);
+    }
+  }
+
+  int num_volumes;
+  TMRVolume **volumes;
+  geo->getVolumes(&num_volumes, &volumes);
+  for (int i = 0; i < num_volumes; i++) {
+    TMRVolumeMesh *mesh = NULL;
+    volumes[i]->getMesh(&mesh);
+    if (mesh) {
+      mesh->renumberNodes(new_nums);
+    }
+  }
+  delete[] new_nums;
+
+  // The global arrays are created again with the new ordering
+  freeMeshArrays();
+}
+
+/*
+  The smallest node number in an element, used to order the elements
+*/
+struct TMRElementKey {
+  int node;
+  int index;
+};
+
+/*
+  Compare the smallest node numbers of two elements. Ties are broken
+  by the original element index.
+*/
+static int compare_element_keys(const void *avoid, const void *bvoid) {
+  const TMRElementKey *a = static_cast<const TMRElementKey *>(avoid);
+  const TMRElementKey *b = static_cast<const TMRElementKey *>(bvoid);
+  if (a->node != b->node) {
+    return a->node - b->node;
+  }
+  return a->index - b->index;
+}
+
+/*
+  Sort the elements in place by their smallest node number
+*/
+static void sort_elements_by_node(int nelems, int size, int *conn) {
+  TMRElementKey *keys = new TMRElementKey[nelems];
+  for (int i = 0; i < nelems; i++) {
+    keys[i].node = conn[size * i];
+    keys[i].index = i;
+    for (int j = 1; j < size; j++) {
+      if (conn[size * i + j] < keys[i].node) {
+        keys[i].node = conn[size * i + j];
+      }
+    }
+  }
+  qsort(keys, nelems, sizeof(TMRElementKey), compare_element_keys);
+
+  int *temp = new int[size * nelems];
+  for (int i = 0; i < nelems; i++) {
+    memcpy(&temp[size * i], &conn[size * keys[i].index], size * sizeof(int));
+  }
+  memcpy(conn, temp, size * nelems * sizeof(int));
+
+  delete[] keys;
+  delete[] temp;
 }
 
 /*
@@ -1117,35 +2435,76 @@ void TMRMesh::initMesh(int count_nodes) {
       const int *vars;
       mesh->getNodeNums(&vars);
 
-      // Set the quadrilateral connectivity
-      for (int j = 0; j < 8 * nlocal; j++, h++) {
-        h[0] = vars[hex_local[j]];
+      // Set the quadrilateral connectivity
+      for (int j = 0; j < 8 * nlocal; j++, h++) {
+        h[0] = vars[hex_local[j]];
+      }
+
+      // Set the node locations
+      for (int j = 0; j < npts; j++) {
+        X[vars[j]] = Xpts[j];
+      }
+
+      if (count_nodes) {
+        for (int j = 0; j < npts; j++) {
+          count[vars[j]]++;
+        }
+      }
+    }
+
+    if (count_nodes) {
+      // Set the count to the number of variables
+      for (int j = 0; j < num_nodes; j++) {
+        if (count[j] == 0) {
+          printf("TMRMesh Error: Node %d not referenced\n", j);
+        }
+        if (count[j] >= 2) {
+          printf("TMRMesh Error: Node %d referenced more than once %d\n", j,
+                 count[j]);
+        }
+      }
+      delete[] count;
+    }
+  }
+  if (num_tet > 0) {
+    tet = new int[4 * num_tet];
+
+    // Retrieve the volume information
+    int num_volumes;
+    TMRVolume **volumes;
+    geo->getVolumes(&num_volumes, &volumes);
+
+    // Set the values into the global arrays
+    int *t = tet;
+    for (int i = 0; i < num_volumes; i++) {
+      TMRVolumeMesh *mesh = NULL;
+      volumes[i]->getMesh(&mesh);
+
+      // Get the local tetrahedral connectivity
+      const int *tet_local;
+      int nlocal = mesh->getTetConnectivity(&tet_local);
+      if (nlocal == 0) {
+        continue;
+      }
+
+      // Get the local mesh points
+      int npts;
+      TMRPoint *Xpts;
+      mesh->getMeshPoints(&npts, &Xpts);
+
+      // Get the local to global variable numbering
+      const int *vars;
+      mesh->getNodeNums(&vars);
+
+      // Set the tetrahedral connectivity
+      for (int j = 0; j < 4 * nlocal; j++, t++) {
+        t[0] = vars[tet_local[j]];
       }
 
       // Set the node locations
       for (int j = 0; j < npts; j++) {
         X[vars[j]] = Xpts[j];
       }
-
-      if (count_nodes) {
-        for (int j = 0; j < npts; j++) {
-          count[vars[j]]++;
-        }
-      }
-    }
-
-    if (count_nodes) {
-      // Set the count to the number of variables
-      for (int j = 0; j < num_nodes; j++) {
-        if (count[j] == 0) {
-          printf("TMRMesh Error: Node %d not referenced\n", j);
-        }
-        if (count[j] >= 2) {
-          printf("TMRMesh Error: Node %d referenced more than once %d\n", j,
-                 count[j]);
-        }
-      }
-      delete[] count;
     }
   }
   if (num_quads > 0 || num_tris > 0) {
@@ -1226,6 +2585,14 @@ void TMRMesh::initMesh(int count_nodes) {
       }
     }
   }
+
+  // Order the elements to follow the reordered nodes
+  if (node_ordering == TMR_RCM_ORDER) {
+    sort_elements_by_node(num_quads, 4, quads);
+    sort_elements_by_node(num_tris, 3, tris);
+    sort_elements_by_node(num_hex, 8, hex);
+    sort_elements_by_node(num_tet, 4, tet);
+  }
 }
 
 /*
@@ -1287,6 +2654,190 @@ void TMRMesh::getHexConnectivity(int *_nhex, const int **_hex) {
   }
 }
 
+/*
+  Get the tetrahedral connectivity
+*/
+void TMRMesh::getTetConnectivity(int *_ntet, const int **_tet) {
+  if (!X) {
+    initMesh();
+  }
+  if (_ntet) {
+    *_ntet = num_tet;
+  }
+  if (_tet) {
+    *_tet = tet;
+  }
+}
+
+/*
+  Compute histograms of the quality of the quadrilateral or hexahedral
+  elements in the mesh
+
+  The mesh is stored on all processors, so each processor evaluates
+  the metrics for a contiguous range of the elements (split between
+  its threads) and the histograms are summed across the processors.
+  This call is collective.
+
+  input:
+  elem_type:    the element type (TMR_QUAD or TMR_HEX)
+  nbins:        the number of bins in each histogram
+
+  output:
+  hist:         the histograms of the metrics (TMR_NUM_QUALITY_METRICS*nbins)
+  min_quality:  the minimum value of each metric (may be NULL)
+
+  returns:      the number of elements of the given type
+*/
+int TMRMesh::computeMeshQuality(int elem_type, int nbins, int hist[],
+                                double min_quality[]) {
+  int mpi_rank, mpi_size;
+  MPI_Comm_rank(comm, &mpi_rank);
+  MPI_Comm_size(comm, &mpi_size);
+
+  if (!X) {
+    initMesh();
+  }
+
+  // The corners are stored in the VTK order
+  const int corner_offset[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+  int num_corners = 4, num_elements = num_quads;
+  const int *elem_conn = quads;
+  if (elem_type == TMR_HEX) {
+    num_corners = 8;
+    num_elements = num_hex;
+    elem_conn = hex;
+  }
+
+  // Set the range of elements evaluated on this processor
+  int start = (int)(((long int)mpi_rank * num_elements) / mpi_size);
+  int end = (int)(((long int)(mpi_rank + 1) * num_elements) / mpi_size);
+  if (elem_conn) {
+    elem_conn = &elem_conn[num_corners * start];
+  }
+
+  return TMR_ComputeMeshQuality(comm, num_threads, end - start, num_corners,
+                                elem_conn, num_corners, corner_offset, 0,
+                                NULL, X, nbins, hist, min_quality);
+}
+
+/*
+  Get the memory (in bytes) used by the global mesh arrays
+
+  The memory used by the meshes stored with the edges, faces and
+  volumes of the geometry is not included.
+*/
+void TMRMesh::getMemoryUsage(TMRMemoryUsage *usage) {
+  usage->zero();
+  if (X) {
+    usage->points = num_nodes * sizeof(TMRPoint);
+  }
+  if (quads) {
+    usage->conn += 4 * num_quads * sizeof(int);
+  }
+  if (tris) {
+    usage->conn += 3 * num_tris * sizeof(int);
+  }
+  if (hex) {
+    usage->conn += 8 * num_hex * sizeof(int);
+  }
+  if (tet) {
+    usage->conn += 4 * num_tet * sizeof(int);
+  }
+}
+
+/*
+  Get the hexahedral mesh as the connectivity for an octree forest
+
+  The block, edge and face connectivity is in the format required by
+  TMROctForest::setFullConnectivity() and can be used together with
+  the mesh points to create a forest without creating a TMRModel from
+  the mesh. This is equivalent to using the model created by
+  createModelFromMesh() when the geometry within the volume only
+  requires trilinear interpolation.
+
+  The arrays are allocated here and must be freed by the caller. The
+  return value is the number of nodes.
+*/
+int TMRMesh::getOctForestConnectivity(int *_num_edges, int *_num_faces,
+                                      int *_num_blocks, int **_block_conn,
+                                      int **_block_edge_conn,
+                                      int **_block_face_conn) {
+  if (!X) {
+    initMesh();
+  }
+
+  // The local edge and face ordering of the hexahedral elements
+  // matches the ordering of the blocks in the forest, so only the
+  // block nodes must be reordered
+  int *block_edge_conn, *block_face_conn;
+  TMR_ComputeHexEdgesAndFaces(num_nodes, num_hex, hex, _num_edges, NULL,
+                              &block_edge_conn, _num_faces, NULL,
+                              &block_face_conn, NULL, NULL, num_threads);
+
+  int *block_conn = new int[8 * num_hex];
+  for (int i = 0; i < num_hex; i++) {
+    for (int j = 0; j < 8; j++) {
+      block_conn[8 * i + j] = hex[8 * i + hex_coordinate_order[j]];
+    }
+  }
+
+  *_num_blocks = num_hex;
+  *_block_conn = block_conn;
+  *_block_edge_conn = block_edge_conn;
+  *_block_face_conn = block_face_conn;
+
+  return num_nodes;
+}
+
+/*
+  Get the quadrilateral mesh as the connectivity for a quadtree forest
+
+  The face and edge connectivity is in the format required by
+  TMRQuadForest::setFullConnectivity(). The arrays are allocated here
+  and must be freed by the caller. The return value is the number of
+  nodes.
+*/
+int TMRMesh::getQuadForestConnectivity(int *_num_edges, int *_num_faces,
+                                       int **_face_conn,
+                                       int **_face_edge_conn) {
+  if (!X) {
+    initMesh();
+  }
+
+  // Number the quadrilateral edges
+  int *ptr, *node_to_quads;
+  TMR_ComputeNodeToElems(num_nodes, num_quads, 4, quads, &ptr,
+                         &node_to_quads);
+  int *quad_edge_nums = new int[4 * num_quads];
+  for (int i = 0; i < 4 * num_quads; i++) {
+    quad_edge_nums[i] = -1;
+  }
+  TMR_FindFirstEdges(0, num_nodes, ptr, node_to_quads, 4, 4, quad_edge_nodes,
+                     quads, quad_edge_nums);
+  *_num_edges = TMR_NumberFirstEntities(4 * num_quads, quad_edge_nums);
+  delete[] ptr;
+  delete[] node_to_quads;
+
+  // Reorder the nodes and edges to match the ordering in the forest
+  const int quad_coordinate_order[] = {0, 1, 3, 2};
+  const int quad_forest_edges[] = {3, 1, 0, 2};
+  int *face_conn = new int[4 * num_quads];
+  int *face_edge_conn = new int[4 * num_quads];
+  for (int i = 0; i < num_quads; i++) {
+    for (int j = 0; j < 4; j++) {
+      face_conn[4 * i + j] = quads[4 * i + quad_coordinate_order[j]];
+      face_edge_conn[4 * i + j] = quad_edge_nums[4 * i + quad_forest_edges[j]];
+    }
+  }
+  delete[] quad_edge_nums;
+
+  *_num_faces = num_quads;
+  *_face_conn = face_conn;
+  *_face_edge_conn = face_edge_conn;
+
+  return num_nodes;
+}
+
 /*
   Print out the mesh to a VTK file
 */
@@ -1355,225 +2906,585 @@ void TMRMesh::writeToVTK(const char *filename, int flag) {
   }
 }
 
+/*
+  Print out the mesh to a binary VTK XML file
+*/
+int TMRMesh::writeToVTU(const char *filename, int flag, int use_float32) {
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+  if (rank == 0 && num_nodes > 0) {
+    // Check whether to print out just quads or hex or both
+    int nquad = num_quads;
+    int nhex = num_hex;
+    int ntris = num_tris;
+    if (!(flag & TMR_QUAD)) {
+      nquad = 0;
+    }
+    if (!(flag & TMR_HEX)) {
+      nhex = 0;
+    }
+
+    if (!X) {
+      initMesh();
+    }
+
+    // Set the cell connectivity and types
+    int ncells = nquad + ntris + nhex;
+    int *ptr = new int[ncells + 1];
+    int *conn = new int[4 * nquad + 3 * ntris + 8 * nhex];
+    int *types = new int[ncells];
+    ptr[0] = 0;
+    int n = 0;
+    for (int k = 0; k < nquad; k++, n++) {
+      memcpy(&conn[ptr[n]], &quads[4 * k], 4 * sizeof(int));
+      ptr[n + 1] = ptr[n] + 4;
+      types[n] = TMR_VTK_QUAD;
+    }
+    for (int k = 0; k < ntris; k++, n++) {
+      memcpy(&conn[ptr[n]], &tris[3 * k], 3 * sizeof(int));
+      ptr[n + 1] = ptr[n] + 3;
+      types[n] = TMR_VTK_TRIANGLE;
+    }
+    for (int k = 0; k < nhex; k++, n++) {
+      memcpy(&conn[ptr[n]], &hex[8 * k], 8 * sizeof(int));
+      ptr[n + 1] = ptr[n] + 8;
+      types[n] = TMR_VTK_HEXAHEDRON;
+    }
+
+    int fail = TMR_WriteVTUFile(MPI_COMM_SELF, filename, num_nodes, X, ncells,
+                                ptr, conn, types, 0, NULL, NULL, use_float32);
+
+    delete[] ptr;
+    delete[] conn;
+    delete[] types;
+
+    return fail;
+  }
+
+  return 0;
+}
+
+/*
+  Character buffer used to format the bulk data file on each processor
+  without going through the formatted output routines. The fields are
+  written directly into the buffer with fixed widths.
+*/
+class TMRBDFBuffer {
+ public:
+  TMRBDFBuffer() {
+    max_len = 1 << 16;
+    len = 0;
+    data = new char[max_len];
+  }
+  ~TMRBDFBuffer() { delete[] data; }
+
+  // Make sure that there is space for n additional characters
+  void reserve(size_t n) {
+    if (len + n > max_len) {
+      while (len + n > max_len) {
+        max_len *= 2;
+      }
+      char *temp = new char[max_len];
+      memcpy(temp, data, len);
+      delete[] data;
+      data = temp;
+    }
+  }
+
+  // Append a string left-justified in the given field width
+  void addString(const char *str, int width = 0) {
+    size_t n = strlen(str);
+    size_t w = (n > (size_t)width ? n : width);
+    reserve(w);
+    memcpy(&data[len], str, n);
+    memset(&data[len + n], ' ', w - n);
+    len += w;
+  }
+
+  // Append a single character
+  void addChar(char c) {
+    reserve(1);
+    data[len] = c;
+    len++;
+  }
+
+  // Append an integer right-justified in the given field width
+  void addInt(int value, int width) {
+    char digits[16];
+    int n = 0;
+    unsigned int u = (value < 0 ? -(unsigned int)value : value);
+    do {
+      digits[n] = '0' + u % 10;
+      u /= 10;
+      n++;
+    } while (u > 0);
+    if (value < 0) {
+      digits[n] = '-';
+      n++;
+    }
+    int pad = (width > n ? width - n : 0);
+    reserve(pad + n);
+    memset(&data[len], ' ', pad);
+    len += pad;
+    for (int i = n - 1; i >= 0; i--, len++) {
+      data[len] = digits[i];
+    }
+  }
+
+  // Append a fixed-point real value right-justified in the field.
+  // Values that do not fit in the field use exponential notation. The
+  // decimal point is always written, since the bulk data format reads
+  // a field without one as an integer.
+  void addReal(double value, int width, int decimals) {
+    double scale = 1.0;
+    for (int i = 0; i < decimals; i++) {
+      scale *= 10.0;
+    }
+    double a = fabs(value) * scale + 0.5;
+    if (decimals > 0 && a < 1e15) {
+      long long r = (long long)a;
+      long long ipart = r;
+      char digits[32];
+      int n = 0;
+      for (int i = 0; i < decimals; i++, n++) {
+        digits[n] = '0' + ipart % 10;
+        ipart /= 10;
+      }
+      digits[n] = '.';
+      n++;
+      do {
+        digits[n] = '0' + ipart % 10;
+        ipart /= 10;
+        n++;
+      } while (ipart > 0);
+      if (value < 0.0 && r > 0) {
+        digits[n] = '-';
+        n++;
+      }
+      if (n <= width) {
+        reserve(width);
+        memset(&data[len], ' ', width - n);
+        len += width - n;
+        for (int i = n - 1; i >= 0; i--, len++) {
+          data[len] = digits[i];
+        }
+        return;
+      }
+    }
+
+    addExpReal(value, width);
+  }
+
+  // Append a real value right-justified in the field in the
+  // exponential form of the bulk data format without the 'E' (for
+  // instance 1.2346+5), using as many digits as will fit
+  void addExpReal(double value, int width) {
+    char str[48];
+    int n = 0;
+    for (int prec = width; prec >= 0; prec--) {
+      char mant[40];
+      snprintf(mant, sizeof(mant), "%#.*e", prec, value);
+      char *e = strchr(mant, 'e');
+      int exponent = (int)strtol(&e[1], NULL, 10);
+      e[0] = '\0';
+      n = snprintf(str, sizeof(str), "%s%c%d", mant, (exponent < 0 ? '-' : '+'),
+                   (exponent < 0 ? -exponent : exponent));
+      if (n <= width) {
+        break;
+      }
+    }
+    int pad = (width > n ? width - n : 0);
+    reserve(pad + n);
+    memset(&data[len], ' ', pad);
+    len += pad;
+    memcpy(&data[len], str, n);
+    len += n;
+  }
+
+  // Append a real value in an 8 character small-field entry, using
+  // as many decimal places as will fit
+  void addSmallReal(double value) {
+    int ndigits = 1;
+    for (double a = fabs(value); a >= 10.0 && ndigits < 8; a *= 0.1) {
+      ndigits++;
+    }
+    addReal(value, 8, 8 - 2 - ndigits);
+  }
+
+  // Append formatted output for the infrequent, non-bulk entries
+  void addFormat(const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    char str[256];
+    vsnprintf(str, sizeof(str), fmt, args);
+    va_end(args);
+    addString(str);
+  }
+
+  size_t len, max_len;
+  char *data;
+};
+
+/*
+  A contiguous set of records in the bulk data file. Each record is
+  either a grid point, an element or a comment line preceding the
+  elements from a face or volume.
+*/
+class TMRBDFRecordBlock {
+ public:
+  enum BlockType { GRID, QUAD, HEX };
+  TMRBDFRecordBlock(BlockType _type, int _index, int _start, int _count,
+                    int _elem_offset) {
+    type = _type;
+    index = _index;
+    start = _start;
+    count = _count;
+    elem_offset = _elem_offset;
+  }
+  BlockType type;
+  int index;        // Face or volume index
+  int start;        // Index of the first record
+  int count;        // Number of records (including the comment)
+  int elem_offset;  // Element number offset
+};
+
 /*
   Write the bulk data file with material properties
+
+  The file is written collectively. Each processor formats a contiguous
+  slice of the grid points and element entries into a character buffer
+  and the slices are written to the file at offsets computed from the
+  lengths of the buffers on the preceding processors. The first
+  processor adds the file header and the last processor adds the
+  boundary conditions and the end of the bulk data section.
+
+  When large_field is set, the grid points are written using the
+  large-field format, otherwise the small-field format is used.
 */
 void TMRMesh::writeToBDF(const char *filename, int flag,
-                         TMRBoundaryConditions *bcs) {
+                         TMRBoundaryConditions *bcs, int large_field) {
   // Static string for the beginning of the file
   const char nastran_file_header[] =
       "$ Generated by TMR\n$ NASTRAN input deck\nSOL 101\nBEGIN BULK\n";
 
-  int rank;
-  MPI_Comm_rank(comm, &rank);
-  if (rank == 0 && num_nodes > 0) {
-    if (!X) {
-      initMesh();
+  int mpi_rank, mpi_size;
+  MPI_Comm_rank(comm, &mpi_rank);
+  MPI_Comm_size(comm, &mpi_size);
+
+  if (num_nodes <= 0) {
+    return;
+  }
+  if (!X) {
+    initMesh();
+  }
+
+  // Set up the blocks of records that will be written to the file
+  std::vector<TMRBDFRecordBlock> blocks;
+  int num_records = 0;
+  blocks.push_back(
+      TMRBDFRecordBlock(TMRBDFRecordBlock::GRID, 0, 0, num_nodes, 0));
+  num_records += num_nodes;
+
+  int num_faces;
+  TMRFace **faces;
+  geo->getFaces(&num_faces, &faces);
+  if (num_quads > 0 && (flag & TMR_QUAD)) {
+    for (int i = 0, j = 0; i < num_faces; i++) {
+      TMRFaceMesh *mesh = NULL;
+      faces[i]->getMesh(&mesh);
+      int nlocal = mesh->getQuadConnectivity(NULL);
+      blocks.push_back(TMRBDFRecordBlock(TMRBDFRecordBlock::QUAD, i,
+                                         num_records, nlocal + 1, j));
+      num_records += nlocal + 1;
+      j += nlocal;
     }
+  }
 
-    FILE *fp = fopen(filename, "w");
-    if (fp) {
-      fprintf(fp, nastran_file_header);
-      fprintf(fp, "$ Grid data\n");
+  int num_volumes;
+  TMRVolume **volumes;
+  geo->getVolumes(&num_volumes, &volumes);
+  if (num_hex > 0 && (flag & TMR_HEX)) {
+    for (int i = 0, j = 0; i < num_volumes; i++) {
+      TMRVolumeMesh *mesh = NULL;
+      volumes[i]->getMesh(&mesh);
+      int nlocal = mesh->getHexConnectivity(NULL);
+      blocks.push_back(TMRBDFRecordBlock(TMRBDFRecordBlock::HEX, i,
+                                         num_records, nlocal + 1, j));
+      num_records += nlocal + 1;
+      j += nlocal;
+    }
+  }
 
+  // Set the range of records owned by this processor
+  int rec_start = (int)(((long long)mpi_rank * num_records) / mpi_size);
+  int rec_end = (int)(((long long)(mpi_rank + 1) * num_records) / mpi_size);
+
+  TMRBDFBuffer buff;
+  if (mpi_rank == 0) {
+    buff.addString(nastran_file_header);
+    buff.addString("$ Grid data\n");
+  }
+
+  for (size_t ib = 0; ib < blocks.size(); ib++) {
+    const TMRBDFRecordBlock &block = blocks[ib];
+    int start = (block.start > rec_start ? block.start : rec_start);
+    int end = block.start + block.count;
+    if (end > rec_end) {
+      end = rec_end;
+    }
+    if (start >= end) {
+      continue;
+    }
+
+    if (block.type == TMRBDFRecordBlock::GRID) {
       // Write out the coordinates to the BDF file
       int coord_disp = 0, coord_id = 0, seid = 0;
-      for (int i = 0; i < num_nodes; i++) {
-        fprintf(fp, "%-8s%16d%16d%16.9f%16.9f*%7d\n", "GRID*", i + 1, coord_id,
-                X[i].x, X[i].y, i + 1);
-        fprintf(fp, "*%7d%16.9f%16d%16s%16d        \n", i + 1, X[i].z,
-                coord_disp, " ", seid);
-      }
-
-      if (num_quads > 0 && (flag & TMR_QUAD)) {
-        int num_faces;
-        TMRFace **faces;
-        geo->getFaces(&num_faces, &faces);
-
-        // Write out the element data for each component
-        for (int i = 0, j = 0; i < num_faces; i++) {
-          TMRFaceMesh *mesh = NULL;
-          faces[i]->getMesh(&mesh);
-
-          // Loop over all possible edges in the surface mesh
-          const int *quad_local;
-          int nlocal = mesh->getQuadConnectivity(&quad_local);
-
-          // Get the local to global variable numbering
-          const int *vars;
-          mesh->getNodeNums(&vars);
-
-          // Set the face id == name
-          char descript[128];
-          snprintf(descript, sizeof(descript), "FACE%d",
-                   faces[i]->getEntityId());
-          if (faces[i]->getName() != NULL) {
-            strncpy(descript, faces[i]->getName(), sizeof(descript));
-          }
+      buff.reserve((end - start) * 162);
+      for (int i = start; i < end; i++) {
+        if (large_field) {
+          buff.addString("GRID*", 8);
+          buff.addInt(i + 1, 16);
+          buff.addInt(coord_id, 16);
+          buff.addReal(X[i].x, 16, 9);
+          buff.addReal(X[i].y, 16, 9);
+          buff.addChar('*');
+          buff.addInt(i + 1, 7);
+          buff.addChar('\n');
+          buff.addChar('*');
+          buff.addInt(i + 1, 7);
+          buff.addReal(X[i].z, 16, 9);
+          buff.addInt(coord_disp, 16);
+          buff.addString(" ", 16);
+          buff.addInt(seid, 16);
+          buff.addString("        \n");
+        } else {
+          buff.addString("GRID", 8);
+          buff.addInt(i + 1, 8);
+          buff.addInt(coord_id, 8);
+          buff.addSmallReal(X[i].x);
+          buff.addSmallReal(X[i].y);
+          buff.addSmallReal(X[i].z);
+          buff.addChar('\n');
+        }
+      }
+    } else if (block.type == TMRBDFRecordBlock::QUAD) {
+      int i = block.index;
+      TMRFaceMesh *mesh = NULL;
+      faces[i]->getMesh(&mesh);
 
-          // Print a local description of the face - use the entity
-          // data if it exists, otherwise use the id value
-          fprintf(fp, "%-41s", "$       Shell element data");
-          fprintf(fp, "%s\n", descript);
+      const int *quad_local;
+      mesh->getQuadConnectivity(&quad_local);
 
-          if (faces[i]->getOrientation() > 0) {
-            for (int k = 0; k < nlocal; k++, j++) {
-              int part = i + 1;
-              fprintf(fp, "%-8s%8d%8d%8d%8d%8d%8d%8d\n", "CQUADR", j + 1, part,
-                      vars[quad_local[4 * k]] + 1,
-                      vars[quad_local[4 * k + 1]] + 1,
-                      vars[quad_local[4 * k + 2]] + 1,
-                      vars[quad_local[4 * k + 3]] + 1, part);
-            }
-          } else {
-            // Print out the nodes in the reversed orientation
-            for (int k = 0; k < nlocal; k++, j++) {
-              int part = i + 1;
-              fprintf(fp, "%-8s%8d%8d%8d%8d%8d%8d%8d\n", "CQUADR", j + 1, part,
-                      vars[quad_local[4 * k]] + 1,
-                      vars[quad_local[4 * k + 3]] + 1,
-                      vars[quad_local[4 * k + 2]] + 1,
-                      vars[quad_local[4 * k + 1]] + 1, part);
-            }
-          }
+      // Get the local to global variable numbering
+      const int *vars;
+      mesh->getNodeNums(&vars);
+
+      // Print a local description of the face - use the entity
+      // data if it exists, otherwise use the id value
+      if (start == block.start) {
+        char descript[128];
+        snprintf(descript, sizeof(descript), "FACE%d",
+                 faces[i]->getEntityId());
+        if (faces[i]->getName() != NULL) {
+          strncpy(descript, faces[i]->getName(), sizeof(descript));
+          descript[sizeof(descript) - 1] = '\0';
         }
+        buff.addString("$       Shell element data", 41);
+        buff.addString(descript);
+        buff.addChar('\n');
+        start++;
       }
-      if (num_hex > 0 && (flag & TMR_HEX)) {
-        int num_volumes;
-        TMRVolume **volumes;
-        geo->getVolumes(&num_volumes, &volumes);
-
-        // Write out the element data for each component
-        for (int i = 0, j = 0; i < num_volumes; i++) {
-          TMRVolumeMesh *mesh = NULL;
-          volumes[i]->getMesh(&mesh);
-
-          // Loop over all possible edges in the surface mesh
-          const int *hex_local;
-          int nlocal = mesh->getHexConnectivity(&hex_local);
-
-          // Get the local to global variable numbering
-          const int *vars;
-          mesh->getNodeNums(&vars);
-
-          // Set the face id == name
-          char descript[128];
-          snprintf(descript, sizeof(descript), "VOLUME%d",
-                   volumes[i]->getEntityId());
-          if (volumes[i]->getName() != NULL) {
-            strncpy(descript, volumes[i]->getName(), sizeof(descript));
-          }
 
-          // Print a local description of the face - use the entity
-          // data if it exists, otherwise use the id value
-          int part = i + 1;
-          fprintf(fp, "%-41s", "$       Volume element data");
-          fprintf(fp, "%s\n", descript);
-          // fprintf(fp, "%-8s%8d%8d%8d\n", "PSOLID", part, part, 0);
-
-          for (int k = 0; k < nlocal; k++, j++) {
-            fprintf(
-                fp, "%-8s%8d%8d%8d%8d%8d%8d%8d%8d\n", "CHEXA", j + 1, part,
-                vars[hex_local[8 * k]] + 1, vars[hex_local[8 * k + 1]] + 1,
-                vars[hex_local[8 * k + 2]] + 1, vars[hex_local[8 * k + 3]] + 1,
-                vars[hex_local[8 * k + 4]] + 1, vars[hex_local[8 * k + 5]] + 1);
-            fprintf(fp, "%-8s%8d%8d\n", " ", vars[hex_local[8 * k + 6]] + 1,
-                    vars[hex_local[8 * k + 7]] + 1);
-          }
+      // Print out the nodes in the reversed orientation if needed
+      const int order[4] = {0, 1, 2, 3};
+      const int reversed[4] = {0, 3, 2, 1};
+      const int *ord = (faces[i]->getOrientation() > 0 ? order : reversed);
+
+      int part = i + 1;
+      buff.reserve((end - start) * 65);
+      for (int r = start; r < end; r++) {
+        int k = r - block.start - 1;
+        buff.addString("CQUADR", 8);
+        buff.addInt(block.elem_offset + k + 1, 8);
+        buff.addInt(part, 8);
+        for (int m = 0; m < 4; m++) {
+          buff.addInt(vars[quad_local[4 * k + ord[m]]] + 1, 8);
         }
+        buff.addInt(part, 8);
+        buff.addChar('\n');
       }
+    } else if (block.type == TMRBDFRecordBlock::HEX) {
+      int i = block.index;
+      TMRVolumeMesh *mesh = NULL;
+      volumes[i]->getMesh(&mesh);
 
-      // Write out the boundary conditions if BC information
-      // is supplied to the function
-      if (bcs) {
-        int nentries = bcs->getNumBoundaryConditions();
-        for (int index = 0; index < nentries; index++) {
-          // Retrieve the boundary condition
-          const char *name;
-          int num_bcs;
-          const int *bc_nums;
-          const double *bc_vals;
-          bcs->getBoundaryCondition(index, &name, &num_bcs, &bc_nums, &bc_vals);
-
-          // Print out a description about the boundary condition name
-          fprintf(fp, "%-41s%s\n", "$       Boundary data", name);
-
-          // Set the SPC constrain string
-          char spc[16];
-          const char *spc_list = "123456789";
-          for (int i = 0, j = 0; i < num_bcs; i++) {
-            if (bc_nums[i] >= 0 && bc_nums[i] <= 8) {
-              spc[j] = spc_list[bc_nums[i]];
-              spc[j + 1] = '\0';
-              j++;
-            }
+      const int *hex_local;
+      mesh->getHexConnectivity(&hex_local);
+
+      // Get the local to global variable numbering
+      const int *vars;
+      mesh->getNodeNums(&vars);
+
+      // Print a local description of the volume - use the entity
+      // data if it exists, otherwise use the id value
+      if (start == block.start) {
+        char descript[128];
+        snprintf(descript, sizeof(descript), "VOLUME%d",
+                 volumes[i]->getEntityId());
+        if (volumes[i]->getName() != NULL) {
+          strncpy(descript, volumes[i]->getName(), sizeof(descript));
+          descript[sizeof(descript) - 1] = '\0';
+        }
+        buff.addString("$       Volume element data", 41);
+        buff.addString(descript);
+        buff.addChar('\n');
+        start++;
+      }
+
+      int part = i + 1;
+      buff.reserve((end - start) * 98);
+      for (int r = start; r < end; r++) {
+        int k = r - block.start - 1;
+        buff.addString("CHEXA", 8);
+        buff.addInt(block.elem_offset + k + 1, 8);
+        buff.addInt(part, 8);
+        for (int m = 0; m < 6; m++) {
+          buff.addInt(vars[hex_local[8 * k + m]] + 1, 8);
+        }
+        buff.addChar('\n');
+        buff.addString(" ", 8);
+        buff.addInt(vars[hex_local[8 * k + 6]] + 1, 8);
+        buff.addInt(vars[hex_local[8 * k + 7]] + 1, 8);
+        buff.addChar('\n');
+      }
+    }
+  }
+
+  // Write out the boundary conditions if BC information
+  // is supplied to the function
+  if (mpi_rank == mpi_size - 1) {
+    if (bcs) {
+      int num_edges;
+      TMREdge **edges;
+      geo->getEdges(&num_edges, &edges);
+
+      int num_vertices = 0;
+      TMRVertex **vertices;
+      geo->getVertices(&num_vertices, &vertices);
+
+      int nentries = bcs->getNumBoundaryConditions();
+      for (int index = 0; index < nentries; index++) {
+        // Retrieve the boundary condition
+        const char *name;
+        int num_bcs;
+        const int *bc_nums;
+        const double *bc_vals;
+        bcs->getBoundaryCondition(index, &name, &num_bcs, &bc_nums, &bc_vals);
+
+        // Print out a description about the boundary condition name
+        buff.addString("$       Boundary data", 41);
+        buff.addString(name);
+        buff.addChar('\n');
+
+        // Set the SPC constrain string
+        char spc[16];
+        spc[0] = '\0';
+        const char *spc_list = "123456789";
+        for (int i = 0, j = 0; i < num_bcs; i++) {
+          if (bc_nums[i] >= 0 && bc_nums[i] <= 8) {
+            spc[j] = spc_list[bc_nums[i]];
+            spc[j + 1] = '\0';
+            j++;
           }
+        }
 
-          // Find the faces, edges and nodes with this name
-          int num_faces;
-          TMRFace **faces;
-          geo->getFaces(&num_faces, &faces);
-          for (int i = 0; i < num_faces; i++) {
-            // Set the face id == name
-            const char *face_name = faces[i]->getName();
-            if (face_name && strcmp(name, face_name) == 0) {
-              // Get the face mesh
-              TMRFaceMesh *mesh = NULL;
-              faces[i]->getMesh(&mesh);
-
-              // Get the local to global variable numbering
-              const int *vars;
-              int nnodes = mesh->getNodeNums(&vars);
-
-              for (int k = 0; k < nnodes; k++) {
-                fprintf(fp, "%-8s%8d%8d%8s%8.2f\n", "SPC", 1, vars[k] + 1, spc,
-                        0.0);
-              }
+        // Find the faces, edges and nodes with this name
+        for (int i = 0; i < num_faces; i++) {
+          const char *face_name = faces[i]->getName();
+          if (face_name && strcmp(name, face_name) == 0) {
+            TMRFaceMesh *mesh = NULL;
+            faces[i]->getMesh(&mesh);
+
+            // Get the local to global variable numbering
+            const int *vars;
+            int nnodes = mesh->getNodeNums(&vars);
+            for (int k = 0; k < nnodes; k++) {
+              buff.addFormat("%-8s%8d%8d%8s%8.2f\n", "SPC", 1, vars[k] + 1,
+                             spc, 0.0);
             }
           }
+        }
 
-          int num_edges;
-          TMREdge **edges;
-          geo->getEdges(&num_edges, &edges);
-          for (int i = 0; i < num_edges; i++) {
-            // Set the face id == name
-            const char *edge_name = edges[i]->getName();
-            if (edge_name && strcmp(name, edge_name) == 0) {
-              // Get the edge mesh
-              TMREdgeMesh *mesh = NULL;
-              edges[i]->getMesh(&mesh);
-
-              // Get the local to global variable numbering
-              const int *vars;
-              int nnodes = mesh->getNodeNums(&vars);
-
-              for (int k = 0; k < nnodes; k++) {
-                fprintf(fp, "%-8s%8d%8d%8s%8f\n", "SPC", 1, vars[k] + 1, spc,
-                        0.0);
-              }
+        for (int i = 0; i < num_edges; i++) {
+          const char *edge_name = edges[i]->getName();
+          if (edge_name && strcmp(name, edge_name) == 0) {
+            TMREdgeMesh *mesh = NULL;
+            edges[i]->getMesh(&mesh);
+
+            // Get the local to global variable numbering
+            const int *vars;
+            int nnodes = mesh->getNodeNums(&vars);
+            for (int k = 0; k < nnodes; k++) {
+              buff.addFormat("%-8s%8d%8d%8s%8f\n", "SPC", 1, vars[k] + 1, spc,
+                             0.0);
             }
           }
+        }
 
-          int num_vertices = 0;
-          TMRVertex **vertices;
-          geo->getVertices(&num_vertices, &vertices);
-          for (int i = 0; i < num_vertices; i++) {
-            // Set the face id == name
-            const char *vert_name = vertices[i]->getName();
-            if (vert_name && strcmp(name, vert_name) == 0) {
-              int vnum;
-              vertices[i]->getNodeNum(&vnum);
-              fprintf(fp, "%-8s%8d%8d%8s%8f\n", "SPC", 1, vnum + 1, spc, 0.0);
-            }
+        for (int i = 0; i < num_vertices; i++) {
+          const char *vert_name = vertices[i]->getName();
+          if (vert_name && strcmp(name, vert_name) == 0) {
+            int vnum;
+            vertices[i]->getNodeNum(&vnum);
+            buff.addFormat("%-8s%8d%8d%8s%8f\n", "SPC", 1, vnum + 1, spc,
+                           0.0);
           }
         }
       }
+    }
 
-      // Signal end of bulk data section and close file handle
-      fprintf(fp, "ENDDATA\n");
-      fclose(fp);
+    // Signal end of bulk data section
+    buff.addString("ENDDATA\n");
+  }
+
+  // Compute the offset for this processor's slice of the file
+  long long local_len = buff.len, offset = 0, total_len = 0;
+  MPI_Exscan(&local_len, &offset, 1, MPI_LONG_LONG, MPI_SUM, comm);
+  if (mpi_rank == 0) {
+    offset = 0;
+  }
+  MPI_Allreduce(&local_len, &total_len, 1, MPI_LONG_LONG, MPI_SUM, comm);
+
+  char *fname = new char[strlen(filename) + 1];
+  strcpy(fname, filename);
+
+  MPI_File fp;
+  int fail = MPI_File_open(comm, fname, MPI_MODE_WRONLY | MPI_MODE_CREATE,
+                           MPI_INFO_NULL, &fp);
+  if (fail == MPI_SUCCESS) {
+    MPI_File_set_size(fp, total_len);
+
+    // Write the buffer in chunks so that the count fits in an int
+    const long long max_chunk = 1 << 30;
+    long long nchunks = (local_len + max_chunk - 1) / max_chunk;
+    long long max_nchunks = 0;
+    MPI_Allreduce(&nchunks, &max_nchunks, 1, MPI_LONG_LONG, MPI_MAX, comm);
+    for (long long k = 0; k < max_nchunks; k++) {
+      long long pos = k * max_chunk;
+      long long count = 0;
+      if (pos < local_len) {
+        count = local_len - pos;
+        if (count > max_chunk) {
+          count = max_chunk;
+        }
+      }
+      MPI_File_write_at_all(fp, offset + pos, &buff.data[count > 0 ? pos : 0],
+                            (int)count, MPI_CHAR, MPI_STATUS_IGNORE);
     }
+    MPI_File_close(&fp);
   }
+
+  delete[] fname;
 }
 
 /*
@@ -1679,7 +3590,8 @@ TMRModel *TMRMesh::createModelFromMesh() {
     // Compute the hexahedral edges and surfaces
     TMR_ComputeHexEdgesAndFaces(num_nodes, num_hex, hex, &num_hex_edges,
                                 &hex_edges, &hex_edge_nums, &num_hex_faces,
-                                &hex_faces, &hex_face_nums);
+                                &hex_faces, &hex_face_nums, NULL, NULL,
+                                num_threads);
   } else {
     // Compute the quadrilateral edges
     TMR_ComputeQuadEdges(num_nodes, num_quads, quads, &num_quad_edges,
@@ -1703,32 +3615,16 @@ TMRModel *TMRMesh::createModelFromMesh() {
     mesh_faces = hex_faces;
   }
 
-  // Create a searchable array that stores the edge number and the two
-  // connecting node numbers. The node numbers are sorted such that
-  // the lowest one comes first. This enables fast sorting/searching
-  int *sorted_edges = new int[3 * num_mesh_edges];
-
-  // Populate the sorted_edges array, sorting each edge as we go...
-  for (int i = 0; i < num_mesh_edges; i++) {
-    sorted_edges[3 * i] = i;
-
-    // Set the quad edge, setting the lower edge number first
-    if (mesh_edges[2 * i] < mesh_edges[2 * i + 1]) {
-      sorted_edges[3 * i + 1] = mesh_edges[2 * i];
-      sorted_edges[3 * i + 2] = mesh_edges[2 * i + 1];
-    } else {
-      sorted_edges[3 * i + 1] = mesh_edges[2 * i + 1];
-      sorted_edges[3 * i + 2] = mesh_edges[2 * i];
-    }
-  }
-
-  // Sort all of the edges/nodes so that they can be easily searched
-  qsort(sorted_edges, num_mesh_edges, 3 * sizeof(int), compare_edges);
+  // Create an index of the edges based on their lowest node number
+  // so that the edge number can be found from its two nodes
+  int *edge_ptr, *edge_index;
+  TMR_ComputeEdgeIndex(num_nodes, num_mesh_edges, mesh_edges, &edge_ptr,
+                       &edge_index);
 
   // Keep track of the orientation of the mesh edges.  edge_dir[i]
-  // > 0 means that the ordering of the vertices in the sorted_edges
-  // array is consistent with the orientation in the mesh. edge_dir[i]
-  // < 0 means the edge is flipped relative to the sorted_edges array.
+  // > 0 means that the ordering of the vertices in the edge index is
+  // consistent with the orientation in the mesh. edge_dir[i]
+  // < 0 means the edge is flipped relative to the edge index.
   int *edge_dir = new int[num_mesh_edges];
   memset(edge_dir, 0, num_mesh_edges * sizeof(int));
 
@@ -1768,11 +3664,10 @@ TMRModel *TMRMesh::createModelFromMesh() {
         }
 
         // Find the associated edge number
-        int *res = (int *)bsearch(edge, sorted_edges, num_mesh_edges,
-                                  3 * sizeof(int), compare_edges);
+        int edge_num =
+            TMR_FindEdgeIndex(edge_ptr, edge_index, edge[1], edge[2]);
 
-        if (res) {
-          int edge_num = res[0];
+        if (edge_num >= 0) {
           if (!new_edges[edge_num]) {
             // Check whether the node ordering is consistent with the
             // edge orientation. If not, tag this edge as reversed.
@@ -1840,12 +3735,10 @@ TMRModel *TMRMesh::createModelFromMesh() {
           }
 
           // Find the associated edge number
-          int *res = (int *)bsearch(edge, sorted_edges, num_mesh_edges,
-                                    3 * sizeof(int), compare_edges);
+          int edge_num =
+              TMR_FindEdgeIndex(edge_ptr, edge_index, edge[1], edge[2]);
 
-          if (res) {
-            // Get the edge number
-            int edge_num = res[0];
+          if (edge_num >= 0) {
             if (!new_edges[edge_num]) {
               // These edges are constructed such that they are
               // always in the forward orientation.
@@ -1902,24 +3795,12 @@ TMRModel *TMRMesh::createModelFromMesh() {
   TMRFace **new_faces = new TMRFace *[num_mesh_faces];
   memset(new_faces, 0, num_mesh_faces * sizeof(TMRFace *));
 
-  // Create the face array
-  int *sorted_faces = NULL;
-
+  // Create an index of the hexahedral faces based on their lowest node
+  // number so that the face number can be found from its nodes
+  int *face_ptr = NULL, *face_index = NULL;
   if (num_hex > 0) {
-    // Allocate an array to store the searchable array that
-    // stores the face nodes
-    sorted_faces = new int[5 * num_hex_faces];
-
-    for (int i = 0; i < num_hex_faces; i++) {
-      sorted_faces[5 * i] = i;
-      for (int k = 0; k < 4; k++) {
-        sorted_faces[5 * i + 1 + k] = hex_faces[4 * i + k];
-      }
-      sort_face_nodes(&sorted_faces[5 * i + 1]);
-    }
-
-    // Sort all of the faces so that they can be easily searched
-    qsort(sorted_faces, num_mesh_faces, 5 * sizeof(int), compare_faces);
+    TMR_ComputeFaceIndex(num_nodes, num_hex_faces, hex_faces, &face_ptr,
+                         &face_index);
   }
 
   // Allocate the faces
@@ -1988,12 +3869,10 @@ TMRModel *TMRMesh::createModelFromMesh() {
           }
 
           // Find the associated edge number
-          int *res = (int *)bsearch(edge, sorted_edges, num_mesh_edges,
-                                    3 * sizeof(int), compare_edges);
+          int edge_num =
+              TMR_FindEdgeIndex(edge_ptr, edge_index, edge[1], edge[2]);
 
-          if (res) {
-            // Get the global edge number
-            int edge_num = res[0];
+          if (edge_num >= 0) {
             c[k] = new_edges[edge_num];
 
             if (vars[l1] < vars[l2]) {
@@ -2011,24 +3890,20 @@ TMRModel *TMRMesh::createModelFromMesh() {
 
         // If this is a hexahedral mesh, then we need to be consistent
         // with how the faces are ordered. This code searches for the
-        // face number within the sorted_faces array to obtain the
-        // required face number
-        if (sorted_faces) {
+        // face number within the face index to obtain the required
+        // face number
+        if (face_index) {
           // Set the nodes associated with this face and sort them
-          int face[5];
-          face[0] = 0;
+          int face[4];
           for (int k = 0; k < 4; k++) {
-            face[k + 1] = vars[quad_local[4 * j + k]];
+            face[k] = vars[quad_local[4 * j + k]];
           }
-          sort_face_nodes(&face[1]);
-
-          // Search for the face
-          int *res = (int *)bsearch(face, sorted_faces, num_mesh_faces,
-                                    5 * sizeof(int), compare_faces);
+          sort_face_nodes(face);
 
-          // Set the face number
-          if (res) {
-            face_num = res[0];
+          // Search for the face and set the face number
+          int res = TMR_FindFaceIndex(face_ptr, face_index, face);
+          if (res >= 0) {
+            face_num = res;
           }
         }
 
@@ -2071,12 +3946,10 @@ TMRModel *TMRMesh::createModelFromMesh() {
           }
 
           // Find the associated edge number
-          int *res = (int *)bsearch(edge, sorted_edges, num_mesh_edges,
-                                    3 * sizeof(int), compare_edges);
+          int edge_num =
+              TMR_FindEdgeIndex(edge_ptr, edge_index, edge[1], edge[2]);
 
-          if (res) {
-            // Get the global edge number
-            int edge_num = res[0];
+          if (edge_num >= 0) {
             c[k] = new_edges[edge_num];
             dir[k] *= edge_dir[edge_num];
           } else {
@@ -2091,10 +3964,12 @@ TMRModel *TMRMesh::createModelFromMesh() {
     }
   }
 
-  // Free all of the edge search information
-  delete[] sorted_edges;
-  if (sorted_faces) {
-    delete[] sorted_faces;
+  // Free all of the edge and face search information
+  delete[] edge_ptr;
+  delete[] edge_index;
+  if (face_index) {
+    delete[] face_ptr;
+    delete[] face_index;
   }
 
   TMRVolume **new_volumes = NULL;
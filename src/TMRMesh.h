@@ -35,6 +35,20 @@ enum TMRFaceMeshType {
   TMR_TRIANGLE
 };
 
+/*
+  The method used to distribute the face meshing across processors
+*/
+enum TMRFaceMeshDistribution {
+  TMR_NO_DISTRIBUTION,
+  TMR_STATIC_DISTRIBUTION,
+  TMR_COST_DISTRIBUTION
+};
+
+/*
+  The ordering of the nodes and elements in the global mesh
+*/
+enum TMRMeshNodeOrdering { TMR_NATURAL_ORDER, TMR_RCM_ORDER };
+
 /*
   Methods for computing the mesh connectivity and dual connectivity
   information from other data.
@@ -57,7 +71,12 @@ void TMR_ComputeQuadEdges(int nnodes, int nquads, const int quads[],
 void TMR_ComputeHexEdgesAndFaces(int nnodes, int nhex, const int hex[],
                                  int *_num_hex_edges, int **_hex_edges,
                                  int **_hex_edge_nums, int *_num_hex_faces,
-                                 int **_hex_faces, int **_hex_face_nums);
+                                 int **_hex_faces, int **_hex_face_nums,
+                                 int **_node_to_hex_ptr = NULL,
+                                 int **_node_to_hex = NULL,
+                                 int num_threads = 1);
+void TMR_ComputeRCMOrder(int nnodes, int nelems, const int elem_ptr[],
+                         const int elem_conn[], int new_nums[]);
 
 /*
   Global options for meshing
@@ -78,12 +97,32 @@ class TMRMeshOptions {
     // Set the default meshing options
     mesh_type_default = TMR_STRUCTURED;
     num_smoothing_steps = 10;
+    smoothing_tolerance = 0.0;
     tri_smoothing_type = TMR_LAPLACIAN;
     frontal_quality_factor = 1.5;
 
+    // By default, triangulate each face as a single domain
+    num_frontal_subdomains = 1;
+    frontal_subdomain_min_triangles = 10000;
+
+    // By default, always use the exact perfect matching to recombine
+    // triangles into quadrilaterals
+    greedy_recombine_min_triangles = 0;
+    greedy_recombine_tolerance = 0.5;
+
     // By default, reset the mesh objects
     reset_mesh_objects = 1;
 
+    // By default, mesh each face on the root processor
+    face_mesh_distribution = TMR_NO_DISTRIBUTION;
+    num_threads = 1;
+
+    // By default, keep the topological node ordering
+    node_ordering = TMR_NATURAL_ORDER;
+
+    // By default, do not cache the edge and face meshes
+    mesh_cache_dir[0] = '\0';
+
     // By default, write nothing to any files
     write_init_domain_triangle = 0;
     write_triangularize_intermediate = 0;
@@ -108,9 +147,45 @@ class TMRMeshOptions {
   TriangleSmoothingType tri_smoothing_type;
   double frontal_quality_factor;
 
+  // Split the parameter domain of large unstructured faces into at
+  // most this many subdomains that are triangulated concurrently
+  // (if greater than one). A face is only split if each subdomain is
+  // expected to contain at least frontal_subdomain_min_triangles.
+  int num_frontal_subdomains;
+  int frontal_subdomain_min_triangles;
+
+  // Stop smoothing before num_smoothing_steps once no point moves
+  // more than this fraction of the mean edge length in a sweep. A
+  // value of zero always applies num_smoothing_steps.
+  double smoothing_tolerance;
+
+  // Use an approximate greedy matching to recombine faces with at
+  // least this many triangles (if positive). The greedy matching is
+  // accepted when its weight is within the relative tolerance of a
+  // lower bound on the optimal weight, otherwise the exact perfect
+  // matching is used.
+  int greedy_recombine_min_triangles;
+  double greedy_recombine_tolerance;
+
   // Reset the mesh objects in each geometry object
   int reset_mesh_objects;
 
+  // Distribute the face meshes across processors
+  TMRFaceMeshDistribution face_mesh_distribution;
+
+  // The number of threads used to mesh the faces on each processor
+  int num_threads;
+
+  // The ordering of the global nodes and elements. The natural order
+  // numbers the vertices, edges, faces and then volumes. The reverse
+  // Cuthill-McKee order reduces the bandwidth of the mesh.
+  TMRMeshNodeOrdering node_ordering;
+
+  // Store the edge and face meshes in this directory (if not empty)
+  // and load them instead of re-meshing when the geometry, the
+  // feature size and the options are unchanged
+  char mesh_cache_dir[256];
+
   // Write intermediate surface meshes to file
   int write_init_domain_triangle;
   int write_triangularize_intermediate;
@@ -122,6 +197,75 @@ class TMRMeshOptions {
   int write_quad_dual;
 };
 
+/*
+  The versions of the mesh cache. The format version is stored in the
+  header of each file, and the algorithm version is added to each key.
+  Increment the format version when the layout of the cache files
+  changes, and the algorithm version when a change to the meshing
+  produces a different mesh from the same input.
+*/
+static const int TMR_MESH_CACHE_FORMAT_VERSION = 2;
+static const int TMR_MESH_CACHE_ALGORITHM_VERSION = 1;
+
+/*
+  A fingerprint of the data that determines an edge or face mesh
+
+  The fingerprint is a 64-bit FNV-1a hash that is used as the key for
+  the mesh cache. The geometry is included by evaluating it at sample
+  points on the edge or face, while the feature size adds the data
+  that defines it exactly.
+*/
+class TMRMeshFingerprint {
+ public:
+  TMRMeshFingerprint() {
+    hash = 14695981039346656037ULL;
+    add(TMR_MESH_CACHE_ALGORITHM_VERSION);
+  }
+
+  // Add data to the fingerprint
+  void add(const void *data, size_t size) {
+    const unsigned char *c = (const unsigned char *)data;
+    for (size_t i = 0; i < size; i++) {
+      hash = (hash ^ c[i]) * 1099511628211ULL;
+    }
+  }
+  void add(int value) { add(&value, sizeof(int)); }
+  void add(double value) { add(&value, sizeof(double)); }
+  void add(const TMRPoint &p) {
+    add(p.x);
+    add(p.y);
+    add(p.z);
+  }
+  void addString(const char *str) { add(str, strlen(str) + 1); }
+
+  // Add the options that modify the face meshes
+  void addOptions(const TMRMeshOptions &options);
+
+  // Add the sample points
+  void addPoints(int npts, const TMRPoint *X);
+
+  // Add the feature size. Returns a non-zero fail flag if the
+  // feature size cannot be fingerprinted.
+  int addFeatureSize(TMRElementFeatureSize *fs);
+
+  uint64_t hash;
+};
+
+/*
+  Create, open and close the files in the mesh cache
+
+  Each file starts with a header that contains the key. A new file is
+  written to a temporary file that is only renamed once it is
+  complete, so that a partial file is never read.
+*/
+void TMR_GetMeshCacheFileName(const char *cache_dir, const char *prefix,
+                              uint64_t key, char *filename, size_t len);
+FILE *TMR_OpenMeshCacheFile(const char *filename, uint64_t key);
+FILE *TMR_CreateMeshCacheFile(const char *filename, uint64_t key,
+                              char *tmp_file, size_t len);
+void TMR_CloseMeshCacheFile(FILE *fp, const char *tmp_file,
+                            const char *filename, int fail);
+
 /*
   Mesh the geometry model.
 
@@ -144,16 +288,37 @@ class TMRMesh : public TMREntity {
   void writeToVTK(const char *filename,
                   int flag = (TMRMesh::TMR_QUAD | TMRMesh::TMR_HEX));
 
-  // Write the mesh to a BDF file
+  // Write the mesh to a binary VTK XML file
+  int writeToVTU(const char *filename,
+                 int flag = (TMRMesh::TMR_QUAD | TMRMesh::TMR_HEX),
+                 int use_float32 = 1);
+
+  // Write the mesh to a BDF file in parallel
   void writeToBDF(const char *filename,
                   int flag = (TMRMesh::TMR_QUAD | TMRMesh::TMR_HEX),
-                  TMRBoundaryConditions *bcs = NULL);
+                  TMRBoundaryConditions *bcs = NULL, int large_field = 1);
 
   // Retrieve the mesh components
   int getMeshPoints(TMRPoint **_X);
   void getQuadConnectivity(int *_nquads, const int **_quads);
   void getTriConnectivity(int *_ntris, const int **_tris);
   void getHexConnectivity(int *_nhex, const int **_hex);
+  void getTetConnectivity(int *_ntet, const int **_tet);
+
+  // Compute histograms of the element quality metrics (collective)
+  int computeMeshQuality(int elem_type, int nbins, int hist[],
+                         double min_quality[] = NULL);
+
+  // Get the memory used by the global mesh arrays
+  void getMemoryUsage(TMRMemoryUsage *usage);
+
+  // Get the mesh as the connectivity for an octree or quadtree forest
+  int getOctForestConnectivity(int *_num_edges, int *_num_faces,
+                               int *_num_blocks, int **_block_conn,
+                               int **_block_edge_conn,
+                               int **_block_face_conn);
+  int getQuadForestConnectivity(int *_num_edges, int *_num_faces,
+                                int **_face_conn, int **_face_edge_conn);
 
   // Create a topology object (with underlying mesh geometry)
   TMRModel *createModelFromMesh();
@@ -165,10 +330,25 @@ class TMRMesh : public TMREntity {
   // Reset the mesh
   void resetMesh();
 
+  // Free the global mesh arrays
+  void freeMeshArrays();
+
+  // Reorder the nodes within the mesh entities
+  void reorderNodes();
+
+  // Mesh the model in parallel across processors and threads
+  void meshInParallel(TMRMeshOptions options, TMRElementFeatureSize *fs);
+
   // The underlying geometry object
   MPI_Comm comm;
   TMRModel *geo;
 
+  // The ordering of the nodes and elements
+  TMRMeshNodeOrdering node_ordering;
+
+  // The number of threads used for the mesh operations
+  int num_threads;
+
   // The number of nodes/positions in the mesh
   int num_nodes;
   TMRPoint *X;
@@ -45,28 +45,72 @@ inline void addParamMovement(double alpha, TMRPoint *Xu, TMRPoint *Xv,
   delta[1] += invdet * (g11 * b2 - g12 * b1);
 }
 
+/*
+  Evaluate the derivatives of the surface at the free points.
+
+  The Jacobi-type smoothers below only update the parameter locations
+  during a sweep. The surface point at the new parameters is obtained
+  here, from the same evaluation as the derivatives, at the start of
+  the next sweep. When update is non-zero, the free points (with a
+  non-zero count, if the count is supplied) are moved to the surface
+  and the maximum squared distance moved by any point is returned.
+*/
+static double evalFreePointDerivs(int update, int num_fixed_pts, int num_pts,
+                                  const int *count, const double *prm,
+                                  TMRPoint *p, TMRPoint *Xu, TMRPoint *Xv,
+                                  TMRFace *face) {
+  double max_move = 0.0;
+  for (int i = num_fixed_pts; i < num_pts; i++) {
+    TMRPoint X;
+    face->evalDeriv(prm[2 * i], prm[2 * i + 1], &X, &Xu[i], &Xv[i]);
+    if (update && (!count || count[i] > 0)) {
+      TMRPoint d;
+      d.x = X.x - p[i].x;
+      d.y = X.y - p[i].y;
+      d.z = X.z - p[i].z;
+      double move = d.dot(d);
+      if (move > max_move) {
+        max_move = move;
+      }
+      p[i] = X;
+    }
+  }
+
+  return max_move;
+}
+
 /*
   Apply Laplacian smoothing
+
+  If tol > 0, the smoothing stops before nsmooth sweeps once no point
+  moves more than tol times the mean edge length in a sweep.
 */
 void TMR_LaplacianSmoothing(int nsmooth, int num_fixed_pts, int num_edges,
                             const int *edge_list, int num_pts, double *prm,
-                            TMRPoint *p, TMRFace *face) {
+                            TMRPoint *p, TMRFace *face, double tol) {
   int *count = new int[num_pts];
   double *new_params = new double[2 * num_pts];
   TMRPoint *Xu = new TMRPoint[num_pts];
   TMRPoint *Xv = new TMRPoint[num_pts];
 
+  // Count the number of edges that reference each point. This does
+  // not change between sweeps.
+  memset(count, 0, num_pts * sizeof(int));
+  for (int i = 0; i < 2 * num_edges; i++) {
+    count[edge_list[i]]++;
+  }
+
+  int converged = 0;
   for (int iter = 0; iter < nsmooth; iter++) {
-    memset(count, 0, num_pts * sizeof(int));
     memset(new_params, 0, 2 * num_pts * sizeof(double));
 
-    // Evaluate the derivatives w.r.t. the parameter locations
-    for (int i = num_fixed_pts; i < num_pts; i++) {
-      TMRPoint X;
-      face->evalDeriv(prm[2 * i], prm[2 * i + 1], &X, &Xu[i], &Xv[i]);
-    }
+    // Evaluate the derivatives w.r.t. the parameter locations and
+    // move the points to the locations from the previous sweep
+    double max_move = evalFreePointDerivs(iter > 0, num_fixed_pts, num_pts,
+                                          count, prm, p, Xu, Xv, face);
 
     // Loop over all the edges
+    double sum = 0.0;
     for (int i = 0; i < num_edges; i++) {
       int n1 = edge_list[2 * i];
       int n2 = edge_list[2 * i + 1];
@@ -77,17 +121,27 @@ void TMR_LaplacianSmoothing(int nsmooth, int num_fixed_pts, int num_edges,
       d.x = p[n2].x - p[n1].x;
       d.y = p[n2].y - p[n1].y;
       d.z = p[n2].z - p[n1].z;
+      if (tol > 0.0) {
+        sum += sqrt(d.dot(d));
+      }
 
       // Add the movement of the node in parameter space
       if (n1 >= num_fixed_pts) {
         addParamMovement(1.0, &Xu[n1], &Xv[n1], &d, &new_params[2 * n1]);
-        count[n1]++;
       }
 
       // Add the movement of the second node in parameter space
       if (n2 >= num_fixed_pts) {
         addParamMovement(-1.0, &Xu[n2], &Xv[n2], &d, &new_params[2 * n2]);
-        count[n2]++;
+      }
+    }
+
+    // Check whether the last sweep moved the points appreciably
+    if (tol > 0.0 && iter > 0) {
+      double h = tol * sum / num_edges;
+      if (max_move < h * h) {
+        converged = 1;
+        break;
       }
     }
 
@@ -96,6 +150,14 @@ void TMR_LaplacianSmoothing(int nsmooth, int num_fixed_pts, int num_edges,
       if (count[i] > 0) {
         prm[2 * i] += new_params[2 * i] / count[i];
         prm[2 * i + 1] += new_params[2 * i + 1] / count[i];
+      }
+    }
+  }
+
+  // Evaluate the points at the final parameter locations
+  if (nsmooth > 0 && !converged) {
+    for (int i = num_fixed_pts; i < num_pts; i++) {
+      if (count[i] > 0) {
         face->evalPoint(prm[2 * i], prm[2 * i + 1], &p[i]);
       }
     }
@@ -109,16 +171,25 @@ void TMR_LaplacianSmoothing(int nsmooth, int num_fixed_pts, int num_edges,
 
 /*
   Apply the spring smoothing analogy
+
+  If tol > 0, the smoothing stops before nsmooth sweeps once no point
+  moves more than tol times the mean edge length in a sweep.
 */
 void TMR_SpringSmoothing(int nsmooth, double alpha, int num_fixed_pts,
                          int num_edges, const int *edge_list, int num_pts,
-                         double *prm, TMRPoint *p, TMRFace *face) {
+                         double *prm, TMRPoint *p, TMRFace *face, double tol) {
   double *len = new double[num_edges];
   double *new_params = new double[2 * num_pts];
   TMRPoint *Xu = new TMRPoint[num_pts];
   TMRPoint *Xv = new TMRPoint[num_pts];
 
+  int converged = 0;
   for (int iter = 0; iter < nsmooth; iter++) {
+    // Evaluate the derivatives w.r.t. the parameter locations and
+    // move the points to the locations from the previous sweep
+    double max_move = evalFreePointDerivs(iter > 0, num_fixed_pts, num_pts,
+                                          NULL, prm, p, Xu, Xv, face);
+
     double sum = 0.0;
     for (int i = 0; i < num_edges; i++) {
       int n1 = edge_list[2 * i];
@@ -136,10 +207,13 @@ void TMR_SpringSmoothing(int nsmooth, double alpha, int num_fixed_pts,
     }
     double len0 = 0.9 * sum / num_edges;
 
-    // Evaluate the derivatives w.r.t. the parameter locations
-    for (int i = num_fixed_pts; i < num_pts; i++) {
-      TMRPoint X;
-      face->evalDeriv(prm[2 * i], prm[2 * i + 1], &X, &Xu[i], &Xv[i]);
+    // Check whether the last sweep moved the points appreciably
+    if (tol > 0.0 && iter > 0) {
+      double h = tol * sum / num_edges;
+      if (max_move < h * h) {
+        converged = 1;
+        break;
+      }
     }
 
     memset(new_params, 0, 2 * num_pts * sizeof(double));
@@ -172,10 +246,15 @@ void TMR_SpringSmoothing(int nsmooth, double alpha, int num_fixed_pts,
     for (int i = num_fixed_pts; i < num_pts; i++) {
       prm[2 * i] += alpha * new_params[2 * i];
       prm[2 * i + 1] += alpha * new_params[2 * i + 1];
-      face->evalPoint(prm[2 * i], prm[2 * i + 1], &p[i]);
     }
   }
 
+  // Evaluate the points at the final parameter locations
+  if (nsmooth > 0 && !converged && num_pts > num_fixed_pts) {
+    face->evalPoints(num_pts - num_fixed_pts, &prm[2 * num_fixed_pts],
+                     &p[num_fixed_pts]);
+  }
+
   delete[] new_params;
   delete[] len;
   delete[] Xu;
@@ -188,11 +267,14 @@ void TMR_SpringSmoothing(int nsmooth, double alpha, int num_fixed_pts,
   This code also connects springs across the faces of quadrilateral
   elements in an attempt to achieve higher mesh quality. This is
   not always successful.
+
+  If tol > 0, the smoothing stops before nsmooth sweeps once no point
+  moves more than tol times the mean edge length in a sweep.
 */
 void TMR_SpringQuadSmoothing(int nsmooth, double alpha, int num_fixed_pts,
                              int num_quads, const int *quad_list, int num_edges,
                              const int *edge_list, int num_pts, double *prm,
-                             TMRPoint *p, TMRFace *face) {
+                             TMRPoint *p, TMRFace *face, double tol) {
   double *len = new double[num_edges];
   double *new_params = new double[2 * num_pts];
   TMRPoint *Xu = new TMRPoint[num_pts];
@@ -201,7 +283,13 @@ void TMR_SpringQuadSmoothing(int nsmooth, double alpha, int num_fixed_pts,
   // Compute the squrare root of 2
   const double sqrt2 = 1.1 * sqrt(2.0);
 
+  int converged = 0;
   for (int iter = 0; iter < nsmooth; iter++) {
+    // Evaluate the derivatives w.r.t. the parameter locations and
+    // move the points to the locations from the previous sweep
+    double max_move = evalFreePointDerivs(iter > 0, num_fixed_pts, num_pts,
+                                          NULL, prm, p, Xu, Xv, face);
+
     double sum = 0.0;
     for (int i = 0; i < num_edges; i++) {
       int n1 = edge_list[2 * i];
@@ -219,10 +307,13 @@ void TMR_SpringQuadSmoothing(int nsmooth, double alpha, int num_fixed_pts,
     }
     double len0 = sum / num_edges;
 
-    // Evaluate the derivatives w.r.t. the parameter locations
-    for (int i = num_fixed_pts; i < num_pts; i++) {
-      TMRPoint X;
-      face->evalDeriv(prm[2 * i], prm[2 * i + 1], &X, &Xu[i], &Xv[i]);
+    // Check whether the last sweep moved the points appreciably
+    if (tol > 0.0 && iter > 0) {
+      double h = tol * len0;
+      if (max_move < h * h) {
+        converged = 1;
+        break;
+      }
     }
 
     memset(new_params, 0, 2 * num_pts * sizeof(double));
@@ -290,10 +381,15 @@ void TMR_SpringQuadSmoothing(int nsmooth, double alpha, int num_fixed_pts,
     for (int i = num_fixed_pts; i < num_pts; i++) {
       prm[2 * i] += alpha * new_params[2 * i];
       prm[2 * i + 1] += alpha * new_params[2 * i + 1];
-      face->evalPoint(prm[2 * i], prm[2 * i + 1], &p[i]);
     }
   }
 
+  // Evaluate the points at the final parameter locations
+  if (nsmooth > 0 && !converged && num_pts > num_fixed_pts) {
+    face->evalPoints(num_pts - num_fixed_pts, &prm[2 * num_fixed_pts],
+                     &p[num_fixed_pts]);
+  }
+
   delete[] new_params;
   delete[] len;
   delete[] Xu;
@@ -302,11 +398,15 @@ void TMR_SpringQuadSmoothing(int nsmooth, double alpha, int num_fixed_pts,
 
 /*
   Smooth the mesh
+
+  The points are updated in place, in order of increasing degree. If
+  tol > 0, the smoothing stops before nsmooth sweeps once no point
+  moves more than tol times the mean edge length in a sweep.
 */
 void TMR_QuadSmoothing(int nsmooth, int num_fixed_pts, int num_pts,
                        const int *ptr, const int *pts_to_quads, int num_quads,
                        const int *quads, double *prm, TMRPoint *p,
-                       TMRFace *face) {
+                       TMRFace *face, double tol) {
   // Compute the min/max degree
   int min_degree = 0;
   int max_degree = 0;
@@ -324,171 +424,221 @@ void TMR_QuadSmoothing(int nsmooth, int num_fixed_pts, int num_pts,
     }
   }
 
+  // Order the free points by increasing degree once, rather than
+  // scanning all the points for each degree during every sweep
+  int num_free = num_pts - num_fixed_pts;
+  int num_degrees = max_degree - min_degree + 1;
+  int *degree_ptr = new int[num_degrees + 1];
+  int *order = new int[num_free > 0 ? num_free : 1];
+  memset(degree_ptr, 0, (num_degrees + 1) * sizeof(int));
+  for (int i = num_fixed_pts; i < num_pts; i++) {
+    degree_ptr[ptr[i + 1] - ptr[i] - min_degree + 1]++;
+  }
+  for (int k = 0; k < num_degrees; k++) {
+    degree_ptr[k + 1] += degree_ptr[k];
+  }
+  for (int i = num_fixed_pts; i < num_pts; i++) {
+    order[degree_ptr[ptr[i + 1] - ptr[i] - min_degree]++] = i;
+  }
+  delete[] degree_ptr;
+
+  // Compute the mean edge length used in the convergence check
+  double h = 0.0;
+  if (tol > 0.0 && num_quads > 0) {
+    for (int i = 0; i < num_quads; i++) {
+      for (int k = 0; k < 4; k++) {
+        const TMRPoint *a = &p[quads[4 * i + k]];
+        const TMRPoint *b = &p[quads[4 * i + (k + 1) % 4]];
+        TMRPoint d;
+        d.x = b->x - a->x;
+        d.y = b->y - a->y;
+        d.z = b->z - a->z;
+        h += sqrt(d.dot(d));
+      }
+    }
+    h = tol * h / (4 * num_quads);
+  }
+
   for (int iter = 0; iter < nsmooth; iter++) {
-    for (int degree = min_degree; degree <= max_degree; degree++) {
-      for (int i = num_fixed_pts; i < num_pts; i++) {
-        int N = ptr[i + 1] - ptr[i];
-
-        if (N == degree) {
-          // Evaluate the derivatives w.r.t. the parameter locations so
-          // that we can take movement in the physical plane and convert
-          // it to movement in the parametric coordinates
-          TMRPoint X, Xu, Xv;
-          face->evalDeriv(prm[2 * i], prm[2 * i + 1], &X, &Xu, &Xv);
-
-          // Normalize the directions Xu, Xv to form a locally-orthonormal
-          // coordinate frame aligned with the surface
-          TMRPoint xdir, ydir;
-
-          // Normalize the x-direction
-          double xnorm = sqrt(Xu.dot(Xu));
-          xdir.x = Xu.x / xnorm;
-          xdir.y = Xu.y / xnorm;
-          xdir.z = Xu.z / xnorm;
-
-          // Remove the component of the x-direction from Xv
-          double dot = xdir.dot(Xv);
-          ydir.x = Xv.x - dot * xdir.x;
-          ydir.y = Xv.y - dot * xdir.y;
-          ydir.z = Xv.z - dot * xdir.z;
-
-          double ynorm = sqrt(ydir.dot(ydir));
-          ydir.x = ydir.x / ynorm;
-          ydir.y = ydir.y / ynorm;
-          ydir.z = ydir.z / ynorm;
-
-          if (N > 0) {
-            // Loop over the quadrilaterals that reference this point
-            double A = 0.0, B = 0.0;
-            for (int qp = ptr[i]; qp < ptr[i + 1]; qp++) {
-              const int *quad = &quads[4 * pts_to_quads[qp]];
-
-              // Pick out the influence triangle points from the quadrilateral
-              // This consists of the base point i and the following two
-              int ijk[3];
-              if (quad[0] == i) {
-                ijk[0] = quad[0];
-                ijk[1] = quad[1];
-                ijk[2] = quad[3];
-              } else if (quad[1] == i) {
-                ijk[0] = quad[1];
-                ijk[1] = quad[2];
-                ijk[2] = quad[0];
-              } else if (quad[2] == i) {
-                ijk[0] = quad[2];
-                ijk[1] = quad[3];
-                ijk[2] = quad[1];
-              } else {
-                ijk[0] = quad[3];
-                ijk[1] = quad[0];
-                ijk[2] = quad[2];
-              }
-
-              // Now compute the geometric quantities
-              // p = yj - yk, q = xk - xj
-              double xi = xdir.dot(p[ijk[0]]);
-              double yi = ydir.dot(p[ijk[0]]);
-              double xj = xdir.dot(p[ijk[1]]);
-              double yj = ydir.dot(p[ijk[1]]);
-              double xk = xdir.dot(p[ijk[2]]);
-              double yk = ydir.dot(p[ijk[2]]);
-              double p = yj - yk;
-              double q = xk - xj;
-              double r = xj * yk - xk * yj;
-              double a = 0.5 * (p * xi + q * yi + r);
-              double b = sqrt(p * p + q * q);
-              A += a;
-              B += b;
-            }
-
-            double hbar = 2.0 * A / B;
-            double bbar = B / N;
-
-            // Set the weights
-            double w1 = 1.0 / (hbar * hbar);
-            double w2 = 4.0 / (bbar * bbar);
-
-            // The parameters for the Jacobian/right-hand-side
-            double s1 = 0.0, s2 = 0.0, s3 = 0.0, s4 = 0.0, s5 = 0.0;
-
-            for (int qp = ptr[i]; qp < ptr[i + 1]; qp++) {
-              const int *quad = &quads[4 * pts_to_quads[qp]];
-
-              // Pick out the influence triangle points from the quadrilateral
-              // This consists of the base point i and the following two
-              int ijk[3];
-              if (quad[0] == i) {
-                ijk[0] = quad[0];
-                ijk[1] = quad[1];
-                ijk[2] = quad[3];
-              } else if (quad[1] == i) {
-                ijk[0] = quad[1];
-                ijk[1] = quad[2];
-                ijk[2] = quad[0];
-              } else if (quad[2] == i) {
-                ijk[0] = quad[2];
-                ijk[1] = quad[3];
-                ijk[2] = quad[1];
-              } else {
-                ijk[0] = quad[3];
-                ijk[1] = quad[0];
-                ijk[2] = quad[2];
-              }
-
-              // Now compute the geometric quantities
-              // p = yj - yk, q = xk - xj
-              double xi = xdir.dot(p[ijk[0]]);
-              double yi = ydir.dot(p[ijk[0]]);
-              double xj = xdir.dot(p[ijk[1]]);
-              double yj = ydir.dot(p[ijk[1]]);
-              double xk = xdir.dot(p[ijk[2]]);
-              double yk = ydir.dot(p[ijk[2]]);
-              double p = yj - yk;
-              double q = xk - xj;
-              double r = xj * yk - xk * yj;
-              double a = 0.5 * (p * xi + q * yi + r);
-              double b = sqrt(p * p + q * q);
-
-              // Other quantities derived from the in-plane triangle data
-              double xm = 0.5 * (xj + xk);
-              double ym = 0.5 * (yj + yk);
-              double binv2 = 1.0 / (b * b);
-
-              // Sum up the contributions to the s terms
-              s1 += binv2 * (w1 * p * p + w2 * q * q);
-              s2 += binv2 * p * q * (w1 - w2);
-              s3 += binv2 * (w1 * p * (hbar * b - 2 * a) -
-                             w2 * q * ((xi - xm) * q - (yi - ym) * p));
-              s4 += binv2 * (w1 * q * q + w2 * p * p);
-              s5 += binv2 * (w1 * q * (hbar * b - 2 * a) -
-                             w2 * p * ((yi - ym) * p - (xi - xm) * q));
-            }
-
-            // Compute the updates in the physical plane
-            double det = s1 * s4 - s2 * s2;
-            double lx = 0.0, ly = 0.0;
-            if (det != 0.0) {
-              det = 1.0 / det;
-              lx = det * (s3 * s4 - s2 * s5);
-              ly = det * (s1 * s5 - s2 * s3);
-            }
-
-            // Check that the requested move direction is well-defined
-            if (lx == lx && ly == ly) {
-              // Add up the displacements along the local coordinate directions
-              TMRPoint dir;
-              dir.x = lx * xdir.x + ly * ydir.x;
-              dir.y = lx * xdir.y + ly * ydir.y;
-              dir.z = lx * xdir.z + ly * ydir.z;
-
-              // Add the parameter movement along the specified direction
-              // and compute the update
-              addParamMovement(1.0, &Xu, &Xv, &dir, &prm[2 * i]);
-              face->evalPoint(prm[2 * i], prm[2 * i + 1], &p[i]);
-            }
+    double max_move = 0.0;
+    for (int index = 0; index < num_free; index++) {
+      int i = order[index];
+      int N = ptr[i + 1] - ptr[i];
+
+      // Evaluate the derivatives w.r.t. the parameter locations so
+      // that we can take movement in the physical plane and convert
+      // it to movement in the parametric coordinates
+      TMRPoint X, Xu, Xv;
+      face->evalDeriv(prm[2 * i], prm[2 * i + 1], &X, &Xu, &Xv);
+
+      // Normalize the directions Xu, Xv to form a locally-orthonormal
+      // coordinate frame aligned with the surface
+      TMRPoint xdir, ydir;
+
+      // Normalize the x-direction
+      double xnorm = sqrt(Xu.dot(Xu));
+      xdir.x = Xu.x / xnorm;
+      xdir.y = Xu.y / xnorm;
+      xdir.z = Xu.z / xnorm;
+
+      // Remove the component of the x-direction from Xv
+      double dot = xdir.dot(Xv);
+      ydir.x = Xv.x - dot * xdir.x;
+      ydir.y = Xv.y - dot * xdir.y;
+      ydir.z = Xv.z - dot * xdir.z;
+
+      double ynorm = sqrt(ydir.dot(ydir));
+      ydir.x = ydir.x / ynorm;
+      ydir.y = ydir.y / ynorm;
+      ydir.z = ydir.z / ynorm;
+
+      if (N > 0) {
+        // Loop over the quadrilaterals that reference this point
+        double A = 0.0, B = 0.0;
+        for (int qp = ptr[i]; qp < ptr[i + 1]; qp++) {
+          const int *quad = &quads[4 * pts_to_quads[qp]];
+
+          // Pick out the influence triangle points from the quadrilateral
+          // This consists of the base point i and the following two
+          int ijk[3];
+          if (quad[0] == i) {
+            ijk[0] = quad[0];
+            ijk[1] = quad[1];
+            ijk[2] = quad[3];
+          } else if (quad[1] == i) {
+            ijk[0] = quad[1];
+            ijk[1] = quad[2];
+            ijk[2] = quad[0];
+          } else if (quad[2] == i) {
+            ijk[0] = quad[2];
+            ijk[1] = quad[3];
+            ijk[2] = quad[1];
+          } else {
+            ijk[0] = quad[3];
+            ijk[1] = quad[0];
+            ijk[2] = quad[2];
+          }
+
+          // Now compute the geometric quantities
+          // p = yj - yk, q = xk - xj
+          double xi = xdir.dot(p[ijk[0]]);
+          double yi = ydir.dot(p[ijk[0]]);
+          double xj = xdir.dot(p[ijk[1]]);
+          double yj = ydir.dot(p[ijk[1]]);
+          double xk = xdir.dot(p[ijk[2]]);
+          double yk = ydir.dot(p[ijk[2]]);
+          double p = yj - yk;
+          double q = xk - xj;
+          double r = xj * yk - xk * yj;
+          double a = 0.5 * (p * xi + q * yi + r);
+          double b = sqrt(p * p + q * q);
+          A += a;
+          B += b;
+        }
+
+        double hbar = 2.0 * A / B;
+        double bbar = B / N;
+
+        // Set the weights
+        double w1 = 1.0 / (hbar * hbar);
+        double w2 = 4.0 / (bbar * bbar);
+
+        // The parameters for the Jacobian/right-hand-side
+        double s1 = 0.0, s2 = 0.0, s3 = 0.0, s4 = 0.0, s5 = 0.0;
+
+        for (int qp = ptr[i]; qp < ptr[i + 1]; qp++) {
+          const int *quad = &quads[4 * pts_to_quads[qp]];
+
+          // Pick out the influence triangle points from the quadrilateral
+          // This consists of the base point i and the following two
+          int ijk[3];
+          if (quad[0] == i) {
+            ijk[0] = quad[0];
+            ijk[1] = quad[1];
+            ijk[2] = quad[3];
+          } else if (quad[1] == i) {
+            ijk[0] = quad[1];
+            ijk[1] = quad[2];
+            ijk[2] = quad[0];
+          } else if (quad[2] == i) {
+            ijk[0] = quad[2];
+            ijk[1] = quad[3];
+            ijk[2] = quad[1];
+          } else {
+            ijk[0] = quad[3];
+            ijk[1] = quad[0];
+            ijk[2] = quad[2];
+          }
+
+          // Now compute the geometric quantities
+          // p = yj - yk, q = xk - xj
+          double xi = xdir.dot(p[ijk[0]]);
+          double yi = ydir.dot(p[ijk[0]]);
+          double xj = xdir.dot(p[ijk[1]]);
+          double yj = ydir.dot(p[ijk[1]]);
+          double xk = xdir.dot(p[ijk[2]]);
+          double yk = ydir.dot(p[ijk[2]]);
+          double p = yj - yk;
+          double q = xk - xj;
+          double r = xj * yk - xk * yj;
+          double a = 0.5 * (p * xi + q * yi + r);
+          double b = sqrt(p * p + q * q);
+
+          // Other quantities derived from the in-plane triangle data
+          double xm = 0.5 * (xj + xk);
+          double ym = 0.5 * (yj + yk);
+          double binv2 = 1.0 / (b * b);
+
+          // Sum up the contributions to the s terms
+          s1 += binv2 * (w1 * p * p + w2 * q * q);
+          s2 += binv2 * p * q * (w1 - w2);
+          s3 += binv2 * (w1 * p * (hbar * b - 2 * a) -
+                         w2 * q * ((xi - xm) * q - (yi - ym) * p));
+          s4 += binv2 * (w1 * q * q + w2 * p * p);
+          s5 += binv2 * (w1 * q * (hbar * b - 2 * a) -
+                         w2 * p * ((yi - ym) * p - (xi - xm) * q));
+        }
+
+        // Compute the updates in the physical plane
+        double det = s1 * s4 - s2 * s2;
+        double lx = 0.0, ly = 0.0;
+        if (det != 0.0) {
+          det = 1.0 / det;
+          lx = det * (s3 * s4 - s2 * s5);
+          ly = det * (s1 * s5 - s2 * s3);
+        }
+
+        // Check that the requested move direction is well-defined
+        if (lx == lx && ly == ly) {
+          // Add up the displacements along the local coordinate directions
+          TMRPoint dir;
+          dir.x = lx * xdir.x + ly * ydir.x;
+          dir.y = lx * xdir.y + ly * ydir.y;
+          dir.z = lx * xdir.z + ly * ydir.z;
+
+          // Add the parameter movement along the specified direction
+          // and compute the update
+          addParamMovement(1.0, &Xu, &Xv, &dir, &prm[2 * i]);
+          face->evalPoint(prm[2 * i], prm[2 * i + 1], &p[i]);
+
+          // Record the distance that the point moved
+          TMRPoint d;
+          d.x = p[i].x - X.x;
+          d.y = p[i].y - X.y;
+          d.z = p[i].z - X.z;
+          double move = d.dot(d);
+          if (move > max_move) {
+            max_move = move;
           }
         }
       }
     }
+
+    // Stop once the sweep no longer moves the points appreciably
+    if (tol > 0.0 && max_move < h * h) {
+      break;
+    }
   }
+
+  delete[] order;
 }
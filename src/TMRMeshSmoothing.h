@@ -28,17 +28,18 @@
 */
 void TMR_LaplacianSmoothing(int nsmooth, int num_fixed_pts, int num_edges,
                             const int *edge_list, int num_pts, double *prm,
-                            TMRPoint *p, TMRFace *face);
+                            TMRPoint *p, TMRFace *face, double tol = 0.0);
 void TMR_SpringSmoothing(int nsmooth, double alpha, int num_fixed_pts,
                          int num_edges, const int *edge_list, int num_pts,
-                         double *prm, TMRPoint *p, TMRFace *face);
+                         double *prm, TMRPoint *p, TMRFace *face,
+                         double tol = 0.0);
 void TMR_SpringQuadSmoothing(int nsmooth, double alpha, int num_fixed_pts,
                              int num_quads, const int *quad_list, int num_edges,
                              const int *edge_list, int num_pts, double *prm,
-                             TMRPoint *p, TMRFace *face);
+                             TMRPoint *p, TMRFace *face, double tol = 0.0);
 void TMR_QuadSmoothing(int nsmooth, int num_fixed_pts, int num_pts,
                        const int *ptr, const int *pts_to_quads, int num_quads,
                        const int *quad_list, double *prm, TMRPoint *p,
-                       TMRFace *face);
+                       TMRFace *face, double tol = 0.0);
 
 #endif  // TMR_MESH_SMOOTHING_H
@@ -23,6 +23,103 @@
 #include <math.h>
 #include <stdio.h>
 
+/*
+  Create an edge from a curve
+*/
+TMREdgeFromCurve::TMREdgeFromCurve(TMRCurve *_curve) {
+  curve = _curve;
+  curve->incref();
+  has_range = 0;
+  tmin = tmax = 0.0;
+  npcurves = 0;
+  pcurve_faces = NULL;
+  pcurve_dirs = NULL;
+  pcurves = NULL;
+}
+
+TMREdgeFromCurve::~TMREdgeFromCurve() {
+  curve->decref();
+  for (int i = 0; i < npcurves; i++) {
+    pcurves[i]->decref();
+  }
+  if (pcurves) {
+    delete[] pcurve_faces;
+    delete[] pcurve_dirs;
+    delete[] pcurves;
+  }
+}
+
+/*
+  Get the parameter range of the edge
+*/
+void TMREdgeFromCurve::getRange(double *_tmin, double *_tmax) {
+  if (has_range) {
+    *_tmin = tmin;
+    *_tmax = tmax;
+  } else {
+    curve->getRange(_tmin, _tmax);
+  }
+}
+
+/*
+  Restrict the edge to the portion of the curve between tmin and tmax
+  without changing its parametrization
+*/
+void TMREdgeFromCurve::setRange(double _tmin, double _tmax) {
+  has_range = 1;
+  tmin = _tmin;
+  tmax = _tmax;
+}
+
+/*
+  Add the parametrization of the edge on the given face
+*/
+void TMREdgeFromCurve::addPcurve(TMRFace *face, int dir, TMRPcurve *pcurve) {
+  pcurve->incref();
+
+  TMRFace **_faces = new TMRFace *[npcurves + 1];
+  int *_dirs = new int[npcurves + 1];
+  TMRPcurve **_pcurves = new TMRPcurve *[npcurves + 1];
+  for (int i = 0; i < npcurves; i++) {
+    _faces[i] = pcurve_faces[i];
+    _dirs[i] = pcurve_dirs[i];
+    _pcurves[i] = pcurves[i];
+  }
+  _faces[npcurves] = face;
+  _dirs[npcurves] = (dir >= 0 ? 1 : -1);
+  _pcurves[npcurves] = pcurve;
+  if (pcurves) {
+    delete[] pcurve_faces;
+    delete[] pcurve_dirs;
+    delete[] pcurves;
+  }
+  pcurve_faces = _faces;
+  pcurve_dirs = _dirs;
+  pcurves = _pcurves;
+  npcurves++;
+}
+
+/*
+  Get the parameters on the face from the pcurve with the same
+  direction, or with any direction if there is only one
+*/
+int TMREdgeFromCurve::getParamsOnFace(TMRFace *face, double t, int dir,
+                                      double *u, double *v) {
+  TMRPcurve *pcurve = NULL;
+  for (int i = 0; i < npcurves; i++) {
+    if (pcurve_faces[i] == face) {
+      if (!pcurve || pcurve_dirs[i] == (dir >= 0 ? 1 : -1)) {
+        pcurve = pcurves[i];
+      }
+    }
+  }
+
+  if (pcurve) {
+    return pcurve->evalPoint(t, u, v);
+  }
+  return TMREdge::getParamsOnFace(face, t, dir, u, v);
+}
+
 /*
   Create a vertex from a point
 */
@@ -877,30 +974,12 @@ void TMRTFIVolume::getRange(double *umin, double *vmin, double *wmin,
 }
 
 /*
-  Evaluate the point within the volume
+  Compute the transfinite interpolation within the volume from the
+  points on the edges and the corners
 */
-int TMRTFIVolume::evalPoint(double u, double v, double w, TMRPoint *X) {
-  int fail = 0;
-
-  // Evaluate/retrieve the points on the edges
-  TMRPoint e[12];
-  for (int k = 0; k < 12; k++) {
-    double t;
-    if (k < 4) {
-      t = u;
-    } else if (k < 8) {
-      t = v;
-    } else {
-      t = w;
-    }
-
-    if (edge_dir[k] > 0) {
-      fail = fail || edges[k]->evalPoint(t, &e[k]);
-    } else {
-      fail = fail || edges[k]->evalPoint(1.0 - t, &e[k]);
-    }
-  }
-
+static inline void tfi_volume_point(double u, double v, double w,
+                                    const TMRPoint e[], const TMRPoint c[],
+                                    TMRPoint *X) {
   X->x =
       ((1.0 - v) * (1.0 - w) * e[0].x + v * (1.0 - w) * e[1].x +
        (1.0 - v) * w * e[2].x + v * w * e[3].x +
@@ -939,10 +1018,73 @@ int TMRTFIVolume::evalPoint(double u, double v, double w, TMRPoint *X) {
              (1.0 - u) * v * (1.0 - w) * c[2].z + u * v * (1.0 - w) * c[3].z +
              (1.0 - u) * (1.0 - v) * w * c[4].z + u * (1.0 - v) * w * c[5].z +
              (1.0 - u) * v * w * c[6].z + u * v * w * c[7].z);
+}
+
+/*
+  Evaluate the point within the volume
+*/
+int TMRTFIVolume::evalPoint(double u, double v, double w, TMRPoint *X) {
+  int fail = 0;
+
+  // Evaluate/retrieve the points on the edges
+  TMRPoint e[12];
+  for (int k = 0; k < 12; k++) {
+    double t;
+    if (k < 4) {
+      t = u;
+    } else if (k < 8) {
+      t = v;
+    } else {
+      t = w;
+    }
+
+    if (edge_dir[k] > 0) {
+      fail = fail || edges[k]->evalPoint(t, &e[k]);
+    } else {
+      fail = fail || edges[k]->evalPoint(1.0 - t, &e[k]);
+    }
+  }
+
+  tfi_volume_point(u, v, w, e, c, X);
 
   return 1;
 }
 
+/*
+  Evaluate an array of points within the volume. The edge points are
+  evaluated with one batched call per edge.
+*/
+int TMRTFIVolume::evalPoints(int n, const double *prm, TMRPoint *X) {
+  int fail = 0;
+  double *t = new double[n];
+  TMRPoint *e = new TMRPoint[12 * n];
+
+  for (int k = 0; k < 12; k++) {
+    int dir = (k < 4 ? 0 : (k < 8 ? 1 : 2));
+    for (int i = 0; i < n; i++) {
+      t[i] = prm[3 * i + dir];
+      if (edge_dir[k] <= 0) {
+        t[i] = 1.0 - t[i];
+      }
+    }
+    if (edges[k]->evalPoints(n, t, &e[k * n])) {
+      fail = 1;
+    }
+  }
+
+  for (int i = 0; i < n; i++) {
+    TMRPoint ei[12];
+    for (int k = 0; k < 12; k++) {
+      ei[k] = e[k * n + i];
+    }
+    tfi_volume_point(prm[3 * i], prm[3 * i + 1], prm[3 * i + 2], ei, c, &X[i]);
+  }
+
+  delete[] t;
+  delete[] e;
+  return fail;
+}
+
 /*
   Get the underlying face, edge and volume entities
 */
@@ -28,20 +28,39 @@
 */
 class TMREdgeFromCurve : public TMREdge {
  public:
-  TMREdgeFromCurve(TMRCurve *_curve) {
-    curve = _curve;
-    curve->incref();
-  }
-  ~TMREdgeFromCurve() { curve->decref(); }
-  void getRange(double *tmin, double *tmax) { curve->getRange(tmin, tmax); }
+  TMREdgeFromCurve(TMRCurve *_curve);
+  ~TMREdgeFromCurve();
+  void getRange(double *tmin, double *tmax);
   int evalPoint(double t, TMRPoint *X) { return curve->evalPoint(t, X); }
+  int evalPoints(int n, const double *t, TMRPoint *X) {
+    return curve->evalPoints(n, t, X);
+  }
   int invEvalPoint(TMRPoint p, double *t) { return curve->invEvalPoint(p, t); }
   int evalDeriv(double t, TMRPoint *X, TMRPoint *Xt) {
     return curve->evalDeriv(t, X, Xt);
   }
+  int getParamsOnFace(TMRFace *face, double t, int dir, double *u, double *v);
+
+  // Restrict the edge to a portion of the curve
+  void setRange(double _tmin, double _tmax);
+
+  // Set the parametrization of the edge on a face in the direction
+  // dir. The pcurve shares the parameter of the curve.
+  void addPcurve(TMRFace *face, int dir, TMRPcurve *pcurve);
 
  private:
   TMRCurve *curve;
+
+  // The parameter range, when set
+  int has_range;
+  double tmin, tmax;
+
+  // The pcurves on the faces. The faces are only compared and are
+  // not referenced since they own the edge.
+  int npcurves;
+  TMRFace **pcurve_faces;
+  int *pcurve_dirs;
+  TMRPcurve **pcurves;
 };
 
 /*
@@ -49,7 +68,8 @@ class TMREdgeFromCurve : public TMREdge {
 */
 class TMRFaceFromSurface : public TMRFace {
  public:
-  TMRFaceFromSurface(TMRSurface *_surf) {
+  TMRFaceFromSurface(TMRSurface *_surf, int _orientation = 1)
+      : TMRFace(_orientation) {
     surf = _surf;
     surf->incref();
   }
@@ -63,6 +83,12 @@ class TMRFaceFromSurface : public TMRFace {
   int invEvalPoint(TMRPoint p, double *u, double *v) {
     return surf->invEvalPoint(p, u, v);
   }
+  int evalPoints(int n, const double *prm, TMRPoint *X) {
+    return surf->evalPoints(n, prm, X);
+  }
+  int invEvalPoints(int n, const TMRPoint *X, double *prm) {
+    return surf->invEvalPoints(n, X, prm);
+  }
   int evalDeriv(double u, double v, TMRPoint *X, TMRPoint *Xu, TMRPoint *Xv) {
     return surf->evalDeriv(u, v, X, Xu, Xv);
   }
@@ -300,6 +326,7 @@ class TMRTFIVolume : public TMRVolume {
   void getRange(double *umin, double *vmin, double *wmin, double *umax,
                 double *vmax, double *wmax);
   int evalPoint(double u, double v, double w, TMRPoint *X);
+  int evalPoints(int n, const double *prm, TMRPoint *X);
   void getEntities(TMRFace ***_faces, TMREdge ***_edges, TMRVertex ***_verts);
 
  private:
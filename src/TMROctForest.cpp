@@ -20,7 +20,11 @@
 
 #include "TMROctForest.h"
 
+#include <pthread.h>
+
 #include "TMRInterpolation.h"
+#include "TMR_QualityTools.h"
+#include "TMR_VTKTools.h"
 #include "tmrlapack.h"
 
 /*
@@ -275,6 +279,11 @@ inline void decode_index_from_info(TMROctant *oct, int info, int *face_info,
   }
 }
 
+/*
+  The operations applied to the nodes constrained by the element orders
+*/
+enum TMROrderConstraintOp { TMR_ORDER_LABEL, TMR_ORDER_COUNT, TMR_ORDER_SET };
+
 /*
   Compare integers for sorting
 */
@@ -291,6 +300,15 @@ static int compare_octant_tags(const void *a, const void *b) {
   return A->tag - B->tag;
 }
 
+/*
+  Compare the element octants of two nodes, ignoring the node index
+*/
+static int compare_octant_nodes(const void *a, const void *b) {
+  const TMROctant *A = static_cast<const TMROctant *>(a);
+  const TMROctant *B = static_cast<const TMROctant *>(b);
+  return A->compare(B);
+}
+
 /*
   Convert from the integer coordinate system to a physical coordinate
   with the off-by-one check.
@@ -321,8 +339,18 @@ TMROctForest::TMROctForest(MPI_Comm _comm, int _mesh_order,
   MPI_Comm_rank(comm, &mpi_rank);
   MPI_Comm_size(comm, &mpi_size);
 
+  // Use a single thread by default
+  num_threads = 1;
+
+  // Cut the partition at any octant by default
+  partition_tol = 0.0;
+
   mesh_order = 2;
   interp_knots = NULL;
+  interp_tables = NULL;
+  interp_inverse = NULL;
+  interp_kernel = NULL;
+  interp_deriv_kernel = NULL;
 
   // Set the topology object to NULL to begin with
   topo = NULL;
@@ -334,7 +362,15 @@ TMROctForest::TMROctForest(MPI_Comm _comm, int _mesh_order,
   owners = NULL;
   octants = NULL;
   adjacent = NULL;
+  neighbor_ptr = NULL;
+  neighbor_list = NULL;
+  ghost_depth = 0;
+  ghosts = NULL;
+  ghost_owners = NULL;
+  ghost_layer_ptr = NULL;
   X = NULL;
+  deferred_node_locations = 0;
+  Xcomp = NULL;
 
   // Set data for the number of elements/nodes/dependents
   conn = NULL;
@@ -349,6 +385,36 @@ TMROctForest::TMROctForest(MPI_Comm _comm, int _mesh_order,
   dep_conn = NULL;
   dep_weights = NULL;
 
+  // All elements use the mesh order by default
+  elem_orders = NULL;
+
+  // No interpolation is cached by default
+  node_stamp = 0;
+  cache_interp = 0;
+  interp_cache_coarse = NULL;
+  interp_cache_stamps[0] = interp_cache_stamps[1] = 0;
+  interp_cache_nrows = 0;
+  interp_cache_max_rows = 0;
+  interp_cache_max_weights = 0;
+  interp_cache_rows = NULL;
+  interp_cache_ptr = NULL;
+  interp_cache_vars = NULL;
+  interp_cache_weights = NULL;
+
+  // Do not retain the mesh data between refinement steps by default
+  incremental_nodes = 0;
+  node_buffer = NULL;
+  shared_conn = 0;
+  prev_octants = NULL;
+  prev_conn = NULL;
+  prev_node_numbers = NULL;
+  prev_num_local_nodes = 0;
+  prev_X = NULL;
+
+  // The name index is created on demand
+  name_oct_ptr = name_oct_list = NULL;
+  name_node_ptr = name_node_list = NULL;
+
   // Set the mesh order
   setMeshOrder(_mesh_order, _interp_type);
 }
@@ -361,8 +427,13 @@ TMROctForest::~TMROctForest() {
   if (topo) {
     topo->decref();
   }
+  if (node_buffer) {
+    node_buffer->decref();
+  }
 
   freeData();
+  freeInterpTables();
+  freeInterpCache();
 }
 /*
   Free any data that has been allocated
@@ -383,9 +454,17 @@ void TMROctForest::freeData() {
   if (adjacent) {
     delete adjacent;
   }
+  if (neighbor_ptr) {
+    delete[] neighbor_ptr;
+  }
+  if (neighbor_list) {
+    delete[] neighbor_list;
+  }
+  freeGhostOctants();
   if (X) {
     delete[] X;
   }
+  freePointComponents();
 
   if (node_range) {
     delete[] node_range;
@@ -399,12 +478,16 @@ void TMROctForest::freeData() {
   if (dep_weights) {
     delete[] dep_weights;
   }
+  freeElementOrders();
 
   // Null the octant owners/octant list
   owners = NULL;
   octants = NULL;
   adjacent = NULL;
+  neighbor_ptr = NULL;
+  neighbor_list = NULL;
   X = NULL;
+  deferred_node_locations = 0;
 
   // Set data for the number of elements/nodes/dependents
   conn = NULL;
@@ -418,6 +501,12 @@ void TMROctForest::freeData() {
   dep_ptr = NULL;
   dep_conn = NULL;
   dep_weights = NULL;
+
+  // Free the mesh data retained from the previous refinement step
+  freePrevMeshData();
+
+  // Free the index of the entity names
+  freeNameIndex();
 }
 
 /*
@@ -435,15 +524,24 @@ void TMROctForest::freeMeshData(int free_octs, int free_owners) {
       delete octants;
     }
     octants = NULL;
+    freeElementOrders();
   }
 
   // Free the octants/adjacency/dependency data
   if (adjacent) {
     delete adjacent;
   }
+  if (neighbor_ptr) {
+    delete[] neighbor_ptr;
+  }
+  if (neighbor_list) {
+    delete[] neighbor_list;
+  }
+  freeGhostOctants();
   if (X) {
     delete[] X;
   }
+  freePointComponents();
 
   if (conn) {
     delete[] conn;
@@ -466,7 +564,10 @@ void TMROctForest::freeMeshData(int free_octs, int free_owners) {
 
   // Null the octant owners/octant list
   adjacent = NULL;
+  neighbor_ptr = NULL;
+  neighbor_list = NULL;
   X = NULL;
+  deferred_node_locations = 0;
 
   // Set data for the number of elements/nodes/dependents
   conn = NULL;
@@ -480,6 +581,53 @@ void TMROctForest::freeMeshData(int free_octs, int free_owners) {
   dep_ptr = NULL;
   dep_conn = NULL;
   dep_weights = NULL;
+
+  // The name index refers to the octants and nodes
+  freeNameIndex();
+}
+
+/*
+  Free the index from the entity names to the octants and nodes
+*/
+void TMROctForest::freeNameIndex() {
+  if (name_oct_ptr) {
+    delete[] name_oct_ptr;
+  }
+  if (name_oct_list) {
+    delete[] name_oct_list;
+  }
+  if (name_node_ptr) {
+    delete[] name_node_ptr;
+  }
+  if (name_node_list) {
+    delete[] name_node_list;
+  }
+  name_oct_ptr = name_oct_list = NULL;
+  name_node_ptr = name_node_list = NULL;
+}
+
+/*
+  Free the octants, connectivity and node locations retained from
+  before the last call to refine()
+*/
+void TMROctForest::freePrevMeshData() {
+  if (prev_octants) {
+    delete prev_octants;
+  }
+  if (prev_conn) {
+    delete[] prev_conn;
+  }
+  if (prev_node_numbers) {
+    delete[] prev_node_numbers;
+  }
+  if (prev_X) {
+    delete[] prev_X;
+  }
+  prev_octants = NULL;
+  prev_conn = NULL;
+  prev_node_numbers = NULL;
+  prev_num_local_nodes = 0;
+  prev_X = NULL;
 }
 
 /*
@@ -497,6 +645,54 @@ void TMROctForest::copyData(TMROctForest *copy) {
   if (copy->topo) {
     copy->topo->incref();
   }
+
+  // Copy the number of threads
+  copy->num_threads = num_threads;
+  copy->partition_tol = partition_tol;
+  copy->incremental_nodes = incremental_nodes;
+
+  // Share the node-local buffer
+  if (node_buffer) {
+    node_buffer->incref();
+  }
+  if (copy->node_buffer) {
+    copy->node_buffer->decref();
+  }
+  copy->node_buffer = node_buffer;
+  copy->shared_conn = shared_conn;
+  copy->cache_interp = cache_interp;
+}
+
+/*
+  Set a new communicator for the forest
+
+  The new communicator must contain the same processors in the same
+  order as the current communicator, for instance a duplicate of it.
+  This is used to perform the collective operations for a forest on a
+  separate thread with a communicator that is not used by the other
+  threads, and to return the forest to the original communicator
+  afterwards. When the octants are exchanged through shared memory,
+  this call is collective on the new communicator.
+*/
+int TMROctForest::setMPIComm(MPI_Comm _comm) {
+  int result = MPI_UNEQUAL;
+  MPI_Comm_compare(comm, _comm, &result);
+  if (result != MPI_IDENT && result != MPI_CONGRUENT) {
+    fprintf(stderr,
+            "TMROctForest Error: The new communicator must contain the "
+            "same processors in the same order\n");
+    return 1;
+  }
+
+  comm = _comm;
+  if (node_buffer) {
+    // Create the node-local buffer for the new communicator
+    node_buffer->decref();
+    node_buffer = new TMRNodeSharedBuffer(comm);
+    node_buffer->incref();
+  }
+
+  return 0;
 }
 
 /*
@@ -554,9 +750,14 @@ TMRTopology *TMROctForest::getTopology() { return topo; }
 
   This information is required for creating octree forests on the
   unstructured super mesh.
+
+  The locations of the nodes may optionally be provided. When no
+  topology is set, the node locations within each block are then
+  computed by trilinear interpolation of the block corner locations.
 */
 void TMROctForest::setConnectivity(int _num_nodes, const int *_block_conn,
-                                   int _num_blocks) {
+                                   int _num_blocks,
+                                   const TMRPoint *_node_pts) {
   // Free any data if it has already been allocated.
   freeData();
 
@@ -570,34 +771,51 @@ void TMROctForest::setConnectivity(int _num_nodes, const int *_block_conn,
   bdata->num_faces = 0;
   bdata->num_blocks = _num_blocks;
 
-  // Copy over the block connectivity
-  bdata->block_conn = new int[8 * _num_blocks];
-  memcpy(bdata->block_conn, _block_conn, 8 * _num_blocks * sizeof(int));
+  // When the connectivity is shared, only the root processor on each
+  // node computes it
+  initSharedBlockConn();
+
+  if (bdata->node_rank == 0) {
+    // Copy over the block connectivity
+    bdata->block_conn = new int[8 * _num_blocks];
+    memcpy(bdata->block_conn, _block_conn, 8 * _num_blocks * sizeof(int));
+
+    // Compute the node to block information
+    computeNodesToBlocks();
+
+    // Compute the edge connectivity from the block data
+    computeEdgesFromNodes();
+    computeEdgesToBlocks();
 
-  // Compute the node to block information
-  computeNodesToBlocks();
+    // Compute the face connectivity from the block data
+    computeFacesFromNodes();
+    computeFacesToBlocks();
 
-  // Compute the edge connectivity from the block data
-  computeEdgesFromNodes();
-  computeEdgesToBlocks();
+    // Compute the block owners based on the node, edge and face data
+    computeBlockOwners();
 
-  // Compute the face connectivity from the block data
-  computeFacesFromNodes();
-  computeFacesToBlocks();
+    // Copy over the node locations
+    if (_node_pts) {
+      bdata->node_pts = new TMRPoint[_num_nodes];
+      memcpy(bdata->node_pts, _node_pts, _num_nodes * sizeof(TMRPoint));
+    }
+  }
 
-  // Compute the block owners based on the node, edge and face data
-  computeBlockOwners();
+  // Copy the connectivity to the other processors on the node
+  shareBlockConn(_node_pts != NULL);
 }
 
 /*
   Set the full connectivity, specifying the node, edge, face and block
-  numbers independently.
+  numbers independently. The node locations are optional (see
+  setConnectivity()).
 */
 void TMROctForest::setFullConnectivity(int _num_nodes, int _num_edges,
                                        int _num_faces, int _num_blocks,
                                        const int *_block_conn,
                                        const int *_block_edge_conn,
-                                       const int *_block_face_conn) {
+                                       const int *_block_face_conn,
+                                       const TMRPoint *_node_pts) {
   // Free any data allocated for other connectivities
   freeData();
 
@@ -611,31 +829,167 @@ void TMROctForest::setFullConnectivity(int _num_nodes, int _num_edges,
   bdata->num_faces = _num_faces;
   bdata->num_blocks = _num_blocks;
 
-  // Copy over the block connectivity
-  bdata->block_conn = new int[8 * _num_blocks];
-  memcpy(bdata->block_conn, _block_conn, 8 * _num_blocks * sizeof(int));
+  // When the connectivity is shared, only the root processor on each
+  // node computes it
+  initSharedBlockConn();
+
+  if (bdata->node_rank == 0) {
+    // Copy over the block connectivity
+    bdata->block_conn = new int[8 * _num_blocks];
+    memcpy(bdata->block_conn, _block_conn, 8 * _num_blocks * sizeof(int));
+
+    // Compute the node to block information
+    computeNodesToBlocks();
+
+    // Copy over the edge information
+    bdata->block_edge_conn = new int[12 * _num_blocks];
+    memcpy(bdata->block_edge_conn, _block_edge_conn,
+           12 * _num_blocks * sizeof(int));
+
+    // Compute the edge to block information
+    computeEdgesToBlocks();
+
+    // Compute the face connectivity from the block data
+    bdata->block_face_conn = new int[6 * _num_blocks];
+    memcpy(bdata->block_face_conn, _block_face_conn,
+           6 * _num_blocks * sizeof(int));
+
+    // Compute the face to block information
+    computeFacesToBlocks();
 
-  // Compute the node to block information
-  computeNodesToBlocks();
+    // Compute the block owners based on the node, edge and face data
+    computeBlockOwners();
 
-  // Copy over the edge information
-  bdata->block_edge_conn = new int[12 * _num_blocks];
-  memcpy(bdata->block_edge_conn, _block_edge_conn,
-         12 * _num_blocks * sizeof(int));
+    // Copy over the node locations
+    if (_node_pts) {
+      bdata->node_pts = new TMRPoint[_num_nodes];
+      memcpy(bdata->node_pts, _node_pts, _num_nodes * sizeof(TMRPoint));
+    }
+  }
+
+  // Copy the connectivity to the other processors on the node
+  shareBlockConn(_node_pts != NULL);
+}
+
+/*
+  Create the node communicator for the block connectivity
+
+  When the connectivity is shared, the processors on the same node
+  are grouped together. Only the processor with rank zero on the
+  node computes the connectivity, which is then copied into the
+  shared window by shareBlockConn().
+*/
+void TMROctForest::initSharedBlockConn() {
+#if MPI_VERSION >= 3
+  if (shared_conn) {
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, mpi_rank, MPI_INFO_NULL,
+                        &bdata->node_comm);
+    MPI_Comm_rank(bdata->node_comm, &bdata->node_rank);
+  }
+#endif  // MPI_VERSION >= 3
+}
+
+/*
+  Copy the block connectivity into a node-local shared window
 
-  // Compute the edge to block information
-  computeEdgesToBlocks();
+  The root processor on the node allocates a window large enough for
+  all the connectivity arrays, copies its private arrays into the
+  window and frees them. The other processors on the node then set
+  their pointers into the window. The arrays are never modified
+  after this point, so no further synchronization is required.
+*/
+void TMROctForest::shareBlockConn(int has_node_pts) {
+#if MPI_VERSION >= 3
+  if (bdata->node_comm == MPI_COMM_NULL) {
+    return;
+  }
 
-  // Compute the face connectivity from the block data
-  bdata->block_face_conn = new int[6 * _num_blocks];
-  memcpy(bdata->block_face_conn, _block_face_conn,
-         6 * _num_blocks * sizeof(int));
+  // The number of edges and faces are only known on the root
+  int counts[2];
+  counts[0] = bdata->num_edges;
+  counts[1] = bdata->num_faces;
+  MPI_Bcast(counts, 2, MPI_INT, 0, bdata->node_comm);
+  bdata->num_edges = counts[0];
+  bdata->num_faces = counts[1];
 
-  // Compute the face to block information
-  computeFacesToBlocks();
+  const int num_blocks = bdata->num_blocks;
+  const int num_nodes = bdata->num_nodes;
+  const int num_edges = bdata->num_edges;
+  const int num_faces = bdata->num_faces;
 
-  // Compute the block owners based on the node, edge and face data
-  computeBlockOwners();
+  // The pointers to each array and their lengths. The node locations
+  // are placed first so that they are aligned.
+  const int num_arrays = 13;
+  int **arrays[num_arrays] = {
+      &bdata->block_conn,        &bdata->block_edge_conn,
+      &bdata->block_face_conn,   &bdata->block_face_ids,
+      &bdata->node_block_ptr,    &bdata->node_block_conn,
+      &bdata->edge_block_ptr,    &bdata->edge_block_conn,
+      &bdata->face_block_ptr,    &bdata->face_block_conn,
+      &bdata->node_block_owners, &bdata->edge_block_owners,
+      &bdata->face_block_owners};
+  size_t lengths[num_arrays] = {
+      8 * (size_t)num_blocks,  12 * (size_t)num_blocks,
+      6 * (size_t)num_blocks,  6 * (size_t)num_blocks,
+      (size_t)num_nodes + 1,   8 * (size_t)num_blocks,
+      (size_t)num_edges + 1,   12 * (size_t)num_blocks,
+      (size_t)num_faces + 1,   6 * (size_t)num_blocks,
+      (size_t)num_nodes,       (size_t)num_edges,
+      (size_t)num_faces};
+
+  size_t pts_size = 0;
+  if (has_node_pts) {
+    pts_size = num_nodes * sizeof(TMRPoint);
+  }
+  size_t size = pts_size;
+  for (int k = 0; k < num_arrays; k++) {
+    size += lengths[k] * sizeof(int);
+  }
+
+  // Allocate the window on the root processor only
+  char *base = NULL;
+  MPI_Aint win_size = (bdata->node_rank == 0 ? size : 0);
+  MPI_Win_allocate_shared(win_size, 1, MPI_INFO_NULL, bdata->node_comm,
+                          &base, &bdata->shared_win);
+
+  MPI_Aint len;
+  int disp_unit;
+  MPI_Win_shared_query(bdata->shared_win, 0, &len, &disp_unit, &base);
+
+  MPI_Win_lock_all(MPI_MODE_NOCHECK, bdata->shared_win);
+  if (bdata->node_rank == 0) {
+    // Copy the private arrays into the window and free them
+    char *ptr = base;
+    if (has_node_pts) {
+      memcpy(ptr, bdata->node_pts, pts_size);
+      delete[] bdata->node_pts;
+      ptr += pts_size;
+    }
+    for (int k = 0; k < num_arrays; k++) {
+      int *array = *arrays[k];
+      memcpy(ptr, array, lengths[k] * sizeof(int));
+      delete[] array;
+      ptr += lengths[k] * sizeof(int);
+    }
+  }
+
+  // Make the copied data visible on all the processors on the node
+  MPI_Win_sync(bdata->shared_win);
+  MPI_Barrier(bdata->node_comm);
+  MPI_Win_sync(bdata->shared_win);
+  MPI_Win_unlock_all(bdata->shared_win);
+
+  // Set the pointers into the window
+  char *ptr = base;
+  if (has_node_pts) {
+    bdata->node_pts = (TMRPoint *)ptr;
+    ptr += pts_size;
+  }
+  for (int k = 0; k < num_arrays; k++) {
+    *arrays[k] = (int *)ptr;
+    ptr += lengths[k] * sizeof(int);
+  }
+#endif  // MPI_VERSION >= 3
 }
 
 /*
@@ -1383,6 +1737,466 @@ void TMROctForest::writeForestToVTK(const char *filename) {
   }
 }
 
+/*
+  Write the entire forest to a single binary VTK XML file
+
+  This is a collective call. All processors write their octants to a
+  shared file so that the output does not depend on the number of
+  processors.
+*/
+int TMROctForest::writeForestToVTU(const char *filename, int use_float32) {
+  if (!topo) {
+    return 1;
+  }
+
+  // Get the octants
+  int size = 0;
+  TMROctant *octs = NULL;
+  if (octants) {
+    octants->getArray(&octs, &size);
+  }
+
+  // Set the edge length
+  const int32_t hmax = 1 << TMR_MAX_LEVEL;
+
+  // Evaluate the corner points of each octant
+  TMRPoint *X = new TMRPoint[8 * size];
+  for (int k = 0; k < size; k++) {
+    const int32_t h = 1 << (TMR_MAX_LEVEL - octs[k].level);
+
+    // Get the volume object and evaluate the point
+    TMRVolume *vol;
+    topo->getVolume(octs[k].block, &vol);
+
+    for (int kk = 0; kk < 2; kk++) {
+      for (int jj = 0; jj < 2; jj++) {
+        for (int ii = 0; ii < 2; ii++) {
+          double u = 1.0 * (octs[k].x + ii * h) / hmax;
+          double v = 1.0 * (octs[k].y + jj * h) / hmax;
+          double w = 1.0 * (octs[k].z + kk * h) / hmax;
+          vol->evalPoint(u, v, w, &X[8 * k + ii + 2 * jj + 4 * kk]);
+        }
+      }
+    }
+  }
+
+  // Set the connectivity in the VTK ordering
+  const int vtk_order[8] = {0, 1, 3, 2, 4, 5, 7, 6};
+  int *ptr = new int[size + 1];
+  int *conn = new int[8 * size];
+  int *types = new int[size];
+  for (int k = 0; k < size; k++) {
+    ptr[k] = 8 * k;
+    for (int j = 0; j < 8; j++) {
+      conn[8 * k + j] = 8 * k + vtk_order[j];
+    }
+    types[k] = TMR_VTK_HEXAHEDRON;
+  }
+  ptr[size] = 8 * size;
+
+  // Set the block index, refinement level and processor rank
+  const char *names[3] = {"entity_index", "level", "rank"};
+  double *data = new double[3 * size];
+  for (int k = 0; k < size; k++) {
+    data[k] = octs[k].block;
+    data[size + k] = octs[k].level;
+    data[2 * size + k] = mpi_rank;
+  }
+
+  int fail = TMR_WriteVTUFile(comm, filename, 8 * size, X, size, ptr, conn,
+                              types, 3, names, data, use_float32);
+
+  delete[] X;
+  delete[] ptr;
+  delete[] conn;
+  delete[] types;
+  delete[] data;
+
+  return fail;
+}
+
+/*
+  Compute histograms of the quality of the elements in the forest
+
+  The metrics are evaluated from the element corners (see
+  TMR_QualityTools.h) in a single pass over the local elements split
+  between the threads. The histograms are summed across all
+  processors, so this call is collective. The nodes must be created
+  before this call.
+
+  input:
+  nbins:        the number of bins in each histogram
+
+  output:
+  hist:         the histograms of the metrics (TMR_NUM_QUALITY_METRICS*nbins)
+  min_quality:  the minimum value of each metric (may be NULL)
+
+  returns:      the number of elements in the forest
+*/
+int TMROctForest::computeMeshQuality(int nbins, int hist[],
+                                     double min_quality[]) {
+  int num_elements = 0;
+  octants->getArray(NULL, &num_elements);
+  evaluateDeferredNodeLocations();
+  if (!conn || !X) {
+    fprintf(stderr,
+            "TMROctForest Error: Cannot compute the mesh quality before "
+            "the nodes and their locations are created\n");
+    num_elements = 0;
+  }
+
+  // The offsets of the element corners in the VTK order
+  const int m = mesh_order - 1;
+  const int m2 = mesh_order * mesh_order;
+  const int corner_offset[8] = {0,
+                                m,
+                                m + m * mesh_order,
+                                m * mesh_order,
+                                m * m2,
+                                m + m * m2,
+                                m + m * mesh_order + m * m2,
+                                m * mesh_order + m * m2};
+  const int num_corners = 8;
+  const int conn_stride = mesh_order * mesh_order * mesh_order;
+
+  return TMR_ComputeMeshQuality(comm, num_threads, num_elements, num_corners,
+                                conn, conn_stride, corner_offset,
+                                num_local_nodes, node_numbers, X, nbins, hist,
+                                min_quality);
+}
+
+/*
+  Write the forest to a binary checkpoint file
+
+  The file contains a fixed-size header, the block connectivity and
+  the octants in their global order. The octants from each processor
+  are written at offsets computed from the number of octants on the
+  preceding processors, using collective MPI-IO. The node numbers are
+  not stored since they are recomputed by createNodes().
+
+  Note that the data is written in the native byte order.
+*/
+int TMROctForest::writeForestToFile(const char *filename) {
+  if (!bdata) {
+    return 1;
+  }
+
+  const int num_blocks = bdata->num_blocks;
+
+  // Get the octants
+  int size = 0;
+  TMROctant *array = NULL;
+  if (octants) {
+    octants->getArray(&array, &size);
+  }
+
+  // Compute the offset for the local octants
+  int64_t local_size = size, oct_offset = 0, num_octs = 0;
+  MPI_Exscan(&local_size, &oct_offset, 1, MPI_INT64_T, MPI_SUM, comm);
+  if (mpi_rank == 0) {
+    oct_offset = 0;
+  }
+  MPI_Allreduce(&local_size, &num_octs, 1, MPI_INT64_T, MPI_SUM, comm);
+
+  // Set the header information
+  char header[TMR_FOREST_FILE_HEADER_SIZE];
+  memset(header, 0, sizeof(header));
+  memcpy(header, "TMROCTF", 8);
+  int32_t info[8];
+  info[0] = TMR_FOREST_FILE_VERSION;
+  info[1] = sizeof(TMROctant);
+  info[2] = mesh_order;
+  info[3] = interp_type;
+  info[4] = bdata->num_nodes;
+  info[5] = bdata->num_edges;
+  info[6] = bdata->num_faces;
+  info[7] = num_blocks;
+  memcpy(&header[8], info, sizeof(info));
+  memcpy(&header[8 + sizeof(info)], &num_octs, sizeof(int64_t));
+
+  // Compute the location of the octants within the file
+  MPI_Offset conn_size = 26 * num_blocks * sizeof(int);
+  MPI_Offset data_start = TMR_FOREST_FILE_HEADER_SIZE + conn_size;
+
+  char *fname = new char[strlen(filename) + 1];
+  strcpy(fname, filename);
+
+  MPI_File fp;
+  int fail = MPI_File_open(comm, fname, MPI_MODE_WRONLY | MPI_MODE_CREATE,
+                           MPI_INFO_NULL, &fp);
+  if (fail == MPI_SUCCESS) {
+    MPI_File_set_size(fp, data_start + num_octs * sizeof(TMROctant));
+
+    if (mpi_rank == 0) {
+      MPI_Offset offset = 0;
+      MPI_File_write_at(fp, offset, header, TMR_FOREST_FILE_HEADER_SIZE,
+                        MPI_CHAR, MPI_STATUS_IGNORE);
+      offset += TMR_FOREST_FILE_HEADER_SIZE;
+      MPI_File_write_at(fp, offset, bdata->block_conn, 8 * num_blocks,
+                        MPI_INT, MPI_STATUS_IGNORE);
+      offset += 8 * num_blocks * sizeof(int);
+      MPI_File_write_at(fp, offset, bdata->block_edge_conn, 12 * num_blocks,
+                        MPI_INT, MPI_STATUS_IGNORE);
+      offset += 12 * num_blocks * sizeof(int);
+      MPI_File_write_at(fp, offset, bdata->block_face_conn, 6 * num_blocks,
+                        MPI_INT, MPI_STATUS_IGNORE);
+    }
+
+    MPI_File_write_at_all(fp, data_start + oct_offset * sizeof(TMROctant),
+                          array, size, TMROctant_MPI_type, MPI_STATUS_IGNORE);
+    MPI_File_close(&fp);
+  }
+
+  delete[] fname;
+
+  return (fail != MPI_SUCCESS);
+}
+
+/*
+  Read the forest from a binary checkpoint file written by
+  writeForestToFile()
+
+  The file may be read on a different number of processors than it
+  was written on. The octants are split evenly between processors in
+  their global order, so repartition() may be called afterwards when
+  a weighted partition is required.
+
+  If the connectivity has already been set (for instance through
+  setTopology()), it must match the connectivity stored in the file.
+  Otherwise, the connectivity is set from the file. The mesh order and
+  interpolation type are restored from the file. The nodes must be
+  re-created by calling createNodes().
+*/
+int TMROctForest::readForestFromFile(const char *filename) {
+  char *fname = new char[strlen(filename) + 1];
+  strcpy(fname, filename);
+
+  MPI_File fp;
+  int open_fail =
+      MPI_File_open(comm, fname, MPI_MODE_RDONLY, MPI_INFO_NULL, &fp);
+  delete[] fname;
+  if (open_fail != MPI_SUCCESS) {
+    return 1;
+  }
+
+  // Read in the header on all processors
+  char header[TMR_FOREST_FILE_HEADER_SIZE];
+  MPI_File_read_at_all(fp, 0, header, TMR_FOREST_FILE_HEADER_SIZE, MPI_CHAR,
+                       MPI_STATUS_IGNORE);
+  int32_t info[8];
+  int64_t num_octs = 0;
+  memcpy(info, &header[8], sizeof(info));
+  memcpy(&num_octs, &header[8 + sizeof(info)], sizeof(int64_t));
+
+  if (strncmp(header, "TMROCTF", 8) != 0 ||
+      info[0] != TMR_FOREST_FILE_VERSION || info[1] != sizeof(TMROctant)) {
+    MPI_File_close(&fp);
+    return 1;
+  }
+
+  // Read in the block connectivity
+  const int num_blocks = info[7];
+  int *block_conn = new int[26 * num_blocks];
+  MPI_File_read_at_all(fp, TMR_FOREST_FILE_HEADER_SIZE, block_conn,
+                       26 * num_blocks, MPI_INT, MPI_STATUS_IGNORE);
+  const int *block_edge_conn = &block_conn[8 * num_blocks];
+  const int *block_face_conn = &block_conn[20 * num_blocks];
+
+  int fail = 0;
+  if (bdata) {
+    // Check that the connectivity matches
+    if (bdata->num_blocks != num_blocks || bdata->num_nodes != info[4] ||
+        memcmp(bdata->block_conn, block_conn, 8 * num_blocks * sizeof(int))) {
+      fail = 1;
+    }
+  } else {
+    setFullConnectivity(info[4], info[5], info[6], num_blocks, block_conn,
+                        block_edge_conn, block_face_conn);
+  }
+  delete[] block_conn;
+
+  if (fail) {
+    MPI_File_close(&fp);
+    return fail;
+  }
+
+  // Restore the mesh order and free the existing mesh data
+  if (info[2] != mesh_order || info[3] != interp_type) {
+    setMeshOrder(info[2], (TMRInterpolationType)info[3]);
+  }
+  freeMeshData();
+  freePrevMeshData();
+
+  // Read in an even share of the octants
+  int64_t start = (mpi_rank * num_octs) / mpi_size;
+  int64_t end = ((mpi_rank + 1) * num_octs) / mpi_size;
+  int size = end - start;
+  TMROctant *array = new TMROctant[size];
+
+  MPI_Offset data_start =
+      TMR_FOREST_FILE_HEADER_SIZE + 26 * num_blocks * sizeof(int);
+  MPI_File_read_at_all(fp, data_start + start * sizeof(TMROctant), array,
+                       size, TMROctant_MPI_type, MPI_STATUS_IGNORE);
+  MPI_File_close(&fp);
+
+  // Set the local ordering for the elements
+  for (int i = 0; i < size; i++) {
+    array[i].tag = i;
+  }
+
+  // Set the last octant
+  TMROctant p;
+  p.block = num_blocks - 1;
+  p.tag = -1;
+  p.level = 0;
+  p.info = 0;
+  p.x = p.y = p.z = 1 << TMR_MAX_LEVEL;
+  if (size > 0) {
+    p = array[0];
+  }
+
+  octants = new TMROctantArray(array, size);
+
+  owners = new TMROctant[mpi_size];
+  MPI_Allgather(&p, 1, TMROctant_MPI_type, owners, 1, TMROctant_MPI_type, comm);
+
+  // Set the offsets if some of the processors have zero octants. The
+  // even split may leave empty processors anywhere in the order, so
+  // each one takes the first octant of the next processor and owns an
+  // empty interval. Trailing empty processors keep the last octant.
+  for (int k = mpi_size - 2; k >= 0; k--) {
+    if (owners[k].tag == -1) {
+      owners[k] = owners[k + 1];
+    }
+  }
+
+  return 0;
+}
+
+/*
+  Get the memory (in bytes) allocated for the data stored by the forest
+
+  This includes the octants, the node numbers, connectivity, dependent
+  node data and node locations, the data retained for incremental node
+  creation and the interpolation cache. The block connectivity and the
+  topology are shared between forests and are not counted.
+*/
+void TMROctForest::getMemoryUsage(TMRMemoryUsage *usage) {
+  usage->zero();
+
+  // Compute the memory for the octants and neighbor lists
+  int num_elements = 0;
+  if (octants) {
+    octants->getArray(NULL, &num_elements);
+    usage->octants += octants->getMemoryUsage();
+  }
+  if (adjacent) {
+    usage->octants += adjacent->getMemoryUsage();
+  }
+  if (prev_octants) {
+    usage->octants += prev_octants->getMemoryUsage();
+  }
+  if (owners) {
+    usage->octants += mpi_size * sizeof(TMROctant);
+  }
+  if (neighbor_ptr) {
+    usage->octants += (26 * num_elements + 1) * sizeof(int);
+    usage->octants += neighbor_ptr[26 * num_elements] * sizeof(int);
+  }
+  if (ghosts) {
+    int num_ghosts = ghost_layer_ptr[ghost_depth];
+    usage->octants += ghosts->getMemoryUsage();
+    usage->octants += num_ghosts * sizeof(int);
+    usage->octants += (ghost_depth + 1) * sizeof(int);
+  }
+
+  // Compute the memory for the nodes and connectivity
+  const int nodes_per_elem = mesh_order * mesh_order * mesh_order;
+  if (node_numbers) {
+    usage->nodes += num_local_nodes * sizeof(int);
+  }
+  if (node_range) {
+    usage->nodes += (mpi_size + 1) * sizeof(int);
+  }
+  if (prev_node_numbers) {
+    usage->nodes += prev_num_local_nodes * sizeof(int);
+  }
+  if (conn) {
+    usage->conn += nodes_per_elem * num_elements * sizeof(int);
+  }
+  if (prev_conn && prev_octants) {
+    int prev_size;
+    prev_octants->getArray(NULL, &prev_size);
+    usage->conn += nodes_per_elem * prev_size * sizeof(int);
+  }
+
+  // Compute the memory for the dependent nodes
+  if (dep_ptr) {
+    usage->dep_nodes += (num_dep_nodes + 1) * sizeof(int);
+    usage->dep_nodes +=
+        dep_ptr[num_dep_nodes] * (sizeof(int) + sizeof(double));
+  }
+
+  // Compute the memory for the node locations
+  if (X) {
+    usage->points += num_local_nodes * sizeof(TMRPoint);
+  }
+  if (Xcomp) {
+    int stride = POINT_COMPONENT_ALIGNMENT / sizeof(double);
+    stride *= (num_local_nodes + stride - 1) / stride;
+    usage->points += 3 * stride * sizeof(double);
+  }
+  if (prev_X) {
+    usage->points += prev_num_local_nodes * sizeof(TMRPoint);
+  }
+
+  // Compute the memory for the interpolation cache and name index
+  if (interp_cache_rows) {
+    usage->other += (2 * interp_cache_max_rows + 1) * sizeof(int);
+    usage->other +=
+        interp_cache_max_weights * (sizeof(int) + sizeof(double));
+  }
+  if (name_oct_ptr) {
+    usage->other += (bdata->num_names + 1) * sizeof(int);
+    usage->other += 2 * name_oct_ptr[bdata->num_names] * sizeof(int);
+  }
+  if (name_node_ptr) {
+    usage->other += (bdata->num_names + 1) * sizeof(int);
+    usage->other += name_node_ptr[bdata->num_names] * sizeof(int);
+  }
+}
+
+/*
+  Get the high-water mark of the memory used by the forest
+
+  The high-water mark is the memory usage, including the transient
+  hash tables and node arrays, at the point where the total was
+  largest during the calls to balance() and createNodes().
+*/
+void TMROctForest::getMaxMemoryUsage(TMRMemoryUsage *usage) {
+  *usage = max_mem_usage;
+}
+
+/*
+  Reset the memory high-water mark
+*/
+void TMROctForest::resetMaxMemoryUsage() { max_mem_usage.zero(); }
+
+/*
+  Update the high-water mark with the current memory usage plus the
+  size of the transient hash tables and node arrays
+*/
+void TMROctForest::updateMaxMemoryUsage(long int hash_size,
+                                        long int node_size) {
+  TMRMemoryUsage usage;
+  getMemoryUsage(&usage);
+  usage.hash += hash_size;
+  usage.nodes += node_size;
+  if (usage.getTotal() > max_mem_usage.getTotal()) {
+    max_mem_usage = usage;
+  }
+}
+
 /*
   Free the mesh element data if it exists
 */
@@ -1391,11 +2205,13 @@ void TMROctForest::setMeshOrder(int _mesh_order,
   // Don't free the octants/owner information if it exists,
   // but free the connectivity and node data
   freeMeshData(0, 0);
+  freePrevMeshData();
 
-  // Free the interpolation knots
+  // Free the interpolation knots and any tabulated shape functions
   if (interp_knots) {
     delete[] interp_knots;
   }
+  freeInterpTables();
 
   // Check that the order falls within allowable bounds
   mesh_order = _mesh_order;
@@ -1424,6 +2240,14 @@ void TMROctForest::setMeshOrder(int _mesh_order,
       interp_knots[i] = -1.0 + 2.0 * i / (mesh_order - 1);
     }
   }
+
+  // Select the interpolation kernels once for this order and type
+  lagrange_weights(mesh_order, interp_knots, interp_weights);
+  TMRInterpKernel kernel2d;
+  TMRInterpDerivKernel2D deriv_kernel2d;
+  get_tensor_interp_kernels(mesh_order, interp_type, &kernel2d,
+                            &deriv_kernel2d, &interp_kernel,
+                            &interp_deriv_kernel);
 }
 
 /*
@@ -1437,23 +2261,102 @@ int TMROctForest::getMeshOrder() { return mesh_order; }
 TMRInterpolationType TMROctForest::getInterpType() { return interp_type; }
 
 /*
-  Get the node-processor ownership range
-*/
-int TMROctForest::getOwnedNodeRange(const int **_node_range) {
-  if (_node_range) {
-    *_node_range = node_range;
-  }
-  return mpi_size;
-}
+  Set the order of each of the local elements
 
-/*
-  Get the octants and the nodes
-*/
-void TMROctForest::getOctants(TMROctantArray **_octants) {
-  if (_octants) {
-    *_octants = octants;
-  }
-}
+  The element orders must lie between 2 and the mesh order. The nodes
+  are still created with the mesh order, but the nodes of an element
+  with a lower order are constrained so that the solution within the
+  element is a polynomial of the lower order. The order of each edge
+  and face is the minimum order of the elements that share it, so
+  that the solution remains continuous between elements of different
+  order. These constraints are added to the dependent nodes in the
+  same manner as the constraints at the transitions between levels.
+
+  The orders are discarded when the octants are changed by refine(),
+  balance() or repartition(). Passing NULL resets all elements to the
+  mesh order. Element orders are not supported with Bernstein points.
+
+  input:
+  orders:  the order of each local element (or NULL)
+*/
+void TMROctForest::setElementOrders(const int orders[]) {
+  if (!octants) {
+    fprintf(stderr,
+            "TMROctForest Error: Cannot call setElementOrders(), "
+            "no octants have been created\n");
+    return;
+  }
+  if (orders && interp_type == TMR_BERNSTEIN_POINTS) {
+    fprintf(stderr,
+            "TMROctForest Error: Element orders are not supported "
+            "with Bernstein points\n");
+    return;
+  }
+
+  // The nodes must be created again with the new orders
+  freeMeshData(0, 0);
+  freePrevMeshData();
+  freeElementOrders();
+
+  if (orders) {
+    int num_elements;
+    octants->getArray(NULL, &num_elements);
+    elem_orders = new int[num_elements];
+    for (int i = 0; i < num_elements; i++) {
+      elem_orders[i] = orders[i];
+      if (elem_orders[i] < 2) {
+        elem_orders[i] = 2;
+      }
+    }
+  }
+}
+
+/*
+  Retrieve the order of each of the local elements
+
+  This returns NULL when the element orders are not set, in which case
+  all elements use the mesh order. Orders that exceed the mesh order
+  are treated as the mesh order.
+*/
+int TMROctForest::getElementOrders(const int **_orders) {
+  int num_elements = 0;
+  if (octants) {
+    octants->getArray(NULL, &num_elements);
+  }
+  if (_orders) {
+    *_orders = elem_orders;
+  }
+  return num_elements;
+}
+
+/*
+  Free the element orders
+*/
+void TMROctForest::freeElementOrders() {
+  if (elem_orders) {
+    delete[] elem_orders;
+  }
+  elem_orders = NULL;
+}
+
+/*
+  Get the node-processor ownership range
+*/
+int TMROctForest::getOwnedNodeRange(const int **_node_range) {
+  if (_node_range) {
+    *_node_range = node_range;
+  }
+  return mpi_size;
+}
+
+/*
+  Get the octants and the nodes
+*/
+void TMROctForest::getOctants(TMROctantArray **_octants) {
+  if (_octants) {
+    *_octants = octants;
+  }
+}
 
 /*
   Get the node numbers (note that this may be NULL)
@@ -1470,16 +2373,118 @@ int TMROctForest::getNodeNumbers(const int **_node_numbers) {
 */
 int TMROctForest::getExtPreOffset() { return ext_pre_offset; }
 
+/*
+  Evaluate the node locations if their evaluation has been deferred
+
+  createNodes() only creates the node numbering and the connectivity.
+  The node locations, which may require many geometry evaluations, are
+  computed on the first request so that forests that only use the
+  connectivity never evaluate them. This is not a collective call.
+*/
+void TMROctForest::evaluateDeferredNodeLocations() {
+  if (deferred_node_locations) {
+    deferred_node_locations = 0;
+    evaluateNodeLocations();
+    updateMaxMemoryUsage();
+
+    // The retained data is only valid for the first evaluation after
+    // refine()
+    freePrevMeshData();
+  }
+}
+
 /*
   Get the node locations
+
+  The locations are evaluated on the first call after createNodes()
 */
 int TMROctForest::getPoints(TMRPoint **_X) {
   if (_X) {
+    evaluateDeferredNodeLocations();
     *_X = X;
   }
   return num_local_nodes;
 }
 
+/*
+  Get the node locations as separate x, y and z component arrays
+
+  Each array is aligned and padded to POINT_COMPONENT_ALIGNMENT bytes
+  so that kernels can stream the coordinates with unit stride. The
+  components are copied from the node locations on the first call
+  after the nodes are created, and are freed with the nodes. Changes
+  made directly to the array from getPoints() are not reflected.
+*/
+int TMROctForest::getPointComponents(const double **_x, const double **_y,
+                                     const double **_z) {
+  evaluateDeferredNodeLocations();
+
+  int stride = POINT_COMPONENT_ALIGNMENT / sizeof(double);
+  stride *= (num_local_nodes + stride - 1) / stride;
+
+  if (X && !Xcomp && stride > 0) {
+    void *ptr = NULL;
+    if (posix_memalign(&ptr, POINT_COMPONENT_ALIGNMENT,
+                       3 * stride * sizeof(double)) == 0) {
+      Xcomp = (double *)ptr;
+    } else {
+      fprintf(stderr,
+              "TMROctForest Error: Unable to allocate the node components\n");
+    }
+    if (Xcomp) {
+      double *x = Xcomp, *y = &Xcomp[stride], *z = &Xcomp[2 * stride];
+      for (int i = 0; i < num_local_nodes; i++) {
+        x[i] = X[i].x;
+        y[i] = X[i].y;
+        z[i] = X[i].z;
+      }
+      for (int i = num_local_nodes; i < stride; i++) {
+        x[i] = y[i] = z[i] = 0.0;
+      }
+    }
+  }
+
+  if (_x) {
+    *_x = Xcomp;
+  }
+  if (_y) {
+    *_y = (Xcomp ? &Xcomp[stride] : NULL);
+  }
+  if (_z) {
+    *_z = (Xcomp ? &Xcomp[2 * stride] : NULL);
+  }
+  return num_local_nodes;
+}
+
+/*
+  Free the component arrays of the node locations
+*/
+void TMROctForest::freePointComponents() {
+  if (Xcomp) {
+    free(Xcomp);
+  }
+  Xcomp = NULL;
+}
+
+/*
+  Free the ghost octants
+*/
+void TMROctForest::freeGhostOctants() {
+  if (ghosts) {
+    delete ghosts;
+  }
+  if (ghost_owners) {
+    delete[] ghost_owners;
+  }
+  if (ghost_layer_ptr) {
+    delete[] ghost_layer_ptr;
+  }
+  ghost_depth = 0;
+  ghosts = NULL;
+  ghost_owners = NULL;
+  ghost_layer_ptr = NULL;
+}
+
 /*
   Retrieve the local node number
 */
@@ -1508,6 +2513,11 @@ int TMROctForest::getInterpKnots(const double **_knots) {
   Evaluate the interpolant at the given parametric point
 */
 void TMROctForest::evalInterp(const double pt[], double N[]) {
+  if (interp_kernel) {
+    interp_kernel(interp_knots, interp_weights, pt, N);
+    return;
+  }
+
   double Nu[MAX_ORDER], Nv[MAX_ORDER], Nw[MAX_ORDER];
   if (interp_type == TMR_BERNSTEIN_POINTS) {
     // Evaluate the bernstein shape functions
@@ -1536,6 +2546,11 @@ void TMROctForest::evalInterp(const double pt[], double N[]) {
 */
 void TMROctForest::evalInterp(const double pt[], double N[], double Nxi[],
                               double Neta[], double Nzeta[]) {
+  if (interp_deriv_kernel) {
+    interp_deriv_kernel(interp_knots, interp_weights, pt, N, Nxi, Neta, Nzeta);
+    return;
+  }
+
   double Nu[MAX_ORDER], Nv[MAX_ORDER], Nw[MAX_ORDER];
   double Nud[MAX_ORDER], Nvd[MAX_ORDER], Nwd[MAX_ORDER];
   if (interp_type == TMR_BERNSTEIN_POINTS) {
@@ -1626,6 +2641,125 @@ void TMROctForest::evalInterp(const double pt[], double N[], double N1[],
   }
 }
 
+/*
+  Evaluate the interpolant at a batch of parametric points
+
+  The points are stored consecutively in pts, and the shape functions
+  for the i-th point are stored in N starting at N[i*mesh_order^3].
+*/
+void TMROctForest::evalInterp(int npts, const double pts[], double N[]) {
+  const int size = mesh_order * mesh_order * mesh_order;
+  for (int i = 0; i < npts; i++) {
+    evalInterp(&pts[3 * i], &N[size * i]);
+  }
+}
+
+/*
+  Evaluate the interpolant and its derivatives at a batch of points
+*/
+void TMROctForest::evalInterp(int npts, const double pts[], double N[],
+                              double Nxi[], double Neta[], double Nzeta[]) {
+  const int size = mesh_order * mesh_order * mesh_order;
+  for (int i = 0; i < npts; i++) {
+    evalInterp(&pts[3 * i], &N[size * i], &Nxi[size * i], &Neta[size * i],
+               &Nzeta[size * i]);
+  }
+}
+
+/*
+  Retrieve the shape functions tabulated at a set of parametric points
+
+  The first call with a given set of points evaluates the shape
+  functions and their derivatives and caches them. Later calls with
+  the same points return the cached tables. The cache is tied to the
+  current mesh order and interpolation type and is cleared by
+  setMeshOrder(). Only the MAX_INTERP_TABLES most recently used tables
+  are retained, so this is intended for fixed sets such as quadrature
+  or knot points. The returned pointers remain valid until the table
+  is evicted or the mesh order changes.
+
+  input:
+  npts:    the number of points
+  pts:     the parametric points (3*npts)
+
+  output:
+  N:       the shape functions at each point
+  Nxi:     the derivative along the first parametric direction
+  Neta:    the derivative along the second parametric direction
+  Nzeta:   the derivative along the third parametric direction
+
+  returns: the number of shape functions at each point
+*/
+int TMROctForest::getInterpTable(int npts, const double pts[],
+                                 const double **_N, const double **_Nxi,
+                                 const double **_Neta, const double **_Nzeta) {
+  const int size = mesh_order * mesh_order * mesh_order;
+
+  // Search for the table, moving it to the front of the list if found
+  TMRInterpTable *prev = NULL, *table = interp_tables;
+  while (table && !table->matches(3, npts, pts)) {
+    prev = table;
+    table = table->next;
+  }
+
+  if (table && prev) {
+    prev->next = table->next;
+    table->next = interp_tables;
+    interp_tables = table;
+  } else if (!table) {
+    table = new TMRInterpTable(3, npts, pts, size);
+    evalInterp(npts, pts, table->N, &table->Nd[0], &table->Nd[size * npts],
+               &table->Nd[2 * size * npts]);
+    table->next = interp_tables;
+    interp_tables = table;
+
+    // Drop the least recently used tables beyond the limit
+    TMRInterpTable *t = interp_tables;
+    for (int i = 1; t && i < MAX_INTERP_TABLES; i++) {
+      t = t->next;
+    }
+    if (t) {
+      TMRInterpTable *tail = t->next;
+      t->next = NULL;
+      while (tail) {
+        TMRInterpTable *tmp = tail->next;
+        delete tail;
+        tail = tmp;
+      }
+    }
+  }
+
+  if (_N) {
+    *_N = table->N;
+  }
+  if (_Nxi) {
+    *_Nxi = &table->Nd[0];
+  }
+  if (_Neta) {
+    *_Neta = &table->Nd[size * npts];
+  }
+  if (_Nzeta) {
+    *_Nzeta = &table->Nd[2 * size * npts];
+  }
+
+  return size;
+}
+
+/*
+  Free the cached shape function tables and interpolation inverse
+*/
+void TMROctForest::freeInterpTables() {
+  while (interp_tables) {
+    TMRInterpTable *tmp = interp_tables->next;
+    delete interp_tables;
+    interp_tables = tmp;
+  }
+  if (interp_inverse) {
+    delete[] interp_inverse;
+  }
+  interp_inverse = NULL;
+}
+
 /*
   Retrieve information about the connectivity between
   blocks, faces, edges and nodes
@@ -1916,11 +3050,210 @@ void TMROctForest::createRandomTrees(int nrand, int min_level, int max_level) {
   }
 }
 
+/*
+  Compute a weighted partition of the octants
+
+  The octants are cut along the space-filling curve so that each of
+  the first max_rank processors receives a nearly equal fraction of
+  the total weight. Each octant is assigned to the processor whose
+  interval contains the midpoint of its cumulative weight. When
+  possible, each of the first max_rank processors receives at least
+  one octant.
+
+  input:
+  comm:        the MPI communicator
+  size:        the number of octants on this processor
+  weights:     the non-negative weight of each local octant
+  total_size:  the total number of octants across all processors
+  max_rank:    the number of processors that will own octants
+
+  output:
+  new_ptr:     the offset into the global octant array for each rank
+
+  returns:
+  0 if the total weight is zero, 1 otherwise
+*/
+static int compute_weighted_partition(MPI_Comm comm, int size,
+                                      const double *weights, int total_size,
+                                      int max_rank, int *new_ptr) {
+  int mpi_rank, mpi_size;
+  MPI_Comm_rank(comm, &mpi_rank);
+  MPI_Comm_size(comm, &mpi_size);
+
+  // Compute the local weight
+  double local_weight = 0.0;
+  for (int i = 0; i < size; i++) {
+    if (weights[i] > 0.0) {
+      local_weight += weights[i];
+    }
+  }
+
+  // Find the offset for this processor and the total weight
+  double offset = 0.0, total_weight = 0.0;
+  MPI_Exscan(&local_weight, &offset, 1, MPI_DOUBLE, MPI_SUM, comm);
+  MPI_Allreduce(&local_weight, &total_weight, 1, MPI_DOUBLE, MPI_SUM, comm);
+  if (mpi_rank == 0) {
+    offset = 0.0;
+  }
+
+  if (total_weight <= 0.0) {
+    return 0;
+  }
+
+  // Count the local octants that lie before each of the cuts
+  int *counts = new int[mpi_size + 1];
+  memset(counts, 0, (mpi_size + 1) * sizeof(int));
+
+  double cumulative = offset;
+  for (int i = 0, k = 1; i < size; i++) {
+    double w = (weights[i] > 0.0 ? weights[i] : 0.0);
+    double mid = cumulative + 0.5 * w;
+    cumulative += w;
+
+    // Find the first cut that lies beyond the midpoint
+    while (k < max_rank && mid >= (total_weight * k) / max_rank) {
+      k++;
+    }
+    if (k < max_rank) {
+      counts[k]++;
+    }
+  }
+  for (int k = 1; k < max_rank; k++) {
+    counts[k] += counts[k - 1];
+  }
+
+  MPI_Allreduce(counts, new_ptr, mpi_size + 1, MPI_INT, MPI_SUM, comm);
+  delete[] counts;
+
+  new_ptr[0] = 0;
+  for (int k = max_rank; k <= mpi_size; k++) {
+    new_ptr[k] = total_size;
+  }
+
+  // Make sure that each rank receives at least one octant
+  if (total_size >= max_rank) {
+    for (int k = 1; k < max_rank; k++) {
+      if (new_ptr[k] <= new_ptr[k - 1]) {
+        new_ptr[k] = new_ptr[k - 1] + 1;
+      }
+    }
+    for (int k = max_rank - 1; k > 0; k--) {
+      if (new_ptr[k] >= new_ptr[k + 1]) {
+        new_ptr[k] = new_ptr[k + 1] - 1;
+      }
+    }
+  }
+
+  return 1;
+}
+
+/*
+  Move the cuts of a partition onto coarse block boundaries
+
+  A cut placed at an arbitrary octant in the Morton order can leave a
+  processor with disconnected pieces of the coarse octants on either
+  side of the cut, which increases the number of ghost octants and
+  nodes. Each cut is instead moved, within the window, to the octant
+  that starts the coarsest subtree. This is the octant with the most
+  trailing zero bits in its coordinates, so that the first octant of a
+  block is preferred and cuts fall between blocks where possible.
+  Ties are broken by the distance to the original cut. Each cut stays
+  within half of the distance to the adjacent cuts so that no
+  processor loses all of its octants.
+
+  input:
+  comm:        the communicator
+  array:       the local octants
+  size:        the number of local octants
+  offset:      the global index of the first local octant
+  max_rank:    the number of processors that receive octants
+  window:      the maximum distance that a cut may move
+
+  input/output:
+  new_ptr:     the offset into the global octant array for each rank
+*/
+static void align_partition_cuts(MPI_Comm comm, const TMROctant *array,
+                                 int size, int offset, int max_rank,
+                                 int window, int *new_ptr) {
+  if (window > (1 << 24)) {
+    window = 1 << 24;
+  }
+
+  // Each candidate is encoded as the number of missing trailing zero
+  // bits, then the distance to the cut and then the side of the cut
+  const int stride = 2 * window + 2;
+  const int max_code = 33 * stride;
+
+  int *codes = new int[max_rank + 1];
+  for (int k = 0; k <= max_rank; k++) {
+    codes[k] = max_code;
+  }
+
+  for (int k = 1; k < max_rank; k++) {
+    int cut = new_ptr[k];
+    int low = (new_ptr[k - 1] + cut) / 2 + 1;
+    int high = (cut + new_ptr[k + 1]) / 2;
+    if (low < cut - window) {
+      low = cut - window;
+    }
+    if (high > cut + window) {
+      high = cut + window;
+    }
+    if (low < offset) {
+      low = offset;
+    }
+    if (high > offset + size - 1) {
+      high = offset + size - 1;
+    }
+
+    for (int pos = low; pos <= high; pos++) {
+      int i = pos - offset;
+      uint32_t bits = array[i].x | array[i].y | array[i].z;
+      int zeros = 32;
+      if (bits) {
+        zeros = 0;
+        while (!(bits & 1)) {
+          bits >>= 1;
+          zeros++;
+        }
+      }
+
+      int dist = (pos > cut ? pos - cut : cut - pos);
+      int code = (32 - zeros) * stride + 2 * dist + (pos > cut);
+      if (code < codes[k]) {
+        codes[k] = code;
+      }
+    }
+  }
+
+  MPI_Allreduce(MPI_IN_PLACE, codes, max_rank + 1, MPI_INT, MPI_MIN, comm);
+
+  // Decode the new locations of the cuts
+  for (int k = 1; k < max_rank; k++) {
+    if (codes[k] < max_code) {
+      int dist = (codes[k] % stride) / 2;
+      if (codes[k] % 2) {
+        new_ptr[k] += dist;
+      } else {
+        new_ptr[k] -= dist;
+      }
+    }
+  }
+
+  delete[] codes;
+}
+
 /*
   Repartition the octants across all processors
+
+  By default, the octants are divided evenly between the first max_rank
+  processors. If weights are provided for the local octants, the
+  space-filling curve is instead cut so that each processor receives
+  an equal fraction of the total weight. Processors without any
+  octants may pass NULL for the weights.
 */
-void TMROctForest::repartition(int max_rank) {
-  const int num_blocks = bdata->num_blocks;
+void TMROctForest::repartition(int max_rank, const double weights[]) {
+  TMR_PROFILE_BEGIN(TMR_PROFILE_REPARTITION);
 
   // Free everything but the octants
   freeMeshData(0);
@@ -1939,6 +3272,7 @@ void TMROctForest::repartition(int max_rank) {
 
   // Gather the sizes from all the arrays
   MPI_Allgather(&size, 1, MPI_INT, &ptr[1], 1, MPI_INT, comm);
+  TMR_PROFILE_MESSAGES(0, mpi_size, MPI_INT);
 
   // Set the pointers
   ptr[0] = 0;
@@ -1946,23 +3280,62 @@ void TMROctForest::repartition(int max_rank) {
     ptr[k + 1] += ptr[k];
   }
 
-  // Compute the average size of the new counts
-  int average_count = ptr[mpi_size] / max_rank;
-  int remain = ptr[mpi_size] - average_count * max_rank;
+  // Use the weights only if they are provided on all processors
+  // that own octants
+  int use_weights = (weights || size == 0);
+  MPI_Allreduce(MPI_IN_PLACE, &use_weights, 1, MPI_INT, MPI_MIN, comm);
 
   // Figure out what goes where on the new distribution of octants
   int *new_ptr = new int[mpi_size + 1];
-  new_ptr[0] = 0;
-  for (int k = 0; k < max_rank; k++) {
-    new_ptr[k + 1] = new_ptr[k] + average_count;
-    if (k < remain) {
-      new_ptr[k + 1] += 1;
+  if (!use_weights ||
+      !compute_weighted_partition(comm, size, weights, ptr[mpi_size],
+                                  max_rank, new_ptr)) {
+    // Compute the average size of the new counts
+    int average_count = ptr[mpi_size] / max_rank;
+    int remain = ptr[mpi_size] - average_count * max_rank;
+
+    new_ptr[0] = 0;
+    for (int k = 0; k < max_rank; k++) {
+      new_ptr[k + 1] = new_ptr[k] + average_count;
+      if (k < remain) {
+        new_ptr[k + 1] += 1;
+      }
+    }
+    for (int k = max_rank; k < mpi_size; k++) {
+      new_ptr[k + 1] = new_ptr[k];
     }
   }
-  for (int k = max_rank; k < mpi_size; k++) {
-    new_ptr[k + 1] = new_ptr[k];
+
+  // Move the cuts onto coarse octree boundaries
+  int window = (int)(partition_tol * ptr[mpi_size] / max_rank);
+  if (window > 0) {
+    align_partition_cuts(comm, array, size, ptr[mpi_rank], max_rank, window,
+                         new_ptr);
   }
 
+  // Move the octants to their new processors
+  redistributeOctants(ptr, new_ptr);
+  delete[] ptr;
+  delete[] new_ptr;
+
+  octants->getArray(NULL, &size);
+  TMR_PROFILE_OCTANTS(TMR_PROFILE_REPARTITION, size);
+  TMR_PROFILE_END(TMR_PROFILE_REPARTITION);
+}
+
+/*
+  Move the octants to the processors given by the new partition
+
+  The octants are ordered along the space-filling curve. On input, ptr
+  contains the current offset of the octants on each processor and new_ptr
+  contains the offsets after the octants are moved.
+*/
+void TMROctForest::redistributeOctants(const int *ptr, const int *new_ptr) {
+  const int num_blocks = bdata->num_blocks;
+  int size;
+  TMROctant *array;
+  octants->getArray(&array, &size);
+
   // Allocate the new array of octants
   int new_size = new_ptr[mpi_rank + 1] - new_ptr[mpi_rank];
   TMROctant *new_array = NULL;
@@ -2017,6 +3390,7 @@ void TMROctForest::repartition(int max_rank) {
         // Send the element array to the new owner
         MPI_Isend(&array[start], count, TMROctant_MPI_type, i, 0, comm,
                   &send_requests[send_count]);
+        TMR_PROFILE_MESSAGES(1, count, TMROctant_MPI_type);
         send_count++;
       }
     }
@@ -2051,10 +3425,6 @@ void TMROctForest::repartition(int max_rank) {
     }
   }
 
-  // Free the memory
-  delete[] ptr;
-  delete[] new_ptr;
-
   // Wait for any remaining sends to complete
   MPI_Waitall(send_count, send_requests, MPI_STATUSES_IGNORE);
   delete[] send_requests;
@@ -2070,8 +3440,9 @@ void TMROctForest::repartition(int max_rank) {
     p = new_array[0];
   }
 
-  // Free the octant arrays
+  // Free the octant arrays and the element orders that refer to them
   delete octants;
+  freeElementOrders();
   octants = new TMROctantArray(new_array, new_size);
 
   if (owners) {
@@ -2079,6 +3450,7 @@ void TMROctForest::repartition(int max_rank) {
   }
   owners = new TMROctant[mpi_size];
   MPI_Allgather(&p, 1, TMROctant_MPI_type, owners, 1, TMROctant_MPI_type, comm);
+  TMR_PROFILE_MESSAGES(0, mpi_size, TMROctant_MPI_type);
 
   // Set the local reordering for the elements
   octants->getArray(&array, &size);
@@ -2088,31 +3460,95 @@ void TMROctForest::repartition(int max_rank) {
 }
 
 /*
-  Duplicate the forest
+  Repartition the octants so that they match the partition of another
+  forest
+
+  Each octant is moved to the processor that owns the corresponding
+  part of the space-filling curve in the given forest. The forest
+  must be defined on the same connectivity and communicator. This is
+  used to co-partition an analysis forest with the filter forest used
+  to define the design variables. When every analysis octant lies
+  within a filter octant, the enclosing filter octant is always local.
+  The typical use is to call repartition() on the filter and then
+  call alignPartition() on the analysis forest.
 
-  This function creates a duplicate representation of the current
-  forest. This function copies the global connectivity of the forest
-  and copies each individual tree.
+  input:
+  forest:   the forest whose partition is matched
 */
-TMROctForest *TMROctForest::duplicate() {
-  TMROctForest *dup = new TMROctForest(comm, mesh_order, interp_type);
-  if (bdata) {
-    copyData(dup);
-
-    // Copy the octants
-    dup->octants = octants->duplicate();
-    dup->owners = new TMROctant[mpi_size];
-    memcpy(dup->owners, owners, sizeof(TMROctant) * mpi_size);
+void TMROctForest::alignPartition(TMROctForest *forest) {
+  if (!octants || !forest->owners) {
+    fprintf(stderr,
+            "TMROctForest Error: Cannot call alignPartition(), "
+            "no octants have been created\n");
+    return;
   }
+  TMR_PROFILE_BEGIN(TMR_PROFILE_REPARTITION);
 
-  return dup;
-}
-
-/*
-  Coarsen the entire forest
+  // Free everything but the octants
+  freeMeshData(0);
 
-  This function creates a coarsened representation of the current
-  forest. This is done by copying the global connectivity of the
+  // Compute the current offsets for the octants on each processor
+  int *ptr = new int[mpi_size + 1];
+  int size;
+  TMROctant *array;
+  octants->getArray(&array, &size);
+  MPI_Allgather(&size, 1, MPI_INT, &ptr[1], 1, MPI_INT, comm);
+  TMR_PROFILE_MESSAGES(0, mpi_size, MPI_INT);
+  ptr[0] = 0;
+  for (int k = 0; k < mpi_size; k++) {
+    ptr[k + 1] += ptr[k];
+  }
+
+  // Find the local octants that lie within the range owned by each
+  // processor in the other forest. Since the octants are sorted, the
+  // new offsets are the sums of these counts over all processors.
+  int *new_ptr = new int[mpi_size + 1];
+  forest->matchOctantIntervals(array, size, new_ptr);
+  for (int k = mpi_size; k > 0; k--) {
+    new_ptr[k] -= new_ptr[k - 1];
+  }
+  MPI_Allreduce(MPI_IN_PLACE, &new_ptr[1], mpi_size, MPI_INT, MPI_SUM, comm);
+  new_ptr[0] = 0;
+  for (int k = 0; k < mpi_size; k++) {
+    new_ptr[k + 1] += new_ptr[k];
+  }
+
+  // Move the octants to their new processors
+  redistributeOctants(ptr, new_ptr);
+  delete[] ptr;
+  delete[] new_ptr;
+
+  octants->getArray(NULL, &size);
+  TMR_PROFILE_OCTANTS(TMR_PROFILE_REPARTITION, size);
+  TMR_PROFILE_END(TMR_PROFILE_REPARTITION);
+}
+
+/*
+  Duplicate the forest
+
+  This function creates a duplicate representation of the current
+  forest. This function copies the global connectivity of the forest
+  and copies each individual tree.
+*/
+TMROctForest *TMROctForest::duplicate() {
+  TMROctForest *dup = new TMROctForest(comm, mesh_order, interp_type);
+  if (bdata) {
+    copyData(dup);
+
+    // Copy the octants
+    dup->octants = octants->duplicate();
+    dup->owners = new TMROctant[mpi_size];
+    memcpy(dup->owners, owners, sizeof(TMROctant) * mpi_size);
+  }
+
+  return dup;
+}
+
+/*
+  Coarsen the entire forest
+
+  This function creates a coarsened representation of the current
+  forest. This is done by copying the global connectivity of the
   forest and coarsening each individual tree. Note that the resulting
   forest is not necessarily balanced.
 */
@@ -2163,11 +3599,139 @@ TMROctForest *TMROctForest::coarsen() {
   return coarse;
 }
 
+/*
+  Coarsen the forest while retaining the 2:1 balance
+
+  This function merges each complete family of eight sibling octants
+  that are stored on this processor into their parent. A family is
+  only merged if none of the octants that neighbor its children are
+  more refined than the children themselves. When the input forest is
+  balanced, this guarantees that the coarse forest is balanced with
+  the same balance_corner setting, so that no call to balance() is
+  required. Families of octants that are split across processors are
+  not merged, and octants on the coarsest level are retained.
+
+  This call is collective since the octant neighbors, including those
+  on adjacent processors, must be computed.
+
+  input:
+  balance_corner:  the input forest is balanced across corners
+
+  returns:
+  the coarsened, balanced forest
+*/
+TMROctForest *TMROctForest::coarsenBalanced(int balance_corner) {
+  TMROctForest *coarse = new TMROctForest(comm, mesh_order, interp_type);
+  if (bdata) {
+    copyData(coarse);
+
+    // Retrieve the face, edge and corner neighbors of each octant
+    const int *ptr, *neighbors;
+    TMROctantArray *adj_octs;
+    getOctantNeighbors(&ptr, &neighbors, &adj_octs);
+
+    int size, adj_size = 0;
+    TMROctant *array, *adj_array = NULL;
+    octants->getArray(&array, &size);
+    if (adj_octs) {
+      adj_octs->getArray(&adj_array, &adj_size);
+    }
+
+    // Only check the corner neighbors when the forest is balanced
+    // across corners
+    const int num_checks = (balance_corner ? 26 : 18);
+
+    // Create a new queue of octants
+    TMROctantQueue *queue = new TMROctantQueue();
+
+    int i = 0;
+    while (i < size) {
+      // Check whether the next eight octants form a family
+      int merge = 0;
+      if (array[i].level > 0 && i + 8 <= size) {
+        TMROctant p;
+        array[i].parent(&p);
+
+        merge = 1;
+        for (int j = i + 1; j < i + 8; j++) {
+          TMROctant q;
+          array[j].parent(&q);
+          if (array[j].level != array[i].level || p.compare(&q) != 0) {
+            merge = 0;
+            break;
+          }
+        }
+
+        // Check that no neighbor of the family is more refined
+        // than the children
+        for (int j = i; merge && j < i + 8; j++) {
+          for (int k = ptr[26 * j]; k < ptr[26 * j + num_checks]; k++) {
+            int index = neighbors[k];
+            int level = 0;
+            if (index < size) {
+              level = array[index].level;
+            } else if (index - size < adj_size) {
+              level = adj_array[index - size].level;
+            }
+            if (level > array[i].level) {
+              merge = 0;
+              break;
+            }
+          }
+        }
+
+        if (merge) {
+          queue->push(&p);
+        }
+      }
+
+      if (merge) {
+        i += 8;
+      } else {
+        queue->push(&array[i]);
+        i++;
+      }
+    }
+
+    // Create the coarse octants
+    coarse->octants = queue->toArray();
+    delete queue;
+
+    // Order the labels of the coarse octants
+    coarse->octants->getArray(&array, &size);
+    for (int i = 0; i < size; i++) {
+      array[i].tag = i;
+    }
+
+    // Set the owner array
+    coarse->owners = new TMROctant[mpi_size];
+    MPI_Allgather(&array[0], 1, TMROctant_MPI_type, coarse->owners, 1,
+                  TMROctant_MPI_type, comm);
+  }
+
+  return coarse;
+}
+
 /*
   Refine the octree mesh based on the input refinement levels
 */
 void TMROctForest::refine(const int refinement[], int min_level,
                           int max_level) {
+  // Retain the current octants, connectivity and node locations so
+  // that createNodes() can re-use the locations of the nodes in the
+  // octants that are not modified
+  if (incremental_nodes && topo && X) {
+    freePrevMeshData();
+    prev_octants = octants;
+    prev_conn = conn;
+    prev_node_numbers = node_numbers;
+    prev_num_local_nodes = num_local_nodes;
+    prev_X = X;
+    conn = NULL;
+    node_numbers = NULL;
+    X = NULL;
+  }
+
   // Free the mesh data
   freeMeshData(0, 0);
 
@@ -2295,8 +3859,10 @@ void TMROctForest::refine(const int refinement[], int min_level,
     }
   }
 
-  // Free the old octants class
-  delete octants;
+  // Free the old octants class, unless it has been retained
+  if (octants != prev_octants) {
+    delete octants;
+  }
 
   // Sort the list of external octants
   TMROctantArray *list = ext_hash->toArray();
@@ -2316,6 +3882,7 @@ void TMROctForest::refine(const int refinement[], int min_level,
   delete local;
 
   // Cover the hash table to a list and uniquely sort it
+  freeElementOrders();
   octants = hash->toArray();
   octants->sort();
 
@@ -2328,6 +3895,50 @@ void TMROctForest::refine(const int refinement[], int min_level,
   }
 }
 
+/*
+  Refine the forest so that each element reaches a target level and
+  balance the result
+
+  Each element is refined directly to its target level in a single
+  call to refine(), rather than one level at a time, and the 2:1
+  balance is then enforced with a single call to balance(). Elements
+  with a target level below their current level are coarsened as in
+  refine(). This call is collective.
+
+  input:
+  levels:          the target level for each local octant
+  balance_corner:  balance across corners
+*/
+void TMROctForest::refineToLevels(const int levels[], int balance_corner) {
+  if (!octants) {
+    fprintf(stderr,
+            "TMROctForest Error: Cannot call refineToLevels(), "
+            "no octants have been created\n");
+    return;
+  }
+
+  int size;
+  TMROctant *array;
+  octants->getArray(&array, &size);
+
+  // Convert the target levels to relative refinement levels
+  int *refinement = new int[size];
+  for (int i = 0; i < size; i++) {
+    int level = levels[i];
+    if (level < 0) {
+      level = 0;
+    } else if (level > TMR_MAX_LEVEL) {
+      level = TMR_MAX_LEVEL;
+    }
+    refinement[i] = level - array[i].level;
+  }
+
+  refine(refinement, 0, TMR_MAX_LEVEL);
+  delete[] refinement;
+
+  balance(balance_corner);
+}
+
 /*
   Get the owner of the octant
 */
@@ -2375,12 +3986,13 @@ void TMROctForest::matchTagIntervals(TMROctant *array, int size, int *ptr) {
 
 /*
   Send a distributed list of octants to their owner processors
+
+  The octants are sent with the given MPI data type, which may only
+  contain part of the octant data (see sendOctants()).
 */
-TMROctantArray *TMROctForest::distributeOctants(TMROctantArray *list,
-                                                int use_tags, int **_oct_ptr,
-                                                int **_oct_recv_ptr,
-                                                int include_local,
-                                                int use_node_index) {
+TMROctantArray *TMROctForest::distributeOctants(
+    TMROctantArray *list, int use_tags, int **_oct_ptr, int **_oct_recv_ptr,
+    int include_local, int use_node_index, MPI_Datatype oct_type) {
   // Get the array itself
   int size;
   TMROctant *array;
@@ -2412,7 +4024,7 @@ TMROctantArray *TMROctForest::distributeOctants(TMROctantArray *list,
   // Now distribute the octants to their destination octrees and
   // balance the corresponding octrees including the new elements.
   int *oct_recv_counts = new int[mpi_size];
-  MPI_Alltoall(oct_counts, 1, MPI_INT, oct_recv_counts, 1, MPI_INT, comm);
+  TMRExchangeCounts(comm, oct_counts, oct_recv_counts);
 
   // Now use oct_ptr to point into the recv array
   oct_recv_ptr[0] = 0;
@@ -2425,7 +4037,7 @@ TMROctantArray *TMROctForest::distributeOctants(TMROctantArray *list,
 
   // Create the distributed array
   TMROctantArray *dist =
-      sendOctants(list, oct_ptr, oct_recv_ptr, use_node_index);
+      sendOctants(list, oct_ptr, oct_recv_ptr, use_node_index, oct_type);
 
   // Free other data associated with the parallel communication
   if (_oct_ptr) {
@@ -2444,20 +4056,33 @@ TMROctantArray *TMROctForest::distributeOctants(TMROctantArray *list,
 
 /*
   Send the octants to the processors designated by the pointer arrays
+
+  The octants are sent using the MPI data type oct_type. When this is
+  TMROctantNode_MPI_type, only the data that identifies a node is sent
+  and the remaining members of the received octants are zero.
 */
 TMROctantArray *TMROctForest::sendOctants(TMROctantArray *list,
                                           const int *oct_ptr,
                                           const int *oct_recv_ptr,
-                                          int use_node_index) {
+                                          int use_node_index,
+                                          MPI_Datatype oct_type) {
   // Get the array itself
   int size;
   TMROctant *array;
   list->getArray(&array, &size);
 
+  // Exchange the octants with the processors on this node through the
+  // shared-memory buffer. Only the full and node data are supported.
+  TMRNodeSharedBuffer *shared = NULL;
+  if (node_buffer && (oct_type == TMROctant_MPI_type ||
+                      oct_type == TMROctantNode_MPI_type)) {
+    shared = node_buffer;
+  }
+
   // Count up the number of recvs
   int nsends = 0, nrecvs = 0;
   for (int i = 0; i < mpi_size; i++) {
-    if (i != mpi_rank) {
+    if (i != mpi_rank && !(shared && shared->getNodeRank(i) >= 0)) {
       if (oct_ptr[i + 1] - oct_ptr[i] > 0) {
         nsends++;
       }
@@ -2470,17 +4095,39 @@ TMROctantArray *TMROctForest::sendOctants(TMROctantArray *list,
   // Allocate the space for the recving array
   int recv_size = oct_recv_ptr[mpi_size];
   TMROctant *recv_array = new TMROctant[recv_size];
+  if (oct_type != TMROctant_MPI_type) {
+    memset(recv_array, 0, recv_size * sizeof(TMROctant));
+  }
 
-  // Allocate space for the requests
+  // Allocate space for the requests. The receives are posted first
+  // so that incoming octants land directly in place.
+  MPI_Request *recv_request = new MPI_Request[nrecvs];
   MPI_Request *send_request = new MPI_Request[nsends];
 
+  // Post the receives from each source processor
+  for (int i = 0, j = 0; i < mpi_size; i++) {
+    if (shared && i != mpi_rank && shared->getNodeRank(i) >= 0) {
+      continue;
+    }
+    if (i != mpi_rank && oct_recv_ptr[i + 1] > oct_recv_ptr[i]) {
+      int recv_count = oct_recv_ptr[i + 1] - oct_recv_ptr[i];
+      MPI_Irecv(&recv_array[oct_recv_ptr[i]], recv_count, oct_type, i, 0,
+                comm, &recv_request[j]);
+      j++;
+    }
+  }
+
   // Loop over all the ranks and send
   for (int i = 0, j = 0; i < mpi_size; i++) {
+    if (shared && i != mpi_rank && shared->getNodeRank(i) >= 0) {
+      continue;
+    }
     if (i != mpi_rank && oct_ptr[i + 1] - oct_ptr[i] > 0) {
       // Post the send to the destination
       int count = oct_ptr[i + 1] - oct_ptr[i];
-      MPI_Isend(&array[oct_ptr[i]], count, TMROctant_MPI_type, i, 0, comm,
+      MPI_Isend(&array[oct_ptr[i]], count, oct_type, i, 0, comm,
                 &send_request[j]);
+      TMR_PROFILE_MESSAGES(1, count, oct_type);
       j++;
     } else if (i == mpi_rank) {
       int count = oct_recv_ptr[i + 1] - oct_recv_ptr[i];
@@ -2491,116 +4138,380 @@ TMROctantArray *TMROctForest::sendOctants(TMROctantArray *list,
     }
   }
 
-  // Loop over the recieve calls
-  for (int i = 0; i < mpi_size; i++) {
-    if (i != mpi_rank && oct_recv_ptr[i + 1] > oct_recv_ptr[i]) {
-      int recv_count = oct_recv_ptr[i + 1] - oct_recv_ptr[i];
+  // Copy the octants through the shared-memory buffer while the
+  // messages to the other nodes are in flight. Each segment starts
+  // with the offsets of the octants for each processor on the node.
+  if (shared) {
+    const int node_size = shared->getNodeSize();
+    const int node_rank = shared->getNodeRank(mpi_rank);
+    size_t header = node_size * sizeof(int);
+    header = sizeof(TMROctant) * ((header + sizeof(TMROctant) - 1) /
+                                  sizeof(TMROctant));
+
+    int nshared = 0;
+    for (int i = 0; i < mpi_size; i++) {
+      if (i != mpi_rank && shared->getNodeRank(i) >= 0) {
+        nshared += oct_ptr[i + 1] - oct_ptr[i];
+      }
+    }
+
+    char *seg = shared->reserve(header + nshared * sizeof(TMROctant));
+    int *offset = (int *)seg;
+    TMROctant *data = (TMROctant *)&seg[header];
+    for (int i = 0, n = 0; i < mpi_size; i++) {
+      int count = oct_ptr[i + 1] - oct_ptr[i];
+      if (i != mpi_rank && shared->getNodeRank(i) >= 0 && count > 0) {
+        offset[shared->getNodeRank(i)] = n;
+        memcpy(&data[n], &array[oct_ptr[i]], count * sizeof(TMROctant));
+        n += count;
+      }
+    }
+    shared->sync();
+
+    for (int i = 0; i < mpi_size; i++) {
+      int count = oct_recv_ptr[i + 1] - oct_recv_ptr[i];
+      if (i != mpi_rank && shared->getNodeRank(i) >= 0 && count > 0) {
+        const char *src = shared->getSegment(shared->getNodeRank(i));
+        const int *src_offset = (const int *)src;
+        const TMROctant *src_data = (const TMROctant *)&src[header];
+        TMROctant *recv = &recv_array[oct_recv_ptr[i]];
+        memcpy(recv, &src_data[src_offset[node_rank]],
+               count * sizeof(TMROctant));
 
-      MPI_Recv(&recv_array[oct_recv_ptr[i]], recv_count, TMROctant_MPI_type, i,
-               0, comm, MPI_STATUS_IGNORE);
+        // Zero the members that are not part of the node data
+        if (oct_type == TMROctantNode_MPI_type) {
+          for (int k = 0; k < count; k++) {
+            recv[k].tag = 0;
+            recv[k].level = 0;
+          }
+        }
+      }
     }
   }
 
-  // Wait for any remaining sends to complete
+  // Wait for the receives and any remaining sends to complete
+  MPI_Waitall(nrecvs, recv_request, MPI_STATUSES_IGNORE);
   MPI_Waitall(nsends, send_request, MPI_STATUSES_IGNORE);
+  delete[] recv_request;
   delete[] send_request;
 
   return new TMROctantArray(recv_array, recv_size, use_node_index);
 }
 
 /*
-  Add the face neighbors for an adjacent tree
+  Send only the tags of the octants to the processors designated by
+  the pointer arrays
 
-  This function balances the given octant p across the face with the
-  given face_index. The adjacent octants are added to the hash object.
-  If the octants are not in the hash, they are also pushed to the queue
-  for balancing.
+  This is used to return the result of a query to the processors that
+  sent the octants. The tags are received in the same order as the
+  octants were originally sent, so the receiver can match them with
+  its own octants without sending the full octants back.
 
-  input:
-  face_index:  index for the given face
-  p:           octant to balance
-  hash:        the array of hash objects for each processor
-  queue:       the array of newly added qudrants for each processor
+  returns:
+  the array of received tags with length oct_recv_ptr[mpi_size]
 */
-void TMROctForest::addFaceNeighbors(int face_index, TMROctant p,
-                                    TMROctantHash *hash,
-                                    TMROctantHash *ext_hash,
-                                    TMROctantQueue *queue) {
-  // Determine the global face number
-  int block = p.block;
-  int face = bdata->block_face_conn[6 * block + face_index];
-  int face_id = bdata->block_face_ids[6 * block + face_index];
-
-  // Set the size of the side-length of the octant
-  const int32_t hmax = 1 << TMR_MAX_LEVEL;
-  const int32_t h = 1 << (TMR_MAX_LEVEL - p.level);
-
-  // Get the u/v coordinates of this face on the owner
-  int32_t u, v;
-  if (face_index < 2) {  // x-face
-    get_face_oct_coords(face_id, 2 * h, p.y, p.z, &u, &v);
-  } else if (face_index < 4) {  // y-face
-    get_face_oct_coords(face_id, 2 * h, p.x, p.z, &u, &v);
-  } else {  // z-face
-    get_face_oct_coords(face_id, 2 * h, p.x, p.y, &u, &v);
-  }
-
-  // Loop over all the adjacent faces and add the block
-  for (int ip = bdata->face_block_ptr[face];
-       ip < bdata->face_block_ptr[face + 1]; ip++) {
-    // Get the adjacent block and the face index on the adjacent block
-    int adj_block = bdata->face_block_conn[ip] / 6;
-    if (adj_block != block) {
-      // Get the face index on the adjacent block
-      int adj_index = bdata->face_block_conn[ip] % 6;
-
-      // Get the face id for the matching face
-      face_id = bdata->block_face_ids[6 * adj_block + adj_index];
+int *TMROctForest::sendOctantTags(TMROctantArray *list, const int *oct_ptr,
+                                  const int *oct_recv_ptr) {
+  // Get the array itself
+  TMROctant *array;
+  list->getArray(&array, NULL);
 
-      // Get the neighboring octant on the face
-      TMROctant neighbor;
-      neighbor.block = adj_block;
-      neighbor.level = p.level;
-      neighbor.info = 0;
+  // Exchange the tags with the processors on this node through the
+  // shared-memory buffer
+  TMRNodeSharedBuffer *shared = node_buffer;
 
-      // Set the coordinates from the owner to the destination face
-      if (adj_index < 2) {
-        neighbor.x = (hmax - 2 * h) * (adj_index % 2);
-        set_face_oct_coords(face_id, 2 * h, u, v, &neighbor.y, &neighbor.z);
-      } else if (adj_index < 4) {
-        neighbor.y = (hmax - 2 * h) * (adj_index % 2);
-        set_face_oct_coords(face_id, 2 * h, u, v, &neighbor.x, &neighbor.z);
-      } else {
-        neighbor.z = (hmax - 2 * h) * (adj_index % 2);
-        set_face_oct_coords(face_id, 2 * h, u, v, &neighbor.x, &neighbor.y);
+  // Count up the number of recvs
+  int nsends = 0, nrecvs = 0;
+  for (int i = 0; i < mpi_size; i++) {
+    if (i != mpi_rank && !(shared && shared->getNodeRank(i) >= 0)) {
+      if (oct_ptr[i + 1] - oct_ptr[i] > 0) {
+        nsends++;
       }
-
-      // Find the octant owner and add the octant to the hash
-      // tables and possibly queue
-      int owner = getOctantMPIOwner(&neighbor);
-      if (owner == mpi_rank) {
-        if (hash->addOctant(&neighbor)) {
-          queue->push(&neighbor);
-        }
-      } else if (ext_hash && ext_hash->addOctant(&neighbor)) {
-        queue->push(&neighbor);
+      if (oct_recv_ptr[i + 1] - oct_recv_ptr[i] > 0) {
+        nrecvs++;
       }
     }
   }
-}
 
-/*
-  Add the edge neighbors for adjacent trees
+  // Allocate the space for the received tags
+  int recv_size = oct_recv_ptr[mpi_size];
+  int *recv_tags = new int[recv_size];
 
-  This function is called to balance the forest across tree edges.
-  Given an octant p on the specified edge index, this code ensures a
-  edge balanced tree, by adding the corresponding edge octants to all
-  edge-adjacent octrees. If the octant is added to the hash object, it
-  is then appended to the local face queue to ensure that it is also
-  balanced locally.
+  MPI_Request *recv_request = new MPI_Request[nrecvs];
+  MPI_Request *send_request = new MPI_Request[nsends];
 
-  input:
-  edge_index:  index for the given edge
+  // Post the receives from each source processor
+  for (int i = 0, j = 0; i < mpi_size; i++) {
+    if (shared && i != mpi_rank && shared->getNodeRank(i) >= 0) {
+      continue;
+    }
+    if (i != mpi_rank && oct_recv_ptr[i + 1] > oct_recv_ptr[i]) {
+      int recv_count = oct_recv_ptr[i + 1] - oct_recv_ptr[i];
+      MPI_Irecv(&recv_tags[oct_recv_ptr[i]], recv_count, MPI_INT32_T, i, 0,
+                comm, &recv_request[j]);
+      j++;
+    }
+  }
+
+  // Send the tags directly from the octant array
+  for (int i = 0, j = 0; i < mpi_size; i++) {
+    if (shared && i != mpi_rank && shared->getNodeRank(i) >= 0) {
+      continue;
+    }
+    if (i != mpi_rank && oct_ptr[i + 1] - oct_ptr[i] > 0) {
+      int count = oct_ptr[i + 1] - oct_ptr[i];
+      MPI_Isend(&array[oct_ptr[i]], count, TMROctantTag_MPI_type, i, 0, comm,
+                &send_request[j]);
+      TMR_PROFILE_MESSAGES(1, count, MPI_INT32_T);
+      j++;
+    } else if (i == mpi_rank) {
+      int count = oct_recv_ptr[i + 1] - oct_recv_ptr[i];
+      if (count == oct_ptr[i + 1] - oct_ptr[i]) {
+        for (int k = 0; k < count; k++) {
+          recv_tags[oct_recv_ptr[i] + k] = array[oct_ptr[i] + k].tag;
+        }
+      }
+    }
+  }
+
+  // Copy the tags through the shared-memory buffer. Each segment
+  // starts with the offsets of the tags for each processor on the node.
+  if (shared) {
+    const int node_size = shared->getNodeSize();
+    const int node_rank = shared->getNodeRank(mpi_rank);
+
+    int nshared = 0;
+    for (int i = 0; i < mpi_size; i++) {
+      if (i != mpi_rank && shared->getNodeRank(i) >= 0) {
+        nshared += oct_ptr[i + 1] - oct_ptr[i];
+      }
+    }
+
+    int *seg = (int *)shared->reserve((node_size + nshared) * sizeof(int));
+    int *data = &seg[node_size];
+    for (int i = 0, n = 0; i < mpi_size; i++) {
+      int count = oct_ptr[i + 1] - oct_ptr[i];
+      if (i != mpi_rank && shared->getNodeRank(i) >= 0 && count > 0) {
+        seg[shared->getNodeRank(i)] = n;
+        for (int k = 0; k < count; k++, n++) {
+          data[n] = array[oct_ptr[i] + k].tag;
+        }
+      }
+    }
+    shared->sync();
+
+    for (int i = 0; i < mpi_size; i++) {
+      int count = oct_recv_ptr[i + 1] - oct_recv_ptr[i];
+      if (i != mpi_rank && shared->getNodeRank(i) >= 0 && count > 0) {
+        const int *src = (const int *)shared->getSegment(
+            shared->getNodeRank(i));
+        memcpy(&recv_tags[oct_recv_ptr[i]], &src[node_size + src[node_rank]],
+               count * sizeof(int));
+      }
+    }
+  }
+
+  MPI_Waitall(nrecvs, recv_request, MPI_STATUSES_IGNORE);
+  MPI_Waitall(nsends, send_request, MPI_STATUSES_IGNORE);
+  delete[] recv_request;
+  delete[] send_request;
+
+  return recv_tags;
+}
+
+/*
+  Set the number of threads used within each MPI process
+
+  At present, the threads are used within balance(), to create the
+  local nodes and connectivity in createNodes() and in the element
+  reconstruction in TMR_RefinementTools.
+*/
+void TMROctForest::setNumThreads(int _num_threads) {
+  num_threads = (_num_threads > 1 ? _num_threads : 1);
+}
+
+/*
+  Get the number of threads used within each MPI process
+*/
+int TMROctForest::getNumThreads() { return num_threads; }
+
+/*
+  Set the tolerance used to align the partition with the octrees
+
+  When positive, repartition() moves each cut by up to this fraction
+  of the average number of octants per processor so that the cut
+  falls on the boundary of the coarsest possible subtree. This
+  reduces the number of ghost octants and nodes at the cost of a small
+  load imbalance.
+*/
+void TMROctForest::setPartitionTolerance(double tol) {
+  partition_tol = (tol > 0.0 ? tol : 0.0);
+}
+
+/*
+  Set whether to retain the mesh data from before a call to refine()
+
+  When active, refine() keeps the previous octants, connectivity and
+  node locations, if the locations have been evaluated. When the node
+  locations of the new mesh are evaluated, the locations are copied
+  for every octant that was not modified instead of evaluating the
+  geometry again.
+
+  Only the node locations are reused. createNodes() still rebuilds the
+  global node numbering, the local nodes and the dependent node
+  connectivity and weights in full, and the locations are only copied
+  if they are requested through getPoints() or getPointComponents().
+*/
+void TMROctForest::setIncrementalNodes(int _incremental_nodes) {
+  incremental_nodes = _incremental_nodes;
+  if (!incremental_nodes) {
+    freePrevMeshData();
+  }
+}
+
+/*
+  Get whether the mesh data is retained from before a call to refine()
+*/
+int TMROctForest::getIncrementalNodes() { return incremental_nodes; }
+
+/*
+  Set whether to exchange octants through node-local shared memory
+
+  When active, sendOctants() and sendOctantTags() copy the data sent
+  between processors on the same node through an MPI-3 shared-memory
+  window instead of point-to-point messages. Each processor writes
+  the data for all of its on-node destinations into its own segment
+  once, and the destinations copy their part directly into the
+  received array. The messages to processors on other nodes are
+  unchanged. This call is collective on the forest communicator and
+  has no effect when MPI-3 is not available.
+*/
+void TMROctForest::setUseSharedMemory(int flag) {
+  if (flag && !node_buffer) {
+    node_buffer = new TMRNodeSharedBuffer(comm);
+    node_buffer->incref();
+  } else if (!flag && node_buffer) {
+    node_buffer->decref();
+    node_buffer = NULL;
+  }
+}
+
+/*
+  Get whether octants are exchanged through node-local shared memory
+*/
+int TMROctForest::getUseSharedMemory() { return (node_buffer != NULL); }
+
+/*
+  Set whether to share the block connectivity between processors
+
+  When active, a single copy of the block connectivity and the
+  inverse connectivity and owner data is stored in an MPI-3 shared
+  window on each node. Only one processor on each node computes
+  this data from the input connectivity, which reduces the memory
+  and the setup time for large block meshes. This must be set before
+  the connectivity or topology is set and has no effect when MPI-3 is
+  not available.
+*/
+void TMROctForest::setUseSharedConnectivity(int flag) { shared_conn = flag; }
+
+/*
+  Get whether the block connectivity is shared between processors
+*/
+int TMROctForest::getUseSharedConnectivity() { return shared_conn; }
+
+/*
+  Add the face neighbors for an adjacent tree
+
+  This function balances the given octant p across the face with the
+  given face_index. The adjacent octants are added to the hash object.
+  If the octants are not in the hash, they are also pushed to the queue
+  for balancing.
+
+  input:
+  face_index:  index for the given face
+  p:           octant to balance
+  hash:        the array of hash objects for each processor
+  queue:       the array of newly added qudrants for each processor
+*/
+void TMROctForest::addFaceNeighbors(int face_index, TMROctant p,
+                                    TMROctantHash *hash,
+                                    TMROctantHash *ext_hash,
+                                    TMROctantQueue *queue) {
+  // Determine the global face number
+  int block = p.block;
+  int face = bdata->block_face_conn[6 * block + face_index];
+  int face_id = bdata->block_face_ids[6 * block + face_index];
+
+  // Set the size of the side-length of the octant
+  const int32_t hmax = 1 << TMR_MAX_LEVEL;
+  const int32_t h = 1 << (TMR_MAX_LEVEL - p.level);
+
+  // Get the u/v coordinates of this face on the owner
+  int32_t u, v;
+  if (face_index < 2) {  // x-face
+    get_face_oct_coords(face_id, 2 * h, p.y, p.z, &u, &v);
+  } else if (face_index < 4) {  // y-face
+    get_face_oct_coords(face_id, 2 * h, p.x, p.z, &u, &v);
+  } else {  // z-face
+    get_face_oct_coords(face_id, 2 * h, p.x, p.y, &u, &v);
+  }
+
+  // Loop over all the adjacent faces and add the block
+  for (int ip = bdata->face_block_ptr[face];
+       ip < bdata->face_block_ptr[face + 1]; ip++) {
+    // Get the adjacent block and the face index on the adjacent block
+    int adj_block = bdata->face_block_conn[ip] / 6;
+    if (adj_block != block) {
+      // Get the face index on the adjacent block
+      int adj_index = bdata->face_block_conn[ip] % 6;
+
+      // Get the face id for the matching face
+      face_id = bdata->block_face_ids[6 * adj_block + adj_index];
+
+      // Get the neighboring octant on the face
+      TMROctant neighbor;
+      neighbor.block = adj_block;
+      neighbor.level = p.level;
+      neighbor.info = 0;
+
+      // Set the coordinates from the owner to the destination face
+      if (adj_index < 2) {
+        neighbor.x = (hmax - 2 * h) * (adj_index % 2);
+        set_face_oct_coords(face_id, 2 * h, u, v, &neighbor.y, &neighbor.z);
+      } else if (adj_index < 4) {
+        neighbor.y = (hmax - 2 * h) * (adj_index % 2);
+        set_face_oct_coords(face_id, 2 * h, u, v, &neighbor.x, &neighbor.z);
+      } else {
+        neighbor.z = (hmax - 2 * h) * (adj_index % 2);
+        set_face_oct_coords(face_id, 2 * h, u, v, &neighbor.x, &neighbor.y);
+      }
+
+      // Find the octant owner and add the octant to the hash
+      // tables and possibly queue
+      int owner = getOctantMPIOwner(&neighbor);
+      if (owner == mpi_rank) {
+        if (hash->addOctant(&neighbor)) {
+          queue->push(&neighbor);
+        }
+      } else if (ext_hash && ext_hash->addOctant(&neighbor)) {
+        queue->push(&neighbor);
+      }
+    }
+  }
+}
+
+/*
+  Add the edge neighbors for adjacent trees
+
+  This function is called to balance the forest across tree edges.
+  Given an octant p on the specified edge index, this code ensures a
+  edge balanced tree, by adding the corresponding edge octants to all
+  edge-adjacent octrees. If the octant is added to the hash object, it
+  is then appended to the local face queue to ensure that it is also
+  balanced locally.
+
+  input:
+  edge_index:  index for the given edge
   p:           octant to balance
   hash:        the array of hash objects for each processor
   queue:       the array of newly added qudrants for each processor
@@ -2894,15 +4805,129 @@ void TMROctForest::balanceOctant(TMROctant *oct, TMROctantHash *hash,
   }
 }
 
+/*
+  Data used to balance a range of the local octants
+*/
+class TMROctBalanceThreadData {
+ public:
+  TMROctForest *forest;
+  TMROctant *array;
+  int start, end;
+  int balance_corner;
+  TMROctantHash *hash, *ext_hash;
+};
+
+/*
+  Balance the octants array[start:end] within the octants that are
+  locally owned by this processor.
+
+  This function only modifies the hash tables and queue that belong to
+  the range, so that separate ranges can be balanced concurrently
+  using different threads.
+*/
+void *TMROctForest::balanceThread(void *args) {
+  TMROctBalanceThreadData *data = static_cast<TMROctBalanceThreadData *>(args);
+  TMROctForest *forest = data->forest;
+  TMROctantHash *hash = data->hash;
+  TMROctantHash *ext_hash = data->ext_hash;
+
+  // The queues of octants to balance on each level
+  TMROctantQueue *queues[TMR_MAX_LEVEL + 1];
+  for (int level = 0; level <= TMR_MAX_LEVEL; level++) {
+    queues[level] = NULL;
+  }
+
+  // Add all the elements. Each 0-sibling is only queued once, since
+  // all siblings require the same octants for balancing.
+  for (int i = data->start; i < data->end; i++) {
+    TMROctant oct;
+    data->array[i].getSibling(0, &oct);
+
+    // Get the octant owner
+    int owner = forest->getOctantMPIOwner(&oct);
+
+    // Add the owner
+    int added = 0;
+    if (owner == forest->mpi_rank) {
+      added = hash->addOctant(&oct);
+    } else {
+      added = ext_hash->addOctant(&oct);
+    }
+
+    if (added) {
+      if (!queues[oct.level]) {
+        queues[oct.level] = new TMROctantQueue();
+      }
+      queues[oct.level]->push(&oct);
+    }
+  }
+
+  // Balance the octants and propagate the added octants
+  forest->balanceLevels(queues, hash, ext_hash, data->balance_corner);
+
+  return NULL;
+}
+
+/*
+  Balance the octants stored in the queues for each level
+
+  Balancing an octant only adds octants on the next-coarsest level, so
+  the octants are processed level by level starting from the finest
+  level. The octants on each level are sorted before they are balanced
+  so that the hash lookups proceed along the space-filling curve.
+  The queues are deleted once the octants on each level are balanced.
+
+  input:
+  queues:          the queue for each level (NULL if the level is empty)
+  hash:            the hash table of local octants
+  ext_hash:        the hash table of external octants (may be NULL)
+  balance_corner:  balance across corners
+*/
+void TMROctForest::balanceLevels(TMROctantQueue **queues,
+                                 TMROctantHash *hash,
+                                 TMROctantHash *ext_hash,
+                                 const int balance_corner) {
+  for (int level = TMR_MAX_LEVEL; level >= 0; level--) {
+    if (!queues[level]) {
+      continue;
+    }
+
+    // Sort the octants on this level
+    TMROctantArray *list = queues[level]->toArray();
+    delete queues[level];
+    queues[level] = NULL;
+    list->sort();
+
+    int size;
+    TMROctant *array;
+    list->getArray(&array, &size);
+
+    // The balanced octants are added on the next-coarsest level
+    if (level > 1 && size > 0) {
+      if (!queues[level - 1]) {
+        queues[level - 1] = new TMROctantQueue();
+      }
+      for (int i = 0; i < size; i++) {
+        const int balance_tree = 1;
+        balanceOctant(&array[i], hash, ext_hash, queues[level - 1],
+                      balance_corner, balance_tree);
+      }
+    }
+
+    delete list;
+  }
+}
+
 /*
   Balance the forest of octrees
 
-  This algorithm uses a hash and a queue to balance the forest of
-  octrees. For each element in the octree, we add the neighbors that
-  are required to balance to the tree. If the element is not in the
-  hash, we add them to a queue, which keeps track of recently added
-  elements. After the first pass, the algorithm continues popping
-  elements until the all the queues are empty.
+  This algorithm uses a hash and a queue for each level to balance the
+  forest of octrees. For each element in the octree, we add the
+  neighbors that are required to balance to the tree. If the element
+  is not in the hash, we add it to the queue for its level. Since the
+  added neighbors are always one level coarser, the queues are
+  processed from the finest level to the coarsest level, sorting the
+  octants on each level before they are balanced.
 
   Note that only 0-th siblings are added/popped on the hash/queue.
   Then at the end, all neighboring siblings are added.
@@ -2913,6 +4938,10 @@ void TMROctForest::balanceOctant(TMROctant *oct, TMROctantHash *hash,
   of the elements and corner balances across corners. The code always
   balances faces and edges (so that there is at most one depdent node
   per edge) and balances across corners optionally.
+
+  When more than one thread is set, the initial local balancing is
+  split between the threads. The octants exchanged between processors
+  are still balanced on the main thread.
 */
 void TMROctForest::balance(int balance_corner) {
   if (!octants) {
@@ -2921,49 +4950,78 @@ void TMROctForest::balance(int balance_corner) {
             "no octants have been created\n");
     return;
   }
+  TMR_PROFILE_BEGIN(TMR_PROFILE_BALANCE);
 
-  // Create a hash table for the balanced tree
-  TMROctantHash *hash = new TMROctantHash();
-  TMROctantHash *ext_hash = new TMROctantHash();
-  TMROctantQueue *queue = new TMROctantQueue();
+  // Free the mesh data, which depends on the octants
+  freeMeshData(0, 0);
 
   // Get the array of octants
   int oct_size;
   TMROctant *oct_array;
   octants->getArray(&oct_array, &oct_size);
 
-  // Add all the elements
-  for (int i = 0; i < oct_size; i++) {
-    TMROctant oct;
-    oct_array[i].getSibling(0, &oct);
-
-    // Get the octant owner
-    int owner = getOctantMPIOwner(&oct);
+  // Split the local octants into contiguous ranges along the
+  // space-filling curve. Each range is balanced independently and
+  // the results are merged afterwards. This is possible since the
+  // octants required to balance a set of octants are the union of
+  // the octants required to balance each octant individually.
+  int nthreads = num_threads;
+  if (nthreads > oct_size) {
+    nthreads = (oct_size > 0 ? oct_size : 1);
+  }
+
+  TMROctBalanceThreadData *data = new TMROctBalanceThreadData[nthreads];
+  for (int k = 0; k < nthreads; k++) {
+    data[k].forest = this;
+    data[k].array = oct_array;
+    data[k].start = (int)(((long int)k * oct_size) / nthreads);
+    data[k].end = (int)(((long int)(k + 1) * oct_size) / nthreads);
+    data[k].balance_corner = balance_corner;
+    data[k].hash = new TMROctantHash();
+    data[k].ext_hash = new TMROctantHash();
+  }
+
+  if (nthreads > 1) {
+    pthread_t *threads = new pthread_t[nthreads];
+    for (int k = 0; k < nthreads; k++) {
+      pthread_create(&threads[k], NULL, TMROctForest::balanceThread,
+                     (void *)&data[k]);
+    }
+    for (int k = 0; k < nthreads; k++) {
+      pthread_join(threads[k], NULL);
+    }
+    delete[] threads;
+  } else {
+    balanceThread((void *)&data[0]);
+  }
 
-    // Add the owner
-    if (owner == mpi_rank) {
-      hash->addOctant(&oct);
-    } else {
-      ext_hash->addOctant(&oct);
+  // Merge the octants from each range into a single hash table
+  TMROctantHash *hash = data[0].hash;
+  TMROctantHash *ext_hash = data[0].ext_hash;
+  for (int k = 1; k < nthreads; k++) {
+    TMROctantArray *list = data[k].hash->toArray();
+    list->getArray(&oct_array, &oct_size);
+    for (int i = 0; i < oct_size; i++) {
+      hash->addOctant(&oct_array[i]);
     }
+    delete list;
+    delete data[k].hash;
 
-    // Balance the octants locally
-    const int balance_tree = 1;
-    balanceOctant(&oct, hash, ext_hash, queue, balance_corner, balance_tree);
+    list = data[k].ext_hash->toArray();
+    list->getArray(&oct_array, &oct_size);
+    for (int i = 0; i < oct_size; i++) {
+      ext_hash->addOctant(&oct_array[i]);
+    }
+    delete list;
+    delete data[k].ext_hash;
   }
+  delete[] data;
 
   // Free the original octant array and set it to NULL
   delete octants;
 
-  while (queue->length() > 0) {
-    // Now continue until the queue of added octants is
-    // empty. At each iteration, pop an octant and add
-    // its neighbours until nothing new is added. This code
-    // handles the propagation of octants to adjacent octants.
-    TMROctant oct = queue->pop();
-    const int balance_tree = 1;
-    balanceOctant(&oct, hash, ext_hash, queue, balance_corner, balance_tree);
-  }
+  // Create the queue for the remainder of the balancing
+  TMROctantQueue *queue = new TMROctantQueue();
 
   // Now everything is locally balanced - all the elements on the
   // current processor are balanced with all the other elements on the
@@ -3010,26 +5068,29 @@ void TMROctForest::balance(int balance_corner) {
   TMROctantArray *local = distributeOctants(list);
   delete list;
 
-  // Allocate a new queue
-  queue = new TMROctantQueue();
-
   // Get the local array of octants and add them to the
   // hash table
+  TMROctantQueue *queues[TMR_MAX_LEVEL + 1];
+  for (int level = 0; level <= TMR_MAX_LEVEL; level++) {
+    queues[level] = NULL;
+  }
   local->getArray(&array, &size);
   for (int i = 0; i < size; i++) {
     if (hash->addOctant(&array[i])) {
-      queue->push(&array[i]);
+      if (!queues[array[i].level]) {
+        queues[array[i].level] = new TMROctantQueue();
+      }
+      queues[array[i].level]->push(&array[i]);
     }
   }
   delete local;
 
   // Now all the received octants will balance the tree locally
   // without having to worry about off-processor octants.
-  while (queue->length() > 0) {
-    const int balance_tree = 1;
-    TMROctant oct = queue->pop();
-    balanceOctant(&oct, hash, NULL, queue, balance_corner, balance_tree);
-  }
+  balanceLevels(queues, hash, NULL, balance_corner);
+
+  // Allocate a new queue
+  queue = new TMROctantQueue();
 
   // Now convert the elements from child-0 elements to
   // elements which cover the full mesh
@@ -3075,8 +5136,11 @@ void TMROctForest::balance(int balance_corner) {
   delete local;
 
   // Set the elements into the octree
+  TMR_PROFILE_PEAK_SIZE(hash->length());
+  freeElementOrders();
   octants = hash->toArray();
   octants->sort();
+  updateMaxMemoryUsage(hash->getMemoryUsage());
 
   // Get the octants and order their labels
   octants->getArray(&array, &size);
@@ -3086,6 +5150,9 @@ void TMROctForest::balance(int balance_corner) {
 
   // Free the hash
   delete hash;
+
+  TMR_PROFILE_OCTANTS(TMR_PROFILE_BALANCE, size);
+  TMR_PROFILE_END(TMR_PROFILE_BALANCE);
 }
 
 /*
@@ -3289,6 +5356,14 @@ void TMROctForest::computeAdjacentOctants() {
     delete adjacent;
   }
 
+  // The neighbors reference the adjacent octants
+  if (neighbor_ptr) {
+    delete[] neighbor_ptr;
+    delete[] neighbor_list;
+  }
+  neighbor_ptr = NULL;
+  neighbor_list = NULL;
+
   // Allocate the queue that stores the octants destined for each of
   // the processors
   TMROctantQueue *queue = new TMROctantQueue();
@@ -3605,30 +5680,716 @@ int TMROctForest::checkAdjacentEdges(int edge_index, TMROctant *neighbor) {
 }
 
 /*
-  Compute the dependent nodes (hanging edge/face nodes) on each block
-  and on the interfaces between adjacent blocks.
+  Find the octants in adjacent blocks that are equivalent to an octant
+  lying outside the bounds of its own block.
 
-  The hanging face nodes may occur on any face within the block and
-  are associated with the 4 parallel hanging edge nodes.  Within this
-  code, we only store the corresponding face node and use the
-  associated edges. Edge nodes along block interfaces may be hanging
-  even if there is no associated hanging face node.
+  The octant may lie across a block face, a block edge or a block
+  corner. The equivalent octants are the octants with the same level
+  that occupy the same location in each of the adjacent blocks.
 
-  side effects:
+  input:
+  q:     the octant outside the bounds of its block
+
+  output:
+  adj:   the equivalent octants in the adjacent blocks
+
+  returns:
+  the number of equivalent octants
 */
-void TMROctForest::computeDepFacesAndEdges() {
+int TMROctForest::getAdjacentBlockOctants(TMROctant *q, TMROctant *adj) {
   const int32_t hmax = 1 << TMR_MAX_LEVEL;
+  const int32_t h = 1 << (TMR_MAX_LEVEL - q->level);
 
-  // Get all of the octants owned by this processor
-  int oct_size;
+  // Determine which bounds the octant lies outside
+  int fx0 = (q->x < 0);
+  int fy0 = (q->y < 0);
+  int fz0 = (q->z < 0);
+  int fx = (fx0 || q->x >= hmax);
+  int fy = (fy0 || q->y >= hmax);
+  int fz = (fz0 || q->z >= hmax);
+
+  int block_owner = q->block;
+  int nadj = 0;
+
+  if (fx && fy && fz) {
+    // The octant lies across a block corner
+    int corner = (fx0 ? 0 : 1) + (fy0 ? 0 : 2) + (fz0 ? 0 : 4);
+    int node = bdata->block_conn[8 * block_owner + corner];
+
+    for (int ip = bdata->node_block_ptr[node];
+         ip < bdata->node_block_ptr[node + 1]; ip++) {
+      int block = bdata->node_block_conn[ip] / 8;
+      if (block != block_owner) {
+        int adj_index = bdata->node_block_conn[ip] % 8;
+
+        adj[nadj].block = block;
+        adj[nadj].level = q->level;
+        adj[nadj].x = (hmax - h) * (adj_index % 2);
+        adj[nadj].y = (hmax - h) * ((adj_index % 4) / 2);
+        adj[nadj].z = (hmax - h) * (adj_index / 4);
+        nadj++;
+      }
+    }
+  } else if ((fx && fy) || (fy && fz) || (fx && fz)) {
+    // The octant lies across a block edge
+    int edge_index = 0;
+    int32_t ucoord = 0;
+    if (fy && fz) {
+      edge_index = (fy0 ? 0 : 1) + (fz0 ? 0 : 2);
+      ucoord = q->x;
+    } else if (fx && fz) {
+      edge_index = (fx0 ? 4 : 5) + (fz0 ? 0 : 2);
+      ucoord = q->y;
+    } else {
+      edge_index = (fx0 ? 8 : 9) + (fy0 ? 0 : 2);
+      ucoord = q->z;
+    }
+
+    // Retrieve the first and second node numbers
+    int edge = bdata->block_edge_conn[12 * block_owner + edge_index];
+    int n1 =
+        bdata->block_conn[8 * block_owner + block_to_edge_nodes[edge_index][0]];
+    int n2 =
+        bdata->block_conn[8 * block_owner + block_to_edge_nodes[edge_index][1]];
+
+    for (int ip = bdata->edge_block_ptr[edge];
+         ip < bdata->edge_block_ptr[edge + 1]; ip++) {
+      int block = bdata->edge_block_conn[ip] / 12;
+      if (block != block_owner) {
+        int adj_index = bdata->edge_block_conn[ip] % 12;
+
+        // Get the nodes on the adjacent block
+        int nn1 =
+            bdata->block_conn[8 * block + block_to_edge_nodes[adj_index][0]];
+        int nn2 =
+            bdata->block_conn[8 * block + block_to_edge_nodes[adj_index][1]];
+
+        // Check whether the edge is reversed
+        int32_t u = ucoord;
+        if (n1 == nn2 && n2 == nn1) {
+          u = hmax - h - ucoord;
+        }
+
+        adj[nadj].block = block;
+        adj[nadj].level = q->level;
+        if (adj_index < 4) {
+          adj[nadj].x = u;
+          adj[nadj].y = (hmax - h) * (adj_index % 2);
+          adj[nadj].z = (hmax - h) * (adj_index / 2);
+        } else if (adj_index < 8) {
+          adj[nadj].x = (hmax - h) * (adj_index % 2);
+          adj[nadj].y = u;
+          adj[nadj].z = (hmax - h) * ((adj_index - 4) / 2);
+        } else {
+          adj[nadj].x = (hmax - h) * (adj_index % 2);
+          adj[nadj].y = (hmax - h) * ((adj_index - 8) / 2);
+          adj[nadj].z = u;
+        }
+        nadj++;
+      }
+    }
+  } else if (fx || fy || fz) {
+    // The octant lies across a block face
+    int face_index =
+        fx * (fx0 ? 0 : 1) + fy * (fy0 ? 2 : 3) + fz * (fz0 ? 4 : 5);
+    int face = bdata->block_face_conn[6 * block_owner + face_index];
+    int face_id = bdata->block_face_ids[6 * block_owner + face_index];
+
+    // Get the u/v coordinates for this octant on the owner face
+    int32_t u, v;
+    if (face_index < 2) {  // x-face
+      get_face_oct_coords(face_id, h, q->y, q->z, &u, &v);
+    } else if (face_index < 4) {  // y-face
+      get_face_oct_coords(face_id, h, q->x, q->z, &u, &v);
+    } else {  // z-face
+      get_face_oct_coords(face_id, h, q->x, q->y, &u, &v);
+    }
+
+    for (int ip = bdata->face_block_ptr[face];
+         ip < bdata->face_block_ptr[face + 1]; ip++) {
+      int block = bdata->face_block_conn[ip] / 6;
+      if (block != block_owner) {
+        int adj_index = bdata->face_block_conn[ip] % 6;
+
+        // Transform the octant to the local coordinates of the
+        // adjacent block
+        face_id = bdata->block_face_ids[6 * block + adj_index];
+        adj[nadj].block = block;
+        adj[nadj].level = q->level;
+        if (adj_index < 2) {
+          adj[nadj].x = (hmax - h) * (adj_index % 2);
+          set_face_oct_coords(face_id, h, u, v, &adj[nadj].y, &adj[nadj].z);
+        } else if (adj_index < 4) {
+          adj[nadj].y = (hmax - h) * (adj_index % 2);
+          set_face_oct_coords(face_id, h, u, v, &adj[nadj].x, &adj[nadj].z);
+        } else {
+          adj[nadj].z = (hmax - h) * (adj_index % 2);
+          set_face_oct_coords(face_id, h, u, v, &adj[nadj].x, &adj[nadj].y);
+        }
+        nadj++;
+      }
+    }
+  } else {
+    // The octant lies within its own block
+    adj[0] = *q;
+    nadj = 1;
+  }
+
+  // Zero the remaining members so that the octants can be searched
+  for (int k = 0; k < nadj; k++) {
+    adj[k].tag = 0;
+    adj[k].info = 0;
+  }
+
+  return nadj;
+}
+
+/*
+  Add the octants that overlap the region r to the neighbor list for
+  the given octant.
+
+  The region r is an octant adjacent to oct, expressed in the
+  coordinates of the block containing oct (it may lie outside the
+  block bounds). The neighbors are found by searching for the
+  octant, or a coarser octant, that contains r in each block that
+  contains r. If r is refined, this function is called recursively
+  for each child of r that touches oct.
+
+  input:
+  hash:    hash table of the local and adjacent octants by position
+  oct:     the octant whose neighbors are sought
+  r:       the region adjacent to the octant
+  start:   the start of the neighbor list for this face/edge/corner
+  adj:     temporary storage for the equivalent block octants
+  len:     the length of the neighbor list
+  max_len: the allocated length of the neighbor list
+*/
+void TMROctForest::addOctantNeighbors(TMROctantHash *hash, TMROctant *oct,
+                                      TMROctant *r, int start, TMROctant *adj,
+                                      int *len, int *max_len) {
+  int nadj = getAdjacentBlockOctants(r, adj);
+
+  int refined = 0;
+  for (int k = 0; k < nadj; k++) {
+    // Search for the octant at the same position as the region,
+    // otherwise search for the coarser octant that contains it
+    TMROctant p = adj[k];
+    TMROctant *t = hash->contains(&p);
+    while (!t && p.level > 0) {
+      TMROctant parent;
+      p.parent(&parent);
+      p = parent;
+      t = hash->contains(&p);
+    }
+
+    // If no octant contains the region, then it must be refined.
+    // Note that the octant at the position of the region may not be
+    // stored on this processor if it does not touch the octant.
+    if (!t || t->level > p.level) {
+      refined = 1;
+    } else {
+      // Add the neighbor if it is not already in the list
+      int index = t->tag;
+      int found = 0;
+      for (int j = start; j < *len; j++) {
+        if (neighbor_list[j] == index) {
+          found = 1;
+          break;
+        }
+      }
+
+      if (!found) {
+        if (*len >= *max_len) {
+          *max_len = 2 * (*max_len);
+          int *temp = new int[*max_len];
+          memcpy(temp, neighbor_list, (*len) * sizeof(int));
+          delete[] neighbor_list;
+          neighbor_list = temp;
+        }
+        neighbor_list[*len] = index;
+        (*len)++;
+      }
+    }
+  }
+
+  // Search the children of the region that touch the octant
+  if (refined && r->level < TMR_MAX_LEVEL) {
+    const int32_t h = 1 << (TMR_MAX_LEVEL - oct->level);
+    const int32_t hc = 1 << (TMR_MAX_LEVEL - r->level - 1);
+
+    for (int id = 0; id < 8; id++) {
+      TMROctant c;
+      c.block = r->block;
+      c.level = r->level + 1;
+      c.x = r->x + ((id & 1) ? hc : 0);
+      c.y = r->y + ((id & 2) ? hc : 0);
+      c.z = r->z + ((id & 4) ? hc : 0);
+
+      // Skip the children on the far side of the region
+      if ((r->x < oct->x && !(id & 1)) || (r->x >= oct->x + h && (id & 1)) ||
+          (r->y < oct->y && !(id & 2)) || (r->y >= oct->y + h && (id & 2)) ||
+          (r->z < oct->z && !(id & 4)) || (r->z >= oct->z + h && (id & 4))) {
+        continue;
+      }
+
+      addOctantNeighbors(hash, oct, &c, start, &adj[nadj], len, max_len);
+    }
+  }
+}
+
+/*
+  Compute the face, edge and corner neighbors of the local octants
+
+  The neighbors are stored in a compressed row format with 26 entries
+  for each local octant: the 6 faces, followed by the 12 edges and
+  the 8 corners. The neighbors of face f of octant i are stored in
+
+  neighbors[ptr[26*i + f]] to neighbors[ptr[26*i + f + 1]]
+
+  while the edge e and corner c neighbors are stored at 26*i + 6 + e
+  and 26*i + 18 + c. The neighbors are the octants that overlap the
+  octant of the same level across the face, edge or corner, including
+  the octants in adjacent blocks. Indices less than the number of
+  local octants refer to local octants, while an index of size + j
+  refers to entry j in the array of adjacent (non-local) octants.
+
+  This requires the adjacent octants, so it can only be called after
+  computeAdjacentOctants().
+*/
+void TMROctForest::computeOctantNeighbors() {
+  if (neighbor_ptr) {
+    delete[] neighbor_ptr;
+  }
+  if (neighbor_list) {
+    delete[] neighbor_list;
+  }
+
+  // Get the local and adjacent octants
+  int size, adj_size = 0;
+  TMROctant *array, *adj_array = NULL;
+  octants->getArray(&array, &size);
+  if (adjacent) {
+    adjacent->getArray(&adj_array, &adj_size);
+  }
+
+  // Hash the octants by position only, storing the index as the tag
+  const int use_node_index = 1;
+  TMROctantHash *hash = new TMROctantHash(use_node_index);
+  for (int i = 0; i < size; i++) {
+    TMROctant t = array[i];
+    t.tag = i;
+    t.info = 0;
+    hash->addOctant(&t);
+  }
+  for (int i = 0; i < adj_size; i++) {
+    TMROctant t = adj_array[i];
+    t.tag = size + i;
+    t.info = 0;
+    hash->addOctant(&t);
+  }
+
+  // Find the maximum number of blocks that share a face, edge or node
+  // to allocate the temporary storage for the equivalent octants
+  int max_adj = 2;
+  for (int i = 0; i < bdata->num_edges; i++) {
+    int n = bdata->edge_block_ptr[i + 1] - bdata->edge_block_ptr[i];
+    if (n > max_adj) {
+      max_adj = n;
+    }
+  }
+  for (int i = 0; i < bdata->num_nodes; i++) {
+    int n = bdata->node_block_ptr[i + 1] - bdata->node_block_ptr[i];
+    if (n > max_adj) {
+      max_adj = n;
+    }
+  }
+  TMROctant *adj = new TMROctant[max_adj * (TMR_MAX_LEVEL + 1)];
+
+  int len = 0;
+  int max_len = 32 * size + 1;
+  neighbor_ptr = new int[26 * size + 1];
+  neighbor_list = new int[max_len];
+
+  for (int i = 0; i < size; i++) {
+    for (int k = 0; k < 26; k++) {
+      neighbor_ptr[26 * i + k] = len;
+
+      // Get the region of the same size across the face/edge/corner
+      TMROctant r;
+      if (k < 6) {
+        array[i].faceNeighbor(k, &r);
+      } else if (k < 18) {
+        array[i].edgeNeighbor(k - 6, &r);
+      } else {
+        array[i].cornerNeighbor(k - 18, &r);
+      }
+      addOctantNeighbors(hash, &array[i], &r, len, adj, &len, &max_len);
+    }
+  }
+  neighbor_ptr[26 * size] = len;
+
+  delete[] adj;
+  delete hash;
+}
+
+/*
+  Retrieve the face, edge and corner neighbors of the local octants
+
+  The neighbors are computed on the first call after the octants are
+  modified, so this call is collective. See computeOctantNeighbors()
+  for the layout of the data.
+
+  output:
+  ptr:        pointer into the neighbor array for each face/edge/corner
+  neighbors:  the neighbor indices
+  adjacent:   the non-local octants referenced by the neighbor indices
+
+  returns:
+  the number of local octants
+*/
+int TMROctForest::getOctantNeighbors(const int **_ptr, const int **_neighbors,
+                                     TMROctantArray **_adjacent) {
+  int size = 0;
+  if (octants) {
+    if (!adjacent) {
+      computeAdjacentOctants();
+    }
+    if (!neighbor_ptr) {
+      computeOctantNeighbors();
+    }
+    octants->getArray(NULL, &size);
+  }
+
+  if (_ptr) {
+    *_ptr = neighbor_ptr;
+  }
+  if (_neighbors) {
+    *_neighbors = neighbor_list;
+  }
+  if (_adjacent) {
+    *_adjacent = adjacent;
+  }
+  return size;
+}
+
+/*
+  Extend the ghost octants to the given number of layers
+
+  The first layer consists of the adjacent octants. Each additional
+  layer requires one round of communication: the octants in the
+  outermost layer are sent to their owners, which reply with the
+  face, edge and corner neighbors of these octants from their own
+  neighbor lists. The neighbors that are not local and are not
+  already ghosts form the next layer. The existing layers are
+  retained, so only the new layers are computed.
+*/
+void TMROctForest::computeGhostOctants(int depth) {
+  if (!adjacent) {
+    computeAdjacentOctants();
+  }
+  if (!neighbor_ptr) {
+    computeOctantNeighbors();
+  }
+
+  // Get the local and adjacent octants
+  int size, adj_size;
+  TMROctant *array, *adj_array;
+  octants->getArray(&array, &size);
+  adjacent->getArray(&adj_array, &adj_size);
+
+  // Find the owners of the adjacent octants
+  int *adj_owners = new int[adj_size];
+  for (int i = 0; i < adj_size; i++) {
+    adj_owners[i] = getOctantMPIOwner(&adj_array[i]);
+  }
+
+  // Copy the existing layers into the new ghost list, or create the
+  // first layer from the adjacent octants. The tag of each ghost
+  // stores its owner.
+  int *layer_ptr = new int[depth + 1];
+  int num_ghosts = 0;
+  int max_ghosts = 2 * adj_size + 1;
+  TMROctant *list = NULL;
+  int start_depth = ghost_depth;
+  if (ghosts) {
+    TMROctant *ghost_array;
+    ghosts->getArray(&ghost_array, &num_ghosts);
+    if (max_ghosts < 2 * num_ghosts) {
+      max_ghosts = 2 * num_ghosts;
+    }
+    list = new TMROctant[max_ghosts];
+    memcpy(list, ghost_array, num_ghosts * sizeof(TMROctant));
+    memcpy(layer_ptr, ghost_layer_ptr, (ghost_depth + 1) * sizeof(int));
+  } else {
+    list = new TMROctant[max_ghosts];
+    for (int i = 0; i < adj_size; i++) {
+      list[i] = adj_array[i];
+      list[i].tag = adj_owners[i];
+    }
+    num_ghosts = adj_size;
+    layer_ptr[0] = 0;
+    layer_ptr[1] = adj_size;
+    start_depth = 1;
+  }
+
+  // Hash the ghosts so that each octant is added only once
+  TMROctantHash *hash = new TMROctantHash();
+  for (int i = 0; i < num_ghosts; i++) {
+    hash->addOctant(&list[i]);
+  }
+
+  int *reply_counts = new int[mpi_size];
+  int *reply_recv_counts = new int[mpi_size];
+
+  for (int layer = start_depth; layer < depth; layer++) {
+    // Send the octants in the outermost layer to their owners
+    int n = layer_ptr[layer] - layer_ptr[layer - 1];
+    TMROctant *req_array = new TMROctant[n];
+    memcpy(req_array, &list[layer_ptr[layer - 1]], n * sizeof(TMROctant));
+    qsort(req_array, n, sizeof(TMROctant), compare_octant_tags);
+    TMROctantArray *req_list = new TMROctantArray(req_array, n);
+
+    int use_tags = 1;
+    int *req_ptr, *req_recv_ptr;
+    TMROctantArray *recv =
+        distributeOctants(req_list, use_tags, &req_ptr, &req_recv_ptr);
+    delete req_list;
+
+    // Collect the neighbors of the requested octants that are not
+    // owned by the requesting processor
+    int recv_size;
+    TMROctant *recv_array;
+    recv->getArray(&recv_array, &recv_size);
+
+    int reply_len = 0;
+    int max_reply = 8 * recv_size + 1;
+    TMROctant *reply = new TMROctant[max_reply];
+    int *reply_ptr = new int[mpi_size + 1];
+    reply_ptr[0] = 0;
+
+    for (int rank = 0; rank < mpi_size; rank++) {
+      for (int i = req_recv_ptr[rank]; i < req_recv_ptr[rank + 1]; i++) {
+        TMROctant *t = octants->contains(&recv_array[i]);
+        if (!t) {
+          continue;
+        }
+        int index = t - array;
+        int jp_end = neighbor_ptr[26 * (index + 1)];
+        for (int jp = neighbor_ptr[26 * index]; jp < jp_end; jp++) {
+          int j = neighbor_list[jp];
+          TMROctant q;
+          if (j < size) {
+            q = array[j];
+            q.tag = mpi_rank;
+          } else {
+            q = adj_array[j - size];
+            q.tag = adj_owners[j - size];
+          }
+          if (q.tag == rank) {
+            continue;
+          }
+
+          // Extend the reply array if required
+          if (reply_len >= max_reply) {
+            max_reply = 2 * max_reply;
+            TMROctant *temp = new TMROctant[max_reply];
+            memcpy(temp, reply, reply_len * sizeof(TMROctant));
+            delete[] reply;
+            reply = temp;
+          }
+          reply[reply_len] = q;
+          reply_len++;
+        }
+      }
+
+      // Sort the reply to this processor and remove duplicates
+      int start = reply_ptr[rank];
+      int count = reply_len - start;
+      qsort(&reply[start], count, sizeof(TMROctant), compare_octant_nodes);
+      int k = start;
+      for (int i = start; i < reply_len; i++) {
+        if (k == start || reply[k - 1].compare(&reply[i]) != 0) {
+          reply[k] = reply[i];
+          k++;
+        }
+      }
+      reply_len = k;
+      reply_ptr[rank + 1] = reply_len;
+      reply_counts[rank] = reply_ptr[rank + 1] - reply_ptr[rank];
+    }
+    delete recv;
+    delete[] req_ptr;
+
+    // Send the neighbors back to the requesting processors
+    TMRExchangeCounts(comm, reply_counts, reply_recv_counts);
+    int *reply_recv_ptr = new int[mpi_size + 1];
+    reply_recv_ptr[0] = 0;
+    for (int i = 0; i < mpi_size; i++) {
+      reply_recv_ptr[i + 1] = reply_recv_ptr[i] + reply_recv_counts[i];
+    }
+
+    TMROctantArray *reply_list = new TMROctantArray(reply, reply_len);
+    TMROctantArray *replies =
+        sendOctants(reply_list, reply_ptr, reply_recv_ptr);
+    delete reply_list;
+    delete[] reply_ptr;
+    delete[] reply_recv_ptr;
+    delete[] req_recv_ptr;
+
+    // Add the octants that are not local and not yet ghosts
+    int num_replies;
+    TMROctant *reply_array;
+    replies->getArray(&reply_array, &num_replies);
+    for (int i = 0; i < num_replies; i++) {
+      if (reply_array[i].tag != mpi_rank &&
+          hash->addOctant(&reply_array[i])) {
+        if (num_ghosts >= max_ghosts) {
+          max_ghosts = 2 * max_ghosts;
+          TMROctant *temp = new TMROctant[max_ghosts];
+          memcpy(temp, list, num_ghosts * sizeof(TMROctant));
+          delete[] list;
+          list = temp;
+        }
+        list[num_ghosts] = reply_array[i];
+        num_ghosts++;
+      }
+    }
+    delete replies;
+
+    // Sort the octants within the new layer
+    int start = layer_ptr[layer];
+    qsort(&list[start], num_ghosts - start, sizeof(TMROctant),
+          compare_octant_nodes);
+    layer_ptr[layer + 1] = num_ghosts;
+  }
+
+  delete hash;
+  delete[] adj_owners;
+  delete[] reply_counts;
+  delete[] reply_recv_counts;
+
+  // Replace the ghost data
+  freeGhostOctants();
+  ghost_depth = depth;
+  ghosts = new TMROctantArray(list, num_ghosts);
+  ghost_layer_ptr = layer_ptr;
+  ghost_owners = new int[num_ghosts];
+  for (int i = 0; i < num_ghosts; i++) {
+    ghost_owners[i] = list[i].tag;
+  }
+}
+
+/*
+  Retrieve the ghost octants up to the given depth
+
+  The ghosts are the non-local octants within depth layers of the
+  local octants, where the first layer consists of the face, edge and
+  corner neighbors of the local octants and each subsequent layer
+  consists of the neighbors of the previous layer. The ghosts are
+  ordered by layer and sorted within each layer, so that the ghosts
+  in layer k + 1 are stored from layer_ptr[k] to layer_ptr[k + 1]
+  and the ghosts up to any depth form a leading subset of the array.
+  The array is not sorted as a whole and must not be sorted. The tag
+  of each ghost is its owner.
+
+  The ghosts are computed when a deeper layer than the existing
+  layers is requested, so this call is collective. The ghosts are
+  retained until the octants or their owners change.
+
+  input:
+  depth:      the number of layers of ghosts
+
+  output:
+  ghosts:     the ghost octants in all computed layers
+  owners:     the owner of each ghost octant
+  layer_ptr:  pointer to the start of each layer within the ghosts
+
+  returns:
+  the number of ghost octants within the given depth
+*/
+int TMROctForest::getGhostOctants(int depth, TMROctantArray **_ghosts,
+                                  const int **_owners,
+                                  const int **_layer_ptr) {
+  int num_ghosts = 0;
+  if (octants && depth > 0) {
+    if (depth > ghost_depth) {
+      computeGhostOctants(depth);
+    }
+    num_ghosts = ghost_layer_ptr[depth];
+  }
+
+  if (_ghosts) {
+    *_ghosts = ghosts;
+  }
+  if (_owners) {
+    *_owners = ghost_owners;
+  }
+  if (_layer_ptr) {
+    *_layer_ptr = ghost_layer_ptr;
+  }
+  return num_ghosts;
+}
+
+/*
+  Compute the dependent nodes (hanging edge/face nodes) on each block
+  and on the interfaces between adjacent blocks.
+
+  The hanging face nodes may occur on any face within the block and
+  are associated with the 4 parallel hanging edge nodes.  Within this
+  code, we only store the corresponding face node and use the
+  associated edges. Edge nodes along block interfaces may be hanging
+  even if there is no associated hanging face node.
+
+  If the octant neighbors have already been computed, they are used
+  in place of searching for the adjacent octants.
+*/
+void TMROctForest::computeDepFacesAndEdges() {
+  const int32_t hmax = 1 << TMR_MAX_LEVEL;
+
+  // Get all of the octants owned by this processor
+  int oct_size;
   TMROctant *octs;
   octants->getArray(&octs, &oct_size);
 
+  // Get the adjacent octants referenced by the neighbor lists (if any)
+  TMROctant *adj_octs = NULL;
+  if (adjacent) {
+    adjacent->getArray(&adj_octs, NULL);
+  }
+
   // Loop over all of the octants
   for (int i = 0; i < oct_size; i++) {
     int face_info = 0, edge_info = 0;
 
-    if (octs[i].level > 0) {
+    if (octs[i].level > 0 && neighbor_ptr) {
+      // Get the child identifier for the current octant
+      int id = octs[i].childId();
+
+      // Check for a neighbor at the level of the parent across each
+      // of the faces and edges that lie on the faces/edges of the
+      // parent
+      for (int k = 0; k < 6; k++) {
+        int index = (k < 3 ? child_id_to_face_index[id][k]
+                           : 6 + child_id_to_edge_index[id][k - 3]);
+        int ptr = neighbor_ptr[26 * i + index];
+        int end = neighbor_ptr[26 * i + index + 1];
+        for (; ptr < end; ptr++) {
+          int n = neighbor_list[ptr];
+          TMROctant *t = (n < oct_size ? &octs[n] : &adj_octs[n - oct_size]);
+          if (t->level == octs[i].level - 1) {
+            if (k < 3) {
+              face_info |= 1 << index;
+            } else {
+              edge_info |= 1 << (index - 6);
+            }
+            break;
+          }
+        }
+      }
+
+      // Encode the result in the info argument
+      octs[i].info = encode_index_to_info(&octs[i], face_info, edge_info);
+    } else if (octs[i].level > 0) {
       // Get the child identifier for the current octant
       int id = octs[i].childId();
 
@@ -4038,6 +6799,10 @@ void TMROctForest::transformNode(TMROctant *oct, int edge_dir,
   }
 }
 
+// The counter used to assign unique node stamps in createNodes(). It is
+// updated atomically since the forests may be created on several threads.
+static int TMR_oct_node_stamp_count = 0;
+
 /*
   Create the nodes from the element mesh
 
@@ -4060,6 +6825,9 @@ void TMROctForest::transformNode(TMROctant *oct, int edge_dir,
   and corners. Finally, the new node numbers are returned to the
   processors that border the octree owners. And lastly, the non-local
   partial octrees are freed.
+
+  The node locations are not evaluated here, but on the first call to
+  getPoints() or getPointComponents().
 */
 void TMROctForest::createNodes() {
   if (!octants) {
@@ -4073,9 +6841,13 @@ void TMROctForest::createNodes() {
     // there is no need to create it a second time.
     return;
   }
+  TMR_PROFILE_BEGIN(TMR_PROFILE_CREATE_NODES);
 
-  // Send/recv the adjacent octants
-  computeAdjacentOctants();
+  // Send/recv the adjacent octants, unless they have already been
+  // computed along with the octant neighbors
+  if (!adjacent) {
+    computeAdjacentOctants();
+  }
 
   // Compute the dependent face nodes
   computeDepFacesAndEdges();
@@ -4122,6 +6894,11 @@ void TMROctForest::createNodes() {
   // Create the local connectivyt based on the node array
   createDependentConn(node_numbers, nodes, node_offset);
 
+  // Add the dependent nodes constrained by the element orders
+  if (elem_orders && mesh_order > 2) {
+    createOrderDependentConn(node_numbers, nodes, node_offset);
+  }
+
   // Loop over all the nodes, check whether they are local (all
   // dependent nodes are dependent)
   const int use_node_index = 1;
@@ -4130,22 +6907,26 @@ void TMROctForest::createNodes() {
   // Add nodes that are externally owned
   nodes->getArray(&node_array, &node_size);
 
-  // Get the MPI owner for each node
+  // Get the MPI owner for each node. Note that the element orders
+  // may constrain only some of the nodes represented by an octant.
   int index = 0;
   for (int i = 0; i < node_size; i++) {
-    // Check if this is a dependent node or not...
-    if (node_numbers[index] >= 0) {
+    int mpi_owner = node_array[i].tag;
+    if (mpi_owner != mpi_rank) {
+      // Label the independent nodes here as owned by another processor
+      int num_indep = 0;
+      for (int k = 0; k < node_array[i].level; k++) {
+        if (node_numbers[index + k] >= 0) {
+          node_numbers[index + k] = -num_dep_nodes - 1;
+          num_indep++;
+        }
+      }
+
       // Send it to the owner processor
-      int mpi_owner = node_array[i].tag;
-      if (mpi_owner != mpi_rank) {
+      if (num_indep > 0) {
         TMROctant node = node_array[i];
         node.tag = mpi_owner;
         ext_nodes->addOctant(&node);
-
-        // Label the nodes here as owned by another processor
-        for (int k = 0; k < node_array[i].level; k++) {
-          node_numbers[index + k] = -num_dep_nodes - 1;
-        }
       }
     }
     index += node_array[i].level;
@@ -4184,6 +6965,9 @@ void TMROctForest::createNodes() {
   // other processors and referenced by the elements on this
   // processor.
   TMROctantArray *ext_array = ext_nodes->toArray();
+  updateMaxMemoryUsage(ext_nodes->getMemoryUsage(),
+                       nodes->getMemoryUsage() + ext_array->getMemoryUsage() +
+                           node_size * sizeof(int));
   delete ext_nodes;
 
   // Sort based on the tags
@@ -4196,9 +6980,10 @@ void TMROctForest::createNodes() {
   // determine their node numbers
   int use_tags = 1;
   int *send_ptr, *recv_ptr;
-  TMROctantArray *dist_nodes = distributeOctants(ext_array, use_tags, &send_ptr,
-                                                 &recv_ptr, use_node_index);
-  delete ext_array;
+  int include_local = 0;
+  TMROctantArray *dist_nodes =
+      distributeOctants(ext_array, use_tags, &send_ptr, &recv_ptr,
+                        include_local, use_node_index, TMROctantNode_MPI_type);
 
   // Loop over the off-processor nodes and search for them in the
   // sorted node list and assign them the correct tag
@@ -4208,31 +6993,41 @@ void TMROctForest::createNodes() {
   for (int i = 0; i < dist_size; i++) {
     TMROctant *t = nodes->contains(&dist_octs[i]);
     if (t) {
-      // Compute the node number
+      // Compute the number of the first independent node
       int index = t - node_array;
-      dist_octs[i].tag = node_numbers[node_offset[index]];
+      int k = 0;
+      while (k < t->level - 1 && node_numbers[node_offset[index] + k] < 0) {
+        k++;
+      }
+      dist_octs[i].tag = node_numbers[node_offset[index] + k];
     }
   }
 
-  // Send the nodes back to the original processors
-  TMROctantArray *return_nodes =
-      sendOctants(dist_nodes, recv_ptr, send_ptr, use_node_index);
+  // Send the node numbers back to the original processors. These are
+  // received in the same order as the external nodes were sent.
+  int *return_tags = sendOctantTags(dist_nodes, recv_ptr, send_ptr);
   delete dist_nodes;
   delete[] recv_ptr;
-  delete[] send_ptr;
 
   // Now go back through and set the external node numbers
-  int return_size;
-  TMROctant *return_octs;
-  return_nodes->getArray(&return_octs, &return_size);
-  for (int i = 0; i < return_size; i++) {
-    TMROctant *t = nodes->contains(&return_octs[i]);
-    for (int k = 0; k < t->level; k++) {
+  for (int rank = 0; rank < mpi_size; rank++) {
+    if (rank == mpi_rank) {
+      continue;
+    }
+    for (int i = send_ptr[rank]; i < send_ptr[rank + 1]; i++) {
+      TMROctant *t = nodes->contains(&ext_octs[i]);
       int index = t - node_array;
-      node_numbers[node_offset[index] + k] = return_octs[i].tag + k;
+      for (int k = 0, j = 0; k < t->level; k++) {
+        if (node_numbers[node_offset[index] + k] == -num_dep_nodes - 1) {
+          node_numbers[node_offset[index] + k] = return_tags[i] + j;
+          j++;
+        }
+      }
     }
   }
-  delete return_nodes;
+  delete[] return_tags;
+  delete[] send_ptr;
+  delete ext_array;
 
   // Free the local node array
   delete nodes;
@@ -4263,59 +7058,331 @@ void TMROctForest::createNodes() {
                              num_local_nodes, sizeof(int), compare_integers);
   ext_pre_offset = item - node_numbers;
 
-  // Evaluate the node locations
-  evaluateNodeLocations();
+  // Defer the evaluation of the node locations until they are first
+  // requested
+  deferred_node_locations = 1;
+  updateMaxMemoryUsage();
+
+  // Mark the new mesh so cached data built from the old one is rejected
+  node_stamp = __sync_add_and_fetch(&TMR_oct_node_stamp_count, 1);
+
+  TMR_PROFILE_OCTANTS(TMR_PROFILE_CREATE_NODES, num_elements);
+  TMR_PROFILE_END(TMR_PROFILE_CREATE_NODES);
 }
 
 /*
-  Create the local nodes and assign their owners
-
-  The ownership rules are as follows:
+  Data used to create the local nodes for a range of the local octants
+*/
+class TMROctCreateNodesThreadData {
+ public:
+  TMROctForest *forest;
+  int start, end;
+  TMROctantArray *nodes;
+};
 
-  1. Dependent nodes are locally owned (this ownership property is
-  assigned in a second step since it can be decided locally)
+/*
+  Create the sorted array of local nodes for the octants
+  array[start:end]. The element nodes are added to the hash before
+  the nodes for the dependent nodes so that their owners take
+  precedence.
+*/
+void *TMROctForest::createNodesThread(void *args) {
+  TMROctCreateNodesThreadData *data =
+      static_cast<TMROctCreateNodesThreadData *>(args);
 
-  2. Independent nodes are owned on processors where the node is
-  created from an element (not just because it is required
-  for a dependent node)
+  const int use_node_index = 1;
+  TMROctantHash *hash = new TMROctantHash(use_node_index);
+  data->forest->addElementNodes(data->start, data->end, hash);
+  data->forest->addDependentNodes(data->start, data->end, hash);
+  data->nodes = hash->toArray();
+  delete hash;
+  data->nodes->sort();
 
-  3. If multiple elements create the same node, its owner is the proc
-  with the lower processor rank
+  return NULL;
+}
 
-  The returns an array of quadrants with the following information:
-  1. tag represents the MPI owner
-  2. info represents the label (node/edge/face)
-  3. level represents the number of nodes represented by the quad
+/*
+  Data used to merge two sorted arrays of nodes
 */
-TMROctantArray *TMROctForest::createLocalNodes() {
-  // Allocate the array of elements
-  int num_elements;
-  TMROctant *octs;
-  octants->getArray(&octs, &num_elements);
+class TMROctMergeNodesThreadData {
+ public:
+  TMROctantArray *a, *b;
+  TMROctantArray *nodes;
+};
 
-  // Create all the nodes/edges/faces
-  const int use_node_index = 1;
-  TMROctantHash *local_nodes = new TMROctantHash(use_node_index);
+/*
+  Merge two sorted arrays of unique nodes into a new sorted array
 
-  // Set the node, edge, face and block labels
-  int node_label, edge_label, face_label, block_label;
-  node_label = edge_label = face_label = block_label = TMR_OCT_NODE_LABEL;
+  When a node is in both arrays, the copy with the larger tag is
+  retained. The nodes created by an element have a non-negative owner
+  while the nodes only added for a dependent node have a negative
+  owner, so the element nodes take precedence as they do when all the
+  nodes are added to a single hash table.
+*/
+static void *merge_nodes_thread(void *args) {
+  TMROctMergeNodesThreadData *data =
+      static_cast<TMROctMergeNodesThreadData *>(args);
+
+  int na, nb;
+  TMROctant *a, *b;
+  data->a->getArray(&a, &na);
+  data->b->getArray(&b, &nb);
+
+  TMROctant *array = new TMROctant[na + nb];
+  int i = 0, j = 0, n = 0;
+  while (i < na && j < nb) {
+    int cmp = a[i].compareNode(&b[j]);
+    if (cmp < 0) {
+      array[n] = a[i];
+      i++;
+    } else if (cmp > 0) {
+      array[n] = b[j];
+      j++;
+    } else {
+      array[n] = (a[i].tag >= b[j].tag ? a[i] : b[j]);
+      i++;
+      j++;
+    }
+    n++;
+  }
+  for (; i < na; i++, n++) {
+    array[n] = a[i];
+  }
+  for (; j < nb; j++, n++) {
+    array[n] = b[j];
+  }
+
+  const int use_node_index = 1, is_sorted = 1;
+  data->nodes = new TMROctantArray(array, n, use_node_index, is_sorted);
+
+  return NULL;
+}
+
+/*
+  Create the local nodes and assign their owners
+
+  The ownership rules are as follows:
+
+  1. Dependent nodes are locally owned (this ownership property is
+  assigned in a second step since it can be decided locally)
+
+  2. Independent nodes are owned on processors where the node is
+  created from an element (not just because it is required
+  for a dependent node)
+
+  3. If multiple elements create the same node, its owner is the proc
+  with the lower processor rank
+
+  The returns an array of quadrants with the following information:
+  1. tag represents the MPI owner
+  2. info represents the label (node/edge/face)
+  3. level represents the number of nodes represented by the quad
+*/
+TMROctantArray *TMROctForest::createLocalNodes() {
+  int num_elements;
+  octants->getArray(NULL, &num_elements);
+
+  // Create all the nodes/edges/faces
+  const int use_node_index = 1;
+  TMROctantArray *nodes = NULL;
+
+  // Create the nodes for contiguous ranges of the octants in separate
+  // threads
+  int nthreads = num_threads;
+  if (nthreads > num_elements) {
+    nthreads = (num_elements > 0 ? num_elements : 1);
+  }
+
+  if (nthreads > 1) {
+    TMROctCreateNodesThreadData *data =
+        new TMROctCreateNodesThreadData[nthreads];
+    pthread_t *threads = new pthread_t[nthreads];
+    for (int k = 0; k < nthreads; k++) {
+      data[k].forest = this;
+      data[k].start = (int)(((long int)k * num_elements) / nthreads);
+      data[k].end = (int)(((long int)(k + 1) * num_elements) / nthreads);
+      data[k].nodes = NULL;
+      pthread_create(&threads[k], NULL, TMROctForest::createNodesThread,
+                     (void *)&data[k]);
+    }
+    for (int k = 0; k < nthreads; k++) {
+      pthread_join(threads[k], NULL);
+    }
+
+    // Merge pairs of the sorted node arrays in parallel until a
+    // single array remains
+    TMROctantArray **lists = new TMROctantArray *[nthreads];
+    for (int k = 0; k < nthreads; k++) {
+      lists[k] = data[k].nodes;
+    }
+    delete[] data;
+
+    int nlists = nthreads;
+    TMROctMergeNodesThreadData *merge = new TMROctMergeNodesThreadData[nlists];
+    while (nlists > 1) {
+      int npairs = nlists / 2;
+      for (int k = 0; k < npairs; k++) {
+        merge[k].a = lists[2 * k];
+        merge[k].b = lists[2 * k + 1];
+        merge[k].nodes = NULL;
+      }
+      if (npairs > 1) {
+        for (int k = 0; k < npairs; k++) {
+          pthread_create(&threads[k], NULL, merge_nodes_thread,
+                         (void *)&merge[k]);
+        }
+        for (int k = 0; k < npairs; k++) {
+          pthread_join(threads[k], NULL);
+        }
+      } else {
+        merge_nodes_thread((void *)&merge[0]);
+      }
+
+      for (int k = 0; k < npairs; k++) {
+        delete lists[2 * k];
+        delete lists[2 * k + 1];
+        lists[k] = merge[k].nodes;
+      }
+      if (nlists % 2 == 1) {
+        lists[npairs] = lists[nlists - 1];
+      }
+      nlists = npairs + nlists % 2;
+    }
+    nodes = lists[0];
+
+    delete[] merge;
+    delete[] lists;
+    delete[] threads;
+  } else {
+    // Add the nodes from the local elements, followed by the
+    // independent nodes that the dependent nodes rely on
+    TMROctantHash *local_nodes = new TMROctantHash(use_node_index);
+    addElementNodes(0, num_elements, local_nodes);
+    addDependentNodes(0, num_elements, local_nodes);
+
+    // Now the local_nodes hash table contains all of the nodes
+    // (dependent, indepdnent and non-local) that are referenced by this
+    // processor
+    nodes = local_nodes->toArray();
+    delete local_nodes;
+    nodes->sort();
+  }
+
+  // Now, determine the node ownership - if nodes that are not
+  // dependent on this processor
+  int use_tags = 0, include_local = 0;
+  int *send_ptr, *recv_ptr;
+  TMROctantArray *recv_nodes = distributeOctants(
+      nodes, use_tags, &send_ptr, &recv_ptr, include_local, use_node_index);
+
+  // Create a unique list of the nodes sent to this processor
+  TMROctantArray *recv_sorted = recv_nodes->duplicate();
+  recv_sorted->sort();
+
+  // Now loop over nodes sent from other processors and decide which
+  // processor owns the node.
+  int recv_size;
+  TMROctant *recv_array;
+  recv_nodes->getArray(&recv_array, &recv_size);
+
+  // Loop over all the nodes and see if they have a donor element from
+  // another processor that is not from a dependent node relationship
+  for (int i = 0; i < recv_size; i++) {
+    // This is the processor that donates
+    if (recv_array[i].tag >= 0) {
+      TMROctant *t = recv_sorted->contains(&recv_array[i]);
+      if (t->tag < 0) {
+        // t is not the owner, it is defined from a dependent edge
+        t->tag = recv_array[i].tag;
+      } else {  // t->tag >= 0
+        // *t is not the owner since it has a higher rank than the
+        // other, equivalent node -- re-assign the node number
+        if (recv_array[i].tag < t->tag) {
+          t->tag = recv_array[i].tag;
+        }
+      }
+    }
+  }
+
+  // Now search and make consistent the owners and the internal
+  // nodes on this processor
+  int sorted_size;
+  TMROctant *sorted_array;
+  recv_sorted->getArray(&sorted_array, &sorted_size);
+  for (int i = 0; i < sorted_size; i++) {
+    TMROctant *t = nodes->contains(&sorted_array[i]);
+    // Note that even though these nodes are mapped to this processor,
+    // they may not be defined on it for some corner cases...
+    if (t) {
+      if (t->tag < 0) {
+        t->tag = sorted_array[i].tag;
+      } else if (sorted_array[i].tag < 0) {
+        sorted_array[i].tag = t->tag;
+      } else if (t->tag < sorted_array[i].tag) {
+        sorted_array[i].tag = t->tag;
+      } else {
+        t->tag = sorted_array[i].tag;
+      }
+    }
+  }
+
+  // Make the return nodes consistent with the sorted list that is
+  // unique
+  for (int i = 0; i < recv_size; i++) {
+    // This is the processor that donates from an owner
+    TMROctant *t = recv_sorted->contains(&recv_array[i]);
+    recv_array[i].tag = t->tag;
+  }
+
+  delete recv_sorted;
+
+  // Return the owner ranks back to the senders. These are received in
+  // the same order as the nodes were sent, leaving a gap for the nodes
+  // that are processor-local.
+  int *owner_tags = sendOctantTags(recv_nodes, recv_ptr, send_ptr);
+  delete recv_nodes;
+  delete[] recv_ptr;
+
+  // Go through the nodes and assign the MPI owner
+  int node_size;
+  TMROctant *node_array;
+  nodes->getArray(&node_array, &node_size);
+  for (int rank = 0; rank < mpi_size; rank++) {
+    if (rank != mpi_rank) {
+      for (int i = send_ptr[rank]; i < send_ptr[rank + 1]; i++) {
+        node_array[i].tag = owner_tags[i];
+      }
+    }
+  }
+  delete[] owner_tags;
+  delete[] send_ptr;
+
+  // Return the owners for each node
+  return nodes;
+}
+
+/*
+  Add the nodes of the local octants array[start:end] to the hash
+
+  The nodes are labeled with this processor as the owner.
+*/
+void TMROctForest::addElementNodes(int start, int end, TMROctantHash *hash) {
+  TMROctant *octs;
+  octants->getArray(&octs, NULL);
 
+  // Set the node, edge, face and block labels
   int label_type[4];
-  // If the mesh order is high enough, we will have multiple nodes
-  // per edge/face
   initLabel(mesh_order, interp_type, label_type);
-
-  node_label = label_type[0];
-  edge_label = label_type[1];
-  face_label = label_type[2];
-  block_label = label_type[3];
+  const int node_label = label_type[0];
+  const int edge_label = label_type[1];
+  const int face_label = label_type[2];
+  const int block_label = label_type[3];
 
   // Set the node locations
   if (mesh_order == 2) {
     // First add all the nodes from the local elements on this
     // processor
-    for (int i = 0; i < num_elements; i++) {
+    for (int i = start; i < end; i++) {
       const int32_t h = 1 << (TMR_MAX_LEVEL - octs[i].level);
       for (int kk = 0; kk < 2; kk++) {
         for (int jj = 0; jj < 2; jj++) {
@@ -4329,13 +7396,13 @@ TMROctantArray *TMROctForest::createLocalNodes() {
             node.tag = mpi_rank;
             node.info = node_label;
             transformNode(&node);
-            local_nodes->addOctant(&node);
+            hash->addOctant(&node);
           }
         }
       }
     }
   } else {
-    for (int i = 0; i < num_elements; i++) {
+    for (int i = start; i < end; i++) {
       const int32_t h = 1 << (TMR_MAX_LEVEL - octs[i].level - 1);
       for (int kk = 0; kk < 3; kk++) {
         for (int jj = 0; jj < 3; jj++) {
@@ -4366,15 +7433,36 @@ TMROctantArray *TMROctForest::createLocalNodes() {
             }
             node.tag = mpi_rank;
             transformNode(&node);
-            local_nodes->addOctant(&node);
+            hash->addOctant(&node);
           }
         }
       }
     }
   }
+}
+
+/*
+  Add the independent nodes that the dependent nodes of the local
+  octants array[start:end] rely on to the hash
+
+  These nodes are labeled with a negative owner. A node that is also
+  created by an element must be added to the hash after the element
+  nodes so that the owner from the element is retained.
+*/
+void TMROctForest::addDependentNodes(int start, int end,
+                                     TMROctantHash *hash) {
+  TMROctant *octs;
+  octants->getArray(&octs, NULL);
+
+  // Set the node, edge, face and block labels
+  int label_type[4];
+  initLabel(mesh_order, interp_type, label_type);
+  const int node_label = label_type[0];
+  const int edge_label = label_type[1];
+  const int face_label = label_type[2];
 
   // Add the independent nodes that the dependent nodes rely on
-  for (int i = 0; i < num_elements; i++) {
+  for (int i = start; i < end; i++) {
     // Add the external nodes from dependent edges
     if (octs[i].info) {
       // Decode the information about the dependent edge/faces for
@@ -4416,7 +7504,7 @@ TMROctantArray *TMROctForest::createLocalNodes() {
               node.info = node_label;
               node.level = 1;
               transformNode(&node);
-              local_nodes->addOctant(&node);
+              hash->addOctant(&node);
             }
           }
         }
@@ -4450,7 +7538,7 @@ TMROctantArray *TMROctForest::createLocalNodes() {
                 node.level = mesh_order - 2;
               }
               transformNode(&node);
-              local_nodes->addOctant(&node);
+              hash->addOctant(&node);
             }
           }
         }
@@ -4483,7 +7571,7 @@ TMROctantArray *TMROctForest::createLocalNodes() {
                 node.info = node_label;
                 node.level = 1;
                 transformNode(&node);
-                local_nodes->addOctant(&node);
+                hash->addOctant(&node);
               }
             }
           }
@@ -4522,7 +7610,7 @@ TMROctantArray *TMROctForest::createLocalNodes() {
                   node.level = (mesh_order - 2) * (mesh_order - 2);
                 }
                 transformNode(&node);
-                local_nodes->addOctant(&node);
+                hash->addOctant(&node);
               }
             }
           }
@@ -4530,113 +7618,28 @@ TMROctantArray *TMROctForest::createLocalNodes() {
       }
     }
   }
+}
 
-  // Now the local_nodes hash table contains all of the nodes
-  // (dependent, indepdnent and non-local) that are referenced by this
-  // processor
-  TMROctantArray *nodes = local_nodes->toArray();
-  delete local_nodes;
-  nodes->sort();
-
-  // Now, determine the node ownership - if nodes that are not
-  // dependent on this processor
-  int use_tags = 0, include_local = 0;
-  int *send_ptr, *recv_ptr;
-  TMROctantArray *recv_nodes = distributeOctants(
-      nodes, use_tags, &send_ptr, &recv_ptr, include_local, use_node_index);
-
-  // Create a unique list of the nodes sent to this processor
-  TMROctantArray *recv_sorted = recv_nodes->duplicate();
-  recv_sorted->sort();
-
-  // Now loop over nodes sent from other processors and decide which
-  // processor owns the node.
-  int recv_size;
-  TMROctant *recv_array;
-  recv_nodes->getArray(&recv_array, &recv_size);
-
-  // Loop over all the nodes and see if they have a donor element from
-  // another processor that is not from a dependent node relationship
-  for (int i = 0; i < recv_size; i++) {
-    // This is the processor that donates
-    if (recv_array[i].tag >= 0) {
-      TMROctant *t = recv_sorted->contains(&recv_array[i]);
-      if (t->tag < 0) {
-        // t is not the owner, it is defined from a dependent edge
-        t->tag = recv_array[i].tag;
-      } else {  // t->tag >= 0
-        // *t is not the owner since it has a higher rank than the
-        // other, equivalent node -- re-assign the node number
-        if (recv_array[i].tag < t->tag) {
-          t->tag = recv_array[i].tag;
-        }
-      }
-    }
-  }
-
-  // Now search and make consistent the owners and the internal
-  // nodes on this processor
-  int sorted_size;
-  TMROctant *sorted_array;
-  recv_sorted->getArray(&sorted_array, &sorted_size);
-  for (int i = 0; i < sorted_size; i++) {
-    TMROctant *t = nodes->contains(&sorted_array[i]);
-    // Note that even though these nodes are mapped to this processor,
-    // they may not be defined on it for some corner cases...
-    if (t) {
-      if (t->tag < 0) {
-        t->tag = sorted_array[i].tag;
-      } else if (sorted_array[i].tag < 0) {
-        sorted_array[i].tag = t->tag;
-      } else if (t->tag < sorted_array[i].tag) {
-        sorted_array[i].tag = t->tag;
-      } else {
-        t->tag = sorted_array[i].tag;
-      }
-    }
-  }
-
-  // Make the return nodes consistent with the sorted list that is
-  // unique
-  for (int i = 0; i < recv_size; i++) {
-    // This is the processor that donates from an owner
-    TMROctant *t = recv_sorted->contains(&recv_array[i]);
-    recv_array[i].tag = t->tag;
-  }
-
-  delete recv_sorted;
-
-  // Adjust the send_ptr array since there will be a gap
-  // for the octants that are processor-local
-  int offset = send_ptr[mpi_rank + 1] - send_ptr[mpi_rank];
-  for (int i = mpi_rank + 1; i <= mpi_size; i++) {
-    send_ptr[i] -= offset;
-  }
-
-  // Return the nodes back to the senders with the new owner
-  // information attached
-  TMROctantArray *owner_nodes =
-      sendOctants(recv_nodes, recv_ptr, send_ptr, use_node_index);
-  delete recv_nodes;
-  delete[] recv_ptr;
-  delete[] send_ptr;
-
-  // Go trhough the owner nodes and assign the MPI owner
-  int owner_size;
-  TMROctant *owner_array;
-  owner_nodes->getArray(&owner_array, &owner_size);
-
-  for (int i = 0; i < owner_size; i++) {
-    // Get the owner of the node on this processor
-    TMROctant *t = nodes->contains(&owner_array[i]);
-
-    // Assign the MPI owner rank
-    t->tag = owner_array[i].tag;
-  }
-  delete owner_nodes;
+/*
+  Data used to compute the local connectivity for a range of octants
+*/
+class TMROctLocalConnThreadData {
+ public:
+  TMROctForest *forest;
+  TMROctantArray *nodes;
+  const int *node_offset;
+  int start, end;
+};
 
-  // Return the owners for each node
-  return nodes;
+/*
+  Compute the local connectivity for the octants array[start:end]
+*/
+void *TMROctForest::localConnThread(void *args) {
+  TMROctLocalConnThreadData *data =
+      static_cast<TMROctLocalConnThreadData *>(args);
+  data->forest->addLocalConn(data->nodes, data->node_offset, data->start,
+                             data->end);
+  return NULL;
 }
 
 /*
@@ -4654,41 +7657,73 @@ TMROctantArray *TMROctForest::createLocalNodes() {
   which depends on the order of the mesh.
 
   input:
-  nodes:        the array of octants that represent nodes
+  nodes:        the sorted array of octants that represent nodes
   node_offset:  the array of offsets for each node
 */
 void TMROctForest::createLocalConn(TMROctantArray *nodes,
                                    const int *node_offset) {
   // Retrieve the octants on this processor
   int num_elements;
-  TMROctant *octs;
-  octants->getArray(&octs, &num_elements);
-
-  // Retrieve the nodes
-  int node_size;
-  TMROctant *node_array;
-  nodes->getArray(&node_array, &node_size);
+  octants->getArray(NULL, &num_elements);
 
-  // Set the node, edge, face and block labels
-  int node_label, edge_label, face_label, block_label;
-  node_label = edge_label = face_label = block_label = TMR_OCT_NODE_LABEL;
+  // Allocate the connectivity
+  int size = mesh_order * mesh_order * mesh_order * num_elements;
+  conn = new int[size];
+  memset(conn, 0, size * sizeof(int));
 
-  int label_type[4];
-  // If the mesh order is high enough, we will have multiple nodes
-  // per edge/face
-  initLabel(mesh_order, interp_type, label_type);
+  // Compute the connectivity for contiguous ranges of the octants in
+  // separate threads
+  int nthreads = num_threads;
+  if (nthreads > num_elements) {
+    nthreads = (num_elements > 0 ? num_elements : 1);
+  }
+
+  if (nthreads > 1) {
+    TMROctLocalConnThreadData *data = new TMROctLocalConnThreadData[nthreads];
+    pthread_t *threads = new pthread_t[nthreads];
+    for (int k = 0; k < nthreads; k++) {
+      data[k].forest = this;
+      data[k].nodes = nodes;
+      data[k].node_offset = node_offset;
+      data[k].start = (int)(((long int)k * num_elements) / nthreads);
+      data[k].end = (int)(((long int)(k + 1) * num_elements) / nthreads);
+      pthread_create(&threads[k], NULL, TMROctForest::localConnThread,
+                     (void *)&data[k]);
+    }
+    for (int k = 0; k < nthreads; k++) {
+      pthread_join(threads[k], NULL);
+    }
+    delete[] data;
+    delete[] threads;
+  } else {
+    addLocalConn(nodes, node_offset, 0, num_elements);
+  }
+}
 
-  node_label = label_type[0];
-  edge_label = label_type[1];
-  face_label = label_type[2];
-  block_label = label_type[3];
+/*
+  Set the local connectivity of the octants array[start:end]
 
-  // Allocate the connectivity
-  int size = mesh_order * mesh_order * mesh_order * num_elements;
-  conn = new int[size];
-  memset(conn, 0, size * sizeof(int));
+  The nodes must be sorted. Each octant writes only to its own entries
+  in the connectivity array.
+*/
+void TMROctForest::addLocalConn(TMROctantArray *nodes, const int *node_offset,
+                                int start, int end) {
+  TMROctant *octs;
+  octants->getArray(&octs, NULL);
 
-  for (int i = 0; i < num_elements; i++) {
+  // Retrieve the nodes
+  TMROctant *node_array;
+  nodes->getArray(&node_array, NULL);
+
+  // Set the node, edge, face and block labels
+  int label_type[4];
+  initLabel(mesh_order, interp_type, label_type);
+  const int node_label = label_type[0];
+  const int edge_label = label_type[1];
+  const int face_label = label_type[2];
+  const int block_label = label_type[3];
+
+  for (int i = start; i < end; i++) {
     int *c = &conn[mesh_order * mesh_order * mesh_order * i];
     const int32_t h = 1 << (TMR_MAX_LEVEL - octs[i].level - 1);
 
@@ -5519,161 +8554,898 @@ void TMROctForest::createDependentConn(const int *node_nums,
 }
 
 /*
-  Evaluate the node locations based on the parametric locations
+  Get the effective order of an element within a mesh of the given
+  order. The nodes that remain independent for an order are selected
+  symmetrically from the nodes along each direction so that the
+  selection does not depend on the orientation of the edge or face.
+  This is not possible for an odd order when the mesh order is even,
+  so these orders are increased by one.
 */
-void TMROctForest::evaluateNodeLocations() {
-  // Allocate the array of locally owned nodes
-  X = new TMRPoint[num_local_nodes];
-  memset(X, 0, num_local_nodes * sizeof(TMRPoint));
+static int get_effective_order(int mesh_order, int order) {
+  if (order < 2) {
+    order = 2;
+  } else if (order > mesh_order) {
+    order = mesh_order;
+  }
+  if (order % 2 == 1 && mesh_order % 2 == 0) {
+    order++;
+  }
+  return order;
+}
 
-  int *flags = new int[num_local_nodes];
-  memset(flags, 0, num_local_nodes * sizeof(int));
+/*
+  Select the indices of the nodes along a direction that remain
+  independent for the given order. The selection includes both ends,
+  is symmetric and is as close to evenly spaced as possible.
+*/
+static void get_order_subset(int mesh_order, int order, int *subset) {
+  for (int k = 0; 2 * k < order; k++) {
+    if (2 * k + 1 == order) {
+      subset[k] = (mesh_order - 1) / 2;
+    } else {
+      subset[k] =
+          (2 * k * (mesh_order - 1) + order - 1) / (2 * (order - 1));
+      subset[order - 1 - k] = mesh_order - 1 - subset[k];
+    }
+  }
+}
+
+/*
+  The data used to apply the constraints from the element orders to
+  the nodes of a line, face or element
+
+  For each order less than the mesh order, the tables store the
+  indices of the independent nodes along a direction, a flag
+  indicating whether each node is independent, and the weights of the
+  interpolation from the independent nodes to each node.
+*/
+class TMROrderConstraints {
+ public:
+  TMROrderConstraints(int _op, int _mesh_order, const double *knots,
+                      const int *_node_orders, int *_node_nums,
+                      int _num_dep_nodes) {
+    op = _op;
+    mesh_order = _mesh_order;
+    node_orders = _node_orders;
+    node_nums = _node_nums;
+    num_dep_nodes = _num_dep_nodes;
+    order_ptr = NULL;
+    order_conn = NULL;
+    order_weights = NULL;
+
+    const int n = mesh_order;
+    subset = new int[(n + 1) * n];
+    in_subset = new int[(n + 1) * n];
+    weights = new double[(n + 1) * n * n];
+    memset(in_subset, 0, (n + 1) * n * sizeof(int));
+
+    double sub_knots[TMROctForest::MAX_ORDER];
+    for (int q = 2; q <= n; q++) {
+      get_order_subset(n, q, &subset[q * n]);
+      for (int k = 0; k < q; k++) {
+        in_subset[q * n + subset[q * n + k]] = 1;
+        sub_knots[k] = knots[subset[q * n + k]];
+      }
+      for (int a = 0; a < n; a++) {
+        lagrange_shape_functions(q, knots[a], sub_knots,
+                                 &weights[(q * n + a) * n]);
+      }
+    }
+  }
+  ~TMROrderConstraints() {
+    delete[] subset;
+    delete[] in_subset;
+    delete[] weights;
+  }
+
+  // The operation and the mesh order
+  int op, mesh_order;
+
+  // The order for each local node and the local node numbers
+  const int *node_orders;
+  int *node_nums;
+
+  // The number of dependent nodes from the level transitions, which
+  // are numbered before the nodes constrained by the element orders
+  int num_dep_nodes;
+
+  // The rows for the nodes constrained by the element orders
+  int *order_ptr, *order_conn;
+  double *order_weights;
+
+  // The tables for each order
+  int *subset, *in_subset;
+  double *weights;
+};
+
+/*
+  Apply the constraints from the element orders to a grid of local
+  node numbers with mesh_order nodes along each of dim directions
+
+  A node is constrained when its index along any of the directions
+  within the edge, face or element that contains it is not one of the
+  independent indices for the order of that edge, face or element. It
+  is then interpolated from the nodes at the independent indices along
+  these directions. The constraints only depend on the order and not
+  on the orientation of the grid.
+*/
+static void add_grid_order_constraints(TMROrderConstraints *data, int dim,
+                                       const int *grid) {
+  const int n = data->mesh_order;
+  int size = n;
+  if (dim == 2) {
+    size = n * n;
+  } else if (dim == 3) {
+    size = n * n * n;
+  }
+
+  for (int j = 0; j < size; j++) {
+    const int node = grid[j];
+    const int q = data->node_orders[node];
+    if (q >= n) {
+      continue;
+    }
+
+    // Find the directions within the edge, face or element and
+    // check whether the node is constrained
+    int c[3], dirs[3];
+    c[0] = j % n;
+    c[1] = (j / n) % n;
+    c[2] = j / (n * n);
+    int nfree = 0, constrained = 0;
+    for (int d = 0; d < dim; d++) {
+      if (c[d] > 0 && c[d] < n - 1) {
+        dirs[nfree] = d;
+        nfree++;
+        if (!data->in_subset[q * n + c[d]]) {
+          constrained = 1;
+        }
+      }
+    }
+    if (!constrained) {
+      continue;
+    }
+
+    if (data->op == TMR_ORDER_LABEL) {
+      // Label the node unless it is already dependent
+      if (data->node_nums[node] >= 0) {
+        data->node_nums[node] = -data->num_dep_nodes - 1;
+      }
+      continue;
+    }
+
+    // Skip the nodes that are dependent on the coarser level
+    int index = -data->node_nums[node] - 1;
+    if (index < data->num_dep_nodes) {
+      continue;
+    }
+
+    int len = 1;
+    for (int f = 0; f < nfree; f++) {
+      len *= q;
+    }
+
+    if (data->op == TMR_ORDER_COUNT) {
+      data->order_ptr[index + 1] = len;
+    } else {
+      int ptr = data->order_ptr[index];
+      for (int k = 0; k < len; k++) {
+        int cs[3] = {c[0], c[1], c[2]};
+        double w = 1.0;
+        for (int f = 0, kk = k; f < nfree; f++, kk /= q) {
+          const int d = dirs[f];
+          cs[d] = data->subset[q * n + kk % q];
+          w *= data->weights[(q * n + c[d]) * n + kk % q];
+        }
+        data->order_conn[ptr + k] = grid[cs[0] + cs[1] * n + cs[2] * n * n];
+        data->order_weights[ptr + k] = w;
+      }
+    }
+  }
+}
+
+/*
+  Compute the order associated with each local node
+
+  The order of a node on the interior of an edge or face is the
+  minimum effective order of the elements that share the edge or face
+  on all processors, while the order of a node on the interior of an
+  element is the order of the element. The minimum is reduced at the
+  owner of each node and returned to the processors that reference it.
+
+  input:
+  nodes:        the sorted array of nodes
+  node_offset:  the offset to the local node numbers
+
+  returns:
+  the order of each local node
+*/
+int *TMROctForest::computeNodeOrders(TMROctantArray *nodes,
+                                     const int *node_offset) {
+  int num_elements;
+  octants->getArray(NULL, &num_elements);
+
+  int node_size;
+  TMROctant *node_array;
+  nodes->getArray(&node_array, &node_size);
+
+  // Find the minimum order of the local elements that contain each
+  // of the local nodes
+  int *node_orders = new int[num_local_nodes];
+  for (int i = 0; i < num_local_nodes; i++) {
+    node_orders[i] = mesh_order;
+  }
+  const int size = mesh_order * mesh_order * mesh_order;
+  for (int i = 0; i < num_elements; i++) {
+    const int order = get_effective_order(mesh_order, elem_orders[i]);
+    const int *c = &conn[size * i];
+    for (int j = 0; j < size; j++) {
+      if (order < node_orders[c[j]]) {
+        node_orders[c[j]] = order;
+      }
+    }
+  }
+
+  // Find the order of each node octant and count the octants owned by
+  // other processors
+  int *oct_orders = new int[node_size];
+  int num_ext = 0;
+  for (int i = 0; i < node_size; i++) {
+    oct_orders[i] = mesh_order;
+    for (int k = 0; k < node_array[i].level; k++) {
+      if (node_orders[node_offset[i] + k] < oct_orders[i]) {
+        oct_orders[i] = node_orders[node_offset[i] + k];
+      }
+    }
+    if (node_array[i].tag != mpi_rank) {
+      num_ext++;
+    }
+  }
+
+  // Send the orders to the owners of the nodes, stored in the level
+  TMROctant *ext_octs = new TMROctant[num_ext];
+  for (int i = 0, j = 0; i < node_size; i++) {
+    if (node_array[i].tag != mpi_rank) {
+      ext_octs[j] = node_array[i];
+      ext_octs[j].level = oct_orders[i];
+      j++;
+    }
+  }
+  qsort(ext_octs, num_ext, sizeof(TMROctant), compare_octant_tags);
+  TMROctantArray *ext_array = new TMROctantArray(ext_octs, num_ext);
+
+  const int use_tags = 1, include_local = 0, use_node_index = 1;
+  int *send_ptr, *recv_ptr;
+  TMROctantArray *dist_nodes =
+      distributeOctants(ext_array, use_tags, &send_ptr, &recv_ptr,
+                        include_local, use_node_index, TMROctant_MPI_type);
+
+  // Reduce the orders at the owner
+  int dist_size;
+  TMROctant *dist_octs;
+  dist_nodes->getArray(&dist_octs, &dist_size);
+  for (int i = 0; i < dist_size; i++) {
+    TMROctant *t = nodes->contains(&dist_octs[i]);
+    if (t && dist_octs[i].level < oct_orders[t - node_array]) {
+      oct_orders[t - node_array] = dist_octs[i].level;
+    }
+  }
+
+  // Return the minimum orders to the processors that sent them
+  for (int i = 0; i < dist_size; i++) {
+    TMROctant *t = nodes->contains(&dist_octs[i]);
+    dist_octs[i].tag = (t ? oct_orders[t - node_array] : mesh_order);
+  }
+  int *return_orders = sendOctantTags(dist_nodes, recv_ptr, send_ptr);
+  delete dist_nodes;
+  delete[] recv_ptr;
+
+  for (int rank = 0; rank < mpi_size; rank++) {
+    if (rank == mpi_rank) {
+      continue;
+    }
+    for (int i = send_ptr[rank]; i < send_ptr[rank + 1]; i++) {
+      TMROctant *t = nodes->contains(&ext_octs[i]);
+      oct_orders[t - node_array] = return_orders[i];
+    }
+  }
+  delete[] return_orders;
+  delete[] send_ptr;
+  delete ext_array;
+
+  // Set the order of the nodes from the order of their octant. The
+  // nodes on the interior of an element keep the element order.
+  for (int i = 0; i < node_size; i++) {
+    for (int k = 0; k < node_array[i].level; k++) {
+      node_orders[node_offset[i] + k] = oct_orders[i];
+    }
+  }
+  delete[] oct_orders;
+
+  return node_orders;
+}
+
+/*
+  Apply the constraints from the element orders to the nodes of the
+  local elements and to the nodes of the parent edges and faces that
+  the dependent nodes on the level transitions reference.
+
+  The parent edges and faces are included since their nodes may be
+  constrained by the order of elements on other processors.
+*/
+void TMROctForest::applyOrderConstraints(
+    int op, TMROctantArray *nodes, const int *node_offset,
+    const int *node_orders, int *node_nums, int num_level_dep_nodes,
+    int *order_ptr, int *order_conn, double *order_weights) {
+  TMROrderConstraints data(op, mesh_order, interp_knots, node_orders,
+                           node_nums, num_level_dep_nodes);
+  data.order_ptr = order_ptr;
+  data.order_conn = order_conn;
+  data.order_weights = order_weights;
 
   int num_elements;
   TMROctant *octs;
   octants->getArray(&octs, &num_elements);
 
-  // Set the knots to use in the interpolation
-  const double *knots = interp_knots;
+  int *grid = new int[mesh_order * mesh_order];
+  const int size = mesh_order * mesh_order * mesh_order;
+  for (int i = 0; i < num_elements; i++) {
+    add_grid_order_constraints(&data, 3, &conn[size * i]);
 
-  if (topo && (interp_type == TMR_BERNSTEIN_POINTS && mesh_order > 2)) {
-    // Form the interpolating matrix
-    int size = mesh_order * mesh_order * mesh_order;
-    double *interp = new double[size * size];
+    if (octs[i].info) {
+      int face_info, edge_info;
+      decode_index_from_info(&octs[i], octs[i].info, &face_info, &edge_info);
 
-    // For each point within the mesh, evaluate the shape functions
-    for (int i = 0; i < size; i++) {
-      double pt[3];
-      pt[0] = knots[i % mesh_order];
-      pt[1] = knots[(i % mesh_order * mesh_order) / mesh_order];
-      pt[2] = knots[i / (mesh_order * mesh_order)];
+      TMROctant parent;
+      octs[i].parent(&parent);
 
-      // Evaluate the interpolant
-      evalInterp(pt, &interp[size * i]);
+      for (int edge_index = 0; edge_index < 12; edge_index++) {
+        if (edge_info & 1 << edge_index) {
+          getEdgeNodes(&parent, edge_index, nodes, node_offset, grid);
+          add_grid_order_constraints(&data, 1, grid);
+        }
+      }
+      for (int face_index = 0; face_index < 6; face_index++) {
+        if (face_info & 1 << face_index) {
+          getFaceNodes(&parent, face_index, nodes, node_offset, grid);
+          add_grid_order_constraints(&data, 2, grid);
+        }
+      }
     }
+  }
 
-    // Compute the inverse for interpolation
-    int info = 0;
-    int *ipiv = new int[size];
-    TmrLAPACKdgetrf(&size, &size, interp, &size, ipiv, &info);
+  delete[] grid;
+}
 
-    // Apply the factoriziation to the inverse
-    double *inverse = new double[size * size];
-    memset(inverse, 0, size * size * sizeof(double));
-    for (int i = 0; i < size; i++) {
-      inverse[(size + 1) * i] = 1.0;
+/*
+  Add the dependent nodes constrained by the element orders
+
+  This is called after the dependent nodes on the transitions between
+  levels have been numbered and their connectivity has been created.
+  The independent nodes constrained by the element orders are labeled
+  and numbered after these dependent nodes.
+
+  The constrained nodes are interpolated from nodes that may
+  themselves be dependent, either on a coarser level or on a lower
+  order edge or face. These references are replaced by the
+  interpolation of the dependent node, so that the dependent nodes
+  only reference independent nodes.
+
+  input:
+  nodes:        the sorted array of nodes
+  node_offset:  the offset to the local node numbers
+
+  input/output:
+  node_nums:    the local node numbers (negative for dependent nodes)
+*/
+void TMROctForest::createOrderDependentConn(int *node_nums,
+                                            TMROctantArray *nodes,
+                                            const int *node_offset) {
+  int *node_orders = computeNodeOrders(nodes, node_offset);
+
+  // Label and number the constrained nodes
+  const int num_level_dep_nodes = num_dep_nodes;
+  applyOrderConstraints(TMR_ORDER_LABEL, nodes, node_offset, node_orders,
+                        node_nums, num_level_dep_nodes, NULL, NULL, NULL);
+  for (int i = 0; i < num_local_nodes; i++) {
+    if (node_nums[i] == -num_level_dep_nodes - 1) {
+      num_dep_nodes++;
+      node_nums[i] = -num_dep_nodes;
+    }
+  }
+
+  // Count up the length of the rows and set the rows
+  int *order_ptr = new int[num_dep_nodes + 1];
+  memset(order_ptr, 0, (num_dep_nodes + 1) * sizeof(int));
+  applyOrderConstraints(TMR_ORDER_COUNT, nodes, node_offset, node_orders,
+                        node_nums, num_level_dep_nodes, order_ptr, NULL,
+                        NULL);
+  for (int i = 0; i < num_dep_nodes; i++) {
+    order_ptr[i + 1] += order_ptr[i];
+  }
+  int *order_conn = new int[order_ptr[num_dep_nodes]];
+  double *order_weights = new double[order_ptr[num_dep_nodes]];
+  applyOrderConstraints(TMR_ORDER_SET, nodes, node_offset, node_orders,
+                        node_nums, num_level_dep_nodes, order_ptr,
+                        order_conn, order_weights);
+  delete[] node_orders;
+
+  // Append the rows to the rows from the level transitions
+  int *ptr = new int[num_dep_nodes + 1];
+  int *dconn = new int[dep_ptr[num_level_dep_nodes] +
+                       order_ptr[num_dep_nodes]];
+  double *dweights = new double[dep_ptr[num_level_dep_nodes] +
+                                order_ptr[num_dep_nodes]];
+  ptr[0] = 0;
+  for (int i = 0; i < num_dep_nodes; i++) {
+    int j = ptr[i];
+    if (i < num_level_dep_nodes) {
+      for (int k = dep_ptr[i]; k < dep_ptr[i + 1]; k++, j++) {
+        dconn[j] = dep_conn[k];
+        dweights[j] = dep_weights[k];
+      }
+    } else {
+      for (int k = order_ptr[i]; k < order_ptr[i + 1]; k++, j++) {
+        dconn[j] = order_conn[k];
+        dweights[j] = order_weights[k];
+      }
+    }
+    ptr[i + 1] = j;
+  }
+  delete[] order_ptr;
+  delete[] order_conn;
+  delete[] order_weights;
+  delete[] dep_ptr;
+  delete[] dep_conn;
+  delete[] dep_weights;
+
+  // Replace the references to dependent nodes until only independent
+  // nodes are referenced. Each pass removes one level of dependence.
+  for (int iter = 0;; iter++) {
+    int new_size = 0, max_len = 0, num_refs = 0;
+    for (int i = 0; i < num_dep_nodes; i++) {
+      int len = 0;
+      for (int j = ptr[i]; j < ptr[i + 1]; j++) {
+        int index = node_nums[dconn[j]];
+        if (index < 0) {
+          index = -index - 1;
+          len += ptr[index + 1] - ptr[index];
+          num_refs++;
+        } else {
+          len++;
+        }
+      }
+      if (len > max_len) {
+        max_len = len;
+      }
+      new_size += len;
+    }
+    if (num_refs == 0) {
+      break;
+    } else if (iter >= MAX_DEP_NODE_DEPTH) {
+      fprintf(stderr,
+              "TMROctForest Error: Dependent nodes reference other "
+              "dependent nodes after %d passes\n",
+              iter);
+      break;
     }
 
-    // Compute the inverse -- note that the transpose is used here
-    // since the interpolation matrix is stored in a row-major order
-    // not column-major order.
-    TmrLAPACKdgetrs("N", &size, &size, interp, &size, ipiv, inverse, &size,
-                    &info);
+    int *new_ptr = new int[num_dep_nodes + 1];
+    int *new_conn = new int[new_size];
+    double *new_weights = new double[new_size];
+    TMRIndexWeight *row = new TMRIndexWeight[max_len];
+
+    new_ptr[0] = 0;
+    for (int i = 0; i < num_dep_nodes; i++) {
+      int len = 0;
+      for (int j = ptr[i]; j < ptr[i + 1]; j++) {
+        int index = node_nums[dconn[j]];
+        if (index < 0) {
+          index = -index - 1;
+          for (int k = ptr[index]; k < ptr[index + 1]; k++, len++) {
+            row[len].index = dconn[k];
+            row[len].weight = dweights[j] * dweights[k];
+          }
+        } else {
+          row[len].index = dconn[j];
+          row[len].weight = dweights[j];
+          len++;
+        }
+      }
+      len = TMRIndexWeight::uniqueSort(row, len);
 
-    // Free the rest of the data
-    delete[] ipiv;
-    delete[] interp;
+      new_ptr[i + 1] = new_ptr[i] + len;
+      for (int k = 0; k < len; k++) {
+        new_conn[new_ptr[i] + k] = row[k].index;
+        new_weights[new_ptr[i] + k] = row[k].weight;
+      }
+    }
 
-    // Allocate storage for the element node locations
-    TMRPoint *Xtmp = new TMRPoint[size];
+    delete[] row;
+    delete[] ptr;
+    delete[] dconn;
+    delete[] dweights;
+    ptr = new_ptr;
+    dconn = new_conn;
+    dweights = new_weights;
+  }
 
-    for (int i = 0; i < num_elements; i++) {
-      // Get the right surface
-      TMRVolume *vol;
-      topo->getVolume(octs[i].block, &vol);
+  dep_ptr = ptr;
+  dep_conn = dconn;
+  dep_weights = dweights;
+}
 
-      // Compute the edge length
-      const int32_t h = 1 << (TMR_MAX_LEVEL - octs[i].level);
+/*
+  Get the inverse of the Bernstein interpolation matrix, evaluated at
+  the interpolation knots. The inverse maps the physical locations at
+  the knots to the Bernstein control points. It is computed once for
+  the current mesh order and freed when the order is changed.
+*/
+const double *TMROctForest::getInterpInverse() {
+  if (interp_inverse) {
+    return interp_inverse;
+  }
+
+  // Form the interpolating matrix
+  const double *knots = interp_knots;
+  int size = mesh_order * mesh_order * mesh_order;
+  double *interp = new double[size * size];
+
+  // For each point within the mesh, evaluate the shape functions
+  for (int i = 0; i < size; i++) {
+    double pt[3];
+    pt[0] = knots[i % mesh_order];
+    pt[1] = knots[(i % (mesh_order * mesh_order)) / mesh_order];
+    pt[2] = knots[i / (mesh_order * mesh_order)];
+
+    // Evaluate the interpolant
+    evalInterp(pt, &interp[size * i]);
+  }
+
+  // Compute the inverse for interpolation
+  int info = 0;
+  int *ipiv = new int[size];
+  TmrLAPACKdgetrf(&size, &size, interp, &size, ipiv, &info);
+
+  // Apply the factoriziation to the inverse
+  interp_inverse = new double[size * size];
+  memset(interp_inverse, 0, size * size * sizeof(double));
+  for (int i = 0; i < size; i++) {
+    interp_inverse[(size + 1) * i] = 1.0;
+  }
+
+  // Compute the inverse -- note that the transpose is used here
+  // since the interpolation matrix is stored in a row-major order
+  // not column-major order.
+  TmrLAPACKdgetrs("N", &size, &size, interp, &size, ipiv, interp_inverse,
+                  &size, &info);
+
+  delete[] ipiv;
+  delete[] interp;
+
+  return interp_inverse;
+}
+
+/*
+  Data used to evaluate the node locations for a range of the local
+  octants
+*/
+class TMROctEvalNodesThreadData {
+ public:
+  TMROctForest *forest;
+  int start, end;
+  const int *owner;
+  const double *inverse;
+};
+
+/*
+  Evaluate the locations of the nodes owned by the octants
+  array[start:end] from the geometry.
+
+  Each local node is owned by exactly one octant, so separate ranges
+  write to separate entries in X and can be evaluated concurrently.
+  The parametric points for runs of octants within the same block are
+  collected and evaluated with a single call to TMRVolume::evalPoints.
+  When the inverse is provided, all the points within the octant are
+  evaluated and the Bernstein control points are computed from them.
+*/
+void *TMROctForest::evalNodesThread(void *args) {
+  TMROctEvalNodesThreadData *data =
+      static_cast<TMROctEvalNodesThreadData *>(args);
+  TMROctForest *forest = data->forest;
+  const int *owner = data->owner;
+  const double *inverse = data->inverse;
+
+  const int mesh_order = forest->mesh_order;
+  const double *knots = forest->interp_knots;
+  const int size = mesh_order * mesh_order * mesh_order;
+
+  TMROctant *octs;
+  forest->octants->getArray(&octs, NULL);
+
+  // Allocate space for a batch of points
+  const int max_points = size * MAX_EVAL_BATCH_SIZE;
+  double *prm = new double[3 * max_points];
+  int *dest = new int[max_points];
+  TMRPoint *Xtmp = new TMRPoint[max_points];
+
+  int i = data->start;
+  while (i < data->end) {
+    // Collect the points for a run of octants within the same block
+    const int block = octs[i].block;
+    int npts = 0;
+    for (int nelems = 0; i < data->end && octs[i].block == block &&
+                         nelems < MAX_EVAL_BATCH_SIZE;
+         i++) {
+      const int *c = &forest->conn[size * i];
+
+      // Find the nodes owned by this octant
+      int num_owned = 0;
+      int *d = &dest[npts];
+      for (int j = 0; j < size; j++) {
+        int index = forest->getLocalNodeNumber(c[j]);
+        d[j] = -1;
+        if (index >= 0 && owner[index] == size * i + j) {
+          d[j] = index;
+          num_owned++;
+        }
+      }
+      if (num_owned == 0) {
+        continue;
+      }
 
       // Compute the origin of the element in parametric space
       // and the edge length of the element
-      double d = convert_to_coordinate(h);
+      const int32_t h = 1 << (TMR_MAX_LEVEL - octs[i].level);
+      double dh = convert_to_coordinate(h);
       double u = convert_to_coordinate(octs[i].x);
       double v = convert_to_coordinate(octs[i].y);
       double w = convert_to_coordinate(octs[i].z);
 
-      // Set the offset into the connectivity array
-      const int *c = &conn[mesh_order * mesh_order * mesh_order * i];
+      // Add either all the points (when the control points are
+      // computed) or only the owned points
+      int n = 0;
+      for (int j = 0; j < size; j++) {
+        if (inverse || d[j] >= 0) {
+          int ii = j % mesh_order;
+          int jj = (j % (mesh_order * mesh_order)) / mesh_order;
+          int kk = j / (mesh_order * mesh_order);
+          prm[3 * (npts + n)] = u + 0.5 * dh * (1.0 + knots[ii]);
+          prm[3 * (npts + n) + 1] = v + 0.5 * dh * (1.0 + knots[jj]);
+          prm[3 * (npts + n) + 2] = w + 0.5 * dh * (1.0 + knots[kk]);
+          d[n] = d[j];
+          n++;
+        }
+      }
+      npts += n;
+      nelems++;
+    }
 
-      for (int kk = 0; kk < mesh_order; kk++) {
-        for (int jj = 0; jj < mesh_order; jj++) {
-          for (int ii = 0; ii < mesh_order; ii++) {
-            int local_index =
-                ii + jj * mesh_order + kk * mesh_order * mesh_order;
-            vol->evalPoint(u + 0.5 * d * (1.0 + knots[ii]),
-                           v + 0.5 * d * (1.0 + knots[jj]),
-                           w + 0.5 * d * (1.0 + knots[kk]), &Xtmp[local_index]);
+    if (npts == 0) {
+      continue;
+    }
+
+    TMRVolume *vol;
+    forest->topo->getVolume(block, &vol);
+    vol->evalPoints(npts, prm, Xtmp);
+
+    if (inverse) {
+      // Compute the control points from the points within each octant
+      for (int k = 0; k < npts; k++) {
+        int index = dest[k];
+        if (index >= 0) {
+          const double *inv = &inverse[(k % size) * size];
+          const TMRPoint *Xe = &Xtmp[size * (k / size)];
+          TMRPoint *Xn = &forest->X[index];
+          Xn->x = Xn->y = Xn->z = 0.0;
+          for (int j = 0; j < size; j++) {
+            Xn->x += inv[j] * Xe[j].x;
+            Xn->y += inv[j] * Xe[j].y;
+            Xn->z += inv[j] * Xe[j].z;
           }
         }
       }
+    } else {
+      for (int k = 0; k < npts; k++) {
+        forest->X[dest[k]] = Xtmp[k];
+      }
+    }
+  }
 
-      // Look for nodes that are not assigned
-      for (int kk = 0; kk < mesh_order; kk++) {
-        for (int jj = 0; jj < mesh_order; jj++) {
-          for (int ii = 0; ii < mesh_order; ii++) {
-            // Compute the mesh index
-            int local_index =
-                ii + jj * mesh_order + kk * mesh_order * mesh_order;
-            int node = c[local_index];
-            int index = getLocalNodeNumber(node);
-            if (!flags[index]) {
-              flags[index] = 1;
+  delete[] prm;
+  delete[] dest;
+  delete[] Xtmp;
 
-              X[index].x = X[index].y = X[index].z = 0.0;
-              for (int j = 0; j < size; j++) {
-                X[index].x += inverse[local_index * size + j] * Xtmp[j].x;
-                X[index].y += inverse[local_index * size + j] * Xtmp[j].y;
-                X[index].z += inverse[local_index * size + j] * Xtmp[j].z;
-              }
-            }
-          }
+  return NULL;
+}
+
+/*
+  Evaluate the node locations based on the parametric locations
+*/
+void TMROctForest::evaluateNodeLocations() {
+  // Allocate the array of locally owned nodes
+  X = new TMRPoint[num_local_nodes];
+  memset(X, 0, num_local_nodes * sizeof(TMRPoint));
+
+  int *flags = new int[num_local_nodes];
+  memset(flags, 0, num_local_nodes * sizeof(int));
+
+  int num_elements;
+  TMROctant *octs;
+  octants->getArray(&octs, &num_elements);
+
+  // Set the knots to use in the interpolation
+  const double *knots = interp_knots;
+
+  if (topo) {
+    const int size = mesh_order * mesh_order * mesh_order;
+
+    // Assign each node that is not copied from the previous mesh to
+    // the first octant that contains it
+    int *owner = new int[num_local_nodes];
+    for (int i = 0; i < num_local_nodes; i++) {
+      owner[i] = -1;
+    }
+    for (int i = 0; i < num_elements; i++) {
+      const int *c = &conn[size * i];
+
+      // Copy the locations if this octant was not modified
+      if (copyPrevNodeLocations(&octs[i], c, flags)) {
+        continue;
+      }
+
+      for (int j = 0; j < size; j++) {
+        int index = getLocalNodeNumber(c[j]);
+        if (!flags[index]) {
+          flags[index] = 1;
+          owner[index] = size * i + j;
         }
       }
     }
 
-    delete[] inverse;
-    delete[] Xtmp;
-  } else if (topo) {
+    // Retrieve the inverse of the interpolation for Bernstein points
+    const double *inverse = NULL;
+    if (interp_type == TMR_BERNSTEIN_POINTS && mesh_order > 2) {
+      inverse = getInterpInverse();
+    }
+
+    // Evaluate contiguous ranges of the octants in separate threads.
+    // Note that this requires that the geometry evaluation is thread
+    // safe when more than one thread is used.
+    int nthreads = num_threads;
+    if (nthreads > num_elements) {
+      nthreads = (num_elements > 0 ? num_elements : 1);
+    }
+
+    TMROctEvalNodesThreadData *data = new TMROctEvalNodesThreadData[nthreads];
+    for (int k = 0; k < nthreads; k++) {
+      data[k].forest = this;
+      data[k].start = (int)(((long int)k * num_elements) / nthreads);
+      data[k].end = (int)(((long int)(k + 1) * num_elements) / nthreads);
+      data[k].owner = owner;
+      data[k].inverse = inverse;
+    }
+
+    if (nthreads > 1) {
+      pthread_t *threads = new pthread_t[nthreads];
+      for (int k = 0; k < nthreads; k++) {
+        pthread_create(&threads[k], NULL, TMROctForest::evalNodesThread,
+                       (void *)&data[k]);
+      }
+      for (int k = 0; k < nthreads; k++) {
+        pthread_join(threads[k], NULL);
+      }
+      delete[] threads;
+    } else {
+      evalNodesThread((void *)&data[0]);
+    }
+
+    delete[] data;
+    delete[] owner;
+  } else if (bdata->node_pts) {
+    // Interpolate the node locations from the block corners. The
+    // Bernstein control points of the trilinear map are its values at
+    // uniformly spaced points.
+    double *pknots = new double[mesh_order];
+    for (int i = 0; i < mesh_order; i++) {
+      pknots[i] = knots[i];
+      if (interp_type == TMR_BERNSTEIN_POINTS) {
+        pknots[i] = -1.0 + 2.0 * i / (mesh_order - 1);
+      }
+    }
+
     for (int i = 0; i < num_elements; i++) {
-      // Get the right surface
-      TMRVolume *vol;
-      topo->getVolume(octs[i].block, &vol);
+      const int *c = &conn[mesh_order * mesh_order * mesh_order * i];
+      const int *bc = &bdata->block_conn[8 * octs[i].block];
 
-      // Compute the edge length
       const int32_t h = 1 << (TMR_MAX_LEVEL - octs[i].level);
-
-      // Compute the origin of the element in parametric space
-      // and the edge length of the element
       double d = convert_to_coordinate(h);
       double u = convert_to_coordinate(octs[i].x);
       double v = convert_to_coordinate(octs[i].y);
       double w = convert_to_coordinate(octs[i].z);
 
-      // Set the offset into the connectivity array
-      const int *c = &conn[mesh_order * mesh_order * mesh_order * i];
-
-      // Look for nodes that are not assigned
       for (int kk = 0; kk < mesh_order; kk++) {
         for (int jj = 0; jj < mesh_order; jj++) {
           for (int ii = 0; ii < mesh_order; ii++) {
-            // Compute the mesh index
             int node = c[ii + jj * mesh_order + kk * mesh_order * mesh_order];
             int index = getLocalNodeNumber(node);
             if (!flags[index]) {
               flags[index] = 1;
-              vol->evalPoint(u + 0.5 * d * (1.0 + knots[ii]),
-                             v + 0.5 * d * (1.0 + knots[jj]),
-                             w + 0.5 * d * (1.0 + knots[kk]), &X[index]);
+
+              // Evaluate the trilinear shape functions for the block
+              double pt[3];
+              pt[0] = u + 0.5 * d * (1.0 + pknots[ii]);
+              pt[1] = v + 0.5 * d * (1.0 + pknots[jj]);
+              pt[2] = w + 0.5 * d * (1.0 + pknots[kk]);
+              for (int n = 0; n < 8; n++) {
+                double N = ((n & 1) ? pt[0] : 1.0 - pt[0]) *
+                           ((n & 2) ? pt[1] : 1.0 - pt[1]) *
+                           ((n & 4) ? pt[2] : 1.0 - pt[2]);
+                const TMRPoint *p = &bdata->node_pts[bc[n]];
+                X[index].x += N * p->x;
+                X[index].y += N * p->y;
+                X[index].z += N * p->z;
+              }
             }
           }
         }
       }
     }
+
+    delete[] pknots;
   }
 
   delete[] flags;
 }
 
+/*
+  Copy the node locations for an octant from the mesh data retained
+  before the last call to refine()
+
+  The locations are only copied for nodes that have not yet been
+  assigned. This returns 1 if the octant and all of its nodes were
+  found in the retained data. Otherwise it returns 0, and the nodes
+  that have not been assigned are evaluated from the geometry.
+
+  input:
+  oct:    the local octant
+  c:      the connectivity for the octant
+  flags:  flags indicating whether each local node has been assigned
+*/
+int TMROctForest::copyPrevNodeLocations(TMROctant *oct, const int *c,
+                                        int *flags) {
+  if (!prev_octants) {
+    return 0;
+  }
+
+  TMROctant *prev_octs;
+  prev_octants->getArray(&prev_octs, NULL);
+  TMROctant *t = prev_octants->contains(oct);
+  if (!t) {
+    return 0;
+  }
+
+  // Get the previous connectivity for this octant
+  const int size = mesh_order * mesh_order * mesh_order;
+  const int *pc = &prev_conn[size * (t - prev_octs)];
+
+  for (int j = 0; j < size; j++) {
+    int index = getLocalNodeNumber(c[j]);
+    if (!flags[index]) {
+      int *item = (int *)bsearch(&pc[j], prev_node_numbers,
+                                 prev_num_local_nodes, sizeof(int),
+                                 compare_integers);
+      if (!item) {
+        return 0;
+      }
+      flags[index] = 1;
+      X[index] = prev_X[item - prev_node_numbers];
+    }
+  }
+
+  return 1;
+}
+
 /*
   Get the nodal connectivity. This can only be called after the nodes
   have been created.
@@ -5728,15 +9500,208 @@ int TMROctForest::getDepNodeConn(const int **ptr, const int **conn,
   return num_dep_nodes;
 }
 
+/*
+  Append an entry consisting of a name index followed by size - 1
+  values to a growable array of entries
+*/
+static void add_name_entry(int size, const int *entry, int *count,
+                           int *max_count, int **entries) {
+  if (*count >= *max_count) {
+    int new_max = 2 * (*max_count) + 1024;
+    int *tmp = new int[size * new_max];
+    int *old = *entries;
+    if (old) {
+      memcpy(tmp, old, size * (*count) * sizeof(int));
+      delete[] old;
+    }
+    *entries = tmp;
+    *max_count = new_max;
+  }
+  memcpy(&(*entries)[size * (*count)], entry, size * sizeof(int));
+  (*count)++;
+}
+
+/*
+  Sort the entries by name index, keeping the original order within
+  each name, and create a pointer into the list of values
+*/
+static void sort_name_entries(int num_names, int size, int count,
+                              const int *entries, int **_ptr, int **_list) {
+  int *ptr = new int[num_names + 1];
+  memset(ptr, 0, (num_names + 1) * sizeof(int));
+  for (int i = 0; i < count; i++) {
+    ptr[entries[size * i] + 1]++;
+  }
+  for (int i = 0; i < num_names; i++) {
+    ptr[i + 1] += ptr[i];
+  }
+
+  int *list = new int[(size - 1) * count];
+  for (int i = 0; i < count; i++) {
+    int n = entries[size * i];
+    memcpy(&list[(size - 1) * ptr[n]], &entries[size * i + 1],
+           (size - 1) * sizeof(int));
+    ptr[n]++;
+  }
+  for (int i = num_names; i > 0; i--) {
+    ptr[i] = ptr[i - 1];
+  }
+  ptr[0] = 0;
+
+  *_ptr = ptr;
+  *_list = list;
+}
+
+/*
+  Intern the names of the vertices, edges, faces and volumes in the
+  topology. Each entity is assigned the index of its name within the
+  name table, so that names can be compared as integers. Index zero is
+  reserved for entities without a name.
+*/
+void TMROctForest::computeNameIds() {
+  const int num_entities[4] = {bdata->num_nodes, bdata->num_edges,
+                               bdata->num_faces, bdata->num_blocks};
+  int max_names = 1 + num_entities[0] + num_entities[1] + num_entities[2] +
+                  num_entities[3];
+  bdata->name_table = new char *[max_names];
+  bdata->name_table[0] = NULL;
+  bdata->num_names = 1;
+
+  bdata->vert_name_ids = new int[num_entities[0]];
+  bdata->edge_name_ids = new int[num_entities[1]];
+  bdata->face_name_ids = new int[num_entities[2]];
+  bdata->volume_name_ids = new int[num_entities[3]];
+  int *ids[4] = {bdata->vert_name_ids, bdata->edge_name_ids,
+                 bdata->face_name_ids, bdata->volume_name_ids};
+
+  for (int type = 0; type < 4; type++) {
+    for (int i = 0; i < num_entities[type]; i++) {
+      const char *name = NULL;
+      if (type == 0) {
+        TMRVertex *vert;
+        topo->getVertex(i, &vert);
+        name = vert->getName();
+      } else if (type == 1) {
+        TMREdge *edge;
+        topo->getEdge(i, &edge);
+        name = edge->getName();
+      } else if (type == 2) {
+        TMRFace *face;
+        topo->getFace(i, &face);
+        name = face->getName();
+      } else {
+        TMRVolume *volume;
+        topo->getVolume(i, &volume);
+        name = volume->getName();
+      }
+
+      int id = getNameId(name);
+      if (id < 0) {
+        id = bdata->num_names;
+        bdata->name_table[id] = new char[strlen(name) + 1];
+        strcpy(bdata->name_table[id], name);
+        bdata->num_names++;
+      }
+      ids[type][i] = id;
+    }
+  }
+}
+
+/*
+  Get the index of the name in the name table, or -1 if no entity has
+  the name
+*/
+int TMROctForest::getNameId(const char *name) {
+  if (!name) {
+    return 0;
+  }
+  for (int i = 1; i < bdata->num_names; i++) {
+    if (strcmp(bdata->name_table[i], name) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/*
+  Compute the octants that lie in a volume or touch a face with each
+  name. The octant is stored with info = -1 when the volume name
+  matches, otherwise info is the local face index.
+*/
+void TMROctForest::computeOctNameIndex() {
+  if (!bdata->name_table) {
+    computeNameIds();
+  }
+
+  int size;
+  TMROctant *array;
+  octants->getArray(&array, &size);
+
+  int count = 0, max_count = 0;
+  int *entries = NULL;
+
+  const int32_t hmax = 1 << TMR_MAX_LEVEL;
+  for (int i = 0; i < size; i++) {
+    const int32_t h = 1 << (TMR_MAX_LEVEL - array[i].level);
+    const int *face_conn = &bdata->block_face_conn[6 * array[i].block];
+
+    // Add the octant to the list for the volume name
+    int vol_id = bdata->volume_name_ids[array[i].block];
+    int entry[3] = {vol_id, i, -1};
+    add_name_entry(3, entry, &count, &max_count, &entries);
+
+    // Find the faces that this octant touches. A root octant touches
+    // all faces, otherwise at most three faces are touched.
+    int nfaces = 0;
+    int face_index[6];
+    if (array[i].level == 0) {
+      for (; nfaces < 6; nfaces++) {
+        face_index[nfaces] = nfaces;
+      }
+    } else {
+      if (array[i].x == 0) {
+        face_index[nfaces++] = 0;
+      } else if (array[i].x + h == hmax) {
+        face_index[nfaces++] = 1;
+      }
+      if (array[i].y == 0) {
+        face_index[nfaces++] = 2;
+      } else if (array[i].y + h == hmax) {
+        face_index[nfaces++] = 3;
+      }
+      if (array[i].z == 0) {
+        face_index[nfaces++] = 4;
+      } else if (array[i].z + h == hmax) {
+        face_index[nfaces++] = 5;
+      }
+    }
+
+    // Faces with the same name as the volume are already covered
+    for (int k = 0; k < nfaces; k++) {
+      int face_id = bdata->face_name_ids[face_conn[face_index[k]]];
+      if (face_id != vol_id) {
+        entry[0] = face_id;
+        entry[2] = face_index[k];
+        add_name_entry(3, entry, &count, &max_count, &entries);
+      }
+    }
+  }
+
+  sort_name_entries(bdata->num_names, 3, count, entries, &name_oct_ptr,
+                    &name_oct_list);
+  if (entries) {
+    delete[] entries;
+  }
+}
+
 /*
   Get the elements that either lie in a volume, on a face or on a
   curve with a given name.
 
-  This code loops over all octants that are locally owned on this
-  processor and checks the name of the underlying topological
-  entry. If the volume name matches, the octant is added
-  directly, otherwise the local face or volume index is set as the
-  tag.
+  The octants are found from an index of the octants by name that is
+  computed on the first call and retained until the octants change.
+  If the volume name matches, the octant is added directly, otherwise
+  the local face index is set as the info member.
 
   input:
   name:   string name associated with the geometric feature
@@ -5757,178 +9722,55 @@ TMROctantArray *TMROctForest::getOctsWithName(const char *name) {
             "getOctsWithName()\n");
     return NULL;
   }
-
-  // Set the flag if the name is NULL
-  int name_is_null = 1;
-  if (name) {
-    name_is_null = 0;
+  if (!name_oct_ptr) {
+    computeOctNameIndex();
   }
 
-  // Create a queue to store the elements that we find
-  TMROctantQueue *queue = new TMROctantQueue();
-
   // Get the octants
   int size;
   TMROctant *array;
   octants->getArray(&array, &size);
 
-  // Loop over the octants and find out whether it touches
-  // a face or edge with the prescribed name
-  const int32_t hmax = 1 << TMR_MAX_LEVEL;
-  for (int i = 0; i < size; i++) {
-    const int32_t h = 1 << (TMR_MAX_LEVEL - array[i].level);
-
-    // Get the surface octant
-    TMRVolume *vol;
-    topo->getVolume(array[i].block, &vol);
-    const char *vol_name = vol->getName();
-    if ((name_is_null && !vol_name) ||
-        (vol_name && strcmp(vol_name, name) == 0)) {
-      queue->push(&array[i]);
-    } else {
-      // If this is a root octant, then we should check all of the
-      // sides, otherwise we will only check a maximum of three of the
-      // sides to see if the face name matches
-      if (array[i].level == 0) {
-        for (int face_index = 0; face_index < 6; face_index++) {
-          TMROctant oct = array[i];
-          int face_num =
-              bdata->block_face_conn[6 * array[i].block + face_index];
-          TMRFace *face;
-          topo->getFace(face_num, &face);
-          const char *face_name = face->getName();
-          if ((name_is_null && !face_name) ||
-              (face_name && strcmp(face_name, name) == 0)) {
-            oct.info = face_index;
-            queue->push(&oct);
-          }
-        }
-      } else {
-        // Check if this octant lies on one or more face
-        int fx0 = (array[i].x == 0);
-        int fy0 = (array[i].y == 0);
-        int fz0 = (array[i].z == 0);
-        int fx = (fx0 || array[i].x + h == hmax);
-        int fy = (fy0 || array[i].y + h == hmax);
-        int fz = (fz0 || array[i].z + h == hmax);
-
-        if (fx || fy || fz) {
-          TMRFace *face = NULL;
-          TMROctant oct = array[i];
-          if (fx) {
-            int face_index = (fx0 ? 0 : 1);
-            int face_num =
-                bdata->block_face_conn[6 * array[i].block + face_index];
-            topo->getFace(face_num, &face);
-            const char *face_name = face->getName();
-            if ((name_is_null && !face_name) ||
-                (face_name && strcmp(face_name, name) == 0)) {
-              oct.info = face_index;
-              queue->push(&oct);
-            }
-          }
-          if (fy) {
-            int face_index = (fy0 ? 2 : 3);
-            int face_num =
-                bdata->block_face_conn[6 * array[i].block + face_index];
-            topo->getFace(face_num, &face);
-            const char *face_name = face->getName();
-            if ((name_is_null && !face_name) ||
-                (face_name && strcmp(face_name, name) == 0)) {
-              oct.info = face_index;
-              queue->push(&oct);
-            }
-          }
-          if (fz) {
-            int face_index = (fz0 ? 4 : 5);
-            int face_num =
-                bdata->block_face_conn[6 * array[i].block + face_index];
-            topo->getFace(face_num, &face);
-            const char *face_name = face->getName();
-            if ((name_is_null && !face_name) ||
-                (face_name && strcmp(face_name, name) == 0)) {
-              oct.info = face_index;
-              queue->push(&oct);
-            }
-          }
-        }
-      }
+  // Copy the octants with this name from the index
+  int id = getNameId(name);
+  int len = 0;
+  if (id >= 0) {
+    len = name_oct_ptr[id + 1] - name_oct_ptr[id];
+  }
+  TMROctant *list = new TMROctant[len];
+  for (int k = 0; k < len; k++) {
+    const int *entry = &name_oct_list[2 * (name_oct_ptr[id] + k)];
+    list[k] = array[entry[0]];
+    if (entry[1] >= 0) {
+      list[k].info = entry[1];
     }
   }
 
-  TMROctantArray *list = queue->toArray();
-  delete queue;
-  return list;
+  return new TMROctantArray(list, len);
 }
 
 /*
-  Create an array of the nodes that are lie on a surface, edge or
-  corner with a given name
-
-  This code loops over all nodes and check whether they lie on a
-  geometric entity that has the given name. If the intersect flag
-  is active (which is the default), then only the owner is checked,
-  e.g. if the node lies on a corner, only the name of the vertex
-  is checked. If intersect is false then the edge, face and volume
-  names are also check and the node is added if any of them
-  match.
-
-  input:
-  name:       the string of the name to search
-
-  returns:
-  list:   the nodes matching the specified name
+  Compute the nodes that lie on a corner, edge or face with each name.
+  Each node list is sorted and the duplicates are removed.
 */
-int TMROctForest::getNodesWithName(const char *name, int **_nodes) {
-  if (!topo) {
-    fprintf(stderr,
-            "TMROctForest Error: Must define topology to use "
-            "getNodesWithName()\n");
-    *_nodes = NULL;
-    return 0;
-  }
-  if (!conn) {
-    fprintf(stderr,
-            "TMROctForest Error: Nodes must be created before calling "
-            "getNodesWithName()\n");
-    *_nodes = NULL;
-    return 0;
+void TMROctForest::computeNodeNameIndex() {
+  if (!bdata->name_table) {
+    computeNameIds();
   }
 
   // The max octant edge length
   const int32_t hmax = 1 << TMR_MAX_LEVEL;
+  const int m = mesh_order;
 
-  // Set the flag if the name is NULL
-  int name_is_null = 1;
-  if (name) {
-    name_is_null = 0;
-  }
-
-  int count = 0;                      // Current node count
-  int max_len = 1024;                 // max length of the node list
-  int *node_list = new int[max_len];  // Nodes touching this name
+  int count = 0, max_count = 0;
+  int *entries = NULL;
 
   // Get the octants
   int size;
   TMROctant *octs;
   octants->getArray(&octs, &size);
 
-  // Max node increment
-  const int max_node_incr = 8 + 12 * mesh_order + 6 * mesh_order * mesh_order +
-                            mesh_order * mesh_order * mesh_order;
-
-  // Loop over the octants and find out whether it touches a face or
-  // edge with the prescribed name
   for (int i = 0; i < size; i++) {
-    if (count + max_node_incr > max_len) {
-      // Extend the length of the array
-      max_len = 2 * max_len + max_node_incr;
-      int *tmp = new int[max_len];
-      memcpy(tmp, node_list, count * sizeof(int));
-      delete[] node_list;
-      node_list = tmp;
-    }
-
     // Compute the octant edge length
     const int32_t h = 1 << (TMR_MAX_LEVEL - octs[i].level);
 
@@ -5943,239 +9785,75 @@ int TMROctForest::getNodesWithName(const char *name, int **_nodes) {
     int fy = fy0 || fy1;
     int fz = fz0 || fz1;
 
-    // Set a pointer into the connectivity array
-    const int *c = &conn[mesh_order * mesh_order * mesh_order * octs[i].tag];
-
-    if (fx && fy && fz) {
-      // This node lies on a corner
-      int nverts = 0;
-      int vert_index[8];
-      if (fx0 && fy0 && fz0) {
-        vert_index[nverts] = 0;
-        nverts++;
-      }
-      if (fx1 && fy0 && fz0) {
-        vert_index[nverts] = 1;
-        nverts++;
-      }
-      if (fx0 && fy1 && fz0) {
-        vert_index[nverts] = 2;
-        nverts++;
-      }
-      if (fx1 && fy1 && fz0) {
-        vert_index[nverts] = 3;
-        nverts++;
-      }
-      if (fx0 && fy0 && fz1) {
-        vert_index[nverts] = 4;
-        nverts++;
-      }
-      if (fx1 && fy0 && fz1) {
-        vert_index[nverts] = 5;
-        nverts++;
-      }
-      if (fx0 && fy1 && fz1) {
-        vert_index[nverts] = 6;
-        nverts++;
-      }
-      if (fx1 && fy1 && fz1) {
-        vert_index[nverts] = 7;
-        nverts++;
-      }
-
-      for (int k = 0; k < nverts; k++) {
-        TMRVertex *vert;
-        int vert_num = bdata->block_conn[8 * octs[i].block + vert_index[k]];
-        topo->getVertex(vert_num, &vert);
-        const char *vert_name = vert->getName();
-        if ((name_is_null && !vert_name) ||
-            (vert_name && strcmp(vert_name, name) == 0)) {
-          int offset =
-              ((mesh_order - 1) * (vert_index[k] % 2) +
-               (mesh_order - 1) * mesh_order * ((vert_index[k] % 4) / 2) +
-               (mesh_order - 1) * mesh_order * mesh_order *
-                   (vert_index[k] / 4));
-          node_list[count] = c[offset];
-          count++;
-        }
-      }
-    }
-    if ((fy && fz) || (fx && fz) || (fx && fy)) {
-      int nedges = 0;
-      int edge_index[12];
-
-      // x-parallel edges
-      if (fy0 && fz0) {
-        edge_index[nedges] = 0;
-        nedges++;
-      }
-      if (fy1 && fz0) {
-        edge_index[nedges] = 1;
-        nedges++;
-      }
-      if (fy0 && fz1) {
-        edge_index[nedges] = 2;
-        nedges++;
-      }
-      if (fy1 && fz1) {
-        edge_index[nedges] = 3;
-        nedges++;
-      }
-
-      // y-parallel edges
-      if (fx0 && fz0) {
-        edge_index[nedges] = 4;
-        nedges++;
-      }
-      if (fx1 && fz0) {
-        edge_index[nedges] = 5;
-        nedges++;
-      }
-      if (fx0 && fz1) {
-        edge_index[nedges] = 6;
-        nedges++;
-      }
-      if (fx1 && fz1) {
-        edge_index[nedges] = 7;
-        nedges++;
-      }
+    // Set a pointer into the connectivity array
+    const int *c = &conn[m * m * m * octs[i].tag];
+    const int block = octs[i].block;
 
-      // z-parallel edges
-      if (fx0 && fy0) {
-        edge_index[nedges] = 8;
-        nedges++;
-      }
-      if (fx1 && fy0) {
-        edge_index[nedges] = 9;
-        nedges++;
-      }
-      if (fx0 && fy1) {
-        edge_index[nedges] = 10;
-        nedges++;
-      }
-      if (fx1 && fy1) {
-        edge_index[nedges] = 11;
-        nedges++;
+    if (fx && fy && fz) {
+      // Add the nodes on the corners of the block
+      for (int k = 0; k < 8; k++) {
+        if (((k % 2 == 0) ? fx0 : fx1) && (((k % 4) / 2 == 0) ? fy0 : fy1) &&
+            ((k / 4 == 0) ? fz0 : fz1)) {
+          int offset = ((m - 1) * (k % 2) + (m - 1) * m * ((k % 4) / 2) +
+                        (m - 1) * m * m * (k / 4));
+          int vert = bdata->block_conn[8 * block + k];
+          int entry[2] = {bdata->vert_name_ids[vert], c[offset]};
+          add_name_entry(2, entry, &count, &max_count, &entries);
+        }
       }
-
-      // This node lies on an edge
-      for (int k = 0; k < nedges; k++) {
-        TMREdge *edge;
-        int edge_num =
-            bdata->block_edge_conn[12 * octs[i].block + edge_index[k]];
-        topo->getEdge(edge_num, &edge);
-        const char *edge_name = edge->getName();
-        if ((name_is_null && !edge_name) ||
-            (edge_name && strcmp(edge_name, name) == 0)) {
-          if (edge_index[k] < 4) {
-            const int jj = (mesh_order - 1) * (edge_index[k] % 2);
-            const int kk = (mesh_order - 1) * (edge_index[k] / 2);
-            for (int ii = 0; ii < mesh_order; ii++) {
-              int offset = ii + jj * mesh_order + kk * mesh_order * mesh_order;
-              node_list[count] = c[offset];
-              count++;
-            }
-          } else if (edge_index[k] < 8) {
-            const int ii = (mesh_order - 1) * (edge_index[k] % 2);
-            const int kk = (mesh_order - 1) * ((edge_index[k] - 4) / 2);
-            for (int jj = 0; jj < mesh_order; jj++) {
-              int offset = ii + jj * mesh_order + kk * mesh_order * mesh_order;
-              node_list[count] = c[offset];
-              count++;
-            }
-          } else {
-            const int ii = (mesh_order - 1) * (edge_index[k] % 2);
-            const int jj = (mesh_order - 1) * ((edge_index[k] - 8) / 2);
-            for (int kk = 0; kk < mesh_order; kk++) {
-              int offset = ii + jj * mesh_order + kk * mesh_order * mesh_order;
-              node_list[count] = c[offset];
-              count++;
-            }
+    }
+    if ((fy && fz) || (fx && fz) || (fx && fy)) {
+      // Add the nodes on the edges of the block
+      for (int k = 0; k < 12; k++) {
+        int on_edge = 0, ii = 0, jj = 0, kk = 0;
+        int di = 0, dj = 0, dk = 0;
+        if (k < 4) {
+          on_edge = ((k % 2 == 0) ? fy0 : fy1) && ((k / 2 == 0) ? fz0 : fz1);
+          jj = (m - 1) * (k % 2);
+          kk = (m - 1) * (k / 2);
+          di = 1;
+        } else if (k < 8) {
+          on_edge =
+              ((k % 2 == 0) ? fx0 : fx1) && (((k - 4) / 2 == 0) ? fz0 : fz1);
+          ii = (m - 1) * (k % 2);
+          kk = (m - 1) * ((k - 4) / 2);
+          dj = 1;
+        } else {
+          on_edge =
+              ((k % 2 == 0) ? fx0 : fx1) && (((k - 8) / 2 == 0) ? fy0 : fy1);
+          ii = (m - 1) * (k % 2);
+          jj = (m - 1) * ((k - 8) / 2);
+          dk = 1;
+        }
+        if (on_edge) {
+          int id = bdata->edge_name_ids[bdata->block_edge_conn[12 * block + k]];
+          for (int n = 0; n < m; n++) {
+            int offset =
+                (ii + n * di) + (jj + n * dj) * m + (kk + n * dk) * m * m;
+            int entry[2] = {id, c[offset]};
+            add_name_entry(2, entry, &count, &max_count, &entries);
           }
         }
       }
     }
     if (fx || fy || fz) {
-      int nfaces = 0;
-      int face_index[6];
-      if (fx0) {
-        face_index[nfaces] = 0;
-        nfaces++;
-      }
-      if (fx1) {
-        face_index[nfaces] = 1;
-        nfaces++;
-      }
-      if (fy0) {
-        face_index[nfaces] = 2;
-        nfaces++;
-      }
-      if (fy1) {
-        face_index[nfaces] = 3;
-        nfaces++;
-      }
-      if (fz0) {
-        face_index[nfaces] = 4;
-        nfaces++;
-      }
-      if (fz1) {
-        face_index[nfaces] = 5;
-        nfaces++;
-      }
-
-      // Which face index are we dealing with?
-      for (int k = 0; k < nfaces; k++) {
-        TMRFace *face;
-        int face_num =
-            bdata->block_face_conn[6 * octs[i].block + face_index[k]];
-        topo->getFace(face_num, &face);
-        const char *face_name = face->getName();
-        if ((name_is_null && !face_name) ||
-            (face_name && strcmp(face_name, name) == 0)) {
-          if (face_index[k] < 2) {
-            const int ii = (mesh_order - 1) * (face_index[k] % 2);
-            for (int kk = 0; kk < mesh_order; kk++) {
-              for (int jj = 0; jj < mesh_order; jj++) {
-                int offset =
-                    ii + jj * mesh_order + kk * mesh_order * mesh_order;
-                node_list[count] = c[offset];
-                count++;
-              }
-            }
-          } else if (face_index[k] < 4) {
-            const int jj = (mesh_order - 1) * (face_index[k] % 2);
-            for (int kk = 0; kk < mesh_order; kk++) {
-              for (int ii = 0; ii < mesh_order; ii++) {
-                int offset =
-                    ii + jj * mesh_order + kk * mesh_order * mesh_order;
-                node_list[count] = c[offset];
-                count++;
-              }
-            }
-          } else {
-            const int kk = (mesh_order - 1) * (face_index[k] % 2);
-            for (int jj = 0; jj < mesh_order; jj++) {
-              for (int ii = 0; ii < mesh_order; ii++) {
-                int offset =
-                    ii + jj * mesh_order + kk * mesh_order * mesh_order;
-                node_list[count] = c[offset];
-                count++;
+      // Add the nodes on the faces of the block
+      const int on_face[6] = {fx0, fx1, fy0, fy1, fz0, fz1};
+      for (int k = 0; k < 6; k++) {
+        if (on_face[k]) {
+          int id = bdata->face_name_ids[bdata->block_face_conn[6 * block + k]];
+          for (int q = 0; q < m; q++) {
+            for (int p = 0; p < m; p++) {
+              int offset = 0;
+              if (k < 2) {
+                offset = (m - 1) * (k % 2) + p * m + q * m * m;
+              } else if (k < 4) {
+                offset = p + (m - 1) * (k % 2) * m + q * m * m;
+              } else {
+                offset = p + q * m + (m - 1) * (k % 2) * m * m;
               }
-            }
-          }
-        }
-      }
-    } else {
-      TMRVolume *volume;
-      topo->getVolume(octs[i].block, &volume);
-      const char *volume_name = volume->getName();
-      if ((name_is_null && !volume_name) ||
-          (volume_name && strcmp(volume_name, name) == 0)) {
-        for (int kk = 0; kk < mesh_order; kk++) {
-          for (int jj = 0; jj < mesh_order; jj++) {
-            for (int ii = 0; ii < mesh_order; ii++) {
-              int offset = ii + jj * mesh_order + kk * mesh_order * mesh_order;
-              node_list[count] = c[offset];
+              int entry[2] = {id, c[offset]};
+              add_name_entry(2, entry, &count, &max_count, &entries);
             }
           }
         }
@@ -6183,19 +9861,73 @@ int TMROctForest::getNodesWithName(const char *name, int **_nodes) {
     }
   }
 
-  // Now, sort the node numbers and remove duplicates
-  qsort(node_list, count, sizeof(int), compare_integers);
+  sort_name_entries(bdata->num_names, 2, count, entries, &name_node_ptr,
+                    &name_node_list);
+  if (entries) {
+    delete[] entries;
+  }
 
-  // Remove duplicates from the array
+  // Sort the node numbers for each name and remove duplicates
   int len = 0;
-  for (int ptr = 0; ptr < count; ptr++, len++) {
-    while ((ptr < count - 1) && (node_list[ptr] == node_list[ptr + 1])) {
-      ptr++;
+  for (int n = 0; n < bdata->num_names; n++) {
+    int start = name_node_ptr[n];
+    int end = name_node_ptr[n + 1];
+    name_node_ptr[n] = len;
+    qsort(&name_node_list[start], end - start, sizeof(int), compare_integers);
+    for (int ptr = start; ptr < end; ptr++, len++) {
+      while ((ptr < end - 1) &&
+             (name_node_list[ptr] == name_node_list[ptr + 1])) {
+        ptr++;
+      }
+      name_node_list[len] = name_node_list[ptr];
     }
+  }
+  name_node_ptr[bdata->num_names] = len;
+}
 
-    if (ptr != len) {
-      node_list[len] = node_list[ptr];
-    }
+/*
+  Create an array of the nodes that are lie on a surface, edge or
+  corner with a given name
+
+  The nodes are found from an index of the nodes by name that is
+  computed on the first call and retained until the nodes change. The
+  node is added if the vertex, edge or face that it lies on has the
+  given name.
+
+  input:
+  name:       the string of the name to search
+
+  returns:
+  list:   the nodes matching the specified name
+*/
+int TMROctForest::getNodesWithName(const char *name, int **_nodes) {
+  if (!topo) {
+    fprintf(stderr,
+            "TMROctForest Error: Must define topology to use "
+            "getNodesWithName()\n");
+    *_nodes = NULL;
+    return 0;
+  }
+  if (!conn) {
+    fprintf(stderr,
+            "TMROctForest Error: Nodes must be created before calling "
+            "getNodesWithName()\n");
+    *_nodes = NULL;
+    return 0;
+  }
+  if (!name_node_ptr) {
+    computeNodeNameIndex();
+  }
+
+  // Copy the nodes with this name from the index
+  int id = getNameId(name);
+  int len = 0;
+  if (id >= 0) {
+    len = name_node_ptr[id + 1] - name_node_ptr[id];
+  }
+  int *node_list = new int[len];
+  if (len > 0) {
+    memcpy(node_list, &name_node_list[name_node_ptr[id]], len * sizeof(int));
   }
 
   *_nodes = node_list;
@@ -6227,6 +9959,66 @@ int TMROctForest::getNodesWithName(const char *name, int **_nodes) {
 */
 TMROctant *TMROctForest::findEnclosing(const int order, const double *knots,
                                        TMROctant *node, int *mpi_owner) {
+  int start = findEnclosingStart(node);
+  return findEnclosing(order, knots, node, start, mpi_owner);
+}
+
+/*
+  Find the location in the octant array where the search for the
+  octant enclosing the node begins.
+
+  This depends only on the position and level of the node octant and
+  not on the node location stored in the info member. The result can
+  therefore be shared between all the nodes of an element.
+*/
+int TMROctForest::findEnclosingStart(TMROctant *node) {
+  // Retrieve the array of elements
+  int size = 0;
+  TMROctant *array = NULL;
+  octants->getArray(&array, &size);
+
+  // Set the low and high indices to the first and last element of the
+  // element array
+  int low = 0;
+  int high = size - 1;
+  int mid = low + (int)((high - low) / 2);
+
+  // Maintain values of low/high and mid such that the octant is
+  // between (elems[low], elems[high]).  Note that if high-low=1, then
+  // mid = low
+  while (mid != low) {
+    // Check if the node is contained by the mid octant
+    if (array[mid].contains(node)) {
+      break;
+    }
+
+    // Compare the ordering of the two octants - if the octant is less
+    // than the other, then adjust the mid point
+    int stat = array[mid].comparePosition(node);
+
+    // array[mid] ? node
+    if (stat == 0) {
+      break;
+    } else if (stat < 0) {
+      low = mid + 1;
+    } else {
+      high = mid - 1;
+    }
+
+    // Re compute the mid-point and repeat
+    mid = low + (int)((high - low) / 2);
+  }
+
+  return mid;
+}
+
+/*
+  Find the enclosing octant, starting the search from the location
+  in the octant array returned by findEnclosingStart()
+*/
+TMROctant *TMROctForest::findEnclosing(const int order, const double *knots,
+                                       TMROctant *node, int start,
+                                       int *mpi_owner) {
   // Assume that we'll find the node on this processor for now.
   if (mpi_owner) {
     *mpi_owner = mpi_rank;
@@ -6273,38 +10065,6 @@ TMROctant *TMROctForest::findEnclosing(const int order, const double *knots,
   const double yd = node->y + 0.5 * h * (1.0 + knots[jj]);
   const double zd = node->z + 0.5 * h * (1.0 + knots[kk]);
 
-  // Set the low and high indices to the first and last element of the
-  // element array
-  int low = 0;
-  int high = size - 1;
-  int mid = low + (int)((high - low) / 2);
-
-  // Maintain values of low/high and mid such that the octant is
-  // between (elems[low], elems[high]).  Note that if high-low=1, then
-  // mid = low
-  while (mid != low) {
-    // Check if the node is contained by the mid octant
-    if (array[mid].contains(node)) {
-      break;
-    }
-
-    // Compare the ordering of the two octants - if the octant is less
-    // than the other, then adjust the mid point
-    int stat = array[mid].comparePosition(node);
-
-    // array[mid] ? node
-    if (stat == 0) {
-      break;
-    } else if (stat < 0) {
-      low = mid + 1;
-    } else {
-      high = mid - 1;
-    }
-
-    // Re compute the mid-point and repeat
-    mid = low + (int)((high - low) / 2);
-  }
-
   // Compute the bounding octant. Octants greater than this octant
   // cannot own the node so a further search is futile.
   TMROctant oct;
@@ -6313,6 +10073,7 @@ TMROctant *TMROctForest::findEnclosing(const int order, const double *knots,
   oct.y = node->y + h;
   oct.z = node->z + h;
 
+  int mid = start;
   while (mid < size && array[mid].comparePosition(&oct) <= 0) {
     // First, make sure that we're on the right block
     if (array[mid].block == block) {
@@ -6600,20 +10361,91 @@ int TMROctForest::computeElemInterp(TMROctant *node, TMROctForest *coarse,
   in the mesh. This interpolation will refer to other nodes, but the
   output is local.
 
+  The construction is split into three stages: beginInterpolation()
+  creates the nodes and checks for recorded rows,
+  computeLocalInterpolation() adds the rows that can be computed on
+  this processor and endInterpolation() exchanges and adds the
+  remaining rows. The first and last stages are collective, while the
+  local stage requires no communication and may be performed
+  concurrently for different pairs of forests.
+
   input:
   coarse:   the coarse octree forest that has the same layout as this
 
   output:
-  ptr:      the pointer into the local rows
-  conn:     the connectivity using global numbers
-  weights:  the interpolation weights for each point
+  interp:   the interpolation object
 */
 void TMROctForest::createInterpolation(TMROctForest *coarse,
                                        TACSBVecInterp *interp) {
+  TMR_PROFILE_BEGIN(TMR_PROFILE_CREATE_INTERPOLATION);
+  if (!beginInterpolation(coarse, interp)) {
+    int *oct_ptr = new int[mpi_size + 1];
+    TMROctantArray *ext_array =
+        computeLocalInterpolation(coarse, interp, oct_ptr);
+    endInterpolation(coarse, interp, ext_array, oct_ptr);
+    delete[] oct_ptr;
+  }
+  TMR_PROFILE_END(TMR_PROFILE_CREATE_INTERPOLATION);
+}
+
+/*
+  Begin creating the interpolation operator
+
+  This call is collective. It creates the nodes on both forests and
+  adds any recorded rows.
+
+  returns:  1 if the interpolation is complete, 0 otherwise
+*/
+int TMROctForest::beginInterpolation(TMROctForest *coarse,
+                                     TACSBVecInterp *interp) {
   // Ensure that the nodes are allocated on both octree forests
   createNodes();
   coarse->createNodes();
 
+  // Reuse the recorded rows when neither forest has changed. The check
+  // is collective since building the rows requires communication.
+  if (cache_interp) {
+    int valid = (interp_cache_ptr && interp_cache_coarse == coarse &&
+                 interp_cache_stamps[0] == node_stamp &&
+                 interp_cache_stamps[1] == coarse->node_stamp);
+    MPI_Allreduce(MPI_IN_PLACE, &valid, 1, MPI_INT, MPI_MIN, comm);
+    if (valid) {
+      for (int i = 0; i < interp_cache_nrows; i++) {
+        int start = interp_cache_ptr[i];
+        interp->addInterp(interp_cache_rows[i], &interp_cache_weights[start],
+                          &interp_cache_vars[start],
+                          interp_cache_ptr[i + 1] - start);
+      }
+      return 1;
+    }
+
+    // Start a new record for this pair of forests
+    freeInterpCache();
+    interp_cache_coarse = coarse;
+    interp_cache_stamps[0] = node_stamp;
+    interp_cache_stamps[1] = coarse->node_stamp;
+    interp_cache_max_rows = node_range[mpi_rank + 1] - node_range[mpi_rank];
+    interp_cache_max_weights = 8 * (interp_cache_max_rows + 1);
+    interp_cache_rows = new int[interp_cache_max_rows];
+    interp_cache_ptr = new int[interp_cache_max_rows + 1];
+    interp_cache_vars = new int[interp_cache_max_weights];
+    interp_cache_weights = new double[interp_cache_max_weights];
+    interp_cache_ptr[0] = 0;
+  }
+
+  return 0;
+}
+
+/*
+  Add the interpolation rows that can be computed locally
+
+  This does not require any communication. The nodes that lie within
+  coarse octants owned by other processors are returned in an array
+  sorted by destination processor, with the ranges for each processor
+  stored in oct_ptr (of length mpi_size+1).
+*/
+TMROctantArray *TMROctForest::computeLocalInterpolation(
+    TMROctForest *coarse, TACSBVecInterp *interp, int *oct_ptr) {
   // Get the dependent node information
   const int *cdep_ptr, *cdep_conn;
   const double *cdep_weights;
@@ -6653,6 +10485,11 @@ void TMROctForest::createInterpolation(TMROctForest *coarse,
 
   for (int i = 0; i < num_elements; i++) {
     const int *c = &conn[nodes_per_element * i];
+
+    // The search for the enclosing coarse octant begins at the same
+    // location for all the nodes in this element
+    int start = -1;
+
     for (int j = 0; j < nodes_per_element; j++) {
       // Check if the fine node is owned by this processor
       if (c[j] >= node_range[mpi_rank] && c[j] < node_range[mpi_rank + 1]) {
@@ -6665,11 +10502,14 @@ void TMROctForest::createInterpolation(TMROctForest *coarse,
           // processor if it exits
           TMROctant node = octs[i];
           node.info = j;
+          if (start < 0) {
+            start = coarse->findEnclosingStart(&node);
+          }
 
           // Find the MPI owner or the
           int mpi_owner = mpi_rank;
-          TMROctant *t =
-              coarse->findEnclosing(mesh_order, knots, &node, &mpi_owner);
+          TMROctant *t = coarse->findEnclosing(mesh_order, knots, &node, start,
+                                               &mpi_owner);
 
           // The node is owned a coarse element on this processor
           if (t) {
@@ -6680,7 +10520,7 @@ void TMROctForest::createInterpolation(TMROctForest *coarse,
               vars[k] = weights[k].index;
               wvals[k] = weights[k].weight;
             }
-            interp->addInterp(c[j], wvals, vars, nweights);
+            addInterpRow(interp, c[j], wvals, vars, nweights);
           } else {
             // We've got to transfer the node to the processor that
             // owns an enclosing element. Do to that, add the
@@ -6706,11 +10546,6 @@ void TMROctForest::createInterpolation(TMROctForest *coarse,
   ext_array->getArray(&array, &size);
   qsort(array, size, sizeof(TMROctant), compare_octant_tags);
 
-  // The number of octants that will be sent from this processor
-  // to all other processors in the communicator
-  int *oct_ptr = new int[mpi_size + 1];
-  int *oct_recv_ptr = new int[mpi_size + 1];
-
   // Match the octant intervals to determine how mnay octants
   // need to be sent to each processor
   matchTagIntervals(array, size, oct_ptr);
@@ -6725,6 +10560,39 @@ void TMROctForest::createInterpolation(TMROctForest *coarse,
     array[i].tag = conn[nodes_per_element * t->tag + array[i].info];
   }
 
+  // Free the temporary arrays
+  delete[] tmp;
+  delete[] vars;
+  delete[] wvals;
+  delete[] weights;
+
+  return ext_array;
+}
+
+/*
+  Exchange the remaining nodes and complete the interpolation
+
+  This call is collective. It takes ownership of the ext_array.
+*/
+void TMROctForest::endInterpolation(TMROctForest *coarse,
+                                    TACSBVecInterp *interp,
+                                    TMROctantArray *ext_array,
+                                    const int *oct_ptr) {
+  // Allocate temporary space for the interpolation
+  double *tmp = new double[3 * coarse->mesh_order];
+  const int order = coarse->mesh_order;
+  int max_nodes = order * order * order;
+  int *vars = new int[max_nodes];
+  double *wvals = new double[max_nodes];
+  int max_weights = order * order * order * order * order;
+  TMRIndexWeight *weights = new TMRIndexWeight[max_weights];
+
+  // Set the knots to use in the interpolation
+  const double *knots = interp_knots;
+
+  // The range of octants received from each processor
+  int *oct_recv_ptr = new int[mpi_size + 1];
+
   // Count up the number of octants destined for other procs
   int *oct_counts = new int[mpi_size];
   for (int i = 0; i < mpi_size; i++) {
@@ -6737,7 +10605,7 @@ void TMROctForest::createInterpolation(TMROctForest *coarse,
 
   // Now distribute the octants to their destination processors
   int *oct_recv_counts = new int[mpi_size];
-  MPI_Alltoall(oct_counts, 1, MPI_INT, oct_recv_counts, 1, MPI_INT, comm);
+  TMRExchangeCounts(comm, oct_counts, oct_recv_counts);
 
   // Now use oct_ptr to point into the recv array
   oct_recv_ptr[0] = 0;
@@ -6750,7 +10618,6 @@ void TMROctForest::createInterpolation(TMROctForest *coarse,
 
   // Distribute the octants based on the oct_ptr/oct_recv_ptr arrays
   TMROctantArray *recv_array = sendOctants(ext_array, oct_ptr, oct_recv_ptr);
-  delete[] oct_ptr;
   delete[] oct_recv_ptr;
   delete ext_array;
 
@@ -6759,11 +10626,20 @@ void TMROctForest::createInterpolation(TMROctForest *coarse,
   TMROctant *recv_nodes;
   recv_array->getArray(&recv_nodes, &recv_size);
 
+  // Sort the nodes so that the nodes from the same fine element are
+  // adjacent and can share the start of the search
+  qsort(recv_nodes, recv_size, sizeof(TMROctant), compare_octant_nodes);
+
   // Recv the nodes and loop over the connectivity
+  int start = 0;
   for (int i = 0; i < recv_size; i++) {
+    if (i == 0 || recv_nodes[i].compare(&recv_nodes[i - 1]) != 0) {
+      start = coarse->findEnclosingStart(&recv_nodes[i]);
+    }
+
     int mpi_owner;
-    TMROctant *t =
-        coarse->findEnclosing(mesh_order, knots, &recv_nodes[i], &mpi_owner);
+    TMROctant *t = coarse->findEnclosing(mesh_order, knots, &recv_nodes[i],
+                                         start, &mpi_owner);
     if (t) {
       // Compute the element interpolation
       int nweights = computeElemInterp(&recv_nodes[i], coarse, t, weights, tmp);
@@ -6772,7 +10648,7 @@ void TMROctForest::createInterpolation(TMROctForest *coarse,
         vars[k] = weights[k].index;
         wvals[k] = weights[k].weight;
       }
-      interp->addInterp(recv_nodes[i].tag, wvals, vars, nweights);
+      addInterpRow(interp, recv_nodes[i].tag, wvals, vars, nweights);
     } else {
       // This should not happen. Print out an error message here.
       fprintf(stderr,
@@ -6792,6 +10668,144 @@ void TMROctForest::createInterpolation(TMROctForest *coarse,
   delete[] weights;
 }
 
+/*
+  Set whether to retain the interpolation built by createInterpolation()
+
+  When active, the interpolation rows are recorded along with the
+  coarse forest and the node stamps of both forests. A later call to
+  createInterpolation() with the same coarse forest, when neither
+  forest has been changed since, adds the recorded rows directly and
+  skips the search for the enclosing coarse octants and the
+  communication. Any change in either mesh renumbers the nodes, so the
+  rows are then rebuilt from scratch.
+*/
+void TMROctForest::setCacheInterpolation(int _cache_interp) {
+  cache_interp = _cache_interp;
+  if (!cache_interp) {
+    freeInterpCache();
+  }
+}
+
+/*
+  Get whether the interpolation is retained by createInterpolation()
+*/
+int TMROctForest::getCacheInterpolation() { return cache_interp; }
+
+/*
+  Get the interpolation rows recorded by createInterpolation()
+
+  The rows are only available when the interpolation is cached, and
+  only if they were built for the given coarse forest with neither
+  forest changed since. Each processor returns the rows that it added
+  to the interpolation, which are not necessarily the rows of its owned
+  nodes. The vars are global node numbers on the coarse forest.
+
+  input:
+  coarse:   the coarse forest
+
+  output:
+  rows:     the global node number on this forest of each row
+  ptr:      the offset into vars/weights for each row
+  vars:     the coarse node numbers
+  weights:  the interpolation weights
+
+  returns:  the number of rows, or -1 if no valid rows are recorded
+*/
+int TMROctForest::getInterpolationRows(TMROctForest *coarse,
+                                       const int **_rows, const int **_ptr,
+                                       const int **_vars,
+                                       const double **_weights) {
+  if (!interp_cache_ptr || interp_cache_coarse != coarse ||
+      interp_cache_stamps[0] != node_stamp ||
+      interp_cache_stamps[1] != coarse->node_stamp) {
+    return -1;
+  }
+  if (_rows) {
+    *_rows = interp_cache_rows;
+  }
+  if (_ptr) {
+    *_ptr = interp_cache_ptr;
+  }
+  if (_vars) {
+    *_vars = interp_cache_vars;
+  }
+  if (_weights) {
+    *_weights = interp_cache_weights;
+  }
+  return interp_cache_nrows;
+}
+
+/*
+  Free the recorded interpolation rows
+*/
+void TMROctForest::freeInterpCache() {
+  if (interp_cache_rows) {
+    delete[] interp_cache_rows;
+  }
+  if (interp_cache_ptr) {
+    delete[] interp_cache_ptr;
+  }
+  if (interp_cache_vars) {
+    delete[] interp_cache_vars;
+  }
+  if (interp_cache_weights) {
+    delete[] interp_cache_weights;
+  }
+  interp_cache_coarse = NULL;
+  interp_cache_stamps[0] = interp_cache_stamps[1] = 0;
+  interp_cache_nrows = 0;
+  interp_cache_max_rows = 0;
+  interp_cache_max_weights = 0;
+  interp_cache_rows = NULL;
+  interp_cache_ptr = NULL;
+  interp_cache_vars = NULL;
+  interp_cache_weights = NULL;
+}
+
+/*
+  Add a row to the interpolation, recording it if caching is active
+*/
+void TMROctForest::addInterpRow(TACSBVecInterp *interp, int row, double *wvals,
+                                int *vars, int nweights) {
+  interp->addInterp(row, wvals, vars, nweights);
+
+  if (cache_interp && interp_cache_ptr) {
+    // Extend the arrays if required
+    if (interp_cache_nrows >= interp_cache_max_rows) {
+      int max_rows = 2 * interp_cache_max_rows + 1;
+      int *rows = new int[max_rows];
+      int *ptr = new int[max_rows + 1];
+      memcpy(rows, interp_cache_rows, interp_cache_nrows * sizeof(int));
+      memcpy(ptr, interp_cache_ptr, (interp_cache_nrows + 1) * sizeof(int));
+      delete[] interp_cache_rows;
+      delete[] interp_cache_ptr;
+      interp_cache_rows = rows;
+      interp_cache_ptr = ptr;
+      interp_cache_max_rows = max_rows;
+    }
+    int start = interp_cache_ptr[interp_cache_nrows];
+    if (start + nweights > interp_cache_max_weights) {
+      int max_weights = 2 * interp_cache_max_weights + nweights;
+      int *v = new int[max_weights];
+      double *w = new double[max_weights];
+      memcpy(v, interp_cache_vars, start * sizeof(int));
+      memcpy(w, interp_cache_weights, start * sizeof(double));
+      delete[] interp_cache_vars;
+      delete[] interp_cache_weights;
+      interp_cache_vars = v;
+      interp_cache_weights = w;
+      interp_cache_max_weights = max_weights;
+    }
+
+    // Record the row
+    interp_cache_rows[interp_cache_nrows] = row;
+    memcpy(&interp_cache_vars[start], vars, nweights * sizeof(int));
+    memcpy(&interp_cache_weights[start], wvals, nweights * sizeof(double));
+    interp_cache_ptr[interp_cache_nrows + 1] = start + nweights;
+    interp_cache_nrows++;
+  }
+}
+
 /*
   Initialize the node label
 */
@@ -52,9 +52,10 @@ class TMROctForest : public TMREntity {
                TMRInterpolationType interp_type = TMR_GAUSS_LOBATTO_POINTS);
   ~TMROctForest();
 
-  // Get the MPI communicator
-  // ------------------------
+  // Get/set the MPI communicator
+  // ----------------------------
   MPI_Comm getMPIComm() { return comm; }
+  int setMPIComm(MPI_Comm _comm);
 
   // Set the topology (and determine the connectivity)
   // -------------------------------------------------
@@ -63,11 +64,13 @@ class TMROctForest : public TMREntity {
 
   // Set the connectivity
   // --------------------
-  void setConnectivity(int _num_nodes, const int *_block_conn, int _num_blocks);
+  void setConnectivity(int _num_nodes, const int *_block_conn, int _num_blocks,
+                       const TMRPoint *_node_pts = NULL);
   void setFullConnectivity(int _num_nodes, int _num_edges, int _num_faces,
                            int _num_blocks, const int *_block_conn,
                            const int *_block_edge_conn,
-                           const int *_block_face_conn);
+                           const int *_block_face_conn,
+                           const TMRPoint *_node_pts = NULL);
 
   // Set/get the interpolation and order
   // -----------------------------------
@@ -76,9 +79,16 @@ class TMROctForest : public TMREntity {
   int getMeshOrder();
   TMRInterpolationType getInterpType();
 
-  // Re-partition the octrees based on element count
-  // -----------------------------------------------
-  void repartition(int max_rank = -1);
+  // Set/get the order of each local element
+  // ---------------------------------------
+  void setElementOrders(const int orders[]);
+  int getElementOrders(const int **orders);
+
+  // Re-partition the octrees based on element count or weight
+  // ---------------------------------------------------------
+  void repartition(int max_rank = -1, const double weights[] = NULL);
+  void alignPartition(TMROctForest *forest);
+  void setPartitionTolerance(double tol);
 
   // Create the forest of octrees
   // ----------------------------
@@ -89,16 +99,40 @@ class TMROctForest : public TMREntity {
   // -------------------------------
   TMROctForest *duplicate();
   TMROctForest *coarsen();
+  TMROctForest *coarsenBalanced(int balance_corner = 0);
 
   // Refine the mesh
   // ---------------
   void refine(const int refinement[] = NULL, int min_level = 0,
               int max_level = TMR_MAX_LEVEL);
+  void refineToLevels(const int levels[], int balance_corner = 0);
 
   // Balance the octree meshes
   // -------------------------
   void balance(int balance_corner = 0);
 
+  // Set the number of threads used within each MPI process
+  // ------------------------------------------------------
+  void setNumThreads(int _num_threads);
+  int getNumThreads();
+
+  // Retain the previous node locations on refine() for reuse
+  // --------------------------------------------------------
+  void setIncrementalNodes(int _incremental_nodes);
+  int getIncrementalNodes();
+
+  // Exchange octants with processors on the same node through shared
+  // memory (collective on the forest communicator)
+  // ------------------------------------------------------------------
+  void setUseSharedMemory(int flag);
+  int getUseSharedMemory();
+
+  // Share a single copy of the block connectivity between the
+  // processors on the same node (set before the connectivity)
+  // ------------------------------------------------------------------
+  void setUseSharedConnectivity(int flag);
+  int getUseSharedConnectivity();
+
   // Create and order the nodes
   // --------------------------
   void createNodes();
@@ -113,6 +147,17 @@ class TMROctForest : public TMREntity {
   // Create interpolation/restriction operators
   // ------------------------------------------
   void createInterpolation(TMROctForest *coarse, TACSBVecInterp *interp);
+  int beginInterpolation(TMROctForest *coarse, TACSBVecInterp *interp);
+  TMROctantArray *computeLocalInterpolation(TMROctForest *coarse,
+                                            TACSBVecInterp *interp,
+                                            int *oct_ptr);
+  void endInterpolation(TMROctForest *coarse, TACSBVecInterp *interp,
+                        TMROctantArray *ext_array, const int *oct_ptr);
+  void setCacheInterpolation(int _cache_interp);
+  int getCacheInterpolation();
+  int getInterpolationRows(TMROctForest *coarse, const int **_rows,
+                           const int **_ptr, const int **_vars,
+                           const double **_weights);
 
   // Get the nodes or elements with a certain name
   // ---------------------------------------------
@@ -126,9 +171,16 @@ class TMROctForest : public TMREntity {
   // Get the octants and the nodes
   // -----------------------------
   void getOctants(TMROctantArray **_octants);
+  int getOctantNeighbors(const int **_ptr, const int **_neighbors,
+                         TMROctantArray **_adjacent = NULL);
+  int getGhostOctants(int depth, TMROctantArray **_ghosts,
+                      const int **_owners = NULL,
+                      const int **_layer_ptr = NULL);
   int getNodeNumbers(const int **_node_numbers);
   int getExtPreOffset();
   int getPoints(TMRPoint **_X);
+  int getPointComponents(const double **_x, const double **_y,
+                         const double **_z);
   int getLocalNodeNumber(int node);
   int getInterpKnots(const double **_knots);
   void evalInterp(const double pt[], double N[]);
@@ -137,6 +189,12 @@ class TMROctForest : public TMREntity {
   void evalInterp(const double pt[], double N[], double N1[], double N2[],
                   double N3[], double N11[], double N22[], double N33[],
                   double N23[], double N13[], double N12[]);
+  void evalInterp(int npts, const double pts[], double N[]);
+  void evalInterp(int npts, const double pts[], double N[], double Nxi[],
+                  double Neta[], double Nzeta[]);
+  int getInterpTable(int npts, const double pts[], const double **_N,
+                     const double **_Nxi = NULL, const double **_Neta = NULL,
+                     const double **_Nzeta = NULL);
 
   // Retrieve the connectivity information
   // -------------------------------------
@@ -155,6 +213,9 @@ class TMROctForest : public TMREntity {
   // ----------------------------------------
   TMROctant *findEnclosing(const int order, const double *knots,
                            TMROctant *node, int *mpi_owner = NULL);
+  int findEnclosingStart(TMROctant *node);
+  TMROctant *findEnclosing(const int order, const double *knots,
+                           TMROctant *node, int start, int *mpi_owner);
 
   // Transform the octant to the global order
   // ----------------------------------------
@@ -167,18 +228,38 @@ class TMROctForest : public TMREntity {
                                     int **oct_ptr = NULL,
                                     int **oct_recv_ptr = NULL,
                                     int include_local = 0,
-                                    int use_node_index = 0);
+                                    int use_node_index = 0,
+                                    MPI_Datatype oct_type = TMROctant_MPI_type);
 
   // Send the octants back to their original processors (dual of distribute)
   // -----------------------------------------------------------------------
   TMROctantArray *sendOctants(TMROctantArray *list, const int *oct_ptr,
-                              const int *oct_recv_ptr, int use_node_index = 0);
+                              const int *oct_recv_ptr, int use_node_index = 0,
+                              MPI_Datatype oct_type = TMROctant_MPI_type);
+  int *sendOctantTags(TMROctantArray *list, const int *oct_ptr,
+                      const int *oct_recv_ptr);
 
   // Write out files showing the connectivity
   // ----------------------------------------
   void writeToVTK(const char *filename);
   void writeToTecplot(const char *filename);
   void writeForestToVTK(const char *filename);
+  int writeForestToVTU(const char *filename, int use_float32 = 1);
+
+  // Compute histograms of the element quality metrics (collective)
+  // ---------------------------------------------------------------
+  int computeMeshQuality(int nbins, int hist[], double min_quality[] = NULL);
+
+  // Write/read the forest to/from a binary checkpoint file
+  // ------------------------------------------------------
+  int writeForestToFile(const char *filename);
+  int readForestFromFile(const char *filename);
+
+  // Get the memory used by the forest and its high-water mark
+  // ---------------------------------------------------------
+  void getMemoryUsage(TMRMemoryUsage *usage);
+  void getMaxMemoryUsage(TMRMemoryUsage *usage);
+  void resetMaxMemoryUsage();
 
  private:
   // Labels for the nodes
@@ -187,10 +268,39 @@ class TMROctForest : public TMREntity {
   static const int TMR_OCT_FACE_LABEL = 2;
   static const int TMR_OCT_BLOCK_LABEL = 3;
 
+  // The maximum number of cached shape function tables
+  static const int MAX_INTERP_TABLES = 8;
+
+  // The maximum number of octants evaluated in one geometry call
+  static const int MAX_EVAL_BATCH_SIZE = 64;
+
+  // The maximum number of passes used to remove the references to
+  // dependent nodes from the dependent node connectivity
+  static const int MAX_DEP_NODE_DEPTH = 16;
+
+  // The alignment in bytes of the node location component arrays
+  static const int POINT_COMPONENT_ALIGNMENT = 64;
+
   // Free the internally stored data and zero things
   void freeData();
+  void freePointComponents();
+  void freeGhostOctants();
+  void freeInterpTables();
+  void freeInterpCache();
   void freeMeshData(int free_quads = 1, int free_owners = 1);
   void copyData(TMROctForest *copy);
+  void freePrevMeshData();
+  void freeNameIndex();
+
+  // Update the memory high-water mark with the transient hash table
+  // and node array sizes
+  void updateMaxMemoryUsage(long int hash_size = 0, long int node_size = 0);
+
+  // Compute the index from the entity names to the octants and nodes
+  void computeNameIds();
+  int getNameId(const char *name);
+  void computeOctNameIndex();
+  void computeNodeNameIndex();
 
   // Compute the node connectivity information
   void computeNodesToBlocks();
@@ -206,9 +316,16 @@ class TMROctForest : public TMREntity {
   // Set the owners - this determines how the mesh will be ordered
   void computeBlockOwners();
 
+  // Copy the block connectivity into node-local shared memory
+  void initSharedBlockConn();
+  void shareBlockConn(int has_node_pts);
+
   // Get the octant owner
   int getOctantMPIOwner(TMROctant *oct);
 
+  // Move the octants to a new partition
+  void redistributeOctants(const int *ptr, const int *new_ptr);
+
   // match the ownership intervals
   void matchOctantIntervals(TMROctant *array, int size, int *ptr);
   void matchTagIntervals(TMROctant *array, int size, int *ptr);
@@ -220,6 +337,13 @@ class TMROctForest : public TMREntity {
                      TMROctantHash *ext_hash, TMROctantQueue *queue,
                      const int balance_corner, const int balance_tree);
 
+  // Balance the octants in the level queues from the finest level
+  void balanceLevels(TMROctantQueue **queues, TMROctantHash *hash,
+                     TMROctantHash *ext_hash, const int balance_corner);
+
+  // Balance a contiguous range of the local octants in a worker thread
+  static void *balanceThread(void *args);
+
   // Add adjacent octants to the hashes/queues for balancing
   void addFaceNeighbors(int face_index, TMROctant p, TMROctantHash *hash,
                         TMROctantHash *ext_hash, TMROctantQueue *queue);
@@ -244,14 +368,33 @@ class TMROctForest : public TMREntity {
   int checkAdjacentFaces(int face_index, TMROctant *neighbor);
   int checkAdjacentEdges(int edge_index, TMROctant *neighbor);
 
+  // Compute the face/edge/corner neighbors of the local octants
+  void computeOctantNeighbors();
+  int getAdjacentBlockOctants(TMROctant *q, TMROctant *adj);
+  void addOctantNeighbors(TMROctantHash *hash, TMROctant *oct, TMROctant *r,
+                          int start, TMROctant *adj, int *len, int *max_len);
+
+  // Extend the ghost octants to the given number of layers
+  void computeGhostOctants(int depth);
+
   // Label the dependent nodes on the locally owned blocks
   void labelDependentNodes(int *nodes);
 
   // Create the global node ownership data
   TMROctantArray *createLocalNodes();
+  void addElementNodes(int start, int end, TMROctantHash *hash);
+  void addDependentNodes(int start, int end, TMROctantHash *hash);
+
+  // Create the local nodes for a range of the local octants in a thread
+  static void *createNodesThread(void *args);
 
   // Create the local connectivity based on the input node array
   void createLocalConn(TMROctantArray *nodes, const int *node_offset);
+  void addLocalConn(TMROctantArray *nodes, const int *node_offset, int start,
+                    int end);
+
+  // Create the connectivity for a range of the local octants in a thread
+  static void *localConnThread(void *args);
 
   // Get the local node numbers associated with an edge/face
   void getEdgeNodes(TMROctant *oct, int edge_index, TMROctantArray *nodes,
@@ -263,10 +406,29 @@ class TMROctForest : public TMREntity {
   void createDependentConn(const int *node_nums, TMROctantArray *nodes,
                            const int *node_offset);
 
+  // Compute the node orders and the constraints from the element orders
+  int *computeNodeOrders(TMROctantArray *nodes, const int *node_offset);
+  void applyOrderConstraints(int op, TMROctantArray *nodes,
+                             const int *node_offset, const int *node_orders,
+                             int *node_nums, int num_level_dep_nodes,
+                             int *order_ptr, int *order_conn,
+                             double *order_weights);
+  void createOrderDependentConn(int *node_nums, TMROctantArray *nodes,
+                                const int *node_offset);
+  void freeElementOrders();
+
   // Compute the node locations
   void evaluateNodeLocations();
+  void evaluateDeferredNodeLocations();
+  int copyPrevNodeLocations(TMROctant *oct, const int *c, int *flags);
+  const double *getInterpInverse();
+
+  // Evaluate the nodes for a range of the local octants in a thread
+  static void *evalNodesThread(void *args);
 
   // Compute the element interpolation
+  void addInterpRow(TACSBVecInterp *interp, int row, double *wvals,
+                    int *vars, int nweights);
   int computeElemInterp(TMROctant *node, TMROctForest *coarse, TMROctant *oct,
                         TMRIndexWeight *weights, double *tmp);
 
@@ -278,9 +440,19 @@ class TMROctForest : public TMREntity {
   MPI_Comm comm;
   int mpi_rank, mpi_size;
 
+  // The number of threads used within each MPI process
+  int num_threads;
+
   // Information about the type of interpolation
   TMRInterpolationType interp_type;
   double *interp_knots;
+  TMRInterpTable *interp_tables;
+  double *interp_inverse;
+
+  // Barycentric weights and kernels specialized for the mesh order
+  double interp_weights[MAX_ORDER];
+  TMRInterpKernel interp_kernel;
+  TMRInterpDerivKernel3D interp_deriv_kernel;
 
   // The owner octants which dictates the partitioning of the octants
   // across processors
@@ -290,6 +462,9 @@ class TMROctForest : public TMREntity {
   int mesh_order;
   int *conn;
 
+  // The order of each local element (NULL if all use the mesh order)
+  int *elem_orders;
+
   // Set the range of nodes owned by each processor
   int *node_range;
 
@@ -313,13 +488,74 @@ class TMROctForest : public TMREntity {
   // The octants that are adjacent to this processor
   TMROctantArray *adjacent;
 
+  // The face/edge/corner neighbors of the local octants in CSR format
+  int *neighbor_ptr, *neighbor_list;
+
+  // The ghost octants ordered by layer, their owners and the pointer
+  // into the ghosts for each of the ghost_depth layers
+  int ghost_depth;
+  TMROctantArray *ghosts;
+  int *ghost_owners, *ghost_layer_ptr;
+
   // The array of all the nodes
   TMRPoint *X;
 
+  // Flag indicating that the evaluation of X is deferred until the node
+  // locations are first requested
+  int deferred_node_locations;
+
+  // The x, y and z components of the nodes in separate aligned arrays,
+  // copied from X when they are first requested
+  double *Xcomp;
+
+  // A stamp, unique within the process, assigned by createNodes()
+  int node_stamp;
+
+  // The fraction of the partition size that the cuts of the partition
+  // may move to align with the octrees
+  double partition_tol;
+
+  // The interpolation rows recorded by createInterpolation(), along
+  // with the coarse forest and the node stamps they were built from
+  int cache_interp;
+  TMROctForest *interp_cache_coarse;
+  int interp_cache_stamps[2];
+  int interp_cache_nrows, interp_cache_max_rows, interp_cache_max_weights;
+  int *interp_cache_rows, *interp_cache_ptr, *interp_cache_vars;
+  double *interp_cache_weights;
+
+  // The node-local shared memory used to exchange octants between
+  // processors on the same node (if any)
+  TMRNodeSharedBuffer *node_buffer;
+
+  // Flag indicating whether the block connectivity is shared between
+  // the processors on the same node
+  int shared_conn;
+
+  // The octants, connectivity, sorted node numbers and node locations
+  // retained from before the last refine() call when incremental node
+  // creation is active
+  int incremental_nodes;
+  TMROctantArray *prev_octants;
+  int *prev_conn, *prev_node_numbers;
+  int prev_num_local_nodes;
+  TMRPoint *prev_X;
+
+  // The memory high-water mark recorded by balance() and createNodes()
+  TMRMemoryUsage max_mem_usage;
+
   // The topology of the underlying model (if any)
   TMRTopology *topo;
 
-  // Class for the block connectivity
+  // For each name, the (octant index, info) pairs and the sorted node
+  // numbers that getOctsWithName() and getNodesWithName() return
+  int *name_oct_ptr, *name_oct_list;
+  int *name_node_ptr, *name_node_list;
+
+  // Class for the block connectivity. This data depends only on the
+  // block topology and is not modified once it has been created, so a
+  // single reference-counted instance is shared by all the forests
+  // created by duplicate() and coarsen().
   class TMRBlockConn : public TMREntity {
    public:
     TMRBlockConn() {
@@ -343,8 +579,37 @@ class TMROctForest : public TMREntity {
       face_block_owners = NULL;
       edge_block_owners = NULL;
       node_block_owners = NULL;
+      node_pts = NULL;
+
+      // The name index is created on demand
+      num_names = 0;
+      name_table = NULL;
+      vert_name_ids = edge_name_ids = NULL;
+      face_name_ids = volume_name_ids = NULL;
+
+      // The connectivity is not shared by default
+      node_comm = MPI_COMM_NULL;
+      node_rank = 0;
+      shared_win = MPI_WIN_NULL;
     }
     ~TMRBlockConn() {
+#if MPI_VERSION >= 3
+      // Free the shared window that holds the connectivity data
+      if (shared_win != MPI_WIN_NULL) {
+        MPI_Win_free(&shared_win);
+        block_conn = block_face_conn = block_edge_conn = NULL;
+        node_block_ptr = node_block_conn = NULL;
+        edge_block_ptr = edge_block_conn = NULL;
+        face_block_ptr = face_block_conn = NULL;
+        face_block_owners = edge_block_owners = NULL;
+        node_block_owners = block_face_ids = NULL;
+        node_pts = NULL;
+      }
+      if (node_comm != MPI_COMM_NULL) {
+        MPI_Comm_free(&node_comm);
+      }
+#endif  // MPI_VERSION >= 3
+
       // Free the connectivity data
       if (block_conn) {
         delete[] block_conn;
@@ -387,6 +652,31 @@ class TMROctForest : public TMREntity {
       if (node_block_owners) {
         delete[] node_block_owners;
       }
+      if (node_pts) {
+        delete[] node_pts;
+      }
+
+      // Free the entity names
+      if (name_table) {
+        for (int i = 0; i < num_names; i++) {
+          if (name_table[i]) {
+            delete[] name_table[i];
+          }
+        }
+        delete[] name_table;
+      }
+      if (vert_name_ids) {
+        delete[] vert_name_ids;
+      }
+      if (edge_name_ids) {
+        delete[] edge_name_ids;
+      }
+      if (face_name_ids) {
+        delete[] face_name_ids;
+      }
+      if (volume_name_ids) {
+        delete[] volume_name_ids;
+      }
     }
 
     // The following data is the same across all processors
@@ -407,6 +697,23 @@ class TMROctForest : public TMREntity {
 
     // Information to enable transformations between faces
     int *block_face_ids;
+
+    // The locations of the nodes (NULL unless set with the connectivity)
+    TMRPoint *node_pts;
+
+    // The unique entity names and the name index of each vertex, edge,
+    // face and volume. Index zero is reserved for entities without a
+    // name. These are computed from the topology on demand.
+    int num_names;
+    char **name_table;
+    int *vert_name_ids, *edge_name_ids;
+    int *face_name_ids, *volume_name_ids;
+
+    // The communicator and rank on the node and the window holding the
+    // connectivity when it is shared between the processors on a node
+    MPI_Comm node_comm;
+    int node_rank;
+    MPI_Win shared_win;
   } * bdata;
 };
 
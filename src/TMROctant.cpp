@@ -320,15 +320,143 @@ static int compare_nodes(const void *a, const void *b) {
   return ao->compareNode(bo);
 }
 
+/*
+  Arrays with fewer than this number of octants are sorted with qsort
+*/
+static const int TMR_MIN_RADIX_SORT_SIZE = 128;
+
+/*
+  The key used in the radix sort of the octants.
+
+  The key consists of 144 bits stored in three words, ordered from the
+  least to the most significant: the level (or the info when sorting
+  nodes), the 96-bit Morton code formed from the interleaved x/y/z bits
+  and the block. Each signed value has its sign bit flipped so that the
+  unsigned ordering of the key matches the ordering produced by
+  TMROctant::compare() and TMROctant::compareNode().
+*/
+class TMROctantSortKey {
+ public:
+  uint64_t key[3];
+  int index;
+};
+
+/*
+  Spread the lower 21 bits of the input so that there are two zero
+  bits between each of the original bits
+*/
+static inline uint64_t spread_bits3(uint64_t u) {
+  u &= 0x1fffff;
+  u = (u | u << 32) & 0x1f00000000ffffULL;
+  u = (u | u << 16) & 0x1f0000ff0000ffULL;
+  u = (u | u << 8) & 0x100f00f00f00f00fULL;
+  u = (u | u << 4) & 0x10c30c30c30c30c3ULL;
+  u = (u | u << 2) & 0x1249249249249249ULL;
+  return u;
+}
+
+/*
+  Sort the octants using a least-significant digit radix sort
+
+  The sort uses 8-bit digits. The histograms for all the digits are
+  computed in a single pass and the passes where all the keys share the
+  same digit are skipped. This is common since the high-order bits of
+  the Morton code and block index are often the same for all octants.
+
+  The sort is stable, so octants that compare equal remain in their
+  original relative order.
+*/
+static void radix_sort_octants(TMROctant *array, int size,
+                               int use_node_index) {
+  // The number of 8-bit digits in each word of the key
+  static const int num_words = 3;
+  static const int word_digits[num_words] = {8, 6, 4};
+  static const int num_digits = 18;
+
+  TMROctantSortKey *keys = new TMROctantSortKey[size];
+  TMROctantSortKey *temp = new TMROctantSortKey[size];
+
+  // Compute the keys and the digit histograms
+  int *counts = new int[256 * num_digits];
+  memset(counts, 0, 256 * num_digits * sizeof(int));
+
+  for (int i = 0; i < size; i++) {
+    const uint32_t sign = 1U << 31;
+    uint32_t x = array[i].x ^ sign;
+    uint32_t y = array[i].y ^ sign;
+    uint32_t z = array[i].z ^ sign;
+    uint16_t tie = (use_node_index ? array[i].info : array[i].level);
+    tie ^= 0x8000;
+
+    // Form the low and high parts of the Morton code
+    uint64_t lo =
+        (spread_bits3(x) << 2) | (spread_bits3(y) << 1) | spread_bits3(z);
+    uint64_t hi = (spread_bits3(x >> 21) << 2) |
+                  (spread_bits3(y >> 21) << 1) | spread_bits3(z >> 21);
+
+    keys[i].key[0] = tie | (lo << 16);
+    keys[i].key[1] = (lo >> 48) | (hi << 15);
+    keys[i].key[2] = (uint32_t)array[i].block ^ sign;
+    keys[i].index = i;
+
+    for (int j = 0, d = 0; j < num_words; j++) {
+      for (int k = 0; k < word_digits[j]; k++, d++) {
+        counts[256 * d + ((keys[i].key[j] >> (8 * k)) & 0xff)]++;
+      }
+    }
+  }
+
+  for (int j = 0, d = 0; j < num_words; j++) {
+    for (int k = 0; k < word_digits[j]; k++, d++) {
+      int *count = &counts[256 * d];
+
+      // Skip this pass if all the keys share the same digit
+      if (count[(keys[0].key[j] >> (8 * k)) & 0xff] == size) {
+        continue;
+      }
+
+      // Convert the counts to offsets
+      for (int b = 0, offset = 0; b < 256; b++) {
+        int tmp = count[b];
+        count[b] = offset;
+        offset += tmp;
+      }
+
+      // Scatter the keys based on the current digit
+      for (int i = 0; i < size; i++) {
+        int b = (keys[i].key[j] >> (8 * k)) & 0xff;
+        temp[count[b]] = keys[i];
+        count[b]++;
+      }
+
+      TMROctantSortKey *t = keys;
+      keys = temp;
+      temp = t;
+    }
+  }
+
+  // Permute the octants into the sorted order
+  TMROctant *sorted = new TMROctant[size];
+  for (int i = 0; i < size; i++) {
+    sorted[i] = array[keys[i].index];
+  }
+  memcpy(array, sorted, size * sizeof(TMROctant));
+
+  delete[] sorted;
+  delete[] counts;
+  delete[] keys;
+  delete[] temp;
+}
+
 /*
   Store a array of octants
 */
 TMROctantArray::TMROctantArray(TMROctant *_array, int _size,
-                               int _use_node_index) {
+                               int _use_node_index, int _is_sorted) {
   array = _array;
   size = _size;
   max_size = size;
-  is_sorted = 0;
+  is_sorted = _is_sorted;
   use_node_index = _use_node_index;
 }
 
@@ -337,6 +465,13 @@ TMROctantArray::TMROctantArray(TMROctant *_array, int _size,
 */
 TMROctantArray::~TMROctantArray() { delete[] array; }
 
+/*
+  Get the number of bytes allocated for the octant array
+*/
+size_t TMROctantArray::getMemoryUsage() {
+  return max_size * sizeof(TMROctant);
+}
+
 /*
   Duplicate the array and return the copy
 */
@@ -355,9 +490,15 @@ TMROctantArray *TMROctantArray::duplicate() {
   entries.
 */
 void TMROctantArray::sort() {
-  if (use_node_index) {
+  if (size >= TMR_MIN_RADIX_SORT_SIZE) {
+    radix_sort_octants(array, size, use_node_index);
+  } else if (use_node_index) {
     qsort(array, size, sizeof(TMROctant), compare_nodes);
+  } else {
+    qsort(array, size, sizeof(TMROctant), compare_octants);
+  }
 
+  if (use_node_index) {
     // Now that the Octants are sorted, remove duplicates
     int i = 0;  // Location from which to take entries
     int j = 0;  // Location to place entries
@@ -375,8 +516,6 @@ void TMROctantArray::sort() {
     // The new size of the array
     size = j;
   } else {
-    qsort(array, size, sizeof(TMROctant), compare_octants);
-
     // Now that the Octants are sorted, remove duplicates
     int i = 0;  // Location from which to take entries
     int j = 0;  // Location to place entries
@@ -508,25 +647,259 @@ void TMROctantArray::getArray(TMROctant **_array, int *_size) {
   }
 }
 
+/*
+  Create a compact copy of the octant array
+
+  The array is sorted first (if required) so that the compact array
+  can be searched. NULL is returned if any octant is finer than
+  TMROctantCompactArray::MAX_COMPACT_LEVEL.
+*/
+TMROctantCompactArray *TMROctantArray::compress() {
+  if (!is_sorted) {
+    sort();
+  }
+
+  for (int i = 0; i < size; i++) {
+    if (!TMROctantCompactArray::isCompressible(&array[i])) {
+      return NULL;
+    }
+  }
+
+  return new TMROctantCompactArray(array, size, use_node_index);
+}
+
+/*
+  The number of low-order coordinate bits dropped in the compact form
+*/
+static const int TMR_COMPACT_SHIFT =
+    TMR_MAX_LEVEL - TMROctantCompactArray::MAX_COMPACT_LEVEL;
+
+/*
+  Collect every third bit of the input into the lower 21 bits. This is
+  the inverse of spread_bits3().
+*/
+static inline uint64_t compact_bits3(uint64_t u) {
+  u &= 0x1249249249249249ULL;
+  u = (u ^ (u >> 2)) & 0x10c30c30c30c30c3ULL;
+  u = (u ^ (u >> 4)) & 0x100f00f00f00f00fULL;
+  u = (u ^ (u >> 8)) & 0x1f0000ff0000ffULL;
+  u = (u ^ (u >> 16)) & 0x1f00000000ffffULL;
+  u = (u ^ (u >> 32)) & 0x1fffff;
+  return u;
+}
+
+/*
+  Create the compact octant array from a sorted array of octants
+*/
+TMROctantCompactArray::TMROctantCompactArray(const TMROctant *array,
+                                             int _size, int _use_node_index) {
+  use_node_index = _use_node_index;
+  size = _size;
+  keys = new uint64_t[size];
+  levels = new uint8_t[size];
+
+  // Count the number of block runs and check for tags and info
+  num_runs = 0;
+  int has_tags = 0, has_info = 0;
+  for (int i = 0; i < size; i++) {
+    if (i == 0 || array[i].block != array[i - 1].block) {
+      num_runs++;
+    }
+    if (array[i].tag != 0) {
+      has_tags = 1;
+    }
+    if (array[i].info != 0) {
+      has_info = 1;
+    }
+  }
+
+  run_blocks = new int32_t[num_runs];
+  run_ptr = new int[num_runs + 1];
+  tags = (has_tags ? new int32_t[size] : NULL);
+  infos = (has_info ? new int16_t[size] : NULL);
+
+  for (int i = 0, run = 0; i < size; i++) {
+    if (i == 0 || array[i].block != array[i - 1].block) {
+      run_blocks[run] = array[i].block;
+      run_ptr[run] = i;
+      run++;
+    }
+
+    uint64_t x = array[i].x >> TMR_COMPACT_SHIFT;
+    uint64_t y = array[i].y >> TMR_COMPACT_SHIFT;
+    uint64_t z = array[i].z >> TMR_COMPACT_SHIFT;
+    keys[i] = (spread_bits3(x) << 2) | (spread_bits3(y) << 1) | spread_bits3(z);
+    levels[i] = array[i].level;
+    if (tags) {
+      tags[i] = array[i].tag;
+    }
+    if (infos) {
+      infos[i] = array[i].info;
+    }
+  }
+  run_ptr[num_runs] = size;
+}
+
+/*
+  Free the compact octant array
+*/
+TMROctantCompactArray::~TMROctantCompactArray() {
+  delete[] keys;
+  delete[] levels;
+  delete[] run_blocks;
+  delete[] run_ptr;
+  if (tags) {
+    delete[] tags;
+  }
+  if (infos) {
+    delete[] infos;
+  }
+}
+
+/*
+  Check whether the octant can be represented exactly
+*/
+int TMROctantCompactArray::isCompressible(const TMROctant *oct) {
+  const int32_t mask = (1 << TMR_COMPACT_SHIFT) - 1;
+  return (oct->level >= 0 && oct->level <= MAX_COMPACT_LEVEL &&
+          oct->x >= 0 && oct->y >= 0 && oct->z >= 0 && !(oct->x & mask) &&
+          !(oct->y & mask) && !(oct->z & mask));
+}
+
+/*
+  Get the number of octants
+*/
+int TMROctantCompactArray::getSize() { return size; }
+
+/*
+  Find the block run that contains the octant index
+*/
+int TMROctantCompactArray::getRun(int index) {
+  int low = 0, high = num_runs - 1;
+  while (low < high) {
+    int mid = high - (high - low) / 2;
+    if (run_ptr[mid] <= index) {
+      low = mid;
+    } else {
+      high = mid - 1;
+    }
+  }
+  return low;
+}
+
+/*
+  Decode the octant with the given index
+*/
+void TMROctantCompactArray::get(int index, TMROctant *oct) {
+  uint64_t key = keys[index];
+  oct->block = run_blocks[getRun(index)];
+  oct->x = compact_bits3(key >> 2) << TMR_COMPACT_SHIFT;
+  oct->y = compact_bits3(key >> 1) << TMR_COMPACT_SHIFT;
+  oct->z = compact_bits3(key) << TMR_COMPACT_SHIFT;
+  oct->level = levels[index];
+  oct->tag = (tags ? tags[index] : 0);
+  oct->info = (infos ? infos[index] : 0);
+}
+
+/*
+  Find the index of the octant within the array
+
+  The search follows the ordering of the original array, so nodes are
+  matched by position and info while elements are matched by position
+  and level. Returns -1 if the octant is not found.
+*/
+int TMROctantCompactArray::findIndex(TMROctant *oct) {
+  if (!isCompressible(oct)) {
+    return -1;
+  }
+
+  // Find the run for the block
+  int run = -1;
+  for (int low = 0, high = num_runs - 1; low <= high;) {
+    int mid = low + (high - low) / 2;
+    if (run_blocks[mid] == oct->block) {
+      run = mid;
+      break;
+    } else if (run_blocks[mid] < oct->block) {
+      low = mid + 1;
+    } else {
+      high = mid - 1;
+    }
+  }
+  if (run < 0) {
+    return -1;
+  }
+
+  uint64_t x = oct->x >> TMR_COMPACT_SHIFT;
+  uint64_t y = oct->y >> TMR_COMPACT_SHIFT;
+  uint64_t z = oct->z >> TMR_COMPACT_SHIFT;
+  uint64_t key =
+      (spread_bits3(x) << 2) | (spread_bits3(y) << 1) | spread_bits3(z);
+  int tie = (use_node_index ? oct->info : oct->level);
+
+  // Search within the run for the key and level or info
+  int low = run_ptr[run], high = run_ptr[run + 1] - 1;
+  while (low <= high) {
+    int mid = low + (high - low) / 2;
+    int mid_tie = levels[mid];
+    if (use_node_index) {
+      mid_tie = (infos ? infos[mid] : 0);
+    }
+
+    if (keys[mid] == key && mid_tie == tie) {
+      return mid;
+    } else if (keys[mid] < key || (keys[mid] == key && mid_tie < tie)) {
+      low = mid + 1;
+    } else {
+      high = mid - 1;
+    }
+  }
+
+  return -1;
+}
+
+/*
+  Create a full octant array from the compact array
+*/
+TMROctantArray *TMROctantCompactArray::decompress() {
+  TMROctant *array = new TMROctant[size];
+  for (int run = 0; run < num_runs; run++) {
+    for (int i = run_ptr[run]; i < run_ptr[run + 1]; i++) {
+      get(i, &array[i]);
+    }
+  }
+  return new TMROctantArray(array, size, use_node_index);
+}
+
+/*
+  Get the number of bytes used to store the compact array
+*/
+size_t TMROctantCompactArray::getMemoryUsage() {
+  size_t mem = size * (sizeof(uint64_t) + sizeof(uint8_t));
+  mem += num_runs * sizeof(int32_t) + (num_runs + 1) * sizeof(int);
+  if (tags) {
+    mem += size * sizeof(int32_t);
+  }
+  if (infos) {
+    mem += size * sizeof(int16_t);
+  }
+  return mem;
+}
+
 /*
   Create an queue of octants
 */
 TMROctantQueue::TMROctantQueue() {
-  root = tip = NULL;
   num_elems = 0;
+  start = 0;
+  max_elems = min_queue_size;
+  array = new TMROctant[max_elems];
 }
 
 /*
   Free the queue
 */
-TMROctantQueue::~TMROctantQueue() {
-  OctQueueNode *node = root;
-  while (node) {
-    OctQueueNode *tmp = node;
-    node = node->next;
-    delete tmp;
-  }
-}
+TMROctantQueue::~TMROctantQueue() { delete[] array; }
 
 /*
   Get the length of the octant queue
@@ -537,15 +910,26 @@ int TMROctantQueue::length() { return num_elems; }
   Push a value onto the octant queue
 */
 void TMROctantQueue::push(TMROctant *oct) {
-  if (!tip) {
-    root = new OctQueueNode();
-    root->oct = *oct;
-    tip = root;
-  } else {
-    tip->next = new OctQueueNode();
-    tip->next->oct = *oct;
-    tip = tip->next;
+  if (num_elems >= max_elems) {
+    // Double the size of the buffer and unwrap the octants so that
+    // the first element in the queue is at the start of the array
+    int new_max_elems = 2 * max_elems;
+    TMROctant *temp = new TMROctant[new_max_elems];
+    int len = max_elems - start;
+    memcpy(temp, &array[start], len * sizeof(TMROctant));
+    memcpy(&temp[len], array, start * sizeof(TMROctant));
+    delete[] array;
+
+    array = temp;
+    max_elems = new_max_elems;
+    start = 0;
+  }
+
+  int index = start + num_elems;
+  if (index >= max_elems) {
+    index -= max_elems;
   }
+  array[index] = *oct;
   num_elems++;
 }
 
@@ -553,16 +937,14 @@ void TMROctantQueue::push(TMROctant *oct) {
   Pop a value from the octant queue
 */
 TMROctant TMROctantQueue::pop() {
-  if (!root) {
+  if (num_elems == 0) {
     return TMROctant();
   } else {
+    TMROctant temp = array[start];
     num_elems--;
-    TMROctant temp = root->oct;
-    OctQueueNode *tmp = root;
-    root = root->next;
-    delete tmp;
-    if (num_elems == 0) {
-      tip = NULL;
+    start++;
+    if (start >= max_elems || num_elems == 0) {
+      start = 0;
     }
     return temp;
   }
@@ -573,22 +955,39 @@ TMROctant TMROctantQueue::pop() {
 */
 TMROctantArray *TMROctantQueue::toArray() {
   // Allocate the array
-  TMROctant *array = new TMROctant[num_elems];
+  TMROctant *list_array = new TMROctant[num_elems];
 
-  // Scan through the queue and retrieve the octants
-  OctQueueNode *node = root;
-  int index = 0;
-  while (node) {
-    array[index] = node->oct;
-    node = node->next;
-    index++;
+  // Copy the octants from the ring buffer in at most two pieces
+  int len = max_elems - start;
+  if (len > num_elems) {
+    len = num_elems;
   }
+  memcpy(list_array, &array[start], len * sizeof(TMROctant));
+  memcpy(&list_array[len], array, (num_elems - len) * sizeof(TMROctant));
 
   // Create the array object
-  TMROctantArray *list = new TMROctantArray(array, num_elems);
+  TMROctantArray *list = new TMROctantArray(list_array, num_elems);
   return list;
 }
 
+/*
+  Check whether two octants are equal. This is equivalent to, but
+  faster than, checking compare() == 0.
+*/
+static inline int same_octant(const TMROctant *a, const TMROctant *b) {
+  return (a->block == b->block && a->x == b->x && a->y == b->y &&
+          a->z == b->z && a->level == b->level);
+}
+
+/*
+  Check whether two octants represent the same node. This is
+  equivalent to, but faster than, checking compareNode() == 0.
+*/
+static inline int same_node(const TMROctant *a, const TMROctant *b) {
+  return (a->block == b->block && a->x == b->x && a->y == b->y &&
+          a->z == b->z && a->info == b->info);
+}
+
 /*
   A hash for octants
 
@@ -598,28 +997,35 @@ TMROctantArray *TMROctantQueue::toArray() {
 */
 TMROctantHash::TMROctantHash(int _use_node_index) {
   use_node_index = _use_node_index;
+  num_slots = min_num_slots;
+  slots = new int[num_slots];
+  memset(slots, 0xff, num_slots * sizeof(int));
+
+  // Allocate space for the octants themselves. The load factor of
+  // the table never exceeds 1/2.
   num_elems = 0;
-  num_buckets = min_num_buckets;
-  hash_buckets = new OctHashNode *[num_buckets];
-  memset(hash_buckets, 0, num_buckets * sizeof(OctHashNode *));
+  max_elems = num_slots / 2;
+  array = new TMROctant[max_elems];
 }
 
 /*
   Free the memory allocated by the octant hash
 */
 TMROctantHash::~TMROctantHash() {
-  // Free all the elements in the hash
-  for (int i = 0; i < num_buckets; i++) {
-    OctHashNode *node = hash_buckets[i];
-    while (node) {
-      // Delete the old guy
-      OctHashNode *tmp = node;
-      node = node->next;
-      delete tmp;
-    }
-  }
+  delete[] slots;
+  delete[] array;
+}
+
+/*
+  Get the number of octants in the hash table
+*/
+int TMROctantHash::length() { return num_elems; }
 
-  delete[] hash_buckets;
+/*
+  Get the number of bytes allocated for the slots and octants
+*/
+size_t TMROctantHash::getMemoryUsage() {
+  return num_slots * sizeof(int) + max_elems * sizeof(TMROctant);
 }
 
 /*
@@ -627,23 +1033,12 @@ TMROctantHash::~TMROctantHash() {
 */
 TMROctantArray *TMROctantHash::toArray() {
   // Create an array of octants
-  TMROctant *array = new TMROctant[num_elems];
-
-  // Loop over all the buckets
-  for (int i = 0, index = 0; i < num_buckets; i++) {
-    // Get the hash bucket and extract all the elements from this
-    // bucket into the array
-    OctHashNode *node = hash_buckets[i];
-
-    while (node) {
-      array[index] = node->oct;
-      index++;
-      node = node->next;
-    }
-  }
+  TMROctant *list_array = new TMROctant[num_elems];
+  memcpy(list_array, array, num_elems * sizeof(TMROctant));
 
   // Create an array object and add it to the list
-  TMROctantArray *list = new TMROctantArray(array, num_elems, use_node_index);
+  TMROctantArray *list =
+      new TMROctantArray(list_array, num_elems, use_node_index);
   return list;
 }
 
@@ -661,138 +1056,121 @@ TMROctantArray *TMROctantHash::toArray() {
   true if the octant is added, false if it is not
 */
 int TMROctantHash::addOctant(TMROctant *oct) {
-  if (num_elems > 10 * num_buckets) {
-    // Redistribute the octants to new buckets
-    int num_old_buckets = num_buckets;
-    num_buckets = 2 * num_buckets;
-    OctHashNode **new_buckets = new OctHashNode *[num_buckets];
-    memset(new_buckets, 0, num_buckets * sizeof(OctHashNode *));
-
-    // Keep track of the end bucket
-    OctHashNode **end_buckets = new OctHashNode *[num_buckets];
-
-    // Redistribute the octant nodes based on the new
-    // number of buckets within the hash data structure
-    for (int i = 0; i < num_old_buckets; i++) {
-      OctHashNode *node = hash_buckets[i];
-      while (node) {
-        int bucket = getBucket(&(node->oct));
-
-        // If this is the first new bucket, create
-        // the new node
-        if (!new_buckets[bucket]) {
-          new_buckets[bucket] = new OctHashNode;
-          new_buckets[bucket]->oct = node->oct;
-          end_buckets[bucket] = new_buckets[bucket];
-        } else {
-          end_buckets[bucket]->next = new OctHashNode;
-          end_buckets[bucket]->next->oct = node->oct;
-          end_buckets[bucket] = end_buckets[bucket]->next;
-        }
-
-        // Delete the old guy
-        OctHashNode *tmp = node;
-
-        // Increment the node to the next hash
-        node = node->next;
-
-        // Free the node
-        delete tmp;
+  const int mask = num_slots - 1;
+  int slot = getSlot(oct);
+
+  // Probe the table until either the octant or an empty slot is found
+  if (use_node_index) {
+    while (slots[slot] >= 0) {
+      if (same_node(&array[slots[slot]], oct)) {
+        return 0;
       }
+      slot = (slot + 1) & mask;
     }
-
-    delete[] end_buckets;
-    delete[] hash_buckets;
-    hash_buckets = new_buckets;
-  }
-
-  int bucket = getBucket(oct);
-
-  // If no octant has been added to the bucket,
-  // create a new bucket
-  if (!hash_buckets[bucket]) {
-    hash_buckets[bucket] = new OctHashNode;
-    hash_buckets[bucket]->oct = *oct;
-    num_elems++;
-    return 1;
   } else {
-    // Get the head node for the corresponding bucket
-    OctHashNode *node = hash_buckets[bucket];
-    if (use_node_index) {
-      while (node) {
-        // The octant is in the list, quit now and return false
-        if (node->oct.compareNode(oct) == 0) {
-          return 0;
-        }
-
-        // If the next node does not exist, quit
-        // while node is the last node in the linked
-        // list
-        if (!node->next) {
-          break;
-        }
-        node = node->next;
-      }
-    } else {
-      while (node) {
-        // The octant is in the list, quit now and return false
-        if (node->oct.compare(oct) == 0) {
-          return 0;
-        }
-
-        // If the next node does not exist, quit
-        // while node is the last node in the linked
-        // list
-        if (!node->next) {
-          break;
-        }
-        node = node->next;
+    while (slots[slot] >= 0) {
+      if (same_octant(&array[slots[slot]], oct)) {
+        return 0;
       }
+      slot = (slot + 1) & mask;
     }
+  }
 
-    // Add the octant as the last node
-    node->next = new OctHashNode;
-    node->next->oct = *oct;
-    num_elems++;
+  // Extend the octant array if required
+  if (num_elems >= max_elems) {
+    max_elems = 2 * max_elems;
+    TMROctant *temp = new TMROctant[max_elems];
+    memcpy(temp, array, num_elems * sizeof(TMROctant));
+    delete[] array;
+    array = temp;
+  }
+
+  // Add the octant to the end of the array
+  array[num_elems] = *oct;
+  slots[slot] = num_elems;
+  num_elems++;
+
+  // Keep the load factor below 1/2
+  if (2 * num_elems > num_slots) {
+    resize();
   }
 
   return 1;
 }
 
 /*
-  Get a bucket to place the octant in.
+  Find an octant within the hash table.
 
-  This code creates a value based on the octant location within the
-  mesh and then takes the remainder of the number of buckets.
+  This uses the same comparison as addOctant(), so when the hash uses
+  a node index, the level of the octant is ignored.
+
+  input:
+  oct:   the octant to search for
+
+  returns:
+  a pointer to the octant within the table, or NULL if it is not found
 */
-int TMROctantHash::getBucket(TMROctant *oct) {
-  // The has value
-  uint32_t val = 0;
+TMROctant *TMROctantHash::contains(TMROctant *oct) {
+  const int mask = num_slots - 1;
+  int slot = getSlot(oct);
 
   if (use_node_index) {
-    uint32_t u = 0, v = 0, w = 0, x = 0;
-    u = oct->block;
-    v = (1 << TMR_MAX_LEVEL) + oct->x;
-    w = (1 << TMR_MAX_LEVEL) + oct->y;
-    x = (1 << TMR_MAX_LEVEL) + oct->z;
-    // y = oct->info;
-
-    // Compute the hash value
-    // val = TMRIntegerFiveTupleHash(u, v, w, x, y);
-    val = TMRIntegerFourTupleHash(u, v, w, x);
+    while (slots[slot] >= 0) {
+      if (same_node(&array[slots[slot]], oct)) {
+        return &array[slots[slot]];
+      }
+      slot = (slot + 1) & mask;
+    }
   } else {
-    uint32_t u = 0, v = 0, w = 0, x = 0;
-    u = oct->block;
-    v = (1 << TMR_MAX_LEVEL) + oct->x;
-    w = (1 << TMR_MAX_LEVEL) + oct->y;
-    x = (1 << TMR_MAX_LEVEL) + oct->z;
+    while (slots[slot] >= 0) {
+      if (same_octant(&array[slots[slot]], oct)) {
+        return &array[slots[slot]];
+      }
+      slot = (slot + 1) & mask;
+    }
+  }
+
+  return NULL;
+}
 
-    // Compute the hash value
-    val = TMRIntegerFourTupleHash(u, v, w, x);
+/*
+  Double the number of slots within the table and re-insert all of the
+  octants. The octants are already unique so no comparisons are
+  required.
+*/
+void TMROctantHash::resize() {
+  delete[] slots;
+  num_slots = 2 * num_slots;
+  slots = new int[num_slots];
+  memset(slots, 0xff, num_slots * sizeof(int));
+
+  const int mask = num_slots - 1;
+  for (int i = 0; i < num_elems; i++) {
+    int slot = getSlot(&array[i]);
+    while (slots[slot] >= 0) {
+      slot = (slot + 1) & mask;
+    }
+    slots[slot] = i;
   }
+}
+
+/*
+  Get the initial slot for the octant.
+
+  This code creates a value based on the octant location within the
+  mesh and then masks off the bits beyond the number of slots. The
+  level and info are not included, so octants that share a position
+  are resolved by probing.
+*/
+int TMROctantHash::getSlot(TMROctant *oct) {
+  uint32_t u = 0, v = 0, w = 0, x = 0;
+  u = oct->block;
+  v = (1 << TMR_MAX_LEVEL) + oct->x;
+  w = (1 << TMR_MAX_LEVEL) + oct->y;
+  x = (1 << TMR_MAX_LEVEL) + oct->z;
 
-  // Compute the bucket value
-  int bucket = val % num_buckets;
+  // Compute the hash value
+  uint32_t val = TMRIntegerFourTupleHash(u, v, w, x);
 
-  return bucket;
+  return val & (num_slots - 1);
 }
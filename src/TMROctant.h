@@ -60,11 +60,15 @@ class TMROctant {
   octants with a smaller level (that have larger side lengths).  After
   the array is sorted, it is searchable either based on elements (when
   use_nodes=0) or by node (use_nodes=1). The difference is that the
-  node search ignores the mesh level.
+  node search ignores the mesh level. An array that is already sorted
+  and unique may be flagged as sorted on construction.
 */
+class TMROctantCompactArray;
+
 class TMROctantArray {
  public:
-  TMROctantArray(TMROctant *array, int size, int _use_node_index = 0);
+  TMROctantArray(TMROctant *array, int size, int _use_node_index = 0,
+                 int _is_sorted = 0);
   ~TMROctantArray();
 
   TMROctantArray *duplicate();
@@ -72,6 +76,8 @@ class TMROctantArray {
   void sort();
   TMROctant *contains(TMROctant *q, int use_nodes = 0);
   void merge(TMROctantArray *list);
+  size_t getMemoryUsage();
+  TMROctantCompactArray *compress();
 
  private:
   int use_node_index;
@@ -80,11 +86,65 @@ class TMROctantArray {
   TMROctant *array;
 };
 
+/*
+  A compact, read-only copy of a sorted octant array
+
+  Each octant is stored as a 64-bit Morton key formed from the upper
+  21 bits of the x/y/z coordinates and an 8-bit level. The block index
+  is stored once for each contiguous run of octants on the same block,
+  and the tag and info are only stored when they are non-zero for at
+  least one octant. This reduces the storage from 24 bytes to 9 bytes
+  per octant for octants with a level of at most MAX_COMPACT_LEVEL.
+
+  The octants are decoded on the fly by get(). The search uses the
+  same ordering as the original array (either by element or node).
+*/
+class TMROctantCompactArray {
+ public:
+  // The finest level that can be stored in the compact form
+  static const int MAX_COMPACT_LEVEL = 20;
+
+  TMROctantCompactArray(const TMROctant *array, int size,
+                        int _use_node_index);
+  ~TMROctantCompactArray();
+
+  int getSize();
+  void get(int index, TMROctant *oct);
+  int findIndex(TMROctant *oct);
+  TMROctantArray *decompress();
+  size_t getMemoryUsage();
+
+  // Check whether the octant can be stored in the compact form
+  static int isCompressible(const TMROctant *oct);
+
+ private:
+  // Find the block run that contains the octant index
+  int getRun(int index);
+
+  int use_node_index;
+  int size;
+
+  // The Morton keys and levels for each octant
+  uint64_t *keys;
+  uint8_t *levels;
+
+  // The block index for each contiguous run of octants
+  int num_runs;
+  int32_t *run_blocks;
+  int *run_ptr;
+
+  // The tags and info (NULL if they are all zero)
+  int32_t *tags;
+  int16_t *infos;
+};
+
 /*
   Create a queue of octants
 
   This class defines a queue of octants that are used for the balance
-  and coarsen operations.
+  and coarsen operations. The octants are stored in a single ring
+  buffer, so push() and pop() do not allocate memory except when the
+  buffer must grow.
 */
 class TMROctantQueue {
  public:
@@ -97,17 +157,14 @@ class TMROctantQueue {
   TMROctantArray *toArray();
 
  private:
-  // Class that defines an element within the queue
-  class OctQueueNode {
-   public:
-    OctQueueNode() { next = NULL; }
-    TMROctant oct;
-    OctQueueNode *next;
-  };
-
-  // Keep track of the number of elements in the queue
-  int num_elems;
-  OctQueueNode *root, *tip;
+  // The initial capacity of the queue
+  static const int min_queue_size = 1 << 10;
+
+  // The octants are stored in a contiguous ring buffer. The first
+  // element in the queue is stored at array[start] and the buffer
+  // is doubled in size when it fills up.
+  int num_elems, max_elems, start;
+  TMROctant *array;
 };
 
 /*
@@ -116,6 +173,10 @@ class TMROctantQueue {
   This object enables the creation of a unique set of octants such
   that no two have the same position/level combination. This hash
   table can then be made into an array of unique elements or nodes.
+
+  The octants are stored in a single contiguous array and the table
+  itself uses open addressing with linear probing, so no memory is
+  allocated per octant.
 */
 class TMROctantHash {
  public:
@@ -124,30 +185,31 @@ class TMROctantHash {
 
   TMROctantArray *toArray();
   int addOctant(TMROctant *oct);
+  int length();
+  size_t getMemoryUsage();
+  TMROctant *contains(TMROctant *oct);
 
  private:
-  // The minimum bucket size
-  static const int min_num_buckets = (1 << 12) - 1;
-
-  class OctHashNode {
-   public:
-    OctHashNode() { next = NULL; }
-    TMROctant oct;
-    OctHashNode *next;
-  };
+  // The minimum number of slots in the table (must be a power of 2)
+  static const int min_num_slots = 1 << 12;
 
   // Keep track of whether to use a node-based search
   int use_node_index;
 
-  // Keep track of the bucket size
-  int num_buckets;
-  OctHashNode **hash_buckets;
+  // The open-addressing table. Each slot stores the index of an
+  // octant within the contiguous octant array, or -1 if empty.
+  int num_slots;
+  int *slots;
+
+  // The unique octants, stored contiguously in the order they were added
+  int num_elems, max_elems;
+  TMROctant *array;
 
-  // Keep track of the number of elements
-  int num_elems;
+  // Get the initial slot for the octant
+  int getSlot(TMROctant *oct);
 
-  // Get the buckets to place the octant in
-  int getBucket(TMROctant *oct);
+  // Double the number of slots and re-insert all the octants
+  void resize();
 };
 
 #endif  // TMR_OCTANT_H
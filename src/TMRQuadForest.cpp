@@ -20,9 +20,12 @@
 
 #include "TMRQuadForest.h"
 
+#include <pthread.h>
 #include <stdlib.h>
 
 #include "TMRInterpolation.h"
+#include "TMR_QualityTools.h"
+#include "TMR_VTKTools.h"
 #include "tmrlapack.h"
 
 /*
@@ -46,6 +49,15 @@ static int compare_quadrant_tags(const void *a, const void *b) {
   return A->tag - B->tag;
 }
 
+/*
+  Compare the element quadrants of two nodes, ignoring the node index
+*/
+static int compare_quadrant_nodes(const void *a, const void *b) {
+  const TMRQuadrant *A = static_cast<const TMRQuadrant *>(a);
+  const TMRQuadrant *B = static_cast<const TMRQuadrant *>(b);
+  return A->compare(B);
+}
+
 /*
   Convert from the integer coordinate system to a physical coordinate
   with the off-by-one check.
@@ -79,6 +91,10 @@ TMRQuadForest::TMRQuadForest(MPI_Comm _comm, int _mesh_order,
   // Set default mesh data
   mesh_order = 2;
   interp_knots = NULL;
+  interp_tables = NULL;
+  interp_inverse = NULL;
+  interp_kernel = NULL;
+  interp_deriv_kernel = NULL;
 
   // Set the topology object to NULL
   topo = NULL;
@@ -91,6 +107,8 @@ TMRQuadForest::TMRQuadForest(MPI_Comm _comm, int _mesh_order,
   quadrants = NULL;
   adjacent = NULL;
   X = NULL;
+  deferred_node_locations = 0;
+  Xcomp = NULL;
 
   // Set data for the number of elements/nodes/dependents
   conn = NULL;
@@ -105,6 +123,29 @@ TMRQuadForest::TMRQuadForest(MPI_Comm _comm, int _mesh_order,
   dep_conn = NULL;
   dep_weights = NULL;
 
+  // Cut the partition at any quadrant by default
+  partition_tol = 0.0;
+
+  // Use a single thread by default
+  num_threads = 1;
+
+  // No interpolation is cached by default
+  node_stamp = 0;
+  cache_interp = 0;
+  interp_cache_coarse = NULL;
+  interp_cache_stamps[0] = interp_cache_stamps[1] = 0;
+  interp_cache_nrows = 0;
+  interp_cache_max_rows = 0;
+  interp_cache_max_weights = 0;
+  interp_cache_rows = NULL;
+  interp_cache_ptr = NULL;
+  interp_cache_vars = NULL;
+  interp_cache_weights = NULL;
+
+  // The name index is created on demand
+  name_quad_ptr = name_quad_list = NULL;
+  name_node_ptr = name_node_list = NULL;
+
   // Set the mesh order
   setMeshOrder(_mesh_order, _interp_type);
 }
@@ -119,6 +160,8 @@ TMRQuadForest::~TMRQuadForest() {
   }
 
   freeData();
+  freeInterpTables();
+  freeInterpCache();
 }
 
 /*
@@ -143,6 +186,7 @@ void TMRQuadForest::freeData() {
   if (X) {
     delete[] X;
   }
+  freePointComponents();
 
   if (conn) {
     delete[] conn;
@@ -168,6 +212,7 @@ void TMRQuadForest::freeData() {
   quadrants = NULL;
   adjacent = NULL;
   X = NULL;
+  deferred_node_locations = 0;
 
   // Set data for the number of elements/nodes/dependents
   conn = NULL;
@@ -181,6 +226,9 @@ void TMRQuadForest::freeData() {
   dep_ptr = NULL;
   dep_conn = NULL;
   dep_weights = NULL;
+
+  // Free the index of the entity names
+  freeNameIndex();
 }
 
 /*
@@ -207,6 +255,7 @@ void TMRQuadForest::freeMeshData(int free_quads, int free_owners) {
   if (X) {
     delete[] X;
   }
+  freePointComponents();
 
   if (conn) {
     delete[] conn;
@@ -230,6 +279,7 @@ void TMRQuadForest::freeMeshData(int free_quads, int free_owners) {
   // Reset the data
   adjacent = NULL;
   X = NULL;
+  deferred_node_locations = 0;
 
   // Set data for the number of elements/nodes/dependents
   conn = NULL;
@@ -244,6 +294,29 @@ void TMRQuadForest::freeMeshData(int free_quads, int free_owners) {
   num_owned_nodes = 0;
   num_dep_nodes = 0;
   ext_pre_offset = 0;
+
+  // The name index refers to the quadrants and nodes
+  freeNameIndex();
+}
+
+/*
+  Free the index from the entity names to the quadrants and nodes
+*/
+void TMRQuadForest::freeNameIndex() {
+  if (name_quad_ptr) {
+    delete[] name_quad_ptr;
+  }
+  if (name_quad_list) {
+    delete[] name_quad_list;
+  }
+  if (name_node_ptr) {
+    delete[] name_node_ptr;
+  }
+  if (name_node_list) {
+    delete[] name_node_list;
+  }
+  name_quad_ptr = name_quad_list = NULL;
+  name_node_ptr = name_node_list = NULL;
 }
 
 /*
@@ -262,6 +335,34 @@ void TMRQuadForest::copyData(TMRQuadForest *copy) {
   if (copy->topo) {
     copy->topo->incref();
   }
+
+  copy->cache_interp = cache_interp;
+  copy->partition_tol = partition_tol;
+  copy->num_threads = num_threads;
+}
+
+/*
+  Set a new communicator for the forest
+
+  The new communicator must contain the same processors in the same
+  order as the current communicator, for instance a duplicate of it.
+  This is used to perform the collective operations for a forest on a
+  separate thread with a communicator that is not used by the other
+  threads, and to return the forest to the original communicator
+  afterwards.
+*/
+int TMRQuadForest::setMPIComm(MPI_Comm _comm) {
+  int result = MPI_UNEQUAL;
+  MPI_Comm_compare(comm, _comm, &result);
+  if (result != MPI_IDENT && result != MPI_CONGRUENT) {
+    fprintf(stderr,
+            "TMRQuadForest Error: The new communicator must contain the "
+            "same processors in the same order\n");
+    return 1;
+  }
+
+  comm = _comm;
+  return 0;
 }
 
 /*
@@ -314,9 +415,14 @@ TMRTopology *TMRQuadForest::getTopology() { return topo; }
 
   This information is required for creating quadtree forests on the
   unstructured mesh.
+
+  The locations of the nodes may optionally be provided. When no
+  topology is set, the node locations within each face are then
+  computed by bilinear interpolation of the face corner locations.
 */
 void TMRQuadForest::setConnectivity(int _num_nodes, const int *_face_conn,
-                                    int _num_faces) {
+                                    int _num_faces,
+                                    const TMRPoint *_node_pts) {
   // Free any data if it has already been allocated.
   freeData();
 
@@ -342,15 +448,23 @@ void TMRQuadForest::setConnectivity(int _num_nodes, const int *_face_conn,
 
   // Compute the face owners based on the node, edge and face data
   computeFaceOwners();
+
+  // Copy over the node locations
+  if (_node_pts) {
+    fdata->node_pts = new TMRPoint[_num_nodes];
+    memcpy(fdata->node_pts, _node_pts, _num_nodes * sizeof(TMRPoint));
+  }
 }
 
 /*
   Set the full connectivity, specifying the node, edge and face
-  numbers independently.
+  numbers independently. The node locations are optional (see
+  setConnectivity()).
 */
 void TMRQuadForest::setFullConnectivity(int _num_nodes, int _num_edges,
                                         int _num_faces, const int *_face_conn,
-                                        const int *_face_edge_conn) {
+                                        const int *_face_edge_conn,
+                                        const TMRPoint *_node_pts) {
   // Free any data allocated for other connectivities
   freeData();
 
@@ -379,6 +493,12 @@ void TMRQuadForest::setFullConnectivity(int _num_nodes, int _num_edges,
 
   // Compute the face owners based on the node, edge and face data
   computeFaceOwners();
+
+  // Copy over the node locations
+  if (_node_pts) {
+    fdata->node_pts = new TMRPoint[_num_nodes];
+    memcpy(fdata->node_pts, _node_pts, _num_nodes * sizeof(TMRPoint));
+  }
 }
 
 /*
@@ -871,6 +991,426 @@ void TMRQuadForest::writeForestToVTK(const char *filename) {
   }
 }
 
+/*
+  Write the entire forest to a single binary VTK XML file
+
+  This is a collective call. All processors write their quadrants to
+  a shared file so that the output does not depend on the number of
+  processors.
+*/
+int TMRQuadForest::writeForestToVTU(const char *filename, int use_float32) {
+  if (!topo) {
+    return 1;
+  }
+
+  // Get the quadrants
+  int size = 0;
+  TMRQuadrant *array = NULL;
+  if (quadrants) {
+    quadrants->getArray(&array, &size);
+  }
+
+  // Set the edge length
+  const int32_t hmax = 1 << TMR_MAX_LEVEL;
+
+  // Evaluate the corner points of each quadrant
+  TMRPoint *X = new TMRPoint[4 * size];
+  for (int k = 0; k < size; k++) {
+    const int32_t h = 1 << (TMR_MAX_LEVEL - array[k].level);
+
+    // Get the surface object and evaluate the point
+    TMRFace *surf;
+    topo->getFace(array[k].face, &surf);
+
+    for (int jj = 0; jj < 2; jj++) {
+      for (int ii = 0; ii < 2; ii++) {
+        double u = 1.0 * (array[k].x + ii * h) / hmax;
+        double v = 1.0 * (array[k].y + jj * h) / hmax;
+        surf->evalPoint(u, v, &X[4 * k + ii + 2 * jj]);
+      }
+    }
+  }
+
+  // Set the connectivity in the VTK ordering
+  const int vtk_order[4] = {0, 1, 3, 2};
+  int *ptr = new int[size + 1];
+  int *conn = new int[4 * size];
+  int *types = new int[size];
+  for (int k = 0; k < size; k++) {
+    ptr[k] = 4 * k;
+    for (int j = 0; j < 4; j++) {
+      conn[4 * k + j] = 4 * k + vtk_order[j];
+    }
+    types[k] = TMR_VTK_QUAD;
+  }
+  ptr[size] = 4 * size;
+
+  // Set the face index, refinement level and processor rank
+  const char *names[3] = {"entity_index", "level", "rank"};
+  double *data = new double[3 * size];
+  for (int k = 0; k < size; k++) {
+    data[k] = array[k].face;
+    data[size + k] = array[k].level;
+    data[2 * size + k] = mpi_rank;
+  }
+
+  int fail = TMR_WriteVTUFile(comm, filename, 4 * size, X, size, ptr, conn,
+                              types, 3, names, data, use_float32);
+
+  delete[] X;
+  delete[] ptr;
+  delete[] conn;
+  delete[] types;
+  delete[] data;
+
+  return fail;
+}
+
+/*
+  Compute histograms of the quality of the elements in the forest
+
+  The metrics are evaluated from the element corners (see
+  TMR_QualityTools.h) in a single pass over the local elements split
+  between the threads. The histograms are summed across all
+  processors, so this call is collective. The nodes must be created
+  before this call.
+
+  input:
+  nbins:        the number of bins in each histogram
+
+  output:
+  hist:         the histograms of the metrics (TMR_NUM_QUALITY_METRICS*nbins)
+  min_quality:  the minimum value of each metric (may be NULL)
+
+  returns:      the number of elements in the forest
+*/
+int TMRQuadForest::computeMeshQuality(int nbins, int hist[],
+                                      double min_quality[]) {
+  int num_elements = 0;
+  quadrants->getArray(NULL, &num_elements);
+  evaluateDeferredNodeLocations();
+  if (!conn || !X) {
+    fprintf(stderr,
+            "TMRQuadForest Error: Cannot compute the mesh quality before "
+            "the nodes and their locations are created\n");
+    num_elements = 0;
+  }
+
+  // The offsets of the element corners in the VTK order
+  const int m = mesh_order - 1;
+  const int corner_offset[4] = {0, m, m + m * mesh_order, m * mesh_order};
+  const int num_corners = 4;
+  const int conn_stride = mesh_order * mesh_order;
+
+  return TMR_ComputeMeshQuality(comm, num_threads, num_elements, num_corners,
+                                conn, conn_stride, corner_offset,
+                                num_local_nodes, node_numbers, X, nbins, hist,
+                                min_quality);
+}
+
+/*
+  Write the forest to a binary checkpoint file
+
+  The file contains a fixed-size header, the face connectivity and
+  the quadrants in their global order. The quadrants from each processor
+  are written at offsets computed from the number of quadrants on the
+  preceding processors, using collective MPI-IO. The node numbers are
+  not stored since they are recomputed by createNodes().
+
+  Note that the data is written in the native byte order.
+*/
+int TMRQuadForest::writeForestToFile(const char *filename) {
+  if (!fdata) {
+    return 1;
+  }
+
+  const int num_faces = fdata->num_faces;
+
+  // Get the quadrants
+  int size = 0;
+  TMRQuadrant *array = NULL;
+  if (quadrants) {
+    quadrants->getArray(&array, &size);
+  }
+
+  // Compute the offset for the local quadrants
+  int64_t local_size = size, quad_offset = 0, num_quads = 0;
+  MPI_Exscan(&local_size, &quad_offset, 1, MPI_INT64_T, MPI_SUM, comm);
+  if (mpi_rank == 0) {
+    quad_offset = 0;
+  }
+  MPI_Allreduce(&local_size, &num_quads, 1, MPI_INT64_T, MPI_SUM, comm);
+
+  // Set the header information
+  char header[TMR_FOREST_FILE_HEADER_SIZE];
+  memset(header, 0, sizeof(header));
+  memcpy(header, "TMRQUADF", 8);
+  int32_t info[8];
+  info[0] = TMR_FOREST_FILE_VERSION;
+  info[1] = sizeof(TMRQuadrant);
+  info[2] = mesh_order;
+  info[3] = interp_type;
+  info[4] = fdata->num_nodes;
+  info[5] = fdata->num_edges;
+  info[6] = num_faces;
+  info[7] = 0;
+  memcpy(&header[8], info, sizeof(info));
+  memcpy(&header[8 + sizeof(info)], &num_quads, sizeof(int64_t));
+
+  // Compute the location of the quadrants within the file
+  MPI_Offset conn_size = 8 * num_faces * sizeof(int);
+  MPI_Offset data_start = TMR_FOREST_FILE_HEADER_SIZE + conn_size;
+
+  char *fname = new char[strlen(filename) + 1];
+  strcpy(fname, filename);
+
+  MPI_File fp;
+  int fail = MPI_File_open(comm, fname, MPI_MODE_WRONLY | MPI_MODE_CREATE,
+                           MPI_INFO_NULL, &fp);
+  if (fail == MPI_SUCCESS) {
+    MPI_File_set_size(fp, data_start + num_quads * sizeof(TMRQuadrant));
+
+    if (mpi_rank == 0) {
+      MPI_Offset offset = 0;
+      MPI_File_write_at(fp, offset, header, TMR_FOREST_FILE_HEADER_SIZE,
+                        MPI_CHAR, MPI_STATUS_IGNORE);
+      offset += TMR_FOREST_FILE_HEADER_SIZE;
+      MPI_File_write_at(fp, offset, fdata->face_conn, 4 * num_faces, MPI_INT,
+                        MPI_STATUS_IGNORE);
+      offset += 4 * num_faces * sizeof(int);
+      MPI_File_write_at(fp, offset, fdata->face_edge_conn, 4 * num_faces,
+                        MPI_INT, MPI_STATUS_IGNORE);
+    }
+
+    MPI_File_write_at_all(fp, data_start + quad_offset * sizeof(TMRQuadrant),
+                          array, size, TMRQuadrant_MPI_type, MPI_STATUS_IGNORE);
+    MPI_File_close(&fp);
+  }
+
+  delete[] fname;
+
+  return (fail != MPI_SUCCESS);
+}
+
+/*
+  Read the forest from a binary checkpoint file written by
+  writeForestToFile()
+
+  The file may be read on a different number of processors than it
+  was written on. The quadrants are split evenly between processors in
+  their global order, so repartition() may be called afterwards when
+  a weighted partition is required.
+
+  If the connectivity has already been set (for instance through
+  setTopology()), it must match the connectivity stored in the file.
+  Otherwise, the connectivity is set from the file. The mesh order and
+  interpolation type are restored from the file. The nodes must be
+  re-created by calling createNodes().
+*/
+int TMRQuadForest::readForestFromFile(const char *filename) {
+  char *fname = new char[strlen(filename) + 1];
+  strcpy(fname, filename);
+
+  MPI_File fp;
+  int open_fail =
+      MPI_File_open(comm, fname, MPI_MODE_RDONLY, MPI_INFO_NULL, &fp);
+  delete[] fname;
+  if (open_fail != MPI_SUCCESS) {
+    return 1;
+  }
+
+  // Read in the header on all processors
+  char header[TMR_FOREST_FILE_HEADER_SIZE];
+  MPI_File_read_at_all(fp, 0, header, TMR_FOREST_FILE_HEADER_SIZE, MPI_CHAR,
+                       MPI_STATUS_IGNORE);
+  int32_t info[8];
+  int64_t num_quads = 0;
+  memcpy(info, &header[8], sizeof(info));
+  memcpy(&num_quads, &header[8 + sizeof(info)], sizeof(int64_t));
+
+  if (strncmp(header, "TMRQUADF", 8) != 0 ||
+      info[0] != TMR_FOREST_FILE_VERSION || info[1] != sizeof(TMRQuadrant)) {
+    MPI_File_close(&fp);
+    return 1;
+  }
+
+  // Read in the face connectivity
+  const int num_faces = info[6];
+  int *face_conn = new int[8 * num_faces];
+  MPI_File_read_at_all(fp, TMR_FOREST_FILE_HEADER_SIZE, face_conn,
+                       8 * num_faces, MPI_INT, MPI_STATUS_IGNORE);
+  const int *face_edge_conn = &face_conn[4 * num_faces];
+
+  int fail = 0;
+  if (fdata) {
+    // Check that the connectivity matches
+    if (fdata->num_faces != num_faces || fdata->num_nodes != info[4] ||
+        memcmp(fdata->face_conn, face_conn, 4 * num_faces * sizeof(int))) {
+      fail = 1;
+    }
+  } else {
+    setFullConnectivity(info[4], info[5], num_faces, face_conn,
+                        face_edge_conn);
+  }
+  delete[] face_conn;
+
+  if (fail) {
+    MPI_File_close(&fp);
+    return fail;
+  }
+
+  // Restore the mesh order and free the existing mesh data
+  if (info[2] != mesh_order || info[3] != interp_type) {
+    setMeshOrder(info[2], (TMRInterpolationType)info[3]);
+  }
+  freeMeshData();
+
+  // Read in an even share of the quadrants
+  int64_t start = (mpi_rank * num_quads) / mpi_size;
+  int64_t end = ((mpi_rank + 1) * num_quads) / mpi_size;
+  int size = end - start;
+  TMRQuadrant *array = new TMRQuadrant[size];
+
+  MPI_Offset data_start =
+      TMR_FOREST_FILE_HEADER_SIZE + 8 * num_faces * sizeof(int);
+  MPI_File_read_at_all(fp, data_start + start * sizeof(TMRQuadrant), array,
+                       size, TMRQuadrant_MPI_type, MPI_STATUS_IGNORE);
+  MPI_File_close(&fp);
+
+  // Set the local ordering for the elements
+  for (int i = 0; i < size; i++) {
+    array[i].tag = i;
+  }
+
+  // Set the last octant
+  TMRQuadrant p;
+  p.face = num_faces - 1;
+  p.tag = -1;
+  p.level = 0;
+  p.info = 0;
+  p.x = p.y = 1 << TMR_MAX_LEVEL;
+  if (size > 0) {
+    p = array[0];
+  }
+
+  quadrants = new TMRQuadrantArray(array, size);
+
+  owners = new TMRQuadrant[mpi_size];
+  MPI_Allgather(&p, 1, TMRQuadrant_MPI_type, owners, 1, TMRQuadrant_MPI_type,
+                comm);
+
+  // Set the offsets if some of the processors have zero quadrants. The
+  // even split may leave empty processors anywhere in the order, so
+  // each one takes the first quadrant of the next processor and owns an
+  // empty interval. Trailing empty processors keep the last quadrant.
+  for (int k = mpi_size - 2; k >= 0; k--) {
+    if (owners[k].tag == -1) {
+      owners[k] = owners[k + 1];
+    }
+  }
+
+  return 0;
+}
+
+/*
+  Get the memory (in bytes) allocated for the data stored by the forest
+
+  This includes the quadrants, the node numbers, connectivity,
+  dependent node data and node locations and the interpolation cache.
+  The face connectivity and the topology are shared between forests
+  and are not counted.
+*/
+void TMRQuadForest::getMemoryUsage(TMRMemoryUsage *usage) {
+  usage->zero();
+
+  // Compute the memory for the quadrants
+  int num_elements = 0;
+  if (quadrants) {
+    quadrants->getArray(NULL, &num_elements);
+    usage->octants += quadrants->getMemoryUsage();
+  }
+  if (adjacent) {
+    usage->octants += adjacent->getMemoryUsage();
+  }
+  if (owners) {
+    usage->octants += mpi_size * sizeof(TMRQuadrant);
+  }
+
+  // Compute the memory for the nodes and connectivity
+  if (node_numbers) {
+    usage->nodes += num_local_nodes * sizeof(int);
+  }
+  if (node_range) {
+    usage->nodes += (mpi_size + 1) * sizeof(int);
+  }
+  if (conn) {
+    usage->conn += mesh_order * mesh_order * num_elements * sizeof(int);
+  }
+
+  // Compute the memory for the dependent nodes
+  if (dep_ptr) {
+    usage->dep_nodes += (num_dep_nodes + 1) * sizeof(int);
+    usage->dep_nodes +=
+        dep_ptr[num_dep_nodes] * (sizeof(int) + sizeof(double));
+  }
+
+  // Compute the memory for the node locations
+  if (X) {
+    usage->points += num_local_nodes * sizeof(TMRPoint);
+  }
+  if (Xcomp) {
+    int stride = POINT_COMPONENT_ALIGNMENT / sizeof(double);
+    stride *= (num_local_nodes + stride - 1) / stride;
+    usage->points += 3 * stride * sizeof(double);
+  }
+
+  // Compute the memory for the interpolation cache and name index
+  if (interp_cache_rows) {
+    usage->other += (2 * interp_cache_max_rows + 1) * sizeof(int);
+    usage->other +=
+        interp_cache_max_weights * (sizeof(int) + sizeof(double));
+  }
+  if (name_quad_ptr) {
+    usage->other += (fdata->num_names + 1) * sizeof(int);
+    usage->other += 2 * name_quad_ptr[fdata->num_names] * sizeof(int);
+  }
+  if (name_node_ptr) {
+    usage->other += (fdata->num_names + 1) * sizeof(int);
+    usage->other += name_node_ptr[fdata->num_names] * sizeof(int);
+  }
+}
+
+/*
+  Get the high-water mark of the memory used by the forest
+
+  The high-water mark is the memory usage, including the transient
+  hash tables and node arrays, at the point where the total was
+  largest during the calls to balance() and createNodes().
+*/
+void TMRQuadForest::getMaxMemoryUsage(TMRMemoryUsage *usage) {
+  *usage = max_mem_usage;
+}
+
+/*
+  Reset the memory high-water mark
+*/
+void TMRQuadForest::resetMaxMemoryUsage() { max_mem_usage.zero(); }
+
+/*
+  Update the high-water mark with the current memory usage plus the
+  size of the transient hash tables and node arrays
+*/
+void TMRQuadForest::updateMaxMemoryUsage(long int hash_size,
+                                         long int node_size) {
+  TMRMemoryUsage usage;
+  getMemoryUsage(&usage);
+  usage.hash += hash_size;
+  usage.nodes += node_size;
+  if (usage.getTotal() > max_mem_usage.getTotal()) {
+    max_mem_usage = usage;
+  }
+}
+
 /*
   Write the entire forest to a VTK file
 */
@@ -951,10 +1491,11 @@ void TMRQuadForest::setMeshOrder(int _mesh_order,
   // but free the connectivity and node data
   freeMeshData(0, 0);
 
-  // Free the interpolation knots
+  // Free the interpolation knots and any tabulated shape functions
   if (interp_knots) {
     delete[] interp_knots;
   }
+  freeInterpTables();
 
   // Check that the order falls within allowable bounds
   mesh_order = _mesh_order;
@@ -983,6 +1524,14 @@ void TMRQuadForest::setMeshOrder(int _mesh_order,
       interp_knots[i] = -1.0 + 2.0 * i / (mesh_order - 1);
     }
   }
+
+  // Select the interpolation kernels once for this order and type
+  lagrange_weights(mesh_order, interp_knots, interp_weights);
+  TMRInterpKernel kernel3d;
+  TMRInterpDerivKernel3D deriv_kernel3d;
+  get_tensor_interp_kernels(mesh_order, interp_type, &interp_kernel,
+                            &interp_deriv_kernel, &kernel3d,
+                            &deriv_kernel3d);
 }
 
 /*
@@ -1029,16 +1578,95 @@ int TMRQuadForest::getNodeNumbers(const int **_node_numbers) {
 */
 int TMRQuadForest::getExtPreOffset() { return ext_pre_offset; }
 
+/*
+  Evaluate the node locations if their evaluation has been deferred
+
+  createNodes() only creates the node numbering and the connectivity.
+  The node locations, which may require many geometry evaluations, are
+  computed on the first request so that forests that only use the
+  connectivity never evaluate them. This is not a collective call.
+*/
+void TMRQuadForest::evaluateDeferredNodeLocations() {
+  if (deferred_node_locations) {
+    deferred_node_locations = 0;
+    evaluateNodeLocations();
+    updateMaxMemoryUsage();
+  }
+}
+
 /*
   Get the node locations
+
+  The locations are evaluated on the first call after createNodes()
 */
 int TMRQuadForest::getPoints(TMRPoint **_X) {
   if (_X) {
+    evaluateDeferredNodeLocations();
     *_X = X;
   }
   return num_local_nodes;
 }
 
+/*
+  Get the node locations as separate x, y and z component arrays
+
+  Each array is aligned and padded to POINT_COMPONENT_ALIGNMENT bytes
+  so that kernels can stream the coordinates with unit stride. The
+  components are copied from the node locations on the first call
+  after the nodes are created, and are freed with the nodes. Changes
+  made directly to the array from getPoints() are not reflected.
+*/
+int TMRQuadForest::getPointComponents(const double **_x, const double **_y,
+                                      const double **_z) {
+  evaluateDeferredNodeLocations();
+
+  int stride = POINT_COMPONENT_ALIGNMENT / sizeof(double);
+  stride *= (num_local_nodes + stride - 1) / stride;
+
+  if (X && !Xcomp && stride > 0) {
+    void *ptr = NULL;
+    if (posix_memalign(&ptr, POINT_COMPONENT_ALIGNMENT,
+                       3 * stride * sizeof(double)) == 0) {
+      Xcomp = (double *)ptr;
+    } else {
+      fprintf(stderr,
+              "TMRQuadForest Error: Unable to allocate the node components\n");
+    }
+    if (Xcomp) {
+      double *x = Xcomp, *y = &Xcomp[stride], *z = &Xcomp[2 * stride];
+      for (int i = 0; i < num_local_nodes; i++) {
+        x[i] = X[i].x;
+        y[i] = X[i].y;
+        z[i] = X[i].z;
+      }
+      for (int i = num_local_nodes; i < stride; i++) {
+        x[i] = y[i] = z[i] = 0.0;
+      }
+    }
+  }
+
+  if (_x) {
+    *_x = Xcomp;
+  }
+  if (_y) {
+    *_y = (Xcomp ? &Xcomp[stride] : NULL);
+  }
+  if (_z) {
+    *_z = (Xcomp ? &Xcomp[2 * stride] : NULL);
+  }
+  return num_local_nodes;
+}
+
+/*
+  Free the component arrays of the node locations
+*/
+void TMRQuadForest::freePointComponents() {
+  if (Xcomp) {
+    free(Xcomp);
+  }
+  Xcomp = NULL;
+}
+
 /*
   Retrieve the local node number
 */
@@ -1067,6 +1695,11 @@ int TMRQuadForest::getInterpKnots(const double **_knots) {
   Evaluate the interpolant at the given parametric point
 */
 void TMRQuadForest::evalInterp(const double pt[], double N[]) {
+  if (interp_kernel) {
+    interp_kernel(interp_knots, interp_weights, pt, N);
+    return;
+  }
+
   double Nu[MAX_ORDER], Nv[MAX_ORDER];
   if (interp_type == TMR_BERNSTEIN_POINTS) {
     // Evaluate the bernstein shape functions
@@ -1091,6 +1724,11 @@ void TMRQuadForest::evalInterp(const double pt[], double N[]) {
 */
 void TMRQuadForest::evalInterp(const double pt[], double N[], double N1[],
                                double N2[]) {
+  if (interp_deriv_kernel) {
+    interp_deriv_kernel(interp_knots, interp_weights, pt, N, N1, N2);
+    return;
+  }
+
   double Nu[MAX_ORDER], Nv[MAX_ORDER];
   double Nud[MAX_ORDER], Nvd[MAX_ORDER];
 
@@ -1156,21 +1794,134 @@ void TMRQuadForest::evalInterp(const double pt[], double N[], double N1[],
 }
 
 /*
-  Retrieve information about the connectivity between faces, edges and
-  nodes
+  Evaluate the interpolant at a batch of parametric points
+
+  The points are stored consecutively in pts, and the shape functions
+  for the i-th point are stored in N starting at N[i*mesh_order^2].
 */
-void TMRQuadForest::getConnectivity(int *_nfaces, int *_nedges, int *_nnodes,
-                                    const int **_face_conn,
-                                    const int **_face_edge_conn) {
-  if (fdata) {
-    if (_nfaces) {
-      *_nfaces = fdata->num_faces;
-    }
-    if (_nedges) {
-      *_nedges = fdata->num_edges;
+void TMRQuadForest::evalInterp(int npts, const double pts[], double N[]) {
+  const int size = mesh_order * mesh_order;
+  for (int i = 0; i < npts; i++) {
+    evalInterp(&pts[2 * i], &N[size * i]);
+  }
+}
+
+/*
+  Evaluate the interpolant and its derivatives at a batch of points
+*/
+void TMRQuadForest::evalInterp(int npts, const double pts[], double N[],
+                               double N1[], double N2[]) {
+  const int size = mesh_order * mesh_order;
+  for (int i = 0; i < npts; i++) {
+    evalInterp(&pts[2 * i], &N[size * i], &N1[size * i], &N2[size * i]);
+  }
+}
+
+/*
+  Retrieve the shape functions tabulated at a set of parametric points
+
+  The first call with a given set of points evaluates the shape
+  functions and their derivatives and caches them. Later calls with
+  the same points return the cached tables. The cache is tied to the
+  current mesh order and interpolation type and is cleared by
+  setMeshOrder(). Only the MAX_INTERP_TABLES most recently used tables
+  are retained, so this is intended for fixed sets such as quadrature
+  or knot points. The returned pointers remain valid until the table
+  is evicted or the mesh order changes.
+
+  input:
+  npts:    the number of points
+  pts:     the parametric points (2*npts)
+
+  output:
+  N:       the shape functions at each point
+  N1:      the derivative along the first parametric direction
+  N2:      the derivative along the second parametric direction
+
+  returns: the number of shape functions at each point
+*/
+int TMRQuadForest::getInterpTable(int npts, const double pts[],
+                                  const double **_N, const double **_N1,
+                                  const double **_N2) {
+  const int size = mesh_order * mesh_order;
+
+  // Search for the table, moving it to the front of the list if found
+  TMRInterpTable *prev = NULL, *table = interp_tables;
+  while (table && !table->matches(2, npts, pts)) {
+    prev = table;
+    table = table->next;
+  }
+
+  if (table && prev) {
+    prev->next = table->next;
+    table->next = interp_tables;
+    interp_tables = table;
+  } else if (!table) {
+    table = new TMRInterpTable(2, npts, pts, size);
+    evalInterp(npts, pts, table->N, &table->Nd[0], &table->Nd[size * npts]);
+    table->next = interp_tables;
+    interp_tables = table;
+
+    // Drop the least recently used tables beyond the limit
+    TMRInterpTable *t = interp_tables;
+    for (int i = 1; t && i < MAX_INTERP_TABLES; i++) {
+      t = t->next;
     }
-    if (_nnodes) {
-      *_nnodes = fdata->num_nodes;
+    if (t) {
+      TMRInterpTable *tail = t->next;
+      t->next = NULL;
+      while (tail) {
+        TMRInterpTable *tmp = tail->next;
+        delete tail;
+        tail = tmp;
+      }
+    }
+  }
+
+  if (_N) {
+    *_N = table->N;
+  }
+  if (_N1) {
+    *_N1 = &table->Nd[0];
+  }
+  if (_N2) {
+    *_N2 = &table->Nd[size * npts];
+  }
+
+  return size;
+}
+
+/*
+  Free the cached shape function tables and interpolation inverse
+*/
+void TMRQuadForest::freeInterpTables() {
+  while (interp_tables) {
+    TMRInterpTable *tmp = interp_tables->next;
+    delete interp_tables;
+    interp_tables = tmp;
+  }
+  if (interp_inverse) {
+    delete[] interp_inverse;
+  }
+  interp_inverse = NULL;
+}
+
+/*
+  Retrieve information about the connectivity between faces, edges and
+  nodes
+*/
+void TMRQuadForest::getConnectivity(int *_nfaces, int *_nedges, int *_nnodes,
+                                    const int **_face_conn,
+                                    const int **_face_edge_conn) {
+  if (fdata) {
+    if (_nfaces) {
+      *_nfaces = fdata->num_faces;
+    }
+    if (_nedges) {
+      *_nedges = fdata->num_edges;
+    }
+    if (_nnodes) {
+      *_nnodes = fdata->num_nodes;
     }
     if (_face_conn) {
       *_face_conn = fdata->face_conn;
@@ -1400,14 +2151,213 @@ void TMRQuadForest::createRandomTrees(int nrand, int min_level, int max_level) {
   }
 }
 
+/*
+  Compute a weighted partition of the quadrants
+
+  The quadrants are cut along the space-filling curve so that each of
+  the first max_rank processors receives a nearly equal fraction of
+  the total weight. Each quadrant is assigned to the processor whose
+  interval contains the midpoint of its cumulative weight. When
+  possible, each of the first max_rank processors receives at least
+  one quadrant.
+
+  input:
+  comm:        the MPI communicator
+  size:        the number of quadrants on this processor
+  weights:     the non-negative weight of each local quadrant
+  total_size:  the total number of quadrants across all processors
+  max_rank:    the number of processors that will own quadrants
+
+  output:
+  new_ptr:     the offset into the global quadrant array for each rank
+
+  returns:
+  0 if the total weight is zero, 1 otherwise
+*/
+static int compute_weighted_partition(MPI_Comm comm, int size,
+                                      const double *weights, int total_size,
+                                      int max_rank, int *new_ptr) {
+  int mpi_rank, mpi_size;
+  MPI_Comm_rank(comm, &mpi_rank);
+  MPI_Comm_size(comm, &mpi_size);
+
+  // Compute the local weight
+  double local_weight = 0.0;
+  for (int i = 0; i < size; i++) {
+    if (weights[i] > 0.0) {
+      local_weight += weights[i];
+    }
+  }
+
+  // Find the offset for this processor and the total weight
+  double offset = 0.0, total_weight = 0.0;
+  MPI_Exscan(&local_weight, &offset, 1, MPI_DOUBLE, MPI_SUM, comm);
+  MPI_Allreduce(&local_weight, &total_weight, 1, MPI_DOUBLE, MPI_SUM, comm);
+  if (mpi_rank == 0) {
+    offset = 0.0;
+  }
+
+  if (total_weight <= 0.0) {
+    return 0;
+  }
+
+  // Count the local quadrants that lie before each of the cuts
+  int *counts = new int[mpi_size + 1];
+  memset(counts, 0, (mpi_size + 1) * sizeof(int));
+
+  double cumulative = offset;
+  for (int i = 0, k = 1; i < size; i++) {
+    double w = (weights[i] > 0.0 ? weights[i] : 0.0);
+    double mid = cumulative + 0.5 * w;
+    cumulative += w;
+
+    // Find the first cut that lies beyond the midpoint
+    while (k < max_rank && mid >= (total_weight * k) / max_rank) {
+      k++;
+    }
+    if (k < max_rank) {
+      counts[k]++;
+    }
+  }
+  for (int k = 1; k < max_rank; k++) {
+    counts[k] += counts[k - 1];
+  }
+
+  MPI_Allreduce(counts, new_ptr, mpi_size + 1, MPI_INT, MPI_SUM, comm);
+  delete[] counts;
+
+  new_ptr[0] = 0;
+  for (int k = max_rank; k <= mpi_size; k++) {
+    new_ptr[k] = total_size;
+  }
+
+  // Make sure that each rank receives at least one quadrant
+  if (total_size >= max_rank) {
+    for (int k = 1; k < max_rank; k++) {
+      if (new_ptr[k] <= new_ptr[k - 1]) {
+        new_ptr[k] = new_ptr[k - 1] + 1;
+      }
+    }
+    for (int k = max_rank - 1; k > 0; k--) {
+      if (new_ptr[k] >= new_ptr[k + 1]) {
+        new_ptr[k] = new_ptr[k + 1] - 1;
+      }
+    }
+  }
+
+  return 1;
+}
+
+/*
+  Move the cuts of a partition onto coarse face boundaries
+
+  A cut placed at an arbitrary quadrant in the Morton order can leave a
+  processor with disconnected pieces of the coarse quadrants on either
+  side of the cut, which increases the number of ghost quadrants and
+  nodes. Each cut is instead moved, within the window, to the quadrant
+  that starts the coarsest subtree. This is the quadrant with the most
+  trailing zero bits in its coordinates, so that the first quadrant of a
+  face is preferred and cuts fall between faces where possible.
+  Ties are broken by the distance to the original cut. Each cut stays
+  within half of the distance to the adjacent cuts so that no
+  processor loses all of its quadrants.
+
+  input:
+  comm:        the communicator
+  array:       the local quadrants
+  size:        the number of local quadrants
+  offset:      the global index of the first local quadrant
+  max_rank:    the number of processors that receive quadrants
+  window:      the maximum distance that a cut may move
+
+  input/output:
+  new_ptr:     the offset into the global quadrant array for each rank
+*/
+static void align_partition_cuts(MPI_Comm comm, const TMRQuadrant *array,
+                                 int size, int offset, int max_rank,
+                                 int window, int *new_ptr) {
+  if (window > (1 << 24)) {
+    window = 1 << 24;
+  }
+
+  // Each candidate is encoded as the number of missing trailing zero
+  // bits, then the distance to the cut and then the side of the cut
+  const int stride = 2 * window + 2;
+  const int max_code = 33 * stride;
+
+  int *codes = new int[max_rank + 1];
+  for (int k = 0; k <= max_rank; k++) {
+    codes[k] = max_code;
+  }
+
+  for (int k = 1; k < max_rank; k++) {
+    int cut = new_ptr[k];
+    int low = (new_ptr[k - 1] + cut) / 2 + 1;
+    int high = (cut + new_ptr[k + 1]) / 2;
+    if (low < cut - window) {
+      low = cut - window;
+    }
+    if (high > cut + window) {
+      high = cut + window;
+    }
+    if (low < offset) {
+      low = offset;
+    }
+    if (high > offset + size - 1) {
+      high = offset + size - 1;
+    }
+
+    for (int pos = low; pos <= high; pos++) {
+      int i = pos - offset;
+      uint32_t bits = array[i].x | array[i].y;
+      int zeros = 32;
+      if (bits) {
+        zeros = 0;
+        while (!(bits & 1)) {
+          bits >>= 1;
+          zeros++;
+        }
+      }
+
+      int dist = (pos > cut ? pos - cut : cut - pos);
+      int code = (32 - zeros) * stride + 2 * dist + (pos > cut);
+      if (code < codes[k]) {
+        codes[k] = code;
+      }
+    }
+  }
+
+  MPI_Allreduce(MPI_IN_PLACE, codes, max_rank + 1, MPI_INT, MPI_MIN, comm);
+
+  // Decode the new locations of the cuts
+  for (int k = 1; k < max_rank; k++) {
+    if (codes[k] < max_code) {
+      int dist = (codes[k] % stride) / 2;
+      if (codes[k] % 2) {
+        new_ptr[k] += dist;
+      } else {
+        new_ptr[k] -= dist;
+      }
+    }
+  }
+
+  delete[] codes;
+}
+
 /*
   Repartition the quadrants across all processors.
 
   This does not repartition the nodes. You have to recreate the nodes
   after this call so be careful.
+
+  By default, the quadrants are divided evenly between processors. If
+  weights are provided for the local quadrants, the space-filling
+  curve is instead cut so that each processor receives an equal
+  fraction of the total weight. Processors without any quadrants may
+  pass NULL for the weights.
 */
-void TMRQuadForest::repartition() {
-  const int num_faces = fdata->num_faces;
+void TMRQuadForest::repartition(const double weights[]) {
+  TMR_PROFILE_BEGIN(TMR_PROFILE_REPARTITION);
 
   // Free everything but the quadrants
   freeMeshData(0);
@@ -1421,6 +2371,7 @@ void TMRQuadForest::repartition() {
 
   // Gather the sizes from all the arrays
   MPI_Allgather(&size, 1, MPI_INT, &ptr[1], 1, MPI_INT, comm);
+  TMR_PROFILE_MESSAGES(0, mpi_size, MPI_INT);
 
   // Set the pointers
   ptr[0] = 0;
@@ -1428,20 +2379,59 @@ void TMRQuadForest::repartition() {
     ptr[k + 1] += ptr[k];
   }
 
-  // Compute the average size of the new counts
-  int average_count = ptr[mpi_size] / mpi_size;
-  int remain = ptr[mpi_size] - average_count * mpi_size;
+  // Use the weights only if they are provided on all processors
+  // that own quadrants
+  int use_weights = (weights || size == 0);
+  MPI_Allreduce(MPI_IN_PLACE, &use_weights, 1, MPI_INT, MPI_MIN, comm);
 
   // Figure out what goes where on the new distribution of quadrants
   int *new_ptr = new int[mpi_size + 1];
-  new_ptr[0] = 0;
-  for (int k = 0; k < mpi_size; k++) {
-    new_ptr[k + 1] = new_ptr[k] + average_count;
-    if (k < remain) {
-      new_ptr[k + 1] += 1;
+  if (!use_weights ||
+      !compute_weighted_partition(comm, size, weights, ptr[mpi_size],
+                                  mpi_size, new_ptr)) {
+    // Compute the average size of the new counts
+    int average_count = ptr[mpi_size] / mpi_size;
+    int remain = ptr[mpi_size] - average_count * mpi_size;
+
+    new_ptr[0] = 0;
+    for (int k = 0; k < mpi_size; k++) {
+      new_ptr[k + 1] = new_ptr[k] + average_count;
+      if (k < remain) {
+        new_ptr[k + 1] += 1;
+      }
     }
   }
 
+  // Move the cuts onto coarse quadtree boundaries
+  int window = (int)(partition_tol * ptr[mpi_size] / mpi_size);
+  if (window > 0) {
+    align_partition_cuts(comm, array, size, ptr[mpi_rank], mpi_size, window,
+                         new_ptr);
+  }
+
+  // Move the quadrants to their new processors
+  redistributeQuadrants(ptr, new_ptr);
+  delete[] ptr;
+  delete[] new_ptr;
+
+  quadrants->getArray(NULL, &size);
+  TMR_PROFILE_OCTANTS(TMR_PROFILE_REPARTITION, size);
+  TMR_PROFILE_END(TMR_PROFILE_REPARTITION);
+}
+
+/*
+  Move the quadrants to the processors given by the new partition
+
+  The quadrants are ordered along the space-filling curve. On input, ptr
+  contains the current offset of the quadrants on each processor and new_ptr
+  contains the offsets after the quadrants are moved.
+*/
+void TMRQuadForest::redistributeQuadrants(const int *ptr, const int *new_ptr) {
+  const int num_faces = fdata->num_faces;
+  int size;
+  TMRQuadrant *array;
+  quadrants->getArray(&array, &size);
+
   // Allocate the new array of quadrants
   int new_size = new_ptr[mpi_rank + 1] - new_ptr[mpi_rank];
   TMRQuadrant *new_array = new TMRQuadrant[new_size];
@@ -1494,6 +2484,7 @@ void TMRQuadForest::repartition() {
         // Send the element array to the new owner
         MPI_Isend(&array[start], count, TMRQuadrant_MPI_type, i, 0, comm,
                   &send_requests[send_count]);
+        TMR_PROFILE_MESSAGES(1, count, TMRQuadrant_MPI_type);
         send_count++;
       }
     }
@@ -1528,10 +2519,6 @@ void TMRQuadForest::repartition() {
     }
   }
 
-  // Free the memory
-  delete[] ptr;
-  delete[] new_ptr;
-
   // Wait for any remaining sends to complete
   MPI_Waitall(send_count, send_requests, MPI_STATUSES_IGNORE);
   delete[] send_requests;
@@ -1554,6 +2541,7 @@ void TMRQuadForest::repartition() {
   owners = new TMRQuadrant[mpi_size];
   MPI_Allgather(&q, 1, TMRQuadrant_MPI_type, owners, 1, TMRQuadrant_MPI_type,
                 comm);
+  TMR_PROFILE_MESSAGES(0, mpi_size, TMRQuadrant_MPI_type);
 
   // Set the local reordering for the elements
   quadrants->getArray(&new_array, &new_size);
@@ -1562,6 +2550,98 @@ void TMRQuadForest::repartition() {
   }
 }
 
+/*
+  Repartition the quadrants so that they match the partition of another
+  forest
+
+  Each quadrant is moved to the processor that owns the corresponding
+  part of the space-filling curve in the given forest. The forest
+  must be defined on the same connectivity and communicator. This is
+  used to co-partition an analysis forest with the filter forest used
+  to define the design variables. When every analysis quadrant lies
+  within a filter quadrant, the enclosing filter quadrant is always local.
+  The typical use is to call repartition() on the filter and then
+  call alignPartition() on the analysis forest.
+
+  input:
+  forest:   the forest whose partition is matched
+*/
+void TMRQuadForest::alignPartition(TMRQuadForest *forest) {
+  if (!quadrants || !forest->owners) {
+    fprintf(stderr,
+            "TMRQuadForest Error: Cannot call alignPartition(), "
+            "no quadrants have been created\n");
+    return;
+  }
+  TMR_PROFILE_BEGIN(TMR_PROFILE_REPARTITION);
+
+  // Free everything but the quadrants
+  freeMeshData(0);
+
+  // Compute the current offsets for the quadrants on each processor
+  int *ptr = new int[mpi_size + 1];
+  int size;
+  TMRQuadrant *array;
+  quadrants->getArray(&array, &size);
+  MPI_Allgather(&size, 1, MPI_INT, &ptr[1], 1, MPI_INT, comm);
+  TMR_PROFILE_MESSAGES(0, mpi_size, MPI_INT);
+  ptr[0] = 0;
+  for (int k = 0; k < mpi_size; k++) {
+    ptr[k + 1] += ptr[k];
+  }
+
+  // Find the local quadrants that lie within the range owned by each
+  // processor in the other forest. Since the quadrants are sorted, the
+  // new offsets are the sums of these counts over all processors.
+  int *new_ptr = new int[mpi_size + 1];
+  forest->matchQuadrantIntervals(array, size, new_ptr);
+  for (int k = mpi_size; k > 0; k--) {
+    new_ptr[k] -= new_ptr[k - 1];
+  }
+  MPI_Allreduce(MPI_IN_PLACE, &new_ptr[1], mpi_size, MPI_INT, MPI_SUM, comm);
+  new_ptr[0] = 0;
+  for (int k = 0; k < mpi_size; k++) {
+    new_ptr[k + 1] += new_ptr[k];
+  }
+
+  // Move the quadrants to their new processors
+  redistributeQuadrants(ptr, new_ptr);
+  delete[] ptr;
+  delete[] new_ptr;
+
+  quadrants->getArray(NULL, &size);
+  TMR_PROFILE_OCTANTS(TMR_PROFILE_REPARTITION, size);
+  TMR_PROFILE_END(TMR_PROFILE_REPARTITION);
+}
+
+/*
+  Set the tolerance used to align the partition with the quadtrees
+
+  When positive, repartition() moves each cut by up to this fraction
+  of the average number of quadrants per processor so that the cut
+  falls on the boundary of the coarsest possible subtree. This
+  reduces the number of ghost quadrants and nodes at the cost of a
+  small load imbalance.
+*/
+void TMRQuadForest::setPartitionTolerance(double tol) {
+  partition_tol = (tol > 0.0 ? tol : 0.0);
+}
+
+/*
+  Set the number of threads used within each MPI process
+
+  At present, the threads are used to create the local nodes and the
+  local connectivity within createNodes().
+*/
+void TMRQuadForest::setNumThreads(int _num_threads) {
+  num_threads = (_num_threads > 1 ? _num_threads : 1);
+}
+
+/*
+  Get the number of threads used within each MPI process
+*/
+int TMRQuadForest::getNumThreads() { return num_threads; }
+
 /*
   Duplicate the forest
 
@@ -1797,6 +2877,50 @@ void TMRQuadForest::refine(const int refinement[], int min_level,
   }
 }
 
+/*
+  Refine the forest so that each element reaches a target level and
+  balance the result
+
+  Each element is refined directly to its target level in a single
+  call to refine(), rather than one level at a time, and the 2:1
+  balance is then enforced with a single call to balance(). Elements
+  with a target level below their current level are coarsened as in
+  refine(). This call is collective.
+
+  input:
+  levels:          the target level for each local quadrant
+  balance_corner:  balance across corners
+*/
+void TMRQuadForest::refineToLevels(const int levels[], int balance_corner) {
+  if (!quadrants) {
+    fprintf(stderr,
+            "TMRQuadForest Error: Cannot call refineToLevels(), "
+            "no quadrants have been created\n");
+    return;
+  }
+
+  int size;
+  TMRQuadrant *array;
+  quadrants->getArray(&array, &size);
+
+  // Convert the target levels to relative refinement levels
+  int *refinement = new int[size];
+  for (int i = 0; i < size; i++) {
+    int level = levels[i];
+    if (level < 0) {
+      level = 0;
+    } else if (level > TMR_MAX_LEVEL) {
+      level = TMR_MAX_LEVEL;
+    }
+    refinement[i] = level - array[i].level;
+  }
+
+  refine(refinement, 0, TMR_MAX_LEVEL);
+  delete[] refinement;
+
+  balance(balance_corner);
+}
+
 /*
   Get the owner of the quadrant
 */
@@ -1879,7 +3003,7 @@ TMRQuadrantArray *TMRQuadForest::distributeQuadrants(
   // Now distribute the quadrants to their destination quadrees and
   // balance the corresponding quadrees including the new elements.
   int *quad_recv_counts = new int[mpi_size];
-  MPI_Alltoall(quad_counts, 1, MPI_INT, quad_recv_counts, 1, MPI_INT, comm);
+  TMRExchangeCounts(comm, quad_counts, quad_recv_counts);
 
   // Now use quad_ptr to point into the recv array
   quad_recv_ptr[0] = 0;
@@ -1938,9 +3062,21 @@ TMRQuadrantArray *TMRQuadForest::sendQuadrants(TMRQuadrantArray *list,
   int recv_size = quad_recv_ptr[mpi_size];
   TMRQuadrant *recv_array = new TMRQuadrant[recv_size];
 
-  // Allocate space for the requests
+  // Allocate space for the requests. The receives are posted first
+  // so that incoming quadrants land directly in place.
+  MPI_Request *recv_request = new MPI_Request[nrecvs];
   MPI_Request *send_request = new MPI_Request[nsends];
 
+  // Post the receives from each source processor
+  for (int i = 0, j = 0; i < mpi_size; i++) {
+    if (i != mpi_rank && quad_recv_ptr[i + 1] > quad_recv_ptr[i]) {
+      int recv_count = quad_recv_ptr[i + 1] - quad_recv_ptr[i];
+      MPI_Irecv(&recv_array[quad_recv_ptr[i]], recv_count, TMRQuadrant_MPI_type,
+                i, 0, comm, &recv_request[j]);
+      j++;
+    }
+  }
+
   // Loop over all the ranks and send
   for (int i = 0, j = 0; i < mpi_size; i++) {
     if (i != mpi_rank && quad_ptr[i + 1] - quad_ptr[i] > 0) {
@@ -1948,6 +3084,7 @@ TMRQuadrantArray *TMRQuadForest::sendQuadrants(TMRQuadrantArray *list,
       int count = quad_ptr[i + 1] - quad_ptr[i];
       MPI_Isend(&array[quad_ptr[i]], count, TMRQuadrant_MPI_type, i, 0, comm,
                 &send_request[j]);
+      TMR_PROFILE_MESSAGES(1, count, TMRQuadrant_MPI_type);
       j++;
     } else if (i == mpi_rank) {
       int count = quad_recv_ptr[i + 1] - quad_recv_ptr[i];
@@ -1958,18 +3095,10 @@ TMRQuadrantArray *TMRQuadForest::sendQuadrants(TMRQuadrantArray *list,
     }
   }
 
-  // Loop over the recieve calls
-  for (int i = 0; i < mpi_size; i++) {
-    if (i != mpi_rank && quad_recv_ptr[i + 1] > quad_recv_ptr[i]) {
-      int recv_count = quad_recv_ptr[i + 1] - quad_recv_ptr[i];
-
-      MPI_Recv(&recv_array[quad_recv_ptr[i]], recv_count, TMRQuadrant_MPI_type,
-               i, 0, comm, MPI_STATUS_IGNORE);
-    }
-  }
-
-  // Wait for any remaining sends to complete
+  // Wait for the receives and any remaining sends to complete
+  MPI_Waitall(nrecvs, recv_request, MPI_STATUSES_IGNORE);
   MPI_Waitall(nsends, send_request, MPI_STATUSES_IGNORE);
+  delete[] recv_request;
   delete[] send_request;
 
   return new TMRQuadrantArray(recv_array, recv_size, use_node_index);
@@ -2241,6 +3370,7 @@ void TMRQuadForest::balance(int balance_corner) {
             "no quadrants have been created\n");
     return;
   }
+  TMR_PROFILE_BEGIN(TMR_PROFILE_BALANCE);
 
   // Create a hash table for the balanced tree
   TMRQuadrantHash *hash = new TMRQuadrantHash();
@@ -2395,8 +3525,10 @@ void TMRQuadForest::balance(int balance_corner) {
   delete local;
 
   // Set the elements into the quadtree
+  TMR_PROFILE_PEAK_SIZE(hash->length());
   quadrants = hash->toArray();
   quadrants->sort();
+  updateMaxMemoryUsage(hash->getMemoryUsage());
 
   // Get the quadrants and order their labels
   quadrants->getArray(&array, &size);
@@ -2406,6 +3538,9 @@ void TMRQuadForest::balance(int balance_corner) {
 
   // Free the hash
   delete hash;
+
+  TMR_PROFILE_OCTANTS(TMR_PROFILE_BALANCE, size);
+  TMR_PROFILE_END(TMR_PROFILE_BALANCE);
 }
 
 /*
@@ -2970,6 +4105,10 @@ void TMRQuadForest::transformNode(TMRQuadrant *quad, int *edge_reversed) {
   }
 }
 
+// The counter used to assign unique node stamps in createNodes(). It is
+// updated atomically since the forests may be created on several threads.
+static int TMR_quad_node_stamp_count = 0;
+
 /*
   Create the nodes from the element mesh
 
@@ -2992,6 +4131,9 @@ void TMRQuadForest::transformNode(TMRQuadrant *quad, int *edge_reversed) {
   and corners. Finally, the new node numbers are returned to the
   processors that border the quadtree owners. And lastly, the non-local
   partial quadtrees are freed.
+
+  The node locations are not evaluated here, but on the first call to
+  getPoints() or getPointComponents().
 */
 void TMRQuadForest::createNodes() {
   if (!quadrants) {
@@ -3005,6 +4147,7 @@ void TMRQuadForest::createNodes() {
     // there is no need to create it a second time.
     return;
   }
+  TMR_PROFILE_BEGIN(TMR_PROFILE_CREATE_NODES);
 
   // Send/recv the adjacent quadrants
   computeAdjacentQuadrants();
@@ -3115,6 +4258,9 @@ void TMRQuadForest::createNodes() {
   // owned by other processors and referenced by the
   // elements on this processor.
   TMRQuadrantArray *ext_array = ext_nodes->toArray();
+  updateMaxMemoryUsage(ext_nodes->getMemoryUsage(),
+                       nodes->getMemoryUsage() + ext_array->getMemoryUsage() +
+                           node_size * sizeof(int));
   delete ext_nodes;
 
   // Sort based on the tags
@@ -3191,8 +4337,103 @@ void TMRQuadForest::createNodes() {
                              num_local_nodes, sizeof(int), compare_integers);
   ext_pre_offset = item - node_numbers;
 
-  // Evaluate the node locations
-  evaluateNodeLocations();
+  // Defer the evaluation of the node locations until they are first
+  // requested
+  deferred_node_locations = 1;
+  updateMaxMemoryUsage();
+
+  // Mark the new mesh so cached data built from the old one is rejected
+  node_stamp = __sync_add_and_fetch(&TMR_quad_node_stamp_count, 1);
+
+  TMR_PROFILE_OCTANTS(TMR_PROFILE_CREATE_NODES, num_elements);
+  TMR_PROFILE_END(TMR_PROFILE_CREATE_NODES);
+}
+
+/*
+  Data used to create the local nodes for a range of the local
+  quadrants
+*/
+class TMRQuadCreateNodesThreadData {
+ public:
+  TMRQuadForest *forest;
+  int start, end;
+  TMRQuadrantArray *nodes;
+};
+
+/*
+  Create the sorted array of local nodes for the quadrants
+  array[start:end]. The element nodes are added to the hash before
+  the nodes for the dependent nodes so that their owners take
+  precedence.
+*/
+void *TMRQuadForest::createNodesThread(void *args) {
+  TMRQuadCreateNodesThreadData *data =
+      static_cast<TMRQuadCreateNodesThreadData *>(args);
+
+  const int use_node_index = 1;
+  TMRQuadrantHash *hash = new TMRQuadrantHash(use_node_index);
+  data->forest->addElementNodes(data->start, data->end, hash);
+  data->forest->addDependentNodes(data->start, data->end, hash);
+  data->nodes = hash->toArray();
+  delete hash;
+  data->nodes->sort();
+
+  return NULL;
+}
+
+/*
+  Data used to merge two sorted arrays of nodes
+*/
+class TMRQuadMergeNodesThreadData {
+ public:
+  TMRQuadrantArray *a, *b;
+  TMRQuadrantArray *nodes;
+};
+
+/*
+  Merge two sorted arrays of unique nodes into a new sorted array
+
+  When a node is in both arrays, the copy with the larger tag is
+  retained so that the nodes created by an element take precedence
+  over the nodes only added for a dependent node.
+*/
+static void *merge_nodes_thread(void *args) {
+  TMRQuadMergeNodesThreadData *data =
+      static_cast<TMRQuadMergeNodesThreadData *>(args);
+
+  int na, nb;
+  TMRQuadrant *a, *b;
+  data->a->getArray(&a, &na);
+  data->b->getArray(&b, &nb);
+
+  TMRQuadrant *array = new TMRQuadrant[na + nb];
+  int i = 0, j = 0, n = 0;
+  while (i < na && j < nb) {
+    int cmp = a[i].compareNode(&b[j]);
+    if (cmp < 0) {
+      array[n] = a[i];
+      i++;
+    } else if (cmp > 0) {
+      array[n] = b[j];
+      j++;
+    } else {
+      array[n] = (a[i].tag >= b[j].tag ? a[i] : b[j]);
+      i++;
+      j++;
+    }
+    n++;
+  }
+  for (; i < na; i++, n++) {
+    array[n] = a[i];
+  }
+  for (; j < nb; j++, n++) {
+    array[n] = b[j];
+  }
+
+  const int use_node_index = 1, is_sorted = 1;
+  data->nodes = new TMRQuadrantArray(array, n, use_node_index, is_sorted);
+
+  return NULL;
 }
 
 /*
@@ -3216,152 +4457,96 @@ void TMRQuadForest::createNodes() {
   3. level represents the number of nodes represented by the quad
 */
 TMRQuadrantArray *TMRQuadForest::createLocalNodes() {
-  // Allocate the array of elements
   int num_elements;
-  TMRQuadrant *quads;
-  quadrants->getArray(&quads, &num_elements);
+  quadrants->getArray(NULL, &num_elements);
 
   // Create all the nodes/edges/faces
   const int use_node_index = 1;
-  TMRQuadrantHash *local_nodes = new TMRQuadrantHash(use_node_index);
-
-  // Set the node, edge and face label
-  int node_label, edge_label, face_label;
-  node_label = edge_label = face_label = TMR_QUAD_NODE_LABEL;
+  TMRQuadrantArray *nodes = NULL;
+
+  // Create the nodes for contiguous ranges of the quadrants in
+  // separate threads
+  int nthreads = num_threads;
+  if (nthreads > num_elements) {
+    nthreads = (num_elements > 0 ? num_elements : 1);
+  }
+
+  if (nthreads > 1) {
+    TMRQuadCreateNodesThreadData *data =
+        new TMRQuadCreateNodesThreadData[nthreads];
+    pthread_t *threads = new pthread_t[nthreads];
+    for (int k = 0; k < nthreads; k++) {
+      data[k].forest = this;
+      data[k].start = (int)(((long int)k * num_elements) / nthreads);
+      data[k].end = (int)(((long int)(k + 1) * num_elements) / nthreads);
+      data[k].nodes = NULL;
+      pthread_create(&threads[k], NULL, TMRQuadForest::createNodesThread,
+                     (void *)&data[k]);
+    }
+    for (int k = 0; k < nthreads; k++) {
+      pthread_join(threads[k], NULL);
+    }
 
-  int label_type[3];
-  // If the mesh order is high enough, we will have multiple nodes
-  // per edge/face
-  initLabel(mesh_order, interp_type, label_type);
-
-  node_label = label_type[0];
-  edge_label = label_type[1];
-  face_label = label_type[2];
-
-  // Set the node locations
-  if (mesh_order == 2) {
-    // First of all, add all the nodes from the local elements
-    // on this processor
-    for (int i = 0; i < num_elements; i++) {
-      const int32_t h = 1 << (TMR_MAX_LEVEL - quads[i].level);
-      for (int jj = 0; jj < 2; jj++) {
-        for (int ii = 0; ii < 2; ii++) {
-          TMRQuadrant node;
-          node.face = quads[i].face;
-          node.level = 1;
-          node.x = quads[i].x + h * ii;
-          node.y = quads[i].y + h * jj;
-          node.tag = mpi_rank;
-          node.info = node_label;
-          transformNode(&node);
-          local_nodes->addQuadrant(&node);
+    // Merge pairs of the sorted node arrays in parallel until a
+    // single array remains
+    TMRQuadrantArray **lists = new TMRQuadrantArray *[nthreads];
+    for (int k = 0; k < nthreads; k++) {
+      lists[k] = data[k].nodes;
+    }
+    delete[] data;
+
+    int nlists = nthreads;
+    TMRQuadMergeNodesThreadData *merge =
+        new TMRQuadMergeNodesThreadData[nlists];
+    while (nlists > 1) {
+      int npairs = nlists / 2;
+      for (int k = 0; k < npairs; k++) {
+        merge[k].a = lists[2 * k];
+        merge[k].b = lists[2 * k + 1];
+        merge[k].nodes = NULL;
+      }
+      if (npairs > 1) {
+        for (int k = 0; k < npairs; k++) {
+          pthread_create(&threads[k], NULL, merge_nodes_thread,
+                         (void *)&merge[k]);
         }
+        for (int k = 0; k < npairs; k++) {
+          pthread_join(threads[k], NULL);
+        }
+      } else {
+        merge_nodes_thread((void *)&merge[0]);
       }
-    }
 
-    // Add the nodes that the dependent nodes depend on
-    for (int i = 0; i < num_elements; i++) {
-      // Add the external nodes from dependent edges
-      if (quads[i].info) {
-        for (int edge_index = 0; edge_index < 4; edge_index++) {
-          if (quads[i].info & 1 << edge_index) {
-            TMRQuadrant parent;
-            quads[i].parent(&parent);
-
-            const int32_t hp = 1 << (TMR_MAX_LEVEL - parent.level);
-            for (int ii = 0; ii < 2; ii++) {
-              TMRQuadrant node;
-              node.face = parent.face;
-              node.level = 1;
-              if (edge_index < 2) {
-                node.x = parent.x + hp * (edge_index % 2);
-                node.y = parent.y + hp * ii;
-              } else {
-                node.x = parent.x + hp * ii;
-                node.y = parent.y + hp * (edge_index % 2);
-              }
-              // Assign a negative rank index for now...
-              node.tag = -1;
-              node.info = node_label;
-              transformNode(&node);
-              local_nodes->addQuadrant(&node);
-            }
-          }
-        }
+      for (int k = 0; k < npairs; k++) {
+        delete lists[2 * k];
+        delete lists[2 * k + 1];
+        lists[k] = merge[k].nodes;
       }
-    }
-  } else {
-    for (int i = 0; i < num_elements; i++) {
-      const int32_t h = 1 << (TMR_MAX_LEVEL - quads[i].level - 1);
-      for (int jj = 0; jj < 3; jj++) {
-        for (int ii = 0; ii < 3; ii++) {
-          TMRQuadrant node;
-          node.face = quads[i].face;
-          node.x = quads[i].x + h * ii;
-          node.y = quads[i].y + h * jj;
-          if ((ii == 0 || ii == 2) && (jj == 0 || jj == 2)) {
-            node.level = 1;
-            node.info = node_label;
-          } else if (ii == 0 || ii == 2 || jj == 0 || jj == 2) {
-            node.level = mesh_order - 2;
-            node.info = edge_label;
-          } else {
-            node.level = (mesh_order - 2) * (mesh_order - 2);
-            node.info = face_label;
-          }
-          node.tag = mpi_rank;
-          transformNode(&node);
-          local_nodes->addQuadrant(&node);
-        }
+      if (nlists % 2 == 1) {
+        lists[npairs] = lists[nlists - 1];
       }
+      nlists = npairs + nlists % 2;
     }
+    nodes = lists[0];
 
-    // Add the nodes from the dependent edges (these will only be
-    // overwritten if required)
-    for (int i = 0; i < num_elements; i++) {
-      if (quads[i].info) {
-        const int32_t h = 1 << (TMR_MAX_LEVEL - quads[i].level);
-
-        for (int edge_index = 0; edge_index < 4; edge_index++) {
-          if (quads[i].info & 1 << edge_index) {
-            TMRQuadrant parent;
-            quads[i].parent(&parent);
+    delete[] merge;
+    delete[] lists;
+    delete[] threads;
+  } else {
+    // Add the nodes from the local elements, followed by the
+    // independent nodes that the dependent nodes rely on
+    TMRQuadrantHash *local_nodes = new TMRQuadrantHash(use_node_index);
+    addElementNodes(0, num_elements, local_nodes);
+    addDependentNodes(0, num_elements, local_nodes);
 
-            for (int ii = 0; ii < 3; ii++) {
-              TMRQuadrant node;
-              node.face = parent.face;
-              if (edge_index < 2) {
-                node.x = parent.x + 2 * h * (edge_index % 2);
-                node.y = parent.y + h * ii;
-              } else {
-                node.x = parent.x + h * ii;
-                node.y = parent.y + 2 * h * (edge_index % 2);
-              }
-              if (ii == 0 || ii == 2) {
-                node.level = 1;
-                node.info = node_label;
-              } else {
-                node.level = mesh_order - 2;
-                node.info = edge_label;
-              }
-              // Assign the negative rank to this processor
-              node.tag = -1;
-              transformNode(&node);
-              local_nodes->addQuadrant(&node);
-            }
-          }
-        }
-      }
-    }
+    // Now the local_nodes hash table contains all of the nodes
+    // (dependent, indepdnent and non-local) that are referenced by
+    // this processor
+    nodes = local_nodes->toArray();
+    delete local_nodes;
+    nodes->sort();
   }
 
-  // Now the local_nodes hash table contains all of the nodes
-  // (dependent, indepdnent and non-local) that are referenced by
-  // this processor
-  TMRQuadrantArray *nodes = local_nodes->toArray();
-  delete local_nodes;
-  nodes->sort();
-
   // Now, determine the node ownership - if nodes that are not
   // dependent on this processor
   int use_tags = 0, include_local = 0;
@@ -3464,6 +4649,182 @@ TMRQuadrantArray *TMRQuadForest::createLocalNodes() {
   return nodes;
 }
 
+/*
+  Add the nodes of the local quadrants array[start:end] to the hash
+
+  The nodes are labeled with this processor as the owner.
+*/
+void TMRQuadForest::addElementNodes(int start, int end,
+                                    TMRQuadrantHash *hash) {
+  TMRQuadrant *quads;
+  quadrants->getArray(&quads, NULL);
+
+  // Set the node, edge and face labels
+  int label_type[3];
+  initLabel(mesh_order, interp_type, label_type);
+  const int node_label = label_type[0];
+  const int edge_label = label_type[1];
+  const int face_label = label_type[2];
+
+  // Set the node locations
+  if (mesh_order == 2) {
+    // First of all, add all the nodes from the local elements
+    // on this processor
+    for (int i = start; i < end; i++) {
+      const int32_t h = 1 << (TMR_MAX_LEVEL - quads[i].level);
+      for (int jj = 0; jj < 2; jj++) {
+        for (int ii = 0; ii < 2; ii++) {
+          TMRQuadrant node;
+          node.face = quads[i].face;
+          node.level = 1;
+          node.x = quads[i].x + h * ii;
+          node.y = quads[i].y + h * jj;
+          node.tag = mpi_rank;
+          node.info = node_label;
+          transformNode(&node);
+          hash->addQuadrant(&node);
+        }
+      }
+    }
+  } else {
+    for (int i = start; i < end; i++) {
+      const int32_t h = 1 << (TMR_MAX_LEVEL - quads[i].level - 1);
+      for (int jj = 0; jj < 3; jj++) {
+        for (int ii = 0; ii < 3; ii++) {
+          TMRQuadrant node;
+          node.face = quads[i].face;
+          node.x = quads[i].x + h * ii;
+          node.y = quads[i].y + h * jj;
+          if ((ii == 0 || ii == 2) && (jj == 0 || jj == 2)) {
+            node.level = 1;
+            node.info = node_label;
+          } else if (ii == 0 || ii == 2 || jj == 0 || jj == 2) {
+            node.level = mesh_order - 2;
+            node.info = edge_label;
+          } else {
+            node.level = (mesh_order - 2) * (mesh_order - 2);
+            node.info = face_label;
+          }
+          node.tag = mpi_rank;
+          transformNode(&node);
+          hash->addQuadrant(&node);
+        }
+      }
+    }
+  }
+}
+
+/*
+  Add the independent nodes that the dependent nodes of the local
+  quadrants array[start:end] rely on to the hash
+
+  These nodes are labeled with a negative owner. A node that is also
+  created by an element must be added to the hash after the element
+  nodes so that the owner from the element is retained.
+*/
+void TMRQuadForest::addDependentNodes(int start, int end,
+                                      TMRQuadrantHash *hash) {
+  TMRQuadrant *quads;
+  quadrants->getArray(&quads, NULL);
+
+  // Set the node, edge and face labels
+  int label_type[3];
+  initLabel(mesh_order, interp_type, label_type);
+  const int node_label = label_type[0];
+  const int edge_label = label_type[1];
+
+  if (mesh_order == 2) {
+    for (int i = start; i < end; i++) {
+      // Add the external nodes from dependent edges
+      if (quads[i].info) {
+        for (int edge_index = 0; edge_index < 4; edge_index++) {
+          if (quads[i].info & 1 << edge_index) {
+            TMRQuadrant parent;
+            quads[i].parent(&parent);
+
+            const int32_t hp = 1 << (TMR_MAX_LEVEL - parent.level);
+            for (int ii = 0; ii < 2; ii++) {
+              TMRQuadrant node;
+              node.face = parent.face;
+              node.level = 1;
+              if (edge_index < 2) {
+                node.x = parent.x + hp * (edge_index % 2);
+                node.y = parent.y + hp * ii;
+              } else {
+                node.x = parent.x + hp * ii;
+                node.y = parent.y + hp * (edge_index % 2);
+              }
+              // Assign a negative rank index for now...
+              node.tag = -1;
+              node.info = node_label;
+              transformNode(&node);
+              hash->addQuadrant(&node);
+            }
+          }
+        }
+      }
+    }
+  } else {
+    for (int i = start; i < end; i++) {
+      if (quads[i].info) {
+        const int32_t h = 1 << (TMR_MAX_LEVEL - quads[i].level);
+
+        for (int edge_index = 0; edge_index < 4; edge_index++) {
+          if (quads[i].info & 1 << edge_index) {
+            TMRQuadrant parent;
+            quads[i].parent(&parent);
+
+            for (int ii = 0; ii < 3; ii++) {
+              TMRQuadrant node;
+              node.face = parent.face;
+              if (edge_index < 2) {
+                node.x = parent.x + 2 * h * (edge_index % 2);
+                node.y = parent.y + h * ii;
+              } else {
+                node.x = parent.x + h * ii;
+                node.y = parent.y + 2 * h * (edge_index % 2);
+              }
+              if (ii == 0 || ii == 2) {
+                node.level = 1;
+                node.info = node_label;
+              } else {
+                node.level = mesh_order - 2;
+                node.info = edge_label;
+              }
+              // Assign the negative rank to this processor
+              node.tag = -1;
+              transformNode(&node);
+              hash->addQuadrant(&node);
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+/*
+  Data used to compute the local connectivity for a range of quadrants
+*/
+class TMRQuadLocalConnThreadData {
+ public:
+  TMRQuadForest *forest;
+  TMRQuadrantArray *nodes;
+  const int *node_offset;
+  int start, end;
+};
+
+/*
+  Compute the local connectivity for the quadrants array[start:end]
+*/
+void *TMRQuadForest::localConnThread(void *args) {
+  TMRQuadLocalConnThreadData *data =
+      static_cast<TMRQuadLocalConnThreadData *>(args);
+  data->forest->addLocalConn(data->nodes, data->node_offset, data->start,
+                             data->end);
+  return NULL;
+}
+
 /*
   Create the local connectivity based on the ordering in the node
   array and the offset arrays
@@ -3479,41 +4840,73 @@ TMRQuadrantArray *TMRQuadForest::createLocalNodes() {
   which depends on the order of the mesh.
 
   input:
-  nodes:        the array of quadrants that represent nodes
+  nodes:        the sorted array of quadrants that represent nodes
   node_offset:  the array of offsets for each node
 */
 void TMRQuadForest::createLocalConn(TMRQuadrantArray *nodes,
                                     const int *node_offset) {
   // Retrieve the quadrants on this processor
   int num_elements;
+  quadrants->getArray(NULL, &num_elements);
+
+  // Allocate the connectivity
+  int size = mesh_order * mesh_order * num_elements;
+  conn = new int[size];
+  memset(conn, 0, size * sizeof(int));
+
+  // Compute the connectivity for contiguous ranges of the quadrants in
+  // separate threads
+  int nthreads = num_threads;
+  if (nthreads > num_elements) {
+    nthreads = (num_elements > 0 ? num_elements : 1);
+  }
+
+  if (nthreads > 1) {
+    TMRQuadLocalConnThreadData *data = new TMRQuadLocalConnThreadData[nthreads];
+    pthread_t *threads = new pthread_t[nthreads];
+    for (int k = 0; k < nthreads; k++) {
+      data[k].forest = this;
+      data[k].nodes = nodes;
+      data[k].node_offset = node_offset;
+      data[k].start = (int)(((long int)k * num_elements) / nthreads);
+      data[k].end = (int)(((long int)(k + 1) * num_elements) / nthreads);
+      pthread_create(&threads[k], NULL, TMRQuadForest::localConnThread,
+                     (void *)&data[k]);
+    }
+    for (int k = 0; k < nthreads; k++) {
+      pthread_join(threads[k], NULL);
+    }
+    delete[] data;
+    delete[] threads;
+  } else {
+    addLocalConn(nodes, node_offset, 0, num_elements);
+  }
+}
+
+/*
+  Set the local connectivity of the quadrants array[start:end]
+
+  The nodes must be sorted. Each quadrant writes only to its own
+  entries in the connectivity array.
+*/
+void TMRQuadForest::addLocalConn(TMRQuadrantArray *nodes,
+                                 const int *node_offset, int start, int end) {
   TMRQuadrant *quads;
-  quadrants->getArray(&quads, &num_elements);
+  quadrants->getArray(&quads, NULL);
 
   // Retrieve the nodes
-  int node_size;
   TMRQuadrant *node_array;
-  nodes->getArray(&node_array, &node_size);
-
-  // Set the node, edge and face label
-  int node_label, edge_label, face_label;
-  node_label = edge_label = face_label = TMR_QUAD_NODE_LABEL;
+  nodes->getArray(&node_array, NULL);
 
+  // Set the node, edge and face labels
   int label_type[3];
-  // If the mesh order is high enough, we will have multiple nodes
-  // per edge/face
   initLabel(mesh_order, interp_type, label_type);
-
-  node_label = label_type[0];
-  edge_label = label_type[1];
-  face_label = label_type[2];
-
-  // Allocate the connectivity
-  int size = mesh_order * mesh_order * num_elements;
-  conn = new int[size];
-  memset(conn, 0, size * sizeof(int));
+  const int node_label = label_type[0];
+  const int edge_label = label_type[1];
+  const int face_label = label_type[2];
 
   if (mesh_order <= 3) {
-    for (int i = 0; i < num_elements; i++) {
+    for (int i = start; i < end; i++) {
       int *c = &conn[mesh_order * mesh_order * i];
       const int32_t h = 1 << (TMR_MAX_LEVEL - quads[i].level - 1);
 
@@ -3571,7 +4964,7 @@ void TMRQuadForest::createLocalConn(TMRQuadrantArray *nodes,
   } else {
     // Loop over all the elements and assign the local index owners
     // for each node
-    for (int i = 0; i < num_elements; i++) {
+    for (int i = start; i < end; i++) {
       int *c = &conn[mesh_order * mesh_order * i];
 
       // Compute the half-edge length of the quadrant
@@ -3857,6 +5250,56 @@ void TMRQuadForest::createDependentConn(const int *node_nums,
   delete[] edge_nodes;
 }
 
+/*
+  Get the inverse of the Bernstein interpolation matrix, evaluated at
+  the interpolation knots. The inverse maps the physical locations at
+  the knots to the Bernstein control points. It is computed once for
+  the current mesh order and freed when the order is changed.
+*/
+const double *TMRQuadForest::getInterpInverse() {
+  if (interp_inverse) {
+    return interp_inverse;
+  }
+
+  // Form the interpolating matrix
+  const double *knots = interp_knots;
+  int size = mesh_order * mesh_order;
+  double *interp = new double[size * size];
+
+  // For each point within the mesh, evaluate the shape functions
+  for (int i = 0; i < size; i++) {
+    double pt[2];
+    pt[0] = knots[i % mesh_order];
+    pt[1] = knots[i / mesh_order];
+
+    // Evaluate the interpolant
+    evalInterp(pt, &interp[size * i]);
+  }
+
+  // Compute the inverse for interpolation
+  int info = 0;
+  int *ipiv = new int[size];
+  TmrLAPACKdgetrf(&size, &size, interp, &size, ipiv, &info);
+
+  // Apply the factoriziation to the inverse
+  interp_inverse = new double[size * size];
+  memset(interp_inverse, 0, size * size * sizeof(double));
+  for (int i = 0; i < size; i++) {
+    interp_inverse[(size + 1) * i] = 1.0;
+  }
+
+  // Compute the inverse -- note that the transpose is used here
+  // since the interpolation matrix is stored in a row-major order
+  // not column-major order.
+  TmrLAPACKdgetrs("N", &size, &size, interp, &size, ipiv, interp_inverse,
+                  &size, &info);
+
+  delete[] ipiv;
+  delete[] interp;
+
+  return interp_inverse;
+}
+
 /*
   Evaluate the node locations based on the parametric locations
 */
@@ -3875,119 +5318,149 @@ void TMRQuadForest::evaluateNodeLocations() {
   // Set the knots to use in the interpolation
   const double *knots = interp_knots;
 
-  if (topo && (interp_type == TMR_BERNSTEIN_POINTS && mesh_order > 2)) {
-    // Form the interpolating matrix
-    int size = mesh_order * mesh_order;
-    double *interp = new double[size * size];
-
-    // For each point within the mesh, evaluate the shape functions
-    for (int i = 0; i < size; i++) {
-      double pt[2];
-      pt[0] = knots[i % mesh_order];
-      pt[1] = knots[i / mesh_order];
-
-      // Evaluate the interpolant
-      evalInterp(pt, &interp[size * i]);
-    }
-
-    // Compute the inverse for interpolation
-    int info = 0;
-    int *ipiv = new int[size];
-    TmrLAPACKdgetrf(&size, &size, interp, &size, ipiv, &info);
+  if (topo) {
+    const int size = mesh_order * mesh_order;
 
-    // Apply the factoriziation to the inverse
-    double *inverse = new double[size * size];
-    memset(inverse, 0, size * size * sizeof(double));
-    for (int i = 0; i < size; i++) {
-      inverse[(size + 1) * i] = 1.0;
+    // Retrieve the inverse of the interpolation for Bernstein points
+    const double *inverse = NULL;
+    if (interp_type == TMR_BERNSTEIN_POINTS && mesh_order > 2) {
+      inverse = getInterpInverse();
     }
 
-    // Compute the inverse -- note that the transpose is used here
-    // since the interpolation matrix is stored in a row-major order
-    // not column-major order.
-    TmrLAPACKdgetrs("N", &size, &size, interp, &size, ipiv, inverse, &size,
-                    &info);
-
-    // Free the rest of the data
-    delete[] ipiv;
-    delete[] interp;
-
-    // Allocate storage for the element node locations
-    TMRPoint *Xtmp = new TMRPoint[size];
-
-    for (int i = 0; i < num_elements; i++) {
-      // Get the right surface
-      TMRFace *surf;
-      topo->getFace(quads[i].face, &surf);
-
-      // Compute the edge length
-      const int32_t h = 1 << (TMR_MAX_LEVEL - quads[i].level);
-
-      // Compute the origin of the element in parametric space
-      // and the edge length of the element
-      double d = convert_to_coordinate(h);
-      double u = convert_to_coordinate(quads[i].x);
-      double v = convert_to_coordinate(quads[i].y);
+    // Allocate space for a batch of points
+    const int max_points = size * MAX_EVAL_BATCH_SIZE;
+    double *prm = new double[2 * max_points];
+    int *dest = new int[max_points];
+    TMRPoint *Xtmp = new TMRPoint[max_points];
+
+    int i = 0;
+    while (i < num_elements) {
+      // Collect the points for a run of quadrants within the same face.
+      // Each node is assigned to the first quadrant that contains it.
+      const int face = quads[i].face;
+      int npts = 0;
+      for (int nelems = 0; i < num_elements && quads[i].face == face &&
+                           nelems < MAX_EVAL_BATCH_SIZE;
+           i++) {
+        const int *c = &conn[size * i];
+
+        // Find the nodes that are not yet assigned
+        int num_owned = 0;
+        int *d = &dest[npts];
+        for (int j = 0; j < size; j++) {
+          int index = getLocalNodeNumber(c[j]);
+          d[j] = -1;
+          if (!flags[index]) {
+            flags[index] = 1;
+            d[j] = index;
+            num_owned++;
+          }
+        }
+        if (num_owned == 0) {
+          continue;
+        }
 
-      for (int jj = 0; jj < mesh_order; jj++) {
-        for (int ii = 0; ii < mesh_order; ii++) {
-          int local_index = ii + jj * mesh_order;
-          surf->evalPoint(u + 0.5 * d * (1.0 + knots[ii]),
-                          v + 0.5 * d * (1.0 + knots[jj]), &Xtmp[local_index]);
+        // Compute the origin of the element in parametric space
+        // and the edge length of the element
+        const int32_t h = 1 << (TMR_MAX_LEVEL - quads[i].level);
+        double dh = convert_to_coordinate(h);
+        double u = convert_to_coordinate(quads[i].x);
+        double v = convert_to_coordinate(quads[i].y);
+
+        // Add either all the points (when the control points are
+        // computed) or only the newly assigned points
+        int n = 0;
+        for (int j = 0; j < size; j++) {
+          if (inverse || d[j] >= 0) {
+            prm[2 * (npts + n)] = u + 0.5 * dh * (1.0 + knots[j % mesh_order]);
+            prm[2 * (npts + n) + 1] =
+                v + 0.5 * dh * (1.0 + knots[j / mesh_order]);
+            d[n] = d[j];
+            n++;
+          }
         }
+        npts += n;
+        nelems++;
       }
 
-      for (int jj = 0; jj < mesh_order; jj++) {
-        for (int ii = 0; ii < mesh_order; ii++) {
-          // Compute the mesh index
-          int local_index = ii + jj * mesh_order;
-          int node = conn[mesh_order * mesh_order * i + local_index];
-          int index = getLocalNodeNumber(node);
-          if (!flags[index]) {
-            flags[index] = 1;
+      if (npts == 0) {
+        continue;
+      }
 
+      TMRFace *surf;
+      topo->getFace(face, &surf);
+      surf->evalPoints(npts, prm, Xtmp);
+
+      if (inverse) {
+        // Compute the control points from the points within each quadrant
+        for (int k = 0; k < npts; k++) {
+          int index = dest[k];
+          if (index >= 0) {
+            const double *inv = &inverse[(k % size) * size];
+            const TMRPoint *Xe = &Xtmp[size * (k / size)];
             X[index].x = X[index].y = X[index].z = 0.0;
             for (int j = 0; j < size; j++) {
-              X[index].x += inverse[local_index * size + j] * Xtmp[j].x;
-              X[index].y += inverse[local_index * size + j] * Xtmp[j].y;
-              X[index].z += inverse[local_index * size + j] * Xtmp[j].z;
+              X[index].x += inv[j] * Xe[j].x;
+              X[index].y += inv[j] * Xe[j].y;
+              X[index].z += inv[j] * Xe[j].z;
             }
           }
         }
+      } else {
+        for (int k = 0; k < npts; k++) {
+          X[dest[k]] = Xtmp[k];
+        }
       }
     }
 
-    delete[] inverse;
+    delete[] prm;
+    delete[] dest;
     delete[] Xtmp;
-  } else if (topo) {
+  } else if (fdata->node_pts) {
+    // Interpolate the node locations from the face corners. The
+    // Bernstein control points of the bilinear map are its values at
+    // uniformly spaced points.
+    double *pknots = new double[mesh_order];
+    for (int i = 0; i < mesh_order; i++) {
+      pknots[i] = knots[i];
+      if (interp_type == TMR_BERNSTEIN_POINTS) {
+        pknots[i] = -1.0 + 2.0 * i / (mesh_order - 1);
+      }
+    }
+
     for (int i = 0; i < num_elements; i++) {
-      // Get the right surface
-      TMRFace *surf;
-      topo->getFace(quads[i].face, &surf);
+      const int *fc = &fdata->face_conn[4 * quads[i].face];
 
-      // Compute the edge length
       const int32_t h = 1 << (TMR_MAX_LEVEL - quads[i].level);
-
-      // Compute the origin of the element in parametric space
-      // and the edge length of the element
       double d = convert_to_coordinate(h);
       double u = convert_to_coordinate(quads[i].x);
       double v = convert_to_coordinate(quads[i].y);
 
-      // Look for nodes that are not assigned
       for (int jj = 0; jj < mesh_order; jj++) {
         for (int ii = 0; ii < mesh_order; ii++) {
-          // Compute the mesh index
           int node = conn[mesh_order * mesh_order * i + ii + jj * mesh_order];
           int index = getLocalNodeNumber(node);
           if (!flags[index]) {
             flags[index] = 1;
-            surf->evalPoint(u + 0.5 * d * (1.0 + knots[ii]),
-                            v + 0.5 * d * (1.0 + knots[jj]), &X[index]);
+
+            // Evaluate the bilinear shape functions for the face
+            double pt[2];
+            pt[0] = u + 0.5 * d * (1.0 + pknots[ii]);
+            pt[1] = v + 0.5 * d * (1.0 + pknots[jj]);
+            for (int n = 0; n < 4; n++) {
+              double N = ((n & 1) ? pt[0] : 1.0 - pt[0]) *
+                         ((n & 2) ? pt[1] : 1.0 - pt[1]);
+              const TMRPoint *p = &fdata->node_pts[fc[n]];
+              X[index].x += N * p->x;
+              X[index].y += N * p->y;
+              X[index].z += N * p->z;
+            }
           }
         }
       }
     }
+
+    delete[] pknots;
   }
 
   delete[] flags;
@@ -4026,35 +5499,200 @@ void TMRQuadForest::getNodeConn(const int **_conn, int *_num_elements,
   Get the dependent connectivity information (create it if it has not
   been allocated previously).
 
-  output:
-  ptr:      pointer for each dependent node number
-  conn:     connectivity to each (global) independent node
-  weights:  the weight values for each dependent node
+  output:
+  ptr:      pointer for each dependent node number
+  conn:     connectivity to each (global) independent node
+  weights:  the weight values for each dependent node
+*/
+int TMRQuadForest::getDepNodeConn(const int **ptr, const int **conn,
+                                  const double **weights) {
+  if (ptr) {
+    *ptr = dep_ptr;
+  }
+  if (conn) {
+    *conn = dep_conn;
+  }
+  if (weights) {
+    *weights = dep_weights;
+  }
+  return num_dep_nodes;
+}
+
+/*
+  Append an entry consisting of a name index followed by size - 1
+  values to a growable array of entries
+*/
+static void add_name_entry(int size, const int *entry, int *count,
+                           int *max_count, int **entries) {
+  if (*count >= *max_count) {
+    int new_max = 2 * (*max_count) + 1024;
+    int *tmp = new int[size * new_max];
+    int *old = *entries;
+    if (old) {
+      memcpy(tmp, old, size * (*count) * sizeof(int));
+      delete[] old;
+    }
+    *entries = tmp;
+    *max_count = new_max;
+  }
+  memcpy(&(*entries)[size * (*count)], entry, size * sizeof(int));
+  (*count)++;
+}
+
+/*
+  Sort the entries by name index, keeping the original order within
+  each name, and create a pointer into the list of values
+*/
+static void sort_name_entries(int num_names, int size, int count,
+                              const int *entries, int **_ptr, int **_list) {
+  int *ptr = new int[num_names + 1];
+  memset(ptr, 0, (num_names + 1) * sizeof(int));
+  for (int i = 0; i < count; i++) {
+    ptr[entries[size * i] + 1]++;
+  }
+  for (int i = 0; i < num_names; i++) {
+    ptr[i + 1] += ptr[i];
+  }
+
+  int *list = new int[(size - 1) * count];
+  for (int i = 0; i < count; i++) {
+    int n = entries[size * i];
+    memcpy(&list[(size - 1) * ptr[n]], &entries[size * i + 1],
+           (size - 1) * sizeof(int));
+    ptr[n]++;
+  }
+  for (int i = num_names; i > 0; i--) {
+    ptr[i] = ptr[i - 1];
+  }
+  ptr[0] = 0;
+
+  *_ptr = ptr;
+  *_list = list;
+}
+
+/*
+  Intern the names of the vertices, edges and faces in the topology.
+  Each entity is assigned the index of its name within the name table,
+  so that names can be compared as integers. Index zero is reserved
+  for entities without a name.
+*/
+void TMRQuadForest::computeNameIds() {
+  const int num_entities[3] = {fdata->num_nodes, fdata->num_edges,
+                               fdata->num_faces};
+  int max_names = 1 + num_entities[0] + num_entities[1] + num_entities[2];
+  fdata->name_table = new char *[max_names];
+  fdata->name_table[0] = NULL;
+  fdata->num_names = 1;
+
+  fdata->vert_name_ids = new int[num_entities[0]];
+  fdata->edge_name_ids = new int[num_entities[1]];
+  fdata->face_name_ids = new int[num_entities[2]];
+  int *ids[3] = {fdata->vert_name_ids, fdata->edge_name_ids,
+                 fdata->face_name_ids};
+
+  for (int type = 0; type < 3; type++) {
+    for (int i = 0; i < num_entities[type]; i++) {
+      const char *name = NULL;
+      if (type == 0) {
+        TMRVertex *vert;
+        topo->getVertex(i, &vert);
+        name = vert->getName();
+      } else if (type == 1) {
+        TMREdge *edge;
+        topo->getEdge(i, &edge);
+        name = edge->getName();
+      } else {
+        TMRFace *face;
+        topo->getFace(i, &face);
+        name = face->getName();
+      }
+
+      int id = getNameId(name);
+      if (id < 0) {
+        id = fdata->num_names;
+        fdata->name_table[id] = new char[strlen(name) + 1];
+        strcpy(fdata->name_table[id], name);
+        fdata->num_names++;
+      }
+      ids[type][i] = id;
+    }
+  }
+}
+
+/*
+  Get the index of the name in the name table, or -1 if no entity has
+  the name
+*/
+int TMRQuadForest::getNameId(const char *name) {
+  if (!name) {
+    return 0;
+  }
+  for (int i = 1; i < fdata->num_names; i++) {
+    if (strcmp(fdata->name_table[i], name) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/*
+  Compute the quadrants that lie in a face or touch an edge with each
+  name. The quadrant is stored with info = -1 when the face name
+  matches, otherwise info is the local edge index. Only faces match
+  entities without a name.
 */
-int TMRQuadForest::getDepNodeConn(const int **ptr, const int **conn,
-                                  const double **weights) {
-  if (ptr) {
-    *ptr = dep_ptr;
+void TMRQuadForest::computeQuadNameIndex() {
+  if (!fdata->name_table) {
+    computeNameIds();
   }
-  if (conn) {
-    *conn = dep_conn;
+
+  int size;
+  TMRQuadrant *array;
+  quadrants->getArray(&array, &size);
+
+  int count = 0, max_count = 0;
+  int *entries = NULL;
+
+  const int32_t hmax = 1 << TMR_MAX_LEVEL;
+  for (int i = 0; i < size; i++) {
+    const int32_t h = 1 << (TMR_MAX_LEVEL - array[i].level);
+    const int *edge_conn = &fdata->face_edge_conn[4 * array[i].face];
+
+    // Add the quadrant to the list for the face name
+    int face_id = fdata->face_name_ids[array[i].face];
+    int entry[3] = {face_id, i, -1};
+    add_name_entry(3, entry, &count, &max_count, &entries);
+
+    // Add the quadrant for the names of the edges it touches
+    const int on_edge[4] = {array[i].x == 0, array[i].x + h == hmax,
+                            array[i].y == 0, array[i].y + h == hmax};
+    for (int k = 0; k < 4; k++) {
+      int edge_id = fdata->edge_name_ids[edge_conn[k]];
+      if (on_edge[k] && edge_id != 0 && edge_id != face_id) {
+        entry[0] = edge_id;
+        entry[2] = k;
+        add_name_entry(3, entry, &count, &max_count, &entries);
+      }
+    }
   }
-  if (weights) {
-    *weights = dep_weights;
+
+  sort_name_entries(fdata->num_names, 3, count, entries, &name_quad_ptr,
+                    &name_quad_list);
+  if (entries) {
+    delete[] entries;
   }
-  return num_dep_nodes;
 }
 
 /*
   Get the elements that either lie on a face or curve with a given
   name.
 
-  This code loops over all quadrants owned locally on this processor
-  and checks if each quadrant lies on a face or boundary. If the face
-  name matches, the quadrant is added without modification. If
-  the quadrant lies on an edge, the quadrant is modified so that the
-  info indicates which edge the quadrant lies on using the regular edge
-  ordering scheme.
+  The quadrants are found from an index of the quadrants by name that
+  is computed on the first call and retained until the quadrants
+  change. If the face name matches, the quadrant is added without
+  modification. If the quadrant lies on an edge, the quadrant is
+  modified so that the info indicates which edge the quadrant lies on
+  using the regular edge ordering scheme.
 
   input:
   name:   string name associated with the geometric feature
@@ -4075,87 +5713,138 @@ TMRQuadrantArray *TMRQuadForest::getQuadsWithName(const char *name) {
             "getQuadsWithName()\n");
     return NULL;
   }
-
-  // Create a queue to store the elements that we find
-  TMRQuadrantQueue *queue = new TMRQuadrantQueue();
+  if (!name_quad_ptr) {
+    computeQuadNameIndex();
+  }
 
   // Get the quadrants
   int size;
   TMRQuadrant *array;
   quadrants->getArray(&array, &size);
 
-  // Loop over the quadrants and find out whether it touches
-  // a face or edge with the prescribed name
+  // Copy the quadrants with this name from the index
+  int id = getNameId(name);
+  int len = 0;
+  if (id >= 0) {
+    len = name_quad_ptr[id + 1] - name_quad_ptr[id];
+  }
+  TMRQuadrant *list = new TMRQuadrant[len];
+  for (int k = 0; k < len; k++) {
+    const int *entry = &name_quad_list[2 * (name_quad_ptr[id] + k)];
+    list[k] = array[entry[0]];
+    if (entry[1] >= 0) {
+      list[k].info = entry[1];
+    }
+  }
+
+  return new TMRQuadrantArray(list, len);
+}
+
+/*
+  Compute the nodes that lie on a corner, edge or face with each name.
+  Each node list is sorted and the duplicates are removed. Entities
+  without a name are not indexed.
+*/
+void TMRQuadForest::computeNodeNameIndex() {
+  if (!fdata->name_table) {
+    computeNameIds();
+  }
+
+  // The maximum quadrant edge length
   const int32_t hmax = 1 << TMR_MAX_LEVEL;
+  const int m = mesh_order;
+
+  int count = 0, max_count = 0;
+  int *entries = NULL;
+
+  // Get the local nodal quadrants
+  int size;
+  TMRQuadrant *quads;
+  quadrants->getArray(&quads, &size);
+
   for (int i = 0; i < size; i++) {
-    const int32_t h = 1 << (TMR_MAX_LEVEL - array[i].level);
+    // Compute the quadrant edge length
+    const int32_t h = 1 << (TMR_MAX_LEVEL - quads[i].level);
+    const int *c = &conn[m * m * quads[i].tag];
+    const int face = quads[i].face;
 
-    // Get the surface quadrant
-    TMRFace *surf;
-    topo->getFace(array[i].face, &surf);
-    const char *face_name = surf->getName();
-    if ((!name && !face_name) || (face_name && strcmp(face_name, name) == 0)) {
-      queue->push(&array[i]);
-    } else {
-      // If this quadrant was not added from a face
-      // name, check to see if it should be added
-      // as an edge/curve name
-      TMREdge *edge;
-      if (array[i].x == 0) {
-        int edge_num = fdata->face_edge_conn[4 * array[i].face];
-        topo->getEdge(edge_num, &edge);
-        const char *edge_name = edge->getName();
-        if (edge_name && strcmp(edge_name, name) == 0) {
-          TMRQuadrant p = array[i];
-          p.info = 0;
-          queue->push(&p);
-        }
-      }
-      if (array[i].x + h == hmax) {
-        int edge_num = fdata->face_edge_conn[4 * array[i].face + 1];
-        topo->getEdge(edge_num, &edge);
-        const char *edge_name = edge->getName();
-        if (edge_name && strcmp(edge_name, name) == 0) {
-          TMRQuadrant p = array[i];
-          p.info = 1;
-          queue->push(&p);
+    const int on_edge[4] = {quads[i].x == 0, quads[i].x + h == hmax,
+                            quads[i].y == 0, quads[i].y + h == hmax};
+    int fx = (on_edge[0] || on_edge[1]);
+    int fy = (on_edge[2] || on_edge[3]);
+
+    if (fx && fy) {
+      // Add the nodes on the corners of the face
+      for (int k = 0; k < 4; k++) {
+        int id = fdata->vert_name_ids[fdata->face_conn[4 * face + k]];
+        if (id != 0 && on_edge[k % 2] && on_edge[2 + k / 2]) {
+          int offset = ((m - 1) * (k % 2) + (m - 1) * m * (k / 2));
+          int entry[2] = {id, c[offset]};
+          add_name_entry(2, entry, &count, &max_count, &entries);
         }
       }
-      if (array[i].y == 0) {
-        int edge_num = fdata->face_edge_conn[4 * array[i].face + 2];
-        topo->getEdge(edge_num, &edge);
-        const char *edge_name = edge->getName();
-        if (edge_name && strcmp(edge_name, name) == 0) {
-          TMRQuadrant p = array[i];
-          p.info = 2;
-          queue->push(&p);
+    }
+    if (fx || fy) {
+      // Add the nodes on the edges of the face
+      for (int k = 0; k < 4; k++) {
+        int id = fdata->edge_name_ids[fdata->face_edge_conn[4 * face + k]];
+        if (id != 0 && on_edge[k]) {
+          for (int n = 0; n < m; n++) {
+            int offset = 0;
+            if (k < 2) {
+              offset = n * m + (m - 1) * k;
+            } else {
+              offset = n + (m - 1) * m * (k % 2);
+            }
+            int entry[2] = {id, c[offset]};
+            add_name_entry(2, entry, &count, &max_count, &entries);
+          }
         }
       }
-      if (array[i].y + h == hmax) {
-        int edge_num = fdata->face_edge_conn[4 * array[i].face + 3];
-        topo->getEdge(edge_num, &edge);
-        const char *edge_name = edge->getName();
-        if (edge_name && strcmp(edge_name, name) == 0) {
-          TMRQuadrant p = array[i];
-          p.info = 3;
-          queue->push(&p);
-        }
+    }
+
+    // Add the nodes on the face
+    int id = fdata->face_name_ids[face];
+    if (id != 0) {
+      for (int n = 0; n < m * m; n++) {
+        int entry[2] = {id, c[n]};
+        add_name_entry(2, entry, &count, &max_count, &entries);
       }
     }
   }
 
-  TMRQuadrantArray *list = queue->toArray();
-  delete queue;
-  return list;
+  sort_name_entries(fdata->num_names, 2, count, entries, &name_node_ptr,
+                    &name_node_list);
+  if (entries) {
+    delete[] entries;
+  }
+
+  // Sort the node numbers for each name and remove duplicates
+  int len = 0;
+  for (int n = 0; n < fdata->num_names; n++) {
+    int start = name_node_ptr[n];
+    int end = name_node_ptr[n + 1];
+    name_node_ptr[n] = len;
+    qsort(&name_node_list[start], end - start, sizeof(int), compare_integers);
+    for (int ptr = start; ptr < end; ptr++, len++) {
+      while ((ptr < end - 1) &&
+             (name_node_list[ptr] == name_node_list[ptr + 1])) {
+        ptr++;
+      }
+      name_node_list[len] = name_node_list[ptr];
+    }
+  }
+  name_node_ptr[fdata->num_names] = len;
 }
 
 /*
   Create an array of the nodes that are lie on a surface, edge or
   corner with a given name
 
-  This code loops over all nodes and check whether they lie on a
-  geometric entity that has the given name. The nodes are not
-  unique if they are lie on a shared boundary between processors.
+  The nodes are found from an index of the nodes by name that is
+  computed on the first call and retained until the nodes change. The
+  nodes are not unique if they are lie on a shared boundary between
+  processors.
 
   input:
   name:   the string of the name to search
@@ -4178,165 +5867,93 @@ int TMRQuadForest::getNodesWithName(const char *name, int **_nodes) {
     *_nodes = NULL;
     return 0;
   }
+  if (!name_node_ptr) {
+    computeNodeNameIndex();
+  }
 
-  // The maximum quadrant edge length
-  const int32_t hmax = 1 << TMR_MAX_LEVEL;
-
-  // Get the local nodal quadrants
-  int size;
-  TMRQuadrant *quads;
-  quadrants->getArray(&quads, &size);
-
-  int count = 0;                      // Current node count
-  int max_len = 1024;                 // max length of the node list
-  int *node_list = new int[max_len];  // Nodes touching this name
-
-  // Max number of nodes added by one quadrant
-  const int max_node_incr = 4 + 4 * mesh_order + mesh_order * mesh_order;
+  // Copy the nodes with this name from the index
+  int id = getNameId(name);
+  int len = 0;
+  if (id > 0) {
+    len = name_node_ptr[id + 1] - name_node_ptr[id];
+  }
+  int *node_list = new int[len];
+  if (len > 0) {
+    memcpy(node_list, &name_node_list[name_node_ptr[id]], len * sizeof(int));
+  }
 
-  // Loop over the quadrants and find out whether it touches a face or
-  // edge with the prescribed name
-  for (int i = 0; i < size; i++) {
-    if (count + max_node_incr > max_len) {
-      // Extend the length of the array
-      max_len = 2 * max_len + max_node_incr;
-      int *tmp = new int[max_len];
-      memcpy(tmp, node_list, count * sizeof(int));
-      delete[] node_list;
-      node_list = tmp;
-    }
+  *_nodes = node_list;
+  return len;
+}
 
-    // Compute the quadrant edge length
-    const int32_t h = 1 << (TMR_MAX_LEVEL - quads[i].level);
+/*
+  Given a node, find the enclosing quadrant
 
-    // Check if this node is on a corner, edge or face, and whether it
-    // shares the appropriate name
-    int fx0 = (quads[i].x == 0);
-    int fy0 = (quads[i].y == 0);
-    int fx = (fx0 || quads[i].x + h == hmax);
-    int fy = (fy0 || quads[i].y + h == hmax);
+  This code is used to find the quadrant in the quadrant array that
+  encloses the given node.
+*/
+TMRQuadrant *TMRQuadForest::findEnclosing(const int order, const double *knots,
+                                          TMRQuadrant *node, int *mpi_owner) {
+  int start = findEnclosingStart(node);
+  return findEnclosing(order, knots, node, start, mpi_owner);
+}
 
-    if (fx && fy) {
-      // Keep track of which corners this element touches
-      int ncorners = 0;
-      int corner_index[4];
-      if (quads[i].x == 0 && quads[i].y == 0) {
-        corner_index[ncorners] = 0;
-        ncorners++;
-      }
-      if (quads[i].x + h == hmax && quads[i].y == 0) {
-        corner_index[ncorners] = 1;
-        ncorners++;
-      }
-      if (quads[i].x == 0 && quads[i].y + h == hmax) {
-        corner_index[ncorners] = 2;
-        ncorners++;
-      }
-      if (quads[i].x + h == hmax && quads[i].y + h == hmax) {
-        corner_index[ncorners] = 3;
-        ncorners++;
-      }
+/*
+  Find the location in the quadrant array where the search for the
+  quadrant enclosing the node begins.
 
-      for (int ii = 0; ii < ncorners; ii++) {
-        TMRVertex *vert;
-        int vert_num = fdata->face_conn[4 * quads[i].face + corner_index[ii]];
-        topo->getVertex(vert_num, &vert);
-        const char *vert_name = vert->getName();
-        if (vert_name && strcmp(vert_name, name) == 0) {
-          int offset = ((mesh_order - 1) * (corner_index[ii] % 2) +
-                        (mesh_order - 1) * mesh_order * (corner_index[ii] / 2));
-          node_list[count] =
-              conn[mesh_order * mesh_order * quads[i].tag + offset];
-          count++;
-        }
-      }
-    }
-    if (fx || fy) {
-      // Keep track of which edges this element touches
-      int nedges = 0;
-      int edge_index[4];
-      if (quads[i].x == 0) {
-        edge_index[nedges] = 0;
-        nedges++;
-      }
-      if (quads[i].x + h == hmax) {
-        edge_index[nedges] = 1;
-        nedges++;
-      }
-      if (quads[i].y == 0) {
-        edge_index[nedges] = 2;
-        nedges++;
-      }
-      if (quads[i].y + h == hmax) {
-        edge_index[nedges] = 3;
-        nedges++;
-      }
+  This depends only on the position of the node quadrant and not on
+  the node location stored in the info member. The result can
+  therefore be shared between all the nodes of an element.
+*/
+int TMRQuadForest::findEnclosingStart(TMRQuadrant *node) {
+  // Retrieve the array of elements
+  int size = 0;
+  TMRQuadrant *array = NULL;
+  quadrants->getArray(&array, &size);
 
-      for (int ii = 0; ii < nedges; ii++) {
-        TMREdge *edge;
-        int edge_num =
-            fdata->face_edge_conn[4 * quads[i].face + edge_index[ii]];
-        topo->getEdge(edge_num, &edge);
-        const char *edge_name = edge->getName();
-        if (edge_name && strcmp(edge_name, name) == 0) {
-          for (int k = 0; k < mesh_order; k++) {
-            int offset = 0;
-            if (edge_index[ii] < 2) {
-              offset = k * mesh_order + (mesh_order - 1) * edge_index[ii];
-            } else {
-              offset = k + (mesh_order - 1) * mesh_order * (edge_index[ii] % 2);
-            }
-            node_list[count] =
-                conn[mesh_order * mesh_order * quads[i].tag + offset];
-            count++;
-          }
-        }
-      }
-    }
+  // Set the low and high indices to the first and last
+  // element of the element array
+  int low = 0;
+  int high = size - 1;
+  int mid = low + (high - low) / 2;
 
-    // This node lies on the face
-    TMRFace *face;
-    topo->getFace(quads[i].face, &face);
-    const char *face_name = face->getName();
-    if (face_name && strcmp(face_name, name) == 0) {
-      for (int jj = 0; jj < mesh_order; jj++) {
-        for (int ii = 0; ii < mesh_order; ii++) {
-          int offset = ii + jj * mesh_order;
-          node_list[count] =
-              conn[mesh_order * mesh_order * quads[i].tag + offset];
-          count++;
-        }
-      }
+  // Maintain values of low/high and mid such that the octant is
+  // between (elems[low], elems[high]).  Note that if high-low=1, then
+  // mid = low
+  while (mid != low) {
+    // Check if the node is contained by the mid octant
+    if (array[mid].contains(node)) {
+      break;
     }
-  }
 
-  // Now, sort the node numbers and remove duplicates
-  qsort(node_list, count, sizeof(int), compare_integers);
+    // Compare the ordering of the two octants - if the octant is less
+    // than the other, then adjust the mid point
+    int stat = array[mid].comparePosition(node);
 
-  // Remove duplicates from the array
-  int len = 0;
-  for (int ptr = 0; ptr < count; ptr++, len++) {
-    while ((ptr < count - 1) && (node_list[ptr] == node_list[ptr + 1])) {
-      ptr++;
+    // array[mid] ? node
+    if (stat == 0) {
+      break;
+    } else if (stat < 0) {
+      low = mid + 1;
+    } else {
+      high = mid - 1;
     }
 
-    if (ptr != len) {
-      node_list[len] = node_list[ptr];
-    }
+    // Re compute the mid-point and repeat
+    mid = low + (int)((high - low) / 2);
   }
 
-  *_nodes = node_list;
-  return len;
+  return mid;
 }
 
 /*
-  Given a node, find the enclosing quadrant
-
-  This code is used to find the quadrant in the quadrant array that
-  encloses the given node.
+  Find the enclosing quadrant, starting the search from the location
+  in the quadrant array returned by findEnclosingStart()
 */
 TMRQuadrant *TMRQuadForest::findEnclosing(const int order, const double *knots,
-                                          TMRQuadrant *node, int *mpi_owner) {
+                                          TMRQuadrant *node, int start,
+                                          int *mpi_owner) {
   // Assume that we'll find octant on this processor for now..
   if (mpi_owner) {
     *mpi_owner = mpi_rank;
@@ -4375,37 +5992,7 @@ TMRQuadrant *TMRQuadForest::findEnclosing(const int order, const double *knots,
   const double xd = node->x + 0.5 * h * (1.0 + knots[ii]);
   const double yd = node->y + 0.5 * h * (1.0 + knots[jj]);
 
-  // Set the low and high indices to the first and last
-  // element of the element array
-  int low = 0;
-  int high = size - 1;
-  int mid = low + (high - low) / 2;
-
-  // Maintain values of low/high and mid such that the octant is
-  // between (elems[low], elems[high]).  Note that if high-low=1, then
-  // mid = low
-  while (mid != low) {
-    // Check if the node is contained by the mid octant
-    if (array[mid].contains(node)) {
-      break;
-    }
-
-    // Compare the ordering of the two octants - if the octant is less
-    // than the other, then adjust the mid point
-    int stat = array[mid].comparePosition(node);
-
-    // array[mid] ? node
-    if (stat == 0) {
-      break;
-    } else if (stat < 0) {
-      low = mid + 1;
-    } else {
-      high = mid - 1;
-    }
-
-    // Re compute the mid-point and repeat
-    mid = low + (int)((high - low) / 2);
-  }
+  int mid = start;
 
   // Compute the bounding quadrant. Quadrants greater than this quad
   // cannot own the node so a further search is futile.
@@ -4659,10 +6246,44 @@ int TMRQuadForest::computeElemInterp(TMRQuadrant *node, TMRQuadForest *coarse,
 */
 void TMRQuadForest::createInterpolation(TMRQuadForest *coarse,
                                         TACSBVecInterp *interp) {
+  TMR_PROFILE_BEGIN(TMR_PROFILE_CREATE_INTERPOLATION);
+
   // Ensure that the nodes are allocated on both octree forests
   createNodes();
   coarse->createNodes();
 
+  // Reuse the recorded rows when neither forest has changed. The check
+  // is collective since building the rows requires communication.
+  if (cache_interp) {
+    int valid = (interp_cache_ptr && interp_cache_coarse == coarse &&
+                 interp_cache_stamps[0] == node_stamp &&
+                 interp_cache_stamps[1] == coarse->node_stamp);
+    MPI_Allreduce(MPI_IN_PLACE, &valid, 1, MPI_INT, MPI_MIN, comm);
+    if (valid) {
+      for (int i = 0; i < interp_cache_nrows; i++) {
+        int start = interp_cache_ptr[i];
+        interp->addInterp(interp_cache_rows[i], &interp_cache_weights[start],
+                          &interp_cache_vars[start],
+                          interp_cache_ptr[i + 1] - start);
+      }
+      TMR_PROFILE_END(TMR_PROFILE_CREATE_INTERPOLATION);
+      return;
+    }
+
+    // Start a new record for this pair of forests
+    freeInterpCache();
+    interp_cache_coarse = coarse;
+    interp_cache_stamps[0] = node_stamp;
+    interp_cache_stamps[1] = coarse->node_stamp;
+    interp_cache_max_rows = node_range[mpi_rank + 1] - node_range[mpi_rank];
+    interp_cache_max_weights = 8 * (interp_cache_max_rows + 1);
+    interp_cache_rows = new int[interp_cache_max_rows];
+    interp_cache_ptr = new int[interp_cache_max_rows + 1];
+    interp_cache_vars = new int[interp_cache_max_weights];
+    interp_cache_weights = new double[interp_cache_max_weights];
+    interp_cache_ptr[0] = 0;
+  }
+
   // Get the dependent node information
   const int *cdep_ptr, *cdep_conn;
   const double *cdep_weights;
@@ -4702,6 +6323,11 @@ void TMRQuadForest::createInterpolation(TMRQuadForest *coarse,
 
   for (int i = 0; i < num_elements; i++) {
     const int *c = &conn[nodes_per_element * i];
+
+    // The search for the enclosing coarse quadrant begins at the same
+    // location for all the nodes in this element
+    int start = -1;
+
     for (int j = 0; j < nodes_per_element; j++) {
       // Check if the fine node is owned by this processor
       if (c[j] >= node_range[mpi_rank] && c[j] < node_range[mpi_rank + 1]) {
@@ -4714,11 +6340,14 @@ void TMRQuadForest::createInterpolation(TMRQuadForest *coarse,
           // processor if it exits
           TMRQuadrant node = quads[i];
           node.info = j;
+          if (start < 0) {
+            start = coarse->findEnclosingStart(&node);
+          }
 
           // Find the MPI owner or the
           int mpi_owner = mpi_rank;
-          TMRQuadrant *t =
-              coarse->findEnclosing(mesh_order, knots, &node, &mpi_owner);
+          TMRQuadrant *t = coarse->findEnclosing(mesh_order, knots, &node,
+                                                 start, &mpi_owner);
 
           // The node is owned a coarse element on this processor
           if (t) {
@@ -4729,7 +6358,7 @@ void TMRQuadForest::createInterpolation(TMRQuadForest *coarse,
               vars[k] = weights[k].index;
               wvals[k] = weights[k].weight;
             }
-            interp->addInterp(c[j], wvals, vars, nweights);
+            addInterpRow(interp, c[j], wvals, vars, nweights);
           } else {
             // We've got to transfer the node to the processor that
             // owns an enclosing element. To do that, add the quad to
@@ -4786,7 +6415,7 @@ void TMRQuadForest::createInterpolation(TMRQuadForest *coarse,
 
   // Now distribute the quad to their destination processors
   int *quad_recv_counts = new int[mpi_size];
-  MPI_Alltoall(quad_counts, 1, MPI_INT, quad_recv_counts, 1, MPI_INT, comm);
+  TMRExchangeCounts(comm, quad_counts, quad_recv_counts);
 
   // Now use oct_ptr to point into the recv array
   quad_recv_ptr[0] = 0;
@@ -4809,9 +6438,19 @@ void TMRQuadForest::createInterpolation(TMRQuadForest *coarse,
   TMRQuadrant *recv_nodes;
   recv_array->getArray(&recv_nodes, &recv_size);
 
+  // Sort the nodes so that the nodes from the same fine element are
+  // adjacent and can share the start of the search
+  qsort(recv_nodes, recv_size, sizeof(TMRQuadrant), compare_quadrant_nodes);
+
   // Recv the nodes and loop over the connectivity
+  int start = 0;
   for (int i = 0; i < recv_size; i++) {
-    TMRQuadrant *t = coarse->findEnclosing(mesh_order, knots, &recv_nodes[i]);
+    if (i == 0 || recv_nodes[i].compare(&recv_nodes[i - 1]) != 0) {
+      start = coarse->findEnclosingStart(&recv_nodes[i]);
+    }
+
+    TMRQuadrant *t = coarse->findEnclosing(mesh_order, knots, &recv_nodes[i],
+                                           start, NULL);
     if (t) {
       // Compute the element interpolation
       int nweights = computeElemInterp(&recv_nodes[i], coarse, t, weights, tmp);
@@ -4820,7 +6459,7 @@ void TMRQuadForest::createInterpolation(TMRQuadForest *coarse,
         vars[k] = weights[k].index;
         wvals[k] = weights[k].weight;
       }
-      interp->addInterp(recv_nodes[i].tag, wvals, vars, nweights);
+      addInterpRow(interp, recv_nodes[i].tag, wvals, vars, nweights);
     } else {
       // This should not happen. Print out an error message here.
       fprintf(stderr,
@@ -4838,6 +6477,146 @@ void TMRQuadForest::createInterpolation(TMRQuadForest *coarse,
   delete[] vars;
   delete[] wvals;
   delete[] weights;
+
+  TMR_PROFILE_END(TMR_PROFILE_CREATE_INTERPOLATION);
+}
+
+/*
+  Set whether to retain the interpolation built by createInterpolation()
+
+  When active, the interpolation rows are recorded along with the
+  coarse forest and the node stamps of both forests. A later call to
+  createInterpolation() with the same coarse forest, when neither
+  forest has been changed since, adds the recorded rows directly and
+  skips the search for the enclosing coarse quadrants and the
+  communication. Any change in either mesh renumbers the nodes, so the
+  rows are then rebuilt from scratch.
+*/
+void TMRQuadForest::setCacheInterpolation(int _cache_interp) {
+  cache_interp = _cache_interp;
+  if (!cache_interp) {
+    freeInterpCache();
+  }
+}
+
+/*
+  Get whether the interpolation is retained by createInterpolation()
+*/
+int TMRQuadForest::getCacheInterpolation() { return cache_interp; }
+
+/*
+  Get the interpolation rows recorded by createInterpolation()
+
+  The rows are only available when the interpolation is cached, and
+  only if they were built for the given coarse forest with neither
+  forest changed since. Each processor returns the rows that it added
+  to the interpolation, which are not necessarily the rows of its owned
+  nodes. The vars are global node numbers on the coarse forest.
+
+  input:
+  coarse:   the coarse forest
+
+  output:
+  rows:     the global node number on this forest of each row
+  ptr:      the offset into vars/weights for each row
+  vars:     the coarse node numbers
+  weights:  the interpolation weights
+
+  returns:  the number of rows, or -1 if no valid rows are recorded
+*/
+int TMRQuadForest::getInterpolationRows(TMRQuadForest *coarse,
+                                        const int **_rows, const int **_ptr,
+                                        const int **_vars,
+                                        const double **_weights) {
+  if (!interp_cache_ptr || interp_cache_coarse != coarse ||
+      interp_cache_stamps[0] != node_stamp ||
+      interp_cache_stamps[1] != coarse->node_stamp) {
+    return -1;
+  }
+  if (_rows) {
+    *_rows = interp_cache_rows;
+  }
+  if (_ptr) {
+    *_ptr = interp_cache_ptr;
+  }
+  if (_vars) {
+    *_vars = interp_cache_vars;
+  }
+  if (_weights) {
+    *_weights = interp_cache_weights;
+  }
+  return interp_cache_nrows;
+}
+
+/*
+  Free the recorded interpolation rows
+*/
+void TMRQuadForest::freeInterpCache() {
+  if (interp_cache_rows) {
+    delete[] interp_cache_rows;
+  }
+  if (interp_cache_ptr) {
+    delete[] interp_cache_ptr;
+  }
+  if (interp_cache_vars) {
+    delete[] interp_cache_vars;
+  }
+  if (interp_cache_weights) {
+    delete[] interp_cache_weights;
+  }
+  interp_cache_coarse = NULL;
+  interp_cache_stamps[0] = interp_cache_stamps[1] = 0;
+  interp_cache_nrows = 0;
+  interp_cache_max_rows = 0;
+  interp_cache_max_weights = 0;
+  interp_cache_rows = NULL;
+  interp_cache_ptr = NULL;
+  interp_cache_vars = NULL;
+  interp_cache_weights = NULL;
+}
+
+/*
+  Add a row to the interpolation, recording it if caching is active
+*/
+void TMRQuadForest::addInterpRow(TACSBVecInterp *interp, int row,
+                                 double *wvals, int *vars, int nweights) {
+  interp->addInterp(row, wvals, vars, nweights);
+
+  if (cache_interp && interp_cache_ptr) {
+    // Extend the arrays if required
+    if (interp_cache_nrows >= interp_cache_max_rows) {
+      int max_rows = 2 * interp_cache_max_rows + 1;
+      int *rows = new int[max_rows];
+      int *ptr = new int[max_rows + 1];
+      memcpy(rows, interp_cache_rows, interp_cache_nrows * sizeof(int));
+      memcpy(ptr, interp_cache_ptr, (interp_cache_nrows + 1) * sizeof(int));
+      delete[] interp_cache_rows;
+      delete[] interp_cache_ptr;
+      interp_cache_rows = rows;
+      interp_cache_ptr = ptr;
+      interp_cache_max_rows = max_rows;
+    }
+    int start = interp_cache_ptr[interp_cache_nrows];
+    if (start + nweights > interp_cache_max_weights) {
+      int max_weights = 2 * interp_cache_max_weights + nweights;
+      int *v = new int[max_weights];
+      double *w = new double[max_weights];
+      memcpy(v, interp_cache_vars, start * sizeof(int));
+      memcpy(w, interp_cache_weights, start * sizeof(double));
+      delete[] interp_cache_vars;
+      delete[] interp_cache_weights;
+      interp_cache_vars = v;
+      interp_cache_weights = w;
+      interp_cache_max_weights = max_weights;
+    }
+
+    // Record the row
+    interp_cache_rows[interp_cache_nrows] = row;
+    memcpy(&interp_cache_vars[start], vars, nweights * sizeof(int));
+    memcpy(&interp_cache_weights[start], wvals, nweights * sizeof(double));
+    interp_cache_ptr[interp_cache_nrows + 1] = start + nweights;
+    interp_cache_nrows++;
+  }
 }
 
 /*
@@ -46,9 +46,10 @@ class TMRQuadForest : public TMREntity {
                 TMRInterpolationType interp_type = TMR_GAUSS_LOBATTO_POINTS);
   ~TMRQuadForest();
 
-  // Get the MPI communicator
-  // ------------------------
+  // Get/set the MPI communicator
+  // ----------------------------
   MPI_Comm getMPIComm() { return comm; }
+  int setMPIComm(MPI_Comm _comm);
 
   // Set the topology (and determine the connectivity)
   // -------------------------------------------------
@@ -57,9 +58,11 @@ class TMRQuadForest : public TMREntity {
 
   // Set the connectivity directly
   // -----------------------------
-  void setConnectivity(int _num_nodes, const int *_face_conn, int _num_faces);
+  void setConnectivity(int _num_nodes, const int *_face_conn, int _num_faces,
+                       const TMRPoint *_node_pts = NULL);
   void setFullConnectivity(int _num_nodes, int _num_edges, int _num_faces,
-                           const int *_face_conn, const int *_face_edge_conn);
+                           const int *_face_conn, const int *_face_edge_conn,
+                           const TMRPoint *_node_pts = NULL);
 
   // Set/get the interpolation and order
   // -----------------------------------
@@ -68,9 +71,11 @@ class TMRQuadForest : public TMREntity {
   int getMeshOrder();
   TMRInterpolationType getInterpType();
 
-  // Re-partition the quadtrees based on element count
-  // -------------------------------------------------
-  void repartition();
+  // Re-partition the quadtrees based on element count or weight
+  // -----------------------------------------------------------
+  void repartition(const double weights[] = NULL);
+  void alignPartition(TMRQuadForest *forest);
+  void setPartitionTolerance(double tol);
 
   // Create the forest of quadtrees
   // ----------------------------
@@ -86,11 +91,17 @@ class TMRQuadForest : public TMREntity {
   // ---------------
   void refine(const int refinement[] = NULL, int min_level = 0,
               int max_level = TMR_MAX_LEVEL);
+  void refineToLevels(const int levels[], int balance_corner = 0);
 
   // Balance the quadtree meshes
   // -------------------------
   void balance(int balance_corner = 0);
 
+  // Set the number of threads used within each MPI process
+  // ------------------------------------------------------
+  void setNumThreads(int _num_threads);
+  int getNumThreads();
+
   // Create and order the nodes
   // --------------------------
   void createNodes();
@@ -105,6 +116,11 @@ class TMRQuadForest : public TMREntity {
   // Create interpolation/restriction operators
   // ------------------------------------------
   void createInterpolation(TMRQuadForest *coarse, TACSBVecInterp *interp);
+  void setCacheInterpolation(int _cache_interp);
+  int getCacheInterpolation();
+  int getInterpolationRows(TMRQuadForest *coarse, const int **_rows,
+                           const int **_ptr, const int **_vars,
+                           const double **_weights);
 
   // Get the nodes or elements with a certain name
   // ---------------------------------------------
@@ -121,12 +137,19 @@ class TMRQuadForest : public TMREntity {
   int getNodeNumbers(const int **_node_numbers);
   int getExtPreOffset();
   int getPoints(TMRPoint **_X);
+  int getPointComponents(const double **_x, const double **_y,
+                         const double **_z);
   int getLocalNodeNumber(int node);
   int getInterpKnots(const double **_knots);
   void evalInterp(const double pt[], double N[]);
   void evalInterp(const double pt[], double N[], double N1[], double N2[]);
   void evalInterp(const double pt[], double N[], double N1[], double N2[],
                   double N11[], double N22[], double N12[]);
+  void evalInterp(int npts, const double pts[], double N[]);
+  void evalInterp(int npts, const double pts[], double N[], double N1[],
+                  double N2[]);
+  int getInterpTable(int npts, const double pts[], const double **_N,
+                     const double **_N1 = NULL, const double **_N2 = NULL);
 
   // Retrieve the connectivity information
   // -------------------------------------
@@ -141,6 +164,9 @@ class TMRQuadForest : public TMREntity {
   // ------------------------------------------
   TMRQuadrant *findEnclosing(const int order, const double *knots,
                              TMRQuadrant *node, int *mpi_owner = NULL);
+  int findEnclosingStart(TMRQuadrant *node);
+  TMRQuadrant *findEnclosing(const int order, const double *knots,
+                             TMRQuadrant *node, int start, int *mpi_owner);
 
   // Distribute the quadrant array
   // -----------------------------
@@ -158,18 +184,57 @@ class TMRQuadForest : public TMREntity {
   void writeToVTK(const char *filename);
   void writeToTecplot(const char *filename);
   void writeForestToVTK(const char *filename);
+  int writeForestToVTU(const char *filename, int use_float32 = 1);
+
+  // Compute histograms of the element quality metrics (collective)
+  // ---------------------------------------------------------------
+  int computeMeshQuality(int nbins, int hist[], double min_quality[] = NULL);
+
+  // Write/read the forest to/from a binary checkpoint file
+  // ------------------------------------------------------
+  int writeForestToFile(const char *filename);
+  int readForestFromFile(const char *filename);
   void writeAdjacentToVTK(const char *filename);
 
+  // Get the memory used by the forest and its high-water mark
+  // ---------------------------------------------------------
+  void getMemoryUsage(TMRMemoryUsage *usage);
+  void getMaxMemoryUsage(TMRMemoryUsage *usage);
+  void resetMaxMemoryUsage();
+
  private:
   // Labels for the nodes
   static const int TMR_QUAD_NODE_LABEL = 0;
   static const int TMR_QUAD_EDGE_LABEL = 1;
   static const int TMR_QUAD_FACE_LABEL = 2;
 
+  // The maximum number of cached shape function tables
+  static const int MAX_INTERP_TABLES = 8;
+
+  // The maximum number of quadrants evaluated in one geometry call
+  static const int MAX_EVAL_BATCH_SIZE = 64;
+
+  // The alignment in bytes of the node location component arrays
+  static const int POINT_COMPONENT_ALIGNMENT = 64;
+
   // Free the internally stored data and zero things
   void freeData();
+  void freePointComponents();
+  void freeInterpTables();
+  void freeInterpCache();
   void freeMeshData(int free_quads = 1, int free_owners = 1);
   void copyData(TMRQuadForest *copy);
+  void freeNameIndex();
+
+  // Update the memory high-water mark with the transient hash table
+  // and node array sizes
+  void updateMaxMemoryUsage(long int hash_size = 0, long int node_size = 0);
+
+  // Compute the index from the entity names to the quadrants and nodes
+  void computeNameIds();
+  int getNameId(const char *name);
+  void computeQuadNameIndex();
+  void computeNodeNameIndex();
 
   // Set up the connectivity from nodes -> faces
   void computeNodesToFaces();
@@ -184,6 +249,9 @@ class TMRQuadForest : public TMREntity {
   // Get the quadrant owner
   int getQuadrantMPIOwner(TMRQuadrant *quad);
 
+  // Move the quadrants to a new partition
+  void redistributeQuadrants(const int *ptr, const int *new_ptr);
+
   // match the ownership intervals
   void matchQuadrantIntervals(TMRQuadrant *array, int size, int *ptr);
   void matchTagIntervals(TMRQuadrant *array, int size, int *ptr);
@@ -224,9 +292,19 @@ class TMRQuadForest : public TMREntity {
 
   // Create the global node ownership data
   TMRQuadrantArray *createLocalNodes();
+  void addElementNodes(int start, int end, TMRQuadrantHash *hash);
+  void addDependentNodes(int start, int end, TMRQuadrantHash *hash);
+
+  // Create the local nodes for a range of the local quadrants in a thread
+  static void *createNodesThread(void *args);
 
   // Create the local connectivity based on the input node array
   void createLocalConn(TMRQuadrantArray *nodes, const int *node_offset);
+  void addLocalConn(TMRQuadrantArray *nodes, const int *node_offset,
+                    int start, int end);
+
+  // Create the connectivity for a range of the local quadrants in a thread
+  static void *localConnThread(void *args);
 
   // Create the dependent node connectivity
   void createDependentConn(const int *node_nums, TMRQuadrantArray *nodes,
@@ -234,8 +312,12 @@ class TMRQuadForest : public TMREntity {
 
   // Compute the node locations
   void evaluateNodeLocations();
+  void evaluateDeferredNodeLocations();
+  const double *getInterpInverse();
 
   // Compute the element interpolation
+  void addInterpRow(TACSBVecInterp *interp, int row, double *wvals,
+                    int *vars, int nweights);
   int computeElemInterp(TMRQuadrant *node, TMRQuadForest *coarse,
                         TMRQuadrant *quad, TMRIndexWeight *weights,
                         double *tmp);
@@ -248,9 +330,19 @@ class TMRQuadForest : public TMREntity {
   MPI_Comm comm;
   int mpi_rank, mpi_size;
 
+  // The number of threads used within each MPI process
+  int num_threads;
+
   // Information about the type of interpolation
   TMRInterpolationType interp_type;
   double *interp_knots;
+  TMRInterpTable *interp_tables;
+  double *interp_inverse;
+
+  // Barycentric weights and kernels specialized for the mesh order
+  double interp_weights[MAX_ORDER];
+  TMRInterpKernel interp_kernel;
+  TMRInterpDerivKernel2D interp_deriv_kernel;
 
   // The owner quadrant ranges for each processor. Note that this is
   // in the quadrant space not the node space
@@ -286,10 +378,45 @@ class TMRQuadForest : public TMREntity {
   // The array of all the nodes
   TMRPoint *X;
 
+  // Flag indicating that the evaluation of X is deferred until the node
+  // locations are first requested
+  int deferred_node_locations;
+
+  // The x, y and z components of the nodes in separate aligned arrays,
+  // copied from X when they are first requested
+  double *Xcomp;
+
+  // A stamp, unique within the process, assigned by createNodes()
+  int node_stamp;
+
+  // The fraction of the partition size that the cuts of the partition
+  // may move to align with the quadtrees
+  double partition_tol;
+
+  // The interpolation rows recorded by createInterpolation(), along
+  // with the coarse forest and the node stamps they were built from
+  int cache_interp;
+  TMRQuadForest *interp_cache_coarse;
+  int interp_cache_stamps[2];
+  int interp_cache_nrows, interp_cache_max_rows, interp_cache_max_weights;
+  int *interp_cache_rows, *interp_cache_ptr, *interp_cache_vars;
+  double *interp_cache_weights;
+
+  // The memory high-water mark recorded by balance() and createNodes()
+  TMRMemoryUsage max_mem_usage;
+
   // The topology of the underlying model (if any)
   TMRTopology *topo;
 
-  // Class for the block connectivity
+  // For each name, the (quadrant index, info) pairs and the sorted
+  // node numbers that getQuadsWithName() and getNodesWithName() return
+  int *name_quad_ptr, *name_quad_list;
+  int *name_node_ptr, *name_node_list;
+
+  // Class for the face connectivity. This data depends only on the
+  // face topology and is not modified once it has been created, so a
+  // single reference-counted instance is shared by all the forests
+  // created by duplicate() and coarsen().
   class TMRFaceConn : public TMREntity {
    public:
     TMRFaceConn() {
@@ -307,6 +434,12 @@ class TMRQuadForest : public TMREntity {
       edge_face_conn = NULL;
       edge_face_owners = NULL;
       node_face_owners = NULL;
+      node_pts = NULL;
+
+      // The name index is created on demand
+      num_names = 0;
+      name_table = NULL;
+      vert_name_ids = edge_name_ids = face_name_ids = NULL;
     }
     ~TMRFaceConn() {
       // Free the connectivity data
@@ -336,6 +469,28 @@ class TMRQuadForest : public TMREntity {
       if (node_face_owners) {
         delete[] node_face_owners;
       }
+      if (node_pts) {
+        delete[] node_pts;
+      }
+
+      // Free the entity names
+      if (name_table) {
+        for (int i = 0; i < num_names; i++) {
+          if (name_table[i]) {
+            delete[] name_table[i];
+          }
+        }
+        delete[] name_table;
+      }
+      if (vert_name_ids) {
+        delete[] vert_name_ids;
+      }
+      if (edge_name_ids) {
+        delete[] edge_name_ids;
+      }
+      if (face_name_ids) {
+        delete[] face_name_ids;
+      }
     }
 
     // The following data is the same across all processors
@@ -350,6 +505,16 @@ class TMRQuadForest : public TMREntity {
 
     // Set the node/edge owners
     int *node_face_owners, *edge_face_owners;
+
+    // The locations of the nodes (NULL unless set with the connectivity)
+    TMRPoint *node_pts;
+
+    // The unique entity names and the name index of each vertex, edge
+    // and face. Index zero is reserved for entities without a name.
+    // These are computed from the topology on demand.
+    int num_names;
+    char **name_table;
+    int *vert_name_ids, *edge_name_ids, *face_name_ids;
   } * fdata;
 };
 
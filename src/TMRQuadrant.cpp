@@ -242,15 +242,138 @@ static int compare_nodes(const void *a, const void *b) {
   return ao->compareNode(bo);
 }
 
+/*
+  Arrays with fewer than this number of quadrants are sorted with qsort
+*/
+static const int TMR_MIN_RADIX_SORT_SIZE = 128;
+
+/*
+  The key used in the radix sort of the quadrants.
+
+  The key consists of 112 bits stored in two words, ordered from the
+  least to the most significant: the level (or the info when sorting
+  nodes), the 64-bit Morton code formed from the interleaved x/y bits
+  and the face. Each signed value has its sign bit flipped so that the
+  unsigned ordering of the key matches the ordering produced by
+  TMRQuadrant::compare() and TMRQuadrant::compareNode().
+*/
+class TMRQuadrantSortKey {
+ public:
+  uint64_t key[2];
+  int index;
+};
+
+/*
+  Spread the lower 32 bits of the input so that there is one zero bit
+  between each of the original bits
+*/
+static inline uint64_t spread_bits2(uint64_t u) {
+  u &= 0xffffffffULL;
+  u = (u | u << 16) & 0x0000ffff0000ffffULL;
+  u = (u | u << 8) & 0x00ff00ff00ff00ffULL;
+  u = (u | u << 4) & 0x0f0f0f0f0f0f0f0fULL;
+  u = (u | u << 2) & 0x3333333333333333ULL;
+  u = (u | u << 1) & 0x5555555555555555ULL;
+  return u;
+}
+
+/*
+  Sort the quadrants using a least-significant digit radix sort
+
+  The sort uses 8-bit digits. The histograms for all the digits are
+  computed in a single pass and the passes where all the keys share the
+  same digit are skipped. This is common since the high-order bits of
+  the Morton code and face index are often the same for all quadrants.
+
+  The sort is stable, so quadrants that compare equal remain in their
+  original relative order.
+*/
+static void radix_sort_quadrants(TMRQuadrant *array, int size,
+                                 int use_node_index) {
+  // The number of 8-bit digits in each word of the key
+  static const int num_words = 2;
+  static const int word_digits[num_words] = {8, 6};
+  static const int num_digits = 14;
+
+  TMRQuadrantSortKey *keys = new TMRQuadrantSortKey[size];
+  TMRQuadrantSortKey *temp = new TMRQuadrantSortKey[size];
+
+  // Compute the keys and the digit histograms
+  int *counts = new int[256 * num_digits];
+  memset(counts, 0, 256 * num_digits * sizeof(int));
+
+  for (int i = 0; i < size; i++) {
+    const uint32_t sign = 1U << 31;
+    uint32_t x = array[i].x ^ sign;
+    uint32_t y = array[i].y ^ sign;
+    uint16_t tie = (use_node_index ? array[i].info : array[i].level);
+    tie ^= 0x8000;
+
+    // Form the Morton code
+    uint64_t code = (spread_bits2(x) << 1) | spread_bits2(y);
+
+    keys[i].key[0] = tie | (code << 16);
+    keys[i].key[1] = (code >> 48) | ((uint64_t)(array[i].face ^ sign) << 16);
+    keys[i].index = i;
+
+    for (int j = 0, d = 0; j < num_words; j++) {
+      for (int k = 0; k < word_digits[j]; k++, d++) {
+        counts[256 * d + ((keys[i].key[j] >> (8 * k)) & 0xff)]++;
+      }
+    }
+  }
+
+  for (int j = 0, d = 0; j < num_words; j++) {
+    for (int k = 0; k < word_digits[j]; k++, d++) {
+      int *count = &counts[256 * d];
+
+      // Skip this pass if all the keys share the same digit
+      if (count[(keys[0].key[j] >> (8 * k)) & 0xff] == size) {
+        continue;
+      }
+
+      // Convert the counts to offsets
+      for (int b = 0, offset = 0; b < 256; b++) {
+        int tmp = count[b];
+        count[b] = offset;
+        offset += tmp;
+      }
+
+      // Scatter the keys based on the current digit
+      for (int i = 0; i < size; i++) {
+        int b = (keys[i].key[j] >> (8 * k)) & 0xff;
+        temp[count[b]] = keys[i];
+        count[b]++;
+      }
+
+      TMRQuadrantSortKey *t = keys;
+      keys = temp;
+      temp = t;
+    }
+  }
+
+  // Permute the quadrants into the sorted order
+  TMRQuadrant *sorted = new TMRQuadrant[size];
+  for (int i = 0; i < size; i++) {
+    sorted[i] = array[keys[i].index];
+  }
+  memcpy(array, sorted, size * sizeof(TMRQuadrant));
+
+  delete[] sorted;
+  delete[] counts;
+  delete[] keys;
+  delete[] temp;
+}
+
 /*
   Store a array of quadrants
 */
 TMRQuadrantArray::TMRQuadrantArray(TMRQuadrant *_array, int _size,
-                                   int _use_node_index) {
+                                   int _use_node_index, int _is_sorted) {
   array = _array;
   size = _size;
   max_size = size;
-  is_sorted = 0;
+  is_sorted = _is_sorted;
   use_node_index = _use_node_index;
 }
 
@@ -259,6 +382,13 @@ TMRQuadrantArray::TMRQuadrantArray(TMRQuadrant *_array, int _size,
 */
 TMRQuadrantArray::~TMRQuadrantArray() { delete[] array; }
 
+/*
+  Get the number of bytes allocated for the quadrant array
+*/
+size_t TMRQuadrantArray::getMemoryUsage() {
+  return max_size * sizeof(TMRQuadrant);
+}
+
 /*
   Duplicate the array and return the copy
 */
@@ -277,9 +407,15 @@ TMRQuadrantArray *TMRQuadrantArray::duplicate() {
   entries.
 */
 void TMRQuadrantArray::sort() {
-  if (use_node_index) {
+  if (size >= TMR_MIN_RADIX_SORT_SIZE) {
+    radix_sort_quadrants(array, size, use_node_index);
+  } else if (use_node_index) {
     qsort(array, size, sizeof(TMRQuadrant), compare_nodes);
+  } else {
+    qsort(array, size, sizeof(TMRQuadrant), compare_quadrants);
+  }
 
+  if (use_node_index) {
     // Now that the Quadrants are sorted, remove duplicates
     int i = 0;  // Location from which to take entries
     int j = 0;  // Location to place entries
@@ -297,8 +433,6 @@ void TMRQuadrantArray::sort() {
     // The new size of the array
     size = j;
   } else {
-    qsort(array, size, sizeof(TMRQuadrant), compare_quadrants);
-
     // Now that the Quadrants are sorted, remove duplicates
     int i = 0;  // Location from which to take entries
     int j = 0;  // Location to place entries
@@ -435,21 +569,16 @@ void TMRQuadrantArray::getArray(TMRQuadrant **_array, int *_size) {
   Create an queue of quadrants
 */
 TMRQuadrantQueue::TMRQuadrantQueue() {
-  root = tip = NULL;
   num_elems = 0;
+  start = 0;
+  max_elems = min_queue_size;
+  array = new TMRQuadrant[max_elems];
 }
 
 /*
   Free the queue
 */
-TMRQuadrantQueue::~TMRQuadrantQueue() {
-  QuadQueueNode *node = root;
-  while (node) {
-    QuadQueueNode *tmp = node;
-    node = node->next;
-    delete tmp;
-  }
-}
+TMRQuadrantQueue::~TMRQuadrantQueue() { delete[] array; }
 
 /*
   Get the length of the quadrant queue
@@ -460,15 +589,26 @@ int TMRQuadrantQueue::length() { return num_elems; }
   Push a value onto the quadrant queue
 */
 void TMRQuadrantQueue::push(TMRQuadrant *quad) {
-  if (!tip) {
-    root = new QuadQueueNode();
-    root->quad = *quad;
-    tip = root;
-  } else {
-    tip->next = new QuadQueueNode();
-    tip->next->quad = *quad;
-    tip = tip->next;
-  }
+  if (num_elems >= max_elems) {
+    // Double the size of the buffer and unwrap the quadrants so that
+    // the first element in the queue is at the start of the array
+    int new_max_elems = 2 * max_elems;
+    TMRQuadrant *temp = new TMRQuadrant[new_max_elems];
+    int len = max_elems - start;
+    memcpy(temp, &array[start], len * sizeof(TMRQuadrant));
+    memcpy(&temp[len], array, start * sizeof(TMRQuadrant));
+    delete[] array;
+
+    array = temp;
+    max_elems = new_max_elems;
+    start = 0;
+  }
+
+  int index = start + num_elems;
+  if (index >= max_elems) {
+    index -= max_elems;
+  }
+  array[index] = *quad;
   num_elems++;
 }
 
@@ -476,16 +616,14 @@ void TMRQuadrantQueue::push(TMRQuadrant *quad) {
   Pop a value from the quadrant queue
 */
 TMRQuadrant TMRQuadrantQueue::pop() {
-  if (!root) {
+  if (num_elems == 0) {
     return TMRQuadrant();
   } else {
+    TMRQuadrant temp = array[start];
     num_elems--;
-    TMRQuadrant temp = root->quad;
-    QuadQueueNode *tmp = root;
-    root = root->next;
-    delete tmp;
-    if (num_elems == 0) {
-      tip = NULL;
+    start++;
+    if (start >= max_elems || num_elems == 0) {
+      start = 0;
     }
     return temp;
   }
@@ -496,19 +634,18 @@ TMRQuadrant TMRQuadrantQueue::pop() {
 */
 TMRQuadrantArray *TMRQuadrantQueue::toArray() {
   // Allocate the array
-  TMRQuadrant *array = new TMRQuadrant[num_elems];
+  TMRQuadrant *list_array = new TMRQuadrant[num_elems];
 
-  // Scan through the queue and retrieve the quadrants
-  QuadQueueNode *node = root;
-  int index = 0;
-  while (node) {
-    array[index] = node->quad;
-    node = node->next;
-    index++;
+  // Copy the quadrants from the ring buffer in at most two pieces
+  int len = max_elems - start;
+  if (len > num_elems) {
+    len = num_elems;
   }
+  memcpy(list_array, &array[start], len * sizeof(TMRQuadrant));
+  memcpy(&list_array[len], array, (num_elems - len) * sizeof(TMRQuadrant));
 
   // Create the array object
-  TMRQuadrantArray *list = new TMRQuadrantArray(array, num_elems);
+  TMRQuadrantArray *list = new TMRQuadrantArray(list_array, num_elems);
   return list;
 }
 
@@ -517,32 +654,39 @@ TMRQuadrantArray *TMRQuadrantQueue::toArray() {
 
   Note that this isn't a true hash table since it does not associate
   elements with other values. It is used to create unique lists of
-  elements and nodes within the quadree mesh.
+  elements and nodes within the quadtree mesh.
 */
 TMRQuadrantHash::TMRQuadrantHash(int _use_node_index) {
   use_node_index = _use_node_index;
+  num_slots = min_num_slots;
+  slots = new int[num_slots];
+  memset(slots, 0xff, num_slots * sizeof(int));
+
+  // Allocate space for the quadrants themselves. The load factor of
+  // the table never exceeds 1/2.
   num_elems = 0;
-  num_buckets = min_num_buckets;
-  hash_buckets = new QuadHashNode *[num_buckets];
-  memset(hash_buckets, 0, num_buckets * sizeof(QuadHashNode *));
+  max_elems = num_slots / 2;
+  array = new TMRQuadrant[max_elems];
 }
 
 /*
   Free the memory allocated by the quadrant hash
 */
 TMRQuadrantHash::~TMRQuadrantHash() {
-  // Free all the elements in the hash
-  for (int i = 0; i < num_buckets; i++) {
-    QuadHashNode *node = hash_buckets[i];
-    while (node) {
-      // Delete the old guy
-      QuadHashNode *tmp = node;
-      node = node->next;
-      delete tmp;
-    }
-  }
+  delete[] slots;
+  delete[] array;
+}
 
-  delete[] hash_buckets;
+/*
+  Get the number of quadrants in the hash table
+*/
+int TMRQuadrantHash::length() { return num_elems; }
+
+/*
+  Get the number of bytes allocated for the slots and quadrants
+*/
+size_t TMRQuadrantHash::getMemoryUsage() {
+  return num_slots * sizeof(int) + max_elems * sizeof(TMRQuadrant);
 }
 
 /*
@@ -550,24 +694,12 @@ TMRQuadrantHash::~TMRQuadrantHash() {
 */
 TMRQuadrantArray *TMRQuadrantHash::toArray() {
   // Create an array of quadrants
-  TMRQuadrant *array = new TMRQuadrant[num_elems];
-
-  // Loop over all the buckets
-  for (int i = 0, index = 0; i < num_buckets; i++) {
-    // Get the hash bucket and extract all the elements from this
-    // bucket into the array
-    QuadHashNode *node = hash_buckets[i];
-
-    while (node) {
-      array[index] = node->quad;
-      index++;
-      node = node->next;
-    }
-  }
+  TMRQuadrant *list_array = new TMRQuadrant[num_elems];
+  memcpy(list_array, array, num_elems * sizeof(TMRQuadrant));
 
   // Create an array object and add it to the list
   TMRQuadrantArray *list =
-      new TMRQuadrantArray(array, num_elems, use_node_index);
+      new TMRQuadrantArray(list_array, num_elems, use_node_index);
   return list;
 }
 
@@ -585,130 +717,85 @@ TMRQuadrantArray *TMRQuadrantHash::toArray() {
   true if the quadrant is added, false if it is not
 */
 int TMRQuadrantHash::addQuadrant(TMRQuadrant *quad) {
-  if (num_elems > 10 * num_buckets) {
-    // Redistribute the quadrants to new buckets
-    int num_old_buckets = num_buckets;
-    num_buckets = 2 * num_buckets;
-    QuadHashNode **new_buckets = new QuadHashNode *[num_buckets];
-    memset(new_buckets, 0, num_buckets * sizeof(QuadHashNode *));
-
-    // Keep track of the end bucket
-    QuadHashNode **end_buckets = new QuadHashNode *[num_buckets];
-
-    // Redistribute the quadrant nodes based on the new
-    // number of buckets within the hash data structure
-    for (int i = 0; i < num_old_buckets; i++) {
-      QuadHashNode *node = hash_buckets[i];
-      while (node) {
-        int bucket = getBucket(&(node->quad));
-
-        // If this is the first new bucket, create
-        // the new node
-        if (!new_buckets[bucket]) {
-          new_buckets[bucket] = new QuadHashNode;
-          new_buckets[bucket]->quad = node->quad;
-          end_buckets[bucket] = new_buckets[bucket];
-        } else {
-          end_buckets[bucket]->next = new QuadHashNode;
-          end_buckets[bucket]->next->quad = node->quad;
-          end_buckets[bucket] = end_buckets[bucket]->next;
-        }
-
-        // Delete the old guy
-        QuadHashNode *tmp = node;
-
-        // Increment the node to the next hash
-        node = node->next;
-
-        // Free the node
-        delete tmp;
+  const int mask = num_slots - 1;
+  int slot = getSlot(quad);
+
+  // Probe the table until either the quadrant or an empty slot is found
+  if (use_node_index) {
+    while (slots[slot] >= 0) {
+      if (array[slots[slot]].compareNode(quad) == 0) {
+        return 0;
       }
+      slot = (slot + 1) & mask;
     }
-
-    delete[] end_buckets;
-    delete[] hash_buckets;
-    hash_buckets = new_buckets;
-  }
-
-  int bucket = getBucket(quad);
-
-  // If no quadrant has been added to the bucket,
-  // create a new bucket
-  if (!hash_buckets[bucket]) {
-    hash_buckets[bucket] = new QuadHashNode;
-    hash_buckets[bucket]->quad = *quad;
-    num_elems++;
-    return 1;
   } else {
-    // Get the head node for the corresponding bucket
-    QuadHashNode *node = hash_buckets[bucket];
-    if (use_node_index) {
-      // Search the bucket to see if there's another node in the list
-      while (node) {
-        if (node->quad.compareNode(quad) == 0) {
-          return 0;
-        }
-
-        // If the next node does not exist, quit while node
-        // is the last node in the linked list
-        if (!node->next) {
-          break;
-        }
-        node = node->next;
-      }
-    } else {
-      // Perform the same search, except using quads
-      while (node) {
-        if (node->quad.compare(quad) == 0) {
-          return 0;
-        }
-
-        if (!node->next) {
-          break;
-        }
-        node = node->next;
+    while (slots[slot] >= 0) {
+      if (array[slots[slot]].compare(quad) == 0) {
+        return 0;
       }
+      slot = (slot + 1) & mask;
     }
+  }
+
+  // Extend the quadrant array if required
+  if (num_elems >= max_elems) {
+    max_elems = 2 * max_elems;
+    TMRQuadrant *temp = new TMRQuadrant[max_elems];
+    memcpy(temp, array, num_elems * sizeof(TMRQuadrant));
+    delete[] array;
+    array = temp;
+  }
+
+  // Add the quadrant to the end of the array
+  array[num_elems] = *quad;
+  slots[slot] = num_elems;
+  num_elems++;
 
-    // Add the quadrant as the last node
-    node->next = new QuadHashNode;
-    node->next->quad = *quad;
-    num_elems++;
+  // Keep the load factor below 1/2
+  if (2 * num_elems > num_slots) {
+    resize();
   }
 
   return 1;
 }
 
 /*
-  Get a bucket to place the quadrant in.
-
-  This code creates a value based on the quadrant location within the
-  mesh and then takes the remainder of the number of buckets.
+  Double the number of slots within the table and re-insert all of the
+  quadrants. The quadrants are already unique so no comparisons are
+  required.
 */
-int TMRQuadrantHash::getBucket(TMRQuadrant *quad) {
-  // The hash value
-  uint32_t val = 0;
-
-  if (use_node_index) {
-    uint32_t u = 0, v = 0, w = 0;
-    u = quad->face;
-    v = (1 << TMR_MAX_LEVEL) + quad->x;
-    w = (1 << TMR_MAX_LEVEL) + quad->y;
+void TMRQuadrantHash::resize() {
+  delete[] slots;
+  num_slots = 2 * num_slots;
+  slots = new int[num_slots];
+  memset(slots, 0xff, num_slots * sizeof(int));
+
+  const int mask = num_slots - 1;
+  for (int i = 0; i < num_elems; i++) {
+    int slot = getSlot(&array[i]);
+    while (slots[slot] >= 0) {
+      slot = (slot + 1) & mask;
+    }
+    slots[slot] = i;
+  }
+}
 
-    // Compute the hash value
-    val = TMRIntegerTripletHash(u, v, w);
-  } else {
-    uint32_t u = 0, v = 0, w = 0;
-    u = quad->face;
-    v = (1 << TMR_MAX_LEVEL) + quad->x;
-    w = (1 << TMR_MAX_LEVEL) + quad->y;
+/*
+  Get the initial slot for the quadrant.
 
-    // Compute the hash value
-    val = TMRIntegerTripletHash(u, v, w);
-  }
+  This code creates a value based on the quadrant location within the
+  mesh and then masks off the bits beyond the number of slots. The
+  level and info are not included, so quadrants that share a position
+  are resolved by probing.
+*/
+int TMRQuadrantHash::getSlot(TMRQuadrant *quad) {
+  uint32_t u = 0, v = 0, w = 0;
+  u = quad->face;
+  v = (1 << TMR_MAX_LEVEL) + quad->x;
+  w = (1 << TMR_MAX_LEVEL) + quad->y;
 
-  // Compute the bucket value
-  int bucket = val % num_buckets;
+  // Compute the hash value
+  uint32_t val = TMRIntegerTripletHash(u, v, w);
 
-  return bucket;
+  return val & (num_slots - 1);
 }
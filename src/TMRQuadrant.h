@@ -57,11 +57,13 @@ class TMRQuadrant {
   quadrants with a smaller level (that have larger side lengths).  After
   the array is sorted, it is searchable either based on elements (when
   use_nodes=0) or by node (use_nodes=1). The difference is that the
-  node search ignores the mesh level.
+  node search ignores the mesh level. An array that is already sorted
+  and unique may be flagged as sorted on construction.
 */
 class TMRQuadrantArray {
  public:
-  TMRQuadrantArray(TMRQuadrant *array, int size, int _use_node_index = 0);
+  TMRQuadrantArray(TMRQuadrant *array, int size, int _use_node_index = 0,
+                   int _is_sorted = 0);
   ~TMRQuadrantArray();
 
   TMRQuadrantArray *duplicate();
@@ -69,6 +71,7 @@ class TMRQuadrantArray {
   void sort();
   TMRQuadrant *contains(TMRQuadrant *q, const int use_position = 0);
   void merge(TMRQuadrantArray *list);
+  size_t getMemoryUsage();
 
  private:
   int use_node_index;
@@ -81,7 +84,9 @@ class TMRQuadrantArray {
   Create a queue of quadrants
 
   This class defines a queue of quadrants that are used for the balance
-  and coarsen operations.
+  and coarsen operations. The quadrants are stored in a single ring
+  buffer, so push() and pop() do not allocate memory except when the
+  buffer must grow.
 */
 class TMRQuadrantQueue {
  public:
@@ -94,17 +99,14 @@ class TMRQuadrantQueue {
   TMRQuadrantArray *toArray();
 
  private:
-  // Class that defines an element within the queue
-  class QuadQueueNode {
-   public:
-    QuadQueueNode() { next = NULL; }
-    TMRQuadrant quad;
-    QuadQueueNode *next;
-  };
-
-  // Keep track of the number of elements in the queue
-  int num_elems;
-  QuadQueueNode *root, *tip;
+  // The initial capacity of the queue
+  static const int min_queue_size = 1 << 10;
+
+  // The quadrants are stored in a contiguous ring buffer. The first
+  // element in the queue is stored at array[start] and the buffer
+  // is doubled in size when it fills up.
+  int num_elems, max_elems, start;
+  TMRQuadrant *array;
 };
 
 /*
@@ -113,6 +115,10 @@ class TMRQuadrantQueue {
   This object enables the creation of a unique set of quadrants such
   that no two have the same position/level combination. This hash
   table can then be made into an array of unique elements or nodes.
+
+  The quadrants are stored in a single contiguous array and the table
+  itself uses open addressing with linear probing, so no memory is
+  allocated per quadrant.
 */
 class TMRQuadrantHash {
  public:
@@ -121,30 +127,30 @@ class TMRQuadrantHash {
 
   TMRQuadrantArray *toArray();
   int addQuadrant(TMRQuadrant *quad);
+  int length();
+  size_t getMemoryUsage();
 
  private:
-  // The minimum bucket size
-  static const int min_num_buckets = (1 << 12) - 1;
-
-  class QuadHashNode {
-   public:
-    QuadHashNode() { next = NULL; }
-    TMRQuadrant quad;
-    QuadHashNode *next;
-  };
+  // The minimum number of slots in the table (must be a power of 2)
+  static const int min_num_slots = 1 << 12;
 
   // Set the element index/node
   int use_node_index;
 
-  // Keep track of the bucket size
-  int num_buckets;
-  QuadHashNode **hash_buckets;
+  // The open-addressing table. Each slot stores the index of a
+  // quadrant within the contiguous quadrant array, or -1 if empty.
+  int num_slots;
+  int *slots;
+
+  // The unique quadrants, stored contiguously in the order they were added
+  int num_elems, max_elems;
+  TMRQuadrant *array;
 
-  // Keep track of the number of elements
-  int num_elems;
+  // Get the initial slot for the quadrant
+  int getSlot(TMRQuadrant *quad);
 
-  // Get the buckets to place the quadrant in
-  int getBucket(TMRQuadrant *quad);
+  // Double the number of slots and re-insert all the quadrants
+  void resize();
 };
 
 #endif  // TMR_QUADRANT_H
@@ -145,6 +145,19 @@ TMREdge::~TMREdge() {
   }
 }
 
+/*
+  Evaluate the edge at an array of parametric locations
+*/
+int TMREdge::evalPoints(int n, const double *t, TMRPoint *X) {
+  int fail = 0;
+  for (int i = 0; i < n; i++) {
+    if (evalPoint(t[i], &X[i])) {
+      fail = 1;
+    }
+  }
+  return fail;
+}
+
 /*
   Perform the inverse evaluation
 */
@@ -645,6 +658,32 @@ int TMRFace::invEvalPoint(TMRPoint p, double *u, double *v) {
   return fail;
 }
 
+/*
+  Evaluate the points at an array of parametric locations
+*/
+int TMRFace::evalPoints(int n, const double *prm, TMRPoint *X) {
+  int fail = 0;
+  for (int i = 0; i < n; i++) {
+    if (evalPoint(prm[2 * i], prm[2 * i + 1], &X[i])) {
+      fail = 1;
+    }
+  }
+  return fail;
+}
+
+/*
+  Perform the inverse evaluation for an array of points
+*/
+int TMRFace::invEvalPoints(int n, const TMRPoint *X, double *prm) {
+  int fail = 0;
+  for (int i = 0; i < n; i++) {
+    if (invEvalPoint(X[i], &prm[2 * i], &prm[2 * i + 1])) {
+      fail = 1;
+    }
+  }
+  return fail;
+}
+
 /*
   Add the curves that bound the surface
 */
@@ -945,6 +984,19 @@ int TMRVolume::evalPoint(double u, double v, double w, TMRPoint *X) {
   return 1;
 }
 
+/*
+  Evaluate the points at an array of parametric locations
+*/
+int TMRVolume::evalPoints(int n, const double *prm, TMRPoint *X) {
+  int fail = 0;
+  for (int i = 0; i < n; i++) {
+    if (evalPoint(prm[3 * i], prm[3 * i + 1], prm[3 * i + 2], &X[i])) {
+      fail = 1;
+    }
+  }
+  return fail;
+}
+
 /*
   Get the faces that enclose this volume
 */
@@ -1049,6 +1101,9 @@ TMRModel::TMRModel(int _num_vertices, TMRVertex **_vertices, int _num_edges,
   ordered_edges = NULL;
   ordered_faces = NULL;
   ordered_volumes = NULL;
+  vertex_keys = NULL;
+  edge_keys = NULL;
+  face_keys = NULL;
   initialize(_num_vertices, _vertices, _num_edges, _edges, _num_faces, _faces,
              _num_volumes, _volumes);
 
@@ -1241,6 +1296,20 @@ void TMRModel::initialize(int _num_vertices, TMRVertex **_vertices,
         compare_ordered_pairs<TMRFace>);
   qsort(ordered_volumes, num_volumes, sizeof(OrderedPair<TMRVolume>),
         compare_ordered_pairs<TMRVolume>);
+
+  // Sort the entities by their hash keys
+  if (vertex_keys) {
+    delete[] vertex_keys;
+  }
+  if (edge_keys) {
+    delete[] edge_keys;
+  }
+  if (face_keys) {
+    delete[] face_keys;
+  }
+  vertex_keys = create_key_pairs(num_vertices, vertices);
+  edge_keys = create_key_pairs(num_edges, edges);
+  face_keys = create_key_pairs(num_faces, faces);
 }
 
 /*
@@ -1275,6 +1344,9 @@ TMRModel::~TMRModel() {
   delete[] ordered_edges;
   delete[] ordered_faces;
   delete[] ordered_volumes;
+  delete[] vertex_keys;
+  delete[] edge_keys;
+  delete[] face_keys;
 }
 
 /*
@@ -1546,6 +1618,89 @@ int TMRModel::getVolumeIndex(TMRVolume *volume) {
   return -1;
 }
 
+/*
+  Static member function for sorting the hash keys
+*/
+int TMRModel::compare_key_pairs(const void *avoid, const void *bvoid) {
+  const KeyPair *a = static_cast<const KeyPair *>(avoid);
+  const KeyPair *b = static_cast<const KeyPair *>(bvoid);
+
+  if (a->key < b->key) {
+    return -1;
+  } else if (a->key > b->key) {
+    return 1;
+  }
+  return a->num - b->num;
+}
+
+/*
+  Create the array of hash keys sorted by key value
+*/
+template <class ctype>
+TMRModel::KeyPair *TMRModel::create_key_pairs(int num, ctype **objs) {
+  KeyPair *keys = new KeyPair[num];
+  for (int i = 0; i < num; i++) {
+    keys[i].key = (objs[i] ? objs[i]->getHashKey() : 0);
+    keys[i].num = i;
+  }
+  qsort(keys, num, sizeof(KeyPair), compare_key_pairs);
+  return keys;
+}
+
+/*
+  Find the index of the object that is the same as the given object.
+  Only the objects with the same hash key are compared with isSame.
+*/
+template <class ctype>
+int TMRModel::find_key_index(int num, const KeyPair *keys, ctype **objs,
+                             ctype *obj) {
+  if (!obj) {
+    return -1;
+  }
+  uint32_t key = obj->getHashKey();
+
+  // Find the first entry with the given key
+  int low = 0, high = num;
+  while (low < high) {
+    int mid = low + (high - low) / 2;
+    if (keys[mid].key < key) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  for (int i = low; i < num && keys[i].key == key; i++) {
+    ctype *item = objs[keys[i].num];
+    if (item && (item == obj || item->isSame(obj))) {
+      return keys[i].num;
+    }
+  }
+
+  return -1;
+}
+
+/*
+  Find the index of the vertex that is the same as the given vertex
+*/
+int TMRModel::findVertexIndex(TMRVertex *vertex) {
+  return find_key_index(num_vertices, vertex_keys, vertices, vertex);
+}
+
+/*
+  Find the index of the edge that is the same as the given edge
+*/
+int TMRModel::findEdgeIndex(TMREdge *edge) {
+  return find_key_index(num_edges, edge_keys, edges, edge);
+}
+
+/*
+  Find the index of the face that is the same as the given face
+*/
+int TMRModel::findFaceIndex(TMRFace *face) {
+  return find_key_index(num_faces, face_keys, faces, face);
+}
+
 /*
   The main topology class that contains the objects used to build the
   underlying mesh.
@@ -1970,6 +2125,12 @@ void TMRTopology::computeConnectivty(int num_entities, int num_edges,
   int *face_to_face_ptr = new int[num_faces + 1];
   int *face_to_face = new int[max_face_to_face_size];
 
+  // Mark the faces already added to the list for face i
+  int *face_marker = new int[num_faces];
+  for (int i = 0; i < num_faces; i++) {
+    face_marker[i] = -1;
+  }
+
   face_to_face_ptr[0] = 0;
   for (int i = 0; i < num_faces; i++) {
     face_to_face_ptr[i + 1] = face_to_face_ptr[i];
@@ -1978,24 +2139,16 @@ void TMRTopology::computeConnectivty(int num_entities, int num_edges,
       if (e >= 0) {
         for (int kp = edge_to_face_ptr[e]; kp < edge_to_face_ptr[e + 1]; kp++) {
           int f = edge_to_face[kp];
-          if (i != f) {
-            int add_me = 1;
-            for (int k = face_to_face_ptr[i]; k < face_to_face_ptr[i + 1];
-                 k++) {
-              if (face_to_face[k] == f) {
-                add_me = 0;
-                break;
-              }
-            }
-            if (add_me) {
-              face_to_face[face_to_face_ptr[i + 1]] = f;
-              face_to_face_ptr[i + 1]++;
-            }
+          if (i != f && face_marker[f] != i) {
+            face_marker[f] = i;
+            face_to_face[face_to_face_ptr[i + 1]] = f;
+            face_to_face_ptr[i + 1]++;
           }
         }
       }
     }
   }
+  delete[] face_marker;
 
   delete[] edge_to_face_ptr;
   delete[] edge_to_face;
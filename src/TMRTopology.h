@@ -32,6 +32,7 @@
 
 #include "TMRBase.h"
 #include "TMRGeometry.h"
+#include "TMRHashFunction.h"
 
 class TMREdge;
 class TMRFace;
@@ -59,6 +60,10 @@ class TMRVertex : public TMREntity {
   // Is this the same underlying vertex
   virtual int isSame(TMRVertex *vert) { return this == vert; }
 
+  // Hash key for the underlying entity. Entities created from the
+  // same underlying CAD entity return the same key.
+  virtual uint32_t getHashKey() { return TMRPointerHash(this); }
+
   // Set the node number to copy from
   void setCopySource(TMRVertex *vert);
   void getCopySource(TMRVertex **vert);
@@ -87,6 +92,10 @@ class TMREdge : public TMREntity {
   // Given the parametric point, compute the x,y,z location
   virtual int evalPoint(double t, TMRPoint *X) = 0;
 
+  // Evaluate an array of n points. The default implementation loops
+  // over the points.
+  virtual int evalPoints(int n, const double *t, TMRPoint *X);
+
   // Perform the inverse evaluation
   virtual int invEvalPoint(TMRPoint p, double *t);
 
@@ -103,6 +112,10 @@ class TMREdge : public TMREntity {
   // Is this the same underlying edge?
   virtual int isSame(TMREdge *edge) { return this == edge; }
 
+  // Hash key for the underlying entity. Entities created from the
+  // same underlying CAD entity return the same key.
+  virtual uint32_t getHashKey() { return TMRPointerHash(this); }
+
   // Is this edge degenerate
   virtual int isDegenerate() { return 0; }
 
@@ -183,6 +196,11 @@ class TMRFace : public TMREntity {
   // Perform the inverse evaluation
   virtual int invEvalPoint(TMRPoint p, double *u, double *v);
 
+  // Evaluate or invert an array of n points with interleaved (u, v)
+  // parameters. The default implementations loop over the points.
+  virtual int evalPoints(int n, const double *prm, TMRPoint *X);
+  virtual int invEvalPoints(int n, const TMRPoint *X, double *prm);
+
   // Given the parametric point, evaluate the first derivative
   virtual int evalDeriv(double u, double v, TMRPoint *X, TMRPoint *Xu,
                         TMRPoint *Xv);
@@ -195,6 +213,10 @@ class TMRFace : public TMREntity {
   // Is this the same underlying face?
   virtual int isSame(TMRFace *face) { return this == face; }
 
+  // Hash key for the underlying entity. Entities created from the
+  // same underlying CAD entity return the same key.
+  virtual uint32_t getHashKey() { return TMRPointerHash(this); }
+
   // Add an edge loop to the face
   int getNumEdgeLoops();
   void addEdgeLoop(int loop_dir, TMREdgeLoop *loop);
@@ -260,6 +282,10 @@ class TMRVolume : public TMREntity {
   // Given the parametric point u,v,w compute the physical location x,y,z
   virtual int evalPoint(double u, double v, double w, TMRPoint *X);
 
+  // Evaluate an array of n points with interleaved (u, v, w)
+  // parameters. The default implementation loops over the points.
+  virtual int evalPoints(int n, const double *prm, TMRPoint *X);
+
   // Get the faces that enclose this volume
   void getFaces(int *_num_faces, TMRFace ***_faces);
 
@@ -304,6 +330,12 @@ class TMRModel : public TMREntity {
   int getFaceIndex(TMRFace *face);
   int getVolumeIndex(TMRVolume *volume);
 
+  // Find the index of the entity that is the same as the given entity
+  // based on the hash key. Returns -1 if no such entity exists.
+  int findVertexIndex(TMRVertex *vertex);
+  int findEdgeIndex(TMREdge *edge);
+  int findFaceIndex(TMRFace *face);
+
  private:
   // Initialize the model
   void initialize(int _num_vertices, TMRVertex **_vertices, int _num_edges,
@@ -337,6 +369,24 @@ class TMRModel : public TMREntity {
   OrderedPair<TMREdge> *ordered_edges;
   OrderedPair<TMRFace> *ordered_faces;
   OrderedPair<TMRVolume> *ordered_volumes;
+
+  // Entities sorted by their hash keys for the equivalence lookups
+  class KeyPair {
+   public:
+    uint32_t key;
+    int num;
+  };
+
+  static int compare_key_pairs(const void *avoid, const void *bvoid);
+  template <class ctype>
+  static KeyPair *create_key_pairs(int num, ctype **objs);
+  template <class ctype>
+  static int find_key_index(int num, const KeyPair *keys, ctype **objs,
+                            ctype *obj);
+
+  KeyPair *vertex_keys;
+  KeyPair *edge_keys;
+  KeyPair *face_keys;
 };
 
 /*
@@ -22,6 +22,7 @@
 
 #include <limits.h>
 #include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 
 #include "TMRHashFunction.h"
@@ -169,277 +170,308 @@ class TriQueue {
 };
 
 /*
-  The following class implments a simple quadtree data structure for fast
-  geometric searching queries.
+  Create the spatial index of the points over the given bounding box.
+
+  The size hint is the expected number of points and sets the initial
+  number of buckets. Points may lie outside the bounding box.
 */
-TMRQuadNode::TMRQuadNode(TMRQuadDomain *_domain) {
-  initialize(_domain, 0, 0, 0);
+TMRPointIndex::TMRPointIndex(double _xlow, double _xhigh, double _ylow,
+                             double _yhigh, int size_hint) {
+  xlow = _xlow;
+  xhigh = _xhigh;
+  ylow = _ylow;
+  yhigh = _yhigh;
+
+  // Guard against a degenerate bounding box
+  double w = xhigh - xlow, h = yhigh - ylow;
+  if (w <= 0.0 && h <= 0.0) {
+    w = h = 1.0;
+  } else if (w <= 0.0) {
+    w = 1e-3 * h;
+  } else if (h <= 0.0) {
+    h = 1e-3 * w;
+  }
+  xhigh = xlow + w;
+  yhigh = ylow + h;
+
+  nx = ny = 0;
+  head = NULL;
+  num_grid_points = 0;
+
+  max_num = 0;
+  next = NULL;
+  bucket = NULL;
+  xy = NULL;
+
+  if (size_hint < 1) {
+    size_hint = 1;
+  }
+  resize(size_hint / POINTS_PER_BUCKET + 1);
 }
 
 /*
-  Create a child node
+  Free the spatial index
 */
-TMRQuadNode::TMRQuadNode(TMRQuadDomain *_domain, uint32_t _u, uint32_t _v,
-                         int _level) {
-  initialize(_domain, _u, _v, _level);
+TMRPointIndex::~TMRPointIndex() {
+  delete[] head;
+  if (next) {
+    delete[] next;
+    delete[] bucket;
+    delete[] xy;
+  }
 }
 
 /*
-  Initialize the data for the quadtree root/node/leaf
+  Get the bucket containing the point, or -1 if the point lies outside
+  the bounding box of the grid
 */
-void TMRQuadNode::initialize(TMRQuadDomain *_domain, uint32_t _u, uint32_t _v,
-                             int _level) {
-  // Set the domain
-  domain = _domain;
-
-  // Set the level of this quadndoe
-  level = _level;
-
-  // Set the domain level
-  u = _u;
-  v = _v;
-
-  // Set the maximum length in parameter space for
-  // the domain
-  const uint32_t hmax = 1 << MAX_DEPTH;
-  const uint32_t h = 1 << (MAX_DEPTH - level - 1);
-
-  // Compute the distance along each edge for this node
-  // within the quadtree
-  double ax = 1.0 * (u + h) / hmax;
-  double ay = 1.0 * (v + h) / hmax;
-
-  // Set the new planes that spatially divide this node
-  x = (1.0 - ax) * domain->xlow + ax * domain->xhigh;
-  y = (1.0 - ay) * domain->ylow + ay * domain->yhigh;
-
-  // Set the pointers to the different children (all to NULL for now)
-  low_left = NULL;
-  low_right = NULL;
-  up_left = NULL;
-  up_right = NULL;
-
-  // Allocate space for the points that will be added
-  num_points = 0;
-  pts = new double[2 * NODES_PER_LEVEL];
-  pt_nums = new uint32_t[NODES_PER_LEVEL];
+inline int TMRPointIndex::getBucket(double x, double y) {
+  if (x < xlow || x > xhigh || y < ylow || y > yhigh) {
+    return -1;
+  }
+  int i = (int)((x - xlow) * xscale);
+  int j = (int)((y - ylow) * yscale);
+  if (i >= nx) {
+    i = nx - 1;
+  }
+  if (j >= ny) {
+    j = ny - 1;
+  }
+  return i + nx * j;
 }
 
 /*
-  Free the quadtree node and its data
+  Set the number of buckets and re-insert the points within the grid.
+  The buckets are kept close to square.
 */
-TMRQuadNode::~TMRQuadNode() {
-  if (pts) {
-    delete[] pts;
+void TMRPointIndex::resize(int nbuckets) {
+  double w = xhigh - xlow, h = yhigh - ylow;
+  nx = (int)(sqrt(nbuckets * w / h) + 0.5);
+  if (nx < 1) {
+    nx = 1;
+  }
+  ny = (nbuckets + nx - 1) / nx;
+  if (ny < 1) {
+    ny = 1;
   }
-  if (pt_nums) {
-    delete[] pt_nums;
+  xscale = nx / w;
+  yscale = ny / h;
+
+  if (head) {
+    delete[] head;
   }
-  if (low_left) {
-    delete low_left;
-    delete low_right;
-    delete up_left;
-    delete up_right;
+  head = new int[nx * ny];
+  for (int i = 0; i < nx * ny; i++) {
+    head[i] = -1;
+  }
+
+  for (int num = 0; num < max_num; num++) {
+    if (bucket[num] >= 0) {
+      int b = getBucket(xy[2 * num], xy[2 * num + 1]);
+      bucket[num] = b;
+      next[num] = head[b];
+      head[b] = num;
+    }
   }
 }
 
 /*
-  Add a node to the quadtree.
+  Add a point to the index.
 
   This code does not check for duplicated geometric entities at the
   same point or duplicated indices. It is the user's responsibility
   not to add duplicates.
 */
-void TMRQuadNode::addNode(uint32_t num, const double pt[]) {
-  // If any of the children have been allocated, searh them for
-  // the place where the node should be added
-  if (low_left) {
-    if (pt[0] <= x && pt[1] <= y) {
-      low_left->addNode(num, pt);
-    } else if (pt[0] <= x) {
-      up_left->addNode(num, pt);
-    } else if (pt[1] <= y) {
-      low_right->addNode(num, pt);
-    } else {
-      up_right->addNode(num, pt);
-    }
+void TMRPointIndex::addNode(uint32_t num, const double pt[]) {
+  // Extend the point arrays
+  if ((int)num >= max_num) {
+    int new_max = 2 * max_num;
+    if (new_max < 1024) {
+      new_max = 1024;
+    }
+    while (new_max <= (int)num) {
+      new_max *= 2;
+    }
+
+    int *new_next = new int[new_max];
+    int *new_bucket = new int[new_max];
+    double *new_xy = new double[2 * new_max];
+    if (max_num > 0) {
+      memcpy(new_next, next, max_num * sizeof(int));
+      memcpy(new_bucket, bucket, max_num * sizeof(int));
+      memcpy(new_xy, xy, 2 * max_num * sizeof(double));
+      delete[] next;
+      delete[] bucket;
+      delete[] xy;
+    }
+    for (int i = max_num; i < new_max; i++) {
+      new_bucket[i] = -2;
+    }
+    next = new_next;
+    bucket = new_bucket;
+    xy = new_xy;
+    max_num = new_max;
+  }
+
+  xy[2 * num] = pt[0];
+  xy[2 * num + 1] = pt[1];
+
+  int b = getBucket(pt[0], pt[1]);
+  bucket[num] = b;
+  if (b < 0) {
+    outside.push_back(num);
     return;
   }
 
-  // Check if adding this node would exceed the number of nodes that
-  // are allowed per level
-  if (num_points < NODES_PER_LEVEL) {
-    pts[2 * num_points] = pt[0];
-    pts[2 * num_points + 1] = pt[1];
-    pt_nums[num_points] = num;
-    num_points++;
-    return;
-  } else {
-    // Allocate new children for the new nodes
-    const uint32_t h = 1 << (MAX_DEPTH - level - 1);
+  next[num] = head[b];
+  head[b] = num;
+  num_grid_points++;
 
-    low_left = new TMRQuadNode(domain, u, v, level + 1);
-    low_right = new TMRQuadNode(domain, u + h, v, level + 1);
-    up_left = new TMRQuadNode(domain, u, v + h, level + 1);
-    up_right = new TMRQuadNode(domain, u + h, v + h, level + 1);
-
-    // Add the points to myself
-    for (int k = 0; k < NODES_PER_LEVEL; k++) {
-      addNode(pt_nums[k], &pts[2 * k]);
-    }
-    addNode(num, pt);
-
-    // Free the space that was allocated
-    delete[] pt_nums;
-    delete[] pts;
-    pt_nums = NULL;
-    pts = NULL;
-    num_points = 0;
+  // Refine the grid once the buckets are too full on average
+  if (num_grid_points > MAX_POINTS_PER_BUCKET * nx * ny) {
+    resize(num_grid_points / POINTS_PER_BUCKET);
   }
 }
 
 /*
-  Delete a point from the quadtree.
-
-  Note that the coordinate provided is used to match the point, but
-  needs to be used to scan through the quadtree hierarchy to find the
-  correct quadrant location.
+  Delete a point from the index. Returns 1 if the point was found and
+  0 otherwise.
 */
-int TMRQuadNode::deleteNode(uint32_t num, const double pt[]) {
-  if (low_left) {
-    if (pt[0] <= x && pt[1] <= y) {
-      return low_left->deleteNode(num, pt);
-    } else if (pt[0] <= x) {
-      return up_left->deleteNode(num, pt);
-    } else if (pt[1] <= y) {
-      return low_right->deleteNode(num, pt);
-    } else {
-      return up_right->deleteNode(num, pt);
-    }
-  }
-
-  // The node could not be deleted because no nodes exist on this
-  // level.
-  if (num_points == 0) {
+int TMRPointIndex::deleteNode(uint32_t num) {
+  if ((int)num >= max_num || bucket[num] == -2) {
     return 0;
   }
 
-  // Scan through the list of nodes, and check for the one that
-  // needs to be deleted.
-  int i = 0;
-  for (; i < num_points; i++) {
-    if (pt_nums[i] == num) {
-      break;
+  int b = bucket[num];
+  bucket[num] = -2;
+  if (b < 0) {
+    for (size_t i = 0; i < outside.size(); i++) {
+      if (outside[i] == num) {
+        outside[i] = outside.back();
+        outside.pop_back();
+        return 1;
+      }
     }
-  }
-
-  // We ended up past the last entry, therefore the point was not found
-  if (i == num_points) {
     return 0;
   }
 
-  // Increment the index one past the node that will be eliminated
-  i++;
-  for (; i < num_points; i++) {
-    // Move all the data back to cover the deleted entry
-    pt_nums[i - 1] = pt_nums[i];
-    pts[2 * (i - 1)] = pts[2 * i];
-    pts[2 * (i - 1) + 1] = pts[2 * i + 1];
+  // Unlink the point from the bucket list
+  int *ptr = &head[b];
+  while (*ptr >= 0 && *ptr != (int)num) {
+    ptr = &next[*ptr];
+  }
+  if (*ptr == (int)num) {
+    *ptr = next[num];
+    num_grid_points--;
+    return 1;
   }
-  // Decrease the number of points to account for the deleted node
-  num_points--;
 
-  // The point was found
-  return 1;
+  return 0;
 }
 
 /*
-  Find the closest indexed point to the provided (x,y) location
-
-  This function is the top-level function that calls the recursive
-  version after initializing the data.
+  Search the points in a bucket for one closer than the current point
 */
-uint32_t TMRQuadNode::findClosest(const double pt[], double *_dist) {
-  double dist = MAX_QUAD_DISTANCE;
-  uint32_t index = 0;
-
-  // Make the recursive call
-  findClosest(pt, &index, &dist);
-  if (_dist) {
-    *_dist = dist;
+inline void TMRPointIndex::searchBucket(int b, const double pt[],
+                                        uint32_t *index, double *dist) {
+  for (int num = head[b]; num >= 0; num = next[num]) {
+    double dx = pt[0] - xy[2 * num];
+    double dy = pt[1] - xy[2 * num + 1];
+    double d = dx * dx + dy * dy;
+    if (d < *dist) {
+      *dist = d;
+      *index = num;
+    }
   }
-  return index;
 }
 
 /*
-  The recursive call to find the closest point
+  Find the closest indexed point to the provided (x,y) location
 
-  This scans each quadrant, testing whether it will be necessary to
-  scan multiple quadrants to ensure that we have, in fact, located the
-  closest point to the provided point.
+  The buckets are searched in rings of increasing size around the
+  bucket containing the point. The search stops once the closest
+  point found so far is closer than any point outside the ring.
 */
-void TMRQuadNode::findClosest(const double pt[], uint32_t *index,
-                              double *dist) {
-  // Scan through the quadtree
-  if (low_left) {
-    if (pt[0] <= x && pt[1] <= y) {
-      low_left->findClosest(pt, index, dist);
-      if (x - pt[0] <= *dist) {
-        low_right->findClosest(pt, index, dist);
-      }
-      if (y - pt[1] <= *dist) {
-        up_left->findClosest(pt, index, dist);
-      }
-      if (x - pt[0] <= *dist && y - pt[1] <= *dist) {
-        up_right->findClosest(pt, index, dist);
-      }
-    } else if (pt[0] <= x) {
-      up_left->findClosest(pt, index, dist);
-      if (x - pt[0] <= *dist) {
-        up_right->findClosest(pt, index, dist);
-      }
-      if (pt[1] - y <= *dist) {
-        low_left->findClosest(pt, index, dist);
-      }
-      if (x - pt[0] <= *dist && pt[1] - y <= *dist) {
-        low_right->findClosest(pt, index, dist);
-      }
-    } else if (pt[1] <= y) {
-      low_right->findClosest(pt, index, dist);
-      if (pt[0] - x <= *dist) {
-        low_left->findClosest(pt, index, dist);
+uint32_t TMRPointIndex::findClosest(const double pt[], double *_dist) {
+  double dist = MAX_QUAD_DISTANCE;
+  uint32_t index = 0;
+
+  // Search the points outside the grid
+  for (size_t k = 0; k < outside.size(); k++) {
+    uint32_t num = outside[k];
+    double dx = pt[0] - xy[2 * num];
+    double dy = pt[1] - xy[2 * num + 1];
+    double d = dx * dx + dy * dy;
+    if (d < dist) {
+      dist = d;
+      index = num;
+    }
+  }
+
+  if (num_grid_points > 0) {
+    // Find the bucket containing the point, or the closest bucket
+    double fx = (pt[0] - xlow) * xscale;
+    double fy = (pt[1] - ylow) * yscale;
+    int i = (fx < 0.0 ? 0 : (fx >= nx ? nx - 1 : (int)fx));
+    int j = (fy < 0.0 ? 0 : (fy >= ny ? ny - 1 : (int)fy));
+
+    for (int r = 0;; r++) {
+      int ilow = i - r, ihigh = i + r;
+      int jlow = j - r, jhigh = j + r;
+
+      // Search the buckets on the ring at distance r
+      for (int jj = jlow; jj <= jhigh; jj++) {
+        if (jj < 0 || jj >= ny) {
+          continue;
+        }
+        if (jj == jlow || jj == jhigh) {
+          int ii = (ilow < 0 ? 0 : ilow);
+          int iend = (ihigh >= nx ? nx - 1 : ihigh);
+          for (; ii <= iend; ii++) {
+            searchBucket(ii + nx * jj, pt, &index, &dist);
+          }
+        } else {
+          if (ilow >= 0) {
+            searchBucket(ilow + nx * jj, pt, &index, &dist);
+          }
+          if (ihigh < nx) {
+            searchBucket(ihigh + nx * jj, pt, &index, &dist);
+          }
+        }
       }
-      if (y - pt[1] <= *dist) {
-        up_right->findClosest(pt, index, dist);
+
+      // Compute the distance from the point to the nearest side of
+      // the searched block that does not lie on the grid boundary.
+      // Any point that has not been searched lies beyond this side.
+      double bound = MAX_QUAD_DISTANCE;
+      if (ilow > 0) {
+        double d = pt[0] - (xlow + ilow / xscale);
+        bound = (d < bound ? d : bound);
       }
-      if (pt[0] - x <= *dist && y - pt[1] <= *dist) {
-        up_left->findClosest(pt, index, dist);
+      if (ihigh < nx - 1) {
+        double d = (xlow + (ihigh + 1) / xscale) - pt[0];
+        bound = (d < bound ? d : bound);
       }
-    } else {
-      up_right->findClosest(pt, index, dist);
-      if (pt[0] - x <= *dist) {
-        up_left->findClosest(pt, index, dist);
+      if (jlow > 0) {
+        double d = pt[1] - (ylow + jlow / yscale);
+        bound = (d < bound ? d : bound);
       }
-      if (pt[1] - y <= *dist) {
-        low_right->findClosest(pt, index, dist);
+      if (jhigh < ny - 1) {
+        double d = (ylow + (jhigh + 1) / yscale) - pt[1];
+        bound = (d < bound ? d : bound);
       }
-      if (pt[0] - x <= *dist && pt[1] - y <= *dist) {
-        low_left->findClosest(pt, index, dist);
+
+      if (bound == MAX_QUAD_DISTANCE ||
+          (bound > 0.0 && dist <= bound * bound)) {
+        break;
       }
     }
-    return;
   }
 
-  // This is a leaf, search the points
-  for (int i = 0; i < num_points; i++) {
-    double dx = pt[0] - pts[2 * i];
-    double dy = pt[1] - pts[2 * i + 1];
-    double d = sqrt(dx * dx + dy * dy);
-    if (d < *dist) {
-      *dist = d;
-      *index = pt_nums[i];
-    }
+  if (_dist) {
+    *_dist = (dist < MAX_QUAD_DISTANCE ? sqrt(dist) : dist);
   }
+  return index;
 }
 
 /*
@@ -490,6 +522,93 @@ TMRTriangularize::TMRTriangularize(int npts, const double inpts[], int nholes,
   initialize(npts, inpts, nholes, nsegs, segs, surf);
 }
 
+/*
+  The predicates code only needs to be initialized once. This is
+  guarded so that triangularizations can be created concurrently.
+*/
+static pthread_once_t tmr_exactinit_once = PTHREAD_ONCE_INIT;
+
+/*
+  Inline floating-point filters for the orient2d and incircle
+  predicates.
+
+  These evaluate the determinant in double precision and return it
+  directly when its sign is certified by Shewchuk's first-stage error
+  bound. Only the uncertain cases call the adaptive exact predicates,
+  which return a value with the same sign as the exact determinant.
+  The error bounds match those computed by exactinit() for IEEE
+  double precision with round-to-nearest (epsilon = 2^{-53}).
+*/
+static const double tmr_pred_epsilon = 1.1102230246251565e-16;
+static const double tmr_ccw_errbound =
+    (3.0 + 16.0 * tmr_pred_epsilon) * tmr_pred_epsilon;
+static const double tmr_icc_errbound =
+    (10.0 + 96.0 * tmr_pred_epsilon) * tmr_pred_epsilon;
+
+static inline double tmr_orient2d(double pa[], double pb[], double pc[]) {
+  double detleft = (pa[0] - pc[0]) * (pb[1] - pc[1]);
+  double detright = (pa[1] - pc[1]) * (pb[0] - pc[0]);
+  double det = detleft - detright;
+
+  // The sign is exact when the two products have different signs
+  double detsum = 0.0;
+  if (detleft > 0.0) {
+    if (detright <= 0.0) {
+      return det;
+    }
+    detsum = detleft + detright;
+  } else if (detleft < 0.0) {
+    if (detright >= 0.0) {
+      return det;
+    }
+    detsum = -detleft - detright;
+  } else {
+    return det;
+  }
+
+  double errbound = tmr_ccw_errbound * detsum;
+  if (det >= errbound || -det >= errbound) {
+    return det;
+  }
+
+  return orient2d(pa, pb, pc);
+}
+
+static inline double tmr_incircle(double pa[], double pb[], double pc[],
+                                  double pd[]) {
+  double adx = pa[0] - pd[0];
+  double bdx = pb[0] - pd[0];
+  double cdx = pc[0] - pd[0];
+  double ady = pa[1] - pd[1];
+  double bdy = pb[1] - pd[1];
+  double cdy = pc[1] - pd[1];
+
+  double bdxcdy = bdx * cdy;
+  double cdxbdy = cdx * bdy;
+  double alift = adx * adx + ady * ady;
+
+  double cdxady = cdx * ady;
+  double adxcdy = adx * cdy;
+  double blift = bdx * bdx + bdy * bdy;
+
+  double adxbdy = adx * bdy;
+  double bdxady = bdx * ady;
+  double clift = cdx * cdx + cdy * cdy;
+
+  double det = alift * (bdxcdy - cdxbdy) + blift * (cdxady - adxcdy) +
+               clift * (adxbdy - bdxady);
+
+  double permanent = (fabs(bdxcdy) + fabs(cdxbdy)) * alift +
+                     (fabs(cdxady) + fabs(adxcdy)) * blift +
+                     (fabs(adxbdy) + fabs(bdxady)) * clift;
+  double errbound = tmr_icc_errbound * permanent;
+  if (det > errbound || -det > errbound) {
+    return det;
+  }
+
+  return incircle(pa, pb, pc, pd);
+}
+
 /*
   The 'true' constructor. This is called, depending on which arguments
   are provided.
@@ -497,23 +616,24 @@ TMRTriangularize::TMRTriangularize(int npts, const double inpts[], int nholes,
 void TMRTriangularize::initialize(int npts, const double inpts[], int nholes,
                                   int nsegs, const int segs[], TMRFace *surf) {
   // Initialize the predicates code
-  exactinit();
+  pthread_once(&tmr_exactinit_once, exactinit);
 
   // Set the surface
   face = surf;
   face->incref();
 
   // Allocate and initialize/zero the hash table data for the edges
-  num_hash_nodes = 0;
-  num_buckets = 100;
-  buckets = new EdgeHashNode *[num_buckets];
-  memset(buckets, 0, num_buckets * sizeof(EdgeHashNode *));
-
-  // Set the initial root/current location of the doubly-linked
-  // triangle list structure. These are allocated as we add new
-  // triangles.
-  list_start = NULL;
-  list_end = NULL;
+  num_hash_entries = 0;
+  edge_hash_size = 1024;
+  edge_hash = new EdgeHashEntry[edge_hash_size];
+  memset(edge_hash, 0, edge_hash_size * sizeof(EdgeHashEntry));
+
+  // Set the initial triangle storage. The blocks of triangles are
+  // allocated as we add new triangles.
+  num_tri_slots = 0;
+  num_tri_blocks = 0;
+  max_tri_blocks = 16;
+  tri_blocks = new TMRTriangle *[max_tri_blocks];
 
   // Keep track of the total number of triangles
   num_triangles = 0;
@@ -535,7 +655,7 @@ void TMRTriangularize::initialize(int npts, const double inpts[], int nholes,
   // If we have a face object
   X = new TMRPoint[max_num_points];
 
-  // Find the maximum domain size
+  // Find the bounding box of the input points
   domain.xlow = domain.xhigh = inpts[0];
   domain.ylow = domain.yhigh = inpts[1];
   for (int i = 1; i < npts; i++) {
@@ -553,6 +673,11 @@ void TMRTriangularize::initialize(int npts, const double inpts[], int nholes,
     }
   }
 
+  // Create the spatial index over the bounding box of the input
+  // points. Points inserted outside of the box are still indexed.
+  root = new TMRPointIndex(domain.xlow, domain.xhigh, domain.ylow,
+                           domain.yhigh, npts);
+
   // Re-adjust the domain boundary to ensure that it is sufficiently
   // large
   double xsmall = 10.0 * (domain.xhigh - domain.xlow);
@@ -563,9 +688,9 @@ void TMRTriangularize::initialize(int npts, const double inpts[], int nholes,
   domain.yhigh += ysmall;
   domain.ylow -= ysmall;
 
-  // Allocate the new root mode
-  root = new TMRQuadNode(&domain);
   search_tag = 0;
+  num_locate_walks = 0;
+  num_locate_searches = 0;
 
   // Set up the PSLG edges
   setUpPSLGEdges(nsegs, segs);
@@ -591,7 +716,7 @@ void TMRTriangularize::initialize(int npts, const double inpts[], int nholes,
     X[i].x = X[i].y = X[i].z = 0.0;
   }
 
-  // Add the extreme points to the quadtree
+  // Add the extreme points to the point index
   for (int i = 0; i < FIXED_POINT_OFFSET; i++) {
     root->addNode(i, &pts[2 * i]);
   }
@@ -602,9 +727,7 @@ void TMRTriangularize::initialize(int npts, const double inpts[], int nholes,
 
   // Add the points to the triangle. This creates a CDT of the
   // original set of points.
-  for (int i = 0; i < npts; i++) {
-    addPointToMesh(&inpts[2 * i], NULL);
-  }
+  addPointsToMesh(npts, inpts);
 
   // Ensure that all the segments are in the triangulation to
   // recover a CDT
@@ -631,59 +754,47 @@ void TMRTriangularize::initialize(int npts, const double inpts[], int nholes,
   // Mark all the triangles in the list that contain or touch nodes
   // that are in the FIXED_POINT_OFFSET list that are not separated by
   // a PSLG edge. These triangles will be deleted.
-  TriListNode *node = list_start;
   uint32_t max_node_num = num_points - nholes;
-  while (node) {
-    if (node->tri.status != DELETE_ME && node->tri.tag == 0 &&
-        ((node->tri.u < FIXED_POINT_OFFSET ||
-          node->tri.v < FIXED_POINT_OFFSET ||
-          node->tri.w < FIXED_POINT_OFFSET) ||
-         (node->tri.u >= max_node_num || node->tri.v >= max_node_num ||
-          node->tri.w >= max_node_num))) {
-      tagTriangles(&node->tri);
+  for (int i = 0; i < num_tri_slots; i++) {
+    TMRTriangle *t = getTriangle(i);
+    if (t->status != DELETE_ME && t->tag == 0 &&
+        ((t->u < FIXED_POINT_OFFSET || t->v < FIXED_POINT_OFFSET ||
+          t->w < FIXED_POINT_OFFSET) ||
+         (t->u >= max_node_num || t->v >= max_node_num ||
+          t->w >= max_node_num))) {
+      tagTriangles(t);
     }
-    node = node->next;
   }
 
   // Free the triangles that have been tagged
-  node = list_start;
-  while (node) {
-    if (node->tri.tag == 1) {
-      deleteTriangle(node->tri);
+  for (int i = 0; i < num_tri_slots; i++) {
+    TMRTriangle *t = getTriangle(i);
+    if (t->tag == 1) {
+      deleteTriangle(*t);
     }
-    node = node->next;
   }
 
   // Free the trianlges marked for deletion from the list
   deleteTrianglesFromList();
 
-  // Free the points and holes from the quadtree
+  // Free the points and holes from the point index
   for (int num = 0; num < FIXED_POINT_OFFSET; num++) {
-    root->deleteNode(num, &pts[2 * num]);
+    root->deleteNode(num);
   }
 
   // Free the points associated with the number of holes
   for (int num = num_points - nholes; num < num_points; num++) {
-    root->deleteNode(num, &pts[2 * num]);
+    root->deleteNode(num);
   }
   num_points -= nholes;
 
   // Perform the delaunay edge flip algorithm
   delaunayEdgeFlip();
 
-  // Free the trianlges marked for deletion from the list
-  deleteTrianglesFromList();
-
-  // Reset the node->traingle pointers to avoid referring to a
+  // Free the trianlges marked for deletion from the list. This also
+  // resets the node->triangle pointers to avoid referring to a
   // triangle that belonged to a hole and was deleted.
-  node = list_start;
-  memset(pts_to_tris, 0, num_points * sizeof(TMRTriangle *));
-  while (node) {
-    pts_to_tris[node->tri.u] = &(node->tri);
-    pts_to_tris[node->tri.v] = &(node->tri);
-    pts_to_tris[node->tri.w] = &(node->tri);
-    node = node->next;
-  }
+  deleteTrianglesFromList();
 }
 
 /*
@@ -706,22 +817,13 @@ TMRTriangularize::~TMRTriangularize() {
   }
 
   // Free the data for the edge hash table
-  for (int i = 0; i < num_buckets; i++) {
-    EdgeHashNode *node = buckets[i];
-    while (node) {
-      EdgeHashNode *tmp = node;
-      node = node->next;
-      delete tmp;
-    }
-  }
-  delete[] buckets;
+  delete[] edge_hash;
 
-  // Free the doubly linked edge list
-  while (list_start) {
-    TriListNode *tmp = list_start;
-    list_start = list_start->next;
-    delete tmp;
+  // Free the blocks of triangles
+  for (int i = 0; i < num_tri_blocks; i++) {
+    delete[] tri_blocks[i];
   }
+  delete[] tri_blocks;
 }
 
 /*
@@ -740,11 +842,11 @@ TMRTriangularize::~TMRTriangularize() {
 void TMRTriangularize::delaunayEdgeFlip() {
   std::queue<TriEdge> q;
 
-  TriListNode *node = list_start;
-  while (node) {
-    uint32_t u = node->tri.u;
-    uint32_t v = node->tri.v;
-    uint32_t w = node->tri.w;
+  for (int i = 0; i < num_tri_slots; i++) {
+    TMRTriangle *t = getTriangle(i);
+    uint32_t u = t->u;
+    uint32_t v = t->v;
+    uint32_t w = t->w;
 
     // Push only the internal edges that have the first node number
     // less than the second node number
@@ -763,7 +865,6 @@ void TMRTriangularize::delaunayEdgeFlip() {
         q.push(TriEdge(w, u));
       }
     }
-    node = node->next;
   }
 
   while (!q.empty()) {
@@ -804,8 +905,8 @@ void TMRTriangularize::delaunayEdgeFlip() {
       // Delete the existing triangles from the mesh. And add the
       // triangles (x, w, u) and (w, x, v) if they form right-handed
       // triangles.
-      if (orient2d(&pts[2 * x], &pts[2 * w], &pts[2 * u]) > 0.0 &&
-          orient2d(&pts[2 * w], &pts[2 * x], &pts[2 * v]) > 0.0) {
+      if (tmr_orient2d(&pts[2 * x], &pts[2 * w], &pts[2 * u]) > 0.0 &&
+          tmr_orient2d(&pts[2 * w], &pts[2 * x], &pts[2 * v]) > 0.0) {
         // Perform the incircle test. This test passes only if both
         // triangles agree that they are incircled. And the new
         // triangles agree that they are not encircled
@@ -933,12 +1034,11 @@ void TMRTriangularize::removeDegenerateEdges(int num_degen, const int degen[]) {
     num_points = count;
 
     // Now, readjust the node numbers in the triangle
-    TriListNode *node = list_start;
-    while (node) {
-      node->tri.u = old_to_new[node->tri.u];
-      node->tri.v = old_to_new[node->tri.v];
-      node->tri.w = old_to_new[node->tri.w];
-      node = node->next;
+    for (int i = 0; i < num_tri_slots; i++) {
+      TMRTriangle *t = getTriangle(i);
+      t->u = old_to_new[t->u];
+      t->v = old_to_new[t->v];
+      t->w = old_to_new[t->w];
     }
 
     // Free the data
@@ -979,13 +1079,12 @@ void TMRTriangularize::getMesh(int *_num_points, int *_num_triangles,
     int *t = *_conn;
 
     // Determine the connectivity
-    TriListNode *node = list_start;
-    while (node) {
-      t[0] = node->tri.u - FIXED_POINT_OFFSET;
-      t[1] = node->tri.v - FIXED_POINT_OFFSET;
-      t[2] = node->tri.w - FIXED_POINT_OFFSET;
+    for (int i = 0; i < num_tri_slots; i++) {
+      TMRTriangle *tri = getTriangle(i);
+      t[0] = tri->u - FIXED_POINT_OFFSET;
+      t[1] = tri->v - FIXED_POINT_OFFSET;
+      t[2] = tri->w - FIXED_POINT_OFFSET;
       t += 3;
-      node = node->next;
     }
   }
 }
@@ -994,10 +1093,8 @@ void TMRTriangularize::getMesh(int *_num_points, int *_num_triangles,
   Reset the tags of all the triangles within the list
 */
 void TMRTriangularize::setTriangleTags(uint32_t tag) {
-  TriListNode *node = list_start;
-  while (node) {
-    node->tri.tag = tag;
-    node = node->next;
+  for (int i = 0; i < num_tri_slots; i++) {
+    getTriangle(i)->tag = tag;
   }
 }
 
@@ -1048,12 +1145,11 @@ void TMRTriangularize::writeToVTK(const char *filename, const int param_space) {
     // Write out the cell values
     fprintf(fp, "\nCELLS %d %d\n", num_triangles, 4 * num_triangles);
 
-    TriListNode *node = list_start;
-    while (node) {
-      if (node->tri.status != DELETE_ME) {
-        fprintf(fp, "3 %d %d %d\n", node->tri.u, node->tri.v, node->tri.w);
+    for (int i = 0; i < num_tri_slots; i++) {
+      TMRTriangle *t = getTriangle(i);
+      if (t->status != DELETE_ME) {
+        fprintf(fp, "3 %d %d %d\n", t->u, t->v, t->w);
       }
-      node = node->next;
     }
 
     // All quadrilaterals
@@ -1066,26 +1162,24 @@ void TMRTriangularize::writeToVTK(const char *filename, const int param_space) {
     fprintf(fp, "CELL_DATA %d\n", num_triangles);
     fprintf(fp, "SCALARS status float 1\n");
     fprintf(fp, "LOOKUP_TABLE default\n");
-    node = list_start;
-    while (node) {
-      if (node->tri.status != DELETE_ME) {
-        fprintf(fp, "%d\n", node->tri.status);
+    for (int i = 0; i < num_tri_slots; i++) {
+      TMRTriangle *t = getTriangle(i);
+      if (t->status != DELETE_ME) {
+        fprintf(fp, "%d\n", t->status);
       }
-      node = node->next;
     }
 
     fprintf(fp, "SCALARS quality float 1\n");
     fprintf(fp, "LOOKUP_TABLE default\n");
-    node = list_start;
-    while (node) {
-      if (node->tri.status != DELETE_ME) {
-        double quality = node->tri.quality;
+    for (int i = 0; i < num_tri_slots; i++) {
+      TMRTriangle *t = getTriangle(i);
+      if (t->status != DELETE_ME) {
+        double quality = t->quality;
         if (quality != quality) {
           quality = -1e20;
         }
         fprintf(fp, "%e\n", quality);
       }
-      node = node->next;
     }
 
     fclose(fp);
@@ -1101,191 +1195,174 @@ inline uint32_t TMRTriangularize::getEdgeHash(uint32_t x, uint32_t y) {
 
 /*
   Remove/delete the deleted triangles from the list
+
+  The remaining triangles are shifted down in place so that their
+  relative order is unchanged and the freed slots are recycled for
+  new triangles. Since this moves the triangles, the edge hash table
+  and the node->triangle pointers are rebuilt.
 */
 void TMRTriangularize::deleteTrianglesFromList() {
-  TriListNode *ptr = list_start;
-  while (ptr) {
-    TriListNode *next = ptr->next;
-
-    if (ptr->tri.status == DELETE_ME) {
-      if (ptr == list_start) {
-        list_start = next;
-        if (list_start) {
-          list_start->prev = NULL;
-        }
-      } else {
-        // Set the pointers from the previous and next objects in the
-        // list so that they point past the ptr member
-        if (ptr->prev) {
-          ptr->prev->next = ptr->next;
-        }
-        if (ptr->next) {
-          ptr->next->prev = ptr->prev;
-        }
+  int count = 0;
+  for (int i = 0; i < num_tri_slots; i++) {
+    TMRTriangle *t = getTriangle(i);
+    if (t->status != DELETE_ME) {
+      if (count != i) {
+        *getTriangle(count) = *t;
       }
-
-      delete ptr;
+      count++;
     }
-
-    ptr = next;
   }
+  num_tri_slots = count;
 
-  // Point the list back to the end of the list
-  list_end = list_start;
-  while (list_end && list_end->next) {
-    list_end = list_end->next;
+  // Re-insert the edges of the remaining triangles
+  num_hash_entries = 0;
+  memset(edge_hash, 0, edge_hash_size * sizeof(EdgeHashEntry));
+  memset(pts_to_tris, 0, num_points * sizeof(TMRTriangle *));
+  for (int i = 0; i < num_tri_slots; i++) {
+    TMRTriangle *t = getTriangle(i);
+    insertEdge(t->u, t->v, t);
+    insertEdge(t->v, t->w, t);
+    insertEdge(t->w, t->u, t);
+    pts_to_tris[t->u] = t;
+    pts_to_tris[t->v] = t;
+    pts_to_tris[t->w] = t;
   }
 }
 
 /*
-  Add a triangle to the mesh
+  Resize the edge hash table and re-insert the existing entries
 */
-int TMRTriangularize::addTriangle(TMRTriangle tri) {
-  int success = 1;
+void TMRTriangularize::resizeEdgeHash(uint32_t size) {
+  EdgeHashEntry *old_hash = edge_hash;
+  uint32_t old_size = edge_hash_size;
 
-  // Add the triangle to the list of nodes
-  if (!list_start) {
-    // Create the root triangle node
-    list_start = new TriListNode();
-    list_start->tri = tri;
-    list_start->next = NULL;
-    list_start->prev = NULL;
+  edge_hash_size = size;
+  edge_hash = new EdgeHashEntry[edge_hash_size];
+  memset(edge_hash, 0, edge_hash_size * sizeof(EdgeHashEntry));
 
-    // Update the current node
-    list_end = list_start;
-  } else {
-    // Create the new member in the triangle list
-    TriListNode *next = new TriListNode();
-    next->tri = tri;
-    next->next = NULL;
-    next->prev = list_end;
+  num_hash_entries = 0;
+  for (uint32_t i = 0; i < old_size; i++) {
+    if (old_hash[i].tri) {
+      insertEdge(old_hash[i].u, old_hash[i].v, old_hash[i].tri);
+    }
+  }
+
+  delete[] old_hash;
+}
+
+/*
+  Insert the edge (u, v) into the hash table.
 
-    // Update the current member in the triangle list
-    list_end->next = next;
-    list_end = list_end->next;
+  If the edge already exists, the triangle is overwritten and the
+  function returns 0, otherwise it returns 1.
+*/
+int TMRTriangularize::insertEdge(uint32_t u, uint32_t v, TMRTriangle *tri) {
+  // Keep the load factor at or below 1/2
+  if (2 * (num_hash_entries + 1) > edge_hash_size) {
+    resizeEdgeHash(2 * edge_hash_size);
   }
 
-  list_end->tri.tag = 0;
-  list_end->tri.status = NO_STATUS;
+  uint32_t mask = edge_hash_size - 1;
+  uint32_t i = getEdgeHash(u, v) & mask;
+  while (edge_hash[i].tri) {
+    if (edge_hash[i].u == u && edge_hash[i].v == v) {
+      edge_hash[i].tri = tri;
+      return 0;
+    }
+    i = (i + 1) & mask;
+  }
 
-  // Set the pointer to the list of triangles
-  pts_to_tris[tri.u] = &(list_end->tri);
-  pts_to_tris[tri.v] = &(list_end->tri);
-  pts_to_tris[tri.w] = &(list_end->tri);
+  edge_hash[i].u = u;
+  edge_hash[i].v = v;
+  edge_hash[i].tri = tri;
+  num_hash_entries++;
 
-  // Add the triangle to the triangle count
-  num_triangles++;
+  return 1;
+}
 
-  // Redistribute the members in the hash table if required
-  if (num_hash_nodes > 10 * num_buckets) {
-    // Create a new array of buckets, twice the size of the old array
-    // of buckets and re-insert the entries back into the new array
-    int num_old_buckets = num_buckets;
-    num_buckets *= 2;
-
-    // Create a new array pointing to the new buckets and the
-    // end of the bucket array
-    EdgeHashNode **new_buckets = new EdgeHashNode *[num_buckets];
-    EdgeHashNode **end_buckets = new EdgeHashNode *[num_buckets];
-    memset(new_buckets, 0, num_buckets * sizeof(EdgeHashNode *));
-    memset(end_buckets, 0, num_buckets * sizeof(EdgeHashNode *));
-
-    // Assign the new buckets
-    for (int i = 0; i < num_old_buckets; i++) {
-      EdgeHashNode *node = buckets[i];
-
-      while (node) {
-        // Get the new hash values
-        EdgeHashNode *tmp = node->next;
-        uint32_t value = getEdgeHash(node->u, node->v);
-        uint32_t bucket = value % num_buckets;
-
-        // If the new bucket linked list does not exist, create a new
-        // one and set the end_buckets pointer
-        if (!new_buckets[bucket]) {
-          new_buckets[bucket] = node;
-          node->next = NULL;
-          end_buckets[bucket] = new_buckets[bucket];
-        } else {
-          end_buckets[bucket]->next = node;
-          end_buckets[bucket] = end_buckets[bucket]->next;
-          node->next = NULL;
-        }
+/*
+  Remove the edge (u, v) from the hash table and return the triangle
+  that it referred to, or NULL if the edge was not found.
 
-        node = tmp;
-      }
+  The entries following the removed entry in the probe sequence are
+  shifted back so that no tombstones are required.
+*/
+TMRTriangle *TMRTriangularize::removeEdge(uint32_t u, uint32_t v) {
+  uint32_t mask = edge_hash_size - 1;
+  uint32_t i = getEdgeHash(u, v) & mask;
+  while (edge_hash[i].tri) {
+    if (edge_hash[i].u == u && edge_hash[i].v == v) {
+      break;
     }
-
-    delete[] end_buckets;
-    delete[] buckets;
-    buckets = new_buckets;
+    i = (i + 1) & mask;
   }
 
-  // Set the combinations of edge pairs that will be added
-  // to the hash table
-  uint32_t edge_pairs[][2] = {{tri.u, tri.v}, {tri.v, tri.w}, {tri.w, tri.u}};
+  TMRTriangle *tri = edge_hash[i].tri;
+  if (!tri) {
+    return NULL;
+  }
 
-  // Add the triangle to the hash table
-  for (int k = 0; k < 3; k++) {
-    // Add a hash for each pair of edges around the triangle
-    uint32_t u = edge_pairs[k][0];
-    uint32_t v = edge_pairs[k][1];
-    uint32_t value = getEdgeHash(u, v);
-    uint32_t bucket = value % num_buckets;
-    if (!buckets[bucket]) {
-      // Create the new buckets node and assign the values
-      buckets[bucket] = new EdgeHashNode();
-      buckets[bucket]->u = u;
-      buckets[bucket]->v = v;
-      buckets[bucket]->tri_node = list_end;
-      buckets[bucket]->next = NULL;
-      num_hash_nodes++;
-    } else {
-      // Scan through to the end of the array and determine if the
-      // edge exists in the hash table already or not
-      EdgeHashNode *node = buckets[bucket];
-      while (node) {
-        // The edge already exists -- overwrite it
-        if (node->u == u && node->v == v) {
-          // The edge already exists, it will be overwritten, but
-          // we'll call this a failure...
-          success = 0;
-
-          // Overwite the triangle
-          node->tri_node = list_end;
-
-          // Set the pointer to NULL so that the new node will not be
-          // created
-          node = NULL;
-          break;
-        }
+  // Shift back any entries whose home slot does not lie in the
+  // cyclic range (i, j]
+  uint32_t j = i;
+  while (1) {
+    j = (j + 1) & mask;
+    if (!edge_hash[j].tri) {
+      break;
+    }
+    uint32_t k = getEdgeHash(edge_hash[j].u, edge_hash[j].v) & mask;
+    if ((i < j) ? (k <= i || k > j) : (k <= i && k > j)) {
+      edge_hash[i] = edge_hash[j];
+      i = j;
+    }
+  }
+  edge_hash[i].tri = NULL;
+  num_hash_entries--;
 
-        // If the next node does not exist, then break
-        if (!node->next) {
-          break;
-        }
+  return tri;
+}
 
-        // Increment the node to the next position
-        node = node->next;
-      }
+/*
+  Add a triangle to the mesh
+*/
+int TMRTriangularize::addTriangle(TMRTriangle tri) {
+  int success = 1;
 
-      if (node) {
-        // Create the new hash node
-        node->next = new EdgeHashNode();
-        node = node->next;
-
-        // Set the data into the object
-        node->u = u;
-        node->v = v;
-        node->tri_node = list_end;
-        node->next = NULL;
-        num_hash_nodes++;
-      } else {
-        success = 0;
-      }
+  // Allocate a new block of triangles if required
+  if (num_tri_slots >= num_tri_blocks * TRI_BLOCK_SIZE) {
+    if (num_tri_blocks >= max_tri_blocks) {
+      max_tri_blocks *= 2;
+      TMRTriangle **tmp = new TMRTriangle *[max_tri_blocks];
+      memcpy(tmp, tri_blocks, num_tri_blocks * sizeof(TMRTriangle *));
+      delete[] tri_blocks;
+      tri_blocks = tmp;
     }
+    tri_blocks[num_tri_blocks] = new TMRTriangle[TRI_BLOCK_SIZE];
+    num_tri_blocks++;
   }
 
+  // Copy the triangle into the next free slot
+  TMRTriangle *t = getTriangle(num_tri_slots);
+  num_tri_slots++;
+  *t = tri;
+  t->tag = 0;
+  t->status = NO_STATUS;
+
+  // Set the pointer to the list of triangles
+  pts_to_tris[tri.u] = t;
+  pts_to_tris[tri.v] = t;
+  pts_to_tris[tri.w] = t;
+
+  // Add the triangle to the triangle count
+  num_triangles++;
+
+  // Add a hash for each pair of edges around the triangle. If the
+  // edge already exists, it will be overwritten, but we'll call this
+  // a failure...
+  success = insertEdge(tri.u, tri.v, t) && success;
+  success = insertEdge(tri.v, tri.w, t) && success;
+  success = insertEdge(tri.w, tri.u, t) && success;
+
   return success;
 }
 
@@ -1308,58 +1385,25 @@ int TMRTriangularize::deleteTriangle(TMRTriangle tri) {
 
   // Remove the triangle from the hash table
   for (int k = 0; k < 3; k++) {
-    // Add a hash for each pair of edges around the triangle
-    uint32_t u = edge_pairs[k][0];
-    uint32_t v = edge_pairs[k][1];
-
-    // Keep track of whether we've deleted this edge
-    int edge_success = 0;
-
-    // Get the hash values and access the first entry of the bucket
-    // it's listed under
-    uint32_t value = getEdgeHash(u, v);
-    uint32_t bucket = value % num_buckets;
-    EdgeHashNode *node = buckets[bucket];
-    EdgeHashNode *prev = node;
-    while (node) {
-      // The edge matches, we have to delete this triangle
-      if (u == node->u && v == node->v) {
-        // If this is the first edge we've found, delete the
-        // corresponding list entry as well.
-        if (first) {
-          // This triangle will be deleted. Adjust the triangle
-          // count to reflect this
-          num_triangles--;
-
-          // Mark the triangle in the edge list so that it is
-          // 'deleted'. The memory is not freed at this point.
-          node->tri_node->tri.status = DELETE_ME;
-
-          // We've already encountered this triangle once.
-          first = 0;
-        }
+    TMRTriangle *t = removeEdge(edge_pairs[k][0], edge_pairs[k][1]);
 
-        // Delete the edge from the hash table
-        if (node == prev) {
-          buckets[bucket] = node->next;
-          delete node;
-          num_hash_nodes--;
-        } else {
-          prev->next = node->next;
-          delete node;
-          num_hash_nodes--;
-        }
+    // The edge matches, we have to delete this triangle. If this is
+    // the first edge we've found, mark the triangle for deletion.
+    if (t && first) {
+      // This triangle will be deleted. Adjust the triangle
+      // count to reflect this
+      num_triangles--;
 
-        edge_success = 1;
-        break;
-      }
+      // Mark the triangle so that it is 'deleted'. The storage is
+      // not recycled at this point.
+      t->status = DELETE_ME;
 
-      prev = node;
-      node = node->next;
+      // We've already encountered this triangle once.
+      first = 0;
     }
 
     // Keep track of each individual edge
-    success = success && edge_success;
+    success = success && (t != NULL);
   }
 
   return success;
@@ -1382,20 +1426,15 @@ inline uint32_t TMRTriangularize::getTriangleHash(TMRTriangle *tri) {
 void TMRTriangularize::completeMe(uint32_t u, uint32_t v, TMRTriangle **tri) {
   *tri = NULL;
 
-  // Retrieve the hash value/bucket for this edge
-  uint32_t value = getEdgeHash(u, v);
-  uint32_t bucket = value % num_buckets;
-  EdgeHashNode *node = buckets[bucket];
-
-  // Loop over the edges until we find the matching triangle
-  while (node) {
-    if (node->u == u && node->v == v) {
-      *tri = &(node->tri_node->tri);
+  // Probe the hash table until we find the edge or an empty entry
+  uint32_t mask = edge_hash_size - 1;
+  uint32_t i = getEdgeHash(u, v) & mask;
+  while (edge_hash[i].tri) {
+    if (edge_hash[i].u == u && edge_hash[i].v == v) {
+      *tri = edge_hash[i].tri;
       break;
     }
-
-    // Increment the pointer to the next member of this bucket
-    node = node->next;
+    i = (i + 1) & mask;
   }
 }
 
@@ -1444,9 +1483,9 @@ int TMRTriangularize::edgeInPSLG(uint32_t u, uint32_t v) {
 inline int TMRTriangularize::enclosed(const double p[], uint32_t u, uint32_t v,
                                       uint32_t w) {
   double pt[2] = {p[0], p[1]};
-  if (orient2d(&pts[2 * u], &pts[2 * v], pt) >= 0.0 &&
-      orient2d(&pts[2 * v], &pts[2 * w], pt) >= 0.0 &&
-      orient2d(&pts[2 * w], &pts[2 * u], pt) >= 0.0) {
+  if (tmr_orient2d(&pts[2 * u], &pts[2 * v], pt) >= 0.0 &&
+      tmr_orient2d(&pts[2 * v], &pts[2 * w], pt) >= 0.0 &&
+      tmr_orient2d(&pts[2 * w], &pts[2 * u], pt) >= 0.0) {
     return 1;
   }
 
@@ -1515,7 +1554,7 @@ inline double TMRTriangularize::inCircle(uint32_t u, uint32_t v, uint32_t w,
 
   // No metric is defined, so simply take the circumcircle check from
   // Shewchuk's geometric predicates
-  return incircle(pu, pv, pw, px);
+  return tmr_incircle(pu, pv, pw, px);
 }
 
 /*
@@ -1547,7 +1586,7 @@ uint32_t TMRTriangularize::addPoint(const double pt[]) {
     X = new_X;
   }
 
-  // Add the point to the quadtree
+  // Add the point to the point index
   root->addNode(num_points, pt);
 
   // Set the new point location
@@ -1571,11 +1610,16 @@ uint32_t TMRTriangularize::addPoint(const double pt[]) {
   Add the vertex to the underlying Delaunay triangularization.
 */
 void TMRTriangularize::addPointToMesh(const double pt[], TMRFace *metric) {
-  // Find the enclosing triangle
+  // Find the enclosing triangle, starting from a triangle attached to
+  // the most recently added point
+  TMRTriangle *hint = NULL;
+  if (num_points > 0) {
+    hint = pts_to_tris[num_points - 1];
+  }
   TMRTriangle *tri;
-  findEnclosing(pt, &tri);
+  findEnclosing(pt, &tri, hint);
 
-  // Add the point to the quadtree
+  // Add the point to the point index
   uint32_t u = addPoint(pt);
 
   if (tri) {
@@ -1610,6 +1654,167 @@ void TMRTriangularize::addPointToMesh(const double pt[], TMRTriangle *tri,
   }
 }
 
+/*
+  Compute the index of the point (x, y) along a Hilbert curve that
+  fills the square [0, 2^16)^2
+*/
+static uint32_t hilbert_index(uint32_t x, uint32_t y) {
+  uint32_t d = 0;
+  for (uint32_t s = 1 << 15; s > 0; s >>= 1) {
+    uint32_t rx = (x & s) > 0;
+    uint32_t ry = (y & s) > 0;
+    d += s * s * ((3 * rx) ^ ry);
+
+    // Rotate the quadrant so that the curve is continuous
+    if (ry == 0) {
+      if (rx == 1) {
+        x = s - 1 - x;
+        y = s - 1 - y;
+      }
+      uint32_t t = x;
+      x = y;
+      y = t;
+    }
+  }
+  return d;
+}
+
+/*
+  The insertion order of a point: The round number is in the upper
+  bits of the key and the Hilbert index within the round is in the
+  lower bits.
+*/
+class TMRInsertionOrder {
+ public:
+  uint64_t key;
+  int index;
+};
+
+/*
+  Compare the insertion order of two points. Ties are broken by the
+  original point index.
+*/
+static int compare_insertion_order(const void *avoid, const void *bvoid) {
+  const TMRInsertionOrder *a = static_cast<const TMRInsertionOrder *>(avoid);
+  const TMRInsertionOrder *b = static_cast<const TMRInsertionOrder *>(bvoid);
+
+  if (a->key < b->key) {
+    return -1;
+  } else if (a->key > b->key) {
+    return 1;
+  }
+  return a->index - b->index;
+}
+
+/*
+  Add a set of points to the Delaunay triangularization.
+
+  The points retain their numbering in the input order, but are
+  inserted using a biased randomized insertion order (BRIO). Each
+  point is assigned to the final round with probability 1/2, to the
+  round before that with probability 1/4 and so on. The rounds are
+  inserted from the smallest to the largest and the points within
+  each round are sorted along a Hilbert curve. The coarse rounds keep
+  the cavities small, even for points along a straight line, while
+  the Hilbert ordering keeps the walk from the previously inserted
+  point short. The pseudo-random round is a hash of the point index,
+  so the resulting triangularization is reproducible.
+
+  The point arrays must already be large enough to hold the points.
+*/
+void TMRTriangularize::addPointsToMesh(int npts, const double inpts[]) {
+  if (npts <= 0) {
+    return;
+  }
+
+  // Find the bounding box of the points
+  double xlow = inpts[0], xhigh = inpts[0];
+  double ylow = inpts[1], yhigh = inpts[1];
+  for (int i = 1; i < npts; i++) {
+    if (inpts[2 * i] < xlow) {
+      xlow = inpts[2 * i];
+    }
+    if (inpts[2 * i] > xhigh) {
+      xhigh = inpts[2 * i];
+    }
+    if (inpts[2 * i + 1] < ylow) {
+      ylow = inpts[2 * i + 1];
+    }
+    if (inpts[2 * i + 1] > yhigh) {
+      yhigh = inpts[2 * i + 1];
+    }
+  }
+
+  // Scale the points to the Hilbert curve grid
+  const double grid = 65535.0;
+  double xscale = 0.0, yscale = 0.0;
+  if (xhigh > xlow) {
+    xscale = grid / (xhigh - xlow);
+  }
+  if (yhigh > ylow) {
+    yscale = grid / (yhigh - ylow);
+  }
+
+  // Compute the insertion order of the points
+  const uint32_t max_round = 31;
+  TMRInsertionOrder *order = new TMRInsertionOrder[npts];
+  for (int i = 0; i < npts; i++) {
+    uint32_t x = (uint32_t)(xscale * (inpts[2 * i] - xlow));
+    uint32_t y = (uint32_t)(yscale * (inpts[2 * i + 1] - ylow));
+
+    // The number of trailing one bits sets the round, counted back
+    // from the final round
+    uint32_t bits = TMRIntegerPairHash(i, 0);
+    uint32_t round = 0;
+    while ((bits & 1) && round < max_round) {
+      bits >>= 1;
+      round++;
+    }
+
+    order[i].key = ((uint64_t)(max_round - round) << 32) | hilbert_index(x, y);
+    order[i].index = i;
+  }
+  qsort(order, npts, sizeof(TMRInsertionOrder), compare_insertion_order);
+
+  // Set the point locations. The points are added to the point index
+  // as they are inserted into the triangularization.
+  uint32_t offset = num_points;
+  for (int i = 0; i < npts; i++) {
+    uint32_t u = offset + i;
+    pts[2 * u] = inpts[2 * i];
+    pts[2 * u + 1] = inpts[2 * i + 1];
+    pts_to_tris[u] = NULL;
+    face->evalPoint(pts[2 * u], pts[2 * u + 1], &X[u]);
+  }
+  num_points += npts;
+
+  // Insert the points, starting the search for the enclosing
+  // triangle from the previously inserted point
+  TMRTriangle *hint = NULL;
+  for (int k = 0; k < npts; k++) {
+    uint32_t u = offset + order[k].index;
+    TMRTriangle *tri;
+    findEnclosing(&pts[2 * u], &tri, hint);
+
+    // Add the point to the point index
+    root->addNode(u, &pts[2 * u]);
+
+    if (tri) {
+      uint32_t v = tri->u;
+      uint32_t w = tri->v;
+      uint32_t x = tri->w;
+      deleteTriangle(*tri);
+      digCavity(u, v, w);
+      digCavity(u, w, x);
+      digCavity(u, x, v);
+    }
+
+    hint = pts_to_tris[u];
+  }
+
+  delete[] order;
+}
+
 /*
   The following code tests whether the triangle formed from the point
   (u, v, w) is constrained Delaunay.
@@ -1686,8 +1891,8 @@ void TMRTriangularize::insertSegment(uint32_t u, uint32_t v) {
 
     // Check whether x is above the oriented edge (u, v)
     // and w is below the oriented edge (u, v)
-    if (orient2d(&pts[2 * u], &pts[2 * v], &pts[2 * x]) >= 0.0 &&
-        orient2d(&pts[2 * u], &pts[2 * v], &pts[2 * w]) <= 0.0) {
+    if (tmr_orient2d(&pts[2 * u], &pts[2 * v], &pts[2 * x]) >= 0.0 &&
+        tmr_orient2d(&pts[2 * u], &pts[2 * v], &pts[2 * w]) <= 0.0) {
       tri = t;
       break;
     }
@@ -1713,8 +1918,8 @@ void TMRTriangularize::insertSegment(uint32_t u, uint32_t v) {
 
       // Check whether x is above the oriented edge (u, v)
       // and w is below the oriented edge (u, v)
-      if (orient2d(&pts[2 * u], &pts[2 * v], &pts[2 * x]) >= 0.0 &&
-          orient2d(&pts[2 * u], &pts[2 * v], &pts[2 * w]) <= 0.0) {
+      if (tmr_orient2d(&pts[2 * u], &pts[2 * v], &pts[2 * x]) >= 0.0 &&
+          tmr_orient2d(&pts[2 * u], &pts[2 * v], &pts[2 * w]) <= 0.0) {
         tri = t;
         break;
       }
@@ -1771,7 +1976,7 @@ void TMRTriangularize::insertSegment(uint32_t u, uint32_t v) {
     } else {
       // Use the orientation check to determine which side of the
       // segment things should lie on...
-      if (orient2d(&pts[2 * u], &pts[2 * v], &pts[2 * y]) >= 0.0) {
+      if (tmr_orient2d(&pts[2 * u], &pts[2 * v], &pts[2 * y]) >= 0.0) {
         pos[pos_count] = y;
         pos_count++;
         x = y;
@@ -1826,18 +2031,74 @@ void TMRTriangularize::giftWrap(const uint32_t v[], int size, int orient) {
   giftWrap(&v[index], size - index, orient);
 }
 
+/*
+  Walk from the starting triangle towards the point.
+
+  At each step, the walk crosses an edge of the current triangle that
+  separates it from the point. The first edge tested is rotated at
+  each step so that the walk cannot cycle indefinitely. NULL is
+  returned if the walk leaves the triangulation (through a hole or
+  the boundary of a non-convex domain) or does not terminate within
+  the maximum number of steps.
+*/
+TMRTriangle *TMRTriangularize::walkToEnclosing(const double p[],
+                                               TMRTriangle *tri) {
+  if (!tri || tri->status == DELETE_ME) {
+    return NULL;
+  }
+
+  double pt[2] = {p[0], p[1]};
+  for (int step = 0; step < num_triangles; step++) {
+    uint32_t edge_pairs[][2] = {
+        {tri->u, tri->v}, {tri->v, tri->w}, {tri->w, tri->u}};
+
+    // Find an edge with the point on the far side
+    int crossed = 0;
+    TMRTriangle *next = NULL;
+    for (int j = 0; j < 3; j++) {
+      int k = (step + j) % 3;
+      uint32_t u = edge_pairs[k][0];
+      uint32_t v = edge_pairs[k][1];
+      if (tmr_orient2d(&pts[2 * u], &pts[2 * v], pt) < 0.0) {
+        completeMe(v, u, &next);
+        crossed = 1;
+        break;
+      }
+    }
+
+    if (!crossed) {
+      return tri;
+    } else if (!next) {
+      return NULL;
+    }
+    tri = next;
+  }
+
+  return NULL;
+}
+
 /*
   Find the enclosing triangle within the mesh.
 
-  This code uses a quadtree for geometric searching. First, we find
-  the node that is closest to the query point. This node is not
-  necessarily connected with the enclosing triangle that we
-  want. Next, we find one triangle associated with this node. If this
-  triangle does not contain the point, we march over the mesh, marking
-  the triangles that we have visited.
+  If a hint is provided, we first walk from the hint towards the
+  point. The points are inserted with strong locality so this walk is
+  usually only a few steps long. Otherwise, or if the walk fails, we
+  use the point index for geometric searching. First, we find the node
+  that is closest to the query point. This node is not necessarily
+  connected with the enclosing triangle that we want. Next, we find
+  one triangle associated with this node. If this triangle does not
+  contain the point, we march over the mesh, marking the triangles
+  that we have visited.
 */
-void TMRTriangularize::findEnclosing(const double pt[], TMRTriangle **ptr) {
-  *ptr = NULL;
+void TMRTriangularize::findEnclosing(const double pt[], TMRTriangle **ptr,
+                                     TMRTriangle *hint) {
+  *ptr = walkToEnclosing(pt, hint);
+  if (*ptr) {
+    num_locate_walks++;
+    return;
+  }
+  num_locate_searches++;
+
   if (search_tag == UINT_MAX) {
     search_tag = 0;
     setTriangleTags(0);
@@ -1895,6 +2156,20 @@ void TMRTriangularize::findEnclosing(const double pt[], TMRTriangle **ptr) {
   }
 }
 
+/*
+  Get the number of point locations resolved by walking from the hint
+  and the number that required a search from the closest point
+*/
+void TMRTriangularize::getPointLocationCounts(int *_num_walks,
+                                              int *_num_searches) {
+  if (_num_walks) {
+    *_num_walks = num_locate_walks;
+  }
+  if (_num_searches) {
+    *_num_searches = num_locate_searches;
+  }
+}
+
 /*
   Compute the circumcircle for the given triangle.
 
@@ -1994,63 +2269,57 @@ void TMRTriangularize::frontal(TMRMeshOptions options,
   }
 
   // Add the triangles to the active set that
-  TriListNode *node = list_start;
-  while (node) {
-    if (node->tri.status != DELETE_ME) {
+  for (int i = 0; i < num_tri_slots; i++) {
+    TMRTriangle *node = getTriangle(i);
+    if (node->status != DELETE_ME) {
       // Set the status by default as waiting
-      node->tri.status = WAITING;
+      node->status = WAITING;
 
       // Compute the 'quality' indicator for this triangle
-      TMRTriangle t = node->tri;
+      TMRTriangle t = *node;
       double R = 0.0;
-      node->tri.quality = computeSizeRatio(t.u, t.v, t.w, fs, &R);
-      node->tri.R = R;
-      if (node->tri.quality < frontal_quality_factor) {
-        node->tri.status = ACCEPTED;
+      node->quality = computeSizeRatio(t.u, t.v, t.w, fs, &R);
+      node->R = R;
+      if (node->quality < frontal_quality_factor) {
+        node->status = ACCEPTED;
       } else {
         // If any of the triangles touches an edge in the planar
         // straight line graph, change it to a waiting triangle
-        uint32_t edge_pairs[][2] = {{node->tri.u, node->tri.v},
-                                    {node->tri.v, node->tri.w},
-                                    {node->tri.w, node->tri.u}};
+        uint32_t edge_pairs[][2] = {{node->u, node->v},
+                                    {node->v, node->w},
+                                    {node->w, node->u}};
         for (int k = 0; k < 3; k++) {
           if (edgeInPSLG(edge_pairs[k][0], edge_pairs[k][1])) {
-            node->tri.status = ACTIVE;
-            active.push(&node->tri);
+            node->status = ACTIVE;
+            active.push(node);
             break;
           }
         }
       }
     }
-
-    // Go to the next triangle in the list
-    node = node->next;
   }
 
   // Iterate over the list again and add any triangles that are
   // adjacent to an ACCEPTED triangle to the ACTIVE set of triangles
-  node = list_start;
-  while (node) {
-    if (node->tri.status == ACCEPTED) {
+  for (int i = 0; i < num_tri_slots; i++) {
+    TMRTriangle *node = getTriangle(i);
+    if (node->status == ACCEPTED) {
       // Check if any of the adjacent triangles are WAITING.  If so,
       // change their status to ACTIVE
-      uint32_t edge_pairs[][2] = {{node->tri.u, node->tri.v},
-                                  {node->tri.v, node->tri.w},
-                                  {node->tri.w, node->tri.u}};
+      uint32_t edge_pairs[][2] = {{node->u, node->v},
+                                  {node->v, node->w},
+                                  {node->w, node->u}};
 
       for (int k = 0; k < 3; k++) {
         TMRTriangle *adjacent;
         completeMe(edge_pairs[k][1], edge_pairs[k][0], &adjacent);
         if (adjacent && adjacent->status == WAITING) {
-          node->tri.status = ACTIVE;
-          active.push(&node->tri);
+          node->status = ACTIVE;
+          active.push(node);
           break;
         }
       }
     }
-
-    // Increment the pointer to the next member of the list
-    node = node->next;
   }
 
   if (options.triangularize_print_level > 0) {
@@ -2277,7 +2546,7 @@ void TMRTriangularize::frontal(TMRMeshOptions options,
       pt_tri = tri;
       if (!enclosed(pt, pt_tri->u, pt_tri->v, pt_tri->w)) {
         t0_enclose += MPI_Wtime();
-        findEnclosing(pt, &pt_tri);
+        findEnclosing(pt, &pt_tri, tri);
         t1_enclose += MPI_Wtime();
       }
 
@@ -2333,28 +2602,24 @@ void TMRTriangularize::frontal(TMRMeshOptions options,
       // Add up the update time
       t0_update += MPI_Wtime();
 
-      // Set the pointer to the last member in the list
-      TriListNode *list_marker = list_end;
+      // Record the slot of the first triangle added to the list
+      int list_marker = num_tri_slots;
       addPointToMesh(pt, pt_tri, face);
       pt_tri = NULL;
 
       // Compute the size ratio of the new triangles and check whether
       // they belong in the accepted category or not...
-      TriListNode *ptr = list_start;
-      if (list_marker) {
-        ptr = list_marker->next;
-      }
-      while (ptr) {
-        TMRTriangle t = ptr->tri;
+      for (int i = list_marker; i < num_tri_slots; i++) {
+        TMRTriangle *ptr = getTriangle(i);
+        TMRTriangle t = *ptr;
         double R = 0.0;
-        ptr->tri.quality = computeSizeRatio(t.u, t.v, t.w, fs, &R);
-        ptr->tri.R = R;
-        if (ptr->tri.quality < frontal_quality_factor) {
-          ptr->tri.status = ACCEPTED;
+        ptr->quality = computeSizeRatio(t.u, t.v, t.w, fs, &R);
+        ptr->R = R;
+        if (ptr->quality < frontal_quality_factor) {
+          ptr->status = ACCEPTED;
         } else {
-          ptr->tri.status = WAITING;
+          ptr->status = WAITING;
         }
-        ptr = ptr->next;
       }
 
       // Complete me with the newly created triangle. This triangle
@@ -2367,26 +2632,22 @@ void TMRTriangularize::frontal(TMRMeshOptions options,
 
       // Scan through the list of the added triangles and mark which
       // ones are active/working/accepted.
-      ptr = list_start;
-      if (list_marker) {
-        ptr = list_marker->next;
-      }
-
-      while (ptr) {
-        if (ptr->tri.status != ACCEPTED) {
+      for (int i = list_marker; i < num_tri_slots; i++) {
+        TMRTriangle *ptr = getTriangle(i);
+        if (ptr->status != ACCEPTED) {
           // If any of the triangles touches an edge in the planar
           // straight line graph, change it to a waiting triangle
           int flag = 0;
-          uint32_t edge_pairs[][2] = {{ptr->tri.u, ptr->tri.v},
-                                      {ptr->tri.v, ptr->tri.w},
-                                      {ptr->tri.w, ptr->tri.u}};
+          uint32_t edge_pairs[][2] = {{ptr->u, ptr->v},
+                                      {ptr->v, ptr->w},
+                                      {ptr->w, ptr->u}};
 
           // Loop over all of the edges in the triangle and check
           // whether they're in the PSLG
           for (int k = 0; k < 3; k++) {
             if (edgeInPSLG(edge_pairs[k][0], edge_pairs[k][1])) {
-              ptr->tri.status = ACTIVE;
-              active.push(&ptr->tri);
+              ptr->status = ACTIVE;
+              active.push(ptr);
               flag = 1;
               break;
             }
@@ -2399,16 +2660,13 @@ void TMRTriangularize::frontal(TMRMeshOptions options,
               TMRTriangle *adjacent;
               completeMe(edge_pairs[k][1], edge_pairs[k][0], &adjacent);
               if (adjacent && adjacent->status == ACCEPTED) {
-                ptr->tri.status = ACTIVE;
-                active.push(&ptr->tri);
+                ptr->status = ACTIVE;
+                active.push(ptr);
                 break;
               }
             }
           }
         }
-
-        // Increment the pointer to the next member of the list
-        ptr = ptr->next;
       }
       t1_update += MPI_Wtime();
     }
@@ -2421,12 +2679,12 @@ void TMRTriangularize::frontal(TMRMeshOptions options,
     // which will cause problems if we do a conversion to a
     // quadrilateral mesh. This will not do "good" things to the
     // triangularization.
-    node = list_start;
-    while (node) {
-      if (node->tri.status == ACCEPTED) {
-        const uint32_t u = node->tri.u;
-        const uint32_t v = node->tri.v;
-        const uint32_t w = node->tri.w;
+    for (int i = 0; i < num_tri_slots; i++) {
+      TMRTriangle *node = getTriangle(i);
+      if (node->status == ACCEPTED) {
+        const uint32_t u = node->u;
+        const uint32_t v = node->v;
+        const uint32_t w = node->w;
 
         if ((u - FIXED_POINT_OFFSET < init_boundary_points) &&
             (v - FIXED_POINT_OFFSET < init_boundary_points) &&
@@ -2467,7 +2725,6 @@ void TMRTriangularize::frontal(TMRMeshOptions options,
           }
         }
       }
-      node = node->next;
     }
   }
 
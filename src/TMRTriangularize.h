@@ -21,14 +21,16 @@
 #ifndef TMR_TRIANGULARIZE_H
 #define TMR_TRIANGULARIZE_H
 
+#include <vector>
+
 #include "TMRBase.h"
 #include "TMRMesh.h"
 #include "TMRTopology.h"
 
 /*
   The rectangular domain used to define the upper/lower limits of the
-  quadtree. Points cannot be reliably added outside the domain without
-  bad stuff happening.
+  triangularization. Points cannot be reliably added outside the
+  domain without bad stuff happening.
 */
 class TMRQuadDomain {
  public:
@@ -37,64 +39,67 @@ class TMRQuadDomain {
 };
 
 /*
-  The following class implments a simple quadtree data structure for fast
-  geometric searching queries.
-
-  This uses a recursive implementation for searching, adding and deleting
-  nodes from the quadtree. The leafs of the quadtree are of fixed size
-  so that it is not necessary to
+  A flat spatial index of the points for fast closest-point queries.
+
+  The points are stored in a uniform grid of buckets over a bounding
+  box. Each bucket holds a singly-linked list of the point numbers
+  threaded through the next[] array, so that adding and deleting
+  points does not allocate memory. The grid is refined as points are
+  added to keep the number of points per bucket bounded. Points
+  outside the bounding box are kept in a separate short list that is
+  always searched.
 */
-class TMRQuadNode {
+class TMRPointIndex {
  public:
-  static const int MAX_DEPTH = 30;
-  static const int NODES_PER_LEVEL = 10;
-
-  // Create the root in a quadtree
-  TMRQuadNode(TMRQuadDomain *_domain);
+  TMRPointIndex(double _xlow, double _xhigh, double _ylow, double _yhigh,
+                int size_hint);
+  ~TMRPointIndex();
 
-  // Create the root node (or other nodes)
-  ~TMRQuadNode();
-
-  // Add/delete nodes from the quadtree
-  // ----------------------------------
+  // Add/delete points from the index
+  // --------------------------------
   void addNode(uint32_t num, const double pt[]);
-  int deleteNode(uint32_t num, const double pt[]);
+  int deleteNode(uint32_t num);
 
   // Find the closest indexed point to the provided (x,y) location
   // -------------------------------------------------------------
   uint32_t findClosest(const double pt[], double *_dist = NULL);
 
  private:
-  // This is only for creating children
-  TMRQuadNode(TMRQuadDomain *_domain, uint32_t _u, uint32_t _v, int _level);
+  // The target average and maximum number of points per bucket
+  static const int POINTS_PER_BUCKET = 2;
+  static const int MAX_POINTS_PER_BUCKET = 8;
 
-  // Initialize things
-  void initialize(TMRQuadDomain *_domain, uint32_t _u, uint32_t _v, int _level);
+  // Get the bucket containing the point (or -1 if outside the grid)
+  inline int getBucket(double x, double y);
 
-  // The recursive call to the quadtree data structure
-  void findClosest(const double pt[], uint32_t *index, double *dist);
+  // Set the number of buckets and re-insert the points
+  void resize(int nbuckets);
 
-  // The 2D domain
-  TMRQuadDomain *domain;
+  // Search the bucket for a closer point
+  inline void searchBucket(int bucket, const double pt[], uint32_t *index,
+                           double *dist);
 
-  // Keep track of the children - if any
-  TMRQuadNode *low_left, *low_right;
-  TMRQuadNode *up_left, *up_right;
+  // The bounding box of the grid
+  double xlow, xhigh, ylow, yhigh;
 
-  // The level required
-  int level;
+  // The number of buckets in each direction and their inverse size
+  int nx, ny;
+  double xscale, yscale;
 
-  // The u/v location of the lower left-hand corner of the domain
-  // in the parametric space
-  uint32_t u, v;
+  // The first point in each bucket, or -1 if empty
+  int *head;
 
-  // The location at which to split incoming point
-  double x, y;
+  // The point data indexed by the point number
+  int max_num;    // Allocated length of the point arrays
+  int *next;      // Next point in the bucket, or -1
+  int *bucket;    // Bucket containing the point (-1 outside, -2 absent)
+  double *xy;     // The point locations
 
-  // The point numbers and arrays
-  int num_points;
-  uint32_t *pt_nums;
-  double *pts;
+  // The number of points within the grid
+  int num_grid_points;
+
+  // The point numbers outside the grid
+  std::vector<uint32_t> outside;
 };
 
 /*
@@ -157,6 +162,10 @@ class TMRTriangularize : public TMREntity {
   // Write the triangulation to an outputfile
   void writeToVTK(const char *filename, const int param_space = 0);
 
+  // Get the number of point locations found by walking the mesh and
+  // the number that required a search of the point index
+  void getPointLocationCounts(int *_num_walks, int *_num_searches);
+
  private:
   // The Bowyer-Watson algorithm is started with 4 points (2 triangles)
   // that cover the entire domain. These are deleted at the end
@@ -183,6 +192,10 @@ class TMRTriangularize : public TMREntity {
   void addPointToMesh(const double pt[], TMRFace *metric);
   void addPointToMesh(const double pt[], TMRTriangle *tri, TMRFace *metric);
 
+  // Add a set of points to the mesh using a biased randomized
+  // insertion order
+  void addPointsToMesh(int npts, const double inpts[]);
+
   // Get a hash value for the given edge
   inline uint32_t getEdgeHash(uint32_t u, uint32_t v);
 
@@ -216,7 +229,9 @@ class TMRTriangularize : public TMREntity {
                   TMRFace *metric = NULL);
 
   // Find the enclosing triangle
-  void findEnclosing(const double pt[], TMRTriangle **tri);
+  TMRTriangle *walkToEnclosing(const double pt[], TMRTriangle *tri);
+  void findEnclosing(const double pt[], TMRTriangle **tri,
+                     TMRTriangle *hint = NULL);
 
   // Compute the maximum edge length of the triangle
   double computeSizeRatio(uint32_t u, uint32_t v, uint32_t w,
@@ -250,21 +265,35 @@ class TMRTriangularize : public TMREntity {
   int num_pslg_edges;
   uint32_t *pslg_edges;
 
-  // The root of the quadtree data structure
+  // The domain and the spatial index of the points
   TMRQuadDomain domain;
-  TMRQuadNode *root;
+  TMRPointIndex *root;
   uint32_t search_tag;
 
-  // Keep a doubly-linked list to store the added triangles. The list
-  // is doubly-linked facilitate deleting triangles from the list.
-  class TriListNode {
-   public:
-    TMRTriangle tri;           // The actual triangle we've allocated
-    TriListNode *next, *prev;  // Next/previous list entries
-  };
+  // The number of calls to findEnclosing() resolved by walking from
+  // the hint and by searching from the closest point
+  int num_locate_walks;
+  int num_locate_searches;
+
+  // The triangles are stored contiguously in fixed-size blocks so
+  // that pointers to a triangle remain valid as new triangles are
+  // added. Deleted triangles stay in place (marked DELETE_ME) until
+  // deleteTrianglesFromList() compacts the storage, after which the
+  // free slots at the end are recycled for new triangles.
+  static const int TRI_BLOCK_SHIFT = 10;
+  static const int TRI_BLOCK_SIZE = 1 << TRI_BLOCK_SHIFT;
+
+  // Retrieve the triangle in the given slot
+  inline TMRTriangle *getTriangle(int slot) {
+    return &tri_blocks[slot >> TRI_BLOCK_SHIFT][slot & (TRI_BLOCK_SIZE - 1)];
+  }
+
+  // The blocks of triangles
+  int num_tri_blocks, max_tri_blocks;
+  TMRTriangle **tri_blocks;
 
-  // Keep track of the current set of triangles
-  TriListNode *list_start, *list_end;
+  // The number of used triangle slots (including deleted triangles)
+  int num_tri_slots;
 
   // Keep track of the number of triangles
   int num_triangles;
@@ -272,20 +301,24 @@ class TMRTriangularize : public TMREntity {
   // Keep a hash tabled based on the ordered edges of the triangular
   // mesh. The order must match the counter clockwise ordering of the
   // triangle, making the edge to triangle mapping unique. Each
-  // triangle is stored three times within the hash table.
-  class EdgeHashNode {
+  // triangle is stored three times within the hash table. The table
+  // uses open addressing with linear probing, and an entry is empty
+  // when its triangle pointer is NULL.
+  class EdgeHashEntry {
    public:
-    uint32_t u, v;          // The edge indices
-    TriListNode *tri_node;  // Pointer to the node within the triangle list
-    EdgeHashNode *next;     // Next node
+    uint32_t u, v;     // The edge indices
+    TMRTriangle *tri;  // Pointer to the triangle
   };
 
-  // Create the array of hash buckets
-  EdgeHashNode **buckets;
+  // Insert/remove entries from the edge hash table
+  int insertEdge(uint32_t u, uint32_t v, TMRTriangle *tri);
+  TMRTriangle *removeEdge(uint32_t u, uint32_t v);
+  void resizeEdgeHash(uint32_t size);
 
-  // The number of buckets
-  int num_buckets;
-  int num_hash_nodes;
+  // The edge hash table. The size is always a power of two.
+  EdgeHashEntry *edge_hash;
+  uint32_t edge_hash_size;
+  uint32_t num_hash_entries;
 
   // Class to store an edge in a triangle
   class TriEdge {
@@ -23,8 +23,11 @@
 #include <math.h>
 #include <stdio.h>
 
+#include <map>
+
 #include "TMRMesh.h"
 #include "TMRNativeTopology.h"
+#include "TMR_VTKTools.h"
 #include "tmrlapack.h"
 
 #ifdef TMR_USE_NETGEN
@@ -33,6 +36,12 @@
 namespace nglib {
 #include "nglib.h"
 }
+
+#include <pthread.h>
+
+// Netgen uses global state, so only one volume can be meshed at a
+// time within a process
+static pthread_mutex_t tmr_netgen_mutex = PTHREAD_MUTEX_INITIALIZER;
 #endif  // TMR_USE_NETGEN
 
 /*
@@ -62,6 +71,10 @@ TMRVolumeMesh::TMRVolumeMesh(MPI_Comm _comm, TMRVolume *_volume) {
   tet = NULL;
   vars = NULL;
 
+  // The boundary points of the tetrahedral mesh
+  num_bnd_pts = 0;
+  bnd_pts = NULL;
+
   // Set the additional connectivity information that is required for
   // the volume mesh.
   source = target = NULL;
@@ -82,6 +95,9 @@ TMRVolumeMesh::~TMRVolumeMesh() {
   if (vars) {
     delete[] vars;
   }
+  if (bnd_pts) {
+    delete[] bnd_pts;
+  }
   if (swept_faces) {
     for (int k = 0; k < num_swept_faces; k++) {
       swept_faces[k]->decref();
@@ -164,6 +180,40 @@ void TMRVolumeMesh::writeToVTK(const char *filename) {
   }
 }
 
+/*
+  Write the hexahedral or tetrahedral volume mesh to a binary VTK XML
+  file
+*/
+int TMRVolumeMesh::writeToVTU(const char *filename, int use_float32) {
+  int mpi_rank;
+  MPI_Comm_rank(comm, &mpi_rank);
+
+  int fail = 0;
+  if (mpi_rank == 0 && (hex || tet)) {
+    // Write the hexahedra if they exist, otherwise the tetrahedra
+    int ncells = (hex ? num_hex : num_tet);
+    int size = (hex ? 8 : 4);
+    const int *conn = (hex ? hex : tet);
+
+    int *ptr = new int[ncells + 1];
+    int *types = new int[ncells];
+    for (int k = 0; k <= ncells; k++) {
+      ptr[k] = size * k;
+    }
+    for (int k = 0; k < ncells; k++) {
+      types[k] = (hex ? TMR_VTK_HEXAHEDRON : TMR_VTK_TETRA);
+    }
+
+    fail = TMR_WriteVTUFile(MPI_COMM_SELF, filename, num_points, X, ncells,
+                            ptr, conn, types, 0, NULL, NULL, use_float32);
+
+    delete[] ptr;
+    delete[] types;
+  }
+
+  return fail;
+}
+
 /*
   Mesh the volume via sweeping (or tetrahedral meshing)
 */
@@ -696,25 +746,211 @@ int TMRVolumeMesh::getSweptMapping(int source_plane, int dest_plane,
 
 /*
   Create a tetrahedral mesh
+
+  The boundary of the volume is formed from the existing face meshes.
+  The points on the edges and vertices are shared between faces, so
+  the boundary points are first ordered uniquely using the edge and
+  vertex that they lie on. Quadrilaterals in the face meshes are split
+  into two triangles. The triangles are oriented so that their normals
+  point out of the volume and passed to Netgen which fills the
+  interior. The boundary points are the first points in the
+  tetrahedral mesh so that they can be matched to the face node
+  numbers later in setNodeNums().
 */
 int TMRVolumeMesh::tetMesh(TMRMeshOptions options) {
-#ifdef TMR_USE_NETGEN
-  nglib::Ng_Init();
-  nglib::Ng_Mesh *m = nglib::Ng_NewMesh();
-
-  // First count up the total number of unique points that bound this
-  // volume that is about to be meshed
-  int num_boundary_pts = 0;
-
   // Get the faces associated with the volume
   int num_faces;
   TMRFace **faces;
-  const int *face_dir;
-  volume->getFaces(&num_faces, &faces, &face_dir);
+  volume->getFaces(&num_faces, &faces);
+
+  // Check that all of the faces are meshed
+  for (int i = 0; i < num_faces; i++) {
+    TMRFaceMesh *mesh = NULL;
+    faces[i]->getMesh(&mesh);
+    if (!mesh) {
+      fprintf(stderr, "TMRVolumeMesh Error: Face %d is not meshed\n", i);
+      return 1;
+    }
+  }
+
+#ifdef TMR_USE_NETGEN
+  // Count up the number of points and triangles on the faces
+  int ntris = 0;
+  int *face_ptr = new int[num_faces + 1];
+  face_ptr[0] = 0;
+  for (int i = 0; i < num_faces; i++) {
+    TMRFaceMesh *mesh = NULL;
+    faces[i]->getMesh(&mesh);
+
+    int npts;
+    mesh->getMeshPoints(&npts, NULL, NULL);
+    face_ptr[i + 1] = face_ptr[i] + npts;
+    ntris +=
+        mesh->getTriConnectivity(NULL) + 2 * mesh->getQuadConnectivity(NULL);
+  }
+
+  // The index of each face mesh point within the boundary points
+  int *face_pts = new int[face_ptr[num_faces]];
+  for (int i = 0; i < face_ptr[num_faces]; i++) {
+    face_pts[i] = -1;
+  }
+
+  // Keep track of the boundary points on the vertices and edges
+  std::map<TMRVertex *, int> vertex_pts;
+  std::map<std::pair<TMREdge *, int>, int> edge_pts;
+
+  // Order the boundary points uniquely
+  num_bnd_pts = 0;
+  bnd_pts = new int[2 * face_ptr[num_faces]];
+  for (int i = 0; i < num_faces; i++) {
+    TMRFaceMesh *mesh = NULL;
+    faces[i]->getMesh(&mesh);
+    int *fpts = &face_pts[face_ptr[i]];
+
+    // Find the points that lie on the edges of the face
+    int nloops = faces[i]->getNumEdgeLoops();
+    for (int k = 0; k < nloops; k++) {
+      TMREdgeLoop *loop;
+      faces[i]->getEdgeLoop(k, &loop);
+      int nedges;
+      TMREdge **edges;
+      loop->getEdgeLoop(&nedges, &edges, NULL);
+
+      for (int j = 0; j < nedges; j++) {
+        TMREdgeMesh *edge_mesh = NULL;
+        edges[j]->getMesh(&edge_mesh);
+        if (!edge_mesh) {
+          continue;
+        }
+
+        int npts;
+        edge_mesh->getMeshPoints(&npts, NULL, NULL);
+
+        TMRVertex *v1, *v2;
+        edges[j]->getVertices(&v1, &v2);
+
+        for (int ix = 0; ix < npts; ix++) {
+          int index = mesh->getFaceIndexFromEdge(edges[j], ix);
+          if (index < 0 || fpts[index] >= 0) {
+            continue;
+          }
+
+          // Find the boundary point if it already exists
+          int pt = num_bnd_pts;
+          if (ix == 0 || ix == npts - 1) {
+            TMRVertex *v = (ix == 0 ? v1 : v2);
+            std::map<TMRVertex *, int>::iterator it = vertex_pts.find(v);
+            if (it == vertex_pts.end()) {
+              vertex_pts[v] = pt;
+            } else {
+              pt = it->second;
+            }
+          } else {
+            std::pair<TMREdge *, int> key(edges[j], ix);
+            std::map<std::pair<TMREdge *, int>, int>::iterator it =
+                edge_pts.find(key);
+            if (it == edge_pts.end()) {
+              edge_pts[key] = pt;
+            } else {
+              pt = it->second;
+            }
+          }
+
+          // Add the point to the boundary
+          if (pt == num_bnd_pts) {
+            bnd_pts[2 * pt] = i;
+            bnd_pts[2 * pt + 1] = index;
+            num_bnd_pts++;
+          }
+          fpts[index] = pt;
+        }
+      }
+    }
 
-  // Count up the number of boundary nodes for this volume
-  for (int i = 0; i < ; i++) {
-    double pt[3] = {0.0, 0.0, 0.0};
+    // Add the remaining points in the interior of the face
+    for (int index = 0; index < face_ptr[i + 1] - face_ptr[i]; index++) {
+      if (fpts[index] < 0) {
+        bnd_pts[2 * num_bnd_pts] = i;
+        bnd_pts[2 * num_bnd_pts + 1] = index;
+        fpts[index] = num_bnd_pts;
+        num_bnd_pts++;
+      }
+    }
+  }
+
+  // Form the boundary triangles with normals that point out of the
+  // volume
+  int *tris = new int[3 * ntris];
+  int *t = tris;
+  for (int i = 0; i < num_faces; i++) {
+    TMRFaceMesh *mesh = NULL;
+    faces[i]->getMesh(&mesh);
+    const int *fpts = &face_pts[face_ptr[i]];
+
+    const int *quad_local, *tri_local;
+    int nquad_local = mesh->getQuadConnectivity(&quad_local);
+    int ntri_local = mesh->getTriConnectivity(&tri_local);
+
+    for (int j = 0; j < ntri_local; j++, t += 3) {
+      t[0] = fpts[tri_local[3 * j]];
+      t[1] = fpts[tri_local[3 * j + 1]];
+      t[2] = fpts[tri_local[3 * j + 2]];
+    }
+    for (int j = 0; j < nquad_local; j++, t += 6) {
+      const int *q = &quad_local[4 * j];
+      t[0] = fpts[q[0]];
+      t[1] = fpts[q[1]];
+      t[2] = fpts[q[2]];
+      t[3] = fpts[q[0]];
+      t[4] = fpts[q[2]];
+      t[5] = fpts[q[3]];
+    }
+
+    // Flip the orientation of the triangles
+    if (faces[i]->getOrientation() < 0) {
+      for (int *f = t - 3 * (ntri_local + 2 * nquad_local); f < t; f += 3) {
+        int tmp = f[1];
+        f[1] = f[2];
+        f[2] = tmp;
+      }
+    }
+  }
+
+  // Set the boundary point locations
+  TMRPoint *Xbnd = new TMRPoint[num_bnd_pts];
+  for (int k = 0; k < num_bnd_pts; k++) {
+    TMRFaceMesh *mesh = NULL;
+    faces[bnd_pts[2 * k]]->getMesh(&mesh);
+    TMRPoint *Xface;
+    mesh->getMeshPoints(NULL, NULL, &Xface);
+    Xbnd[k] = Xface[bnd_pts[2 * k + 1]];
+  }
+
+  // Set the target element size to the average edge length of the
+  // boundary triangles
+  double htarget = 0.0;
+  for (int i = 0; i < 3 * ntris; i++) {
+    int n1 = tris[i];
+    int n2 = tris[3 * (i / 3) + (i + 1) % 3];
+    double dx = Xbnd[n1].x - Xbnd[n2].x;
+    double dy = Xbnd[n1].y - Xbnd[n2].y;
+    double dz = Xbnd[n1].z - Xbnd[n2].z;
+    htarget += sqrt(dx * dx + dy * dy + dz * dz);
+  }
+  if (ntris > 0) {
+    htarget = htarget / (3 * ntris);
+  }
+
+  pthread_mutex_lock(&tmr_netgen_mutex);
+  nglib::Ng_Init();
+  nglib::Ng_Mesh *m = nglib::Ng_NewMesh();
+
+  // Add the boundary points. Netgen uses a 1-based numbering.
+  for (int i = 0; i < num_bnd_pts; i++) {
+    double pt[3];
+    pt[0] = Xbnd[i].x;
+    pt[1] = Xbnd[i].y;
+    pt[2] = Xbnd[i].z;
     nglib::Ng_AddPoint(m, pt);
   }
 
@@ -724,7 +960,7 @@ int TMRVolumeMesh::tetMesh(TMRMeshOptions options) {
     tri[0] = tris[3 * i] + 1;
     tri[1] = tris[3 * i + 1] + 1;
     tri[2] = tris[3 * i + 2] + 1;
-    nglib::Ng_AddSurfaceElement(m, NG_TRIG, tri);
+    nglib::Ng_AddSurfaceElement(m, nglib::NG_TRIG, tri);
   }
 
   // Set the mesh parameters
@@ -734,38 +970,106 @@ int TMRVolumeMesh::tetMesh(TMRMeshOptions options) {
   mp.second_order = 0;
 
   // Generate the volume mesh
-  nglib::Ng_GenerateVolumeMesh(m, &mp);
-
-  // Get the total number of points and tets in the volume
-  num_points = nglib::Ng_GetNP(m);
-  num_tet = nglib::Ng_GetNE(m);
-
-  // Allocate space to store everything
-  X = new TMRPoint[num_points];
-  tet = new int[4 * num_tet];
-
-  // Retrieve the points
-  for (int i = 0; i < num_points; i++) {
-    double x[3];
-    nglib::Ng_GetPoint(m, i + 1, x);
-    X[i].x = x[0];
-    X[i].y = x[1];
-    X[i].z = x[2];
-  }
+  int fail = 0;
+  if (nglib::Ng_GenerateVolumeMesh(m, &mp) != nglib::NG_OK ||
+      nglib::Ng_GetNP(m) < num_bnd_pts) {
+    fprintf(stderr, "TMRVolumeMesh Error: Tetrahedral meshing failed\n");
+    fail = 1;
+  } else {
+    // Get the total number of points and tets in the volume
+    num_points = nglib::Ng_GetNP(m);
+    num_tet = nglib::Ng_GetNE(m);
+
+    // Allocate space to store everything
+    X = new TMRPoint[num_points];
+    tet = new int[4 * num_tet];
+
+    // Retrieve the points. The boundary points are unchanged.
+    for (int i = 0; i < num_points; i++) {
+      if (i < num_bnd_pts) {
+        X[i] = Xbnd[i];
+      } else {
+        double x[3];
+        nglib::Ng_GetPoint(m, i + 1, x);
+        X[i].x = x[0];
+        X[i].y = x[1];
+        X[i].z = x[2];
+      }
+    }
 
-  // Retrieve the tets
-  for (int i = 0; i < num_tet; i++) {
-    nglib::Ng_GetVolumeElement(m, i + 1, &tet[4 * i]);
-    for (int k = 0; k < 4; k++) {
-      tet[4 * i + k] -= 1;
+    // Retrieve the tets
+    for (int i = 0; i < num_tet; i++) {
+      nglib::Ng_GetVolumeElement(m, i + 1, &tet[4 * i]);
+      for (int k = 0; k < 4; k++) {
+        tet[4 * i + k] -= 1;
+      }
     }
   }
 
   // Free the memory and exit from netgen
   nglib::Ng_DeleteMesh(m);
   nglib::Ng_Exit();
+  pthread_mutex_unlock(&tmr_netgen_mutex);
+
+  delete[] face_ptr;
+  delete[] face_pts;
+  delete[] tris;
+  delete[] Xbnd;
+
+  if (fail) {
+    delete[] bnd_pts;
+    bnd_pts = NULL;
+    num_bnd_pts = 0;
+  }
+
+  return fail;
+#else
+  fprintf(stderr,
+          "TMRVolumeMesh Error: Tetrahedral meshing requires TMR_USE_NETGEN\n");
+  return 1;
 #endif  // TMR_USE_NETGEN
-  return 0;
+}
+
+/*
+  Broadcast the tetrahedral mesh from the root processor to all
+  processors in the communicator.
+
+  This is used when the volume has been meshed independently on the
+  root processor. The node numbers of a tetrahedral mesh only depend
+  on the boundary points and the face meshes, so no other data is
+  required. The communicator stored in the object is replaced by the
+  input communicator.
+
+  input:
+  _comm:   the communicator to distribute the mesh over
+  root:    the rank of the processor that owns the mesh
+*/
+void TMRVolumeMesh::broadcastMesh(MPI_Comm _comm, int root) {
+  comm = _comm;
+
+  int mpi_rank;
+  MPI_Comm_rank(comm, &mpi_rank);
+
+  // Broadcast the mesh sizes to all the processors
+  int temp[3];
+  temp[0] = num_points;
+  temp[1] = num_tet;
+  temp[2] = num_bnd_pts;
+  MPI_Bcast(temp, 3, MPI_INT, root, comm);
+
+  if (mpi_rank != root) {
+    num_points = temp[0];
+    num_tet = temp[1];
+    num_bnd_pts = temp[2];
+
+    X = new TMRPoint[num_points];
+    tet = new int[4 * num_tet];
+    bnd_pts = new int[2 * num_bnd_pts];
+  }
+
+  MPI_Bcast(X, num_points, TMRPoint_MPI_type, root, comm);
+  MPI_Bcast(tet, 4 * num_tet, MPI_INT, root, comm);
+  MPI_Bcast(bnd_pts, 2 * num_bnd_pts, MPI_INT, root, comm);
 }
 
 /*
@@ -776,10 +1080,34 @@ int TMRVolumeMesh::tetMesh(TMRMeshOptions options) {
   code takes into account the orientations of the surrounding surfaces
   by computing the absolute orientations of the surface meshes. The
   orientation of the source/target surfaces is already accounted for
-  within the connectivity.
+  within the connectivity. For a tetrahedral mesh, the boundary points
+  take their numbers from the face meshes instead.
 */
 int TMRVolumeMesh::setNodeNums(int *num) {
-  if (!vars) {
+  if (!vars && tet) {
+    vars = new int[num_points];
+
+    // Take the boundary node numbers from the face meshes
+    int num_faces;
+    TMRFace **faces;
+    volume->getFaces(&num_faces, &faces);
+    for (int k = 0; k < num_bnd_pts; k++) {
+      TMRFaceMesh *mesh = NULL;
+      faces[bnd_pts[2 * k]]->getMesh(&mesh);
+
+      const int *face_vars;
+      mesh->getNodeNums(&face_vars);
+      vars[k] = face_vars[bnd_pts[2 * k + 1]];
+    }
+
+    // Order the interior points
+    for (int k = num_bnd_pts; k < num_points; k++) {
+      vars[k] = *num;
+      (*num)++;
+    }
+
+    return num_points - num_bnd_pts;
+  } else if (!vars) {
     // Initially, set all of the nodes to zero
     vars = new int[num_points];
     for (int k = 0; k < num_points; k++) {
@@ -913,3 +1241,14 @@ int TMRVolumeMesh::getNodeNums(const int **_vars) {
   }
   return num_points;
 }
+
+/*
+  Replace the node numbers with new numbers from the global ordering
+*/
+void TMRVolumeMesh::renumberNodes(const int *new_nums) {
+  if (vars) {
+    for (int i = 0; i < num_points; i++) {
+      vars[i] = new_nums[vars[i]];
+    }
+  }
+}
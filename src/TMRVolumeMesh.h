@@ -48,9 +48,14 @@ class TMRVolumeMesh : public TMREntity {
   // Order the mesh points uniquely
   int setNodeNums(int *num);
   int getNodeNums(const int **_vars);
+  void renumberNodes(const int *new_nums);
 
   // Write the volume mesh to a VTK file
   void writeToVTK(const char *filename);
+  int writeToVTU(const char *filename, int use_float32 = 1);
+
+  // Distribute a tetrahedral mesh from the processor that created it
+  void broadcastMesh(MPI_Comm _comm, int root);
 
  private:
   // Create a tetrahedral mesh (if possible)
@@ -93,6 +98,12 @@ class TMRVolumeMesh : public TMREntity {
   // Tetrahedral mesh information
   int num_tet;
   int *tet;
+
+  // The boundary points of the tetrahedral mesh. Each point is stored
+  // as a pair of the face index within the volume and the index of
+  // the point within the face mesh.
+  int num_bnd_pts;
+  int *bnd_pts;
 };
 
 #endif  // TMR_VOLUME_MESH_H
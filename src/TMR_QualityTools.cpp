@@ -0,0 +1,349 @@
+/*
+  This file is part of the package TMR for adaptive mesh refinement.
+
+  Copyright (C) 2015 Georgia Tech Research Corporation.
+  Additional copyright (C) 2015 Graeme Kennedy.
+  All rights reserved.
+
+  TMR is licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this software except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "TMR_QualityTools.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+  Compare integers for bsearch
+*/
+static int compare_integers(const void *a, const void *b) {
+  return (*(int *)a - *(int *)b);
+}
+
+/*
+  Compute the cross product c = a x b
+*/
+static inline void TMRCrossProduct(const TMRPoint &a, const TMRPoint &b,
+                                   TMRPoint *c) {
+  c->x = a.y * b.z - a.z * b.y;
+  c->y = a.z * b.x - a.x * b.z;
+  c->z = a.x * b.y - a.y * b.x;
+}
+
+/*
+  Compute the deviation of the angle between the edges a and b from a
+  right angle
+*/
+static double TMRRightAngleDeviation(const TMRPoint &a, const TMRPoint &b) {
+  double prod = sqrt(a.dot(a) * b.dot(b));
+  if (prod <= 0.0) {
+    return 0.5 * M_PI;
+  }
+  double beta = a.dot(b) / prod;
+  if (beta < -1.0) {
+    beta = -1.0;
+  }
+  if (beta > 1.0) {
+    beta = 1.0;
+  }
+  return fabs(0.5 * M_PI - acos(beta));
+}
+
+/*
+  Compute the quality metrics for a quadrilateral or hexahedral
+  element
+*/
+void TMR_ComputeElementQuality(int num_corners, const TMRPoint X[],
+                               double quality[]) {
+  double jac = 1.0;
+  double max_dev = 0.0;
+  double hmin = 0.0, hmax = 0.0;
+
+  if (num_corners == 4) {
+    // Compute the element normal from the diagonals
+    TMRPoint d1, d2, n;
+    d1.x = X[2].x - X[0].x;
+    d1.y = X[2].y - X[0].y;
+    d1.z = X[2].z - X[0].z;
+    d2.x = X[3].x - X[1].x;
+    d2.y = X[3].y - X[1].y;
+    d2.z = X[3].z - X[1].z;
+    TMRCrossProduct(d1, d2, &n);
+    double nrm = sqrt(n.dot(n));
+
+    for (int k = 0; k < 4; k++) {
+      int next = (k + 1) % 4;
+      int prev = (k + 3) % 4;
+
+      TMRPoint a, b;
+      a.x = X[next].x - X[k].x;
+      a.y = X[next].y - X[k].y;
+      a.z = X[next].z - X[k].z;
+      b.x = X[prev].x - X[k].x;
+      b.y = X[prev].y - X[k].y;
+      b.z = X[prev].z - X[k].z;
+
+      // Compute the scaled Jacobian at this corner
+      TMRPoint c;
+      TMRCrossProduct(a, b, &c);
+      double prod = nrm * sqrt(a.dot(a) * b.dot(b));
+      double val = (prod > 0.0 ? c.dot(n) / prod : 0.0);
+      if (val < jac) {
+        jac = val;
+      }
+
+      double dev = TMRRightAngleDeviation(a, b);
+      if (dev > max_dev) {
+        max_dev = dev;
+      }
+
+      double h = sqrt(a.dot(a));
+      if (k == 0 || h < hmin) {
+        hmin = h;
+      }
+      if (k == 0 || h > hmax) {
+        hmax = h;
+      }
+    }
+  } else {
+    for (int k = 0; k < 8; k++) {
+      // Find the adjacent corners along the three edges that form a
+      // right-handed system at this corner
+      int c1, c2, c3;
+      if (k < 4) {
+        c1 = (k + 1) % 4;
+        c2 = (k + 3) % 4;
+        c3 = k + 4;
+      } else {
+        c1 = (k + 3) % 4 + 4;
+        c2 = (k + 1) % 4 + 4;
+        c3 = k - 4;
+      }
+
+      TMRPoint a, b, c;
+      a.x = X[c1].x - X[k].x;
+      a.y = X[c1].y - X[k].y;
+      a.z = X[c1].z - X[k].z;
+      b.x = X[c2].x - X[k].x;
+      b.y = X[c2].y - X[k].y;
+      b.z = X[c2].z - X[k].z;
+      c.x = X[c3].x - X[k].x;
+      c.y = X[c3].y - X[k].y;
+      c.z = X[c3].z - X[k].z;
+
+      // Compute the scaled Jacobian at this corner
+      TMRPoint t;
+      TMRCrossProduct(a, b, &t);
+      double prod = sqrt(a.dot(a) * b.dot(b) * c.dot(c));
+      double val = (prod > 0.0 ? t.dot(c) / prod : 0.0);
+      if (val < jac) {
+        jac = val;
+      }
+
+      // Each corner is shared by three faces
+      double dev = TMRRightAngleDeviation(a, b);
+      if (dev > max_dev) {
+        max_dev = dev;
+      }
+      dev = TMRRightAngleDeviation(b, c);
+      if (dev > max_dev) {
+        max_dev = dev;
+      }
+      dev = TMRRightAngleDeviation(c, a);
+      if (dev > max_dev) {
+        max_dev = dev;
+      }
+
+      // Each edge is counted from both of its corners
+      double h = sqrt(a.dot(a));
+      if (k == 0 || h < hmin) {
+        hmin = h;
+      }
+      if (k == 0 || h > hmax) {
+        hmax = h;
+      }
+      h = sqrt(c.dot(c));
+      if (h < hmin) {
+        hmin = h;
+      }
+      if (h > hmax) {
+        hmax = h;
+      }
+    }
+  }
+
+  quality[TMR_SCALED_JACOBIAN] = jac;
+  quality[TMR_ASPECT_RATIO] = (hmax > 0.0 ? hmin / hmax : 0.0);
+  quality[TMR_SKEW] = 1.0 - (2.0 / M_PI) * max_dev;
+  if (quality[TMR_SKEW] < 0.0) {
+    quality[TMR_SKEW] = 0.0;
+  }
+}
+
+/*
+  The data for the quality histograms of a range of elements
+*/
+class TMRQualityThreadData {
+ public:
+  int start, end;
+  int num_corners;
+  const int *conn;
+  int conn_stride;
+  const int *corner_offset;
+  int num_nodes;
+  const int *node_numbers;
+  const TMRPoint *X;
+  int nbins;
+
+  // The histogram and minimum quality computed by this thread
+  int *hist;
+  double min_quality[TMR_NUM_QUALITY_METRICS];
+};
+
+/*
+  Add the quality metrics of the elements elem[start:end] to the
+  histograms of the thread
+*/
+static void *TMRComputeQualityThread(void *args) {
+  TMRQualityThreadData *data = static_cast<TMRQualityThreadData *>(args);
+
+  const int nbins = data->nbins;
+  for (int j = 0; j < TMR_NUM_QUALITY_METRICS; j++) {
+    data->min_quality[j] = 1.0;
+  }
+
+  for (int i = data->start; i < data->end; i++) {
+    const int *c = &data->conn[data->conn_stride * i];
+
+    TMRPoint Xc[8];
+    for (int k = 0; k < data->num_corners; k++) {
+      int node = c[data->corner_offset[k]];
+      if (data->node_numbers) {
+        const int *item =
+            (const int *)bsearch(&node, data->node_numbers, data->num_nodes,
+                                 sizeof(int), compare_integers);
+        node = (item ? item - data->node_numbers : -1);
+      }
+      if (node >= 0) {
+        Xc[k] = data->X[node];
+      } else {
+        Xc[k].x = Xc[k].y = Xc[k].z = 0.0;
+      }
+    }
+
+    double quality[TMR_NUM_QUALITY_METRICS];
+    TMR_ComputeElementQuality(data->num_corners, Xc, quality);
+
+    for (int j = 0; j < TMR_NUM_QUALITY_METRICS; j++) {
+      if (quality[j] < data->min_quality[j]) {
+        data->min_quality[j] = quality[j];
+      }
+
+      int k = (int)(nbins * quality[j]);
+      if (k < 0) {
+        k = 0;
+      } else if (k >= nbins) {
+        k = nbins - 1;
+      }
+      data->hist[nbins * j + k]++;
+    }
+  }
+
+  return NULL;
+}
+
+/*
+  Compute histograms of the element quality metrics for a mesh
+*/
+int TMR_ComputeMeshQuality(MPI_Comm comm, int num_threads, int num_elements,
+                           int num_corners, const int *conn, int conn_stride,
+                           const int corner_offset[], int num_nodes,
+                           const int *node_numbers, const TMRPoint *X,
+                           int nbins, int hist[], double min_quality[]) {
+  const int size = TMR_NUM_QUALITY_METRICS * nbins;
+
+  int nthreads = num_threads;
+  if (nthreads > num_elements) {
+    nthreads = num_elements;
+  }
+  if (nthreads < 1) {
+    nthreads = 1;
+  }
+
+  // Compute the histograms for contiguous ranges of the elements
+  TMRQualityThreadData *data = new TMRQualityThreadData[nthreads];
+  int *thread_hist = new int[nthreads * size];
+  memset(thread_hist, 0, nthreads * size * sizeof(int));
+  for (int k = 0; k < nthreads; k++) {
+    data[k].start = (int)(((long int)k * num_elements) / nthreads);
+    data[k].end = (int)(((long int)(k + 1) * num_elements) / nthreads);
+    data[k].num_corners = num_corners;
+    data[k].conn = conn;
+    data[k].conn_stride = conn_stride;
+    data[k].corner_offset = corner_offset;
+    data[k].num_nodes = num_nodes;
+    data[k].node_numbers = node_numbers;
+    data[k].X = X;
+    data[k].nbins = nbins;
+    data[k].hist = &thread_hist[k * size];
+  }
+
+  if (nthreads > 1) {
+    pthread_t *threads = new pthread_t[nthreads];
+    for (int k = 0; k < nthreads; k++) {
+      pthread_create(&threads[k], NULL, TMRComputeQualityThread,
+                     (void *)&data[k]);
+    }
+    for (int k = 0; k < nthreads; k++) {
+      pthread_join(threads[k], NULL);
+    }
+    delete[] threads;
+  } else {
+    TMRComputeQualityThread((void *)&data[0]);
+  }
+
+  // Sum the contributions from each thread
+  int *local_hist = new int[size];
+  memset(local_hist, 0, size * sizeof(int));
+  double local_min[TMR_NUM_QUALITY_METRICS];
+  for (int j = 0; j < TMR_NUM_QUALITY_METRICS; j++) {
+    local_min[j] = 1.0;
+  }
+  for (int k = 0; k < nthreads; k++) {
+    for (int i = 0; i < size; i++) {
+      local_hist[i] += data[k].hist[i];
+    }
+    for (int j = 0; j < TMR_NUM_QUALITY_METRICS; j++) {
+      if (data[k].min_quality[j] < local_min[j]) {
+        local_min[j] = data[k].min_quality[j];
+      }
+    }
+  }
+  delete[] data;
+  delete[] thread_hist;
+
+  // Reduce the histograms and the minimum values across processors
+  MPI_Allreduce(local_hist, hist, size, MPI_INT, MPI_SUM, comm);
+  if (min_quality) {
+    MPI_Allreduce(local_min, min_quality, TMR_NUM_QUALITY_METRICS,
+                  MPI_DOUBLE, MPI_MIN, comm);
+  }
+  delete[] local_hist;
+
+  int num_total = 0;
+  MPI_Allreduce(&num_elements, &num_total, 1, MPI_INT, MPI_SUM, comm);
+
+  return num_total;
+}
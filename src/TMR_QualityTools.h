@@ -0,0 +1,108 @@
+/*
+  This file is part of the package TMR for adaptive mesh refinement.
+
+  Copyright (C) 2015 Georgia Tech Research Corporation.
+  Additional copyright (C) 2015 Graeme Kennedy.
+  All rights reserved.
+
+  TMR is licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this software except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef TMR_QUALITY_TOOLS_H
+#define TMR_QUALITY_TOOLS_H
+
+#include "TMRBase.h"
+
+/*
+  The element quality metrics
+
+  Each metric is scaled so that an ideal element has a quality of one:
+
+  TMR_SCALED_JACOBIAN: The minimum over the element corners of the
+  Jacobian determinant formed from the unit edge vectors at the
+  corner. This is negative for inverted elements.
+
+  TMR_ASPECT_RATIO: The ratio of the shortest to the longest edge of
+  the element (the inverse of the aspect ratio).
+
+  TMR_SKEW: One minus the maximum deviation of the corner angles of
+  the element faces from a right angle, scaled by 2/pi.
+*/
+enum TMRQualityMetric {
+  TMR_SCALED_JACOBIAN = 0,
+  TMR_ASPECT_RATIO = 1,
+  TMR_SKEW = 2,
+  TMR_NUM_QUALITY_METRICS = 3
+};
+
+/*
+  Compute the quality metrics for a quadrilateral or hexahedral
+  element
+
+  The corners are given in the VTK order: counter-clockwise around
+  the quadrilateral, or counter-clockwise around the bottom face of
+  the hexahedron followed by the corresponding corners of the top
+  face.
+
+  input:
+  num_corners:  the number of corners (4 or 8)
+  X:            the corner locations
+
+  output:
+  quality:      the TMR_NUM_QUALITY_METRICS quality values
+*/
+void TMR_ComputeElementQuality(int num_corners, const TMRPoint X[],
+                               double quality[]);
+
+/*
+  Compute histograms of the element quality metrics for a mesh
+
+  The elements are split across the threads on each processor and the
+  histograms are summed across the communicator. The connectivity of
+  each element is stored with a fixed stride and the corners are
+  located at the given offsets, listed in the VTK order. When the
+  node numbers are provided, the connectivity contains global node
+  numbers that are located within the sorted node_numbers array to
+  find the index of the point, otherwise the connectivity contains
+  the point indices directly.
+
+  Each histogram has nbins uniform bins over [0, 1], ordered by
+  metric. Elements with a quality below zero are added to the first
+  bin.
+
+  input:
+  comm:           the communicator
+  num_threads:    the number of threads on each processor
+  num_elements:   the number of elements on this processor
+  num_corners:    the number of corners per element (4 or 8)
+  conn:           the element connectivity
+  conn_stride:    the number of connectivity entries per element
+  corner_offset:  the offsets of the corners within each element
+  num_nodes:      the number of node numbers
+  node_numbers:   the sorted node numbers (may be NULL)
+  X:              the point locations
+  nbins:          the number of bins
+
+  output:
+  hist:           the TMR_NUM_QUALITY_METRICS*nbins histogram entries
+  min_quality:    the minimum value of each metric (may be NULL)
+
+  returns:        the number of elements in the mesh
+*/
+int TMR_ComputeMeshQuality(MPI_Comm comm, int num_threads, int num_elements,
+                           int num_corners, const int *conn, int conn_stride,
+                           const int corner_offset[], int num_nodes,
+                           const int *node_numbers, const TMRPoint *X,
+                           int nbins, int hist[], double min_quality[]);
+
+#endif  // TMR_QUALITY_TOOLS_H
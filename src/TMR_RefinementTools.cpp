@@ -28,11 +28,52 @@
 #include <string>
 
 // Include for writing output file
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+/*
+  The data required to compute the local rows of the interpolation
+  between two levels of the multigrid hierarchy
+*/
+class TMRInterpLevel {
+ public:
+  TMROctForest *fine, *coarse;
+  TACSBVecInterp *interp;
+  int *oct_ptr;
+  TMROctantArray *ext_array;
+};
+
+/*
+  The range of levels handled by each thread
+*/
+class TMRInterpThreadData {
+ public:
+  TMRInterpLevel *levels;
+  int start, end;
+};
+
+/*
+  Compute the local rows of the interpolation for a range of levels
+*/
+static void *computeLocalInterpThread(void *arg) {
+  TMRInterpThreadData *data = static_cast<TMRInterpThreadData *>(arg);
+  for (int i = data->start; i < data->end; i++) {
+    TMRInterpLevel *level = &data->levels[i];
+    level->ext_array = level->fine->computeLocalInterpolation(
+        level->coarse, level->interp, level->oct_ptr);
+  }
+  return NULL;
+}
+
 /*
   Create a multgrid object for a forest of octrees
+
+  The interpolation operators between all levels are created together.
+  The local rows for each pair of forests do not require communication
+  and are computed concurrently using the number of threads set on the
+  finest forest. The exchange of the remaining rows and the
+  initialization of each operator are then performed level by level.
 */
 void TMR_CreateTACSMg(int num_levels, TACSAssembler *assembler[],
                       TMROctForest *forest[], TACSMg **_mg, double omega,
@@ -52,13 +93,64 @@ void TMR_CreateTACSMg(int num_levels, TACSAssembler *assembler[],
       new TACSMg(comm, num_levels, omega, mg_smooth_iters, mg_sor_symm);
 
   // Create the intepolation/restriction objects between mesh levels
+  // and add any recorded interpolation rows
+  int mpi_size;
+  MPI_Comm_size(comm, &mpi_size);
+  TACSBVecInterp **interps = new TACSBVecInterp *[num_levels];
+  TMRInterpLevel *levels = new TMRInterpLevel[num_levels];
+  int num_local = 0;
   for (int level = 0; level < num_levels - 1; level++) {
-    // Create the interpolation object
-    TACSBVecInterp *interp =
-        new TACSBVecInterp(assembler[level + 1], assembler[level]);
+    interps[level] = new TACSBVecInterp(assembler[level + 1], assembler[level]);
+    if (!forest[level]->beginInterpolation(forest[level + 1],
+                                           interps[level])) {
+      levels[num_local].fine = forest[level];
+      levels[num_local].coarse = forest[level + 1];
+      levels[num_local].interp = interps[level];
+      levels[num_local].oct_ptr = new int[mpi_size + 1];
+      levels[num_local].ext_array = NULL;
+      num_local++;
+    }
+  }
 
-    // Set the interpolation
-    forest[level]->createInterpolation(forest[level + 1], interp);
+  // Compute the local interpolation rows for all levels concurrently
+  int num_threads = forest[0]->getNumThreads();
+  if (num_threads > num_local) {
+    num_threads = num_local;
+  }
+  if (num_threads > 1) {
+    TMRInterpThreadData *data = new TMRInterpThreadData[num_threads];
+    pthread_t *threads = new pthread_t[num_threads];
+    for (int k = 0; k < num_threads; k++) {
+      data[k].levels = levels;
+      data[k].start = (k * num_local) / num_threads;
+      data[k].end = ((k + 1) * num_local) / num_threads;
+      pthread_create(&threads[k], NULL, computeLocalInterpThread,
+                     (void *)&data[k]);
+    }
+    for (int k = 0; k < num_threads; k++) {
+      pthread_join(threads[k], NULL);
+    }
+    delete[] threads;
+    delete[] data;
+  } else if (num_local > 0) {
+    TMRInterpThreadData data;
+    data.levels = levels;
+    data.start = 0;
+    data.end = num_local;
+    computeLocalInterpThread((void *)&data);
+  }
+
+  // Exchange the remaining rows. These calls are collective so they
+  // must be made in the same order on all processors.
+  for (int i = 0; i < num_local; i++) {
+    levels[i].fine->endInterpolation(levels[i].coarse, levels[i].interp,
+                                     levels[i].ext_array, levels[i].oct_ptr);
+    delete[] levels[i].oct_ptr;
+  }
+  delete[] levels;
+
+  for (int level = 0; level < num_levels - 1; level++) {
+    TACSBVecInterp *interp = interps[level];
 
     // Initialize the interpolation
     interp->initialize();
@@ -80,6 +172,8 @@ void TMR_CreateTACSMg(int num_levels, TACSAssembler *assembler[],
     }
   }
 
+  delete[] interps;
+
   if (use_coarse_direct_solve) {
     // Set the lowest level - with no interpolation object
     mg->setLevel(num_levels - 1, assembler[num_levels - 1], NULL, 1,
@@ -279,6 +373,35 @@ static int getNum3dEnrich(int order) {
   return 15;
 }
 
+/*
+  Set the tensor-product grid of parametric points formed from the
+  given knots. The first parametric direction varies fastest so that
+  point (i, j, k) matches the local node ordering within an element.
+  These point sets are used to look up the tabulated shape functions.
+*/
+static void getTensorKnots2D(const int order, const double knots[],
+                             double pts[]) {
+  for (int j = 0; j < order; j++) {
+    for (int i = 0; i < order; i++, pts += 2) {
+      pts[0] = knots[i];
+      pts[1] = knots[j];
+    }
+  }
+}
+
+static void getTensorKnots3D(const int order, const double knots[],
+                             double pts[]) {
+  for (int k = 0; k < order; k++) {
+    for (int j = 0; j < order; j++) {
+      for (int i = 0; i < order; i++, pts += 3) {
+        pts[0] = knots[i];
+        pts[1] = knots[j];
+        pts[2] = knots[k];
+      }
+    }
+  }
+}
+
 /*
   Evaluate the enrichment function for a second-order shell problem
 */
@@ -641,46 +764,75 @@ static void eval3rdEnrichmentFuncs3D(const double pt[], double N[], double Na[],
 }
 
 /*
-  Given the values of the derivatives of one component of the
-  displacement or rotation field at the nodes, compute the
-  reconstruction over the element by solving a least-squares problem
-
-  input:
-  Xpts:    the element node locations
-  uvals:   the solution at the nodes
-  uderiv:  the derivative of the solution in x/y/z at the nodes
+  The tabulated data for the element reconstruction problem
 
-  output:
-  ubar:    the values of the coefficients on the enrichment functions
+  The reconstruction is computed at the knots of the original mesh.
+  The shape functions of both meshes and the enrichment functions at
+  these points, as well as the values at the knots of the refined
+  mesh, are the same for every element. They are evaluated once for
+  each pair of meshes and shared by all element solves.
 */
-static void computeElemRecon2D(const int vars_per_node, TMRQuadForest *forest,
-                               TMRQuadForest *refined_forest,
-                               const TacsScalar Xpts[],
-                               const TacsScalar uvals[],
-                               const TacsScalar uderiv[], TacsScalar ubar[],
-                               TacsScalar *tmp) {
-  // Get information about the interpolation
-  const double *knots, *refined_knots;
-  const int order = forest->getInterpKnots(&knots);
-  const int refined_order = refined_forest->getInterpKnots(&refined_knots);
+class TMRReconTables {
+ public:
+  TMRReconTables(int _dim, int _order, int _refined_order, int _nenrich,
+                 int _size, int _refined_size) {
+    dim = _dim;
+    order = _order;
+    refined_order = _refined_order;
+    nenrich = _nenrich;
+    size = _size;
+    refined_size = _refined_size;
+
+    npts = order * order;
+    num_refined_pts = refined_order * refined_order;
+    if (dim == 3) {
+      npts *= order;
+      num_refined_pts *= refined_order;
+    }
+    neq = dim * npts;
+
+    wts = new double[npts];
+    Nd = new double[dim * npts * size];
+    Nd_refined = new double[dim * npts * refined_size];
+    Nrd = new double[dim * npts * nenrich];
+    N_refined = new double[num_refined_pts * size];
+    Nr_refined = new double[num_refined_pts * nenrich];
+  }
+  ~TMRReconTables() {
+    delete[] wts;
+    delete[] Nd;
+    delete[] Nd_refined;
+    delete[] Nrd;
+    delete[] N_refined;
+    delete[] Nr_refined;
+  }
 
-  // The number of enrichment functions
-  const int nenrich = getNum2dEnrich(order);
+  // The dimension, orders and number of enrichment functions
+  int dim, order, refined_order, nenrich;
 
-  // The number of equations
-  const int neq = 2 * order * order;
+  // The number of nodes in the original and refined elements
+  int size, refined_size;
 
-  // The number of derivatives per node
-  const int deriv_per_node = 3 * vars_per_node;
+  // The number of knots, refined knots and equations
+  int npts, num_refined_pts, neq;
 
-  // Set up the least squares problem at the nodes
-  int nrhs = vars_per_node;
+  // The weights of the equations at each knot
+  double *wts;
 
-  TacsScalar *A = &tmp[0];
-  TacsScalar *b = &tmp[nenrich * neq];
+  // The shape function derivatives at the knots on both meshes
+  double *Nd, *Nd_refined;
+
+  // The enrichment function derivatives at the knots
+  double *Nrd;
+
+  // The shape and enrichment functions at the refined knots
+  double *N_refined, *Nr_refined;
+};
 
-  // Set the weighs
-  double wvals[4];
+/*
+  Set the weights of the reconstruction equations at the knots
+*/
+static void getReconWeights(const int order, double wvals[]) {
   if (order == 2) {
     wvals[0] = wvals[1] = 1.0;
   } else if (order == 3) {
@@ -690,98 +842,163 @@ static void computeElemRecon2D(const int vars_per_node, TMRQuadForest *forest,
     wvals[0] = wvals[3] = 0.5;
     wvals[1] = wvals[2] = 1.0;
   }
+}
 
-  for (int c = 0, jj = 0; jj < order; jj++) {
-    for (int ii = 0; ii < order; ii++, c += 2) {
-      // Set the parametric location within the element
-      double pt[2];
-      pt[0] = knots[ii];
-      pt[1] = knots[jj];
-
-      // Compute the element shape functions at this point
-      double N[MAX_ORDER * MAX_ORDER];
-      double Na[MAX_ORDER * MAX_ORDER], Nb[MAX_ORDER * MAX_ORDER];
-      refined_forest->evalInterp(pt, N, Na, Nb);
-
-      // Evaluate the Jacobian transformation at this point
-      TacsScalar Xd[9], J[9];
-      computeJacobianTrans2D(Xpts, Na, Nb, Xd, J,
-                             refined_order * refined_order);
-
-      // Normalize the first direction
-      TacsScalar d1[3], d2[3];
-      d1[0] = Xd[0];
-      d1[1] = Xd[1];
-      d1[2] = Xd[2];
-      vec3Normalize(d1);
+/*
+  Create the tabulated data for the 2D reconstruction problem
+*/
+static TMRReconTables *createReconTables2D(TMRQuadForest *forest,
+                                           TMRQuadForest *refined_forest) {
+  const double *knots, *refined_knots;
+  const int order = forest->getInterpKnots(&knots);
+  const int refined_order = refined_forest->getInterpKnots(&refined_knots);
+  const int nenrich = getNum2dEnrich(order);
+  const int npts = order * order;
+  const int num_refined_pts = refined_order * refined_order;
+
+  // Retrieve the shape function derivatives on both meshes at the
+  // knot locations of the original mesh
+  double pts[2 * MAX_ORDER * MAX_ORDER];
+  getTensorKnots2D(order, knots, pts);
+  const double *Na, *Nb, *Na_refined, *Nb_refined;
+  const int refined_size = refined_forest->getInterpTable(
+      npts, pts, NULL, &Na_refined, &Nb_refined);
+  const int size = forest->getInterpTable(npts, pts, NULL, &Na, &Nb);
+
+  TMRReconTables *tables =
+      new TMRReconTables(2, order, refined_order, nenrich, size, refined_size);
+  memcpy(tables->Nd_refined, Na_refined, npts * refined_size * sizeof(double));
+  memcpy(&tables->Nd_refined[npts * refined_size], Nb_refined,
+         npts * refined_size * sizeof(double));
+
+  // Look up the table again since the previous call may have replaced
+  // the most recent table
+  forest->getInterpTable(npts, pts, NULL, &Na, &Nb);
+  memcpy(tables->Nd, Na, npts * size * sizeof(double));
+  memcpy(&tables->Nd[npts * size], Nb, npts * size * sizeof(double));
+
+  // Set the weights and evaluate the enrichment function derivatives
+  double wvals[MAX_ORDER];
+  getReconWeights(order, wvals);
+  for (int jj = 0; jj < order; jj++) {
+    for (int ii = 0; ii < order; ii++) {
+      const int p = ii + order * jj;
+      tables->wts[p] = wvals[ii] * wvals[jj];
 
-      // Compute d2 = n x d1
-      crossProduct(&Xd[6], d1, d2);
+      double Nr[MAX_2D_ENRICH];
+      evalEnrichmentFuncs2D(order, &pts[2 * p], knots, Nr,
+                            &tables->Nrd[nenrich * p],
+                            &tables->Nrd[nenrich * (npts + p)]);
+    }
+  }
 
-      // First, compute the contributions to the righ-hand-side. The
-      // right vector contains the difference between the prescribed
-      // derivative and the contribution to the derivative from the
-      // quadratic shape function terms
-      const TacsScalar *ud = &uderiv[deriv_per_node * (ii + order * jj)];
+  // Evaluate the shape and enrichment functions at the refined knots
+  double *refined_pts = new double[2 * num_refined_pts];
+  getTensorKnots2D(refined_order, refined_knots, refined_pts);
+  const double *N_table;
+  forest->getInterpTable(num_refined_pts, refined_pts, &N_table);
+  memcpy(tables->N_refined, N_table, num_refined_pts * size * sizeof(double));
+  for (int p = 0; p < num_refined_pts; p++) {
+    evalEnrichmentFuncs2D(order, &refined_pts[2 * p], knots,
+                          &tables->Nr_refined[nenrich * p]);
+  }
+  delete[] refined_pts;
 
-      for (int k = 0; k < vars_per_node; k++) {
-        b[neq * k + c] = wvals[ii] * wvals[jj] *
-                         (d1[0] * ud[0] + d1[1] * ud[1] + d1[2] * ud[2]);
-        b[neq * k + c + 1] = wvals[ii] * wvals[jj] *
-                             (d2[0] * ud[0] + d2[1] * ud[1] + d2[2] * ud[2]);
-        ud += 3;
-      }
+  return tables;
+}
 
-      // Evaluate the interpolation on the original mesh
-      forest->evalInterp(pt, N, Na, Nb);
+/*
+  Create the tabulated data for the 3D reconstruction problem
+*/
+static TMRReconTables *createReconTables3D(TMROctForest *forest,
+                                           TMROctForest *refined_forest) {
+  const double *knots, *refined_knots;
+  const int order = forest->getInterpKnots(&knots);
+  const int refined_order = refined_forest->getInterpKnots(&refined_knots);
+  const int nenrich = getNum3dEnrich(order);
+  const int npts = order * order * order;
+  const int num_refined_pts = refined_order * refined_order * refined_order;
+
+  // Retrieve the shape function derivatives on both meshes at the
+  // knot locations of the original mesh
+  double pts[3 * MAX_ORDER * MAX_ORDER * MAX_ORDER];
+  getTensorKnots3D(order, knots, pts);
+  const double *Na, *Nb, *Nc, *Na_refined, *Nb_refined, *Nc_refined;
+  const int refined_size = refined_forest->getInterpTable(
+      npts, pts, NULL, &Na_refined, &Nb_refined, &Nc_refined);
+  const int size = forest->getInterpTable(npts, pts, NULL, &Na, &Nb, &Nc);
+
+  TMRReconTables *tables =
+      new TMRReconTables(3, order, refined_order, nenrich, size, refined_size);
+  const int rlen = npts * refined_size;
+  memcpy(tables->Nd_refined, Na_refined, rlen * sizeof(double));
+  memcpy(&tables->Nd_refined[rlen], Nb_refined, rlen * sizeof(double));
+  memcpy(&tables->Nd_refined[2 * rlen], Nc_refined, rlen * sizeof(double));
+
+  // Look up the table again since the previous call may have replaced
+  // the most recent table
+  forest->getInterpTable(npts, pts, NULL, &Na, &Nb, &Nc);
+  const int len = npts * size;
+  memcpy(tables->Nd, Na, len * sizeof(double));
+  memcpy(&tables->Nd[len], Nb, len * sizeof(double));
+  memcpy(&tables->Nd[2 * len], Nc, len * sizeof(double));
+
+  // Set the weights and evaluate the enrichment function derivatives
+  double wvals[MAX_ORDER];
+  getReconWeights(order, wvals);
+  for (int kk = 0; kk < order; kk++) {
+    for (int jj = 0; jj < order; jj++) {
+      for (int ii = 0; ii < order; ii++) {
+        const int p = ii + order * jj + order * order * kk;
+        tables->wts[p] = wvals[ii] * wvals[jj] * wvals[kk];
 
-      // Add the contribution from the nodes
-      for (int k = 0; k < vars_per_node; k++) {
-        // Evaluate the derivatives along the parametric directions
-        TacsScalar Ua = 0.0, Ub = 0.0;
-        for (int i = 0; i < order * order; i++) {
-          Ua += uvals[vars_per_node * i + k] * Na[i];
-          Ub += uvals[vars_per_node * i + k] * Nb[i];
+        double Nr[MAX_3D_ENRICH];
+        double *Nar = &tables->Nrd[nenrich * p];
+        double *Nbr = &tables->Nrd[nenrich * (npts + p)];
+        double *Ncr = &tables->Nrd[nenrich * (2 * npts + p)];
+        if (order == 2) {
+          eval2ndEnrichmentFuncs3D(&pts[3 * p], Nr, Nar, Nbr, Ncr);
+        } else if (order == 3) {
+          eval3rdEnrichmentFuncs3D(&pts[3 * p], Nr, Nar, Nbr, Ncr);
         }
-
-        // Compute the derivative along the x,y,z directions
-        TacsScalar d[3];
-        d[0] = Ua * J[0] + Ub * J[1];
-        d[1] = Ua * J[3] + Ub * J[4];
-        d[2] = Ua * J[6] + Ub * J[7];
-
-        b[neq * k + c] -= wvals[ii] * wvals[jj] *
-                          (d1[0] * d[0] + d1[1] * d[1] + d1[2] * d[2]);
-        b[neq * k + c + 1] -= wvals[ii] * wvals[jj] *
-                              (d2[0] * d[0] + d2[1] * d[1] + d2[2] * d[2]);
       }
+    }
+  }
 
-      // xi,X = [X,xi]^{-1}
-      // U,X = U,xi*xi,X = U,xi*J^{T}
-
-      // Now, evaluate the terms for the left-hand-side
-      // that contribute to the derivative
-      double Nr[MAX_2D_ENRICH];
-      double Nar[MAX_2D_ENRICH], Nbr[MAX_2D_ENRICH];
-      evalEnrichmentFuncs2D(order, pt, knots, Nr, Nar, Nbr);
-
-      // Add the contributions to the the enricment
-      for (int i = 0; i < nenrich; i++) {
-        TacsScalar d[3];
-        d[0] = Nar[i] * J[0] + Nbr[i] * J[1];
-        d[1] = Nar[i] * J[3] + Nbr[i] * J[4];
-        d[2] = Nar[i] * J[6] + Nbr[i] * J[7];
-
-        A[neq * i + c] = wvals[ii] * wvals[jj] *
-                         (d1[0] * d[0] + d1[1] * d[1] + d1[2] * d[2]);
-        A[neq * i + c + 1] = wvals[ii] * wvals[jj] *
-                             (d2[0] * d[0] + d2[1] * d[1] + d2[2] * d[2]);
-      }
+  // Evaluate the shape and enrichment functions at the refined knots
+  double *refined_pts = new double[3 * num_refined_pts];
+  getTensorKnots3D(refined_order, refined_knots, refined_pts);
+  const double *N_table;
+  forest->getInterpTable(num_refined_pts, refined_pts, &N_table);
+  memcpy(tables->N_refined, N_table, num_refined_pts * size * sizeof(double));
+  for (int p = 0; p < num_refined_pts; p++) {
+    if (order == 2) {
+      eval2ndEnrichmentFuncs3D(&refined_pts[3 * p],
+                               &tables->Nr_refined[nenrich * p]);
+    } else if (order == 3) {
+      eval3rdEnrichmentFuncs3D(&refined_pts[3 * p],
+                               &tables->Nr_refined[nenrich * p]);
     }
   }
+  delete[] refined_pts;
+
+  return tables;
+}
+
+/*
+  Solve the least-squares problem for the coefficients of the
+  enrichment functions and copy the solution to ubar. When abar is
+  provided, b contains a second set of right-hand-sides that share the
+  same factorization of A and the solution is copied to abar.
+*/
+static void solveElemRecon(const int vars_per_node, const int neq,
+                           const int nenrich, TacsScalar *A, TacsScalar *b,
+                           TacsScalar ubar[], TacsScalar abar[] = NULL) {
+  // Set up the least squares problem at the nodes
+  int nrhs = (abar ? 2 * vars_per_node : vars_per_node);
 
   // Singular values
-  TacsScalar s[MAX_2D_ENRICH];
+  TacsScalar s[MAX_3D_ENRICH];
   int m = neq, n = nenrich;
   double rcond = -1.0;
   int rank;
@@ -803,164 +1020,378 @@ static void computeElemRecon2D(const int vars_per_node, TMRQuadForest *forest,
       ubar[vars_per_node * i + j] = b[m * j + i];
     }
   }
+  if (abar) {
+    b += m * vars_per_node;
+    for (int i = 0; i < nenrich; i++) {
+      for (int j = 0; j < vars_per_node; j++) {
+        abar[vars_per_node * i + j] = b[m * j + i];
+      }
+    }
+  }
 }
 
 /*
   Given the values of the derivatives of one component of the
-  displacement at the nodes, compute the reconstruction over the
-  element by solving a least-squares problem
+  displacement or rotation field at the nodes, compute the
+  reconstruction over the element by solving a least-squares problem
 
   input:
+  tables:  the tabulated shape and enrichment functions
   Xpts:    the element node locations
   uvals:   the solution at the nodes
   uderiv:  the derivative of the solution in x/y/z at the nodes
 
   output:
   ubar:    the values of the coefficients on the enrichment functions
-*/
-static void computeElemRecon3D(const int vars_per_node, TMROctForest *forest,
-                               TMROctForest *refined_forest,
-                               const TacsScalar Xpts[],
-                               const TacsScalar uvals[],
-                               const TacsScalar uderiv[], TacsScalar ubar[],
-                               TacsScalar *tmp) {
-  // Get information about the interpolation
-  const double *knots;
-  const int order = forest->getInterpKnots(&knots);
-  const int refined_order = refined_forest->getMeshOrder();
-
-  // Get the number of enrichment functions
-  const int nenrich = getNum3dEnrich(order);
 
-  // The number of equations
-  const int neq = 3 * order * order * order;
+  The optional avals/aderiv/abar arguments reconstruct a second field,
+  typically the adjoint, on the same element. Since the least-squares
+  matrix depends only on the element geometry, both fields are solved
+  with a single factorization.
+*/
+static void computeElemRecon2D(
+    const int vars_per_node, const TMRReconTables *tables,
+    const TacsScalar Xpts[], const TacsScalar uvals[],
+    const TacsScalar uderiv[], TacsScalar ubar[], TacsScalar *tmp,
+    const TacsScalar avals[] = NULL, const TacsScalar aderiv[] = NULL,
+    TacsScalar abar[] = NULL) {
+  const int nenrich = tables->nenrich;
+  const int npts = tables->npts;
+  const int neq = tables->neq;
+  const int size = tables->size;
+  const int refined_size = tables->refined_size;
 
   // The number of derivatives per node
   const int deriv_per_node = 3 * vars_per_node;
 
-  // Set up the least squares problem at the nodes
-  int nrhs = vars_per_node;
+  // The number of fields to reconstruct
+  const int nsets = (abar ? 2 : 1);
 
   TacsScalar *A = &tmp[0];
   TacsScalar *b = &tmp[nenrich * neq];
 
-  // Set the weights
-  double wvals[3];
-  if (order == 2) {
-    wvals[0] = wvals[1] = 1.0;
-  } else if (order == 3) {
-    wvals[0] = wvals[2] = 0.5;
-    wvals[1] = 1.0;
-  }
+  for (int p = 0, c = 0; p < npts; p++, c += 2) {
+    const double w = tables->wts[p];
+
+    // Retrieve the element shape functions at this point
+    const double *Na = &tables->Nd_refined[refined_size * p];
+    const double *Nb = &tables->Nd_refined[refined_size * (npts + p)];
+
+    // Evaluate the Jacobian transformation at this point
+    TacsScalar Xd[9], J[9];
+    computeJacobianTrans2D(Xpts, Na, Nb, Xd, J, refined_size);
+
+    // Normalize the first direction
+    TacsScalar d1[3], d2[3];
+    d1[0] = Xd[0];
+    d1[1] = Xd[1];
+    d1[2] = Xd[2];
+    vec3Normalize(d1);
+
+    // Compute d2 = n x d1
+    crossProduct(&Xd[6], d1, d2);
+
+    // First, compute the contributions to the righ-hand-side. The
+    // right vector contains the difference between the prescribed
+    // derivative and the contribution to the derivative from the
+    // quadratic shape function terms
+    // Evaluate the interpolation on the original mesh
+    Na = &tables->Nd[size * p];
+    Nb = &tables->Nd[size * (npts + p)];
+
+    for (int set = 0; set < nsets; set++) {
+      const TacsScalar *vals = (set == 0 ? uvals : avals);
+      const TacsScalar *ud = (set == 0 ? uderiv : aderiv);
+      ud = &ud[deriv_per_node * p];
+      TacsScalar *bs = &b[neq * vars_per_node * set];
 
-  for (int c = 0, kk = 0; kk < order; kk++) {
-    for (int jj = 0; jj < order; jj++) {
-      for (int ii = 0; ii < order; ii++, c += 3) {
-        // Set the parametric location within the element
-        double pt[3];
-        pt[0] = knots[ii];
-        pt[1] = knots[jj];
-        pt[2] = knots[kk];
-
-        // Compute the element shape functions at this point
-        double N[MAX_ORDER * MAX_ORDER * MAX_ORDER];
-        double Na[MAX_ORDER * MAX_ORDER * MAX_ORDER];
-        double Nb[MAX_ORDER * MAX_ORDER * MAX_ORDER];
-        double Nc[MAX_ORDER * MAX_ORDER * MAX_ORDER];
-        refined_forest->evalInterp(pt, N, Na, Nb, Nc);
+      for (int k = 0; k < vars_per_node; k++) {
+        bs[neq * k + c] = w * (d1[0] * ud[0] + d1[1] * ud[1] + d1[2] * ud[2]);
+        bs[neq * k + c + 1] =
+            w * (d2[0] * ud[0] + d2[1] * ud[1] + d2[2] * ud[2]);
+        ud += 3;
+      }
 
-        // Evaluate the Jacobian transformation at this point
-        TacsScalar Xd[9], J[9];
-        computeJacobianTrans3D(Xpts, Na, Nb, Nc, Xd, J,
-                               refined_order * refined_order * refined_order);
-
-        // First, compute the contributions to the righ-hand-side. The
-        // right vector contains the difference between the prescribed
-        // derivative and the contribution to the derivative from the
-        // quadratic shape function terms
-        const TacsScalar *ud =
-            &uderiv[deriv_per_node * (ii + order * jj + order * order * kk)];
-        for (int k = 0; k < vars_per_node; k++) {
-          b[neq * k + c] = wvals[ii] * wvals[jj] * wvals[kk] * ud[0];
-          b[neq * k + c + 1] = wvals[ii] * wvals[jj] * wvals[kk] * ud[1];
-          b[neq * k + c + 2] = wvals[ii] * wvals[jj] * wvals[kk] * ud[2];
-          ud += 3;
+      // Add the contribution from the nodes
+      for (int k = 0; k < vars_per_node; k++) {
+        // Evaluate the derivatives along the parametric directions
+        TacsScalar Ua = 0.0, Ub = 0.0;
+        for (int i = 0; i < size; i++) {
+          Ua += vals[vars_per_node * i + k] * Na[i];
+          Ub += vals[vars_per_node * i + k] * Nb[i];
         }
 
-        // Compute the shape functions on the coarser mesh
-        forest->evalInterp(pt, N, Na, Nb, Nc);
+        // Compute the derivative along the x,y,z directions
+        TacsScalar d[3];
+        d[0] = Ua * J[0] + Ub * J[1];
+        d[1] = Ua * J[3] + Ub * J[4];
+        d[2] = Ua * J[6] + Ub * J[7];
+
+        bs[neq * k + c] -= w * (d1[0] * d[0] + d1[1] * d[1] + d1[2] * d[2]);
+        bs[neq * k + c + 1] -=
+            w * (d2[0] * d[0] + d2[1] * d[1] + d2[2] * d[2]);
+      }
+    }
 
-        // Add the contribution from the nodes
-        for (int k = 0; k < vars_per_node; k++) {
-          // Evaluate the derivatives along the parametric directions
-          TacsScalar Ua = 0.0, Ub = 0.0, Uc = 0.0;
-          for (int i = 0; i < order * order * order; i++) {
-            Ua += uvals[vars_per_node * i + k] * Na[i];
-            Ub += uvals[vars_per_node * i + k] * Nb[i];
-            Uc += uvals[vars_per_node * i + k] * Nc[i];
-          }
+    // xi,X = [X,xi]^{-1}
+    // U,X = U,xi*xi,X = U,xi*J^{T}
 
-          // Compute the derivative along the x,y,z directions
-          TacsScalar d[3];
-          d[0] = Ua * J[0] + Ub * J[1] + Uc * J[2];
-          d[1] = Ua * J[3] + Ub * J[4] + Uc * J[5];
-          d[2] = Ua * J[6] + Ub * J[7] + Uc * J[8];
+    // Now, evaluate the terms for the left-hand-side
+    // that contribute to the derivative
+    const double *Nar = &tables->Nrd[nenrich * p];
+    const double *Nbr = &tables->Nrd[nenrich * (npts + p)];
 
-          b[neq * k + c] -= wvals[ii] * wvals[jj] * wvals[kk] * d[0];
-          b[neq * k + c + 1] -= wvals[ii] * wvals[jj] * wvals[kk] * d[1];
-          b[neq * k + c + 2] -= wvals[ii] * wvals[jj] * wvals[kk] * d[2];
-        }
+    // Add the contributions to the the enricment
+    for (int i = 0; i < nenrich; i++) {
+      TacsScalar d[3];
+      d[0] = Nar[i] * J[0] + Nbr[i] * J[1];
+      d[1] = Nar[i] * J[3] + Nbr[i] * J[4];
+      d[2] = Nar[i] * J[6] + Nbr[i] * J[7];
 
-        // Now, evaluate the terms for the left-hand-side that
-        // contribute to the derivative
-        // xi,X = [X,xi]^{-1}
-        // U,X = U,xi*xi,X = U,xi*J^{T}
-        double Nr[MAX_3D_ENRICH];
-        double Nar[MAX_3D_ENRICH], Nbr[MAX_3D_ENRICH], Ncr[MAX_3D_ENRICH];
-        if (order == 2) {
-          eval2ndEnrichmentFuncs3D(pt, Nr, Nar, Nbr, Ncr);
-        } else if (order == 3) {
-          eval3rdEnrichmentFuncs3D(pt, Nr, Nar, Nbr, Ncr);
-        }
+      A[neq * i + c] = w * (d1[0] * d[0] + d1[1] * d[1] + d1[2] * d[2]);
+      A[neq * i + c + 1] = w * (d2[0] * d[0] + d2[1] * d[1] + d2[2] * d[2]);
+    }
+  }
+
+  solveElemRecon(vars_per_node, neq, nenrich, A, b, ubar, abar);
+}
+
+/*
+  Given the values of the derivatives of one component of the
+  displacement at the nodes, compute the reconstruction over the
+  element by solving a least-squares problem
+
+  input:
+  tables:  the tabulated shape and enrichment functions
+  Xpts:    the element node locations
+  uvals:   the solution at the nodes
+  uderiv:  the derivative of the solution in x/y/z at the nodes
+
+  output:
+  ubar:    the values of the coefficients on the enrichment functions
+
+  The optional avals/aderiv/abar arguments reconstruct a second field,
+  typically the adjoint, on the same element. Since the least-squares
+  matrix depends only on the element geometry, both fields are solved
+  with a single factorization.
+*/
+static void computeElemRecon3D(
+    const int vars_per_node, const TMRReconTables *tables,
+    const TacsScalar Xpts[], const TacsScalar uvals[],
+    const TacsScalar uderiv[], TacsScalar ubar[], TacsScalar *tmp,
+    const TacsScalar avals[] = NULL, const TacsScalar aderiv[] = NULL,
+    TacsScalar abar[] = NULL) {
+  const int nenrich = tables->nenrich;
+  const int npts = tables->npts;
+  const int neq = tables->neq;
+  const int size = tables->size;
+  const int refined_size = tables->refined_size;
+
+  // The number of derivatives per node
+  const int deriv_per_node = 3 * vars_per_node;
 
-        // Add the contributions to the the enricment
-        for (int i = 0; i < nenrich; i++) {
-          TacsScalar d[3];
-          d[0] = Nar[i] * J[0] + Nbr[i] * J[1] + Ncr[i] * J[2];
-          d[1] = Nar[i] * J[3] + Nbr[i] * J[4] + Ncr[i] * J[5];
-          d[2] = Nar[i] * J[6] + Nbr[i] * J[7] + Ncr[i] * J[8];
+  // The number of fields to reconstruct
+  const int nsets = (abar ? 2 : 1);
 
-          A[neq * i + c] = wvals[ii] * wvals[jj] * wvals[kk] * d[0];
-          A[neq * i + c + 1] = wvals[ii] * wvals[jj] * wvals[kk] * d[1];
-          A[neq * i + c + 2] = wvals[ii] * wvals[jj] * wvals[kk] * d[2];
+  TacsScalar *A = &tmp[0];
+  TacsScalar *b = &tmp[nenrich * neq];
+
+  for (int p = 0, c = 0; p < npts; p++, c += 3) {
+    const double w = tables->wts[p];
+
+    // Retrieve the element shape functions at this point
+    const double *Na = &tables->Nd_refined[refined_size * p];
+    const double *Nb = &tables->Nd_refined[refined_size * (npts + p)];
+    const double *Nc = &tables->Nd_refined[refined_size * (2 * npts + p)];
+
+    // Evaluate the Jacobian transformation at this point
+    TacsScalar Xd[9], J[9];
+    computeJacobianTrans3D(Xpts, Na, Nb, Nc, Xd, J, refined_size);
+
+    // First, compute the contributions to the righ-hand-side. The
+    // right vector contains the difference between the prescribed
+    // derivative and the contribution to the derivative from the
+    // quadratic shape function terms
+    // Compute the shape functions on the coarser mesh
+    Na = &tables->Nd[size * p];
+    Nb = &tables->Nd[size * (npts + p)];
+    Nc = &tables->Nd[size * (2 * npts + p)];
+
+    for (int set = 0; set < nsets; set++) {
+      const TacsScalar *vals = (set == 0 ? uvals : avals);
+      const TacsScalar *ud = (set == 0 ? uderiv : aderiv);
+      ud = &ud[deriv_per_node * p];
+      TacsScalar *bs = &b[neq * vars_per_node * set];
+
+      for (int k = 0; k < vars_per_node; k++) {
+        bs[neq * k + c] = w * ud[0];
+        bs[neq * k + c + 1] = w * ud[1];
+        bs[neq * k + c + 2] = w * ud[2];
+        ud += 3;
+      }
+
+      // Add the contribution from the nodes
+      for (int k = 0; k < vars_per_node; k++) {
+        // Evaluate the derivatives along the parametric directions
+        TacsScalar Ua = 0.0, Ub = 0.0, Uc = 0.0;
+        for (int i = 0; i < size; i++) {
+          Ua += vals[vars_per_node * i + k] * Na[i];
+          Ub += vals[vars_per_node * i + k] * Nb[i];
+          Uc += vals[vars_per_node * i + k] * Nc[i];
         }
+
+        // Compute the derivative along the x,y,z directions
+        TacsScalar d[3];
+        d[0] = Ua * J[0] + Ub * J[1] + Uc * J[2];
+        d[1] = Ua * J[3] + Ub * J[4] + Uc * J[5];
+        d[2] = Ua * J[6] + Ub * J[7] + Uc * J[8];
+
+        bs[neq * k + c] -= w * d[0];
+        bs[neq * k + c + 1] -= w * d[1];
+        bs[neq * k + c + 2] -= w * d[2];
       }
     }
+
+    // Now, evaluate the terms for the left-hand-side that
+    // contribute to the derivative
+    // xi,X = [X,xi]^{-1}
+    // U,X = U,xi*xi,X = U,xi*J^{T}
+    const double *Nar = &tables->Nrd[nenrich * p];
+    const double *Nbr = &tables->Nrd[nenrich * (npts + p)];
+    const double *Ncr = &tables->Nrd[nenrich * (2 * npts + p)];
+
+    // Add the contributions to the the enricment
+    for (int i = 0; i < nenrich; i++) {
+      TacsScalar d[3];
+      d[0] = Nar[i] * J[0] + Nbr[i] * J[1] + Ncr[i] * J[2];
+      d[1] = Nar[i] * J[3] + Nbr[i] * J[4] + Ncr[i] * J[5];
+      d[2] = Nar[i] * J[6] + Nbr[i] * J[7] + Ncr[i] * J[8];
+
+      A[neq * i + c] = w * d[0];
+      A[neq * i + c + 1] = w * d[1];
+      A[neq * i + c + 2] = w * d[2];
+    }
   }
 
-  // Singular values
-  TacsScalar s[MAX_3D_ENRICH];
-  int m = neq, n = nenrich;
-  double rcond = -1.0;
-  int rank;
+  solveElemRecon(vars_per_node, neq, nenrich, A, b, ubar, abar);
+}
 
-  // Length of the work array
-  int lwork = 512;
-  TacsScalar work[512];
+// The number of elements gathered for each batch of reconstructions
+static const int RECON_BATCH_SIZE = 256;
 
-  // LAPACK output status
-  int info;
+/*
+  The data for a batch of element reconstructions. Each thread solves
+  the reconstruction problems for a contiguous range of elements.
+*/
+class TMRReconBatch {
+ public:
+  const TMRReconTables *tables;
+  int vars_per_node;
+  int start, end;
+  const TacsScalar *Xpts;
+  const TacsScalar *uvals;
+  const TacsScalar *uderiv;
+  TacsScalar *ubar;
+  const TacsScalar *avals;
+  const TacsScalar *aderiv;
+  TacsScalar *abar;
+};
 
-  // Using LAPACK, compute the least squares solution
-  LAPACKdgelss(&m, &n, &nrhs, A, &m, b, &m, s, &rcond, &rank, work, &lwork,
-               &info);
+/*
+  Solve the reconstruction problems for a range of elements in a batch
+*/
+static void *computeElemReconThread(void *arg) {
+  TMRReconBatch *batch = static_cast<TMRReconBatch *>(arg);
+  const TMRReconTables *tables = batch->tables;
+  const int vars_per_node = batch->vars_per_node;
+
+  // The strides between the element data in the batch
+  const int xstride = 3 * tables->num_refined_pts;
+  const int ustride = vars_per_node * tables->size;
+  const int dstride = 3 * ustride;
+  const int bstride = vars_per_node * tables->nenrich;
+
+  // The number of right-hand-sides in the least-squares problems
+  const int nrhs = (batch->abar ? 2 * vars_per_node : vars_per_node);
+
+  TacsScalar *tmp = new TacsScalar[tables->neq * (tables->nenrich + nrhs)];
+  for (int i = batch->start; i < batch->end; i++) {
+    const TacsScalar *avals = NULL, *aderiv = NULL;
+    TacsScalar *abar = NULL;
+    if (batch->abar) {
+      avals = &batch->avals[ustride * i];
+      aderiv = &batch->aderiv[dstride * i];
+      abar = &batch->abar[bstride * i];
+    }
 
-  // Copy over the ubar solution
-  for (int i = 0; i < nenrich; i++) {
-    for (int j = 0; j < vars_per_node; j++) {
-      ubar[vars_per_node * i + j] = b[m * j + i];
+    if (tables->dim == 2) {
+      computeElemRecon2D(vars_per_node, tables, &batch->Xpts[xstride * i],
+                         &batch->uvals[ustride * i],
+                         &batch->uderiv[dstride * i],
+                         &batch->ubar[bstride * i], tmp, avals, aderiv, abar);
+    } else {
+      computeElemRecon3D(vars_per_node, tables, &batch->Xpts[xstride * i],
+                         &batch->uvals[ustride * i],
+                         &batch->uderiv[dstride * i],
+                         &batch->ubar[bstride * i], tmp, avals, aderiv, abar);
+    }
+  }
+  delete[] tmp;
+
+  return NULL;
+}
+
+/*
+  Compute the reconstruction for a batch of elements. The element data
+  is stored contiguously: Xpts has the refined node locations, uvals
+  and uderiv the solution and derivatives at the nodes of the original
+  element and ubar the output coefficients of the enrichment functions.
+  When abar is provided, the second field stored in avals and aderiv
+  is reconstructed in the same pass as the first.
+*/
+static void computeElemReconBatch(
+    const int vars_per_node, const TMRReconTables *tables, const int nbatch,
+    const TacsScalar Xpts[], const TacsScalar uvals[],
+    const TacsScalar uderiv[], TacsScalar ubar[], int num_threads,
+    const TacsScalar avals[] = NULL, const TacsScalar aderiv[] = NULL,
+    TacsScalar abar[] = NULL) {
+  if (num_threads > nbatch) {
+    num_threads = nbatch;
+  }
+  if (num_threads < 1) {
+    num_threads = 1;
+  }
+
+  TMRReconBatch *data = new TMRReconBatch[num_threads];
+  for (int k = 0; k < num_threads; k++) {
+    data[k].tables = tables;
+    data[k].vars_per_node = vars_per_node;
+    data[k].start = (k * nbatch) / num_threads;
+    data[k].end = ((k + 1) * nbatch) / num_threads;
+    data[k].Xpts = Xpts;
+    data[k].uvals = uvals;
+    data[k].uderiv = uderiv;
+    data[k].ubar = ubar;
+    data[k].avals = avals;
+    data[k].aderiv = aderiv;
+    data[k].abar = abar;
+  }
+
+  if (num_threads > 1) {
+    pthread_t *threads = new pthread_t[num_threads];
+    for (int k = 0; k < num_threads; k++) {
+      pthread_create(&threads[k], NULL, computeElemReconThread,
+                     (void *)&data[k]);
     }
+    for (int k = 0; k < num_threads; k++) {
+      pthread_join(threads[k], NULL);
+    }
+    delete[] threads;
+  } else {
+    computeElemReconThread((void *)&data[0]);
   }
+
+  delete[] data;
 }
 
 /*
@@ -1074,6 +1505,13 @@ static void computeNodeDeriv2D(TMRQuadForest *forest, TACSAssembler *tacs,
   TacsScalar *uelem = new TacsScalar[order * order * vars_per_node];
   TacsScalar *delem = new TacsScalar[order * order * deriv_per_node];
 
+  // Retrieve the shape function derivatives at the knot locations
+  double pts[2 * MAX_ORDER * MAX_ORDER];
+  getTensorKnots2D(order, knots, pts);
+  const double *Na_table, *Nb_table;
+  const int size =
+      forest->getInterpTable(order * order, pts, NULL, &Na_table, &Nb_table);
+
   // Perform the reconstruction for the local
   for (int index = 0; index < nelems; index++) {
     // Set the element number, depending on whether we're using the
@@ -1107,14 +1545,9 @@ static void computeNodeDeriv2D(TMRQuadForest *forest, TACSAssembler *tacs,
     // the element
     for (int jj = 0; jj < order; jj++) {
       for (int ii = 0; ii < order; ii++) {
-        double pt[2];
-        pt[0] = knots[ii];
-        pt[1] = knots[jj];
-
-        // Evaluate the the quadratic shape functions at this point
-        double N[MAX_ORDER * MAX_ORDER];
-        double Na[MAX_ORDER * MAX_ORDER], Nb[MAX_ORDER * MAX_ORDER];
-        forest->evalInterp(pt, N, Na, Nb);
+        // Retrieve the the quadratic shape functions at this point
+        const double *Na = &Na_table[size * (ii + order * jj)];
+        const double *Nb = &Nb_table[size * (ii + order * jj)];
 
         // Evaluate the Jacobian transformation at this point
         TacsScalar Xd[9], J[9];
@@ -1211,6 +1644,13 @@ static void computeNodeDeriv3D(TMROctForest *forest, TACSAssembler *tacs,
   TacsScalar *uelem = new TacsScalar[order * order * order * vars_per_node];
   TacsScalar *delem = new TacsScalar[order * order * order * deriv_per_node];
 
+  // Retrieve the shape function derivatives at the knot locations
+  double pts[3 * MAX_ORDER * MAX_ORDER * MAX_ORDER];
+  getTensorKnots3D(order, knots, pts);
+  const double *Na_table, *Nb_table, *Nc_table;
+  const int size = forest->getInterpTable(order * order * order, pts, NULL,
+                                          &Na_table, &Nb_table, &Nc_table);
+
   // Perform the reconstruction for the local
   for (int index = 0; index < nelems; index++) {
     // Set the element number, depending on whether we're using the
@@ -1245,17 +1685,11 @@ static void computeNodeDeriv3D(TMROctForest *forest, TACSAssembler *tacs,
     for (int kk = 0; kk < order; kk++) {
       for (int jj = 0; jj < order; jj++) {
         for (int ii = 0; ii < order; ii++) {
-          double pt[3];
-          pt[0] = knots[ii];
-          pt[1] = knots[jj];
-          pt[2] = knots[kk];
-
-          // Evaluate the the shape functions
-          double N[MAX_ORDER * MAX_ORDER * MAX_ORDER];
-          double Na[MAX_ORDER * MAX_ORDER * MAX_ORDER];
-          double Nb[MAX_ORDER * MAX_ORDER * MAX_ORDER];
-          double Nc[MAX_ORDER * MAX_ORDER * MAX_ORDER];
-          forest->evalInterp(pt, N, Na, Nb, Nc);
+          // Retrieve the the shape functions
+          const int offset = ii + order * jj + order * order * kk;
+          const double *Na = &Na_table[size * offset];
+          const double *Nb = &Nb_table[size * offset];
+          const double *Nc = &Nc_table[size * offset];
 
           // Evaluate the Jacobian transformation at this point
           TacsScalar Xd[9], J[9];
@@ -1329,151 +1763,97 @@ void addRefinedSolution2D(TMRQuadForest *forest, TACSAssembler *tacs,
   const int vars_per_node = tacs->getVarsPerNode();
   const int deriv_per_node = 3 * vars_per_node;
 
-  // Get the order of the solution and the refined solution
-  const double *knots, *refined_knots;
-  const int order = forest->getInterpKnots(&knots);
-  const int refined_order = forest_refined->getInterpKnots(&refined_knots);
-  const int num_nodes = order * order;
-  const int num_refined_nodes = refined_order * refined_order;
-
-  // The number of enrichment functions
-  const int nenrich = getNum2dEnrich(order);
-
-  // The number of equations for the reconstruction: 2 times the
-  // number of nodes for each element
-  const int neq = 2 * order * order;
-
-  // Allocate space for the element reconstruction problem
-  TacsScalar *tmp = new TacsScalar[neq * (nenrich + vars_per_node)];
+  // Tabulate the shape and enrichment functions
+  TMRReconTables *tables = createReconTables2D(forest, forest_refined);
+  const int num_nodes = tables->size;
+  const int num_refined_nodes = tables->num_refined_pts;
+  const int nenrich = tables->nenrich;
 
-  // Element solution on the coarse TACS mesh
-  TacsScalar *uelem = new TacsScalar[vars_per_node * num_nodes];
-  TacsScalar *delem = new TacsScalar[deriv_per_node * num_nodes];
-  TacsScalar *ubar = new TacsScalar[vars_per_node * nenrich];
+  // Element data for a batch of elements
+  TacsScalar *uelem =
+      new TacsScalar[RECON_BATCH_SIZE * vars_per_node * num_nodes];
+  TacsScalar *delem =
+      new TacsScalar[RECON_BATCH_SIZE * deriv_per_node * num_nodes];
+  TacsScalar *ubar = new TacsScalar[RECON_BATCH_SIZE * vars_per_node * nenrich];
+  TacsScalar *Xpts = new TacsScalar[RECON_BATCH_SIZE * 3 * num_refined_nodes];
 
   // Refined element solution
   TacsScalar *uref = new TacsScalar[vars_per_node * num_refined_nodes];
 
-  // The maximum number of nodes for any element
-  TacsScalar Xpts[3 * MAX_ORDER * MAX_ORDER];
-
   // Number of local elements in the coarse version of TACS
   int nelems = tacs->getNumElements();
   if (element_nums) {
     nelems = num_elements;
   }
 
-  for (int index = 0; index < nelems; index++) {
-    // Get the element number
-    int elem = index;
-    if (element_nums) {
-      elem = element_nums[index];
+  for (int start = 0; start < nelems; start += RECON_BATCH_SIZE) {
+    int nbatch = nelems - start;
+    if (nbatch > RECON_BATCH_SIZE) {
+      nbatch = RECON_BATCH_SIZE;
     }
 
-    // Get the node numbers and node locations for this element
-    int len;
-    const int *nodes;
-    tacs->getElement(elem, &len, &nodes);
-
-    // Get the derivatives at the nodes
-    vec->getValues(len, nodes, uelem);
-    vecDeriv->getValues(len, nodes, delem);
-
-    // Get the node locateions
-    tacs_refined->getElement(elem, Xpts);
-
-    // Compute the reconstruction weights for the enrichment functions
-    computeElemRecon2D(vars_per_node, forest, forest_refined, Xpts, uelem,
-                       delem, ubar, tmp);
-
-    if (compute_difference) {
-      // Get the refined element nodes
-      const int *refined_nodes;
-      tacs_refined->getElement(elem, &len, &refined_nodes);
-
-      // Zero the refined element contribution
-      memset(uref, 0, vars_per_node * num_refined_nodes * sizeof(TacsScalar));
+    // Gather the element data for the batch
+    for (int j = 0; j < nbatch; j++) {
+      int elem = start + j;
+      if (element_nums) {
+        elem = element_nums[elem];
+      }
 
-      // Compute the solution at the refined points
-      for (int m = 0; m < refined_order; m++) {
-        for (int n = 0; n < refined_order; n++) {
-          // Set the new parameter point in the refined element
-          double pt[2];
-          pt[0] = refined_knots[n];
-          pt[1] = refined_knots[m];
+      // Get the node numbers and node locations for this element
+      int len;
+      const int *nodes;
+      tacs->getElement(elem, &len, &nodes);
 
-          // Evaluate the shape functions and the enrichment
-          // functions at the new parametric point
-          double Nr[MAX_2D_ENRICH];
-          evalEnrichmentFuncs2D(order, pt, knots, Nr);
+      // Get the derivatives at the nodes
+      vec->getValues(len, nodes, &uelem[vars_per_node * num_nodes * j]);
+      vecDeriv->getValues(len, nodes, &delem[deriv_per_node * num_nodes * j]);
 
-          // Add the portion from the enrichment functions
-          for (int i = 0; i < vars_per_node; i++) {
-            const TacsScalar *ue = &ubar[i];
-            TacsScalar *u = &uref[vars_per_node * (n + refined_order * m) + i];
+      // Get the node locateions
+      tacs_refined->getElement(elem, &Xpts[3 * num_refined_nodes * j]);
+    }
 
-            for (int k = 0; k < nenrich; k++) {
-              u[0] += Nr[k] * ue[vars_per_node * k];
-            }
-          }
-        }
-      }
+    // Compute the reconstruction weights for the enrichment functions
+    computeElemReconBatch(vars_per_node, tables, nbatch, Xpts, uelem, delem,
+                          ubar, 1);
 
-      // Zero the contribution if it goes to a dependent node
-      for (int i = 0; i < num_refined_nodes; i++) {
-        if (refined_nodes[i] < 0) {
-          for (int j = 0; j < vars_per_node; j++) {
-            uref[vars_per_node * i + j] = 0.0;
-          }
-        }
+    for (int j = 0; j < nbatch; j++) {
+      int elem = start + j;
+      if (element_nums) {
+        elem = element_nums[elem];
       }
+      const TacsScalar *ue0 = &uelem[vars_per_node * num_nodes * j];
+      const TacsScalar *ub0 = &ubar[vars_per_node * nenrich * j];
 
-      // Add the contributions to the element
-      vec_refined->setValues(len, refined_nodes, uref, TACS_ADD_VALUES);
-    } else {
       // Get the refined element nodes
+      int len;
       const int *refined_nodes;
       tacs_refined->getElement(elem, &len, &refined_nodes);
 
       // Zero the refined element contribution
       memset(uref, 0, vars_per_node * num_refined_nodes * sizeof(TacsScalar));
 
-      // Compute the element order
-      for (int m = 0; m < refined_order; m++) {
-        for (int n = 0; n < refined_order; n++) {
-          // Set the new parameter point in the refined element
-          double pt[2];
-          pt[0] = refined_knots[n];
-          pt[1] = refined_knots[m];
-
-          // Evaluate the shape functions
-          double N[MAX_ORDER * MAX_ORDER];
-          forest->evalInterp(pt, N);
+      // Compute the solution at the refined points
+      for (int p = 0; p < num_refined_nodes; p++) {
+        TacsScalar *u = &uref[vars_per_node * p];
 
-          // Set the values of the variables at this point
+        // Set the values of the variables at this point
+        if (!compute_difference) {
+          const double *N = &tables->N_refined[num_nodes * p];
           for (int i = 0; i < vars_per_node; i++) {
-            const TacsScalar *ue = &uelem[i];
-            TacsScalar *u = &uref[vars_per_node * (n + refined_order * m) + i];
-
+            const TacsScalar *ue = &ue0[i];
             for (int k = 0; k < num_nodes; k++) {
-              u[0] += N[k] * ue[0];
+              u[i] += N[k] * ue[0];
               ue += vars_per_node;
             }
           }
+        }
 
-          // Evaluate the enrichment functions and add them to the
-          // solution
-          double Nr[MAX_2D_ENRICH];
-          evalEnrichmentFuncs2D(order, pt, knots, Nr);
-
-          // Add the portion from the enrichment functions
-          for (int i = 0; i < vars_per_node; i++) {
-            const TacsScalar *ue = &ubar[i];
-            TacsScalar *u = &uref[vars_per_node * (n + refined_order * m) + i];
-
-            for (int k = 0; k < nenrich; k++) {
-              u[0] += Nr[k] * ue[vars_per_node * k];
-            }
+        // Add the portion from the enrichment functions
+        const double *Nr = &tables->Nr_refined[nenrich * p];
+        for (int i = 0; i < vars_per_node; i++) {
+          const TacsScalar *ue = &ub0[i];
+          for (int k = 0; k < nenrich; k++) {
+            u[i] += Nr[k] * ue[vars_per_node * k];
           }
         }
       }
@@ -1481,8 +1861,8 @@ void addRefinedSolution2D(TMRQuadForest *forest, TACSAssembler *tacs,
       // Zero the contribution if it goes to a dependent node
       for (int i = 0; i < num_refined_nodes; i++) {
         if (refined_nodes[i] < 0) {
-          for (int j = 0; j < vars_per_node; j++) {
-            uref[vars_per_node * i + j] = 0.0;
+          for (int k = 0; k < vars_per_node; k++) {
+            uref[vars_per_node * i + k] = 0.0;
           }
         }
       }
@@ -1493,10 +1873,11 @@ void addRefinedSolution2D(TMRQuadForest *forest, TACSAssembler *tacs,
   }
 
   // Free allocated data
-  delete[] tmp;
+  delete tables;
   delete[] uelem;
   delete[] delem;
   delete[] ubar;
+  delete[] Xpts;
   delete[] uref;
 }
 
@@ -1514,32 +1895,22 @@ void addRefinedSolution3D(TMROctForest *forest, TACSAssembler *tacs,
   const int vars_per_node = tacs->getVarsPerNode();
   const int deriv_per_node = 3 * vars_per_node;
 
-  // Get the order of the solution and the refined solution
-  const double *knots, *refined_knots;
-  const int order = forest->getInterpKnots(&knots);
-  const int refined_order = refined_forest->getInterpKnots(&refined_knots);
-  const int num_refined_nodes = refined_order * refined_order * refined_order;
-
-  // The number of enrichment functions
-  const int nenrich = getNum3dEnrich(order);
-
-  // The number of equations for the reconstruction: 2 times the
-  // number of nodes for each element
-  const int neq = 3 * order * order * order;
+  // Tabulate the shape and enrichment functions
+  TMRReconTables *tables = createReconTables3D(forest, refined_forest);
+  const int num_nodes = tables->size;
+  const int num_refined_nodes = tables->num_refined_pts;
+  const int nenrich = tables->nenrich;
 
-  // Allocate space for the element reconstruction problem
-  TacsScalar *tmp = new TacsScalar[neq * (nenrich + vars_per_node)];
-
-  // Element solution on the coarse TACS mesh
-  TacsScalar *uelem = new TacsScalar[vars_per_node * order * order * order];
-  TacsScalar *delem = new TacsScalar[deriv_per_node * order * order * order];
-  TacsScalar *ubar = new TacsScalar[vars_per_node * nenrich];
+  // Element data for a batch of elements
+  TacsScalar *uelem =
+      new TacsScalar[RECON_BATCH_SIZE * vars_per_node * num_nodes];
+  TacsScalar *delem =
+      new TacsScalar[RECON_BATCH_SIZE * deriv_per_node * num_nodes];
+  TacsScalar *ubar = new TacsScalar[RECON_BATCH_SIZE * vars_per_node * nenrich];
+  TacsScalar *Xpts = new TacsScalar[RECON_BATCH_SIZE * 3 * num_refined_nodes];
 
   // Refined element solution
-  TacsScalar *uref = new TacsScalar[vars_per_node * order * order * order];
-
-  // The maximum number of nodes for any element
-  TacsScalar Xpts[3 * MAX_ORDER * MAX_ORDER * MAX_ORDER];
+  TacsScalar *uref = new TacsScalar[vars_per_node * num_refined_nodes];
 
   // Number of local elements in the coarse version of TACS
   int nelems = tacs->getNumElements();
@@ -1547,128 +1918,72 @@ void addRefinedSolution3D(TMROctForest *forest, TACSAssembler *tacs,
     nelems = num_elements;
   }
 
-  for (int index = 0; index < nelems; index++) {
-    // Get the element number
-    int elem = index;
-    if (element_nums) {
-      elem = element_nums[index];
+  for (int start = 0; start < nelems; start += RECON_BATCH_SIZE) {
+    int nbatch = nelems - start;
+    if (nbatch > RECON_BATCH_SIZE) {
+      nbatch = RECON_BATCH_SIZE;
     }
 
-    // Get the node numbers for this element
-    int len;
-    const int *nodes;
-    tacs->getElement(elem, &len, &nodes);
-
-    // Get the derivatives at the nodes
-    vec->getValues(len, nodes, uelem);
-    vecDeriv->getValues(len, nodes, delem);
-
-    // Get the refined node locations
-    refined_tacs->getElement(elem, Xpts);
-
-    // Compute the reconstruction weights for the enrichment functions
-    computeElemRecon3D(vars_per_node, forest, refined_forest, Xpts, uelem,
-                       delem, ubar, tmp);
+    // Gather the element data for the batch
+    for (int j = 0; j < nbatch; j++) {
+      int elem = start + j;
+      if (element_nums) {
+        elem = element_nums[elem];
+      }
 
-    if (compute_difference) {
-      // Get the refined element nodes
-      const int *refined_nodes;
-      refined_tacs->getElement(elem, &len, &refined_nodes);
+      // Get the node numbers for this element
+      int len;
+      const int *nodes;
+      tacs->getElement(elem, &len, &nodes);
 
-      // Zero the refined element contribution
-      memset(uref, 0, vars_per_node * num_refined_nodes * sizeof(TacsScalar));
+      // Get the derivatives at the nodes
+      vec->getValues(len, nodes, &uelem[vars_per_node * num_nodes * j]);
+      vecDeriv->getValues(len, nodes, &delem[deriv_per_node * num_nodes * j]);
 
-      for (int p = 0; p < refined_order; p++) {
-        for (int m = 0; m < refined_order; m++) {
-          for (int n = 0; n < refined_order; n++) {
-            // Set the new parameter point in the refined element
-            double pt[3];
-            pt[0] = refined_knots[n];
-            pt[1] = refined_knots[m];
-            pt[2] = refined_knots[p];
-
-            // Evaluate the shape functions and the enrichment
-            // functions at the new parametric point
-            double Nr[MAX_3D_ENRICH];
-            if (order == 2) {
-              eval2ndEnrichmentFuncs3D(pt, Nr);
-            } else if (order == 3) {
-              eval3rdEnrichmentFuncs3D(pt, Nr);
-            }
+      // Get the refined node locations
+      refined_tacs->getElement(elem, &Xpts[3 * num_refined_nodes * j]);
+    }
 
-            // Add the portion from the enrichment functions
-            int offset =
-                (n + refined_order * m + refined_order * refined_order * p);
-            TacsScalar *u = &uref[vars_per_node * offset];
-            for (int i = 0; i < vars_per_node; i++) {
-              const TacsScalar *ue = &ubar[i];
-              for (int k = 0; k < nenrich; k++) {
-                u[i] += Nr[k] * ue[vars_per_node * k];
-              }
-            }
-          }
-        }
-      }
+    // Compute the reconstruction weights for the enrichment functions
+    computeElemReconBatch(vars_per_node, tables, nbatch, Xpts, uelem, delem,
+                          ubar, forest->getNumThreads());
 
-      // Zero the contribution if it goes to a dependent node
-      for (int i = 0; i < num_refined_nodes; i++) {
-        if (refined_nodes[i] < 0) {
-          for (int j = 0; j < vars_per_node; j++) {
-            uref[vars_per_node * i + j] = 0.0;
-          }
-        }
+    for (int j = 0; j < nbatch; j++) {
+      int elem = start + j;
+      if (element_nums) {
+        elem = element_nums[elem];
       }
+      const TacsScalar *ue0 = &uelem[vars_per_node * num_nodes * j];
+      const TacsScalar *ub0 = &ubar[vars_per_node * nenrich * j];
 
-      // Add the contributions to the element
-      vec_refined->setValues(len, refined_nodes, uref, TACS_ADD_VALUES);
-    } else {
       // Get the refined element nodes
+      int len;
       const int *refined_nodes;
       refined_tacs->getElement(elem, &len, &refined_nodes);
 
       // Zero the refined element contribution
       memset(uref, 0, vars_per_node * num_refined_nodes * sizeof(TacsScalar));
 
-      for (int p = 0; p < refined_order; p++) {
-        for (int m = 0; m < refined_order; m++) {
-          for (int n = 0; n < refined_order; n++) {
-            // Set the new parameter point in the refined element
-            double pt[3];
-            pt[0] = refined_knots[n];
-            pt[1] = refined_knots[m];
-            pt[2] = refined_knots[p];
-
-            // Evaluate the shape functions and the enrichment
-            // functions at the new parametric point
-            double N[MAX_ORDER * MAX_ORDER * MAX_ORDER];
-            forest->evalInterp(pt, N);
-
-            // Add the portion from the enrichment functions
-            int offset =
-                (n + refined_order * m + refined_order * refined_order * p);
-            TacsScalar *u = &uref[vars_per_node * offset];
-
-            for (int i = 0; i < vars_per_node; i++) {
-              const TacsScalar *ue = &uelem[i];
-              for (int k = 0; k < order * order * order; k++) {
-                u[i] += N[k] * ue[vars_per_node * k];
-              }
-            }
+      for (int p = 0; p < num_refined_nodes; p++) {
+        TacsScalar *u = &uref[vars_per_node * p];
 
-            double Nr[MAX_3D_ENRICH];
-            if (order == 2) {
-              eval2ndEnrichmentFuncs3D(pt, Nr);
-            } else if (order == 3) {
-              eval3rdEnrichmentFuncs3D(pt, Nr);
+        // Add the portion from the shape functions
+        if (!compute_difference) {
+          const double *N = &tables->N_refined[num_nodes * p];
+          for (int i = 0; i < vars_per_node; i++) {
+            const TacsScalar *ue = &ue0[i];
+            for (int k = 0; k < num_nodes; k++) {
+              u[i] += N[k] * ue[vars_per_node * k];
             }
+          }
+        }
 
-            // Add the portion from the enrichment functions
-            for (int i = 0; i < vars_per_node; i++) {
-              const TacsScalar *ue = &ubar[i];
-              for (int k = 0; k < nenrich; k++) {
-                u[i] += Nr[k] * ue[vars_per_node * k];
-              }
-            }
+        // Add the portion from the enrichment functions
+        const double *Nr = &tables->Nr_refined[nenrich * p];
+        for (int i = 0; i < vars_per_node; i++) {
+          const TacsScalar *ue = &ub0[i];
+          for (int k = 0; k < nenrich; k++) {
+            u[i] += Nr[k] * ue[vars_per_node * k];
           }
         }
       }
@@ -1676,8 +1991,8 @@ void addRefinedSolution3D(TMROctForest *forest, TACSAssembler *tacs,
       // Zero the contribution if it goes to a dependent node
       for (int i = 0; i < num_refined_nodes; i++) {
         if (refined_nodes[i] < 0) {
-          for (int j = 0; j < vars_per_node; j++) {
-            uref[vars_per_node * i + j] = 0.0;
+          for (int k = 0; k < vars_per_node; k++) {
+            uref[vars_per_node * i + k] = 0.0;
           }
         }
       }
@@ -1688,10 +2003,11 @@ void addRefinedSolution3D(TMROctForest *forest, TACSAssembler *tacs,
   }
 
   // Free allocated data
-  delete[] tmp;
+  delete tables;
   delete[] uelem;
   delete[] delem;
   delete[] ubar;
+  delete[] Xpts;
   delete[] uref;
 }
 
@@ -1821,6 +2137,13 @@ void TMR_ComputeInterpSolution(TMRQuadForest *forest, TACSAssembler *tacs,
   const int num_nodes = order * order;
   const int num_refined_nodes = refined_order * refined_order;
 
+  // Tabulate the shape functions at the refined knot locations
+  double *refined_pts = new double[2 * num_refined_nodes];
+  getTensorKnots2D(refined_order, refined_knots, refined_pts);
+  const double *N_table;
+  forest->getInterpTable(num_refined_nodes, refined_pts, &N_table);
+  delete[] refined_pts;
+
   // Get the number of elements
   const int nelems = tacs->getNumElements();
   const int vars_per_node = tacs->getVarsPerNode();
@@ -1872,16 +2195,9 @@ void TMR_ComputeInterpSolution(TMRQuadForest *forest, TACSAssembler *tacs,
     // Perform the interpolation
     for (int m = 0; m < refined_order; m++) {
       for (int n = 0; n < refined_order; n++) {
-        double pt[2];
-        pt[0] = refined_knots[n];
-        pt[1] = refined_knots[m];
-
-        // Evaluate the shape functions
-        double N[max_num_nodes];
-        forest->evalInterp(pt, N);
-
-        // Evaluate the interpolation
+        // Evaluate the interpolation using the tabulated shape functions
         int offset = n + m * refined_order;
+        const double *N = &N_table[num_nodes * offset];
         TacsScalar *v = &vars_interp[vars_per_node * offset];
 
         for (int k = 0; k < num_nodes; k++) {
@@ -1931,9 +2247,6 @@ void TMR_ComputeInterpSolution(TMROctForest *forest, TACSAssembler *tacs,
                                TMROctForest *forest_refined,
                                TACSAssembler *tacs_refined, TACSBVec *_uvec,
                                TACSBVec *_uvec_refined) {
-  // The maximum number of nodes
-  const int max_num_nodes = MAX_ORDER * MAX_ORDER * MAX_ORDER;
-
   // Get the order of the mesh
   const double *refined_knots;
   const int order = forest->getInterpKnots(NULL);
@@ -1941,6 +2254,13 @@ void TMR_ComputeInterpSolution(TMROctForest *forest, TACSAssembler *tacs,
   const int num_nodes = order * order * order;
   const int num_refined_nodes = refined_order * refined_order * refined_order;
 
+  // Tabulate the shape functions at the refined knot locations
+  double *refined_pts = new double[3 * num_refined_nodes];
+  getTensorKnots3D(refined_order, refined_knots, refined_pts);
+  const double *N_table;
+  forest->getInterpTable(num_refined_nodes, refined_pts, &N_table);
+  delete[] refined_pts;
+
   // Get the number of elements
   const int nelems = tacs->getNumElements();
   const int vars_per_node = tacs->getVarsPerNode();
@@ -1989,18 +2309,10 @@ void TMR_ComputeInterpSolution(TMROctForest *forest, TACSAssembler *tacs,
     for (int p = 0; p < refined_order; p++) {
       for (int m = 0; m < refined_order; m++) {
         for (int n = 0; n < refined_order; n++) {
-          double pt[3];
-          pt[0] = refined_knots[n];
-          pt[1] = refined_knots[m];
-          pt[2] = refined_knots[p];
-
-          // Evaluate the locations of the new nodes
-          double N[max_num_nodes];
-          forest->evalInterp(pt, N);
-
           // Evaluate the interpolation part of the reconstruction
           int offset =
               (n + m * refined_order + p * refined_order * refined_order);
+          const double *N = &N_table[num_nodes * offset];
           TacsScalar *v = &vars_interp[vars_per_node * offset];
 
           for (int k = 0; k < num_nodes; k++) {
@@ -2373,37 +2685,27 @@ void TMR_ComputeReconSolution(TMROctForest *forest, TACSAssembler *tacs,
 double TMR_StrainEnergyErrorEst(TMRQuadForest *forest, TACSAssembler *tacs,
                                 TMRQuadForest *forest_refined,
                                 TACSAssembler *tacs_refined, double *error) {
-  // The maximum number of nodes
-  const int max_num_nodes = MAX_ORDER * MAX_ORDER;
-
-  // Get the order of the original mesh and the number of enrichment
-  // functions associated with the order
-  const double *knots;
-  const int order = forest->getInterpKnots(&knots);
-  const int nenrich = getNum2dEnrich(order);
-
-  // Get the refined order of the mesh
-  const double *refined_knots;
-  const int refined_order = forest_refined->getInterpKnots(&refined_knots);
-  const int num_refined_nodes = refined_order * refined_order;
+  // Tabulate the shape and enrichment functions
+  TMRReconTables *tables = createReconTables2D(forest, forest_refined);
+  const int num_nodes = tables->size;
+  const int num_refined_nodes = tables->num_refined_pts;
+  const int nenrich = tables->nenrich;
 
   // Get the number of variables per node
   const int vars_per_node = tacs->getVarsPerNode();
   const int deriv_per_node = 3 * vars_per_node;
 
-  // The number of equations: 2 times the number of nodes for each element
-  const int neq = 2 * order * order;
-
   // Number of local elements
   const int nelems = tacs->getNumElements();
 
-  // Allocate space for the element reconstruction problem
-  TacsScalar *tmp = new TacsScalar[neq * (nenrich + vars_per_node)];
-  TacsScalar *ubar = new TacsScalar[vars_per_node * nenrich];
-  TacsScalar *delem = new TacsScalar[deriv_per_node * order * order];
-
-  // Allocate arrays needed for the reconstruction
-  TacsScalar *vars_elem = new TacsScalar[vars_per_node * order * order];
+  // Allocate space for the element data for a batch of elements
+  TacsScalar *ubar = new TacsScalar[RECON_BATCH_SIZE * vars_per_node * nenrich];
+  TacsScalar *delem =
+      new TacsScalar[RECON_BATCH_SIZE * deriv_per_node * num_nodes];
+  TacsScalar *vars_elem =
+      new TacsScalar[RECON_BATCH_SIZE * vars_per_node * num_nodes];
+  TacsScalar *Xpts = new TacsScalar[RECON_BATCH_SIZE * 3 * num_refined_nodes];
+  TACSElement *elems[RECON_BATCH_SIZE];
 
   // The interpolated variables on the refined mesh
   TacsScalar *dvars = new TacsScalar[vars_per_node * num_refined_nodes];
@@ -2443,62 +2745,64 @@ double TMR_StrainEnergyErrorEst(TMRQuadForest *forest, TACSAssembler *tacs,
   // Keep track of the total error
   TacsScalar SE_total_error = 0.0;
 
-  for (int i = 0; i < nelems; i++) {
-    // The simulation time -- we assume time-independent analysis
-    double time = 0.0;
-
-    // Get the variables for this element on the coarse mesh
-    tacs->getElement(i, NULL, vars_elem);
-
-    // Get the node numbers for this element
-    int len;
-    const int *nodes;
-    tacs->getElement(i, &len, &nodes);
+  for (int start = 0; start < nelems; start += RECON_BATCH_SIZE) {
+    int nbatch = nelems - start;
+    if (nbatch > RECON_BATCH_SIZE) {
+      nbatch = RECON_BATCH_SIZE;
+    }
 
-    // Compute the solution on the refined mesh
-    uderiv->getValues(len, nodes, delem);
+    // Gather the element data for the batch
+    for (int j = 0; j < nbatch; j++) {
+      int i = start + j;
 
-    // Get the refined node locations
-    TacsScalar Xpts[3 * max_num_nodes];
-    TACSElement *elem = tacs_refined->getElement(i, Xpts);
+      // Get the variables for this element on the coarse mesh
+      tacs->getElement(i, NULL, &vars_elem[vars_per_node * num_nodes * j]);
 
-    // Compute the enrichment functions for each degree of freedom
-    computeElemRecon2D(vars_per_node, forest, forest_refined, Xpts, vars_elem,
-                       delem, ubar, tmp);
+      // Get the node numbers for this element
+      int len;
+      const int *nodes;
+      tacs->getElement(i, &len, &nodes);
 
-    // Set the variables to zero
-    memset(vars_interp, 0,
-           vars_per_node * num_refined_nodes * sizeof(TacsScalar));
+      // Compute the solution on the refined mesh
+      uderiv->getValues(len, nodes, &delem[deriv_per_node * num_nodes * j]);
 
-    // Evaluate the interpolation on the refined mesh
-    for (int m = 0; m < refined_order; m++) {
-      for (int n = 0; n < refined_order; n++) {
-        double pt[2];
-        pt[0] = refined_knots[n];
-        pt[1] = refined_knots[m];
+      // Get the refined element and node locations
+      elems[j] = tacs_refined->getElement(i, &Xpts[3 * num_refined_nodes * j]);
+    }
 
-        // Add the contribution from the enrichment functions
-        double Nr[MAX_2D_ENRICH];
-        evalEnrichmentFuncs2D(order, pt, knots, Nr);
+    // Compute the enrichment functions for each degree of freedom
+    computeElemReconBatch(vars_per_node, tables, nbatch, Xpts, vars_elem,
+                          delem, ubar, 1);
 
-        // Add the portion from the enrichment functions
+    for (int j = 0; j < nbatch; j++) {
+      // The simulation time -- we assume time-independent analysis
+      double time = 0.0;
+      int i = start + j;
+      TacsScalar *X = &Xpts[3 * num_refined_nodes * j];
+      const TacsScalar *ub = &ubar[vars_per_node * nenrich * j];
+      TACSElement *elem = elems[j];
+
+      // Evaluate the interpolation on the refined mesh
+      memset(vars_interp, 0,
+             vars_per_node * num_refined_nodes * sizeof(TacsScalar));
+      for (int p = 0; p < num_refined_nodes; p++) {
+        const double *Nr = &tables->Nr_refined[nenrich * p];
+        TacsScalar *v = &vars_interp[vars_per_node * p];
         for (int k = 0; k < nenrich; k++) {
-          // Evaluate the interpolation part of the reconstruction
           for (int kk = 0; kk < vars_per_node; kk++) {
-            vars_interp[vars_per_node * (n + m * refined_order) + kk] +=
-                ubar[vars_per_node * k + kk] * Nr[k];
+            v[kk] += ub[vars_per_node * k + kk] * Nr[k];
           }
         }
       }
-    }
 
-    // Compute the strain/potential energy
-    TacsScalar Te, Pe;
-    elem->computeEnergies(i, time, Xpts, vars_interp, dvars, &Te, &Pe);
-    error[i] = fabs(TacsRealPart(Pe));
+      // Compute the strain/potential energy
+      TacsScalar Te, Pe;
+      elem->computeEnergies(i, time, X, vars_interp, dvars, &Te, &Pe);
+      error[i] = fabs(TacsRealPart(Pe));
 
-    // Add up the total error
-    SE_total_error += error[i];
+      // Add up the total error
+      SE_total_error += error[i];
+    }
   }
 
   // Count up the total strain energy
@@ -2511,10 +2815,11 @@ double TMR_StrainEnergyErrorEst(TMRQuadForest *forest, TACSAssembler *tacs,
   uderiv->decref();
 
   // Free the element-related data
-  delete[] tmp;
+  delete tables;
   delete[] ubar;
   delete[] delem;
   delete[] vars_elem;
+  delete[] Xpts;
   delete[] dvars;
   delete[] vars_interp;
 
@@ -2530,45 +2835,37 @@ double TMR_StrainEnergyErrorEst(TMRQuadForest *forest, TACSAssembler *tacs,
   quadtrees.
 */
 double TMR_StrainEnergyErrorEst(TMROctForest *forest, TACSAssembler *tacs,
-                                TMROctForest *refined_forest,
-                                TACSAssembler *refined_tacs, double *error) {
-  // The maximum number of nodes
-  const int max_num_nodes = MAX_ORDER * MAX_ORDER * MAX_ORDER;
-
-  // Get the order of the original mesh and the number of enrichment
-  // functions associated with the order
-  const double *knots;
-  const int order = forest->getInterpKnots(&knots);
-  const int nenrich = getNum3dEnrich(order);
-
-  // Get the refined order of the mesh
-  const double *refined_knots;
-  const int refined_order = refined_forest->getInterpKnots(&refined_knots);
-  const int num_nodes = order * order * order;
-  const int num_refined_nodes = refined_order * refined_order * refined_order;
+                                TMROctForest *forest_refined,
+                                TACSAssembler *tacs_refined, double *error) {
+  // Tabulate the shape and enrichment functions
+  TMRReconTables *tables = createReconTables3D(forest, forest_refined);
+  const int num_nodes = tables->size;
+  const int num_refined_nodes = tables->num_refined_pts;
+  const int nenrich = tables->nenrich;
 
   // Get the number of variables per node
   const int vars_per_node = tacs->getVarsPerNode();
   const int deriv_per_node = 3 * vars_per_node;
 
-  // The number of equations: 3 times the number of nodes for each element
-  const int neq = 3 * order * order * order;
-
   // Number of local elements
   const int nelems = tacs->getNumElements();
 
-  // Allocate space for the element reconstruction problem
-  TacsScalar *tmp = new TacsScalar[neq * (nenrich + vars_per_node)];
-  TacsScalar *ubar = new TacsScalar[vars_per_node * nenrich];
-  TacsScalar *delem = new TacsScalar[deriv_per_node * num_nodes];
-
-  // Allocate arrays needed for the reconstruction
-  TacsScalar *vars_elem = new TacsScalar[vars_per_node * num_nodes];
+  // Allocate space for the element data for a batch of elements
+  TacsScalar *ubar = new TacsScalar[RECON_BATCH_SIZE * vars_per_node * nenrich];
+  TacsScalar *delem =
+      new TacsScalar[RECON_BATCH_SIZE * deriv_per_node * num_nodes];
+  TacsScalar *vars_elem =
+      new TacsScalar[RECON_BATCH_SIZE * vars_per_node * num_nodes];
+  TacsScalar *Xpts = new TacsScalar[RECON_BATCH_SIZE * 3 * num_refined_nodes];
+  TACSElement *elems[RECON_BATCH_SIZE];
 
   // The interpolated variables on the refined mesh
   TacsScalar *dvars = new TacsScalar[vars_per_node * num_refined_nodes];
   TacsScalar *vars_interp = new TacsScalar[vars_per_node * num_refined_nodes];
 
+  // Zero the refined nodes
+  memset(dvars, 0, vars_per_node * num_refined_nodes * sizeof(TacsScalar));
+
   // Get the communicator
   MPI_Comm comm = tacs->getMPIComm();
 
@@ -2600,68 +2897,64 @@ double TMR_StrainEnergyErrorEst(TMROctForest *forest, TACSAssembler *tacs,
   // Keep track of the total error
   double SE_total_error = 0.0;
 
-  for (int i = 0; i < nelems; i++) {
-    // The simulation time -- we assume time-independent analysis
-    double time = 0.0;
-
-    // Get the node numbers for this element
-    int len;
-    const int *nodes;
-    tacs->getElement(i, &len, &nodes);
+  for (int start = 0; start < nelems; start += RECON_BATCH_SIZE) {
+    int nbatch = nelems - start;
+    if (nbatch > RECON_BATCH_SIZE) {
+      nbatch = RECON_BATCH_SIZE;
+    }
 
-    // Get the values of the derivatives at the nodes
-    uderiv->getValues(len, nodes, delem);
+    // Gather the element data for the batch
+    for (int j = 0; j < nbatch; j++) {
+      int i = start + j;
 
-    // Get the node locations on the new mesh
-    TacsScalar Xpts[3 * max_num_nodes];
-    TACSElement *elem = refined_tacs->getElement(i, Xpts);
+      // Get the variables for this element on the coarse mesh
+      tacs->getElement(i, NULL, &vars_elem[vars_per_node * num_nodes * j]);
 
-    // Compute the enrichment functions for each degree of freedom
-    computeElemRecon3D(vars_per_node, forest, refined_forest, Xpts, vars_elem,
-                       delem, ubar, tmp);
+      // Get the node numbers for this element
+      int len;
+      const int *nodes;
+      tacs->getElement(i, &len, &nodes);
 
-    // Set the variables to zero
-    memset(vars_interp, 0,
-           vars_per_node * num_refined_nodes * sizeof(TacsScalar));
+      // Compute the solution on the refined mesh
+      uderiv->getValues(len, nodes, &delem[deriv_per_node * num_nodes * j]);
 
-    for (int p = 0; p < refined_order; p++) {
-      for (int m = 0; m < refined_order; m++) {
-        for (int n = 0; n < refined_order; n++) {
-          double pt[3];
-          pt[0] = refined_knots[n];
-          pt[1] = refined_knots[m];
-          pt[2] = refined_knots[p];
+      // Get the refined element and node locations
+      elems[j] = tacs_refined->getElement(i, &Xpts[3 * num_refined_nodes * j]);
+    }
 
-          // Evaluate the difference between the interpolation
-          // and the reconstruction (just the reconstruction part)
-          double Nr[MAX_3D_ENRICH];
-          if (order == 2) {
-            eval2ndEnrichmentFuncs3D(pt, Nr);
-          } else {
-            eval3rdEnrichmentFuncs3D(pt, Nr);
-          }
+    // Compute the enrichment functions for each degree of freedom
+    computeElemReconBatch(vars_per_node, tables, nbatch, Xpts, vars_elem,
+                          delem, ubar, forest->getNumThreads());
 
-          // Add the portion from the enrichment functions
-          int offset =
-              (n + m * refined_order + p * refined_order * refined_order);
-          TacsScalar *v = &vars_interp[vars_per_node * offset];
-          for (int k = 0; k < nenrich; k++) {
-            // Evaluate the interpolation part of the reconstruction
-            for (int kk = 0; kk < vars_per_node; kk++) {
-              v[kk] += ubar[vars_per_node * k + kk] * Nr[k];
-            }
+    for (int j = 0; j < nbatch; j++) {
+      // The simulation time -- we assume time-independent analysis
+      double time = 0.0;
+      int i = start + j;
+      TacsScalar *X = &Xpts[3 * num_refined_nodes * j];
+      const TacsScalar *ub = &ubar[vars_per_node * nenrich * j];
+      TACSElement *elem = elems[j];
+
+      // Evaluate the interpolation on the refined mesh
+      memset(vars_interp, 0,
+             vars_per_node * num_refined_nodes * sizeof(TacsScalar));
+      for (int p = 0; p < num_refined_nodes; p++) {
+        const double *Nr = &tables->Nr_refined[nenrich * p];
+        TacsScalar *v = &vars_interp[vars_per_node * p];
+        for (int k = 0; k < nenrich; k++) {
+          for (int kk = 0; kk < vars_per_node; kk++) {
+            v[kk] += ub[vars_per_node * k + kk] * Nr[k];
           }
         }
       }
-    }
 
-    // Compute the strain/potential energy
-    TacsScalar Te, Pe;
-    elem->computeEnergies(i, time, Xpts, vars_interp, dvars, &Te, &Pe);
-    error[i] = fabs(TacsRealPart(Pe));
+      // Compute the strain/potential energy
+      TacsScalar Te, Pe;
+      elem->computeEnergies(i, time, X, vars_interp, dvars, &Te, &Pe);
+      error[i] = fabs(TacsRealPart(Pe));
 
-    // Add up the total error
-    SE_total_error += error[i];
+      // Add up the total error
+      SE_total_error += error[i];
+    }
   }
 
   // Count up the total strain energy
@@ -2674,10 +2967,11 @@ double TMR_StrainEnergyErrorEst(TMROctForest *forest, TACSAssembler *tacs,
   uderiv->decref();
 
   // Free the element-related data
-  delete[] tmp;
+  delete tables;
   delete[] ubar;
   delete[] delem;
   delete[] vars_elem;
+  delete[] Xpts;
   delete[] dvars;
   delete[] vars_interp;
 
@@ -2735,11 +3029,21 @@ void TMR_PrintErrorBins(MPI_Comm comm, const double *error, const int nelems,
     } else if (error[i] >= bin_bounds[NUM_BINS]) {
       bins[NUM_BINS + 1]++;
     } else {
-      for (int j = 0; j < NUM_BINS; j++) {
-        if (error[i] >= bin_bounds[j] && error[i] < bin_bounds[j + 1]) {
-          bins[j + 1]++;
-        }
+      // Compute the bin index directly and correct it for any
+      // round-off in the bin bounds
+      int j = (int)((log10(error[i]) - low) * NUM_BINS / (high - low));
+      if (j < 0) {
+        j = 0;
+      } else if (j >= NUM_BINS) {
+        j = NUM_BINS - 1;
+      }
+      while (j > 0 && error[i] < bin_bounds[j]) {
+        j--;
       }
+      while (j < NUM_BINS - 1 && error[i] >= bin_bounds[j + 1]) {
+        j++;
+      }
+      bins[j + 1]++;
     }
   }
 
@@ -2771,35 +3075,247 @@ void TMR_PrintErrorBins(MPI_Comm comm, const double *error, const int nelems,
   }
 }
 
-/*!
-  Create a nodal vector from the forest
+/*
+  Compute the key used to bin the element errors. When all the errors
+  in the range are positive, the bins are logarithmic since the errors
+  typically span many orders of magnitude.
 */
-void createPartUnityVector(TMRQuadForest *pu, TACSBVec **pu_vec) {
-  MPI_Comm comm = pu->getMPIComm();
+static inline double getErrorBinKey(double err, int use_log) {
+  if (use_log) {
+    return log(err);
+  }
+  return err;
+}
 
-  // Get the rank
-  int mpi_rank;
-  MPI_Comm_rank(comm, &mpi_rank);
+/*
+  Select an error threshold in parallel using a histogram with quantile
+  bisection.
 
-  // Create the variable map for the partition of unity constraint
-  const int *pu_range;
-  pu->getOwnedNodeRange(&pu_range);
+  The candidate elements are binned within the range of their errors,
+  the bin that contains the target count is found and the candidate
+  set is reduced to that bin. This repeats until the target is met
+  exactly or the candidates all share the same error. Each iteration
+  requires O(n) work on the remaining candidates and two reductions.
 
-  int num_pu_local = pu_range[mpi_rank + 1] - pu_range[mpi_rank];
-  TACSNodeMap *pu_map = new TACSNodeMap(comm, num_pu_local);
+  When largest is true, the returned threshold t is the largest value
+  such that the number of elements with error >= t is at least
+  ntarget. Otherwise, t is the smallest value such that the number of
+  elements with error <= t is at least ntarget.
 
-  // Create/retrieve the dependent node information
-  const int *dep_ptr = NULL, *dep_conn = NULL;
-  const double *dep_weights = NULL;
-  int ndep = pu->getDepNodeConn(&dep_ptr, &dep_conn, &dep_weights);
+  input:
+  comm:     the communicator
+  error:    the element errors
+  nelems:   the number of local elements
+  ntarget:  the target number of elements across all processors
+  largest:  select from the largest (or smallest) errors
 
-  // Get the external numbers from the filter itself
-  const int *pu_ext;
-  int num_pu_ext = pu->getNodeNumbers(&pu_ext);
+  returns:  the error threshold
+*/
+double TMR_ComputeErrorThreshold(MPI_Comm comm, const double *error,
+                                 const int nelems, const int ntarget,
+                                 int largest) {
+  const int NUM_BINS = 64;
+  const int MAX_ITERATIONS = 32;
 
-  // Count up all the external nodes
-  int num_ext = 0;
-  int *ext_nodes = new int[num_pu_ext];
+  // Compute the total number of elements
+  int ntotal = nelems;
+  MPI_Allreduce(MPI_IN_PLACE, &ntotal, 1, MPI_INT, MPI_SUM, comm);
+
+  // Keep a list of the candidate elements
+  int nactive = nelems;
+  int *active = new int[nelems + 1];
+  for (int i = 0; i < nelems; i++) {
+    active[i] = i;
+  }
+
+  // The number of elements already selected outside the candidates
+  // and the number of candidates across all processors
+  int nselect = 0;
+  int ncandidates = ntotal;
+
+  double threshold = 0.0;
+  for (int iter = 0;; iter++) {
+    // Compute the range of the candidate errors
+    double range[2];
+    range[0] = -HUGE_VAL;
+    range[1] = -HUGE_VAL;
+    for (int i = 0; i < nactive; i++) {
+      double err = error[active[i]];
+      if (err > range[0]) {
+        range[0] = err;
+      }
+      if (-err > range[1]) {
+        range[1] = -err;
+      }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, range, 2, MPI_DOUBLE, MPI_MAX, comm);
+    double emax = range[0];
+    double emin = -range[1];
+
+    // Check if the selection is complete
+    if (ntarget <= 0 || ncandidates == 0) {
+      threshold = (largest ? HUGE_VAL : -HUGE_VAL);
+      break;
+    } else if (nselect + ncandidates <= ntarget || emin >= emax ||
+               iter >= MAX_ITERATIONS) {
+      threshold = (largest ? emin : emax);
+      break;
+    }
+
+    // Compute the histogram of the candidates
+    int use_log = (emin > 0.0);
+    double low = getErrorBinKey(emin, use_log);
+    double high = getErrorBinKey(emax, use_log);
+    double scale = NUM_BINS / (high - low);
+
+    int bins[NUM_BINS];
+    memset(bins, 0, NUM_BINS * sizeof(int));
+    for (int i = 0; i < nactive; i++) {
+      double key = getErrorBinKey(error[active[i]], use_log);
+      int k = (int)((key - low) * scale);
+      if (k < 0) {
+        k = 0;
+      } else if (k >= NUM_BINS) {
+        k = NUM_BINS - 1;
+      }
+      bins[k]++;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, bins, NUM_BINS, MPI_INT, MPI_SUM, comm);
+
+    // Find the bin that contains the target count. The bin index is
+    // monotonic in the error so all the elements in the skipped bins
+    // are strictly greater (or less) than those in the selected bin.
+    int kbin = 0;
+    if (largest) {
+      for (kbin = NUM_BINS - 1; kbin > 0; kbin--) {
+        if (nselect + bins[kbin] >= ntarget) {
+          break;
+        }
+        nselect += bins[kbin];
+      }
+    } else {
+      for (kbin = 0; kbin < NUM_BINS - 1; kbin++) {
+        if (nselect + bins[kbin] >= ntarget) {
+          break;
+        }
+        nselect += bins[kbin];
+      }
+    }
+    ncandidates = bins[kbin];
+
+    // Reduce the candidates to the elements in the selected bin
+    int n = 0;
+    for (int i = 0; i < nactive; i++) {
+      double key = getErrorBinKey(error[active[i]], use_log);
+      int k = (int)((key - low) * scale);
+      if (k < 0) {
+        k = 0;
+      } else if (k >= NUM_BINS) {
+        k = NUM_BINS - 1;
+      }
+      if (k == kbin) {
+        active[n] = active[i];
+        n++;
+      }
+    }
+    nactive = n;
+  }
+
+  delete[] active;
+
+  return threshold;
+}
+
+/*
+  Compute the refinement array for the forest from the element errors
+
+  The elements with the nrefine largest errors are refined provided
+  their error is at least refine_cutoff, while the elements with the
+  ncoarsen smallest errors are coarsened provided their error is less
+  than coarsen_cutoff. Elements with tied errors at a threshold are
+  all selected. The output array can be passed directly to refine().
+
+  input:
+  comm:            the communicator
+  error:           the element errors
+  nelems:          the number of local elements
+  nrefine:         the target number of elements to refine
+  ncoarsen:        the target number of elements to coarsen
+  refine_cutoff:   the smallest error that is refined
+  coarsen_cutoff:  the errors below this value may be coarsened
+
+  output:
+  refine:              the refinement array (1, 0 or -1)
+  refine_threshold:    the threshold used for refinement
+  coarsen_threshold:   the threshold used for coarsening
+
+  returns:  the number of refined elements across all processors
+*/
+int TMR_ComputeRefinementArray(MPI_Comm comm, const double *error,
+                               const int nelems, const int nrefine,
+                               const int ncoarsen, double refine_cutoff,
+                               double coarsen_cutoff, int *refine,
+                               double *refine_threshold,
+                               double *coarsen_threshold) {
+  // Find the error thresholds for the refinement and coarsening
+  double rthresh = TMR_ComputeErrorThreshold(comm, error, nelems, nrefine, 1);
+  if (rthresh < refine_cutoff) {
+    rthresh = refine_cutoff;
+  }
+  double cthresh =
+      TMR_ComputeErrorThreshold(comm, error, nelems, ncoarsen, 0);
+
+  int count = 0;
+  for (int i = 0; i < nelems; i++) {
+    refine[i] = 0;
+    if (error[i] >= rthresh) {
+      refine[i] = 1;
+      count++;
+    } else if (error[i] <= cthresh && error[i] < coarsen_cutoff) {
+      refine[i] = -1;
+    }
+  }
+  MPI_Allreduce(MPI_IN_PLACE, &count, 1, MPI_INT, MPI_SUM, comm);
+
+  if (refine_threshold) {
+    *refine_threshold = rthresh;
+  }
+  if (coarsen_threshold) {
+    *coarsen_threshold = cthresh;
+  }
+
+  return count;
+}
+
+/*!
+  Create a nodal vector from the forest
+*/
+void createPartUnityVector(TMRQuadForest *pu, TACSBVec **pu_vec) {
+  MPI_Comm comm = pu->getMPIComm();
+
+  // Get the rank
+  int mpi_rank;
+  MPI_Comm_rank(comm, &mpi_rank);
+
+  // Create the variable map for the partition of unity constraint
+  const int *pu_range;
+  pu->getOwnedNodeRange(&pu_range);
+
+  int num_pu_local = pu_range[mpi_rank + 1] - pu_range[mpi_rank];
+  TACSNodeMap *pu_map = new TACSNodeMap(comm, num_pu_local);
+
+  // Create/retrieve the dependent node information
+  const int *dep_ptr = NULL, *dep_conn = NULL;
+  const double *dep_weights = NULL;
+  int ndep = pu->getDepNodeConn(&dep_ptr, &dep_conn, &dep_weights);
+
+  // Get the external numbers from the filter itself
+  const int *pu_ext;
+  int num_pu_ext = pu->getNodeNumbers(&pu_ext);
+
+  // Count up all the external nodes
+  int num_ext = 0;
+  int *ext_nodes = new int[num_pu_ext];
 
   // Add the external nodes from the filter
   for (int i = 0; i < num_pu_ext; i++) {
@@ -3063,16 +3579,21 @@ double TMR_AdjointErrorEst(TMRQuadForest *forest, TACSAssembler *tacs,
 /*
   Refine the mesh using the original solution and the adjoint solution
 
+  The adjoint-weighted residual, the nodal error and the element count
+  used to localize the error are computed in a single pass over the
+  elements and assembled with one set/distribute exchange.
+
   input:
-  forest:           the forest of quadtrees
+  forest:           the forest of octrees
   tacs:             the TACSAssembler object
-  forest_refined:   the higher-order forest of quadtrees
+  forest_refined:   the higher-order forest of octrees
   tacs_refined:     the higher-order TACSAssembler object
   solution_refined: the higher-order solution (or approximation)
   adjoint_refined:  the difference between the refined and coarse adjoint
                     solutions computed in some manner
 
   output:
+  error:         the element-wise error estimates
   adj_corr:      adjoint-based functional correction
 
   returns:
@@ -3084,158 +3605,727 @@ double TMR_AdjointErrorEst(TMROctForest *forest, TACSAssembler *tacs,
                            TACSBVec *solution_refined,
                            TACSBVec *adjoint_refined, double *error,
                            double *adj_corr) {
-  /*
-    const int max_num_nodes = MAX_ORDER*MAX_ORDER*MAX_ORDER;
-
-    // Get the order of the mesh and the number of enrichment shape functions
-    const double *refined_knots;
-    const int refined_order = forest_refined->getInterpKnots(&refined_knots);
-    const int num_refined_nodes = refined_order*refined_order*refined_order;
-
-    // Perform a local refinement of the nodes based on the strain energy
-    // within each element
-    const int nelems = tacs->getNumElements();
-
-    // Get the number of variables per node
-    const int vars_per_node = tacs->getVarsPerNode();
-
-    // Get the communicator
-    MPI_Comm comm = tacs->getMPIComm();
-
-    // Allocate the element arrays needed for the reconstruction
-    TacsScalar *vars_interp = new TacsScalar[ vars_per_node*num_refined_nodes ];
-    TacsScalar *adj_interp = new TacsScalar[ vars_per_node*num_refined_nodes ];
-
-    // Allocate the nodal error estimates array
-    TacsScalar *err = new TacsScalar[ num_refined_nodes ];
-
-    // Keep track of the total error remaining from each element
-    // indicator and the adjoint error correction
-    double total_error_remain = 0.0;
-    TacsScalar total_adjoint_corr = 0.0;
-
-    // Create a vector for the predicted nodal errors.
-    TACSBVec *nodal_error = new TACSBVec(tacs_refined->getNodeMap(), 1,
-                                         tacs_refined->getBVecDistribute(),
-                                         tacs_refined->getBVecDepNodes());
-    nodal_error->incref();
-
-    // Distribute the values for the adjoint/solution
-    solution_refined->beginDistributeValues();
-    adjoint_refined->beginDistributeValues();
-    solution_refined->endDistributeValues();
-    adjoint_refined->endDistributeValues();
-
-    // Get the auxiliary elements (surface tractions) associated with
-    // the element class
-    TACSAuxElements *aux_elements = tacs_refined->getAuxElements();
-    int num_aux_elems = 0;
-    TACSAuxElem *aux = NULL;
-    if (aux_elements){
-      aux_elements->sort();
-      num_aux_elems = aux_elements->getAuxElements(&aux);
+  // The maximum number of nodes
+  const int max_num_nodes = MAX_ORDER * MAX_ORDER * MAX_ORDER;
+
+  // Get the number of variables per node
+  const int vars_per_node = tacs->getVarsPerNode();
+
+  // Get the order of the refined mesh
+  const double *refined_knots;
+  const int refined_order = forest_refined->getInterpKnots(&refined_knots);
+  const int num_refined_nodes = refined_order * refined_order * refined_order;
+
+  // Get the number of elements in the coarse/refined mesh
+  const int nelems = tacs->getNumElements();
+
+  // Get the communicator
+  MPI_Comm comm = tacs->getMPIComm();
+
+  // Allocate the element arrays needed for the adjoint-weighted residual
+  TacsScalar *vars_refined = new TacsScalar[vars_per_node * num_refined_nodes];
+  TacsScalar *dvars_refined = new TacsScalar[vars_per_node * num_refined_nodes];
+  TacsScalar *ddvars_refined =
+      new TacsScalar[vars_per_node * num_refined_nodes];
+  TacsScalar *adj_refined = new TacsScalar[vars_per_node * num_refined_nodes];
+  TacsScalar *res_refined = new TacsScalar[vars_per_node * num_refined_nodes];
+  memset(dvars_refined, 0,
+         vars_per_node * num_refined_nodes * sizeof(TacsScalar));
+  memset(ddvars_refined, 0,
+         vars_per_node * num_refined_nodes * sizeof(TacsScalar));
+
+  // The nodal error estimate and the element count for each node,
+  // stored as pairs so that both are assembled together
+  TacsScalar *err = new TacsScalar[2 * num_refined_nodes];
+
+  // Keep track of the total output functional error estimate and the total
+  // output functional correction terms
+  TacsScalar total_error_est = 0.0;
+  TacsScalar total_output_corr = 0.0;
+
+  // Create a distributed vector for the nodal error estimates and the
+  // element count of each node. The count is used for the error
+  // localization from the nodes to the elements.
+  TACSNodeMap *refined_map = tacs_refined->getNodeMap();
+  TACSBVecDistribute *refined_dist = tacs_refined->getBVecDistribute();
+  TACSBVecDepNodes *refined_dep_nodes = tacs_refined->getBVecDepNodes();
+  TACSBVec *nodal_error =
+      new TACSBVec(refined_map, 2, refined_dist, refined_dep_nodes);
+  nodal_error->incref();
+  nodal_error->zeroEntries();
+
+  // Distribute the values for the adjoint/solution
+  solution_refined->beginDistributeValues();
+  adjoint_refined->beginDistributeValues();
+  solution_refined->endDistributeValues();
+  adjoint_refined->endDistributeValues();
+
+  // Get the auxiliary elements defined in the problem
+  TACSAuxElements *aux_elements = tacs_refined->getAuxElements();
+  int num_aux_elems = 0;
+  TACSAuxElem *aux = NULL;
+  if (aux_elements) {
+    aux_elements->sort();
+    num_aux_elems = aux_elements->getAuxElements(&aux);
+  }
+
+  // Compute the nodal error estimates using an adjoint-weighted
+  // residual and the element counts in a single pass over the elements
+  int aux_count = 0;
+  for (int elem = 0; elem < nelems; elem++) {
+    // Set the simulation time
+    double time = 0.0;
+
+    // Get the node numbers for this element in the refined mesh
+    int nnodes = 0;
+    const int *node_inds;
+    tacs_refined->getElement(elem, &nnodes, &node_inds);
+
+    // Get the node locations for this element
+    TacsScalar Xpts[3 * max_num_nodes];
+    TACSElement *element = tacs_refined->getElement(elem, Xpts);
+
+    // Get the state and adjoint variables for this element
+    solution_refined->getValues(nnodes, node_inds, vars_refined);
+    adjoint_refined->getValues(nnodes, node_inds, adj_refined);
+
+    // Compute the residual on the element
+    memset(err, 0, 2 * nnodes * sizeof(TacsScalar));
+    memset(res_refined, 0, nnodes * vars_per_node * sizeof(TacsScalar));
+    element->addResidual(elem, time, Xpts, vars_refined, dvars_refined,
+                         ddvars_refined, res_refined);
+
+    // Compute the nodal error estimates with the adjoint-weighted residual
+    for (int inode = 0; inode < nnodes; inode++) {
+      for (int ivar = 0; ivar < vars_per_node; ivar++) {
+        int ind = vars_per_node * inode + ivar;
+        err[2 * inode] += -1. * (res_refined[ind] * adj_refined[ind]);
+      }
     }
 
-    // Compute the residual on the refined mesh with the interpolated
-    // variables.
-    int aux_count = 0;
-    for ( int elem = 0; elem < nelems; elem++ ){
-      // Set the simulation time
-      double time = 0.0;
+    // Add the contribution from any loads - opposite sign for error
+    // contribution
+    while (aux_count < num_aux_elems && aux[aux_count].num == elem) {
+      memset(res_refined, 0, nnodes * vars_per_node * sizeof(TacsScalar));
+      aux[aux_count].elem->addResidual(elem, time, Xpts, vars_refined,
+                                       dvars_refined, ddvars_refined,
+                                       res_refined);
+      for (int inode = 0; inode < nnodes; inode++) {
+        for (int ivar = 0; ivar < vars_per_node; ivar++) {
+          int ind = vars_per_node * inode + ivar;
+          err[2 * inode] += 1. * (res_refined[ind] * adj_refined[ind]);
+        }
+      }
+      aux_count++;
+    }
 
-      // Get the node numbers for the refined mesh
-      int refine_len = 0;
-      const int *refine_nodes;
-      tacs_refined->getElement(elem, &refine_nodes, &refine_len);
+    // Add the nodal errors to the total output functional correction
+    // term and count the element for each independent node
+    for (int i = 0; i < nnodes; i++) {
+      total_output_corr += TacsRealPart(err[2 * i]);
+      err[2 * i + 1] = (node_inds[i] < 0 ? 0.0 : 1.0);
+    }
 
-      // Get the node locations
-      TacsScalar Xpts[3*max_num_nodes];
-      TACSElement *element = tacs_refined->getElement(elem, Xpts);
+    // Add the nodal errors from this element to the nodal error vector
+    nodal_error->setValues(nnodes, node_inds, err, TACS_ADD_VALUES);
+  }
 
-      // Get the adjoint variables for this element
-      solution_refined->getValues(refine_len, refine_nodes, vars_interp);
-      adjoint_refined->getValues(refine_len, refine_nodes, adj_interp);
+  // Finish setting the values into the nodal error array
+  nodal_error->beginSetValues(TACS_ADD_VALUES);
+  nodal_error->endSetValues(TACS_ADD_VALUES);
 
-      // Compute the localized error on the refined mesh
-      memset(err, 0, element->getNumNodes()*sizeof(TacsScalar));
-      element->addLocalizedError(time, err, adj_interp,
-                                 Xpts, vars_interp);
+  // Distribute the values back to all nodes
+  nodal_error->beginDistributeValues();
+  nodal_error->endDistributeValues();
 
-      // Add the contribution from any forces
-      while (aux_count < num_aux_elems && aux[aux_count].num == elem){
-        aux[aux_count].elem->addLocalizedError(time, err, adj_interp,
-                                               Xpts, vars_interp);
-        aux_count++;
+  // Localize the error from the nodes to the elements with an equal split
+  for (int elem = 0; elem < nelems; elem++) {
+    // Get the node numbers for this element in the refined mesh
+    int nnodes = 0;
+    const int *node_inds;
+    tacs_refined->getElement(elem, &nnodes, &node_inds);
+
+    // Get the errors and element counts for the nodes of this element
+    nodal_error->getValues(nnodes, node_inds, err);
+
+    // Compute the element indicator error as a function of the nodal
+    // error estimate.
+    error[elem] = 0.0;
+    for (int i = 0; i < nnodes; i++) {
+      if (node_inds[i] < 0) {
+        // skip dependent nodes - handled in beginSetValues() with dep weights
+        continue;
+      }
+      error[elem] += TacsRealPart(err[2 * i]) / TacsRealPart(err[2 * i + 1]);
+    }
+    // absolute value after the sum allows for error cancellation between each
+    // basis function within an element
+    error[elem] = fabs(error[elem]);
+    total_error_est += error[elem];
+  }
+
+  // Sum up the contributions across all processors
+  double temp[2];
+  temp[0] = total_error_est;
+  temp[1] = total_output_corr;
+  MPI_Allreduce(MPI_IN_PLACE, temp, 2, MPI_DOUBLE, MPI_SUM, comm);
+  total_error_est = temp[0];
+  total_output_corr = temp[1];
+
+  // Free the data that is no longer required
+  delete[] vars_refined;
+  delete[] dvars_refined;
+  delete[] ddvars_refined;
+  delete[] adj_refined;
+  delete[] res_refined;
+  delete[] err;
+  nodal_error->decref();
+
+  // Set the adjoint residual correction
+  if (adj_corr) {
+    *adj_corr = total_output_corr;
+  }
+
+  // Return the error
+  return total_error_est;
+}
+
+/*
+  Set up a virtual refinement of the forest of octrees
+
+  The refined forest is a copy of the octants with the mesh order
+  elevated by one. No nodes are created for the refined forest and no
+  refined TACSAssembler object is built. Instead, the creator is used
+  to make the higher-order elements and any auxiliary elements so that
+  the refined residual can be evaluated element-by-element.
+
+  input:
+  forest:        the forest of octrees
+  creator:       the creator object used to make the refined elements
+  num_elements:  the number of local elements
+
+  output:
+  elements:      the refined elements (each one is incref'd)
+  aux_elements:  the auxiliary elements (may be NULL)
+
+  returns:       the refined forest (incref'd)
+*/
+static TMROctForest *createVirtualRefinement(TMROctForest *forest,
+                                             TMROctTACSCreator *creator,
+                                             int num_elements,
+                                             TACSElement **elements,
+                                             TACSAuxElements **aux_elements) {
+  // Create a forest with elevated order. This only duplicates the
+  // octants and not the node data.
+  TMROctForest *forest_refined = forest->duplicate();
+  forest_refined->incref();
+  const int order = forest->getMeshOrder();
+  forest_refined->setMeshOrder(order + 1, forest->getInterpType());
+
+  // Create the higher-order elements
+  if (num_elements > 0) {
+    memset(elements, 0, num_elements * sizeof(TACSElement *));
+    creator->createElements(order + 1, forest_refined, num_elements,
+                            elements);
+    for (int i = 0; i < num_elements; i++) {
+      elements[i]->incref();
+    }
+  }
+
+  // Create the auxiliary elements for the refined mesh
+  *aux_elements = creator->createAuxElements(order + 1, forest_refined);
+  if (*aux_elements) {
+    (*aux_elements)->incref();
+    (*aux_elements)->sort();
+  }
+
+  return forest_refined;
+}
+
+/*
+  Interpolate the node locations of the refined element from the node
+  locations of the original element
+*/
+static void computeVirtualRefinedXpts(const TMRReconTables *tables,
+                                      const TacsScalar Xpts[],
+                                      TacsScalar Xrefined[]) {
+  const int size = tables->size;
+  for (int p = 0; p < tables->num_refined_pts; p++) {
+    const double *N = &tables->N_refined[size * p];
+    TacsScalar *X = &Xrefined[3 * p];
+    X[0] = X[1] = X[2] = 0.0;
+    for (int k = 0; k < size; k++) {
+      X[0] += N[k] * Xpts[3 * k];
+      X[1] += N[k] * Xpts[3 * k + 1];
+      X[2] += N[k] * Xpts[3 * k + 2];
+    }
+  }
+}
+
+/*
+  Evaluate the reconstructed solution at the nodes of the refined
+  element. When compute_difference is set, only the contribution from
+  the enrichment functions is included.
+*/
+static void evalVirtualRefinedSolution(const int vars_per_node,
+                                       const TMRReconTables *tables,
+                                       const TacsScalar uvals[],
+                                       const TacsScalar ubar[],
+                                       TacsScalar uref[],
+                                       const int compute_difference) {
+  const int size = tables->size;
+  const int nenrich = tables->nenrich;
+  memset(uref, 0,
+         vars_per_node * tables->num_refined_pts * sizeof(TacsScalar));
+
+  for (int p = 0; p < tables->num_refined_pts; p++) {
+    TacsScalar *u = &uref[vars_per_node * p];
+
+    // Add the portion from the shape functions
+    if (!compute_difference) {
+      const double *N = &tables->N_refined[size * p];
+      for (int k = 0; k < size; k++) {
+        for (int i = 0; i < vars_per_node; i++) {
+          u[i] += N[k] * uvals[vars_per_node * k + i];
+        }
       }
+    }
 
-      // Add up the total adjoint correction
-      for ( int i = 0; i < element->getNumNodes(); i++ ){
-        total_adjoint_corr += err[i];
+    // Add the portion from the enrichment functions
+    const double *Nr = &tables->Nr_refined[nenrich * p];
+    for (int k = 0; k < nenrich; k++) {
+      for (int i = 0; i < vars_per_node; i++) {
+        u[i] += Nr[k] * ubar[vars_per_node * k + i];
       }
+    }
+  }
+}
+
+/*
+  Compute the strain energy error estimate using a virtual refinement
+  of the forest.
+
+  This performs the same computation as the strain energy error
+  estimate above, but the higher-order elements are created directly
+  from the creator and the refined node locations are interpolated
+  from the original element. The refined TACSAssembler object and its
+  vectors are never created.
+
+  input:
+  forest:      the forest of octrees
+  tacs:        the TACSAssembler object
+  creator:     the creator used to make the higher-order elements
+
+  output:
+  error:       the element-wise error estimates
+
+  returns:     predicted strain energy error
+*/
+double TMR_StrainEnergyErrorEst(TMROctForest *forest, TACSAssembler *tacs,
+                                TMROctTACSCreator *creator, double *error) {
+  // Number of local elements
+  const int nelems = tacs->getNumElements();
+
+  // Create the higher-order elements
+  TACSElement **elements = NULL;
+  if (nelems > 0) {
+    elements = new TACSElement *[nelems];
+  }
+  TACSAuxElements *aux_elements = NULL;
+  TMROctForest *forest_refined = createVirtualRefinement(
+      forest, creator, nelems, elements, &aux_elements);
+
+  // Tabulate the shape and enrichment functions
+  TMRReconTables *tables = createReconTables3D(forest, forest_refined);
+  const int num_nodes = tables->size;
+  const int num_refined_nodes = tables->num_refined_pts;
+  const int nenrich = tables->nenrich;
+
+  // Get the number of variables per node
+  const int vars_per_node = tacs->getVarsPerNode();
+  const int deriv_per_node = 3 * vars_per_node;
+
+  // Allocate space for the element data for a batch of elements
+  TacsScalar *ubar = new TacsScalar[RECON_BATCH_SIZE * vars_per_node * nenrich];
+  TacsScalar *delem =
+      new TacsScalar[RECON_BATCH_SIZE * deriv_per_node * num_nodes];
+  TacsScalar *vars_elem =
+      new TacsScalar[RECON_BATCH_SIZE * vars_per_node * num_nodes];
+  TacsScalar *Xpts = new TacsScalar[RECON_BATCH_SIZE * 3 * num_refined_nodes];
+  TacsScalar *Xcoarse = new TacsScalar[3 * num_nodes];
+
+  // The interpolated variables on the refined mesh
+  TacsScalar *dvars = new TacsScalar[vars_per_node * num_refined_nodes];
+  TacsScalar *vars_interp = new TacsScalar[vars_per_node * num_refined_nodes];
+  memset(dvars, 0, vars_per_node * num_refined_nodes * sizeof(TacsScalar));
+
+  // Get the communicator
+  MPI_Comm comm = tacs->getMPIComm();
+
+  // Retrieve the variables from the TACSAssembler object
+  TACSBVec *uvec = tacs->createVec();
+  uvec->incref();
+  tacs->getVariables(uvec);
+  uvec->beginDistributeValues();
+  uvec->endDistributeValues();
+
+  // Compute the nodal weights and derivatives
+  TACSBVec *weights =
+      new TACSBVec(tacs->getNodeMap(), 1, tacs->getBVecDistribute(),
+                   tacs->getBVecDepNodes());
+  weights->incref();
+  computeLocalWeights(tacs, weights);
+
+  TACSBVec *uderiv =
+      new TACSBVec(tacs->getNodeMap(), 3 * vars_per_node,
+                   tacs->getBVecDistribute(), tacs->getBVecDepNodes());
+  uderiv->incref();
+  computeNodeDeriv3D(forest, tacs, uvec, weights, uderiv);
+  weights->decref();
+
+  // Keep track of the total error
+  double SE_total_error = 0.0;
 
-      // Add the contributions to the nodal error
-      nodal_error->setValues(refine_len, refine_nodes, err, TACS_ADD_VALUES);
+  for (int start = 0; start < nelems; start += RECON_BATCH_SIZE) {
+    int nbatch = nelems - start;
+    if (nbatch > RECON_BATCH_SIZE) {
+      nbatch = RECON_BATCH_SIZE;
     }
 
-    // Finish setting the values into the nodal error array
-    nodal_error->beginSetValues(TACS_ADD_VALUES);
-    nodal_error->endSetValues(TACS_ADD_VALUES);
+    // Gather the element data for the batch
+    for (int j = 0; j < nbatch; j++) {
+      int i = start + j;
 
-    // Distribute the values back to all nodes
-    nodal_error->beginDistributeValues();
-    nodal_error->endDistributeValues();
+      // Get the variables and node locations for this element
+      tacs->getElement(i, Xcoarse, &vars_elem[vars_per_node * num_nodes * j]);
+      computeVirtualRefinedXpts(tables, Xcoarse,
+                                &Xpts[3 * num_refined_nodes * j]);
 
-    // Finish setting the values into the array
-    for ( int elem = 0; elem < nelems; elem++ ){
-      // Get the node numbers for the refined mesh
-      int len = 0;
+      // Get the nodal derivatives for this element
+      int len;
       const int *nodes;
-      tacs_refined->getElement(elem, &len, &nodes);
-
-      // Get the adjoint variables for this element
-      nodal_error->getValues(len, nodes, err);
-
-      // Compute the element indicator error as a function of the nodal
-      // error estimate.
-      TacsScalar estimate = 0.0;
-      for ( int k = 0; k < 2; k++ ){
-        for ( int j = 0; j < 2; j++ ){
-          for ( int i = 0; i < 2; i++ ){
-            estimate +=
-              err[(refined_order-1)*i +
-                  (refined_order-1)*j*refined_order +
-                  (refined_order-1)*k*refined_order*refined_order];
-          }
+      tacs->getElement(i, &len, &nodes);
+      uderiv->getValues(len, nodes, &delem[deriv_per_node * num_nodes * j]);
+    }
+
+    // Compute the enrichment functions for each degree of freedom
+    computeElemReconBatch(vars_per_node, tables, nbatch, Xpts, vars_elem,
+                          delem, ubar, forest->getNumThreads());
+
+    for (int j = 0; j < nbatch; j++) {
+      // The simulation time -- we assume time-independent analysis
+      double time = 0.0;
+      int i = start + j;
+
+      // Evaluate the enrichment on the refined element
+      evalVirtualRefinedSolution(vars_per_node, tables,
+                                 &vars_elem[vars_per_node * num_nodes * j],
+                                 &ubar[vars_per_node * nenrich * j],
+                                 vars_interp, 1);
+
+      // Compute the strain/potential energy
+      TacsScalar Te, Pe;
+      elements[i]->computeEnergies(i, time, &Xpts[3 * num_refined_nodes * j],
+                                   vars_interp, dvars, &Te, &Pe);
+      error[i] = fabs(TacsRealPart(Pe));
+
+      // Add up the total error
+      SE_total_error += error[i];
+    }
+  }
+
+  // Count up the total strain energy
+  double SE_temp = 0.0;
+  MPI_Allreduce(&SE_total_error, &SE_temp, 1, MPI_DOUBLE, MPI_SUM, comm);
+  SE_total_error = SE_temp;
+
+  // Free the global vectors
+  uvec->decref();
+  uderiv->decref();
+
+  // Free the element-related data
+  delete tables;
+  delete[] ubar;
+  delete[] delem;
+  delete[] vars_elem;
+  delete[] Xpts;
+  delete[] Xcoarse;
+  delete[] dvars;
+  delete[] vars_interp;
+
+  // Free the refined elements and forest
+  for (int i = 0; i < nelems; i++) {
+    elements[i]->decref();
+  }
+  if (elements) {
+    delete[] elements;
+  }
+  if (aux_elements) {
+    aux_elements->decref();
+  }
+  forest_refined->decref();
+
+  return SE_total_error;
+}
+
+/*
+  Compute the adjoint-based error estimate using a virtual refinement
+  of the forest.
+
+  The solution and adjoint are reconstructed element-by-element on the
+  higher-order element. The adjoint-weighted residual is evaluated
+  directly from the reconstruction without assembling the refined
+  vectors, so the error is localized to the element that produces it.
+  Note that since the reconstruction is not averaged between adjacent
+  elements and dependent nodes are not constrained, the estimate is
+  close to, but not identical with, the estimate computed with a
+  refined TACSAssembler object.
+
+  input:
+  forest:      the forest of octrees
+  tacs:        the TACSAssembler object
+  creator:     the creator used to make the higher-order elements
+  solution:    the solution on the original mesh (NULL to use the
+               variables stored in tacs)
+  adjoint:     the adjoint solution on the original mesh
+
+  output:
+  error:       the element-wise error estimates
+  adj_corr:    adjoint-based functional correction
+
+  returns:
+  absolute functional error estimate
+*/
+double TMR_AdjointErrorEst(TMROctForest *forest, TACSAssembler *tacs,
+                           TMROctTACSCreator *creator, TACSBVec *solution,
+                           TACSBVec *adjoint, double *error,
+                           double *adj_corr) {
+  // Number of local elements
+  const int nelems = tacs->getNumElements();
+
+  // Create the higher-order elements
+  TACSElement **elements = NULL;
+  if (nelems > 0) {
+    elements = new TACSElement *[nelems];
+  }
+  TACSAuxElements *aux_elements = NULL;
+  TMROctForest *forest_refined = createVirtualRefinement(
+      forest, creator, nelems, elements, &aux_elements);
+
+  // Get the auxiliary elements defined in the problem
+  int num_aux_elems = 0;
+  TACSAuxElem *aux = NULL;
+  if (aux_elements) {
+    num_aux_elems = aux_elements->getAuxElements(&aux);
+  }
+
+  // Tabulate the shape and enrichment functions
+  TMRReconTables *tables = createReconTables3D(forest, forest_refined);
+  const int num_nodes = tables->size;
+  const int num_refined_nodes = tables->num_refined_pts;
+  const int nenrich = tables->nenrich;
+
+  // Get the number of variables per node
+  const int vars_per_node = tacs->getVarsPerNode();
+  const int deriv_per_node = 3 * vars_per_node;
+
+  // Get the communicator
+  MPI_Comm comm = tacs->getMPIComm();
+
+  // Retrieve the solution and distribute the values
+  TACSBVec *uvec = solution;
+  if (!uvec) {
+    uvec = tacs->createVec();
+    uvec->incref();
+    tacs->getVariables(uvec);
+  }
+  uvec->beginDistributeValues();
+  adjoint->beginDistributeValues();
+  uvec->endDistributeValues();
+  adjoint->endDistributeValues();
+
+  // Compute the nodal weights and the nodal derivatives of the
+  // solution and adjoint
+  TACSBVec *weights =
+      new TACSBVec(tacs->getNodeMap(), 1, tacs->getBVecDistribute(),
+                   tacs->getBVecDepNodes());
+  weights->incref();
+  computeLocalWeights(tacs, weights);
+
+  TACSBVec *uderiv =
+      new TACSBVec(tacs->getNodeMap(), 3 * vars_per_node,
+                   tacs->getBVecDistribute(), tacs->getBVecDepNodes());
+  uderiv->incref();
+  computeNodeDeriv3D(forest, tacs, uvec, weights, uderiv);
+
+  TACSBVec *aderiv =
+      new TACSBVec(tacs->getNodeMap(), 3 * vars_per_node,
+                   tacs->getBVecDistribute(), tacs->getBVecDepNodes());
+  aderiv->incref();
+  computeNodeDeriv3D(forest, tacs, adjoint, weights, aderiv);
+  weights->decref();
+
+  // Allocate space for the element data for a batch of elements
+  TacsScalar *uelem =
+      new TacsScalar[RECON_BATCH_SIZE * vars_per_node * num_nodes];
+  TacsScalar *udelem =
+      new TacsScalar[RECON_BATCH_SIZE * deriv_per_node * num_nodes];
+  TacsScalar *aelem =
+      new TacsScalar[RECON_BATCH_SIZE * vars_per_node * num_nodes];
+  TacsScalar *adelem =
+      new TacsScalar[RECON_BATCH_SIZE * deriv_per_node * num_nodes];
+  TacsScalar *ubar = new TacsScalar[RECON_BATCH_SIZE * vars_per_node * nenrich];
+  TacsScalar *abar = new TacsScalar[RECON_BATCH_SIZE * vars_per_node * nenrich];
+  TacsScalar *Xpts = new TacsScalar[RECON_BATCH_SIZE * 3 * num_refined_nodes];
+  TacsScalar *Xcoarse = new TacsScalar[3 * num_nodes];
+
+  // Allocate the element arrays on the refined element
+  TacsScalar *vars_refined = new TacsScalar[vars_per_node * num_refined_nodes];
+  TacsScalar *dvars_refined = new TacsScalar[vars_per_node * num_refined_nodes];
+  TacsScalar *ddvars_refined =
+      new TacsScalar[vars_per_node * num_refined_nodes];
+  TacsScalar *adj_refined = new TacsScalar[vars_per_node * num_refined_nodes];
+  TacsScalar *res_refined = new TacsScalar[vars_per_node * num_refined_nodes];
+  memset(dvars_refined, 0,
+         vars_per_node * num_refined_nodes * sizeof(TacsScalar));
+  memset(ddvars_refined, 0,
+         vars_per_node * num_refined_nodes * sizeof(TacsScalar));
+
+  // Keep track of the total output functional error estimate and the total
+  // output functional correction terms
+  double total_error_est = 0.0;
+  double total_output_corr = 0.0;
+
+  int aux_count = 0;
+  for (int start = 0; start < nelems; start += RECON_BATCH_SIZE) {
+    int nbatch = nelems - start;
+    if (nbatch > RECON_BATCH_SIZE) {
+      nbatch = RECON_BATCH_SIZE;
+    }
+
+    // Gather the element data for the batch
+    for (int j = 0; j < nbatch; j++) {
+      int elem = start + j;
+
+      // Get the node numbers for this element
+      int len;
+      const int *nodes;
+      tacs->getElement(elem, &len, &nodes);
+
+      // Get the solution, adjoint and their derivatives
+      uvec->getValues(len, nodes, &uelem[vars_per_node * num_nodes * j]);
+      uderiv->getValues(len, nodes, &udelem[deriv_per_node * num_nodes * j]);
+      adjoint->getValues(len, nodes, &aelem[vars_per_node * num_nodes * j]);
+      aderiv->getValues(len, nodes, &adelem[deriv_per_node * num_nodes * j]);
+
+      // Interpolate the refined node locations
+      tacs->getElement(elem, Xcoarse);
+      computeVirtualRefinedXpts(tables, Xcoarse,
+                                &Xpts[3 * num_refined_nodes * j]);
+    }
+
+    // Compute the reconstruction of the solution and the adjoint
+    // together so that each element matrix is factored only once
+    computeElemReconBatch(vars_per_node, tables, nbatch, Xpts, uelem, udelem,
+                          ubar, forest->getNumThreads(), aelem, adelem, abar);
+
+    for (int j = 0; j < nbatch; j++) {
+      // Set the simulation time
+      double time = 0.0;
+      int elem = start + j;
+      TacsScalar *X = &Xpts[3 * num_refined_nodes * j];
+
+      // Evaluate the reconstructed solution and the adjoint
+      // difference at the refined nodes
+      evalVirtualRefinedSolution(vars_per_node, tables,
+                                 &uelem[vars_per_node * num_nodes * j],
+                                 &ubar[vars_per_node * nenrich * j],
+                                 vars_refined, 0);
+      evalVirtualRefinedSolution(vars_per_node, tables,
+                                 &aelem[vars_per_node * num_nodes * j],
+                                 &abar[vars_per_node * nenrich * j],
+                                 adj_refined, 1);
+
+      // Compute the adjoint-weighted residual on the refined element
+      memset(res_refined, 0,
+             vars_per_node * num_refined_nodes * sizeof(TacsScalar));
+      elements[elem]->addResidual(elem, time, X, vars_refined, dvars_refined,
+                                  ddvars_refined, res_refined);
+
+      TacsScalar err = 0.0;
+      for (int k = 0; k < vars_per_node * num_refined_nodes; k++) {
+        err -= res_refined[k] * adj_refined[k];
+      }
+
+      // Add the contribution from any loads - opposite sign for error
+      // contribution
+      while (aux_count < num_aux_elems && aux[aux_count].num == elem) {
+        memset(res_refined, 0,
+               vars_per_node * num_refined_nodes * sizeof(TacsScalar));
+        aux[aux_count].elem->addResidual(elem, time, X, vars_refined,
+                                         dvars_refined, ddvars_refined,
+                                         res_refined);
+        for (int k = 0; k < vars_per_node * num_refined_nodes; k++) {
+          err += res_refined[k] * adj_refined[k];
         }
+        aux_count++;
       }
 
-      error[elem] = 0.125*fabs(TacsRealPart(estimate));
-      total_error_remain += error[elem];
+      error[elem] = fabs(TacsRealPart(err));
+      total_error_est += error[elem];
+      total_output_corr += TacsRealPart(err);
     }
+  }
 
-    // Sum up the contributions across all processors
-    double temp[2];
-    temp[0] = total_error_remain;
-    temp[1] = total_adjoint_corr;
-    MPI_Allreduce(MPI_IN_PLACE, temp, 2, MPI_DOUBLE, MPI_SUM, comm);
-    total_error_remain = temp[0];
-    total_adjoint_corr = temp[1];
-
-    // Free the data that is no longer required
-    delete [] vars_interp;
-    delete [] adj_interp;
-    delete [] err;
-    nodal_error->decref();
-
-    // Set the adjoint residual correction
-    if (adj_corr){
-      *adj_corr = total_adjoint_corr;
-    }
+  // Sum up the contributions across all processors
+  double temp[2];
+  temp[0] = total_error_est;
+  temp[1] = total_output_corr;
+  MPI_Allreduce(MPI_IN_PLACE, temp, 2, MPI_DOUBLE, MPI_SUM, comm);
+  total_error_est = temp[0];
+  total_output_corr = temp[1];
 
-    // Return the error
-    return total_error_remain;
-  */
-  return 0.0;
+  // Free the global vectors
+  if (!solution) {
+    uvec->decref();
+  }
+  uderiv->decref();
+  aderiv->decref();
+
+  // Free the element-related data
+  delete tables;
+  delete[] uelem;
+  delete[] udelem;
+  delete[] aelem;
+  delete[] adelem;
+  delete[] ubar;
+  delete[] abar;
+  delete[] Xpts;
+  delete[] Xcoarse;
+  delete[] vars_refined;
+  delete[] dvars_refined;
+  delete[] ddvars_refined;
+  delete[] adj_refined;
+  delete[] res_refined;
+
+  // Free the refined elements and forest
+  for (int i = 0; i < nelems; i++) {
+    elements[i]->decref();
+  }
+  if (elements) {
+    delete[] elements;
+  }
+  if (aux_elements) {
+    aux_elements->decref();
+  }
+  forest_refined->decref();
+
+  // Set the adjoint residual correction
+  if (adj_corr) {
+    *adj_corr = total_output_corr;
+  }
+
+  return total_error_est;
 }
 
 /*
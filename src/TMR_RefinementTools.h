@@ -25,6 +25,7 @@
 #include "TACSMg.h"
 #include "TMROctForest.h"
 #include "TMRQuadForest.h"
+#include "TMR_TACSCreator.h"
 
 /*
   Create a TACS multigrid object
@@ -73,6 +74,20 @@ void TMR_ComputeReconSolution(TMROctForest *forest, TACSAssembler *tacs,
 void TMR_PrintErrorBins(MPI_Comm comm, const double *error, const int nelems,
                         double *mean = NULL, double *stddev = NULL);
 
+/*
+  Select the error thresholds and compute the refinement array in
+  parallel without gathering the element errors
+*/
+double TMR_ComputeErrorThreshold(MPI_Comm comm, const double *error,
+                                 const int nelems, const int ntarget,
+                                 int largest = 1);
+int TMR_ComputeRefinementArray(MPI_Comm comm, const double *error,
+                               const int nelems, const int nrefine,
+                               const int ncoarsen, double refine_cutoff,
+                               double coarsen_cutoff, int *refine,
+                               double *refine_threshold = NULL,
+                               double *coarsen_threshold = NULL);
+
 /*
   Perform a mesh refinement based on the strain engery refinement
   criteria.
@@ -100,6 +115,19 @@ double TMR_AdjointErrorEst(TMROctForest *forest, TACSAssembler *tacs,
                            TACSBVec *adjoint_refined, double *error,
                            double *adj_corr);
 
+/*
+  Perform the error estimates using a virtual refinement of the forest
+  of octrees. The higher-order elements are created from the creator
+  object and the refined residual is evaluated element-by-element
+  without creating a refined TACSAssembler object.
+*/
+double TMR_StrainEnergyErrorEst(TMROctForest *forest, TACSAssembler *tacs,
+                                TMROctTACSCreator *creator, double *error);
+double TMR_AdjointErrorEst(TMROctForest *forest, TACSAssembler *tacs,
+                           TMROctTACSCreator *creator, TACSBVec *solution,
+                           TACSBVec *adjoint, double *error,
+                           double *adj_corr);
+
 /*
   Evaluate a stress constraint based on a higher-order interpolation
   of the stresses in the problem.
@@ -13,9 +13,15 @@
 
 #include "TMR_STLTools.h"
 
+#include <fcntl.h>
 #include <math.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 const int edgeTable[256] = {
     0x0,   0x109, 0x203, 0x30a, 0x406, 0x50f, 0x605, 0x70c, 0x80c, 0x905, 0xa0f,
@@ -330,8 +336,43 @@ class Cell {
  public:
   TMRPoint p[8];
   double val[8];
+  int node[8];
 };
 
+/*
+  The local cell edges in the order used by the marching cubes
+  tables, given as the pair of cell vertices for each edge
+*/
+const int cell_edge_vertex[12][2] = {{0, 1}, {1, 2}, {2, 3}, {3, 0},
+                                     {4, 5}, {5, 6}, {6, 7}, {7, 4},
+                                     {0, 4}, {1, 5}, {2, 6}, {3, 7}};
+
+/*
+  The key that identifies a vertex of the isosurface by the pair of
+  nodes that define the edge on which it lies. Vertices that lie on a
+  node have n1 == n2.
+
+  Independent nodes have a global number, so the key is the same on
+  all processors. Dependent nodes are stored as negative numbers that
+  are local to each processor, so keys that contain a dependent node
+  also store the processor rank.
+*/
+class TMRSTLVertexKey {
+ public:
+  int n1, n2, rank;
+};
+
+static TMRSTLVertexKey make_vertex_key(int a, int b, int mpi_rank) {
+  TMRSTLVertexKey key;
+  key.n1 = (a < b ? a : b);
+  key.n2 = (a < b ? b : a);
+  key.rank = -1;
+  if (key.n1 < 0) {
+    key.rank = mpi_rank;
+  }
+  return key;
+}
+
 /*
   Linearly interpolate the position where an isosurface cuts an edge
   between two vertices, each with their own scalar value
@@ -362,7 +403,8 @@ TMRPoint vertex_interp(double isolevel, TMRPoint p1, TMRPoint p2, double valp1,
   0 will be returned if the grid cell is either totally above of
   totally below the isolevel.
 */
-int polygonise(Cell grid, double isolevel, TMR_STLTriangle *triangles) {
+int polygonise(Cell grid, double isolevel, TMR_STLTriangle *triangles,
+               int (*edges)[3] = NULL) {
   int ntriang;
   int cubeindex;
   TMRPoint vertlist[12];
@@ -428,6 +470,11 @@ int polygonise(Cell grid, double isolevel, TMR_STLTriangle *triangles) {
     triangles[ntriang].p[0] = vertlist[triTable[cubeindex][i]];
     triangles[ntriang].p[1] = vertlist[triTable[cubeindex][i + 1]];
     triangles[ntriang].p[2] = vertlist[triTable[cubeindex][i + 2]];
+    if (edges) {
+      edges[ntriang][0] = triTable[cubeindex][i];
+      edges[ntriang][1] = triTable[cubeindex][i + 1];
+      edges[ntriang][2] = triTable[cubeindex][i + 2];
+    }
     ntriang++;
   }
 
@@ -468,7 +515,7 @@ const int face_vertex[6][4] = {{0, 4, 7, 3}, {1, 2, 6, 5}, {0, 1, 5, 4},
   Write out the face
 */
 int face_polygonize(TMRPoint *p, double vals[], double cutoff,
-                    TMR_STLTriangle *triangles) {
+                    TMR_STLTriangle *triangles, int (*verts)[3] = NULL) {
   TMRPoint vertlist[8];
 
   // Determine the nodes that are below the cutoff
@@ -500,6 +547,11 @@ int face_polygonize(TMRPoint *p, double vals[], double cutoff,
     triangles[ntri].p[0] = vertlist[faceTriTable[faceindex][i]];
     triangles[ntri].p[1] = vertlist[faceTriTable[faceindex][i + 1]];
     triangles[ntri].p[2] = vertlist[faceTriTable[faceindex][i + 2]];
+    if (verts) {
+      verts[ntri][0] = faceTriTable[faceindex][i];
+      verts[ntri][1] = faceTriTable[faceindex][i + 1];
+      verts[ntri][2] = faceTriTable[faceindex][i + 2];
+    }
     ntri++;
   }
 
@@ -516,8 +568,10 @@ class TriangleList {
     len = ntris;
     max_len = ntris;
     len_incr = ntris;
+    keys = NULL;
+    mpi_rank = 0;
   }
-  TriangleList(int _max_len) {
+  TriangleList(int _max_len, int use_keys = 0, int _mpi_rank = 0) {
     len = 0;
     max_len = _max_len;
     if (max_len < 100) {
@@ -525,28 +579,58 @@ class TriangleList {
     }
     len_incr = max_len;
     triangles = new TMR_STLTriangle[max_len];
+    keys = NULL;
+    if (use_keys) {
+      keys = new TMRSTLVertexKey[3 * max_len];
+    }
+    mpi_rank = _mpi_rank;
+  }
+  ~TriangleList() {
+    delete[] triangles;
+    if (keys) {
+      delete[] keys;
+    }
   }
-  ~TriangleList() { delete[] triangles; }
 
   // Add a triangle to the list
-  void addTriangle(TMR_STLTriangle *tri) {
+  void addTriangle(TMR_STLTriangle *tri,
+                   const TMRSTLVertexKey *tri_keys = NULL) {
     if (len >= max_len) {
-      max_len += len_incr;
-      TMR_STLTriangle *temp = new TMR_STLTriangle[max_len];
-      memcpy(temp, triangles, len * sizeof(TMR_STLTriangle));
-      delete[] triangles;
-      triangles = temp;
+      extend(len + 1);
     }
     triangles[len] = *tri;
+    if (keys && tri_keys) {
+      for (int k = 0; k < 3; k++) {
+        keys[3 * len + k] = tri_keys[k];
+      }
+    }
     len++;
   }
 
+  // Add an array of triangles to the list
+  void addTriangles(int ntris, const TMR_STLTriangle *tris,
+                    const TMRSTLVertexKey *tri_keys = NULL) {
+    if (len + ntris > max_len) {
+      extend(len + ntris);
+    }
+    memcpy(&triangles[len], tris, ntris * sizeof(TMR_STLTriangle));
+    if (keys && tri_keys) {
+      memcpy(&keys[3 * len], tri_keys, 3 * ntris * sizeof(TMRSTLVertexKey));
+    }
+    len += ntris;
+  }
+
   // Get the list of triangles
   void getTriangles(int *ntris, TMR_STLTriangle **tris) {
     *tris = triangles;
     *ntris = len;
   }
 
+  // Get the vertex keys (if they are stored) and the processor rank
+  // used for keys with dependent nodes
+  TMRSTLVertexKey *getKeys() { return keys; }
+  int getRank() { return mpi_rank; }
+
   // Write all the triangles to a list
   int writeSTLFile(const char *filename) {
     // Open the file and see if we were successful
@@ -579,8 +663,34 @@ class TriangleList {
   }
 
  private:
+  // Extend the array so that it holds at least size triangles. The
+  // size is at least doubled so that the cost of adding n triangles
+  // is O(n).
+  void extend(int size) {
+    int new_len = max_len + len_incr;
+    if (new_len < 2 * max_len) {
+      new_len = 2 * max_len;
+    }
+    if (new_len < size) {
+      new_len = size;
+    }
+    TMR_STLTriangle *temp = new TMR_STLTriangle[new_len];
+    memcpy(temp, triangles, len * sizeof(TMR_STLTriangle));
+    delete[] triangles;
+    triangles = temp;
+    if (keys) {
+      TMRSTLVertexKey *temp_keys = new TMRSTLVertexKey[3 * new_len];
+      memcpy(temp_keys, keys, 3 * len * sizeof(TMRSTLVertexKey));
+      delete[] keys;
+      keys = temp_keys;
+    }
+    max_len = new_len;
+  }
+
   int len, max_len, len_incr;
   TMR_STLTriangle *triangles;
+  TMRSTLVertexKey *keys;
+  int mpi_rank;
 };
 
 /*
@@ -588,11 +698,22 @@ class TriangleList {
 */
 void add_volume(TriangleList *list, Cell *grid, double cutoff) {
   TMR_STLTriangle triangles[5];
-  int ntri = polygonise(*grid, cutoff, triangles);
+  int edges[5][3];
+  int ntri = polygonise(*grid, cutoff, triangles, edges);
 
   // Add the triangles to the list
   for (int k = 0; k < ntri; k++) {
-    list->addTriangle(&triangles[k]);
+    if (list->getKeys()) {
+      TMRSTLVertexKey keys[3];
+      for (int j = 0; j < 3; j++) {
+        const int *v = cell_edge_vertex[edges[k][j]];
+        keys[j] = make_vertex_key(grid->node[v[0]], grid->node[v[1]],
+                                  list->getRank());
+      }
+      list->addTriangle(&triangles[k], keys);
+    } else {
+      list->addTriangle(&triangles[k]);
+    }
   }
 }
 
@@ -616,11 +737,29 @@ void add_faces(TriangleList *list, Cell *grid, double cutoff, int bound[]) {
     // Check whether this face is actually on a boundary
     if (b[0] && b[1] && b[2] && b[3]) {
       TMR_STLTriangle triangles[4];
-      int ntri = face_polygonize(p, vals, cutoff, triangles);
+      int verts[4][3];
+      int ntri = face_polygonize(p, vals, cutoff, triangles, verts);
 
       // Add the triangles to the list
       for (int k = 0; k < ntri; k++) {
-        list->addTriangle(&triangles[k]);
+        if (list->getKeys()) {
+          // The first four vertices are the face nodes, the remaining
+          // vertices lie on the face edges
+          TMRSTLVertexKey keys[3];
+          for (int j = 0; j < 3; j++) {
+            int v1 = verts[k][j], v2 = verts[k][j];
+            if (v1 >= 4) {
+              v1 = v1 - 4;
+              v2 = (v1 + 1) % 4;
+            }
+            keys[j] = make_vertex_key(grid->node[face_vertex[face][v1]],
+                                      grid->node[face_vertex[face][v2]],
+                                      list->getRank());
+          }
+          list->addTriangle(&triangles[k], keys);
+        } else {
+          list->addTriangle(&triangles[k]);
+        }
       }
     }
   }
@@ -633,64 +772,51 @@ void add_faces(TriangleList *list, Cell *grid, double cutoff, int bound[]) {
 
 const int ordering_transform[] = {0, 1, 3, 2, 4, 5, 7, 6};
 
-/**
-  Create a list of STL triangles
+/*
+  The data shared by the threads that generate the triangles. Each
+  thread processes a contiguous range of octants and adds the
+  triangles to its own list.
 */
-int TMR_GenerateSTLTriangles(TMROctForest *filter, TACSBVec *x, int x_offset,
-                             double cutoff, TriangleList **_list) {
-  // Set the return flag
-  int fail = 0;
-
-  // Get the MPI communicator
-  int mpi_size, mpi_rank;
-  MPI_Comm comm = filter->getMPIComm();
-  MPI_Comm_size(comm, &mpi_size);
-  MPI_Comm_rank(comm, &mpi_rank);
-
-  // Retrieve the mesh order
-  const int mesh_order = filter->getMeshOrder();
-
-  // Ensure that the values are distributed so that we can access them
-  // directly
-  x->beginDistributeValues();
-  x->endDistributeValues();
-
-  // Get the dependent nodes and weight values
+class TMRSTLThreadData {
+ public:
+  TMROctForest *filter;
+  TACSBVec *x;
+  int x_offset;
+  double cutoff;
+  int mesh_order;
   const int *dep_ptr, *dep_conn;
   const double *dep_weights;
-  filter->getDepNodeConn(&dep_ptr, &dep_conn, &dep_weights);
+  const int *block_face_conn, *face_block_ptr;
+  const TMROctant *octs;
+  const int *conn;
+  const TMRPoint *X;
+  int start, end;
+  TriangleList *list;
+};
+
+/*
+  Generate the triangles for the octants in the range [start, end)
+*/
+static void *generateSTLTrianglesThread(void *arg) {
+  TMRSTLThreadData *data = static_cast<TMRSTLThreadData *>(arg);
+  TMROctForest *filter = data->filter;
+  TACSBVec *x = data->x;
+  const int x_offset = data->x_offset;
+  const double cutoff = data->cutoff;
+  const int mesh_order = data->mesh_order;
+  const int *dep_ptr = data->dep_ptr;
+  const int *dep_conn = data->dep_conn;
+  const double *dep_weights = data->dep_weights;
+  const int *block_face_conn = data->block_face_conn;
+  const int *face_block_ptr = data->face_block_ptr;
+  const TMROctant *octs = data->octs;
+  const int *conn = data->conn;
+  const TMRPoint *X = data->X;
+  TriangleList *list = data->list;
 
   // Set the maximum length of any of the block sides
   const int32_t hmax = 1 << TMR_MAX_LEVEL;
 
-  // Create the list of Triangles
-  TriangleList *list = new TriangleList(4096);
-
-  // Get the block -> face information and the face -> block info.
-  // This will be used to determine which faces lie on the boundaries
-  // of the domain
-  const int *block_face_conn;
-  filter->getConnectivity(NULL, NULL, NULL, NULL, NULL, &block_face_conn, NULL,
-                          NULL);
-
-  const int *face_block_ptr;
-  filter->getInverseConnectivity(NULL, NULL, NULL, NULL, NULL, &face_block_ptr);
-
-  // Get the array of octants
-  TMROctantArray *octants;
-  int nelems;
-  TMROctant *octs;
-  filter->getOctants(&octants);
-  octants->getArray(&octs, &nelems);
-
-  // Get the connectivity
-  const int *conn;
-  filter->getNodeConn(&conn);
-
-  // Get the nodal locations from the TMROctree object
-  TMRPoint *X;
-  filter->getPoints(&X);
-
   // Allocate space to store the node locations and levelset values
   const int bsize = x->getBlockSize();
   TacsScalar *xvars = new TacsScalar[bsize];
@@ -698,7 +824,7 @@ int TMR_GenerateSTLTriangles(TMROctForest *filter, TACSBVec *x, int x_offset,
   TMRPoint *Xe = new TMRPoint[mesh_order * mesh_order * mesh_order];
 
   // Get the mesh coordinates from the filter
-  for (int i = 0; i < nelems; i++) {
+  for (int i = data->start; i < data->end; i++) {
     // Compute the side-length of this element
     const int32_t h = 1 << (TMR_MAX_LEVEL - octs[i].level);
 
@@ -803,7 +929,8 @@ int TMR_GenerateSTLTriangles(TMROctForest *filter, TACSBVec *x, int x_offset,
                   cell.val[index] = levelvals[offset];
                 }
 
-                // Set the node location
+                // Set the node location and number
+                cell.node[index] = c[offset];
                 cell.p[index].x = Xe[offset].x;
                 cell.p[index].y = Xe[offset].y;
                 cell.p[index].z = Xe[offset].z;
@@ -846,6 +973,116 @@ int TMR_GenerateSTLTriangles(TMROctForest *filter, TACSBVec *x, int x_offset,
   delete[] levelvals;
   delete[] Xe;
 
+  return NULL;
+}
+
+/**
+  Create a list of STL triangles
+
+  The octants are split into contiguous chunks that are polygonized
+  concurrently using the number of threads set on the filter. The
+  triangles from each chunk are appended in order, so the output is
+  the same regardless of the number of threads.
+
+  If use_keys is set, the list also stores the key for each triangle
+  vertex that identifies the edge of the mesh on which it lies.
+*/
+int TMR_GenerateSTLTriangles(TMROctForest *filter, TACSBVec *x, int x_offset,
+                             double cutoff, TriangleList **_list,
+                             int use_keys = 0) {
+  // Set the return flag
+  int fail = 0;
+
+  int mpi_rank;
+  MPI_Comm_rank(filter->getMPIComm(), &mpi_rank);
+
+  // Ensure that the values are distributed so that we can access them
+  // directly
+  x->beginDistributeValues();
+  x->endDistributeValues();
+
+  // Set the data shared by all of the threads
+  TMRSTLThreadData shared;
+  shared.filter = filter;
+  shared.x = x;
+  shared.x_offset = x_offset;
+  shared.cutoff = cutoff;
+  shared.mesh_order = filter->getMeshOrder();
+
+  // Get the dependent nodes and weight values
+  filter->getDepNodeConn(&shared.dep_ptr, &shared.dep_conn,
+                         &shared.dep_weights);
+
+  // Get the block -> face information and the face -> block info.
+  // This will be used to determine which faces lie on the boundaries
+  // of the domain
+  filter->getConnectivity(NULL, NULL, NULL, NULL, NULL,
+                          &shared.block_face_conn, NULL, NULL);
+  filter->getInverseConnectivity(NULL, NULL, NULL, NULL, NULL,
+                                 &shared.face_block_ptr);
+
+  // Get the array of octants
+  TMROctantArray *octants;
+  int nelems;
+  TMROctant *octs;
+  filter->getOctants(&octants);
+  octants->getArray(&octs, &nelems);
+  shared.octs = octs;
+
+  // Get the connectivity
+  filter->getNodeConn(&shared.conn);
+
+  // Get the nodal locations from the TMROctree object
+  TMRPoint *X;
+  filter->getPoints(&X);
+  shared.X = X;
+
+  // Limit the number of threads so that each has a reasonable
+  // amount of work
+  const int min_octs_per_thread = 256;
+  int num_threads = filter->getNumThreads();
+  if (num_threads > nelems / min_octs_per_thread) {
+    num_threads = nelems / min_octs_per_thread;
+  }
+  if (num_threads < 1) {
+    num_threads = 1;
+  }
+
+  // Create the list of Triangles
+  TriangleList *list = new TriangleList(4096, use_keys, mpi_rank);
+
+  if (num_threads > 1) {
+    TMRSTLThreadData *data = new TMRSTLThreadData[num_threads];
+    pthread_t *threads = new pthread_t[num_threads];
+    for (int k = 0; k < num_threads; k++) {
+      data[k] = shared;
+      data[k].start = (k * nelems) / num_threads;
+      data[k].end = ((k + 1) * nelems) / num_threads;
+      data[k].list = new TriangleList(4096, use_keys, mpi_rank);
+      pthread_create(&threads[k], NULL, generateSTLTrianglesThread,
+                     (void *)&data[k]);
+    }
+    for (int k = 0; k < num_threads; k++) {
+      pthread_join(threads[k], NULL);
+    }
+
+    // Append the triangles from each thread in order
+    for (int k = 0; k < num_threads; k++) {
+      int ntris;
+      TMR_STLTriangle *tris;
+      data[k].list->getTriangles(&ntris, &tris);
+      list->addTriangles(ntris, tris, data[k].list->getKeys());
+      delete data[k].list;
+    }
+    delete[] threads;
+    delete[] data;
+  } else {
+    shared.start = 0;
+    shared.end = nelems;
+    shared.list = list;
+    generateSTLTrianglesThread((void *)&shared);
+  }
+
   *_list = list;
 
   return fail;
@@ -962,32 +1199,889 @@ int TMR_GenerateBinFile(const char *filename, TMROctForest *filter, TACSBVec *x,
 }
 
 /*
-  Take the binary file generated from above and convert to the .STL
-  data format (in ASCII).
+  Pack a triangle into the 50-byte binary STL facet format
 */
-int TMR_ConvertBinToSTL(const char *binfile, const char *stlfile) {
-  FILE *fp = fopen(binfile, "rb");
+static void pack_stl_facet(const TMR_STLTriangle *tri, char *ptr) {
+  double n[3];
+  compute_normal(*tri, n);
+
+  float values[12];
+  for (int k = 0; k < 3; k++) {
+    values[k] = n[k];
+    values[3 * (k + 1)] = tri->p[k].x;
+    values[3 * (k + 1) + 1] = tri->p[k].y;
+    values[3 * (k + 1) + 2] = tri->p[k].z;
+  }
+  uint16_t attribute = 0;
+
+  memcpy(ptr, values, 12 * sizeof(float));
+  memcpy(&ptr[12 * sizeof(float)], &attribute, sizeof(uint16_t));
+}
+
+/*
+  Write the triangles directly to a binary STL file
+
+  The file consists of an 80 byte header, the number of triangles as
+  a 32-bit unsigned integer, and then 50 bytes for each triangle: the
+  facet normal and the three vertices as 32-bit floats followed by a
+  16-bit attribute count. The values are written in the native byte
+  order, which is little-endian on all supported platforms.
+*/
+int TMR_WriteSTLFile(const char *filename, TMROctForest *filter, TACSBVec *x,
+                     int x_offset, double cutoff) {
+  // Generate the triangle
+  TriangleList *list;
+  int fail = TMR_GenerateSTLTriangles(filter, x, x_offset, cutoff, &list);
+  if (fail) {
+    return fail;
+  }
+
+  // Get the MPI communicator
+  int mpi_size, mpi_rank;
+  MPI_Comm comm = filter->getMPIComm();
+  MPI_Comm_size(comm, &mpi_size);
+  MPI_Comm_rank(comm, &mpi_rank);
+
+  // Get the local triangles
+  int ntris;
+  TMR_STLTriangle *tris;
+  list->getTriangles(&ntris, &tris);
+
+  int *range = new int[mpi_size + 1];
+  range[0] = 0;
+  MPI_Allgather(&ntris, 1, MPI_INT, &range[1], 1, MPI_INT, comm);
+  for (int i = 0; i < mpi_size; i++) {
+    range[i + 1] += range[i];
+  }
+
+  // Pack the local facets into the binary STL format
+  const int header_size = 80 + sizeof(uint32_t);
+  const int facet_size = 12 * sizeof(float) + sizeof(uint16_t);
+  char *buffer = new char[facet_size * ntris];
+  for (int i = 0; i < ntris; i++) {
+    pack_stl_facet(&tris[i], &buffer[facet_size * i]);
+  }
+
+  // Copy the filename to a non-const array
+  char *fname = new char[strlen(filename) + 1];
+  strcpy(fname, filename);
+
+  // Create the file and write out the information
+  MPI_File fp = NULL;
+  MPI_File_open(comm, fname, MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL,
+                &fp);
+
+  if (fp) {
+    // Truncate any existing file to the final size
+    MPI_Offset file_size =
+        header_size + (MPI_Offset)facet_size * range[mpi_size];
+    MPI_File_set_size(fp, file_size);
+
+    // Write out the header and the number of triangles
+    if (mpi_rank == 0) {
+      char header[80];
+      memset(header, 0, sizeof(header));
+      snprintf(header, sizeof(header), "TMR topology");
+      uint32_t num_facets = range[mpi_size];
+      MPI_File_write_at(fp, 0, header, sizeof(header), MPI_BYTE,
+                        MPI_STATUS_IGNORE);
+      MPI_File_write_at(fp, sizeof(header), &num_facets, sizeof(uint32_t),
+                        MPI_BYTE, MPI_STATUS_IGNORE);
+    }
+
+    // Write out all the facets to the file
+    MPI_Offset offset = header_size + (MPI_Offset)facet_size * range[mpi_rank];
+    MPI_File_write_at_all(fp, offset, buffer, facet_size * ntris, MPI_BYTE,
+                          MPI_STATUS_IGNORE);
+    MPI_File_close(&fp);
+  } else {
+    fail = 1;
+  }
+
+  delete[] buffer;
+  delete[] range;
+  delete[] fname;
+  delete list;
+
+  return fail;
+}
+
+/*
+  A vertex and its original index, sorted by coordinate to find
+  duplicate vertices
+*/
+class TMRSTLVertex {
+ public:
+  TMRPoint p;
+  int index;
+};
+
+static int compare_stl_vertex(const void *a, const void *b) {
+  const TMRSTLVertex *va = static_cast<const TMRSTLVertex *>(a);
+  const TMRSTLVertex *vb = static_cast<const TMRSTLVertex *>(b);
+  if (va->p.x != vb->p.x) {
+    return (va->p.x < vb->p.x ? -1 : 1);
+  }
+  if (va->p.y != vb->p.y) {
+    return (va->p.y < vb->p.y ? -1 : 1);
+  }
+  if (va->p.z != vb->p.z) {
+    return (va->p.z < vb->p.z ? -1 : 1);
+  }
+  return va->index - vb->index;
+}
+
+/*
+  Write the triangles to a binary file with a shared vertex list
+
+  Vertices that are bitwise identical on the same processor are
+  merged. Vertices on the interface between processors are duplicated.
+*/
+int TMR_WriteIndexedBinFile(const char *filename, TMROctForest *filter,
+                            TACSBVec *x, int x_offset, double cutoff) {
+  // Generate the triangle
+  TriangleList *list;
+  int fail = TMR_GenerateSTLTriangles(filter, x, x_offset, cutoff, &list);
+  if (fail) {
+    return fail;
+  }
+
+  // Get the MPI communicator
+  int mpi_size, mpi_rank;
+  MPI_Comm comm = filter->getMPIComm();
+  MPI_Comm_size(comm, &mpi_size);
+  MPI_Comm_rank(comm, &mpi_rank);
+
+  // Get the local triangles
+  int ntris;
+  TMR_STLTriangle *tris;
+  list->getTriangles(&ntris, &tris);
+
+  // Sort the vertices to find the duplicates
+  TMRSTLVertex *verts = new TMRSTLVertex[3 * ntris];
+  for (int i = 0; i < 3 * ntris; i++) {
+    verts[i].p = tris[i / 3].p[i % 3];
+    verts[i].index = i;
+  }
+  qsort(verts, 3 * ntris, sizeof(TMRSTLVertex), compare_stl_vertex);
+
+  // Number the unique vertices and set the triangle connectivity
+  int nverts = 0;
+  double *Xpts = new double[9 * ntris];
+  int *tri_conn = new int[3 * ntris];
+  for (int i = 0; i < 3 * ntris; i++) {
+    if (i == 0 || verts[i].p.x != verts[i - 1].p.x ||
+        verts[i].p.y != verts[i - 1].p.y || verts[i].p.z != verts[i - 1].p.z) {
+      Xpts[3 * nverts] = verts[i].p.x;
+      Xpts[3 * nverts + 1] = verts[i].p.y;
+      Xpts[3 * nverts + 2] = verts[i].p.z;
+      nverts++;
+    }
+    tri_conn[verts[i].index] = nverts - 1;
+  }
+  delete[] verts;
+
+  // Compute the offsets for the vertices and triangles
+  int counts[2] = {nverts, ntris};
+  int *range = new int[2 * (mpi_size + 1)];
+  range[0] = range[1] = 0;
+  MPI_Allgather(counts, 2, MPI_INT, &range[2], 2, MPI_INT, comm);
+  for (int i = 0; i < mpi_size; i++) {
+    range[2 * (i + 1)] += range[2 * i];
+    range[2 * (i + 1) + 1] += range[2 * i + 1];
+  }
+  const int num_verts = range[2 * mpi_size];
+  const int num_tris = range[2 * mpi_size + 1];
+
+  // Offset the connectivity by the vertex offset on this processor
+  for (int i = 0; i < 3 * ntris; i++) {
+    tri_conn[i] += range[2 * mpi_rank];
+  }
+
+  // Copy the filename to a non-const array
+  char *fname = new char[strlen(filename) + 1];
+  strcpy(fname, filename);
+
+  // Create the file and write out the information
+  MPI_File fp = NULL;
+  MPI_File_open(comm, fname, MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL,
+                &fp);
+
+  if (fp) {
+    const MPI_Offset header_size = 2 * sizeof(int);
+    const MPI_Offset vert_size = 3 * sizeof(double);
+    const MPI_Offset tri_size = 3 * sizeof(int);
+    MPI_File_set_size(fp, header_size + vert_size * num_verts +
+                              tri_size * num_tris);
+
+    // Write out the number of vertices and triangles
+    if (mpi_rank == 0) {
+      int header[2] = {num_verts, num_tris};
+      MPI_File_write_at(fp, 0, header, 2, MPI_INT, MPI_STATUS_IGNORE);
+    }
+
+    // Write out the vertices and then the connectivity
+    MPI_Offset offset = header_size + vert_size * range[2 * mpi_rank];
+    MPI_File_write_at_all(fp, offset, Xpts, 3 * nverts, MPI_DOUBLE,
+                          MPI_STATUS_IGNORE);
+    offset = header_size + vert_size * num_verts +
+             tri_size * range[2 * mpi_rank + 1];
+    MPI_File_write_at_all(fp, offset, tri_conn, 3 * ntris, MPI_INT,
+                          MPI_STATUS_IGNORE);
+    MPI_File_close(&fp);
+  } else {
+    fail = 1;
+  }
+
+  delete[] Xpts;
+  delete[] tri_conn;
+  delete[] range;
+  delete[] fname;
+  delete list;
+
+  return fail;
+}
+
+/*
+  A vertex key and the index of the vertex in the triangle list (or
+  in the array of keys received from other processors)
+*/
+class TMRSTLKeyIndex {
+ public:
+  TMRSTLVertexKey key;
+  int index;
+};
+
+static int compare_vertex_keys(const TMRSTLVertexKey *a,
+                               const TMRSTLVertexKey *b) {
+  if (a->n1 != b->n1) {
+    return a->n1 - b->n1;
+  }
+  if (a->n2 != b->n2) {
+    return a->n2 - b->n2;
+  }
+  return a->rank - b->rank;
+}
+
+static int compare_key_index(const void *a, const void *b) {
+  const TMRSTLKeyIndex *ka = static_cast<const TMRSTLKeyIndex *>(a);
+  const TMRSTLKeyIndex *kb = static_cast<const TMRSTLKeyIndex *>(b);
+  int cmp = compare_vertex_keys(&ka->key, &kb->key);
+  if (cmp != 0) {
+    return cmp;
+  }
+  return ka->index - kb->index;
+}
+
+/*
+  Write the level set to a binary PLY file with shared vertices
+
+  Each vertex of the isosurface is identified by the pair of nodes
+  that define the mesh edge on which it lies. Vertices with the same
+  key are merged across octants and processors. The key is sent to
+  the processor that owns the first node of the edge, which assigns
+  the global vertex number and writes the vertex to the file. Keys
+  that contain a dependent node are local to each processor.
+
+  The vertices are written as 32-bit floats and the faces as lists of
+  32-bit integer vertex indices.
+*/
+int TMR_WritePLYFile(const char *filename, TMROctForest *filter, TACSBVec *x,
+                     int x_offset, double cutoff) {
+  // Generate the triangles and the vertex keys
+  TriangleList *list;
+  int use_keys = 1;
+  int fail =
+      TMR_GenerateSTLTriangles(filter, x, x_offset, cutoff, &list, use_keys);
+  if (fail) {
+    return fail;
+  }
+
+  // Get the MPI communicator
+  int mpi_size, mpi_rank;
+  MPI_Comm comm = filter->getMPIComm();
+  MPI_Comm_size(comm, &mpi_size);
+  MPI_Comm_rank(comm, &mpi_rank);
+
+  // Get the local triangles and their keys
+  int ntris;
+  TMR_STLTriangle *tris;
+  list->getTriangles(&ntris, &tris);
+  const TMRSTLVertexKey *keys = list->getKeys();
+
+  // Sort the keys to find the unique vertices on this processor
+  TMRSTLKeyIndex *sorted = new TMRSTLKeyIndex[3 * ntris];
+  for (int i = 0; i < 3 * ntris; i++) {
+    sorted[i].key = keys[i];
+    sorted[i].index = i;
+  }
+  qsort(sorted, 3 * ntris, sizeof(TMRSTLKeyIndex), compare_key_index);
+
+  int nunique = 0;
+  int *local_ids = new int[3 * ntris];
+  TMRSTLKeyIndex *unique = new TMRSTLKeyIndex[3 * ntris];
+  for (int i = 0; i < 3 * ntris; i++) {
+    if (i == 0 || compare_vertex_keys(&sorted[i].key, &sorted[i - 1].key)) {
+      unique[nunique] = sorted[i];
+      nunique++;
+    }
+    local_ids[sorted[i].index] = nunique - 1;
+  }
+  delete[] sorted;
+
+  // Find the owner of each unique vertex
+  const int *node_range;
+  filter->getOwnedNodeRange(&node_range);
+
+  int *owner = new int[nunique];
+  int *send_counts = new int[mpi_size];
+  memset(send_counts, 0, mpi_size * sizeof(int));
+  for (int i = 0; i < nunique; i++) {
+    if (unique[i].key.rank >= 0) {
+      owner[i] = unique[i].key.rank;
+    } else {
+      int n = unique[i].key.n1;
+      int low = 0, high = mpi_size - 1;
+      while (low < high) {
+        int mid = low + (high - low + 1) / 2;
+        if (node_range[mid] <= n) {
+          low = mid;
+        } else {
+          high = mid - 1;
+        }
+      }
+      owner[i] = low;
+    }
+    send_counts[owner[i]]++;
+  }
+
+  // Order the unique vertices by owner
+  int *send_ptr = new int[mpi_size + 1];
+  send_ptr[0] = 0;
+  for (int k = 0; k < mpi_size; k++) {
+    send_ptr[k + 1] = send_ptr[k] + send_counts[k];
+  }
+
+  int *send_pos = new int[nunique];
+  int *send_keys = new int[3 * nunique];
+  double *send_pts = new double[3 * nunique];
+  memset(send_counts, 0, mpi_size * sizeof(int));
+  for (int i = 0; i < nunique; i++) {
+    int pos = send_ptr[owner[i]] + send_counts[owner[i]];
+    send_counts[owner[i]]++;
+    send_pos[i] = pos;
+
+    const TMRPoint *pt = &tris[unique[i].index / 3].p[unique[i].index % 3];
+    send_keys[3 * pos] = unique[i].key.n1;
+    send_keys[3 * pos + 1] = unique[i].key.n2;
+    send_keys[3 * pos + 2] = unique[i].key.rank;
+    send_pts[3 * pos] = pt->x;
+    send_pts[3 * pos + 1] = pt->y;
+    send_pts[3 * pos + 2] = pt->z;
+  }
+  delete[] owner;
+  delete[] unique;
+
+  // Send the keys and points to their owners
+  int *recv_counts = new int[mpi_size];
+  MPI_Alltoall(send_counts, 1, MPI_INT, recv_counts, 1, MPI_INT, comm);
+
+  int *recv_ptr = new int[mpi_size + 1];
+  recv_ptr[0] = 0;
+  for (int k = 0; k < mpi_size; k++) {
+    recv_ptr[k + 1] = recv_ptr[k] + recv_counts[k];
+  }
+  int nrecv = recv_ptr[mpi_size];
+
+  // Scale the counts and offsets by the number of components
+  int *send_counts3 = new int[mpi_size];
+  int *send_ptr3 = new int[mpi_size];
+  int *recv_counts3 = new int[mpi_size];
+  int *recv_ptr3 = new int[mpi_size];
+  for (int k = 0; k < mpi_size; k++) {
+    send_counts3[k] = 3 * send_counts[k];
+    send_ptr3[k] = 3 * send_ptr[k];
+    recv_counts3[k] = 3 * recv_counts[k];
+    recv_ptr3[k] = 3 * recv_ptr[k];
+  }
+
+  int *recv_keys = new int[3 * nrecv];
+  double *recv_pts = new double[3 * nrecv];
+  MPI_Alltoallv(send_keys, send_counts3, send_ptr3, MPI_INT, recv_keys,
+                recv_counts3, recv_ptr3, MPI_INT, comm);
+  MPI_Alltoallv(send_pts, send_counts3, send_ptr3, MPI_DOUBLE, recv_pts,
+                recv_counts3, recv_ptr3, MPI_DOUBLE, comm);
+  delete[] send_keys;
+  delete[] send_pts;
+  delete[] send_counts3;
+  delete[] send_ptr3;
+  delete[] recv_counts3;
+  delete[] recv_ptr3;
+
+  // Number the vertices owned by this processor
+  sorted = new TMRSTLKeyIndex[nrecv];
+  for (int i = 0; i < nrecv; i++) {
+    sorted[i].key.n1 = recv_keys[3 * i];
+    sorted[i].key.n2 = recv_keys[3 * i + 1];
+    sorted[i].key.rank = recv_keys[3 * i + 2];
+    sorted[i].index = i;
+  }
+  qsort(sorted, nrecv, sizeof(TMRSTLKeyIndex), compare_key_index);
+  delete[] recv_keys;
+
+  int nowned = 0;
+  int *recv_ids = new int[nrecv];
+  float *Xowned = new float[3 * nrecv];
+  for (int i = 0; i < nrecv; i++) {
+    if (i == 0 || compare_vertex_keys(&sorted[i].key, &sorted[i - 1].key)) {
+      const double *pt = &recv_pts[3 * sorted[i].index];
+      Xowned[3 * nowned] = pt[0];
+      Xowned[3 * nowned + 1] = pt[1];
+      Xowned[3 * nowned + 2] = pt[2];
+      nowned++;
+    }
+    recv_ids[sorted[i].index] = nowned - 1;
+  }
+  delete[] sorted;
+  delete[] recv_pts;
+
+  // Compute the global vertex and face offsets
+  int counts[2] = {nowned, ntris};
+  int *range = new int[2 * (mpi_size + 1)];
+  range[0] = range[1] = 0;
+  MPI_Allgather(counts, 2, MPI_INT, &range[2], 2, MPI_INT, comm);
+  for (int k = 0; k < mpi_size; k++) {
+    range[2 * (k + 1)] += range[2 * k];
+    range[2 * (k + 1) + 1] += range[2 * k + 1];
+  }
+  const int num_verts = range[2 * mpi_size];
+  const int num_tris = range[2 * mpi_size + 1];
+
+  // Send the global vertex numbers back to the processors that
+  // requested them
+  for (int i = 0; i < nrecv; i++) {
+    recv_ids[i] += range[2 * mpi_rank];
+  }
+  int *send_ids = new int[nunique];
+  MPI_Alltoallv(recv_ids, recv_counts, recv_ptr, MPI_INT, send_ids,
+                send_counts, send_ptr, MPI_INT, comm);
+  delete[] recv_ids;
+  delete[] recv_counts;
+  delete[] recv_ptr;
+  delete[] send_counts;
+  delete[] send_ptr;
+
+  // Pack the faces into the PLY format
+  const int face_size = sizeof(unsigned char) + 3 * sizeof(int);
+  char *faces = new char[face_size * ntris];
+  for (int i = 0; i < ntris; i++) {
+    unsigned char nv = 3;
+    int ids[3];
+    for (int k = 0; k < 3; k++) {
+      ids[k] = send_ids[send_pos[local_ids[3 * i + k]]];
+    }
+    char *ptr = &faces[face_size * i];
+    memcpy(ptr, &nv, sizeof(unsigned char));
+    memcpy(&ptr[sizeof(unsigned char)], ids, 3 * sizeof(int));
+  }
+  delete[] send_ids;
+  delete[] send_pos;
+  delete[] local_ids;
+
+  // Create the header. This is identical on all processors.
+  char header[512];
+  snprintf(header, sizeof(header),
+           "ply\n"
+           "format binary_little_endian 1.0\n"
+           "comment TMR topology\n"
+           "element vertex %d\n"
+           "property float x\n"
+           "property float y\n"
+           "property float z\n"
+           "element face %d\n"
+           "property list uchar int vertex_indices\n"
+           "end_header\n",
+           num_verts, num_tris);
+  const MPI_Offset header_size = strlen(header);
+  const MPI_Offset vert_size = 3 * sizeof(float);
+
+  // Copy the filename to a non-const array
+  char *fname = new char[strlen(filename) + 1];
+  strcpy(fname, filename);
+
+  // Create the file and write out the information
+  MPI_File fp = NULL;
+  MPI_File_open(comm, fname, MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL,
+                &fp);
+
+  if (fp) {
+    MPI_File_set_size(fp, header_size + vert_size * num_verts +
+                              (MPI_Offset)face_size * num_tris);
+
+    if (mpi_rank == 0) {
+      MPI_File_write_at(fp, 0, header, header_size, MPI_CHAR,
+                        MPI_STATUS_IGNORE);
+    }
+
+    // Write out the owned vertices and then the local faces
+    MPI_Offset offset = header_size + vert_size * range[2 * mpi_rank];
+    MPI_File_write_at_all(fp, offset, Xowned, 3 * nowned, MPI_FLOAT,
+                          MPI_STATUS_IGNORE);
+    offset = header_size + vert_size * num_verts +
+             (MPI_Offset)face_size * range[2 * mpi_rank + 1];
+    MPI_File_write_at_all(fp, offset, faces, face_size * ntris, MPI_BYTE,
+                          MPI_STATUS_IGNORE);
+    MPI_File_close(&fp);
+  } else {
+    fail = 1;
+  }
+
+  delete[] Xowned;
+  delete[] faces;
+  delete[] range;
+  delete[] fname;
+  delete list;
+
+  return fail;
+}
+
+/*
+  Write the binary file from the triangles on a single processor
+*/
+int TMR_WriteBinFile(const char *filename, int ntris,
+                     const TMR_STLTriangle *tris) {
+  FILE *fp = fopen(filename, "wb");
   if (!fp) {
     return 1;
   }
 
-  // Try to read in the number of triangles
+  int fail = 0;
+  if (fwrite(&ntris, sizeof(int), 1, fp) != 1) {
+    fail = 1;
+  } else if (ntris > 0) {
+    unsigned int unsigned_ntris = ntris;
+    if (fwrite(tris, sizeof(TMR_STLTriangle), ntris, fp) != unsigned_ntris) {
+      fail = 1;
+    }
+  }
+  fclose(fp);
+
+  return fail;
+}
+
+/*
+  The number of triangles converted by a thread at a time. The size of
+  the buffers used in the conversion is proportional to this number
+  times the number of threads, independent of the size of the file.
+*/
+static const int BIN_CONVERT_CHUNK_SIZE = 16384;
+
+/*
+  The maximum length of an ASCII STL facet
+*/
+static const int MAX_ASCII_FACET_SIZE = 512;
+
+/*
+  The data for a thread that converts a chunk of the triangles
+*/
+class TMRBinConvertData {
+ public:
+  const char *data;
+  int ntris;
+  TMRBinConvertType type;
+  int chunk;
+
+  // The formatted output for the ASCII and binary STL formats
+  char *buffer;
+  size_t size;
+
+  // The merged vertices and connectivity for the indexed format
+  TMRSTLVertex *verts;
+  double *Xpts;
+  int *tri_conn;
+  int nverts;
+};
+
+/*
+  Convert a chunk of the triangles from the memory-mapped file. The
+  triangles are copied since they are not aligned within the file.
+*/
+static void *convertBinChunkThread(void *arg) {
+  TMRBinConvertData *data = static_cast<TMRBinConvertData *>(arg);
+  int start = data->chunk * BIN_CONVERT_CHUNK_SIZE;
+  int end = start + BIN_CONVERT_CHUNK_SIZE;
+  if (end > data->ntris) {
+    end = data->ntris;
+  }
+
+  if (data->type == TMR_INDEXED_BIN) {
+    // Merge the duplicate vertices within the chunk
+    int n = 3 * (end - start);
+    for (int i = 0; i < n; i++) {
+      TMR_STLTriangle tri;
+      memcpy(&tri, &data->data[sizeof(TMR_STLTriangle) * (start + i / 3)],
+             sizeof(TMR_STLTriangle));
+      data->verts[i].p = tri.p[i % 3];
+      data->verts[i].index = i;
+    }
+    qsort(data->verts, n, sizeof(TMRSTLVertex), compare_stl_vertex);
+
+    int nverts = 0;
+    for (int i = 0; i < n; i++) {
+      const TMRSTLVertex *v = data->verts;
+      if (i == 0 || v[i].p.x != v[i - 1].p.x || v[i].p.y != v[i - 1].p.y ||
+          v[i].p.z != v[i - 1].p.z) {
+        data->Xpts[3 * nverts] = v[i].p.x;
+        data->Xpts[3 * nverts + 1] = v[i].p.y;
+        data->Xpts[3 * nverts + 2] = v[i].p.z;
+        nverts++;
+      }
+      data->tri_conn[v[i].index] = nverts - 1;
+    }
+    data->nverts = nverts;
+  } else {
+    char *ptr = data->buffer;
+    for (int i = start; i < end; i++) {
+      TMR_STLTriangle tri;
+      memcpy(&tri, &data->data[sizeof(TMR_STLTriangle) * i],
+             sizeof(TMR_STLTriangle));
+      if (data->type == TMR_BINARY_STL) {
+        pack_stl_facet(&tri, ptr);
+        ptr += 12 * sizeof(float) + sizeof(uint16_t);
+      } else {
+        double n[3];
+        compute_normal(tri, n);
+        ptr += snprintf(ptr, MAX_ASCII_FACET_SIZE,
+                        "facet normal %e %e %e\n"
+                        "outer loop\n"
+                        "vertex %e %e %e\n"
+                        "vertex %e %e %e\n"
+                        "vertex %e %e %e\n"
+                        "endloop\nendfacet\n",
+                        n[0], n[1], n[2], tri.p[0].x, tri.p[0].y, tri.p[0].z,
+                        tri.p[1].x, tri.p[1].y, tri.p[1].z, tri.p[2].x,
+                        tri.p[2].y, tri.p[2].z);
+      }
+    }
+    data->size = ptr - data->buffer;
+  }
+
+  return NULL;
+}
+
+/*
+  Convert the chunks [first, first + num_threads) in separate threads
+*/
+static void convertBinChunks(int first, int nchunks, int num_threads,
+                             TMRBinConvertData *data) {
+  int nrun = nchunks - first;
+  if (nrun > num_threads) {
+    nrun = num_threads;
+  }
+  for (int k = 0; k < nrun; k++) {
+    data[k].chunk = first + k;
+  }
+
+  if (nrun > 1) {
+    pthread_t *threads = new pthread_t[nrun];
+    for (int k = 0; k < nrun; k++) {
+      pthread_create(&threads[k], NULL, convertBinChunkThread,
+                     (void *)&data[k]);
+    }
+    for (int k = 0; k < nrun; k++) {
+      pthread_join(threads[k], NULL);
+    }
+    delete[] threads;
+  } else if (nrun == 1) {
+    convertBinChunkThread((void *)&data[0]);
+  }
+}
+
+/*
+  Convert the binary file generated by TMR_GenerateBinFile to an STL
+  file or to the indexed format of TMR_WriteIndexedBinFile.
+
+  The input file is memory-mapped and the triangles are converted in
+  chunks, with each of the threads formatting one chunk at a time. The
+  chunks are written in order, so the whole file is never held in
+  memory. For the indexed format, the duplicate vertices are merged
+  within each chunk, but not across chunks. This requires two passes:
+  the first counts the vertices in each chunk so that the vertices and
+  connectivity can then be written at their offsets.
+
+  Note that this is a serial code and should only be called by a
+  single processor.
+*/
+int TMR_ConvertBinFile(const char *binfile, const char *outfile,
+                       TMRBinConvertType type, int num_threads) {
+  int fd = open(binfile, O_RDONLY);
+  if (fd < 0) {
+    return 1;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(int)) {
+    close(fd);
+    return 1;
+  }
+
+  size_t file_size = st.st_size;
+  char *map = (char *)mmap(NULL, file_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return 1;
+  }
+  madvise(map, file_size, MADV_SEQUENTIAL);
+
+  // Check that the file contains all of the triangles
   int ntris;
-  if (fread(&ntris, sizeof(int), 1, fp) != 1) {
+  memcpy(&ntris, map, sizeof(int));
+  if (ntris < 0 || file_size < sizeof(int) + (size_t)ntris *
+                                                sizeof(TMR_STLTriangle)) {
+    munmap(map, file_size);
     return 1;
   }
 
-  // Read in the triangles themselves
-  TMR_STLTriangle *tris = new TMR_STLTriangle[ntris];
-  unsigned int unsigned_ntris = ntris;
-  if (fread(tris, sizeof(TMR_STLTriangle), ntris, fp) != unsigned_ntris) {
-    delete[] tris;
+  FILE *fp = fopen(outfile, "wb");
+  if (!fp) {
+    munmap(map, file_size);
     return 1;
   }
 
-  TriangleList *list = new TriangleList(tris, ntris);
-  list->writeSTLFile(stlfile);
-  delete list;
+  if (num_threads < 1) {
+    num_threads = 1;
+  }
+  int nchunks = (ntris + BIN_CONVERT_CHUNK_SIZE - 1) / BIN_CONVERT_CHUNK_SIZE;
+
+  // Allocate the buffers for each thread
+  TMRBinConvertData *data = new TMRBinConvertData[num_threads];
+  for (int k = 0; k < num_threads; k++) {
+    data[k].data = &map[sizeof(int)];
+    data[k].ntris = ntris;
+    data[k].type = type;
+    data[k].chunk = 0;
+    data[k].buffer = NULL;
+    data[k].size = 0;
+    data[k].verts = NULL;
+    data[k].Xpts = NULL;
+    data[k].tri_conn = NULL;
+    data[k].nverts = 0;
+    if (type == TMR_INDEXED_BIN) {
+      data[k].verts = new TMRSTLVertex[3 * BIN_CONVERT_CHUNK_SIZE];
+      data[k].Xpts = new double[9 * BIN_CONVERT_CHUNK_SIZE];
+      data[k].tri_conn = new int[3 * BIN_CONVERT_CHUNK_SIZE];
+    } else if (type == TMR_BINARY_STL) {
+      data[k].buffer = new char[50 * BIN_CONVERT_CHUNK_SIZE];
+    } else {
+      data[k].buffer = new char[MAX_ASCII_FACET_SIZE * BIN_CONVERT_CHUNK_SIZE];
+    }
+  }
+
+  int fail = 0;
+  if (type == TMR_INDEXED_BIN) {
+    // Count the vertices in each chunk to find the vertex offsets
+    int64_t *vert_offset = new int64_t[nchunks + 1];
+    vert_offset[0] = 0;
+    for (int first = 0; first < nchunks; first += num_threads) {
+      convertBinChunks(first, nchunks, num_threads, data);
+      for (int k = 0; k < num_threads && first + k < nchunks; k++) {
+        vert_offset[first + k + 1] = vert_offset[first + k] + data[k].nverts;
+      }
+    }
 
-  return 0;
+    const int64_t num_verts = vert_offset[nchunks];
+    if (num_verts > INT32_MAX) {
+      fail = 1;
+    } else {
+      int header[2] = {(int)num_verts, ntris};
+      if (fwrite(header, sizeof(int), 2, fp) != 2) {
+        fail = 1;
+      }
+    }
+
+    // Write the vertices and the connectivity of each chunk at their
+    // offsets within the file
+    const off_t header_size = 2 * sizeof(int);
+    const off_t conn_start = header_size + 3 * sizeof(double) * num_verts;
+    for (int first = 0; first < nchunks && !fail; first += num_threads) {
+      convertBinChunks(first, nchunks, num_threads, data);
+      for (int k = 0; k < num_threads && first + k < nchunks; k++) {
+        int chunk = first + k;
+        int start = chunk * BIN_CONVERT_CHUNK_SIZE;
+        int n = ntris - start;
+        if (n > BIN_CONVERT_CHUNK_SIZE) {
+          n = BIN_CONVERT_CHUNK_SIZE;
+        }
+        for (int i = 0; i < 3 * n; i++) {
+          data[k].tri_conn[i] += (int)vert_offset[chunk];
+        }
+
+        size_t nv = 3 * data[k].nverts;
+        if (fseeko(fp, header_size + 3 * sizeof(double) * vert_offset[chunk],
+                   SEEK_SET) != 0 ||
+            fwrite(data[k].Xpts, sizeof(double), nv, fp) != nv ||
+            fseeko(fp, conn_start + 3 * sizeof(int) * (off_t)start,
+                   SEEK_SET) != 0 ||
+            fwrite(data[k].tri_conn, sizeof(int), 3 * n, fp) !=
+                (size_t)(3 * n)) {
+          fail = 1;
+          break;
+        }
+      }
+    }
+
+    delete[] vert_offset;
+  } else {
+    // Write the header
+    if (type == TMR_BINARY_STL) {
+      char header[80];
+      memset(header, 0, sizeof(header));
+      snprintf(header, sizeof(header), "TMR topology");
+      uint32_t num_facets = ntris;
+      if (fwrite(header, 1, sizeof(header), fp) != sizeof(header) ||
+          fwrite(&num_facets, sizeof(uint32_t), 1, fp) != 1) {
+        fail = 1;
+      }
+    } else {
+      fprintf(fp, "solid topology\n");
+    }
+
+    // Format the chunks in parallel and write them out in order
+    for (int first = 0; first < nchunks && !fail; first += num_threads) {
+      convertBinChunks(first, nchunks, num_threads, data);
+      for (int k = 0; k < num_threads && first + k < nchunks; k++) {
+        if (fwrite(data[k].buffer, 1, data[k].size, fp) != data[k].size) {
+          fail = 1;
+          break;
+        }
+      }
+    }
+
+    if (type == TMR_ASCII_STL) {
+      fprintf(fp, "endsolid topology\n");
+    }
+  }
+
+  if (fclose(fp) != 0) {
+    fail = 1;
+  }
+  munmap(map, file_size);
+
+  for (int k = 0; k < num_threads; k++) {
+    delete[] data[k].buffer;
+    delete[] data[k].verts;
+    delete[] data[k].Xpts;
+    delete[] data[k].tri_conn;
+  }
+  delete[] data;
+
+  return fail;
+}
+
+/*
+  Take the binary file generated from above and convert to the .STL
+  data format (in ASCII).
+*/
+int TMR_ConvertBinToSTL(const char *binfile, const char *stlfile) {
+  return TMR_ConvertBinFile(binfile, stlfile, TMR_ASCII_STL);
 }
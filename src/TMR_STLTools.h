@@ -68,6 +68,53 @@ int TMR_GenerateSTLTriangles(int root, TMROctForest *filter, TACSBVec *x,
 extern int TMR_GenerateBinFile(const char *filename, TMROctForest *filter,
                                TACSBVec *x, int x_offset, double cutoff);
 
+/*
+  Write the level set directly to a binary STL file. This is a
+  collective call that skips the intermediate file and the serial
+  conversion step. The header is 80 bytes, followed by the number of
+  triangles and 50 bytes per triangle in the binary STL format.
+*/
+extern int TMR_WriteSTLFile(const char *filename, TMROctForest *filter,
+                            TACSBVec *x, int x_offset, double cutoff);
+
+/*
+  Write the level set to a binary file with a shared vertex list.
+  Vertices are merged within each processor, but not across
+  processors.
+
+  binary output data format:
+  2 integers representing the number of vertices and triangles
+  3*nverts doubles representing the vertex locations
+  3*ntri integers representing the vertex indices in CCW ordering
+*/
+extern int TMR_WriteIndexedBinFile(const char *filename, TMROctForest *filter,
+                                   TACSBVec *x, int x_offset, double cutoff);
+
+/*
+  Write the level set to a binary PLY file with 32-bit float vertices
+  and 32-bit integer face indices. Vertices are identified by the pair
+  of mesh nodes that define the edge on which they lie, so vertices
+  are shared between octants and processors. This is a collective
+  call.
+*/
+extern int TMR_WritePLYFile(const char *filename, TMROctForest *filter,
+                            TACSBVec *x, int x_offset, double cutoff);
+
+/*
+  Write the binary file from the triangles gathered on a single
+  processor. The output format is the same as TMR_GenerateBinFile.
+
+  Note that this is a serial code that does not call MPI, so it can be
+  called from a thread on the root processor.
+*/
+extern int TMR_WriteBinFile(const char *filename, int ntris,
+                            const TMR_STLTriangle *tris);
+
+/*
+  The output formats for the conversion of the binary file
+*/
+enum TMRBinConvertType { TMR_ASCII_STL, TMR_BINARY_STL, TMR_INDEXED_BIN };
+
 /*
   Take the binary file generated from above and convert to the .STL
   data format (in ASCII).
@@ -77,4 +124,18 @@ extern int TMR_GenerateBinFile(const char *filename, TMROctForest *filter,
 */
 extern int TMR_ConvertBinToSTL(const char *binfile, const char *stlfile);
 
+/*
+  Convert the binary file generated from above to an ASCII or binary
+  STL file, or to the format written by TMR_WriteIndexedBinFile with
+  the vertices merged within chunks of the file.
+
+  The input file is memory-mapped and converted in chunks using the
+  given number of threads, so the memory use does not depend on the
+  size of the file. This is a serial code that should only be called
+  by a single processor.
+*/
+extern int TMR_ConvertBinFile(const char *binfile, const char *outfile,
+                              TMRBinConvertType type = TMR_ASCII_STL,
+                              int num_threads = 1);
+
 #endif  // TMR_STL_TOOLS_H
@@ -20,6 +20,8 @@
 
 #include "TMR_TACSCreator.h"
 
+#include "TMRHashFunction.h"
+
 /*
   Initialize the TMRQuadTACSCreator data in the abstract base class
 */
@@ -279,6 +281,128 @@ void TMRQuadTACSCreator::setNodeLocations(TMRQuadForest *forest,
   X->decref();
 }
 
+/*
+  The data cached by the octant creator for a single mesh order
+
+  The entry stores a copy of the local octants so that a match can be
+  verified exactly. The hash key is only used to quickly reject forests
+  that differ.
+*/
+class TMROctTACSCacheEntry {
+ public:
+  TMROctTACSCacheEntry() {
+    key = 0;
+    topo = NULL;
+    interp_type = TMR_UNIFORM_POINTS;
+    num_bcs = 0;
+    filter_key = 0;
+    num_filter_octs = 0;
+    num_elements = 0;
+    octs = NULL;
+    elements = NULL;
+    assembler = NULL;
+    ordering = TACSAssembler::NATURAL_ORDER;
+  }
+  ~TMROctTACSCacheEntry() { clear(); }
+
+  // Free the cached data
+  void clear() {
+    if (octs) {
+      delete[] octs;
+    }
+    if (elements) {
+      for (int i = 0; i < num_elements; i++) {
+        elements[i]->decref();
+      }
+      delete[] elements;
+    }
+    if (assembler) {
+      assembler->decref();
+    }
+    key = 0;
+    topo = NULL;
+    num_elements = 0;
+    octs = NULL;
+    elements = NULL;
+    assembler = NULL;
+  }
+
+  // The data used to identify the forest
+  uint32_t key;
+  TMRTopology *topo;
+  TMRInterpolationType interp_type;
+  int num_bcs;
+  uint32_t filter_key;
+  int num_filter_octs;
+  int num_elements;
+  TMROctant *octs;
+
+  // The cached elements and assembler
+  TACSElement **elements;
+  TACSAssembler *assembler;
+  TACSAssembler::OrderingType ordering;
+};
+
+/*
+  The cached data for each mesh order
+*/
+class TMROctTACSCache {
+ public:
+  TMROctTACSCacheEntry entries[TMROctForest::MAX_ORDER + 1];
+};
+
+/*
+  Compute a hash key for the local octants of a forest
+*/
+static uint32_t computeOctantKey(TMROctForest *forest, int *num_octs) {
+  TMROctantArray *octants;
+  forest->getOctants(&octants);
+
+  int size = 0;
+  TMROctant *array = NULL;
+  if (octants) {
+    octants->getArray(&array, &size);
+  }
+
+  uint32_t key = TMRIntegerPairHash(size, forest->getMeshOrder());
+  for (int i = 0; i < size; i++) {
+    uint32_t h = TMRIntegerFiveTupleHash(array[i].block, array[i].x,
+                                         array[i].y, array[i].z,
+                                         array[i].level);
+    key = TMRIntegerPairHash(key, h);
+  }
+  if (num_octs) {
+    *num_octs = size;
+  }
+  return key;
+}
+
+/*
+  Check whether the local octants match the cached copy
+*/
+static int isSameOctants(TMROctForest *forest, const TMROctant *octs,
+                         int num_octs) {
+  TMROctantArray *octants;
+  forest->getOctants(&octants);
+
+  int size = 0;
+  TMROctant *array = NULL;
+  if (octants) {
+    octants->getArray(&array, &size);
+  }
+  if (size != num_octs) {
+    return 0;
+  }
+  for (int i = 0; i < size; i++) {
+    if (array[i].block != octs[i].block || array[i].x != octs[i].x ||
+        array[i].y != octs[i].y || array[i].z != octs[i].z ||
+        array[i].level != octs[i].level) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
 /*
   Initialize the TMRQuadTACSCreator data in the abstract base class
 */
@@ -292,6 +416,8 @@ TMROctTACSCreator::TMROctTACSCreator() {
   bcs = NULL;
   filter = NULL;
   design_vars_per_node = 1;
+  use_cache = 0;
+  cache = NULL;
 }
 
 /*
@@ -304,6 +430,9 @@ TMROctTACSCreator::~TMROctTACSCreator() {
   if (filter) {
     filter->decref();
   }
+  if (cache) {
+    delete cache;
+  }
 }
 
 /*
@@ -324,6 +453,34 @@ void TMROctTACSCreator::initialize(TMRBoundaryConditions *_bcs,
   if (filter) {
     filter->incref();
   }
+  use_cache = 0;
+  cache = NULL;
+}
+
+/*
+  Set whether to reuse the data from previous calls to createTACS
+
+  When the cache is used, the elements created for each mesh order are
+  kept and reused when createTACS is called again with a forest that
+  has the same local octants, interpolation and topology. When the
+  ordering is also unchanged and no component names are given, the
+  same TACSAssembler object is returned.
+*/
+void TMROctTACSCreator::setUseCache(int _use_cache) {
+  use_cache = _use_cache;
+  if (!use_cache) {
+    clearCache();
+  }
+}
+
+/*
+  Free all of the cached elements and TACSAssembler objects
+*/
+void TMROctTACSCreator::clearCache() {
+  if (cache) {
+    delete cache;
+    cache = NULL;
+  }
 }
 
 /*
@@ -349,6 +506,65 @@ TACSAssembler *TMROctTACSCreator::createTACS(
   int num_elements = 0, num_owned_nodes = 0;
   forest->getNodeConn(&conn, &num_elements, &num_owned_nodes);
 
+  // Check whether the cached data for this mesh order matches the
+  // forest. The result must agree on all processors since creating
+  // the TACSAssembler object is collective.
+  TMROctTACSCacheEntry *entry = NULL;
+  int reuse_elements = 0, reuse_assembler = 0;
+  if (use_cache) {
+    if (!cache) {
+      cache = new TMROctTACSCache();
+    }
+    entry = &cache->entries[order];
+
+    int num_octs = 0, num_filter_octs = 0;
+    uint32_t key = computeOctantKey(forest, &num_octs);
+    uint32_t filter_key = 0;
+    if (filter) {
+      filter_key = computeOctantKey(filter, &num_filter_octs);
+    }
+    int num_bcs = (bcs ? bcs->getNumBoundaryConditions() : 0);
+
+    int flags[2];
+    flags[0] = (entry->elements && entry->key == key &&
+                entry->topo == forest->getTopology() &&
+                entry->interp_type == forest->getInterpType() &&
+                entry->num_bcs == num_bcs &&
+                entry->filter_key == filter_key &&
+                entry->num_filter_octs == num_filter_octs &&
+                entry->num_elements == num_elements &&
+                isSameOctants(forest, entry->octs, num_octs));
+    flags[1] = (flags[0] && entry->assembler && entry->ordering == ordering &&
+                !(components && num_comps > 0));
+    MPI_Allreduce(MPI_IN_PLACE, flags, 2, MPI_INT, MPI_MIN, comm);
+    reuse_elements = flags[0];
+    reuse_assembler = flags[1];
+
+    if (reuse_assembler) {
+      return entry->assembler;
+    } else if (!reuse_elements) {
+      // Replace the cached data for this order
+      entry->clear();
+      entry->key = key;
+      entry->topo = forest->getTopology();
+      entry->interp_type = forest->getInterpType();
+      entry->num_bcs = num_bcs;
+      entry->filter_key = filter_key;
+      entry->num_filter_octs = num_filter_octs;
+
+      TMROctantArray *octants;
+      forest->getOctants(&octants);
+      TMROctant *array;
+      octants->getArray(&array, &num_octs);
+      entry->octs = new TMROctant[num_octs];
+      memcpy(entry->octs, array, num_octs * sizeof(TMROctant));
+    } else if (entry->assembler) {
+      // The elements match but the assembler does not
+      entry->assembler->decref();
+      entry->assembler = NULL;
+    }
+  }
+
   // Allocate the pointer array
   int *ptr = new int[num_elements + 1];
   for (int i = 0; i <= num_elements; i++) {
@@ -360,12 +576,25 @@ TACSAssembler *TMROctTACSCreator::createTACS(
   const double *dep_weights = NULL;
   int num_dep_nodes = forest->getDepNodeConn(&dep_ptr, &dep_conn, &dep_weights);
 
-  // Create the elements using the virtual call
+  // Create the elements using the virtual call, or retrieve the
+  // elements from the cache
   TACSElement **elements = NULL;
   if (num_elements > 0) {
     elements = new TACSElement *[num_elements];
   }
-  createElements(order, forest, num_elements, elements);
+  if (reuse_elements) {
+    memcpy(elements, entry->elements, num_elements * sizeof(TACSElement *));
+  } else {
+    createElements(order, forest, num_elements, elements);
+    if (entry) {
+      entry->num_elements = num_elements;
+      entry->elements = new TACSElement *[num_elements];
+      for (int i = 0; i < num_elements; i++) {
+        elements[i]->incref();
+        entry->elements[i] = elements[i];
+      }
+    }
+  }
 
   // set the component numbers in the elements if specified
   if (components && (num_comps > 0)) {
@@ -457,6 +686,13 @@ TACSAssembler *TMROctTACSCreator::createTACS(
   // Set the node locations
   setNodeLocations(forest, assembler);
 
+  // Keep a reference to the assembler for later calls
+  if (entry && !(components && num_comps > 0)) {
+    assembler->incref();
+    entry->assembler = assembler;
+    entry->ordering = ordering;
+  }
+
   return assembler;
 }
 
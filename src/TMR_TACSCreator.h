@@ -83,6 +83,9 @@ class TMRQuadTACSCreator : public TMREntity {
   TMRQuadForest *filter;
 };
 
+// Cached element and assembler data for the octant creator
+class TMROctTACSCache;
+
 /*
   The creator object for octant meshes
 
@@ -115,6 +118,11 @@ class TMROctTACSCreator : public TMREntity {
 
   TMROctForest *getFilter() { return filter; }
 
+  // Reuse the elements and the TACSAssembler object from a previous
+  // call to createTACS when the forest has not changed
+  void setUseCache(int _use_cache);
+  void clearCache();
+
  protected:
   // Initialize the data
   void initialize(TMRBoundaryConditions *_bcs, int _design_vars_per_node,
@@ -129,6 +137,10 @@ class TMROctTACSCreator : public TMREntity {
   TMRBoundaryConditions *bcs;
   int design_vars_per_node;
   TMROctForest *filter;
+
+  // The cached data from previous calls to createTACS
+  int use_cache;
+  TMROctTACSCache *cache;
 };
 
 #endif  // TMR_TACS_CREATOR
@@ -0,0 +1,240 @@
+/*
+  This file is part of the package TMR for adaptive mesh refinement.
+
+  Copyright (C) 2015 Georgia Tech Research Corporation.
+  Additional copyright (C) 2015 Graeme Kennedy.
+  All rights reserved.
+
+  TMR is licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this software except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "TMR_VTKTools.h"
+
+#include <stdio.h>
+
+/*
+  Write the array on each processor to its location in the file
+
+  The offset is the location of the array in the file, the first
+  processor also writes the number of bytes in the array before the
+  array itself, as required by the VTK appended format.
+*/
+static void TMRWriteAppendedArray(MPI_File fp, int mpi_rank, MPI_Offset offset,
+                                  uint64_t total_bytes, MPI_Offset local_offset,
+                                  const void *data, int local_bytes) {
+  if (mpi_rank == 0) {
+    MPI_File_write_at(fp, offset, &total_bytes, sizeof(uint64_t), MPI_BYTE,
+                      MPI_STATUS_IGNORE);
+  }
+  MPI_File_write_at_all(fp, offset + sizeof(uint64_t) + local_offset,
+                        (void *)data, local_bytes, MPI_BYTE,
+                        MPI_STATUS_IGNORE);
+}
+
+/*
+  Copy the values to the buffer in single or double precision
+*/
+static void TMRCopyReal(int use_float32, int n, const double *values,
+                        char *buffer) {
+  if (use_float32) {
+    float *array = (float *)buffer;
+    for (int i = 0; i < n; i++) {
+      array[i] = values[i];
+    }
+  } else {
+    memcpy(buffer, values, n * sizeof(double));
+  }
+}
+
+/*
+  Write an unstructured grid to a binary VTK XML file
+*/
+int TMR_WriteVTUFile(MPI_Comm comm, const char *filename, int num_points,
+                     const TMRPoint *X, int num_cells, const int *cell_ptr,
+                     const int *cell_conn, const int *cell_types,
+                     int num_cell_data, const char *cell_data_names[],
+                     const double *cell_data, int use_float32) {
+  int mpi_size, mpi_rank;
+  MPI_Comm_size(comm, &mpi_size);
+  MPI_Comm_rank(comm, &mpi_rank);
+
+  // Compute the offsets for the points, cells and connectivity
+  long long counts[3] = {num_points, num_cells, cell_ptr[num_cells]};
+  long long *range = new long long[3 * (mpi_size + 1)];
+  range[0] = range[1] = range[2] = 0;
+  MPI_Allgather(counts, 3, MPI_LONG_LONG, &range[3], 3, MPI_LONG_LONG, comm);
+  for (int k = 0; k < mpi_size; k++) {
+    for (int j = 0; j < 3; j++) {
+      range[3 * (k + 1) + j] += range[3 * k + j];
+    }
+  }
+  const long long total_points = range[3 * mpi_size];
+  const long long total_cells = range[3 * mpi_size + 1];
+  const long long total_conn = range[3 * mpi_size + 2];
+  const long long point_offset = range[3 * mpi_rank];
+  const long long cell_offset = range[3 * mpi_rank + 1];
+  const long long conn_offset = range[3 * mpi_rank + 2];
+  delete[] range;
+
+  // Compute the size of each array in the appended data section
+  const int real_size = (use_float32 ? sizeof(float) : sizeof(double));
+  const char *real_type = (use_float32 ? "Float32" : "Float64");
+  const int num_arrays = 4 + num_cell_data;
+  uint64_t *array_bytes = new uint64_t[num_arrays];
+  MPI_Offset *array_offset = new MPI_Offset[num_arrays + 1];
+  array_bytes[0] = 3 * real_size * total_points;
+  array_bytes[1] = sizeof(int64_t) * total_conn;
+  array_bytes[2] = sizeof(int64_t) * total_cells;
+  array_bytes[3] = sizeof(uint8_t) * total_cells;
+  for (int k = 0; k < num_cell_data; k++) {
+    array_bytes[4 + k] = real_size * total_cells;
+  }
+  array_offset[0] = 0;
+  for (int k = 0; k < num_arrays; k++) {
+    array_offset[k + 1] = array_offset[k] + sizeof(uint64_t) + array_bytes[k];
+  }
+
+  // Create the XML header. This is the same on all processors.
+  int header_len = 2048 + 256 * num_cell_data;
+  char *header = new char[header_len];
+  int pos = snprintf(
+      header, header_len,
+      "<?xml version=\"1.0\"?>\n"
+      "<VTKFile type=\"UnstructuredGrid\" version=\"1.0\" "
+      "byte_order=\"LittleEndian\" header_type=\"UInt64\">\n"
+      "<UnstructuredGrid>\n"
+      "<Piece NumberOfPoints=\"%lld\" NumberOfCells=\"%lld\">\n"
+      "<Points>\n"
+      "<DataArray type=\"%s\" NumberOfComponents=\"3\" "
+      "format=\"appended\" offset=\"%lld\"/>\n"
+      "</Points>\n"
+      "<Cells>\n"
+      "<DataArray type=\"Int64\" Name=\"connectivity\" "
+      "format=\"appended\" offset=\"%lld\"/>\n"
+      "<DataArray type=\"Int64\" Name=\"offsets\" "
+      "format=\"appended\" offset=\"%lld\"/>\n"
+      "<DataArray type=\"UInt8\" Name=\"types\" "
+      "format=\"appended\" offset=\"%lld\"/>\n"
+      "</Cells>\n"
+      "<CellData>\n",
+      total_points, total_cells, real_type, (long long)array_offset[0],
+      (long long)array_offset[1], (long long)array_offset[2],
+      (long long)array_offset[3]);
+  for (int k = 0; k < num_cell_data; k++) {
+    pos += snprintf(&header[pos], header_len - pos,
+                    "<DataArray type=\"%s\" Name=\"%s\" "
+                    "format=\"appended\" offset=\"%lld\"/>\n",
+                    real_type, cell_data_names[k],
+                    (long long)array_offset[4 + k]);
+  }
+  pos += snprintf(&header[pos], header_len - pos,
+                  "</CellData>\n"
+                  "</Piece>\n"
+                  "</UnstructuredGrid>\n"
+                  "<AppendedData encoding=\"raw\">\n_");
+  const char footer[] = "\n</AppendedData>\n</VTKFile>\n";
+  const MPI_Offset data_start = pos;
+
+  // Copy the filename to a non-const array
+  char *fname = new char[strlen(filename) + 1];
+  strcpy(fname, filename);
+
+  // Create the file and write out the information
+  int fail = 0;
+  MPI_File fp = NULL;
+  MPI_File_open(comm, fname, MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL,
+                &fp);
+
+  if (fp) {
+    // Truncate any existing file to the final size
+    MPI_File_set_size(fp, data_start + array_offset[num_arrays] +
+                              strlen(footer));
+
+    if (mpi_rank == 0) {
+      MPI_File_write_at(fp, 0, header, pos, MPI_CHAR, MPI_STATUS_IGNORE);
+      MPI_File_write_at(fp, data_start + array_offset[num_arrays],
+                        (void *)footer, strlen(footer), MPI_CHAR,
+                        MPI_STATUS_IGNORE);
+    }
+
+    // Allocate a buffer large enough for any of the local arrays
+    int conn_size = cell_ptr[num_cells];
+    int max_bytes = 3 * real_size * num_points;
+    if (sizeof(int64_t) * conn_size > (size_t)max_bytes) {
+      max_bytes = sizeof(int64_t) * conn_size;
+    }
+    if (sizeof(int64_t) * num_cells > (size_t)max_bytes) {
+      max_bytes = sizeof(int64_t) * num_cells;
+    }
+    char *buffer = new char[max_bytes + 1];
+
+    // Write the points
+    double *Xtmp = new double[3 * num_points];
+    for (int i = 0; i < num_points; i++) {
+      Xtmp[3 * i] = X[i].x;
+      Xtmp[3 * i + 1] = X[i].y;
+      Xtmp[3 * i + 2] = X[i].z;
+    }
+    TMRCopyReal(use_float32, 3 * num_points, Xtmp, buffer);
+    delete[] Xtmp;
+    TMRWriteAppendedArray(fp, mpi_rank, data_start + array_offset[0],
+                          array_bytes[0], 3 * real_size * point_offset, buffer,
+                          3 * real_size * num_points);
+
+    // Write the connectivity with the global point numbers
+    int64_t *array = (int64_t *)buffer;
+    for (int i = 0; i < conn_size; i++) {
+      array[i] = cell_conn[i] + point_offset;
+    }
+    TMRWriteAppendedArray(fp, mpi_rank, data_start + array_offset[1],
+                          array_bytes[1], sizeof(int64_t) * conn_offset,
+                          buffer, sizeof(int64_t) * conn_size);
+
+    // Write the offsets to the end of each cell
+    for (int i = 0; i < num_cells; i++) {
+      array[i] = conn_offset + cell_ptr[i + 1];
+    }
+    TMRWriteAppendedArray(fp, mpi_rank, data_start + array_offset[2],
+                          array_bytes[2], sizeof(int64_t) * cell_offset,
+                          buffer, sizeof(int64_t) * num_cells);
+
+    // Write the cell types
+    uint8_t *types = (uint8_t *)buffer;
+    for (int i = 0; i < num_cells; i++) {
+      types[i] = cell_types[i];
+    }
+    TMRWriteAppendedArray(fp, mpi_rank, data_start + array_offset[3],
+                          array_bytes[3], sizeof(uint8_t) * cell_offset,
+                          buffer, sizeof(uint8_t) * num_cells);
+
+    // Write the cell data
+    for (int k = 0; k < num_cell_data; k++) {
+      TMRCopyReal(use_float32, num_cells, &cell_data[k * num_cells], buffer);
+      TMRWriteAppendedArray(fp, mpi_rank, data_start + array_offset[4 + k],
+                            array_bytes[4 + k], real_size * cell_offset,
+                            buffer, real_size * num_cells);
+    }
+
+    delete[] buffer;
+    MPI_File_close(&fp);
+  } else {
+    fail = 1;
+  }
+
+  delete[] header;
+  delete[] fname;
+  delete[] array_bytes;
+  delete[] array_offset;
+
+  return fail;
+}
@@ -0,0 +1,70 @@
+/*
+  This file is part of the package TMR for adaptive mesh refinement.
+
+  Copyright (C) 2015 Georgia Tech Research Corporation.
+  Additional copyright (C) 2015 Graeme Kennedy.
+  All rights reserved.
+
+  TMR is licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this software except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef TMR_VTK_TOOLS_H
+#define TMR_VTK_TOOLS_H
+
+#include "TMRBase.h"
+
+/*
+  The VTK cell types used by TMR
+*/
+enum TMRVTKCellType {
+  TMR_VTK_TRIANGLE = 5,
+  TMR_VTK_QUAD = 9,
+  TMR_VTK_TETRA = 10,
+  TMR_VTK_HEXAHEDRON = 12
+};
+
+/*
+  Write an unstructured grid to a binary VTK XML file (.vtu)
+
+  All processors in the communicator write their part of the grid to
+  a single shared file using collective MPI/IO. The data is stored in
+  the appended raw format, so the file size is proportional to the
+  size of the mesh and no ASCII conversion is required.
+
+  Notes: The filename must be the same on all processors. To write a
+  serial file, call this function on a single processor with
+  MPI_COMM_SELF.
+
+  input:
+  comm:             the communicator
+  filename:         the filename
+  num_points:       the number of points on this processor
+  X:                the point locations
+  num_cells:        the number of cells on this processor
+  cell_ptr:         pointer into the connectivity for each cell
+  cell_conn:        the cell connectivity (local point indices)
+  cell_types:       the VTK cell type for each cell
+  num_cell_data:    the number of cell data fields
+  cell_data_names:  the names of the cell data fields
+  cell_data:        the cell data ordered by field then cell
+  use_float32:      write the points and data in single precision
+
+  returns:          a non-zero fail flag if the file cannot be opened
+*/
+int TMR_WriteVTUFile(MPI_Comm comm, const char *filename, int num_points,
+                     const TMRPoint *X, int num_cells, const int *cell_ptr,
+                     const int *cell_conn, const int *cell_types,
+                     int num_cell_data, const char *cell_data_names[],
+                     const double *cell_data, int use_float32 = 1);
+
+#endif  // TMR_VTK_TOOLS_H
@@ -20,6 +20,9 @@
 
 #include "TMREgads.h"
 
+#include <math.h>
+#include <string.h>
+
 #include <map>
 
 #ifdef TMR_HAS_EGADS
@@ -29,14 +32,28 @@ using namespace TMR_EgadsInterface;
 TMR_EgadsContext::TMR_EgadsContext() {
   EG_open(&ctx);
   ismine = 1;
+  num_tess = max_num_tess = 0;
+  tess_bodies = tess_objs = NULL;
+  pthread_mutex_init(&tess_mutex, NULL);
 }
 
 TMR_EgadsContext::TMR_EgadsContext(ego _ctx) {
   ctx = _ctx;
   ismine = 0;
+  num_tess = max_num_tess = 0;
+  tess_bodies = tess_objs = NULL;
+  pthread_mutex_init(&tess_mutex, NULL);
 }
 
 TMR_EgadsContext::~TMR_EgadsContext() {
+  for (int i = 0; i < num_tess; i++) {
+    EG_deleteObject(tess_objs[i]);
+  }
+  if (tess_bodies) {
+    delete[] tess_bodies;
+    delete[] tess_objs;
+  }
+  pthread_mutex_destroy(&tess_mutex);
   if (ismine) {
     EG_close(ctx);
   }
@@ -44,6 +61,160 @@ TMR_EgadsContext::~TMR_EgadsContext() {
 
 ego TMR_EgadsContext::getContext() { return ctx; }
 
+/*
+  Get the tessellation of the body that contains the face or edge
+
+  The tessellation is only used to seed the inverse evaluation, so it
+  is created once for each body with a resolution set relative to the
+  size of the body.
+*/
+int TMR_EgadsContext::getTessellation(ego obj, ego *body, ego *tess) {
+  *body = NULL;
+  *tess = NULL;
+  if (EG_getBody(obj, body) != EGADS_SUCCESS || !(*body)) {
+    return 1;
+  }
+
+  pthread_mutex_lock(&tess_mutex);
+  for (int i = 0; i < num_tess; i++) {
+    if (tess_bodies[i] == *body) {
+      *tess = tess_objs[i];
+      break;
+    }
+  }
+
+  if (!(*tess)) {
+    // Set the maximum edge length, sag and angle of the tessellation
+    double params[3] = {0.0, 0.0, 15.0};
+    double box[6];
+    if (EG_getBoundingBox(*body, box) == EGADS_SUCCESS) {
+      double d = sqrt((box[3] - box[0]) * (box[3] - box[0]) +
+                      (box[4] - box[1]) * (box[4] - box[1]) +
+                      (box[5] - box[2]) * (box[5] - box[2]));
+      params[0] = 0.025 * d;
+      params[1] = 0.001 * d;
+    }
+
+    ego t;
+    if (EG_makeTessBody(*body, params, &t) == EGADS_SUCCESS) {
+      if (num_tess >= max_num_tess) {
+        max_num_tess = 2 * max_num_tess + 4;
+        ego *bodies = new ego[max_num_tess];
+        ego *objs = new ego[max_num_tess];
+        if (tess_bodies) {
+          memcpy(bodies, tess_bodies, num_tess * sizeof(ego));
+          memcpy(objs, tess_objs, num_tess * sizeof(ego));
+          delete[] tess_bodies;
+          delete[] tess_objs;
+        }
+        tess_bodies = bodies;
+        tess_objs = objs;
+      }
+      tess_bodies[num_tess] = *body;
+      tess_objs[num_tess] = t;
+      num_tess++;
+      *tess = t;
+    }
+  }
+  pthread_mutex_unlock(&tess_mutex);
+
+  return (*tess ? 0 : 1);
+}
+
+TMR_EgadsInvEvalSeed::TMR_EgadsInvEvalSeed() {
+  initialized = 0;
+  nprm = 0;
+  locator = NULL;
+  params = NULL;
+  has_last = 0;
+}
+
+TMR_EgadsInvEvalSeed::~TMR_EgadsInvEvalSeed() {
+  if (locator) {
+    locator->decref();
+  }
+  if (params) {
+    delete[] params;
+  }
+}
+
+/*
+  Set the tessellation points on the face or edge and their parameter
+  values
+*/
+void TMR_EgadsInvEvalSeed::initialize(int npts, const double *xyz,
+                                      const double *prm, int _nprm) {
+  initialized = 1;
+  if (npts <= 0) {
+    return;
+  }
+
+  nprm = _nprm;
+  params = new double[nprm * npts];
+  memcpy(params, prm, nprm * npts * sizeof(double));
+
+  TMRPoint *pts = new TMRPoint[npts];
+  for (int i = 0; i < npts; i++) {
+    pts[i].x = xyz[3 * i];
+    pts[i].y = xyz[3 * i + 1];
+    pts[i].z = xyz[3 * i + 2];
+  }
+  locator = new TMRPointLocator(npts, pts);
+  locator->incref();
+  delete[] pts;
+}
+
+/*
+  Find the parameters of the closest tessellation point, or of the
+  last result when it is closer. Returns non-zero when there is no
+  initial guess available.
+*/
+int TMR_EgadsInvEvalSeed::getSeed(TMRPoint X, double *prm) {
+  double dmin = -1.0;
+  if (locator) {
+    int nk, index;
+    double dist;
+    locator->locateClosest(1, X, &nk, &index, &dist);
+    if (nk > 0) {
+      dmin = dist;
+      for (int k = 0; k < nprm; k++) {
+        prm[k] = params[nprm * index + k];
+      }
+    }
+  }
+
+  if (has_last) {
+    double dx = X.x - last_result.x;
+    double dy = X.y - last_result.y;
+    double dz = X.z - last_result.z;
+    double d = dx * dx + dy * dy + dz * dz;
+    if (dmin < 0.0 || d < dmin) {
+      dmin = d;
+      for (int k = 0; k < nprm; k++) {
+        prm[k] = last_prm[k];
+      }
+    }
+  }
+
+  return (dmin < 0.0);
+}
+
+/*
+  Record the result of the last inverse evaluation
+*/
+void TMR_EgadsInvEvalSeed::setResult(const double *prm,
+                                     const double *result) {
+  if (nprm > 0) {
+    has_last = 1;
+    for (int k = 0; k < nprm; k++) {
+      last_prm[k] = prm[k];
+    }
+    last_result.x = result[0];
+    last_result.y = result[1];
+    last_result.z = result[2];
+  }
+}
+
 TMR_EgadsNode::TMR_EgadsNode(TMR_EgadsContext *_ctx, ego _node) {
   ctx = _ctx;
   ctx->incref();
@@ -95,11 +266,16 @@ int TMR_EgadsNode::getParamsOnFace(TMRFace *surface, double *u, double *v) {
 int TMR_EgadsNode::isSame(TMRVertex *vt) {
   TMR_EgadsNode *v = dynamic_cast<TMR_EgadsNode *>(vt);
   if (v) {
+    if (node == v->node) {
+      return 1;
+    }
     return (EG_isSame(node, v->node) == EGADS_SUCCESS);
   }
   return 0;
 }
 
+uint32_t TMR_EgadsNode::getHashKey() { return TMRPointerHash(node); }
+
 void TMR_EgadsNode::getNodeObject(ego *n) { *n = node; }
 
 TMR_EgadsEdge::TMR_EgadsEdge(TMR_EgadsContext *_ctx, ego _edge,
@@ -108,9 +284,13 @@ TMR_EgadsEdge::TMR_EgadsEdge(TMR_EgadsContext *_ctx, ego _edge,
   ctx->incref();
   edge = _edge;
   is_degenerate = _is_degenerate;
+  pthread_mutex_init(&mutex, NULL);
 }
 
-TMR_EgadsEdge::~TMR_EgadsEdge() { ctx->decref(); }
+TMR_EgadsEdge::~TMR_EgadsEdge() {
+  ctx->decref();
+  pthread_mutex_destroy(&mutex);
+}
 
 void TMR_EgadsEdge::getRange(double *tmin, double *tmax) {
   double range[4];
@@ -174,10 +354,31 @@ int TMR_EgadsEdge::invEvalPoint(TMRPoint X, double *t) {
   pos[1] = X.y;
   pos[2] = X.z;
 
-  // Perform the inverse evaluation
-  double params[2];
+  // Find the initial guess from the tessellation or the last result
+  double params[2] = {0.0, 0.0};
   double result[3];
-  int icode = EG_invEvaluate(edge, pos, params, result);
+  pthread_mutex_lock(&mutex);
+  if (!seed.initialized) {
+    initSeed();
+  }
+  int has_seed = (seed.getSeed(X, params) == 0);
+  pthread_mutex_unlock(&mutex);
+
+  // Perform the inverse evaluation, starting from the guess if there
+  // is one
+  int icode = EGADS_NOTFOUND;
+  if (has_seed) {
+    icode = EG_invEvaluateGuess(edge, pos, params, result);
+  }
+  if (icode != EGADS_SUCCESS) {
+    icode = EG_invEvaluate(edge, pos, params, result);
+  }
+
+  if (icode == EGADS_SUCCESS) {
+    pthread_mutex_lock(&mutex);
+    seed.setResult(params, result);
+    pthread_mutex_unlock(&mutex);
+  }
 
   // Set the parameters
   *t = params[0];
@@ -185,6 +386,28 @@ int TMR_EgadsEdge::invEvalPoint(TMRPoint X, double *t) {
   return icode;
 }
 
+/*
+  Place the tessellation points on the edge in the point locator. This
+  is called with the mutex held.
+*/
+void TMR_EgadsEdge::initSeed() {
+  seed.initialized = 1;
+  if (is_degenerate) {
+    return;
+  }
+
+  ego body, tess;
+  if (ctx->getTessellation(edge, &body, &tess) == 0) {
+    int index = EG_indexBodyTopo(body, edge);
+    int len;
+    const double *xyz, *t;
+    if (index > 0 &&
+        EG_getTessEdge(tess, index, &len, &xyz, &t) == EGADS_SUCCESS) {
+      seed.initialize(len, xyz, t, 1);
+    }
+  }
+}
+
 int TMR_EgadsEdge::evalDeriv(double t, TMRPoint *X, TMRPoint *Xt) {
   double eval[18];
 
@@ -233,11 +456,16 @@ int TMR_EgadsEdge::eval2ndDeriv(double t, TMRPoint *X, TMRPoint *Xt,
 int TMR_EgadsEdge::isSame(TMREdge *et) {
   TMR_EgadsEdge *e = dynamic_cast<TMR_EgadsEdge *>(et);
   if (e) {
+    if (edge == e->edge) {
+      return 1;
+    }
     return (EG_isSame(edge, e->edge) == EGADS_SUCCESS);
   }
   return 0;
 }
 
+uint32_t TMR_EgadsEdge::getHashKey() { return TMRPointerHash(edge); }
+
 void TMR_EgadsEdge::getEdgeObject(ego *e) { *e = edge; }
 
 int TMR_EgadsEdge::isDegenerate() { return is_degenerate; }
@@ -250,9 +478,13 @@ TMR_EgadsFace::TMR_EgadsFace(TMR_EgadsContext *_ctx, int _normal_dir, ego _face)
   ctx = _ctx;
   ctx->incref();
   face = _face;
+  pthread_mutex_init(&mutex, NULL);
 }
 
-TMR_EgadsFace::~TMR_EgadsFace() { ctx->decref(); }
+TMR_EgadsFace::~TMR_EgadsFace() {
+  ctx->decref();
+  pthread_mutex_destroy(&mutex);
+}
 
 void TMR_EgadsFace::getRange(double *umin, double *vmin, double *umax,
                              double *vmax) {
@@ -290,10 +522,35 @@ int TMR_EgadsFace::invEvalPoint(TMRPoint X, double *u, double *v) {
   pos[1] = X.y;
   pos[2] = X.z;
 
-  // Perform the inverse evaluation
-  double params[2];
+  // Find the initial guess from the tessellation or the last result
+  double params[2] = {0.0, 0.0};
   double result[3];
-  int icode = EG_invEvaluate(face, pos, params, result);
+  pthread_mutex_lock(&mutex);
+  if (!seed.initialized) {
+    initSeed();
+  }
+  int has_seed = (seed.getSeed(X, params) == 0);
+  pthread_mutex_unlock(&mutex);
+
+  // Perform the inverse evaluation, starting from the guess if there
+  // is one. The result must lie within the trimmed face, otherwise
+  // the full inverse evaluation is used.
+  int icode = EGADS_NOTFOUND;
+  if (has_seed) {
+    icode = EG_invEvaluateGuess(face, pos, params, result);
+    if (icode == EGADS_SUCCESS && EG_inFace(face, params) != EGADS_SUCCESS) {
+      icode = EGADS_OUTSIDE;
+    }
+  }
+  if (icode != EGADS_SUCCESS) {
+    icode = EG_invEvaluate(face, pos, params, result);
+  }
+
+  if (icode == EGADS_SUCCESS) {
+    pthread_mutex_lock(&mutex);
+    seed.setResult(params, result);
+    pthread_mutex_unlock(&mutex);
+  }
 
   // Set the parameters
   *u = params[0];
@@ -302,6 +559,27 @@ int TMR_EgadsFace::invEvalPoint(TMRPoint X, double *u, double *v) {
   return icode;
 }
 
+/*
+  Place the tessellation points on the face in the point locator. This
+  is called with the mutex held.
+*/
+void TMR_EgadsFace::initSeed() {
+  seed.initialized = 1;
+
+  ego body, tess;
+  if (ctx->getTessellation(face, &body, &tess) == 0) {
+    int index = EG_indexBodyTopo(body, face);
+    int len, ntris;
+    const double *xyz, *uv;
+    const int *ptype, *pindex, *tris, *tric;
+    if (index > 0 &&
+        EG_getTessFace(tess, index, &len, &xyz, &uv, &ptype, &pindex, &ntris,
+                       &tris, &tric) == EGADS_SUCCESS) {
+      seed.initialize(len, xyz, uv, 2);
+    }
+  }
+}
+
 int TMR_EgadsFace::evalDeriv(double u, double v, TMRPoint *X, TMRPoint *Xu,
                              TMRPoint *Xv) {
   double eval[18];
@@ -368,19 +646,418 @@ int TMR_EgadsFace::eval2ndDeriv(double u, double v, TMRPoint *X, TMRPoint *Xu,
 int TMR_EgadsFace::isSame(TMRFace *ft) {
   TMR_EgadsFace *f = dynamic_cast<TMR_EgadsFace *>(ft);
   if (f) {
+    if (face == f->face) {
+      return 1;
+    }
     return (EG_isSame(face, f->face) == EGADS_SUCCESS);
   }
   return 0;
 }
 
+uint32_t TMR_EgadsFace::getHashKey() { return TMRPointerHash(face); }
+
 void TMR_EgadsFace::getFaceObject(ego *f) { *f = face; }
 
+/*
+  The maximum B-spline order that can be converted to a native object.
+  This matches the maximum order in TMRBspline.
+*/
+static const int TMR_MAX_NATIVE_ORDER = 6;
+
+/*
+  Check that the knot vector is clamped at both ends
+*/
+static int TMR_IsClampedKnots(int n, int k, const double *Tu) {
+  for (int i = 1; i < k; i++) {
+    if (Tu[i] != Tu[0] || Tu[n + k - 1 - i] != Tu[n + k - 1]) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/*
+  Get the geometry data for the object, following trimmed curves and
+  surfaces to the underlying geometry, which has the same
+  parametrization
+*/
+static int TMR_GetEgadsGeometry(ego *geom, int *mtype, int **ivec,
+                                double **rvec) {
+  while (1) {
+    int oclass;
+    ego rref;
+    *ivec = NULL;
+    *rvec = NULL;
+    int icode = EG_getGeometry(*geom, &oclass, mtype, &rref, ivec, rvec);
+    if (icode != EGADS_SUCCESS || *mtype != TRIMMED) {
+      return icode;
+    }
+    EG_free(*ivec);
+    EG_free(*rvec);
+    *geom = rref;
+  }
+}
+
+/*
+  Convert the curve to a TMRBsplineCurve with the same parametrization.
+  Lines are converted over the range [t0, t1]. Returns NULL when the
+  curve cannot be represented exactly.
+*/
+static TMRBsplineCurve *TMR_ConvertEgadsCurve(ego curve, double t0,
+                                              double t1) {
+  int mtype;
+  int *ivec;
+  double *rvec;
+  if (TMR_GetEgadsGeometry(&curve, &mtype, &ivec, &rvec) != EGADS_SUCCESS) {
+    return NULL;
+  }
+
+  TMRBsplineCurve *native = NULL;
+  if (mtype == LINE) {
+    double Tu[4] = {t0, t0, t1, t1};
+    TMRPoint pts[2];
+    double eval[9];
+    EG_evaluate(curve, &t0, eval);
+    pts[0].x = eval[0];
+    pts[0].y = eval[1];
+    pts[0].z = eval[2];
+    EG_evaluate(curve, &t1, eval);
+    pts[1].x = eval[0];
+    pts[1].y = eval[1];
+    pts[1].z = eval[2];
+    native = new TMRBsplineCurve(2, 2, Tu, pts);
+  } else if (mtype == BSPLINE) {
+    int k = ivec[1] + 1;
+    int n = ivec[2];
+    int nknots = ivec[3];
+    const double *Tu = rvec;
+    if (nknots == n + k && k <= TMR_MAX_NATIVE_ORDER &&
+        TMR_IsClampedKnots(n, k, Tu)) {
+      TMRPoint *pts = new TMRPoint[n];
+      for (int i = 0; i < n; i++) {
+        pts[i].x = rvec[nknots + 3 * i];
+        pts[i].y = rvec[nknots + 3 * i + 1];
+        pts[i].z = rvec[nknots + 3 * i + 2];
+      }
+      if (ivec[0] & 2) {
+        native = new TMRBsplineCurve(n, k, Tu, &rvec[nknots + 3 * n], pts);
+      } else {
+        native = new TMRBsplineCurve(n, k, Tu, pts);
+      }
+      delete[] pts;
+    }
+  }
+
+  EG_free(ivec);
+  EG_free(rvec);
+  return native;
+}
+
+/*
+  Convert the pcurve to a TMRBsplinePcurve with the same
+  parametrization
+*/
+static TMRBsplinePcurve *TMR_ConvertEgadsPcurve(ego pcurve, double t0,
+                                                double t1) {
+  int mtype;
+  int *ivec;
+  double *rvec;
+  if (TMR_GetEgadsGeometry(&pcurve, &mtype, &ivec, &rvec) != EGADS_SUCCESS) {
+    return NULL;
+  }
+
+  TMRBsplinePcurve *native = NULL;
+  if (mtype == LINE) {
+    double Tu[4] = {t0, t0, t1, t1};
+    double pts[4];
+    double eval[6];
+    EG_evaluate(pcurve, &t0, eval);
+    pts[0] = eval[0];
+    pts[1] = eval[1];
+    EG_evaluate(pcurve, &t1, eval);
+    pts[2] = eval[0];
+    pts[3] = eval[1];
+    native = new TMRBsplinePcurve(2, 2, Tu, pts);
+  } else if (mtype == BSPLINE) {
+    int k = ivec[1] + 1;
+    int n = ivec[2];
+    int nknots = ivec[3];
+    const double *Tu = rvec;
+    if (nknots == n + k && k <= TMR_MAX_NATIVE_ORDER &&
+        TMR_IsClampedKnots(n, k, Tu)) {
+      if (ivec[0] & 2) {
+        native = new TMRBsplinePcurve(n, k, Tu, &rvec[nknots + 2 * n],
+                                      &rvec[nknots]);
+      } else {
+        native = new TMRBsplinePcurve(n, k, Tu, &rvec[nknots]);
+      }
+    }
+  }
+
+  EG_free(ivec);
+  EG_free(rvec);
+  return native;
+}
+
+/*
+  Create the pcurve of a curve on a plane. The parameters on a plane
+  are an affine function of the position, so the pcurve has the
+  control points of the curve mapped onto the plane.
+*/
+static TMRBsplinePcurve *TMR_ConvertEgadsPlanePcurve(ego face,
+                                                     TMRBsplineCurve *curve) {
+  ego surf, *children;
+  int oclass, mtype, nchildren, *sense;
+  double data[4];
+  EG_getTopology(face, &surf, &oclass, &mtype, data, &nchildren, &children,
+                 &sense);
+
+  int smtype;
+  int *ivec;
+  double *rvec;
+  if (TMR_GetEgadsGeometry(&surf, &smtype, &ivec, &rvec) != EGADS_SUCCESS) {
+    return NULL;
+  }
+  EG_free(ivec);
+  EG_free(rvec);
+  if (smtype != PLANE) {
+    return NULL;
+  }
+
+  // Find the origin and the derivatives of the plane
+  double prm[2] = {0.0, 0.0};
+  double eval[18];
+  EG_evaluate(surf, prm, eval);
+  const double *X0 = &eval[0], *Xu = &eval[3], *Xv = &eval[6];
+  double a11 = Xu[0] * Xu[0] + Xu[1] * Xu[1] + Xu[2] * Xu[2];
+  double a12 = Xu[0] * Xv[0] + Xu[1] * Xv[1] + Xu[2] * Xv[2];
+  double a22 = Xv[0] * Xv[0] + Xv[1] * Xv[1] + Xv[2] * Xv[2];
+  double det = a11 * a22 - a12 * a12;
+  if (det == 0.0) {
+    return NULL;
+  }
+
+  int n, k;
+  const double *Tu, *wts;
+  const TMRPoint *pts;
+  curve->getData(&n, &k, &Tu, &wts, &pts);
+
+  double *uv = new double[2 * n];
+  for (int i = 0; i < n; i++) {
+    double d[3] = {pts[i].x - X0[0], pts[i].y - X0[1], pts[i].z - X0[2]};
+    double bu = Xu[0] * d[0] + Xu[1] * d[1] + Xu[2] * d[2];
+    double bv = Xv[0] * d[0] + Xv[1] * d[1] + Xv[2] * d[2];
+    uv[2 * i] = (a22 * bu - a12 * bv) / det;
+    uv[2 * i + 1] = (a11 * bv - a12 * bu) / det;
+  }
+
+  TMRBsplinePcurve *native = NULL;
+  if (wts) {
+    native = new TMRBsplinePcurve(n, k, Tu, wts, uv);
+  } else {
+    native = new TMRBsplinePcurve(n, k, Tu, uv);
+  }
+  delete[] uv;
+
+  return native;
+}
+
+/*
+  Convert the surface of the face to a TMRBsplineSurface with the same
+  parametrization. Planes are converted over the parameter range of
+  the face.
+*/
+static TMRBsplineSurface *TMR_ConvertEgadsSurface(ego face) {
+  ego surf, *children;
+  int oclass, mtype, nchildren, *sense;
+  double data[4];
+  EG_getTopology(face, &surf, &oclass, &mtype, data, &nchildren, &children,
+                 &sense);
+
+  int *ivec;
+  double *rvec;
+  if (TMR_GetEgadsGeometry(&surf, &mtype, &ivec, &rvec) != EGADS_SUCCESS) {
+    return NULL;
+  }
+
+  TMRBsplineSurface *native = NULL;
+  if (mtype == PLANE) {
+    double range[4];
+    int periodic;
+    EG_getRange(face, range, &periodic);
+    double Tu[4] = {range[0], range[0], range[1], range[1]};
+    double Tv[4] = {range[2], range[2], range[3], range[3]};
+    TMRPoint pts[4];
+    for (int j = 0; j < 2; j++) {
+      for (int i = 0; i < 2; i++) {
+        double prm[2] = {range[i], range[2 + j]};
+        double eval[18];
+        EG_evaluate(surf, prm, eval);
+        pts[i + 2 * j].x = eval[0];
+        pts[i + 2 * j].y = eval[1];
+        pts[i + 2 * j].z = eval[2];
+      }
+    }
+    native = new TMRBsplineSurface(2, 2, 2, 2, Tu, Tv, pts);
+  } else if (mtype == BSPLINE) {
+    int ku = ivec[1] + 1;
+    int nu = ivec[2];
+    int nuknots = ivec[3];
+    int kv = ivec[4] + 1;
+    int nv = ivec[5];
+    int nvknots = ivec[6];
+    const double *Tu = rvec;
+    const double *Tv = &rvec[nuknots];
+    if (nuknots == nu + ku && nvknots == nv + kv &&
+        ku <= TMR_MAX_NATIVE_ORDER && kv <= TMR_MAX_NATIVE_ORDER &&
+        TMR_IsClampedKnots(nu, ku, Tu) && TMR_IsClampedKnots(nv, kv, Tv)) {
+      const double *cps = &rvec[nuknots + nvknots];
+      TMRPoint *pts = new TMRPoint[nu * nv];
+      for (int i = 0; i < nu * nv; i++) {
+        pts[i].x = cps[3 * i];
+        pts[i].y = cps[3 * i + 1];
+        pts[i].z = cps[3 * i + 2];
+      }
+      if (ivec[0] & 2) {
+        native = new TMRBsplineSurface(nu, nv, ku, kv, Tu, Tv,
+                                       &cps[3 * nu * nv], pts);
+      } else {
+        native = new TMRBsplineSurface(nu, nv, ku, kv, Tu, Tv, pts);
+      }
+      delete[] pts;
+    }
+  }
+
+  EG_free(ivec);
+  EG_free(rvec);
+  return native;
+}
+
+/*
+  Convert the pcurve of the k-th edge in the loop. Loops on planes do
+  not store pcurves, so the pcurve is created from the edge curve.
+*/
+static TMRBsplinePcurve *TMR_ConvertEgadsLoopPcurve(ego face, ego loop, int k,
+                                                    TMRBsplineCurve *curve,
+                                                    double t0, double t1) {
+  ego loop_ref, *loop_children;
+  int oclass, mtype, num_edges, *edge_sense;
+  double data[4];
+  EG_getTopology(loop, &loop_ref, &oclass, &mtype, data, &num_edges,
+                 &loop_children, &edge_sense);
+
+  if (loop_ref) {
+    return TMR_ConvertEgadsPcurve(loop_children[num_edges + k], t0, t1);
+  }
+  return TMR_ConvertEgadsPlanePcurve(face, curve);
+}
+
+/*
+  Find the faces and edges that can be converted to native objects.
+  Edges are converted when the curve and the pcurves on all of the
+  faces can be converted. Faces are converted when the surface and all
+  of their edges can be converted, so that the parameters of the edges
+  on native faces always come from a pcurve.
+*/
+static void TMR_ConvertEgadsToNative(int nedges, std::map<int, ego> &edges,
+                                     int nfaces, std::map<int, ego> &faces,
+                                     std::map<ego, int> &edge_map,
+                                     TMRBsplineSurface **native_surfs,
+                                     TMRBsplineCurve **native_curves,
+                                     double *native_range) {
+  for (int index = 0; index < nedges; index++) {
+    ego ref, *children;
+    int oclass, mtype, nchildren, *sense;
+    double data[4];
+    EG_getTopology(edges[index], &ref, &oclass, &mtype, data, &nchildren,
+                   &children, &sense);
+
+    native_curves[index] = NULL;
+    if (mtype != DEGENERATE) {
+      native_curves[index] = TMR_ConvertEgadsCurve(ref, data[0], data[1]);
+      if (native_curves[index]) {
+        native_curves[index]->incref();
+      }
+    }
+    native_range[2 * index] = data[0];
+    native_range[2 * index + 1] = data[1];
+  }
+
+  for (int index = 0; index < nfaces; index++) {
+    native_surfs[index] = TMR_ConvertEgadsSurface(faces[index]);
+    if (native_surfs[index]) {
+      native_surfs[index]->incref();
+    }
+  }
+
+  // Check that the pcurves of the edges can be converted
+  for (int index = 0; index < nfaces; index++) {
+    ego ref, *face_loops;
+    int oclass, mtype, num_loops, *loop_sense;
+    double data[4];
+    EG_getTopology(faces[index], &ref, &oclass, &mtype, data, &num_loops,
+                   &face_loops, &loop_sense);
+
+    for (int i = 0; i < num_loops; i++) {
+      ego loop_ref, *loop_edges;
+      int loop_oclass, loop_mtype, num_edges, *edge_sense;
+      EG_getTopology(face_loops[i], &loop_ref, &loop_oclass, &loop_mtype,
+                     data, &num_edges, &loop_edges, &edge_sense);
+
+      for (int k = 0; k < num_edges; k++) {
+        int e = edge_map[loop_edges[k]];
+        if (native_curves[e]) {
+          TMRBsplinePcurve *pcurve = TMR_ConvertEgadsLoopPcurve(
+              faces[index], face_loops[i], k, native_curves[e],
+              native_range[2 * e], native_range[2 * e + 1]);
+          if (pcurve) {
+            pcurve->incref();
+            pcurve->decref();
+          } else {
+            native_curves[e]->decref();
+            native_curves[e] = NULL;
+          }
+        }
+      }
+    }
+  }
+
+  // Keep the faces with an edge that could not be converted
+  for (int index = 0; index < nfaces; index++) {
+    if (!native_surfs[index]) {
+      continue;
+    }
+
+    ego ref, *face_loops;
+    int oclass, mtype, num_loops, *loop_sense;
+    double data[4];
+    EG_getTopology(faces[index], &ref, &oclass, &mtype, data, &num_loops,
+                   &face_loops, &loop_sense);
+
+    for (int i = 0; i < num_loops && native_surfs[index]; i++) {
+      ego loop_ref, *loop_edges;
+      int loop_oclass, loop_mtype, num_edges, *edge_sense;
+      EG_getTopology(face_loops[i], &loop_ref, &loop_oclass, &loop_mtype,
+                     data, &num_edges, &loop_edges, &edge_sense);
+
+      for (int k = 0; k < num_edges; k++) {
+        if (!native_curves[edge_map[loop_edges[k]]]) {
+          native_surfs[index]->decref();
+          native_surfs[index] = NULL;
+          break;
+        }
+      }
+    }
+  }
+}
+
 /*
   Create the TMRModel by loading in an EGADS model file
 */
 TMRModel *TMR_EgadsInterface::TMR_LoadModelFromEGADSFile(const char *filename,
                                                          const char *units,
-                                                         int print_level) {
+                                                         int print_level,
+                                                         int convert_to_native) {
   // Create the common context for all egads objects
   TMR_EgadsContext *ctx = new TMR_EgadsContext();
 
@@ -394,14 +1071,16 @@ TMRModel *TMR_EgadsInterface::TMR_LoadModelFromEGADSFile(const char *filename,
     return NULL;
   }
 
-  return TMR_EgadsInterface::TMR_ConvertEGADSModel(model, print_level);
+  return TMR_EgadsInterface::TMR_ConvertEGADSModel(model, print_level,
+                                                   convert_to_native);
 }
 
 /*
   Create a TMR model from an EGADS model object
 */
 TMRModel *TMR_EgadsInterface::TMR_ConvertEGADSModel(ego model,
-                                                    int print_level) {
+                                                    int print_level,
+                                                    int convert_to_native) {
   ego context;
   EG_getContext(model, &context);
 
@@ -508,6 +1187,33 @@ TMRModel *TMR_EgadsInterface::TMR_ConvertEGADSModel(ego model,
         nverts, nedges, nfaces, nsolids);
   }
 
+  // Find the geometry that can be converted to native objects
+  TMRBsplineSurface **native_surfs = new TMRBsplineSurface *[nfaces];
+  TMRBsplineCurve **native_curves = new TMRBsplineCurve *[nedges];
+  double *native_range = new double[2 * nedges];
+  memset(native_surfs, 0, nfaces * sizeof(TMRBsplineSurface *));
+  memset(native_curves, 0, nedges * sizeof(TMRBsplineCurve *));
+  if (convert_to_native) {
+    TMR_ConvertEgadsToNative(nedges, edges, nfaces, faces, edge_map,
+                             native_surfs, native_curves, native_range);
+
+    if (print_level > 0) {
+      int nnative_edges = 0, nnative_faces = 0;
+      for (int i = 0; i < nedges; i++) {
+        if (native_curves[i]) {
+          nnative_edges++;
+        }
+      }
+      for (int i = 0; i < nfaces; i++) {
+        if (native_surfs[i]) {
+          nnative_faces++;
+        }
+      }
+      printf("Converted %d of %d edges and %d of %d faces to native\n",
+             nnative_edges, nedges, nnative_faces, nfaces);
+    }
+  }
+
   // Re-iterate through the list and create the objects needed to
   // define the geometry in TMR
   TMRVertex **all_vertices = new TMRVertex *[nverts];
@@ -550,8 +1256,14 @@ TMRModel *TMR_EgadsInterface::TMR_ConvertEGADSModel(ego model,
       idx2 = vert_map[children[1]];
     }
 
-    // Set a flag to indicate that the edge is degenerate
-    all_edges[index] = new TMR_EgadsEdge(ctx, edges[index], isdegenerate);
+    if (native_curves[index]) {
+      TMREdgeFromCurve *edge = new TMREdgeFromCurve(native_curves[index]);
+      edge->setRange(native_range[2 * index], native_range[2 * index + 1]);
+      all_edges[index] = edge;
+    } else {
+      // Set a flag to indicate that the edge is degenerate
+      all_edges[index] = new TMR_EgadsEdge(ctx, edges[index], isdegenerate);
+    }
 
     if ((idx1 >= 0 && idx1 < nverts) && (idx2 >= 0 && idx2 < nverts)) {
       all_edges[index]->setVertices(all_vertices[idx1], all_vertices[idx2]);
@@ -592,7 +1304,12 @@ TMRModel *TMR_EgadsInterface::TMR_ConvertEGADSModel(ego model,
       orientation = -1;
     }
 
-    all_faces[index] = new TMR_EgadsFace(ctx, orientation, faces[index]);
+    if (native_surfs[index]) {
+      all_faces[index] = new TMRFaceFromSurface(native_surfs[index],
+                                                orientation);
+    } else {
+      all_faces[index] = new TMR_EgadsFace(ctx, orientation, faces[index]);
+    }
 
     // Set the "name" attribute
     int atype, len;
@@ -623,6 +1340,19 @@ TMRModel *TMR_EgadsInterface::TMR_ConvertEGADSModel(ego model,
         dir[k] = edge_sense[k];
         int edge_index = edge_map[loop_edges[k]];
         edgs[k] = all_edges[edge_index];
+
+        // Attach the pcurve so that the edge parameters map directly
+        // to the parameters on this face
+        if (native_curves[edge_index]) {
+          TMREdgeFromCurve *edge =
+              dynamic_cast<TMREdgeFromCurve *>(all_edges[edge_index]);
+          TMRBsplinePcurve *pcurve = TMR_ConvertEgadsLoopPcurve(
+              faces[index], face_loops[i], k, native_curves[edge_index],
+              native_range[2 * edge_index], native_range[2 * edge_index + 1]);
+          if (edge && pcurve) {
+            edge->addPcurve(all_faces[index], edge_sense[k], pcurve);
+          }
+        }
       }
 
       // Allocate the loop with the given edges/directions
@@ -722,6 +1452,21 @@ TMRModel *TMR_EgadsInterface::TMR_ConvertEGADSModel(ego model,
   TMRModel *geo = new TMRModel(nverts, all_vertices, nedges, all_edges, nfaces,
                                all_faces, nsolids, all_vols);
 
+  // Free the native geometry, now owned by the edges and faces
+  for (int i = 0; i < nedges; i++) {
+    if (native_curves[i]) {
+      native_curves[i]->decref();
+    }
+  }
+  for (int i = 0; i < nfaces; i++) {
+    if (native_surfs[i]) {
+      native_surfs[i]->decref();
+    }
+  }
+  delete[] native_surfs;
+  delete[] native_curves;
+  delete[] native_range;
+
   // Free the arrays
   delete[] all_vertices;
   delete[] all_edges;
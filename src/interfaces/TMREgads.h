@@ -26,6 +26,11 @@
 /*
   Include the TMR files required
 */
+#include <pthread.h>
+
+#include "TMRBspline.h"
+#include "TMRFeatureSize.h"
+#include "TMRNativeTopology.h"
 #include "TMRTopology.h"
 #include "egads.h"
 
@@ -38,9 +43,53 @@ class TMR_EgadsContext : public TMREntity {
   ~TMR_EgadsContext();
   ego getContext();
 
+  // Get the tessellation of the body that contains the given face or
+  // edge. The tessellation is created once for each body and shared.
+  int getTessellation(ego obj, ego *body, ego *tess);
+
  private:
   int ismine;
   ego ctx;
+
+  // The tessellations created for each body
+  int num_tess, max_num_tess;
+  ego *tess_bodies;
+  ego *tess_objs;
+  pthread_mutex_t tess_mutex;
+};
+
+/*
+  The seed for the inverse evaluation on a face or edge
+
+  The points of the body tessellation that lie on the face or edge are
+  placed in a point locator, along with their parameter values. The
+  closest tessellation point, or the result of the last inverse
+  evaluation if it is closer, is used as the initial guess.
+*/
+class TMR_EgadsInvEvalSeed {
+ public:
+  TMR_EgadsInvEvalSeed();
+  ~TMR_EgadsInvEvalSeed();
+
+  // Set the tessellation points and their parameters
+  void initialize(int npts, const double *xyz, const double *prm, int nprm);
+
+  // Find the initial guess for the point and record the result
+  int getSeed(TMRPoint X, double *prm);
+  void setResult(const double *prm, const double *result);
+
+  // Has the seed been initialized
+  int initialized;
+
+ private:
+  int nprm;
+  TMRPointLocator *locator;
+  double *params;
+
+  // The last inverse evaluation result
+  int has_last;
+  TMRPoint last_result;
+  double last_prm[2];
 };
 
 /*
@@ -58,6 +107,7 @@ class TMR_EgadsNode : public TMRVertex {
   int getParamOnEdge(TMREdge *edge, double *t);
   int getParamsOnFace(TMRFace *face, double *u, double *v);
   int isSame(TMRVertex *v);
+  uint32_t getHashKey();
   void getNodeObject(ego *n);
 
  private:
@@ -76,13 +126,21 @@ class TMR_EgadsEdge : public TMREdge {
   int eval2ndDeriv(double t, TMRPoint *X, TMRPoint *Xt, TMRPoint *Xtt);
   int getParamsOnFace(TMRFace *face, double t, int dir, double *u, double *v);
   int isSame(TMREdge *e);
+  uint32_t getHashKey();
   int isDegenerate();
   void getEdgeObject(ego *e);
 
  private:
+  void initSeed();
+
   TMR_EgadsContext *ctx;
   ego edge;
   int is_degenerate;
+
+  // The tessellation-based seed for the inverse evaluation, created
+  // on first use and guarded by the mutex
+  TMR_EgadsInvEvalSeed seed;
+  pthread_mutex_t mutex;
 };
 
 class TMR_EgadsFace : public TMRFace {
@@ -96,19 +154,33 @@ class TMR_EgadsFace : public TMRFace {
   int eval2ndDeriv(double u, double v, TMRPoint *X, TMRPoint *Xu, TMRPoint *Xv,
                    TMRPoint *Xuu, TMRPoint *Xuv, TMRPoint *Xvv);
   int isSame(TMRFace *v);
+  uint32_t getHashKey();
   void getFaceObject(ego *f);
 
  private:
+  void initSeed();
+
   TMR_EgadsContext *ctx;
   ego face;
+
+  // The tessellation-based seed for the inverse evaluation, created
+  // on first use and guarded by the mutex
+  TMR_EgadsInvEvalSeed seed;
+  pthread_mutex_t mutex;
 };
 
 /*
   Initialization of the OpenCascade geometry from an IGES/STEP files
+
+  When convert_to_native is set, faces and edges whose geometry is a
+  plane, line or clamped B-spline are converted once to native TMR
+  B-spline objects. Any other geometry is kept as an EGADS object.
 */
 TMRModel *TMR_LoadModelFromEGADSFile(const char *filename, const char *units,
-                                     int print_level = 0);
-TMRModel *TMR_ConvertEGADSModel(ego model, int print_level = 0);
+                                     int print_level = 0,
+                                     int convert_to_native = 0);
+TMRModel *TMR_ConvertEGADSModel(ego model, int print_level = 0,
+                                int convert_to_native = 0);
 
 }  // namespace TMR_EgadsInterface
 
@@ -69,6 +69,12 @@ int TMR_OCCVertex::isSame(TMRVertex *vt) {
   return 0;
 }
 
+/*
+  The hash code combines the TShape and location, but not the
+  orientation, consistent with IsSame
+*/
+uint32_t TMR_OCCVertex::getHashKey() { return vert.HashCode(IntegerLast()); }
+
 void TMR_OCCVertex::getVertexObject(TopoDS_Vertex &v) { v = vert; }
 
 /*
@@ -78,9 +84,18 @@ TMR_OCCEdge::TMR_OCCEdge(TopoDS_Edge &e) {
   edge = e;
   reverse_edge = e;
   reverse_edge.Reverse();
+  curve_init = 0;
+  projection = NULL;
+  projection_fail = 0;
+  pthread_mutex_init(&mutex, NULL);
 }
 
-TMR_OCCEdge::~TMR_OCCEdge() {}
+TMR_OCCEdge::~TMR_OCCEdge() {
+  if (projection) {
+    delete projection;
+  }
+  pthread_mutex_destroy(&mutex);
+}
 
 void TMR_OCCEdge::getRange(double *tmin, double *tmax) {
   BRep_Tool::Range(edge, *tmin, *tmax);
@@ -120,36 +135,75 @@ int TMR_OCCEdge::getParamsOnFace(TMRFace *surface, double t, int dir, double *u,
   return TMREdge::getParamsOnFace(surface, t, dir, u, v);
 }
 
+/*
+  Initialize the curve adaptor on the first evaluation. Degenerate
+  edges may not have a curve and are never evaluated. The mutex must
+  be held.
+*/
+void TMR_OCCEdge::initCurve() {
+  if (!curve_init) {
+    curve.Initialize(edge);
+    curve_init = 1;
+  }
+}
+
 int TMR_OCCEdge::evalPoint(double t, TMRPoint *X) {
-  BRepAdaptor_Curve curve(edge);
   gp_Pnt p;
+  pthread_mutex_lock(&mutex);
+  initCurve();
   curve.D0(t, p);
+  pthread_mutex_unlock(&mutex);
   X->x = p.X();
   X->y = p.Y();
   X->z = p.Z();
   return 0;
 }
 
+/*
+  Project the point onto the edge. The projection is initialized for
+  the curve on the first call and re-used afterwards.
+*/
 int TMR_OCCEdge::invEvalPoint(TMRPoint X, double *t) {
   gp_Pnt pt(X.x, X.y, X.z);
-  double tmin, tmax;
-  getRange(&tmin, &tmax);
-  const Handle(Geom_Curve) curve = BRep_Tool::Curve(edge, tmin, tmax);
-  GeomAPI_ProjectPointOnCurve projection(pt, curve);
-  if (projection.NbPoints() == 0) {
-    return 1;
+  int fail = 0;
+
+  pthread_mutex_lock(&mutex);
+  if (!projection && !projection_fail) {
+    double tmin, tmax;
+    getRange(&tmin, &tmax);
+    const Handle(Geom_Curve) geom_curve = BRep_Tool::Curve(edge, tmin, tmax);
+    if (geom_curve.IsNull()) {
+      projection_fail = 1;
+    } else {
+      projection = new GeomAPI_ProjectPointOnCurve();
+      projection->Init(geom_curve, geom_curve->FirstParameter(),
+                       geom_curve->LastParameter());
+    }
+  }
+
+  if (projection) {
+    projection->Perform(pt);
+    if (projection->NbPoints() == 0) {
+      fail = 1;
+    } else {
+      *t = projection->LowerDistanceParameter();
+    }
   } else {
-    *t = projection.LowerDistanceParameter();
-    return 0;
+    fail = 1;
   }
+  pthread_mutex_unlock(&mutex);
+
+  return fail;
 }
 
 int TMR_OCCEdge::evalDeriv(double t, TMRPoint *X, TMRPoint *Xt) {
   int fail = 0;
   gp_Pnt p;
   gp_Vec pt;
-  BRepAdaptor_Curve curve(edge);
+  pthread_mutex_lock(&mutex);
+  initCurve();
   curve.D1(t, p, pt);
+  pthread_mutex_unlock(&mutex);
   X->x = p.X();
   X->y = p.Y();
   X->z = p.Z();
@@ -165,8 +219,10 @@ int TMR_OCCEdge::eval2ndDeriv(double t, TMRPoint *X, TMRPoint *Xt,
   int fail = 0;
   gp_Pnt p;
   gp_Vec pt, ptt;
-  BRepAdaptor_Curve curve(edge);
+  pthread_mutex_lock(&mutex);
+  initCurve();
   curve.D2(t, p, pt, ptt);
+  pthread_mutex_unlock(&mutex);
   X->x = p.X();
   X->y = p.Y();
   X->z = p.Z();
@@ -189,6 +245,12 @@ int TMR_OCCEdge::isSame(TMREdge *et) {
   return 0;
 }
 
+/*
+  The hash code combines the TShape and location, but not the
+  orientation, consistent with IsSame
+*/
+uint32_t TMR_OCCEdge::getHashKey() { return edge.HashCode(IntegerLast()); }
+
 int TMR_OCCEdge::isDegenerate() { return BRep_Tool::Degenerated(edge); }
 
 void TMR_OCCEdge::getEdgeObject(TopoDS_Edge &e) { e = edge; }
@@ -199,66 +261,209 @@ void TMR_OCCEdge::getEdgeObject(TopoDS_Edge &e) { e = edge; }
 TMR_OCCFace::TMR_OCCFace(int _normal_dir, TopoDS_Face &f)
     : TMRFace(_normal_dir) {
   face = f;
+  surf = BRep_Tool::Surface(face);
+  adaptor.Load(surf);
+  projection = NULL;
+  pthread_mutex_init(&mutex, NULL);
+  cache_size = 0;
+  cache = NULL;
 }
 
-TMR_OCCFace::~TMR_OCCFace() {}
+TMR_OCCFace::~TMR_OCCFace() {
+  if (projection) {
+    delete projection;
+  }
+  if (cache) {
+    delete[] cache;
+  }
+  pthread_mutex_destroy(&mutex);
+}
 
 void TMR_OCCFace::getRange(double *umin, double *vmin, double *umax,
                            double *vmax) {
   BRepTools::UVBounds(face, *umin, *umax, *vmin, *vmax);
 }
 
-int TMR_OCCFace::evalPoint(double u, double v, TMRPoint *X) {
-  const Handle(Geom_Surface) surf = BRep_Tool::Surface(face);
+/*
+  Set the number of evaluations stored in the cache. The size is
+  rounded up to a power of two. A size of zero removes the cache.
+
+  The cache only helps when the same parameter values are evaluated
+  repeatedly, for instance during projection-bound smoothing.
+*/
+void TMR_OCCFace::setEvalCacheSize(int size) {
+  int new_size = 0;
+  if (size > 0) {
+    new_size = 1;
+    while (new_size < size) {
+      new_size *= 2;
+    }
+  }
+
+  pthread_mutex_lock(&mutex);
+  if (cache) {
+    delete[] cache;
+    cache = NULL;
+  }
+  cache_size = new_size;
+  if (cache_size > 0) {
+    cache = new EvalCacheEntry[cache_size];
+    for (int i = 0; i < cache_size; i++) {
+      cache[i].has_deriv = -1;
+    }
+  }
+  pthread_mutex_unlock(&mutex);
+}
+
+/*
+  Evaluate the point, and the derivatives if Xu and Xv are not NULL,
+  using the cache if one is set. The mutex must be held.
+*/
+void TMR_OCCFace::evalCached(double u, double v, TMRPoint *X, TMRPoint *Xu,
+                             TMRPoint *Xv) {
+  EvalCacheEntry *entry = NULL;
+  if (cache) {
+    uint64_t a, b;
+    memcpy(&a, &u, sizeof(double));
+    memcpy(&b, &v, sizeof(double));
+    uint64_t key = (a ^ (b * 0x9e3779b97f4a7c15ULL)) * 0xbf58476d1ce4e5b9ULL;
+    entry = &cache[(key >> 32) & (cache_size - 1)];
+
+    if (entry->has_deriv >= 0 && entry->u == u && entry->v == v &&
+        (!Xu || entry->has_deriv)) {
+      *X = entry->X;
+      if (Xu) {
+        *Xu = entry->Xu;
+        *Xv = entry->Xv;
+      }
+      return;
+    }
+  }
+
   gp_Pnt p;
-  surf->D0(u, v, p);
+  gp_Vec pu, pv;
+  if (Xu) {
+    adaptor.D1(u, v, p, pu, pv);
+    Xu->x = pu.X();
+    Xu->y = pu.Y();
+    Xu->z = pu.Z();
+    Xv->x = pv.X();
+    Xv->y = pv.Y();
+    Xv->z = pv.Z();
+  } else {
+    adaptor.D0(u, v, p);
+  }
   X->x = p.X();
   X->y = p.Y();
   X->z = p.Z();
+
+  if (entry) {
+    entry->u = u;
+    entry->v = v;
+    entry->has_deriv = (Xu ? 1 : 0);
+    entry->X = *X;
+    if (Xu) {
+      entry->Xu = *Xu;
+      entry->Xv = *Xv;
+    }
+  }
+}
+
+/*
+  Get the projection onto the surface, creating it on the first
+  call. The mutex must be held.
+*/
+GeomAPI_ProjectPointOnSurf *TMR_OCCFace::getProjection() {
+  if (!projection) {
+    double umin, umax, vmin, vmax;
+    surf->Bounds(umin, umax, vmin, vmax);
+    projection = new GeomAPI_ProjectPointOnSurf();
+    projection->Init(surf, umin, umax, vmin, vmax);
+  }
+  return projection;
+}
+
+int TMR_OCCFace::evalPoint(double u, double v, TMRPoint *X) {
+  pthread_mutex_lock(&mutex);
+  evalCached(u, v, X, NULL, NULL);
+  pthread_mutex_unlock(&mutex);
   return 0;
 }
 
 int TMR_OCCFace::invEvalPoint(TMRPoint X, double *u, double *v) {
   gp_Pnt pt(X.x, X.y, X.z);
-  const Handle(Geom_Surface) surf = BRep_Tool::Surface(face);
-  GeomAPI_ProjectPointOnSurf projection(pt, surf);
-  if (projection.NbPoints() == 0) {
+  int fail = 0;
+
+  pthread_mutex_lock(&mutex);
+  GeomAPI_ProjectPointOnSurf *proj = getProjection();
+  proj->Perform(pt);
+  if (proj->NbPoints() == 0) {
     *u = *v = 0.0;
-    return 1;
+    fail = 1;
   } else {
-    projection.LowerDistanceParameters(*u, *v);
+    proj->LowerDistanceParameters(*u, *v);
+  }
+  pthread_mutex_unlock(&mutex);
+
+  return fail;
+}
+
+/*
+  Evaluate an array of points, acquiring the lock only once
+*/
+int TMR_OCCFace::evalPoints(int n, const double *prm, TMRPoint *X) {
+  pthread_mutex_lock(&mutex);
+  for (int i = 0; i < n; i++) {
+    evalCached(prm[2 * i], prm[2 * i + 1], &X[i], NULL, NULL);
+  }
+  pthread_mutex_unlock(&mutex);
+  return 0;
+}
+
+/*
+  Project an array of points onto the surface, acquiring the lock
+  only once
+*/
+int TMR_OCCFace::invEvalPoints(int n, const TMRPoint *X, double *prm) {
+  if (n <= 0) {
     return 0;
   }
+
+  int fail = 0;
+  pthread_mutex_lock(&mutex);
+  GeomAPI_ProjectPointOnSurf *proj = getProjection();
+  for (int i = 0; i < n; i++) {
+    gp_Pnt pt(X[i].x, X[i].y, X[i].z);
+    proj->Perform(pt);
+    if (proj->NbPoints() == 0) {
+      prm[2 * i] = prm[2 * i + 1] = 0.0;
+      fail = 1;
+    } else {
+      proj->LowerDistanceParameters(prm[2 * i], prm[2 * i + 1]);
+    }
+  }
+  pthread_mutex_unlock(&mutex);
+
+  return fail;
 }
 
 int TMR_OCCFace::evalDeriv(double u, double v, TMRPoint *X, TMRPoint *Xu,
                            TMRPoint *Xv) {
-  const Handle(Geom_Surface) surf = BRep_Tool::Surface(face);
-  gp_Pnt p;
-  gp_Vec pu, pv;
-  surf->D1(u, v, p, pu, pv);
-  X->x = p.X();
-  X->y = p.Y();
-  X->z = p.Z();
-
-  Xu->x = pu.X();
-  Xu->y = pu.Y();
-  Xu->z = pu.Z();
-
-  Xv->x = pv.X();
-  Xv->y = pv.Y();
-  Xv->z = pv.Z();
+  pthread_mutex_lock(&mutex);
+  evalCached(u, v, X, Xu, Xv);
+  pthread_mutex_unlock(&mutex);
   return 0;
 }
 
 int TMR_OCCFace::eval2ndDeriv(double u, double v, TMRPoint *X, TMRPoint *Xu,
                               TMRPoint *Xv, TMRPoint *Xuu, TMRPoint *Xuv,
                               TMRPoint *Xvv) {
-  const Handle(Geom_Surface) surf = BRep_Tool::Surface(face);
   gp_Pnt p;
   gp_Vec pu, pv;
   gp_Vec puu, puv, pvv;
-  surf->D2(u, v, p, pu, pv, puu, pvv, puv);
+  pthread_mutex_lock(&mutex);
+  adaptor.D2(u, v, p, pu, pv, puu, pvv, puv);
+  pthread_mutex_unlock(&mutex);
   X->x = p.X();
   X->y = p.Y();
   X->z = p.Z();
@@ -293,6 +498,12 @@ int TMR_OCCFace::isSame(TMRFace *ft) {
   return 0;
 }
 
+/*
+  The hash code combines the TShape and location, but not the
+  orientation, consistent with IsSame
+*/
+uint32_t TMR_OCCFace::getHashKey() { return face.HashCode(IntegerLast()); }
+
 void TMR_OCCFace::getFaceObject(TopoDS_Face &f) { f = face; }
 
 /*
@@ -749,7 +960,7 @@ void TMR_FixCompound(TopoDS_Compound &compound, int print_level, double tol) {
   Create the TMRModel based on the IGES input file
 */
 TMRModel *TMR_LoadModelFromIGESFile(const char *filename, const char *units,
-                                    int print_level) {
+                                    int print_level, int convert_to_native) {
   FILE *fp = fopen(filename, "r");
   if (!fp) {
     return NULL;
@@ -789,14 +1000,14 @@ TMRModel *TMR_LoadModelFromIGESFile(const char *filename, const char *units,
 
   // TMR_RemoveFloatingShapes(compound, TopAbs_FACE);
 
-  return TMR_LoadModelFromCompound(compound, print_level);
+  return TMR_LoadModelFromCompound(compound, print_level, convert_to_native);
 }
 
 /*
   Create the TMRModel based on the STEP input file
 */
 TMRModel *TMR_LoadModelFromSTEPFile(const char *filename, const char *units,
-                                    int print_level) {
+                                    int print_level, int convert_to_native) {
   FILE *fp = fopen(filename, "r");
   if (!fp) {
     return NULL;
@@ -836,14 +1047,574 @@ TMRModel *TMR_LoadModelFromSTEPFile(const char *filename, const char *units,
 
   TMR_RemoveFloatingShapes(compound, TopAbs_EDGE);
 
-  return TMR_LoadModelFromCompound(compound, print_level);
+  return TMR_LoadModelFromCompound(compound, print_level, convert_to_native);
+}
+
+/*
+  Read the STEP file into a compound. Returns 0 on success.
+*/
+static int TMR_ReadSTEPCompound(const char *filename, const char *units,
+                                TopoDS_Compound &compound) {
+  STEPControl_Reader reader;
+  Interface_Static::SetCVal("xstep.cascade.unit", units);
+  IFSelect_ReturnStatus status = reader.ReadFile(filename);
+  if (status != IFSelect_RetDone) {
+    fprintf(stderr, "TMR Warning: STEP file reader failed\n");
+    return 1;
+  }
+
+  // The number of root objects for transfer
+  int nroots = reader.NbRootsForTransfer();
+  for (int k = 1; k <= nroots; k++) {
+    Standard_Boolean ok = reader.TransferRoot(k);
+    if (!ok) {
+      fprintf(stderr, "TMR Warning: Transfer %d not OK!\n", k);
+    }
+  }
+
+  // Build the shape
+  int nbs = reader.NbShapes();
+  BRep_Builder builder;
+  builder.MakeCompound(compound);
+  for (int i = 1; i <= nbs; i++) {
+    TopoDS_Shape shape = reader.Shape(i);
+    builder.Add(compound, shape);
+  }
+
+  TMR_RemoveFloatingShapes(compound, TopAbs_EDGE);
+
+  return 0;
+}
+
+/*
+  Compute the 64-bit FNV-1a hash of the file contents combined with
+  the units and sew tolerance. Returns 0 on success.
+*/
+static int TMR_HashSTEPFile(const char *filename, const char *units,
+                            double sew_tol, uint64_t *hash) {
+  FILE *fp = fopen(filename, "rb");
+  if (!fp) {
+    return 1;
+  }
+
+  const uint64_t prime = 1099511628211ULL;
+  uint64_t h = 14695981039346656037ULL;
+
+  unsigned char buffer[65536];
+  size_t len = 0;
+  while ((len = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+    for (size_t i = 0; i < len; i++) {
+      h = (h ^ buffer[i]) * prime;
+    }
+  }
+  fclose(fp);
+
+  for (const char *c = units; c && *c; c++) {
+    h = (h ^ (unsigned char)(*c)) * prime;
+  }
+  const unsigned char *tol = (const unsigned char *)&sew_tol;
+  for (size_t i = 0; i < sizeof(double); i++) {
+    h = (h ^ tol[i]) * prime;
+  }
+
+  *hash = h;
+  return 0;
+}
+
+/*
+  Read the entire contents of a file into a string. Returns 0 on
+  success.
+*/
+static int TMR_ReadFileContents(const char *filename, std::string &data) {
+  FILE *fp = fopen(filename, "rb");
+  if (!fp) {
+    return 1;
+  }
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  if (size < 0) {
+    fclose(fp);
+    return 1;
+  }
+  data.resize(size);
+  size_t nread = 0;
+  if (size > 0) {
+    nread = fread(&data[0], 1, size, fp);
+  }
+  fclose(fp);
+
+  return (nread != (size_t)size);
+}
+
+/*
+  Load the STEP file on the root processor and broadcast the healed
+  topology to all processors
+*/
+TMRModel *TMR_LoadModelFromSTEPFile(MPI_Comm comm, const char *filename,
+                                    const char *units, double sew_tol,
+                                    const char *cache_dir, int print_level,
+                                    int convert_to_native) {
+  int mpi_rank;
+  MPI_Comm_rank(comm, &mpi_rank);
+
+  // The BREP representation of the healed compound
+  std::string data;
+  int64_t size = -1;
+
+  if (mpi_rank == 0) {
+    // Find the name of the cache file, if any
+    char cache_file[1024];
+    cache_file[0] = '\0';
+    uint64_t hash = 0;
+    if (cache_dir && TMR_HashSTEPFile(filename, units, sew_tol, &hash) == 0) {
+      const char *base = strrchr(filename, '/');
+      base = (base ? base + 1 : filename);
+      snprintf(cache_file, sizeof(cache_file), "%s/%s.%016llx.brep",
+               cache_dir, base, (unsigned long long)hash);
+    }
+
+    if (cache_file[0] != '\0' && TMR_ReadFileContents(cache_file, data) == 0) {
+      size = data.size();
+      if (print_level > 0) {
+        printf("Loaded healed STEP model from cache %s\n", cache_file);
+      }
+    } else {
+      TopoDS_Compound compound;
+      FILE *fp = fopen(filename, "r");
+      if (fp) {
+        fclose(fp);
+        if (TMR_ReadSTEPCompound(filename, units, compound) == 0) {
+          if (sew_tol > 0.0) {
+            TMR_SewCompound(compound, print_level, sew_tol, false);
+            TMR_FixCompound(compound, print_level, sew_tol);
+          }
+
+          std::ostringstream out;
+          BRepTools::Write(compound, out);
+          data = out.str();
+          size = data.size();
+        }
+      }
+
+      // Write the cache to a temporary file first so that a partial
+      // file is never read by another run
+      if (size >= 0 && cache_file[0] != '\0') {
+        char tmp_file[1040];
+        snprintf(tmp_file, sizeof(tmp_file), "%s.tmp", cache_file);
+        FILE *cache = fopen(tmp_file, "wb");
+        if (cache) {
+          size_t nwritten = fwrite(data.data(), 1, data.size(), cache);
+          fclose(cache);
+          if (nwritten == data.size()) {
+            rename(tmp_file, cache_file);
+          } else {
+            remove(tmp_file);
+          }
+        } else if (print_level > 0) {
+          fprintf(stderr, "TMR Warning: Unable to write cache file %s\n",
+                  cache_file);
+        }
+      }
+    }
+  }
+
+  // Broadcast the byte stream in chunks that fit in an int count
+  MPI_Bcast(&size, 1, MPI_INT64_T, 0, comm);
+  if (size < 0) {
+    return NULL;
+  }
+  if (mpi_rank != 0) {
+    data.resize(size);
+  }
+  const int64_t max_chunk = 1 << 30;
+  for (int64_t offset = 0; offset < size; offset += max_chunk) {
+    int64_t chunk = size - offset;
+    if (chunk > max_chunk) {
+      chunk = max_chunk;
+    }
+    MPI_Bcast(&data[offset], (int)chunk, MPI_CHAR, 0, comm);
+  }
+
+  // Rebuild the compound on all processors
+  TopoDS_Shape shape;
+  BRep_Builder builder;
+  std::istringstream in(data);
+  BRepTools::Read(shape, in, builder);
+  data.clear();
+
+  TopoDS_Compound compound;
+  if (!shape.IsNull() && shape.ShapeType() == TopAbs_COMPOUND) {
+    compound = TopoDS::Compound(shape);
+  } else {
+    builder.MakeCompound(compound);
+    if (!shape.IsNull()) {
+      builder.Add(compound, shape);
+    }
+  }
+
+  return TMR_LoadModelFromCompound(compound, print_level, convert_to_native);
+}
+
+/*
+  The maximum B-spline order that can be converted to a native object.
+  This matches the maximum order in TMRBspline.
+*/
+static const int TMR_MAX_NATIVE_ORDER = 6;
+
+/*
+  Check that the knot vector is clamped at both ends
+*/
+static int TMR_IsClampedKnots(int n, int k, const double *Tu) {
+  for (int i = 1; i < k; i++) {
+    if (Tu[i] != Tu[0] || Tu[n + k - 1 - i] != Tu[n + k - 1]) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/*
+  Convert the curve to a TMRBsplineCurve with the same parametrization.
+  Lines are converted over the range [t0, t1]. Returns NULL when the
+  curve cannot be represented exactly.
+*/
+static TMRBsplineCurve *TMR_ConvertCurveToNative(Handle(Geom_Curve) curve,
+                                                 double t0, double t1) {
+  // Trimming does not change the parametrization
+  while (curve->IsKind(STANDARD_TYPE(Geom_TrimmedCurve))) {
+    curve = Handle(Geom_TrimmedCurve)::DownCast(curve)->BasisCurve();
+  }
+
+  if (curve->IsKind(STANDARD_TYPE(Geom_Line))) {
+    gp_Pnt p0 = curve->Value(t0);
+    gp_Pnt p1 = curve->Value(t1);
+    double Tu[4] = {t0, t0, t1, t1};
+    TMRPoint pts[2];
+    pts[0].x = p0.X();
+    pts[0].y = p0.Y();
+    pts[0].z = p0.Z();
+    pts[1].x = p1.X();
+    pts[1].y = p1.Y();
+    pts[1].z = p1.Z();
+    return new TMRBsplineCurve(2, 2, Tu, pts);
+  }
+
+  Handle(Geom_BSplineCurve) bspline;
+  if (curve->IsKind(STANDARD_TYPE(Geom_BezierCurve))) {
+    bspline = GeomConvert::CurveToBSplineCurve(curve);
+  } else if (curve->IsKind(STANDARD_TYPE(Geom_BSplineCurve))) {
+    bspline = Handle(Geom_BSplineCurve)::DownCast(curve);
+    if (bspline->IsPeriodic()) {
+      bspline = Handle(Geom_BSplineCurve)::DownCast(bspline->Copy());
+      bspline->SetNotPeriodic();
+    }
+  }
+  if (bspline.IsNull()) {
+    return NULL;
+  }
+
+  int n = bspline->NbPoles();
+  int k = bspline->Degree() + 1;
+  if (k > TMR_MAX_NATIVE_ORDER) {
+    return NULL;
+  }
+
+  TColStd_Array1OfReal knots(1, n + k);
+  bspline->KnotSequence(knots);
+  double *Tu = new double[n + k];
+  for (int i = 0; i < n + k; i++) {
+    Tu[i] = knots(i + 1);
+  }
+
+  TMRBsplineCurve *native = NULL;
+  if (TMR_IsClampedKnots(n, k, Tu)) {
+    TMRPoint *pts = new TMRPoint[n];
+    double *wts = new double[n];
+    for (int i = 0; i < n; i++) {
+      gp_Pnt p = bspline->Pole(i + 1);
+      pts[i].x = p.X();
+      pts[i].y = p.Y();
+      pts[i].z = p.Z();
+      wts[i] = bspline->Weight(i + 1);
+    }
+    if (bspline->IsRational()) {
+      native = new TMRBsplineCurve(n, k, Tu, wts, pts);
+    } else {
+      native = new TMRBsplineCurve(n, k, Tu, pts);
+    }
+    delete[] pts;
+    delete[] wts;
+  }
+  delete[] Tu;
+
+  return native;
+}
+
+/*
+  Convert the parametric curve of the oriented edge on the face to a
+  TMRBsplinePcurve with the same parametrization
+*/
+static TMRBsplinePcurve *TMR_ConvertPcurveToNative(TopoDS_Edge &edge,
+                                                   TopoDS_Face &face) {
+  double t0, t1;
+  Handle(Geom2d_Curve) curve = BRep_Tool::CurveOnSurface(edge, face, t0, t1);
+  if (curve.IsNull()) {
+    return NULL;
+  }
+
+  while (curve->IsKind(STANDARD_TYPE(Geom2d_TrimmedCurve))) {
+    curve = Handle(Geom2d_TrimmedCurve)::DownCast(curve)->BasisCurve();
+  }
+
+  if (curve->IsKind(STANDARD_TYPE(Geom2d_Line))) {
+    gp_Pnt2d p0 = curve->Value(t0);
+    gp_Pnt2d p1 = curve->Value(t1);
+    double Tu[4] = {t0, t0, t1, t1};
+    double pts[4] = {p0.X(), p0.Y(), p1.X(), p1.Y()};
+    return new TMRBsplinePcurve(2, 2, Tu, pts);
+  }
+
+  Handle(Geom2d_BSplineCurve) bspline;
+  if (curve->IsKind(STANDARD_TYPE(Geom2d_BezierCurve))) {
+    bspline = Geom2dConvert::CurveToBSplineCurve(curve);
+  } else if (curve->IsKind(STANDARD_TYPE(Geom2d_BSplineCurve))) {
+    bspline = Handle(Geom2d_BSplineCurve)::DownCast(curve);
+    if (bspline->IsPeriodic()) {
+      bspline = Handle(Geom2d_BSplineCurve)::DownCast(bspline->Copy());
+      bspline->SetNotPeriodic();
+    }
+  }
+  if (bspline.IsNull()) {
+    return NULL;
+  }
+
+  int n = bspline->NbPoles();
+  int k = bspline->Degree() + 1;
+  if (k > TMR_MAX_NATIVE_ORDER) {
+    return NULL;
+  }
+
+  TColStd_Array1OfReal knots(1, n + k);
+  bspline->KnotSequence(knots);
+  double *Tu = new double[n + k];
+  for (int i = 0; i < n + k; i++) {
+    Tu[i] = knots(i + 1);
+  }
+
+  TMRBsplinePcurve *native = NULL;
+  if (TMR_IsClampedKnots(n, k, Tu)) {
+    double *pts = new double[2 * n];
+    double *wts = new double[n];
+    for (int i = 0; i < n; i++) {
+      gp_Pnt2d p = bspline->Pole(i + 1);
+      pts[2 * i] = p.X();
+      pts[2 * i + 1] = p.Y();
+      wts[i] = bspline->Weight(i + 1);
+    }
+    if (bspline->IsRational()) {
+      native = new TMRBsplinePcurve(n, k, Tu, wts, pts);
+    } else {
+      native = new TMRBsplinePcurve(n, k, Tu, pts);
+    }
+    delete[] pts;
+    delete[] wts;
+  }
+  delete[] Tu;
+
+  return native;
+}
+
+/*
+  Convert the surface of the face to a TMRBsplineSurface with the same
+  parametrization. Planes are converted over the parameter bounds of
+  the face.
+*/
+static TMRBsplineSurface *TMR_ConvertSurfaceToNative(TopoDS_Face &face) {
+  Handle(Geom_Surface) surf = BRep_Tool::Surface(face);
+  while (surf->IsKind(STANDARD_TYPE(Geom_RectangularTrimmedSurface))) {
+    surf =
+        Handle(Geom_RectangularTrimmedSurface)::DownCast(surf)->BasisSurface();
+  }
+
+  if (surf->IsKind(STANDARD_TYPE(Geom_Plane))) {
+    double umin, umax, vmin, vmax;
+    BRepTools::UVBounds(face, umin, umax, vmin, vmax);
+    double Tu[4] = {umin, umin, umax, umax};
+    double Tv[4] = {vmin, vmin, vmax, vmax};
+    TMRPoint pts[4];
+    for (int j = 0; j < 2; j++) {
+      for (int i = 0; i < 2; i++) {
+        gp_Pnt p = surf->Value(Tu[2 * i], Tv[2 * j]);
+        pts[i + 2 * j].x = p.X();
+        pts[i + 2 * j].y = p.Y();
+        pts[i + 2 * j].z = p.Z();
+      }
+    }
+    return new TMRBsplineSurface(2, 2, 2, 2, Tu, Tv, pts);
+  }
+
+  Handle(Geom_BSplineSurface) bspline;
+  if (surf->IsKind(STANDARD_TYPE(Geom_BezierSurface))) {
+    bspline = GeomConvert::SurfaceToBSplineSurface(surf);
+  } else if (surf->IsKind(STANDARD_TYPE(Geom_BSplineSurface))) {
+    bspline = Handle(Geom_BSplineSurface)::DownCast(surf);
+    if (bspline->IsUPeriodic() || bspline->IsVPeriodic()) {
+      bspline = Handle(Geom_BSplineSurface)::DownCast(bspline->Copy());
+      if (bspline->IsUPeriodic()) {
+        bspline->SetUNotPeriodic();
+      }
+      if (bspline->IsVPeriodic()) {
+        bspline->SetVNotPeriodic();
+      }
+    }
+  }
+  if (bspline.IsNull()) {
+    return NULL;
+  }
+
+  int nu = bspline->NbUPoles();
+  int nv = bspline->NbVPoles();
+  int ku = bspline->UDegree() + 1;
+  int kv = bspline->VDegree() + 1;
+  if (ku > TMR_MAX_NATIVE_ORDER || kv > TMR_MAX_NATIVE_ORDER) {
+    return NULL;
+  }
+
+  TColStd_Array1OfReal uknots(1, nu + ku);
+  TColStd_Array1OfReal vknots(1, nv + kv);
+  bspline->UKnotSequence(uknots);
+  bspline->VKnotSequence(vknots);
+  double *Tu = new double[nu + ku];
+  double *Tv = new double[nv + kv];
+  for (int i = 0; i < nu + ku; i++) {
+    Tu[i] = uknots(i + 1);
+  }
+  for (int j = 0; j < nv + kv; j++) {
+    Tv[j] = vknots(j + 1);
+  }
+
+  TMRBsplineSurface *native = NULL;
+  if (TMR_IsClampedKnots(nu, ku, Tu) && TMR_IsClampedKnots(nv, kv, Tv)) {
+    TMRPoint *pts = new TMRPoint[nu * nv];
+    double *wts = new double[nu * nv];
+    for (int j = 0; j < nv; j++) {
+      for (int i = 0; i < nu; i++) {
+        gp_Pnt p = bspline->Pole(i + 1, j + 1);
+        pts[i + nu * j].x = p.X();
+        pts[i + nu * j].y = p.Y();
+        pts[i + nu * j].z = p.Z();
+        wts[i + nu * j] = bspline->Weight(i + 1, j + 1);
+      }
+    }
+    if (bspline->IsURational() || bspline->IsVRational()) {
+      native = new TMRBsplineSurface(nu, nv, ku, kv, Tu, Tv, wts, pts);
+    } else {
+      native = new TMRBsplineSurface(nu, nv, ku, kv, Tu, Tv, pts);
+    }
+    delete[] pts;
+    delete[] wts;
+  }
+  delete[] Tu;
+  delete[] Tv;
+
+  return native;
+}
+
+/*
+  Find the faces and edges of the compound that can be converted to
+  native objects. Edges are converted when the curve and the pcurves on
+  all of the adjacent faces can be converted. Faces are converted when
+  the surface and all of their edges can be converted, so that the
+  parameters of the edges on native faces always come from a pcurve.
+*/
+static void TMR_ConvertToNative(
+    TopTools_IndexedMapOfShape &edges, TopTools_IndexedMapOfShape &faces,
+    TopTools_IndexedDataMapOfShapeListOfShape &edge_faces,
+    TMRBsplineSurface **native_surfs, TMREdgeFromCurve **native_edges) {
+  int nedges = edges.Extent();
+  int nfaces = faces.Extent();
+
+  for (int index = 1; index <= nfaces; index++) {
+    TopoDS_Face face = TopoDS::Face(faces(index));
+    native_surfs[index - 1] = TMR_ConvertSurfaceToNative(face);
+    if (native_surfs[index - 1]) {
+      native_surfs[index - 1]->incref();
+    }
+  }
+
+  for (int index = 1; index <= nedges; index++) {
+    native_edges[index - 1] = NULL;
+
+    TopoDS_Edge e = TopoDS::Edge(edges(index).Oriented(TopAbs_FORWARD));
+    TopoDS_Edge re = TopoDS::Edge(edges(index).Oriented(TopAbs_REVERSED));
+    if (BRep_Tool::Degenerated(e)) {
+      continue;
+    }
+
+    double t0, t1;
+    Handle(Geom_Curve) curve = BRep_Tool::Curve(e, t0, t1);
+    if (curve.IsNull()) {
+      continue;
+    }
+    TMRBsplineCurve *native = TMR_ConvertCurveToNative(curve, t0, t1);
+    if (!native) {
+      continue;
+    }
+    native->incref();
+
+    // Check that all of the pcurves can be converted
+    int fail = 0;
+    TopTools_ListOfShape list;
+    if (edge_faces.Contains(e)) {
+      list = edge_faces.FindFromKey(e);
+    }
+    TopTools_ListIteratorOfListOfShape it(list);
+    for (; it.More() && !fail; it.Next()) {
+      TopoDS_Face face = TopoDS::Face(faces(faces.FindIndex(it.Value())));
+      for (int k = 0; k < 2 && !fail; k++) {
+        TMRBsplinePcurve *pcurve =
+            TMR_ConvertPcurveToNative((k == 0 ? e : re), face);
+        if (pcurve) {
+          pcurve->incref();
+          pcurve->decref();
+        } else {
+          fail = 1;
+        }
+      }
+    }
+
+    if (!fail) {
+      BRep_Tool::Range(e, t0, t1);
+      native_edges[index - 1] = new TMREdgeFromCurve(native);
+      native_edges[index - 1]->setRange(t0, t1);
+    }
+    native->decref();
+  }
+
+  // Keep the faces with an edge that could not be converted
+  for (int index = 1; index <= nfaces; index++) {
+    if (!native_surfs[index - 1]) {
+      continue;
+    }
+
+    TopExp_Explorer Exp(faces(index), TopAbs_EDGE);
+    for (; Exp.More(); Exp.Next()) {
+      int edge_index = edges.FindIndex(Exp.Current());
+      if (!native_edges[edge_index - 1]) {
+        native_surfs[index - 1]->decref();
+        native_surfs[index - 1] = NULL;
+        break;
+      }
+    }
+  }
 }
 
 /*
   Create the TMRModel based on the TopoDS_Compound object
 */
 TMRModel *TMR_LoadModelFromCompound(TopoDS_Compound &compound,
-                                    int print_level) {
+                                    int print_level, int convert_to_native) {
   // Create the index <--> geometry object
   TopTools_IndexedMapOfShape verts, edges, faces, wires, shells, solids;
 
@@ -909,11 +1680,39 @@ TMRModel *TMR_LoadModelFromCompound(TopoDS_Compound &compound,
     all_vertices[index - 1] = new TMR_OCCVertex(v);
   }
 
+  // Convert the geometry to native objects where possible
+  TMRBsplineSurface **native_surfs = NULL;
+  TMREdgeFromCurve **native_edges = NULL;
+  TopTools_IndexedDataMapOfShapeListOfShape edge_faces;
+  if (convert_to_native) {
+    TopExp::MapShapesAndAncestors(compound, TopAbs_EDGE, TopAbs_FACE,
+                                  edge_faces);
+    native_surfs = new TMRBsplineSurface *[nfaces];
+    native_edges = new TMREdgeFromCurve *[nedges];
+    TMR_ConvertToNative(edges, faces, edge_faces, native_surfs, native_edges);
+
+    if (print_level > 0) {
+      int nnative_edges = 0, nnative_faces = 0;
+      for (int i = 0; i < nedges; i++) {
+        nnative_edges += (native_edges[i] ? 1 : 0);
+      }
+      for (int i = 0; i < nfaces; i++) {
+        nnative_faces += (native_surfs[i] ? 1 : 0);
+      }
+      printf("Converted %d of %d edges and %d of %d faces to native\n",
+             nnative_edges, nedges, nnative_faces, nfaces);
+    }
+  }
+
   TMREdge **all_edges = new TMREdge *[nedges];
   memset(all_edges, 0, nedges * sizeof(TMREdge *));
   for (int index = 1; index <= edges.Extent(); index++) {
     TopoDS_Edge e = TopoDS::Edge(edges(index).Oriented(TopAbs_FORWARD));
-    all_edges[index - 1] = new TMR_OCCEdge(e);
+    if (native_edges && native_edges[index - 1]) {
+      all_edges[index - 1] = native_edges[index - 1];
+    } else {
+      all_edges[index - 1] = new TMR_OCCEdge(e);
+    }
 
     // Set the vertices belonging to this edge
     TopoDS_Vertex v1, v2;
@@ -937,7 +1736,12 @@ TMRModel *TMR_LoadModelFromCompound(TopoDS_Compound &compound,
     if (face.Orientation() == TopAbs_REVERSED) {
       orient = -1;
     }
-    all_faces[index - 1] = new TMR_OCCFace(orient, face);
+    if (native_surfs && native_surfs[index - 1]) {
+      all_faces[index - 1] =
+          new TMRFaceFromSurface(native_surfs[index - 1], orient);
+    } else {
+      all_faces[index - 1] = new TMR_OCCFace(orient, face);
+    }
 
     // Find the wires connected to the face
     TopTools_IndexedMapOfShape wire_map;
@@ -978,6 +1782,43 @@ TMRModel *TMR_LoadModelFromCompound(TopoDS_Compound &compound,
     }
   }
 
+  // Set the pcurves of the native edges now that the faces exist
+  if (convert_to_native) {
+    for (int index = 1; index <= nedges; index++) {
+      TMREdgeFromCurve *edge = native_edges[index - 1];
+      if (!edge) {
+        continue;
+      }
+
+      TopoDS_Edge e = TopoDS::Edge(edges(index).Oriented(TopAbs_FORWARD));
+      TopoDS_Edge re = TopoDS::Edge(edges(index).Oriented(TopAbs_REVERSED));
+      if (!edge_faces.Contains(e)) {
+        continue;
+      }
+      const TopTools_ListOfShape &list = edge_faces.FindFromKey(e);
+      TopTools_MapOfShape visited;
+      for (TopTools_ListIteratorOfListOfShape it(list); it.More(); it.Next()) {
+        if (!visited.Add(it.Value())) {
+          continue;
+        }
+        int face_index = faces.FindIndex(it.Value());
+        TopoDS_Face face = TopoDS::Face(faces(face_index));
+        edge->addPcurve(all_faces[face_index - 1], 1,
+                        TMR_ConvertPcurveToNative(e, face));
+        edge->addPcurve(all_faces[face_index - 1], -1,
+                        TMR_ConvertPcurveToNative(re, face));
+      }
+    }
+
+    for (int i = 0; i < nfaces; i++) {
+      if (native_surfs[i]) {
+        native_surfs[i]->decref();
+      }
+    }
+    delete[] native_surfs;
+    delete[] native_edges;
+  }
+
   // Create the volumes
   TMRVolume **all_vols = new TMRVolume *[nsolids];
   memset(all_vols, 0, nsolids * sizeof(TMRVolume *));
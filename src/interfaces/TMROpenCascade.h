@@ -26,7 +26,13 @@
 /*
   Include the TMR files required
 */
+#include <pthread.h>
+
+#include <sstream>
+
+#include "TMRBspline.h"
 #include "TMRGeometry.h"
+#include "TMRNativeTopology.h"
 #include "TMRTopology.h"
 
 /*
@@ -70,17 +76,32 @@
 #include <GProp_GProps.hxx>
 #include <Geom2dAPI_ProjectPointOnCurve.hxx>
 #include <Geom2dAdaptor_HCurve.hxx>
+#include <Geom2dConvert.hxx>
+#include <Geom2d_BSplineCurve.hxx>
+#include <Geom2d_BezierCurve.hxx>
 #include <Geom2d_Curve.hxx>
+#include <Geom2d_Line.hxx>
+#include <Geom2d_TrimmedCurve.hxx>
 #include <GeomAPI_PointsToBSpline.hxx>
 #include <GeomAPI_PointsToBSplineSurface.hxx>
 #include <GeomAPI_ProjectPointOnCurve.hxx>
 #include <GeomAPI_ProjectPointOnSurf.hxx>
 #include <GeomAdaptor_Curve.hxx>
 #include <GeomAdaptor_HSurface.hxx>
+#include <GeomAdaptor_Surface.hxx>
+#include <GeomConvert.hxx>
 #include <GeomLib.hxx>
 #include <GeomProjLib.hxx>
+#include <Geom_BSplineCurve.hxx>
+#include <Geom_BSplineSurface.hxx>
+#include <Geom_BezierCurve.hxx>
+#include <Geom_BezierSurface.hxx>
 #include <Geom_Curve.hxx>
+#include <Geom_Line.hxx>
+#include <Geom_Plane.hxx>
+#include <Geom_RectangularTrimmedSurface.hxx>
 #include <Geom_Surface.hxx>
+#include <Geom_TrimmedCurve.hxx>
 #include <IGESControl_Controller.hxx>
 #include <IGESControl_Reader.hxx>
 #include <IGESControl_Writer.hxx>
@@ -102,11 +123,15 @@
 #include <Standard_Real.hxx>
 #include <Standard_Type.hxx>
 #include <Standard_Version.hxx>
+#include <TColStd_Array1OfReal.hxx>
 #include <TopAbs.hxx>
 #include <TopExp.hxx>
 #include <TopExp_Explorer.hxx>
 #include <TopLoc_Location.hxx>
 #include <TopTools.hxx>
+#include <TopTools_IndexedDataMapOfShapeListOfShape.hxx>
+#include <TopTools_ListIteratorOfListOfShape.hxx>
+#include <TopTools_MapOfShape.hxx>
 #include <TopoDS.hxx>
 #include <TopoDS_Compound.hxx>
 #include <TopoDS_Edge.hxx>
@@ -130,6 +155,7 @@ class TMR_OCCVertex : public TMRVertex {
   int getParamOnEdge(TMREdge *edge, double *t);
   int getParamsOnFace(TMRFace *face, double *u, double *v);
   int isSame(TMRVertex *v);
+  uint32_t getHashKey();
   void getVertexObject(TopoDS_Vertex &v);
 
  private:
@@ -147,12 +173,24 @@ class TMR_OCCEdge : public TMREdge {
   int eval2ndDeriv(double t, TMRPoint *X, TMRPoint *Xt, TMRPoint *Xtt);
   int getParamsOnFace(TMRFace *face, double t, int dir, double *u, double *v);
   int isSame(TMREdge *e);
+  uint32_t getHashKey();
   int isDegenerate();
   void getEdgeObject(TopoDS_Edge &e);
 
  private:
+  void initCurve();
+
   TopoDS_Edge edge;
   TopoDS_Edge reverse_edge;
+
+  // The curve adaptor and the projection onto the curve are kept for
+  // all evaluations and created on first use. Both have internal
+  // state guarded by the mutex.
+  int curve_init;
+  BRepAdaptor_Curve curve;
+  GeomAPI_ProjectPointOnCurve *projection;
+  int projection_fail;
+  pthread_mutex_t mutex;
 };
 
 class TMR_OCCFace : public TMRFace {
@@ -162,29 +200,84 @@ class TMR_OCCFace : public TMRFace {
   void getRange(double *umin, double *vmin, double *umax, double *vmax);
   int evalPoint(double u, double v, TMRPoint *X);
   int invEvalPoint(TMRPoint p, double *u, double *v);
+  int evalPoints(int n, const double *prm, TMRPoint *X);
+  int invEvalPoints(int n, const TMRPoint *X, double *prm);
   int evalDeriv(double u, double v, TMRPoint *X, TMRPoint *Xu, TMRPoint *Xv);
   int eval2ndDeriv(double u, double v, TMRPoint *X, TMRPoint *Xu, TMRPoint *Xv,
                    TMRPoint *Xuu, TMRPoint *Xuv, TMRPoint *Xvv);
   int isSame(TMRFace *f);
+  uint32_t getHashKey();
   void getFaceObject(TopoDS_Face &f);
 
+  // Keep up to the given number of point/derivative evaluations
+  void setEvalCacheSize(int size);
+
  private:
+  // Evaluate the point and optionally the derivatives with the
+  // mutex held
+  void evalCached(double u, double v, TMRPoint *X, TMRPoint *Xu,
+                  TMRPoint *Xv);
+  GeomAPI_ProjectPointOnSurf *getProjection();
+
   TopoDS_Face face;
+
+  // The surface, its adaptor and the projection onto the surface are
+  // kept for all evaluations. The projection is created on the first
+  // inverse evaluation. All have internal state guarded by the mutex.
+  Handle(Geom_Surface) surf;
+  GeomAdaptor_Surface adaptor;
+  GeomAPI_ProjectPointOnSurf *projection;
+  pthread_mutex_t mutex;
+
+  // An optional direct-mapped cache of evaluations keyed on the exact
+  // parameter values. The size is zero or a power of two.
+  class EvalCacheEntry {
+   public:
+    double u, v;
+    int has_deriv;
+    TMRPoint X, Xu, Xv;
+  };
+  int cache_size;
+  EvalCacheEntry *cache;
 };
 
 /*
   Initialization of the OpenCascade geometry from an IGES/STEP files
+
+  When convert_to_native is set, faces and edges whose geometry is a
+  plane, line, Bezier or clamped B-spline are converted once to
+  TMRBsplineSurface, TMRBsplineCurve and TMRBsplinePcurve objects so
+  that meshing does not evaluate through OpenCASCADE. Any other
+  geometry is kept as TMR_OCCFace/TMR_OCCEdge.
 */
 void TMR_SewModelIGES(char *filename, const char *units, int print_level = 0,
                       double sew_tol = 1.e-6, bool nonmanifold_mode = false);
 void TMR_SewModelSTEP(char *filename, const char *units, int print_level = 0,
                       double sew_tol = 1.e-6, bool nonmanifold_mode = false);
 TMRModel *TMR_LoadModelFromIGESFile(const char *filename, const char *units,
-                                    int print_level = 0);
+                                    int print_level = 0,
+                                    int convert_to_native = 0);
 TMRModel *TMR_LoadModelFromSTEPFile(const char *filename, const char *units,
-                                    int print_level = 0);
+                                    int print_level = 0,
+                                    int convert_to_native = 0);
 TMRModel *TMR_LoadModelFromCompound(TopoDS_Compound &compound,
-                                    int print_level = 0);
+                                    int print_level = 0,
+                                    int convert_to_native = 0);
+
+/*
+  Load the STEP file on the root processor only, optionally sew and
+  fix the compound with the tolerance sew_tol > 0, and broadcast the
+  healed topology to all processors as a BREP byte stream.
+
+  When cache_dir is not NULL, the healed topology is stored in
+  cache_dir and reused by later runs. The cache file name is based on
+  a hash of the STEP file contents, the units and the sew tolerance.
+*/
+TMRModel *TMR_LoadModelFromSTEPFile(MPI_Comm comm, const char *filename,
+                                    const char *units, double sew_tol = 0.0,
+                                    const char *cache_dir = NULL,
+                                    int print_level = 0,
+                                    int convert_to_native = 0);
 
 #endif  // TMR_HAS_OPENCASCADE
 #endif  // TMR_OPENCASCADE_H
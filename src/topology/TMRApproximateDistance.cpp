@@ -22,6 +22,10 @@
 
 #include <math.h>
 
+#include <functional>
+#include <queue>
+#include <vector>
+
 #include "KSM.h"
 #include "TACSElement2D.h"
 #include "TACSElement3D.h"
@@ -801,3 +805,584 @@ void TMRApproximateDistance(TMROctForest *filter, int index, double cutoff,
   assembler->decref();
   forest->decref();
 }
+
+/*
+  The following code computes the signed distance to the material
+  on_interface using the fast marching method on the nodes of the forest.
+
+  The nodes of each element are split into sub-cells with 2^dim
+  corners, ordered so that the neighbor of corner c along the
+  direction a is c ^ (1 << a). The distance at a node is updated from
+  the accepted nodes of an adjacent sub-cell by solving the upwind
+  discretization of |grad(d)| = 1 with the edge lengths as the grid
+  spacing.
+
+  Each processor runs the fast marching method on its local nodes
+  (owned and ghost). The owner of each node then takes the minimum
+  over the copies on all processors and returns it to the processors
+  that share the node. This is repeated until no values change, which
+  takes one iteration for each processor boundary crossed by the
+  front.
+*/
+
+// The distance assigned to nodes that are not reached
+static const double TMR_FAR_DISTANCE = 1e20;
+
+// Compare integers for sorting and searching
+static int compare_node_numbers(const void *a, const void *b) {
+  return (*(const int *)a) - (*(const int *)b);
+}
+
+/*
+  The local node graph for the fast marching method
+*/
+class TMRFastMarchingGraph {
+ public:
+  TMRFastMarchingGraph(MPI_Comm _comm, int _dim, int _num_nodes,
+                       const int *_nodes, const int *_node_range,
+                       const TMRPoint *_X, int _num_cells, int *_cells) {
+    comm = _comm;
+    dim = _dim;
+    num_corners = 1 << dim;
+    num_nodes = _num_nodes;
+    nodes = _nodes;
+    X = _X;
+    num_cells = _num_cells;
+    cells = _cells;
+
+    // Create the node to cell pointer
+    node_cell_ptr = new int[num_nodes + 1];
+    memset(node_cell_ptr, 0, (num_nodes + 1) * sizeof(int));
+    for (int i = 0; i < num_corners * num_cells; i++) {
+      if (cells[i] >= 0) {
+        node_cell_ptr[cells[i] + 1]++;
+      }
+    }
+    for (int i = 0; i < num_nodes; i++) {
+      node_cell_ptr[i + 1] += node_cell_ptr[i];
+    }
+    node_cells = new int[node_cell_ptr[num_nodes]];
+    for (int i = 0; i < num_corners * num_cells; i++) {
+      if (cells[i] >= 0) {
+        node_cells[node_cell_ptr[cells[i]]] = i;
+        node_cell_ptr[cells[i]]++;
+      }
+    }
+    for (int i = num_nodes; i > 0; i--) {
+      node_cell_ptr[i] = node_cell_ptr[i - 1];
+    }
+    node_cell_ptr[0] = 0;
+
+    // Set up the exchange of the ghost nodes with their owners
+    int mpi_size, mpi_rank;
+    MPI_Comm_size(comm, &mpi_size);
+    MPI_Comm_rank(comm, &mpi_rank);
+
+    ghost_count = new int[mpi_size];
+    ghost_ptr = new int[mpi_size + 1];
+    memset(ghost_count, 0, mpi_size * sizeof(int));
+
+    // The node numbers are sorted so the ghost nodes are sorted by owner
+    int owner = 0;
+    num_ghosts = 0;
+    ghost_nodes = new int[num_nodes];
+    for (int i = 0; i < num_nodes; i++) {
+      while (owner < mpi_size && nodes[i] >= _node_range[owner + 1]) {
+        owner++;
+      }
+      if (owner != mpi_rank) {
+        ghost_nodes[num_ghosts] = i;
+        ghost_count[owner]++;
+        num_ghosts++;
+      }
+    }
+    ghost_ptr[0] = 0;
+    for (int k = 0; k < mpi_size; k++) {
+      ghost_ptr[k + 1] = ghost_ptr[k] + ghost_count[k];
+    }
+
+    int *send_nums = new int[num_ghosts];
+    for (int i = 0; i < num_ghosts; i++) {
+      send_nums[i] = nodes[ghost_nodes[i]];
+    }
+
+    shared_count = new int[mpi_size];
+    shared_ptr = new int[mpi_size + 1];
+    MPI_Alltoall(ghost_count, 1, MPI_INT, shared_count, 1, MPI_INT, comm);
+    shared_ptr[0] = 0;
+    for (int k = 0; k < mpi_size; k++) {
+      shared_ptr[k + 1] = shared_ptr[k] + shared_count[k];
+    }
+    num_shared = shared_ptr[mpi_size];
+    shared_nodes = new int[num_shared];
+    MPI_Alltoallv(send_nums, ghost_count, ghost_ptr, MPI_INT, shared_nodes,
+                  shared_count, shared_ptr, MPI_INT, comm);
+    delete[] send_nums;
+
+    // Convert the shared global node numbers to local indices
+    for (int i = 0; i < num_shared; i++) {
+      int *item = (int *)bsearch(&shared_nodes[i], nodes, num_nodes,
+                                 sizeof(int), compare_node_numbers);
+      shared_nodes[i] = (item ? item - nodes : -1);
+    }
+
+    ghost_vals = new double[num_ghosts];
+    shared_vals = new double[num_shared];
+  }
+  ~TMRFastMarchingGraph() {
+    delete[] node_cell_ptr;
+    delete[] node_cells;
+    delete[] ghost_nodes;
+    delete[] ghost_count;
+    delete[] ghost_ptr;
+    delete[] shared_nodes;
+    delete[] shared_count;
+    delete[] shared_ptr;
+    delete[] ghost_vals;
+    delete[] shared_vals;
+  }
+
+  /*
+    Run the fast marching method from all nodes with a finite distance
+  */
+  void march(double *dist, int *accepted) {
+    typedef std::pair<double, int> entry;
+    std::priority_queue<entry, std::vector<entry>, std::greater<entry> > heap;
+    for (int i = 0; i < num_nodes; i++) {
+      accepted[i] = 0;
+      if (dist[i] < TMR_FAR_DISTANCE) {
+        heap.push(entry(dist[i], i));
+      }
+    }
+
+    while (!heap.empty()) {
+      entry top = heap.top();
+      heap.pop();
+      int node = top.second;
+      if (accepted[node] || top.first > dist[node]) {
+        continue;
+      }
+      accepted[node] = 1;
+
+      // Update the nodes in all the sub-cells that contain this node
+      for (int jp = node_cell_ptr[node]; jp < node_cell_ptr[node + 1]; jp++) {
+        const int *cell = &cells[num_corners * (node_cells[jp] / num_corners)];
+        for (int c = 0; c < num_corners; c++) {
+          int n = cell[c];
+          if (n >= 0 && !accepted[n]) {
+            double d = update(cell, c, dist, accepted);
+            if (d < dist[n]) {
+              dist[n] = d;
+              heap.push(entry(d, n));
+            }
+          }
+        }
+      }
+    }
+  }
+
+  /*
+    Set the minimum distance across all processors for the shared nodes
+    and return whether any value changed on any processor
+  */
+  int exchange(double *dist) {
+    int mpi_size;
+    MPI_Comm_size(comm, &mpi_size);
+
+    // Send the ghost values to the owners and take the minimum
+    for (int i = 0; i < num_ghosts; i++) {
+      ghost_vals[i] = dist[ghost_nodes[i]];
+    }
+    MPI_Alltoallv(ghost_vals, ghost_count, ghost_ptr, MPI_DOUBLE, shared_vals,
+                  shared_count, shared_ptr, MPI_DOUBLE, comm);
+
+    int changed = 0;
+    for (int i = 0; i < num_shared; i++) {
+      int n = shared_nodes[i];
+      if (n >= 0 && shared_vals[i] < dist[n]) {
+        dist[n] = shared_vals[i];
+        changed = 1;
+      }
+    }
+
+    // Return the owner values to the ghost nodes
+    for (int i = 0; i < num_shared; i++) {
+      int n = shared_nodes[i];
+      shared_vals[i] = (n >= 0 ? dist[n] : TMR_FAR_DISTANCE);
+    }
+    MPI_Alltoallv(shared_vals, shared_count, shared_ptr, MPI_DOUBLE,
+                  ghost_vals, ghost_count, ghost_ptr, MPI_DOUBLE, comm);
+    for (int i = 0; i < num_ghosts; i++) {
+      if (ghost_vals[i] < dist[ghost_nodes[i]]) {
+        dist[ghost_nodes[i]] = ghost_vals[i];
+        changed = 1;
+      }
+    }
+
+    int global_changed = 0;
+    MPI_Allreduce(&changed, &global_changed, 1, MPI_INT, MPI_MAX, comm);
+    return global_changed;
+  }
+
+  // The spatial dimension of the sub-cells
+  int dim, num_corners;
+
+  // The local nodes and their locations
+  int num_nodes;
+  const int *nodes;
+  const TMRPoint *X;
+
+  // The sub-cells
+  int num_cells;
+  int *cells;
+
+  // The sub-cell corners that contain each node
+  int *node_cell_ptr, *node_cells;
+
+ private:
+  /*
+    Compute the upwind update for corner c of the sub-cell
+  */
+  double update(const int *cell, int c, const double *dist,
+                const int *accepted) {
+    const TMRPoint *p = &X[cell[c]];
+
+    // Collect the accepted neighbors along each direction
+    int m = 0;
+    double d[3], h[3];
+    for (int a = 0; a < dim; a++) {
+      int n = cell[c ^ (1 << a)];
+      if (n >= 0 && accepted[n]) {
+        double dx = X[n].x - p->x;
+        double dy = X[n].y - p->y;
+        double dz = X[n].z - p->z;
+        d[m] = dist[n];
+        h[m] = sqrt(dx * dx + dy * dy + dz * dz);
+        m++;
+      }
+    }
+    if (m == 0) {
+      return TMR_FAR_DISTANCE;
+    }
+
+    // Sort the neighbors by distance
+    for (int i = 1; i < m; i++) {
+      for (int j = i; j > 0 && d[j] < d[j - 1]; j--) {
+        double t = d[j];
+        d[j] = d[j - 1];
+        d[j - 1] = t;
+        t = h[j];
+        h[j] = h[j - 1];
+        h[j - 1] = t;
+      }
+    }
+
+    // Add the neighbors one at a time while the solution remains
+    // larger than the next neighbor value
+    double value = d[0] + h[0];
+    for (int k = 2; k <= m; k++) {
+      if (value <= d[k - 1]) {
+        break;
+      }
+      double A = 0.0, B = 0.0, C = -1.0;
+      for (int i = 0; i < k; i++) {
+        double w = 1.0 / (h[i] * h[i]);
+        A += w;
+        B -= 2.0 * w * d[i];
+        C += w * d[i] * d[i];
+      }
+      double disc = B * B - 4.0 * A * C;
+      if (disc < 0.0) {
+        break;
+      }
+      value = (-B + sqrt(disc)) / (2.0 * A);
+    }
+
+    return value;
+  }
+
+  MPI_Comm comm;
+
+  // The ghost nodes on this processor and the nodes owned by this
+  // processor that are ghosts on other processors
+  int num_ghosts, *ghost_nodes, *ghost_count, *ghost_ptr;
+  int num_shared, *shared_nodes, *shared_count, *shared_ptr;
+  double *ghost_vals, *shared_vals;
+};
+
+/*
+  Compute the signed distance on the local nodes given the sub-cells
+  and the level set values at the nodes. Distances are positive where
+  the level set value is positive.
+*/
+static void TMRComputeSignedDistance(TMRFastMarchingGraph *graph,
+                                     const double *phi, const int *on_interface,
+                                     double *dist) {
+  const int num_nodes = graph->num_nodes;
+  const int num_corners = graph->num_corners;
+  const TMRPoint *X = graph->X;
+
+  // Initialize the distance on the on_interface
+  for (int i = 0; i < num_nodes; i++) {
+    dist[i] = (on_interface[i] ? 0.0 : TMR_FAR_DISTANCE);
+  }
+
+  // Initialize the nodes on either side of a sub-cell edge that
+  // crosses the zero level set using linear interpolation
+  for (int i = 0; i < graph->num_cells; i++) {
+    const int *cell = &graph->cells[num_corners * i];
+    for (int c = 0; c < num_corners; c++) {
+      for (int a = 0; a < graph->dim; a++) {
+        int n1 = cell[c], n2 = cell[c ^ (1 << a)];
+        if (n1 >= 0 && n2 >= 0 && phi[n1] * phi[n2] < 0.0) {
+          double dx = X[n2].x - X[n1].x;
+          double dy = X[n2].y - X[n1].y;
+          double dz = X[n2].z - X[n1].z;
+          double h = sqrt(dx * dx + dy * dy + dz * dz);
+          double t = phi[n1] / (phi[n1] - phi[n2]);
+          if (t * h < dist[n1]) {
+            dist[n1] = t * h;
+          }
+          if ((1.0 - t) * h < dist[n2]) {
+            dist[n2] = (1.0 - t) * h;
+          }
+        }
+      }
+    }
+  }
+
+  // Alternate between marching locally and exchanging the values
+  // with the other processors
+  int *accepted = new int[num_nodes];
+  graph->exchange(dist);
+  do {
+    graph->march(dist, accepted);
+  } while (graph->exchange(dist));
+  delete[] accepted;
+
+  // Set the sign of the distance
+  for (int i = 0; i < num_nodes; i++) {
+    if (phi[i] < 0.0) {
+      dist[i] = -dist[i];
+    }
+  }
+}
+
+/*
+  Evaluate the level set value at each local node. The on_interface is
+  the set of nodes with intermediate density. When the index is
+  negative, the material region is the union of all the materials.
+*/
+static void TMREvalLevelSet(TACSBVec *rho, int index, double cutoff,
+                            int num_nodes, const int *nodes, double *phi,
+                            int *on_interface) {
+  int bsize = rho->getBlockSize();
+  TacsScalar *values = new TacsScalar[bsize];
+  for (int i = 0; i < num_nodes; i++) {
+    rho->getValues(1, &nodes[i], values);
+
+    double value = 0.0;
+    if (index >= 0 && index < bsize) {
+      value = TacsRealPart(values[index]);
+    } else {
+      value = TacsRealPart(values[0]);
+      for (int k = 1; k < bsize; k++) {
+        if (TacsRealPart(values[k]) > value) {
+          value = TacsRealPart(values[k]);
+        }
+      }
+    }
+    phi[i] = value - 0.5;
+    on_interface[i] = (value >= cutoff && value <= 1.0 - cutoff);
+  }
+  delete[] values;
+}
+
+/*
+  Set the signed distance into the vector and compute the minimum
+  distance for each element
+*/
+static void TMRSetDistanceValues(TMRFastMarchingGraph *graph, int mpi_rank,
+                                 int elem_size, int num_elements,
+                                 const int *conn, const int *node_range,
+                                 const double *dist, TACSBVec *dist_vec,
+                                 double *min_dist) {
+  if (dist_vec) {
+    dist_vec->zeroEntries();
+    for (int i = 0; i < graph->num_nodes; i++) {
+      int node = graph->nodes[i];
+      if (node >= node_range[mpi_rank] && node < node_range[mpi_rank + 1]) {
+        TacsScalar value = dist[i];
+        dist_vec->setValues(1, &node, &value, TACS_INSERT_VALUES);
+      }
+    }
+    dist_vec->beginSetValues(TACS_INSERT_VALUES);
+    dist_vec->endSetValues(TACS_INSERT_VALUES);
+    dist_vec->beginDistributeValues();
+    dist_vec->endDistributeValues();
+  }
+
+  if (min_dist) {
+    for (int i = 0; i < num_elements; i++) {
+      min_dist[i] = TMR_FAR_DISTANCE;
+      for (int j = 0; j < elem_size; j++) {
+        int node = conn[elem_size * i + j];
+        if (node >= 0) {
+          int *item = (int *)bsearch(&node, graph->nodes, graph->num_nodes,
+                                     sizeof(int), compare_node_numbers);
+          if (item) {
+            double d = fabs(dist[item - graph->nodes]);
+            if (d < min_dist[i]) {
+              min_dist[i] = d;
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+/*
+  Compute the signed distance for the quadtree forest
+*/
+int TMRFastMarchingDistance(TMRQuadForest *filter, int index, double cutoff,
+                            TACSBVec *rho, TACSBVec *dist_vec,
+                            double *min_dist) {
+  if (dist_vec && dist_vec->getBlockSize() != 1) {
+    fprintf(stderr,
+            "TMRFastMarchingDistance: Distance vector must have a block "
+            "size of 1\n");
+    return 1;
+  }
+
+  // Distribute the design values
+  rho->beginDistributeValues();
+  rho->endDistributeValues();
+
+  filter->createNodes();
+  const int order = filter->getMeshOrder();
+  const int *conn;
+  int num_elements = 0;
+  filter->getNodeConn(&conn, &num_elements);
+
+  const int *nodes, *node_range;
+  int num_nodes = filter->getNodeNumbers(&nodes);
+  filter->getOwnedNodeRange(&node_range);
+  TMRPoint *X;
+  filter->getPoints(&X);
+
+  // Create the sub-cells from the element nodes
+  const int ncells = (order - 1) * (order - 1);
+  int *cells = new int[4 * ncells * num_elements];
+  for (int i = 0, *c = cells; i < num_elements; i++) {
+    const int *elem_conn = &conn[order * order * i];
+    for (int iy = 0; iy < order - 1; iy++) {
+      for (int ix = 0; ix < order - 1; ix++, c += 4) {
+        for (int jj = 0; jj < 2; jj++) {
+          for (int ii = 0; ii < 2; ii++) {
+            int node = elem_conn[(ix + ii) + (iy + jj) * order];
+            c[ii + 2 * jj] =
+                (node >= 0 ? filter->getLocalNodeNumber(node) : -1);
+          }
+        }
+      }
+    }
+  }
+
+  TMRFastMarchingGraph *graph =
+      new TMRFastMarchingGraph(filter->getMPIComm(), 2, num_nodes, nodes,
+                               node_range, X, ncells * num_elements, cells);
+
+  double *phi = new double[num_nodes];
+  int *on_interface = new int[num_nodes];
+  double *dist = new double[num_nodes];
+  TMREvalLevelSet(rho, index, cutoff, num_nodes, nodes, phi, on_interface);
+  TMRComputeSignedDistance(graph, phi, on_interface, dist);
+  int mpi_rank;
+  MPI_Comm_rank(filter->getMPIComm(), &mpi_rank);
+  TMRSetDistanceValues(graph, mpi_rank, order * order, num_elements, conn,
+                       node_range, dist, dist_vec, min_dist);
+
+  delete graph;
+  delete[] cells;
+  delete[] phi;
+  delete[] on_interface;
+  delete[] dist;
+
+  return 0;
+}
+
+/*
+  Compute the signed distance for the octree forest
+*/
+int TMRFastMarchingDistance(TMROctForest *filter, int index, double cutoff,
+                            TACSBVec *rho, TACSBVec *dist_vec,
+                            double *min_dist) {
+  if (dist_vec && dist_vec->getBlockSize() != 1) {
+    fprintf(stderr,
+            "TMRFastMarchingDistance: Distance vector must have a block "
+            "size of 1\n");
+    return 1;
+  }
+
+  // Distribute the design values
+  rho->beginDistributeValues();
+  rho->endDistributeValues();
+
+  filter->createNodes();
+  const int order = filter->getMeshOrder();
+  const int *conn;
+  int num_elements = 0;
+  filter->getNodeConn(&conn, &num_elements);
+
+  const int *nodes, *node_range;
+  int num_nodes = filter->getNodeNumbers(&nodes);
+  filter->getOwnedNodeRange(&node_range);
+  TMRPoint *X;
+  filter->getPoints(&X);
+
+  // Create the sub-cells from the element nodes
+  const int ncells = (order - 1) * (order - 1) * (order - 1);
+  int *cells = new int[8 * ncells * num_elements];
+  for (int i = 0, *c = cells; i < num_elements; i++) {
+    const int *elem_conn = &conn[order * order * order * i];
+    for (int iz = 0; iz < order - 1; iz++) {
+      for (int iy = 0; iy < order - 1; iy++) {
+        for (int ix = 0; ix < order - 1; ix++, c += 8) {
+          for (int kk = 0; kk < 2; kk++) {
+            for (int jj = 0; jj < 2; jj++) {
+              for (int ii = 0; ii < 2; ii++) {
+                int node = elem_conn[(ix + ii) + (iy + jj) * order +
+                                     (iz + kk) * order * order];
+                c[ii + 2 * jj + 4 * kk] =
+                    (node >= 0 ? filter->getLocalNodeNumber(node) : -1);
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+  TMRFastMarchingGraph *graph =
+      new TMRFastMarchingGraph(filter->getMPIComm(), 3, num_nodes, nodes,
+                               node_range, X, ncells * num_elements, cells);
+
+  double *phi = new double[num_nodes];
+  int *on_interface = new int[num_nodes];
+  double *dist = new double[num_nodes];
+  TMREvalLevelSet(rho, index, cutoff, num_nodes, nodes, phi, on_interface);
+  TMRComputeSignedDistance(graph, phi, on_interface, dist);
+  int mpi_rank;
+  MPI_Comm_rank(filter->getMPIComm(), &mpi_rank);
+  TMRSetDistanceValues(graph, mpi_rank, order * order * order, num_elements,
+                       conn, node_range, dist, dist_vec, min_dist);
+
+  delete graph;
+  delete[] cells;
+  delete[] phi;
+  delete[] on_interface;
+  delete[] dist;
+
+  return 0;
+}
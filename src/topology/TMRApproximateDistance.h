@@ -32,4 +32,31 @@ void TMRApproximateDistance(TMROctForest *filter, int index, double cutoff,
                             double t, TACSBVec *rho, const char *filename,
                             double *min_dist);
 
+/*
+  Compute the signed distance to the material interface using the
+  fast marching method on the nodes of the filter forest.
+
+  The interface consists of the nodes with intermediate density in
+  [cutoff, 1 - cutoff] and the crossings of the rho = 0.5 level set
+  along the mesh edges. The distance is positive within the material.
+  When the index is negative, the material region is the union of all
+  the components of rho.
+
+  input:
+  filter:     the forest with the layout of the design vector
+  index:      the design variable component (or -1 for all)
+  cutoff:     the density cutoff for the interface
+  rho:        the design vector
+
+  output:
+  dist:       the signed distance at the nodes (block size 1, may be NULL)
+  min_dist:   the minimum distance for each element (may be NULL)
+
+  returns:    a non-zero fail flag if the input is not valid
+*/
+int TMRFastMarchingDistance(TMRQuadForest *filter, int index, double cutoff,
+                            TACSBVec *rho, TACSBVec *dist, double *min_dist);
+int TMRFastMarchingDistance(TMROctForest *filter, int index, double cutoff,
+                            TACSBVec *rho, TACSBVec *dist, double *min_dist);
+
 #endif  // TMR_APPROXIMATE_DISTANCE_H
@@ -71,6 +71,8 @@ void TMRConformFilter::initialize(int _nlevels, TACSAssembler *_assembler[],
 
   // Now create the interpolation between filter levels
   filter_interp = new TACSBVecInterp *[nlevels - 1];
+  restriction = new TMRDesignRestriction(nlevels, assembler);
+  restriction->incref();
 
   for (int k = 1; k < nlevels; k++) {
     // Create the interpolation object
@@ -81,14 +83,20 @@ void TMRConformFilter::initialize(int _nlevels, TACSAssembler *_assembler[],
 
     // Create the interpolation on the TMR side
     if (oct_filter) {
-      oct_filter[k - 1]->createInterpolation(oct_filter[k],
-                                             filter_interp[k - 1]);
+      restriction->createInterpolation(k - 1, oct_filter[k - 1], oct_filter[k],
+                                       filter_interp[k - 1]);
     } else {
-      quad_filter[k - 1]->createInterpolation(quad_filter[k],
-                                              filter_interp[k - 1]);
+      restriction->createInterpolation(k - 1, quad_filter[k - 1],
+                                       quad_filter[k], filter_interp[k - 1]);
     }
     filter_interp[k - 1]->initialize();
   }
+
+  // Form the composite restriction to all levels, if it can be used
+  if (!restriction->initialize(filter_interp)) {
+    restriction->decref();
+    restriction = NULL;
+  }
 }
 
 TMRConformFilter::~TMRConformFilter() {
@@ -116,6 +124,9 @@ TMRConformFilter::~TMRConformFilter() {
     filter_interp[k]->decref();
   }
   delete[] filter_interp;
+  if (restriction) {
+    restriction->decref();
+  }
 }
 
 /*
@@ -148,22 +159,61 @@ TMROctForest *TMRConformFilter::getFilterOctForest() {
   return NULL;
 }
 
+/*
+  Get the memory used by the filter forests and the design variable
+  vectors on all levels. The TACSAssembler objects are not included.
+*/
+void TMRConformFilter::getMemoryUsage(TMRMemoryUsage *usage) {
+  usage->zero();
+  for (int k = 0; k < nlevels; k++) {
+    TMRMemoryUsage level_usage;
+    if (oct_filter) {
+      oct_filter[k]->getMemoryUsage(&level_usage);
+    } else {
+      quad_filter[k]->getMemoryUsage(&level_usage);
+    }
+    usage->add(&level_usage);
+
+    TacsScalar *xvals;
+    int size = x[k]->getArray(&xvals);
+    usage->other += size * sizeof(TacsScalar);
+  }
+  if (restriction) {
+    usage->other += restriction->getMemoryUsage();
+  }
+}
+
 /*
   Set the design variables for each level
 */
 void TMRConformFilter::setDesignVars(TACSBVec *xvec) {
   // Copy the values to the local design variable vector
   x[0]->copyValues(xvec);
+  setLevelDesignVars();
+}
 
-  // Copy the values to the local array
-  assembler[0]->setDesignVars(x[0]);
-
-  // Set the design variable values on all processors
-  for (int k = 0; k < nlevels - 1; k++) {
-    filter_interp[k]->multWeightTranspose(x[k], x[k + 1]);
+/*
+  Set the design variables on all levels from the values in x[0]
+*/
+void TMRConformFilter::setLevelDesignVars() {
+  if (restriction) {
+    // Compute the values on the coarser levels from x[0] while the
+    // values are set on the finest level
+    restriction->beginRestriction(x);
+    assembler[0]->setDesignVars(x[0]);
+    restriction->endRestriction(x);
+
+    for (int k = 1; k < nlevels; k++) {
+      assembler[k]->setDesignVars(x[k]);
+    }
+  } else {
+    assembler[0]->setDesignVars(x[0]);
 
-    // Set the design variable values
-    assembler[k + 1]->setDesignVars(x[k + 1]);
+    // Set the design variable values on all processors
+    for (int k = 0; k < nlevels - 1; k++) {
+      filter_interp[k]->multWeightTranspose(x[k], x[k + 1]);
+      assembler[k + 1]->setDesignVars(x[k + 1]);
+    }
   }
 }
 
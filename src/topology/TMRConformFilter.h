@@ -22,6 +22,7 @@
 #define TMR_CONFORM_FILTER_H
 
 #include "TACSAssembler.h"
+#include "TMRDesignRestriction.h"
 #include "TMROctForest.h"
 #include "TMRQuadForest.h"
 #include "TMRTopoFilter.h"
@@ -48,6 +49,9 @@ class TMRConformFilter : public TMRTopoFilter {
   TMRQuadForest *getFilterQuadForest();
   TMROctForest *getFilterOctForest();
 
+  // Get the memory used by the forests and design vectors on all levels
+  void getMemoryUsage(TMRMemoryUsage *usage);
+
   // Set the design variable values (including all local values)
   void setDesignVars(TACSBVec *x);
 
@@ -61,7 +65,22 @@ class TMRConformFilter : public TMRTopoFilter {
     }
   }
 
+  // Gather the STL triangles on the root processor
+  int getSTLTriangles(int root, int k, double cutoff, int *ntris,
+                      TMR_STLTriangle **tris) {
+    if (oct_filter) {
+      return TMR_GenerateSTLTriangles(root, oct_filter[0], x[0], k, cutoff,
+                                      ntris, tris);
+    }
+    *ntris = 0;
+    *tris = NULL;
+    return 1;
+  }
+
  protected:
+  // Set the design variables on all levels from the values in x[0]
+  void setLevelDesignVars();
+
   // The number of multigrid levels
   int nlevels;
   TACSAssembler **assembler;
@@ -74,6 +93,9 @@ class TMRConformFilter : public TMRTopoFilter {
   TMRQuadForest **quad_filter;
   TACSBVecInterp **filter_interp;
 
+  // The composite restriction of the design variables (if any)
+  TMRDesignRestriction *restriction;
+
   // Create the design variable values at each level
   TACSBVec **x;
 
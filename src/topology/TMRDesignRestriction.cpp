@@ -0,0 +1,808 @@
+/*
+  This file is part of the package TMR for adaptive mesh refinement.
+
+  Copyright (C) 2015 Georgia Tech Research Corporation.
+  Additional copyright (C) 2015 Graeme Kennedy.
+  All rights reserved.
+
+  TMR is licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this software except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "TMRDesignRestriction.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+  The composite operators are only used if they have at most this many
+  times the non-zeros of the level-by-level restriction operators
+*/
+static const double TMR_MAX_COMPOSITE_FILL = 8.0;
+
+/*
+  The relative tolerance used to check the composite operators against
+  the level-by-level restriction
+*/
+static const double TMR_COMPOSITE_CHECK_TOL = 1e-10;
+
+/*
+  Find the processor that owns the given node from the ownership
+  ranges
+*/
+static int TMRFindRangeOwner(int node, int mpi_size, const int *range) {
+  int low = 0, high = mpi_size - 1;
+  while (low < high) {
+    int mid = (low + high + 1) / 2;
+    if (range[mid] <= node) {
+      low = mid;
+    } else {
+      high = mid - 1;
+    }
+  }
+  return low;
+}
+
+/*
+  A column index and value of a composite operator row
+*/
+class TMRColumnValue {
+ public:
+  int col;
+  double val;
+};
+
+/*
+  Compare two column entries by their index
+*/
+static int compare_column_values(const void *a, const void *b) {
+  const TMRColumnValue *A = static_cast<const TMRColumnValue *>(a);
+  const TMRColumnValue *B = static_cast<const TMRColumnValue *>(b);
+  return A->col - B->col;
+}
+
+/*
+  Compare two integers
+*/
+static int compare_ints(const void *a, const void *b) {
+  return *static_cast<const int *>(a) - *static_cast<const int *>(b);
+}
+
+/*
+  Set up the restriction for the given hierarchy
+
+  The levels are ordered from the finest to the coarsest, as in the
+  filters.
+*/
+TMRDesignRestriction::TMRDesignRestriction(int _nlevels,
+                                           TACSAssembler *_assembler[]) {
+  nlevels = _nlevels;
+  comm = _assembler[0]->getMPIComm();
+  bsize = _assembler[0]->getDesignVarsPerNode();
+
+  int mpi_size;
+  MPI_Comm_size(comm, &mpi_size);
+
+  assembler = new TACSAssembler *[nlevels];
+  range = new int *[nlevels];
+  for (int k = 0; k < nlevels; k++) {
+    assembler[k] = _assembler[k];
+    assembler[k]->incref();
+
+    const int *owner_range;
+    assembler[k]->getDesignNodeMap()->getOwnerRange(&owner_range);
+    range[k] = new int[mpi_size + 1];
+    memcpy(range[k], owner_range, (mpi_size + 1) * sizeof(int));
+  }
+
+  num_rows = new int[nlevels];
+  rows = new int *[nlevels];
+  rows_ptr = new int *[nlevels];
+  rows_vars = new int *[nlevels];
+  rows_weights = new double *[nlevels];
+
+  num_owned = new int[nlevels];
+  rowp = new int *[nlevels];
+  cols = new int *[nlevels];
+  vals = new double *[nlevels];
+  browp = new int *[nlevels];
+  bcols = new int *[nlevels];
+  bvals = new double *[nlevels];
+
+  for (int k = 0; k < nlevels; k++) {
+    num_rows[k] = -1;
+    rows[k] = rows_ptr[k] = rows_vars[k] = NULL;
+    rows_weights[k] = NULL;
+
+    num_owned[k] = 0;
+    rowp[k] = cols[k] = browp[k] = bcols[k] = NULL;
+    vals[k] = bvals[k] = NULL;
+  }
+
+  num_ext = 0;
+  ghost = NULL;
+  x_ext = NULL;
+}
+
+/*
+  Free the restriction data
+*/
+TMRDesignRestriction::~TMRDesignRestriction() {
+  freeRecordedRows();
+  freeOperators();
+
+  for (int k = 0; k < nlevels; k++) {
+    assembler[k]->decref();
+    delete[] range[k];
+  }
+  delete[] assembler;
+  delete[] range;
+
+  delete[] num_rows;
+  delete[] rows;
+  delete[] rows_ptr;
+  delete[] rows_vars;
+  delete[] rows_weights;
+
+  delete[] num_owned;
+  delete[] rowp;
+  delete[] cols;
+  delete[] vals;
+  delete[] browp;
+  delete[] bcols;
+  delete[] bvals;
+}
+
+/*
+  Create the interpolation from level+1 to level and record its rows
+
+  The rows are recorded through the interpolation cache of the fine
+  forest, which is restored to its previous setting afterwards. This
+  call is collective.
+*/
+void TMRDesignRestriction::createInterpolation(int level, TMROctForest *fine,
+                                               TMROctForest *coarse,
+                                               TACSBVecInterp *interp) {
+  int cache = fine->getCacheInterpolation();
+  fine->setCacheInterpolation(1);
+  fine->createInterpolation(coarse, interp);
+
+  const int *r, *ptr, *vars;
+  const double *weights;
+  int n = fine->getInterpolationRows(coarse, &r, &ptr, &vars, &weights);
+  recordRows(level, n, r, ptr, vars, weights);
+  fine->setCacheInterpolation(cache);
+}
+
+void TMRDesignRestriction::createInterpolation(int level, TMRQuadForest *fine,
+                                               TMRQuadForest *coarse,
+                                               TACSBVecInterp *interp) {
+  int cache = fine->getCacheInterpolation();
+  fine->setCacheInterpolation(1);
+  fine->createInterpolation(coarse, interp);
+
+  const int *r, *ptr, *vars;
+  const double *weights;
+  int n = fine->getInterpolationRows(coarse, &r, &ptr, &vars, &weights);
+  recordRows(level, n, r, ptr, vars, weights);
+  fine->setCacheInterpolation(cache);
+}
+
+/*
+  Copy the interpolation rows for the given level
+*/
+void TMRDesignRestriction::recordRows(int level, int nrows, const int *r,
+                                      const int *ptr, const int *vars,
+                                      const double *weights) {
+  if (rows[level]) {
+    delete[] rows[level];
+    delete[] rows_ptr[level];
+    delete[] rows_vars[level];
+    delete[] rows_weights[level];
+    rows[level] = rows_ptr[level] = rows_vars[level] = NULL;
+    rows_weights[level] = NULL;
+  }
+
+  num_rows[level] = nrows;
+  if (nrows >= 0) {
+    int size = ptr[nrows];
+    rows[level] = new int[nrows];
+    rows_ptr[level] = new int[nrows + 1];
+    rows_vars[level] = new int[size];
+    rows_weights[level] = new double[size];
+    memcpy(rows[level], r, nrows * sizeof(int));
+    memcpy(rows_ptr[level], ptr, (nrows + 1) * sizeof(int));
+    memcpy(rows_vars[level], vars, size * sizeof(int));
+    memcpy(rows_weights[level], weights, size * sizeof(double));
+  }
+}
+
+/*
+  Free the recorded interpolation rows
+*/
+void TMRDesignRestriction::freeRecordedRows() {
+  for (int k = 0; k < nlevels; k++) {
+    if (rows[k]) {
+      delete[] rows[k];
+      delete[] rows_ptr[k];
+      delete[] rows_vars[k];
+      delete[] rows_weights[k];
+    }
+    num_rows[k] = -1;
+    rows[k] = rows_ptr[k] = rows_vars[k] = NULL;
+    rows_weights[k] = NULL;
+  }
+}
+
+/*
+  Free the composite operators and the exchange
+*/
+void TMRDesignRestriction::freeOperators() {
+  for (int k = 0; k < nlevels; k++) {
+    if (rowp[k]) {
+      delete[] rowp[k];
+      delete[] cols[k];
+      delete[] vals[k];
+      delete[] browp[k];
+      delete[] bcols[k];
+      delete[] bvals[k];
+    }
+    num_owned[k] = 0;
+    rowp[k] = cols[k] = browp[k] = bcols[k] = NULL;
+    vals[k] = bvals[k] = NULL;
+  }
+  if (ghost) {
+    ghost->decref();
+  }
+  if (x_ext) {
+    delete[] x_ext;
+  }
+  num_ext = 0;
+  ghost = NULL;
+  x_ext = NULL;
+}
+
+
+/*
+  Compute the rows of the composite operator on the next coarser level
+
+  Given the rows of the composite operator C for the owned nodes on
+  the given level, this computes the rows of D^{-1} P^{T} C for the
+  owned nodes on the next level, where P is the recorded interpolation
+  from the next level. The interpolation rows are first sent to the
+  owners of their fine nodes. The products and the weights are then
+  sent to the owners of the coarse nodes and summed.
+
+  input:
+  level:   the fine level
+  cptr:    the pointer into the composite rows on the fine level
+  ccols:   the finest-level columns of the composite rows
+  cvals:   the values of the composite rows
+
+  output:
+  _ptr:    the pointer into the composite rows on the coarse level
+  _cols:   the sorted finest-level columns of the composite rows
+  _vals:   the values of the composite rows
+*/
+void TMRDesignRestriction::computeCoarseRows(int level, const int *cptr,
+                                             const int *ccols,
+                                             const double *cvals, int **_ptr,
+                                             int **_cols, double **_vals) {
+  int mpi_rank, mpi_size;
+  MPI_Comm_rank(comm, &mpi_rank);
+  MPI_Comm_size(comm, &mpi_size);
+
+  const int *fine_range = range[level];
+  const int *coarse_range = range[level + 1];
+  const int nrows = num_rows[level];
+  const int *ptr = rows_ptr[level];
+
+  // Send the interpolation rows to the owners of the fine nodes. Each
+  // row is sent as the node, the number of weights and the coarse
+  // nodes, followed by the weights.
+  int *isend_count = new int[mpi_size];
+  int *dsend_count = new int[mpi_size];
+  memset(isend_count, 0, mpi_size * sizeof(int));
+  memset(dsend_count, 0, mpi_size * sizeof(int));
+  for (int i = 0; i < nrows; i++) {
+    int owner = TMRFindRangeOwner(rows[level][i], mpi_size, fine_range);
+    isend_count[owner] += 2 + ptr[i + 1] - ptr[i];
+    dsend_count[owner] += ptr[i + 1] - ptr[i];
+  }
+
+  int *irecv_count = new int[mpi_size];
+  int *drecv_count = new int[mpi_size];
+  MPI_Alltoall(isend_count, 1, MPI_INT, irecv_count, 1, MPI_INT, comm);
+  MPI_Alltoall(dsend_count, 1, MPI_INT, drecv_count, 1, MPI_INT, comm);
+
+  int *isend_offset = new int[mpi_size + 1];
+  int *dsend_offset = new int[mpi_size + 1];
+  int *irecv_offset = new int[mpi_size + 1];
+  int *drecv_offset = new int[mpi_size + 1];
+  isend_offset[0] = dsend_offset[0] = irecv_offset[0] = drecv_offset[0] = 0;
+  for (int k = 0; k < mpi_size; k++) {
+    isend_offset[k + 1] = isend_offset[k] + isend_count[k];
+    dsend_offset[k + 1] = dsend_offset[k] + dsend_count[k];
+    irecv_offset[k + 1] = irecv_offset[k] + irecv_count[k];
+    drecv_offset[k + 1] = drecv_offset[k] + drecv_count[k];
+  }
+
+  int *ipos = new int[mpi_size];
+  int *dpos = new int[mpi_size];
+  memcpy(ipos, isend_offset, mpi_size * sizeof(int));
+  memcpy(dpos, dsend_offset, mpi_size * sizeof(int));
+
+  int *isend = new int[isend_offset[mpi_size]];
+  double *dsend = new double[dsend_offset[mpi_size]];
+  for (int i = 0; i < nrows; i++) {
+    int owner = TMRFindRangeOwner(rows[level][i], mpi_size, fine_range);
+    int n = ptr[i + 1] - ptr[i];
+    isend[ipos[owner]] = rows[level][i];
+    isend[ipos[owner] + 1] = n;
+    memcpy(&isend[ipos[owner] + 2], &rows_vars[level][ptr[i]],
+           n * sizeof(int));
+    memcpy(&dsend[dpos[owner]], &rows_weights[level][ptr[i]],
+           n * sizeof(double));
+    ipos[owner] += 2 + n;
+    dpos[owner] += n;
+  }
+
+  int *irecv = new int[irecv_offset[mpi_size]];
+  double *drecv = new double[drecv_offset[mpi_size]];
+  MPI_Alltoallv(isend, isend_count, isend_offset, MPI_INT, irecv, irecv_count,
+                irecv_offset, MPI_INT, comm);
+  MPI_Alltoallv(dsend, dsend_count, dsend_offset, MPI_DOUBLE, drecv,
+                drecv_count, drecv_offset, MPI_DOUBLE, comm);
+  delete[] isend;
+  delete[] dsend;
+  delete[] isend_count;
+  delete[] dsend_count;
+  delete[] isend_offset;
+  delete[] dsend_offset;
+  delete[] drecv_count;
+  delete[] drecv_offset;
+
+  // Send the contributions to the owners of the coarse nodes. Each
+  // weight w contributes (c, -1, w) to the weight sum of the coarse
+  // node c, and (c, j, w*C[i, j]) for each entry in the composite row
+  // of the fine node i.
+  int *send_count = new int[mpi_size];
+  memset(send_count, 0, mpi_size * sizeof(int));
+  for (int ip = 0; ip < irecv_offset[mpi_size];) {
+    int i = irecv[ip] - fine_range[mpi_rank];
+    int n = irecv[ip + 1];
+    for (int j = 0; j < n; j++) {
+      int owner = TMRFindRangeOwner(irecv[ip + 2 + j], mpi_size, coarse_range);
+      send_count[owner] += 1 + cptr[i + 1] - cptr[i];
+    }
+    ip += 2 + n;
+  }
+
+  int *recv_count = new int[mpi_size];
+  MPI_Alltoall(send_count, 1, MPI_INT, recv_count, 1, MPI_INT, comm);
+
+  int *send_offset = new int[mpi_size + 1];
+  int *recv_offset = new int[mpi_size + 1];
+  send_offset[0] = recv_offset[0] = 0;
+  for (int k = 0; k < mpi_size; k++) {
+    send_offset[k + 1] = send_offset[k] + send_count[k];
+    recv_offset[k + 1] = recv_offset[k] + recv_count[k];
+  }
+
+  int num_send = send_offset[mpi_size];
+  int *send_nodes = new int[num_send];
+  int *send_cols = new int[num_send];
+  double *send_vals = new double[num_send];
+  memcpy(ipos, send_offset, mpi_size * sizeof(int));
+  for (int ip = 0, dp = 0; ip < irecv_offset[mpi_size];) {
+    int i = irecv[ip] - fine_range[mpi_rank];
+    int n = irecv[ip + 1];
+    for (int j = 0; j < n; j++) {
+      int c = irecv[ip + 2 + j];
+      double w = drecv[dp + j];
+      int owner = TMRFindRangeOwner(c, mpi_size, coarse_range);
+      send_nodes[ipos[owner]] = c;
+      send_cols[ipos[owner]] = -1;
+      send_vals[ipos[owner]] = w;
+      ipos[owner]++;
+      for (int jp = cptr[i]; jp < cptr[i + 1]; jp++) {
+        send_nodes[ipos[owner]] = c;
+        send_cols[ipos[owner]] = ccols[jp];
+        send_vals[ipos[owner]] = w * cvals[jp];
+        ipos[owner]++;
+      }
+    }
+    ip += 2 + n;
+    dp += n;
+  }
+  delete[] irecv;
+  delete[] drecv;
+  delete[] irecv_count;
+  delete[] irecv_offset;
+  delete[] ipos;
+  delete[] dpos;
+
+  int num_recv = recv_offset[mpi_size];
+  int *recv_nodes = new int[num_recv];
+  int *recv_cols = new int[num_recv];
+  double *recv_vals = new double[num_recv];
+  MPI_Alltoallv(send_nodes, send_count, send_offset, MPI_INT, recv_nodes,
+                recv_count, recv_offset, MPI_INT, comm);
+  MPI_Alltoallv(send_cols, send_count, send_offset, MPI_INT, recv_cols,
+                recv_count, recv_offset, MPI_INT, comm);
+  MPI_Alltoallv(send_vals, send_count, send_offset, MPI_DOUBLE, recv_vals,
+                recv_count, recv_offset, MPI_DOUBLE, comm);
+  delete[] send_nodes;
+  delete[] send_cols;
+  delete[] send_vals;
+  delete[] send_count;
+  delete[] recv_count;
+  delete[] send_offset;
+  delete[] recv_offset;
+
+  // Sort the contributions to each owned coarse node by column
+  const int num_coarse = coarse_range[mpi_rank + 1] - coarse_range[mpi_rank];
+  int *count = new int[num_coarse + 1];
+  memset(count, 0, (num_coarse + 1) * sizeof(int));
+  for (int i = 0; i < num_recv; i++) {
+    count[recv_nodes[i] - coarse_range[mpi_rank] + 1]++;
+  }
+  for (int i = 0; i < num_coarse; i++) {
+    count[i + 1] += count[i];
+  }
+
+  TMRColumnValue *entries = new TMRColumnValue[num_recv];
+  for (int i = 0; i < num_recv; i++) {
+    int c = recv_nodes[i] - coarse_range[mpi_rank];
+    entries[count[c]].col = recv_cols[i];
+    entries[count[c]].val = recv_vals[i];
+    count[c]++;
+  }
+  for (int i = num_coarse; i > 0; i--) {
+    count[i] = count[i - 1];
+  }
+  count[0] = 0;
+  delete[] recv_nodes;
+  delete[] recv_cols;
+  delete[] recv_vals;
+
+  // Sum the duplicate columns and divide by the weight sum, which is
+  // sorted first with the column -1
+  int *new_ptr = new int[num_coarse + 1];
+  new_ptr[0] = 0;
+  int nnz = 0;
+  for (int i = 0; i < num_coarse; i++) {
+    int start = count[i], end = count[i + 1];
+    qsort(&entries[start], end - start, sizeof(TMRColumnValue),
+          compare_column_values);
+
+    double wsum = 0.0;
+    int j = start;
+    for (; j < end && entries[j].col < 0; j++) {
+      wsum += entries[j].val;
+    }
+    if (wsum != 0.0) {
+      while (j < end) {
+        int col = entries[j].col;
+        double val = 0.0;
+        for (; j < end && entries[j].col == col; j++) {
+          val += entries[j].val;
+        }
+        entries[nnz].col = col;
+        entries[nnz].val = val / wsum;
+        nnz++;
+      }
+    }
+    new_ptr[i + 1] = nnz;
+  }
+
+  int *new_cols = new int[nnz];
+  double *new_vals = new double[nnz];
+  for (int i = 0; i < nnz; i++) {
+    new_cols[i] = entries[i].col;
+    new_vals[i] = entries[i].val;
+  }
+  delete[] entries;
+  delete[] count;
+
+  *_ptr = new_ptr;
+  *_cols = new_cols;
+  *_vals = new_vals;
+}
+
+/*
+  Form the composite operators from the recorded interpolation rows
+
+  The composite operators are formed level by level with global
+  finest-level columns. They are discarded if they have too many
+  non-zeros, or if they do not reproduce the level-by-level
+  restriction computed with the interpolants. This call is collective.
+
+  input:
+  interp:   the interpolants from each level+1 to level
+
+  returns: 1 if the composite operators can be used, 0 otherwise
+*/
+int TMRDesignRestriction::initialize(TACSBVecInterp *interp[]) {
+  int mpi_rank;
+  MPI_Comm_rank(comm, &mpi_rank);
+
+  freeOperators();
+  if (nlevels < 2) {
+    freeRecordedRows();
+    return 0;
+  }
+
+  // Check that the rows were recorded on every level
+  int recorded = 1;
+  for (int k = 0; k < nlevels - 1; k++) {
+    if (num_rows[k] < 0) {
+      recorded = 0;
+    }
+  }
+  MPI_Allreduce(MPI_IN_PLACE, &recorded, 1, MPI_INT, MPI_MIN, comm);
+  if (!recorded) {
+    freeRecordedRows();
+    return 0;
+  }
+
+  // The composite operator on the finest level is the identity
+  const int start = range[0][mpi_rank];
+  const int end = range[0][mpi_rank + 1];
+  int **ptr = new int *[nlevels];
+  int **gcols = new int *[nlevels];
+  double **gvals = new double *[nlevels];
+  ptr[0] = new int[end - start + 1];
+  gcols[0] = new int[end - start];
+  gvals[0] = new double[end - start];
+  ptr[0][0] = 0;
+  for (int i = 0; i < end - start; i++) {
+    ptr[0][i + 1] = i + 1;
+    gcols[0][i] = start + i;
+    gvals[0][i] = 1.0;
+  }
+
+  // Form the composite operators and count the non-zeros of the
+  // composite and level-by-level operators
+  long int nnz[2] = {0, 0};
+  for (int k = 0; k < nlevels - 1; k++) {
+    nnz[1] += rows_ptr[k][num_rows[k]];
+    computeCoarseRows(k, ptr[k], gcols[k], gvals[k], &ptr[k + 1],
+                      &gcols[k + 1], &gvals[k + 1]);
+    int n = range[k + 1][mpi_rank + 1] - range[k + 1][mpi_rank];
+    nnz[0] += ptr[k + 1][n];
+  }
+  freeRecordedRows();
+  MPI_Allreduce(MPI_IN_PLACE, nnz, 2, MPI_LONG, MPI_SUM, comm);
+
+  int fail = (nnz[0] > TMR_MAX_COMPOSITE_FILL * nnz[1]);
+  if (!fail) {
+    // Find the sorted external columns on the finest level
+    int next = 0;
+    for (int k = 1; k < nlevels; k++) {
+      int n = range[k][mpi_rank + 1] - range[k][mpi_rank];
+      for (int jp = 0; jp < ptr[k][n]; jp++) {
+        if (gcols[k][jp] < start || gcols[k][jp] >= end) {
+          next++;
+        }
+      }
+    }
+
+    int *ext_nodes = new int[next];
+    next = 0;
+    for (int k = 1; k < nlevels; k++) {
+      int n = range[k][mpi_rank + 1] - range[k][mpi_rank];
+      for (int jp = 0; jp < ptr[k][n]; jp++) {
+        if (gcols[k][jp] < start || gcols[k][jp] >= end) {
+          ext_nodes[next] = gcols[k][jp];
+          next++;
+        }
+      }
+    }
+    qsort(ext_nodes, next, sizeof(int), compare_ints);
+    num_ext = 0;
+    for (int i = 0; i < next; i++) {
+      if (i == 0 || ext_nodes[i] != ext_nodes[num_ext - 1]) {
+        ext_nodes[num_ext] = ext_nodes[i];
+        num_ext++;
+      }
+    }
+
+    // Split the composite operators into the local and external
+    // columns
+    for (int k = 1; k < nlevels; k++) {
+      int n = range[k][mpi_rank + 1] - range[k][mpi_rank];
+      num_owned[k] = n;
+      rowp[k] = new int[n + 1];
+      browp[k] = new int[n + 1];
+      rowp[k][0] = browp[k][0] = 0;
+      for (int i = 0; i < n; i++) {
+        rowp[k][i + 1] = rowp[k][i];
+        browp[k][i + 1] = browp[k][i];
+        for (int jp = ptr[k][i]; jp < ptr[k][i + 1]; jp++) {
+          if (gcols[k][jp] < start || gcols[k][jp] >= end) {
+            browp[k][i + 1]++;
+          } else {
+            rowp[k][i + 1]++;
+          }
+        }
+      }
+
+      cols[k] = new int[rowp[k][n]];
+      vals[k] = new double[rowp[k][n]];
+      bcols[k] = new int[browp[k][n]];
+      bvals[k] = new double[browp[k][n]];
+      for (int i = 0; i < n; i++) {
+        int jl = rowp[k][i], je = browp[k][i];
+        for (int jp = ptr[k][i]; jp < ptr[k][i + 1]; jp++) {
+          int col = gcols[k][jp];
+          if (col < start || col >= end) {
+            int *item = (int *)bsearch(&col, ext_nodes, num_ext, sizeof(int),
+                                       compare_ints);
+            bcols[k][je] = item - ext_nodes;
+            bvals[k][je] = gvals[k][jp];
+            je++;
+          } else {
+            cols[k][jl] = col - start;
+            vals[k][jl] = gvals[k][jp];
+            jl++;
+          }
+        }
+      }
+    }
+
+    ghost = new TMRGhostExchange(comm, bsize, end - start, num_ext, ext_nodes);
+    ghost->incref();
+    x_ext = new TacsScalar[bsize * num_ext];
+    delete[] ext_nodes;
+  }
+
+  for (int k = 0; k < nlevels; k++) {
+    delete[] ptr[k];
+    delete[] gcols[k];
+    delete[] gvals[k];
+  }
+  delete[] ptr;
+  delete[] gcols;
+  delete[] gvals;
+
+  if (fail) {
+    return 0;
+  }
+
+  // Check the composite operators against the level-by-level
+  // restriction of a probe vector
+  TACSBVec **y = new TACSBVec *[nlevels];
+  TACSBVec **z = new TACSBVec *[nlevels];
+  for (int k = 0; k < nlevels; k++) {
+    y[k] = assembler[k]->createDesignVec();
+    y[k]->incref();
+    z[k] = assembler[k]->createDesignVec();
+    z[k]->incref();
+  }
+
+  TacsScalar *y0;
+  int size = y[0]->getArray(&y0);
+  for (int i = 0; i < size; i++) {
+    y0[i] = 1.0 + 0.5 * sin(1.0 * (bsize * start + i));
+  }
+  z[0]->copyValues(y[0]);
+
+  for (int k = 0; k < nlevels - 1; k++) {
+    interp[k]->multWeightTranspose(y[k], y[k + 1]);
+  }
+  beginRestriction(z);
+  endRestriction(z);
+
+  double err[2] = {0.0, 0.0};
+  for (int k = 1; k < nlevels; k++) {
+    TacsScalar *ya, *za;
+    size = y[k]->getArray(&ya);
+    z[k]->getArray(&za);
+    for (int i = 0; i < size; i++) {
+      double e = fabs(TacsRealPart(ya[i] - za[i]));
+      double v = fabs(TacsRealPart(ya[i]));
+      err[0] = (e > err[0] ? e : err[0]);
+      err[1] = (v > err[1] ? v : err[1]);
+    }
+  }
+  MPI_Allreduce(MPI_IN_PLACE, err, 2, MPI_DOUBLE, MPI_MAX, comm);
+
+  for (int k = 0; k < nlevels; k++) {
+    y[k]->decref();
+    z[k]->decref();
+  }
+  delete[] y;
+  delete[] z;
+
+  // The negated test also rejects a non-finite error
+  if (!(err[0] <= TMR_COMPOSITE_CHECK_TOL * err[1])) {
+    if (mpi_rank == 0) {
+      fprintf(stderr,
+              "TMRDesignRestriction: Composite restriction does not match "
+              "the level-by-level restriction, max error %e\n",
+              err[0]);
+    }
+    freeOperators();
+    return 0;
+  }
+
+  return 1;
+}
+
+/*
+  Begin restricting the design values from x[0] to the coarser levels
+
+  The exchange of the external values is started, and the products
+  with the locally owned values are computed. The values x[0] must not
+  be modified before endRestriction is called.
+*/
+void TMRDesignRestriction::beginRestriction(TACSBVec *x[]) {
+  TacsScalar *x0;
+  x[0]->getArray(&x0);
+  ghost->beginForward(x0);
+
+  for (int k = 1; k < nlevels; k++) {
+    TacsScalar *y;
+    x[k]->getArray(&y);
+    for (int i = 0; i < num_owned[k]; i++) {
+      TacsScalar *yb = &y[bsize * i];
+      for (int ii = 0; ii < bsize; ii++) {
+        yb[ii] = 0.0;
+      }
+      for (int jp = rowp[k][i]; jp < rowp[k][i + 1]; jp++) {
+        const TacsScalar *xb = &x0[bsize * cols[k][jp]];
+        for (int ii = 0; ii < bsize; ii++) {
+          yb[ii] += vals[k][jp] * xb[ii];
+        }
+      }
+    }
+  }
+}
+
+/*
+  Finish the exchange and add the products with the external values
+*/
+void TMRDesignRestriction::endRestriction(TACSBVec *x[]) {
+  ghost->endForward(x_ext);
+
+  for (int k = 1; k < nlevels; k++) {
+    TacsScalar *y;
+    x[k]->getArray(&y);
+    for (int i = 0; i < num_owned[k]; i++) {
+      TacsScalar *yb = &y[bsize * i];
+      for (int jp = browp[k][i]; jp < browp[k][i + 1]; jp++) {
+        const TacsScalar *xb = &x_ext[bsize * bcols[k][jp]];
+        for (int ii = 0; ii < bsize; ii++) {
+          yb[ii] += bvals[k][jp] * xb[ii];
+        }
+      }
+    }
+  }
+}
+
+/*
+  Get the memory used by the composite operators
+*/
+long int TMRDesignRestriction::getMemoryUsage() {
+  long int usage = 0;
+  for (int k = 1; k < nlevels; k++) {
+    if (rowp[k]) {
+      int n = num_owned[k];
+      usage += 2 * (n + 1) * sizeof(int);
+      usage += (rowp[k][n] + browp[k][n]) * (sizeof(int) + sizeof(double));
+    }
+  }
+  usage += bsize * num_ext * sizeof(TacsScalar);
+  return usage;
+}
@@ -0,0 +1,105 @@
+/*
+  This file is part of the package TMR for adaptive mesh refinement.
+
+  Copyright (C) 2015 Georgia Tech Research Corporation.
+  Additional copyright (C) 2015 Graeme Kennedy.
+  All rights reserved.
+
+  TMR is licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this software except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef TMR_DESIGN_RESTRICTION_H
+#define TMR_DESIGN_RESTRICTION_H
+
+#include "TACSAssembler.h"
+#include "TMRGhostExchange.h"
+#include "TMROctForest.h"
+#include "TMRQuadForest.h"
+
+/*
+  Composite restriction of the design variables to all levels
+
+  The filters restrict the design variables from each level to the
+  next coarser level with TACSBVecInterp::multWeightTranspose, which
+  computes x[k+1] = D^{-1} P^{T} x[k], where P is the interpolation
+  from level k+1 to level k and D = diag(P^{T} e). Each restriction is
+  a fixed linear map, so the restriction from the finest level to
+  level k is the product of these maps. This class forms the rows of
+  each product from the interpolation rows recorded by the forests.
+
+  The design variables on all levels are then computed from the finest
+  level with a single exchange of the external values, through a plan
+  of persistent requests, instead of one exchange per level. The
+  products with the locally owned values are computed while the
+  external values are exchanged.
+
+  The composite operators are only kept if they have few enough
+  non-zeros compared to the level-by-level restriction, and if they
+  reproduce the level-by-level restriction when they are initialized.
+*/
+class TMRDesignRestriction : public TACSObject {
+ public:
+  TMRDesignRestriction(int _nlevels, TACSAssembler *_assembler[]);
+  ~TMRDesignRestriction();
+
+  // Create the interpolation from level+1 to level and record its rows
+  void createInterpolation(int level, TMROctForest *fine, TMROctForest *coarse,
+                           TACSBVecInterp *interp);
+  void createInterpolation(int level, TMRQuadForest *fine,
+                           TMRQuadForest *coarse, TACSBVecInterp *interp);
+
+  // Form the composite operators (returns 1 if they can be used)
+  int initialize(TACSBVecInterp *interp[]);
+
+  // Restrict the design values from x[0] to the coarser levels
+  void beginRestriction(TACSBVec *x[]);
+  void endRestriction(TACSBVec *x[]);
+
+  // Get the memory used by the composite operators
+  long int getMemoryUsage();
+
+ private:
+  void recordRows(int level, int nrows, const int *rows, const int *ptr,
+                  const int *vars, const double *weights);
+  void computeCoarseRows(int level, const int *cptr, const int *ccols,
+                         const double *cvals, int **_ptr, int **_cols,
+                         double **_vals);
+  void freeRecordedRows();
+  void freeOperators();
+
+  MPI_Comm comm;
+  int nlevels, bsize;
+  TACSAssembler **assembler;
+
+  // The ownership ranges of the design nodes on each level
+  int **range;
+
+  // The interpolation rows recorded for each level
+  int *num_rows;
+  int **rows, **rows_ptr, **rows_vars;
+  double **rows_weights;
+
+  // The composite operator for each coarse level, split into the
+  // columns owned by this processor (local indices) and the external
+  // columns (indices into the external values)
+  int *num_owned;
+  int **rowp, **cols, **browp, **bcols;
+  double **vals, **bvals;
+
+  // The exchange of the external values on the finest level
+  int num_ext;
+  TMRGhostExchange *ghost;
+  TacsScalar *x_ext;
+};
+
+#endif  // TMR_DESIGN_RESTRICTION_H
@@ -0,0 +1,197 @@
+/*
+  This file is part of the package TMR for adaptive mesh refinement.
+
+  Copyright (C) 2015 Georgia Tech Research Corporation.
+  Additional copyright (C) 2015 Graeme Kennedy.
+  All rights reserved.
+
+  TMR is licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this software except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "TMRFloatMat.h"
+
+/*
+  Copy the values of the parallel matrix in single precision
+*/
+TMRFloatMat::TMRFloatMat(TACSParallelMat *_mat) {
+  mat = _mat;
+  mat->incref();
+
+  // Get the number of rows and the number of rows that are coupled
+  // to the external variables
+  int nc;
+  mat->getRowMap(&bsize, &nrows, &nc);
+  next_rows = nc;
+
+  BCSRMat *Aloc, *Bext;
+  mat->getBCSRMat(&Aloc, &Bext);
+
+  // Copy the values from the local block
+  TacsScalar *A;
+  Aloc->getArrays(NULL, NULL, NULL, &rowp, &cols, &A);
+  int asize = bsize * bsize * rowp[nrows];
+  Avals = new float[asize];
+  for (int i = 0; i < asize; i++) {
+    Avals[i] = TacsRealPart(A[i]);
+  }
+
+  // Copy the values from the external block
+  TacsScalar *B;
+  Bext->getArrays(NULL, NULL, NULL, &browp, &bcols, &B);
+  int bsz = bsize * bsize * browp[next_rows];
+  Bvals = new float[bsz];
+  for (int i = 0; i < bsz; i++) {
+    Bvals[i] = TacsRealPart(B[i]);
+  }
+
+  // Set up the exchange of the external column values
+  TACSBVecDistribute *ext_dist;
+  mat->getExtColMap(&ext_dist);
+  const int *ext_nodes;
+  num_ext = ext_dist->getIndices()->getIndices(&ext_nodes);
+  ghost = new TMRGhostExchange(ext_dist->getMPIComm(), bsize, nrows, num_ext,
+                               ext_nodes);
+  ghost->incref();
+
+  int size = bsize * num_ext;
+  x_ext = new TacsScalar[size];
+  memset(x_ext, 0, size * sizeof(TacsScalar));
+}
+
+/*
+  Free the single-precision values
+*/
+TMRFloatMat::~TMRFloatMat() {
+  mat->decref();
+  ghost->decref();
+  delete[] Avals;
+  delete[] Bvals;
+  delete[] x_ext;
+}
+
+/*
+  Compute y = A*x
+
+  The values of the external columns are gathered while the product
+  with the local block is computed.
+*/
+void TMRFloatMat::mult(TACSBVec *xvec, TACSBVec *yvec) {
+  TacsScalar *x, *y;
+  xvec->getArray(&x);
+  yvec->getArray(&y);
+
+  ghost->beginForward(x);
+
+  if (bsize == 1) {
+    for (int i = 0; i < nrows; i++) {
+      TacsScalar s = 0.0;
+      for (int jp = rowp[i]; jp < rowp[i + 1]; jp++) {
+        s += (double)Avals[jp] * x[cols[jp]];
+      }
+      y[i] = s;
+    }
+  } else {
+    const int b2 = bsize * bsize;
+    for (int i = 0; i < nrows; i++) {
+      for (int ii = 0; ii < bsize; ii++) {
+        TacsScalar s = 0.0;
+        for (int jp = rowp[i]; jp < rowp[i + 1]; jp++) {
+          const float *a = &Avals[b2 * jp + bsize * ii];
+          const TacsScalar *xb = &x[bsize * cols[jp]];
+          for (int jj = 0; jj < bsize; jj++) {
+            s += (double)a[jj] * xb[jj];
+          }
+        }
+        y[bsize * i + ii] = s;
+      }
+    }
+  }
+
+  ghost->endForward(x_ext);
+
+  // Add the contributions from the external columns to the last rows
+  TacsScalar *yb = &y[bsize * (nrows - next_rows)];
+  if (bsize == 1) {
+    for (int i = 0; i < next_rows; i++) {
+      TacsScalar s = 0.0;
+      for (int jp = browp[i]; jp < browp[i + 1]; jp++) {
+        s += (double)Bvals[jp] * x_ext[bcols[jp]];
+      }
+      yb[i] += s;
+    }
+  } else {
+    const int b2 = bsize * bsize;
+    for (int i = 0; i < next_rows; i++) {
+      for (int ii = 0; ii < bsize; ii++) {
+        TacsScalar s = 0.0;
+        for (int jp = browp[i]; jp < browp[i + 1]; jp++) {
+          const float *a = &Bvals[b2 * jp + bsize * ii];
+          const TacsScalar *xb = &x_ext[bsize * bcols[jp]];
+          for (int jj = 0; jj < bsize; jj++) {
+            s += (double)a[jj] * xb[jj];
+          }
+        }
+        yb[bsize * i + ii] += s;
+      }
+    }
+  }
+}
+
+/*
+  Compute y = A^{T}*x
+
+  The products with the external block are computed first and added
+  back to the owners of the external columns while the product with
+  the local block is computed.
+*/
+void TMRFloatMat::multTranspose(TACSBVec *xvec, TACSBVec *yvec) {
+  TacsScalar *x, *y;
+  xvec->getArray(&x);
+  int size = yvec->getArray(&y);
+
+  // Compute the contributions to the external columns
+  const int b2 = bsize * bsize;
+  memset(x_ext, 0, bsize * num_ext * sizeof(TacsScalar));
+
+  const TacsScalar *xb = &x[bsize * (nrows - next_rows)];
+  for (int i = 0; i < next_rows; i++) {
+    for (int jp = browp[i]; jp < browp[i + 1]; jp++) {
+      const float *a = &Bvals[b2 * jp];
+      TacsScalar *ye = &x_ext[bsize * bcols[jp]];
+      for (int ii = 0; ii < bsize; ii++) {
+        const TacsScalar xi = xb[bsize * i + ii];
+        for (int jj = 0; jj < bsize; jj++) {
+          ye[jj] += (double)a[bsize * ii + jj] * xi;
+        }
+      }
+    }
+  }
+
+  ghost->beginReverse(x_ext);
+
+  memset(y, 0, size * sizeof(TacsScalar));
+  for (int i = 0; i < nrows; i++) {
+    for (int jp = rowp[i]; jp < rowp[i + 1]; jp++) {
+      const float *a = &Avals[b2 * jp];
+      TacsScalar *yb = &y[bsize * cols[jp]];
+      for (int ii = 0; ii < bsize; ii++) {
+        const TacsScalar xi = x[bsize * i + ii];
+        for (int jj = 0; jj < bsize; jj++) {
+          yb[jj] += (double)a[bsize * ii + jj] * xi;
+        }
+      }
+    }
+  }
+
+  ghost->endReverse(y);
+}
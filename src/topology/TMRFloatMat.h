@@ -0,0 +1,79 @@
+/*
+  This file is part of the package TMR for adaptive mesh refinement.
+
+  Copyright (C) 2015 Georgia Tech Research Corporation.
+  Additional copyright (C) 2015 Graeme Kennedy.
+  All rights reserved.
+
+  TMR is licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this software except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef TMR_FLOAT_MAT_H
+#define TMR_FLOAT_MAT_H
+
+#include "TACSAssembler.h"
+#include "TMRGhostExchange.h"
+
+/*
+  A single-precision copy of the values of a TACSParallelMat
+
+  The filter matrices are applied many times within the Neumann series
+  of each filter application so that the products are limited by the
+  memory traffic of the matrix. This class stores the entries of the
+  local and external blocks in single precision and accumulates the
+  products in TacsScalar, roughly halving the traffic of the matrix
+  values. The non-zero pattern and the external column distribution
+  are shared with the original matrix, which is referenced by this
+  object. Only the real part of the entries is retained.
+
+  The values of the external columns are exchanged through a plan of
+  persistent requests that is set up once for the matrix, since the
+  communication pattern is the same for every product.
+
+  The values are copied on construction, so a new object must be
+  created if the entries of the original matrix change.
+*/
+class TMRFloatMat : public TACSObject {
+ public:
+  TMRFloatMat(TACSParallelMat *_mat);
+  ~TMRFloatMat();
+
+  // Compute y = A*x
+  void mult(TACSBVec *x, TACSBVec *y);
+
+  // Compute y = A^{T}*x
+  void multTranspose(TACSBVec *x, TACSBVec *y);
+
+ private:
+  // The original matrix that owns the non-zero pattern
+  TACSParallelMat *mat;
+
+  // The block size, the number of block rows and the number of rows
+  // with entries in the external block
+  int bsize, nrows, next_rows;
+
+  // The non-zero pattern and values of the local block
+  const int *rowp, *cols;
+  float *Avals;
+
+  // The non-zero pattern and values of the external block
+  const int *browp, *bcols;
+  float *Bvals;
+
+  // The exchange of the external column values
+  int num_ext;
+  TMRGhostExchange *ghost;
+  TacsScalar *x_ext;
+};
+
+#endif  // TMR_FLOAT_MAT_H
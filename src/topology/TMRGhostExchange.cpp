@@ -0,0 +1,262 @@
+/*
+  This file is part of the package TMR for adaptive mesh refinement.
+
+  Copyright (C) 2015 Georgia Tech Research Corporation.
+  Additional copyright (C) 2015 Graeme Kennedy.
+  All rights reserved.
+
+  TMR is licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this software except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "TMRGhostExchange.h"
+
+#include <string.h>
+
+/*
+  Find the processor that owns the given node from the ownership
+  ranges
+*/
+static int TMRFindOwner(int node, int mpi_size, const int *range) {
+  int low = 0, high = mpi_size - 1;
+  while (low < high) {
+    int mid = (low + high + 1) / 2;
+    if (range[mid] <= node) {
+      low = mid;
+    } else {
+      high = mid - 1;
+    }
+  }
+  return low;
+}
+
+/*
+  Set up the exchange plan
+
+  This call is collective on the communicator. The communicator is
+  duplicated so that the persistent requests cannot match any other
+  messages.
+
+  input:
+  comm:       the communicator
+  bsize:      the block size of the values
+  num_owned:  the number of nodes owned by this processor
+  num_ext:    the number of external nodes
+  ext_nodes:  the global indices of the external nodes
+*/
+TMRGhostExchange::TMRGhostExchange(MPI_Comm _comm, int _bsize, int num_owned,
+                                   int num_ext, const int *ext_nodes) {
+  MPI_Comm_dup(_comm, &comm);
+  bsize = _bsize;
+
+  int mpi_rank, mpi_size;
+  MPI_Comm_rank(comm, &mpi_rank);
+  MPI_Comm_size(comm, &mpi_size);
+
+  // Compute the ownership ranges
+  int *range = new int[mpi_size + 1];
+  range[0] = 0;
+  MPI_Allgather(&num_owned, 1, MPI_INT, &range[1], 1, MPI_INT, comm);
+  for (int k = 0; k < mpi_size; k++) {
+    range[k + 1] += range[k];
+  }
+
+  // Count up the external nodes owned by each processor
+  int *owner = new int[num_ext];
+  int *recv_count = new int[mpi_size];
+  memset(recv_count, 0, mpi_size * sizeof(int));
+  for (int i = 0; i < num_ext; i++) {
+    owner[i] = TMRFindOwner(ext_nodes[i], mpi_size, range);
+    recv_count[owner[i]]++;
+  }
+
+  // Find the number of owned nodes requested by each processor
+  int *send_count = new int[mpi_size];
+  MPI_Alltoall(recv_count, 1, MPI_INT, send_count, 1, MPI_INT, comm);
+
+  int *recv_offset = new int[mpi_size + 1];
+  int *send_offset = new int[mpi_size + 1];
+  recv_offset[0] = send_offset[0] = 0;
+  num_recv_procs = num_send_procs = 0;
+  for (int k = 0; k < mpi_size; k++) {
+    recv_offset[k + 1] = recv_offset[k] + recv_count[k];
+    send_offset[k + 1] = send_offset[k] + send_count[k];
+    if (recv_count[k] > 0) {
+      num_recv_procs++;
+    }
+    if (send_count[k] > 0) {
+      num_send_procs++;
+    }
+  }
+
+  // Order the external nodes by their owners
+  int *ext_global = new int[num_ext];
+  recv_nodes = new int[num_ext];
+  for (int i = 0; i < num_ext; i++) {
+    int pos = recv_offset[owner[i]];
+    ext_global[pos] = ext_nodes[i];
+    recv_nodes[pos] = i;
+    recv_offset[owner[i]]++;
+  }
+  for (int k = mpi_size; k > 0; k--) {
+    recv_offset[k] = recv_offset[k - 1];
+  }
+  recv_offset[0] = 0;
+
+  // Send the requested nodes to their owners and convert them to
+  // local indices
+  int num_send = send_offset[mpi_size];
+  send_nodes = new int[num_send];
+  MPI_Alltoallv(ext_global, recv_count, recv_offset, MPI_INT, send_nodes,
+                send_count, send_offset, MPI_INT, comm);
+  for (int i = 0; i < num_send; i++) {
+    send_nodes[i] -= range[mpi_rank];
+  }
+
+  // Record the processors that take part in the exchange
+  recv_procs = new int[num_recv_procs];
+  recv_ptr = new int[num_recv_procs + 1];
+  send_procs = new int[num_send_procs];
+  send_ptr = new int[num_send_procs + 1];
+  recv_ptr[0] = send_ptr[0] = 0;
+  for (int k = 0, nr = 0, ns = 0; k < mpi_size; k++) {
+    if (recv_count[k] > 0) {
+      recv_procs[nr] = k;
+      recv_ptr[nr + 1] = recv_offset[k + 1];
+      nr++;
+    }
+    if (send_count[k] > 0) {
+      send_procs[ns] = k;
+      send_ptr[ns + 1] = send_offset[k + 1];
+      ns++;
+    }
+  }
+
+  delete[] range;
+  delete[] owner;
+  delete[] recv_count;
+  delete[] send_count;
+  delete[] recv_offset;
+  delete[] send_offset;
+  delete[] ext_global;
+
+  // Allocate the buffers and create the persistent requests
+  send_buf = new TacsScalar[bsize * num_send];
+  recv_buf = new TacsScalar[bsize * num_ext];
+
+  const int forward_tag = 0, reverse_tag = 1;
+  int num_requests = num_send_procs + num_recv_procs;
+  forward_requests = new MPI_Request[num_requests];
+  reverse_requests = new MPI_Request[num_requests];
+
+  for (int i = 0; i < num_recv_procs; i++) {
+    TacsScalar *buf = &recv_buf[bsize * recv_ptr[i]];
+    int size = bsize * (recv_ptr[i + 1] - recv_ptr[i]);
+    MPI_Recv_init(buf, size, TACS_MPI_TYPE, recv_procs[i], forward_tag, comm,
+                  &forward_requests[i]);
+    MPI_Send_init(buf, size, TACS_MPI_TYPE, recv_procs[i], reverse_tag, comm,
+                  &reverse_requests[num_send_procs + i]);
+  }
+  for (int i = 0; i < num_send_procs; i++) {
+    TacsScalar *buf = &send_buf[bsize * send_ptr[i]];
+    int size = bsize * (send_ptr[i + 1] - send_ptr[i]);
+    MPI_Send_init(buf, size, TACS_MPI_TYPE, send_procs[i], forward_tag, comm,
+                  &forward_requests[num_recv_procs + i]);
+    MPI_Recv_init(buf, size, TACS_MPI_TYPE, send_procs[i], reverse_tag, comm,
+                  &reverse_requests[i]);
+  }
+}
+
+/*
+  Free the persistent requests and the exchange data
+*/
+TMRGhostExchange::~TMRGhostExchange() {
+  int num_requests = num_send_procs + num_recv_procs;
+  for (int i = 0; i < num_requests; i++) {
+    MPI_Request_free(&forward_requests[i]);
+    MPI_Request_free(&reverse_requests[i]);
+  }
+  delete[] forward_requests;
+  delete[] reverse_requests;
+  MPI_Comm_free(&comm);
+
+  delete[] send_procs;
+  delete[] send_ptr;
+  delete[] send_nodes;
+  delete[] recv_procs;
+  delete[] recv_ptr;
+  delete[] recv_nodes;
+  delete[] send_buf;
+  delete[] recv_buf;
+}
+
+/*
+  Pack the owned values and start the forward exchange
+*/
+void TMRGhostExchange::beginForward(const TacsScalar *x) {
+  int num_send = send_ptr[num_send_procs];
+  for (int i = 0; i < num_send; i++) {
+    const TacsScalar *xb = &x[bsize * send_nodes[i]];
+    for (int j = 0; j < bsize; j++) {
+      send_buf[bsize * i + j] = xb[j];
+    }
+  }
+
+  MPI_Startall(num_send_procs + num_recv_procs, forward_requests);
+}
+
+/*
+  Complete the forward exchange and set the external values
+*/
+void TMRGhostExchange::endForward(TacsScalar *x_ext) {
+  MPI_Waitall(num_send_procs + num_recv_procs, forward_requests,
+              MPI_STATUSES_IGNORE);
+
+  int num_recv = recv_ptr[num_recv_procs];
+  for (int i = 0; i < num_recv; i++) {
+    TacsScalar *xb = &x_ext[bsize * recv_nodes[i]];
+    for (int j = 0; j < bsize; j++) {
+      xb[j] = recv_buf[bsize * i + j];
+    }
+  }
+}
+
+/*
+  Pack the external values and start the reverse exchange
+*/
+void TMRGhostExchange::beginReverse(const TacsScalar *x_ext) {
+  int num_recv = recv_ptr[num_recv_procs];
+  for (int i = 0; i < num_recv; i++) {
+    const TacsScalar *xb = &x_ext[bsize * recv_nodes[i]];
+    for (int j = 0; j < bsize; j++) {
+      recv_buf[bsize * i + j] = xb[j];
+    }
+  }
+
+  MPI_Startall(num_send_procs + num_recv_procs, reverse_requests);
+}
+
+/*
+  Complete the reverse exchange and add the values to the owned nodes
+*/
+void TMRGhostExchange::endReverse(TacsScalar *x) {
+  MPI_Waitall(num_send_procs + num_recv_procs, reverse_requests,
+              MPI_STATUSES_IGNORE);
+
+  int num_send = send_ptr[num_send_procs];
+  for (int i = 0; i < num_send; i++) {
+    TacsScalar *xb = &x[bsize * send_nodes[i]];
+    for (int j = 0; j < bsize; j++) {
+      xb[j] += send_buf[bsize * i + j];
+    }
+  }
+}
@@ -0,0 +1,78 @@
+/*
+  This file is part of the package TMR for adaptive mesh refinement.
+
+  Copyright (C) 2015 Georgia Tech Research Corporation.
+  Additional copyright (C) 2015 Graeme Kennedy.
+  All rights reserved.
+
+  TMR is licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this software except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef TMR_GHOST_EXCHANGE_H
+#define TMR_GHOST_EXCHANGE_H
+
+#include "TACSAssembler.h"
+
+/*
+  A fixed ghost-exchange plan built from persistent MPI requests
+
+  The nodes are owned in contiguous ranges ordered by rank, as in the
+  TACSNodeMap. Each processor lists the global indices of the external
+  (ghost) nodes it requires. The processors that own or reference each
+  node, the send/receive buffers and the persistent requests are set up
+  once on construction, so that each exchange only packs the values
+  and starts the requests.
+
+  The forward exchange gathers the owned values into the external
+  values. The reverse exchange adds the external values back to their
+  owners. Only one exchange may be active at a time, and the values
+  may be computed between the begin and end calls to overlap the
+  communication.
+*/
+class TMRGhostExchange : public TACSObject {
+ public:
+  TMRGhostExchange(MPI_Comm _comm, int _bsize, int num_owned, int num_ext,
+                   const int *ext_nodes);
+  ~TMRGhostExchange();
+
+  // Gather the external values from the owners: x_ext <- x
+  void beginForward(const TacsScalar *x);
+  void endForward(TacsScalar *x_ext);
+
+  // Add the external values to the owners: x += x_ext
+  void beginReverse(const TacsScalar *x_ext);
+  void endReverse(TacsScalar *x);
+
+ private:
+  MPI_Comm comm;
+  int bsize;
+
+  // The processors that reference owned nodes and the owned nodes
+  // (local indices) sent to each of them
+  int num_send_procs;
+  int *send_procs, *send_ptr, *send_nodes;
+
+  // The processors that own external nodes and the external nodes
+  // (indices into the external values) received from each of them
+  int num_recv_procs;
+  int *recv_procs, *recv_ptr, *recv_nodes;
+
+  // The buffers for the owned and external values
+  TacsScalar *send_buf, *recv_buf;
+
+  // The persistent requests for the forward and reverse exchanges,
+  // with the receives ordered before the sends
+  MPI_Request *forward_requests, *reverse_requests;
+};
+
+#endif  // TMR_GHOST_EXCHANGE_H
@@ -93,14 +93,33 @@ void TMRHelmholtzFilter::initialize_helmholtz(double helmholtz_radius) {
   helmholtz_rhs->incref();
   helmholtz_psi->incref();
 
-  // Create the multigrid object
+  // Allocate the initial guesses for each design variable component.
+  // The filtered design variables change slowly between optimization
+  // iterations so the previous solution is a good starting point.
+  num_guesses = assembler[0]->getDesignVarsPerNode();
+  filter_guess = new TACSBVec *[num_guesses];
+  transpose_guess = new TACSBVec *[num_guesses];
+  for (int k = 0; k < num_guesses; k++) {
+    filter_guess[k] = helmholtz_assembler[0]->createVec();
+    filter_guess[k]->incref();
+    transpose_guess[k] = helmholtz_assembler[0]->createVec();
+    transpose_guess[k]->incref();
+  }
+
+  // Create the multigrid object with a Chebyshev smoother on each of
+  // the levels of the filter hierarchy
   double helmholtz_omega = 0.5;
+  int use_galerkin = 0;
+  int use_coarse_direct_solve = 1;
+  int use_chebyshev_smoother = 1;
   if (oct_filter) {
     TMR_CreateTACSMg(nlevels, helmholtz_assembler, oct_filter, &helmholtz_mg,
-                     helmholtz_omega);
+                     helmholtz_omega, use_galerkin, use_coarse_direct_solve,
+                     use_chebyshev_smoother);
   } else {
     TMR_CreateTACSMg(nlevels, helmholtz_assembler, quad_filter, &helmholtz_mg,
-                     helmholtz_omega);
+                     helmholtz_omega, use_galerkin, use_coarse_direct_solve,
+                     use_chebyshev_smoother);
   }
   helmholtz_mg->incref();
 
@@ -141,6 +160,14 @@ TMRHelmholtzFilter::~TMRHelmholtzFilter() {
     helmholtz_assembler[k]->decref();
   }
   delete[] helmholtz_assembler;
+
+  for (int k = 0; k < num_guesses; k++) {
+    filter_guess[k]->decref();
+    transpose_guess[k]->decref();
+  }
+  delete[] filter_guess;
+  delete[] transpose_guess;
+
   temp->decref();
 }
 
@@ -228,8 +255,12 @@ void TMRHelmholtzFilter::applyFilter(TACSBVec *xvars) {
     helmholtz_rhs->beginSetValues(TACS_ADD_VALUES);
     helmholtz_rhs->endSetValues(TACS_ADD_VALUES);
 
-    // Solve for the filtered values of the design variables
-    helmholtz_ksm->solve(helmholtz_rhs, helmholtz_psi);
+    // Solve for the filtered values of the design variables, starting
+    // from the solution computed on the previous call
+    int zero_guess = 0;
+    helmholtz_psi->copyValues(filter_guess[k]);
+    helmholtz_ksm->solve(helmholtz_rhs, helmholtz_psi, zero_guess);
+    filter_guess[k]->copyValues(helmholtz_psi);
     helmholtz_assembler[0]->reorderVec(helmholtz_psi);
     helmholtz_assembler[0]->setVariables(helmholtz_psi);
 
@@ -288,8 +319,12 @@ void TMRHelmholtzFilter::applyTranspose(TACSBVec *input, TACSBVec *output) {
       hrhs[i] = xarr[vars_per_node * i + k];
     }
 
-    // Solve for the filtered values of the design variables
-    helmholtz_ksm->solve(helmholtz_rhs, helmholtz_psi);
+    // Solve for the filtered values of the design variables, starting
+    // from the solution computed on the previous call
+    int zero_guess = 0;
+    helmholtz_psi->copyValues(transpose_guess[k]);
+    helmholtz_ksm->solve(helmholtz_rhs, helmholtz_psi, zero_guess);
+    transpose_guess[k]->copyValues(helmholtz_psi);
     helmholtz_assembler[0]->reorderVec(helmholtz_psi);
 
     // Distribute the values from the solution
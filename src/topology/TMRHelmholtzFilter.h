@@ -56,6 +56,12 @@ class TMRHelmholtzFilter : public TMRConformFilter {
   TACSBVec *helmholtz_rhs, *helmholtz_psi;
   TACSBVec *helmholtz_vec;
 
+  // Solutions from the previous call used as initial guesses. There
+  // is one vector for each design variable component for both the
+  // filter and its transpose.
+  int num_guesses;
+  TACSBVec **filter_guess, **transpose_guess;
+
   // Temporary vector
   TACSBVec *temp;
 };
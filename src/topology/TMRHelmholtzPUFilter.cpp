@@ -21,10 +21,171 @@
 #include "TMRHelmholtzPUFilter.h"
 
 #include "TACSToFH5.h"
+#include "TMRHashFunction.h"
 #include "TMRHelmholtzModel.h"
 #include "TMRMatrixCreator.h"
 #include "TMRMatrixFilterModel.h"
 #include "TMR_TACSCreator.h"
+#include "tacslapack.h"
+
+/*
+  A stencil stored in the stencil cache
+*/
+class TMRPUStencil {
+ public:
+  TMRPUStencil(int _diag, int _npts, const double _normal[],
+               const double _Xrel[], const double _alpha[]) {
+    diag = _diag;
+    npts = _npts;
+    normal[0] = _normal[0];
+    normal[1] = _normal[1];
+    normal[2] = _normal[2];
+    Xrel = new double[3 * npts];
+    alpha = new double[npts];
+    memcpy(Xrel, _Xrel, 3 * npts * sizeof(double));
+    memcpy(alpha, _alpha, npts * sizeof(double));
+    next = NULL;
+  }
+  ~TMRPUStencil() {
+    delete[] Xrel;
+    delete[] alpha;
+  }
+
+  int diag, npts;
+  double normal[3];
+  double *Xrel, *alpha;
+  TMRPUStencil *next;
+};
+
+/*
+  Cache of the stencils computed during the filter initialization
+
+  The stencil is identified by its local geometric signature: the
+  position of the diagonal entry within the row, the node locations
+  relative to the diagonal node and the boundary normal (which is zero
+  for interior nodes). Nodes at the same level within uniform regions
+  of the mesh share the same signature so the stencil is computed once
+  and copied for the remaining nodes.
+*/
+class TMRPUStencilCache {
+ public:
+  static const int TABLE_SIZE = 1031;
+
+  TMRPUStencilCache() {
+    table = new TMRPUStencil *[TABLE_SIZE];
+    memset(table, 0, TABLE_SIZE * sizeof(TMRPUStencil *));
+    max_npts = 0;
+    Xrel = NULL;
+  }
+  ~TMRPUStencilCache() {
+    for (int i = 0; i < TABLE_SIZE; i++) {
+      TMRPUStencil *ptr = table[i];
+      while (ptr) {
+        TMRPUStencil *tmp = ptr;
+        ptr = ptr->next;
+        delete tmp;
+      }
+    }
+    delete[] table;
+    if (Xrel) {
+      delete[] Xrel;
+    }
+  }
+
+  /*
+    Find the stencil in the cache. If the stencil is found, copy the
+    weights to alpha and return 1, otherwise return 0.
+  */
+  int getStencil(int diag, int npts, const TacsScalar X[],
+                 const TacsScalar n[], double alpha[]) {
+    int bucket = computeSignature(diag, npts, X, n);
+
+    double tol = STENCIL_TOL * h;
+    for (TMRPUStencil *ptr = table[bucket]; ptr; ptr = ptr->next) {
+      if (ptr->diag == diag && ptr->npts == npts &&
+          fabs(ptr->normal[0] - normal[0]) <= STENCIL_TOL &&
+          fabs(ptr->normal[1] - normal[1]) <= STENCIL_TOL &&
+          fabs(ptr->normal[2] - normal[2]) <= STENCIL_TOL) {
+        int match = 1;
+        for (int i = 0; i < 3 * npts; i++) {
+          if (fabs(ptr->Xrel[i] - Xrel[i]) > tol) {
+            match = 0;
+            break;
+          }
+        }
+        if (match) {
+          memcpy(alpha, ptr->alpha, npts * sizeof(double));
+          return 1;
+        }
+      }
+    }
+
+    return 0;
+  }
+
+  /*
+    Add the stencil to the cache
+  */
+  void addStencil(int diag, int npts, const TacsScalar X[],
+                  const TacsScalar n[], const double alpha[]) {
+    int bucket = computeSignature(diag, npts, X, n);
+    TMRPUStencil *stencil = new TMRPUStencil(diag, npts, normal, Xrel, alpha);
+    stencil->next = table[bucket];
+    table[bucket] = stencil;
+  }
+
+ private:
+  // Compute the relative node locations and the hash bucket
+  int computeSignature(int diag, int npts, const TacsScalar X[],
+                       const TacsScalar n[]) {
+    if (npts > max_npts) {
+      if (Xrel) {
+        delete[] Xrel;
+      }
+      max_npts = npts;
+      Xrel = new double[3 * max_npts];
+    }
+
+    h = 0.0;
+    for (int i = 0; i < npts; i++) {
+      for (int k = 0; k < 3; k++) {
+        Xrel[3 * i + k] = TacsRealPart(X[3 * i + k] - X[3 * diag + k]);
+        if (fabs(Xrel[3 * i + k]) > h) {
+          h = fabs(Xrel[3 * i + k]);
+        }
+      }
+    }
+    for (int k = 0; k < 3; k++) {
+      normal[k] = TacsRealPart(n[k]);
+    }
+
+    uint32_t hash = TMRIntegerPairHash(diag, npts);
+    for (int k = 0; k < 3; k++) {
+      int q = (int)floor(QUANTIZE * normal[k] + 0.5);
+      hash = TMRIntegerPairHash(hash, (uint32_t)q);
+    }
+    if (h > 0.0) {
+      for (int i = 0; i < 3 * npts; i++) {
+        int q = (int)floor(QUANTIZE * Xrel[i] / h + 0.5);
+        hash = TMRIntegerPairHash(hash, (uint32_t)q);
+      }
+    }
+
+    return hash % TABLE_SIZE;
+  }
+
+  // Quantization used when hashing the relative node locations
+  static constexpr double QUANTIZE = 1e6;
+
+  // Relative tolerance used to match stencils
+  static constexpr double STENCIL_TOL = 1e-10;
+
+  TMRPUStencil **table;
+
+  // Data for the most recent signature
+  int max_npts;
+  double h, normal[3], *Xrel;
+};
 
 /*
   Find the boundary faces and set them as  and set them
@@ -347,10 +508,13 @@ TMRHelmholtzPUFilter::TMRHelmholtzPUFilter(int _N, int _nlevels,
   t1 = t2 = NULL;
   y1 = y2 = NULL;
   B = NULL;
+  Bf = NULL;
   Dinv = NULL;
   Tinv = NULL;
   y1 = y2 = NULL;
   temp = NULL;
+  use_stencil_cache = 1;
+  use_single_precision = 0;
 
   xraw = assembler[0]->createDesignVec();
   xraw->incref();
@@ -364,10 +528,13 @@ TMRHelmholtzPUFilter::TMRHelmholtzPUFilter(int _N, int _nlevels,
   t1 = t2 = NULL;
   y1 = y2 = NULL;
   B = NULL;
+  Bf = NULL;
   Dinv = NULL;
   Tinv = NULL;
   y1 = y2 = NULL;
   temp = NULL;
+  use_stencil_cache = 1;
+  use_single_precision = 0;
 
   xraw = assembler[0]->createDesignVec();
   xraw->incref();
@@ -386,6 +553,9 @@ TMRHelmholtzPUFilter::~TMRHelmholtzPUFilter() {
   if (B) {
     B->decref();
   }
+  if (Bf) {
+    Bf->decref();
+  }
   if (Dinv) {
     Dinv->decref();
   }
@@ -525,6 +695,12 @@ void TMRHelmholtzPUFilter::initialize() {
   nodeMap->getOwnerRange(&owner_range);
   MPI_Comm_rank(nodeMap->getMPIComm(), &mpi_rank);
 
+  // Create the stencil cache (if it is used)
+  TMRPUStencilCache *cache = NULL;
+  if (use_stencil_cache) {
+    cache = new TMRPUStencilCache();
+  }
+
   for (int i = 0; i < n; i++) {
     // Count up the number of columns in the row
     int num_acols = rowp[i + 1] - rowp[i];
@@ -569,16 +745,32 @@ void TMRHelmholtzPUFilter::initialize() {
     normals->getValues(1, &indices[diagonal_index], normal);
 
     // Find the stencil
-    if (normal[0] == 0.0 && normal[1] == 0.0 && normal[2] == 0.0) {
-      getInteriorStencil(diagonal_index, num_indices, X, alpha);
-    } else {
+    int is_interior =
+        (normal[0] == 0.0 && normal[1] == 0.0 && normal[2] == 0.0);
+    if (!is_interior) {
       TacsScalar invnorm =
           1.0 / sqrt(normal[0] * normal[0] + normal[1] * normal[1] +
                      normal[2] * normal[2]);
       normal[0] *= invnorm;
       normal[1] *= invnorm;
       normal[2] *= invnorm;
-      getBoundaryStencil(diagonal_index, normal, num_indices, X, alpha);
+    }
+
+    // Check whether the stencil has already been computed
+    int found = 0;
+    if (cache) {
+      found = cache->getStencil(diagonal_index, num_indices, X, normal, alpha);
+    }
+
+    if (!found) {
+      if (is_interior) {
+        getInteriorStencil(diagonal_index, num_indices, X, alpha);
+      } else {
+        getBoundaryStencil(diagonal_index, normal, num_indices, X, alpha);
+      }
+      if (cache) {
+        cache->addStencil(diagonal_index, num_indices, X, normal, alpha);
+      }
     }
 
     // Make the call-back to evaluate the weights
@@ -617,6 +809,9 @@ void TMRHelmholtzPUFilter::initialize() {
   // Free the node locations
   Xpts->decref();
   normals->decref();
+  if (cache) {
+    delete cache;
+  }
 
   // Allocate the vectors needed for the application of the filter
   Tinv = matrix_assembler->createVec();
@@ -649,6 +844,21 @@ void TMRHelmholtzPUFilter::initialize() {
     D++;
   }
 
+  // Create the single-precision copy of the matrix
+  if (use_single_precision) {
+    Bf = new TMRFloatMat(distMat);
+    Bf->incref();
+  }
+
+  // Compute the normalization
+  computeNormalization();
+}
+
+/*
+  Compute the normalization so that the filter maps a vector of unit
+  entries to itself
+*/
+void TMRHelmholtzPUFilter::computeNormalization() {
   // Apply the filter to create the normalization
   Tinv->set(1.0);
   y2->set(1.0);
@@ -656,7 +866,7 @@ void TMRHelmholtzPUFilter::initialize() {
 
   // Create the inverse of the T matrix
   TacsScalar *T, *ty;
-  size = Tinv->getArray(&T);
+  int size = Tinv->getArray(&T);
   y1->getArray(&ty);
   for (int i = 0; i < size; i++) {
     if (ty[0] != 0.0) {
@@ -669,6 +879,27 @@ void TMRHelmholtzPUFilter::initialize() {
   }
 }
 
+/*
+  Store and apply the matrix in single precision
+
+  If the filter has already been initialized, the normalization is
+  re-computed with the matrix that is used in the filter.
+*/
+void TMRHelmholtzPUFilter::setUseSinglePrecision(int flag) {
+  use_single_precision = flag;
+  if (B) {
+    if (flag && !Bf) {
+      Bf = new TMRFloatMat(B);
+      Bf->incref();
+      computeNormalization();
+    } else if (!flag && Bf) {
+      Bf->decref();
+      Bf = NULL;
+      computeNormalization();
+    }
+  }
+}
+
 /*
   Compute the action of the filter on the input vector using Horner's
   method
@@ -688,7 +919,11 @@ void TMRHelmholtzPUFilter::applyFilter(TACSBVec *in, TACSBVec *out) {
   // Apply Horner's method
   for (int n = 0; n < N; n++) {
     // Compute out = D^{-1}*B*out
-    B->mult(out, t2);
+    if (Bf) {
+      Bf->mult(out, t2);
+    } else {
+      B->mult(out, t2);
+    }
     kronecker(Dinv, t2, out);
 
     // Compute out = t1 + D^{-1}*B*out
@@ -712,7 +947,11 @@ void TMRHelmholtzPUFilter::applyTranspose(TACSBVec *in, TACSBVec *out) {
   for (int n = 0; n < N; n++) {
     // Compute B^{T}*D^{-1}*out
     kronecker(Dinv, out, t2);
-    B->multTranspose(t2, out);
+    if (Bf) {
+      Bf->multTranspose(t2, out);
+    } else {
+      B->multTranspose(t2, out);
+    }
 
     // Compute out = t1 + B^{T}*D^{-1}*out
     out->axpy(1.0, t1);
@@ -797,15 +1036,8 @@ void TMRHelmholtzPUFilter::setDesignVars(TACSBVec *xvec) {
     }
   }
 
-  assembler[0]->setDesignVars(x[0]);
-
   // Set the design variable values on all levels
-  for (int k = 0; k < nlevels - 1; k++) {
-    filter_interp[k]->multWeightTranspose(x[k], x[k + 1]);
-
-    // Set the design variable values
-    assembler[k + 1]->setDesignVars(x[k + 1]);
-  }
+  setLevelDesignVars();
 }
 
 /*
@@ -862,3 +1094,257 @@ void TMRHelmholtzPUFilter::addValues(TACSBVec *vec) {
     }
   }
 }
+
+/*
+  Compute the minimum norm, non-negative weights that satisfy the
+  Taylor series constraints for a stencil in dim spatial dimensions.
+
+  The input locations Xt are relative to the diagonal node. The
+  problem is
+
+  min 0.5*||w||^2  s.t.  A*w = b,  w >= 0
+
+  This is solved by an active-set method: the minimum norm solution
+  is computed for the free weights, negative weights are fixed at
+  zero, and the process is repeated until all free weights are
+  non-negative.
+*/
+static int computeMFilterStencil(int dim, double r, int diag, int npts,
+                                 const double Xt[], double alpha[]) {
+  memset(alpha, 0, npts * sizeof(double));
+  alpha[diag] = 1.0;
+  if (npts <= 1) {
+    return 1;
+  }
+
+  // Compute the normalization
+  double delta = 0.0;
+  for (int i = 0; i < npts; i++) {
+    double d = 0.0;
+    for (int k = 0; k < dim; k++) {
+      d += Xt[dim * i + k] * Xt[dim * i + k];
+    }
+    if (d > delta) {
+      delta = d;
+    }
+  }
+  delta = sqrt(delta);
+  if (delta == 0.0) {
+    return 1;
+  }
+
+  // Set the number of constraints: first and second derivatives
+  const int m = dim + (dim * (dim + 1)) / 2;
+  const int n = npts - 1;
+
+  // Compute the full constraint matrix (stored column-major)
+  double *A = new double[m * n];
+  int *index = new int[n];
+  for (int i = 0, j = 0; i < npts; i++) {
+    if (i != diag) {
+      const double *dx = &Xt[dim * i];
+      double *a = &A[m * j];
+      if (dim == 1) {
+        a[0] = dx[0] / delta;
+        a[1] = 0.5 * a[0] * a[0];
+      } else if (dim == 2) {
+        a[0] = dx[0] / delta;
+        a[1] = dx[1] / delta;
+        a[2] = 0.5 * a[0] * a[0];
+        a[3] = 0.5 * a[1] * a[1];
+        a[4] = a[0] * a[1];
+      } else {
+        a[0] = dx[0] / delta;
+        a[1] = dx[1] / delta;
+        a[2] = dx[2] / delta;
+        a[3] = 0.5 * a[0] * a[0];
+        a[4] = 0.5 * a[1] * a[1];
+        a[5] = 0.5 * a[2] * a[2];
+        a[6] = a[1] * a[2];
+        a[7] = a[0] * a[2];
+        a[8] = a[0] * a[1];
+      }
+      index[j] = i;
+      j++;
+    }
+  }
+
+  // Set the right-hand-side: H = r^2*I
+  double b[9];
+  memset(b, 0, sizeof(b));
+  for (int k = 0; k < dim; k++) {
+    b[dim + k] = r * r;
+  }
+
+  // Allocate space for the least-squares problems
+  int ldb = (m > n ? m : n);
+  int lwork = 10 * (m + n) + 64;
+  double *Af = new double[m * n];
+  double *bf = new double[ldb];
+  double *sv = new double[m < n ? m : n];
+  double *work = new double[lwork];
+  double *w = new double[n];
+  int *free_vars = new int[n];
+  for (int j = 0; j < n; j++) {
+    free_vars[j] = 1;
+    w[j] = 0.0;
+  }
+
+  int fail = 1;
+  for (int iter = 0; iter < n; iter++) {
+    // Form the constraint matrix for the free variables
+    int nf = 0;
+    for (int j = 0; j < n; j++) {
+      if (free_vars[j]) {
+        memcpy(&Af[m * nf], &A[m * j], m * sizeof(double));
+        nf++;
+      }
+    }
+    if (nf == 0) {
+      break;
+    }
+
+    // Compute the minimum norm solution for the free variables
+    memset(bf, 0, ldb * sizeof(double));
+    memcpy(bf, b, m * sizeof(double));
+    int nrhs = 1, rank, info;
+    int ldbf = (m > nf ? m : nf);
+    double rcond = 1e-12;
+    int mm = m;
+    LAPACKdgelss(&mm, &nf, &nrhs, Af, &mm, bf, &ldbf, sv, &rcond, &rank, work,
+                 &lwork, &info);
+    if (info != 0) {
+      break;
+    }
+
+    // Copy the solution and fix the negative weights at zero
+    int num_negative = 0;
+    for (int j = 0, jf = 0; j < n; j++) {
+      if (free_vars[j]) {
+        w[j] = bf[jf];
+        if (w[j] < 0.0) {
+          free_vars[j] = 0;
+          num_negative++;
+        }
+        jf++;
+      } else {
+        w[j] = 0.0;
+      }
+    }
+
+    if (num_negative == 0) {
+      fail = 0;
+      break;
+    }
+  }
+
+  // Set the interpolating coefficients based on the weights
+  for (int j = 0; j < n; j++) {
+    if (w[j] > 0.0) {
+      alpha[index[j]] = w[j] / (delta * delta);
+      alpha[diag] += w[j] / (delta * delta);
+    }
+  }
+
+  delete[] A;
+  delete[] index;
+  delete[] Af;
+  delete[] bf;
+  delete[] sv;
+  delete[] work;
+  delete[] w;
+  delete[] free_vars;
+
+  return fail;
+}
+
+/*
+  Create the M-filter with a default stencil computation
+*/
+TMRMFilter::TMRMFilter(int _N, int _nlevels, TACSAssembler *_assembler[],
+                       TMROctForest *_filter[], double _r)
+    : TMRHelmholtzPUFilter(_N, _nlevels, _assembler, _filter) {
+  dim = 3;
+  r = _r;
+}
+
+TMRMFilter::TMRMFilter(int _N, int _nlevels, TACSAssembler *_assembler[],
+                       TMRQuadForest *_filter[], double _r)
+    : TMRHelmholtzPUFilter(_N, _nlevels, _assembler, _filter) {
+  dim = 2;
+  r = _r;
+}
+
+/*
+  Compute the stencil at an interior node
+*/
+int TMRMFilter::getInteriorStencil(int diag, int npts, const TacsScalar X[],
+                                   double alpha[]) {
+  double *Xt = new double[dim * npts];
+  for (int i = 0; i < npts; i++) {
+    for (int k = 0; k < dim; k++) {
+      Xt[dim * i + k] = TacsRealPart(X[3 * i + k] - X[3 * diag + k]);
+    }
+  }
+
+  int fail = computeMFilterStencil(dim, r, diag, npts, Xt, alpha);
+  delete[] Xt;
+
+  return fail;
+}
+
+/*
+  Compute the stencil at a boundary node on the tangent plane
+*/
+int TMRMFilter::getBoundaryStencil(int diag, const TacsScalar n[], int npts,
+                                   const TacsScalar X[], double alpha[]) {
+  double *Xt = new double[(dim - 1) * npts];
+
+  if (dim == 2) {
+    double t[2];
+    t[0] = TacsRealPart(n[1]);
+    t[1] = -TacsRealPart(n[0]);
+    for (int i = 0; i < npts; i++) {
+      Xt[i] = (t[0] * TacsRealPart(X[3 * i] - X[3 * diag]) +
+               t[1] * TacsRealPart(X[3 * i + 1] - X[3 * diag + 1]));
+    }
+  } else {
+    // Pick the direction least aligned with the normal
+    double nrm[3];
+    nrm[0] = TacsRealPart(n[0]);
+    nrm[1] = TacsRealPart(n[1]);
+    nrm[2] = TacsRealPart(n[2]);
+    int index = 0;
+    if (fabs(nrm[1]) < fabs(nrm[index])) {
+      index = 1;
+    }
+    if (fabs(nrm[2]) < fabs(nrm[index])) {
+      index = 2;
+    }
+    double t[3] = {0.0, 0.0, 0.0};
+    t[index] = 1.0;
+
+    // Compute the in-plane directions t2 = t x n and t1 = n x t2
+    double t1[3], t2[3];
+    t2[0] = t[1] * nrm[2] - t[2] * nrm[1];
+    t2[1] = t[2] * nrm[0] - t[0] * nrm[2];
+    t2[2] = t[0] * nrm[1] - t[1] * nrm[0];
+    t1[0] = nrm[1] * t2[2] - nrm[2] * t2[1];
+    t1[1] = nrm[2] * t2[0] - nrm[0] * t2[2];
+    t1[2] = nrm[0] * t2[1] - nrm[1] * t2[0];
+
+    for (int i = 0; i < npts; i++) {
+      double d[3];
+      d[0] = TacsRealPart(X[3 * i] - X[3 * diag]);
+      d[1] = TacsRealPart(X[3 * i + 1] - X[3 * diag + 1]);
+      d[2] = TacsRealPart(X[3 * i + 2] - X[3 * diag + 2]);
+      Xt[2 * i] = t1[0] * d[0] + t1[1] * d[1] + t1[2] * d[2];
+      Xt[2 * i + 1] = t2[0] * d[0] + t2[1] * d[1] + t2[2] * d[2];
+    }
+  }
+
+  int fail = computeMFilterStencil(dim - 1, r, diag, npts, Xt, alpha);
+  delete[] Xt;
+
+  return fail;
+}
@@ -22,6 +22,7 @@
 #define TMR_HELMHOLTZ_PARTITION_UNITY_FILTER_H
 
 #include "TMRConformFilter.h"
+#include "TMRFloatMat.h"
 
 /*
   Create a partition of unity filter
@@ -52,6 +53,15 @@ class TMRHelmholtzPUFilter : public TMRConformFilter {
   // Set values/add values to the vector
   void addValues(TACSBVec *vec);
 
+  // Re-use stencils for nodes with the same local geometry. This
+  // assumes that the stencils depend only on the relative node
+  // locations and the boundary normal.
+  void setUseStencilCache(int flag) { use_stencil_cache = flag; }
+
+  // Store and apply the matrix B in single precision. The products
+  // are still accumulated in TacsScalar.
+  void setUseSinglePrecision(int flag);
+
   void initialize();
 
  private:
@@ -62,8 +72,14 @@ class TMRHelmholtzPUFilter : public TMRConformFilter {
   void applyTranspose(TACSBVec *in, TACSBVec *out);
 
  private:
+  // Compute the normalization Tinv so that the filter preserves constants
+  void computeNormalization();
+
   // The non-negative matrix M
-  TACSMat *B;
+  TACSParallelMat *B;
+
+  // The single-precision copy of B (if it is used)
+  TMRFloatMat *Bf;
 
   // The number of terms to include in the approximate inverse
   int N;
@@ -83,6 +99,12 @@ class TMRHelmholtzPUFilter : public TMRConformFilter {
   // The unfiltered design variable
   TACSBVec *xraw;
 
+  // Flag to indicate whether to cache the stencils
+  int use_stencil_cache;
+
+  // Flag to indicate whether to apply B in single precision
+  int use_single_precision;
+
   // Compute the Kronecker product
   void kronecker(TACSBVec *c, TACSBVec *x, TACSBVec *y = NULL);
 };
@@ -146,4 +168,36 @@ class TMRCallbackHelmholtzPUFilter : public TMRHelmholtzPUFilter {
                             const TacsScalar *, double *);
 };
 
+/*
+  Create a partition of unity filter that approximates the Helmholtz
+  filter with radius r.
+
+  The stencil weights are the minimum norm, non-negative weights that
+  reproduce the second-order Taylor series expansion of the Helmholtz
+  operator at each node. On the boundary, the stencil is computed on
+  the tangent plane to the surface.
+*/
+class TMRMFilter : public TMRHelmholtzPUFilter {
+ public:
+  TMRMFilter(int _N, int _nlevels, TACSAssembler *_assembler[],
+             TMROctForest *_filter[], double _r);
+  TMRMFilter(int _N, int _nlevels, TACSAssembler *_assembler[],
+             TMRQuadForest *_filter[], double _r);
+
+  // Compute the stencil at an interior node
+  int getInteriorStencil(int diagonal_index, int npts, const TacsScalar Xpts[],
+                         double alpha[]);
+
+  // Compute the stencil at a boundary node with the normal n
+  int getBoundaryStencil(int diagonal_index, const TacsScalar n[], int npts,
+                         const TacsScalar Xpts[], double alpha[]);
+
+ private:
+  // The spatial dimension of the filter
+  int dim;
+
+  // The filter radius
+  double r;
+};
+
 #endif  // TMR_HELMHOLTZ_PARTITION_UNITY_FILTER_H
@@ -22,6 +22,7 @@
 #define TMR_LAGRANGE_FILTER_H
 
 #include "TACSAssembler.h"
+#include "TMRDesignRestriction.h"
 #include "TMROctForest.h"
 #include "TMRQuadForest.h"
 #include "TMRTopoFilter.h"
@@ -45,6 +46,9 @@ class TMRLagrangeFilter : public TMRTopoFilter {
   TMRQuadForest *getFilterQuadForest();
   TMROctForest *getFilterOctForest();
 
+  // Get the memory used by the forests and design vectors on all levels
+  void getMemoryUsage(TMRMemoryUsage *usage);
+
   // Set the design variable values (including all local values)
   void setDesignVars(TACSBVec *x);
 
@@ -59,6 +63,18 @@ class TMRLagrangeFilter : public TMRTopoFilter {
     }
   }
 
+  // Gather the STL triangles on the root processor
+  int getSTLTriangles(int root, int k, double cutoff, int *ntris,
+                      TMR_STLTriangle **tris) {
+    if (oct_filter) {
+      return TMR_GenerateSTLTriangles(root, oct_filter[0], x[0], k, cutoff,
+                                      ntris, tris);
+    }
+    *ntris = 0;
+    *tris = NULL;
+    return 1;
+  }
+
  private:
   // Initialize the problem
   void initialize(int _nlevels, TACSAssembler *_assembler[],
@@ -75,6 +91,9 @@ class TMRLagrangeFilter : public TMRTopoFilter {
   // Design interpolation operators
   TACSBVecInterp **filter_interp;
 
+  // The composite restriction of the design variables (if any)
+  TMRDesignRestriction *restriction;
+
   // Create the design variable values at each level
   TACSBVec **x;
 };
@@ -20,10 +20,266 @@
 
 #include "TMRMatrixFilter.h"
 
+#include "TMRHashFunction.h"
 #include "TMRMatrixCreator.h"
 #include "TMRMatrixFilterModel.h"
 #include "TMR_TACSCreator.h"
 
+/*
+  A stencil stored in the element matrix cache
+
+  The stencil stores the element node locations relative to the first
+  node along with the element matrix computed for those nodes.
+*/
+class TMRFilterStencil {
+ public:
+  TMRFilterStencil(TACSElement *_elem, int _num_nodes, const TacsScalar *X,
+                   int _size) {
+    elem = _elem;
+    num_nodes = _num_nodes;
+    size = _size;
+    Xrel = new TacsScalar[3 * num_nodes];
+    mat = new TacsScalar[size * size];
+    for (int i = 0; i < num_nodes; i++) {
+      Xrel[3 * i] = X[3 * i] - X[0];
+      Xrel[3 * i + 1] = X[3 * i + 1] - X[1];
+      Xrel[3 * i + 2] = X[3 * i + 2] - X[2];
+    }
+    memset(mat, 0, size * size * sizeof(TacsScalar));
+    next = NULL;
+  }
+  ~TMRFilterStencil() {
+    delete[] Xrel;
+    delete[] mat;
+  }
+
+  TACSElement *elem;
+  int num_nodes, size;
+  TacsScalar *Xrel, *mat;
+  TMRFilterStencil *next;
+};
+
+/*
+  Cache of the element matrices used to assemble the filter matrix
+
+  The mass matrix integrand is independent of the position of the
+  element so that all elements with the same size, shape and order
+  (for instance, octants on the same refinement level of a uniform
+  region of the forest) share the same element matrix. The element
+  matrix is only computed once for each unique stencil and is then
+  re-used for all the remaining elements.
+*/
+class TMRFilterStencilCache {
+ public:
+  static const int TABLE_SIZE = 1031;
+
+  TMRFilterStencilCache() {
+    num_stencils = 0;
+    max_size = 0;
+    vars = res = NULL;
+    table = new TMRFilterStencil *[TABLE_SIZE];
+    memset(table, 0, TABLE_SIZE * sizeof(TMRFilterStencil *));
+  }
+  ~TMRFilterStencilCache() {
+    for (int i = 0; i < TABLE_SIZE; i++) {
+      TMRFilterStencil *ptr = table[i];
+      while (ptr) {
+        TMRFilterStencil *tmp = ptr;
+        ptr = ptr->next;
+        delete tmp;
+      }
+    }
+    delete[] table;
+    if (vars) {
+      delete[] vars;
+      delete[] res;
+    }
+  }
+
+  // Get the number of unique stencils computed so far
+  int getNumStencils() { return num_stencils; }
+
+  /*
+    Retrieve the element matrix for the given element, computing it
+    if this is the first time the stencil has been encountered
+  */
+  const TacsScalar *getElementMatrix(int index, TACSElement *elem,
+                                     int num_nodes, const TacsScalar *X) {
+    // Compute the length scale of the element
+    double h = 0.0;
+    for (int i = 1; i < num_nodes; i++) {
+      for (int k = 0; k < 3; k++) {
+        double d = fabs(TacsRealPart(X[3 * i + k] - X[k]));
+        if (d > h) {
+          h = d;
+        }
+      }
+    }
+
+    // Hash the quantized relative locations of the nodes
+    uint32_t hash = TMRIntegerPairHash(num_nodes, TMRPointerHash(elem));
+    if (h > 0.0) {
+      for (int i = 1; i < num_nodes; i++) {
+        for (int k = 0; k < 3; k++) {
+          double d = TacsRealPart(X[3 * i + k] - X[k]) / h;
+          int q = (int)floor(QUANTIZE * d + 0.5);
+          hash = TMRIntegerPairHash(hash, (uint32_t)q);
+        }
+      }
+    }
+    int bucket = hash % TABLE_SIZE;
+
+    // Search for a matching stencil within the tolerance
+    double tol = STENCIL_TOL * h;
+    for (TMRFilterStencil *ptr = table[bucket]; ptr; ptr = ptr->next) {
+      if (ptr->elem == elem && ptr->num_nodes == num_nodes) {
+        int match = 1;
+        for (int i = 1; i < num_nodes && match; i++) {
+          for (int k = 0; k < 3; k++) {
+            double d = TacsRealPart(X[3 * i + k] - X[k] - ptr->Xrel[3 * i + k]);
+            if (fabs(d) > tol) {
+              match = 0;
+              break;
+            }
+          }
+        }
+        if (match) {
+          return ptr->mat;
+        }
+      }
+    }
+
+    // No match was found: compute the element matrix
+    int size = elem->getVarsPerNode() * num_nodes;
+    if (size > max_size) {
+      if (vars) {
+        delete[] vars;
+        delete[] res;
+      }
+      max_size = size;
+      vars = new TacsScalar[max_size];
+      res = new TacsScalar[max_size];
+      memset(vars, 0, max_size * sizeof(TacsScalar));
+    }
+
+    TMRFilterStencil *stencil = new TMRFilterStencil(elem, num_nodes, X, size);
+    elem->addJacobian(index, 0.0, 1.0, 0.0, 0.0, X, vars, vars, vars, res,
+                      stencil->mat);
+    stencil->next = table[bucket];
+    table[bucket] = stencil;
+    num_stencils++;
+
+    return stencil->mat;
+  }
+
+ private:
+  // Quantization used when hashing the relative node locations
+  static constexpr double QUANTIZE = 1e6;
+
+  // Relative tolerance used to match stencils
+  static constexpr double STENCIL_TOL = 1e-10;
+
+  int num_stencils;
+  TMRFilterStencil **table;
+
+  // Temporary vectors used to evaluate the element matrix
+  int max_size;
+  TacsScalar *vars, *res;
+};
+
+/*
+  Assemble the matrix for the filter using the element matrix cache.
+
+  This adds the element matrices to the matrix, taking into account
+  the dependent nodes in the mesh, and performs the assembly.
+*/
+static void assembleFilterMatrix(TACSAssembler *matrix_assembler,
+                                 TACSMat *mat) {
+  TMRFilterStencilCache cache;
+
+  // Get the dependent node information
+  const int *dep_ptr = NULL, *dep_conn = NULL;
+  const double *dep_weights = NULL;
+  TACSBVecDepNodes *dep_nodes = matrix_assembler->getBVecDepNodes();
+  if (dep_nodes) {
+    dep_nodes->getDepNodes(&dep_ptr, &dep_conn, &dep_weights);
+  }
+
+  // Allocate space for the element data
+  int max_nodes = matrix_assembler->getMaxElementNodes();
+  TacsScalar *Xpts = new TacsScalar[3 * max_nodes];
+  int max_dep = max_nodes;
+  int *varp = new int[max_nodes + 1];
+  int *vars = new int[max_dep];
+  TacsScalar *weights = new TacsScalar[max_dep];
+
+  mat->zeroEntries();
+
+  int num_elements = matrix_assembler->getNumElements();
+  for (int i = 0; i < num_elements; i++) {
+    int len;
+    const int *nodes;
+    matrix_assembler->getElement(i, &len, &nodes);
+    TACSElement *elem = matrix_assembler->getElement(i, Xpts);
+
+    // Get the element matrix from the cache
+    const TacsScalar *Amat = cache.getElementMatrix(i, elem, len, Xpts);
+    int size = elem->getVarsPerNode() * len;
+
+    // Check if there are any dependent nodes
+    int has_dep = 0;
+    int num_vars = 0;
+    for (int j = 0; j < len; j++) {
+      if (nodes[j] >= 0) {
+        num_vars++;
+      } else {
+        int dep = -nodes[j] - 1;
+        num_vars += dep_ptr[dep + 1] - dep_ptr[dep];
+        has_dep = 1;
+      }
+    }
+
+    if (!has_dep) {
+      mat->addValues(len, nodes, len, nodes, size, size, Amat);
+    } else {
+      if (num_vars > max_dep) {
+        max_dep = num_vars;
+        delete[] vars;
+        delete[] weights;
+        vars = new int[max_dep];
+        weights = new TacsScalar[max_dep];
+      }
+
+      // Expand the dependent nodes in terms of the independent nodes
+      num_vars = 0;
+      varp[0] = 0;
+      for (int j = 0; j < len; j++) {
+        if (nodes[j] >= 0) {
+          vars[num_vars] = nodes[j];
+          weights[num_vars] = 1.0;
+          num_vars++;
+        } else {
+          int dep = -nodes[j] - 1;
+          for (int k = dep_ptr[dep]; k < dep_ptr[dep + 1]; k++, num_vars++) {
+            vars[num_vars] = dep_conn[k];
+            weights[num_vars] = dep_weights[k];
+          }
+        }
+        varp[j + 1] = num_vars;
+      }
+      mat->addWeightValues(len, varp, vars, weights, size, size, Amat);
+    }
+  }
+
+  mat->beginAssembly();
+  mat->endAssembly();
+
+  delete[] Xpts;
+  delete[] varp;
+  delete[] vars;
+  delete[] weights;
+}
+
 /*
   Create the filter matrix
 */
@@ -46,6 +302,8 @@ TMRMatrixFilter::TMRMatrixFilter(double _r, int _N, int _nlevels,
 
   This code creates a TACSAssembler object (and frees it), assembles a
   mass matrix, creates the internal variables required for the filter.
+  The mass matrix is assembled from a cache of element matrices since
+  elements with the same size and shape have identical contributions.
 */
 void TMRMatrixFilter::initialize_matrix(double _r, int _N,
                                         TMROctForest *oct_forest,
@@ -82,6 +340,7 @@ void TMRMatrixFilter::initialize_matrix(double _r, int _N,
   // Create the matrix
   M = matrix_assembler->createMat();
   M->incref();
+  Mf = NULL;
 
   // Allocate the vectors needed for the application of the filter
   Ainv = matrix_assembler->createVec();
@@ -104,7 +363,7 @@ void TMRMatrixFilter::initialize_matrix(double _r, int _N,
   temp->incref();
 
   // Assemble the mass matrix
-  matrix_assembler->assembleJacobian(1.0, 0.0, 0.0, t2, M);
+  assembleFilterMatrix(matrix_assembler, M);
 
   // Free this version of TACS - it's not required anymore!
   matrix_assembler->decref();
@@ -146,13 +405,23 @@ void TMRMatrixFilter::initialize_matrix(double _r, int _N,
     Ai++;
   }
 
+  // Compute the normalization
+  computeNormalization();
+}
+
+/*
+  Compute the normalization so that the filter maps a vector of unit
+  entries to itself
+*/
+void TMRMatrixFilter::computeNormalization() {
   // Apply the filter to create the normalization
   Tinv->set(1.0);
+  y2->set(1.0);
   applyFilter(y2, y1);
 
   // Create the inverse of the T matrix
   TacsScalar *T, *ty;
-  size = Tinv->getArray(&T);
+  int size = Tinv->getArray(&T);
   y1->getArray(&ty);
   for (int i = 0; i < size; i++) {
     if (ty[0] != 0.0) {
@@ -165,6 +434,24 @@ void TMRMatrixFilter::initialize_matrix(double _r, int _N,
   }
 }
 
+/*
+  Store and apply the matrix in single precision
+
+  The normalization is re-computed with the matrix that is used in
+  the filter so that the filter still preserves constant vectors.
+*/
+void TMRMatrixFilter::setUseSinglePrecision(int flag) {
+  if (flag && !Mf) {
+    Mf = new TMRFloatMat(M);
+    Mf->incref();
+    computeNormalization();
+  } else if (!flag && Mf) {
+    Mf->decref();
+    Mf = NULL;
+    computeNormalization();
+  }
+}
+
 /*
   Destroy the filter matrix
 */
@@ -172,6 +459,9 @@ TMRMatrixFilter::~TMRMatrixFilter() {
   t1->decref();
   t2->decref();
   M->decref();
+  if (Mf) {
+    Mf->decref();
+  }
   Ainv->decref();
   B->decref();
   y1->decref();
@@ -199,7 +489,11 @@ void TMRMatrixFilter::applyFilter(TACSBVec *in, TACSBVec *out) {
   // Apply Horner's method
   for (int n = 0; n < N; n++) {
     // Compute t2 = B*M*out
-    M->mult(out, t2);
+    if (Mf) {
+      Mf->mult(out, t2);
+    } else {
+      M->mult(out, t2);
+    }
     kronecker(B, t2, out);
 
     // Compute out = t1 + B*M*out
@@ -224,7 +518,11 @@ void TMRMatrixFilter::applyTranspose(TACSBVec *in, TACSBVec *out) {
   for (int n = 0; n < N; n++) {
     // Compute M*B*out
     kronecker(B, out, t2);
-    M->mult(t2, out);
+    if (Mf) {
+      Mf->mult(t2, out);
+    } else {
+      M->mult(t2, out);
+    }
 
     // Compute out = t1 + M*B*out
     out->axpy(1.0, t1);
@@ -308,15 +606,8 @@ void TMRMatrixFilter::setDesignVars(TACSBVec *xvec) {
     }
   }
 
-  assembler[0]->setDesignVars(x[0]);
-
   // Set the design variable values on all levels
-  for (int k = 0; k < nlevels - 1; k++) {
-    filter_interp[k]->multWeightTranspose(x[k], x[k + 1]);
-
-    // Set the design variable values
-    assembler[k + 1]->setDesignVars(x[k + 1]);
-  }
+  setLevelDesignVars();
 }
 
 /*
@@ -22,6 +22,7 @@
 #define TMR_MATRIX_FILTER_H
 
 #include "TMRConformFilter.h"
+#include "TMRFloatMat.h"
 
 /*
   The following class creates and stores approximate M-filters for
@@ -86,12 +87,22 @@ class TMRMatrixFilter : public TMRConformFilter {
   // Apply the transpose of the filter for sensitivities
   void applyTranspose(TACSBVec *in, TACSBVec *out);
 
+  // Store and apply the matrix M in single precision. The products
+  // are still accumulated in TacsScalar.
+  void setUseSinglePrecision(int flag);
+
  private:
   void initialize_matrix(double _r, int _N, TMROctForest *oct_filter,
                          TMRQuadForest *quad_filter);
 
+  // Compute the normalization Tinv so that the filter preserves constants
+  void computeNormalization();
+
   // The non-negative matrix M
-  TACSMat *M;
+  TACSParallelMat *M;
+
+  // The single-precision copy of M (if it is used)
+  TMRFloatMat *Mf;
 
   // The number of terms to include in the approximate inverse
   int N;
@@ -68,6 +68,9 @@ TMRStiffnessProperties::TMRStiffnessProperties(
   beta = _beta;
   xoffset = _xoffset;
   use_project = _use_project;
+
+  // Evaluate all materials by default
+  active_material_tol = 0.0;
 }
 
 /*
@@ -100,6 +103,19 @@ TMROctConstitutive::TMROctConstitutive(TMRStiffnessProperties *_props,
   N = new double[order * order * order];
   temp_array = new TacsScalar[2 * nmats];
 
+  // Evaluate the stiffness matrices for each material. These do not
+  // depend on the design variables or the point within the element.
+  Cmat = new TacsScalar[21 * nmats];
+  for (int j = 0; j < nmats; j++) {
+    props->props[j]->evalTangentStiffness3D(&Cmat[21 * j]);
+  }
+
+  // Allocate space for the penalty values
+  shape_valid = 0;
+  penalty_elem = -1;
+  penalty = new TacsScalar[2 * nmats];
+  dpenalty = &penalty[nmats];
+
   // Initialize the design vector
   x = new TacsScalar[nvars * nconn];
   if (nvars == 1) {
@@ -115,6 +131,13 @@ TMROctConstitutive::TMROctConstitutive(TMRStiffnessProperties *_props,
       }
     }
   }
+
+  // Set the active materials for each element
+  num_active = new int[num_elements];
+  active_mats = new int[nmats * num_elements];
+  for (int i = 0; i < num_elements; i++) {
+    updateActiveMaterials(i);
+  }
 }
 
 /*
@@ -126,6 +149,105 @@ TMROctConstitutive::~TMROctConstitutive() {
   delete[] x;
   delete[] N;
   delete[] temp_array;
+  delete[] num_active;
+  delete[] active_mats;
+  delete[] Cmat;
+  delete[] penalty;
+}
+
+/*
+  Evaluate the shape functions at the given parametric point. The
+  shape functions are only re-evaluated when the point changes.
+*/
+void TMROctConstitutive::evalShapeFunctions(const double pt[]) {
+  if (!(shape_valid && shape_pt[0] == pt[0] && shape_pt[1] == pt[1] &&
+        shape_pt[2] == pt[2])) {
+    forest->evalInterp(pt, N);
+    shape_pt[0] = pt[0];
+    shape_pt[1] = pt[1];
+    shape_pt[2] = pt[2];
+    shape_valid = 1;
+  }
+}
+
+/*
+  Evaluate the penalized stiffness coefficient for each material and
+  its derivative w.r.t. the interpolated density.
+
+  The design variables are fixed during assembly, and the stress,
+  tangent stiffness and stress sensitivity are typically evaluated in
+  sequence at the same point. The values are therefore retained for
+  the most recent element and point. The values are invalidated when
+  the design variables are set.
+*/
+void TMROctConstitutive::evalStiffnessPenalty(int elemIndex,
+                                              const double pt[]) {
+  if (penalty_elem == elemIndex && penalty_pt[0] == pt[0] &&
+      penalty_pt[1] == pt[1] && penalty_pt[2] == pt[2]) {
+    return;
+  }
+
+  // Get the materials that are active within the element
+  int nactive;
+  const int *active = getActiveMaterials(elemIndex, &nactive);
+
+  const int order = forest->getMeshOrder();
+  const int len = order * order * order;
+  const double q = props->stiffness_penalty_value;
+  const double k0 = props->stiffness_offset;
+  const double beta = props->beta;
+  const double xoffset = props->xoffset;
+
+  // Evaluate the shape functions
+  evalShapeFunctions(pt);
+
+  // Get the design variable values
+  const TacsScalar *xptr = &x[nvars * len * elemIndex];
+
+  for (int jj = 0; jj < nactive; jj++) {
+    const int j = active[jj];
+    TacsScalar rho = 0.0;
+    if (nvars == 1) {
+      for (int i = 0; i < len; i++) {
+        rho += N[i] * xptr[i];
+      }
+    } else {
+      for (int i = 0; i < len; i++) {
+        rho += N[i] * xptr[nvars * i + j + 1];
+      }
+    }
+
+    // Use projection
+    TacsScalar rho_exp = 0.0;
+    if (props->use_project) {
+      rho_exp = exp(-beta * (rho - xoffset));
+      rho = 1.0 / (1.0 + rho_exp);
+    }
+
+    // Compute the penalty and the derivative of the penalization with
+    // respect to the projected density
+    if (props->penalty_type == TMR_SIMP_PENALTY) {
+      penalty[j] = pow(rho, q) + k0;
+      dpenalty[j] = 1.0;
+      if (q > 1.0) {
+        dpenalty[j] = q * pow(rho, q - 1.0);
+      }
+    } else {
+      penalty[j] = rho / (1.0 + q * (1.0 - rho)) + k0;
+      dpenalty[j] =
+          (q + 1.0) / ((1.0 + q * (1.0 - rho)) * (1.0 + q * (1.0 - rho)));
+    }
+
+    // Compute the derivative of the projection
+    if (props->use_project) {
+      dpenalty[j] *= beta * rho_exp * rho * rho;
+    }
+  }
+
+  penalty_elem = elemIndex;
+  penalty_pt[0] = pt[0];
+  penalty_pt[1] = pt[1];
+  penalty_pt[2] = pt[2];
 }
 
 /*
@@ -160,9 +282,54 @@ int TMROctConstitutive::setDesignVars(int elemIndex, int dvLen,
     xptr[i] = dvs[i];
   }
 
+  // Invalidate the penalty values
+  penalty_elem = -1;
+
+  // Update the active materials
+  updateActiveMaterials(elemIndex);
+
   return len;
 }
 
+/*
+  Update the materials that are active within the element
+
+  A material is active if its density exceeds the active material
+  tolerance at any node of the element. Only the active materials are
+  included in the stiffness, stress and failure evaluations, so that
+  the cost scales with the number of active materials. When no
+  material is active, all materials are included so that the stiffness
+  offset is retained in void regions.
+*/
+void TMROctConstitutive::updateActiveMaterials(int elemIndex) {
+  const int order = forest->getMeshOrder();
+  const int len = order * order * order;
+  const double tol = props->active_material_tol;
+  int *active = &active_mats[nmats * elemIndex];
+
+  int n = 0;
+  if (nvars > 1 && tol > 0.0) {
+    const TacsScalar *xptr = &x[nvars * len * elemIndex];
+    for (int j = 0; j < nmats; j++) {
+      for (int i = 0; i < len; i++) {
+        if (TacsRealPart(xptr[nvars * i + j + 1]) > tol) {
+          active[n] = j;
+          n++;
+          break;
+        }
+      }
+    }
+  }
+
+  if (n == 0) {
+    for (int j = 0; j < nmats; j++) {
+      active[j] = j;
+    }
+    n = nmats;
+  }
+  num_active[elemIndex] = n;
+}
+
 /*
   Get the design variable values
 
@@ -220,7 +387,7 @@ TacsScalar TMROctConstitutive::evalDensity(int elemIndex, const double pt[],
   const int len = order * order * order;
 
   // Evaluate the shape functions
-  forest->evalInterp(pt, N);
+  evalShapeFunctions(pt);
 
   // Get the design variable values
   const TacsScalar *xptr = &x[nvars * len * elemIndex];
@@ -257,7 +424,7 @@ void TMROctConstitutive::addDensityDVSens(int elemIndex, const TacsScalar scale,
   const int len = order * order * order;
 
   // Evaluate the shape functions
-  forest->evalInterp(pt, N);
+  evalShapeFunctions(pt);
 
   // Add the derivative of the density
   if (nvars == 1) {
@@ -292,7 +459,7 @@ TacsScalar TMROctConstitutive::evalMassMatrixDensity(int elemIndex,
   const double xoffset = props->xoffset;
 
   // Evaluate the shape functions
-  forest->evalInterp(pt, N);
+  evalShapeFunctions(pt);
 
   // Get the design variable values
   const TacsScalar *xptr = &x[nvars * len * elemIndex];
@@ -344,7 +511,7 @@ void TMROctConstitutive::addMassMatrixDensityDVSens(
   const double xoffset = props->xoffset;
 
   // Evaluate the shape functions
-  forest->evalInterp(pt, N);
+  evalShapeFunctions(pt);
 
   // Add the derivative of the density
   if (nvars == 1) {
@@ -412,7 +579,7 @@ TacsScalar TMROctConstitutive::evalSpecificHeat(int elemIndex,
   const int len = order * order * order;
 
   // Evaluate the shape functions
-  forest->evalInterp(pt, N);
+  evalShapeFunctions(pt);
 
   // Get the design variable values
   const TacsScalar *xptr = &x[nvars * len * elemIndex];
@@ -452,7 +619,7 @@ void TMROctConstitutive::addSpecificHeatDVSens(int elemIndex,
   const int len = order * order * order;
 
   // Evaluate the shape functions
-  forest->evalInterp(pt, N);
+  evalShapeFunctions(pt);
 
   // Add the derivative of the density
   if (nvars == 1) {
@@ -498,54 +665,21 @@ void TMROctConstitutive::evalStress(int elemIndex, const double pt[],
 void TMROctConstitutive::evalTangentStiffness(int elemIndex, const double pt[],
                                               const TacsScalar X[],
                                               TacsScalar C[]) {
-  const int order = forest->getMeshOrder();
-  const int len = order * order * order;
-  const double q = props->stiffness_penalty_value;
-  const double k0 = props->stiffness_offset;
-  const double beta = props->beta;
-  const double xoffset = props->xoffset;
+  // Get the materials that are active within the element
+  int nactive;
+  const int *active = getActiveMaterials(elemIndex, &nactive);
 
   memset(C, 0, 21 * sizeof(TacsScalar));
 
-  // Evaluate the shape functions
-  forest->evalInterp(pt, N);
-
-  // Get the design variable values
-  const TacsScalar *xptr = &x[nvars * len * elemIndex];
-
-  // Add the derivative of the density
-  for (int j = 0; j < nmats; j++) {
-    TacsScalar rho = 0.0;
-    if (nvars == 1) {
-      for (int i = 0; i < len; i++) {
-        rho += N[i] * xptr[i];
-      }
-    } else {
-      for (int i = 0; i < len; i++) {
-        rho += N[i] * xptr[nvars * i + j + 1];
-      }
-    }
-
-    // Use projection
-    if (props->use_project) {
-      rho = 1.0 / (1.0 + exp(-beta * (rho - xoffset)));
-    }
-
-    // Evaluate the tangent stiffness
-    TacsScalar Cj[21];
-    props->props[j]->evalTangentStiffness3D(Cj);
+  // Evaluate the penalty for each material
+  evalStiffnessPenalty(elemIndex, pt);
 
-    // Compute the penalty
-    TacsScalar penalty = 0.0;
-    if (props->penalty_type == TMR_SIMP_PENALTY) {
-      penalty = pow(rho, q) + k0;
-    } else {
-      penalty = rho / (1.0 + q * (1.0 - rho)) + k0;
-    }
-
-    // Add up the contribution to the tangent stiffness matrix
+  // Add up the contribution to the tangent stiffness matrix
+  for (int jj = 0; jj < nactive; jj++) {
+    const int j = active[jj];
+    const TacsScalar *Cj = &Cmat[21 * j];
     for (int i = 0; i < 21; i++) {
-      C[i] += penalty * Cj[i];
+      C[i] += penalty[j] * Cj[i];
     }
   }
 }
@@ -560,97 +694,98 @@ void TMROctConstitutive::addStressDVSens(int elemIndex, TacsScalar scale,
                                          const TacsScalar e[],
                                          const TacsScalar psi[], int dvLen,
                                          TacsScalar dfdx[]) {
-  const int order = forest->getMeshOrder();
-  const int len = order * order * order;
-  const double q = props->stiffness_penalty_value;
-  const double beta = props->beta;
-  const double xoffset = props->xoffset;
-
-  // Evaluate the shape functions
-  forest->evalInterp(pt, N);
-
-  // Get the design variable values
-  const TacsScalar *xptr = &x[nvars * len * elemIndex];
+  addStressDVSensBatch(elemIndex, 1, &scale, pt, X, e, psi, dvLen, dfdx);
+}
 
-  // Add the derivative of the density
-  for (int j = 0; j < nmats; j++) {
-    TacsScalar rho = 0.0;
-    if (nvars == 1) {
-      for (int i = 0; i < len; i++) {
-        rho += N[i] * xptr[i];
-      }
-    } else {
-      for (int i = 0; i < len; i++) {
-        rho += N[i] * xptr[nvars * i + j + 1];
-      }
-    }
+/*
+  Evaluate the stress at npts points within the same element.
 
-    // The derivative of the penalty value w.r.t. the density
-    TacsScalar dpenalty = 0.0;
+  The points, node locations, strains and stresses are stored
+  contiguously for each point: pts[3*n], X[3*n], e[6*n] and s[6*n].
+*/
+void TMROctConstitutive::evalStressBatch(int elemIndex, int npts,
+                                         const double pts[],
+                                         const TacsScalar X[],
+                                         const TacsScalar e[],
+                                         TacsScalar s[]) {
+  for (int n = 0; n < npts; n++) {
+    evalStress(elemIndex, &pts[3 * n], &X[3 * n], &e[6 * n], &s[6 * n]);
+  }
+}
 
-    // Use projection
-    if (props->use_project) {
-      // Compute the projection
-      TacsScalar rho_exp = exp(-beta * (rho - xoffset));
-      rho = 1.0 / (1.0 + rho_exp);
+/*
+  Add the derivative of the product of the stress with the vector psi
+  to the design variable array for npts points within the same element.
 
-      // Compute the derivative w.r.t. the penalty value
-      if (props->penalty_type == TMR_SIMP_PENALTY) {
-        dpenalty = 1.0;
-        if (q > 1.0) {
-          dpenalty = q * pow(rho, q - 1.0);
-        }
-      } else {
-        dpenalty =
-            (q + 1.0) / ((1.0 + q * (1.0 - rho)) * (1.0 + q * (1.0 - rho)));
-      }
+  The contributions from each point are accumulated at the nodes of the
+  element before they are added to the output array.
+*/
+void TMROctConstitutive::addStressDVSensBatch(
+    int elemIndex, int npts, const TacsScalar scale[], const double pts[],
+    const TacsScalar X[], const TacsScalar e[], const TacsScalar psi[],
+    int dvLen, TacsScalar dfdx[]) {
+  // Get the materials that are active within the element
+  int nactive;
+  const int *active = getActiveMaterials(elemIndex, &nactive);
 
-      // Compute the derivative of the projection w.r.t.
-      dpenalty *= beta * rho_exp * rho * rho;
+  const int order = forest->getMeshOrder();
+  const int len = order * order * order;
 
-    } else {
-      // Compute the derivative of the penalization with respect to
-      // the projected density
-      if (props->penalty_type == TMR_SIMP_PENALTY) {
-        dpenalty = 1.0;
-        if (q > 1.0) {
-          dpenalty = q * pow(rho, q - 1.0);
-        }
-      } else {
-        dpenalty =
-            (q + 1.0) / ((1.0 + q * (1.0 - rho)) * (1.0 + q * (1.0 - rho)));
-      }
-    }
+  // Accumulate the nodal contributions for each material
+  TacsScalar *dfdn = new TacsScalar[nmats * len];
+  memset(dfdn, 0, nmats * len * sizeof(TacsScalar));
 
-    TacsScalar C[21], s[6];
-    props->props[j]->evalTangentStiffness3D(C);
-    s[0] = C[0] * e[0] + C[1] * e[1] + C[2] * e[2] + C[3] * e[3] + C[4] * e[4] +
-           C[5] * e[5];
-    s[1] = C[1] * e[0] + C[6] * e[1] + C[7] * e[2] + C[8] * e[3] + C[9] * e[4] +
-           C[10] * e[5];
-    s[2] = C[2] * e[0] + C[7] * e[1] + C[11] * e[2] + C[12] * e[3] +
-           C[13] * e[4] + C[14] * e[5];
-    s[3] = C[3] * e[0] + C[8] * e[1] + C[12] * e[2] + C[15] * e[3] +
-           C[16] * e[4] + C[17] * e[5];
-    s[4] = C[4] * e[0] + C[9] * e[1] + C[13] * e[2] + C[16] * e[3] +
-           C[18] * e[4] + C[19] * e[5];
-    s[5] = C[5] * e[0] + C[10] * e[1] + C[14] * e[2] + C[17] * e[3] +
-           C[19] * e[4] + C[20] * e[5];
+  for (int n = 0; n < npts; n++) {
+    const TacsScalar *en = &e[6 * n];
+    const TacsScalar *psin = &psi[6 * n];
 
-    TacsScalar product = scale * dpenalty *
-                         (s[0] * psi[0] + s[1] * psi[1] + s[2] * psi[2] +
-                          s[3] * psi[3] + s[4] * psi[4] + s[5] * psi[5]);
+    // Evaluate the penalty derivatives (this evaluates N as well)
+    evalStiffnessPenalty(elemIndex, &pts[3 * n]);
 
-    if (nvars == 1) {
+    for (int jj = 0; jj < nactive; jj++) {
+      const int j = active[jj];
+      const TacsScalar *C = &Cmat[21 * j];
+      TacsScalar s[6];
+      s[0] = C[0] * en[0] + C[1] * en[1] + C[2] * en[2] + C[3] * en[3] +
+             C[4] * en[4] + C[5] * en[5];
+      s[1] = C[1] * en[0] + C[6] * en[1] + C[7] * en[2] + C[8] * en[3] +
+             C[9] * en[4] + C[10] * en[5];
+      s[2] = C[2] * en[0] + C[7] * en[1] + C[11] * en[2] + C[12] * en[3] +
+             C[13] * en[4] + C[14] * en[5];
+      s[3] = C[3] * en[0] + C[8] * en[1] + C[12] * en[2] + C[15] * en[3] +
+             C[16] * en[4] + C[17] * en[5];
+      s[4] = C[4] * en[0] + C[9] * en[1] + C[13] * en[2] + C[16] * en[3] +
+             C[18] * en[4] + C[19] * en[5];
+      s[5] = C[5] * en[0] + C[10] * en[1] + C[14] * en[2] + C[17] * en[3] +
+             C[19] * en[4] + C[20] * en[5];
+
+      TacsScalar product =
+          scale[n] * dpenalty[j] *
+          (s[0] * psin[0] + s[1] * psin[1] + s[2] * psin[2] + s[3] * psin[3] +
+           s[4] * psin[4] + s[5] * psin[5]);
+
+      TacsScalar *d = &dfdn[len * j];
       for (int i = 0; i < len; i++) {
-        dfdx[i] += N[i] * product;
+        d[i] += N[i] * product;
       }
-    } else {
+    }
+  }
+
+  // Add the accumulated values to the design variable array
+  if (nvars == 1) {
+    for (int i = 0; i < len; i++) {
+      dfdx[i] += dfdn[i];
+    }
+  } else {
+    for (int jj = 0; jj < nactive; jj++) {
+      const int j = active[jj];
       for (int i = 0; i < len; i++) {
-        dfdx[nvars * i + j + 1] += N[i] * product;
+        dfdx[nvars * i + j + 1] += dfdn[len * j + i];
       }
     }
   }
+
+  delete[] dfdn;
 }
 
 /*
@@ -669,7 +804,7 @@ void TMROctConstitutive::evalGeometricTangentStiffness(int elemIndex,
   memset(C, 0, 21 * sizeof(TacsScalar));
 
   // Evaluate the shape functions
-  forest->evalInterp(pt, N);
+  evalShapeFunctions(pt);
 
   // Get the design variable values
   const TacsScalar *xptr = &x[nvars * len * elemIndex];
@@ -694,7 +829,7 @@ void TMROctConstitutive::evalGeometricTangentStiffness(int elemIndex,
 
     // Evaluate the tangent stiffness
     TacsScalar Cj[21];
-    props->props[j]->evalTangentStiffness3D(Cj);
+    memcpy(Cj, &Cmat[21 * j], 21 * sizeof(TacsScalar));
 
     // Compute the penalty
     TacsScalar penalty = 0.0;
@@ -726,7 +861,7 @@ void TMROctConstitutive::addGeometricTangentStressDVSens(
   const double xoffset = props->xoffset;
 
   // Evaluate the shape functions
-  forest->evalInterp(pt, N);
+  evalShapeFunctions(pt);
 
   // Get the design variable values
   const TacsScalar *xptr = &x[nvars * len * elemIndex];
@@ -782,7 +917,7 @@ void TMROctConstitutive::addGeometricTangentStressDVSens(
     }
 
     TacsScalar C[21], s[6];
-    props->props[j]->evalTangentStiffness3D(C);
+    memcpy(C, &Cmat[21 * j], 21 * sizeof(TacsScalar));
     s[0] = C[0] * e[0] + C[1] * e[1] + C[2] * e[2] + C[3] * e[3] + C[4] * e[4] +
            C[5] * e[5];
     s[1] = C[1] * e[0] + C[6] * e[1] + C[7] * e[2] + C[8] * e[3] + C[9] * e[4] +
@@ -820,7 +955,7 @@ void TMROctConstitutive::evalThermalStrain(int elemIndex, const double pt[],
   const int len = order * order * order;
 
   // Evaluate the shape functions
-  forest->evalInterp(pt, N);
+  evalShapeFunctions(pt);
 
   // Get the design variable values
   const TacsScalar *xptr = &x[nvars * len * elemIndex];
@@ -857,7 +992,7 @@ void TMROctConstitutive::addThermalStrainDVSens(
   const int len = order * order * order;
 
   // Evaluate the shape functions
-  forest->evalInterp(pt, N);
+  evalShapeFunctions(pt);
 
   // Get the design variable values
   const TacsScalar *xptr = &x[nvars * len * elemIndex];
@@ -919,7 +1054,7 @@ void TMROctConstitutive::evalTangentHeatFlux(int elemIndex, const double pt[],
   memset(C, 0, 6 * sizeof(TacsScalar));
 
   // Evaluate the shape functions
-  forest->evalInterp(pt, N);
+  evalShapeFunctions(pt);
 
   // Get the design variable values
   const TacsScalar *xptr = &x[nvars * len * elemIndex];
@@ -975,7 +1110,7 @@ void TMROctConstitutive::addHeatFluxDVSens(int elemIndex, TacsScalar scale,
   const double xoffset = props->xoffset;
 
   // Evaluate the shape functions
-  forest->evalInterp(pt, N);
+  evalShapeFunctions(pt);
 
   // Get the design variable values
   const TacsScalar *xptr = &x[nvars * len * elemIndex];
@@ -1056,6 +1191,10 @@ void TMROctConstitutive::addHeatFluxDVSens(int elemIndex, TacsScalar scale,
 TacsScalar TMROctConstitutive::evalFailure(int elemIndex, const double pt[],
                                            const TacsScalar X[],
                                            const TacsScalar e[]) {
+  // Get the materials that are active within the element
+  int nactive;
+  const int *active = getActiveMaterials(elemIndex, &nactive);
+
   const int order = forest->getMeshOrder();
   const int len = order * order * order;
   const double eps = props->stress_relax_value;
@@ -1063,14 +1202,14 @@ TacsScalar TMROctConstitutive::evalFailure(int elemIndex, const double pt[],
   const double xoffset = props->xoffset;
 
   // Evaluate the shape functions
-  forest->evalInterp(pt, N);
+  evalShapeFunctions(pt);
 
   // Get the design variable values
   const TacsScalar *xptr = &x[nvars * len * elemIndex];
 
   if (nvars == 1) {
     TacsScalar C[21];
-    props->props[0]->evalTangentStiffness3D(C);
+    memcpy(C, Cmat, 21 * sizeof(TacsScalar));
 
     TacsScalar s[6];
     s[0] = C[0] * e[0] + C[1] * e[1] + C[2] * e[2] + C[3] * e[3] + C[4] * e[4] +
@@ -1108,9 +1247,10 @@ TacsScalar TMROctConstitutive::evalFailure(int elemIndex, const double pt[],
     TacsScalar *fail = temp_array;
     TacsScalar max_fail = -1e20;
 
-    for (int j = 0; j < nmats; j++) {
+    for (int jj = 0; jj < nactive; jj++) {
+      const int j = active[jj];
       TacsScalar C[21];
-      props->props[j]->evalTangentStiffness3D(C);
+      memcpy(C, &Cmat[21 * j], 21 * sizeof(TacsScalar));
 
       TacsScalar s[6];
       s[0] = C[0] * e[0] + C[1] * e[1] + C[2] * e[2] + C[3] * e[3] +
@@ -1141,7 +1281,8 @@ TacsScalar TMROctConstitutive::evalFailure(int elemIndex, const double pt[],
 
     // Compute the KS aggregate of the failure
     TacsScalar ksSum = 0.0;
-    for (int j = 0; j < nmats; j++) {
+    for (int jj = 0; jj < nactive; jj++) {
+      const int j = active[jj];
       ksSum += exp(ks_penalty * (fail[j] - max_fail));
     }
 
@@ -1162,6 +1303,10 @@ void TMROctConstitutive::addFailureDVSens(int elemIndex, TacsScalar scale,
                                           const TacsScalar X[],
                                           const TacsScalar e[], int dvLen,
                                           TacsScalar dfdx[]) {
+  // Get the materials that are active within the element
+  int nactive;
+  const int *active = getActiveMaterials(elemIndex, &nactive);
+
   const int order = forest->getMeshOrder();
   const int len = order * order * order;
   const double eps = props->stress_relax_value;
@@ -1169,14 +1314,14 @@ void TMROctConstitutive::addFailureDVSens(int elemIndex, TacsScalar scale,
   const double xoffset = props->xoffset;
 
   // Evaluate the shape functions
-  forest->evalInterp(pt, N);
+  evalShapeFunctions(pt);
 
   // Get the design variable values
   const TacsScalar *xptr = &x[nvars * len * elemIndex];
 
   if (nvars == 1) {
     TacsScalar C[21];
-    props->props[0]->evalTangentStiffness3D(C);
+    memcpy(C, Cmat, 21 * sizeof(TacsScalar));
 
     TacsScalar s[6];
     s[0] = C[0] * e[0] + C[1] * e[1] + C[2] * e[2] + C[3] * e[3] + C[4] * e[4] +
@@ -1226,9 +1371,10 @@ void TMROctConstitutive::addFailureDVSens(int elemIndex, TacsScalar scale,
     TacsScalar *rho = &temp_array[nmats];
     TacsScalar max_fail = -1e20;
 
-    for (int j = 0; j < nmats; j++) {
+    for (int jj = 0; jj < nactive; jj++) {
+      const int j = active[jj];
       TacsScalar C[21];
-      props->props[j]->evalTangentStiffness3D(C);
+      memcpy(C, &Cmat[21 * j], 21 * sizeof(TacsScalar));
 
       TacsScalar s[6];
       s[0] = C[0] * e[0] + C[1] * e[1] + C[2] * e[2] + C[3] * e[3] +
@@ -1262,14 +1408,16 @@ void TMROctConstitutive::addFailureDVSens(int elemIndex, TacsScalar scale,
 
     // Compute the KS aggregate of the failure
     TacsScalar ksSum = 0.0;
-    for (int j = 0; j < nmats; j++) {
+    for (int jj = 0; jj < nactive; jj++) {
+      const int j = active[jj];
       fail[j] = exp(ks_penalty * (fail[j] - max_fail));
       ksSum += fail[j];
     }
 
-    for (int j = 0; j < nmats; j++) {
+    for (int jj = 0; jj < nactive; jj++) {
+      const int j = active[jj];
       TacsScalar C[21];
-      props->props[j]->evalTangentStiffness3D(C);
+      memcpy(C, &Cmat[21 * j], 21 * sizeof(TacsScalar));
 
       TacsScalar s[6];
       s[0] = C[0] * e[0] + C[1] * e[1] + C[2] * e[2] + C[3] * e[3] +
@@ -1306,6 +1454,10 @@ TacsScalar TMROctConstitutive::evalFailureStrainSens(int elemIndex,
                                                      const TacsScalar X[],
                                                      const TacsScalar e[],
                                                      TacsScalar dfde[]) {
+  // Get the materials that are active within the element
+  int nactive;
+  const int *active = getActiveMaterials(elemIndex, &nactive);
+
   const int order = forest->getMeshOrder();
   const int len = order * order * order;
   const double eps = props->stress_relax_value;
@@ -1313,14 +1465,14 @@ TacsScalar TMROctConstitutive::evalFailureStrainSens(int elemIndex,
   const double xoffset = props->xoffset;
 
   // Evaluate the shape functions
-  forest->evalInterp(pt, N);
+  evalShapeFunctions(pt);
 
   // Get the design variable values
   const TacsScalar *xptr = &x[nvars * len * elemIndex];
 
   if (nvars == 1) {
     TacsScalar C[21];
-    props->props[0]->evalTangentStiffness3D(C);
+    memcpy(C, Cmat, 21 * sizeof(TacsScalar));
 
     TacsScalar s[6];
     s[0] = C[0] * e[0] + C[1] * e[1] + C[2] * e[2] + C[3] * e[3] + C[4] * e[4] +
@@ -1377,9 +1529,10 @@ TacsScalar TMROctConstitutive::evalFailureStrainSens(int elemIndex,
     TacsScalar *rho = &temp_array[nmats];
     TacsScalar max_fail = -1e20;
 
-    for (int j = 0; j < nmats; j++) {
+    for (int jj = 0; jj < nactive; jj++) {
+      const int j = active[jj];
       TacsScalar C[21];
-      props->props[j]->evalTangentStiffness3D(C);
+      memcpy(C, &Cmat[21 * j], 21 * sizeof(TacsScalar));
 
       TacsScalar s[6];
       s[0] = C[0] * e[0] + C[1] * e[1] + C[2] * e[2] + C[3] * e[3] +
@@ -1413,7 +1566,8 @@ TacsScalar TMROctConstitutive::evalFailureStrainSens(int elemIndex,
 
     // Compute the KS aggregate of the failure
     TacsScalar ksSum = 0.0;
-    for (int j = 0; j < nmats; j++) {
+    for (int jj = 0; jj < nactive; jj++) {
+      const int j = active[jj];
       fail[j] = exp(ks_penalty * (fail[j] - max_fail));
       ksSum += fail[j];
     }
@@ -1421,9 +1575,10 @@ TacsScalar TMROctConstitutive::evalFailureStrainSens(int elemIndex,
     TacsScalar ksFail = max_fail + log(ksSum) / ks_penalty;
 
     memset(dfde, 0, 6 * sizeof(TacsScalar));
-    for (int j = 0; j < nmats; j++) {
+    for (int jj = 0; jj < nactive; jj++) {
+      const int j = active[jj];
       TacsScalar C[21];
-      props->props[j]->evalTangentStiffness3D(C);
+      memcpy(C, &Cmat[21 * j], 21 * sizeof(TacsScalar));
 
       TacsScalar s[6];
       s[0] = C[0] * e[0] + C[1] * e[1] + C[2] * e[2] + C[3] * e[3] +
@@ -1478,7 +1633,7 @@ TacsScalar TMROctConstitutive::evalDesignFieldValue(int elemIndex,
     const double xoffset = props->xoffset;
 
     // Evaluate the shape functions
-    forest->evalInterp(pt, N);
+    evalShapeFunctions(pt);
 
     // Get the design variable values
     const TacsScalar *xptr = &x[nvars * len * elemIndex];
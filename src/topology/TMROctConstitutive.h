@@ -62,6 +62,12 @@ class TMRStiffnessProperties : public TMREntity {
   double xoffset;     // Offset parameter in the logistics function
   int use_project;    // Flag to indicate if projection should be used (0, 1)
 
+  // The nodal density below which a material is skipped within an
+  // element for the stiffness, stress and failure evaluations. The
+  // active materials are updated when the design variables are set. A
+  // value of zero (the default) evaluates all materials.
+  double active_material_tol;
+
   TACSMaterialProperties **getMaterialProperties() { return props; }
 };
 
@@ -135,6 +141,17 @@ class TMROctConstitutive : public TACSSolidConstitutive {
                        const TacsScalar X[], const TacsScalar strain[],
                        const TacsScalar psi[], int dvLen, TacsScalar dfdx[]);
 
+  // Evaluate the stress at multiple points within the same element
+  void evalStressBatch(int elemIndex, int npts, const double pts[],
+                       const TacsScalar X[], const TacsScalar strain[],
+                       TacsScalar stress[]);
+
+  // Add the stress sensitivity from multiple points within an element
+  void addStressDVSensBatch(int elemIndex, int npts, const TacsScalar scale[],
+                            const double pts[], const TacsScalar X[],
+                            const TacsScalar strain[], const TacsScalar psi[],
+                            int dvLen, TacsScalar dfdx[]);
+
   // Evaluate the geometric stiffness constitutive matrix
   void evalGeometricTangentStiffness(int elemIndex, const double pt[],
                                      const TacsScalar X[], TacsScalar C[]);
@@ -195,11 +212,39 @@ class TMROctConstitutive : public TACSSolidConstitutive {
   TMRStiffnessProperties *props;
   TMROctForest *forest;
 
+  // Evaluate the shape functions at the parametric point
+  void evalShapeFunctions(const double pt[]);
+
+  // Evaluate the stiffness penalty for each material at the point
+  void evalStiffnessPenalty(int elemIndex, const double pt[]);
+
+  // Update or retrieve the materials that are active within an element
+  void updateActiveMaterials(int elemIndex);
+  const int *getActiveMaterials(int elemIndex, int *nactive) {
+    *nactive = num_active[elemIndex];
+    return &active_mats[nmats * elemIndex];
+  }
+
   // Information about the design variable values
   int nmats, nvars;
   TacsScalar *x;           // All the design variable values
   double *N;               // Space for the shape functions
   TacsScalar *temp_array;  // Temporary array
+
+  // Stiffness matrices for each material (21 entries per material)
+  TacsScalar *Cmat;
+
+  // Values retained from the most recent evaluation point
+  int shape_valid;           // Flag indicating if N is valid at shape_pt
+  double shape_pt[3];        // The point for the shape functions
+  int penalty_elem;          // Element index for the penalty (-1 if invalid)
+  double penalty_pt[3];      // The point for the penalty values
+  TacsScalar *penalty;       // The stiffness penalty for each material
+  TacsScalar *dpenalty;      // Derivative of the penalty w.r.t. rho
+
+  // The number and indices of the active materials in each element
+  int *num_active;
+  int *active_mats;
 };
 
 #endif  // TMR_OCTANT_STIFFNESS_H
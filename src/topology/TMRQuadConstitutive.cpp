@@ -65,6 +65,13 @@ TMRQuadConstitutive::TMRQuadConstitutive(TMRStiffnessProperties *_props,
       }
     }
   }
+
+  // Set the active materials for each element
+  num_active = new int[num_elements];
+  active_mats = new int[nmats * num_elements];
+  for (int i = 0; i < num_elements; i++) {
+    updateActiveMaterials(i);
+  }
 }
 
 /*
@@ -76,6 +83,8 @@ TMRQuadConstitutive::~TMRQuadConstitutive() {
   delete[] x;
   delete[] N;
   delete[] temp_array;
+  delete[] num_active;
+  delete[] active_mats;
 }
 
 /*
@@ -110,9 +119,51 @@ int TMRQuadConstitutive::setDesignVars(int elemIndex, int dvLen,
     xptr[i] = dvs[i];
   }
 
+  // Update the active materials
+  updateActiveMaterials(elemIndex);
+
   return len;
 }
 
+/*
+  Update the materials that are active within the element
+
+  A material is active if its density exceeds the active material
+  tolerance at any node of the element. Only the active materials are
+  included in the stiffness, stress and failure evaluations, so that
+  the cost scales with the number of active materials. When no
+  material is active, all materials are included so that the stiffness
+  offset is retained in void regions.
+*/
+void TMRQuadConstitutive::updateActiveMaterials(int elemIndex) {
+  const int order = forest->getMeshOrder();
+  const int len = order * order;
+  const double tol = props->active_material_tol;
+  int *active = &active_mats[nmats * elemIndex];
+
+  int n = 0;
+  if (nvars > 1 && tol > 0.0) {
+    const TacsScalar *xptr = &x[nvars * len * elemIndex];
+    for (int j = 0; j < nmats; j++) {
+      for (int i = 0; i < len; i++) {
+        if (TacsRealPart(xptr[nvars * i + j + 1]) > tol) {
+          active[n] = j;
+          n++;
+          break;
+        }
+      }
+    }
+  }
+
+  if (n == 0) {
+    for (int j = 0; j < nmats; j++) {
+      active[j] = j;
+    }
+    n = nmats;
+  }
+  num_active[elemIndex] = n;
+}
+
 /*
   Get the design variable values
 
@@ -440,6 +491,10 @@ void TMRQuadConstitutive::evalStress(int elemIndex, const double pt[],
 void TMRQuadConstitutive::evalTangentStiffness(int elemIndex, const double pt[],
                                                const TacsScalar X[],
                                                TacsScalar C[]) {
+  // Get the materials that are active within the element
+  int nactive;
+  const int *active = getActiveMaterials(elemIndex, &nactive);
+
   const int order = forest->getMeshOrder();
   const int len = order * order;
   const double q = props->stiffness_penalty_value;
@@ -456,7 +511,8 @@ void TMRQuadConstitutive::evalTangentStiffness(int elemIndex, const double pt[],
   const TacsScalar *xptr = &x[nvars * len * elemIndex];
 
   // Add the derivative of the density
-  for (int j = 0; j < nmats; j++) {
+  for (int jj = 0; jj < nactive; jj++) {
+    const int j = active[jj];
     TacsScalar rho = 0.0;
     if (nvars == 1) {
       for (int i = 0; i < len; i++) {
@@ -502,6 +558,10 @@ void TMRQuadConstitutive::addStressDVSens(int elemIndex, TacsScalar scale,
                                           const TacsScalar e[],
                                           const TacsScalar psi[], int dvLen,
                                           TacsScalar dfdx[]) {
+  // Get the materials that are active within the element
+  int nactive;
+  const int *active = getActiveMaterials(elemIndex, &nactive);
+
   const int order = forest->getMeshOrder();
   const int len = order * order;
   const double q = props->stiffness_penalty_value;
@@ -515,7 +575,8 @@ void TMRQuadConstitutive::addStressDVSens(int elemIndex, TacsScalar scale,
   const TacsScalar *xptr = &x[nvars * len * elemIndex];
 
   // Add the derivative of the density
-  for (int j = 0; j < nmats; j++) {
+  for (int jj = 0; jj < nactive; jj++) {
+    const int j = active[jj];
     TacsScalar rho = 0.0;
     if (nvars == 1) {
       for (int i = 0; i < len; i++) {
@@ -971,6 +1032,10 @@ void TMRQuadConstitutive::addHeatFluxDVSens(int elemIndex, TacsScalar scale,
 TacsScalar TMRQuadConstitutive::evalFailure(int elemIndex, const double pt[],
                                             const TacsScalar X[],
                                             const TacsScalar e[]) {
+  // Get the materials that are active within the element
+  int nactive;
+  const int *active = getActiveMaterials(elemIndex, &nactive);
+
   const int order = forest->getMeshOrder();
   const int len = order * order;
   const double eps = props->stress_relax_value;
@@ -1014,7 +1079,8 @@ TacsScalar TMRQuadConstitutive::evalFailure(int elemIndex, const double pt[],
     TacsScalar *fail = temp_array;
     TacsScalar max_fail = -1e20;
 
-    for (int j = 0; j < nmats; j++) {
+    for (int jj = 0; jj < nactive; jj++) {
+      const int j = active[jj];
       TacsScalar C[6];
       props->props[j]->evalTangentStiffness2D(C);
 
@@ -1038,7 +1104,8 @@ TacsScalar TMRQuadConstitutive::evalFailure(int elemIndex, const double pt[],
 
     // Compute the KS aggregate of the failure
     TacsScalar ksSum = 0.0;
-    for (int j = 0; j < nmats; j++) {
+    for (int jj = 0; jj < nactive; jj++) {
+      const int j = active[jj];
       ksSum += exp(ks_penalty * (fail[j] - max_fail));
     }
 
@@ -1059,6 +1126,10 @@ void TMRQuadConstitutive::addFailureDVSens(int elemIndex, TacsScalar scale,
                                            const TacsScalar X[],
                                            const TacsScalar e[], int dvLen,
                                            TacsScalar dfdx[]) {
+  // Get the materials that are active within the element
+  int nactive;
+  const int *active = getActiveMaterials(elemIndex, &nactive);
+
   const int order = forest->getMeshOrder();
   const int len = order * order;
   const double eps = props->stress_relax_value;
@@ -1115,7 +1186,8 @@ void TMRQuadConstitutive::addFailureDVSens(int elemIndex, TacsScalar scale,
     TacsScalar *rho = &temp_array[nmats];
     TacsScalar max_fail = -1e20;
 
-    for (int j = 0; j < nmats; j++) {
+    for (int jj = 0; jj < nactive; jj++) {
+      const int j = active[jj];
       TacsScalar C[6];
       props->props[j]->evalTangentStiffness2D(C);
 
@@ -1142,12 +1214,14 @@ void TMRQuadConstitutive::addFailureDVSens(int elemIndex, TacsScalar scale,
 
     // Compute the KS aggregate of the failure
     TacsScalar ksSum = 0.0;
-    for (int j = 0; j < nmats; j++) {
+    for (int jj = 0; jj < nactive; jj++) {
+      const int j = active[jj];
       fail[j] = exp(ks_penalty * (fail[j] - max_fail));
       ksSum += fail[j];
     }
 
-    for (int j = 0; j < nmats; j++) {
+    for (int jj = 0; jj < nactive; jj++) {
+      const int j = active[jj];
       TacsScalar C[6];
       props->props[j]->evalTangentStiffness2D(C);
 
@@ -1177,6 +1251,10 @@ TacsScalar TMRQuadConstitutive::evalFailureStrainSens(int elemIndex,
                                                       const TacsScalar X[],
                                                       const TacsScalar e[],
                                                       TacsScalar dfde[]) {
+  // Get the materials that are active within the element
+  int nactive;
+  const int *active = getActiveMaterials(elemIndex, &nactive);
+
   const int order = forest->getMeshOrder();
   const int len = order * order;
   const double eps = props->stress_relax_value;
@@ -1230,7 +1308,8 @@ TacsScalar TMRQuadConstitutive::evalFailureStrainSens(int elemIndex,
     TacsScalar *rho = &temp_array[nmats];
     TacsScalar max_fail = -1e20;
 
-    for (int j = 0; j < nmats; j++) {
+    for (int jj = 0; jj < nactive; jj++) {
+      const int j = active[jj];
       TacsScalar C[6];
       props->props[j]->evalTangentStiffness2D(C);
 
@@ -1257,7 +1336,8 @@ TacsScalar TMRQuadConstitutive::evalFailureStrainSens(int elemIndex,
 
     // Compute the KS aggregate of the failure
     TacsScalar ksSum = 0.0;
-    for (int j = 0; j < nmats; j++) {
+    for (int jj = 0; jj < nactive; jj++) {
+      const int j = active[jj];
       fail[j] = exp(ks_penalty * (fail[j] - max_fail));
       ksSum += fail[j];
     }
@@ -1265,7 +1345,8 @@ TacsScalar TMRQuadConstitutive::evalFailureStrainSens(int elemIndex,
     TacsScalar ksFail = max_fail + log(ksSum) / ks_penalty;
 
     memset(dfde, 0, 3 * sizeof(TacsScalar));
-    for (int j = 0; j < nmats; j++) {
+    for (int jj = 0; jj < nactive; jj++) {
+      const int j = active[jj];
       TacsScalar C[6];
       props->props[j]->evalTangentStiffness2D(C);
 
@@ -158,11 +158,22 @@ class TMRQuadConstitutive : public TACSPlaneStressConstitutive {
   TMRStiffnessProperties *props;
   TMRQuadForest *forest;
 
+  // Update or retrieve the materials that are active within an element
+  void updateActiveMaterials(int elemIndex);
+  const int *getActiveMaterials(int elemIndex, int *nactive) {
+    *nactive = num_active[elemIndex];
+    return &active_mats[nmats * elemIndex];
+  }
+
   // Information about the design variable values
   int nmats, nvars;
   TacsScalar *x;           // All the design variable values
   double *N;               // Space for the shape functions
   TacsScalar *temp_array;  // Temporary array
+
+  // The number and indices of the active materials in each element
+  int *num_active;
+  int *active_mats;
 };
 
 #endif  // TMR_QUADRANT_STIFFNESS_H
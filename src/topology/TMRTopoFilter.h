@@ -38,6 +38,16 @@ class TMRTopoFilter : public TMREntity {
   virtual TMRQuadForest *getFilterQuadForest() = 0;
   virtual TMROctForest *getFilterOctForest() = 0;
 
+  // Get the memory used by the filter on this processor
+  virtual void getMemoryUsage(TMRMemoryUsage *usage) {
+    usage->zero();
+    if (getFilterOctForest()) {
+      getFilterOctForest()->getMemoryUsage(usage);
+    } else if (getFilterQuadForest()) {
+      getFilterQuadForest()->getMemoryUsage(usage);
+    }
+  }
+
   // Set the design variables
   virtual void setDesignVars(TACSBVec *vec) = 0;
 
@@ -54,6 +64,14 @@ class TMRTopoFilter : public TMREntity {
   // Write the STL file
   virtual void writeSTLFile(int k, double cutoff, const char *filename) {}
 
+  // Gather the STL triangles on the root processor
+  virtual int getSTLTriangles(int root, int k, double cutoff, int *ntris,
+                              TMR_STLTriangle **tris) {
+    *ntris = 0;
+    *tris = NULL;
+    return 1;
+  }
+
   // Apply filter/filter transpose to some vector that has same size as design
   // variable
   virtual void applyFilter(TACSBVec *in, TACSBVec *out) {
@@ -22,7 +22,9 @@
 
 #include "TACSFunction.h"
 #include "TACSToFH5.h"
+#include "TMR_STLTools.h"
 #include "TMR_TACSCreator.h"
+#include "tacslapack.h"
 
 /*
   Wrap a TACSBVec object with the ParOpt vector interface
@@ -30,9 +32,13 @@
 ParOptBVecWrap::ParOptBVecWrap(TACSBVec *_vec) {
   vec = _vec;
   vec->incref();
+  mdot_request = MPI_REQUEST_NULL;
 }
 
-ParOptBVecWrap::~ParOptBVecWrap() { vec->decref(); }
+ParOptBVecWrap::~ParOptBVecWrap() {
+  endMdot();
+  vec->decref();
+}
 
 /*
   Set all the values within the vector
@@ -109,20 +115,102 @@ ParOptScalar ParOptBVecWrap::dot(ParOptVec *pvec) {
 }
 
 /*
-  Compute multiple dot products simultaneously
+  Compute the local contributions to multiple dot products
+
+  The local entries are processed in blocks, so that each block of
+  this vector is loaded from memory once for all the dot products.
+  Vectors that are not wrapped TACSBVec objects contribute zero.
 */
-void ParOptBVecWrap::mdot(ParOptVec **vecs, int nvecs, ParOptScalar *output) {
-  TACSVec **tvecs = new TACSVec *[nvecs];
+void ParOptBVecWrap::localMdot(ParOptVec **vecs, int nvecs,
+                               ParOptScalar *output) {
+  TacsScalar *x = NULL;
+  int size = vec->getArray(&x);
+
+  TacsScalar **y = new TacsScalar *[nvecs];
   for (int k = 0; k < nvecs; k++) {
     ParOptBVecWrap *wrap = dynamic_cast<ParOptBVecWrap *>(vecs[k]);
-    tvecs[k] = NULL;
+    y[k] = NULL;
     if (wrap) {
-      tvecs[k] = wrap->vec;
+      wrap->vec->getArray(&y[k]);
+    }
+    output[k] = 0.0;
+  }
+
+  const int block_size = 256;
+  for (int start = 0; start < size; start += block_size) {
+    int end = (start + block_size < size ? start + block_size : size);
+    for (int k = 0; k < nvecs; k++) {
+      if (y[k]) {
+        const TacsScalar *yk = y[k];
+        TacsScalar sum = 0.0;
+        for (int i = start; i < end; i++) {
+          sum += x[i] * yk[i];
+        }
+        output[k] += sum;
+      }
     }
   }
 
-  vec->mdot(tvecs, output, nvecs);
-  delete[] tvecs;
+  delete[] y;
+}
+
+/*
+  Compute multiple dot products simultaneously with a single pass
+  over this vector and a single reduction
+*/
+void ParOptBVecWrap::mdot(ParOptVec **vecs, int nvecs, ParOptScalar *output) {
+  localMdot(vecs, nvecs, output);
+  MPI_Allreduce(MPI_IN_PLACE, output, nvecs, TACS_MPI_TYPE, MPI_SUM,
+                vec->getMPIComm());
+}
+
+/*
+  Compute multiple dot products and the norm of this vector with a
+  single reduction
+*/
+void ParOptBVecWrap::mdotNorm(ParOptVec **vecs, int nvecs,
+                              ParOptScalar *output, double *nrm) {
+  TacsScalar *res = new TacsScalar[nvecs + 1];
+  localMdot(vecs, nvecs, res);
+
+  TacsScalar *x = NULL;
+  int size = vec->getArray(&x);
+  res[nvecs] = 0.0;
+  for (int i = 0; i < size; i++) {
+    res[nvecs] += x[i] * x[i];
+  }
+
+  MPI_Allreduce(MPI_IN_PLACE, res, nvecs + 1, TACS_MPI_TYPE, MPI_SUM,
+                vec->getMPIComm());
+
+  for (int k = 0; k < nvecs; k++) {
+    output[k] = res[k];
+  }
+  *nrm = sqrt(TacsRealPart(res[nvecs]));
+  delete[] res;
+}
+
+/*
+  Start computing multiple dot products. The local contributions are
+  computed immediately and the reduction is started without waiting
+  for it to complete. The output is not valid until endMdot() is
+  called and must not be modified until then.
+*/
+void ParOptBVecWrap::beginMdot(ParOptVec **vecs, int nvecs,
+                               ParOptScalar *output) {
+  endMdot();
+  localMdot(vecs, nvecs, output);
+  MPI_Iallreduce(MPI_IN_PLACE, output, nvecs, TACS_MPI_TYPE, MPI_SUM,
+                 vec->getMPIComm(), &mdot_request);
+}
+
+/*
+  Wait for the reduction started by beginMdot() to complete
+*/
+void ParOptBVecWrap::endMdot() {
+  if (mdot_request != MPI_REQUEST_NULL) {
+    MPI_Wait(&mdot_request, MPI_STATUS_IGNORE);
+  }
 }
 
 /*
@@ -153,6 +241,59 @@ int ParOptBVecWrap::getArray(ParOptScalar **array) {
   return size;
 }
 
+/*
+  The STL output data written by the output thread
+*/
+class TMRSTLOutputData {
+ public:
+  TMRSTLOutputData(int _nfiles) {
+    nfiles = _nfiles;
+    filenames = new char *[nfiles];
+    ntris = new int[nfiles];
+    tris = new TMR_STLTriangle *[nfiles];
+    for (int k = 0; k < nfiles; k++) {
+      filenames[k] = NULL;
+      ntris[k] = 0;
+      tris[k] = NULL;
+    }
+  }
+  ~TMRSTLOutputData() {
+    for (int k = 0; k < nfiles; k++) {
+      if (filenames[k]) {
+        delete[] filenames[k];
+      }
+      if (tris[k]) {
+        delete[] tris[k];
+      }
+    }
+    delete[] filenames;
+    delete[] ntris;
+    delete[] tris;
+  }
+
+  int nfiles;
+  char **filenames;
+  int *ntris;
+  TMR_STLTriangle **tris;
+};
+
+/*
+  Write the STL output files. This does not call MPI.
+*/
+static void *writeSTLOutputThread(void *args) {
+  TMRSTLOutputData *data = static_cast<TMRSTLOutputData *>(args);
+  for (int k = 0; k < data->nfiles; k++) {
+    if (data->filenames[k]) {
+      if (TMR_WriteBinFile(data->filenames[k], data->ntris[k],
+                           data->tris[k])) {
+        fprintf(stderr, "TMRTopoProblem: Failed to write file %s\n",
+                data->filenames[k]);
+      }
+    }
+  }
+  return NULL;
+}
+
 /*
   Create the topology optimization problem
 */
@@ -202,17 +343,31 @@ TMRTopoProblem::TMRTopoProblem(TMRTopoFilter *_filter, TACSMg *_mg,
     ksm->incref();
     ksm->setMonitor(new KSMPrintStdout("GMRES", mpi_rank, 10));
     ksm->setTolerances(rtol, atol);
+    ksm_rtol = rtol;
+    ksm_atol = atol;
   } else {
     ksm = NULL;
+    ksm_rtol = rtol;
+    ksm_atol = 0.0;
   }
 
   // Set the iteration count
   iter_count = 0;
 
+  // Set the asynchronous output data
+  use_async_output = 0;
+  output_thread_active = 0;
+  output_data = NULL;
+
   // Set the load case information
   num_load_cases = 0;
   forces = NULL;
   vars = NULL;
+  use_multi_rhs = 0;
+  load_case_prods = NULL;
+  use_warm_start = 0;
+  num_adjoint_guesses = 0;
+  adjoint_guesses = NULL;
 
   // Set the load case information
   load_case_info = NULL;
@@ -280,12 +435,25 @@ TMRTopoProblem::TMRTopoProblem(TMRTopoFilter *_filter, TACSMg *_mg,
   proj_deriv = NULL;
   x_h = NULL;
   s_temp = NULL;
+
+  // The data for the Hessian-vector products is allocated on demand
+  hvec_op_valid = 0;
+  hvec_res_valid = 0;
+  hvec_design = NULL;
+  hvec_xtemp = NULL;
+  hvec_base = NULL;
+  hvec_res = NULL;
+  hvec_rhs = NULL;
+  hvec_sols = NULL;
 }
 
 /*
   Free the data stored in the object
 */
 TMRTopoProblem::~TMRTopoProblem() {
+  // Complete any pending output
+  waitForOutput();
+
   if (prefix) {
     delete[] prefix;
   }
@@ -324,6 +492,28 @@ TMRTopoProblem::~TMRTopoProblem() {
     delete[] forces;
     delete[] vars;
   }
+  if (load_case_prods) {
+    for (int i = 0; i < num_load_cases; i++) {
+      load_case_prods[i]->decref();
+    }
+    delete[] load_case_prods;
+  }
+  if (adjoint_guesses) {
+    for (int i = 0; i < num_adjoint_guesses; i++) {
+      adjoint_guesses[i]->decref();
+    }
+    delete[] adjoint_guesses;
+  }
+  if (hvec_res) {
+    for (int i = 0; i < num_load_cases; i++) {
+      hvec_res[i]->decref();
+      hvec_rhs[i]->decref();
+      hvec_sols[i]->decref();
+    }
+    delete[] hvec_res;
+    delete[] hvec_rhs;
+    delete[] hvec_sols;
+  }
 
   // Free the load case data
   if (load_case_info) {
@@ -381,6 +571,15 @@ TMRTopoProblem::~TMRTopoProblem() {
     x_h->decref();
     s_temp->decref();
   }
+
+  // Free the vectors for the Hessian-vector products
+  if (hvec_design) {
+    hvec_design->decref();
+  }
+  if (hvec_xtemp) {
+    hvec_xtemp->decref();
+    hvec_base->decref();
+  }
 }
 
 /*
@@ -472,6 +671,34 @@ void TMRTopoProblem::setLoadCases(TACSBVec **_forces, int _num_load_cases) {
     delete[] forces;
     delete[] vars;
   }
+  if (load_case_prods) {
+    for (int i = 0; i < num_load_cases; i++) {
+      load_case_prods[i]->decref();
+    }
+    delete[] load_case_prods;
+    load_case_prods = NULL;
+  }
+  if (adjoint_guesses) {
+    for (int i = 0; i < num_adjoint_guesses; i++) {
+      adjoint_guesses[i]->decref();
+    }
+    delete[] adjoint_guesses;
+    num_adjoint_guesses = 0;
+    adjoint_guesses = NULL;
+  }
+  if (hvec_res) {
+    for (int i = 0; i < num_load_cases; i++) {
+      hvec_res[i]->decref();
+      hvec_rhs[i]->decref();
+      hvec_sols[i]->decref();
+    }
+    delete[] hvec_res;
+    delete[] hvec_rhs;
+    delete[] hvec_sols;
+    hvec_res = hvec_rhs = hvec_sols = NULL;
+  }
+  hvec_op_valid = 0;
+  hvec_res_valid = 0;
 
   // Deallocate the load case data (if it exists)
   if (load_case_info) {
@@ -521,6 +748,187 @@ void TMRTopoProblem::setLoadCases(TACSBVec **_forces, int _num_load_cases) {
 */
 int TMRTopoProblem::getNumLoadCases() { return num_load_cases; }
 
+/*
+  Set the flag to solve the load cases using multiple right-hand-sides
+*/
+void TMRTopoProblem::setUseMultiRHSSolve(int flag) { use_multi_rhs = flag; }
+
+/*
+  Set the flag to use the solutions from the previous iteration as
+  initial guesses for the linear solves
+*/
+void TMRTopoProblem::setUseWarmStart(int flag) { use_warm_start = flag; }
+
+/*
+  Solve the system K*x = rhs using the input values of x as the
+  initial guess.
+
+  The Krylov tolerance is relative to the initial residual, so the
+  absolute tolerance is set relative to the norm of the right-hand-side
+  to obtain the same accuracy as the solution with a zero initial guess.
+*/
+void TMRTopoProblem::solveWithGuess(TACSBVec *rhs, TACSBVec *x) {
+  double atol = TacsRealPart(ksm_rtol * rhs->norm());
+  if (atol < ksm_atol) {
+    atol = ksm_atol;
+  }
+  ksm->setTolerances(ksm_rtol, atol);
+  int zero_guess = 0;
+  ksm->solve(rhs, x, zero_guess);
+  ksm->setTolerances(ksm_rtol, ksm_atol);
+}
+
+/*
+  Solve the adjoint equations and return the adjoint vector.
+
+  When warm starts are used, the adjoint from the previous iteration
+  with the same index is used as the initial guess. The adjoint
+  equations are solved in the same order at each iteration, so the
+  index identifies the load case and function.
+*/
+TACSBVec *TMRTopoProblem::solveAdjoint(int index, TACSBVec *rhs) {
+  if (!use_warm_start) {
+    ksm->solve(rhs, adjoint);
+    return adjoint;
+  }
+
+  // Extend the array of adjoint vectors if required
+  if (index >= num_adjoint_guesses) {
+    TACSBVec **guesses = new TACSBVec *[index + 1];
+    for (int i = 0; i < num_adjoint_guesses; i++) {
+      guesses[i] = adjoint_guesses[i];
+    }
+    for (int i = num_adjoint_guesses; i <= index; i++) {
+      guesses[i] = assembler->createVec();
+      guesses[i]->incref();
+    }
+    if (adjoint_guesses) {
+      delete[] adjoint_guesses;
+    }
+    adjoint_guesses = guesses;
+    num_adjoint_guesses = index + 1;
+  }
+
+  solveWithGuess(rhs, adjoint_guesses[index]);
+  return adjoint_guesses[index];
+}
+
+/*
+  Solve the linear systems K(x)*u = f for all the load cases.
+
+  When the multiple right-hand-side mode is used, the initial guess
+  for each load case is the linear combination of the current load
+  case solutions that minimizes the residual
+
+  min_{c} || f_{i} - sum_{j} c_{j} K*u_{j} ||
+
+  The solutions u_{j} are taken from the previous design iteration
+  and are replaced by the new solutions as they are computed, so the
+  span includes both the previous design and the load cases already
+  solved. This requires one matrix-vector product and two multiple
+  dot products for each load case. The tolerance for the Krylov
+  method is set relative to the norm of the right-hand-side so that
+  the accuracy is the same as the solution with a zero initial guess.
+*/
+void TMRTopoProblem::solveLoadCases() {
+  if (!use_multi_rhs || num_load_cases < 2) {
+    for (int i = 0; i < num_load_cases; i++) {
+      if (forces[i]) {
+        if (use_warm_start) {
+          solveWithGuess(forces[i], vars[i]);
+        } else {
+          ksm->solve(forces[i], vars[i]);
+        }
+      }
+    }
+    return;
+  }
+
+  // Allocate the vectors for the matrix-vector products
+  if (!load_case_prods) {
+    load_case_prods = new TACSBVec *[num_load_cases];
+    for (int i = 0; i < num_load_cases; i++) {
+      load_case_prods[i] = assembler->createVec();
+      load_case_prods[i]->incref();
+    }
+  }
+
+  // Compute the products with the solutions from the last iteration
+  TACSMat *mat = mg->getMat(0);
+  for (int i = 0; i < num_load_cases; i++) {
+    mat->mult(vars[i], load_case_prods[i]);
+  }
+
+  // Compute the Gram matrix G = (K*U)^{T}*(K*U)
+  const int n = num_load_cases;
+  TacsScalar *G = new TacsScalar[n * n];
+  TacsScalar *g = new TacsScalar[n];
+  TACSVec **prods = new TACSVec *[n];
+  for (int i = 0; i < n; i++) {
+    prods[i] = load_case_prods[i];
+  }
+  for (int i = 0; i < n; i++) {
+    load_case_prods[i]->mdot(prods, &G[n * i], n);
+  }
+
+  // Allocate space for the least-squares problem
+  double *A = new double[n * n];
+  double *b = new double[n];
+  double *s = new double[n];
+  int lwork = 10 * n + 64;
+  double *work = new double[lwork];
+
+  for (int i = 0; i < n; i++) {
+    if (!forces[i]) {
+      continue;
+    }
+
+    // Compute the right-hand-side of the projected problem
+    forces[i]->mdot(prods, g, n);
+
+    // Solve the projected least-squares problem (the Gram matrix may
+    // be rank-deficient so the least-squares solution is used)
+    for (int k = 0; k < n * n; k++) {
+      A[k] = TacsRealPart(G[k]);
+    }
+    for (int k = 0; k < n; k++) {
+      b[k] = TacsRealPart(g[k]);
+    }
+    int m = n, nrhs = 1, rank, info;
+    double rcond = 1e-12;
+    LAPACKdgelss(&m, &m, &nrhs, A, &m, b, &m, s, &rcond, &rank, work, &lwork,
+                 &info);
+
+    // Form the initial guess in the adjoint vector (used as a
+    // temporary here) and copy it to the solution vector
+    adjoint->zeroEntries();
+    if (info == 0) {
+      for (int j = 0; j < n; j++) {
+        adjoint->axpy(b[j], vars[j]);
+      }
+    }
+    vars[i]->copyValues(adjoint);
+
+    // Solve the system starting from the initial guess
+    solveWithGuess(forces[i], vars[i]);
+
+    // Update the product and the Gram matrix
+    mat->mult(vars[i], load_case_prods[i]);
+    load_case_prods[i]->mdot(prods, &G[n * i], n);
+    for (int j = 0; j < n; j++) {
+      G[n * j + i] = G[n * i + j];
+    }
+  }
+
+  delete[] G;
+  delete[] g;
+  delete[] prods;
+  delete[] A;
+  delete[] b;
+  delete[] s;
+  delete[] work;
+}
+
 /*
   Set the constraint functions for each of the specified load cases
 */
@@ -979,9 +1387,12 @@ int TMRTopoProblem::evalObjCon(ParOptVec *pxvec, ParOptScalar *fobj,
   // Keep track of the constraint number
   int count = 0;
 
-  // Compute the linear constraint
-  for (int i = 0; i < num_linear_con; i++, count++) {
-    cons[count] = linear_offset[i] + Alinear[i]->dot(pxvec);
+  // Compute the linear constraints with a single reduction
+  if (num_linear_con > 0) {
+    pxvec->mdot(Alinear, num_linear_con, cons);
+    for (int i = 0; i < num_linear_con; i++, count++) {
+      cons[count] += linear_offset[i];
+    }
   }
 
   // Perform the objective function callback
@@ -1000,10 +1411,20 @@ int TMRTopoProblem::evalObjCon(ParOptVec *pxvec, ParOptScalar *fobj,
     mg->assembleJacobian(alpha, beta, gamma, NULL);
     mg->factor();
 
+    // Solve the system: K(x)*u = forces for all load cases
+    solveLoadCases();
+
+    // Record the design at which the operator is factored
+    if (!hvec_design) {
+      hvec_design = createDesignVec();
+      hvec_design->incref();
+    }
+    hvec_design->copyValues(pxvec);
+    hvec_op_valid = 1;
+    hvec_res_valid = 0;
+
     for (int i = 0; i < num_load_cases; i++) {
       if (forces[i]) {
-        // Solve the system: K(x)*u = forces
-        ksm->solve(forces[i], vars[i]);
         assembler->setBCs(vars[i]);
 
         // Set the variables into TACSAssembler
@@ -1081,6 +1502,7 @@ int TMRTopoProblem::evalObjCon(ParOptVec *pxvec, ParOptScalar *fobj,
       err_count = 0;
       // Solve the eigenvalue problem
       freq->solve(new KSMPrintStdout("KSM", mpi_rank, 1));
+      hvec_op_valid = 0;
 
       // Extract the first k eigenvalues
       for (int k = 0; k < num_freq_eigvals; k++) {
@@ -1152,6 +1574,7 @@ int TMRTopoProblem::evalObjCon(ParOptVec *pxvec, ParOptScalar *fobj,
           // Solve the eigenvalue problem
           TACSBVec *u0 = NULL;  // TODO: Is this right? do we need a u0? --Aaron
           buck[i]->solve(forces[i], u0, new KSMPrintStdout("KSM", mpi_rank, 1));
+          hvec_op_valid = 0;
 
           // Extract the first k eigenvalues
           for (int k = 0; k < num_buck_eigvals; k++) {
@@ -1218,6 +1641,9 @@ int TMRTopoProblem::evalObjConGradient(ParOptVec *xvec, ParOptVec *gvec,
   int mpi_rank;
   MPI_Comm_rank(assembler->getMPIComm(), &mpi_rank);
 
+  // Index of the adjoint used for the initial guesses
+  int adjoint_index = 0;
+
   // Evaluate the derivative of the weighted compliance with
   // respect to the design variables
   ParOptBVecWrap *wrap = dynamic_cast<ParOptBVecWrap *>(gvec);
@@ -1259,6 +1685,7 @@ int TMRTopoProblem::evalObjConGradient(ParOptVec *xvec, ParOptVec *gvec,
           double alpha = 1.0, beta = 0.0, gamma = 0.0;
           mg->assembleJacobian(alpha, beta, gamma, NULL, TACS_MAT_TRANSPOSE);
           mg->factor();
+          hvec_op_valid = 0;
 
           // Compute the right-hand-side
           dfdu->zeroEntries();
@@ -1266,9 +1693,10 @@ int TMRTopoProblem::evalObjConGradient(ParOptVec *xvec, ParOptVec *gvec,
           assembler->applyBCs(dfdu);
 
           // Solve the system of adjoint equations
-          ksm->solve(dfdu, adjoint);
+          TACSBVec *psi = solveAdjoint(adjoint_index, dfdu);
+          adjoint_index++;
           assembler->addDVSens(obj_weights[i], 1, &obj_funcs[i], &g);
-          assembler->addAdjointResProducts(-obj_weights[i], 1, &adjoint, &g);
+          assembler->addAdjointResProducts(-obj_weights[i], 1, &psi, &g);
         } else {
           assembler->addDVSens(obj_weights[i], 1, &obj_funcs[i], &g);
         }
@@ -1334,11 +1762,12 @@ int TMRTopoProblem::evalObjConGradient(ParOptVec *xvec, ParOptVec *gvec,
           assembler->applyBCs(dfdu);
 
           // Solve the system of equations
-          ksm->solve(dfdu, adjoint);
+          TACSBVec *psi = solveAdjoint(adjoint_index, dfdu);
+          adjoint_index++;
 
           // Compute the total derivative using the adjoint
           assembler->addDVSens(scale, 1, &func, &A);
-          assembler->addAdjointResProducts(-scale, 1, &adjoint, &A);
+          assembler->addAdjointResProducts(-scale, 1, &psi, &A);
         } else {
           assembler->addDVSens(scale, 1, &func, &A);
         }
@@ -1630,6 +2059,167 @@ void TMRTopoProblem::computeQuasiNewtonUpdateCorrection(
 int TMRTopoProblem::evalHvecProduct(ParOptVec *xvec, ParOptScalar *z,
                                     ParOptVec *zw, ParOptVec *pxvec,
                                     ParOptVec *hvec) {
+  return evalHvecProducts(xvec, z, zw, 1, &pxvec, &hvec);
+}
+
+/*
+  Evaluate the products of the Hessian of the weighted compliance
+  with the given vectors px
+
+  The Hessian of the compliance c = f^{T}*u, where K(x)*u = f, is
+
+  H*p = 2*u^{T}*K,x*K^{-1}*(K,x*p)*u - u^{T}*(K,xx*p)*u
+
+  The product (K,x*p)*u is computed by a finite-difference of the
+  residual along p with the state fixed. The solution of K*w = (K,x*p)*u
+  is then solved with the operator that is already factored at x and
+  the second term is the finite-difference of the gradient with the
+  state held fixed. Only the contributions from the compliance
+  objective are included. The constraints in the problem are either
+  linear or their second derivatives are neglected.
+
+  The multigrid operator and the states are only re-computed when x
+  differs from the design last analyzed, with the current states as
+  initial guesses. The residuals and the gradient at x are shared by
+  all the products for the same design. When warm starts are used,
+  the solution for each load case from the previous product is the
+  initial guess for the next.
+*/
+int TMRTopoProblem::evalHvecProducts(ParOptVec *xvec, ParOptScalar *z,
+                                     ParOptVec *zw, int num_vecs,
+                                     ParOptVec **pxvec, ParOptVec **hvec) {
+  if (obj_funcs || objectiveCallback || !mg || num_load_cases == 0) {
+    fprintf(stderr,
+            "TMRTopoProblem: Hessian-vector products are only available "
+            "for the compliance objective\n");
+    return 1;
+  }
+
+  // Allocate the vectors on the first call
+  if (!hvec_xtemp) {
+    hvec_xtemp = createDesignVec();
+    hvec_xtemp->incref();
+    hvec_base = createDesignVec();
+    hvec_base->incref();
+  }
+  if (!hvec_res) {
+    hvec_res = new TACSBVec *[num_load_cases];
+    hvec_rhs = new TACSBVec *[num_load_cases];
+    hvec_sols = new TACSBVec *[num_load_cases];
+    for (int i = 0; i < num_load_cases; i++) {
+      hvec_res[i] = assembler->createVec();
+      hvec_res[i]->incref();
+      hvec_rhs[i] = assembler->createVec();
+      hvec_rhs[i]->incref();
+      hvec_sols[i] = assembler->createVec();
+      hvec_sols[i]->incref();
+    }
+  }
+
+  ParOptBVecWrap *base_wrap = dynamic_cast<ParOptBVecWrap *>(hvec_base);
+  if (!base_wrap) {
+    return 1;
+  }
+  TACSBVec *base = base_wrap->vec;
+
+  // Check if the operator is still factored at this design
+  int reuse = 0;
+  if (hvec_op_valid && hvec_design) {
+    hvec_xtemp->copyValues(xvec);
+    hvec_xtemp->axpy(-1.0, hvec_design);
+    reuse = (hvec_xtemp->maxabs() == 0.0);
+  }
+
+  setDesignVars(xvec);
+  if (!reuse) {
+    // Assemble and factor the operator and update the states
+    double alpha = 1.0, beta = 0.0, gamma = 0.0;
+    mg->assembleJacobian(alpha, beta, gamma, NULL);
+    mg->factor();
+    for (int i = 0; i < num_load_cases; i++) {
+      if (forces[i]) {
+        solveWithGuess(forces[i], vars[i]);
+        assembler->setBCs(vars[i]);
+      }
+    }
+
+    if (!hvec_design) {
+      hvec_design = createDesignVec();
+      hvec_design->incref();
+    }
+    hvec_design->copyValues(xvec);
+    hvec_op_valid = 1;
+    hvec_res_valid = 0;
+  }
+
+  // Compute the residuals and the gradient with the states fixed
+  if (!hvec_res_valid) {
+    base->zeroEntries();
+    for (int i = 0; i < num_load_cases; i++) {
+      if (forces[i]) {
+        assembler->setVariables(vars[i]);
+        assembler->assembleRes(hvec_res[i]);
+        assembler->addAdjointResProducts(-obj_weights[i], 1, &vars[i],
+                                         &base);
+      }
+      hvec_sols[i]->zeroEntries();
+    }
+    hvec_res_valid = 1;
+  }
+
+  for (int k = 0; k < num_vecs; k++) {
+    ParOptBVecWrap *wrap = dynamic_cast<ParOptBVecWrap *>(hvec[k]);
+    if (!wrap) {
+      return 1;
+    }
+    TACSBVec *h = wrap->vec;
+    h->zeroEntries();
+
+    // Scale the step so that no design variable changes by more
+    // than the finite-difference step size
+    double pmax = pxvec[k]->maxabs();
+    if (pmax == 0.0) {
+      continue;
+    }
+    double dh = TacsRealPart(dh_Kmat_2nd_deriv) / pmax;
+
+    // Compute the right-hand-sides and the gradient with the states
+    // fixed at the perturbed design
+    hvec_xtemp->copyValues(xvec);
+    hvec_xtemp->axpy(dh, pxvec[k]);
+    setDesignVars(hvec_xtemp);
+    for (int i = 0; i < num_load_cases; i++) {
+      if (forces[i]) {
+        assembler->setVariables(vars[i]);
+        assembler->assembleRes(hvec_rhs[i]);
+        hvec_rhs[i]->axpy(-1.0, hvec_res[i]);
+        hvec_rhs[i]->scale(1.0 / dh);
+        assembler->addAdjointResProducts(-obj_weights[i] / dh, 1, &vars[i],
+                                         &h);
+      }
+    }
+    h->axpy(-1.0 / dh, base);
+
+    // Solve for the state perturbations with the factored operator
+    // and add the contributions at the design x
+    setDesignVars(xvec);
+    for (int i = 0; i < num_load_cases; i++) {
+      if (forces[i]) {
+        if (use_warm_start) {
+          solveWithGuess(hvec_rhs[i], hvec_sols[i]);
+        } else {
+          ksm->solve(hvec_rhs[i], hvec_sols[i]);
+        }
+        assembler->setVariables(vars[i]);
+        assembler->addAdjointResProducts(2.0 * obj_weights[i], 1,
+                                         &hvec_sols[i], &h);
+      }
+    }
+
+    // Apply the filter transpose to the product
+    filter->addValues(h);
+  }
+
   return 0;
 }
 
@@ -1712,6 +2302,27 @@ void TMRTopoProblem::addSparseInnerProduct(double alpha, ParOptVec *x,
 /*
   Write the output file
 */
+void TMRTopoProblem::setUseAsyncOutput(int flag) {
+  if (!flag) {
+    waitForOutput();
+  }
+  use_async_output = flag;
+}
+
+/*
+  Wait for the output thread to complete writing the files (if any)
+*/
+void TMRTopoProblem::waitForOutput() {
+  if (output_thread_active) {
+    pthread_join(output_thread, NULL);
+    output_thread_active = 0;
+  }
+  if (output_data) {
+    delete output_data;
+    output_data = NULL;
+  }
+}
+
 void TMRTopoProblem::writeOutput(int iter, ParOptVec *xvec) {
   ParOptBVecWrap *wrap = dynamic_cast<ParOptBVecWrap *>(xvec);
   if (wrap && writeOutputCallback) {
@@ -1725,13 +2336,47 @@ void TMRTopoProblem::writeOutput(int iter, ParOptVec *xvec) {
     // Write out the file at a cut off of 0.25
     char filename[strlen(prefix) + 100];
 
-    for (int k = 0; k < design_vars_per_node; k++) {
-      double cutoff = 0.5;
-      snprintf(filename, sizeof(filename),
-               "%s/levelset05_var%d_binary%04d.bstl", prefix, k, iter_count);
+    if (use_async_output) {
+      // Gather the triangles on the root processor. This is collective
+      // and must be completed before the design variables change.
+      int mpi_rank, root = 0;
+      MPI_Comm_rank(assembler->getMPIComm(), &mpi_rank);
+
+      TMRSTLOutputData *data = new TMRSTLOutputData(design_vars_per_node);
+      for (int k = 0; k < design_vars_per_node; k++) {
+        double cutoff = 0.5;
+        int fail = filter->getSTLTriangles(root, k, cutoff, &data->ntris[k],
+                                           &data->tris[k]);
+        if (!fail && mpi_rank == root) {
+          snprintf(filename, sizeof(filename),
+                   "%s/levelset05_var%d_binary%04d.bstl", prefix, k,
+                   iter_count);
+          data->filenames[k] = new char[strlen(filename) + 1];
+          strcpy(data->filenames[k], filename);
+        }
+      }
 
-      // Write the STL file
-      filter->writeSTLFile(k, cutoff, filename);
+      // Wait for the previous output to complete, then write the new
+      // data from the output thread on the root processor
+      waitForOutput();
+      output_data = data;
+      if (mpi_rank == root) {
+        if (pthread_create(&output_thread, NULL, writeSTLOutputThread,
+                           (void *)output_data) == 0) {
+          output_thread_active = 1;
+        } else {
+          writeSTLOutputThread((void *)output_data);
+        }
+      }
+    } else {
+      for (int k = 0; k < design_vars_per_node; k++) {
+        double cutoff = 0.5;
+        snprintf(filename, sizeof(filename),
+                 "%s/levelset05_var%d_binary%04d.bstl", prefix, k, iter_count);
+
+        // Write the STL file
+        filter->writeSTLFile(k, cutoff, filename);
+      }
     }
   }
 
@@ -21,6 +21,8 @@
 #ifndef TMR_TOPO_PROBLEM_H
 #define TMR_TOPO_PROBLEM_H
 
+#include <pthread.h>
+
 #include "ParOptProblem.h"
 #include "TACSAssembler.h"
 #include "TACSBuckling.h"
@@ -53,10 +55,27 @@ class ParOptBVecWrap : public ParOptVec {
   void axpy(ParOptScalar alpha, ParOptVec *pvec);
   int getArray(ParOptScalar **array);
 
+  // Fused and non-blocking reductions
+  // ---------------------------------
+  void mdotNorm(ParOptVec **vecs, int nvecs, ParOptScalar *output,
+                double *nrm);
+  void beginMdot(ParOptVec **vecs, int nvecs, ParOptScalar *output);
+  void endMdot();
+
   // The underlying TACSBVec object
   TACSBVec *vec;
+
+ private:
+  // Compute the local contributions to the dot products
+  void localMdot(ParOptVec **vecs, int nvecs, ParOptScalar *output);
+
+  // The request for a reduction started by beginMdot()
+  MPI_Request mdot_request;
 };
 
+// Data for the asynchronous output of the STL files
+class TMRSTLOutputData;
+
 /*
   The implementation of the ParOptProblem class
 */
@@ -74,6 +93,16 @@ class TMRTopoProblem : public ParOptProblem {
   void setLoadCases(TACSBVec **_forces, int _num_load_cases);
   int getNumLoadCases();
 
+  // Solve all load cases together by projecting each right-hand-side
+  // onto the span of the load case solutions to get the initial guess
+  // -----------------------------------------------------------------
+  void setUseMultiRHSSolve(int flag);
+
+  // Use the state and adjoint vectors from the previous design
+  // iteration as the initial guesses for the linear solves
+  // ----------------------------------------------------------
+  void setUseWarmStart(int flag);
+
   // Set the output frequency, element type and flags for f5 files
   // -------------------------------------------------------------
   void setF5OutputFlags(int freq, ElementType elem_type, int flag);
@@ -149,6 +178,12 @@ class TMRTopoProblem : public ParOptProblem {
   // --------------------------------
   void setIterationCounter(int iter);
 
+  // Write the STL output files from a background thread on the root
+  // processor so that the file system writes overlap the optimization
+  // -----------------------------------------------------------------
+  void setUseAsyncOutput(int flag);
+  void waitForOutput();
+
   // Create a design variable vector
   // -------------------------------
   ParOptVec *createDesignVec();
@@ -188,6 +223,11 @@ class TMRTopoProblem : public ParOptProblem {
   int evalHvecProduct(ParOptVec *xvec, ParOptScalar *z, ParOptVec *zw,
                       ParOptVec *pxvec, ParOptVec *hvec);
 
+  // Evaluate the products of the Hessian with several vectors at once
+  // -----------------------------------------------------------------
+  int evalHvecProducts(ParOptVec *xvec, ParOptScalar *z, ParOptVec *zw,
+                       int num_vecs, ParOptVec **pxvec, ParOptVec **hvec);
+
   // Evaluate the sparse constraints
   // -------------------------------
   void evalSparseCon(ParOptVec *x, ParOptVec *out);
@@ -246,12 +286,29 @@ class TMRTopoProblem : public ParOptProblem {
   // Set the design variables across all multigrid levels
   void setDesignVars(ParOptVec *xvec);
 
+  // Solve the linear systems for all of the load cases
+  void solveLoadCases();
+
+  // Solve K*x = rhs using the input x as the initial guess
+  void solveWithGuess(TACSBVec *rhs, TACSBVec *x);
+
+  // Solve the adjoint equations for the given adjoint index
+  TACSBVec *solveAdjoint(int index, TACSBVec *rhs);
+
   // Store the prefix
   char *prefix;
 
   // Set the iteration count for printing to the file
   int iter_count;
 
+  // Data for the asynchronous output. The triangles are gathered to
+  // the root processor and written by the output thread while the
+  // next output buffer is filled.
+  int use_async_output;
+  int output_thread_active;
+  pthread_t output_thread;
+  TMRSTLOutputData *output_data;
+
   // Set the number of variables per node (defaults to 1)
   int design_vars_per_node;
 
@@ -260,6 +317,18 @@ class TMRTopoProblem : public ParOptProblem {
   int num_load_cases;
   TACSBVec **vars, **forces;
 
+  // Data for the multiple right-hand-side solution mode. The products
+  // of the stiffness matrix with the solution vectors are stored.
+  int use_multi_rhs;
+  TACSBVec **load_case_prods;
+  double ksm_rtol, ksm_atol;
+
+  // The adjoint vectors from the previous iteration, stored in the
+  // order that the adjoint equations are solved
+  int use_warm_start;
+  int num_adjoint_guesses;
+  TACSBVec **adjoint_guesses;
+
   // The linear constraints -- independent of load case
   int num_linear_con;
   ParOptVec **Alinear;
@@ -330,6 +399,14 @@ class TMRTopoProblem : public ParOptProblem {
 
   // Vectors used by quasi-Newton update correction
   ParOptVec *proj_deriv, *x_h, *s_temp;
+
+  // Data for the Hessian-vector products. The multigrid operator and
+  // the states are reused while they are valid for the design stored
+  // in hvec_design. The residuals and the gradient with the states
+  // held fixed are computed once for each design.
+  int hvec_op_valid, hvec_res_valid;
+  ParOptVec *hvec_design, *hvec_xtemp, *hvec_base;
+  TACSBVec **hvec_res, **hvec_rhs, **hvec_sols;
 };
 
 #endif  // TMR_TOPO_PROBLEM_H
@@ -52,30 +52,132 @@ TMROctTACSTopoCreator::~TMROctTACSTopoCreator() {
   }
 }
 
+/*
+  Tabulated filter shape functions for one node of the analysis
+  elements
+
+  The node of an analysis octant that is d levels finer than the
+  enclosing filter octant lies at one of 2^d x 2^d x 2^d positions
+  within the filter octant. The shape functions at each position are
+  evaluated the first time they are needed and then re-used. Level
+  differences that are negative or too large are not tabulated.
+*/
+class TMROctFilterWeightTable {
+ public:
+  static const int MAX_LEVEL_DIFF = 5;
+
+  TMROctFilterWeightTable(TMROctForest *_filter, const int _mesh_order,
+                          const double *_knots, const int _info) {
+    filter = _filter;
+    const int order = filter->getMeshOrder();
+    nweights = order * order * order;
+
+    // Compute the location of the node within the analysis octant
+    const int i = _info % _mesh_order;
+    const int j = (_info % (_mesh_order * _mesh_order)) / _mesh_order;
+    const int k = _info / (_mesh_order * _mesh_order);
+    info = _info;
+    node_pt[0] = _knots[i];
+    node_pt[1] = _knots[j];
+    node_pt[2] = _knots[k];
+
+    for (int d = 0; d <= MAX_LEVEL_DIFF; d++) {
+      N[d] = NULL;
+      flags[d] = NULL;
+    }
+  }
+  ~TMROctFilterWeightTable() {
+    for (int d = 0; d <= MAX_LEVEL_DIFF; d++) {
+      if (N[d]) {
+        delete[] N[d];
+        delete[] flags[d];
+      }
+    }
+  }
+
+  // Get the shape functions for the node of the analysis octant within
+  // the filter octant, or NULL if this case is not tabulated
+  const double *getShapeFuncs(const TMROctant *node, const TMROctant *oct) {
+    const int d = node->level - oct->level;
+    if (node->info != info || d < 0 || d > MAX_LEVEL_DIFF) {
+      return NULL;
+    }
+
+    // Compute the position of the analysis octant within the filter
+    // octant, relative to the analysis octant size
+    const int32_t hoct = 1 << (TMR_MAX_LEVEL - oct->level);
+    const int shift = TMR_MAX_LEVEL - node->level;
+    const int n = 1 << d;
+    const int sx = (node->x % hoct) >> shift;
+    const int sy = (node->y % hoct) >> shift;
+    const int sz = (node->z % hoct) >> shift;
+    const int index = sx + n * (sy + n * sz);
+
+    if (!N[d]) {
+      N[d] = new double[n * n * n * nweights];
+      flags[d] = new char[n * n * n];
+      memset(flags[d], 0, n * n * n * sizeof(char));
+    }
+
+    double *Nd = &N[d][nweights * index];
+    if (!flags[d][index]) {
+      double pt[3];
+      pt[0] = -1.0 + (2.0 * sx + 1.0 + node_pt[0]) / n;
+      pt[1] = -1.0 + (2.0 * sy + 1.0 + node_pt[1]) / n;
+      pt[2] = -1.0 + (2.0 * sz + 1.0 + node_pt[2]) / n;
+      filter->evalInterp(pt, Nd);
+      flags[d][index] = 1;
+    }
+
+    return Nd;
+  }
+
+ private:
+  TMROctForest *filter;
+  int nweights;
+
+  // The node information and parametric location within the octant
+  int info;
+  double node_pt[3];
+
+  // The shape functions for each level difference and whether they
+  // have been computed yet
+  double *N[MAX_LEVEL_DIFF + 1];
+  char *flags[MAX_LEVEL_DIFF + 1];
+};
+
 void TMROctTACSTopoCreator::computeWeights(const int mesh_order,
                                            const double *knots, TMROctant *node,
                                            TMROctant *oct,
-                                           TMRIndexWeight *weights,
-                                           double *tmp) {
-  // Find the side length of the octant in the filter that contains
-  // the element octant
-  const int32_t h = 1 << (TMR_MAX_LEVEL - node->level);
-  const int32_t hoct = 1 << (TMR_MAX_LEVEL - oct->level);
-
-  // Compute the i, j, k location of the nod
-  const int i = node->info % mesh_order;
-  const int j = (node->info % (mesh_order * mesh_order)) / mesh_order;
-  const int k = node->info / (mesh_order * mesh_order);
-
-  // Get the u/v/w values within the filter octant
-  double pt[3];
-  pt[0] = -1.0 + 2.0 * ((node->x % hoct) + 0.5 * h * (1.0 + knots[i])) / hoct;
-  pt[1] = -1.0 + 2.0 * ((node->y % hoct) + 0.5 * h * (1.0 + knots[j])) / hoct;
-  pt[2] = -1.0 + 2.0 * ((node->z % hoct) + 0.5 * h * (1.0 + knots[k])) / hoct;
+                                           TMRIndexWeight *weights, double *tmp,
+                                           TMROctFilterWeightTable *table) {
+  // Look up the shape functions in the table, if possible
+  const double *N = NULL;
+  if (table) {
+    N = table->getShapeFuncs(node, oct);
+  }
 
-  // Get the Lagrange shape functions
-  double *N = tmp;
-  filter->evalInterp(pt, N);
+  if (!N) {
+    // Find the side length of the octant in the filter that contains
+    // the element octant
+    const int32_t h = 1 << (TMR_MAX_LEVEL - node->level);
+    const int32_t hoct = 1 << (TMR_MAX_LEVEL - oct->level);
+
+    // Compute the i, j, k location of the nod
+    const int i = node->info % mesh_order;
+    const int j = (node->info % (mesh_order * mesh_order)) / mesh_order;
+    const int k = node->info / (mesh_order * mesh_order);
+
+    // Get the u/v/w values within the filter octant
+    double pt[3];
+    pt[0] = -1.0 + 2.0 * ((node->x % hoct) + 0.5 * h * (1.0 + knots[i])) / hoct;
+    pt[1] = -1.0 + 2.0 * ((node->y % hoct) + 0.5 * h * (1.0 + knots[j])) / hoct;
+    pt[2] = -1.0 + 2.0 * ((node->z % hoct) + 0.5 * h * (1.0 + knots[k])) / hoct;
+
+    // Get the Lagrange shape functions
+    filter->evalInterp(pt, tmp);
+    N = tmp;
+  }
 
   // Get the dependent node information for this mesh
   const int *dep_ptr, *dep_conn;
@@ -163,6 +265,11 @@ void TMROctTACSTopoCreator::createElements(int order, TMROctForest *forest,
   const double node_knots[] = {-1.0, 0.0, 1.0};
   const int node_order = 3;
 
+  // The shape functions at the central node take only a few distinct
+  // values that depend on the position within the filter octant
+  TMROctFilterWeightTable *table =
+      new TMROctFilterWeightTable(filter, node_order, node_knots, node_info);
+
   for (int i = 0; i < num_octs; i++) {
     // Get the original octant from the forest
     TMROctant node = octs[i];
@@ -180,7 +287,7 @@ void TMROctTACSTopoCreator::createElements(int order, TMROctForest *forest,
       queue->push(&node);
       weights[nweights * i].index = -1;
     } else {
-      computeWeights(node_order, node_knots, &node, oct, wtmp, tmp);
+      computeWeights(node_order, node_knots, &node, oct, wtmp, tmp, table);
       memcpy(&weights[nweights * i], wtmp, nweights * sizeof(TMRIndexWeight));
     }
   }
@@ -208,7 +315,8 @@ void TMROctTACSTopoCreator::createElements(int order, TMROctForest *forest,
     TMROctant *oct =
         filter->findEnclosing(node_order, node_knots, &dist_array[i]);
     if (oct) {
-      computeWeights(node_order, node_knots, &dist_array[i], oct, wtmp, tmp);
+      computeWeights(node_order, node_knots, &dist_array[i], oct, wtmp, tmp,
+                     table);
       memcpy(&dist_weights[nweights * i], wtmp,
              nweights * sizeof(TMRIndexWeight));
     } else {
@@ -217,6 +325,7 @@ void TMROctTACSTopoCreator::createElements(int order, TMROctForest *forest,
   }
 
   // Free the temporary space
+  delete table;
   delete[] wtmp;
   delete[] tmp;
 
@@ -24,6 +24,8 @@
 #include "TACSAssembler.h"
 #include "TMR_TACSCreator.h"
 
+class TMROctFilterWeightTable;
+
 /*
   This is an abstract base class used to create octforests specialized
   for topology optimization. This class can be overriden with the
@@ -48,7 +50,7 @@ class TMROctTACSTopoCreator : public TMROctTACSCreator {
   // Compute the weights for a given point
   void computeWeights(const int mesh_order, const double *knots,
                       TMROctant *node, TMROctant *oct, TMRIndexWeight *weights,
-                      double *tmp);
+                      double *tmp, TMROctFilterWeightTable *table = NULL);
 
   // The filter indices. This defines the relationship between the
   // local design variable numbers and the global design variable
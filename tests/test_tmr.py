@@ -1,8 +1,17 @@
+import functools
+import os
+import shutil
+import tempfile
 import numpy as np
 from mpi4py import MPI
 from tmr import TMR
 import unittest
 
+try:
+    from tacs import TACS
+except ImportError:
+    TACS = None
+
 
 class BsplineTest(unittest.TestCase):
     def test_run(self):
@@ -334,3 +343,316 @@ class BsplineTest(unittest.TestCase):
         mesh.mesh(hval)
 
         return
+
+
+def random_octants(rng, n, nblocks, use_nodes):
+    """Create n octants with unique positions (and info for nodes)"""
+    octants = []
+    keys = set()
+    while len(octants) < n:
+        oc = TMR.Octant()
+        oc.block = int(rng.integers(0, nblocks))
+        oc.level = int(rng.integers(0, TMR.MAX_LEVEL + 1))
+        h = 1 << (TMR.MAX_LEVEL - oc.level)
+        ncells = 1 << min(oc.level, 20)
+        oc.x = h * int(rng.integers(0, ncells))
+        oc.y = h * int(rng.integers(0, ncells))
+        oc.z = h * int(rng.integers(0, ncells))
+        if use_nodes:
+            oc.info = int(rng.integers(0, 3))
+        key = (oc.block, oc.x, oc.y, oc.z, oc.info)
+        if key not in keys:
+            keys.add(key)
+            octants.append(oc)
+    return octants
+
+
+def random_quadrants(rng, n, nfaces, use_nodes):
+    """Create n quadrants with unique positions (and info for nodes)"""
+    quadrants = []
+    keys = set()
+    while len(quadrants) < n:
+        quad = TMR.Quadrant()
+        quad.face = int(rng.integers(0, nfaces))
+        quad.level = int(rng.integers(0, TMR.MAX_LEVEL + 1))
+        h = 1 << (TMR.MAX_LEVEL - quad.level)
+        ncells = 1 << min(quad.level, 20)
+        quad.x = h * int(rng.integers(0, ncells))
+        quad.y = h * int(rng.integers(0, ncells))
+        if use_nodes:
+            quad.info = int(rng.integers(0, 3))
+        key = (quad.face, quad.x, quad.y, quad.info)
+        if key not in keys:
+            keys.add(key)
+            quadrants.append(quad)
+    return quadrants
+
+
+def two_block_connectivity():
+    """
+    Create the connectivity for two blocks side by side in x, with the
+    same orientation, so that each octant has a global location
+    """
+    conn = np.zeros((2, 8), dtype=np.intc)
+    for b in range(2):
+        for n in range(8):
+            i, j, k = n % 2, (n // 2) % 2, n // 4
+            conn[b, n] = (b + i) + 3 * j + 6 * k
+    return conn
+
+
+class SortTest(unittest.TestCase):
+    # Sizes on either side of the switch from qsort to the radix sort
+    sizes = [1, 64, 127, 128, 129, 2000]
+
+    def check_sort(self, items, array, use_nodes, fields):
+        if use_nodes:
+            key = functools.cmp_to_key(lambda a, b: a.compareNode(b))
+        else:
+            key = functools.cmp_to_key(lambda a, b: a.compare(b))
+        expected = []
+        for item in sorted(items, key=key):
+            expected.append(tuple(getattr(item, f) for f in fields))
+
+        array.sort()
+        result = []
+        for i in range(len(array)):
+            result.append(tuple(getattr(array[i], f) for f in fields))
+        self.assertEqual(result, expected)
+
+    def test_octants(self):
+        rng = np.random.default_rng(0)
+        fields = ["block", "x", "y", "z", "level", "info"]
+        for use_nodes in [False, True]:
+            for nblocks in [1, 5]:
+                for n in self.sizes:
+                    octs = random_octants(rng, n, nblocks, use_nodes)
+                    array = TMR.OctantArray(octs, use_nodes=use_nodes)
+                    self.check_sort(octs, array, use_nodes, fields)
+
+    def test_quadrants(self):
+        rng = np.random.default_rng(1)
+        fields = ["face", "x", "y", "level", "info"]
+        for use_nodes in [False, True]:
+            for nfaces in [1, 5]:
+                for n in self.sizes:
+                    quads = random_quadrants(rng, n, nfaces, use_nodes)
+                    array = TMR.QuadrantArray(quads, use_nodes=use_nodes)
+                    self.check_sort(quads, array, use_nodes, fields)
+
+
+class BalanceTest(unittest.TestCase):
+    def test_balance(self):
+        comm = MPI.COMM_WORLD
+        hmax = 1 << TMR.MAX_LEVEL
+
+        conn = two_block_connectivity()
+
+        for btype in [0, 1]:
+            forest = TMR.OctForest(comm)
+            forest.setConnectivity(conn)
+            forest.createRandomTrees(nrand=20, min_lev=0, max_lev=6)
+            forest.balance(btype)
+
+            octs = forest.getOctantsView()
+            fields = ["block", "x", "y", "z", "level"]
+            local = [tuple(int(o[f]) for f in fields) for o in octs]
+            octants = [oc for part in comm.allgather(local) for oc in part]
+            octset = set(octants)
+            self.assertEqual(len(octset), len(octants))
+            levels = range(max(oc[4] for oc in octants) + 1)
+
+            # The octants must not overlap and must fill both blocks
+            volume = 0
+            for block, x, y, z, level in octants:
+                for lev in range(level):
+                    mask = ~((1 << (TMR.MAX_LEVEL - lev)) - 1)
+                    parent = (block, x & mask, y & mask, z & mask, lev)
+                    self.assertNotIn(parent, octset)
+                volume += (1 << (TMR.MAX_LEVEL - level)) ** 3
+            self.assertEqual(volume, 2 * hmax**3)
+
+            # Find the level of the octant that contains a global point
+            def find_level(X, y, z):
+                block, x = X // hmax, X % hmax
+                for lev in levels:
+                    mask = ~((1 << (TMR.MAX_LEVEL - lev)) - 1)
+                    if (block, x & mask, y & mask, z & mask, lev) in octset:
+                        return lev
+                return None
+
+            # Check the 2:1 balance across the faces and edges, and the
+            # corners when they are balanced, including between blocks
+            for block, x, y, z, level in octants:
+                h = 1 << (TMR.MAX_LEVEL - level)
+                X = x + block * hmax
+                for d in range(27):
+                    dx, dy, dz = d % 3 - 1, (d // 3) % 3 - 1, d // 9 - 1
+                    nz = abs(dx) + abs(dy) + abs(dz)
+                    if nz == 0 or (btype == 0 and nz == 3):
+                        continue
+                    p = [
+                        X + (-1 if dx < 0 else h if dx > 0 else 0),
+                        y + (-1 if dy < 0 else h if dy > 0 else 0),
+                        z + (-1 if dz < 0 else h if dz > 0 else 0),
+                    ]
+                    if p[0] < 0 or p[0] >= 2 * hmax:
+                        continue
+                    if min(p[1], p[2]) < 0 or max(p[1], p[2]) >= hmax:
+                        continue
+                    lev = find_level(*p)
+                    self.assertIsNotNone(lev)
+                    self.assertGreaterEqual(lev, level - 1)
+
+
+class CheckpointTest(unittest.TestCase):
+    """
+    Write a forest on one processor and read it on all of them, and the
+    reverse. With two octants and three or more processors, some
+    processors read no octants.
+    """
+
+    fields = ["block", "x", "y", "z", "level"]
+
+    def get_octants(self, forest, comm):
+        local = [tuple(int(o[f]) for f in self.fields) for o in forest.getOctantsView()]
+        return comm.allgather(local)
+
+    def create_forest(self, comm, case):
+        forest = TMR.OctForest(comm)
+        forest.setConnectivity(two_block_connectivity())
+        if case == 0:
+            forest.createTrees(0)
+        else:
+            forest.createRandomTrees(nrand=10, min_lev=0, max_lev=4)
+            forest.balance(1)
+        return forest
+
+    def check_read(self, fname, octants, num_nodes):
+        comm = MPI.COMM_WORLD
+        forest = TMR.OctForest(comm)
+        self.assertEqual(forest.readForestFromFile(fname), 0)
+        parts = self.get_octants(forest, comm)
+        self.assertEqual([oc for part in parts for oc in part], octants)
+
+        # Each ghost must be owned by the processor that holds it
+        owner = {}
+        for rank, part in enumerate(parts):
+            for oc in part:
+                owner[oc] = rank
+        ghosts, ghost_owners, layer_ptr = forest.getGhostOctants(1)
+        for i in range(layer_ptr[1]):
+            g = ghosts[i]
+            key = tuple(getattr(g, f) for f in self.fields)
+            self.assertEqual(owner[key], ghost_owners[i])
+
+        forest.createNodes()
+        self.assertEqual(forest.getNodeRange()[-1], num_nodes)
+
+    def test_checkpoint(self):
+        comm = MPI.COMM_WORLD
+        dirname = None
+        if comm.rank == 0:
+            dirname = tempfile.mkdtemp()
+        dirname = comm.bcast(dirname, root=0)
+        fname = os.path.join(dirname, "forest.tmr")
+
+        for case in [0, 1]:
+            # Write on the first processor alone and read on all
+            octants, num_nodes = None, None
+            if comm.rank == 0:
+                forest = self.create_forest(MPI.COMM_SELF, case)
+                self.assertEqual(forest.writeForestToFile(fname), 0)
+                octants = self.get_octants(forest, MPI.COMM_SELF)[0]
+                forest.createNodes()
+                num_nodes = forest.getNodeRange()[-1]
+            octants, num_nodes = comm.bcast((octants, num_nodes), root=0)
+            comm.barrier()
+            self.check_read(fname, octants, num_nodes)
+            comm.barrier()
+
+            # Write on all processors and read on each processor alone
+            forest = self.create_forest(comm, case)
+            self.assertEqual(forest.writeForestToFile(fname), 0)
+            octants = [oc for part in self.get_octants(forest, comm) for oc in part]
+            forest.createNodes()
+            num_nodes = forest.getNodeRange()[-1]
+            comm.barrier()
+
+            forest = TMR.OctForest(MPI.COMM_SELF)
+            self.assertEqual(forest.readForestFromFile(fname), 0)
+            self.assertEqual(self.get_octants(forest, MPI.COMM_SELF)[0], octants)
+            forest.createNodes()
+            self.assertEqual(forest.getNodeRange()[-1], num_nodes)
+            comm.barrier()
+
+        if comm.rank == 0:
+            shutil.rmtree(dirname)
+
+
+@unittest.skipIf(TACS is None, "TACS is not installed")
+class InterpolationCacheTest(unittest.TestCase):
+    """
+    Check that the interpolation replayed from the cache, and the one
+    rebuilt after either forest is refined, match an interpolation
+    built without the cache
+    """
+
+    def create_forest(self, comm, order, depth):
+        forest = TMR.OctForest(comm, order=order)
+        forest.setConnectivity(two_block_connectivity())
+        forest.createTrees(depth)
+        forest.repartition()
+        forest.createNodes()
+        return forest
+
+    def refine(self, forest, mod):
+        refine = np.zeros(len(forest.getOctants()), dtype=np.intc)
+        refine[::mod] = 1
+        forest.refine(refine)
+        forest.balance(1)
+        forest.repartition()
+        forest.createNodes()
+
+    def interpolate(self, comm, fine, coarse):
+        coarse_range = coarse.getNodeRange()
+        fine_range = fine.getNodeRange()
+        c0, c1 = coarse_range[comm.rank], coarse_range[comm.rank + 1]
+        f0, f1 = fine_range[comm.rank], fine_range[comm.rank + 1]
+        coarse_map = TACS.NodeMap(comm, c1 - c0)
+        fine_map = TACS.NodeMap(comm, f1 - f0)
+
+        interp = TACS.VecInterp(coarse_map, fine_map, 1)
+        fine.createInterpolation(coarse, interp)
+        interp.initialize()
+
+        # Interpolate values that depend only on the global node numbers
+        x = TACS.Vec(coarse_map, 1)
+        y = TACS.Vec(fine_map, 1)
+        x.getArray()[:] = np.sin(1.0 + np.arange(c0, c1))
+        interp.mult(x, y)
+        return np.array(y.getArray())
+
+    def test_cache(self):
+        comm = MPI.COMM_WORLD
+        coarse = self.create_forest(comm, 2, 1)
+        fine = self.create_forest(comm, 3, 1)
+        self.refine(fine, 3)
+
+        # Record the interpolation and replay it
+        fine.setCacheInterpolation(1)
+        y0 = self.interpolate(comm, fine, coarse)
+        y1 = self.interpolate(comm, fine, coarse)
+        self.assertTrue(np.allclose(y0, y1, rtol=1e-14, atol=1e-14))
+
+        # Refine each forest in turn. The cached interpolation must be
+        # rebuilt, and replayed after that.
+        for forest in [fine, coarse]:
+            self.refine(forest, 5)
+            fine.setCacheInterpolation(1)
+            y0 = self.interpolate(comm, fine, coarse)
+            y1 = self.interpolate(comm, fine, coarse)
+            fine.setCacheInterpolation(0)
+            y2 = self.interpolate(comm, fine, coarse)
+            self.assertTrue(np.allclose(y0, y2, rtol=1e-14, atol=1e-14))
+            self.assertTrue(np.allclose(y1, y2, rtol=1e-14, atol=1e-14))
@@ -71,11 +71,59 @@ STRUCTURED = TMR_STRUCTURED
 UNSTRUCTURED = TMR_UNSTRUCTURED
 TRIANGLE = TMR_TRIANGLE
 
+# Set the distribution of the face meshing across processors
+NO_DISTRIBUTION = TMR_NO_DISTRIBUTION
+STATIC_DISTRIBUTION = TMR_STATIC_DISTRIBUTION
+COST_DISTRIBUTION = TMR_COST_DISTRIBUTION
+
+# Set the ordering of the nodes in the mesh
+NATURAL_ORDER = TMR_NATURAL_ORDER
+RCM_ORDER = TMR_RCM_ORDER
+
 # Set the type of interpolation to use
 UNIFORM_POINTS = TMR_UNIFORM_POINTS
 GAUSS_LOBATTO_POINTS = TMR_GAUSS_LOBATTO_POINTS
 BERNSTEIN_POINTS = TMR_BERNSTEIN_POINTS
 
+# Set the phases that are profiled
+PROFILE_BALANCE = TMR_PROFILE_BALANCE
+PROFILE_REPARTITION = TMR_PROFILE_REPARTITION
+PROFILE_CREATE_NODES = TMR_PROFILE_CREATE_NODES
+PROFILE_CREATE_INTERPOLATION = TMR_PROFILE_CREATE_INTERPOLATION
+PROFILE_MESH = TMR_PROFILE_MESH
+
+# Structured types with the same memory layout as TMRQuadrant/TMROctant
+QUADRANT_DTYPE = np.dtype([('face', np.int32), ('x', np.int32),
+                           ('y', np.int32), ('tag', np.int32),
+                           ('level', np.int16), ('info', np.int16)])
+OCTANT_DTYPE = np.dtype([('block', np.int32), ('x', np.int32),
+                         ('y', np.int32), ('z', np.int32),
+                         ('tag', np.int32), ('level', np.int16),
+                         ('info', np.int16)])
+
+# Wrap C++ data with a numpy array that does not copy the data. The
+# array keeps a reference to the owner so that the owner outlives it.
+cdef inplace_view(object owner, int nptype, int dim1, int dim2,
+                  void *data_ptr):
+    cdef int ndim = 1
+    cdef np.npy_intp shape[2]
+    cdef np.ndarray ndarray
+    shape[0] = <np.npy_intp>dim1
+    shape[1] = <np.npy_intp>dim2
+    if dim2 > 0:
+        ndim = 2
+    ndarray = np.PyArray_SimpleNewFromData(ndim, shape, nptype, data_ptr)
+    np.set_array_base(ndarray, owner)
+    return ndarray
+
+# Convert the refinement input to a contiguous integer array
+cdef np.ndarray _refine_array(refine, int size):
+    cdef np.ndarray array = np.ascontiguousarray(refine, dtype=np.intc)
+    if array.ndim != 1 or array.shape[0] != size:
+        errmsg = 'Refinement array must have length %d'%(size)
+        raise ValueError(errmsg)
+    return array
+
 cdef class Vertex:
     """
     The vertex class is used to store both the point and to
@@ -798,6 +846,40 @@ cdef class Face:
         self.ptr.evalPoint(u, v, &pt)
         return np.array([pt.x, pt.y, pt.z])
 
+    def evalPoints(self, np.ndarray[double, ndim=2, mode='c'] uv):
+        """
+        evalPoints(self, uv)
+
+        Evaluate the node locations at an array of parametric locations
+
+        Args:
+            uv (np.ndarray): Array of (u, v) parametric locations
+
+        Returns:
+            np.ndarray: Array of the node locations
+        """
+        cdef int n = uv.shape[0]
+        cdef np.ndarray X = np.zeros((n, 3), dtype=np.double)
+        self.ptr.evalPoints(n, <double*>uv.data, <TMRPoint*>X.data)
+        return X
+
+    def invEvalPoints(self, np.ndarray[double, ndim=2, mode='c'] X):
+        """
+        invEvalPoints(self, X)
+
+        Find the parametric locations of an array of node locations
+
+        Args:
+            X (np.ndarray): Array of the node locations
+
+        Returns:
+            np.ndarray: Array of (u, v) parametric locations
+        """
+        cdef int n = X.shape[0]
+        cdef np.ndarray uv = np.zeros((n, 2), dtype=np.double)
+        self.ptr.invEvalPoints(n, <TMRPoint*>X.data, <double*>uv.data)
+        return uv
+
     def setName(self, aname):
         """
         setName(self, aname)
@@ -2144,6 +2226,21 @@ cdef class MeshOptions:
         def __set__(self, value):
             self.ptr.num_smoothing_steps=value
 
+    property smoothing_tolerance:
+        """
+        Stop the smoothing before the specified number of steps once no point
+        moves more than this fraction of the mean edge length in a step. A
+        value of zero always applies all the smoothing steps.
+
+        Args:
+            value (float): Relative smoothing tolerance
+        """
+        def __get__(self):
+            return self.ptr.smoothing_tolerance
+        def __set__(self, value):
+            if value >= 0.0:
+                self.ptr.smoothing_tolerance = value
+
     property frontal_quality_factor:
         """
         Use the mesh quality indicator to determine when to accept new triangles
@@ -2157,6 +2254,64 @@ cdef class MeshOptions:
         def __set__(self, value):
             self.ptr.frontal_quality_factor = value
 
+    property num_frontal_subdomains:
+        """
+        Split the parameter domain of large unstructured faces into at most
+        this many subdomains. The subdomains share their interface points and
+        are triangulated concurrently, then recombined as a single mesh. Note
+        that the geometry evaluation must be thread-safe.
+
+        Args:
+            value (int): Maximum number of subdomains per face
+        """
+        def __get__(self):
+            return self.ptr.num_frontal_subdomains
+        def __set__(self, value):
+            if value >= 1:
+                self.ptr.num_frontal_subdomains = value
+
+    property frontal_subdomain_min_triangles:
+        """
+        Only split a face if each subdomain is expected to contain at least
+        this many triangles.
+
+        Args:
+            value (int): Minimum number of triangles per subdomain
+        """
+        def __get__(self):
+            return self.ptr.frontal_subdomain_min_triangles
+        def __set__(self, value):
+            self.ptr.frontal_subdomain_min_triangles = value
+
+    property greedy_recombine_min_triangles:
+        """
+        Recombine faces with at least this many triangles using a greedy
+        matching with local repair instead of the exact perfect matching.
+        A value of zero always uses the exact perfect matching.
+
+        Args:
+            value (int): Minimum number of triangles
+        """
+        def __get__(self):
+            return self.ptr.greedy_recombine_min_triangles
+        def __set__(self, value):
+            self.ptr.greedy_recombine_min_triangles = value
+
+    property greedy_recombine_tolerance:
+        """
+        Relative tolerance on the weight of the greedy matching compared to a
+        lower bound on the optimal matching weight. If the greedy matching
+        exceeds this tolerance, the exact perfect matching is used instead.
+
+        Args:
+            value (float): Relative weight tolerance
+        """
+        def __get__(self):
+            return self.ptr.greedy_recombine_tolerance
+        def __set__(self, value):
+            if value >= 0.0:
+                self.ptr.greedy_recombine_tolerance = value
+
     property triangularize_print_level:
         """
         Print level to provide more verbosity during the triangularization
@@ -2183,6 +2338,63 @@ cdef class MeshOptions:
         def __set__(self, value):
             self.ptr.reset_mesh_objects = value
 
+    property face_mesh_distribution:
+        """
+        Distribute the face meshing across processors. With NO_DISTRIBUTION,
+        each face is meshed on the root processor. STATIC_DISTRIBUTION assigns
+        the faces to processors in contiguous blocks, while COST_DISTRIBUTION
+        balances the estimated meshing cost. Faces linked by source or copy
+        relationships are always meshed on the same processor.
+        """
+        def __get__(self):
+            return self.ptr.face_mesh_distribution
+        def __set__(self, TMRFaceMeshDistribution value):
+            self.ptr.face_mesh_distribution = value
+
+    property num_threads:
+        """
+        Number of threads used to mesh independent faces on each processor.
+        The geometry evaluation must be thread-safe when this is larger than
+        one.
+
+        Args:
+            value (int): Number of threads
+        """
+        def __get__(self):
+            return self.ptr.num_threads
+        def __set__(self, value):
+            if value >= 1:
+                self.ptr.num_threads = value
+
+    property node_ordering:
+        """
+        Ordering of the nodes and elements in the global mesh. NATURAL_ORDER
+        numbers the vertices, edges, faces and then volumes. RCM_ORDER applies
+        a reverse Cuthill-McKee ordering to reduce the bandwidth of the mesh.
+        """
+        def __get__(self):
+            return self.ptr.node_ordering
+        def __set__(self, TMRMeshNodeOrdering value):
+            self.ptr.node_ordering = value
+
+    property mesh_cache_dir:
+        """
+        Directory used to cache the edge and face meshes. When set, each edge
+        and face mesh is stored in this directory and is loaded instead of
+        re-meshing the entity when its geometry, the feature size and the
+        options are unchanged. Faces meshed from a source or copy face, and
+        meshes with a feature size that cannot be represented exactly in the
+        cache key, are not cached.
+
+        Args:
+            value (str): Cache directory (an empty string disables the cache)
+        """
+        def __get__(self):
+            return self.ptr.mesh_cache_dir.decode("utf-8")
+        def __set__(self, value):
+            cdef bytes path = value.encode("utf-8")[:255]
+            strcpy(self.ptr.mesh_cache_dir, path)
+
     property write_mesh_quality_histogram:
         """
         Write out a histogram of the mesh quality in the final smoothed
@@ -2270,6 +2482,23 @@ cdef class ElementFeatureSize:
         pt.z = x[2]
         return self.ptr.getFeatureSize(pt)
 
+    def getFeatureSizes(self, np.ndarray[double, ndim=2, mode='c'] X):
+        """
+        getFeatureSizes(self, X)
+
+        Evaluate the feature size at an array of points
+
+        Args:
+            X (np.ndarray): Array of the point locations
+
+        Returns:
+            np.ndarray: Array of the feature sizes
+        """
+        cdef int n = X.shape[0]
+        cdef np.ndarray h = np.zeros(n, dtype=np.double)
+        self.ptr.getFeatureSizes(n, <TMRPoint*>X.data, <double*>h.data)
+        return h
+
 cdef class ConstElementSize(ElementFeatureSize):
     def __cinit__(self, double h):
         self.ptr = new TMRElementFeatureSize(h)
@@ -2311,7 +2540,8 @@ cdef class BoxFeatureSize(ElementFeatureSize):
 cdef class PointFeatureSize(ElementFeatureSize):
     def __cinit__(self, np.ndarray[double, ndim=2, mode='c'] X,
                   np.ndarray[double, ndim=1, mode='c'] hvals,
-                  double hmin, double hmax, int num_sample_pts=16):
+                  double hmin, double hmax, int num_sample_pts=16,
+                  int num_threads=1):
         cdef int npts = 0
         cdef TMRPoint *pts
         if X.shape[0] != hvals.shape[0]:
@@ -2329,14 +2559,135 @@ cdef class PointFeatureSize(ElementFeatureSize):
             pts[i].y = X[i,1]
             pts[i].z = X[i,2]
         self.ptr = new TMRPointFeatureSize(npts, pts, <double*>hvals.data,
-                                           hmin, hmax, num_sample_pts)
+                                           hmin, hmax, num_sample_pts,
+                                           num_threads)
         self.ptr.incref()
         free(pts)
         return
 
+cdef class GridFeatureSize(ElementFeatureSize):
+    """
+    Feature size sampled at the nodes of a uniform grid and evaluated
+    by trilinear interpolation. Use this to evaluate an expensive
+    feature size, such as a PointFeatureSize, once and reuse it.
+    """
+    cdef TMRGridFeatureSize *gptr
+    def __cinit__(self, xlow=None, xhigh=None, int nx=1, int ny=1, int nz=1,
+                  ElementFeatureSize fs=None, double hmin=0.0,
+                  double hmax=0.0):
+        cdef TMRPoint p1
+        cdef TMRPoint p2
+        self.gptr = NULL
+        if fs is None:
+            return
+        p1.x = xlow[0]
+        p1.y = xlow[1]
+        p1.z = xlow[2]
+        p2.x = xhigh[0]
+        p2.y = xhigh[1]
+        p2.z = xhigh[2]
+        self.gptr = new TMRGridFeatureSize(p1, p2, nx, ny, nz, fs.ptr,
+                                           hmin, hmax)
+        self.ptr = self.gptr
+        self.ptr.incref()
+
+    def writeToFile(self, fname):
+        """
+        writeToFile(self, fname)
+
+        Write the grid values to a binary file
+
+        Args:
+            fname (str): File name
+        """
+        cdef string sfilename = tmr_convert_str_to_chars(fname)
+        cdef const char *filename = NULL
+        if fname is not None:
+            filename = sfilename.c_str()
+        if self.gptr.writeToFile(filename):
+            errmsg = 'Error writing grid feature size to %s'%(fname)
+            raise RuntimeError(errmsg)
+        return
+
+def isProfilingEnabled():
+    """
+    isProfilingEnabled()
+
+    Check whether TMR was compiled with TMR_USE_PROFILING
+
+    Returns:
+        bool: True if the profile data is recorded
+    """
+    return TMRIsProfilingEnabled() != 0
+
+def getProfileData(int phase):
+    """
+    getProfileData(phase)
+
+    Get the profile data recorded on this processor for a phase. The data
+    is only recorded when TMR is compiled with TMR_USE_PROFILING.
+
+    Args:
+        phase (int): The phase (PROFILE_BALANCE, PROFILE_REPARTITION,
+            PROFILE_CREATE_NODES, PROFILE_CREATE_INTERPOLATION or PROFILE_MESH)
+
+    Returns:
+        dict: The number of calls, wall time, messages and bytes sent, the
+        peak hash table size and the number of local octants/quadrants
+    """
+    cdef TMRProfileData data
+    if phase < 0 or phase > TMR_PROFILE_MESH:
+        raise ValueError('Unrecognized profile phase %d'%(phase))
+    TMRGetProfileData(<TMRProfilePhase>phase, &data)
+    return {'num_calls': data.num_calls, 'time': data.time,
+            'num_messages': data.num_messages, 'num_bytes': data.num_bytes,
+            'peak_size': data.peak_size, 'num_octants': data.num_octants}
+
+def resetProfileData():
+    """
+    resetProfileData()
+
+    Reset the profile data for all phases on this processor
+    """
+    TMRResetProfileData()
+
+cdef _memory_usage_to_dict(TMRMemoryUsage *usage):
+    return {'octants': usage.octants, 'nodes': usage.nodes,
+            'conn': usage.conn, 'dep_nodes': usage.dep_nodes,
+            'points': usage.points, 'hash': usage.hash,
+            'other': usage.other, 'total': usage.getTotal()}
+
+def LoadGridFeatureSize(fname):
+    """
+    LoadGridFeatureSize(fname)
+
+    Load a GridFeatureSize written with GridFeatureSize.writeToFile
+
+    Args:
+        fname (str): File name
+
+    Returns:
+        GridFeatureSize: The feature size stored in the file
+    """
+    cdef string sfilename = tmr_convert_str_to_chars(fname)
+    cdef const char *filename = NULL
+    cdef TMRGridFeatureSize *ptr = NULL
+    if fname is not None:
+        filename = sfilename.c_str()
+    ptr = TMRGridFeatureSize.createFromFile(filename)
+    if ptr is NULL:
+        errmsg = 'Error loading grid feature size. File %s does not exist?'%(fname)
+        raise RuntimeError(errmsg)
+    grid = GridFeatureSize()
+    grid.gptr = ptr
+    grid.ptr = ptr
+    grid.ptr.incref()
+    return grid
+
 cdef class PointLocator:
     cdef TMRPointLocator *ptr
-    def __cinit__(self, np.ndarray[double, ndim=2, mode='c'] X):
+    def __cinit__(self, np.ndarray[double, ndim=2, mode='c'] X,
+                  int num_threads=1):
         cdef int npts = 0
         cdef TMRPoint *pts
         npts = X.shape[0]
@@ -2345,7 +2696,7 @@ cdef class PointLocator:
             pts[i].x = X[i,0]
             pts[i].y = X[i,1]
             pts[i].z = X[i,2]
-        self.ptr = new TMRPointLocator(npts, pts)
+        self.ptr = new TMRPointLocator(npts, pts, num_threads)
         self.ptr.incref()
         free(pts)
         return
@@ -2371,6 +2722,21 @@ cdef class PointLocator:
                                <int*>index.data, <double*>dist.data)
         return num_found
 
+    def locateClosestPoints(self, np.ndarray[double, ndim=2, mode='c'] X,
+                            np.ndarray[int, ndim=2, mode='c'] index,
+                            np.ndarray[double, ndim=2, mode='c'] dist):
+        if (index.shape[0] != X.shape[0] or dist.shape[0] != X.shape[0] or
+            index.shape[1] != dist.shape[1]):
+            errmsg = 'PointLocator expects equal size input/output arrays'
+            raise ValueError(errmsg)
+
+        cdef int n = X.shape[0]
+        cdef int K = index.shape[1]
+        cdef np.ndarray num_found = np.zeros(n, dtype=np.intc)
+        self.ptr.locateClosest(K, n, <TMRPoint*>X.data, <int*>num_found.data,
+                               <int*>index.data, <double*>dist.data)
+        return num_found
+
 cdef class Mesh:
     """
     Mesh the geometry model. This class handles the meshing for surface objects
@@ -2404,17 +2770,18 @@ cdef class Mesh:
             opts (MeshOptions): Meshing options class
             fs (ElementFeatureSize): ElementFeatureSize class specifying spacing
         """
-        cdef TMRMeshOptions default
+        cdef TMRMeshOptions options
+        cdef TMRElementFeatureSize *fs_ptr = NULL
+        if opts is not None:
+            options = opts.ptr
         if fs is not None:
-            if opts is None:
-                self.ptr.mesh(default, fs.ptr)
-            else:
-                self.ptr.mesh(opts.ptr, fs.ptr)
-        else:
-            if opts is None:
-                self.ptr.mesh(default, h)
+            fs_ptr = fs.ptr
+        # Release the GIL while meshing
+        with nogil:
+            if fs_ptr != NULL:
+                self.ptr.mesh(options, fs_ptr)
             else:
-                self.ptr.mesh(opts.ptr, h)
+                self.ptr.mesh(options, h)
 
     def getMeshPoints(self):
         """
@@ -2501,6 +2868,68 @@ cdef class Mesh:
             he[i,7] = hex[8*i+7]
         return he
 
+    def getTetConnectivity(self):
+        """
+        getTetConnectivity(self)
+
+        Retrieve the global connectivity from the tetrahedral mesh
+
+        Returns:
+            np.ndarray: Numpy array of the tetrahedral connectivity
+        """
+        cdef const int *tet = NULL
+        cdef int ntet = 0
+
+        self.ptr.getTetConnectivity(&ntet, &tet)
+        te = np.zeros((ntet,4), dtype=np.intc)
+        for i in range(ntet):
+            te[i,0] = tet[4*i]
+            te[i,1] = tet[4*i+1]
+            te[i,2] = tet[4*i+2]
+            te[i,3] = tet[4*i+3]
+        return te
+
+    def computeMeshQuality(self, outtype='quad', int nbins=20):
+        """
+        computeMeshQuality(self, outtype='quad', nbins=20)
+
+        Compute histograms of the quadrilateral or hexahedral element
+        quality metrics, split across the processors and their threads.
+        The rows correspond to the scaled Jacobian, the inverse aspect
+        ratio and the skew quality. Each metric is one for an ideal
+        element and the bins are uniform over [0, 1]. This call is
+        collective.
+
+        Args:
+            outtype (str): The type of element i.e. quad or hex
+            nbins (int): The number of bins in each histogram
+
+        Returns:
+            np.ndarray: The (3, nbins) histograms
+            np.ndarray: The minimum value of each metric
+        """
+        cdef int elem_type = 1
+        cdef np.ndarray hist = np.zeros((3, nbins), dtype=np.intc)
+        cdef np.ndarray minq = np.ones(3, dtype=np.double)
+        if outtype == 'hex':
+            elem_type = 2
+        self.ptr.computeMeshQuality(elem_type, nbins, <int*>hist.data,
+                                    <double*>minq.data)
+        return hist, minq
+
+    def getMemoryUsage(self):
+        """
+        getMemoryUsage(self)
+
+        Get the memory used by the global mesh arrays on this processor
+
+        Returns:
+            dict: The number of bytes for each structure and the total
+        """
+        cdef TMRMemoryUsage usage
+        self.ptr.getMemoryUsage(&usage)
+        return _memory_usage_to_dict(&usage)
+
     def createModelFromMesh(self):
         """
         createModelFromMesh(self)
@@ -2514,19 +2943,68 @@ cdef class Mesh:
         model = self.ptr.createModelFromMesh()
         return _init_Model(model)
 
-    def writeToBDF(self, fname, outtype=None, BoundaryConditions bcs=None):
+    def setForestConnectivity(self, forest):
+        """
+        setForestConnectivity(self, forest)
+
+        Set the connectivity and the corner locations of the hexahedral or
+        quadrilateral mesh directly into an OctForest or QuadForest. The forest
+        node locations are then interpolated from the element corners, so this
+        avoids creating a Model with createModelFromMesh() when the geometry
+        only requires linear interpolation.
+
+        Args:
+            forest (OctForest or QuadForest): The forest to set up
+        """
+        cdef TMRPoint *X = NULL
+        cdef int num_nodes = self.ptr.getMeshPoints(&X)
+        cdef int num_edges = 0
+        cdef int num_faces = 0
+        cdef int num_blocks = 0
+        cdef int *conn = NULL
+        cdef int *edge_conn = NULL
+        cdef int *face_conn = NULL
+        cdef OctForest oct_forest
+        cdef QuadForest quad_forest
+        if isinstance(forest, OctForest):
+            oct_forest = forest
+            self.ptr.getOctForestConnectivity(&num_edges, &num_faces,
+                                              &num_blocks, &conn,
+                                              &edge_conn, &face_conn)
+            oct_forest.ptr.setFullConnectivity(num_nodes, num_edges,
+                                               num_faces, num_blocks, conn,
+                                               edge_conn, face_conn, X)
+            _deleteMe(face_conn)
+        elif isinstance(forest, QuadForest):
+            quad_forest = forest
+            self.ptr.getQuadForestConnectivity(&num_edges, &num_faces,
+                                               &conn, &edge_conn)
+            quad_forest.ptr.setFullConnectivity(num_nodes, num_edges,
+                                                num_faces, conn, edge_conn, X)
+        else:
+            raise ValueError('Expected an OctForest or QuadForest')
+        _deleteMe(conn)
+        _deleteMe(edge_conn)
+
+    def writeToBDF(
+        self, fname, outtype=None, BoundaryConditions bcs=None, large_field=True
+    ):
         """
-        writeToBDF(self, fname, outtype=None)
+        writeToBDF(self, fname, outtype=None, bcs=None, large_field=True)
 
-        Write both the quadrilateral and hexahedral mesh to a BDF file
+        Write both the quadrilateral and hexahedral mesh to a BDF file.
+        This call is collective: each processor writes part of the file.
 
         Args:
             fname (str): File name
             outtype (str): Type of mesh to output to BDF file i.e. quad or hex
+            bcs (BoundaryConditions): Boundary conditions to write
+            large_field (bool): Use the large-field format for the grid points
         """
         cdef string sfilename = tmr_convert_str_to_chars(fname)
         cdef const char *filename = NULL
         cdef int flag = 3
+        cdef int use_large = 1
         if fname is not None:
             filename = sfilename.c_str()
         if outtype is None:
@@ -2535,10 +3013,12 @@ cdef class Mesh:
             flag = 1
         elif outtype == 'hex':
             flag = 2
+        if not large_field:
+            use_large = 0
         if bcs is not None:
-           self.ptr.writeToBDF(filename, flag, bcs.ptr)
+           self.ptr.writeToBDF(filename, flag, bcs.ptr, use_large)
         else:
-            self.ptr.writeToBDF(filename, flag, NULL)
+            self.ptr.writeToBDF(filename, flag, NULL, use_large)
 
     def writeToVTK(self, fname, outtype=None):
         """
@@ -2563,6 +3043,30 @@ cdef class Mesh:
             flag = 2
         self.ptr.writeToVTK(filename, flag)
 
+    def writeToVTU(self, fname, outtype=None, use_float32=True):
+        """
+        writeToVTU(self, fname, outtype=None, use_float32=True)
+
+        Write the mesh to a binary VTK XML (.vtu) file
+
+        Args:
+            fname (str): File name
+            outtype (str): Type of mesh to output i.e. quad or hex
+            use_float32 (bool): Write single precision coordinates
+        """
+        cdef string sfilename = tmr_convert_str_to_chars(fname)
+        cdef const char *filename = NULL
+        cdef int flag = 3
+        if fname is not None:
+            filename = sfilename.c_str()
+        if outtype is None:
+            flag = 3
+        elif outtype == 'quad':
+            flag = 1
+        elif outtype == 'hex':
+            flag = 2
+        return self.ptr.writeToVTU(filename, flag, use_float32)
+
 cdef class EdgeMesh:
     """
     This is the class that stores the node numbers along an edge
@@ -2596,10 +3100,10 @@ cdef class EdgeMesh:
         cdef TMRElementFeatureSize *fs = NULL
         fs = new TMRElementFeatureSize(h)
         fs.incref()
-        if opts is None:
+        if opts is not None:
+            options = opts.ptr
+        with nogil:
             self.ptr.mesh(options, fs)
-        else:
-            self.ptr.mesh(opts.ptr, fs)
         fs.decref()
 
     def writeToVTK(self, fname):
@@ -2668,10 +3172,10 @@ cdef class FaceMesh:
         cdef TMRElementFeatureSize *fs = NULL
         fs = new TMRElementFeatureSize(h)
         fs.incref()
-        if opts is None:
+        if opts is not None:
+            options = opts.ptr
+        with nogil:
             self.ptr.mesh(options, fs)
-        else:
-            self.ptr.mesh(opts.ptr, fs)
         fs.decref()
 
     def writeToVTK(self, fname):
@@ -2770,8 +3274,19 @@ cdef _init_Topology(TMRTopology *ptr):
 cdef class QuadrantArray:
     cdef TMRQuadrantArray *ptr
     cdef int self_owned
-    def __cinit__(self):
+    def __cinit__(self, quadrants=None, use_nodes=False):
+        cdef TMRQuadrantHash *qhash = NULL
+        cdef Quadrant quad
+        self.self_owned = 0
         self.ptr = NULL
+        if quadrants is not None:
+            # The hash keeps the unique quadrants in the order they are added
+            qhash = new TMRQuadrantHash(1 if use_nodes else 0)
+            for quad in quadrants:
+                qhash.addQuadrant(&quad.quad)
+            self.ptr = qhash.toArray()
+            self.self_owned = 1
+            del qhash
 
     def __dealloc__(self):
         if self.ptr and self.self_owned:
@@ -2828,6 +3343,9 @@ cdef class QuadrantArray:
         index = t - array
         return index
 
+    def sort(self):
+        self.ptr.sort()
+
 cdef _init_QuadrantArray(TMRQuadrantArray *array, int self_owned):
     arr = QuadrantArray()
     arr.ptr = array
@@ -2880,6 +3398,12 @@ cdef class Quadrant:
         def __set__(self, value):
             self.quad.info = value
 
+    def compare(self, Quadrant quad):
+        return self.quad.compare(&quad.quad)
+
+    def compareNode(self, Quadrant quad):
+        return self.quad.compareNode(&quad.quad)
+
 cdef class QuadForest:
     """
     This class defines a parallel forest of quadrtrees. The connectivity
@@ -2901,6 +3425,23 @@ cdef class QuadForest:
         if self.ptr:
             self.ptr.decref()
 
+    def setMPIComm(self, MPI.Comm comm):
+        """
+        setMPIComm(self, comm)
+
+        Set a new communicator for the forest. The communicator must contain
+        the same processors in the same order, for instance a duplicate of the
+        current communicator. This allows the collective operations on the
+        forest to be performed on a separate thread.
+
+        Args:
+            comm (MPI.Comm): The new communicator
+        """
+        cdef MPI_Comm c_comm = comm.ob_mpi
+        if self.ptr.setMPIComm(c_comm) != 0:
+            errmsg = 'The communicator must contain the same processors'
+            raise ValueError(errmsg)
+
     def setMeshOrder(self, int order,
                      TMRInterpolationType interp=GAUSS_LOBATTO_POINTS):
         """
@@ -2961,15 +3502,53 @@ cdef class QuadForest:
             return _init_Topology(topo)
         return None
 
-    def repartition(self):
+    def repartition(self, np.ndarray[double, ndim=1, mode='c'] weights=None):
         """
-        repartition(self)
+        repartition(self, weights=None)
 
         Repartition the mesh across processors. This redistributes the elements
         so that there are an equal, or nearly equal, number of elements on each
-        processor.
+        processor. If weights are supplied, the elements are redistributed so
+        that there is an equal, or nearly equal, total weight on each processor.
+
+        Args:
+            weights (np.ndarray): Optional weight for each local element
+        """
+        cdef double *w = NULL
+        if weights is not None:
+            w = <double*>weights.data
+        with nogil:
+            self.ptr.repartition(w)
+
+    def alignPartition(self, QuadForest forest):
+        """
+        alignPartition(self, forest)
+
+        Repartition the mesh so that each element is placed on the processor
+        that owns the same part of the space-filling curve in another forest
+        with the same connectivity. Call repartition() on the filter forest
+        and then alignPartition() on the analysis forest so that the filter
+        quadrant enclosing each analysis element is local.
+
+        Args:
+            forest (QuadForest): The forest whose partition is matched
+        """
+        with nogil:
+            self.ptr.alignPartition(forest.ptr)
+
+    def setPartitionTolerance(self, double tol):
+        """
+        setPartitionTolerance(self, tol)
+
+        Allow repartition() to move each cut of the partition by up to this
+        fraction of the average number of quadrants per processor, so that the
+        cuts fall on coarse tree boundaries. This reduces the ghost quadrants
+        and nodes at the cost of a small load imbalance.
+
+        Args:
+            tol (float): Fraction of the average partition size (0 disables)
         """
-        self.ptr.repartition()
+        self.ptr.setPartitionTolerance(tol)
 
     def createTrees(self, int depth=0):
         """
@@ -2997,8 +3576,7 @@ cdef class QuadForest:
         """
         self.ptr.createRandomTrees(nrand, min_lev, max_lev)
 
-    def refine(self, np.ndarray[int, ndim=1, mode='c'] refine=None,
-               int min_lev=0, int max_lev=MAX_LEVEL):
+    def refine(self, refine=None, int min_lev=0, int max_lev=MAX_LEVEL):
         """
         refine(self, refine=None, min_level=0, max_level=MAX_LEVEL)
 
@@ -3006,16 +3584,45 @@ cdef class QuadForest:
         negative number is supplied, coarsen the element.
 
         Args:
-            refine (np.ndarray): Array of integers indicating element refinement
+            refine (array_like): Integers indicating element refinement, one for
+                each local quadrant. Contiguous int arrays are not copied.
             min_lev (int): Minimum quadrant refinement level
             max_lev (int): Maximum quadrant refinement level
         """
+        cdef TMRQuadrantArray *array = NULL
+        cdef int size = 0
+        cdef np.ndarray _refine
         if refine is not None:
-            self.ptr.refine(<int*>refine.data, min_lev, max_lev)
+            self.ptr.getQuadrants(&array)
+            if array != NULL:
+                array.getArray(NULL, &size)
+            _refine = _refine_array(refine, size)
+            self.ptr.refine(<int*>_refine.data, min_lev, max_lev)
         else:
             self.ptr.refine(NULL, min_lev, max_lev)
         return
 
+    def refineToLevels(self, levels, int btype=0):
+        """
+        refineToLevels(self, levels, btype=0)
+
+        Refine each element directly to its target level and balance the
+        mesh in a single pass.
+
+        Args:
+            levels (array_like): Target level for each local quadrant
+            btype (int): Indicates whether or not to balance across quadrant corners
+        """
+        cdef TMRQuadrantArray *array = NULL
+        cdef int size = 0
+        cdef np.ndarray _levels
+        self.ptr.getQuadrants(&array)
+        if array != NULL:
+            array.getArray(NULL, &size)
+        _levels = _refine_array(levels, size)
+        self.ptr.refineToLevels(<int*>_levels.data, btype)
+        return
+
     def duplicate(self):
         """
         duplicate(self)
@@ -3041,7 +3648,8 @@ cdef class QuadForest:
             QuadForest: The coarsened QuadForest
         """
         cdef TMRQuadForest *dup = NULL
-        dup = self.ptr.coarsen()
+        with nogil:
+            dup = self.ptr.coarsen()
         return _init_QuadForest(dup)
 
     def balance(self, int btype):
@@ -3053,22 +3661,48 @@ cdef class QuadForest:
         Args:
             btype (int): Indicates whether or not to balance across octant corners
         """
-        self.ptr.balance(btype)
+        with nogil:
+            self.ptr.balance(btype)
 
-    def createNodes(self):
+    def setNumThreads(self, int num_threads):
         """
-        createNodes(self, btype)
+        setNumThreads(self, num_threads)
 
-        Create and order the nodes in the mesh.
+        Set the number of threads used within each MPI process. At
+        present, the threads are used to create the local nodes and
+        connectivity within createNodes().
+
+        Args:
+            num_threads (int): The number of threads
         """
-        self.ptr.createNodes()
+        self.ptr.setNumThreads(num_threads)
 
-    def getQuadsWithName(self, aname):
+    def getNumThreads(self):
         """
-        getQuadsWithName(self, aname)
+        getNumThreads(self)
 
-        Get an array of quadrants who touch a geometric object with the
-        specified name.
+        Get the number of threads used within each MPI process
+
+        Returns:
+            int: The number of threads
+        """
+        return self.ptr.getNumThreads()
+
+    def createNodes(self):
+        """
+        createNodes(self, btype)
+
+        Create and order the nodes in the mesh.
+        """
+        with nogil:
+            self.ptr.createNodes()
+
+    def getQuadsWithName(self, aname):
+        """
+        getQuadsWithName(self, aname)
+
+        Get an array of quadrants who touch a geometric object with the
+        specified name.
 
         Args:
             aname (str): The name to search for
@@ -3123,6 +3757,110 @@ cdef class QuadForest:
         self.ptr.getQuadrants(&array)
         return _init_QuadrantArray(array, 0)
 
+    def getQuadrantsView(self):
+        """
+        getQuadrantsView(self)
+
+        Get a view of the locally owned quadrants without copying. The view is
+        valid until the quadrants are modified, for instance by refine(),
+        balance() or repartition().
+
+        Returns:
+            np.ndarray: A structured array with dtype QUADRANT_DTYPE
+        """
+        cdef TMRQuadrantArray *array = NULL
+        cdef TMRQuadrant *data = NULL
+        cdef int size = 0
+        self.ptr.getQuadrants(&array)
+        if array == NULL:
+            return np.zeros(0, dtype=QUADRANT_DTYPE)
+        array.getArray(&data, &size)
+        view = inplace_view(self, np.NPY_BYTE, size*sizeof(TMRQuadrant), 0,
+                            <void*>data)
+        return view.view(QUADRANT_DTYPE)
+
+    def getPointsView(self):
+        """
+        getPointsView(self)
+
+        Get a (npts, 3) view of the node locations without copying. The
+        view is valid until the nodes are re-created.
+
+        Returns:
+            np.ndarray: An array of node locations
+        """
+        cdef TMRPoint *X = NULL
+        cdef int npts = 0
+        with nogil:
+            npts = self.ptr.getPoints(&X)
+        if X == NULL:
+            errmsg = 'TMRQuadForest: No node locations'
+            raise RuntimeError(errmsg)
+        return inplace_view(self, np.NPY_DOUBLE, npts, 3, <void*>X)
+
+    def getPointComponentsView(self):
+        """
+        getPointComponentsView(self)
+
+        Get views of the x, y and z components of the node locations
+        stored in separate aligned arrays. The views are valid until
+        the nodes are re-created.
+
+        Returns:
+            tuple: The arrays of the x, y and z components
+        """
+        cdef const double *x = NULL
+        cdef const double *y = NULL
+        cdef const double *z = NULL
+        cdef int npts = 0
+        with nogil:
+            npts = self.ptr.getPointComponents(&x, &y, &z)
+        if x == NULL:
+            errmsg = 'TMRQuadForest: No node locations'
+            raise RuntimeError(errmsg)
+        return (inplace_view(self, np.NPY_DOUBLE, npts, 0, <void*>x),
+                inplace_view(self, np.NPY_DOUBLE, npts, 0, <void*>y),
+                inplace_view(self, np.NPY_DOUBLE, npts, 0, <void*>z))
+
+    def getMeshConnView(self):
+        """
+        getMeshConnView(self)
+
+        Get a (nelems, nodes per element) view of the local connectivity
+        without copying. The view is valid until the nodes are re-created.
+
+        Returns:
+            np.ndarray: The local connectivity using global node numbers
+        """
+        cdef const int *conn = NULL
+        cdef int nelems = 0
+        cdef int order = self.ptr.getMeshOrder()
+        self.ptr.getNodeConn(&conn, &nelems)
+        if conn == NULL:
+            errmsg = 'TMRQuadForest: No mesh connectivity'
+            raise RuntimeError(errmsg)
+        cdef int npe = order*order
+        return inplace_view(self, np.NPY_INT, nelems, npe, <void*>conn)
+
+    def getNodeNumbersView(self):
+        """
+        getNodeNumbersView(self)
+
+        Get a view of the sorted global node numbers referenced on this
+        processor without copying. The view is valid until the nodes are
+        re-created.
+
+        Returns:
+            np.ndarray: The global node numbers
+        """
+        cdef const int *node_numbers = NULL
+        cdef int size = 0
+        size = self.ptr.getNodeNumbers(&node_numbers)
+        if node_numbers == NULL:
+            errmsg = 'TMRQuadForest: No node numbers'
+            raise RuntimeError(errmsg)
+        return inplace_view(self, np.NPY_INT, size, 0, <void*>node_numbers)
+
     def getPoints(self):
         """
         getPoints(self)
@@ -3134,7 +3872,8 @@ cdef class QuadForest:
         """
         cdef TMRPoint *X = NULL
         cdef int npts = 0
-        npts = self.ptr.getPoints(&X)
+        with nogil:
+            npts = self.ptr.getPoints(&X)
         if X != NULL:
             Xp = np.zeros((npts, 3), dtype=np.double)
             for i in range(npts):
@@ -3244,6 +3983,93 @@ cdef class QuadForest:
             filename = sfilename.c_str()
         self.ptr.writeForestToVTK(filename)
 
+    def writeForestToVTU(self, fname, use_float32=True):
+        """
+        Write the forest to a single binary VTK XML (.vtu) file using
+        collective MPI-IO
+        """
+        cdef string sfilename = tmr_convert_str_to_chars(fname)
+        cdef const char *filename = NULL
+        if fname is not None:
+            filename = sfilename.c_str()
+        return self.ptr.writeForestToVTU(filename, use_float32)
+
+    def writeForestToFile(self, fname):
+        """
+        Write the forest connectivity and elements to a binary checkpoint
+        file. This call is collective.
+        """
+        cdef string sfilename = tmr_convert_str_to_chars(fname)
+        return self.ptr.writeForestToFile(sfilename.c_str())
+
+    def readForestFromFile(self, fname):
+        """
+        Read the forest from a binary checkpoint file. The file may be read
+        on a different number of processors than it was written on.
+        """
+        cdef string sfilename = tmr_convert_str_to_chars(fname)
+        return self.ptr.readForestFromFile(sfilename.c_str())
+
+    def computeMeshQuality(self, int nbins=20):
+        """
+        computeMeshQuality(self, nbins=20)
+
+        Compute histograms of the element quality metrics in a single
+        threaded pass over the elements, summed across all processors.
+        The rows correspond to the scaled Jacobian, the inverse aspect
+        ratio and the skew quality. Each metric is one for an ideal
+        element and the bins are uniform over [0, 1]. This call is
+        collective and the nodes must be created first.
+
+        Args:
+            nbins (int): The number of bins in each histogram
+
+        Returns:
+            np.ndarray: The (3, nbins) histograms
+            np.ndarray: The minimum value of each metric
+        """
+        cdef np.ndarray hist = np.zeros((3, nbins), dtype=np.intc)
+        cdef np.ndarray minq = np.ones(3, dtype=np.double)
+        self.ptr.computeMeshQuality(nbins, <int*>hist.data,
+                                    <double*>minq.data)
+        return hist, minq
+
+    def getMemoryUsage(self):
+        """
+        getMemoryUsage(self)
+
+        Get the memory used by the forest on this processor
+
+        Returns:
+            dict: The number of bytes for the octants, nodes, conn, dep_nodes,
+            points, hash and other structures and the total
+        """
+        cdef TMRMemoryUsage usage
+        self.ptr.getMemoryUsage(&usage)
+        return _memory_usage_to_dict(&usage)
+
+    def getMaxMemoryUsage(self):
+        """
+        getMaxMemoryUsage(self)
+
+        Get the memory high-water mark recorded during balance() and
+        createNodes(), including the transient hash tables
+
+        Returns:
+            dict: The number of bytes for each structure at the high-water mark
+        """
+        cdef TMRMemoryUsage usage
+        self.ptr.getMaxMemoryUsage(&usage)
+        return _memory_usage_to_dict(&usage)
+
+    def resetMaxMemoryUsage(self):
+        """
+        resetMaxMemoryUsage(self)
+
+        Reset the memory high-water mark
+        """
+        self.ptr.resetMaxMemoryUsage()
+
     def createInterpolation(self, QuadForest forest, VecInterp vec):
         """
         createInterpolation(self, forest, vec)
@@ -3255,10 +4081,36 @@ cdef class QuadForest:
             forest (QuadForest): The quadtree forest that has the common topology
             vec (VecInterp): The interpolation operator
         """
-        if self.ptr == forest.ptr:
+        cdef TMRQuadForest *fptr = forest.ptr
+        cdef TACSBVecInterp *vptr = vec.ptr
+        if self.ptr == fptr:
             errmsg = 'Cannot interpolate between the same object'
             raise ValueError(errmsg)
-        self.ptr.createInterpolation(forest.ptr, vec.ptr)
+        with nogil:
+            self.ptr.createInterpolation(fptr, vptr)
+
+    def setCacheInterpolation(self, int cache):
+        """
+        setCacheInterpolation(self, cache)
+
+        Retain the interpolation built by createInterpolation() so that
+        it can be reused when neither forest has changed since.
+
+        Args:
+            cache (int): Flag to retain the interpolation
+        """
+        self.ptr.setCacheInterpolation(cache)
+
+    def getCacheInterpolation(self):
+        """
+        getCacheInterpolation(self)
+
+        Get whether the interpolation is retained by createInterpolation()
+
+        Returns:
+            int: Flag indicating whether the interpolation is retained
+        """
+        return self.ptr.getCacheInterpolation()
 
 cdef _init_QuadForest(TMRQuadForest* ptr):
     forest = QuadForest()
@@ -3270,9 +4122,19 @@ cdef _init_QuadForest(TMRQuadForest* ptr):
 cdef class OctantArray:
     cdef TMROctantArray *ptr
     cdef int self_owned
-    def __cinit__(self):
+    def __cinit__(self, octants=None, use_nodes=False):
+        cdef TMROctantHash *ohash = NULL
+        cdef Octant oc
         self.self_owned = 0
         self.ptr = NULL
+        if octants is not None:
+            # The hash keeps the unique octants in the order they are added
+            ohash = new TMROctantHash(1 if use_nodes else 0)
+            for oc in octants:
+                ohash.addOctant(&oc.octant)
+            self.ptr = ohash.toArray()
+            self.self_owned = 1
+            del ohash
 
     def __dealloc__(self):
         if self.ptr and self.self_owned:
@@ -3331,6 +4193,9 @@ cdef class OctantArray:
         index = t - array
         return index
 
+    def sort(self):
+        self.ptr.sort()
+
 cdef _init_OctantArray(TMROctantArray *array, int self_owned):
     arr = OctantArray()
     arr.ptr = array
@@ -3390,6 +4255,12 @@ cdef class Octant:
         def __set__(self, value):
             self.octant.info = value
 
+    def compare(self, Octant oc):
+        return self.octant.compare(&oc.octant)
+
+    def compareNode(self, Octant oc):
+        return self.octant.compareNode(&oc.octant)
+
 cdef class OctForest:
     """
     This class defines a forest of octrees. The octrees within the
@@ -3415,6 +4286,23 @@ cdef class OctForest:
         if self.ptr:
             self.ptr.decref()
 
+    def setMPIComm(self, MPI.Comm comm):
+        """
+        setMPIComm(self, comm)
+
+        Set a new communicator for the forest. The communicator must contain
+        the same processors in the same order, for instance a duplicate of the
+        current communicator. This allows the collective operations on the
+        forest to be performed on a separate thread.
+
+        Args:
+            comm (MPI.Comm): The new communicator
+        """
+        cdef MPI_Comm c_comm = comm.ob_mpi
+        if self.ptr.setMPIComm(c_comm) != 0:
+            errmsg = 'The communicator must contain the same processors'
+            raise ValueError(errmsg)
+
     def setMeshOrder(self, int order,
                      TMRInterpolationType interp=GAUSS_LOBATTO_POINTS):
         """
@@ -3450,6 +4338,44 @@ cdef class OctForest:
         """
         return self.ptr.getInterpType()
 
+    def setElementOrders(self, orders=None):
+        """
+        setElementOrders(self, orders=None)
+
+        Set the order of each local element. The nodes of elements with an
+        order lower than the mesh order are constrained so that the solution
+        is a polynomial of the lower order. The orders are discarded when
+        the octants are refined, balanced or repartitioned.
+
+        Args:
+            orders (np.ndarray): The order of each local element, or None to
+            use the mesh order for all elements
+        """
+        cdef np.ndarray[int, ndim=1, mode='c'] ords
+        if orders is None:
+            self.ptr.setElementOrders(NULL)
+        else:
+            ords = np.ascontiguousarray(orders, dtype=np.intc)
+            self.ptr.setElementOrders(<int*>ords.data)
+
+    def getElementOrders(self):
+        """
+        getElementOrders(self)
+
+        Get the order of each local element
+
+        Returns:
+            np.ndarray: The element orders, or None if they are not set
+        """
+        cdef const int *orders = NULL
+        cdef int num_elements = self.ptr.getElementOrders(&orders)
+        if orders == NULL:
+            return None
+        ords = np.zeros(num_elements, dtype=np.intc)
+        for i in range(num_elements):
+            ords[i] = orders[i]
+        return ords
+
     def setTopology(self, Topology topo):
         """
         setTopology(self, topo)
@@ -3494,19 +4420,56 @@ cdef class OctForest:
         num_nodes = np.max(conn)+1
         self.ptr.setConnectivity(num_nodes, <int*>conn.data, num_blocks)
 
-    def repartition(self, int max_rank=-1):
+    def repartition(self, int max_rank=-1,
+                    np.ndarray[double, ndim=1, mode='c'] weights=None):
         """
-        repartition(self, max_rank=-1)
+        repartition(self, max_rank=-1, weights=None)
 
         Repartition the mesh across processors. This redistributes the elements
         so that there are an equal, or nearly equal, number of elements on each
-        processor.
+        processor. If weights are supplied, the elements are redistributed so
+        that there is an equal, or nearly equal, total weight on each processor.
 
         Args:
             max_rank (int): Number of processors to distribute the mesh across.
             If negative, the mesh is distributed across all processors
+            weights (np.ndarray): Optional weight for each local element
+        """
+        cdef double *w = NULL
+        if weights is not None:
+            w = <double*>weights.data
+        with nogil:
+            self.ptr.repartition(max_rank, w)
+
+    def alignPartition(self, OctForest forest):
+        """
+        alignPartition(self, forest)
+
+        Repartition the mesh so that each element is placed on the processor
+        that owns the same part of the space-filling curve in another forest
+        with the same connectivity. Call repartition() on the filter forest
+        and then alignPartition() on the analysis forest so that the filter
+        octant enclosing each analysis element is local.
+
+        Args:
+            forest (OctForest): The forest whose partition is matched
+        """
+        with nogil:
+            self.ptr.alignPartition(forest.ptr)
+
+    def setPartitionTolerance(self, double tol):
+        """
+        setPartitionTolerance(self, tol)
+
+        Allow repartition() to move each cut of the partition by up to this
+        fraction of the average number of octants per processor, so that the
+        cuts fall on coarse tree boundaries. This reduces the ghost octants
+        and nodes at the cost of a small load imbalance.
+
+        Args:
+            tol (float): Fraction of the average partition size (0 disables)
         """
-        self.ptr.repartition(max_rank)
+        self.ptr.setPartitionTolerance(tol)
 
     def createTrees(self, int depth=0):
         """
@@ -3534,8 +4497,7 @@ cdef class OctForest:
         """
         self.ptr.createRandomTrees(nrand, min_lev, max_lev)
 
-    def refine(self, np.ndarray[int, ndim=1, mode='c'] refine=None,
-               int min_lev=0, int max_lev=MAX_LEVEL):
+    def refine(self, refine=None, int min_lev=0, int max_lev=MAX_LEVEL):
         """
         refine(self, refine=None, min_level=0, max_level=MAX_LEVEL)
 
@@ -3543,16 +4505,45 @@ cdef class OctForest:
         negative number is supplied, coarsen the element.
 
         Args:
-            refine (np.ndarray): Array of integers indicating element refinement
+            refine (array_like): Integers indicating element refinement, one for
+                each local octant. Contiguous int arrays are not copied.
             min_lev (int): Minimum octant refinement level
             max_lev (int): Maximum octant refinement level
         """
+        cdef TMROctantArray *array = NULL
+        cdef int size = 0
+        cdef np.ndarray _refine
         if refine is not None:
-            self.ptr.refine(<int*>refine.data, min_lev, max_lev)
+            self.ptr.getOctants(&array)
+            if array != NULL:
+                array.getArray(NULL, &size)
+            _refine = _refine_array(refine, size)
+            self.ptr.refine(<int*>_refine.data, min_lev, max_lev)
         else:
             self.ptr.refine(NULL, min_lev, max_lev)
         return
 
+    def refineToLevels(self, levels, int btype=0):
+        """
+        refineToLevels(self, levels, btype=0)
+
+        Refine each element directly to its target level and balance the
+        mesh in a single pass.
+
+        Args:
+            levels (array_like): Target level for each local octant
+            btype (int): Indicates whether or not to balance across octant corners
+        """
+        cdef TMROctantArray *array = NULL
+        cdef int size = 0
+        cdef np.ndarray _levels
+        self.ptr.getOctants(&array)
+        if array != NULL:
+            array.getArray(NULL, &size)
+        _levels = _refine_array(levels, size)
+        self.ptr.refineToLevels(<int*>_levels.data, btype)
+        return
+
     def duplicate(self):
         """
         duplicate(self)
@@ -3578,7 +4569,28 @@ cdef class OctForest:
             OctForest: The coarsened OctForest
         """
         cdef TMROctForest *dup = NULL
-        dup = self.ptr.coarsen()
+        with nogil:
+            dup = self.ptr.coarsen()
+        return _init_OctForest(dup)
+
+    def coarsenBalanced(self, int btype=0):
+        """
+        coarsenBalanced(self, btype=0)
+
+        Create a new forest object by merging the complete families of
+        elements whose neighbors are not more refined. If this forest is
+        balanced, the coarse forest is balanced and balance() need not be
+        called. Does not create new nodes.
+
+        Args:
+            btype (int): Indicates whether the forest is balanced across corners
+
+        Returns:
+            OctForest: The coarsened OctForest
+        """
+        cdef TMROctForest *dup = NULL
+        with nogil:
+            dup = self.ptr.coarsenBalanced(btype)
         return _init_OctForest(dup)
 
     def balance(self, int btype):
@@ -3590,7 +4602,106 @@ cdef class OctForest:
         Args:
             btype (int): Indicates whether or not to balance across octant corners
         """
-        self.ptr.balance(btype)
+        with nogil:
+            self.ptr.balance(btype)
+
+    def setNumThreads(self, int num_threads):
+        """
+        setNumThreads(self, num_threads)
+
+        Set the number of threads used within each MPI process. At
+        present, the threads are used to balance the local octants and
+        to create the local nodes and connectivity within createNodes().
+
+        Args:
+            num_threads (int): The number of threads
+        """
+        self.ptr.setNumThreads(num_threads)
+
+    def getNumThreads(self):
+        """
+        getNumThreads(self)
+
+        Get the number of threads used within each MPI process
+
+        Returns:
+            int: The number of threads
+        """
+        return self.ptr.getNumThreads()
+
+    def setIncrementalNodes(self, int incremental):
+        """
+        setIncrementalNodes(self, incremental)
+
+        Retain the octants, connectivity and node locations when the
+        forest is refined, so that the node locations of the new mesh
+        are only evaluated for the octants that changed. Only the node
+        locations are reused: createNodes() still rebuilds the node
+        numbering and the dependent nodes in full.
+
+        Args:
+            incremental (int): Flag to retain the previous mesh data
+        """
+        self.ptr.setIncrementalNodes(incremental)
+
+    def getIncrementalNodes(self):
+        """
+        getIncrementalNodes(self)
+
+        Get whether the previous mesh data is retained by refine()
+
+        Returns:
+            int: Flag indicating whether the mesh data is retained
+        """
+        return self.ptr.getIncrementalNodes()
+
+    def setUseSharedMemory(self, int flag):
+        """
+        setUseSharedMemory(self, flag)
+
+        Exchange octants between processors on the same node through
+        node-local shared memory. This is collective on the forest
+        communicator.
+
+        Args:
+            flag (int): Flag to use shared memory
+        """
+        self.ptr.setUseSharedMemory(flag)
+
+    def getUseSharedMemory(self):
+        """
+        getUseSharedMemory(self)
+
+        Get whether octants are exchanged through shared memory
+
+        Returns:
+            int: Flag indicating whether shared memory is used
+        """
+        return self.ptr.getUseSharedMemory()
+
+    def setUseSharedConnectivity(self, int flag):
+        """
+        setUseSharedConnectivity(self, flag)
+
+        Store a single copy of the block connectivity in node-local
+        shared memory, computed by one processor on each node. This
+        must be called before the connectivity or topology is set.
+
+        Args:
+            flag (int): Flag to share the block connectivity
+        """
+        self.ptr.setUseSharedConnectivity(flag)
+
+    def getUseSharedConnectivity(self):
+        """
+        getUseSharedConnectivity(self)
+
+        Get whether the block connectivity is shared on each node
+
+        Returns:
+            int: Flag indicating whether the connectivity is shared
+        """
+        return self.ptr.getUseSharedConnectivity()
 
     def createNodes(self):
         """
@@ -3598,7 +4709,8 @@ cdef class OctForest:
 
         Create and order all the nodes within the mesh
         """
-        self.ptr.createNodes()
+        with nogil:
+            self.ptr.createNodes()
 
     def getOctsWithName(self, aname):
         """
@@ -3660,6 +4772,177 @@ cdef class OctForest:
         self.ptr.getOctants(&array)
         return _init_OctantArray(array, 0)
 
+    def getOctantsView(self):
+        """
+        getOctantsView(self)
+
+        Get a view of the locally owned octants without copying. The view is
+        valid until the octants are modified, for instance by refine(),
+        balance() or repartition().
+
+        Returns:
+            np.ndarray: A structured array with dtype OCTANT_DTYPE
+        """
+        cdef TMROctantArray *array = NULL
+        cdef TMROctant *data = NULL
+        cdef int size = 0
+        self.ptr.getOctants(&array)
+        if array == NULL:
+            return np.zeros(0, dtype=OCTANT_DTYPE)
+        array.getArray(&data, &size)
+        view = inplace_view(self, np.NPY_BYTE, size*sizeof(TMROctant), 0,
+                            <void*>data)
+        return view.view(OCTANT_DTYPE)
+
+    def getPointsView(self):
+        """
+        getPointsView(self)
+
+        Get a (npts, 3) view of the node locations without copying. The
+        view is valid until the nodes are re-created.
+
+        Returns:
+            np.ndarray: An array of node locations
+        """
+        cdef TMRPoint *X = NULL
+        cdef int npts = 0
+        with nogil:
+            npts = self.ptr.getPoints(&X)
+        if X == NULL:
+            errmsg = 'TMROctForest: No node locations'
+            raise RuntimeError(errmsg)
+        return inplace_view(self, np.NPY_DOUBLE, npts, 3, <void*>X)
+
+    def getPointComponentsView(self):
+        """
+        getPointComponentsView(self)
+
+        Get views of the x, y and z components of the node locations
+        stored in separate aligned arrays. The views are valid until
+        the nodes are re-created.
+
+        Returns:
+            tuple: The arrays of the x, y and z components
+        """
+        cdef const double *x = NULL
+        cdef const double *y = NULL
+        cdef const double *z = NULL
+        cdef int npts = 0
+        with nogil:
+            npts = self.ptr.getPointComponents(&x, &y, &z)
+        if x == NULL:
+            errmsg = 'TMROctForest: No node locations'
+            raise RuntimeError(errmsg)
+        return (inplace_view(self, np.NPY_DOUBLE, npts, 0, <void*>x),
+                inplace_view(self, np.NPY_DOUBLE, npts, 0, <void*>y),
+                inplace_view(self, np.NPY_DOUBLE, npts, 0, <void*>z))
+
+    def getMeshConnView(self):
+        """
+        getMeshConnView(self)
+
+        Get a (nelems, nodes per element) view of the local connectivity
+        without copying. The view is valid until the nodes are re-created.
+
+        Returns:
+            np.ndarray: The local connectivity using global node numbers
+        """
+        cdef const int *conn = NULL
+        cdef int nelems = 0
+        cdef int order = self.ptr.getMeshOrder()
+        self.ptr.getNodeConn(&conn, &nelems)
+        if conn == NULL:
+            errmsg = 'TMROctForest: No mesh connectivity'
+            raise RuntimeError(errmsg)
+        cdef int npe = order*order*order
+        return inplace_view(self, np.NPY_INT, nelems, npe, <void*>conn)
+
+    def getNodeNumbersView(self):
+        """
+        getNodeNumbersView(self)
+
+        Get a view of the sorted global node numbers referenced on this
+        processor without copying. The view is valid until the nodes are
+        re-created.
+
+        Returns:
+            np.ndarray: The global node numbers
+        """
+        cdef const int *node_numbers = NULL
+        cdef int size = 0
+        size = self.ptr.getNodeNumbers(&node_numbers)
+        if node_numbers == NULL:
+            errmsg = 'TMROctForest: No node numbers'
+            raise RuntimeError(errmsg)
+        return inplace_view(self, np.NPY_INT, size, 0, <void*>node_numbers)
+
+    def getOctantNeighbors(self):
+        """
+        getOctantNeighbors(self)
+
+        Get the face, edge and corner neighbors of the locally owned
+        octants. The neighbors of octant i across face f, edge e or
+        corner c are stored in neighbors[ptr[26*i + k]:ptr[26*i + k + 1]]
+        with k = f, 6 + e or 18 + c, respectively. Indices greater than
+        or equal to the number of local octants refer to the adjacent
+        (non-local) octants.
+
+        Returns:
+            ptr (np.ndarray), neighbors (np.ndarray), OctantArray:
+            Pointer into the neighbor array, the neighbor indices and
+            the adjacent non-local octants
+        """
+        cdef int size = 0
+        cdef const int *_ptr = NULL
+        cdef const int *_neighbors = NULL
+        cdef TMROctantArray *adjacent = NULL
+        size = self.ptr.getOctantNeighbors(&_ptr, &_neighbors, &adjacent)
+        if _ptr == NULL:
+            errmsg = 'TMROctForest: No octants to compute neighbors'
+            raise RuntimeError(errmsg)
+        ptr = np.zeros(26*size+1, dtype=np.intc)
+        for i in range(26*size+1):
+            ptr[i] = _ptr[i]
+        neighbors = np.zeros(ptr[26*size], dtype=np.intc)
+        for i in range(ptr[26*size]):
+            neighbors[i] = _neighbors[i]
+        return ptr, neighbors, _init_OctantArray(adjacent, 0)
+
+    def getGhostOctants(self, int depth=1):
+        """
+        getGhostOctants(self, depth=1)
+
+        Get the non-local octants within depth layers of the locally
+        owned octants. The ghosts are ordered by layer and the ghosts in
+        layer k + 1 are stored from layer_ptr[k] to layer_ptr[k + 1].
+        The returned octant array may contain ghosts from deeper layers
+        that were computed previously.
+
+        Args:
+            depth (int): The number of ghost layers
+
+        Returns:
+            OctantArray, owners (np.ndarray), layer_ptr (np.ndarray):
+            The ghost octants, the owner of each ghost within the depth
+            and the pointer to the start of each layer
+        """
+        cdef int num_ghosts = 0
+        cdef TMROctantArray *ghosts = NULL
+        cdef const int *_owners = NULL
+        cdef const int *_layer_ptr = NULL
+        num_ghosts = self.ptr.getGhostOctants(depth, &ghosts, &_owners,
+                                              &_layer_ptr)
+        if ghosts == NULL:
+            errmsg = 'TMROctForest: No octants to compute ghosts'
+            raise RuntimeError(errmsg)
+        owners = np.zeros(num_ghosts, dtype=np.intc)
+        for i in range(num_ghosts):
+            owners[i] = _owners[i]
+        layer_ptr = np.zeros(depth+1, dtype=np.intc)
+        for i in range(depth+1):
+            layer_ptr[i] = _layer_ptr[i]
+        return _init_OctantArray(ghosts, 0), owners, layer_ptr
+
     def getPoints(self):
         """
         getPoints(self)
@@ -3671,7 +4954,8 @@ cdef class OctForest:
         """
         cdef TMRPoint *X = NULL
         cdef int npts = 0
-        npts = self.ptr.getPoints(&X)
+        with nogil:
+            npts = self.ptr.getPoints(&X)
         Xp = np.zeros((npts, 3), dtype=np.double)
         for i in range(npts):
             Xp[i,0] = X[i].x
@@ -3766,6 +5050,93 @@ cdef class OctForest:
             filename = sfilename.c_str()
         self.ptr.writeForestToVTK(filename)
 
+    def writeForestToVTU(self, fname, use_float32=True):
+        """
+        Write the forest to a single binary VTK XML (.vtu) file using
+        collective MPI-IO
+        """
+        cdef string sfilename = tmr_convert_str_to_chars(fname)
+        cdef const char *filename = NULL
+        if fname is not None:
+            filename = sfilename.c_str()
+        return self.ptr.writeForestToVTU(filename, use_float32)
+
+    def writeForestToFile(self, fname):
+        """
+        Write the forest connectivity and elements to a binary checkpoint
+        file. This call is collective.
+        """
+        cdef string sfilename = tmr_convert_str_to_chars(fname)
+        return self.ptr.writeForestToFile(sfilename.c_str())
+
+    def readForestFromFile(self, fname):
+        """
+        Read the forest from a binary checkpoint file. The file may be read
+        on a different number of processors than it was written on.
+        """
+        cdef string sfilename = tmr_convert_str_to_chars(fname)
+        return self.ptr.readForestFromFile(sfilename.c_str())
+
+    def computeMeshQuality(self, int nbins=20):
+        """
+        computeMeshQuality(self, nbins=20)
+
+        Compute histograms of the element quality metrics in a single
+        threaded pass over the elements, summed across all processors.
+        The rows correspond to the scaled Jacobian, the inverse aspect
+        ratio and the skew quality. Each metric is one for an ideal
+        element and the bins are uniform over [0, 1]. This call is
+        collective and the nodes must be created first.
+
+        Args:
+            nbins (int): The number of bins in each histogram
+
+        Returns:
+            np.ndarray: The (3, nbins) histograms
+            np.ndarray: The minimum value of each metric
+        """
+        cdef np.ndarray hist = np.zeros((3, nbins), dtype=np.intc)
+        cdef np.ndarray minq = np.ones(3, dtype=np.double)
+        self.ptr.computeMeshQuality(nbins, <int*>hist.data,
+                                    <double*>minq.data)
+        return hist, minq
+
+    def getMemoryUsage(self):
+        """
+        getMemoryUsage(self)
+
+        Get the memory used by the forest on this processor
+
+        Returns:
+            dict: The number of bytes for the octants, nodes, conn, dep_nodes,
+            points, hash and other structures and the total
+        """
+        cdef TMRMemoryUsage usage
+        self.ptr.getMemoryUsage(&usage)
+        return _memory_usage_to_dict(&usage)
+
+    def getMaxMemoryUsage(self):
+        """
+        getMaxMemoryUsage(self)
+
+        Get the memory high-water mark recorded during balance() and
+        createNodes(), including the transient hash tables
+
+        Returns:
+            dict: The number of bytes for each structure at the high-water mark
+        """
+        cdef TMRMemoryUsage usage
+        self.ptr.getMaxMemoryUsage(&usage)
+        return _memory_usage_to_dict(&usage)
+
+    def resetMaxMemoryUsage(self):
+        """
+        resetMaxMemoryUsage(self)
+
+        Reset the memory high-water mark
+        """
+        self.ptr.resetMaxMemoryUsage()
+
     def createInterpolation(self, OctForest forest, VecInterp vec):
         """
         createInterpolation(self, forest, vec)
@@ -3777,10 +5148,36 @@ cdef class OctForest:
             forest (OctForest): The octree forest that has the common topology
             vec (VecInterp): The interpolation operator
         """
-        if self.ptr == forest.ptr:
+        cdef TMROctForest *fptr = forest.ptr
+        cdef TACSBVecInterp *vptr = vec.ptr
+        if self.ptr == fptr:
             errmsg = 'Cannot interpolate between the same object'
             raise ValueError(errmsg)
-        self.ptr.createInterpolation(forest.ptr, vec.ptr)
+        with nogil:
+            self.ptr.createInterpolation(fptr, vptr)
+
+    def setCacheInterpolation(self, int cache):
+        """
+        setCacheInterpolation(self, cache)
+
+        Retain the interpolation built by createInterpolation() so that
+        it can be reused when neither forest has changed since.
+
+        Args:
+            cache (int): Flag to retain the interpolation
+        """
+        self.ptr.setCacheInterpolation(cache)
+
+    def getCacheInterpolation(self):
+        """
+        getCacheInterpolation(self)
+
+        Get whether the interpolation is retained by createInterpolation()
+
+        Returns:
+            int: Flag indicating whether the interpolation is retained
+        """
+        return self.ptr.getCacheInterpolation()
 
 cdef _init_OctForest(TMROctForest* ptr):
     forest = OctForest()
@@ -3789,6 +5186,88 @@ cdef _init_OctForest(TMROctForest* ptr):
         forest.ptr.incref()
     return forest
 
+cdef class ElementLocator:
+    """
+    Locate the elements of an OctForest or QuadForest that contain a
+    set of physical points. The nodes of the forest must be created
+    before the locator.
+    """
+    cdef TMRElementLocator *ptr
+    def __cinit__(self, forest, double tol=1e-6):
+        self.ptr = NULL
+        if isinstance(forest, OctForest):
+            self.ptr = new TMRElementLocator((<OctForest>forest).ptr, tol)
+        elif isinstance(forest, QuadForest):
+            self.ptr = new TMRElementLocator((<QuadForest>forest).ptr, tol)
+        else:
+            errmsg = 'ElementLocator expects an OctForest or QuadForest'
+            raise ValueError(errmsg)
+        self.ptr.incref()
+
+    def __dealloc__(self):
+        if self.ptr:
+            self.ptr.decref()
+
+    def locatePoints(self, np.ndarray[double, ndim=2, mode='c'] X):
+        """
+        locatePoints(self, X)
+
+        Locate the elements that contain the points. This call is
+        collective and the points may differ on each processor.
+
+        Args:
+            X (np.ndarray): The points as an (n, 3) array
+
+        Returns:
+            tuple: The owner rank and the local element index on the owner
+            for each point (-1 if not found) and the (n, 3) array of
+            parametric points
+        """
+        cdef int n = X.shape[0]
+        cdef np.ndarray ranks = np.zeros(n, dtype=np.intc)
+        cdef np.ndarray elems = np.zeros(n, dtype=np.intc)
+        cdef np.ndarray prm = np.zeros((n, 3), dtype=np.double)
+        cdef TMRPoint *pts = <TMRPoint*>X.data
+        cdef int *r = <int*>ranks.data
+        cdef int *e = <int*>elems.data
+        cdef double *p = <double*>prm.data
+        with nogil:
+            self.ptr.locatePoints(n, pts, r, e, p)
+        return ranks, elems, prm
+
+    def createInterpolation(self, forest, VecInterp vec):
+        """
+        createInterpolation(self, forest, vec)
+
+        Create the interpolation from the nodes of the forest used by the
+        locator to the nodes of another forest. The forests do not need to
+        share a common topology. The interpolation must be initialized after
+        this call.
+
+        Args:
+            forest (OctForest or QuadForest): The forest for the output nodes
+            vec (VecInterp): The interpolation operator
+
+        Returns:
+            int: The number of nodes that were not located
+        """
+        cdef int fail = 0
+        cdef TACSBVecInterp *vptr = vec.ptr
+        cdef TMROctForest *oct_ptr = NULL
+        cdef TMRQuadForest *quad_ptr = NULL
+        if isinstance(forest, OctForest):
+            oct_ptr = (<OctForest>forest).ptr
+            with nogil:
+                fail = self.ptr.createInterpolation(oct_ptr, vptr)
+        elif isinstance(forest, QuadForest):
+            quad_ptr = (<QuadForest>forest).ptr
+            with nogil:
+                fail = self.ptr.createInterpolation(quad_ptr, vptr)
+        else:
+            errmsg = 'ElementLocator expects an OctForest or QuadForest'
+            raise ValueError(errmsg)
+        return fail
+
 def sewModel(file, units="M", int print_level=0, sew_options={}):
     """
     Load in a STEP/IGES file, apply a sewing operation with OpenCASCADE,
@@ -3802,60 +5281,90 @@ def sewModel(file, units="M", int print_level=0, sew_options={}):
         print_lev (int): Print level for operation
         sew_options (dict): options for sewing operation on model
     """
-    cdef char *filename = tmr_convert_str_to_chars(file)
-    cdef const char *units_chars = tmr_convert_str_to_chars(units)
+    cdef string sfilename = tmr_convert_str_to_chars(file)
+    cdef string sunits = tmr_convert_str_to_chars(units)
+    cdef char *filename = <char*>sfilename.c_str()
+    cdef const char *units_chars = sunits.c_str()
+    cdef double sew_tol = sew_options.get("sew_tol",1e-6)
+    cdef bool nonmanifold = sew_options.get("nonmanifold_mode",False)
     if file.lower().endswith(('step', 'stp')):
-        TMR_SewModelSTEP(filename,
-                         units_chars,
-                         print_level,
-                         sew_options.get("sew_tol",1e-6),
-                         sew_options.get("nonmanifold_mode",False))
+        with nogil:
+            TMR_SewModelSTEP(filename, units_chars, print_level,
+                             sew_tol, nonmanifold)
     elif file.lower().endswith(('iges', 'igs')):
-        TMR_SewModelIGES(filename,
-                         units_chars,
-                         print_level,
-                         sew_options.get("sew_tol",1e-6),
-                         sew_options.get("nonmanifold_mode",False))
+        with nogil:
+            TMR_SewModelIGES(filename, units_chars, print_level,
+                             sew_tol, nonmanifold)
     else:
         print("model file extension not supported")
     return
 
-def LoadModel(fname, units="M", int print_lev=0):
+def LoadModel(fname, units="M", int print_lev=0, int convert_to_native=0,
+              MPI.Comm comm=None, double sew_tol=0.0, cache_dir=None):
     """
-    LoadModel(fname, print_lev=0)
+    LoadModel(fname, print_lev=0, convert_to_native=0, comm=None, sew_tol=0.0,
+              cache_dir=None)
 
     Load and initialize a Model class based on information within a STEP, IGES or
     EGADS file. The file type is determined based on the extension.
 
+    When a communicator is provided, STEP files are read and healed on the
+    root processor only and the result is broadcast to all processors. The
+    healed model is cached in cache_dir, if given, and reused by later runs.
+
     Args:
         fname (str): Name of the geometry file
         units (str): Units to use when reading in geometry file (IGES/STEP)
         print_lev (int): Print level for operation
+        convert_to_native (int): Convert supported geometry to native B-splines
+        comm (MPI.Comm): Communicator for the parallel STEP import
+        sew_tol (float): Sew and fix the STEP model with this tolerance if > 0
+        cache_dir (str): Directory for the healed STEP model cache
 
     Returns:
         Model: An instance of a Model class
     """
     cdef string sfilename = tmr_convert_str_to_chars(fname)
     cdef string sunits = tmr_convert_str_to_chars(units)
+    cdef string scache
     cdef const char *units_c = sunits.c_str()
     cdef const char *filename = NULL
+    cdef const char *cache_c = NULL
     cdef TMRModel *model = NULL
+    cdef MPI_Comm c_comm = NULL
     if fname is not None:
         filename = sfilename.c_str()
-    if fname.lower().endswith(('step', 'stp')):
-        model = TMR_LoadModelFromSTEPFile(filename, units_c, print_lev)
+    if cache_dir is not None:
+        scache = tmr_convert_str_to_chars(cache_dir)
+        cache_c = scache.c_str()
+    # Release the GIL while the model is read and healed
+    if fname.lower().endswith(('step', 'stp')) and comm is not None:
+        c_comm = comm.ob_mpi
+        with nogil:
+            model = TMR_LoadModelFromSTEPFile(c_comm, filename, units_c,
+                                              sew_tol, cache_c, print_lev,
+                                              convert_to_native)
+    elif fname.lower().endswith(('step', 'stp')):
+        with nogil:
+            model = TMR_LoadModelFromSTEPFile(filename, units_c, print_lev,
+                                              convert_to_native)
     elif fname.lower().endswith(('igs', 'iges')):
-        model = TMR_LoadModelFromIGESFile(filename, units_c, print_lev)
+        with nogil:
+            model = TMR_LoadModelFromIGESFile(filename, units_c, print_lev,
+                                              convert_to_native)
     elif fname.lower().endswith(('egads')):
-        model = TMR_LoadModelFromEGADSFile(filename, units_c, print_lev)
+        with nogil:
+            model = TMR_LoadModelFromEGADSFile(filename, units_c, print_lev,
+                                               convert_to_native)
     if model is NULL:
         errmsg = 'Error loading model. File %s does not exist?'%(fname)
         raise RuntimeError(errmsg)
     return _init_Model(model)
 
-def ConvertEGADSModel(pyego egads_model, int print_lev=0):
+def ConvertEGADSModel(pyego egads_model, int print_lev=0,
+                      int convert_to_native=0):
     """
-    ConvertEGADSModel(egads_model, print_lev=0)
+    ConvertEGADSModel(egads_model, print_lev=0, convert_to_native=0)
 
     This function wraps the egads4py object with the TMR interface layer and
     creates a Model class.
@@ -3863,12 +5372,14 @@ def ConvertEGADSModel(pyego egads_model, int print_lev=0):
     Args:
         egads_model (pyego): Model created from egads4py
         print_lev (int): Print level for operation
+        convert_to_native (int): Convert supported geometry to native B-splines
 
     Returns:
         Model: An instance of a Model class
     """
     cdef TMRModel *model = NULL
-    model = TMR_ConvertEGADSModel(egads_model.ptr, print_lev)
+    model = TMR_ConvertEGADSModel(egads_model.ptr, print_lev,
+                                  convert_to_native)
     if model is NULL:
         errmsg = 'Error converting EGADS model.'
         raise RuntimeError(errmsg)
@@ -3939,7 +5450,7 @@ cdef class BoundaryConditions:
         return
 
 cdef TACSElement* _createQuadElement(void *_self, int order,
-                                     TMRQuadrant *quad) noexcept:
+                                     TMRQuadrant *quad) noexcept with gil:
     cdef TACSElement *elem = NULL
     q = Quadrant()
     q.quad.x = quad.x
@@ -3955,6 +5466,55 @@ cdef TACSElement* _createQuadElement(void *_self, int order,
         return elem
     return NULL
 
+# Set the elements from the table of unique elements and the index
+# of the table entry for each element returned by a createElements()
+# callback. Each entry in the elements array holds a reference.
+cdef int _set_element_table(result, int num,
+                            TACSElement **elements) except -1:
+    cdef int i = 0
+    cdef int k = 0
+    cdef int ntable = 0
+    cdef TACSElement **table = NULL
+    cdef np.ndarray index
+    cdef int *idx = NULL
+    elems, indices = result
+    index = np.ascontiguousarray(indices, dtype=np.intc)
+    if index.ndim != 1 or index.shape[0] != num:
+        errmsg = 'Element index array must have length %d'%(num)
+        raise ValueError(errmsg)
+    ntable = len(elems)
+    idx = <int*>index.data
+    for i in range(num):
+        if idx[i] < 0 or idx[i] >= ntable:
+            errmsg = 'Element index %d out of range [0,%d)'%(idx[i], ntable)
+            raise IndexError(errmsg)
+    table = <TACSElement**>malloc(ntable*sizeof(TACSElement*))
+    for k in range(ntable):
+        table[k] = NULL
+        if elems[k] is not None:
+            table[k] = (<Element>elems[k]).ptr
+    for i in range(num):
+        elements[i] = table[idx[i]]
+        if elements[i] != NULL:
+            elements[i].incref()
+    free(table)
+    return 0
+
+cdef int _createQuadElements(void *_self, int order, int num,
+                             TMRQuadrant *quads,
+                             TACSElement **elements) noexcept with gil:
+    cdef int fail = 0
+    try:
+        view = inplace_array_1d(np.NPY_BYTE, num*sizeof(TMRQuadrant),
+                                <void*>quads).view(QUADRANT_DTYPE)
+        _set_element_table((<object>_self).createElements(order, view),
+                           num, elements)
+    except:
+        tb = traceback.format_exc()
+        print(tb)
+        fail = 1
+    return fail
+
 cdef class QuadCreator:
     """
     Generates a QuadForest object
@@ -3966,6 +5526,18 @@ cdef class QuadCreator:
 
     This function takes the order of the mesh and a TMR.Quadrant and returns a
     TACS.Element object that will be placed into an Assembler object.
+
+    Alternatively, implement the batched member function:
+
+    createElements(self, order, quads)
+
+    This function is called once with a structured array of all the local
+    quadrants (dtype QUADRANT_DTYPE). It returns a tuple (elems, index) where
+    elems is a list of unique TACS.Element objects and index is an integer
+    array giving the entry in elems for each quadrant. For instance, the
+    quadrants can be grouped with np.unique(quads['tag'], return_inverse=True).
+    Elements that are shared between quadrants should not be assigned to
+    different components. When both are defined, createElements is used.
     """
     cdef TMRCyQuadCreator *ptr
     def __cinit__(self, BoundaryConditions bcs, int design_vars_per_node=1,
@@ -3974,6 +5546,8 @@ cdef class QuadCreator:
         self.ptr.incref()
         self.ptr.setSelfPointer(<void*>self)
         self.ptr.setCreateQuadElement(_createQuadElement)
+        if hasattr(self, 'createElements'):
+            self.ptr.setCreateQuadElements(_createQuadElements)
         return
 
     def __dealloc__(self):
@@ -4004,11 +5578,13 @@ cdef class QuadCreator:
                 # get the temporary name as a c++ string
                 temp_name = tmr_convert_str_to_chars(name)
                 # allocate space for the current name
-                components[icomp] = <char*>malloc((temp_name.length())*sizeof(char))
+                components[icomp] = <char*>malloc((temp_name.length()+1)*sizeof(char))
                 # copy the name to store it
                 strcpy(components[icomp], temp_name.c_str())
         # create/initialize the TACSAssembler object
-        assembler = self.ptr.createTACS(forest.ptr, ordering, ncomps, <const char**>components)
+        with nogil:
+            assembler = self.ptr.createTACS(forest.ptr, ordering, ncomps,
+                                            <const char**>components)
         # free allocated memory
         if (components):
             for i in range(ncomps):
@@ -4023,7 +5599,7 @@ cdef class QuadCreator:
         return None
 
 cdef TACSElement* _createOctElement(void *_self, int order,
-                                    TMROctant *octant) noexcept:
+                                    TMROctant *octant) noexcept with gil:
     cdef TACSElement *elem = NULL
     o = Octant()
     o.octant.x = octant.x
@@ -4040,6 +5616,21 @@ cdef TACSElement* _createOctElement(void *_self, int order,
         return elem
     return NULL
 
+cdef int _createOctElements(void *_self, int order, int num,
+                            TMROctant *octs,
+                            TACSElement **elements) noexcept with gil:
+    cdef int fail = 0
+    try:
+        view = inplace_array_1d(np.NPY_BYTE, num*sizeof(TMROctant),
+                                <void*>octs).view(OCTANT_DTYPE)
+        _set_element_table((<object>_self).createElements(order, view),
+                           num, elements)
+    except:
+        tb = traceback.format_exc()
+        print(tb)
+        fail = 1
+    return fail
+
 cdef class OctCreator:
     """
     Generates a OctCreator object
@@ -4051,6 +5642,18 @@ cdef class OctCreator:
 
     This function takes the order of the mesh and a TMR.Octant and returns a
     TACS.Element object that will be placed into an Assembler object.
+
+    Alternatively, implement the batched member function:
+
+    createElements(self, order, octs)
+
+    This function is called once with a structured array of all the local
+    octants (dtype OCTANT_DTYPE). It returns a tuple (elems, index) where
+    elems is a list of unique TACS.Element objects and index is an integer
+    array giving the entry in elems for each octant. For instance, the
+    octants can be grouped with np.unique(octs['block'], return_inverse=True).
+    Elements that are shared between octants should not be assigned to
+    different components. When both are defined, createElements is used.
     """
     cdef TMRCyOctCreator *ptr
     def __cinit__(self, BoundaryConditions bcs,
@@ -4060,6 +5663,8 @@ cdef class OctCreator:
         self.ptr.incref()
         self.ptr.setSelfPointer(<void*>self)
         self.ptr.setCreateOctElement(_createOctElement)
+        if hasattr(self, 'createElements'):
+            self.ptr.setCreateOctElements(_createOctElements)
         return
 
     def __dealloc__(self):
@@ -4091,11 +5696,13 @@ cdef class OctCreator:
                 # get the temporary name as a c++ string
                 temp_name = tmr_convert_str_to_chars(name)
                 # allocate space for the current name
-                components[icomp] = <char*>malloc((temp_name.length())*sizeof(char))
+                components[icomp] = <char*>malloc((temp_name.length()+1)*sizeof(char))
                 # copy the name to store it
                 strcpy(components[icomp], temp_name.c_str())
         # create/initialize the TACSAssembler object
-        assembler = self.ptr.createTACS(forest.ptr, ordering, ncomps, <const char**>components)
+        with nogil:
+            assembler = self.ptr.createTACS(forest.ptr, ordering, ncomps,
+                                            <const char**>components)
         # free allocated memory
         if (components):
             for i in range(ncomps):
@@ -4109,11 +5716,31 @@ cdef class OctCreator:
             return _init_OctForest(filtr)
         return None
 
+    def setUseCache(self, use_cache=True):
+        """
+        setUseCache(self, use_cache=True)
+
+        Reuse the elements and the Assembler object from previous calls to
+        createTACS when the forest has not changed.
+
+        Args:
+            use_cache (bool): Flag to enable or disable the cache
+        """
+        self.ptr.setUseCache(int(use_cache))
+
+    def clearCache(self):
+        """
+        clearCache(self)
+
+        Free the cached elements and Assembler objects.
+        """
+        self.ptr.clearCache()
+
 
 cdef TACSElement* _createQuadTopoElement(void *_self, int order,
                                          TMRQuadrant *quad,
                                          int nweights,
-                                         TMRIndexWeight *weights) noexcept:
+                                         TMRIndexWeight *weights) noexcept with gil:
     cdef TACSElement *elem = NULL
     q = Quadrant()
     q.quad.x = quad.x
@@ -4151,7 +5778,8 @@ cdef class QuadTopoCreator:
     def createTACS(self, QuadForest forest,
                    OrderingType ordering=TACS.NATURAL_ORDER):
         cdef TACSAssembler *assembler = NULL
-        assembler = self.ptr.createTACS(forest.ptr, ordering)
+        with nogil:
+            assembler = self.ptr.createTACS(forest.ptr, ordering)
         return _init_Assembler(assembler)
 
     def getFilter(self):
@@ -4162,7 +5790,7 @@ cdef TACSElement* _createQuadConformTopoElement(void *_self, int order,
                                                 TMRQuadrant *quad,
                                                 int nweights,
                                                 const int *index,
-                                                TMRQuadForest *filtr) noexcept:
+                                                TMRQuadForest *filtr) noexcept with gil:
     cdef TACSElement *elem = NULL
     q = Quadrant()
     q.quad.x = quad.x
@@ -4203,7 +5831,8 @@ cdef class QuadConformTopoCreator:
     def createTACS(self, QuadForest forest,
                    OrderingType ordering=TACS.NATURAL_ORDER):
         cdef TACSAssembler *assembler = NULL
-        assembler = self.ptr.createTACS(forest.ptr, ordering)
+        with nogil:
+            assembler = self.ptr.createTACS(forest.ptr, ordering)
         return _init_Assembler(assembler)
 
     def getFilter(self):
@@ -4213,7 +5842,7 @@ cdef class QuadConformTopoCreator:
 cdef TACSElement* _createOctTopoElement(void *_self, int order,
                                         TMROctant *octant,
                                         int nweights,
-                                        TMRIndexWeight *weights) noexcept:
+                                        TMRIndexWeight *weights) noexcept with gil:
     cdef TACSElement *elem = NULL
     oct = Octant()
     oct.octant.x = octant.x
@@ -4253,18 +5882,40 @@ cdef class OctTopoCreator:
     def createTACS(self, OctForest forest,
                    OrderingType ordering=TACS.NATURAL_ORDER):
         cdef TACSAssembler *assembler = NULL
-        assembler = self.ptr.createTACS(forest.ptr, ordering)
+        with nogil:
+            assembler = self.ptr.createTACS(forest.ptr, ordering)
         return _init_Assembler(assembler)
 
     def getFilter(self):
         cdef TMROctForest *filtr = self.ptr.getFilter()
         return _init_OctForest(filtr)
 
+    def setUseCache(self, use_cache=True):
+        """
+        setUseCache(self, use_cache=True)
+
+        Reuse the elements and the Assembler object from previous calls to
+        createTACS when the forest has not changed.
+
+        Args:
+            use_cache (bool): Flag to enable or disable the cache
+        """
+        self.ptr.setUseCache(int(use_cache))
+
+    def clearCache(self):
+        """
+        clearCache(self)
+
+        Free the cached elements and Assembler objects.
+        """
+        self.ptr.clearCache()
+
+
 cdef TACSElement* _createOctConformTopoElement( void *_self, int order,
                                                 TMROctant *octant,
                                                 int nweights,
                                                 const int *index,
-                                                TMROctForest *filtr) noexcept:
+                                                TMROctForest *filtr) noexcept with gil:
     cdef TACSElement *elem = NULL
     Oct = Octant()
     Oct.octant.x = octant.x
@@ -4307,13 +5958,35 @@ cdef class OctConformTopoCreator:
     def createTACS(self, OctForest forest,
                    OrderingType ordering=TACS.NATURAL_ORDER):
         cdef TACSAssembler *assembler = NULL
-        assembler = self.ptr.createTACS(forest.ptr, ordering)
+        with nogil:
+            assembler = self.ptr.createTACS(forest.ptr, ordering)
         return _init_Assembler(assembler)
 
     def getFilter(self):
         cdef TMROctForest *filtr = self.ptr.getFilter()
         return _init_OctForest(filtr)
 
+    def setUseCache(self, use_cache=True):
+        """
+        setUseCache(self, use_cache=True)
+
+        Reuse the elements and the Assembler object from previous calls to
+        createTACS when the forest has not changed.
+
+        Args:
+            use_cache (bool): Flag to enable or disable the cache
+        """
+        self.ptr.setUseCache(int(use_cache))
+
+    def clearCache(self):
+        """
+        clearCache(self)
+
+        Free the cached elements and Assembler objects.
+        """
+        self.ptr.clearCache()
+
+
 def createMg(list assemblers, list forests, double omega=1.0,
              use_galerkin=False,
              use_coarse_direct_solve=True,
@@ -4500,6 +6173,94 @@ def adjointError(forest, Assembler coarse,
                                       &adj_corr)
     return err_est, adj_corr, elem_error, node_error
 
+cdef TMROctTACSCreator* _getOctCreatorPtr(creator):
+    if isinstance(creator, OctCreator):
+        return (<OctCreator>creator).ptr
+    elif isinstance(creator, OctTopoCreator):
+        return (<OctTopoCreator>creator).ptr
+    elif isinstance(creator, OctConformTopoCreator):
+        return (<OctConformTopoCreator>creator).ptr
+    raise ValueError('Creator must be an OctCreator, OctTopoCreator or '
+                     'OctConformTopoCreator')
+
+def virtualStrainEnergyError(OctForest forest, Assembler coarse, creator):
+    """
+    virtualStrainEnergyError(forest, coarse_assembler, creator)
+
+    Compute the strain energy error estimate using a virtual refinement of the
+    forest. The higher-order elements are made by the creator and no refined
+    forest nodes or refined assembler are created.
+
+    Parameters
+    -----------
+    forest: :class:`~TMR.OctForest`
+      Forest for current mesh level
+    coarse: :class:`~TACS.Assembler`
+      Finite assembler class associated with forest
+    creator: :class:`~TMR.OctCreator` or :class:`~TMR.OctTopoCreator`
+      Creator used to make the higher-order elements
+
+    Returns
+    --------
+    ans: double
+      Total strain energy error
+
+    err: array of double
+      Elemental strain energy error
+    """
+    cdef double ans = 0.0
+    cdef TMROctTACSCreator *ptr = _getOctCreatorPtr(creator)
+    cdef np.ndarray err = np.zeros(coarse.ptr.getNumElements(), dtype=np.double)
+    ans = TMR_StrainEnergyErrorEst(forest.ptr, coarse.ptr, ptr,
+                                   <double*>err.data)
+    return ans, err
+
+def virtualAdjointError(OctForest forest, Assembler coarse, creator,
+                        Vec adjoint, Vec solution=None):
+    """
+    virtualAdjointError(forest, coarse_assembler, creator, adjoint,
+                        solution=None)
+
+    Compute the adjoint-based error estimate using a virtual refinement of the
+    forest. The solution and adjoint are reconstructed on each higher-order
+    element and the adjoint-weighted residual is evaluated element-by-element.
+
+    Parameters
+    -----------
+    forest: :class:`~TMR.OctForest`
+      Forest for current mesh level
+    coarse: :class:`~TACS.Assembler`
+      Finite assembler class associated with forest
+    creator: :class:`~TMR.OctCreator` or :class:`~TMR.OctTopoCreator`
+      Creator used to make the higher-order elements
+    adjoint: :class:`~TACS.Vec`
+      The adjoint solution on the current mesh
+    solution: :class:`~TACS.Vec`
+      The solution on the current mesh (defaults to the assembler variables)
+
+    Returns
+    -------
+    err_est: double
+      Total error estimate for the output functional
+
+    adj_corr: TacsScalar
+      Adjoint-based output functional correction
+
+    err: array of double
+      Element-wise error indicators
+    """
+    cdef TMROctTACSCreator *ptr = _getOctCreatorPtr(creator)
+    cdef TACSBVec *sol = NULL
+    cdef double err_est = 0.0
+    cdef double adj_corr = 0.0
+    cdef np.ndarray elem_error = np.zeros(coarse.ptr.getNumElements(), dtype=np.double)
+    if solution is not None:
+        sol = solution.getBVecPtr()
+    err_est = TMR_AdjointErrorEst(forest.ptr, coarse.ptr, ptr,
+                                  sol, adjoint.getBVecPtr(),
+                                  <double*>elem_error.data, &adj_corr)
+    return err_est, adj_corr, elem_error
+
 def computeInterpSolution(forest, Assembler coarse,
                           forest_refined, Assembler refined,
                           Vec uvec=None, Vec uvec_refined=None):
@@ -4607,6 +6368,89 @@ def computeReconSolution(forest, Assembler coarse,
                                  uvec_ptr, uvec_refined_ptr, diff)
     return
 
+def computeErrorThreshold(MPI.Comm comm,
+                          np.ndarray[double, ndim=1, mode='c'] error,
+                          int ntarget, largest=True):
+    """
+    computeErrorThreshold(comm, error, ntarget, largest=True)
+
+    Find the error threshold that selects ntarget elements across all
+    processors using a parallel histogram. The element errors are not
+    gathered.
+
+    Parameters
+    -----------
+    comm: mpi4py.MPI.Intracomm
+      The communicator
+    error: array of double
+      The local element errors
+    ntarget: int
+      The target number of elements across all processors
+    largest: bool
+      Select the elements with the largest errors (or the smallest)
+
+    Returns
+    --------
+    threshold: double
+      The threshold value
+    """
+    cdef int select_largest = 0
+    if largest:
+        select_largest = 1
+    return TMR_ComputeErrorThreshold(comm.ob_mpi, <double*>error.data,
+                                     error.shape[0], ntarget, select_largest)
+
+def computeRefinementArray(MPI.Comm comm,
+                           np.ndarray[double, ndim=1, mode='c'] error,
+                           int nrefine, int ncoarsen=0,
+                           double refine_cutoff=0.0,
+                           double coarsen_cutoff=0.0):
+    """
+    computeRefinementArray(comm, error, nrefine, ncoarsen=0,
+                           refine_cutoff=0.0, coarsen_cutoff=0.0)
+
+    Compute the refinement array for the forest. The nrefine elements with
+    the largest errors are refined if their error is at least refine_cutoff
+    and the ncoarsen elements with the smallest errors are coarsened if their
+    error is less than coarsen_cutoff.
+
+    Parameters
+    -----------
+    comm: mpi4py.MPI.Intracomm
+      The communicator
+    error: array of double
+      The local element errors
+    nrefine: int
+      The target number of refined elements across all processors
+    ncoarsen: int
+      The target number of coarsened elements across all processors
+    refine_cutoff: double
+      The smallest error that will be refined
+    coarsen_cutoff: double
+      Elements with an error below this value may be coarsened
+
+    Returns
+    --------
+    refine: array of int
+      The refinement array that can be passed to refine()
+    nref: int
+      The number of refined elements across all processors
+    refine_threshold: double
+      The threshold used for refinement
+    coarsen_threshold: double
+      The threshold used for coarsening
+    """
+    cdef int nelems = error.shape[0]
+    cdef double rthresh = 0.0
+    cdef double cthresh = 0.0
+    cdef int nref = 0
+    cdef np.ndarray refine = np.zeros(nelems, dtype=np.intc)
+    nref = TMR_ComputeRefinementArray(comm.ob_mpi, <double*>error.data, nelems,
+                                      nrefine, ncoarsen, refine_cutoff,
+                                      coarsen_cutoff, <int*>refine.data,
+                                      &rthresh, &cthresh)
+    return refine, nref, rthresh, cthresh
+
 def writeSTLToBin(fname, OctForest forest,
                   Vec x, int index=0, double cutoff=0.5):
     """
@@ -4630,6 +6474,76 @@ def writeSTLToBin(fname, OctForest forest,
     TMR_GenerateBinFile(filename, forest.ptr, x.getBVecPtr(), index, cutoff)
     return
 
+def writeSTLFile(fname, OctForest forest,
+                 Vec x, int index=0, double cutoff=0.5):
+    """
+    writeSTLFile(fname, forest, x, index=0, cutoff=0.5)
+
+    Write the triangularization of the levelset of the design field x
+    directly to a binary STL file. All processors write their
+    triangles to the file collectively.
+
+    Args:
+        fname (str): The file name of file
+        forest (OctForest): The octree forest
+        x (Vec): The design vector
+        index (int): Offset in the design vector (for multimaterial problems)
+        cutoff (double): Level-set cutoff value
+    """
+    cdef string sfilename = tmr_convert_str_to_chars(fname)
+    cdef const char *filename = NULL
+    if fname is not None:
+        filename = sfilename.c_str()
+    TMR_WriteSTLFile(filename, forest.ptr, x.getBVecPtr(), index, cutoff)
+    return
+
+def writeIndexedSTLToBin(fname, OctForest forest,
+                         Vec x, int index=0, double cutoff=0.5):
+    """
+    writeIndexedSTLToBin(fname, forest, x, index=0, cutoff=0.5)
+
+    Write the triangularization of the levelset of the design field x
+    to a binary file containing a list of unique vertices and the
+    vertex indices of each triangle.
+
+    Args:
+        fname (str): The file name of file
+        forest (OctForest): The octree forest
+        x (Vec): The design vector
+        index (int): Offset in the design vector (for multimaterial problems)
+        cutoff (double): Level-set cutoff value
+    """
+    cdef string sfilename = tmr_convert_str_to_chars(fname)
+    cdef const char *filename = NULL
+    if fname is not None:
+        filename = sfilename.c_str()
+    TMR_WriteIndexedBinFile(filename, forest.ptr, x.getBVecPtr(), index,
+                            cutoff)
+    return
+
+def writePLYFile(fname, OctForest forest,
+                 Vec x, int index=0, double cutoff=0.5):
+    """
+    writePLYFile(fname, forest, x, index=0, cutoff=0.5)
+
+    Write the triangularization of the levelset of the design field x
+    to a binary PLY file. Vertices are shared between octants and
+    processors and stored in single precision.
+
+    Args:
+        fname (str): The file name of file
+        forest (OctForest): The octree forest
+        x (Vec): The design vector
+        index (int): Offset in the design vector (for multimaterial problems)
+        cutoff (double): Level-set cutoff value
+    """
+    cdef string sfilename = tmr_convert_str_to_chars(fname)
+    cdef const char *filename = NULL
+    if fname is not None:
+        filename = sfilename.c_str()
+    TMR_WritePLYFile(filename, forest.ptr, x.getBVecPtr(), index, cutoff)
+    return
+
 def getSTLTriangles(OctForest forest, Vec x, int offset=0,
                     double cutoff=0.5, int root=0):
     cdef int ntris = 0
@@ -4700,6 +6614,21 @@ cdef class TopoFilter:
             return _init_Assembler(self.ptr.getAssembler())
         return None
 
+    def getMemoryUsage(self):
+        """
+        getMemoryUsage(self)
+
+        Get the memory used by the filter forests and design vectors on this
+        processor
+
+        Returns:
+            dict: The number of bytes for each structure and the total
+        """
+        cdef TMRMemoryUsage usage
+        if self.ptr != NULL:
+            self.ptr.getMemoryUsage(&usage)
+        return _memory_usage_to_dict(&usage)
+
     def setDesignVars(self, Vec vec):
         """
         setDesignVars(self, vec)
@@ -4895,6 +6824,7 @@ cdef class HelmholtzFilter(TopoFilter):
         return
 
 cdef class MatrixFilter(TopoFilter):
+    cdef TMRMatrixFilter* mptr
     def __cinit__(self, double r, int N, list assemblers, list filters):
         cdef int nlevels = 0
         cdef int isqforest = 0
@@ -4919,7 +6849,8 @@ cdef class MatrixFilter(TopoFilter):
             for i in range(nlevels):
                 qfiltr[i] = (<QuadForest>filters[i]).ptr
                 assemb[i] = (<Assembler>assemblers[i]).ptr
-            self.ptr = new TMRMatrixFilter(r, N, nlevels, assemb, qfiltr)
+            self.mptr = new TMRMatrixFilter(r, N, nlevels, assemb, qfiltr)
+            self.ptr = self.mptr
             self.ptr.incref()
             free(qfiltr)
         else:
@@ -4927,13 +6858,18 @@ cdef class MatrixFilter(TopoFilter):
             for i in range(nlevels):
                 ofiltr[i] = (<OctForest>filters[i]).ptr
                 assemb[i] = (<Assembler>assemblers[i]).ptr
-            self.ptr = new TMRMatrixFilter(r, N, nlevels, assemb, ofiltr)
+            self.mptr = new TMRMatrixFilter(r, N, nlevels, assemb, ofiltr)
+            self.ptr = self.mptr
             self.ptr.incref()
             free(ofiltr)
 
         free(assemb)
         return
 
+    def setUseSinglePrecision(self, flag=True):
+        self.mptr.setUseSinglePrecision(flag)
+        return
+
 # This wraps a C++ array with a numpy array for later useage
 cdef inplace_array_1d(int nptype, int dim1, void *data_ptr):
     """Return a numpy version of the array"""
@@ -4953,7 +6889,8 @@ cdef inplace_array_1d(int nptype, int dim1, void *data_ptr):
     return ndarray
 
 cdef int _getinteriorstencil(void *_self, int diag, int npts,
-                             const TacsScalar *X, double *alphas) noexcept:
+                             const TacsScalar *X,
+                             double *alphas) noexcept with gil:
     cdef int fail = 0
     try:
         _X = inplace_array_1d(np.NPY_DOUBLE, 3*npts, <void*>X)
@@ -4968,7 +6905,8 @@ cdef int _getinteriorstencil(void *_self, int diag, int npts,
 
 cdef int _getboundarystencil(void *_self, int diag,
                              const TacsScalar *n, int npts,
-                             const TacsScalar *X, double *alphas) noexcept:
+                             const TacsScalar *X,
+                             double *alphas) noexcept with gil:
     cdef int fail = 0
     try:
         _n = np.array([n[0], n[1], n[2]])
@@ -5038,6 +6976,69 @@ cdef class HelmholtzPUFilter(TopoFilter):
         self.hptr.initialize()
         return
 
+    def setUseStencilCache(self, flag=True):
+        self.hptr.setUseStencilCache(flag)
+        return
+
+    def setUseSinglePrecision(self, flag=True):
+        self.hptr.setUseSinglePrecision(flag)
+        return
+
+cdef class MFilter(TopoFilter):
+    cdef TMRMFilter* mptr
+    def __cinit__(self, int N, list assemblers, list filters, double r=0.01):
+        cdef int nlevels = 0
+        cdef int isqforest = 0
+        cdef TACSAssembler **assemb = NULL
+        cdef TMROctForest **ofiltr = NULL
+        cdef TMRQuadForest **qfiltr = NULL
+
+        if len(assemblers) != len(filters):
+            errmsg = 'MFilter must have equal number of objects in lists'
+            raise ValueError(errmsg)
+
+        nlevels = len(assemblers)
+        for i in range(nlevels):
+            if isinstance(filters[i], QuadForest):
+                isqforest = 1
+            elif isinstance(filters[i], OctForest):
+                isqforest = 0
+
+        assemb = <TACSAssembler**>malloc(nlevels*sizeof(TACSAssembler*))
+        if isqforest:
+            qfiltr = <TMRQuadForest**>malloc(nlevels*sizeof(TMRQuadForest*))
+            for i in range(nlevels):
+                qfiltr[i] = (<QuadForest>filters[i]).ptr
+                assemb[i] = (<Assembler>assemblers[i]).ptr
+            self.mptr = new TMRMFilter(N, nlevels, assemb, qfiltr, r)
+            self.ptr = self.mptr
+            self.ptr.incref()
+            free(qfiltr)
+        else:
+            ofiltr = <TMROctForest**>malloc(nlevels*sizeof(TMROctForest*))
+            for i in range(nlevels):
+                ofiltr[i] = (<OctForest>filters[i]).ptr
+                assemb[i] = (<Assembler>assemblers[i]).ptr
+            self.mptr = new TMRMFilter(N, nlevels, assemb, ofiltr, r)
+            self.ptr = self.mptr
+            self.ptr.incref()
+            free(ofiltr)
+
+        free(assemb)
+        return
+
+    def initialize(self):
+        self.mptr.initialize()
+        return
+
+    def setUseStencilCache(self, flag=True):
+        self.mptr.setUseStencilCache(flag)
+        return
+
+    def setUseSinglePrecision(self, flag=True):
+        self.mptr.setUseSinglePrecision(flag)
+        return
+
 cdef class StiffnessProperties:
     cdef TMRStiffnessProperties *ptr
     def __cinit__(self, props, **kwargs):
@@ -5111,6 +7112,8 @@ cdef class StiffnessProperties:
                                               penalty_type, qmass, qcond, qtemp,
                                               ksWeight, beta, xoffset, use_project)
         self.ptr.incref()
+        if 'active_material_tol' in kwargs:
+            self.ptr.active_material_tol = kwargs['active_material_tol']
 
         if nmats > 1:
             free(_props)
@@ -5187,6 +7190,12 @@ cdef class StiffnessProperties:
         def __set__(self, value):
             self.ptr.beta = value
 
+    property active_material_tol:
+        def __get__(self):
+            return self.ptr.active_material_tol
+        def __set__(self, value):
+            self.ptr.active_material_tol = value
+
     property use_project:
         def __get__(self):
             if self.ptr.use_project:
@@ -5274,6 +7283,58 @@ def ApproximateDistance(filtr, Vec x, int index=0,
         return dist
     return None
 
+def FastMarchingDistance(filtr, Vec x, int index=0,
+                         double cutoff=0.15, Vec dist=None):
+    """
+    FastMarchingDistance(filtr, x, index=0, cutoff=0.15, dist=None)
+
+    Compute the signed distance to the material interface using the
+    fast marching method on the nodes of the filter forest. The
+    interface consists of the nodes with intermediate density and the
+    crossings of the 0.5 density level set.
+
+    Args:
+        filtr (QuadForest or OctForest): The forest for the design vector
+        x (Vec): The design vector
+        index (int): The design variable component (negative for all)
+        cutoff (float): Cutoff to indicate the interface
+        dist (Vec): Vector with block size 1 for the signed distance (optional)
+
+    Returns:
+        np.ndarray: The minimum distance for each element
+    """
+    cdef int size = 0
+    cdef int fail = 0
+    cdef TMRQuadrantArray *quad_array = NULL
+    cdef TMROctantArray *oct_array = NULL
+    cdef TACSBVec *dist_ptr = NULL
+    cdef np.ndarray min_dist
+
+    if dist is not None:
+        dist_ptr = dist.getBVecPtr()
+
+    if isinstance(filtr, OctForest):
+        (<OctForest>filtr).ptr.getOctants(&oct_array)
+        oct_array.getArray(NULL, &size)
+        min_dist = np.zeros(size, dtype=np.double)
+        fail = TMRFastMarchingDistance((<OctForest>filtr).ptr, index, cutoff,
+                                       x.getBVecPtr(), dist_ptr,
+                                       <double*>min_dist.data)
+    elif isinstance(filtr, QuadForest):
+        (<QuadForest>filtr).ptr.getQuadrants(&quad_array)
+        quad_array.getArray(NULL, &size)
+        min_dist = np.zeros(size, dtype=np.double)
+        fail = TMRFastMarchingDistance((<QuadForest>filtr).ptr, index, cutoff,
+                                       x.getBVecPtr(), dist_ptr,
+                                       <double*>min_dist.data)
+    else:
+        return None
+
+    if fail:
+        errmsg = 'Failed to compute the distance, check the vector block size'
+        raise ValueError(errmsg)
+    return min_dist
+
 cdef void writeOutputCallback(void *func, const char *prefix, int iter,
                               TMROctForest *octforest, TMRQuadForest *quadforest,
                               TACSBVec *x) noexcept:
@@ -5867,6 +7928,44 @@ cdef class TopoProblem(ProblemBase):
         prob.setPrefix(prefix.c_str())
         return
 
+    def setUseMultiRHSSolve(self, flag=True):
+        """
+        setUseMultiRHSSolve(self, flag=True)
+
+        Solve the load cases together. The initial guess for each load
+        case is the combination of the load case solutions from the
+        previous iteration (and the load cases already solved) that
+        minimizes the residual.
+
+        Args:
+            flag (bool): Flag to use the multiple right-hand-side mode
+        """
+        cdef TMRTopoProblem *prob = NULL
+        prob = _dynamicTopoProblem(self.ptr)
+        if prob == NULL:
+            errmsg = 'Expected TMRTopoProblem got other type'
+            raise ValueError(errmsg)
+        prob.setUseMultiRHSSolve(flag)
+        return
+
+    def setUseWarmStart(self, flag=True):
+        """
+        setUseWarmStart(self, flag=True)
+
+        Use the state and adjoint solutions from the previous design
+        iteration as the initial guesses for the linear solves.
+
+        Args:
+            flag (bool): Flag to use warm-started solves
+        """
+        cdef TMRTopoProblem *prob = NULL
+        prob = _dynamicTopoProblem(self.ptr)
+        if prob == NULL:
+            errmsg = 'Expected TMRTopoProblem got other type'
+            raise ValueError(errmsg)
+        prob.setUseWarmStart(flag)
+        return
+
     def setIterationCounter(self, int count):
         """
         setIterationCounter(self, count)
@@ -5885,6 +7984,38 @@ cdef class TopoProblem(ProblemBase):
         prob.setIterationCounter(count)
         return
 
+    def setUseAsyncOutput(self, flag=True):
+        """
+        setUseAsyncOutput(self, flag=True)
+
+        Write the STL output files from a background thread on the root
+        processor while the optimization continues.
+
+        Args:
+            flag (bool): Flag to use asynchronous output
+        """
+        cdef TMRTopoProblem *prob = NULL
+        prob = _dynamicTopoProblem(self.ptr)
+        if prob == NULL:
+            errmsg = 'Expected TMRTopoProblem got other type'
+            raise ValueError(errmsg)
+        prob.setUseAsyncOutput(flag)
+        return
+
+    def waitForOutput(self):
+        """
+        waitForOutput(self)
+
+        Wait until any pending asynchronous output has been written.
+        """
+        cdef TMRTopoProblem *prob = NULL
+        prob = _dynamicTopoProblem(self.ptr)
+        if prob == NULL:
+            errmsg = 'Expected TMRTopoProblem got other type'
+            raise ValueError(errmsg)
+        prob.waitForOutput()
+        return
+
     def setInitDesignVars(self, PVec pvec, PVec lbvec=None, PVec ubvec=None):
         """
         setInitDesignVars(self, pvec, lbvec, ubvec)
@@ -31,13 +31,24 @@ class TMRCyQuadCreator : public TMRQuadTACSCreator {
  public:
   TMRCyQuadCreator(TMRBoundaryConditions *_bcs, int _design_vars_per_node = 1,
                    TMRQuadForest *_filter = NULL)
-      : TMRQuadTACSCreator(_bcs, _design_vars_per_node, _filter) {}
+      : TMRQuadTACSCreator(_bcs, _design_vars_per_node, _filter) {
+    self = NULL;
+    createquadelement = NULL;
+    createquadelements = NULL;
+  }
 
   void setSelfPointer(void *_self) { self = _self; }
   void setCreateQuadElement(TACSElement *(*func)(void *, int, TMRQuadrant *)) {
     createquadelement = func;
   }
 
+  // Set a callback that creates the elements for all quadrants at once.
+  // This takes precedence over the element-by-element callback.
+  void setCreateQuadElements(int (*func)(void *, int, int, TMRQuadrant *,
+                                         TACSElement **)) {
+    createquadelements = func;
+  }
+
   void createElements(int order, TMRQuadForest *forest, int num_elements,
                       TACSElement **elements) {
     // Get the array of quadrants
@@ -49,6 +60,12 @@ class TMRCyQuadCreator : public TMRQuadTACSCreator {
 
     // Set the element types into the matrix
     memset(elements, 0, num_elements * sizeof(TACSElement *));
+    if (createquadelements) {
+      if (createquadelements(self, order, num_elements, array, elements)) {
+        fprintf(stderr, "TMRCyQuadCreator error: Elements not created\n");
+      }
+      return;
+    }
     for (int i = 0; i < num_elements; i++) {
       TACSElement *elem = createquadelement(self, order, &array[i]);
       if (!elem) {
@@ -62,6 +79,7 @@ class TMRCyQuadCreator : public TMRQuadTACSCreator {
  private:
   void *self;
   TACSElement *(*createquadelement)(void *, int, TMRQuadrant *);
+  int (*createquadelements)(void *, int, int, TMRQuadrant *, TACSElement **);
 };
 
 /*
@@ -71,13 +89,24 @@ class TMRCyOctCreator : public TMROctTACSCreator {
  public:
   TMRCyOctCreator(TMRBoundaryConditions *_bcs, int _design_vars_per_node = 1,
                   TMROctForest *_filter = NULL)
-      : TMROctTACSCreator(_bcs, _design_vars_per_node, _filter) {}
+      : TMROctTACSCreator(_bcs, _design_vars_per_node, _filter) {
+    self = NULL;
+    createoctelement = NULL;
+    createoctelements = NULL;
+  }
 
   void setSelfPointer(void *_self) { self = _self; }
   void setCreateOctElement(TACSElement *(*func)(void *, int, TMROctant *)) {
     createoctelement = func;
   }
 
+  // Set a callback that creates the elements for all octants at once.
+  // This takes precedence over the element-by-element callback.
+  void setCreateOctElements(int (*func)(void *, int, int, TMROctant *,
+                                        TACSElement **)) {
+    createoctelements = func;
+  }
+
   void createElements(int order, TMROctForest *forest, int num_elements,
                       TACSElement **elements) {
     // Get the array of octants
@@ -89,6 +118,12 @@ class TMRCyOctCreator : public TMROctTACSCreator {
 
     // Set the element types into the matrix
     memset(elements, 0, num_elements * sizeof(TACSElement *));
+    if (createoctelements) {
+      if (createoctelements(self, order, num_elements, array, elements)) {
+        fprintf(stderr, "TMRCyOctCreator error: Elements not created\n");
+      }
+      return;
+    }
     for (int i = 0; i < num_elements; i++) {
       TACSElement *elem = createoctelement(self, order, &array[i]);
       if (!elem) {
@@ -102,6 +137,7 @@ class TMRCyOctCreator : public TMROctTACSCreator {
  private:
   void *self;
   TACSElement *(*createoctelement)(void *, int, TMROctant *);
+  int (*createoctelements)(void *, int, int, TMROctant *, TACSElement **);
 };
 
 /*
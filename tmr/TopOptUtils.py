@@ -1,3 +1,4 @@
+import threading
 from mpi4py import MPI
 from tacs import TACS, elements
 from tmr import TMR
@@ -24,6 +25,7 @@ def createTopoProblem(
     ordering=TACS.MULTICOLOR_ORDER,
     use_galerkin=False,
     scale_coordinate_factor=1.0,
+    forests=None,
 ):
     """
     Create a topology optimization problem instance and a hierarchy of meshes.
@@ -55,46 +57,26 @@ def createTopoProblem(
         ordering: TACS Assembler ordering type
         use_galerkin: Use Galerkin projection to obtain coarse grid operators
         scale_coordinate_factor (float): Scale all coordinates by this factor
+        forests (list): The hierarchy of forests from createForestHierarchy()
+                        or PipelinedRefine.finish(), if already created
 
     Returns:
         problem (TopoProblem): The allocated topology optimization problem
     """
 
     # Store data
-    forests = []
     filters = []
     assemblers = []
 
-    # Balance the forest and repartition across processors
-    forest.balance(1)
-    if repartition:
-        forest.repartition()
-
-    # Create the forest object
-    creator, filtr = callback(forest)
-    forests.append(forest)
-    filters.append(filtr)
-    assemblers.append(creator.createTACS(forest, ordering))
-
-    for i in range(nlevels - 1):
-        order = forests[-1].getMeshOrder()
-        interp = forests[-1].getInterpType()
-        if order > lowest_order:
-            forest = forests[-1].duplicate()
-            order = order - 1
-            forest.setMeshOrder(order, interp)
-        else:
-            forest = forests[-1].coarsen()
-            forest.setMeshOrder(order, interp)
-
-            # Balance and repartition if needed
-            forest.balance(1)
-            if repartition:
-                forest.repartition()
+    # Create the hierarchy of forests
+    if forests is None:
+        forests = createForestHierarchy(
+            forest, nlevels, repartition=repartition, lowest_order=lowest_order
+        )
 
-        # Create the forest object
+    # Create the filter and the assembler on each level
+    for forest in forests:
         creator, filtr = callback(forest)
-        forests.append(forest)
         filters.append(filtr)
         assemblers.append(creator.createTACS(forest, ordering))
 
@@ -128,6 +110,192 @@ def createTopoProblem(
     return problem
 
 
+def createForestHierarchy(forest, nlevels=2, repartition=True, lowest_order=2):
+    """
+    Create the hierarchy of forests used for the multigrid levels.
+
+    The input forest is balanced and repartitioned and forms the finest level.
+    Each coarser level either reduces the mesh order or coarsens the forest.
+    The nodes are created on each level. Only TMR calls that release the GIL
+    are used, so this may be run on a separate thread (see PipelinedRefine).
+
+    Args:
+        forest (OctForest or QuadForest): The forest on the finest level
+        nlevels (int): The number of levels
+        repartition (bool): Repartition the mesh
+        lowest_order (int): Lowest order mesh to create
+
+    Returns:
+        list: The forests ordered from the finest to the coarsest level
+    """
+
+    # Balance the forest and repartition across processors
+    forest.balance(1)
+    if repartition:
+        forest.repartition()
+    forest.createNodes()
+    forests = [forest]
+
+    for i in range(nlevels - 1):
+        order = forests[-1].getMeshOrder()
+        interp = forests[-1].getInterpType()
+        if order > lowest_order:
+            forest = forests[-1].duplicate()
+            order = order - 1
+            forest.setMeshOrder(order, interp)
+        else:
+            if isinstance(forests[-1], TMR.OctForest):
+                # The coarse forest inherits the balance of the fine forest
+                forest = forests[-1].coarsenBalanced(1)
+                forest.setMeshOrder(order, interp)
+            else:
+                forest = forests[-1].coarsen()
+                forest.setMeshOrder(order, interp)
+                forest.balance(1)
+
+            # Repartition if needed
+            if repartition:
+                forest.repartition()
+
+        forest.createNodes()
+        forests.append(forest)
+
+    return forests
+
+
+class PipelinedRefine:
+    """
+    Build the forest hierarchy for the next adaptation step on a helper thread
+    while the optimization continues.
+
+    The refinement is applied to a duplicate of the forest that uses a
+    duplicate of the communicator, so that the collective calls made on the
+    helper thread do not interfere with those made by the optimizer. The
+    helper thread only makes TMR calls that release the GIL, and it also
+    evaluates the node locations of each level, so that the geometry is not
+    evaluated on the main thread when the hierarchy is used. When the MPI
+    library does not provide MPI.THREAD_MULTIPLE, the hierarchy is built
+    when start() is called.
+
+    The refinement indicator is computed from a snapshot of the design:
+
+    pipe = PipelinedRefine(comm)
+    ...
+    refine = computeDensityRefinement(assembler)
+    pipe.start(forest, refine)
+    ... continue the optimization
+    forests = pipe.finish()
+    problem = createTopoProblem(forests[0], callback, filter_type,
+                                nlevels=len(forests), forests=forests)
+    ...
+    pipe.free()
+
+    Args:
+        comm (MPI.Comm): The communicator for the forests
+        nlevels (int): The number of levels
+        repartition (bool): Repartition the mesh
+        lowest_order (int): Lowest order mesh to create
+    """
+
+    def __init__(self, comm, nlevels=2, repartition=True, lowest_order=2):
+        self.comm = comm
+        self.helper_comm = comm.Dup()
+        self.nlevels = nlevels
+        self.repartition = repartition
+        self.lowest_order = lowest_order
+        self.use_thread = MPI.Query_thread() == MPI.THREAD_MULTIPLE
+        self.thread = None
+        self.forests = None
+        return
+
+    def free(self):
+        """
+        Wait for any hierarchy that is still being built, discard it and
+        free the duplicated communicator. This is collective on the
+        communicator. The object cannot be used afterwards.
+        """
+        if self.helper_comm is not None:
+            self.finish()
+            self.helper_comm.Free()
+            self.helper_comm = None
+        return
+
+    def start(self, forest, refine, min_lev=0, max_lev=TMR.MAX_LEVEL):
+        """
+        Start building the refined forest hierarchy. This is collective on
+        the communicator. Any hierarchy that is still being built is discarded.
+
+        Args:
+            forest (OctForest or QuadForest): The current analysis forest
+            refine (np.ndarray): The refinement indicator for each element
+            min_lev (int): Minimum refinement level
+            max_lev (int): Maximum refinement level
+        """
+        if self.helper_comm is None:
+            raise RuntimeError("PipelinedRefine: start() called after free()")
+        self.finish()
+
+        # The refinement is local, so it is applied on this thread
+        new_forest = forest.duplicate()
+        new_forest.setMPIComm(self.helper_comm)
+        new_forest.refine(refine, min_lev=min_lev, max_lev=max_lev)
+
+        if self.use_thread:
+            self.thread = threading.Thread(target=self._build, args=(new_forest,))
+            self.thread.start()
+        else:
+            self._build(new_forest)
+
+        return
+
+    def _build(self, forest):
+        forests = createForestHierarchy(
+            forest,
+            self.nlevels,
+            repartition=self.repartition,
+            lowest_order=self.lowest_order,
+        )
+
+        # createNodes() defers the evaluation of the node locations until
+        # they are first requested. Request them here so that the geometry
+        # is evaluated on this thread, and not by createTACS() after finish().
+        for f in forests:
+            f.getPointsView()
+
+        self.forests = forests
+        return
+
+    def isActive(self):
+        """
+        Check whether a hierarchy has been started and not yet retrieved
+
+        Returns:
+            bool: True if start() has been called since the last finish()
+        """
+        return self.thread is not None or self.forests is not None
+
+    def finish(self):
+        """
+        Wait for the hierarchy to be completed and return it. The forests are
+        returned to the original communicator. This is collective on the
+        communicator.
+
+        Returns:
+            list: The forests from the finest to the coarsest level, or None
+        """
+        if self.thread is not None:
+            self.thread.join()
+            self.thread = None
+
+        forests = self.forests
+        self.forests = None
+        if forests is not None:
+            for forest in forests:
+                forest.setMPIComm(self.comm)
+
+        return forests
+
+
 def computeVertexLoad(name, forest, assembler, point_force):
     """
     Add a load at vertices with the given name value. The assembler object must
@@ -267,18 +435,22 @@ def compute3DTractionLoad(name, forest, assembler, tr):
     return computeTractionLoad(name, forest, assembler, trac)
 
 
-def interpolateDesignVec(orig_filter, orig_vec, new_filter, new_vec):
+def interpolateDesignVec(orig_filter, orig_vec, new_filter, new_vec, nested=True):
     """
     This function interpolates a design vector from the original design space defined
     on an OctForest or QuadForest and interpolates it to a new OctForest or QuadForest.
 
     This function is used after a mesh adaptation step to get the new design space.
+    When the forests are not related by refinement, for instance after a restart
+    with a different topology, set nested=False to locate the new nodes within the
+    elements of the original filter instead.
 
     Args:
         orig_filter (OctForest or QuadForest): Original filter Oct or QuadForest object
         orig_vec (PVec): Design variables on the original mesh in a ParOpt.PVec
         new_filter (OctForest or QuadForest): New filter Oct or QuadForest object
         new_vec (PVec): Design variables on the new mesh in a ParOpt.PVec (set on ouput)
+        nested (bool): Whether the new filter is a refinement of the original filter
     """
 
     # Convert the PVec class to TACSBVec
@@ -298,7 +470,13 @@ def interpolateDesignVec(orig_filter, orig_vec, new_filter, new_vec):
 
     # Create the interpolation class
     interp = TACS.VecInterp(orig_map, new_map, vars_per_node)
-    new_filter.createInterpolation(orig_filter, interp)
+    if nested:
+        new_filter.createInterpolation(orig_filter, interp)
+    else:
+        locator = TMR.ElementLocator(orig_filter)
+        fail = locator.createInterpolation(new_filter, interp)
+        if fail:
+            raise ValueError("%d nodes of the new filter were not located" % (fail))
     interp.initialize()
 
     # Perform the interpolation
@@ -425,6 +603,33 @@ def densityBasedRefine(
         max_lev (int): Maximum refinement level
     """
 
+    # Compute the refinement array
+    refine = computeDensityRefinement(
+        assembler, index=index, lower=lower, upper=upper, reverse=reverse
+    )
+
+    # Refine the forest
+    forest.refine(refine, min_lev=min_lev, max_lev=max_lev)
+
+    return
+
+
+def computeDensityRefinement(assembler, index=0, lower=0.05, upper=0.5, reverse=False):
+    """
+    Compute the density-based refinement indicator used by densityBasedRefine()
+    without modifying the forest. This is local to each processor.
+
+    Args:
+        assembler (Assembler): The TACS.Assembler object associated with forest
+        index (int): The component index of the design vector used to indicate material
+        lower (float): the lower limit used for coarsening
+        upper (float): the upper limit used for refinement
+        reverse (bool): Reverse the refinement scheme
+
+    Returns:
+        np.ndarray: The refinement indicator for each element
+    """
+
     # Create refinement array
     num_elems = assembler.getNumElements()
     refine = np.zeros(num_elems, dtype=np.int32)
@@ -451,10 +656,7 @@ def densityBasedRefine(
             elif value <= lower:
                 refine[i] = -1
 
-    # Refine the forest
-    forest.refine(refine, min_lev=min_lev, max_lev=max_lev)
-
-    return
+    return refine
 
 
 def approxDistanceRefine(
@@ -469,6 +671,7 @@ def approxDistanceRefine(
     filename=None,
     min_lev=0,
     max_lev=TMR.MAX_LEVEL,
+    use_fast_marching=False,
 ):
     """
     Apply a distance-based refinement criteria.
@@ -498,6 +701,7 @@ def approxDistanceRefine(
         cutoff (float): Cutoff to indicate structural interface
         min_lev (int): Minimum refinement level
         max_lev (int): Maximum refinement level
+        use_fast_marching (bool): Compute the distance with the fast marching method
     """
 
     # Set up and solve for an approximate level set function
@@ -505,25 +709,21 @@ def approxDistanceRefine(
     assembler.getDesignVars(x)
 
     # Approximate the distance to the boundary
-    dist = TMR.ApproximateDistance(
-        fltr,
-        x,
-        index=index,
-        cutoff=cutoff,
-        t=tfactor * domain_length,
-        filename=filename,
-    )
+    if use_fast_marching:
+        dist = TMR.FastMarchingDistance(fltr, x, index=index, cutoff=cutoff)
+    else:
+        dist = TMR.ApproximateDistance(
+            fltr,
+            x,
+            index=index,
+            cutoff=cutoff,
+            t=tfactor * domain_length,
+            filename=filename,
+        )
 
     # Create refinement array
     num_elems = assembler.getNumElements()
-    refine = np.zeros(num_elems, dtype=np.int32)
-
-    for i in range(num_elems):
-        # Apply the refinement criteria
-        if dist[i] <= refine_distance:
-            refine[i] = 1
-        else:
-            refine[i] = -1
+    refine = np.where(dist[:num_elems] <= refine_distance, 1, -1).astype(np.int32)
 
     # Refine the forest
     forest.refine(refine, min_lev=min_lev, max_lev=max_lev)
@@ -547,6 +747,7 @@ def targetRefine(
     filename=None,
     min_lev=0,
     max_lev=TMR.MAX_LEVEL,
+    use_fast_marching=False,
 ):
     """
     Apply a target-based refinement strategy.
@@ -576,6 +777,7 @@ def targetRefine(
         filename (str): File name for the approximate distance calculation
         min_lev (int): Minimum refinement level
         max_lev (int): Maximum refinement level
+        use_fast_marching (bool): Compute the distance with the fast marching method
     """
 
     # Set up and solve for an approximate level set function
@@ -583,14 +785,17 @@ def targetRefine(
     assembler.getDesignVars(x)
 
     # Approximate the distance to the boundary
-    dist = TMR.ApproximateDistance(
-        fltr,
-        x,
-        index=interface_index,
-        cutoff=cutoff,
-        t=tfactor * domain_length,
-        filename=filename,
-    )
+    if use_fast_marching:
+        dist = TMR.FastMarchingDistance(fltr, x, index=interface_index, cutoff=cutoff)
+    else:
+        dist = TMR.ApproximateDistance(
+            fltr,
+            x,
+            index=interface_index,
+            cutoff=cutoff,
+            t=tfactor * domain_length,
+            filename=filename,
+        )
 
     # Create refinement array
     num_elems = assembler.getNumElements()
@@ -598,15 +803,9 @@ def targetRefine(
 
     # Compute the levels
     if isinstance(forest, TMR.OctForest):
-        octants = forest.getOctants()
-        lev = np.zeros(len(octants))
-        for i, oc in enumerate(octants):
-            lev[i] = oc.level
+        lev = forest.getOctantsView()["level"].astype(np.int32)
     elif isinstance(forest, TMR.QuadForest):
-        quads = forest.getQuadrants()
-        lev = np.zeros(len(quads))
-        for i, quad in enumerate(quads):
-            lev[i] = quad.level
+        lev = forest.getQuadrantsView()["level"].astype(np.int32)
 
     # Get the elements from the Assembler object
     elems = assembler.getElements()
@@ -80,6 +80,35 @@ cdef extern from "TMRBase.h":
         TMR_GAUSS_LOBATTO_POINTS
         TMR_BERNSTEIN_POINTS
 
+    enum TMRProfilePhase:
+        TMR_PROFILE_BALANCE
+        TMR_PROFILE_REPARTITION
+        TMR_PROFILE_CREATE_NODES
+        TMR_PROFILE_CREATE_INTERPOLATION
+        TMR_PROFILE_MESH
+
+    cdef cppclass TMRProfileData:
+        int num_calls
+        double time
+        long num_messages
+        long num_bytes
+        long peak_size
+        long num_octants
+
+    cdef cppclass TMRMemoryUsage:
+        long octants
+        long nodes
+        long conn
+        long dep_nodes
+        long points
+        long hash
+        long other
+        long getTotal()
+
+    int TMRIsProfilingEnabled()
+    int TMRGetProfileData(TMRProfilePhase, TMRProfileData*)
+    void TMRResetProfileData()
+
 cdef extern from "TMRTopology.h":
     cdef cppclass TMRTopology(TMREntity):
         TMRTopology(MPI_Comm, TMRModel*)
@@ -120,6 +149,8 @@ cdef extern from "TMRTopology.h":
         TMRFace(int)
         void getRange(double*, double*, double*, double*)
         int evalPoint(double, double, TMRPoint*)
+        int evalPoints(int, const double*, TMRPoint*)
+        int invEvalPoints(int, const TMRPoint*, double*)
         void setSource(TMRVolume*, TMRFace*)
         void getSource(TMRVolume**, TMRFace**)
         int getNumEdgeLoops()
@@ -240,6 +271,7 @@ cdef extern from "TMRFeatureSize.h":
         TMRElementFeatureSize()
         TMRElementFeatureSize(double)
         double getFeatureSize(TMRPoint)
+        void getFeatureSizes(int, const TMRPoint*, double*)
 
     cdef cppclass TMRLinearElementSize(TMRElementFeatureSize):
         TMRLinearElementSize(double, double,
@@ -250,28 +282,36 @@ cdef extern from "TMRFeatureSize.h":
         void addBox(TMRPoint, TMRPoint, double)
 
     cdef cppclass TMRPointFeatureSize(TMRElementFeatureSize):
-        TMRPointFeatureSize(int, TMRPoint*, double*, double, double, int)
+        TMRPointFeatureSize(int, TMRPoint*, double*, double, double, int, int)
 
     cdef cppclass TMRPointLocator(TMREntity):
-        TMRPointLocator(int, TMRPoint*)
+        TMRPointLocator(int, TMRPoint*, int)
         void locateClosest(int, TMRPoint, int*, int*, double*)
+        void locateClosest(int, int, const TMRPoint*, int*, int*, double*)
+
+    cdef cppclass TMRGridFeatureSize(TMRElementFeatureSize):
+        TMRGridFeatureSize(TMRPoint, TMRPoint, int, int, int,
+                           TMRElementFeatureSize*, double, double)
+        int writeToFile(const char*)
+        @staticmethod
+        TMRGridFeatureSize* createFromFile(const char*)
 
 cdef extern from "TMREdgeMesh.h":
     cdef cppclass TMREdgeMesh(TMREntity):
         TMREdgeMesh(MPI_Comm, TMREdge*, TMRPoint*, int)
-        void mesh(TMRMeshOptions, TMRElementFeatureSize*)
+        void mesh(TMRMeshOptions, TMRElementFeatureSize*) nogil
         void writeToVTK(const char*)
 
 cdef extern from "TMRFaceMesh.h":
     cdef cppclass TMRFaceMesh(TMREntity):
         TMRFaceMesh(MPI_Comm, TMRFace*, TMRPoint*, int, int*, int)
-        void mesh(TMRMeshOptions, TMRElementFeatureSize*)
+        void mesh(TMRMeshOptions, TMRElementFeatureSize*) nogil
         void writeToVTK(const char*)
 
 cdef extern from "TMRVolumeMesh.h":
     cdef cppclass TMRVolumeMesh(TMREntity):
         TMRVolumeMesh(MPI_Comm, TMRVolume*)
-        void mesh(TMRMeshOptions)
+        void mesh(TMRMeshOptions) nogil
         void writeToVTK(const char*)
 
 cdef extern from "TMRMesh.h":
@@ -281,19 +321,33 @@ cdef extern from "TMRMesh.h":
         TMR_UNSTRUCTURED
         TMR_TRIANGLE
 
+    enum TMRFaceMeshDistribution:
+        TMR_NO_DISTRIBUTION
+        TMR_STATIC_DISTRIBUTION
+        TMR_COST_DISTRIBUTION
+
+    enum TMRMeshNodeOrdering:
+        TMR_NATURAL_ORDER
+        TMR_RCM_ORDER
+
     cdef cppclass TMRMesh(TMREntity):
         TMRMesh(MPI_Comm, TMRModel*)
-        void mesh(TMRMeshOptions, double)
-        void mesh(TMRMeshOptions, TMRElementFeatureSize*)
+        void mesh(TMRMeshOptions, double) nogil
+        void mesh(TMRMeshOptions, TMRElementFeatureSize*) nogil
         int getMeshPoints(TMRPoint**)
         int getQuadConnectivity(int*, const int**)
         int getTriConnectivity(int*, const int**)
         int getHexConnectivity(int*, const int**)
         int getTetConnectivity(int*, const int**)
+        int computeMeshQuality(int, int, int*, double*)
+        void getMemoryUsage(TMRMemoryUsage*)
+        int getOctForestConnectivity(int*, int*, int*, int**, int**, int**)
+        int getQuadForestConnectivity(int*, int*, int**, int**)
 
         TMRModel *createModelFromMesh()
         void writeToVTK(const char*, int)
-        void writeToBDF(const char*, int, TMRBoundaryConditions*)
+        int writeToVTU(const char*, int, int)
+        void writeToBDF(const char*, int, TMRBoundaryConditions*, int)
 
     cdef cppclass TMRMeshOptions:
         TMRMeshOptions()
@@ -302,8 +356,17 @@ cdef extern from "TMRMesh.h":
         int triangularize_print_iter
         int write_mesh_quality_histogram
         int num_smoothing_steps
+        double smoothing_tolerance
         double frontal_quality_factor
+        int num_frontal_subdomains
+        int frontal_subdomain_min_triangles
+        int greedy_recombine_min_triangles
+        double greedy_recombine_tolerance
         int reset_mesh_objects
+        TMRFaceMeshDistribution face_mesh_distribution
+        int num_threads
+        TMRMeshNodeOrdering node_ordering
+        char mesh_cache_dir[256]
         int write_init_domain_triangle
         int write_triangularize_intermediate
         int write_pre_smooth_triangle
@@ -321,6 +384,8 @@ cdef extern from "TMRQuadrant.h":
         void edgeNeighbor(int, TMRQuadrant*)
         void cornerNeighbor(int, TMRQuadrant*)
         int contains(TMRQuadrant*)
+        int compare(TMRQuadrant*)
+        int compareNode(TMRQuadrant*)
         int32_t face
         int32_t x
         int32_t y
@@ -335,22 +400,34 @@ cdef extern from "TMRQuadrant.h":
         void sort()
         TMRQuadrant* contains(TMRQuadrant *q, int)
 
+    cdef cppclass TMRQuadrantHash:
+        TMRQuadrantHash(int)
+        TMRQuadrantArray* toArray()
+        int addQuadrant(TMRQuadrant*)
+
 cdef extern from "TMRQuadForest.h":
     cdef cppclass TMRQuadForest(TMREntity):
         TMRQuadForest(MPI_Comm, int, TMRInterpolationType)
         MPI_Comm getMPIComm()
+        int setMPIComm(MPI_Comm)
         void setTopology(TMRTopology*)
         TMRTopology* getTopology()
         void setConnectivity(int, const int*, int)
-        void setFullConnectivity(int, int, int, const int*, const int*)
-        void repartition()
+        void setFullConnectivity(int, int, int, const int*, const int*,
+                                 const TMRPoint*)
+        void repartition(const double*) nogil
+        void alignPartition(TMRQuadForest*) nogil
+        void setPartitionTolerance(double)
         void createTrees(int)
         void createRandomTrees(int, int, int)
         void refine(int*, int, int)
+        void refineToLevels(int*, int)
         TMRQuadForest *duplicate()
-        TMRQuadForest *coarsen()
-        void balance(int)
-        void createNodes()
+        TMRQuadForest *coarsen() nogil
+        void balance(int) nogil
+        void setNumThreads(int)
+        int getNumThreads()
+        void createNodes() nogil
         int getMeshOrder()
         TMRInterpolationType getInterpType()
         void setMeshOrder(int, TMRInterpolationType)
@@ -358,14 +435,26 @@ cdef extern from "TMRQuadForest.h":
         int getDepNodeConn(const int**, const int**, const double**)
         TMRQuadrantArray* getQuadsWithName(const char*)
         int getNodesWithName(const char*, int**)
-        void createInterpolation(TMRQuadForest*, TACSBVecInterp*)
+        void createInterpolation(TMRQuadForest*, TACSBVecInterp*) nogil
+        void setCacheInterpolation(int)
+        int getCacheInterpolation()
         int getOwnedNodeRange(const int**)
         void getQuadrants(TMRQuadrantArray**)
-        int getPoints(TMRPoint**)
+        int getNodeNumbers(const int**)
+        int getPoints(TMRPoint**) nogil
+        int getPointComponents(const double**, const double**,
+                               const double**) nogil
         int getLocalNodeNumber(int);
         int getExtPreOffset()
         void writeToVTK(const char*)
         void writeForestToVTK(const char*)
+        int writeForestToVTU(const char*, int)
+        int writeForestToFile(const char*)
+        int readForestFromFile(const char*)
+        int computeMeshQuality(int, int*, double*)
+        void getMemoryUsage(TMRMemoryUsage*)
+        void getMaxMemoryUsage(TMRMemoryUsage*)
+        void resetMaxMemoryUsage()
 
 cdef extern from "TMROctant.h":
     cdef cppclass TMROctant:
@@ -376,6 +465,8 @@ cdef extern from "TMROctant.h":
         void cornerNeighbor(int, TMROctant*)
         void faceNeighbor(int, TMROctant)
         int contains(TMROctant*)
+        int compare(TMROctant*)
+        int compareNode(TMROctant*)
         int32_t block
         int32_t x
         int32_t y
@@ -391,36 +482,79 @@ cdef extern from "TMROctant.h":
         void sort()
         TMROctant* contains(TMROctant*, int)
 
+    cdef cppclass TMROctantHash:
+        TMROctantHash(int)
+        TMROctantArray* toArray()
+        int addOctant(TMROctant*)
+
 cdef extern from "TMROctForest.h":
     cdef cppclass TMROctForest(TMREntity):
         TMROctForest(MPI_Comm, int, TMRInterpolationType)
         MPI_Comm getMPIComm()
+        int setMPIComm(MPI_Comm)
         void setTopology(TMRTopology*)
         TMRTopology* getTopology()
         void setConnectivity(int, const int*, int)
-        void setFullConnectivity(int, int, int, const int*, const int*)
-        void repartition(int)
+        void setFullConnectivity(int, int, int, int, const int*, const int*,
+                                 const int*, const TMRPoint*)
+        void repartition(int, const double*) nogil
+        void alignPartition(TMROctForest*) nogil
+        void setPartitionTolerance(double)
         void createTrees(int)
         void createRandomTrees(int, int, int)
         void refine(int*, int, int)
+        void refineToLevels(int*, int)
         TMROctForest *duplicate()
-        TMROctForest *coarsen()
-        void balance(int)
-        void createNodes()
+        TMROctForest *coarsen() nogil
+        TMROctForest *coarsenBalanced(int) nogil
+        void balance(int) nogil
+        void setNumThreads(int)
+        int getNumThreads()
+        void setIncrementalNodes(int)
+        int getIncrementalNodes()
+        void setUseSharedMemory(int)
+        int getUseSharedMemory()
+        void setUseSharedConnectivity(int)
+        int getUseSharedConnectivity()
+        void createNodes() nogil
         int getMeshOrder()
         TMRInterpolationType getInterpType()
         void setMeshOrder(int, TMRInterpolationType)
+        void setElementOrders(const int*)
+        int getElementOrders(const int**)
         void getNodeConn(const int**, int*)
         int getDepNodeConn(const int**, const int**, const double**)
         TMROctantArray* getOctsWithName(const char*)
         int getNodesWithName(const char*, int**)
-        void createInterpolation(TMROctForest*, TACSBVecInterp*)
+        void createInterpolation(TMROctForest*, TACSBVecInterp*) nogil
+        void setCacheInterpolation(int)
+        int getCacheInterpolation()
         int getOwnedNodeRange(const int**)
         void getOctants(TMROctantArray**)
-        int getPoints(TMRPoint**)
+        int getNodeNumbers(const int**)
+        int getOctantNeighbors(const int**, const int**, TMROctantArray**)
+        int getGhostOctants(int, TMROctantArray**, const int**, const int**)
+        int getPoints(TMRPoint**) nogil
+        int getPointComponents(const double**, const double**,
+                               const double**) nogil
         int getExtPreOffset()
         void writeToVTK(const char*)
         void writeForestToVTK(const char*)
+        int writeForestToVTU(const char*, int)
+        int writeForestToFile(const char*)
+        int readForestFromFile(const char*)
+        int computeMeshQuality(int, int*, double*)
+        void getMemoryUsage(TMRMemoryUsage*)
+        void getMaxMemoryUsage(TMRMemoryUsage*)
+        void resetMaxMemoryUsage()
+
+cdef extern from "TMRElementLocator.h":
+    cdef cppclass TMRElementLocator(TMREntity):
+        TMRElementLocator(TMROctForest*, double)
+        TMRElementLocator(TMRQuadForest*, double)
+        int locatePoints(int, const TMRPoint*, int*, int*, double*) nogil
+        int createInterpolation(TMROctForest*, TACSBVecInterp*) nogil
+        int createInterpolation(TMRQuadForest*, TACSBVecInterp*) nogil
 
 cdef extern from "TMRBoundaryConditions.h":
     cdef cppclass TMRBoundaryConditions(TMREntity):
@@ -437,18 +571,28 @@ cdef extern from "TMR_TACSCreator.h":
     cdef cppclass TMROctTACSCreator(TMREntity):
         TMROctTACSCreator(TMRBoundaryConditions*, int, TMROctForest*)
         TMROctForest* getFilter()
+        void setUseCache(int)
+        void clearCache()
 
 cdef extern from "TMROpenCascade.h":
-    cdef void TMR_SewModelIGES(char *, const char *, int, double, bool)
-    cdef void TMR_SewModelSTEP(char *, const char *, int, double, bool)
-    cdef TMRModel* TMR_LoadModelFromIGESFile(const char*, const char*, int)
-    cdef TMRModel* TMR_LoadModelFromSTEPFile(const char*, const char*, int)
+    cdef void TMR_SewModelIGES(char *, const char *, int, double, bool) nogil
+    cdef void TMR_SewModelSTEP(char *, const char *, int, double, bool) nogil
+    cdef TMRModel* TMR_LoadModelFromIGESFile(const char*, const char*,
+                                             int, int) nogil
+    cdef TMRModel* TMR_LoadModelFromSTEPFile(const char*, const char*,
+                                             int, int) nogil
+    cdef TMRModel* TMR_LoadModelFromSTEPFile(MPI_Comm, const char*, const char*,
+                                             double, const char*, int,
+                                             int) nogil
 
 cdef extern from "TMREgads.h" namespace "TMR_EgadsInterface":
-    cdef TMRModel* TMR_ConvertEGADSModel"TMR_EgadsInterface::TMR_ConvertEGADSModel"(ego, int)
-    cdef TMRModel* TMR_LoadModelFromEGADSFile"TMR_EgadsInterface::TMR_LoadModelFromEGADSFile"(const char*, const char*, int)
+    cdef TMRModel* TMR_ConvertEGADSModel"TMR_EgadsInterface::TMR_ConvertEGADSModel"(ego, int, int)
+    cdef TMRModel* TMR_LoadModelFromEGADSFile"TMR_EgadsInterface::TMR_LoadModelFromEGADSFile"(const char*, const char*, int, int) nogil
 
 cdef extern from "TMR_RefinementTools.h":
+    double TMR_ComputeErrorThreshold(MPI_Comm, const double*, int, int, int)
+    int TMR_ComputeRefinementArray(MPI_Comm, const double*, int, int, int,
+                                   double, double, int*, double*, double*)
     void TMR_CreateTACSMg(int, TACSAssembler**,
                           TMRQuadForest**, TACSMg**, double, int, int, int)
     void TMR_ComputeInterpSolution(TMRQuadForest*, TACSAssembler*,
@@ -478,10 +622,19 @@ cdef extern from "TMR_RefinementTools.h":
     double TMR_AdjointErrorEst(TMROctForest*, TACSAssembler*,
                                TMROctForest*, TACSAssembler*,
                                TACSBVec*, TACSBVec*, double*, double*)
+    double TMR_StrainEnergyErrorEst(TMROctForest*, TACSAssembler*,
+                                    TMROctTACSCreator*, double*)
+    double TMR_AdjointErrorEst(TMROctForest*, TACSAssembler*,
+                               TMROctTACSCreator*, TACSBVec*, TACSBVec*,
+                               double*, double*)
 
 cdef extern from "TMRCyCreator.h":
     ctypedef TACSElement* (*createquadelements)(void*, int, TMRQuadrant*)
     ctypedef TACSElement* (*createoctelements)(void*, int, TMROctant*)
+    ctypedef int (*createquadelementbatch)(
+        void*, int, int, TMRQuadrant*, TACSElement**)
+    ctypedef int (*createoctelementbatch)(
+        void*, int, int, TMROctant*, TACSElement**)
     ctypedef TACSElement* (*createquadtopoelements)(
         void*, int, TMRQuadrant*, int, TMRIndexWeight*)
     ctypedef TACSElement* (*createocttopoelements)(
@@ -492,14 +645,18 @@ cdef extern from "TMRCyCreator.h":
         void setSelfPointer(void*)
         void setCreateQuadElement(
             TACSElement* (*createquadelements)(void*, int, TMRQuadrant*))
-        TACSAssembler *createTACS(TMRQuadForest*, OrderingType, int, const char**)
+        void setCreateQuadElements(createquadelementbatch)
+        TACSAssembler *createTACS(TMRQuadForest*, OrderingType, int,
+                                  const char**) nogil
 
     cdef cppclass TMRCyOctCreator(TMROctTACSCreator):
         TMRCyOctCreator(TMRBoundaryConditions*, int, TMROctForest*)
         void setSelfPointer(void*)
         void setCreateOctElement(
             TACSElement* (*createoctelements)(void*, int, TMROctant*))
-        TACSAssembler *createTACS(TMROctForest*, OrderingType, int, const char**)
+        void setCreateOctElements(createoctelementbatch)
+        TACSAssembler *createTACS(TMROctForest*, OrderingType, int,
+                                  const char**) nogil
 
     cdef cppclass TMRCyTopoQuadCreator(TMRQuadTACSCreator):
         TMRCyTopoQuadCreator(TMRBoundaryConditions*, int, TMRQuadForest*)
@@ -507,7 +664,7 @@ cdef extern from "TMRCyCreator.h":
         void setCreateQuadTopoElement(
             TACSElement* (*createquadtopoelements)(
                 void*, int, TMRQuadrant*, int, TMRIndexWeight*))
-        TACSAssembler *createTACS(TMRQuadForest*, OrderingType)
+        TACSAssembler *createTACS(TMRQuadForest*, OrderingType) nogil
 
     cdef cppclass TMRCyTopoOctCreator(TMROctTACSCreator):
         TMRCyTopoOctCreator(TMRBoundaryConditions*, int, TMROctForest*)
@@ -515,7 +672,7 @@ cdef extern from "TMRCyCreator.h":
         void setCreateOctTopoElement(
             TACSElement* (*createocttopoelements)(
                 void*, int, TMROctant*, int, TMRIndexWeight*))
-        TACSAssembler *createTACS(TMROctForest*, OrderingType)
+        TACSAssembler *createTACS(TMROctForest*, OrderingType) nogil
 
     cdef cppclass TMRCyTopoQuadConformCreator(TMRQuadTACSCreator):
        TMRCyTopoQuadConformCreator(TMRBoundaryConditions*, int, TMRQuadForest*,
@@ -524,7 +681,7 @@ cdef extern from "TMRCyCreator.h":
        void setCreateQuadTopoElement(
           TACSElement* (*createquadtopoelements)(
              void*, int, TMRQuadrant*, int, const int*, TMRQuadForest*))
-       TACSAssembler *createTACS(TMRQuadForest*, OrderingType)
+       TACSAssembler *createTACS(TMRQuadForest*, OrderingType) nogil
 
     cdef cppclass TMRCyTopoOctConformCreator(TMROctTACSCreator):
         TMRCyTopoOctConformCreator(TMRBoundaryConditions*, int, TMROctForest*,
@@ -533,13 +690,14 @@ cdef extern from "TMRCyCreator.h":
         void setCreateOctTopoElement(
             TACSElement* (*createocttopoelements)(
                 void*, int, TMROctant*, int, const int*, TMROctForest*))
-        TACSAssembler *createTACS(TMROctForest*, OrderingType)
+        TACSAssembler *createTACS(TMROctForest*, OrderingType) nogil
 
 cdef extern from "TMRTopoFilter.h":
     cdef cppclass TMRTopoFilter(TMREntity):
         TACSAssembler* getAssembler()
         TMRQuadForest* getFilterQuadForest()
         TMROctForest* getFilterOctForest()
+        void getMemoryUsage(TMRMemoryUsage*)
         void setDesignVars(TACSBVec*)
         void getDesignVars(TACSBVec*)
         void addValues(TACSBVec*)
@@ -565,6 +723,7 @@ cdef extern from "TMRMatrixFilter.h":
     cdef cppclass TMRMatrixFilter(TMRTopoFilter):
         TMRMatrixFilter(double, int, int, TACSAssembler**, TMROctForest**)
         TMRMatrixFilter(double, int, int, TACSAssembler**, TMRQuadForest**)
+        void setUseSinglePrecision(int)
 
 cdef extern from "TMROctConstitutive.h":
     cdef enum TMRTopoPenaltyType:
@@ -589,6 +748,7 @@ cdef extern from "TMROctConstitutive.h":
         double beta
         double xoffset
         int use_project
+        double active_material_tol
 
     cdef cppclass TMROctConstitutive(TACSSolidConstitutive):
         TMROctConstitutive(TMRStiffnessProperties*, TMROctForest*)
@@ -609,10 +769,19 @@ cdef extern from "TMRHelmholtzPUFilter.h":
         TMRCallbackHelmholtzPUFilter(int, int, TACSAssembler**,
                                      TMRQuadForest**)
         void initialize()
+        void setUseStencilCache(int)
+        void setUseSinglePrecision(int)
         void setSelfPointer(void*)
         void setGetInteriorStencil(getinteriorstencil)
         void setGetBoundaryStencil(getboundarystencil)
 
+    cdef cppclass TMRMFilter(TMRTopoFilter):
+        TMRMFilter(int, int, TACSAssembler**, TMROctForest**, double)
+        TMRMFilter(int, int, TACSAssembler**, TMRQuadForest**, double)
+        void initialize()
+        void setUseStencilCache(int)
+        void setUseSinglePrecision(int)
+
 cdef extern from "TMRTopoProblem.h":
     ctypedef void (*writeoutputcallback)(void*, const char*, int,
                                          TMROctForest*, TMRQuadForest*,
@@ -637,6 +806,8 @@ cdef extern from "TMRTopoProblem.h":
         TACSMg* getMg()
         void setLoadCases(TACSBVec**, int)
         int getNumLoadCases()
+        void setUseMultiRHSSolve(int)
+        void setUseWarmStart(int)
         void addConstraints(int, TACSFunction**,
                             const TacsScalar*, const TacsScalar*, int)
         void addLinearConstraints(ParOptVec**, TacsScalar*, int)
@@ -667,6 +838,8 @@ cdef extern from "TMRTopoProblem.h":
         void setPrefix(const char*)
         void setInitDesignVars(ParOptVec*,ParOptVec*,ParOptVec*)
         void setIterationCounter(int)
+        void setUseAsyncOutput(int)
+        void waitForOutput()
         ParOptVec* createDesignVec()
         void setF5OutputFlags(int, ElementType, int)
         void setF5EigenOutputFlags(int, ElementType, int)
@@ -686,6 +859,12 @@ cdef extern from "TMRTopoProblem.h":
 cdef extern from "TMR_STLTools.h":
     int TMR_GenerateBinFile(const char*, TMROctForest*,
                             TACSBVec*, int, double)
+    int TMR_WriteSTLFile(const char*, TMROctForest*,
+                         TACSBVec*, int, double)
+    int TMR_WriteIndexedBinFile(const char*, TMROctForest*,
+                                TACSBVec*, int, double)
+    int TMR_WritePLYFile(const char*, TMROctForest*,
+                         TACSBVec*, int, double)
     int TMR_GenerateSTLTriangles(int, TMROctForest*, TACSBVec*,
                                  int, double, int*, TMR_STLTriangle**)
 
@@ -694,3 +873,7 @@ cdef extern from "TMRApproximateDistance.h":
                                 TACSBVec*, const char*, double*)
     void TMRApproximateDistance(TMROctForest*, int, double, double,
                                 TACSBVec*, const char*, double*)
+    int TMRFastMarchingDistance(TMRQuadForest*, int, double,
+                                TACSBVec*, TACSBVec*, double*)
+    int TMRFastMarchingDistance(TMROctForest*, int, double,
+                                TACSBVec*, TACSBVec*, double*)
@@ -747,34 +747,33 @@ class pyTACSAdapt(BaseUI):
         """
         # get the total number of elements
         nelems = len(element_errors)
-        elem_counts = self.comm.allgather(nelems)
-        nelems_tot = sum(elem_counts)
+        nelems_tot = self.comm.allreduce(nelems, op=MPI.SUM)
 
         # choose elements based on an equidistributed target error
         target_error = self.error_tol / nelems_tot
-        error_ratio = element_errors / target_error
         refine_threshold = max(
             1.0, 2.0 ** (self.num_decrease_iters - self.coarse.refine_iter)
         )
 
         # record the refinement threshold:error_ratio pair for this iteration
-        error_ratio_tot = np.zeros(nelems_tot)
-        self.comm.Allgatherv(error_ratio, [error_ratio_tot, elem_counts])
         self.adaptation_history["threshold"][
             f"refine_{self.coarse.refine_iter}"
         ] = refine_threshold
         self.adaptation_history["element_errors"][
             f"adapt_iter_{self.coarse.refine_iter}"
-        ] = error_ratio_tot
+        ] = self._gatherErrorRatio(element_errors, target_error)
 
         # get the refinement indicator array
-        adapt_indicator = np.array(error_ratio >= refine_threshold, dtype=int)
-        nref = np.count_nonzero(adapt_indicator)
-        nref = self.comm.allreduce(nref, op=MPI.SUM)
+        adapt_indicator, nref, _, _ = TMR.computeRefinementArray(
+            self.comm,
+            np.ascontiguousarray(element_errors, dtype=float),
+            nelems_tot,
+            refine_cutoff=refine_threshold * target_error,
+        )
 
         # adapt the coarse-space model
         self.coarse.applyRefinement(
-            adapt_indicator.astype(np.intc),
+            adapt_indicator,
             num_min_levels=self.num_min_ref_levels,
             num_max_levels=self.num_max_ref_levels,
         )
@@ -792,72 +791,67 @@ class pyTACSAdapt(BaseUI):
         """
         # get the elem counts
         nelems = len(element_errors)
-        elem_counts = self.comm.allgather(nelems)
-        nelems_tot = sum(elem_counts)
+        nelems_tot = self.comm.allreduce(nelems, op=MPI.SUM)
         nrefine = int(self.growth_refine_factor * nelems_tot)
         ncoarse = int(self.growth_coarsen_factor * nelems_tot)
 
-        # gather all the element errors on each proc
-        element_errors_tot = np.empty(nelems_tot)
-        self.comm.Allgatherv(element_errors, [element_errors_tot, elem_counts])
-
-        # compute the error ratio for all elements
+        # select the elements with the largest and smallest errors in
+        # parallel, refining only those above the target error and
+        # coarsening only those below it
         target_error = self.error_tol / nelems_tot
-        error_ratio_tot = element_errors_tot / target_error
-
-        # sort all the element error ratios in descending order
-        sorted_inds = np.flip(np.argsort(error_ratio_tot))
-
-        # create the adaptation indicator array
-        adapt_indicator_tot = np.zeros(nelems_tot, dtype=int)
-        refine_inds = None
-        coarse_inds = None
-        if nrefine > 0:
-            refine_inds = sorted_inds[:nrefine]
-            adapt_indicator_tot[refine_inds] = np.where(
-                error_ratio_tot[refine_inds] >= 1.0, 1, adapt_indicator_tot[refine_inds]
-            )
-        if ncoarse > 0:
-            coarse_inds = sorted_inds[-ncoarse:]
-            adapt_indicator_tot[coarse_inds] = np.where(
-                error_ratio_tot[coarse_inds] < 1.0, -1, adapt_indicator_tot[coarse_inds]
-            )
+        (
+            adapt_indicator,
+            nref,
+            refine_threshold,
+            coarsen_threshold,
+        ) = TMR.computeRefinementArray(
+            self.comm,
+            np.ascontiguousarray(element_errors, dtype=float),
+            nrefine,
+            ncoarse,
+            refine_cutoff=target_error,
+            coarsen_cutoff=target_error,
+        )
+        ncoarsened = self.comm.allreduce(
+            np.count_nonzero(adapt_indicator < 0), op=MPI.SUM
+        )
 
         # update the adaptation history
-        if refine_inds is not None:
-            ind = 0
-            while error_ratio_tot[refine_inds[ind]] >= 1.0:
-                self.adaptation_history["threshold"][
-                    f"refine_{self.coarse.refine_iter}"
-                ] = error_ratio_tot[refine_inds[ind]]
-                ind += 1
-                if ind >= nrefine:
-                    break
-        if coarse_inds is not None:
-            ind = ncoarse - 1
-            while error_ratio_tot[coarse_inds[ind]] < 1.0:
-                self.adaptation_history["threshold"][
-                    f"coarsen_{self.coarse.refine_iter}"
-                ] = error_ratio_tot[coarse_inds[ind]]
-                ind -= 1
-                if ind <= 0:
-                    break
+        if nrefine > 0 and nref > 0:
+            self.adaptation_history["threshold"][
+                f"refine_{self.coarse.refine_iter}"
+            ] = refine_threshold / target_error
+        if ncoarse > 0 and ncoarsened > 0:
+            self.adaptation_history["threshold"][
+                f"coarsen_{self.coarse.refine_iter}"
+            ] = min(coarsen_threshold / target_error, 1.0)
         self.adaptation_history["element_errors"][
             f"adapt_iter_{self.coarse.refine_iter}"
-        ] = error_ratio_tot
-
-        # scatter the adaptation indicator to each proc
-        adapt_indicator = np.empty(nelems, dtype=int)
-        self.comm.Scatterv([adapt_indicator_tot, elem_counts], adapt_indicator, root=0)
+        ] = self._gatherErrorRatio(element_errors, target_error)
 
         # adapt the coarse-space model
         self.coarse.applyRefinement(
-            adapt_indicator.astype(np.intc),
+            adapt_indicator,
             num_min_levels=self.num_min_ref_levels,
             num_max_levels=self.num_max_ref_levels,
         )
         return
 
+    def _gatherErrorRatio(self, element_errors, target_error):
+        """
+        Gathers the element error ratios on the root processor for the
+        adaptation history. The other processors return None.
+        """
+        error_ratio = np.ascontiguousarray(element_errors / target_error)
+        elem_counts = self.comm.gather(len(error_ratio), root=0)
+        error_ratio_tot = None
+        if self.comm.rank == 0:
+            error_ratio_tot = np.empty(sum(elem_counts))
+            self.comm.Gatherv(error_ratio, [error_ratio_tot, elem_counts], root=0)
+        else:
+            self.comm.Gatherv(error_ratio, None, root=0)
+        return error_ratio_tot
+
     def writeModelHistory(self, filename=""):
         """
         Writes out the model history information to an .hdf5 file